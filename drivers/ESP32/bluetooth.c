@@ -46,8 +46,14 @@
 #define SPP_CONNECTED    (1 << 1)
 #define SPP_CONGESTED    (1 << 2)
 #define SPP_DISCONNECTED (1 << 3)
-#define BT_TX_QUEUE_ENTRIES 32
-#define BT_TX_BUFFER_SIZE 250
+#define BT_TX_BUFFER_SIZE 2048 // Must be a power of 2
+#define BT_TX_FLUSH_DELAY 10   // Max time in ms output is held back for coalescing
+#define BT_TX_FLUSH_TICKS (pdMS_TO_TICKS(BT_TX_FLUSH_DELAY) ? pdMS_TO_TICKS(BT_TX_FLUSH_DELAY) : 1)
+#ifdef ESP_SPP_MAX_MTU
+#define BT_TX_MTU ESP_SPP_MAX_MTU
+#else
+#define BT_TX_MTU 990
+#endif
 
 #define USE_BT_MUTEX 0
 
@@ -62,24 +68,25 @@ static SemaphoreHandle_t lock = NULL;
 
 #define SPP_TAG "BLUETOOTH"
 
+/*
+  Output is written to a ring buffer by the grbl task and sent by the btTX task in writes of up to
+  BT_TX_MTU bytes, one write in flight at a time. The task is woken when a MTU worth of complete lines
+  is pending, else it sends what is pending after BT_TX_FLUSH_DELAY ms. Status reports and responses
+  are thus coalesced into few SPP packets instead of being sent one line at a time.
+*/
+
 typedef struct {
-    volatile uint16_t head;
+    volatile uint_fast16_t head;
+    volatile uint_fast16_t tail;
     char data[BT_TX_BUFFER_SIZE];
 } bt_tx_buffer_t;
 
-typedef struct {
-    uint16_t length;
-    uint8_t data[1];
-} tx_chunk_t;
-
 static uint32_t connection = 0;
 static bool is_second_attempt = false;
 static bluetooth_settings_t *bt_settings;
 static SemaphoreHandle_t tx_busy = NULL;
 static EventGroupHandle_t event_group = NULL;
 static TaskHandle_t polltask = NULL;
-static xQueueHandle tx_queue = NULL;
-static portMUX_TYPE tx_flush_mux = portMUX_INITIALIZER_UNLOCKED;
 static char client_mac[18];
 
 static bt_tx_buffer_t txbuffer;
@@ -126,33 +133,65 @@ int16_t BTStreamGetC (void)
     return data;
 }
 
-static inline bool enqueue_tx_chunk (uint16_t length, uint8_t *data)
+//
+// BTStreamReadBlock - reads up to max characters, ends after the first CR or LF
+//
+uint16_t BTStreamReadBlock (char *buffer, uint16_t max)
 {
-    tx_chunk_t *chunk;
-
-    if((chunk = malloc(sizeof(tx_chunk_t) + length))) {
-        chunk->length = length;
-        memcpy(&chunk->data, data, length);
-        if (xQueueSendToBack(tx_queue, &chunk, portMAX_DELAY) != pdPASS) {
-            free(chunk);
-            chunk = NULL;
-        }
+    char c;
+    uint16_t count = 0;
+
+    BT_MUTEX_LOCK();
+
+    uint_fast16_t bptr = rxbuffer.tail, head = rxbuffer.head;
+
+    while(count < max && bptr != head) {
+        buffer[count++] = c = rxbuffer.data[bptr];
+        bptr = (bptr + 1) & (RX_BUFFER_SIZE - 1);
+        if(c == ASCII_LF || c == ASCII_CR)
+            break;
     }
 
-    return chunk != NULL;
+    rxbuffer.tail = bptr;
+
+    BT_MUTEX_UNLOCK();
+
+    return count;
+}
+
+// "dummy" version of BTStreamReadBlock
+static uint16_t BTStreamReadBlockNull (char *buffer, uint16_t max)
+{
+    return 0;
+}
+
+static inline uint_fast16_t tx_count (void)
+{
+    uint_fast16_t head = txbuffer.head, tail = txbuffer.tail;
+
+    return BUFCOUNT(head, tail, BT_TX_BUFFER_SIZE);
+}
+
+uint16_t BTStreamTXFree (void)
+{
+    return (BT_TX_BUFFER_SIZE - 1) - tx_count();
 }
 
-// Since grbl always sends cr/lf terminated strings we can send complete strings to improve throughput
 bool BTStreamPutC (const char c)
 {
-    if(txbuffer.head < BT_TX_BUFFER_SIZE)
-        txbuffer.data[txbuffer.head++] = c;
+    uint_fast16_t next_head = (txbuffer.head + 1) & (BT_TX_BUFFER_SIZE - 1);
 
-    if(c == '\n') {
-        enqueue_tx_chunk(txbuffer.head, (uint8_t *)txbuffer.data);
-        txbuffer.head = 0;
+    while(txbuffer.tail == next_head) {                 // Buffer full, block until space is available...
+        if(!connection || !hal.stream_blocking_callback())
+            return false;
     }
 
+    txbuffer.data[txbuffer.head] = c;                   // Add data to buffer
+    txbuffer.head = next_head;                          // and update head pointer
+
+    if(c == ASCII_LF && tx_count() >= BT_TX_MTU && polltask)
+        xTaskNotifyGive(polltask);                      // A full packet is ready, send it now
+
     return true;
 }
 
@@ -203,9 +242,10 @@ bool BTStreamSuspendInput (bool suspend)
 {
     BT_MUTEX_LOCK();
 
-    if(suspend)
+    if(suspend) {
         hal.stream.read = BTStreamGetNull;
-    else if(rxbuffer.backup)
+        hal.stream.read_block = BTStreamReadBlockNull;
+    } else if(rxbuffer.backup)
         memcpy(&rxbuffer, &rxbackup, sizeof(stream_rx_buffer_t));
 
     BT_MUTEX_UNLOCK();
@@ -215,19 +255,66 @@ bool BTStreamSuspendInput (bool suspend)
 
 static void flush_tx_queue (void)
 {
-    if(uxQueueMessagesWaiting(tx_queue)) {
+    txbuffer.tail = txbuffer.head;
+}
+
+// Adds a run of characters to the input buffer, flags overflow if it does not fit.
+static void rx_add_run (const uint8_t *data, uint_fast16_t length)
+{
+    uint_fast16_t head = rxbuffer.head, tail = rxbuffer.tail, free = (RX_BUFFER_SIZE - 1) - BUFCOUNT(head, tail, RX_BUFFER_SIZE), part;
 
-        tx_chunk_t *chunk;
+    if(length > free) {
+        rxbuffer.overflow = 1;
+        length = free;
+    }
 
-        portENTER_CRITICAL(&tx_flush_mux);
+    if((part = RX_BUFFER_SIZE - head) > length)
+        part = length;
 
-        while(uxQueueMessagesWaiting(tx_queue)) {
-            if(xQueueReceive(tx_queue, &chunk, (TickType_t)0) == pdTRUE)
-                free(chunk);
-        }
+    memcpy(&rxbuffer.data[head], data, part);
+    memcpy(rxbuffer.data, data + part, length - part);
 
-        portEXIT_CRITICAL(&tx_flush_mux);
+    rxbuffer.head = (head + length) & (RX_BUFFER_SIZE - 1); // Update pointer after the data is in place
+}
+
+// Received data is scanned once, realtime commands are passed on as they are encountered
+// and the runs of characters between them are copied to the input buffer as blocks.
+static void rx_add_block (const uint8_t *data, uint_fast16_t length)
+{
+    const uint8_t *run = data;
+
+    // discard input if MPG has taken over...
+    if(hal.stream.type == StreamType_MPG)
+        return;
+
+    while(length--) {
+
+        if(*data == CMD_TOOL_ACK && !rxbuffer.backup) {
+
+            rx_add_run(run, data - run);                    // Commit characters preceding the ACK
+            memcpy(&rxbackup, &rxbuffer, sizeof(stream_rx_buffer_t));
+            rxbuffer.backup = true;
+            rxbuffer.tail = rxbuffer.head;
+            hal.stream.read = BTStreamGetC; // restore normal input
+            hal.stream.read_block = BTStreamReadBlock;
+            run = data + 1;
+
+        } else {
+
+            uint_fast16_t head = rxbuffer.head;
+
+            if(hal.stream.enqueue_realtime_command((char)*data)) {
+                if(rxbuffer.head == head)                   // Commit characters preceding the command
+                    rx_add_run(run, data - run);            // unless it cancelled buffered input
+                run = data + 1;
+            }
+        }
+        data++;
     }
+
+    rx_add_run(run, data - run);
+
+    system_idle_wake();
 }
 
 static void esp_spp_cb (esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
@@ -243,7 +330,7 @@ static void esp_spp_cb (esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
         case ESP_SPP_SRV_OPEN_EVT:
             if(connection == 0) {
                 connection = param->open.handle;
-                txbuffer.head = 0;
+                flush_tx_queue();
                 uint8_t *mac = param->srv_open.rem_bda;
                 sprintf(client_mac, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
                 selectStream(StreamType_Bluetooth);
@@ -271,43 +358,18 @@ static void esp_spp_cb (esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
             }
             break;
 
-        case ESP_SPP_DATA_IND_EVT:;
-            char c;
-            uint16_t len = param->data_ind.len;
-            uint8_t *data = param->data_ind.data;
-
-            while(len--) {
-                c = (char)*data++;
-                // discard input if MPG has taken over...
-                if(hal.stream.type != StreamType_MPG) {
-
-                    if(c == CMD_TOOL_ACK && !rxbuffer.backup) {
-
-                        memcpy(&rxbackup, &rxbuffer, sizeof(stream_rx_buffer_t));
-                        rxbuffer.backup = true;
-                        rxbuffer.tail = rxbuffer.head;
-                        hal.stream.read = BTStreamGetC; // restore normal input
-
-                    } else if(!hal.stream.enqueue_realtime_command(c)) {
-
-                        uint32_t bptr = (rxbuffer.head + 1) & (RX_BUFFER_SIZE - 1);  // Get next head pointer
-
-                        if(bptr == rxbuffer.tail)               // If buffer full
-                            rxbuffer.overflow = 1;              // flag overflow,
-                        else {
-                            rxbuffer.data[rxbuffer.head] = c;   // else add data to buffer
-                            rxbuffer.head = bptr;               // and update pointer
-                        }
-                    }
-                }
-            }
+        case ESP_SPP_DATA_IND_EVT:
+            rx_add_block(param->data_ind.data, param->data_ind.len);
             break;
 
         case ESP_SPP_CONG_EVT:
             if(param->cong.cong)
                 xEventGroupClearBits(event_group, SPP_CONGESTED);
-            else
+            else {
                 xEventGroupSetBits(event_group, SPP_CONGESTED);
+                if(tx_count())
+                    xTaskNotifyGive(polltask);
+            }
             ESP_LOGI(SPP_TAG, "ESP_SPP_CONG_EVT");
             break;
 
@@ -315,6 +377,8 @@ static void esp_spp_cb (esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
             if(param->write.cong)
                 xEventGroupClearBits(event_group, SPP_CONGESTED);
             xSemaphoreGive(tx_busy);
+            if(tx_count() >= BT_TX_MTU)
+                xTaskNotifyGive(polltask);  // Send next packet without waiting for the flush deadline
             break;
 
         default:
@@ -365,51 +429,36 @@ void esp_bt_gap_cb(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param)
 
 static void pollTX (void * arg)
 {
-    tx_chunk_t *chunk = NULL;
-    bool data_sent = false;
-    uint8_t buffer[256], *ptr;
-    size_t remaining;
+    static uint8_t buffer[BT_TX_MTU];
+
+    uint_fast16_t count, tail, part;
 
     while(true) {
 
+        ulTaskNotifyTake(pdTRUE, BT_TX_FLUSH_TICKS);
+
         if(connection &&
-            xEventGroupWaitBits(event_group, SPP_CONGESTED, pdFALSE, pdTRUE, 0) &&
-             uxQueueMessagesWaiting(tx_queue) &&
+            (count = tx_count()) &&
+             xEventGroupWaitBits(event_group, SPP_CONGESTED, pdFALSE, pdTRUE, 0) &&
               xSemaphoreTake(tx_busy, (TickType_t)0)) {
 
-            data_sent = false;
+            if(count > BT_TX_MTU)
+                count = BT_TX_MTU;
 
-            if(chunk || xQueueReceive(tx_queue, &chunk, (TickType_t)0) == pdTRUE) {
+            tail = txbuffer.tail;
+            if((part = BT_TX_BUFFER_SIZE - tail) > count)
+                part = count;
 
-                remaining = sizeof(buffer);
-                ptr = buffer;
+            memcpy(buffer, &txbuffer.data[tail], part);
+            memcpy(&buffer[part], txbuffer.data, count - part);
 
-                if(chunk->length >= remaining) {
-                    data_sent = esp_spp_write(connection, chunk->length, chunk->data) == ESP_OK;
-                    free(chunk);
-                    chunk = NULL;
-                } else while(chunk && chunk->length < remaining) {
+            txbuffer.tail = (tail + count) & (BT_TX_BUFFER_SIZE - 1);
 
-                    memcpy(ptr, chunk->data, chunk->length);
-                    ptr += chunk->length;
-                    remaining -= chunk->length;
-                    free(chunk);
-
-                    if(xQueueReceive(tx_queue, &chunk, (TickType_t)0) != pdTRUE)
-                        chunk = NULL;
-                }
-
-                if(remaining != sizeof(buffer))
-                    data_sent = esp_spp_write(connection, sizeof(buffer) - remaining, buffer) == ESP_OK;
-            }
-
-            if(!data_sent)
-               xSemaphoreGive(tx_busy);
+            if(esp_spp_write(connection, count, buffer) != ESP_OK)
+                xSemaphoreGive(tx_busy);
         }
 
-        if(connection)
-            vTaskDelay(pdMS_TO_TICKS(10));
-        else
+        if(!connection)
             vTaskSuspend(NULL);
     }
 }
@@ -430,9 +479,6 @@ bool bluetooth_init (bluetooth_settings_t *settings)
         return false;
 #endif
 
-    if(!(tx_queue || (tx_queue = xQueueCreate(BT_TX_QUEUE_ENTRIES, sizeof(tx_chunk_t *)))))
-        return false;
-
     if(!(tx_busy || (tx_busy = xSemaphoreCreateBinary())))
         return false;
 
@@ -544,8 +590,7 @@ bool bluetooth_disable (void)
             vTaskDelete(polltask);
             vEventGroupDelete(event_group);
             vSemaphoreDelete(tx_busy);
-            vQueueDelete(tx_queue);
-            polltask = event_group = tx_busy = tx_queue = NULL;
+            polltask = event_group = tx_busy = NULL;
 #if USE_BT_MUTEX
             vSemaphoreDelete(lock);
             lock = NULL;
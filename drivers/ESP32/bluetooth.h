@@ -35,7 +35,9 @@ char *bluetooth_get_client_mac (void);
 
 uint32_t BTStreamAvailable (void);
 uint16_t BTStreamRXFree (void);
+uint16_t BTStreamTXFree (void);
 int16_t BTStreamGetC (void);
+uint16_t BTStreamReadBlock (char *buffer, uint16_t max);
 bool BTStreamSuspendInput (bool suspend);
 void BTStreamWriteS (const char *data);
 void BTStreamFlush (void);
@@ -32,9 +32,12 @@
 #include "esp32-hal-uart.h"
 #include "nvs.h"
 #include "esp_log.h"
+#include "soc/rmt_reg.h"
+#include "soc/gpio_struct.h"
 
 #if WIFI_ENABLE
 #include "wifi.h"
+#include "networking/StreamMux.h"
 #endif
 
 #if WEBUI_ENABLE
@@ -56,6 +59,9 @@
 #if SDCARD_ENABLE
 #include "sdcard/sdcard.h"
 #include "esp_vfs_fat.h"
+#if SDCARD_CACHE_ENABLE
+#include "esp_heap_caps.h"
+#endif
 #endif
 
 #if KEYPAD_ENABLE
@@ -78,6 +84,11 @@
 #include "freertos/task.h"
 #include "freertos/timers.h"
 
+#if defined(ENABLE_PERF_COUNTERS) || defined(ENABLE_MOTION_TRACE)
+#include "xtensa/hal.h"
+#include "rom/ets_sys.h"
+#endif
+
 // prescale step counter to 20Mhz
 #define STEPPER_DRIVER_PRESCALER 4
 
@@ -136,6 +147,20 @@ typedef struct {
 
 #if MPG_MODE_ENABLE
 static io_stream_t prev_stream = {0};
+#ifdef ENABLE_STREAM_ARBITER
+static const io_stream_t mpg_stream = {
+    .type = StreamType_MPG,
+    .read = uart2Read,
+    .write = uartWriteS,
+    .write_all = uartWriteS,
+    .get_rx_buffer_available = uart2RXFree,
+    .get_tx_buffer_available = uartTXFree,
+    .reset_read_buffer = uart2Flush,
+    .cancel_read_buffer = uart2Cancel,
+    .suspend_read = uart2SuspendInput,
+    .enqueue_realtime_command = protocol_enqueue_realtime_command
+};
+#endif
 #endif
 
 const io_stream_t serial_stream = {
@@ -144,6 +169,7 @@ const io_stream_t serial_stream = {
     .write = uartWriteS,
     .write_all = uartWriteS,
     .get_rx_buffer_available = uartRXFree,
+    .get_tx_buffer_available = uartTXFree,
     .reset_read_buffer = uartFlush,
     .cancel_read_buffer = uartCancel,
     .suspend_read = uartSuspendInput,
@@ -154,26 +180,15 @@ const io_stream_t serial_stream = {
 
 static network_services_t services = {0};
 
-void tcpStreamWriteS (const char *data)
-{
-#if TELNET_ENABLE
-    if(services.telnet)
-        TCPStreamWriteS(data);
-#endif
-#if WEBSOCKET_ENABLE
-    if(services.websocket)
-        WsStreamWriteS(data);
-#endif
-    uartWriteS(data);
-}
-
 #if TELNET_ENABLE
 const io_stream_t telnet_stream = {
     .type = StreamType_Telnet,
     .read = TCPStreamGetC,
     .write = TCPStreamWriteS,
-    .write_all = tcpStreamWriteS,
+    .write_n = TCPStreamWriteN,     // No read_block(), input is suspended via hal.stream.read only
+    .write_all = StreamMuxWriteS,
     .get_rx_buffer_available = TCPStreamRxFree,
+    .get_tx_buffer_available = TCPStreamTxFree,
     .reset_read_buffer = TCPStreamRxFlush,
     .cancel_read_buffer = TCPStreamRxCancel,
     .suspend_read = uartSuspendInput,
@@ -185,9 +200,12 @@ const io_stream_t telnet_stream = {
 const io_stream_t websocket_stream = {
     .type = StreamType_WebSocket,
     .read = WsStreamGetC,
+    .read_block = WsStreamReadBlock,
     .write = WsStreamWriteS,
-    .write_all = tcpStreamWriteS,
+    .write_n = WsStreamWriteN,
+    .write_all = StreamMuxWriteS,
     .get_rx_buffer_available = WsStreamRxFree,
+    .get_tx_buffer_available = WsStreamTxFree,
     .reset_read_buffer = WsStreamRxFlush,
     .cancel_read_buffer = WsStreamRxCancel,
     .enqueue_realtime_command = protocol_enqueue_realtime_command,
@@ -211,12 +229,14 @@ void btStreamWriteS (const char *data)
 const io_stream_t bluetooth_stream = {
     .type = StreamType_Bluetooth,
     .read = BTStreamGetC,
+    .read_block = BTStreamReadBlock,
     .write = BTStreamWriteS,
     .write_all = btStreamWriteS,
     .get_rx_buffer_available = BTStreamRXFree,
+    .get_tx_buffer_available = BTStreamTXFree,
     .reset_read_buffer = BTStreamFlush,
     .cancel_read_buffer = BTStreamCancel,
-    .suspend_read = uartSuspendInput,
+    .suspend_read = BTStreamSuspendInput,
     .enqueue_realtime_command = protocol_enqueue_realtime_command
 };
 
@@ -249,6 +269,8 @@ static volatile uint32_t ms_count = 1; // NOTE: initial value 1 is for "resettin
 static uint32_t pwm_max_value;
 static bool pwmEnabled = false, IOInitDone = false;
 static spindle_pwm_t spindle_pwm;
+static stepdir_port_t dir_port[2];
+static uint_fast8_t n_dir_ports = 0;
 
 // Inverts the probe pin state depending on user settings and probing cycle mode.
 static uint8_t probe_invert;
@@ -283,8 +305,96 @@ static void gpio_isr (void *arg);
 
 static TimerHandle_t xDelayTimer = NULL, debounceTimer = NULL;
 
+#if PREP_TASK_ENABLE || defined(ENABLE_IDLE_WAIT)
+// Wait timeout of the prep task and hal.idle_wait, 1 ms. A tick at least if the tick rate is lower.
+#define WAIT_TICKS (pdMS_TO_TICKS(1) ? pdMS_TO_TICKS(1) : 1)
+#endif
+
+#if defined(ENABLE_IDLE_WAIT) && configTICK_RATE_HZ < 1000
+#error "ENABLE_IDLE_WAIT requires a 1 kHz FreeRTOS tick, set CONFIG_FREERTOS_HZ=1000 in sdkconfig!"
+#endif
+
+#if PREP_TASK_ENABLE
+
+static TaskHandle_t prepTask = NULL;
+static SemaphoreHandle_t plannerMutex = NULL;
+
+// Serializes planner and segment generator updates between the Grbl task and the prep task.
+static void plannerLock (bool lock)
+{
+    if(lock)
+        xSemaphoreTakeRecursive(plannerMutex, portMAX_DELAY);
+    else
+        xSemaphoreGiveRecursive(plannerMutex);
+}
+
+// Keeps the segment buffer filled while the Grbl task is busy parsing or serving the network.
+// Runs on core 1 along with the stepper ISR, which is allocated here since interrupts are
+// serviced by the core they were allocated from. Woken by the stepper ISR on each segment load.
+static void vPrepTask (void *grblTask)
+{
+    timer_isr_register(STEP_TIMER_GROUP, STEP_TIMER_INDEX, stepper_driver_isr, 0, ESP_INTR_FLAG_IRAM, NULL);
+    timer_enable_intr(STEP_TIMER_GROUP, STEP_TIMER_INDEX);
+
+    xTaskNotifyGive((TaskHandle_t)grblTask);
+
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, WAIT_TICKS);
+#ifdef ENABLE_REALTIME_DISPATCH
+        protocol_realtime_dispatch(); // Start the deceleration for a pending stop request, if any.
+#endif
+        if (sys.state & (STATE_CYCLE | STATE_HOLD | STATE_SAFETY_DOOR | STATE_HOMING | STATE_SLEEP| STATE_JOG))
+            st_prep_buffer();
+    }
+}
+
+#ifdef ENABLE_REALTIME_DISPATCH
+
+// Wakes the prep task to start the deceleration for a stop request, the Grbl task may be busy elsewhere.
+IRAM_ATTR static void pendRealtime (void)
+{
+    if(xPortInIsrContext()) {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(prepTask, &xHigherPriorityTaskWoken);
+        if(xHigherPriorityTaskWoken)
+            portYIELD_FROM_ISR();
+    } else
+        xTaskNotifyGive(prepTask);
+}
+
+#endif
+
+#endif
+
+#ifdef ENABLE_IDLE_WAIT
+
+static TaskHandle_t grblTask = NULL;
+
+// Blocks the Grbl task until woken or for 1 ms at most, the network tasks run meanwhile.
+static void idleWait (void)
+{
+    ulTaskNotifyTake(pdTRUE, WAIT_TICKS);
+}
+
+IRAM_ATTR static void idleWake (void)
+{
+    if(xPortInIsrContext()) {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(grblTask, &xHigherPriorityTaskWoken);
+        if(xHigherPriorityTaskWoken)
+            portYIELD_FROM_ISR();
+    } else
+        xTaskNotifyGive(grblTask);
+}
+
+#endif
+
 static void activateStream (const io_stream_t *stream)
 {
+#ifdef ENABLE_STREAM_ARBITER
+    if(stream_arbiter_add(stream, StreamPriority_Host))
+        return;
+#endif
 #if MPG_MODE_ENABLE
     if(hal.stream.type == StreamType_MPG) {
         hal.stream.write_all = stream->write_all;
@@ -313,6 +423,7 @@ void selectStream (stream_type_t stream)
         case StreamType_Telnet:
             activateStream(&telnet_stream);
             services.telnet = On;
+            StreamMuxEnable(StreamType_Telnet, true);
             hal.stream.write_all("[MSG:TELNET STREAM ACTIVE]\r\n");
             break;
 #endif
@@ -321,6 +432,7 @@ void selectStream (stream_type_t stream)
         case StreamType_WebSocket:
             activateStream(&websocket_stream);
             services.websocket = On;
+            StreamMuxEnable(StreamType_WebSocket, true);
             hal.stream.write_all("[MSG:WEBSOCKET STREAM ACTIVE]\r\n");
             break;
 #endif
@@ -329,6 +441,8 @@ void selectStream (stream_type_t stream)
             activateStream(&serial_stream);
 #if WIFI_ENABLE
             services.mask = 0;
+            StreamMuxEnable(StreamType_Telnet, false);
+            StreamMuxEnable(StreamType_WebSocket, false);
 #endif
             if(active_stream != StreamType_Serial)
                 hal.stream.write_all("[MSG:SERIAL STREAM ACTIVE]\r\n");
@@ -341,6 +455,24 @@ void selectStream (stream_type_t stream)
     active_stream = stream;
 }
 
+// Step pins, driven by RMT channels 0 to N_AXIS - 1.
+static const gpio_num_t step_pin[N_AXIS] = {
+    X_STEP_PIN, Y_STEP_PIN, Z_STEP_PIN
+#ifdef A_AXIS
+  , A_STEP_PIN
+#endif
+#ifdef B_AXIS
+  , B_STEP_PIN
+#endif
+#ifdef C_AXIS
+  , C_STEP_PIN
+#endif
+};
+
+// RMT channel configuration register values for starting a step pulse,
+// a pulse is started by a single register write.
+static uint32_t rmt_start[N_AXIS];
+
 void initRMT (settings_t *settings)
 {
     rmt_item32_t rmtItem[2];
@@ -366,25 +498,15 @@ void initRMT (settings_t *settings)
     for(channel = 0; channel < N_AXIS; channel++) {
 
         rmtConfig.channel = channel;
+        rmtConfig.gpio_num = step_pin[channel];
+        rmtConfig.tx_config.idle_level = (settings->steppers.step_invert.mask & bit(channel)) != 0;
 
-        switch(channel) {
-            case 0:
-                rmtConfig.tx_config.idle_level = settings->steppers.step_invert.x;
-                rmtConfig.gpio_num = X_STEP_PIN;
-                break;
-            case 1:
-                rmtConfig.tx_config.idle_level = settings->steppers.step_invert.y;
-                rmtConfig.gpio_num = Y_STEP_PIN;
-                break;
-            case 2:
-                rmtConfig.tx_config.idle_level = settings->steppers.step_invert.z;
-                rmtConfig.gpio_num = Z_STEP_PIN;
-                break;
-        }
         rmtItem[0].level0 = rmtConfig.tx_config.idle_level;
         rmtItem[0].level1 = !rmtConfig.tx_config.idle_level;
         rmt_config(&rmtConfig);
         rmt_fill_tx_items(rmtConfig.channel, &rmtItem[0], 2, 0);
+
+        rmt_start[channel] = RMT.conf_ch[channel].conf1.val | RMT_MEM_RD_RST_CH0 | RMT_TX_START_CH0;
     }
 }
 
@@ -399,6 +521,14 @@ void vTimerCallback (TimerHandle_t xTimer)
     xDelayTimer = NULL;
 }
 
+#if defined(ENABLE_PERF_COUNTERS) || defined(ENABLE_MOTION_TRACE)
+// CCOUNT is per core, functions measured must start and end on the same core.
+IRAM_ATTR static uint32_t getCycleCount (void)
+{
+    return xthal_get_ccount();
+}
+#endif
+
 IRAM_ATTR static void driver_delay_ms (uint32_t ms, void (*callback)(void))
 {
     if(callback) {
@@ -435,20 +565,30 @@ inline IRAM_ATTR static void set_step_outputs (axes_signals_t step_outbits)
     if(step_outbits.value)
         hal.debug_out(true);
 #endif
-    if(step_outbits.x) {
-        RMT.conf_ch[0].conf1.mem_rd_rst = 1;
-        RMT.conf_ch[0].conf1.tx_start = 1;
-    }
+    // The ESP32 has no common RMT start register, start the channels by back-to-back register writes.
+    if(step_outbits.x)
+        RMT.conf_ch[X_AXIS].conf1.val = rmt_start[X_AXIS];
 
-    if(step_outbits.y) {
-        RMT.conf_ch[1].conf1.mem_rd_rst = 1;
-        RMT.conf_ch[1].conf1.tx_start = 1;
-    }
+    if(step_outbits.y)
+        RMT.conf_ch[Y_AXIS].conf1.val = rmt_start[Y_AXIS];
 
-    if(step_outbits.z) {
-        RMT.conf_ch[2].conf1.mem_rd_rst = 1;
-        RMT.conf_ch[2].conf1.tx_start = 1;
-    }
+    if(step_outbits.z)
+        RMT.conf_ch[Z_AXIS].conf1.val = rmt_start[Z_AXIS];
+
+#ifdef A_AXIS
+    if(step_outbits.a)
+        RMT.conf_ch[A_AXIS].conf1.val = rmt_start[A_AXIS];
+#endif
+
+#ifdef B_AXIS
+    if(step_outbits.b)
+        RMT.conf_ch[B_AXIS].conf1.val = rmt_start[B_AXIS];
+#endif
+
+#ifdef C_AXIS
+    if(step_outbits.c)
+        RMT.conf_ch[C_AXIS].conf1.val = rmt_start[C_AXIS];
+#endif
 /*
     step_outbits.value ^= settings.steppers.step_invert.mask;
     gpio_set_level(X_STEP_PIN, step_outbits.x);
@@ -459,12 +599,46 @@ inline IRAM_ATTR static void set_step_outputs (axes_signals_t step_outbits)
 
 // Set stepper direction output pins
 // NOTE: see note for set_step_outputs()
+// Pins 0-31 and 32-39 are updated by one write each to the w1ts and w1tc registers of their bank,
+// the values are looked up in tables built by dirMapInit(). Inversion is applied by the tables.
 inline IRAM_ATTR static void set_dir_outputs (axes_signals_t dir_outbits)
 {
-    dir_outbits.value ^= settings.steppers.dir_invert.mask;
-    gpio_set_level(X_DIRECTION_PIN, dir_outbits.x);
-    gpio_set_level(Y_DIRECTION_PIN, dir_outbits.y);
-    gpio_set_level(Z_DIRECTION_PIN, dir_outbits.z);
+    uint_fast8_t idx = n_dir_ports;
+
+    while(idx) {
+        idx--;
+        ((volatile uint32_t *)dir_port[idx].port)[0] = dir_port[idx].set[dir_outbits.value];   // outx_w1ts
+        ((volatile uint32_t *)dir_port[idx].port)[1] = dir_port[idx].reset[dir_outbits.value]; // outx_w1tc
+    }
+}
+
+static void dirMapInit (settings_t *settings)
+{
+    static const gpio_num_t dir_pin[N_AXIS] = {
+        X_DIRECTION_PIN, Y_DIRECTION_PIN, Z_DIRECTION_PIN
+#ifdef A_AXIS
+      , A_DIRECTION_PIN
+#endif
+#ifdef B_AXIS
+      , B_DIRECTION_PIN
+#endif
+#ifdef C_AXIS
+      , C_DIRECTION_PIN
+#endif
+    };
+
+    stepdir_pin_t dir[N_AXIS];
+    uint_fast8_t idx = N_AXIS;
+
+    do {
+        idx--;
+        dir[idx].axis = idx;
+        dir[idx].port = dir_pin[idx] < 32 ? (void *)&GPIO.out_w1ts : (void *)&GPIO.out1_w1ts.val;
+        dir[idx].bit = 1UL << (dir_pin[idx] & 0x1F);
+    } while(idx);
+
+    n_dir_ports = 0; // Stop updates while the tables are rebuilt
+    n_dir_ports = stepdir_map_init(dir_port, 2, dir, N_AXIS, settings->steppers.dir_invert);
 }
 
 // Enable/disable steppers
@@ -534,6 +708,16 @@ IRAM_ATTR static void stepperCyclesPerTick (uint32_t cycles_per_tick)
 #else
     TIMERG0.hw_timer[STEP_TIMER_INDEX].alarm_low = cycles_per_tick < (1UL << 23) ? cycles_per_tick : (1UL << 23) - 1UL;
 #endif
+
+#if PREP_TASK_ENABLE
+    // A segment has been consumed, wake the prep task to refill the segment buffer.
+    if(xPortInIsrContext()) {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(prepTask, &xHigherPriorityTaskWoken);
+        if(xHigherPriorityTaskWoken)
+            portYIELD_FROM_ISR();
+    }
+#endif
 }
 
 // Sets stepper direction and pulse pins and starts a step pulse
@@ -610,6 +794,7 @@ static void probeConfigure(bool is_probe_away)
       probe_invert ^= 1;
 #if PROBE_ISR
     gpio_set_intr_type(inputpin[INPUT_PROBE].pin, probe_invert ? GPIO_INTR_NEGEDGE : GPIO_INTR_POSEDGE);
+    gpio_intr_enable(inputpin[INPUT_PROBE].pin);
     inputpin[INPUT_PROBE].active = false;
 #endif
 }
@@ -843,6 +1028,32 @@ IRAM_ATTR static uint_fast16_t valueSetAtomic (volatile uint_fast16_t *ptr, uint
 
 #if MPG_MODE_ENABLE
 
+#ifdef ENABLE_STREAM_ARBITER
+
+// The MPG stream is added as an input source, host input is kept and both are served at line boundaries.
+IRAM_ATTR static void modeSelect (bool mpg_mode)
+{
+    if(mpg_mode == sys.mpg_mode) {
+        hal.stream.enqueue_realtime_command(CMD_STATUS_REPORT_ALL);
+        return;
+    }
+
+    serialEnableMPG(mpg_mode);
+
+    if(mpg_mode)
+        stream_arbiter_add(&mpg_stream, StreamPriority_MPG);
+    else
+        stream_arbiter_remove(StreamPriority_MPG);
+
+    sys.mpg_mode = mpg_mode;
+    sys.report.mpg_mode = On;
+
+    // Force a realtime status report, all reports when MPG mode active
+    hal.stream.enqueue_realtime_command(mpg_mode ? CMD_STATUS_REPORT_ALL : CMD_STATUS_REPORT);
+}
+
+#else
+
 IRAM_ATTR static void modeSelect (bool mpg_mode)
 {
     // Deny entering MPG mode if busy
@@ -857,8 +1068,10 @@ IRAM_ATTR static void modeSelect (bool mpg_mode)
         memcpy(&prev_stream, &hal.stream, sizeof(io_stream_t));
         hal.stream.type = StreamType_MPG;
         hal.stream.read = uart2Read;
+        hal.stream.read_block = NULL; // Network and Bluetooth streams read blocks, input is read from hal.stream.read in MPG mode
         hal.stream.write = serial_stream.write;
         hal.stream.get_rx_buffer_available = uart2RXFree;
+        hal.stream.get_tx_buffer_available = serial_stream.get_tx_buffer_available;
         hal.stream.reset_read_buffer = uart2Flush;
         hal.stream.cancel_read_buffer = uart2Cancel;
         hal.stream.suspend_read = uart2SuspendInput;
@@ -874,6 +1087,8 @@ IRAM_ATTR static void modeSelect (bool mpg_mode)
     hal.stream.enqueue_realtime_command(mpg_mode ? CMD_STATUS_REPORT_ALL : CMD_STATUS_REPORT);
 }
 
+#endif
+
 IRAM_ATTR static void modeChange(void)
 {
     modeSelect(!gpio_get_level(MPG_ENABLE_PIN));
@@ -948,6 +1163,8 @@ static void settings_changed (settings_t *settings)
 
     if(IOInitDone) {
 
+        dirMapInit(settings);
+
       #if TRINAMIC_ENABLE
         trinamic_configure();
       #endif
@@ -1155,8 +1372,14 @@ static bool driver_setup (settings_t *settings)
 
     timer_init(STEP_TIMER_GROUP, STEP_TIMER_INDEX, &timerConfig);
     timer_set_counter_value(STEP_TIMER_GROUP, STEP_TIMER_INDEX, 0ULL);
+#if PREP_TASK_ENABLE
+    // The prep task registers the stepper ISR on core 1, wait for it to do so.
+    xTaskCreatePinnedToCore(vPrepTask, "Prep", 4096, xTaskGetCurrentTaskHandle(), configMAX_PRIORITIES - 1, &prepTask, 1);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#else
     timer_isr_register(STEP_TIMER_GROUP, STEP_TIMER_INDEX, stepper_driver_isr, 0, ESP_INTR_FLAG_IRAM, NULL);
     timer_enable_intr(STEP_TIMER_GROUP, STEP_TIMER_INDEX);
+#endif
 
     /********************
      *  Output signals  *
@@ -1245,6 +1468,14 @@ static bool driver_setup (settings_t *settings)
     esp_vfs_fat_sdmmc_mount("/sdcard", &host, &slot_config, &mount_config, &card);
 
     sdcard_init();
+
+#if SDCARD_CACHE_ENABLE
+  #ifdef CONFIG_SPIRAM_SUPPORT
+    sdcard_cache_attach(heap_caps_malloc(SDCARD_CACHE_SIZE, MALLOC_CAP_SPIRAM), SDCARD_CACHE_SIZE);
+  #else
+    sdcard_cache_attach(malloc(SDCARD_CACHE_SIZE), SDCARD_CACHE_SIZE);
+  #endif
+#endif
 #endif
 
 #if IOEXPAND_ENABLE
@@ -1265,7 +1496,7 @@ static bool driver_setup (settings_t *settings)
 
   // Set defaults
 
-    IOInitDone = settings->version == 16;
+    IOInitDone = settings->version == 17;
 
     settings_changed(settings);
 
@@ -1369,10 +1600,35 @@ bool driver_init (void)
     hal.board = BOARD_NAME;
 #endif
     hal.driver_setup = driver_setup;
+#if PREP_TASK_ENABLE
+    if((plannerMutex = xSemaphoreCreateRecursiveMutex())) {
+        hal.planner_lock = plannerLock;
+  #ifdef ENABLE_REALTIME_DISPATCH
+        hal.pend_realtime = pendRealtime;
+  #endif
+    }
+#endif
     hal.f_step_timer = rtc_clk_apb_freq_get() / STEPPER_DRIVER_PRESCALER; // 20 MHz
     hal.rx_buffer_size = RX_BUFFER_SIZE;
+#if defined(ENABLE_PERF_COUNTERS) || defined(ENABLE_MOTION_TRACE)
+    hal.f_cycle_counter = ets_get_cpu_frequency() * 1000000UL;
+    hal.get_cycle_count = getCycleCount;
+#endif
+#if PLANNER_BLOCKS
+    // Falls back to the grbl default buffer if allocation fails.
+    if((hal.planner_buffer.blocks = malloc(PLANNER_BLOCKS * sizeof(plan_block_t))))
+        hal.planner_buffer.size = PLANNER_BLOCKS;
+#ifdef PLANNER_SOA
+    hal.planner_buffer.profile = malloc(PLANNER_BLOCKS * 4 * sizeof(float));
+#endif
+#endif
     hal.delay_ms = driver_delay_ms;
     hal.settings_changed = settings_changed;
+#ifdef ENABLE_IDLE_WAIT
+    grblTask = xTaskGetCurrentTaskHandle(); // driver_init() is called from the Grbl task.
+    hal.idle_wait = idleWait;
+    hal.idle_wake = idleWake;
+#endif
 
     hal.stepper_wake_up = stepperWakeUp;
     hal.stepper_go_idle = stepperGoIdle;
@@ -1389,6 +1645,9 @@ bool driver_init (void)
 #if PROBE_ENABLE
     hal.probe_get_state = probeGetState;
     hal.probe_configure_invert_mask = probeConfigure;
+#if PROBE_ISR
+    hal.driver_cap.probe_latch = On;
+#endif
 #endif
 
     hal.spindle_set_state = spindleSetState;
@@ -1402,6 +1661,17 @@ bool driver_init (void)
 
     hal.system_control_get_state = systemGetState;
 
+#if WIFI_ENABLE
+    StreamMuxAdd(StreamType_Serial, uartWriteS, NULL);
+  #if TELNET_ENABLE
+    StreamMuxAdd(StreamType_Telnet, TCPStreamWriteS, TCPStreamTxFree);
+    StreamMuxAdd(StreamType_Null, TCPStreamWriteObservers, NULL);
+  #endif
+  #if WEBSOCKET_ENABLE
+    StreamMuxAdd(StreamType_WebSocket, WsStreamWriteS, WsStreamTxFree);
+  #endif
+#endif
+
     selectStream(StreamType_Serial);
 
 #if EEPROM_ENABLE
@@ -1415,6 +1685,8 @@ bool driver_init (void)
         hal.eeprom.type = EEPROM_Emulated;
         hal.eeprom.memcpy_from_flash = nvsRead;
         hal.eeprom.memcpy_to_flash = nvsWrite;
+        if(nvsBlockStorage())
+            hal.eeprom.memcpy_block_to_flash = nvsWriteBlock;
     } else
         hal.eeprom.type = EEPROM_None;
 #endif
@@ -1424,7 +1696,7 @@ bool driver_init (void)
     if(hal.eeprom.type != EEPROM_None) {
         hal.eeprom.driver_area.address = GRBL_EEPROM_SIZE;
         hal.eeprom.driver_area.size = sizeof(driver_settings); // Add assert?
-        hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings) + 1;
+        hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings) + EEPROM_CHECKSUM_SIZE;
 
         hal.driver_setting = driver_setting;
         hal.driver_settings_restore = driver_settings_restore;
@@ -1499,7 +1771,7 @@ bool driver_init (void)
 #endif
 
    // no need to move version check before init - compiler will fail any mismatch for existing entries
-    return hal.version == 6;
+    return hal.version == 7;
 }
 
 /* interrupt handlers */
@@ -1547,6 +1819,11 @@ IRAM_ATTR static void gpio_isr (void *arg)
   if(grp & INPUT_GROUP_CONTROL)
       hal.control_interrupt_callback(systemGetState());
 
+#if PROBE_ISR
+  if(grp & INPUT_GROUP_PROBE)
+      hal.probe_interrupt_callback(NULL);
+#endif
+
 #if MPG_MODE_ENABLE
 
   static bool mpg_mutex = false;
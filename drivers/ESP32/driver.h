@@ -66,6 +66,11 @@ static const DRAM_ATTR float FZERO = 0.0f;
 #define WEBSOCKET_ENABLE 1
 #endif
 
+#ifdef UDP_TELEMETRY_ENABLE
+#undef UDP_TELEMETRY_ENABLE
+#define UDP_TELEMETRY_ENABLE 1
+#endif
+
 #ifdef BLUETOOTH_ENABLE
 #undef BLUETOOTH_ENABLE
 #define BLUETOOTH_ENABLE 1
@@ -108,6 +113,9 @@ static const DRAM_ATTR float FZERO = 0.0f;
 #define IOEXPAND_ENABLE  0 // I2C IO expander for some output signals.
 #endif
 #define PWM_RAMPED       0 // Ramped spindle PWM.
+#define PLANNER_BLOCKS 256 // Number of planner blocks, allocated from the heap. Set to 0 to use the grbl default buffer.
+#define SDCARD_CACHE_SIZE 0 // Size of RAM file cache for SD card jobs, allocated from PSRAM when enabled in sdkconfig. Set to 0 to disable.
+#define PREP_TASK_ENABLE 0 // Run segment preparation and the stepper ISR on core 1, Grbl and networking on core 0.
 #define PROBE_ENABLE     1 // Probe input
 #define PROBE_ISR        0 // Catch probe state change by interrupt TODO: needs verification!
 #define WIFI_SOFTAP      0 // Use Soft AP mode for WiFi.
@@ -128,6 +136,10 @@ static const DRAM_ATTR float FZERO = 0.0f;
 #define WEBSOCKET_ENABLE 0 // Enable websocket daemon - requires WiFi enabled
 #endif
 
+#ifndef UDP_TELEMETRY_ENABLE
+#define UDP_TELEMETRY_ENABLE 0 // Multicast binary status frames - requires WiFi and ENABLE_BINARY_STATUS_REPORT enabled
+#endif
+
 #ifndef BLUETOOTH_ENABLE
 #define BLUETOOTH_ENABLE 0 // Streaming over Bluetooth.
 #endif
@@ -138,6 +150,9 @@ static const DRAM_ATTR float FZERO = 0.0f;
 #ifndef SDCARD_ENABLE
 #define SDCARD_ENABLE    0 // Run jobs from SD card.
 #endif
+#if SDCARD_ENABLE && SDCARD_CACHE_SIZE
+#define SDCARD_CACHE_ENABLE 1
+#endif
 #ifndef WEBUI_ENABLE
 #define WEBUI_ENABLE     0 // Enables WebUi - requires WiFi enabled. Note: experimental - only partly implemented!
 #endif
@@ -162,6 +177,10 @@ static const DRAM_ATTR float FZERO = 0.0f;
 
 #if WIFI_ENABLE
 
+// Wakes the network task on stream activity, see wifi.c.
+#define NETWORK_STREAM_NOTIFY() wifi_stream_notify()
+void wifi_stream_notify (void);
+
 #define NETWORK_TELNET_PORT     23
 #define NETWORK_HTTP_PORT       80
 #define NETWORK_WEBSOCKET_PORT  81
@@ -196,6 +215,10 @@ static const DRAM_ATTR float FZERO = 0.0f;
 #error "Networking protocols reqires WiFi enabled!"
 #endif // WIFI_ENABLE
 
+#if defined(ENABLE_REALTIME_DISPATCH) && !PREP_TASK_ENABLE
+#error "Realtime dispatch requires PREP_TASK_ENABLE, stop requests are dispatched from the prep task!"
+#endif
+
 #if BLUETOOTH_ENABLE
 #define BLUETOOTH_DEVICE    "GRBL"
 #define BLUETOOTH_SERVICE   "GRBL Serial Port" // Minimum 8 characters, or blank for open
@@ -349,6 +372,16 @@ extern QueueHandle_t i2cQueue;
 extern SemaphoreHandle_t i2cBusy;
 #endif
 
+#if N_AXIS > 3 && !(defined(A_STEP_PIN) && defined(A_DIRECTION_PIN))
+#error "A axis step and direction pins must be defined in the board map!"
+#endif
+#if N_AXIS > 4 && !(defined(B_STEP_PIN) && defined(B_DIRECTION_PIN))
+#error "B axis step and direction pins must be defined in the board map!"
+#endif
+#if N_AXIS > 5 && !(defined(C_STEP_PIN) && defined(C_DIRECTION_PIN))
+#error "C axis step and direction pins must be defined in the board map!"
+#endif
+
 #ifndef GRBL_ESP32
 #error "Add #define GRBL_ESP32 in grbl/config.h or update your CMakeLists.txt to the latest version!"
 #endif
@@ -87,6 +87,7 @@ static stream_rx_buffer_t rxbuffer = {
 };
 
 static stream_rx_buffer_t rxbackup;
+static stream_tx_buffer_t txbuffer = {0};
 
 #if MPG_MODE_ENABLE
 
@@ -111,6 +112,21 @@ static void IRAM_ATTR _uart1_isr (void *arg)
     uart1->dev->int_clr.frm_err = 1;
     uart1->dev->int_clr.rxfifo_tout = 1;
 
+    if(uart1->dev->int_st.txfifo_empty) {
+
+        uint_fast16_t tail = txbuffer.tail;
+
+        while(tail != txbuffer.head && uart1->dev->status.txfifo_cnt < 0x7F) { // Refill the TX FIFO from the buffer
+            uart1->dev->fifo.rw_byte = txbuffer.data[tail];
+            tail = (tail + 1) & (TX_BUFFER_SIZE - 1);
+        }
+        txbuffer.tail = tail;
+
+        if(tail == txbuffer.head)                   // If buffer empty then
+            uart1->dev->int_ena.txfifo_empty = 0;   // disable TX FIFO interrupt
+        uart1->dev->int_clr.txfifo_empty = 1;
+    }
+
     while(uart1->dev->status.rxfifo_cnt || (uart1->dev->mem_rx_status.wr_addr != uart1->dev->mem_rx_status.rd_addr)) {
 
         c = uart1->dev->fifo.rw_byte;
@@ -120,6 +136,9 @@ static void IRAM_ATTR _uart1_isr (void *arg)
             memcpy(&rxbackup, &rxbuffer, sizeof(stream_rx_buffer_t));
             rxbuffer.backup = true;
             rxbuffer.tail = rxbuffer.head;
+#ifdef ENABLE_STREAM_ARBITER
+            if(hal.stream.type != StreamType_MPG) // MPG input is not suspended by host
+#endif
             hal.stream.read = uartRead; // restore normal input
 
         } else if(!hal.stream.enqueue_realtime_command(c)) {
@@ -135,6 +154,8 @@ static void IRAM_ATTR _uart1_isr (void *arg)
         }
     }
 
+    system_idle_wake();
+
 /*
     if (xHigherPriorityTaskWoken) {
         portYIELD_FROM_ISR();
@@ -149,6 +170,8 @@ static void uartEnableInterrupt (uart_t *uart, uart_isr_ptr isr, bool enable_rx)
     esp_intr_alloc(UART_INTR_SOURCE(uart->num), (int)ESP_INTR_FLAG_IRAM, isr, NULL, &uart->intr_handle);
 
     uart->dev->conf1.rxfifo_full_thrhd = 112;
+    uart->dev->conf1.txfifo_empty_thrhd = 32;
+    uart->dev->int_ena.txfifo_empty = 0;
     uart->dev->conf1.rx_tout_thrhd = 2;
     uart->dev->conf1.rx_tout_en = 1;
     uart->dev->int_ena.rxfifo_full = enable_rx;
@@ -277,6 +300,13 @@ uint32_t uartAvailableForWrite (void)
     return uart1 ? 0x7f - uart1->dev->status.txfifo_cnt : 0;
 }
 
+uint16_t uartTXFree (void)
+{
+    uint16_t head = txbuffer.head, tail = txbuffer.tail;
+
+    return (TX_BUFFER_SIZE - 1) - BUFCOUNT(head, tail, TX_BUFFER_SIZE);
+}
+
 // "dummy" version of serialGetC
 static int16_t uartGetNull (void)
 {
@@ -302,14 +332,27 @@ int16_t uartRead (void)
 
 bool uartPutC (const char c)
 {
+    uint_fast16_t next_head;
+
     UART_MUTEX_LOCK(uart1);
 
-    while(uart1->dev->status.txfifo_cnt == 0x7F) {
-        if(!hal.stream_blocking_callback())
-            return false;
+    // Write directly to the TX FIFO if nothing is buffered and there is room, else buffer the character.
+    if(txbuffer.head == txbuffer.tail && uart1->dev->status.txfifo_cnt < 0x7F)
+        uart1->dev->fifo.rw_byte = c;
+    else {
+
+        next_head = (txbuffer.head + 1) & (TX_BUFFER_SIZE - 1);
+
+        while(txbuffer.tail == next_head) {         // Buffer full, block until space is available...
+            if(!hal.stream_blocking_callback())
+                return false;
+        }
+
+        txbuffer.data[txbuffer.head] = c;           // Add data to buffer,
+        txbuffer.head = next_head;                  // update head pointer and
+        uart1->dev->int_ena.txfifo_empty = 1;       // enable TX FIFO interrupt
     }
 
-    uart1->dev->fifo.rw_byte = c;
     UART_MUTEX_UNLOCK(uart1);
 
     return true;
@@ -370,6 +413,9 @@ static void IRAM_ATTR _uart2_isr (void *arg)
             memcpy(&rxbackup2, &rxbuffer2, sizeof(stream_rx_buffer_t));
             rxbuffer2.backup = true;
             rxbuffer2.tail = rxbuffer.head;
+#ifdef ENABLE_STREAM_ARBITER
+            if(hal.stream.type == StreamType_MPG) // Host input is not suspended by MPG
+#endif
             hal.stream.read = uart2Read; // restore normal input
 
         } else if(!hal.stream.enqueue_realtime_command(c)) {
@@ -385,6 +431,8 @@ static void IRAM_ATTR _uart2_isr (void *arg)
         }
     }
 
+    system_idle_wake();
+
 /*
     if (xHigherPriorityTaskWoken) {
         portYIELD_FROM_ISR();
@@ -413,6 +461,28 @@ IRAM_ATTR void serialSelect(bool mpg_mode)
     uart_on->dev->int_ena.rxfifo_tout = 1;
 }
 
+#ifdef ENABLE_STREAM_ARBITER
+
+// Enables or disables MPG input, host input stays enabled as the core arbitrates the streams.
+IRAM_ATTR void serialEnableMPG (bool on)
+{
+    uart2->dev->int_ena.rxfifo_full = 0;
+    uart2->dev->int_ena.frm_err = 0;
+    uart2->dev->int_ena.rxfifo_tout = 0;
+
+    if(on) {
+        flush(uart2);
+        uart2->dev->int_clr.rxfifo_full = 1;
+        uart2->dev->int_clr.frm_err = 1;
+        uart2->dev->int_clr.rxfifo_tout = 1;
+        uart2->dev->int_ena.rxfifo_full = 1;
+        uart2->dev->int_ena.frm_err = 1;
+        uart2->dev->int_ena.rxfifo_tout = 1;
+    }
+}
+
+#endif
+
 void uart2Init (void)
 {
     uart2 = &_uart_bus_array[1]; // use UART 1
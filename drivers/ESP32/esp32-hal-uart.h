@@ -59,6 +59,7 @@ void uartInit (void);
 uint32_t uartAvailable (void);
 uint16_t uartRXFree (void);
 uint32_t uartAvailableForWrite (void);
+uint16_t uartTXFree (void);
 int16_t uartRead (void);
 bool uartSuspendInput (bool suspend);
 
@@ -85,6 +86,9 @@ void uart2Flush (void);
 void uart2Cancel (void);
 
 void serialSelect(bool mpg_mode);
+#ifdef ENABLE_STREAM_ARBITER
+void serialEnableMPG (bool on);
+#endif
 
 #endif
 
@@ -38,7 +38,17 @@ void I2CTask (void *queue)
 {
     i2c_task_t task;
 
+#if IOEXPAND_ENABLE
+    // Times out periodically to flush I/O expander output changes that could not be signalled.
+    while(true) {
+
+        if(xQueueReceive((QueueHandle_t)queue, &task, IOEX_FLUSH_MS / portTICK_PERIOD_MS) != pdPASS) {
+            ioexpand_flush();
+            continue;
+        }
+#else
     while(xQueueReceive((QueueHandle_t)queue, &task, portMAX_DELAY) == pdPASS) {
+#endif
 
 #if KEYPAD_ENABLE
         if(task.action == 1) { // Read keypad character and add to input buffer
@@ -57,21 +67,8 @@ void I2CTask (void *queue)
         }
 #endif
 #if IOEXPAND_ENABLE
-        if(task.action == 2) { // Write to I/O expander (from ISR)
-            if(i2cBusy != NULL && xSemaphoreTake(i2cBusy, 5 / portTICK_PERIOD_MS) == pdTRUE) {
-
-                i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-                i2c_master_start(cmd);
-                i2c_master_write_byte(cmd, IOEX_ADDRESS|I2C_MASTER_WRITE, true);
-                i2c_master_write_byte(cmd, RW_OUTPUT, true);
-                i2c_master_write_byte(cmd, (uint8_t)((uint32_t)task.params & 0xFF), true);
-                i2c_master_stop(cmd);
-                i2c_master_cmd_begin(I2C_PORT, cmd, 1000 / portTICK_PERIOD_MS);
-                i2c_cmd_link_delete(cmd);
-
-                xSemaphoreGive(i2cBusy);
-            }
-        }
+        if(task.action == 2) // Write I/O expander output changes
+            ioexpand_flush();
 #endif
     }
 }
@@ -67,26 +67,47 @@ void ioexpand_init (void)
     }
 }
 
+// Output state shadow, written to the expander by the I2C task. Changes made before the task runs are coalesced
+// to a single write, if the task could not be signalled the write is done by the periodic flush of the task.
+static volatile uint8_t shadow = 0;
+static volatile bool dirty = false;
+
 IRAM_ATTR void ioexpand_out (ioexpand_t pins)
 {
-    static i2c_task_t i2c_task = {
+    static const i2c_task_t i2c_task = {
         .action = 2,
         .params = NULL
     };
 
-    if(xPortInIsrContext()) {
-        i2c_task.params = (void *)((uint32_t)pins.mask);
-        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        xQueueSendFromISR(i2cQueue, (void *)&i2c_task, &xHigherPriorityTaskWoken);
-    } else if(i2cBusy != NULL && xSemaphoreTake(i2cBusy, 5 / portTICK_PERIOD_MS) == pdTRUE) {
+    shadow = pins.mask;
+
+    if(!dirty) {
+        dirty = true;
+        if(xPortInIsrContext()) {
+            BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+            xQueueSendFromISR(i2cQueue, (void *)&i2c_task, &xHigherPriorityTaskWoken);
+            if(xHigherPriorityTaskWoken)
+                portYIELD_FROM_ISR();
+        } else
+            xQueueSend(i2cQueue, (void *)&i2c_task, 0);
+    }
+}
+
+// Writes the output state to the expander if changed, called from the I2C task only.
+void ioexpand_flush (void)
+{
+    if(dirty && i2cBusy != NULL && xSemaphoreTake(i2cBusy, 5 / portTICK_PERIOD_MS) == pdTRUE) {
+
+        dirty = false; // Cleared before the state is read, a change while writing is flushed by the next pass.
 
         i2c_cmd_handle_t cmd = i2c_cmd_link_create();
         i2c_master_start(cmd);
         i2c_master_write_byte(cmd, IOEX_ADDRESS|I2C_MASTER_WRITE, true);
         i2c_master_write_byte(cmd, RW_OUTPUT, true);
-        i2c_master_write_byte(cmd, pins.mask, true);
+        i2c_master_write_byte(cmd, shadow, true);
         i2c_master_stop(cmd);
-        i2c_master_cmd_begin(I2C_PORT, cmd, 1000 / portTICK_PERIOD_MS);
+        if(i2c_master_cmd_begin(I2C_PORT, cmd, 1000 / portTICK_PERIOD_MS) != ESP_OK)
+            dirty = true; // Retry on the next flush.
         i2c_cmd_link_delete(cmd);
 
         xSemaphoreGive(i2cBusy);
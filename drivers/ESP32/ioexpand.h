@@ -34,8 +34,11 @@
 #define RW_INVERSION 2
 #define RW_CONFIG    3
 
+#define IOEX_FLUSH_MS 10 // Max. time from an output change to the expander write if the I2C task could not be signalled.
+
 void ioexpand_init (void);
 void ioexpand_out (ioexpand_t pins);
+void ioexpand_flush (void);
 ioexpand_t ioexpand_in (void);
 
 #endif
@@ -36,6 +36,7 @@
 #include <stdbool.h>
 
 #include "grbl/grbllib.h"
+#include "driver.h"
 
 #include "nvs.h"
 #include "nvs_flash.h"
@@ -58,5 +59,10 @@ void app_main(void)
             ret = nvs_flash_init();
     }
 
+#if PREP_TASK_ENABLE
+    // Core 1 is reserved for segment preparation and the stepper ISR, see driver.c
+    xTaskCreatePinnedToCore(vGrblTask, "Grbl", 4096, NULL, 0, NULL, 0);
+#else
     xTaskCreatePinnedToCore(vGrblTask, "Grbl", 4096, NULL, 0, NULL, 1);
+#endif
 }
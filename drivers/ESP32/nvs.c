@@ -21,8 +21,16 @@
   along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "esp_partition.h"
 #include "esp_log.h"
+#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
 
 #include "nvs.h"
 #include "grbl/grbl.h"
@@ -40,6 +48,34 @@ static const esp_partition_t *grblNVS = NULL;
 
 static bool (*realtime_command_handler)(char data); // NOTE: set by grbl at startup
 
+/*
+  Each block of the emulated EEPROM, the global settings with the version byte, a coordinate system, a tool, a
+  startup line or the driver settings, is stored under its own key in the NVS partition as the core writes only
+  the blocks changed. Blocks are copied and queued by nvsWriteBlock() and written by a background task, the grbl
+  task does not wait for the flash. The key "index" holds a bitmap of the block addresses stored. Blocks are read
+  on top of the image in the grbl partition, written by earlier versions. Keys of blocks overlapping a block
+  written are erased, these are left by a change of the settings layout.
+*/
+
+#define NVS_NAMESPACE "grbl"
+#define NVS_QUEUE_SIZE 16
+
+typedef struct {
+    uint16_t address;
+    uint16_t size;
+    uint8_t data[];
+} nvs_block_t;
+
+static nvs_handle grblKeys = 0;
+static QueueHandle_t nvsQueue = NULL;
+static uint8_t *keyIndex = NULL;
+static size_t keyIndexSize = 0;
+
+static inline void nvs_key (char *key, uint32_t address)
+{
+    sprintf(key, "b%04X", (unsigned int)address);
+}
+
 // Strip top bit set characters, control characters except CR and LF and question mark
 static IRAM_ATTR bool nvs_enqueue_realtime_command (char c)
 {
@@ -53,6 +89,26 @@ bool nvsRead (uint8_t *dest)
     if(!(ok = grblNVS && esp_partition_read(grblNVS, 0, (void *)dest, hal.eeprom.size) == ESP_OK))
         grblNVS = NULL;
 
+    if(grblKeys && (keyIndex = calloc(1, keyIndexSize = (hal.eeprom.size + 7) / 8))) {
+
+        char key[8];
+        size_t size = keyIndexSize;
+        uint32_t address;
+
+        ok = true;
+
+        if(nvs_get_blob(grblKeys, "index", keyIndex, &size) != ESP_OK)
+            memset(keyIndex, 0, keyIndexSize);
+
+        for(address = 0; address < hal.eeprom.size; address++) {
+            if(keyIndex[address >> 3] & bit(address & 0x07)) {
+                nvs_key(key, address);
+                if(nvs_get_blob(grblKeys, key, NULL, &size) == ESP_OK && address + size <= hal.eeprom.size)
+                    nvs_get_blob(grblKeys, key, dest + address, &size);
+            }
+        }
+    }
+
     return ok;
 }
 
@@ -73,9 +129,93 @@ bool nvsWrite (uint8_t *source)
     return ok;
 }
 
+// Queues a copy of the block and its checksum for the write task.
+void nvsWriteBlock (uint32_t destination, uint8_t *source, uint32_t size)
+{
+    nvs_block_t *block;
+
+    size += EEPROM_CHECKSUM_SIZE;
+
+    if(keyIndex && destination + size <= hal.eeprom.size && (block = malloc(sizeof(nvs_block_t) + size))) {
+        block->address = (uint16_t)destination;
+        block->size = (uint16_t)size;
+        memcpy(block->data, source, size);
+        if(xQueueSend(nvsQueue, &block, portMAX_DELAY) != pdTRUE)
+            free(block);
+    }
+}
+
+// Erases the keys of other blocks overlapping the block, e.g. blocks stored at addresses of an earlier settings layout.
+// Returns true if the index was changed.
+static bool nvs_erase_overlapped (nvs_block_t *block)
+{
+    char key[8];
+    size_t size;
+    uint32_t address;
+    bool erased = false;
+
+    for(address = 0; address < block->address + block->size; address++) {
+        if(address != block->address && (keyIndex[address >> 3] & bit(address & 0x07))) {
+            nvs_key(key, address);
+            if(nvs_get_blob(grblKeys, key, NULL, &size) != ESP_OK || address + size > block->address) {
+                nvs_erase_key(grblKeys, key);
+                keyIndex[address >> 3] &= ~bit(address & 0x07);
+                erased = true;
+            }
+        }
+    }
+
+    return erased;
+}
+
+static void nvsWriteTask (void *queue)
+{
+    char key[8];
+    bool update_index;
+    nvs_block_t *block;
+
+    while(xQueueReceive((QueueHandle_t)queue, &block, portMAX_DELAY) == pdTRUE) {
+
+        nvs_key(key, block->address);
+
+        // Redirect real time command handler as for nvsWrite() above.
+        realtime_command_handler = hal.stream.enqueue_realtime_command;
+        hal.stream.enqueue_realtime_command = nvs_enqueue_realtime_command;
+
+        if(nvs_set_blob(grblKeys, key, block->data, block->size) == ESP_OK) {
+            update_index = nvs_erase_overlapped(block);
+            if(!(keyIndex[block->address >> 3] & bit(block->address & 0x07))) {
+                keyIndex[block->address >> 3] |= bit(block->address & 0x07);
+                update_index = true;
+            }
+            if(update_index)
+                nvs_set_blob(grblKeys, "index", keyIndex, keyIndexSize);
+            nvs_commit(grblKeys);
+        }
+
+        hal.stream.enqueue_realtime_command = realtime_command_handler;
+
+        free(block);
+    }
+}
+
 bool nvsInit (void)
 {
     grblNVS = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "grbl");
 
-    return grblNVS != NULL;
+    if(nvs_open(NVS_NAMESPACE, NVS_READWRITE, &grblKeys) != ESP_OK)
+        grblKeys = 0;
+    else if((nvsQueue = xQueueCreate(NVS_QUEUE_SIZE, sizeof(nvs_block_t *))) == NULL ||
+             xTaskCreate(nvsWriteTask, "NVS", 2048, (void *)nvsQueue, 1, NULL) != pdPASS) {
+        nvs_close(grblKeys);
+        grblKeys = 0;
+    }
+
+    return grblNVS != NULL || grblKeys != 0;
+}
+
+// Returns true if blocks are written to separate keys, set hal.eeprom.memcpy_block_to_flash to nvsWriteBlock then.
+bool nvsBlockStorage (void)
+{
+    return grblKeys != 0;
 }
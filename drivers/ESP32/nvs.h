@@ -24,3 +24,5 @@
 bool nvsInit(void);
 bool nvsRead (uint8_t *dest);
 bool nvsWrite (uint8_t *source);
+bool nvsBlockStorage (void);
+void nvsWriteBlock (uint32_t destination, uint8_t *source, uint32_t size);
@@ -108,6 +108,15 @@ static esp_err_t index_html_get_handler(httpd_req_t *req)
     extern const unsigned char index_html_start[] asm("_binary_index_html_start");
     extern const unsigned char index_html_end[]   asm("_binary_index_html_end");
     const size_t index_html_size = (index_html_end - index_html_start);
+    static http_etag_t etag = "";
+
+    if(*etag == '\0')
+        http_etag_from_data(etag, index_html_start, index_html_size);
+
+    if(http_not_modified(req, etag))
+        return ESP_OK;
+
+    set_content_type_from_file(req, "index.html");
     return httpd_resp_send(req, (const char *)index_html_start, index_html_size);
 #endif
 }
@@ -128,8 +137,18 @@ esp_err_t set_content_type_from_file(httpd_req_t *req, const char *filename)
     if(filename && strlen(filename) > 3) {
         if (IS_FILE_EXT(filename, ".pdf"))
             return httpd_resp_set_type(req, "application/pdf");
-        else if (IS_FILE_EXT(filename, ".html"))
+        else if (IS_FILE_EXT(filename, ".html") || IS_FILE_EXT(filename, ".htm"))
             return httpd_resp_set_type(req, "text/html");
+        else if (IS_FILE_EXT(filename, ".css"))
+            return httpd_resp_set_type(req, "text/css");
+        else if (IS_FILE_EXT(filename, ".js"))
+            return httpd_resp_set_type(req, "application/javascript");
+        else if (IS_FILE_EXT(filename, ".json"))
+            return httpd_resp_set_type(req, "application/json");
+        else if (IS_FILE_EXT(filename, ".svg"))
+            return httpd_resp_set_type(req, "image/svg+xml");
+        else if (IS_FILE_EXT(filename, ".png"))
+            return httpd_resp_set_type(req, "image/png");
         else if (IS_FILE_EXT(filename, ".jpeg") || IS_FILE_EXT(filename, ".jpg"))
             return httpd_resp_set_type(req, "image/jpeg");
         else if (IS_FILE_EXT(filename, ".ico"))
@@ -142,6 +161,75 @@ esp_err_t set_content_type_from_file(httpd_req_t *req, const char *filename)
     return httpd_resp_set_type(req, "text/plain");
 }
 
+/* ETag for content embedded in flash, a FNV-1a hash of the content */
+void http_etag_from_data (http_etag_t etag, const unsigned char *data, size_t size)
+{
+    uint32_t hash = 2166136261UL;
+
+    while(size--) {
+        hash ^= *data++;
+        hash *= 16777619UL;
+    }
+
+    sprintf(etag, "\"%08x\"", (unsigned int)hash);
+}
+
+/* Adds the ETag and Cache-Control headers to the response, the client has to revalidate its copy
+ * on each load. If the copy is current responds with 304 Not Modified and returns true.
+ * NOTE: etag must stay valid until the response is sent. */
+bool http_not_modified (httpd_req_t *req, const char *etag)
+{
+    bool match = false;
+    size_t len = httpd_req_get_hdr_value_len(req, "If-None-Match");
+
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    if(len > 0 && len < sizeof(sbuf) && httpd_req_get_hdr_value_str(req, "If-None-Match", sbuf, sizeof(sbuf)) == ESP_OK)
+        match = strstr(sbuf, etag) != NULL || !strcmp(sbuf, "*");
+
+    if(match) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_send(req, NULL, 0);
+    }
+
+    return match;
+}
+
+static bool accepts_gzip (httpd_req_t *req)
+{
+    size_t len = httpd_req_get_hdr_value_len(req, "Accept-Encoding");
+
+    return len > 0 && len < sizeof(sbuf) &&
+            httpd_req_get_hdr_value_str(req, "Accept-Encoding", sbuf, sizeof(sbuf)) == ESP_OK &&
+             strstr(sbuf, "gzip") != NULL;
+}
+
+/* Appends .gz to the path if a gzipped sibling of the file exists and is to be served instead.
+ * It is served if the client accepts gzip encoding or if the file itself does not exist. */
+static bool use_gz_sibling (httpd_req_t *req, char *filepath, size_t destsize)
+{
+    struct stat st;
+    size_t len = strlen(filepath);
+
+    if(len < 4 || len + 4 > destsize || IS_FILE_EXT(filepath, ".gz"))
+        return false;
+
+    strcpy(filepath + len, ".gz");
+
+    if(stat(filepath, &st) == 0) {
+        filepath[len] = '\0';
+        if(accepts_gzip(req) || stat(filepath, &st) != 0) {
+            strcpy(filepath + len, ".gz");
+            return true;
+        }
+    }
+
+    filepath[len] = '\0';
+
+    return false;
+}
+
 // Fetch and decode value for query key
 char *http_get_key_value (char *qstring, char *key, char *val, size_t val_size)
 {
@@ -239,6 +327,8 @@ esp_err_t spiffs_get_handler (httpd_req_t *req)
 
     FILE *file;
     struct stat st;
+    http_etag_t etag;
+    bool gzipped = use_gz_sibling(req, filepath, sizeof(filepath));
 
     if (stat(filepath, &st) != 0) {
         /* If file not present on SPIFFS check if URI
@@ -252,16 +342,32 @@ esp_err_t spiffs_get_handler (httpd_req_t *req)
         return ESP_FAIL;
     }
 
+    /* ETag from modification time and size, SPIFFS does not keep modification times unless
+     * CONFIG_SPIFFS_USE_MTIME is set. The gzipped variant has its own ETag. */
+    sprintf(etag, "\"%lx-%lx%s\"", (unsigned long)st.st_mtime, (unsigned long)st.st_size, gzipped ? "-gz" : "");
+
+    if(gzipped)
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+    if(http_not_modified(req, etag))
+        return ESP_OK;
+
     if ((file = fopen(filepath, "r")) == NULL) {
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read existing file");
         return ESP_FAIL;
     }
 
+    if(gzipped) {
+        filepath[strlen(filepath) - 3] = '\0'; // Content type is set from the name of the uncompressed file.
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    }
+
     set_content_type_from_file(req, filename);
 
     size_t chunksize;
     char *chunk = ((file_server_data_t *)req->user_ctx)->scratch;
 
+    // Stream the file in scratch buffer sized chunks, an empty chunk terminates the response.
     do {
         chunksize = fread(chunk, sizeof(char), sizeof(fs_scratch_t), file);
 
@@ -275,7 +381,6 @@ esp_err_t spiffs_get_handler (httpd_req_t *req)
     } while (chunksize != 0);
 
     fclose(file);
-    httpd_resp_send_chunk(req, NULL, 0);
 
     return ESP_OK;
 }
@@ -455,7 +560,8 @@ static esp_err_t get_handler(httpd_req_t *req)
     struct stat st;
     strcat(strcpy(spiff_fs_data.scratch, spiff_fs_data.base_path), filename);
 
-    if (stat(spiff_fs_data.scratch, &st) == 0) {
+    if (stat(spiff_fs_data.scratch, &st) == 0 || (strlen(spiff_fs_data.scratch) + 4 <= sizeof(fs_scratch_t) &&
+                                                    stat(strcat(spiff_fs_data.scratch, ".gz"), &st) == 0)) {
         req->user_ctx = &spiff_fs_data;
         return spiffs_get_handler(req);
     }
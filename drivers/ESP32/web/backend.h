@@ -38,6 +38,7 @@ typedef char fs_path_t[ESP_VFS_PATH_MAX + 1];
 typedef char fs_filename_t[CONFIG_SPIFFS_OBJ_NAME_LEN + 1];
 typedef char fs_filepath_t[ESP_VFS_PATH_MAX + CONFIG_SPIFFS_OBJ_NAME_LEN + 1];
 typedef char fs_queryarg_t[100];
+typedef char http_etag_t[24];
 
 typedef struct {
     fs_path_t base_path;
@@ -47,6 +48,8 @@ typedef struct {
 bool httpdaemon_start(network_settings_t *network);
 void httpdaemon_stop();
 esp_err_t set_content_type_from_file(httpd_req_t *req, const char *filename);
+void http_etag_from_data (http_etag_t etag, const unsigned char *data, size_t size);
+bool http_not_modified (httpd_req_t *req, const char *etag);
 char *http_get_key_value (char *qstring, char *key, char *s, size_t val_size);
 
 #endif
@@ -28,6 +28,8 @@
 #include <string.h>
 #include <sys/unistd.h>
 
+#include "esp_timer.h"
+
 #include "driver.h"
 #include "upload.h"
 
@@ -40,6 +42,18 @@
 static struct multipartparser parser;
 static struct multipartparser_callbacks *sd_callbacks = NULL;
 
+#if SDCARD_CACHE_ENABLE
+
+static void cache_release (file_upload_t *upload, bool keep)
+{
+    if(upload->cache) {
+        sdcard_cache_release(keep ? upload->filename : NULL, upload->uploaded);
+        upload->cache = NULL;
+    }
+}
+
+#endif
+
 static void do_cleanup (file_upload_t *upload)
 {
     // close and unlink open file
@@ -53,6 +67,15 @@ static void do_cleanup (file_upload_t *upload)
         }
         upload->file.handle = NULL;
     }
+
+#if SDCARD_CACHE_ENABLE
+    cache_release(upload, false);
+#endif
+
+    if(upload->buffer) {
+        free(upload->buffer);
+        upload->buffer = NULL;
+    }
 }
 
 static void cleanup (void *upload)
@@ -62,6 +85,99 @@ static void cleanup (void *upload)
     free(upload);
 }
 
+// Writes are kept in whole clusters for FatFs, the chunk size is then cluster aligned.
+static size_t get_chunk_size (file_upload_t *upload)
+{
+    size_t size = UPLOAD_CHUNK_SIZE;
+
+    if(upload->to_fatfs) {
+        FATFS *fs = upload->file.fatfs_handle->obj.fs;
+#if FF_MAX_SS != FF_MIN_SS
+        size_t cluster = (size_t)fs->csize * fs->ssize;
+#else
+        size_t cluster = (size_t)fs->csize * FF_MAX_SS;
+#endif
+        if(cluster < size)
+            size = cluster;
+    }
+
+    return size;
+}
+
+static bool write_chunk (file_upload_t *upload, const char *data, size_t size)
+{
+    size_t count;
+    int64_t start = esp_timer_get_time();
+
+    if(upload->to_fatfs) {
+        UINT written;
+        if(f_write(upload->file.fatfs_handle, data, size, &written) != FR_OK)
+            written = 0;
+        count = written;
+    } else
+        count = fwrite(data, sizeof(char), size, upload->file.handle);
+
+    upload->write_time += esp_timer_get_time() - start;
+
+    return count == size;
+}
+
+// Writes whole chunks directly from the receive buffer, data that does not fill a chunk is buffered.
+static bool write_data (file_upload_t *upload, const char *data, size_t size)
+{
+    size_t count;
+
+    if(upload->buffered) {
+        count = upload->chunk_size - upload->buffered;
+        if(count > size)
+            count = size;
+        memcpy(upload->buffer + upload->buffered, data, count);
+        upload->buffered += count;
+        data += count;
+        size -= count;
+        if(upload->buffered == upload->chunk_size) {
+            upload->buffered = 0;
+            if(!write_chunk(upload, upload->buffer, upload->chunk_size))
+                return false;
+        }
+    }
+
+    if(size >= upload->chunk_size) {
+        count = size - size % upload->chunk_size;
+        if(!write_chunk(upload, data, count))
+            return false;
+        data += count;
+        size -= count;
+    }
+
+    if(size) {
+        memcpy(upload->buffer, data, size);
+        upload->buffered = size;
+    }
+
+    return true;
+}
+
+static bool write_flush (file_upload_t *upload)
+{
+    bool ok = upload->buffered == 0 || write_chunk(upload, upload->buffer, upload->buffered);
+
+    upload->buffered = 0;
+
+    return ok;
+}
+
+static void report_throughput (file_upload_t *upload)
+{
+    char msg[160];
+    uint32_t time = (uint32_t)((esp_timer_get_time() - upload->start) / 1000LL) + 1;
+
+    sprintf(msg, "[MSG:Upload %s, %u bytes in %u ms, %u bytes/s, %u ms writing]\r\n", upload->filename, (uint32_t)upload->uploaded, time,
+             (uint32_t)((uint64_t)upload->uploaded * 1000 / time), (uint32_t)(upload->write_time / 1000LL));
+
+    hal.stream.write(msg);
+}
+
 static int on_body_begin(struct multipartparser *parser)
 {
     return 0;
@@ -111,7 +227,19 @@ static void on_header_done(struct multipartparser *parser)
             }  else if((upload->file.handle = fopen(upload->filename, "w")))
                 upload->state = Upload_Write;
 
-            upload->uploaded = 0;
+            if(upload->state == Upload_Write) {
+                upload->chunk_size = get_chunk_size(upload);
+                if(upload->buffer == NULL && (upload->buffer = malloc(UPLOAD_CHUNK_SIZE)) == NULL)
+                    upload->state = Upload_Failed;
+#if SDCARD_CACHE_ENABLE
+                if(upload->to_fatfs && upload->cache == NULL)
+                    upload->cache = sdcard_cache_claim(&upload->cache_size);
+#endif
+            }
+
+            upload->uploaded = upload->buffered = 0;
+            upload->write_time = 0;
+            upload->start = esp_timer_get_time();
         }
     }
 
@@ -149,16 +277,18 @@ static int on_data(struct multipartparser *parser, const char* data, size_t size
     switch(upload->state) {
 
         case Upload_Write:
-            {
-                size_t count;
-                if(upload->to_fatfs) {
-                    f_write(upload->file.fatfs_handle, data, size, &count);
-                } else
-                    count = fwrite(data, sizeof(char), size, upload->file.handle);
-                if(count != size)
-                    upload->state = Upload_Failed;
-                upload->uploaded += count;
+#if SDCARD_CACHE_ENABLE
+            if(upload->cache) {
+                if(upload->uploaded + size <= upload->cache_size)
+                    memcpy(upload->cache + upload->uploaded, data, size);
+                else // File does not fit, it is streamed from the card when run
+                    cache_release(upload, false);
             }
+#endif
+            if(write_data(upload, data, size))
+                upload->uploaded += size;
+            else
+                upload->state = Upload_Failed;
             break;
 
         case Upload_GetPath:
@@ -183,13 +313,24 @@ static int on_part_end(struct multipartparser *parser)
     switch(upload->state) {
 
         case Upload_Write:
+            if(!write_flush(upload)) {
+                do_cleanup(upload);
+                break;
+            }
             if(upload->to_fatfs) {
                 f_close(upload->file.fatfs_handle);
                 upload->file.fatfs_handle = NULL;
+#if SDCARD_ENABLE
+                sdcard_dir_changed();
+#endif
             } else {
                 fclose(upload->file.handle);
                 upload->file.handle = NULL;
             }
+#if SDCARD_CACHE_ENABLE
+            cache_release(upload, true);
+#endif
+            report_throughput(upload);
             break;
 
         case Upload_Failed:
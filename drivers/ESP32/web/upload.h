@@ -29,6 +29,12 @@
 #include <esp_http_server.h>
 #include <esp_vfs_fat.h>
 
+// Maximum size of file writes, a power of 2. Writes are done in chunks of this size or of the
+// card cluster size if smaller, only the data that does not fill a chunk is copied.
+#ifndef UPLOAD_CHUNK_SIZE
+#define UPLOAD_CHUNK_SIZE 4096
+#endif
+
 typedef enum
 {
     Upload_Parsing = 0,
@@ -57,6 +63,15 @@ typedef struct {
     FIL fatfs_fd;
     size_t size;
     size_t uploaded;
+    char *buffer;           // Partial chunk to be written
+    size_t buffered;
+    size_t chunk_size;
+    int64_t start;          // Time of file open, us
+    int64_t write_time;     // Time spent writing to the file system, us
+#if SDCARD_CACHE_ENABLE
+    char *cache;            // Copy of the file kept in the SD card RAM file cache
+    size_t cache_size;
+#endif
 } file_upload_t;
 
 bool upload_start (httpd_req_t *req, const char* boundary, bool to_fatfs);
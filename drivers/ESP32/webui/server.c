@@ -377,6 +377,8 @@ esp_err_t webui_sdcard_handler (httpd_req_t *req)
                     sprintf(status, "Invalid action \"%s\" for %s!", action, filename);
                     break;
             }
+
+            sdcard_dir_changed();
         }
     }
 
@@ -1060,6 +1062,14 @@ esp_err_t webui_index_html_get_handler (httpd_req_t *req)
 {
     extern const unsigned char index_html_gz_start[] asm("_binary_index_html_gz_start");
     extern const unsigned char index_html_gz_end[]   asm("_binary_index_html_gz_end");
+    static http_etag_t etag = "";
+
+    if(*etag == '\0')
+        http_etag_from_data(etag, index_html_gz_start, index_html_gz_end - index_html_gz_start);
+
+    if(http_not_modified(req, etag))
+        return ESP_OK;
+
     set_content_type_from_file(req, "index.html");
     httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
     return httpd_resp_send(req, (const char *)index_html_gz_start, index_html_gz_end - index_html_gz_start);
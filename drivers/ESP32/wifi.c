@@ -56,6 +56,11 @@ const static int SCANNING_BIT = BIT1;
 const static int APSTA_BIT = BIT2;
 
 static network_services_t services = {0};
+#if UDP_TELEMETRY_ENABLE
+static bool telemetry = false;
+#else
+static const bool telemetry = false;
+#endif
 static wifi_config_t wifi_sta_config;
 static SemaphoreHandle_t aplist_mutex = NULL;
 static ap_list_t ap_list = {0};
@@ -109,18 +114,59 @@ bool wifi_dns_running (void)
     return services.dns == On;
 }
 
-static void lwIPHostTimerHandler (void *arg)
+/*
+  The network streams are served by a dedicated task running above the grbl task, it is woken by the
+  streams when data is received or a line of output is completed and otherwise every STREAM_POLL_INTERVAL
+  ms. The lwIP raw API is not thread safe so the task passes the poll to the lwIP thread, at most one
+  poll is pending at a time. Data is handed over to grbl by the single producer/single consumer stream
+  buffers, the grbl task thus never waits for the network and vice versa.
+*/
+
+static TaskHandle_t netTask = NULL;
+static volatile bool poll_pending = false;
+
+// Runs in the lwIP thread.
+static void streamsPoll (void *arg)
 {
+    poll_pending = false;
+
 #if TELNET_ENABLE
     if(services.telnet)
         TCPStreamPoll();
 #endif
 #if WEBSOCKET_ENABLE
-    if(services.telnet)
+    if(services.websocket)
         WsStreamPoll();
 #endif
-    if(services.mask)
-        sys_timeout(STREAM_POLL_INTERVAL, lwIPHostTimerHandler, NULL);
+#if UDP_TELEMETRY_ENABLE
+    if(telemetry)
+        UDPTelemetryPoll();
+#endif
+}
+
+static void vNetTask (void *arg)
+{
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(STREAM_POLL_INTERVAL));
+        if((services.mask || telemetry) && !poll_pending) {
+            poll_pending = true;
+            if(tcpip_callback_with_block(streamsPoll, NULL, 0) != ERR_OK)
+                poll_pending = false; // lwIP mailbox full, retry on next wakeup
+        }
+    }
+}
+
+// Called by the streams on activity, from the grbl task or the lwIP thread.
+void wifi_stream_notify (void)
+{
+    if(netTask)
+        xTaskNotifyGive(netTask);
+}
+
+static void start_stream_task (void)
+{
+    if(netTask == NULL)
+        xTaskCreate(vNetTask, "Net", 2048, NULL, NETWORK_TASK_PRIORITY, &netTask);
 }
 
 static void start_services (void)
@@ -130,7 +176,7 @@ static void start_services (void)
         TCPStreamInit();
         TCPStreamListen(network->telnet_port == 0 ? 23 : network->telnet_port);
         services.telnet = On;
-        sys_timeout(STREAM_POLL_INTERVAL, lwIPHostTimerHandler, NULL);
+        start_stream_task();
     }
 #endif
 #if WEBSOCKET_ENABLE
@@ -138,9 +184,13 @@ static void start_services (void)
         WsStreamInit();
         WsStreamListen(network->websocket_port == 0 ? 80 : network->websocket_port);
         services.websocket = On;
-        sys_timeout(STREAM_POLL_INTERVAL, lwIPHostTimerHandler, NULL);
+        start_stream_task();
     }
 #endif
+#if UDP_TELEMETRY_ENABLE
+    if(!telemetry && (telemetry = UDPTelemetryStart(UDP_TELEMETRY_GROUP, UDP_TELEMETRY_PORT, UDP_TELEMETRY_PERIOD)))
+        start_stream_task();
+#endif
 #if HTTP_ENABLE
     if(network->services.http && !services.http)
         services.http = httpdaemon_start(network);
@@ -163,6 +213,12 @@ static void stop_services (void)
 #endif
     if(services.dns)
         dns_server_stop();
+#if UDP_TELEMETRY_ENABLE
+    if(telemetry) {
+        UDPTelemetryStop();
+        telemetry = false;
+    }
+#endif
 
     services.mask = 0;
 }
@@ -27,7 +27,8 @@
 #include "driver.h"
 #include "esp_wifi.h"
 
-#define STREAM_POLL_INTERVAL 20 // Poll interval in milliseconds
+#define STREAM_POLL_INTERVAL 20 // Poll interval in milliseconds when there is no stream activity
+#define NETWORK_TASK_PRIORITY 1 // Above the grbl task, below the prep task and the lwIP thread
 
 typedef struct {
     uint16_t ap_num;
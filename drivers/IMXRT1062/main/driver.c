@@ -127,6 +127,18 @@ typedef struct {
     input_signal_t *signal[DEBOUNCE_QUEUE];
 } debounce_queue_t;
 
+#if PLANNER_BLOCKS
+DMAMEM static plan_block_t planner_buffer[PLANNER_BLOCKS];
+#ifdef PLANNER_SOA
+DMAMEM static float planner_profile[PLANNER_BLOCKS * 4];
+#endif
+#endif
+
+#if STEP_SEGMENTS
+static segment_t step_segments[STEP_SEGMENTS];
+static st_block_t st_blocks[STEP_SEGMENTS - 1];
+#endif
+
 typedef union {
     uint_fast8_t pins;
     struct {
@@ -146,6 +158,26 @@ typedef struct {
 static qei_t qei = {0};
 static debounce_queue_t debounce_queue = {0};
 
+#if INPUT_SCANNER
+
+// Limit and control inputs are sampled from the systick handler, one read of the data register per port.
+// A vertical counter debounces all pins of a port in parallel, a pin changes state when read at the new
+// level in four consecutive samples. Only changes to the active level are reported.
+typedef struct {
+    gpio_reg_t *reg;
+    uint32_t mask;          // Scanned pins
+    uint32_t limit;         // Limit pins
+    uint32_t invert;        // Active low pins
+    uint32_t state;         // Debounced pin levels
+    uint32_t cnt0;          // Vertical counter, bit 0
+    uint32_t cnt1;          // Vertical counter, bit 1
+} input_port_t;
+
+static input_port_t input_port[4] = {0};
+static volatile bool scan_limits = false;
+
+#endif
+
 // Standard inputs
 static gpio_t Reset, FeedHold, CycleStart, Probe, LimitX, LimitY, LimitZ;
 
@@ -233,13 +265,70 @@ static input_signal_t inputpin[] = {
 
 #define DIGITAL_OUT(gpio, on) { if(on) gpio.reg->DR_SET = gpio.bit; else gpio.reg->DR_CLEAR = gpio.bit; } 
 
+static stepdir_port_t step_port[N_AXIS], dir_port[N_AXIS];
+static uint_fast8_t n_step_ports = 0, n_dir_ports = 0;
+
 static bool pwmEnabled = false, IOInitDone = false, probe_invert = false;
 static axes_signals_t next_step_outbits;
 static spindle_pwm_t spindle_pwm;
 static delay_t grbl_delay = { .ms = 0, .callback = NULL };
+static periodic_t periodic = {0};
 
 static void spindle_set_speed (uint_fast16_t pwm_value);
 
+#if STEP_PULSE_TIMER
+
+// Layout of the registers of a QuadTimer channel, channels are 0x20 bytes apart.
+typedef struct {
+    volatile uint16_t COMP1;
+    volatile uint16_t COMP2;
+    volatile uint16_t CAPT;
+    volatile uint16_t LOAD;
+    volatile uint16_t HOLD;
+    volatile uint16_t CNTR;
+    volatile uint16_t CTRL;
+    volatile uint16_t SCTRL;
+    volatile uint16_t CMPLD1;
+    volatile uint16_t CMPLD2;
+    volatile uint16_t CSCTRL;
+    volatile uint16_t FILT;
+    volatile uint16_t DMA;
+    volatile uint16_t reserved[3];
+} qtimer_channel_t;
+
+typedef struct {
+    uint8_t pin;
+    volatile uint16_t *timer; // Channel 0 COMP1 register
+    volatile uint16_t *enable;
+    uint8_t channel;
+} step_timer_map_t;
+
+// Pins that can be muxed (ALT1) to a QuadTimer output, TMR4 is used for the pulse ISR.
+static const step_timer_map_t step_timer_map[] = {
+    { .pin = 10, .timer = &TMR1_COMP10, .enable = &TMR1_ENBL, .channel = 0 },
+    { .pin = 11, .timer = &TMR1_COMP10, .enable = &TMR1_ENBL, .channel = 2 },
+    { .pin = 14, .timer = &TMR3_COMP10, .enable = &TMR3_ENBL, .channel = 2 },
+    { .pin = 15, .timer = &TMR3_COMP10, .enable = &TMR3_ENBL, .channel = 3 },
+    { .pin = 18, .timer = &TMR3_COMP10, .enable = &TMR3_ENBL, .channel = 1 },
+    { .pin = 19, .timer = &TMR3_COMP10, .enable = &TMR3_ENBL, .channel = 0 }
+};
+
+static const uint8_t step_pin[N_AXIS] = {
+    X_STEP_PIN, Y_STEP_PIN, Z_STEP_PIN
+#ifdef A_AXIS
+  , A_STEP_PIN
+#endif
+#ifdef B_AXIS
+  , B_STEP_PIN
+#endif
+};
+
+static qtimer_channel_t *step_timer[N_AXIS] = {0};
+static const step_timer_map_t *step_timer_pin[N_AXIS] = {0};
+static bool step_timers_ok = false;
+
+#endif
+
 // Interrupt handler prototypes
 // Interrupt handlers needs to be registered, possibly by modifying a system specific startup file.
 // It is possible to relocate the interrupt dispatch table from flash to RAM and programatically attach handlers.
@@ -247,6 +336,9 @@ static void spindle_set_speed (uint_fast16_t pwm_value);
 // Also, if a MCU specific driver library is used this might have functions to programatically attach handlers.
 
 static void stepper_driver_isr (void);
+#ifdef ENABLE_STEP_TIMING
+static void stepper_timed_isr (void);
+#endif
 static void stepper_pulse_isr (void);
 static void stepper_pulse_isr_delayed (void);
 static void gpio_isr (void);
@@ -273,22 +365,41 @@ static void driver_delay_ms (uint32_t ms, void (*callback)(void))
     }
 }
 
+static void driver_periodic_ms (uint32_t ms, void (*callback)(void))
+{
+    periodic.callback = NULL;
+    periodic.ms = periodic.period = ms;
+
+    if(ms)
+        periodic.callback = callback;
+}
+
+static uint32_t getElapsedTicks (void)
+{
+    return millis();
+}
+
+#if defined(ENABLE_PERF_COUNTERS) || defined(ENABLE_MOTION_TRACE)
+static uint32_t getCycleCount (void)
+{
+    return ARM_DWT_CYCCNT;
+}
+#endif
+
 // Set stepper pulse output pins.
 // step_outbits.value (or step_outbits.mask) are: bit0 -> X, bit1 -> Y...
 // Individual step bits can be accessed by step_outbits.x, step_outbits.y, ...
+// Each port with step pins is updated by one write to its set and one to its clear register,
+// the values are looked up in tables built by stepdirMapInit(). Inversion is applied by the tables.
 inline static void set_step_outputs (axes_signals_t step_outbits)
 {
-    step_outbits.value ^= settings.steppers.step_invert.mask;
+    uint_fast8_t idx = n_step_ports;
 
-    DIGITAL_OUT(stepX, step_outbits.x);
-    DIGITAL_OUT(stepY, step_outbits.y);
-    DIGITAL_OUT(stepZ, step_outbits.z);
-#ifdef A_AXIS
-    DIGITAL_OUT(stepA, step_outbits.a);
-#endif
-#ifdef B_AXIS
-    DIGITAL_OUT(stepB, step_outbits.b);
-#endif
+    while(idx) {
+        idx--;
+        ((gpio_reg_t *)step_port[idx].port)->DR_SET = step_port[idx].set[step_outbits.value];
+        ((gpio_reg_t *)step_port[idx].port)->DR_CLEAR = step_port[idx].reset[step_outbits.value];
+    }
 }
 
 // Set stepper direction ouput pins.
@@ -296,17 +407,52 @@ inline static void set_step_outputs (axes_signals_t step_outbits)
 // Individual direction bits can be accessed by dir_outbits.x, dir_outbits.y, ...
 inline static void set_dir_outputs (axes_signals_t dir_outbits)
 {
-    dir_outbits.value ^= settings.steppers.dir_invert.mask;
+    uint_fast8_t idx = n_dir_ports;
 
-    DIGITAL_OUT(dirX, dir_outbits.x);
-    DIGITAL_OUT(dirY, dir_outbits.y);
-    DIGITAL_OUT(dirZ, dir_outbits.z);
+    while(idx) {
+        idx--;
+        ((gpio_reg_t *)dir_port[idx].port)->DR_SET = dir_port[idx].set[dir_outbits.value];
+        ((gpio_reg_t *)dir_port[idx].port)->DR_CLEAR = dir_port[idx].reset[dir_outbits.value];
+    }
+}
+
+// Build the step and direction output tables, the pins must be configured first.
+static void stepdirMapInit (settings_t *settings)
+{
+    static gpio_t *const step_gpio[N_AXIS] = {
+        &stepX, &stepY, &stepZ
 #ifdef A_AXIS
-    DIGITAL_OUT(dirA, dir_outbits.a);
+      , &stepA
 #endif
 #ifdef B_AXIS
-    DIGITAL_OUT(dirB, dir_outbits.b);
+      , &stepB
+#endif
+    };
+    static gpio_t *const dir_gpio[N_AXIS] = {
+        &dirX, &dirY, &dirZ
+#ifdef A_AXIS
+      , &dirA
 #endif
+#ifdef B_AXIS
+      , &dirB
+#endif
+    };
+
+    stepdir_pin_t step[N_AXIS], dir[N_AXIS];
+    uint_fast8_t idx = N_AXIS;
+
+    do {
+        idx--;
+        step[idx].axis = dir[idx].axis = idx;
+        step[idx].port = step_gpio[idx]->reg;
+        step[idx].bit = step_gpio[idx]->bit;
+        dir[idx].port = dir_gpio[idx]->reg;
+        dir[idx].bit = dir_gpio[idx]->bit;
+    } while(idx);
+
+    n_step_ports = n_dir_ports = 0; // Stop updates while the tables are rebuilt
+    n_step_ports = stepdir_map_init(step_port, N_AXIS, step, N_AXIS, settings->steppers.step_invert);
+    n_dir_ports = stepdir_map_init(dir_port, N_AXIS, dir, N_AXIS, settings->steppers.dir_invert);
 }
 
 // Enable steppers.
@@ -368,6 +514,49 @@ static void stepperCyclesPerTick (uint32_t cycles_per_tick)
     PIT_TCTRL0 |= PIT_TCTRL_TEN;
 }
 
+#ifdef ENABLE_STEP_TIMING
+
+// The timed step executor uses GPT1 instead of the PIT. GPT1 is free running from the same 24 MHz clock
+// and the compare value is advanced by the time to the next interrupt, interrupt latency and the time
+// spent in the interrupt handler thus do not add to the step intervals.
+#define GPT_MIN_CYCLES 24 // 1 us, the next interrupt is delayed by this if its time has passed
+
+// Starts stepper driver timer and forces a stepper driver interrupt callback.
+static void stepperWakeUpTimed (void)
+{
+    // Enable stepper drivers.
+    stepperEnable((axes_signals_t){AXES_BITMASK});
+
+    GPT1_OCR1 = GPT1_CNT + 5000;
+    GPT1_SR = GPT_SR_OF1;
+    GPT1_IR = GPT_IR_OF1IE;
+}
+
+// Disables stepper driver interrupts and reset outputs.
+static void stepperGoIdleTimed (bool clear_signals)
+{
+    GPT1_IR = 0;
+
+    if(clear_signals) {
+        set_step_outputs((axes_signals_t){0});
+        set_dir_outputs((axes_signals_t){0});
+    }
+}
+
+// Sets up the time to the next stepper driver interrupt from the current one.
+// Called on each interrupt by the timed step executor.
+static void stepperCyclesPerTickTimed (uint32_t cycles_per_tick)
+{
+    uint32_t ocr = GPT1_OCR1 + (cycles_per_tick < (1UL << 20) ? cycles_per_tick : 0x000FFFFFUL);
+
+    if((int32_t)(ocr - GPT1_CNT) < GPT_MIN_CYCLES)
+        ocr = GPT1_CNT + GPT_MIN_CYCLES;
+
+    GPT1_OCR1 = ocr;
+}
+
+#endif
+
 // Start a stepper pulse, no delay version
 // stepper_t struct is defined in grbl/stepper.h
 static void stepperPulseStart (stepper_t *stepper)
@@ -398,11 +587,80 @@ static void stepperPulseStartDelayed (stepper_t *stepper)
     }
 }
 
+#if STEP_PULSE_TIMER
+
+// Start a stepper pulse, QuadTimer version.
+// The timers output the pulse, including the delay, so no interrupt is needed to end it.
+static void stepperPulseStartTimer (stepper_t *stepper)
+{
+    if(stepper->new_block) {
+        stepper->new_block = false;
+        set_dir_outputs(stepper->dir_outbits);
+    }
+
+    if(stepper->step_outbits.value) {
+        uint_fast8_t idx = N_AXIS;
+        do {
+            if(stepper->step_outbits.value & bit(--idx))
+                step_timer[idx]->CTRL |= TMR_CTRL_CM(0b001);
+        } while(idx);
+    }
+}
+
+// Map step pins to QuadTimer channels, returns false if any pin is not a QuadTimer output.
+static bool stepTimersInit (void)
+{
+    uint_fast8_t idx = N_AXIS, i;
+
+    do {
+        idx--;
+        step_timer_pin[idx] = NULL;
+        i = sizeof(step_timer_map) / sizeof(step_timer_map_t);
+        do {
+            if(step_timer_map[--i].pin == step_pin[idx])
+                step_timer_pin[idx] = &step_timer_map[i];
+        } while(i && step_timer_pin[idx] == NULL);
+        if(step_timer_pin[idx] == NULL)
+            return false;
+        step_timer[idx] = (qtimer_channel_t *)step_timer_pin[idx]->timer + step_timer_pin[idx]->channel;
+    } while(idx);
+
+    return true;
+}
+
+// Set pulse delay and length, the output toggles at the COMP1 and COMP2 matches and then the timer stops.
+static void stepTimersConfig (settings_t *settings)
+{
+    uint_fast8_t idx = N_AXIS;
+    uint16_t delay = (uint16_t)(F_BUS_MHZ * settings->steppers.pulse_delay_microseconds);
+
+    do {
+        idx--;
+        *step_timer_pin[idx]->enable &= ~(1 << step_timer_pin[idx]->channel);
+        step_timer[idx]->CTRL = 0;
+        step_timer[idx]->CNTR = 0;
+        step_timer[idx]->LOAD = 0;
+        step_timer[idx]->COMP1 = delay ? delay : 1;
+        step_timer[idx]->COMP2 = (uint16_t)(F_BUS_MHZ * settings->steppers.pulse_microseconds);
+        step_timer[idx]->CSCTRL = 0;
+        step_timer[idx]->SCTRL = TMR_SCTRL_OEN | (settings->steppers.step_invert.mask & bit(idx) ? TMR_SCTRL_OPS : 0);
+        step_timer[idx]->SCTRL |= TMR_SCTRL_FORCE;
+        step_timer[idx]->CTRL = TMR_CTRL_PCS(0b1000) | TMR_CTRL_ONCE | TMR_CTRL_LENGTH | TMR_CTRL_OUTMODE(0b100);
+        *step_timer_pin[idx]->enable |= 1 << step_timer_pin[idx]->channel;
+        *(portConfigRegister(step_pin[idx])) = 1; // Mux pin to timer output
+    } while(idx);
+}
+
+#endif
+
 // Enable/disable limit pins interrupt.
 // NOTE: the homing parameter is indended for configuring advanced
 //        stepper drivers for sensorless homing.
 static void limitsEnable (bool on, bool homing)
 {
+#if INPUT_SCANNER
+    scan_limits = on && settings.limits.flags.hard_enabled;
+#else
     uint32_t i = sizeof(inputpin) / sizeof(input_signal_t);
 
     on &= settings.limits.flags.hard_enabled;
@@ -416,6 +674,7 @@ static void limitsEnable (bool on, bool homing)
                 inputpin[i].gpio.reg->IMR &= ~inputpin[i].gpio.bit; // Disable interrupt.
         } 
     } while(i);
+#endif
 }
 
 // Returns limit state as an axes_signals_t bitmap variable.
@@ -679,6 +938,8 @@ static void settings_changed (settings_t *settings)
 {
     if(IOInitDone) {
 
+        stepdirMapInit(settings);
+
         stepperEnable(settings->steppers.deenergize);
 
         if(hal.driver_cap.variable_spindle && spindle_precompute_pwm_values(&spindle_pwm, F_BUS_ACTUAL / 2)) {
@@ -697,6 +958,12 @@ static void settings_changed (settings_t *settings)
         // When the stepper pulse is delayed either two timers or a timer that supports multiple
         // compare registers is required.
         TMR4_CSCTRL0 &= ~(TMR_CSCTRL_TCF1|TMR_CSCTRL_TCF2);
+#if STEP_PULSE_TIMER
+        if(step_timers_ok) {
+            stepTimersConfig(settings);
+            hal.stepper_pulse_start = stepperPulseStartTimer;
+        } else
+#endif
         if(settings->steppers.pulse_delay_microseconds) {
             TMR4_COMP10 = F_BUS_MHZ * settings->steppers.pulse_delay_microseconds;
             TMR4_COMP20 = F_BUS_MHZ * settings->steppers.pulse_microseconds;
@@ -728,6 +995,11 @@ static void settings_changed (settings_t *settings)
 
         NVIC_DISABLE_IRQ(IRQ_GPIO6789);
 
+#if INPUT_SCANNER
+        __disable_irq();
+        memset(input_port, 0, sizeof(input_port));
+#endif
+
         do {
 
             pullup = true;
@@ -867,7 +1139,19 @@ static void settings_changed (settings_t *settings)
 
                 signal->gpio.reg->ISR = signal->gpio.bit;       // Clear interrupt.
 
+#if INPUT_SCANNER
+                if(signal->group & (INPUT_GROUP_LIMIT|INPUT_GROUP_CONTROL)) {
+                    input_port_t *port = &input_port[signal->offset];
+                    port->reg = signal->gpio.reg;
+                    port->mask |= signal->gpio.bit;
+                    if(signal->group == INPUT_GROUP_LIMIT)
+                        port->limit |= signal->gpio.bit;
+                    if(signal->irq_mode == IRQ_Mode_Falling)
+                        port->invert |= signal->gpio.bit;
+                } else
+#else
                 if(signal->group != INPUT_GROUP_LIMIT)          // If pin is not a limit pin
+#endif
                     signal->gpio.reg->IMR |= signal->gpio.bit;  // enable interrupt
 
                 signal->active = (signal->gpio.reg->DR & signal->gpio.bit) != 0;
@@ -877,6 +1161,17 @@ static void settings_changed (settings_t *settings)
             }
         } while(i);
 
+#if INPUT_SCANNER
+        i = sizeof(input_port) / sizeof(input_port_t);
+        do {
+            if(input_port[--i].mask) {
+                input_port[i].state = input_port[i].reg->DR & input_port[i].mask;
+                input_port[i].cnt0 = input_port[i].cnt1 = ~0;
+            }
+        } while(i);
+        __enable_irq();
+#endif
+
         NVIC_ENABLE_IRQ(IRQ_GPIO6789);
     }
 }
@@ -912,6 +1207,19 @@ static bool driver_setup (settings_t *settings)
 	NVIC_SET_PRIORITY(IRQ_PIT, 2);
 	NVIC_ENABLE_IRQ(IRQ_PIT);
 
+#ifdef ENABLE_STEP_TIMING
+    CCM_CCGR1 |= CCM_CCGR1_GPT1_BUS(CCM_CCGR_ON)|CCM_CCGR1_GPT1_SERIAL(CCM_CCGR_ON);
+    GPT1_CR = 0;
+    GPT1_PR = 0;
+    GPT1_SR = 0x3F;
+    GPT1_IR = 0;
+    GPT1_CR = GPT_CR_CLKSRC(2)|GPT_CR_FRR|GPT_CR_ENMOD|GPT_CR_EN; // Free running from the PERCLK (24 MHz) as the PIT
+
+	attachInterruptVector(IRQ_GPT1, stepper_timed_isr);
+	NVIC_SET_PRIORITY(IRQ_GPT1, 2);
+	NVIC_ENABLE_IRQ(IRQ_GPT1);
+#endif
+
     TMR4_ENBL = 0;
     TMR4_LOAD0 = 0;
     TMR4_CTRL0 = TMR_CTRL_PCS(0b1000) | TMR_CTRL_ONCE | TMR_CTRL_LENGTH;
@@ -923,6 +1231,10 @@ static bool driver_setup (settings_t *settings)
 
     TMR4_ENBL = 1;
 
+#if STEP_PULSE_TIMER
+    step_timers_ok = stepTimersInit();
+#endif
+
     pinModeOutput(&stepX, X_STEP_PIN);
     pinModeOutput(&stepY, Y_STEP_PIN);
     pinModeOutput(&stepZ, Z_STEP_PIN);
@@ -1012,7 +1324,7 @@ static bool driver_setup (settings_t *settings)
 
   // Set defaults
 
-    IOInitDone = settings->version == 16;
+    IOInitDone = settings->version == 17;
 
     settings_changed(settings);
 
@@ -1115,13 +1427,45 @@ bool driver_init (void)
     hal.driver_setup = driver_setup;
     hal.f_step_timer = 24000000;
     hal.rx_buffer_size = RX_BUFFER_SIZE;
+#if PLANNER_BLOCKS
+    hal.planner_buffer.blocks = planner_buffer;
+    hal.planner_buffer.size = PLANNER_BLOCKS;
+#ifdef PLANNER_SOA
+    hal.planner_buffer.profile = planner_profile;
+#endif
+#endif
+#if STEP_SEGMENTS
+    hal.segment_buffer.segments = step_segments;
+    hal.segment_buffer.st_blocks = st_blocks;
+    hal.segment_buffer.size = STEP_SEGMENTS;
+#endif
     hal.delay_ms = driver_delay_ms;
+    hal.periodic_ms = driver_periodic_ms;
+    hal.get_elapsed_ticks = getElapsedTicks;
+#ifdef ENABLE_MEMORY_USAGE
+    // The stack occupies the DTCM above .bss.
+    extern unsigned long _ebss, _estack;
+    hal.stack.base = (uint8_t *)&_ebss;
+    hal.stack.size = (uint8_t *)&_estack - (uint8_t *)&_ebss;
+#endif
+#if defined(ENABLE_PERF_COUNTERS) || defined(ENABLE_MOTION_TRACE)
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+    hal.f_cycle_counter = F_CPU_ACTUAL;
+    hal.get_cycle_count = getCycleCount;
+#endif
     hal.settings_changed = settings_changed;
 
+#ifdef ENABLE_STEP_TIMING
+    hal.stepper_wake_up = stepperWakeUpTimed;
+    hal.stepper_go_idle = stepperGoIdleTimed;
+    hal.stepper_cycles_per_tick = stepperCyclesPerTickTimed;
+#else
     hal.stepper_wake_up = stepperWakeUp;
     hal.stepper_go_idle = stepperGoIdle;
-    hal.stepper_enable = stepperEnable;
     hal.stepper_cycles_per_tick = stepperCyclesPerTick;
+#endif
+    hal.stepper_enable = stepperEnable;
     hal.stepper_pulse_start = stepperPulseStart;
 
     hal.limits_enable = limitsEnable;
@@ -1147,7 +1491,12 @@ bool driver_init (void)
 #if USB_SERIAL_GRBL
     usb_serialInit();
     hal.stream.read = usb_serialGetC;
+  #if USB_SERIAL_GRBL == 2
+    hal.stream.read_block = usb_serialReadBlock;
+    hal.stream.write_n = usb_serialWriteN;
+  #endif
     hal.stream.get_rx_buffer_available = usb_serialRxFree;
+    hal.stream.get_tx_buffer_available = usb_serialTxFree;
     hal.stream.reset_read_buffer = usb_serialRxFlush;
     hal.stream.cancel_read_buffer = usb_serialRxCancel;
     hal.stream.write = usb_serialWriteS;
@@ -1156,9 +1505,12 @@ bool driver_init (void)
 #else
     serialInit();
     hal.stream.read = serialGetC;
+    hal.stream.read_block = serialReadBlock;
     hal.stream.write = serialWriteS;
+    hal.stream.write_n = serialWriteN;
     hal.stream.write_all = serialWriteS;
     hal.stream.get_rx_buffer_available = serialRxFree;
+    hal.stream.get_tx_buffer_available = serialTxFree;
     hal.stream.reset_read_buffer = serialRxFlush;
     hal.stream.cancel_read_buffer = serialRxCancel;
     hal.stream.suspend_read = serialSuspendInput;
@@ -1171,6 +1523,7 @@ bool driver_init (void)
     hal.eeprom.put_byte = eepromPutByte;
     hal.eeprom.memcpy_to_with_checksum = eepromWriteBlockWithChecksum;
     hal.eeprom.memcpy_from_with_checksum = eepromReadBlockWithChecksum;
+    hal.eeprom.memcpy_from = eepromReadBlock;
 #else // use Arduino emulated EEPROM in flash
     eeprom_initialize();
     hal.eeprom.type = EEPROM_Emulated;
@@ -1212,14 +1565,17 @@ bool driver_init (void)
 #endif
     hal.driver_cap.software_debounce = On;
     hal.driver_cap.step_pulse_delay = On;
-    hal.driver_cap.amass_level = 3;
+    hal.driver_cap.amass_level = 7; // 32 bit PIT timer, up to 7 levels may be configured by MAX_AMASS_LEVEL
+#ifdef ENABLE_STEP_TIMING
+    hal.driver_cap.step_timing = On; // GPT1 compare value advanced by stepperCyclesPerTickTimed()
+#endif
     hal.driver_cap.control_pull_up = On;
     hal.driver_cap.limits_pull_up = On;
     hal.driver_cap.probe_pull_up = On;
 
     // No need to move version check before init.
     // Compiler will fail any signature mismatch for existing entries.
-    return hal.version == 6;
+    return hal.version == 7;
 }
 
 /* interrupt handlers */
@@ -1233,6 +1589,19 @@ static void stepper_driver_isr (void)
     }
 }
 
+#ifdef ENABLE_STEP_TIMING
+
+// Main stepper driver, timed step executor version.
+static void stepper_timed_isr (void)
+{
+    if(GPT1_SR & GPT_SR_OF1) {
+        GPT1_SR = GPT_SR_OF1;
+        hal.stepper_interrupt_callback();
+    }
+}
+
+#endif
+
 /* The Stepper Port Reset Interrupt: This interrupt handles the falling edge of the step
    pulse. This should always trigger before the next general stepper driver interrupt and independently
    finish, if stepper driver interrupts is disabled after completing a move.
@@ -1321,6 +1690,40 @@ static void debounce_isr (void)
 
 }
 
+#if INPUT_SCANNER
+
+static void input_scan (void)
+{
+    uint8_t grp = 0;
+    uint32_t delta, i = sizeof(input_port) / sizeof(input_port_t);
+    input_port_t *port;
+
+    do {
+        port = &input_port[--i];
+        if(port->mask) {
+            delta = (port->reg->DR & port->mask) ^ port->state;
+            port->cnt0 = ~(port->cnt0 & delta);
+            port->cnt1 = port->cnt0 ^ (port->cnt1 & delta);
+            delta &= port->cnt0 & port->cnt1;       // Pins read at the new level four times in a row
+            port->state ^= delta;
+            if((delta &= port->state ^ port->invert)) {
+                if(delta & port->limit)
+                    grp |= INPUT_GROUP_LIMIT;
+                if(delta & ~port->limit)
+                    grp |= INPUT_GROUP_CONTROL;
+            }
+        }
+    } while(i);
+
+    if((grp & INPUT_GROUP_LIMIT) && scan_limits)
+        hal.limit_interrupt_callback(limitsGetState());
+
+    if(grp & INPUT_GROUP_CONTROL)
+        hal.control_interrupt_callback(systemGetState());
+}
+
+#endif
+
   //GPIO intr process
 static void gpio_isr (void)
 {
@@ -1471,10 +1874,19 @@ static void systick_isr (void)
     }
 #endif
 
+#if INPUT_SCANNER
+    input_scan();
+#endif
+
     if(grbl_delay.ms && !(--grbl_delay.ms)) {
         if(grbl_delay.callback) {
             grbl_delay.callback();
             grbl_delay.callback = NULL;
         }
     }
+
+    if(periodic.callback && !(--periodic.ms)) {
+        periodic.ms = periodic.period;
+        periodic.callback();
+    }
 }
@@ -37,6 +37,8 @@
 #define USB_SERIAL_GRBL    2 // Set to 1 for Arduino class library, 2 for PJRC C library.
 #define USB_SERIAL_WAIT    0 // Wait for USB connection before starting grblHAL.
 #define QEI_ENABLE         0 // Enable quadrature encoder interface. NOTE: requires encoder plugin.
+#define STEP_PULSE_TIMER   0 // Generate step pulses by QuadTimer hardware. NOTE: all step pins must be QuadTimer outputs, 10, 11, 14, 15, 18 or 19.
+#define INPUT_SCANNER      0 // Sample limit and control inputs every ms and debounce them over 4 samples instead of using pin interrupts.
 
 #if COMPATIBILITY_LEVEL <= 1
 #define ESTOP_ENABLE       1 // When enabled only real-time report requests will be executed when the reset pin is asserted.
@@ -44,6 +46,8 @@
 #define ESTOP_ENABLE       0 // Do not change!
 #endif
 #define CNC_BOOSTERPACK    0 // Do not change!
+#define PLANNER_BLOCKS   256 // Number of planner blocks, placed in RAM2 (OCRAM). Set to 0 to use the grbl default buffer.
+#define STEP_SEGMENTS     32 // Number of step segments. Set to 0 to use the grbl default buffer.
 
 // NOTE: none of these extensions are available, TBC!
 #if CNC_BOOSTERPACK
@@ -16,8 +16,6 @@
 
 #include "i2c.h"
 
-#define i2cIsBusy (!(i2c.state == I2CState_Idle || i2c.state == I2CState_Error) || (port->MSR & (LPI2C_MSR_BBF|LPI2C_MSR_MBF)))
-
 // Timeout if a device stretches SCL this long, in microseconds
 #define CLOCK_STRETCH_TIMEOUT 15000
 #define PINCONFIG (IOMUXC_PAD_ODE | IOMUXC_PAD_SRE | IOMUXC_PAD_DSE(4) | IOMUXC_PAD_SPEED(1) | IOMUXC_PAD_PKE | IOMUXC_PAD_PUE | IOMUXC_PAD_PUS(3))
@@ -172,12 +170,18 @@ typedef struct {
     volatile uint8_t acount;
     uint8_t *data;
     uint8_t regaddr[2];
-#if KEYPAD_ENABLE
-    keycode_callback_ptr keycode_callback;
-#endif
     uint8_t buffer[8];
 } i2c_trans_t;
 
+// Transactions are queued and executed in order by the interrupt handler, the next is started when the
+// previous has completed with a stop condition.
+static struct {
+    i2c_request_t *request[I2C_QUEUE_SIZE];
+    volatile uint_fast8_t head;
+    volatile uint_fast8_t tail;
+    i2c_request_t *volatile current;
+} queue = {0};
+
 static i2c_trans_t i2c;
 static uint8_t tx_fifo_size;
 static i2c_hardware_t *hardware;
@@ -233,83 +237,191 @@ void i2c_init (void)
     }
 }
 
-// get bytes (max 8 if local buffer, else max 255), waits for result
-uint8_t *I2C_Receive (uint32_t i2cAddr, uint8_t *buf, uint8_t bytes, bool block)
+// Starts a transaction, called with interrupts disabled or from the interrupt handler.
+static void I2C_Start (i2c_request_t *request)
 {
-    i2c.data  = buf ? buf : i2c.buffer;
-    i2c.count = bytes;
+    i2c.addr   = request->address;
+    i2c.count  = request->count;
     i2c.rcount = 0;
-    i2c.state = bytes == 1 ? I2CState_ReceiveLast : (bytes == 2 ? I2CState_ReceiveNextToLast : I2CState_ReceiveNext);
+    i2c.acount = request->acount;
+    i2c.data   = request->data;
+    memcpy(i2c.regaddr, request->regaddr, sizeof(i2c.regaddr));
+
+    port->MSR = LPI2C_MSR_SDF|LPI2C_MSR_NDF|LPI2C_MSR_ALF|LPI2C_MSR_EPF; // Clear flags left from the previous transaction
+
+    if(request->acount) { // Register read: send register address then restart for the read
+        i2c.state = I2CState_SendAddr;
+        port->MTDR = LPI2C_MTDR_CMD_START | (i2c.addr << 1);
+        port->MIER = LPI2C_MIER_NDIE|LPI2C_MIER_TDIE;
+    } else if(request->read) {
+        i2c.state = i2c.count == 1 ? I2CState_ReceiveLast : (i2c.count == 2 ? I2CState_ReceiveNextToLast : I2CState_ReceiveNext);
+        port->MTDR = LPI2C_MTDR_CMD_START | (i2c.addr << 1) | 1;
+        port->MTDR = LPI2C_MTDR_CMD_RECEIVE | ((uint32_t)i2c.count - 1);
+        port->MIER = LPI2C_MIER_NDIE|LPI2C_MIER_RDIE;
+    } else {
+        port->MTDR = LPI2C_MTDR_CMD_START | (i2c.addr << 1);
+        while(i2c.count && (port->MFSR & 0b111) < tx_fifo_size) {
+            port->MTDR = LPI2C_MTDR_CMD_TRANSMIT | (uint32_t)(*i2c.data++);
+            i2c.count--;
+        }
+        i2c.state = i2c.count == 0 ? I2CState_AwaitCompletion : (i2c.count == 1 ? I2CState_SendLast : I2CState_SendNext);
+        port->MIER = LPI2C_MIER_NDIE|LPI2C_MIER_TDIE;
+    }
+}
+
+// Starts the next queued transaction if any, called with interrupts disabled or from the interrupt handler.
+static void I2C_Next (void)
+{
+    if(queue.tail != queue.head) {
+        queue.current = queue.request[queue.tail];
+        queue.tail = (queue.tail + 1) % I2C_QUEUE_SIZE;
+        I2C_Start(queue.current);
+    } else
+        queue.current = NULL;
+}
 
-    port->MSR = 0;
-    port->MTDR = LPI2C_MTDR_CMD_START | (i2cAddr << 1) | 1;
-    port->MTDR = LPI2C_MTDR_CMD_RECEIVE | ((uint32_t)i2c.count - 1);
-    port->MIER = LPI2C_MIER_NDIE|LPI2C_MIER_RDIE;
+// Completes the current transaction and starts the next, the callback may queue a new transaction.
+static void I2C_Complete (void)
+{
+    i2c_request_t *request = queue.current;
 
-    if(block)
-        while(i2cIsBusy);
+    port->MIER = 0;
+    request->ok = i2c.state != I2CState_Error;
+    i2c.state = I2CState_Idle;
+    request->done = true;
 
-    return i2c.buffer;
+    I2C_Next();
+
+    if(request->callback)
+        request->callback(request);
 }
 
-void I2C_Send (uint32_t i2cAddr, uint8_t *buf, uint8_t bytes, bool block)
+// Queues a transaction, it is started at once if the bus is idle. Returns false if the queue is full.
+// May be called from interrupt context, the callback is called from the I2C interrupt on completion.
+bool i2c_transfer (i2c_request_t *request)
 {
-    i2c.count = bytes;
-    i2c.data  = buf ? buf : i2c.buffer;
+    bool ok;
 
-    port->MSR = 0;
-    port->MTDR = LPI2C_MTDR_CMD_START | (i2cAddr << 1);
+    __disable_irq();
 
-    while(i2c.count && (port->MFSR & 0b111) < tx_fifo_size) {
-        port->MTDR = LPI2C_MTDR_CMD_TRANSMIT | (uint32_t)(*i2c.data++);
-        i2c.count--;
+    uint_fast8_t next = (queue.head + 1) % I2C_QUEUE_SIZE;
+
+    if((ok = next != queue.tail)) {
+        request->done = false;
+        queue.request[queue.head] = request;
+        queue.head = next;
+        if(queue.current == NULL)
+            I2C_Next();
     }
 
-    port->MIER = LPI2C_MIER_NDIE|LPI2C_MIER_TDIE;
+    __enable_irq();
+
+    return ok;
+}
+
+// Queues a transaction and waits for it to complete, returns false on NACK or bus error.
+// NOTE: Must not be called from interrupt context.
+static bool i2c_transfer_wait (i2c_request_t *request)
+{
+    while(!i2c_transfer(request));
+    while(!request->done);
+
+    return request->ok;
+}
+
+// get bytes (max 8 if local buffer, else max 255), waits for result if block is true
+uint8_t *I2C_Receive (uint32_t i2cAddr, uint8_t *buf, uint8_t bytes, bool block)
+{
+    static i2c_request_t request = { .read = true, .done = true };
+
+    while(!request.done);
+
+    request.address = i2cAddr;
+    request.count = bytes;
+    request.data = buf ? buf : i2c.buffer;
+
+    if(block)
+        i2c_transfer_wait(&request);
+    else
+        i2c_transfer(&request);
+
+    return request.data;
+}
+
+void I2C_Send (uint32_t i2cAddr, uint8_t *buf, uint8_t bytes, bool block)
+{
+    static i2c_request_t request = { .done = true };
 
-    i2c.state = i2c.count == 0 ? I2CState_AwaitCompletion : (i2c.count == 1 ? I2CState_SendLast : I2CState_SendNext);
+    while(!request.done);
+
+    request.address = i2cAddr;
+    request.count = bytes;
+    request.data = buf ? buf : i2c.buffer;
 
     if(block)
-        while(i2cIsBusy);
+        i2c_transfer_wait(&request);
+    else
+        i2c_transfer(&request);
 }
 
+// Reads bytes from the register addressed by the first abytes of buf, or of the local buffer if buf is NULL.
+// The register address is sent last byte first.
 uint8_t *I2C_ReadRegister (uint32_t i2cAddr, uint8_t *buf, uint8_t abytes, uint8_t bytes, bool block)
 {
-    while(i2cIsBusy);
+    static i2c_request_t request = { .read = true, .done = true };
 
-    i2c.addr   = i2cAddr;
-    i2c.count  = bytes;
-    i2c.rcount = 0;
-    i2c.acount = abytes;
-    i2c.data   = buf ? buf : i2c.buffer;
-    i2c.state  = I2CState_SendAddr;
+    while(!request.done);
 
-    port->MSR = 0;
-    port->MTDR = LPI2C_MTDR_CMD_START | (i2cAddr << 1);
-    port->MIER = LPI2C_MIER_NDIE|LPI2C_MIER_TDIE;
+    request.address = i2cAddr;
+    request.acount = abytes;
+    request.count = bytes;
+    request.data = buf ? buf : i2c.buffer;
+    memcpy(request.regaddr, request.data, abytes);
 
     if(block)
-        while(i2cIsBusy);
+        i2c_transfer_wait(&request);
+    else
+        i2c_transfer(&request);
 
-    return i2c.buffer;
+    return request.data;
 }
 
 #if EEPROM_ENABLE
 
+// Max number of times to address the EEPROM while it completes a write cycle, takes ~100 us each at 100 kHz.
+#define EEPROM_ACK_POLL_RETRIES 100
+
+// Acknowledge polling: the EEPROM does not respond to its address until a write cycle is completed.
+static void eeprom_wait_ready (uint32_t i2cAddr)
+{
+    uint_fast8_t retries = EEPROM_ACK_POLL_RETRIES;
+    i2c_request_t request = { .address = i2cAddr };
+
+    while(!i2c_transfer_wait(&request) && --retries);
+}
+
 void i2c_eeprom_transfer (i2c_eeprom_trans_t *eeprom, bool read)
 {
+    static bool write_pending = false;
     static uint8_t txbuf[66];
+    i2c_request_t request = { .address = eeprom->address, .read = read };
 
-    while(i2cIsBusy);
+    // Wait for the previous write to complete, the write cycle overlaps with whatever was done in between.
+    if(write_pending) {
+        write_pending = false;
+        eeprom_wait_ready(eeprom->address);
+    }
 
     if(read) {
+        request.acount = eeprom->word_addr_bytes;
         if(eeprom->word_addr_bytes == 1)
-            i2c.regaddr[0] = eeprom->word_addr;
+            request.regaddr[0] = eeprom->word_addr;
         else {
-            i2c.regaddr[0] = eeprom->word_addr & 0xFF;
-            i2c.regaddr[1] = eeprom->word_addr >> 8;
+            request.regaddr[0] = eeprom->word_addr & 0xFF;
+            request.regaddr[1] = eeprom->word_addr >> 8;
         }
-        I2C_ReadRegister(eeprom->address, eeprom->data, eeprom->word_addr_bytes, eeprom->count, true);
+        request.data = eeprom->data;
+        request.count = eeprom->count;
     } else {
         memcpy(&txbuf[eeprom->word_addr_bytes], eeprom->data, eeprom->count);
         if(eeprom->word_addr_bytes == 1)
@@ -318,22 +430,40 @@ void i2c_eeprom_transfer (i2c_eeprom_trans_t *eeprom, bool read)
             txbuf[0] = eeprom->word_addr >> 8;
             txbuf[1] = eeprom->word_addr & 0xFF;
         }
-        I2C_Send(eeprom->address, txbuf, eeprom->count + eeprom->word_addr_bytes, true);
-        hal.delay_ms(7, NULL);
+        request.data = txbuf;
+        request.count = eeprom->count + eeprom->word_addr_bytes;
+        write_pending = true;
     }
+
+    i2c_transfer_wait(&request);
 }
 
 #endif
 
 #if KEYPAD_ENABLE
 
+static keycode_callback_ptr keycode_callback = NULL;
+
+static void keycode_received (i2c_request_t *request)
+{
+    if(request->ok)
+        keycode_callback((char)request->data[0]);
+}
+
+// Called from the keypad interrupt, queues the keycode read and returns at once. The callback is called
+// from the I2C interrupt when the read completes.
 void I2C_GetKeycode (uint32_t i2cAddr, keycode_callback_ptr callback)
 {
-    while(i2cIsBusy);
+    static uint8_t keycode;
+    static i2c_request_t request = { .read = true, .count = 1, .data = &keycode, .callback = keycode_received, .done = true };
+
+    if(!request.done) // A read is already pending.
+        return;
 
-    i2c.keycode_callback = callback;
+    keycode_callback = callback;
+    request.address = i2cAddr;
 
-    I2C_Receive(i2cAddr, NULL, 1, false);
+    i2c_transfer(&request);
 }
 
 #endif
@@ -342,50 +472,43 @@ void I2C_GetKeycode (uint32_t i2cAddr, keycode_callback_ptr callback)
 
 static TMC2130_status_t I2C_TMC_ReadRegister (TMC2130_t *driver, TMC2130_datagram_t *reg)
 {
-    uint8_t *res, i2creg;
+    uint8_t res[5];
     TMC2130_status_t status = {0};
+    i2c_request_t request = { .address = I2C_ADR_I2CBRIDGE, .read = true, .acount = 1, .count = 5, .data = res };
 
-    if((i2creg = TMCI2C_GetMapAddress((uint8_t)(driver ? (uint32_t)driver->cs_pin : 0), reg->addr).value) == 0xFF)
+    if((request.regaddr[0] = TMCI2C_GetMapAddress((uint8_t)(driver ? (uint32_t)driver->cs_pin : 0), reg->addr).value) == 0xFF)
         return status; // unsupported register
 
-    while(i2cIsBusy);
+    i2c_transfer_wait(&request);
 
-    i2c.buffer[0] = i2creg;
-    i2c.buffer[1] = 0;
-    i2c.buffer[2] = 0;
-    i2c.buffer[3] = 0;
-    i2c.buffer[4] = 0;
-
-    res = I2C_ReadRegister(I2C_ADR_I2CBRIDGE, NULL, 5, true);
-
-    status.value = (uint8_t)*res++;
-    reg->payload.value = ((uint8_t)*res++ << 24);
-    reg->payload.value |= ((uint8_t)*res++ << 16);
-    reg->payload.value |= ((uint8_t)*res++ << 8);
-    reg->payload.value |= (uint8_t)*res++;
+    status.value = res[0];
+    reg->payload.value = ((uint32_t)res[1] << 24);
+    reg->payload.value |= ((uint32_t)res[2] << 16);
+    reg->payload.value |= ((uint32_t)res[3] << 8);
+    reg->payload.value |= (uint32_t)res[4];
 
     return status;
 }
 
 static TMC2130_status_t I2C_TMC_WriteRegister (TMC2130_t *driver, TMC2130_datagram_t *reg)
 {
+    uint8_t buf[5];
     TMC2130_status_t status = {0};
-
-    while(i2cIsBusy);
+    i2c_request_t request = { .address = I2C_ADR_I2CBRIDGE, .count = 5, .data = buf };
 
     reg->addr.write = 1;
-    i2c.buffer[0] = TMCI2C_GetMapAddress((uint8_t)(driver ? (uint32_t)driver->cs_pin : 0), reg->addr).value;
+    buf[0] = TMCI2C_GetMapAddress((uint8_t)(driver ? (uint32_t)driver->cs_pin : 0), reg->addr).value;
     reg->addr.write = 0;
 
-    if(i2c.buffer[0] == 0xFF)
+    if(buf[0] == 0xFF)
         return status; // unsupported register
 
-    i2c.buffer[1] = (reg->payload.value >> 24) & 0xFF;
-    i2c.buffer[2] = (reg->payload.value >> 16) & 0xFF;
-    i2c.buffer[3] = (reg->payload.value >> 8) & 0xFF;
-    i2c.buffer[4] = reg->payload.value & 0xFF;
+    buf[1] = (reg->payload.value >> 24) & 0xFF;
+    buf[2] = (reg->payload.value >> 16) & 0xFF;
+    buf[3] = (reg->payload.value >> 8) & 0xFF;
+    buf[4] = reg->payload.value & 0xFF;
 
-    I2C_Send(I2C_ADR_I2CBRIDGE, NULL, 5, true);
+    i2c_transfer_wait(&request);
 
     return status;
 }
@@ -415,20 +538,35 @@ hal.stream.write(" ");
 hal.stream.write(uitoa(i2c.state));
 hal.stream.write(ASCII_EOL);
 */
-    if(ifg & LPI2C_MSR_ALF) {
-        port->MTDR = LPI2C_MTDR_CMD_STOP;
-        i2c.state = I2CState_Error;
+    // Transaction completed with a stop condition.
+    if((ifg & LPI2C_MSR_SDF) && (port->MIER & LPI2C_MIER_SDIE)) {
+        if(ifg & LPI2C_MSR_NDF)
+            i2c.state = I2CState_Error;
+        I2C_Complete();
+        return;
     }
 
+    if(ifg & LPI2C_MSR_ALF)
+        i2c.state = I2CState_Error;
+
     if(ifg & LPI2C_MSR_NDF)
         i2c.state = I2CState_Error;
 
     switch(i2c.state) {
 
         case I2CState_Idle:
-        case I2CState_Error:
             port->MIER = 0;
+            break;
+
+        case I2CState_Error:
             port->MCR |= (LPI2C_MCR_RTF|LPI2C_MCR_RRF);
+            if(port->MSR & LPI2C_MSR_MBF) { // Release the bus, the transaction completes on the stop condition.
+                port->MTDR = LPI2C_MTDR_CMD_STOP;
+                port->MIER = LPI2C_MIER_SDIE;
+            } else if(queue.current)
+                I2C_Complete();
+            else
+                port->MIER = 0;
             break;
 
         case I2CState_SendNext:
@@ -443,7 +581,7 @@ hal.stream.write(ASCII_EOL);
             break;
 
         case I2CState_AwaitCompletion:
-            port->MIER &= ~LPI2C_MIER_TDIE;
+            port->MIER = LPI2C_MIER_NDIE|LPI2C_MIER_SDIE;
             port->MTDR = LPI2C_MTDR_CMD_STOP;
             i2c.count = 0;
             i2c.state = I2CState_Idle;
@@ -487,13 +625,8 @@ hal.stream.write(ASCII_EOL);
             *i2c.data = port->MRDR & 0xFF;
             i2c.count = 0;
             i2c.state = I2CState_Idle;
+            port->MIER = LPI2C_MIER_SDIE;
             port->MTDR = LPI2C_MTDR_CMD_STOP;
-          #if KEYPAD_ENABLE
-            if(i2c.keycode_callback) {
-                i2c.keycode_callback(*i2c.data);
-                i2c.keycode_callback = NULL;
-            }
-          #endif
             break;
 default: break;
     }
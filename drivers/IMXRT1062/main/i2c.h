@@ -27,6 +27,28 @@
 #include "driver.h"
 #include "src/grbl/plugins.h"
 
+#define I2C_QUEUE_SIZE 4 // Max. number of transactions queued
+
+typedef struct i2c_request i2c_request_t;
+
+typedef void (*i2c_callback_ptr)(i2c_request_t *request);
+
+// A transaction, must stay valid until completed. A read with acount > 0 first sends the register address
+// in regaddr, last byte first, and then restarts for the read.
+struct i2c_request {
+    uint8_t address;            // 7-bit device address
+    bool read;
+    uint8_t acount;             // Number of register address bytes, 0 or 2 max.
+    uint8_t regaddr[2];
+    uint8_t count;              // Number of bytes to read or write
+    uint8_t *data;
+    i2c_callback_ptr callback;  // Optional, called from the I2C interrupt on completion
+    volatile bool done;         // Set on completion
+    volatile bool ok;           // False if the transaction was NACKed or the bus arbitration was lost
+};
+
+bool i2c_transfer (i2c_request_t *request);
+
 #if TRINAMIC_ENABLE && TRINAMIC_I2C
 
 #include "src/trinamic/trinamic2130.h"
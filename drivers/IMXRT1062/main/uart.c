@@ -225,6 +225,27 @@ int16_t serialGetC (void)
     return data;
 }
 
+//
+// serialReadBlock - reads up to max characters, ends after the first CR or LF
+//
+uint16_t serialReadBlock (char *buffer, uint16_t max)
+{
+    char c;
+    uint16_t count = 0;
+    uint_fast16_t bptr = rxbuffer.tail, head = rxbuffer.head;
+
+    while(count < max && bptr != head) {
+        buffer[count++] = c = rxbuffer.data[bptr];
+        bptr = (bptr + 1) & (RX_BUFFER_SIZE - 1);
+        if(c == ASCII_LF || c == ASCII_CR)
+            break;
+    }
+
+    rxbuffer.tail = bptr;
+
+    return count;
+}
+
 inline static uint16_t serialRxCount (void)
 {
     uint_fast16_t head = rxbuffer.head, tail = rxbuffer.tail;
@@ -289,16 +310,30 @@ void serialWriteS (const char *data)
         serialPutC(c);
 }
 
+void serialWriteN (const char *data, uint16_t length)
+{
+    while(length--)
+        serialPutC(*data++);
+}
+
 // "dummy" version of serialGetC
 static int16_t serialGetNull (void)
 {
     return -1;
 }
 
+// "dummy" version of serialReadBlock
+static uint16_t serialReadBlockNull (char *buffer, uint16_t max)
+{
+    return 0;
+}
+
 bool serialSuspendInput (bool suspend)
 {
-    if(suspend)
+    if(suspend) {
         hal.stream.read = serialGetNull;
+        hal.stream.read_block = serialReadBlockNull;
+    }
     else if(rxbuffer.backup)
         memcpy(&rxbuffer, &rxbackup, sizeof(stream_rx_buffer_t));
 
@@ -312,6 +347,11 @@ uint16_t serialTxCount(void) {
     return BUFCOUNT(head, tail, TX_BUFFER_SIZE);
 }
 
+uint16_t serialTxFree (void)
+{
+    return (TX_BUFFER_SIZE - 1) - serialTxCount();
+}
+
 static void uart_interrupt_handler (void)
 {
     uint_fast16_t bptr;
@@ -363,6 +403,7 @@ static void uart_interrupt_handler (void)
                     rxbuffer.backup = true;
                     rxbuffer.tail = rxbuffer.head;
                     hal.stream.read = serialGetC; // restore normal input
+                    hal.stream.read_block = serialReadBlock;
                 } else if(!hal.stream.enqueue_realtime_command((char)data)) {
                     rxbuffer.data[rxbuffer.head] = (char)data;  // Add data to buffer
                     rxbuffer.head = bptr;                       // and update pointer
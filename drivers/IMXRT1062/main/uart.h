@@ -28,9 +28,12 @@
 
 void serialInit (void);
 int16_t serialGetC (void);
+uint16_t serialReadBlock (char *buffer, uint16_t max);
 void serialWriteS (const char *data);
+void serialWriteN (const char *data, uint16_t length);
 bool serialSuspendInput (bool suspend);
 uint16_t serialRxFree (void);
+uint16_t serialTxFree (void);
 void serialRxFlush (void);
 void serialRxCancel (void);
 
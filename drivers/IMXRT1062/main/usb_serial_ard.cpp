@@ -72,6 +72,15 @@ uint16_t usb_serialRxFree (void)
     return (uint16_t)((RX_BUFFER_SIZE - 1) - BUFCOUNT(head, tail, RX_BUFFER_SIZE));
 }
 
+//
+// Returns number of characters that can be written without blocking
+//
+uint16_t usb_serialTxFree (void)
+{
+    uint_fast16_t txfree = SerialUSB.availableForWrite(), buffer_free = (BLOCK_TX_BUFFER_SIZE - 1) - txbuf.length;
+    return (uint16_t)(txfree < buffer_free ? txfree : buffer_free);
+}
+
 //
 // Flushes the serial input buffer (including the USB buffer)
 //
@@ -42,6 +42,7 @@ bool usb_serialSuspendInput (bool suspend);
 uint16_t usb_serialTxCount(void);
 uint16_t usb_serialRxCount(void);
 uint16_t usb_serialRxFree(void);
+uint16_t usb_serialTxFree(void);
 void usb_serialRxFlush(void);
 void usb_serialRxCancel(void);
 
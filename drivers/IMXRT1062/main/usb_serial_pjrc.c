@@ -62,6 +62,15 @@ uint16_t usb_serialRxFree (void)
     return (uint16_t)((RX_BUFFER_SIZE - 1) - BUFCOUNT(head, tail, RX_BUFFER_SIZE));
 }
 
+//
+// Returns number of characters that can be written without blocking
+//
+uint16_t usb_serialTxFree (void)
+{
+    uint_fast16_t txfree = usb_serial_write_buffer_free(), buffer_free = (BLOCK_TX_BUFFER_SIZE - 1) - txbuf.length;
+    return (uint16_t)(txfree < buffer_free ? txfree : buffer_free);
+}
+
 //
 // Flushes the serial input buffer (including the USB buffer)
 //
@@ -92,15 +101,14 @@ bool usb_serialPutC (const char c)
 }
 
 //
-// Writes a null terminated string to the serial output stream, blocks if buffer full
+// Writes a number of characters to the serial output stream, blocks if buffer full
+// Buffers output up to EOL (LF) or until the buffer is nearly full before transmitting
 //
-void usb_serialWriteS (const char *s)
+void usb_serialWriteN (const char *s, uint16_t length)
 {
-    if(*s == '\0')
+    if(length == 0)
         return;
 
-    size_t length = strlen(s);
-
     if((length + txbuf.length) < BLOCK_TX_BUFFER_SIZE) {
 
         memcpy(txbuf.s, s, length);
@@ -135,6 +143,14 @@ void usb_serialWriteS (const char *s)
     }
 }
 
+//
+// Writes a null terminated string to the serial output stream, blocks if buffer full
+//
+void usb_serialWriteS (const char *s)
+{
+    usb_serialWriteN(s, (uint16_t)strlen(s));
+}
+
 //
 // Writes a null terminated string to the serial output stream followed by EOL, blocks if buffer full
 //
@@ -171,58 +187,112 @@ int16_t usb_serialGetC (void)
     return (int16_t)data;
 }
 
+//
+// usb_serialReadBlock - reads up to max characters, ends after the first CR or LF
+//
+uint16_t usb_serialReadBlock (char *buffer, uint16_t max)
+{
+    char c;
+    uint16_t count = 0;
+    uint_fast16_t bptr = usb_rxbuffer.tail, head = usb_rxbuffer.head;
+
+    while(count < max && bptr != head) {
+        buffer[count++] = c = usb_rxbuffer.data[bptr];
+        bptr = (bptr + 1) & (RX_BUFFER_SIZE - 1);
+        if(c == ASCII_LF || c == ASCII_CR)
+            break;
+    }
+
+    usb_rxbuffer.tail = bptr;
+
+    return count;
+}
+
 // "dummy" version of serialGetC
 static int16_t serialGetNull (void)
 {
     return -1;
 }
 
+// "dummy" version of usb_serialReadBlock
+static uint16_t serialReadBlockNull (char *buffer, uint16_t max)
+{
+    return 0;
+}
+
 bool usb_serialSuspendInput (bool suspend)
 {
-    if(suspend)
+    if(suspend) {
         hal.stream.read = serialGetNull;
+        hal.stream.read_block = serialReadBlockNull;
+    }
     else if(usb_rxbuffer.backup)
         memcpy(&usb_rxbuffer, &usb_rxbackup, sizeof(stream_rx_buffer_t));
 
     return usb_rxbuffer.tail != usb_rxbuffer.head;
 }
 
+// Returns the number of characters that can be added at head without wrapping or overwriting unread data.
+static inline uint_fast16_t usb_serialRxSpan (void)
+{
+    uint_fast16_t tail = usb_rxbuffer.tail, head = usb_rxbuffer.head;
+
+    return tail > head ? tail - head - 1 : RX_BUFFER_SIZE - head - (tail == 0 ? 1 : 0);
+}
+
 //
 // This function get called from the systick interrupt handler,
 // used here to get characters off the USB serial input stream and buffer
 // them for processing by grbl. Real time command characters are stripped out
 // and submitted for realtime processing.
+// Data is read straight into the free part of the input buffer and scanned in place, realtime
+// commands are removed by moving the remaining characters down in the same pass.
+// When the input buffer is full data is read via a small buffer so that realtime commands still
+// get through, other characters are then dropped and the overflow flag is set.
 //
 void usb_execute_realtime (uint_fast16_t state)
 {
-    char c, *dp;
-    int avail, free;
+    char c, *sp, *dp;
+    int avail, span;
+    uint_fast16_t head;
+    uint_fast8_t passes = 2; // At most two reads, before and after the end of the buffer
 
-    if((avail = usb_serial_available())) {
+    while(passes-- && (avail = usb_serial_available())) {
 
-        dp = rxbuf;
-        free = usb_serialRxFree();
-        free = free > BLOCK_RX_BUFFER_SIZE ? BLOCK_RX_BUFFER_SIZE : free;
+        if((span = usb_serialRxSpan()) == 0) {
 
-        avail = usb_serial_read(rxbuf, avail > free ? free : avail);
+            avail = usb_serial_read(rxbuf, avail > BLOCK_RX_BUFFER_SIZE ? BLOCK_RX_BUFFER_SIZE : avail);
+            sp = rxbuf;
+
+            while(avail--) {
+                if(!hal.stream.enqueue_realtime_command(*sp++))
+                    usb_rxbuffer.overflow = On;
+            }
+            break;
+        }
+
+        sp = dp = &usb_rxbuffer.data[usb_rxbuffer.head];
+        avail = usb_serial_read(dp, avail > span ? span : avail);
 
         while(avail--) {
-            c = *dp++;
+            c = *sp++;
             if(c == CMD_TOOL_ACK && !usb_rxbuffer.backup) {
+                usb_rxbuffer.head = dp - usb_rxbuffer.data; // Commit characters preceding the ACK
                 memcpy(&usb_rxbackup, &usb_rxbuffer, sizeof(stream_rx_buffer_t));
                 usb_rxbuffer.backup = true;
                 usb_rxbuffer.tail = usb_rxbuffer.head;
                 hal.stream.read = usb_serialGetC; // restore normal input
-            } else if(!hal.stream.enqueue_realtime_command(c)) {
-                uint32_t bptr = (usb_rxbuffer.head + 1) & (RX_BUFFER_SIZE - 1); // Get next head pointer
-                if(bptr == usb_rxbuffer.tail)                                   // If buffer full
-                    usb_rxbuffer.overflow = On;                                 // flag overflow,
-                else {
-                    usb_rxbuffer.data[usb_rxbuffer.head] = c;                   // else add character data to buffer
-                    usb_rxbuffer.head = bptr;                                   // and update pointer
-                }
+                hal.stream.read_block = usb_serialReadBlock;
+            } else {
+                head = usb_rxbuffer.head;
+                if(!hal.stream.enqueue_realtime_command(c))
+                    *dp++ = c;
+                else if(usb_rxbuffer.head != head)          // Input was cancelled by the command,
+                    dp = &usb_rxbuffer.data[usb_rxbuffer.head]; // drop the characters preceding it
             }
         }
+
+        usb_rxbuffer.head = (dp - usb_rxbuffer.data) & (RX_BUFFER_SIZE - 1); // Update pointer after the data is in place
     }
 }
 
@@ -33,8 +33,10 @@ extern void usb_execute_realtime (uint_fast16_t state);
 
 void usb_serialInit(void);
 int16_t usb_serialGetC(void);
+uint16_t usb_serialReadBlock(char *buffer, uint16_t max);
 bool usb_serialPutC(const char c);
 void usb_serialWriteS(const char *s);
+void usb_serialWriteN(const char *s, uint16_t length);
 void usb_serialWriteLn(const char *s);
 void usb_serialWrite(const char *s, uint16_t length);
 bool usb_serialSuspendInput (bool suspend);
@@ -42,6 +44,7 @@ bool usb_serialSuspendInput (bool suspend);
 uint16_t usb_serialTxCount(void);
 uint16_t usb_serialRxCount(void);
 uint16_t usb_serialRxFree(void);
+uint16_t usb_serialTxFree(void);
 void usb_serialRxFlush(void);
 void usb_serialRxCancel(void);
 
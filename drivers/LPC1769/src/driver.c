@@ -990,7 +990,7 @@ static bool driver_setup (settings_t *settings)
 
  // Set defaults
 
-    IOInitDone = settings->version == 16;
+    IOInitDone = settings->version == 17;
 
     settings_changed(settings);
 
@@ -1067,6 +1067,7 @@ bool driver_init (void) {
 #if USB_ENABLE
     usbInit();
     hal.stream.read = usbGetC;
+    hal.stream.read_block = usbReadBlock;
     hal.stream.write = usbWriteS;
     hal.stream.write_all = usbWriteS;
     hal.stream.get_rx_buffer_available = usbRxFree;
@@ -1094,6 +1095,11 @@ bool driver_init (void) {
     hal.eeprom.type = EEPROM_Emulated;
     hal.eeprom.memcpy_from_flash = memcpy_from_flash;
     hal.eeprom.memcpy_to_flash = memcpy_to_flash;
+    hal.eeprom.journal.base = flash_journal_base;
+    hal.eeprom.journal.sector_size = FLASH_JOURNAL_SECTOR_SIZE;
+    hal.eeprom.journal.sectors = 2;
+    hal.eeprom.journal.erase = flash_journal_erase;
+    hal.eeprom.journal.program = flash_journal_program;
 #else
     hal.eeprom.type = EEPROM_None;
 #endif
@@ -1128,7 +1134,7 @@ bool driver_init (void) {
 
     // No need to move version check before init.
     // Compiler will fail any signature mismatch for existing entries.
-    return hal.version == 6;
+    return hal.version == 7;
 }
 
 /* interrupt handlers */
@@ -34,6 +34,14 @@ static const uint32_t flash_target = 0x1000UL * 16 + 0x8000UL * (flash_sector -
 //static const uint32_t flash_sector = 15;      // Last 4k sector number
 //static const uint32_t flash_target = 0xF000UL;    // Last 4k sector start adress
 
+// The journal occupies the last two 32k sectors, the last sector is shared with the single sector
+// storage above which is imported from if the journal is empty.
+// NOTE: The firmware image must not extend into sector 28.
+#define FLASH_JOURNAL_SECTOR 28
+#define FLASH_PAGE_SIZE 256 // Smallest unit programmed by IAP
+
+const uint8_t *flash_journal_base = (const uint8_t *)(0x1000UL * 16 + 0x8000UL * (FLASH_JOURNAL_SECTOR - 16));
+
 bool memcpy_from_flash (uint8_t *dest)
 {
     memcpy(dest, (const void *)flash_target, hal.eeprom.size);
@@ -58,3 +66,53 @@ bool memcpy_to_flash (uint8_t *source)
 
     return ret == IAP_CMD_SUCCESS;
 }
+
+bool flash_journal_erase (const uint8_t *sector)
+{
+    uint8_t ret;
+    uint32_t sector_num = FLASH_JOURNAL_SECTOR + (sector - flash_journal_base) / FLASH_JOURNAL_SECTOR_SIZE;
+
+    __disable_irq();
+
+    ret = Chip_IAP_PreSectorForReadWrite(sector_num, sector_num);
+    ret = Chip_IAP_EraseSector(sector_num, sector_num);
+
+    __enable_irq();
+
+    return ret == IAP_CMD_SUCCESS;
+}
+
+// IAP programs whole 256 byte pages, the bytes of each page outside the range written are programmed to their current
+// value. Records are appended to erased flash so these are either erased or already programmed and thus not changed.
+bool flash_journal_program (const uint8_t *address, const uint8_t *data, uint32_t size)
+{
+    static uint32_t page[FLASH_PAGE_SIZE / sizeof(uint32_t)]; // IAP source must be word aligned
+
+    uint8_t ret = IAP_CMD_SUCCESS;
+    uint32_t sector_num = FLASH_JOURNAL_SECTOR + (address - flash_journal_base) / FLASH_JOURNAL_SECTOR_SIZE;
+    uint32_t offset, count;
+    const uint8_t *target;
+
+    while(size && ret == IAP_CMD_SUCCESS) {
+
+        target = (const uint8_t *)((uint32_t)address & ~(FLASH_PAGE_SIZE - 1));
+        offset = address - target;
+        count = min(size, FLASH_PAGE_SIZE - offset);
+
+        memcpy(page, target, FLASH_PAGE_SIZE);
+        memcpy((uint8_t *)page + offset, data, count);
+
+        __disable_irq();
+
+        ret = Chip_IAP_PreSectorForReadWrite(sector_num, sector_num);
+        ret = Chip_IAP_CopyRamToFlash((uint32_t)target, page, FLASH_PAGE_SIZE);
+
+        __enable_irq();
+
+        address += count;
+        data += count;
+        size -= count;
+    }
+
+    return ret == IAP_CMD_SUCCESS;
+}
@@ -24,7 +24,13 @@
 #ifndef _flash_h_
 #define _flash_h_
 
+#define FLASH_JOURNAL_SECTOR_SIZE 0x8000UL
+
+extern const uint8_t *flash_journal_base;
+
 bool memcpy_from_flash (uint8_t *dest);
 bool memcpy_to_flash (uint8_t *source);
+bool flash_journal_erase (const uint8_t *sector);
+bool flash_journal_program (const uint8_t *address, const uint8_t *data, uint32_t size);
 
 #endif
@@ -228,45 +228,102 @@ int16_t usbGetC (void)
     return (int16_t)data;
 }
 
+//
+// usbReadBlock - reads up to max characters, ends after the first CR or LF
+//
+uint16_t usbReadBlock (char *buffer, uint16_t max)
+{
+    char c;
+    uint16_t count = 0;
+    uint_fast16_t bptr = rxbuf.tail, head = rxbuf.head;
+
+    while(count < max && bptr != head) {
+        buffer[count++] = c = rxbuf.data[bptr];
+        bptr = (bptr + 1) & (RX_BUFFER_SIZE - 1);
+        if(c == ASCII_LF || c == ASCII_CR)
+            break;
+    }
+
+    rxbuf.tail = bptr;
+
+    return count;
+}
+
 // "dummy" version of serialGetC
 static int16_t usbGetNull (void)
 {
     return -1;
 }
 
+// "dummy" version of usbReadBlock
+static uint16_t usbReadBlockNull (char *buffer, uint16_t max)
+{
+    return 0;
+}
+
 bool usbSuspendInput (bool suspend)
 {
-    if(suspend)
+    if(suspend) {
         hal.stream.read = usbGetNull;
-    else if(rxbuf.backup)
+        hal.stream.read_block = usbReadBlockNull;
+    } else if(rxbuf.backup)
         memcpy(&rxbuf, &rxbackup, sizeof(stream_rx_buffer_t));
 
     return rxbuf.tail != rxbuf.head;
 }
 
+// Copies a run of characters to the input buffer, flags overflow if it does not fit.
+static void usbBufferRun (const uint8_t *data, uint32_t length)
+{
+    uint_fast16_t head = rxbuf.head, tail = rxbuf.tail, free = (RX_BUFFER_SIZE - 1) - BUFCOUNT(head, tail, RX_BUFFER_SIZE), span;
+
+    if(length > free) {
+        rxbuf.overflow = 1;
+        length = free;
+    }
+
+    if((span = RX_BUFFER_SIZE - head) > length)
+        span = length;
+
+    memcpy(&rxbuf.data[head], data, span);
+    memcpy(rxbuf.data, data + span, length - span);
+
+    rxbuf.head = (head + length) & (RX_BUFFER_SIZE - 1);                    // Update pointer after the data is in place
+}
+
+// Scans the USB endpoint buffer in place. Realtime commands are extracted in a single pass,
+// also when the input buffer is full, and the runs of characters between them are copied
+// to the input buffer as blocks.
 void usbBufferInput (uint8_t *data, uint32_t length)
 {
+    uint8_t *run = data;
+
     while(length--) {
 
-        uint_fast16_t next_head = (rxbuf.head + 1)  & (RX_BUFFER_SIZE - 1); // Get and increment buffer pointer
+        if(*data == CMD_TOOL_ACK && !rxbuf.backup) {
+
+            usbBufferRun(run, data - run);                                  // Commit characters preceding the ACK
+            memcpy(&rxbackup, &rxbuf, sizeof(stream_rx_buffer_t));
+            rxbuf.backup = true;
+            rxbuf.tail = rxbuf.head;
+            hal.stream.read = usbGetC; // restore normal input
+            hal.stream.read_block = usbReadBlock;
+            run = data + 1;
 
-        if(rxbuf.tail == next_head) {                                       // If buffer full
-            rxbuf.overflow = 1;                                             // flag overflow
         } else {
-            if(*data == CMD_TOOL_ACK && !rxbuf.backup) {
 
-                memcpy(&rxbackup, &rxbuf, sizeof(stream_rx_buffer_t));
-                rxbuf.backup = true;
-                rxbuf.tail = rxbuf.head;
-                hal.stream.read = usbGetC; // restore normal input
+            uint_fast16_t head = rxbuf.head;
 
-            } else if(!hal.stream.enqueue_realtime_command(*data)) {        // Check and strip realtime commands,
-                rxbuf.data[rxbuf.head] = *data;                             // if not add data to buffer
-                rxbuf.head = next_head;                                     // and update pointer
+            if(hal.stream.enqueue_realtime_command(*data)) {                // Check and strip realtime commands
+                if(rxbuf.head == head)                                      // Commit characters preceding the command
+                    usbBufferRun(run, data - run);                          // unless it cancelled buffered input
+                run = data + 1;
             }
         }
         data++;                                                             // next
     }
+
+    usbBufferRun(run, data - run);
 }
 
 #endif
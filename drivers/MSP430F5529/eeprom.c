@@ -158,6 +158,7 @@ void eepromPutByte (uint32_t addr, uint8_t new_value)
 void eepromWriteBlockWithChecksum (uint32_t destination, uint8_t *source, uint32_t size)
 {
     uint32_t bytes = size;
+    uint16_t checksum = calc_checksum(source, size);
 
     i2c.word_addr = destination & 0xFF;
     i2c.data = source;
@@ -174,7 +175,8 @@ void eepromWriteBlockWithChecksum (uint32_t destination, uint8_t *source, uint32
         i2c.word_addr = destination & 0xFF;
     }
 
-    eepromPutByte(destination, calc_checksum(source, size));
+    eepromPutByte(destination, (uint8_t)checksum);
+    eepromPutByte(destination + 1, (uint8_t)(checksum >> 8));
 }
 
 bool eepromReadBlockWithChecksum (uint8_t *destination, uint32_t source, uint32_t size)
@@ -186,5 +188,5 @@ bool eepromReadBlockWithChecksum (uint8_t *destination, uint32_t source, uint32_
 
     StartI2C(true);
 
-    return calc_checksum(destination, size) == eepromGetByte(source + size);
+    return calc_checksum(destination, size) == (eepromGetByte(source + size) | (eepromGetByte(source + size + 1) << 8));
 }
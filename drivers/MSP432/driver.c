@@ -81,11 +81,19 @@ typedef struct {
 typedef struct {
     pid_state_t pid_state;
     pid_t pid;
+#ifdef ENABLE_SPINDLE_PID
+    spindle_pid_t fixed_pid;    // Core fixed point PID, pid.error holds its output
+#endif
 } spindle_control_t;
 
 typedef struct {
     float block_start;              // Spindle position at start of move (number of revolutions)
     float prev_pos;                 // Target position of previous segment
+#if SPINDLE_SYNC_SUBSEGMENT
+    float segment_start;            // Start position of current segment
+    uint32_t step_count;            // Stepper step count at last correction
+    volatile bool sample;           // Set by spindle encoder interrupt to request a correction
+#endif
     float steps_per_mm;             // Steps per mm for current block
     float programmed_rate;          // Programmed feed in mm/rev for current block
     uint32_t min_cycles_per_tick;   // Minimum cycles per tick for PID loop
@@ -371,6 +379,9 @@ static void stepperPulseStartSynchronized (stepper_t *stepper)
         spindle_tracker.pid.d_error = 0.0f;
         spindle_tracker.pid.sample_rate_prev = 0.0f;
         spindle_tracker.block_start = spindleGetData(SpindleData_AngularPosition).angular_position * spindle_tracker.programmed_rate;
+#if SPINDLE_SYNC_SUBSEGMENT
+        spindle_tracker.sample = false;
+#endif
 #ifdef PID_LOG
         sys.pid_log.idx = 0;
         sys.pid_log.setpoint = 100.0f;
@@ -438,8 +449,38 @@ static void stepperPulseStartSynchronized (stepper_t *stepper)
 #endif
         }
 
+#if SPINDLE_SYNC_SUBSEGMENT
+        spindle_tracker.segment_start = spindle_tracker.prev_pos;
+        spindle_tracker.step_count = stepper->step_count;
+        spindle_tracker.sample = false;
+#endif
         spindle_tracker.prev_pos = stepper->exec_segment->target_position;
     }
+#if SPINDLE_SYNC_SUBSEGMENT
+    // Sub-segment correction: adjust the tick rate of the remaining segment steps for any positional error
+    // at the last spindle encoder interrupt. The setpoint is interpolated between the segment end positions.
+    else if(spindle_tracker.sample && stepper->exec_segment->cruising && stepper->step_count > 1) {
+
+        uint32_t steps = spindle_tracker.step_count - stepper->step_count;
+
+        spindle_tracker.sample = false;
+
+        if(steps) {
+
+            float sample_rate = (float)hal.f_step_timer / (float)(stepper->exec_segment->cycles_per_tick * steps);
+            float setpoint = spindle_tracker.segment_start + (spindle_tracker.prev_pos - spindle_tracker.segment_start) *
+                              (float)(stepper->exec_segment->n_step - stepper->step_count) / (float)stepper->exec_segment->n_step;
+            float actual_pos = spindleGetData(SpindleData_AngularPosition).angular_position * spindle_tracker.programmed_rate - spindle_tracker.block_start;
+            int32_t step_delta = (int32_t)(pid(&spindle_tracker.pid, setpoint, actual_pos, sample_rate) * spindle_tracker.steps_per_mm);
+            int32_t ticks = (((int32_t)stepper->step_count + step_delta) * (int32_t)stepper->exec_segment->cycles_per_tick) / (int32_t)stepper->step_count;
+
+            stepper->exec_segment->cycles_per_tick = (uint32_t)max(ticks, (int32_t)spindle_tracker.min_cycles_per_tick);
+            stepperCyclesPerTick(stepper->exec_segment->cycles_per_tick);
+
+            spindle_tracker.step_count = stepper->step_count;
+        }
+    }
+#endif
 }
 
 // Enable/disable limit pins interrupt
@@ -696,6 +737,9 @@ static void spindleSetStateVariable (spindle_state_t state, float rpm)
         spindle_control.pid.i_error = 0.0f;
         spindle_control.pid.d_error = 0.0f;
         spindle_control.pid.sample_rate_prev = 1.0f;
+  #ifdef ENABLE_SPINDLE_PID
+        spindle_pid_reset(&spindle_control.fixed_pid);
+  #endif
 #endif
     } else {
         spindle_dir(state.ccw);
@@ -726,6 +770,25 @@ inline static float spindle_calc_rpm (uint32_t tpp)
     return spindle_encoder.rpm_factor / (float)tpp;
 }
 
+#ifdef ENABLE_SPINDLE_ENCODER
+
+// The RPM timer is counting down, the spindle encoder takes timestamps counting up.
+#define spindle_encoder_timestamp() (~RPM_TIMER->VALUE)
+
+static spindle_data_t spindleGetData (spindle_data_request_t request)
+{
+    spindle_data_t data = spindle_encoder_get_data(request, RPM_COUNTER->R, spindle_encoder_timestamp());
+
+#ifdef SPINDLE_RPM_CONTROLLED
+    if(request == SpindleData_RPM && spindle_control.pid.enabled && data.rpm > 0.0f)
+        data.rpm = spindle_data.rpm = spindle_encoder.rpm;
+#endif
+
+    return data;
+}
+
+#else
+
 static spindle_data_t spindleGetData (spindle_data_request_t request)
 {
     bool stopped;
@@ -764,6 +827,8 @@ static spindle_data_t spindleGetData (spindle_data_request_t request)
     return spindle_data;
 }
 
+#endif
+
 static void spindleDataReset (void)
 {
     while(spindleLock);
@@ -784,6 +849,9 @@ static void spindleDataReset (void)
     RPM_TIMER->LOAD = 0; // Reload RPM timer
     RPM_COUNTER->CTL = 0;
 
+#ifdef ENABLE_SPINDLE_ENCODER
+    RPM_COUNTER->CCR[0] = spindle_encoder_reset(0, spindle_encoder_timestamp());
+#else
     spindle_encoder.timer_value_index = RPM_TIMER->VALUE;
     spindle_encoder.pulse_counter_index = 0;
     spindle_encoder.pulse_counter_last = 0;
@@ -791,6 +859,7 @@ static void spindleDataReset (void)
     spindle_data.pulse_count = 0;
     spindle_data.index_count = 0;
     RPM_COUNTER->CCR[0] = spindle_encoder.pulse_counter_trigger;
+#endif
     RPM_COUNTER->CTL = TIMER_A_CTL_MC__CONTINUOUS|TIMER_A_CTL_CLR;
 
     if(systick_state & SysTick_CTRL_ENABLE_Msk)
@@ -822,7 +891,11 @@ inline static void spindle_rpm_pid (uint32_t tpp)
     spindleLock = true;
 
     spindle_encoder.rpm = spindle_calc_rpm(tpp);
+#ifdef ENABLE_SPINDLE_PID
+    float error = spindle_control.pid.error = (float)spindle_pid_update(&spindle_control.fixed_pid, (int32_t)spindle_data.rpm_programmed, (int32_t)spindle_encoder.rpm);
+#else
     float error = pid(&spindle_control.pid, spindle_data.rpm_programmed, spindle_encoder.rpm, 1.0);
+#endif
 
 #ifdef sPID_LOG
     if(sys.pid_log.idx < PID_LOG) {
@@ -983,6 +1056,9 @@ void settings_changed (settings_t *settings)
         if(memcmp(&spindle_control.pid.cfg, &settings->spindle.pid, sizeof(pid_values_t)) != 0) {
             spindle_set_state((spindle_state_t){0}, 0.0f);
             memcpy(&spindle_control.pid.cfg, &settings->spindle.pid, sizeof(pid_values_t));
+  #ifdef ENABLE_SPINDLE_PID
+            spindle_pid_init(&spindle_control.fixed_pid, &settings->spindle.pid, (float)SPINDLE_PID_SAMPLE_RATE / 1000.0f);
+  #endif
       //      spindle_encoder.pid.cfg.i_max_error = spindle_encoder.pid.cfg.i_max_error / settings->spindle.pid.i_gain; // Makes max value sensible?
             SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
         }
@@ -1000,6 +1076,9 @@ void settings_changed (settings_t *settings)
         spindle_encoder.timer_resolution = 1.0f / (float)(SystemCoreClock / 16);
         spindle_encoder.maximum_tt = (uint32_t)(0.25f / spindle_encoder.timer_resolution) * spindle_encoder.pulse_counter_trigger; // 250 mS
         spindle_encoder.rpm_factor = 60.0f / ((spindle_encoder.timer_resolution * (float)spindle_encoder.ppr));
+#ifdef ENABLE_SPINDLE_ENCODER
+        spindle_encoder_init(&spindle_data, spindle_encoder.ppr, SystemCoreClock / 16, 0xFFFF);
+#endif
         BITBAND_PERI(RPM_INDEX_PORT->IE, RPM_INDEX_PIN) = 1;
         spindleDataReset();
         //        spindle_data.rpm = 60.0f / ((float)(spindle_encoder.tpp * spindle_encoder.ppr) * spindle_encoder.timer_resolution); // TODO: get rid of division
@@ -1333,7 +1412,7 @@ static bool driver_setup (settings_t *settings)
     atc_init();
 #endif
 
-    IOInitDone = settings->version == 16;
+    IOInitDone = settings->version == 17;
 
     settings_changed(settings);
 
@@ -1545,7 +1624,7 @@ bool driver_init (void)
 #ifdef DRIVER_SETTINGS
     hal.eeprom.driver_area.address = GRBL_EEPROM_SIZE;
     hal.eeprom.driver_area.size = sizeof(driver_settings_t);
-    hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings_t) + 1;
+    hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings_t) + EEPROM_CHECKSUM_SIZE;
 
     hal.driver_setting = driver_setting;
     hal.driver_settings_report = driver_settings_report;
@@ -1598,7 +1677,7 @@ bool driver_init (void)
 #endif
 
     // no need to move version check before init - compiler will fail any signature mismatch for existing entries
-    return hal.version == 6;
+    return hal.version == 7;
 }
 
 /* interrupt handlers */
@@ -1659,11 +1738,18 @@ void RPMCOUNTER_IRQHandler (void)
 
     RPM_COUNTER->CCTL[0] &= ~TIMER_A_CCTLN_CCIFG;
 
+#ifdef ENABLE_SPINDLE_ENCODER
+    RPM_COUNTER->CCR[0] = cval + spindle_encoder_sample(cval, ~tval);
+#else
     spindle_data.pulse_count += cval - spindle_encoder.pulse_counter_last;
     spindle_encoder.pulse_counter_last = cval;
     spindle_encoder.tpp = (spindle_encoder.timer_value_last - tval) >> 2; // / spindle_encoder.pulse_counter_trigger..
     spindle_encoder.timer_value_last = tval;
     RPM_COUNTER->CCR[0] += spindle_encoder.pulse_counter_trigger;
+#endif
+#if SPINDLE_SYNC_SUBSEGMENT
+    spindle_tracker.sample = true; // Request spindle sync correction on next step
+#endif
 }
 
 #if CNC_BOOSTERPACK_SHORTS
@@ -1676,11 +1762,15 @@ void CONTROL_IRQHandler (void)
     CONTROL_PORT->IFG &= ~iflags;
 
     if(iflags & RPM_INDEX_BIT) {
+#ifdef ENABLE_SPINDLE_ENCODER
+        spindle_encoder.error = !spindle_encoder_index(RPM_COUNTER->R);
+#else
         spindle_encoder.timer_value_index = RPM_TIMER->VALUE;
         if((spindle_encoder.error = (RPM_COUNTER->R - spindle_encoder.pulse_counter_index) != spindle_encoder.ppr))
             RPM_COUNTER->CCR[0] = RPM_COUNTER->R + spindle_encoder.pulse_counter_trigger;
         spindle_encoder.pulse_counter_index = RPM_COUNTER->R;
         spindle_data.index_count++;
+#endif
 //        hal.spindle_index_callback(&spindle_data);
     }
 
@@ -1760,11 +1850,15 @@ void CONTROL_FH_CS_IRQHandler (void)
     CONTROL_PORT_FH->IFG = 0;
 
     if(iflags & RPM_INDEX_BIT) {
+#ifdef ENABLE_SPINDLE_ENCODER
+        spindle_encoder.error = !spindle_encoder_index(RPM_COUNTER->R);
+#else
         spindle_encoder.timer_value_index = RPM_TIMER->VALUE;
         if((spindle_encoder.error = (RPM_COUNTER->R - spindle_encoder.pulse_counter_index) != spindle_encoder.ppr))
             RPM_COUNTER->CCR[0] = RPM_COUNTER->R + spindle_encoder.pulse_counter_trigger;
         spindle_encoder.pulse_counter_index = RPM_COUNTER->R;
         spindle_data.index_count++;
+#endif
 //        hal.spindle_index_callback(&spindle_data);
     }
 
@@ -1849,7 +1943,11 @@ void SysTick_Handler (void)
             else if(spindle_data.index_count > 2)
                 spindle_control.pid_state = PIDState_Active;
 
+#ifdef ENABLE_SPINDLE_ENCODER
+            tpp += spindle_encoder_tpp(spindle_encoder_timestamp());
+#else
             tpp += spindle_encoder.tpp;
+#endif
 
             if(--spid == 0) {
                 spindle_encoder.rpm = spindle_calc_rpm(tpp / SPINDLE_PID_SAMPLE_RATE);
@@ -1859,7 +1957,11 @@ void SysTick_Handler (void)
             break;
 
         case PIDState_Active:
+#ifdef ENABLE_SPINDLE_ENCODER
+            tpp += spindle_encoder_tpp(spindle_encoder_timestamp());
+#else
             tpp += spindle_encoder.tpp;
+#endif
             if(--spid == 0) {
                 spindle_rpm_pid(tpp / SPINDLE_PID_SAMPLE_RATE);
                 tpp = 0;
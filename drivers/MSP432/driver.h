@@ -43,6 +43,7 @@
 #define TRINAMIC_ENABLE        0 // Trinamic TMC2130 stepper driver support. NOTE: work in progress.
 #define TRINAMIC_I2C           0 // Trinamic I2C - SPI bridge interface.
 #define TRINAMIC_DEV           0 // Development mode, adds a few M-codes to aid debugging. Do not enable in production code
+#define SPINDLE_SYNC_SUBSEGMENT 1 // Correct spindle synchronized motion on spindle encoder interrupts, not only on segment boundaries.
 #if COMPATIBILITY_LEVEL <= 1
 #define ESTOP_ENABLE           1 // When enabled only real-time report requests will be executed when the reset pin is asserted.
 #else
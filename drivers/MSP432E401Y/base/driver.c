@@ -54,6 +54,7 @@ static void trinamic_diag1_isr (void);
 
 #if ETHERNET_ENABLE
   #include "ethernet/enet.h"
+  #include "networking/StreamMux.h"
   #if TELNET_ENABLE
     #include "networking/TCPStream.h"
   #endif
@@ -85,25 +86,14 @@ static uint16_t step_prescaler[3] = {
 
 static network_services_t services = {0};
 
-static void enetStreamWriteS (const char *data)
-{
-#if TELNET_ENABLE
-    if(services.telnet)
-        TCPStreamWriteS(data);
-#endif
-#if WEBSOCKET_ENABLE
-    if(services.websocket)
-        WsStreamWriteS(data);
-#endif
-    serialWriteS(data);
-}
-
   #if TELNET_ENABLE
     const io_stream_t ethernet_stream = {
         .type = StreamType_Telnet,
         .read = TCPStreamGetC,
+        .read_block = TCPStreamReadBlock,
         .write = TCPStreamWriteS,
-        .write_all = enetStreamWriteS,
+        .write_n = TCPStreamWriteN,
+        .write_all = StreamMuxWriteS,
         .get_rx_buffer_available = TCPStreamRxFree,
         .reset_read_buffer = TCPStreamRxFlush,
         .cancel_read_buffer = TCPStreamRxCancel,
@@ -120,8 +110,10 @@ static void enetStreamWriteS (const char *data)
     const io_stream_t websocket_stream = {
         .type = StreamType_WebSocket,
         .read = WsStreamGetC,
+        .read_block = WsStreamReadBlock,
         .write = WsStreamWriteS,
-        .write_all = enetStreamWriteS,
+        .write_n = WsStreamWriteN,
+        .write_all = StreamMuxWriteS,
         .get_rx_buffer_available = WsStreamRxFree,
         .reset_read_buffer = WsStreamRxFlush,
         .cancel_read_buffer = WsStreamRxCancel,
@@ -141,7 +133,7 @@ const io_stream_t serial_stream = {
     .read = serialGetC,
     .write = serialWriteS,
 #if ETHERNET_ENABLE
-    .write_all = enetStreamWriteS,
+    .write_all = StreamMuxWriteS,
 #else
     .write_all = serialWriteS,
 #endif
@@ -304,18 +296,22 @@ void selectStream (stream_type_t stream)
         case StreamType_Telnet:
             memcpy(&hal.stream, &ethernet_stream, sizeof(io_stream_t));
             services.telnet = On;
+            StreamMuxEnable(StreamType_Telnet, true);
             break;
 #endif
 #if WEBSOCKET_ENABLE
         case StreamType_WebSocket:
             memcpy(&hal.stream, &websocket_stream, sizeof(io_stream_t));
             services.websocket = On;
+            StreamMuxEnable(StreamType_WebSocket, true);
             break;
 #endif
         case StreamType_Serial:
             memcpy(&hal.stream, &serial_stream, sizeof(io_stream_t));
 #if ETHERNET_ENABLE
             services.mask = 0;
+            StreamMuxEnable(StreamType_Telnet, false);
+            StreamMuxEnable(StreamType_WebSocket, false);
 #endif
             break;
 
@@ -1142,6 +1138,7 @@ static void modeSelect (bool mpg_mode)
     if(mpg_mode) {
         normal_stream = hal.stream.type;
         hal.stream.read = serial2GetC;
+        hal.stream.read_block = NULL; // Network streams read blocks, input is read from hal.stream.read in MPG mode
         hal.stream.get_rx_buffer_available = serial2RxFree;
         hal.stream.cancel_read_buffer = serial2RxCancel;
         hal.stream.reset_read_buffer = serial2RxFlush;
@@ -1621,7 +1618,7 @@ static bool driver_setup (settings_t *settings)
 
   // Set defaults
 
-    IOInitDone = settings->version == 16;
+    IOInitDone = settings->version == 17;
 
     settings_changed(settings);
 
@@ -1726,6 +1723,10 @@ bool driver_init (void)
     SysCtlDelay(26); // wait a bit for peripheral to wake up
     EEPROMInit();
 
+    // Enable the CRC module for EEPROM block checksums
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_CCM0);
+    SysCtlDelay(26); // wait a bit for peripheral to wake up
+
 #if USE_32BIT_TIMER && USE_PIOSC
     // Moved after EEPROM enable for giving time for 32768 Hz crystal to stabilize
     SysCtlPIOSCCalibrate(SYSCTL_PIOSC_CAL_AUTO);
@@ -1797,6 +1798,17 @@ bool driver_init (void)
 
     hal.system_control_get_state = systemGetState;
 
+#if ETHERNET_ENABLE
+    StreamMuxAdd(StreamType_Serial, serialWriteS, NULL);
+  #if TELNET_ENABLE
+    StreamMuxAdd(StreamType_Telnet, TCPStreamWriteS, TCPStreamTxFree);
+    StreamMuxAdd(StreamType_Null, TCPStreamWriteObservers, NULL);
+  #endif
+  #if WEBSOCKET_ENABLE
+    StreamMuxAdd(StreamType_WebSocket, WsStreamWriteS, WsStreamTxFree);
+  #endif
+#endif
+
     selectStream(StreamType_Serial);
 
     hal.eeprom.type = EEPROM_Physical;
@@ -1804,6 +1816,7 @@ bool driver_init (void)
     hal.eeprom.put_byte = eepromPutByte;
     hal.eeprom.memcpy_to_with_checksum = eepromWriteBlockWithChecksum;
     hal.eeprom.memcpy_from_with_checksum = eepromReadBlockWithChecksum;
+    hal.eeprom.checksum = eepromChecksum;
 
 #if ETHERNET_ENABLE
     hal.report_options = reportIP;
@@ -1811,7 +1824,7 @@ bool driver_init (void)
 
 #ifdef DRIVER_SETTINGS
     hal.eeprom.driver_area.address = GRBL_EEPROM_SIZE;
-    hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings_t) + 1;
+    hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings_t) + EEPROM_CHECKSUM_SIZE;
     hal.eeprom.driver_area.size = sizeof(driver_settings_t);
     hal.driver_setting = driver_setting;
     hal.driver_settings_report = driver_settings_report;
@@ -1890,7 +1903,7 @@ bool driver_init (void)
 #endif
 
     // no need to move version check before init - compiler will fail any signature mismatch for existing entries
-    return hal.version == 6;
+    return hal.version == 7;
 }
 
 /* interrupt handlers */
@@ -83,7 +83,9 @@ void eepromWriteBlockWithChecksum (uint32_t destination, uint8_t *source, uint32
     } else
         EEPROMProgram((uint32_t *)source, destination + EEPROMOFFSET, size);
 
-    eepromPutByte(destination + size, calc_checksum(source, size));
+    uint16_t checksum = calc_checksum(source, size);
+    eepromPutByte(destination + size, (uint8_t)checksum);
+    eepromPutByte(destination + size + 1, (uint8_t)(checksum >> 8));
 }
 
 bool eepromReadBlockWithChecksum (uint8_t *destination, uint32_t source, uint32_t size) {
@@ -106,5 +108,13 @@ bool eepromReadBlockWithChecksum (uint8_t *destination, uint32_t source, uint32_
     } else
         EEPROMRead((uint32_t *)destination, source + EEPROMOFFSET, size);
 
-    return calc_checksum(destination, size) == eepromGetByte(source + size);
+    return calc_checksum(destination, size) == (eepromGetByte(source + size) | (eepromGetByte(source + size + 1) << 8));
+}
+
+// CRC-16/CCITT of a block by the CRC module, set as hal.eeprom.checksum to be used by calc_checksum().
+uint16_t eepromChecksum (uint8_t *data, uint32_t size) {
+
+    CRCConfigSet(CCM0_BASE, CRC_CFG_INIT_1|CRC_CFG_TYPE_P1021|CRC_CFG_SIZE_8BIT);
+
+    return (uint16_t)CRCDataProcess(CCM0_BASE, (uint32_t *)data, size, false);
 }
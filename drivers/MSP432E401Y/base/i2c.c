@@ -44,12 +44,27 @@ typedef struct {
     bool getKeycode;
 #if KEYPAD_ENABLE
     keycode_callback_ptr keycode_callback;
+#endif
+#if TRINAMIC_ENABLE && TRINAMIC_I2C && TRINAMIC_ASYNC_IO
+    TMC2130_t *tmc_driver;
+    TMC2130_datagram_t *tmc_reg;
+    tmc_read_callback_ptr tmc_callback;
 #endif
     uint8_t buffer[8];
 } i2c_trans_t;
 
 static i2c_trans_t i2c;
 
+#if KEYPAD_ENABLE
+// Keycode read requested while the bus was busy, started by the interrupt handler when the current transfer completes
+static struct {
+    volatile bool pending;
+    uint8_t addr;
+    uint8_t keycode;
+    keycode_callback_ptr callback;
+} keypad = {0};
+#endif
+
 #define i2cIsBusy ((i2c.state != I2CState_Idle) || I2CMasterBusy(I2C0_BASE))
 
 static void I2C_interrupt_handler (void);
@@ -131,13 +146,29 @@ static uint8_t *I2C_ReadRegister (uint32_t i2cAddr, uint8_t bytes, bool block)
 
 #if KEYPAD_ENABLE
 
-void I2C_GetKeycode (uint32_t i2cAddr, keycode_callback_ptr callback)
+// Keycode is read to its own buffer so data from a pending foreground read is not overwritten
+static void I2C_ReceiveKeycode (void)
 {
-    while(i2cIsBusy);
+    keypad.pending = false;
 
-    i2c.keycode_callback = callback;
+    i2c.keycode_callback = keypad.callback;
+    i2c.data  = &keypad.keycode;
+    i2c.count = 1;
+    i2c.state = I2CState_ReceiveLast;
 
-    I2C_Receive(i2cAddr, 1, false);
+    I2CMasterSlaveAddrSet(I2C0_BASE, keypad.addr, true);
+    I2CMasterControl(I2C0_BASE, I2C_MASTER_CMD_SINGLE_RECEIVE);
+}
+
+// Called from the keypad interrupt, the read is deferred to the I2C interrupt handler if the bus is busy
+void I2C_GetKeycode (uint32_t i2cAddr, keycode_callback_ptr callback)
+{
+    keypad.addr = (uint8_t)i2cAddr;
+    keypad.callback = callback;
+    keypad.pending = true;
+
+    if(!i2cIsBusy && keypad.pending)
+        I2C_ReceiveKeycode();
 }
 
 #endif
@@ -195,6 +226,29 @@ static TMC2130_status_t I2C_TMC_WriteRegister (TMC2130_t *driver, TMC2130_datagr
     return status;
 }
 
+#if TRINAMIC_ASYNC_IO
+
+// Register is read to the transfer buffer by the interrupt handler, the payload is written and the callback
+// called when the transfer completes
+bool TMC_ReadRegisterAsync (TMC2130_t *driver, TMC2130_datagram_t *reg, tmc_read_callback_ptr callback)
+{
+    uint8_t i2creg;
+
+    if(i2cIsBusy || (i2creg = TMCI2C_GetMapAddress((uint8_t)(driver ? (uint32_t)driver->cs_pin : 0), reg->addr).value) == 0xFF)
+        return false;
+
+    i2c.tmc_driver = driver;
+    i2c.tmc_reg = reg;
+    i2c.tmc_callback = callback;
+    i2c.buffer[0] = i2creg;
+
+    I2C_ReadRegister(I2C_ADR_I2CBRIDGE, 5, false);
+
+    return true;
+}
+
+#endif
+
 void I2C_DriverInit (TMC_io_driver_t *driver)
 {
     driver->WriteRegister = I2C_TMC_WriteRegister;
@@ -240,6 +294,10 @@ static void I2C_interrupt_handler (void)
         case I2CState_AwaitCompletion:
             i2c.count = 0;
             i2c.state = I2CState_Idle;
+          #if KEYPAD_ENABLE
+            if(keypad.pending)
+                I2C_ReceiveKeycode();
+          #endif
             break;
 
         case I2CState_ReceiveNext:
@@ -261,6 +319,14 @@ static void I2C_interrupt_handler (void)
         case I2CState_ReceiveLast:
             *i2c.data = I2CMasterDataGet(I2C0_BASE);
             i2c.count = 0;
+          #if TRINAMIC_ENABLE && TRINAMIC_I2C && TRINAMIC_ASYNC_IO
+            if(i2c.tmc_callback) {
+                i2c.tmc_reg->payload.value = ((uint32_t)i2c.buffer[1] << 24) | ((uint32_t)i2c.buffer[2] << 16) |
+                                              ((uint32_t)i2c.buffer[3] << 8) | i2c.buffer[4];
+                i2c.tmc_callback(i2c.tmc_driver, i2c.tmc_reg);
+                i2c.tmc_callback = NULL;
+            }
+          #endif
             i2c.state = I2CState_Idle;
           #if KEYPAD_ENABLE
             if(i2c.keycode_callback) {
@@ -268,6 +334,8 @@ static void I2C_interrupt_handler (void)
                 i2c.keycode_callback(*i2c.data);
                 i2c.keycode_callback = NULL;
             }
+            if(keypad.pending)
+                I2C_ReceiveKeycode();
           #endif
             break;
     }
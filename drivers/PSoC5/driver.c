@@ -27,6 +27,12 @@
 #include "grbl.h"
 
 //#define HAS_KEYPAD //uncomment to enable I2C keypad for jogging etc.
+//#define STEP_DMA_ENABLE //uncomment to output step pulses by DMA, requires the StepDMA and StepDMA_Done components, see README.md
+
+// Max. number of ticks in a step pulse train output by DMA.
+#ifndef STEP_TRAIN_SIZE
+#define STEP_TRAIN_SIZE 256
+#endif
 
 // prescale step counter to 20Mhz (80 / (STEPPER_DRIVER_PRESCALER + 1))
 #define STEPPER_DRIVER_PRESCALER 3
@@ -38,6 +44,16 @@ static spindle_pwm_t spindle_pwm;
 static axes_signals_t next_step_outbits;
 static delay_t delay = { .ms = 1, .callback = NULL }; // NOTE: initial ms set to 1 for "resetting" systick timer on startup
 
+#ifdef STEP_DMA_ENABLE
+static axes_signals_t step_train_buffer[STEP_TRAIN_SIZE];
+static step_train_t step_train = {
+    .size = STEP_TRAIN_SIZE,
+    .step_outbits = step_train_buffer
+};
+static uint8 step_dma_ch, step_dma_td;
+static void stepperCyclesPerTick (uint32_t cycles_per_tick);
+#endif
+
 // Interrupt handler prototypes
 static void stepper_driver_isr (void);
 static void stepper_pulse_isr (void);
@@ -125,6 +141,64 @@ static void stepperEnable (axes_signals_t enable)
     StepperEnable_Write(enable.x);
 }
 
+#ifdef STEP_DMA_ENABLE
+
+/*
+  The step pulse trains rendered by st_segment_render() are output by DMA, one byte per stepper timer
+  terminal count is copied from the train to the StepOutput control register which starts the pulses in
+  the UDB logic as a write from the stepper driver interrupt does. The CPU is only interrupted at the end
+  of each train, to render the next, rather than for each tick. The train ends with the segment so the
+  tick period and direction are constant until it has been output.
+*/
+
+// Renders the next step pulse train and starts its output, the steppers are set idle if there is none.
+static void step_train_start (void)
+{
+    if(st_segment_render(&step_train)) {
+
+        if(step_train.new_block)
+            DirOutput_Write(step_train.dir_outbits.value);
+
+        stepperCyclesPerTick(step_train.cycles_per_tick);
+
+        CyDmaTdSetConfiguration(step_dma_td, step_train.ticks, CY_DMA_DISABLE_TD, TD_INC_SRC_ADR|StepDMA__TD_TERMOUT_EN);
+        CyDmaChSetInitialTd(step_dma_ch, step_dma_td);
+        CyDmaChEnable(step_dma_ch, 1);
+    }
+}
+
+// Called when a step pulse train has been output.
+static void step_dma_done_isr (void)
+{
+    step_train_start();
+}
+
+// The stepper driver interrupt is used for homing and probing as the probe input and homing axis locks
+// are only checked when a train is rendered.
+static inline bool step_dma_mode (void)
+{
+    return !(sys.state & STATE_HOMING) && sys_probing_state == Probing_Off;
+}
+
+static void stepperWakeUp ()
+{
+    StepperEnable_Write(On);
+
+    if(step_dma_mode()) {
+        Stepper_Interrupt_Disable();
+        StepperTimer_WritePeriod(5000); // dummy
+        StepperTimer_Enable();
+        step_train_start();
+    } else {
+        Stepper_Interrupt_Enable();
+        StepperTimer_WritePeriod(5000); // dummy
+        StepperTimer_Enable();
+        Stepper_Interrupt_SetPending();
+    }
+}
+
+#else
+
 // Sets up for a step pulse and forces a stepper driver interrupt, called from st_wake_up()
 // NOTE: delay and pulse_time are # of microseconds
 static void stepperWakeUp () 
@@ -144,6 +218,8 @@ static void stepperWakeUp ()
 
 }
 
+#endif
+
 
 // Sets up stepper driver interrupt timeout, called from stepper_driver_interrupt_handler()
 static void stepperCyclesPerTick (uint32_t cycles_per_tick)
@@ -358,6 +434,14 @@ static bool driver_setup (settings_t *settings)
     Stepper_Interrupt_SetPriority(1);
     Stepper_Interrupt_Enable();
 
+#ifdef STEP_DMA_ENABLE
+    step_dma_ch = StepDMA_DmaInitialize(1, 1, HI16(CYDEV_SRAM_BASE), HI16(CYDEV_PERIPH_BASE));
+    step_dma_td = CyDmaTdAllocate();
+    CyDmaTdSetAddress(step_dma_td, LO16((uint32)step_train_buffer), LO16((uint32)StepOutput_Control_PTR));
+    StepDMA_Done_StartEx(step_dma_done_isr);
+    StepDMA_Done_SetPriority(1);
+#endif
+
     if(hal.driver_cap.step_pulse_delay) {
     //    TimerIntRegister(TIMER2_BASE, TIMER_A, stepper_pulse_isr_delayed);
     //    TimerIntEnable(TIMER2_BASE, TIMER_TIMA_TIMEOUT|TIMER_TIMA_MATCH);
@@ -399,7 +483,7 @@ static bool driver_setup (settings_t *settings)
 
 #endif
 
-    return settings->version == 16;
+    return settings->version == 17;
 }
 
 // Initialize HAL pointers
@@ -483,7 +567,7 @@ bool driver_init (void)
 
     // No need to move version check before init.
     // Compiler will fail any signature mismatch for existing entries.
-    return hal.version == 6;
+    return hal.version == 7;
 }
 
 /* interrupt handlers */
@@ -44,7 +44,7 @@ static void keyclick_int_handler (void);
 static void claim_eeprom (void)
 {
     if(hal.eeprom.driver_area.size == 0) {
-        assert(EEPROM_SETTINGS - (sizeof(jog_settings_t) + 2) > EEPROM_ADDR_GLOBAL + sizeof(settings_t) + 1);
+        assert(EEPROM_SETTINGS - (sizeof(jog_settings_t) + 2) > EEPROM_ADDR_GLOBAL + sizeof(settings_t) + EEPROM_CHECKSUM_SIZE);
 
         hal.eeprom.driver_area.address = EEPROM_SETTINGS - (sizeof(jog_settings_t) + 2);
         hal.eeprom.driver_area.size = sizeof(jog_settings_t);
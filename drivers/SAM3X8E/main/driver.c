@@ -207,101 +207,116 @@ static void driver_delay_ms (uint32_t ms, void (*callback)(void))
         callback();
 }
 
-// Set stepper pulse output pins
-#ifdef SQUARING_ENABLED
-inline static void set_step_outputs (axes_signals_t step_outbits_1)
-{
-    axes_signals_t step_outbits_2;
+// Step and direction pins, ports are updated by one set and one clear register write each
+// with values looked up in tables built by stepdirMapInit(). Inversion is applied by the tables.
+// When squaring is enabled the ganged step pins are mapped separately so that they can be masked.
 
-    step_outbits_2.mask = (step_outbits_1.mask & motors_2.mask) ^= settings.steppers.step_invert.mask;
-    step_outbits_1.mask = (step_outbits_1.mask & motors_1.mask) ^= settings.steppers.step_invert.mask;
+#define STEPDIR_PORTS 4 // PIOA - PIOD
 
-    BITBAND_PERI(X_STEP_PORT->PIO_ODSR, X_STEP_PIN) = step_outbits_1.x;
-  #ifdef X2_STEP_PIN
-    BITBAND_PERI(X2_STEP_PORT->PIO_ODSR, X2_STEP_PIN) = step_outbits_2.x;
+static const stepdir_pin_t step_pins[] = {
+    { .axis = X_AXIS, .port = X_STEP_PORT, .bit = 1 << X_STEP_PIN },
+  #if defined(X2_STEP_PIN) && !defined(SQUARING_ENABLED)
+    { .axis = X_AXIS, .port = X2_STEP_PORT, .bit = 1 << X2_STEP_PIN },
   #endif
-
-    BITBAND_PERI(Y_STEP_PORT->PIO_ODSR, Y_STEP_PIN) = step_outbits_1.y;
-  #ifdef Y2_STEP_PIN
-    BITBAND_PERI(Y2_STEP_PORT->PIO_ODSR, Y2_STEP_PIN) = step_outbits_2.y;
+    { .axis = Y_AXIS, .port = Y_STEP_PORT, .bit = 1 << Y_STEP_PIN },
+  #if defined(Y2_STEP_PIN) && !defined(SQUARING_ENABLED)
+    { .axis = Y_AXIS, .port = Y2_STEP_PORT, .bit = 1 << Y2_STEP_PIN },
   #endif
- 
-    BITBAND_PERI(Z_STEP_PORT->PIO_ODSR, Z_STEP_PIN) = step_outbits_1.z;
-  #ifdef Z2_STEP_PIN
-    BITBAND_PERI(Z2_STEP_PORT->PIO_ODSR, Z2_STEP_PIN) = step_outbits_2.z;
+    { .axis = Z_AXIS, .port = Z_STEP_PORT, .bit = 1 << Z_STEP_PIN },
+  #if defined(Z2_STEP_PIN) && !defined(SQUARING_ENABLED)
+    { .axis = Z_AXIS, .port = Z2_STEP_PORT, .bit = 1 << Z2_STEP_PIN },
   #endif
-
   #ifdef A_STEP_PIN
-    BITBAND_PERI(A_STEP_PORT->PIO_ODSR, A_STEP_PIN) = step_outbits_1.a;
+    { .axis = A_AXIS, .port = A_STEP_PORT, .bit = 1 << A_STEP_PIN },
   #endif
   #ifdef B_STEP_PIN
-    BITBAND_PERI(B_STEP_PORT->PIO_ODSR, B_STEP_PIN) = step_outbits_1.b;
+    { .axis = B_AXIS, .port = B_STEP_PORT, .bit = 1 << B_STEP_PIN },
   #endif
   #ifdef C_STEP_PIN
-    BITBAND_PERI(C_STEP_PORT->PIO_ODSR, C_STEP_PIN) = step_outbits_1.c;
+    { .axis = C_AXIS, .port = C_STEP_PORT, .bit = 1 << C_STEP_PIN },
   #endif
-}
-#else // SQUARING DISABLED
-inline static void set_step_outputs (axes_signals_t step_outbits)
-{
-    step_outbits.value ^= settings.steppers.step_invert.mask;
+};
 
-    BITBAND_PERI(X_STEP_PORT->PIO_ODSR, X_STEP_PIN) = step_outbits.x;
+#ifdef SQUARING_ENABLED
+static const stepdir_pin_t step_pins_2[] = {
   #ifdef X2_STEP_PIN
-    BITBAND_PERI(X2_STEP_PORT->PIO_ODSR, X2_STEP_PIN) = step_outbits.x;
+    { .axis = X_AXIS, .port = X2_STEP_PORT, .bit = 1 << X2_STEP_PIN },
   #endif
-    
-    BITBAND_PERI(Y_STEP_PORT->PIO_ODSR, Y_STEP_PIN) = step_outbits.y;
   #ifdef Y2_STEP_PIN
-    BITBAND_PERI(Y2_STEP_PORT->PIO_ODSR, Y2_STEP_PIN) = step_outbits.y;
+    { .axis = Y_AXIS, .port = Y2_STEP_PORT, .bit = 1 << Y2_STEP_PIN },
   #endif
-
-    BITBAND_PERI(Z_STEP_PORT->PIO_ODSR, Z_STEP_PIN) = step_outbits.z;
   #ifdef Z2_STEP_PIN
-    BITBAND_PERI(Z2_STEP_PORT->PIO_ODSR, Z2_STEP_PIN) = step_outbits.z;
-  #endif 
-
-  #ifdef A_STEP_PIN
-    BITBAND_PERI(A_STEP_PORT->PIO_ODSR, A_STEP_PIN) = step_outbits.a;
-  #endif
-  #ifdef B_STEP_PIN
-    BITBAND_PERI(B_STEP_PORT->PIO_ODSR, B_STEP_PIN) = step_outbits.b;
+    { .axis = Z_AXIS, .port = Z2_STEP_PORT, .bit = 1 << Z2_STEP_PIN },
   #endif
-  #ifdef C_STEP_PIN
-    BITBAND_PERI(C_STEP_PORT->PIO_ODSR, C_STEP_PIN) = step_outbits.c;
-  #endif
-}
+};
 #endif
 
-// Set stepper direction output pins
-inline static void set_dir_outputs (axes_signals_t dir_outbits)
-{
-    dir_outbits.value ^= settings.steppers.dir_invert.mask;
-
-    BITBAND_PERI(X_DIRECTION_PORT->PIO_ODSR, X_DIRECTION_PIN) = dir_outbits.x;
+static const stepdir_pin_t dir_pins[] = {
+    { .axis = X_AXIS, .port = X_DIRECTION_PORT, .bit = 1 << X_DIRECTION_PIN },
   #ifdef X2_DIRECTION_PIN
-    BITBAND_PERI(X2_DIRECTION_PORT->PIO_ODSR, X2_DIRECTION_PIN) = dir_outbits.x;
+    { .axis = X_AXIS, .port = X2_DIRECTION_PORT, .bit = 1 << X2_DIRECTION_PIN },
   #endif
-
-    BITBAND_PERI(Y_DIRECTION_PORT->PIO_ODSR, Y_DIRECTION_PIN) = dir_outbits.y;
+    { .axis = Y_AXIS, .port = Y_DIRECTION_PORT, .bit = 1 << Y_DIRECTION_PIN },
   #ifdef Y2_DIRECTION_PIN
-    BITBAND_PERI(Y2_DIRECTION_PORT->PIO_ODSR, Y2_DIRECTION_PIN) = dir_outbits.y;
+    { .axis = Y_AXIS, .port = Y2_DIRECTION_PORT, .bit = 1 << Y2_DIRECTION_PIN },
   #endif
-
-    BITBAND_PERI(Z_DIRECTION_PORT->PIO_ODSR, Z_DIRECTION_PIN) = dir_outbits.z;
+    { .axis = Z_AXIS, .port = Z_DIRECTION_PORT, .bit = 1 << Z_DIRECTION_PIN },
   #ifdef Z2_DIRECTION_PIN
-    BITBAND_PERI(Z2_DIRECTION_PORT->PIO_ODSR, Z2_DIRECTION_PIN) = dir_outbits.z;
+    { .axis = Z_AXIS, .port = Z2_DIRECTION_PORT, .bit = 1 << Z2_DIRECTION_PIN },
   #endif
-
   #ifdef A_STEP_PIN
-    BITBAND_PERI(A_DIRECTION_PORT->PIO_ODSR, A_DIRECTION_PIN) = dir_outbits.a;
+    { .axis = A_AXIS, .port = A_DIRECTION_PORT, .bit = 1 << A_DIRECTION_PIN },
   #endif
   #ifdef B_STEP_PIN
-    BITBAND_PERI(B_DIRECTION_PORT->PIO_ODSR, B_DIRECTION_PIN) = dir_outbits.b;
+    { .axis = B_AXIS, .port = B_DIRECTION_PORT, .bit = 1 << B_DIRECTION_PIN },
   #endif
   #ifdef C_STEP_PIN
-    BITBAND_PERI(C_DIRECTION_PORT->PIO_ODSR, C_DIRECTION_PIN) = dir_outbits.c;
+    { .axis = C_AXIS, .port = C_DIRECTION_PORT, .bit = 1 << C_DIRECTION_PIN },
   #endif
+};
+
+static stepdir_port_t step_port[STEPDIR_PORTS], dir_port[STEPDIR_PORTS];
+static uint_fast8_t n_step_ports = 0, n_dir_ports = 0;
+#ifdef SQUARING_ENABLED
+static stepdir_port_t step_port_2[STEPDIR_PORTS];
+static uint_fast8_t n_step_ports_2 = 0;
+#endif
+
+static void stepdirMapInit (settings_t *settings)
+{
+    n_step_ports = n_dir_ports = 0; // Stop updates while the tables are rebuilt
+    n_step_ports = stepdir_map_init(step_port, STEPDIR_PORTS, step_pins, sizeof(step_pins) / sizeof(stepdir_pin_t), settings->steppers.step_invert);
+    n_dir_ports = stepdir_map_init(dir_port, STEPDIR_PORTS, dir_pins, sizeof(dir_pins) / sizeof(stepdir_pin_t), settings->steppers.dir_invert);
+#ifdef SQUARING_ENABLED
+    n_step_ports_2 = 0;
+    n_step_ports_2 = stepdir_map_init(step_port_2, STEPDIR_PORTS, step_pins_2, sizeof(step_pins_2) / sizeof(stepdir_pin_t), settings->steppers.step_invert);
+#endif
+}
+
+inline static void set_port_outputs (stepdir_port_t *port, uint_fast8_t n_ports, uint_fast8_t value)
+{
+    while(n_ports) {
+        n_ports--;
+        ((Pio *)port[n_ports].port)->PIO_SODR = port[n_ports].set[value];
+        ((Pio *)port[n_ports].port)->PIO_CODR = port[n_ports].reset[value];
+    }
+}
+
+// Set stepper pulse output pins
+inline static void set_step_outputs (axes_signals_t step_outbits)
+{
+#ifdef SQUARING_ENABLED
+    set_port_outputs(step_port, n_step_ports, step_outbits.mask & motors_1.mask);
+    set_port_outputs(step_port_2, n_step_ports_2, step_outbits.mask & motors_2.mask);
+#else
+    set_port_outputs(step_port, n_step_ports, step_outbits.mask);
+#endif
+}
+
+// Set stepper direction output pins
+inline static void set_dir_outputs (axes_signals_t dir_outbits)
+{
+    set_port_outputs(dir_port, n_dir_ports, dir_outbits.mask);
 }
 
 // Enable/disable stepper motors
@@ -486,8 +501,8 @@ inline static axes_signals_t limitsGetState()
 // Enable/disable motors for auto squaring of ganged axes
 static void StepperDisableMotors (axes_signals_t axes, squaring_mode_t mode)
 {
-    motors_1.mask = (mode == SquaringMode_A || mode == SquaringMode_Both ? axes.mask : 0);
-    motors_2.mask = (mode == SquaringMode_B || mode == SquaringMode_Both ? axes.mask : 0);
+    motors_1.mask = mode == SquaringMode_B ? motors_1.mask & ~axes.mask : motors_1.mask | axes.mask;
+    motors_2.mask = mode == SquaringMode_A ? motors_2.mask & ~axes.mask : motors_2.mask | axes.mask;
 /*
     if(hal.driver_cap.axis_ganged_x) {
         BITBAND_PERI(X_DISABLE_PORT->PIO_ODSR, X_DISABLE_PIN) = motors_1.x ^ settings.steppers.enable_invert.mask.x;
@@ -544,6 +559,35 @@ inline static axes_signals_t limitsGetHomeState()
     return signals_min;
 }
 
+// Returns limit state of motor A or B of ganged axes as an axes_signals_t variable.
+static axes_signals_t limitsGetSquaringState (squaring_mode_t motor)
+{
+    axes_signals_t signals;
+
+    signals.mask = settings.limits.invert.mask;
+
+    if(motor == SquaringMode_B) {
+#ifdef X_LIMIT_PIN_MAX
+        signals.x = BITBAND_PERI(X_LIMIT_PORT_MAX->PIO_PDSR, X_LIMIT_PIN_MAX);
+#endif
+#ifdef Y_LIMIT_PIN_MAX
+        signals.y = BITBAND_PERI(Y_LIMIT_PORT_MAX->PIO_PDSR, Y_LIMIT_PIN_MAX);
+#endif
+#ifdef Z_LIMIT_PIN_MAX
+        signals.z = BITBAND_PERI(Z_LIMIT_PORT_MAX->PIO_PDSR, Z_LIMIT_PIN_MAX);
+#endif
+    } else {
+        signals.x = BITBAND_PERI(X_LIMIT_PORT->PIO_PDSR, X_LIMIT_PIN);
+        signals.y = BITBAND_PERI(Y_LIMIT_PORT->PIO_PDSR, Y_LIMIT_PIN);
+        signals.z = BITBAND_PERI(Z_LIMIT_PORT->PIO_PDSR, Z_LIMIT_PIN);
+    }
+
+    if (settings.limits.invert.mask)
+        signals.mask ^= settings.limits.invert.mask;
+
+    return signals;
+}
+
 #endif
 
 // Enable/disable limit pins interrupt
@@ -862,6 +906,8 @@ void settings_changed (settings_t *settings)
 {
     if(IOInitDone) {
 
+        stepdirMapInit(settings);
+
       #if TRINAMIC_ENABLE
         trinamic_configure();
       #endif
@@ -1302,7 +1348,7 @@ static bool driver_setup (settings_t *settings)
 
  // Set defaults
 
-    IOInitDone = settings->version == 16;
+    IOInitDone = settings->version == 17;
 
     settings_changed(settings);
 
@@ -1499,6 +1545,7 @@ bool driver_init (void)
     hal.stepper_pulse_start = stepperPulseStart;
 #ifdef SQUARING_ENABLED
     hal.stepper_disable_motors = StepperDisableMotors;
+    hal.limits_get_squaring_state = limitsGetSquaringState;
 #endif
 
     hal.limits_enable = limitsEnable;
@@ -1570,7 +1617,7 @@ bool driver_init (void)
     if(hal.eeprom.type != EEPROM_None) {
         hal.eeprom.driver_area.address = GRBL_EEPROM_SIZE;
         hal.eeprom.driver_area.size = sizeof(driver_settings); // Add assert?
-        hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings) + 1;
+        hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings) + EEPROM_CHECKSUM_SIZE;
 
         hal.driver_setting = driver_setting;
         hal.driver_settings_report = driver_settings_report;
@@ -1633,7 +1680,7 @@ bool driver_init (void)
 
     // No need to move version check before init.
     // Compiler will fail any signature mismatch for existing entries.
-    return hal.version == 6;
+    return hal.version == 7;
 }
 
 /* interrupt handlers */
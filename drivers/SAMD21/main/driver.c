@@ -55,6 +55,8 @@ uint32_t vectorTable[sizeof(DeviceVectors) / sizeof(uint32_t)] __attribute__(( a
 
 static uint32_t lim_IRQMask = 0;
 static bool pwmEnabled = false, IOInitDone = false;
+static stepdir_port_t step_port[N_AXIS], dir_port[N_AXIS];
+static uint_fast8_t n_step_ports = 0, n_dir_ports = 0;
 // Inverts the probe pin state depending on user settings and probing cycle mode.
 static bool probe_invert, sd_detect = false;
 static axes_signals_t next_step_outbits;
@@ -104,23 +106,52 @@ static void driver_delay_ms (uint32_t ms, void (*callback)(void))
 }
 
 // Set stepper pulse output pins
+// Each port with step pins is updated by one OUTSET and one OUTCLR write, the values are looked
+// up in tables built by stepdirMapInit(). Inversion is applied by the tables.
 inline static void set_step_outputs (axes_signals_t step_outbits)
 {
-    step_outbits.value ^= settings.steppers.step_invert.mask;
+    uint_fast8_t idx = n_step_ports;
 
-    pinOut(X_STEP_PIN, step_outbits.x);
-    pinOut(Y_STEP_PIN, step_outbits.y);
-    pinOut(Z_STEP_PIN, step_outbits.z);
+    while(idx) {
+        idx--;
+        ((PortGroup *)step_port[idx].port)->OUTSET.reg = step_port[idx].set[step_outbits.value];
+        ((PortGroup *)step_port[idx].port)->OUTCLR.reg = step_port[idx].reset[step_outbits.value];
+    }
 }
 
 // Set stepper direction output pins
 inline static void set_dir_outputs (axes_signals_t dir_outbits)
 {
-    dir_outbits.value ^= settings.steppers.dir_invert.mask;
+    uint_fast8_t idx = n_dir_ports;
 
-    pinOut(X_DIRECTION_PIN, dir_outbits.x);
-    pinOut(Y_DIRECTION_PIN, dir_outbits.y);
-    pinOut(Z_DIRECTION_PIN, dir_outbits.z);
+    while(idx) {
+        idx--;
+        ((PortGroup *)dir_port[idx].port)->OUTSET.reg = dir_port[idx].set[dir_outbits.value];
+        ((PortGroup *)dir_port[idx].port)->OUTCLR.reg = dir_port[idx].reset[dir_outbits.value];
+    }
+}
+
+// Build the step and direction output tables from the Arduino pin numbers.
+static void stepdirMapInit (settings_t *settings)
+{
+    static const uint8_t step_pin[] = { X_STEP_PIN, Y_STEP_PIN, Z_STEP_PIN };
+    static const uint8_t dir_pin[] = { X_DIRECTION_PIN, Y_DIRECTION_PIN, Z_DIRECTION_PIN };
+
+    stepdir_pin_t step[sizeof(step_pin)], dir[sizeof(dir_pin)];
+    uint_fast8_t idx = sizeof(step_pin);
+
+    do {
+        idx--;
+        step[idx].axis = dir[idx].axis = idx;
+        step[idx].port = &PORT->Group[g_APinDescription[step_pin[idx]].ulPort];
+        step[idx].bit = 1 << g_APinDescription[step_pin[idx]].ulPin;
+        dir[idx].port = &PORT->Group[g_APinDescription[dir_pin[idx]].ulPort];
+        dir[idx].bit = 1 << g_APinDescription[dir_pin[idx]].ulPin;
+    } while(idx);
+
+    n_step_ports = n_dir_ports = 0; // Stop updates while the tables are rebuilt
+    n_step_ports = stepdir_map_init(step_port, N_AXIS, step, sizeof(step_pin), settings->steppers.step_invert);
+    n_dir_ports = stepdir_map_init(dir_port, N_AXIS, dir, sizeof(dir_pin), settings->steppers.dir_invert);
 }
 
 // Enable/disable stepper motors
@@ -541,6 +572,8 @@ void settings_changed (settings_t *settings)
 
     if(IOInitDone) {
 
+        stepdirMapInit(settings);
+
       #if TRINAMIC_ENABLE
         trinamic_configure();
       #endif
@@ -825,7 +858,7 @@ static bool driver_setup (settings_t *settings)
 
  // Set defaults
 
-    IOInitDone = settings->version == 16;
+    IOInitDone = settings->version == 17;
 
     settings_changed(settings);
 
@@ -1075,6 +1108,7 @@ bool driver_init (void) {
     hal.eeprom.put_byte = eepromPutByte;
     hal.eeprom.memcpy_to_with_checksum = eepromWriteBlockWithChecksum;
     hal.eeprom.memcpy_from_with_checksum = eepromReadBlockWithChecksum;
+    hal.eeprom.memcpy_from = eepromReadBlock;
 #else
     if(nvsInit()) {
         hal.eeprom.type = EEPROM_Emulated;
@@ -1093,7 +1127,7 @@ bool driver_init (void) {
     if(hal.eeprom.type != EEPROM_None) {
         hal.eeprom.driver_area.address = GRBL_EEPROM_SIZE;
         hal.eeprom.driver_area.size = sizeof(driver_settings); // Add assert?
-        hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings) + 1;
+        hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings) + EEPROM_CHECKSUM_SIZE;
 
         hal.driver_setting = driver_setting;
         hal.driver_settings_report = driver_settings_report;
@@ -1142,7 +1176,7 @@ bool driver_init (void) {
 
     // No need to move version check before init.
     // Compiler will fail any signature mismatch for existing entries.
-    return hal.version == 6;
+    return hal.version == 7;
 }
 
 /* interrupt handlers */
@@ -41,6 +41,9 @@
 // Set value to 1 to enable, 0 to disable
 
 #define USB_ENABLE      1
+#define USB_FLOW_CONTROL 0 // NAK USB OUT packets when the input buffer is nearly full, senders may then stream without character counting.
+#define SERIAL_DMA      0 // USART RX by circular DMA with idle line detection and TX by DMA, a few interrupts per line instead of one per character.
+#define STEP_DMA_ENABLE 0 // Step pulses output by DMA from pulse trains rendered by the core, one interrupt per train instead of one per tick.
 #define KEYPAD_ENABLE   0 // I2C keypad for jogging etc.
 #define TRINAMIC_ENABLE 0 // Trinamic TMC2130 stepper driver support. NOTE: work in progress.
 #define TRINAMIC_I2C    0 // Trinamic I2C - SPI bridge interface.
@@ -258,4 +261,8 @@ extern driver_settings_t driver_settings;
 
 bool driver_init (void);
 
+#if SDCARD_ENABLE
+void disk_set_wait_handler (void (*handler)(void));
+#endif
+
 #endif // __DRIVER_H__
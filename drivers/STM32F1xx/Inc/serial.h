@@ -29,10 +29,18 @@
 #define RX_BUFFER_HWM 900
 #define RX_BUFFER_LWM 300
 
+// Size of the circular DMA receive buffer, received characters are moved to the input buffer at half and full transfer and when the line goes idle.
+#ifndef SERIAL_DMA_RX_SIZE
+#define SERIAL_DMA_RX_SIZE 64
+#endif
+
 void serialInit(void);
 int16_t serialGetC(void);
+uint16_t serialReadBlock(char *buffer, uint16_t max);
 void serialWriteS(const char *s);
+void serialWrite(const char *s, uint16_t length);
 uint16_t serialRxFree(void);
+uint16_t serialTxFree(void);
 void serialRxFlush(void);
 void serialRxCancel(void);
 bool serialSuspendInput (bool suspend);
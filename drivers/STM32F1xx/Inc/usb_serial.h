@@ -26,9 +26,15 @@
 
 void usbInit (void);
 int16_t usbGetC(void);
+uint16_t usbReadBlock(char *buffer, uint16_t max);
 void usbWriteS(const char *s);
+void usbWriteN(const char *s, uint16_t length);
 uint16_t usbRxFree (void);
+uint16_t usbTxFree (void);
 void usbRxFlush(void);
 void usbRxCancel(void);
-void usbBufferInput (uint8_t *data, uint32_t length);
+bool usbBufferInput (uint8_t *data, uint32_t length);
 bool usbSuspendInput (bool suspend);
+#if USB_FLOW_CONTROL
+uint16_t usbRxLines (void);
+#endif
@@ -68,6 +68,7 @@ static bool probe_invert;
 static axes_signals_t next_step_outbits;
 static spindle_pwm_t spindle_pwm;
 static delay_t delay = { .ms = 1, .callback = NULL }; // NOTE: initial ms set to 1 for "resetting" systick timer on startup
+static periodic_t periodic = {0};
 static status_code_t (*syscmd)(uint_fast16_t state, char *line, char *lcline);
 
 #if STEP_OUTMODE == GPIO_MAP
@@ -160,8 +161,57 @@ static uint32_t dir_outmap[sizeof(c_dir_outmap) / sizeof(uint32_t)];
 
 #endif
 
+#if STEP_DMA_ENABLE
+
+#if STEP_OUTMODE == GPIO_BITBAND
+#error "STEP_DMA_ENABLE requires all step outputs on STEP_PORT!"
+#endif
+
+// Max. number of ticks in a step pulse train output by DMA.
+#ifndef STEP_TRAIN_SIZE
+#define STEP_TRAIN_SIZE 128
+#endif
+
+typedef struct {
+    uint32_t cycles_per_tick;
+    axes_signals_t dir_outbits;
+    bool new_block;
+    uint_fast16_t ticks;
+    uint32_t bsrr[STEP_TRAIN_SIZE];     // STEP_PORT BSRR words starting the step pulses of each tick
+} step_dma_train_t;
+
+static struct {
+    volatile bool active;               // A train is being output
+    bool ready;                         // The train in train[next] is rendered and waiting to be output
+    uint_fast8_t next;
+    uint32_t delay;                     // Step pulse delay in stepper timer cycles, at least 1
+    uint32_t pulse;                     // Step pulse time in stepper timer cycles
+    uint32_t pulse_end;                 // STEP_PORT BSRR word ending the step pulses
+    axes_signals_t outbits[STEP_TRAIN_SIZE];
+    step_dma_train_t train[2];
+} step_dma = {0};
+
+static step_train_t step_train = {
+    .size = STEP_TRAIN_SIZE,
+    .step_outbits = step_dma.outbits
+};
+
+#endif
+
 static void spindle_set_speed (uint_fast16_t pwm_value);
 
+#if SDCARD_ENABLE
+
+// Keep the step segment buffer filled while a SD card sector is transferred by DMA,
+// a sector read by the job prefetch or by the parser then does not starve the stepper.
+static void sdcard_io_wait (void)
+{
+    if(sys.state & (STATE_CYCLE|STATE_HOLD|STATE_JOG))
+        st_prep_buffer();
+}
+
+#endif
+
 static void driver_delay (uint32_t ms, void (*callback)(void))
 {
     if((delay.ms = ms) > 0) {
@@ -174,6 +224,27 @@ static void driver_delay (uint32_t ms, void (*callback)(void))
         callback();
 }
 
+static void driver_periodic_ms (uint32_t ms, void (*callback)(void))
+{
+    periodic.callback = NULL;
+    periodic.ms = periodic.period = ms;
+
+    if(ms)
+        periodic.callback = callback;
+}
+
+static uint32_t getElapsedTicks (void)
+{
+    return uwTick;
+}
+
+#if defined(ENABLE_PERF_COUNTERS) || defined(ENABLE_MOTION_TRACE)
+static uint32_t getCycleCount (void)
+{
+    return DWT->CYCCNT;
+}
+#endif
+
 // Enable/disable stepper motors
 static void stepperEnable (axes_signals_t enable)
 {
@@ -185,11 +256,127 @@ static void stepperEnable (axes_signals_t enable)
 #endif
 }
 
+#if STEP_DMA_ENABLE
+
+static void stepperCyclesPerTickPrescaled (uint32_t cycles_per_tick);
+inline static void stepperSetDirOutputs (axes_signals_t dir_outbits);
+
+/*
+  The step pulse trains rendered by st_segment_render() are output by DMA. Stepper timer compare 3, the step
+  pulse delay into each timer period, requests DMA1 channel 1 to copy the next word of the train to the step
+  port BSRR register which starts the step pulses of the tick. Compare 4, the step pulse time later, requests
+  DMA1 channel 7 to write the word ending them. The tick period, compare values and prescaler are preloaded
+  and change at the timer update following the last tick of a train, as they do when written by the stepper
+  driver interrupt. The train ends with the segment so the tick period and direction are constant until it
+  has been output.
+
+  Trains are double buffered, when one has been output the next is started and the one after that rendered
+  while it is output. The CPU is thus interrupted once per train rather than for each tick. A train is only
+  rendered ahead if there is a segment for it, st_segment_render() sets the steppers idle when there is none.
+*/
+
+// Returns the STEP_PORT BSRR word setting the step outputs to step_outbits, with the step invert mask applied.
+inline static uint32_t stepperBSRR (axes_signals_t step_outbits)
+{
+#if STEP_OUTMODE == GPIO_MAP
+    uint32_t outbits = step_outmap[step_outbits.value];
+#else
+    uint32_t outbits = (step_outbits.mask ^ settings.steppers.step_invert.mask) << STEP_OUTMODE;
+#endif
+
+    return outbits | ((STEP_MASK & ~outbits) << 16);
+}
+
+// Renders the next step pulse train to train[next]. Returns false, and the steppers are set idle, if there is none.
+static bool step_dma_render (void)
+{
+    step_dma_train_t *train = &step_dma.train[step_dma.next];
+
+    if((step_dma.ready = st_segment_render(&step_train))) {
+
+        uint_fast16_t idx = step_train.ticks;
+
+        train->cycles_per_tick = step_train.cycles_per_tick;
+        train->dir_outbits = step_train.dir_outbits;
+        train->new_block = step_train.new_block;
+        train->ticks = step_train.ticks;
+
+        do {
+            idx--;
+            train->bsrr[idx] = stepperBSRR(step_dma.outbits[idx]);
+        } while(idx);
+    }
+
+    return step_dma.ready;
+}
+
+// Starts output of the rendered train, its first tick is output in the timer period following the current one.
+static void step_dma_start (void)
+{
+    uint32_t shift, arr;
+    step_dma_train_t *train = &step_dma.train[step_dma.next];
+
+    if(train->new_block)
+        stepperSetDirOutputs(train->dir_outbits);
+
+    stepperCyclesPerTickPrescaled(train->cycles_per_tick);
+
+    shift = STEPPER_TIMER->PSC == 0 ? 0 : (STEPPER_TIMER->PSC == 7 ? 3 : 6);
+    arr = STEPPER_TIMER->ARR;
+    STEPPER_TIMER->CCR3 = min(step_dma.delay >> shift, arr);
+    STEPPER_TIMER->CCR4 = min((step_dma.delay + step_dma.pulse) >> shift, arr);
+
+    DMA1_Channel1->CCR = 0;
+    DMA1_Channel1->CMAR = (uint32_t)train->bsrr;
+    DMA1_Channel1->CNDTR = train->ticks;
+    DMA1_Channel1->CCR = DMA_CCR_PL_1|DMA_CCR_MSIZE_1|DMA_CCR_PSIZE_1|DMA_CCR_MINC|DMA_CCR_DIR|DMA_CCR_TCIE|DMA_CCR_EN;
+
+    step_dma.next ^= 1;
+    step_dma.ready = false;
+    step_dma.active = true;
+}
+
+// The stepper driver interrupt is used for homing and probing as the probe input and homing axis locks
+// are only checked when a train is rendered.
+static inline bool step_dma_mode (void)
+{
+    return !(sys.state & STATE_HOMING) && sys_probing_state == Probing_Off;
+}
+
+#endif
+
 // Starts stepper driver ISR timer and forces a stepper driver interrupt callback
 static void stepperWakeUp (void)
 {
     stepperEnable((axes_signals_t){AXES_BITMASK});
 
+#if STEP_DMA_ENABLE
+
+    if(step_dma_mode()) {
+
+        STEPPER_TIMER->DIER &= ~TIM_DIER_UIE;
+        STEPPER_TIMER->CR1 |= TIM_CR1_ARPE;
+
+        if(!step_dma.active && step_dma_render()) {
+            STEPPER_TIMER->PSC = 0;
+            STEPPER_TIMER->ARR = 5000; // delay to allow drivers time to wake up
+            STEPPER_TIMER->CCR3 = STEPPER_TIMER->CCR4 = 0xFFFF; // no tick in the first period
+            STEPPER_TIMER->EGR = TIM_EGR_UG;
+            step_dma_start();
+            // Render the second train before the timer is started, later trains are rendered by the DMA interrupt.
+            if(st_segment_ready())
+                step_dma_render();
+            STEPPER_TIMER->DIER |= TIM_DIER_CC3DE|TIM_DIER_CC4DE;
+            STEPPER_TIMER->CR1 |= TIM_CR1_CEN;
+        }
+        return;
+    }
+
+    STEPPER_TIMER->CR1 &= ~TIM_CR1_ARPE;
+    STEPPER_TIMER->DIER |= TIM_DIER_UIE;
+
+#endif
+
     STEPPER_TIMER->ARR = 5000; // delay to allow drivers time to wake up
     STEPPER_TIMER->EGR = TIM_EGR_UG;
     STEPPER_TIMER->CR1 |= TIM_CR1_CEN;
@@ -200,6 +387,19 @@ static void stepperWakeUp (void)
 // Disables stepper driver interrupts
 static void stepperGoIdle (bool clear_signals)
 {
+#if STEP_DMA_ENABLE
+    if(STEPPER_TIMER->DIER & TIM_DIER_CC3DE) {
+        uint32_t cnt;
+        STEPPER_TIMER->DIER &= ~TIM_DIER_CC3DE;
+        DMA1_Channel1->CCR = 0;
+        // Let a step pulse in progress complete before it is ended here.
+        while((STEPPER_TIMER->CR1 & TIM_CR1_CEN) && (cnt = STEPPER_TIMER->CNT) >= STEPPER_TIMER->CCR3 && cnt < STEPPER_TIMER->CCR4);
+        STEPPER_TIMER->DIER &= ~TIM_DIER_CC4DE;
+        STEP_PORT->BSRR = step_dma.pulse_end;
+        step_dma.active = step_dma.ready = false;
+    }
+#endif
+
     STEPPER_TIMER->CR1 &= ~TIM_CR1_CEN;
     STEPPER_TIMER->CNT = 0;
 }
@@ -594,6 +794,13 @@ void settings_changed (settings_t *settings)
         PULSE_TIMER->CCR1 = settings->steppers.pulse_delay_microseconds;
         PULSE_TIMER->EGR = TIM_EGR_UG;
 
+#if STEP_DMA_ENABLE
+        step_dma.delay = max((hal.f_step_timer / 1000000UL) * (hal.driver_cap.step_pulse_delay ? settings->steppers.pulse_delay_microseconds : 0), 1);
+        step_dma.pulse = (hal.f_step_timer / 1000000UL) * settings->steppers.pulse_microseconds;
+        step_dma.pulse_end = stepperBSRR((axes_signals_t){0});
+        STEP_PORT->BSRR = step_dma.pulse_end;
+#endif
+
         /*************************
          *  Control pins config  *
          *************************/
@@ -763,6 +970,25 @@ static bool driver_setup (settings_t *settings)
     STEPPER_TIMER->CNT = 0;
     STEPPER_TIMER->DIER |= TIM_DIER_UIE;
 
+#if STEP_DMA_ENABLE
+    // Compare 3 and 4 request the DMA transfers starting and ending the step pulses, see step_dma_start().
+    STEPPER_TIMER->CCMR2 = TIM_CCMR2_OC3PE|TIM_CCMR2_OC4PE; // Frozen output compare mode, preloaded.
+
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    DMA1_Channel1->CCR = 0;
+    DMA1_Channel1->CPAR = (uint32_t)&STEP_PORT->BSRR;
+
+    DMA1_Channel7->CCR = 0;
+    DMA1_Channel7->CPAR = (uint32_t)&STEP_PORT->BSRR;
+    DMA1_Channel7->CMAR = (uint32_t)&step_dma.pulse_end;
+    DMA1_Channel7->CNDTR = 1;
+    DMA1_Channel7->CCR = DMA_CCR_PL_1|DMA_CCR_MSIZE_1|DMA_CCR_PSIZE_1|DMA_CCR_CIRC|DMA_CCR_DIR|DMA_CCR_EN;
+
+    HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+#endif
+
     // Single-shot 1 us per tick
     PULSE_TIMER->CR1 |= TIM_CR1_OPM|TIM_CR1_DIR|TIM_CR1_CKD_1|TIM_CR1_ARPE|TIM_CR1_URS;
     PULSE_TIMER->PSC = hal.f_step_timer / 1000000UL - 1;
@@ -833,6 +1059,7 @@ static bool driver_setup (settings_t *settings)
 
     BITBAND_PERI(SD_CS_PORT->ODR, SD_CS_PIN) = 1;
 
+    disk_set_wait_handler(sdcard_io_wait);
     sdcard_init();
 
 #endif
@@ -846,7 +1073,7 @@ static bool driver_setup (settings_t *settings)
 
 #endif
 
-    IOInitDone = settings->version == 16;
+    IOInitDone = settings->version == 17;
 
     settings_changed(settings);
 
@@ -931,6 +1158,21 @@ bool driver_init (void)
     hal.f_step_timer = SystemCoreClock;
     hal.rx_buffer_size = RX_BUFFER_SIZE;
     hal.delay_ms = &driver_delay;
+    hal.periodic_ms = driver_periodic_ms;
+    hal.get_elapsed_ticks = getElapsedTicks;
+#ifdef ENABLE_MEMORY_USAGE
+    // Stack reserved by the linker script, it may grow further down into the heap.
+    extern uint8_t _estack, _Min_Stack_Size;
+    hal.stack.size = (uint32_t)&_Min_Stack_Size;
+    hal.stack.base = &_estack - hal.stack.size;
+#endif
+#if defined(ENABLE_PERF_COUNTERS) || defined(ENABLE_MOTION_TRACE)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    hal.f_cycle_counter = SystemCoreClock;
+    hal.get_cycle_count = getCycleCount;
+#endif
     hal.settings_changed = settings_changed;
 
     hal.stepper_wake_up = stepperWakeUp;
@@ -965,17 +1207,26 @@ bool driver_init (void)
 
 #if USB_ENABLE
     hal.stream.read = usbGetC;
+    hal.stream.read_block = usbReadBlock;
     hal.stream.write = usbWriteS;
+    hal.stream.write_n = usbWriteN;
     hal.stream.write_all = usbWriteS;
     hal.stream.get_rx_buffer_available = usbRxFree;
+    hal.stream.get_tx_buffer_available = usbTxFree;
     hal.stream.reset_read_buffer = usbRxFlush;
     hal.stream.cancel_read_buffer = usbRxCancel;
+#if USB_FLOW_CONTROL
+    hal.stream.get_rx_lines = usbRxLines;
+#endif
     hal.stream.suspend_read = usbSuspendInput;
 #else
     hal.stream.read = serialGetC;
+    hal.stream.read_block = serialReadBlock;
     hal.stream.write = serialWriteS;
+    hal.stream.write_n = serialWrite;
     hal.stream.write_all = serialWriteS;
     hal.stream.get_rx_buffer_available = serialRxFree;
+    hal.stream.get_tx_buffer_available = serialTxFree;
     hal.stream.reset_read_buffer = serialRxFlush;
     hal.stream.cancel_read_buffer = serialRxCancel;
     hal.stream.suspend_read = serialSuspendInput;
@@ -991,19 +1242,24 @@ bool driver_init (void)
     hal.eeprom.type = EEPROM_Emulated;
     hal.eeprom.memcpy_from_flash = memcpy_from_flash;
     hal.eeprom.memcpy_to_flash = memcpy_to_flash;
+    hal.eeprom.journal.base = flash_journal_base;
+    hal.eeprom.journal.sector_size = FLASH_JOURNAL_PAGES * FLASH_PAGE_SIZE;
+    hal.eeprom.journal.sectors = 2;
+    hal.eeprom.journal.erase = flash_journal_erase;
+    hal.eeprom.journal.program = flash_journal_program;
 #else
     hal.eeprom.type = EEPROM_None;
 #endif
 
 #ifdef DRIVER_SETTINGS
   #if !TRINAMIC_ENABLE
-    assert(EEPROM_ADDR_TOOL_TABLE - (sizeof(driver_settings_t) + 2) > EEPROM_ADDR_GLOBAL + sizeof(settings_t) + 1);
+    assert(EEPROM_ADDR_TOOL_TABLE - (sizeof(driver_settings_t) + 2) > EEPROM_ADDR_GLOBAL + sizeof(settings_t) + EEPROM_CHECKSUM_SIZE);
     hal.eeprom.driver_area.address = EEPROM_ADDR_TOOL_TABLE - (sizeof(driver_settings_t) + 2);
   #else
     hal.eeprom.driver_area.address = GRBL_EEPROM_SIZE;
   #endif
     hal.eeprom.driver_area.size = sizeof(driver_settings_t);
-    hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings_t) + 1;
+    hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings_t) + EEPROM_CHECKSUM_SIZE;
 
     hal.driver_setting = driver_setting;
     hal.driver_settings_report = driver_settings_report;
@@ -1044,7 +1300,7 @@ bool driver_init (void)
 
     // No need to move version check before init.
     // Compiler will fail any signature mismatch for existing entries.
-    return hal.version == 6;
+    return hal.version == 7;
 }
 
 /* interrupt handlers */
@@ -1060,6 +1316,24 @@ void TIM2_IRQHandler(void)
     }
 }
 
+#if STEP_DMA_ENABLE
+
+// Called when a step pulse train has been output, starts the next and renders the one after.
+void DMA1_Channel1_IRQHandler (void)
+{
+    DMA1->IFCR = DMA_IFCR_CGIF1;
+
+    step_dma.active = false;
+
+    if(step_dma.ready || step_dma_render())
+        step_dma_start();
+
+    if(step_dma.active && st_segment_ready())
+        step_dma_render();
+}
+
+#endif
+
 /* The Stepper Port Reset Interrupt: This interrupt handles the falling edge of the step
    pulse. This should always trigger before the next general stepper driver interrupt and independently
    finish, if stepper driver interrupts is disabled after completing a move.
@@ -1160,4 +1434,9 @@ void HAL_IncTick(void)
             delay.callback = NULL;
         }
     }
+
+    if(periodic.callback && !(--periodic.ms)) {
+        periodic.ms = periodic.period;
+        periodic.callback();
+    }
 }
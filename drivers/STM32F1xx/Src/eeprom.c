@@ -77,8 +77,11 @@ void eepromWriteBlockWithChecksum (uint32_t destination, uint8_t *source, uint32
         i2c.word_addr = destination & 0xFF;
     }
 
-    if(size > 0)
-        eepromPutByte(destination, calc_checksum(source, size));
+    if(size > 0) {
+        uint16_t checksum = calc_checksum(source, size);
+        eepromPutByte(destination, (uint8_t)checksum);
+        eepromPutByte(destination + 1, (uint8_t)(checksum >> 8));
+    }
 }
 
 bool eepromReadBlockWithChecksum (uint8_t *destination, uint32_t source, uint32_t size)
@@ -90,7 +93,7 @@ bool eepromReadBlockWithChecksum (uint8_t *destination, uint32_t source, uint32_
 
     I2C_EEPROM(&i2c, true);
 
-    return calc_checksum(destination, size) == eepromGetByte(source + size);
+    return calc_checksum(destination, size) == (eepromGetByte(source + size) | (eepromGetByte(source + size + 1) << 8));
 }
 
 #endif
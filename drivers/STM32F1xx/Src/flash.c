@@ -7,6 +7,7 @@
   Copyright (c) 2019 Terje Io
 
   This code reads/writes the whole RAM-based emulated EPROM contents from/to flash
+  and provides the flash area used for the settings journal
 
   Grbl is free software: you can redistribute it and/or modify
   it under the terms of the GNU General Public License as published by
@@ -30,6 +31,10 @@
 
 static const uint8_t *flash_target = (uint8_t *)(FLASH_BANK1_END - FLASH_PAGE_SIZE + 1);    // Last page start adress
 
+// The journal occupies the last 2 * FLASH_JOURNAL_PAGES pages, the last page is shared with the
+// single page storage above which is imported from if the journal is empty.
+const uint8_t *flash_journal_base = (uint8_t *)(FLASH_BANK1_END - 2 * FLASH_JOURNAL_PAGES * FLASH_PAGE_SIZE + 1);
+
 bool memcpy_from_flash (uint8_t *dest)
 {
     memcpy(dest, flash_target, hal.eeprom.size);
@@ -68,3 +73,39 @@ bool memcpy_to_flash (uint8_t *source)
 
     return status == HAL_OK;
 }
+
+bool flash_journal_erase (const uint8_t *sector)
+{
+    uint32_t error;
+    FLASH_EraseInitTypeDef erase = {
+        .Banks = FLASH_BANK_1,
+        .TypeErase = FLASH_TYPEERASE_PAGES,
+        .NbPages = FLASH_JOURNAL_PAGES,
+        .PageAddress = (uint32_t)sector
+    };
+
+    HAL_FLASH_Unlock();
+
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &error);
+
+    HAL_FLASH_Lock();
+
+    return status == HAL_OK;
+}
+
+bool flash_journal_program (const uint8_t *address, const uint8_t *data, uint32_t size)
+{
+    HAL_StatusTypeDef status = HAL_OK;
+
+    HAL_FLASH_Unlock();
+
+    for(; size && status == HAL_OK; size -= 2) {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, (uint32_t)address, data[0] | (data[1] << 8));
+        address += 2;
+        data += 2;
+    }
+
+    HAL_FLASH_Lock();
+
+    return status == HAL_OK;
+}
@@ -54,17 +54,26 @@ void i2c_init (void)
 
 #if EEPROM_ENABLE
 
+// Max number of times to address the EEPROM while it completes a write cycle, takes ~100 us each at 100 kHz.
+#define EEPROM_ACK_POLL_RETRIES 100
+
 void i2c_eeprom_transfer (i2c_eeprom_trans_t *i2c, bool read)
 {
+    static bool write_pending = false;
+
     while (HAL_I2C_GetState(&hi2c2) != HAL_I2C_STATE_READY);
 
-//    while (HAL_I2C_IsDeviceReady(&hi2c2, (uint16_t)(0xA0), 3, 100) != HAL_OK);
+    // Acknowledge polling: the EEPROM does not respond to its address until the previous write cycle is completed.
+    if(write_pending) {
+        write_pending = false;
+        HAL_I2C_IsDeviceReady(&hi2c2, i2c->address << 1, EEPROM_ACK_POLL_RETRIES, 10);
+    }
 
     if(read)
         HAL_I2C_Mem_Read(&hi2c2, i2c->address << 1, i2c->word_addr, I2C_MEMADD_SIZE_8BIT, i2c->data, i2c->count, 100);
     else {
         HAL_I2C_Mem_Write(&hi2c2, i2c->address << 1, i2c->word_addr, I2C_MEMADD_SIZE_8BIT, i2c->data, i2c->count, 100);
-        hal.delay_ms(5, NULL);
+        write_pending = true;
     }
     i2c->data += i2c->count;
 }
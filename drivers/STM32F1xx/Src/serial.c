@@ -33,6 +33,22 @@
 static stream_rx_buffer_t rxbuf = {0};
 static stream_tx_buffer_t txbuf = {0}, rxbackup;
 
+#if SERIAL_DMA
+
+/*
+  USART1 RX is served by DMA1 channel 5 in circular mode and TX by DMA1 channel 4.
+  Received characters are scanned for realtime commands and moved to the input buffer in batches, on the half
+  and full transfer interrupts and on the USART idle line interrupt. The idle line interrupt fires one character
+  time after the last character received so a single realtime command is handled without delay.
+  TX transfers the contiguous part of the output buffer, the next part is started from the transfer complete interrupt.
+*/
+
+static uint8_t dma_rx[SERIAL_DMA_RX_SIZE];
+static uint16_t dma_rx_tail = 0;
+static volatile uint16_t dma_tx_count = 0; // Characters in the current TX transfer, 0 when idle.
+
+#endif
+
 void serialInit (void)
 {
     __HAL_RCC_USART1_CLK_ENABLE();
@@ -51,7 +67,33 @@ void serialInit (void)
 
     USART1->CR1 |= (USART_CR1_RE|USART_CR1_TE);
     USART1->BRR = UART_BRR_SAMPLING16(HAL_RCC_GetPCLK2Freq(), 115200);
+
+#if SERIAL_DMA
+
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    DMA1->IFCR = DMA_IFCR_CGIF4|DMA_IFCR_CGIF5;
+
+    DMA1_Channel5->CPAR = (uint32_t)&USART1->DR;
+    DMA1_Channel5->CMAR = (uint32_t)dma_rx;
+    DMA1_Channel5->CNDTR = SERIAL_DMA_RX_SIZE;
+    DMA1_Channel5->CCR = DMA_CCR_PL_1|DMA_CCR_MINC|DMA_CCR_CIRC|DMA_CCR_HTIE|DMA_CCR_TCIE|DMA_CCR_EN;
+
+    DMA1_Channel4->CPAR = (uint32_t)&USART1->DR;
+    DMA1_Channel4->CCR = DMA_CCR_PL_0|DMA_CCR_MINC|DMA_CCR_DIR|DMA_CCR_TCIE;
+
+    USART1->CR3 |= (USART_CR3_DMAR|USART_CR3_DMAT);
+    USART1->CR1 |= (USART_CR1_UE|USART_CR1_IDLEIE);
+
+    // Same priority as the USART interrupt so that the receive handlers do not preempt each other.
+    HAL_NVIC_SetPriority(DMA1_Channel5_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+    HAL_NVIC_SetPriority(DMA1_Channel4_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+
+#else
     USART1->CR1 |= (USART_CR1_UE|USART_CR1_RXNEIE);
+#endif
 
     HAL_NVIC_SetPriority(USART1_IRQn, 0, 0);
     HAL_NVIC_EnableIRQ(USART1_IRQn);
@@ -66,6 +108,15 @@ uint16_t serialRxFree (void)
     return RX_BUFFER_SIZE - BUFCOUNT(head, tail, RX_BUFFER_SIZE);
 }
 
+//
+// Returns number of free characters in the output buffer
+//
+uint16_t serialTxFree (void)
+{
+    uint16_t tail = txbuf.tail, head = txbuf.head;
+    return (TX_BUFFER_SIZE - 1) - BUFCOUNT(head, tail, TX_BUFFER_SIZE);
+}
+
 //
 // Flushes the serial input buffer
 //
@@ -113,7 +164,12 @@ bool serialPutC (const char c)
 
         txbuf.data[txbuf.head] = c;                                     // Add data to buffer,
         txbuf.head = next_head;                                         // update head pointer and
+#if SERIAL_DMA
+        if(dma_tx_count == 0)                                           // start a DMA transfer if idle
+            NVIC_SetPendingIRQ(DMA1_Channel4_IRQn);
+#else
         USART1->CR1 |= USART_CR1_TXEIE;                                 // enable TX interrupts
+#endif
 //    }
 
     return true;
@@ -131,7 +187,7 @@ void serialWriteS (const char *s)
 }
 
 //
-// Writes a number of characters from string to the serial output stream followed by EOL, blocks if buffer full
+// Writes a number of characters from string to the serial output stream, blocks if buffer full
 //
 void serialWrite(const char *s, uint16_t length)
 {
@@ -157,45 +213,132 @@ int16_t serialGetC (void)
     return (int16_t)data;
 }
 
+//
+// serialReadBlock - reads up to max characters, ends after the first CR or LF
+//
+uint16_t serialReadBlock (char *buffer, uint16_t max)
+{
+    char c;
+    uint16_t count = 0, bptr = rxbuf.tail, head = rxbuf.head;
+
+    while(count < max && bptr != head) {
+        buffer[count++] = c = rxbuf.data[bptr];
+        bptr = (bptr + 1) & (RX_BUFFER_SIZE - 1);
+        if(c == ASCII_LF || c == ASCII_CR)
+            break;
+    }
+
+    rxbuf.tail = bptr;
+
+    return count;
+}
+
 // "dummy" version of serialGetC
 static int16_t serialGetNull (void)
 {
     return -1;
 }
 
+// "dummy" version of serialReadBlock
+static uint16_t serialReadBlockNull (char *buffer, uint16_t max)
+{
+    return 0;
+}
+
 bool serialSuspendInput (bool suspend)
 {
-    if(suspend)
+    if(suspend) {
         hal.stream.read = serialGetNull;
+        hal.stream.read_block = serialReadBlockNull;
+    }
     else if(rxbuf.backup)
         memcpy(&rxbuf, &rxbackup, sizeof(stream_rx_buffer_t));
 
     return rxbuf.tail != rxbuf.head;
 }
 
-void USART1_IRQHandler (void)
+// Adds a received character to the input buffer, realtime commands are stripped.
+inline static void serialRxChar (char data)
 {
-    if(USART1->SR & USART_SR_RXNE) {
+    uint16_t next_head = (rxbuf.head + 1) & (RX_BUFFER_SIZE - 1);       // Get and increment buffer pointer
 
-        uint16_t next_head = (rxbuf.head + 1) & (RX_BUFFER_SIZE - 1);   // Get and increment buffer pointer
+    if(rxbuf.tail == next_head)                                         // If buffer full
+        rxbuf.overflow = 1;                                             // flag overflow
+    else if(data == CMD_TOOL_ACK && !rxbuf.backup) {
 
-        if(rxbuf.tail == next_head) {                                   // If buffer full
-            rxbuf.overflow = 1;                                         // flag overflow
-            next_head =  USART1->DR;                                    // and do dummy read to clear interrupt
-        } else {
-            char data = USART1->DR;
-            if(data == CMD_TOOL_ACK && !rxbuf.backup) {
+        memcpy(&rxbackup, &rxbuf, sizeof(stream_rx_buffer_t));
+        rxbuf.backup = true;
+        rxbuf.tail = rxbuf.head;
+        hal.stream.read = serialGetC; // restore normal input
+        hal.stream.read_block = serialReadBlock;
 
-                memcpy(&rxbackup, &rxbuf, sizeof(stream_rx_buffer_t));
-                rxbuf.backup = true;
-                rxbuf.tail = rxbuf.head;
-                hal.stream.read = serialGetC; // restore normal input
+    } else if(!hal.stream.enqueue_realtime_command(data)) {             // Check and strip realtime commands,
+        rxbuf.data[rxbuf.head] = data;                                  // if not add data to buffer
+        rxbuf.head = next_head;                                         // and update pointer
+    }
+}
 
-            } else if(!hal.stream.enqueue_realtime_command(data)) {     // Check and strip realtime commands,
-                rxbuf.data[rxbuf.head] = data;                          // if not add data to buffer
-                rxbuf.head = next_head;                                 // and update pointer
-            }
-        }
+#if SERIAL_DMA
+
+// Moves the characters received by DMA since the last call to the input buffer.
+static void serialRxDMA (void)
+{
+    uint16_t head = SERIAL_DMA_RX_SIZE - DMA1_Channel5->CNDTR;
+
+    if(head == SERIAL_DMA_RX_SIZE)
+        head = 0;
+
+    while(dma_rx_tail != head) {
+        serialRxChar((char)dma_rx[dma_rx_tail]);
+        if(++dma_rx_tail == SERIAL_DMA_RX_SIZE)
+            dma_rx_tail = 0;
+    }
+}
+
+// RX half and full transfer
+void DMA1_Channel5_IRQHandler (void)
+{
+    DMA1->IFCR = DMA_IFCR_CGIF5;
+
+    serialRxDMA();
+}
+
+// TX transfer complete, or pended by serialPutC() to start a transfer
+void DMA1_Channel4_IRQHandler (void)
+{
+    DMA1->IFCR = DMA_IFCR_CGIF4;
+
+    if(dma_tx_count && DMA1_Channel4->CNDTR)    // Transfer in progress
+        return;
+
+    DMA1_Channel4->CCR &= ~DMA_CCR_EN;
+
+    uint16_t tail = (txbuf.tail + dma_tx_count) & (TX_BUFFER_SIZE - 1), head = txbuf.head;
+
+    txbuf.tail = tail;                          // Release the characters sent
+
+    if((dma_tx_count = head >= tail ? head - tail : TX_BUFFER_SIZE - tail)) {
+        DMA1_Channel4->CMAR = (uint32_t)&txbuf.data[tail];
+        DMA1_Channel4->CNDTR = dma_tx_count;
+        DMA1_Channel4->CCR |= DMA_CCR_EN;
+    }
+}
+
+void USART1_IRQHandler (void)
+{
+    if(USART1->SR & USART_SR_IDLE) {
+        (void)USART1->DR;                       // Clear idle flag
+        serialRxDMA();
+    }
+}
+
+#else
+
+void USART1_IRQHandler (void)
+{
+    if(USART1->SR & USART_SR_RXNE) {
+        char data = USART1->DR;
+        serialRxChar(data);
     }
 
     if((USART1->SR & USART_SR_TXE) && (USART1->CR1 & USART_CR1_TXEIE)) {
@@ -214,4 +357,6 @@ void USART1_IRQHandler (void)
    }
 }
 
+#endif
+
 #endif // __serial_h__
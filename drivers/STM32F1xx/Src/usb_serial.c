@@ -28,6 +28,7 @@
 #include "main.h"
 #include "usbd_cdc_if.h"
 #include "usb_device.h"
+#include "usb_serial.h"
 
 static stream_rx_buffer_t rxbuf = {0}, rxbackup;
 
@@ -41,6 +42,39 @@ typedef struct {
 
 usb_tx_buf txbuf = {0};
 
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+#if USB_FLOW_CONTROL
+
+/*
+  The OUT endpoint is not rearmed after a packet if the input buffer cannot take another full
+  packet, the host is then NAKed until the parser has consumed enough input. Complete lines are
+  counted by separate received and consumed counters so that each is only written from one context.
+*/
+
+static volatile bool rx_paused = false;
+static volatile uint16_t lines_received = 0;
+static uint16_t lines_consumed = 0;
+
+// Rearms the OUT endpoint if paused and there is room for a packet, call after input is consumed.
+static inline void usbRxResume (void)
+{
+    if(rx_paused && usbRxFree() > CDC_DATA_FS_MAX_PACKET_SIZE) {
+        rx_paused = false;
+        USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+    }
+}
+
+//
+// Returns number of complete lines in the input buffer
+//
+uint16_t usbRxLines (void)
+{
+    return lines_received - lines_consumed;
+}
+
+#endif
+
 void usbInit (void)
 {
     MX_USB_DEVICE_Init();
@@ -57,12 +91,26 @@ uint16_t usbRxFree (void)
     return RX_BUFFER_SIZE - BUFCOUNT(head, tail, RX_BUFFER_SIZE);
 }
 
+//
+// Returns number of free characters in the output buffer, none while a transfer is in progress
+//
+uint16_t usbTxFree (void)
+{
+    USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)hUsbDeviceFS.pClassData;
+
+    return hcdc && hcdc->TxState != 0 ? 0 : (USB_TXLEN - 1) - txbuf.length;
+}
+
 //
 // Flushes the input buffer
 //
 void usbRxFlush (void)
 {
     rxbuf.head = rxbuf.tail = 0;
+#if USB_FLOW_CONTROL
+    lines_consumed = lines_received;
+    usbRxResume();
+#endif
 }
 
 //
@@ -73,17 +121,19 @@ void usbRxCancel (void)
     rxbuf.data[rxbuf.head] = ASCII_CAN;
     rxbuf.tail = rxbuf.head;
     rxbuf.head = (rxbuf.tail + 1) & (RX_BUFFER_SIZE - 1);
+#if USB_FLOW_CONTROL
+    lines_consumed = lines_received;
+    usbRxResume();
+#endif
 }
 
 //
-// Writes a null terminated string to the USB output stream, blocks if buffer full
-// Buffers string up to EOL (LF) before transmitting
+// Writes a number of characters to the USB output stream, blocks if buffer full
+// Buffers output up to EOL (LF) before transmitting
 //
-void usbWriteS (const char *s)
+void usbWriteN (const char *s, uint16_t length)
 {
-    size_t length = strlen(s);
-
-    if(length + txbuf.length < USB_TXLEN) {
+    if(length && length + txbuf.length < USB_TXLEN) {
         memcpy(txbuf.s, s, length);
         txbuf.length += length;
         txbuf.s += length;
@@ -106,6 +156,14 @@ void usbWriteS (const char *s)
 //  while(CDC_Transmit_FS((uint8_t*)s, strlen(s)) == USBD_BUSY);
 }
 
+//
+// Writes a null terminated string to the USB output stream, blocks if buffer full
+//
+void usbWriteS (const char *s)
+{
+    usbWriteN(s, (uint16_t)strlen(s));
+}
+
 //
 // usbGetC - returns -1 if no data available
 //
@@ -119,26 +177,67 @@ int16_t usbGetC (void)
     char data = rxbuf.data[bptr++];             // Get next character, increment tmp pointer
     rxbuf.tail = bptr & (RX_BUFFER_SIZE - 1);   // and update pointer
 
+#if USB_FLOW_CONTROL
+    if(data == ASCII_LF)
+        lines_consumed++;
+    usbRxResume();
+#endif
+
     return (int16_t)data;
 }
 
+//
+// usbReadBlock - reads up to max characters, ends after the first CR or LF
+//
+uint16_t usbReadBlock (char *buffer, uint16_t max)
+{
+    char c;
+    uint16_t count = 0, bptr = rxbuf.tail, head = rxbuf.head;
+
+    while(count < max && bptr != head) {
+        buffer[count++] = c = rxbuf.data[bptr];
+        bptr = (bptr + 1) & (RX_BUFFER_SIZE - 1);
+        if(c == ASCII_LF || c == ASCII_CR)
+            break;
+    }
+
+    rxbuf.tail = bptr;
+
+#if USB_FLOW_CONTROL
+    if(count && buffer[count - 1] == ASCII_LF)
+        lines_consumed++;
+    usbRxResume();
+#endif
+
+    return count;
+}
+
 // "dummy" version of serialGetC
 static int16_t usbGetNull (void)
 {
     return -1;
 }
 
+// "dummy" version of usbReadBlock
+static uint16_t usbReadBlockNull (char *buffer, uint16_t max)
+{
+    return 0;
+}
+
 bool usbSuspendInput (bool suspend)
 {
-    if(suspend)
+    if(suspend) {
         hal.stream.read = usbGetNull;
+        hal.stream.read_block = usbReadBlockNull;
+    }
     else if(rxbuf.backup)
         memcpy(&rxbuf, &rxbackup, sizeof(stream_rx_buffer_t));
 
     return rxbuf.tail != rxbuf.head;
 }
 
-void usbBufferInput (uint8_t *data, uint32_t length)
+// Returns false if the OUT endpoint is to be left unarmed, flow control only.
+bool usbBufferInput (uint8_t *data, uint32_t length)
 {
     while(length--) {
 
@@ -153,12 +252,23 @@ void usbBufferInput (uint8_t *data, uint32_t length)
                 rxbuf.backup = true;
                 rxbuf.tail = rxbuf.head;
                 hal.stream.read = usbGetC; // restore normal input
+                hal.stream.read_block = usbReadBlock;
 
             } else if(!hal.stream.enqueue_realtime_command(*data)) {        // Check and strip realtime commands,
                 rxbuf.data[rxbuf.head] = *data;                             // if not add data to buffer
                 rxbuf.head = next_head;                                     // and update pointer
+#if USB_FLOW_CONTROL
+                if(*data == ASCII_LF)
+                    lines_received++;
+#endif
             }
         }
         data++;                                                             // next
     }
+
+#if USB_FLOW_CONTROL
+    return !(rx_paused = usbRxFree() <= CDC_DATA_FS_MAX_PACKET_SIZE);
+#else
+    return true;
+#endif
 }
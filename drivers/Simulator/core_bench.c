@@ -0,0 +1,474 @@
+/*
+  core_bench.c - Grbl parser, planner and segment generator throughput benchmark
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Replays a corpus of g-code programs through gc_execute_block(), the planner and st_prep_buffer()
+  with the validator null driver and reports parsed lines, planned blocks and prepped segments per
+  second along with peak planner and segment buffer occupancy.
+
+  The built-in corpus is generated on startup and is the same on every run: a 3D finishing toolpath,
+  a laser raster with per segment power changes in laser mode, arcs and drilling canned cycles.
+  g-code files given on the command line are replayed instead of the built-in corpus.
+
+  Lines are fed as by the protocol layer with a realtime checkpoint before each line. The stepper
+  ISR is called from the checkpoint until one segment has been completed, so the planner and the
+  segment buffer are kept full as on a machine that is streamed to faster than it can move.
+  Elapsed time thus includes executing the steps. Uses the default settings from defaults.h.
+  Counts and peaks are deterministic and can be compared across commits, rates depend on the host.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+
+#include "platform.h"
+#include "grbl/grbl.h"
+
+// Injected accessors for peeking inside the segment buffer:
+uint_fast16_t get_segment_buffer_count();
+
+typedef struct arg_vars {
+    uint32_t passes;
+} arg_vars_t;
+
+typedef struct {
+    const char *name;
+    bool laser_mode;
+    char **blocks;
+    uint32_t n_blocks;
+    uint32_t blocks_size;
+} program_t;
+
+typedef struct {
+    uint32_t lines;
+    uint32_t blocks;
+    uint32_t segments;
+    uint32_t errors;
+    uint_fast16_t peak_blocks;
+    uint_fast16_t peak_segments;
+} counts_t;
+
+arg_vars_t args;
+const char* progname;
+
+static program_t *programs = NULL;
+static uint32_t n_programs = 0;
+static counts_t counts;
+static bool stepper_running = false;
+
+int usage (const char* badarg)
+{
+    if (badarg)
+        printf("Unrecognized option %s\n", badarg);
+
+    printf("Usage: \n"
+     "%s <Options> [gcode_file...]\n"
+     "  Options:\n"
+     "    -n <passes> : number of times to replay each program. Default=3\n"
+     "\n  Replays the built-in corpus, or the given files, and reports parser, planner and\n"
+     "  segment generator throughput along with peak buffer occupancy\n",
+     progname);
+
+    return -1;
+}
+
+static void bench_write (const char *data)
+{
+}
+
+/* Corpus */
+
+static program_t *add_program (const char *name, bool laser_mode)
+{
+    if((programs = realloc(programs, (n_programs + 1) * sizeof(program_t))) == NULL) {
+        printf("Out of memory\n");
+        exit(-1);
+    }
+
+    memset(&programs[n_programs], 0, sizeof(program_t));
+    programs[n_programs].name = name;
+    programs[n_programs].laser_mode = laser_mode;
+
+    return &programs[n_programs++];
+}
+
+// Strips whitespace and comments and converts to upper case, as done by the protocol layer.
+static void preprocess (char *line)
+{
+    char c, *out = line;
+    bool comment = false;
+
+    while((c = *line++) && c != ';' && c != '\n' && c != '\r') {
+        if(comment)
+            comment = c != ')';
+        else if(c == '(')
+            comment = true;
+        else if(c > ' ')
+            *out++ = toupper(c);
+    }
+
+    *out = '\0';
+}
+
+static void add_block (program_t *program, const char *format, ...)
+{
+    char line[LINE_BUFFER_SIZE + 2];
+    va_list list;
+
+    va_start(list, format);
+    vsnprintf(line, sizeof(line), format, list);
+    va_end(list);
+
+    preprocess(line);
+
+    // Skip empty lines, program delimiters and system commands.
+    if(*line == '\0' || *line == '%' || *line == '$')
+        return;
+
+    if(program->n_blocks == program->blocks_size) {
+        program->blocks_size = program->blocks_size ? program->blocks_size * 2 : 4096;
+        if((program->blocks = realloc(program->blocks, program->blocks_size * sizeof(char *))) == NULL) {
+            printf("Out of memory\n");
+            exit(-1);
+        }
+    }
+
+    program->blocks[program->n_blocks++] = strdup(line);
+}
+
+static bool load_file (const char *name)
+{
+    FILE *file;
+    char line[LINE_BUFFER_SIZE + 2];
+    program_t *program;
+
+    if((file = fopen(name, "r")) == NULL) {
+        perror("fopen");
+        printf("Error opening : %s\n", name);
+        return false;
+    }
+
+    program = add_program(name, false);
+
+    while(fgets(line, sizeof(line), file))
+        add_block(program, "%s", line);
+
+    fclose(file);
+
+    return true;
+}
+
+// Zig-zag raster over a 50 x 50 mm surface, 0.25 mm stepover and segments.
+static void generate_finishing (void)
+{
+    uint32_t row, col;
+    float x, y;
+    program_t *program = add_program("3D finishing", false);
+
+    add_block(program, "G21G90G17G94");
+    add_block(program, "M3S12000");
+    add_block(program, "G0X0Y0Z5");
+    add_block(program, "G1Z0F500");
+    add_block(program, "F2000");
+
+    for(row = 0; row <= 200; row++) {
+        y = (float)row * 0.25f;
+        for(col = 0; col <= 200; col++) {
+            x = (float)(row & 1 ? 200 - col : col) * 0.25f;
+            add_block(program, "X%.3fY%.3fZ%.3f", x, y, 2.0f * sinf(x / 8.0f) * cosf(y / 6.0f) - 2.0f);
+        }
+    }
+
+    add_block(program, "G0Z5");
+    add_block(program, "M5");
+}
+
+// Bidirectional raster of a 40 x 40 mm image, 0.1 mm line spacing and power changes every 0.5 mm.
+static void generate_laser_raster (void)
+{
+    uint32_t row, col;
+    program_t *program = add_program("Laser raster", true);
+
+    add_block(program, "G21G90G17G94");
+    add_block(program, "G0X0Y0");
+    add_block(program, "M4S0");
+    add_block(program, "G1F6000");
+
+    for(row = 0; row < 400; row++) {
+        add_block(program, "G0X%.3fY%.3fS0", row & 1 ? 40.0f : 0.0f, (float)row * 0.1f);
+        for(col = 1; col <= 80; col++)
+            add_block(program, "G1X%.3fS%d", (float)(row & 1 ? 80 - col : col) * 0.5f,
+                       (int)((row * 7 + col * 13) % 1000));
+    }
+
+    add_block(program, "M5");
+}
+
+// Arcs of varying radius and sweep in both directions, full circles and helixes.
+static void generate_arcs (void)
+{
+    uint32_t idx;
+    float radius, angle, x = 0.0f, y = 0.0f, cx, cy;
+    program_t *program = add_program("Arcs", false);
+
+    add_block(program, "G21G90G17G94");
+    add_block(program, "M3S12000");
+    add_block(program, "G0X0Y0Z0");
+    add_block(program, "G1F1500");
+
+    for(idx = 0; idx < 2000; idx++) {
+        radius = 0.5f + (float)(idx % 20) * 0.5f;
+        angle = (float)(idx % 7 + 1) * 0.4f;
+        if(idx % 50 == 49)
+            add_block(program, "G2X%.3fY%.3fZ%.3fI%.3fJ0", x, y, -(float)(idx % 3), radius); // Helix
+        else {
+            // Center on the negative X side of the current position, sweep is alternating CW and CCW.
+            cx = x - radius;
+            cy = y;
+            add_block(program, "G%dX%.3fY%.3fI%.3fJ0", idx & 1 ? 2 : 3, cx + radius * cosf(idx & 1 ? -angle : angle),
+                       cy + radius * sinf(idx & 1 ? -angle : angle), -radius);
+            x = cx + radius * cosf(idx & 1 ? -angle : angle);
+            y = cy + radius * sinf(idx & 1 ? -angle : angle);
+        }
+    }
+
+    add_block(program, "G0Z5");
+    add_block(program, "M5");
+}
+
+// 30 x 30 hole grid with G81 drilling, every third row with G83 peck drilling.
+static void generate_drilling (void)
+{
+    uint32_t row, col;
+    program_t *program = add_program("Drilling", false);
+
+    add_block(program, "G21G90G17G94G98");
+    add_block(program, "M3S8000");
+    add_block(program, "G0X0Y0Z5");
+
+    for(row = 0; row < 30; row++) {
+        if(row % 3 == 2)
+            add_block(program, "G83X0Y%.3fZ-6R1Q1.5F300", (float)row * 5.0f);
+        else
+            add_block(program, "G81X0Y%.3fZ-3R1F300", (float)row * 5.0f);
+        for(col = 1; col < 30; col++)
+            add_block(program, "X%.3f", (float)(row & 1 ? 29 - col : col) * 5.0f);
+        add_block(program, "G80");
+    }
+
+    add_block(program, "G0Z5");
+    add_block(program, "M5");
+}
+
+/* Null driver hooks */
+
+static void bench_stepper_wake_up (void)
+{
+    stepper_running = true;
+}
+
+static void bench_stepper_go_idle (bool clear_signals)
+{
+    stepper_running = false;
+}
+
+static void bench_stepper_cycles_per_tick (uint32_t cycles_per_tick)
+{
+    counts.segments++;
+}
+
+static void bench_stepper_pulse_start (stepper_t *stepper)
+{
+    if(stepper->new_block) {
+        stepper->new_block = false;
+        counts.blocks++;
+    }
+}
+
+// Called at each realtime checkpoint, executes steps until a segment is completed.
+static void bench_realtime (uint_fast16_t state)
+{
+    uint32_t segments = counts.segments;
+    uint_fast16_t occupancy = plan_get_block_buffer_size() - plan_get_block_buffer_available();
+
+    if(occupancy > counts.peak_blocks)
+        counts.peak_blocks = occupancy;
+
+    if((occupancy = get_segment_buffer_count()) > counts.peak_segments)
+        counts.peak_segments = occupancy;
+
+    while(stepper_running && counts.segments == segments)
+        hal.stepper_interrupt_callback();
+}
+
+static void bench_reset (program_t *program)
+{
+    settings.flags.laser_mode = program->laser_mode;
+
+    memset(sys_position, 0, sizeof(sys_position));
+
+    sys.state = STATE_IDLE;
+    stepper_running = false;
+
+    plan_reset();
+    st_reset();
+    plan_sync_position();
+    gc_init(true);
+}
+
+static float run (program_t *program, counts_t *result)
+{
+    uint32_t pass, block;
+    char line[LINE_BUFFER_SIZE];
+
+    memset(&counts, 0, sizeof(counts_t));
+
+    clock_t start = clock();
+
+    for(pass = 0; pass < args.passes; pass++) {
+
+        bench_reset(program);
+
+        for(block = 0; block < program->n_blocks; block++) {
+            protocol_execute_realtime(); // End of line checkpoint, as in the protocol layer.
+            // Parse from a line buffer as the protocol layer does.
+            strcpy(line, program->blocks[block]);
+            if(gc_execute_block(line, NULL) != Status_OK)
+                counts.errors++;
+        }
+
+        protocol_buffer_synchronize();
+    }
+
+    float elapsed = (float)(clock() - start) / (float)CLOCKS_PER_SEC;
+
+    memcpy(result, &counts, sizeof(counts_t));
+    result->lines = program->n_blocks * args.passes;
+
+    return elapsed;
+}
+
+static void report (const char *name, counts_t *counts, float elapsed)
+{
+    printf("%-16s %8" PRIu32 " %8" PRIu32 " %9" PRIu32 " %10.0f %10.0f %11.0f %5d/%-5d %5d/%-5d %6" PRIu32 "\n",
+            name, counts->lines / args.passes, counts->blocks / args.passes, counts->segments / args.passes,
+            elapsed > 0.0f ? (float)counts->lines / elapsed : 0.0f,
+            elapsed > 0.0f ? (float)counts->blocks / elapsed : 0.0f,
+            elapsed > 0.0f ? (float)counts->segments / elapsed : 0.0f,
+            (int)counts->peak_blocks, (int)plan_get_block_buffer_size(),
+            (int)counts->peak_segments, SEGMENT_BUFFER_SIZE - 1,
+            counts->errors / args.passes);
+}
+
+int main (int argc, char *argv[])
+{
+    //defaults
+    args.passes = 3;
+
+    progname = argv[0];
+
+    while (argc > 2 && argv[1][0] == '-') {
+        switch(argv[1][1]) {
+
+            case 'n':
+                args.passes = (uint32_t)atol(argv[2]);
+                break;
+
+            default:
+                return usage(argv[1]);
+        }
+        argv += 2; argc -= 2;
+    }
+
+    if ((argc > 1 && argv[1][0] == '-') || args.passes == 0)
+        return usage(argc > 1 && argv[1][1] != 'h' ? argv[1] : NULL);
+
+    for(argv++; *argv; argv++) {
+        if(!load_file(*argv))
+            return -1;
+    }
+
+    if(n_programs == 0) {
+        generate_finishing();
+        generate_laser_raster();
+        generate_arcs();
+        generate_drilling();
+    }
+
+    memset(&hal, 0, sizeof(HAL));
+
+    hal.version = HAL_VERSION;
+    hal.stepper_interrupt_callback = stepper_driver_interrupt_handler;
+
+    if(!driver_init())
+       return -1;
+
+    hal.stream.write = bench_write;
+    hal.stream.write_all = bench_write;
+    hal.stream.enqueue_realtime_command = protocol_enqueue_realtime_command;
+
+    hal.stepper_wake_up = bench_stepper_wake_up;
+    hal.stepper_go_idle = bench_stepper_go_idle;
+    hal.stepper_cycles_per_tick = bench_stepper_cycles_per_tick;
+    hal.stepper_pulse_start = bench_stepper_pulse_start;
+    hal.execute_realtime = bench_realtime;
+
+    eeprom_emu_init();
+    report_init();
+    settings_init();
+
+    hal.report.status_message = report_status_message;
+    hal.report.feedback_message = report_feedback_message;
+
+    memset(&sys, 0, sizeof(system_t));
+    sys.override.feed_rate = DEFAULT_FEED_OVERRIDE;
+    sys.override.rapid_rate = DEFAULT_RAPID_OVERRIDE;
+    sys.override.spindle_rpm = DEFAULT_SPINDLE_RPM_OVERRIDE;
+
+    uint32_t idx;
+    float elapsed, total_elapsed = 0.0f;
+    counts_t result, total = {0};
+
+    printf("%-16s %8s %8s %9s %10s %10s %11s %11s %11s %6s\n", "Program", "Lines", "Blocks", "Segments",
+            "Lines/s", "Blocks/s", "Segments/s", "Peak blocks", "Peak segs", "Errors");
+
+    for(idx = 0; idx < n_programs; idx++) {
+
+        elapsed = run(&programs[idx], &result);
+        report(programs[idx].name, &result, elapsed);
+
+        total.lines += result.lines;
+        total.blocks += result.blocks;
+        total.segments += result.segments;
+        total.errors += result.errors;
+        total.peak_blocks = max(total.peak_blocks, result.peak_blocks);
+        total.peak_segments = max(total.peak_segments, result.peak_segments);
+        total_elapsed += elapsed;
+    }
+
+    report("Total", &total, total_elapsed);
+
+    return total.errors ? 1 : 0;
+}
@@ -20,17 +20,26 @@
 
 */
 
+#if defined(ENABLE_MEMORY_USAGE) && defined(PLAT_LINUX)
+#define _GNU_SOURCE // for pthread_getattr_np()
+#include <pthread.h>
+#endif
+
 #include "mcu.h"
 #include "driver.h"
 #include "serial.h"
 #include "eeprom.h"
 #include "grbl_eeprom_extensions.h"
 #include "platform.h"
+#include "simulator.h"
+#include "estimate.h"
+#include "grbl_interface.h"
 
 #include "grbl/grbl.h"
 
 static bool probe_invert;
 static delay_t delay = { .ms = 1, .callback = NULL }; // NOTE: initial ms set to 1 for "resetting" systick timer on startup
+static periodic_t periodic = {0};
 
 void SysTick_Handler (void);
 void Stepper_IRQHandler (void);
@@ -43,6 +52,7 @@ void Control_IRQHandler (void);
 static axes_signals_t motors_0 = {AXES_BITMASK}, motors_1 = {AXES_BITMASK};
 
 void Limits1_IRQHandler (void);
+void LaserPPI_IRQHandler (void);
 #endif
 
 static void driver_delay_ms (uint32_t ms, void (*callback)(void))
@@ -50,11 +60,23 @@ static void driver_delay_ms (uint32_t ms, void (*callback)(void))
     if((delay.ms = ms) > 0) {
         systick_timer.enable = 1;
         if(!(delay.callback = callback))
-            while(delay.ms);
+            while(delay.ms)
+                sim.on_delay();
     } else if(callback)
         callback();
 }
 
+static void driver_periodic_ms (uint32_t ms, void (*callback)(void))
+{
+    periodic.callback = NULL;
+    periodic.ms = periodic.period = ms;
+
+    if(ms && callback) {
+        periodic.callback = callback;
+        systick_timer.enable = 1;
+    }
+}
+
 inline static void set_step_outputs (axes_signals_t step_outbits_0)
 {
     axes_signals_t step_outbits_1;
@@ -111,8 +133,15 @@ static void stepperCyclesPerTick (uint32_t cycles_per_tick)
 // If spindle synchronized motion switch to PID version.
 static void stepperPulseStart (stepper_t *stepper)
 {
+    if(args.step_events)
+        grbl_step_event(stepper);
+
     if(stepper->new_block) {
         stepper->new_block = false;
+#ifdef ENABLE_NATIVE_ARCS
+        if(!stepper->exec_block->arc_chord)
+#endif
+        sim.block_count++;
         set_dir_outputs(stepper->dir_outbits);
     }
 
@@ -126,8 +155,15 @@ static void stepperPulseStart (stepper_t *stepper)
 // TODO: only delay after setting dir outputs?
 static void stepperPulseStartDelayed (stepper_t *stepper)
 {
+    if(args.step_events)
+        grbl_step_event(stepper);
+
     if(stepper->new_block) {
         stepper->new_block = false;
+#ifdef ENABLE_NATIVE_ARCS
+        if(!stepper->exec_block->arc_chord)
+#endif
+        sim.block_count++;
         set_dir_outputs(stepper->dir_outbits);
     }
 
@@ -137,6 +173,33 @@ static void stepperPulseStartDelayed (stepper_t *stepper)
     }
 }
 
+#ifdef ENABLE_LASER_PPI
+
+// Times the laser pulses of a step segment by a timer, the first after delay and then every period cycles.
+// The pulse length is not simulated, each pulse is reported at its start when step events are enabled.
+// NOTE: Called from the stepper interrupt, the timer is counted down later in the same tick.
+static void laserPulseTrain (uint32_t delay, uint32_t period, uint_fast16_t pulse_length)
+{
+    if(period == 0) {
+        timer[LASER_PPI_TIMER].enable = 0;
+        timer[LASER_PPI_TIMER].value = timer[LASER_PPI_TIMER].load = 0;
+        if(args.step_events)
+            grbl_laser_pulse(false);
+        return;
+    }
+
+    if(delay == 0) {
+        LaserPPI_IRQHandler();
+        delay = period;
+    }
+
+    timer[LASER_PPI_TIMER].load = period;
+    timer[LASER_PPI_TIMER].value = delay + 1;
+    timer[LASER_PPI_TIMER].enable = 1;
+}
+
+#endif
+
 static axes_signals_t limitsGetState()
 {
     axes_signals_t signals = {0};
@@ -154,35 +217,32 @@ static axes_signals_t limitsGetState()
 // Enable/disable motors for auto squaring of ganged axes
 static void StepperDisableMotors (axes_signals_t axes, squaring_mode_t mode)
 {
-    motors_0.mask = (mode == SquaringMode_A || mode == SquaringMode_Both ? axes.mask : 0);
-    motors_1.mask = (mode == SquaringMode_B || mode == SquaringMode_Both ? axes.mask : 0);
+    motors_0.mask = mode == SquaringMode_B ? motors_0.mask & ~axes.mask : motors_0.mask | axes.mask;
+    motors_1.mask = mode == SquaringMode_A ? motors_1.mask & ~axes.mask : motors_1.mask | axes.mask;
 }
 
-// Returns limit state as an axes_signals_t variable.
-// Each bitfield bit indicates an axis limit, where triggered is 1 and not triggered is 0.
-static axes_signals_t limitsGetHomeState()
+// Returns limit state of motor A or B of ganged axes as an axes_signals_t variable.
+static axes_signals_t limitsGetSquaringState (squaring_mode_t motor)
 {
-    axes_signals_t signals_min = {0}, signals_max = {0};
-    
-    if(motors_0.mask) {
-
-        signals_min.mask = gpio[LIMITS_PORT0].state.value;
+    axes_signals_t signals;
 
-        if (settings.limits.invert.mask)
-            signals_min.mask ^= settings.limits.invert.mask;
-    }
+    signals.mask = gpio[motor == SquaringMode_B ? LIMITS_PORT1 : LIMITS_PORT0].state.value;
 
-    if(motors_1.mask) {
+    if (settings.limits.invert.mask)
+        signals.mask ^= settings.limits.invert.mask;
 
-       signals_max.mask = gpio[LIMITS_PORT1].state.value;
+    return signals;
+}
 
-        if (settings.limits.invert.mask)
-            signals_max.mask ^= settings.limits.invert.mask;
-    }
+// Returns limit state as an axes_signals_t variable.
+// Each bitfield bit indicates an axis limit, where triggered is 1 and not triggered is 0.
+static axes_signals_t limitsGetHomeState()
+{
+    axes_signals_t signals;
 
-    signals_min.mask |= signals_max.mask;
+    signals.mask = (limitsGetSquaringState(SquaringMode_A).mask & motors_0.mask) | (limitsGetSquaringState(SquaringMode_B).mask & motors_1.mask);
 
-    return signals_min;
+    return signals;
 }
 
 #endif
@@ -327,6 +387,12 @@ bool driver_setup (settings_t *settings)
     timer[STEPPER_TIMER].irq_enable = 1;
     mcu_register_irq_handler(Stepper_IRQHandler, Timer0_IRQ);
 
+#ifdef ENABLE_LASER_PPI
+    timer[LASER_PPI_TIMER].prescaler = 0;
+    timer[LASER_PPI_TIMER].irq_enable = 1;
+    mcu_register_irq_handler(LaserPPI_IRQHandler, Timer1_IRQ);
+#endif
+
     gpio[STEPPER_ENABLE_PORT].dir.mask = AXES_BITMASK;
     gpio[STEP_PORT0].dir.mask = AXES_BITMASK;
     gpio[DIR_PORT].dir.mask = AXES_BITMASK;
@@ -361,14 +427,27 @@ bool driver_setup (settings_t *settings)
     hal.spindle_set_state((spindle_state_t){0}, 0.0f);
     hal.coolant_set_state((coolant_state_t){0});
 
-    return settings->version == 16;
+    return settings->version == 17;
 }
 
+#if defined(ENABLE_PERF_COUNTERS) || defined(ENABLE_MOTION_TRACE)
+// Host time, the simulated MCU has no cycle counter.
+static uint32_t getCycleCount (void)
+{
+    return platform_ns();
+}
+#endif
+
 // used to inject a sleep in grbl main loop, 
 // ensures hardware simulator gets some cycles in "parallel"
 void sim_process_realtime (uint_fast16_t state)
 {
-    platform_sleep(0);
+    sim.realtime_count++;
+
+    sim.on_realtime();
+
+    if(!(sim.estimate || sim.replay))
+        platform_sleep(0);
 }
 
 bool driver_init ()
@@ -387,7 +466,27 @@ bool driver_init ()
     hal.driver_setup = driver_setup;
     hal.rx_buffer_size = RX_BUFFER_SIZE;
     hal.f_step_timer = F_CPU;
+#if defined(ENABLE_MEMORY_USAGE) && defined(PLAT_LINUX)
+    {
+        // driver_init() runs in the grbl thread, use its stack.
+        pthread_attr_t attr;
+        void *stack;
+        size_t size;
+        if(pthread_getattr_np(pthread_self(), &attr) == 0) {
+            if(pthread_attr_getstack(&attr, &stack, &size) == 0) {
+                hal.stack.base = (uint8_t *)stack;
+                hal.stack.size = (uint32_t)size;
+            }
+            pthread_attr_destroy(&attr);
+        }
+    }
+#endif
+#if defined(ENABLE_PERF_COUNTERS) || defined(ENABLE_MOTION_TRACE)
+    hal.f_cycle_counter = 1000000000UL;
+    hal.get_cycle_count = getCycleCount;
+#endif
     hal.delay_ms = driver_delay_ms;
+    hal.periodic_ms = driver_periodic_ms;
     hal.settings_changed = settings_changed;
 
     hal.execute_realtime = sim_process_realtime;
@@ -399,6 +498,7 @@ bool driver_init ()
     hal.stepper_pulse_start = stepperPulseStart;
 #ifdef SQUARING_ENABLED
     hal.stepper_disable_motors = StepperDisableMotors;
+    hal.limits_get_squaring_state = limitsGetSquaringState;
 #endif
 
     hal.limits_enable = limitsEnable;
@@ -418,20 +518,30 @@ bool driver_init ()
 #else
     hal.spindle_update_rpm = spindleUpdateRPM;
 #endif
+#ifdef ENABLE_LASER_PPI
+    hal.laser_pulse_train = laserPulseTrain;
+#endif
 
     hal.system_control_get_state = systemGetState;
 /*
     hal.show_message = showMessage;
 */
     hal.stream.read = serialGetC;
+    hal.stream.read_block = serialReadBlock;
+    hal.stream.write_n = serialWriteN;
     hal.stream.get_rx_buffer_available = serialRxFree;
+    hal.stream.get_tx_buffer_available = serialTxFree;
     hal.stream.reset_read_buffer = serialRxFlush;
     hal.stream.cancel_read_buffer = serialRxCancel;
     hal.stream.write = serialWriteS;
     hal.stream.write_all = serialWriteS;
     hal.stream.suspend_read = serialSuspendInput;
 
+    if(sim.estimate)
+        estimate_stream_init();
+
     hal.eeprom.type = EEPROM_Physical;
+    hal.eeprom.size = MAX_EEPROM_SIZE;
     hal.eeprom.get_byte = eeprom_get_char;
     hal.eeprom.put_byte = eeprom_put_char;
     hal.eeprom.memcpy_to_with_checksum = memcpy_to_eeprom_with_checksum;
@@ -444,6 +554,7 @@ bool driver_init ()
   // driver capabilities, used for announcing and negotiating (with Grbl) driver functionality
 
     hal.driver_cap.amass_level = 3;
+    hal.driver_cap.step_timing = On;
     hal.driver_cap.spindle_dir = On;
 
     hal.driver_cap.variable_spindle = On;
@@ -464,7 +575,7 @@ bool driver_init ()
     hal.driver_cap.axis_ganged_x = On;
 #endif
     // no need to move version check before init - compiler will fail any signature mismatch for existing entries
-    return hal.version == 6;
+    return hal.version == 7;
 }
 
 // Main stepper driver
@@ -473,6 +584,17 @@ void Stepper_IRQHandler (void)
     hal.stepper_interrupt_callback();
 }
 
+#ifdef ENABLE_LASER_PPI
+
+// Laser PPI pulse timer
+void LaserPPI_IRQHandler (void)
+{
+    if(args.step_events)
+        grbl_laser_pulse(true);
+}
+
+#endif
+
 void Control_IRQHandler (void)
 {
     gpio[CONTROL_PORT].irq_state.value = ~CONTROL_MASK;
@@ -498,11 +620,18 @@ void Limits1_IRQHandler (void)
 // Interrupt handler for 1 ms interval timer
 void SysTick_Handler (void)
 {
-    if(!(--delay.ms)) {
-        systick_timer.enable = 0;
+    if(delay.ms && !(--delay.ms)) {
         if(delay.callback) {
             delay.callback();
             delay.callback = NULL;
         }
     }
+
+    if(periodic.callback && !(--periodic.ms)) {
+        periodic.ms = periodic.period;
+        periodic.callback();
+    }
+
+    if(delay.ms == 0 && periodic.callback == NULL)
+        systick_timer.enable = 0;
 }
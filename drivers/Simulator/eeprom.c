@@ -28,8 +28,7 @@
 #include <stdbool.h>
 
 #include "simulator.h"
-
-#define MAX_EEPROM_SIZE 4096   // 4KB EEPROM
+#include "eeprom.h"
 
 static FILE *eeprom_create_empty_file (void)
 {
@@ -2,6 +2,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#define MAX_EEPROM_SIZE 4096   // 4KB EEPROM
+
 void eeprom_close (void);
 uint8_t eeprom_get_char (uint32_t addr );
 void eeprom_put_char (uint32_t addr, uint8_t new_value );
\ No newline at end of file
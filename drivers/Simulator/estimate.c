@@ -0,0 +1,284 @@
+/*
+  estimate.c - cycle time estimation mode
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Runs a g-code file through the unmodified planner and step segment generator and reports how
+  long the stepper takes to execute it, acceleration and junction speeds included.
+
+  There is no hardware thread, the simulation is advanced by the grbl thread itself at each realtime
+  checkpoint and in busy delays, one timer event at a time. Input is read directly from the file as
+  if the sender were infinitely fast, the planner buffer is thus kept full as on a well fed machine.
+  The simulated clock only advances while motion is executing or a delay is running, parsing and
+  buffering takes no time. The result is independent of the host speed and repeatable.
+
+  Program pauses (M0, or M1 if enabled) are resumed immediately, operator time is not included.
+
+  The result is written to the block file when the end of the input is reached:
+
+    total,<seconds>
+    tool,<tool number>,<seconds>                    one record for each tool used
+    line,<line number>,<tool number>,<seconds>      one record for each line that takes time
+
+  Line numbers are the line numbers in the file, starting at 1, and not g-code N-words.
+  Time spent executing a block is booked against the line it was planned from, time spent
+  while no block is executing, in dwells and other delays, against the line being executed.
+  Blocks are tagged with the line in the order they are planned and the stepper driver counts
+  blocks as their execution starts, this since a planner block is discarded when it has been
+  converted to step segments, not when the last segment has been executed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simulator.h"
+#include "estimate.h"
+
+#include "grbl/grbl.h"
+
+#define ESTIMATE_MAX_TICKS (F_CPU / 1000) // Maximum ticks to advance at a time, 1 ms
+
+// Functions for peeking inside planner state:
+plan_block_t *get_block_buffer();
+plan_block_t *get_block_buffer_head();
+
+typedef struct {
+    uint32_t line;
+    tool_id_t tool;
+} block_source_t;
+
+typedef struct {
+    uint64_t ticks;
+    tool_id_t tool;
+} line_time_t;
+
+static struct {
+    FILE *file;
+    bool eof;
+    bool eol;                   // Last character passed to the parser was a LF
+    uint32_t lines_read;        // Number of LFs passed to the parser
+    uint32_t parser_line;       // Line currently executed by the parser
+    plan_block_t *head;         // Next planner block to be tagged with its source
+    block_source_t *source;     // Source line and tool of blocks planned, in the order planned
+    uint32_t source_size;
+    uint32_t queued;            // Number of blocks tagged
+    uint32_t block_offset;      // sim.block_count when the first tagged block was queued
+    line_time_t *line;
+    uint32_t line_size;
+    uint64_t tool_ticks[UINT16_MAX + 1]; // By tool number, tool_id_t
+} est = {0};
+
+/* Input stream */
+
+static int16_t estimate_getc (void)
+{
+    int c;
+
+    // Hold back input while a canned cycle is pending so that its moves are booked against the cycle line.
+    if(est.eof || mc_canned_pending())
+        return SERIAL_NO_DATA;
+
+    while((c = fgetc(est.file)) != EOF && hal.stream.enqueue_realtime_command((char)c));
+
+    if(c == EOF) {
+        est.eof = true;
+        if(est.eol)
+            return SERIAL_NO_DATA;
+        c = ASCII_LF; // Terminate the last line
+    }
+
+    if((est.eol = c == ASCII_LF))
+        est.lines_read++;
+
+    return (int16_t)c;
+}
+
+// The input buffer is always empty, the next line is read only when the parser asks for it.
+static uint16_t estimate_rx_free (void)
+{
+    return RX_BUFFER_SIZE - 1;
+}
+
+static void estimate_rx_nop (void)
+{
+}
+
+static void estimate_write (const char *s)
+{
+    while(*s)
+        sim.putchar(*s++);
+}
+
+static void estimate_write_n (const char *s, uint16_t length)
+{
+    while(length--)
+        sim.putchar(*s++);
+}
+
+void estimate_stream_init (void)
+{
+    hal.stream.read = estimate_getc;
+    hal.stream.read_block = NULL;
+    hal.stream.get_rx_buffer_available = estimate_rx_free;
+    hal.stream.get_tx_buffer_available = NULL;
+    hal.stream.reset_read_buffer = estimate_rx_nop;
+    hal.stream.cancel_read_buffer = estimate_rx_nop;
+    hal.stream.suspend_read = NULL;
+    hal.stream.write = estimate_write;
+    hal.stream.write_all = estimate_write;
+    hal.stream.write_n = estimate_write_n;
+}
+
+/* Time accounting */
+
+static line_time_t *get_line (uint32_t line)
+{
+    if(line >= est.line_size) {
+
+        uint32_t size = est.line_size ? est.line_size : 1024;
+
+        while(size <= line)
+            size <<= 1;
+
+        if((est.line = realloc(est.line, size * sizeof(line_time_t))) == NULL) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(-5);
+        }
+
+        memset(&est.line[est.line_size], 0, (size - est.line_size) * sizeof(line_time_t));
+        est.line_size = size;
+    }
+
+    return &est.line[line];
+}
+
+static inline bool motion_active (void)
+{
+    return !!(sys.state & (STATE_HOMING|STATE_CYCLE|STATE_HOLD|STATE_JOG));
+}
+
+// Tags blocks added to the planner since the previous call with the line that was executing.
+// Called at every realtime checkpoint, the parser passes one at the end of each line before executing it.
+static void tag_blocks (void)
+{
+    plan_block_t *head = get_block_buffer_head();
+
+    if(est.source == NULL) {
+        // Blocks queued are either in the planner buffer or converted to step segments, not yet executed
+        est.source_size = plan_get_block_buffer_size() + SEGMENT_BUFFER_SIZE;
+        if((est.source = calloc(est.source_size, sizeof(block_source_t))) == NULL) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(-5);
+        }
+        est.head = head;
+        est.block_offset = sim.block_count;
+    } else if(!motion_active() && plan_get_current_block() == NULL) {
+        // All blocks are executed or have been flushed by a reset, resync
+        est.head = head;
+        est.block_offset = sim.block_count - est.queued;
+    }
+
+    while(est.head != head) {
+        est.source[est.queued % est.source_size].line = est.parser_line;
+        est.source[est.queued % est.source_size].tool = gc_state.tool->tool;
+        est.queued++;
+        est.head = est.head->next;
+    }
+
+    est.parser_line = est.lines_read;
+}
+
+static void estimate_advance (void)
+{
+    uint64_t clock = sim.masterclock;
+    uint32_t executed = sim.block_count - est.block_offset;
+    block_source_t source = { .line = est.parser_line, .tool = gc_state.tool ? gc_state.tool->tool : 0 };
+
+    if(est.source && motion_active() && executed)
+        source = est.source[(executed - 1) % est.source_size];
+
+    sim_step(ESTIMATE_MAX_TICKS);
+
+    if(source.line) {
+        line_time_t *line = get_line(source.line);
+        line->ticks += sim.masterclock - clock;
+        line->tool = source.tool;
+        est.tool_ticks[source.tool] += sim.masterclock - clock;
+    }
+}
+
+static void estimate_report (FILE *out)
+{
+    uint32_t idx;
+    uint64_t total = 0;
+
+    for(idx = 0; idx <= UINT16_MAX; idx++)
+        total += est.tool_ticks[idx];
+
+    fprintf(out, "total,%.6f\n", (double)total / (double)F_CPU);
+
+    for(idx = 0; idx <= UINT16_MAX; idx++) {
+        if(est.tool_ticks[idx])
+            fprintf(out, "tool,%d,%.6f\n", idx, (double)est.tool_ticks[idx] / (double)F_CPU);
+    }
+
+    for(idx = 1; idx < est.line_size; idx++) {
+        if(est.line[idx].ticks)
+            fprintf(out, "line,%d,%d,%.6f\n", idx, est.line[idx].tool, (double)est.line[idx].ticks / (double)F_CPU);
+    }
+
+    fflush(out);
+}
+
+/* Simulator hooks */
+
+static void estimate_realtime (void)
+{
+    tag_blocks();
+
+    // No operator, resume immediately when a program pause has brought motion to a stop
+    if(sys.state == STATE_HOLD && sys.holding_state == Hold_Complete)
+        system_set_exec_state_flag(EXEC_CYCLE_START);
+
+    if(motion_active())
+        estimate_advance();
+    else if(est.eof && plan_get_current_block() == NULL) {
+        estimate_report(args.block_out_file);
+        shutdown_simulator();
+        exit(EXIT_SUCCESS);
+    }
+}
+
+uint32_t estimate_line (void)
+{
+    return est.parser_line;
+}
+
+void estimate_init (FILE *gcode_file)
+{
+    est.file = gcode_file;
+    est.eol = true;
+
+    sim.estimate = true;
+    sim.on_tick = sim_nop; // the block file is used for the result, no step or block output
+    sim.on_realtime = estimate_realtime;
+    sim.on_delay = estimate_advance;
+}
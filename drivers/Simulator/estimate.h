@@ -0,0 +1,37 @@
+/*
+  estimate.h - cycle time estimation mode
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef estimate_h
+#define estimate_h
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Sets up the simulator hooks for estimating the cycle time of the g-code read from gcode_file.
+void estimate_init (FILE *gcode_file);
+
+// Replaces the serial stream with direct input from the g-code file, called by driver_init().
+void estimate_stream_init (void);
+
+// Returns the number of the line executed by the parser, 0 before the first line.
+uint32_t estimate_line (void);
+
+#endif
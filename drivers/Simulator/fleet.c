@@ -0,0 +1,216 @@
+/*
+  fleet.c - cycle time estimates for a cell of machines, run in parallel
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Runs the cycle time estimate for each machine of a cell, up to one instance per host core at a time.
+
+  grbl keeps its state in globals, an instance is thus a child process forked from the simulator and not
+  a thread. The child runs the estimate as for --estimate, its result is written to a temporary file read
+  back by the parent when the child exits. As for --estimate the simulation is advanced one timer event at
+  a time by the grbl thread itself, not by the hardware thread ticking in real time, so instances are CPU
+  bound and independent of each other and throughput scales with the number of cores.
+
+  The cell is described by a text file with one machine per line, lines starting with # are comments:
+
+    <g-code file>[,<EEPROM file>]
+
+  Machines without an EEPROM file use the settings of the -e file. The EEPROM files should exist, the
+  instances sharing a missing file create it concurrently.
+
+  The result is written to the block file when all instances have completed:
+
+    fleet,<machines>,<cell cycle time in seconds>,<mean utilization>
+    machine,<n>,<g-code file>,<seconds>,<utilization>     one record for each machine, from 1
+    machine,<n>,<g-code file>,error                       if the estimate failed
+
+  The cell cycle time is the longest machine cycle time, utilization is the cycle time of a machine
+  divided by the cell cycle time.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "simulator.h"
+#include "fleet.h"
+
+typedef struct {
+    char gcode_file[256];
+    char eeprom_file[128];
+    pid_t pid;
+    FILE *result;
+    bool ok;
+    double seconds;
+} machine_t;
+
+static machine_t *machine = NULL;
+static uint32_t machines = 0;
+
+static bool load_cell (FILE *cell_file)
+{
+    char line[512], *eeprom;
+    uint32_t size = 0;
+
+    while(fgets(line, sizeof(line), cell_file)) {
+
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if(*line == '\0' || *line == '#')
+            continue;
+
+        if(machines == size) {
+            size = size ? size << 1 : 16;
+            if((machine = realloc(machine, size * sizeof(machine_t))) == NULL) {
+                fprintf(stderr, "Fatal: out of memory\n");
+                exit(-5);
+            }
+        }
+
+        memset(&machine[machines], 0, sizeof(machine_t));
+
+        if((eeprom = strchr(line, ',')))
+            *eeprom++ = '\0';
+
+        if(strlen(line) >= sizeof(machine->gcode_file) || (eeprom && strlen(eeprom) >= sizeof(machine->eeprom_file))) {
+            printf("File name too long: %s\n", line);
+            return false;
+        }
+
+        strcpy(machine[machines].gcode_file, line);
+        strcpy(machine[machines].eeprom_file, eeprom ? eeprom : args.eeprom_file);
+        machines++;
+    }
+
+    fclose(cell_file);
+
+    return machines > 0;
+}
+
+// Waits for an instance to exit and reads back its result.
+static void wait_instance (void)
+{
+    int status;
+    uint32_t idx;
+    char line[128];
+    pid_t pid = wait(&status);
+
+    for(idx = 0; idx < machines; idx++) {
+        if(machine[idx].pid == pid && machine[idx].result) {
+            if(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) {
+                rewind(machine[idx].result);
+                while(!machine[idx].ok && fgets(line, sizeof(line), machine[idx].result))
+                    machine[idx].ok = sscanf(line, "total,%lf", &machine[idx].seconds) == 1;
+            }
+            fclose(machine[idx].result);
+            machine[idx].result = NULL;
+            break;
+        }
+    }
+}
+
+static void fleet_report (FILE *out)
+{
+    uint32_t idx, ok = 0;
+    double cell = 0.0, utilization = 0.0;
+
+    for(idx = 0; idx < machines; idx++) {
+        if(machine[idx].ok && machine[idx].seconds > cell)
+            cell = machine[idx].seconds;
+    }
+
+    for(idx = 0; idx < machines; idx++) {
+        if(machine[idx].ok) {
+            ok++;
+            utilization += cell > 0.0 ? machine[idx].seconds / cell : 0.0;
+        }
+    }
+
+    fprintf(out, "fleet,%u,%.6f,%.4f\n", machines, cell, ok ? utilization / (double)ok : 0.0);
+
+    for(idx = 0; idx < machines; idx++) {
+        if(machine[idx].ok)
+            fprintf(out, "machine,%u,%s,%.6f,%.4f\n", idx + 1, machine[idx].gcode_file, machine[idx].seconds,
+                     cell > 0.0 ? machine[idx].seconds / cell : 0.0);
+        else
+            fprintf(out, "machine,%u,%s,error\n", idx + 1, machine[idx].gcode_file);
+    }
+
+    fflush(out);
+}
+
+FILE *fleet_run (FILE *cell_file, int workers)
+{
+    uint32_t idx, running = 0;
+    FILE *gcode_file;
+
+    if(!load_cell(cell_file)) {
+        printf("No machines in the cell file\n");
+        exit(-1);
+    }
+
+    if(workers <= 0 && (workers = (int)sysconf(_SC_NPROCESSORS_ONLN)) <= 0)
+        workers = 1;
+
+    fflush(NULL); // Do not duplicate buffered output in the children.
+
+    for(idx = 0; idx < machines; idx++) {
+
+        if(running == (uint32_t)workers) {
+            wait_instance();
+            running--;
+        }
+
+        if((machine[idx].result = tmpfile()) == NULL) {
+            perror("tmpfile");
+            exit(-5);
+        }
+
+        if((machine[idx].pid = fork()) == 0) {
+
+            // Instance, run the estimate with the result written to the temporary file.
+            if((gcode_file = fopen(machine[idx].gcode_file, "r")) == NULL)
+                exit(-1);
+
+            strcpy(args.eeprom_file, machine[idx].eeprom_file);
+            args.block_out_file = machine[idx].result;
+            args.serial_out_file = fopen("/dev/null", "w");
+
+            return gcode_file;
+        }
+
+        if(machine[idx].pid < 0) {
+            perror("fork");
+            fclose(machine[idx].result);
+            machine[idx].result = NULL;
+        } else
+            running++;
+    }
+
+    while(running--)
+        wait_instance();
+
+    fleet_report(args.block_out_file);
+
+    exit(EXIT_SUCCESS);
+}
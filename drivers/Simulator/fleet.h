@@ -0,0 +1,32 @@
+/*
+  fleet.h - cycle time estimates for a cell of machines, run in parallel
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef fleet_h
+#define fleet_h
+
+#include <stdio.h>
+
+// Runs the cycle time estimate for each machine listed in cell_file in a child process, up to workers
+// at a time or one per core if workers is 0. Returns the g-code file to estimate in a child, with the
+// result and EEPROM files set up, and exits when the report has been written in the parent.
+FILE *fleet_run (FILE *cell_file, int workers);
+
+#endif
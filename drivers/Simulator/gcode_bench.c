@@ -0,0 +1,189 @@
+/*
+  gcode_bench.c - Grbl g-code parser throughput benchmark
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Loads one or more g-code files and reports the number of blocks parsed per second by gc_execute_block().
+  Blocks are preprocessed as by the protocol layer before timing starts: whitespace and comments are
+  removed and letters converted to upper case. The parser is run in check mode so that no motion is
+  planned, this measures the parser only. Uses the default settings from defaults.h.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "platform.h"
+#include "grbl/grbl.h"
+
+typedef struct arg_vars {
+    uint32_t passes;
+} arg_vars_t;
+
+arg_vars_t args;
+const char* progname;
+
+static char **blocks = NULL;
+static uint32_t n_blocks = 0, blocks_size = 0;
+
+int usage (const char* badarg)
+{
+    if (badarg)
+        printf("Unrecognized option %s\n", badarg);
+
+    printf("Usage: \n"
+     "%s <Options> gcode_file [gcode_file...]\n"
+     "  Options:\n"
+     "    -n <passes> : number of times to parse the files. Default=10\n"
+     "\n  Reports g-code parser throughput in blocks per second\n",
+     progname);
+
+    return -1;
+}
+
+static void bench_write (const char *data)
+{
+}
+
+// Strips whitespace and comments and converts to upper case, as done by the protocol layer.
+static void preprocess (char *line)
+{
+    char c, *out = line;
+    bool comment = false;
+
+    while((c = *line++) && c != ';' && c != '\n' && c != '\r') {
+        if(comment)
+            comment = c != ')';
+        else if(c == '(')
+            comment = true;
+        else if(c > ' ')
+            *out++ = toupper(c);
+    }
+
+    *out = '\0';
+}
+
+static bool load_file (const char *name)
+{
+    FILE *file;
+    char line[LINE_BUFFER_SIZE + 2];
+
+    if((file = fopen(name, "r")) == NULL) {
+        perror("fopen");
+        printf("Error opening : %s\n", name);
+        return false;
+    }
+
+    while(fgets(line, sizeof(line), file)) {
+        preprocess(line);
+        // Skip empty lines, program delimiters and system commands.
+        if(*line == '\0' || *line == '%' || *line == '$')
+            continue;
+        if(n_blocks == blocks_size) {
+            blocks_size = blocks_size ? blocks_size * 2 : 4096;
+            if((blocks = realloc(blocks, blocks_size * sizeof(char *))) == NULL)
+                return false;
+        }
+        blocks[n_blocks++] = strdup(line);
+    }
+
+    fclose(file);
+
+    return true;
+}
+
+int main (int argc, char *argv[])
+{
+    //defaults
+    args.passes = 10;
+
+    progname = argv[0];
+
+    while (argc > 2 && argv[1][0] == '-') {
+        switch(argv[1][1]) {
+
+            case 'n':
+                args.passes = (uint32_t)atol(argv[2]);
+                break;
+
+            default:
+                return usage(argv[1]);
+        }
+        argv += 2; argc -= 2;
+    }
+
+    if (argc < 2 || argv[1][0] == '-' || args.passes == 0)
+        return usage(argc > 1 && argv[1][1] != 'h' ? argv[1] : NULL);
+
+    for(argv++; *argv; argv++) {
+        if(!load_file(*argv))
+            return -1;
+    }
+
+    memset(&hal, 0, sizeof(HAL));
+
+    hal.version = HAL_VERSION;
+
+    if(!driver_init())
+       return -1;
+
+    hal.stream.write = bench_write;
+    hal.stream.write_all = bench_write;
+
+    eeprom_emu_init();
+    report_init();
+    settings_init();
+
+    hal.report.status_message = report_status_message;
+    hal.report.feedback_message = report_feedback_message;
+
+    memset(&sys, 0, sizeof(system_t));
+    sys.override.feed_rate = DEFAULT_FEED_OVERRIDE;
+    sys.override.rapid_rate = DEFAULT_RAPID_OVERRIDE;
+    sys.override.spindle_rpm = DEFAULT_SPINDLE_RPM_OVERRIDE;
+
+    plan_reset();
+    st_reset();
+    gc_init(true);
+    sys.state = STATE_CHECK_MODE;
+
+    uint32_t pass, block, errors = 0;
+    char line[LINE_BUFFER_SIZE];
+
+    clock_t start = clock();
+
+    for(pass = 0; pass < args.passes; pass++) {
+        for(block = 0; block < n_blocks; block++) {
+            // Parse from a line buffer as the protocol layer does.
+            strcpy(line, blocks[block]);
+            if(gc_execute_block(line, NULL) != Status_OK && pass == 0)
+                errors++;
+        }
+    }
+
+    float elapsed = (float)(clock() - start) / (float)CLOCKS_PER_SEC;
+
+    printf("Parsed %" PRIu32 " blocks %" PRIu32 " times in %.3f s, %" PRIu32 " blocks failed: %.0f blocks/s\n",
+            n_blocks, args.passes, elapsed, errors, elapsed > 0.0f ? (float)n_blocks * (float)args.passes / elapsed : 0.0f);
+
+    return 0;
+}
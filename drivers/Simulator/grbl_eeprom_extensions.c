@@ -28,7 +28,7 @@
 void memcpy_to_eeprom_with_checksum(uint32_t destination, uint8_t *source, uint32_t size)
 {
     uint32_t dest = destination;
-    uint8_t checksum = calc_checksum(source, size);
+    uint16_t checksum = calc_checksum(source, size);
 
     for(; size > 0; size--)
         eeprom_put_char(dest++, *(source++));
@@ -40,7 +40,8 @@ hal.stream.write(uitoa(checksum));
 hal.stream.write(":");
 hal.stream.write(uitoa(*source));
 
-    eeprom_put_char(dest, checksum);
+    eeprom_put_char(dest, (uint8_t)checksum);
+    eeprom_put_char(dest + 1, (uint8_t)(checksum >> 8));
 }
 
 bool memcpy_from_eeprom_with_checksum(uint8_t *destination, uint32_t source, uint32_t size)
@@ -58,7 +59,7 @@ hal.stream.write(uitoa(checksum));
 hal.stream.write(":");
 hal.stream.write(uitoa(eeprom_get_char(source)));
 */
-    return calc_checksum(dest, sz) == eeprom_get_char(source);
+    return calc_checksum(dest, sz) == (eeprom_get_char(source) | (eeprom_get_char(source + 1) << 8));
 }
 
 // end of file
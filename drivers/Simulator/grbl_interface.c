@@ -23,17 +23,29 @@
 */
 
 #include <stdio.h>
+#include <inttypes.h>
 
 #include "mcu.h"
 #include "driver.h"
 #include "simulator.h"
+#include "grbl_interface.h"
+#include "trace_file.h"
 
 #include "grbl/grbl.h"
 
+// Bresenham counts in the stepper block are scaled up, see st_prep_buffer()
+#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+#define BRESENHAM_SCALE MAX_AMASS_LEVEL
+#else
+#define BRESENHAM_SCALE 1
+#endif
+
 int block_position[N_AXIS] = {0}; //step count after most recently planned block
 uint32_t block_number = 0;
 double next_print_time;
 
+static trace_file_t step_trace, block_trace; // Used when the trace format is not text
+
 static void print_steps(bool force);
 static void printBlock(void);
 
@@ -46,6 +58,28 @@ void grbl_app_init (void)
 {
     //setup local tacking vars
     next_print_time = args.step_time;
+
+    if(args.trace_format != TraceFormat_Text) {
+        trace_file_init(&step_trace, args.step_out_file, (trace_format_t)args.trace_format, N_AXIS, F_CPU);
+        trace_file_init(&block_trace, args.block_out_file, (trace_format_t)args.trace_format, N_AXIS, F_CPU);
+    }
+
+    if(args.step_events) {
+        next_print_time = 0.0; // no sampled positions
+        if(args.trace_format != TraceFormat_Text)
+            trace_write_clock(&step_trace);
+        else
+            fprintf(args.step_out_file, "# clock %d, %d\n", F_CPU, N_AXIS);
+    }
+}
+
+// Prints the position sampled at the report time.
+static void print_sample (int ocr)
+{
+    if(args.trace_format != TraceFormat_Text)
+        trace_write_sample(&step_trace, sim.sim_time, sys_position, ocr);
+    else
+        fprintf(args.step_out_file, "%12.5f %d, %d, %d, %d\n", sim.sim_time, sys_position[X_AXIS], sys_position[Y_AXIS], sys_position[Z_AXIS], ocr);
 }
 
 void grbl_per_tick (void)
@@ -53,6 +87,10 @@ void grbl_per_tick (void)
     //maybe print the position every tick
     print_steps(0);
 
+    //maybe print newest block, checked every tick since ticks without events are skipped
+    if(!sim.socket_fd || args.block_out_file != stdout)
+        printBlock();
+
     //TODO:
     //  set limit pins based on position,
     //  set probe pin when probing.
@@ -131,11 +169,7 @@ void grbl_per_byte (void)
                 sim.exit = exit_REQ;
                 break;
         }
-
-        if(args.block_out_file != stdout)
-            printBlock();   //maybe print newest block
-    } else
-        printBlock();   //maybe print newest block
+    }
 }
 
 void grbl_app_exit (void)
@@ -153,7 +187,7 @@ static void print_steps (bool force)
     int ocr = 0;
 
     //Allow exit when idle. Prevents aborting before all streamed commands have run
-    if (sim.exit == exit_REQ && sys.state < STATE_HOMING )
+    if (sim.exit == exit_REQ && sys.state < STATE_HOMING && current_block == NULL && hal.stream.get_rx_buffer_available() == RX_BUFFER_SIZE - 1)
         sim.exit = exit_OK;
 
     if (next_print_time == 0.0)
@@ -166,24 +200,104 @@ static void print_steps (bool force)
     if (current_block != printed_block) {
         //new block. 
         if (block_number) //print values from the end of prev block
-            fprintf(args.step_out_file, "%12.5f %d, %d, %d, %d\n", sim.sim_time, sys_position[X_AXIS], sys_position[Y_AXIS], sys_position[Z_AXIS],ocr);
+            print_sample(ocr);
 
         printed_block = current_block;
         if (current_block == NULL)
             return;
         // print header
-        fprintf(args.step_out_file, "# block number %d\n", block_number++);
+        if(args.trace_format != TraceFormat_Text) {
+            trace_write_block_number(&step_trace);
+            block_number++;
+        } else
+            fprintf(args.step_out_file, "# block number %d\n", block_number++);
     }
     //print at correct interval while executing block
     else if ((current_block && sim.sim_time>=next_print_time) || force ) {
-        fprintf(args.step_out_file, "%12.5f %d, %d, %d, %d\n", sim.sim_time, sys_position[X_AXIS], sys_position[Y_AXIS], sys_position[Z_AXIS], ocr);
-        fflush(args.step_out_file);
+        print_sample(ocr);
+        if(args.trace_format == TraceFormat_Text)
+            fflush(args.step_out_file);
         //make sure the simulation time doesn't get ahead of next_print_time
         while (next_print_time <= sim.sim_time)
             next_print_time += args.step_time;
     }
 }
 
+/* Print the step pulse about to be output, and the block and segment it belongs to when changed.
+
+   # block <number> <steps>, ...                                   signed steps per axis
+   # backlash <steps>, ...                                         backlash take-up steps per axis, if any
+   # segment <id>, <steps>, <cycles per tick>, <AMASS level>
+   <master clock> <position>, ...                                  position after the step
+
+   The system position is updated when the step bits are generated, one tick ahead of the output.
+   Backlash take-up steps are output ahead of the block steps and do not change the system position.
+*/
+
+// Returns the signed steps of an axis in the block executing.
+static int32_t block_steps (stepper_t *stepper, uint_fast8_t idx)
+{
+    return (int32_t)(stepper->exec_block->steps[idx] >> BRESENHAM_SCALE) * stepper->exec_block->position_delta[idx];
+}
+
+void grbl_step_event (stepper_t *stepper)
+{
+    static uint32_t number = 0;
+    static segment_t *segment = NULL;
+
+    uint_fast8_t idx;
+
+    if(args.trace_format != TraceFormat_Text) {
+
+        if(stepper->new_block && stepper->exec_block) {
+            int32_t steps[N_AXIS];
+            for(idx = 0; idx < N_AXIS; idx++)
+                steps[idx] = block_steps(stepper, idx);
+            trace_write_step_block(&step_trace, steps);
+            segment = NULL;
+        }
+
+        if(stepper->exec_segment && stepper->exec_segment != segment) {
+            segment = stepper->exec_segment;
+            trace_write_segment(&step_trace, segment->id, segment->n_step, segment->cycles_per_tick, segment->amass_level);
+        }
+
+        if(stepper->step_outbits.value)
+            trace_write_step(&step_trace, sim.masterclock, sys_position);
+
+        return;
+    }
+
+    if(stepper->new_block && stepper->exec_block) {
+        fprintf(args.step_out_file, "# block %d", number++);
+        for(idx = 0; idx < N_AXIS; idx++)
+            fprintf(args.step_out_file, idx ? ", %d" : " %d", block_steps(stepper, idx));
+        fputc('\n', args.step_out_file);
+#ifdef ENABLE_BACKLASH_COMPENSATION
+        for(idx = 0; idx < N_AXIS && !stepper->exec_block->backlash_steps[idx]; idx++);
+        if(idx < N_AXIS) {
+            fputs("# backlash", args.step_out_file);
+            for(idx = 0; idx < N_AXIS; idx++)
+                fprintf(args.step_out_file, idx ? ", %d" : " %d", (int)stepper->exec_block->backlash_steps[idx]);
+            fputc('\n', args.step_out_file);
+        }
+#endif
+        segment = NULL;
+    }
+
+    if(stepper->exec_segment && stepper->exec_segment != segment) {
+        segment = stepper->exec_segment;
+        fprintf(args.step_out_file, "# segment %d, %d, %d, %d\n", (int)segment->id, (int)segment->n_step, segment->cycles_per_tick, (int)segment->amass_level);
+    }
+
+    if(stepper->step_outbits.value) {
+        fprintf(args.step_out_file, "%" PRIu64, sim.masterclock);
+        for(idx = 0; idx < N_AXIS; idx++)
+            fprintf(args.step_out_file, idx ? ", %d" : " %d", sys_position[idx]);
+        fputc('\n', args.step_out_file);
+    }
+}
+
 static plan_block_t *plan_get_recent_block (void)
 {
     return get_block_buffer_head() == get_block_buffer_tail() ? NULL : get_block_buffer_head()->prev;
@@ -191,6 +305,16 @@ static plan_block_t *plan_get_recent_block (void)
 
 // Print information about the most recently inserted block
 // but only once!
+void grbl_laser_pulse (bool on)
+{
+    if(args.trace_format != TraceFormat_Text)
+        trace_write_pulse(&step_trace, on, sim.masterclock);
+    else if(on)
+        fprintf(args.step_out_file, "# pulse %" PRIu64 "\n", sim.masterclock);
+    else
+        fprintf(args.step_out_file, "# pulse off\n");
+}
+
 static void printBlock (void)
 {
     static plan_block_t *last_block;
@@ -203,10 +327,15 @@ static void printBlock (void)
                 block_position[i] -= b->steps[i];
             else
                 block_position[i] += b->steps[i];
-            fprintf(args.block_out_file,"%d, ", block_position[i]);
+            if(args.trace_format == TraceFormat_Text)
+                fprintf(args.block_out_file,"%d, ", block_position[i]);
+        }
+        if(args.trace_format != TraceFormat_Text)
+            trace_write_plan_block(&block_trace, (int32_t *)block_position, b->entry_speed_sqr);
+        else {
+            fprintf(args.block_out_file,"%f\n", b->entry_speed_sqr);
+            fflush(args.block_out_file); //TODO: needed?
         }
-        fprintf(args.block_out_file,"%f\n", b->entry_speed_sqr);
-        fflush(args.block_out_file); //TODO: needed?
         last_block = b;
     }
 }
@@ -20,7 +20,11 @@
   along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "grbl/grbl.h"
+
 void grbl_app_init(void);  //call to setup ISRs and local tracking vars
 void grbl_per_tick(void);  //call per tick to print steps
 void grbl_per_byte(void);  //call per incoming byte to print block info
 void grbl_app_exit(void);  //call to shutdown cleanly
+void grbl_step_event(stepper_t *stepper);  //call per step pulse to print steps when step events are enabled
+void grbl_laser_pulse(bool on);  //call per laser PPI pulse, and with on false when the pulse train stops, when step events are enabled
@@ -35,6 +35,11 @@
 #include "simulator.h"
 #include "eeprom.h"
 #include "grbl_interface.h"
+#include "estimate.h"
+#include "replay.h"
+#include "profile.h"
+#include "trace_file.h"
+#include "fleet.h"
 
 #include "grbl/grbllib.h"
 
@@ -57,10 +62,25 @@ int usage(const char* badarg)
       "    -g <response file> : file to report responses from grbl.  default = stdout\n"
       "    -b <block file>    : file to report each block executed.  default = stdout\n"
       "    -s <step file>     : file to report each step executed.  default = stderr\n"
+      "    -S                 : report every step pulse, block and segment to the step file.\n"
+      "                         Replaces the positions sampled at the report time, see gstepcheck.exe.\n"
+      "    --trace <format>   : format of the step and block files, text, binary or delta (compressed binary).\n"
+      "                         Default=text, see gtracedecode.exe.\n"
       "    -e <EEPROM file>   : file containing grblHAL settings.  default = EEPROM.DAT\n"
       "    -p <port>          : port to open raw telnet communication.\n"
       "    -c<comment_char>   : character to print before each line from grbl.  default = '#'\n"
       "    -n                 : no comments before grbl response lines.\n"
+      "    --estimate <file>  : estimate the cycle time of a g-code file, use - for stdin.\n"
+      "                         Time in total, per tool and per line is written to the block file.\n"
+      "    --profile <file>   : with --estimate, write the host CPU time spent per line in the parser, arc and\n"
+      "                         spline generation, the planner and the step segment generator to a file.\n"
+      "                         Requires a build with ENABLE_PERF_COUNTERS.\n"
+      "    --fleet <file>     : estimate the cycle time of each machine of a cell listed in a file, in parallel.\n"
+      "                         Cycle times and utilization are written to the block file.\n"
+      "    --workers <n>      : with --fleet, number of estimates to run at a time.  default = number of cores\n"
+      "    --record <file>    : record the input received, with the time received, to a capture file.\n"
+      "    --replay <file>    : replay the input recorded in a capture file, deterministic and independent\n"
+      "                         of the host speed. A summary is written to the block file at the end.\n"
       "    -h                 : this help.\n"
       "\n  <time_step> and <block_file> can be specifed with option flags or positional parameters\n"
       "\n  ^-F to shutdown cleanly\n\n",
@@ -138,7 +158,8 @@ static void exithandler (int signum)
 int main(int argc, char *argv[])
 {
     float tick_rate = 1.0f;
-    int positional_args = 0;
+    FILE *estimate_file = NULL, *profile_file = NULL, *record_file = NULL, *replay_file = NULL, *fleet_file = NULL;
+    int positional_args = 0, workers = 0;
 
     //defaults
     args.step_out_file = stderr;
@@ -199,6 +220,10 @@ int main(int argc, char *argv[])
                     }
                     break;
 
+                case 'S': //Step events to step out file.
+                    args.step_events = true;
+                    break;
+
                 case 'g': //Grbl output
                     argv++; argc--;
                     args.serial_out_file = fopen(*argv,"w");
@@ -222,6 +247,66 @@ int main(int argc, char *argv[])
                 case 'h':
                     return usage(NULL);
 
+                case '-':
+                    if (argc < 2)
+                        return usage(*argv);
+                    if (!strcmp(*argv, "--estimate")) {
+                        argv++; argc--;
+                        estimate_file = strcmp(*argv, "-") ? fopen(*argv, "r") : stdin;
+                        if (!estimate_file) {
+                            perror("fopen");
+                            printf("Error opening : %s\n",*argv);
+                            return(usage(0));
+                        }
+                    } else if (!strcmp(*argv, "--profile")) {
+                        argv++; argc--;
+                        profile_file = fopen(*argv, "w");
+                        if (!profile_file) {
+                            perror("fopen");
+                            printf("Error opening : %s\n",*argv);
+                            return(usage(0));
+                        }
+                    } else if (!strcmp(*argv, "--fleet")) {
+                        argv++; argc--;
+                        fleet_file = fopen(*argv, "r");
+                        if (!fleet_file) {
+                            perror("fopen");
+                            printf("Error opening : %s\n",*argv);
+                            return(usage(0));
+                        }
+                    } else if (!strcmp(*argv, "--workers")) {
+                        argv++; argc--;
+                        workers = atoi(*argv);
+                    } else if (!strcmp(*argv, "--record")) {
+                        argv++; argc--;
+                        record_file = fopen(*argv, "w");
+                        if (!record_file) {
+                            perror("fopen");
+                            printf("Error opening : %s\n",*argv);
+                            return(usage(0));
+                        }
+                    } else if (!strcmp(*argv, "--trace")) {
+                        argv++; argc--;
+                        if (!strcmp(*argv, "text"))
+                            args.trace_format = TraceFormat_Text;
+                        else if (!strcmp(*argv, "binary"))
+                            args.trace_format = TraceFormat_Binary;
+                        else if (!strcmp(*argv, "delta"))
+                            args.trace_format = TraceFormat_Delta;
+                        else
+                            return usage(*argv);
+                    } else if (!strcmp(*argv, "--replay")) {
+                        argv++; argc--;
+                        replay_file = fopen(*argv, "r");
+                        if (!replay_file) {
+                            perror("fopen");
+                            printf("Error opening : %s\n",*argv);
+                            return(usage(0));
+                        }
+                    } else
+                        return usage(*argv);
+                    break;
+
                 default:
                     return usage(*argv);
             }
@@ -250,6 +335,24 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (profile_file && !estimate_file)
+        return usage("--profile without --estimate");
+
+    // Binary traces are written to disk in large blocks, output to the console is left as is.
+    if (args.trace_format != TraceFormat_Text) {
+        if (args.step_out_file != stderr)
+            setvbuf(args.step_out_file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+        if (args.block_out_file != stdout && args.block_out_file != args.serial_out_file)
+            setvbuf(args.block_out_file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+    }
+
+    if (fleet_file && (estimate_file || replay_file || record_file || args.port))
+        return usage("--fleet with --estimate, --replay, --record or -p");
+
+    // Returns in each instance with the g-code file to estimate.
+    if (fleet_file)
+        estimate_file = fleet_run(fleet_file, workers);
+
     // Make sure the output streams are flushed immediately.
     // This is important when using the simulator inside another application in parallel
     // to the real grbl.
@@ -267,6 +370,37 @@ int main(int argc, char *argv[])
 
     init_simulator(tick_rate);
 
+    if(estimate_file) {
+
+        sim.putchar = sim_serial_out;
+
+        estimate_init(estimate_file);
+
+        if(profile_file && !profile_init(profile_file)) {
+            printf("--profile requires a build with ENABLE_PERF_COUNTERS\n");
+            return -1;
+        }
+
+        atexit(eeprom_close);
+        signal(SIGTERM, exithandler);
+
+        // The grbl code runs in this thread and drives the simulation, exits when the end of the file is reached.
+        grbl_enter();
+    }
+
+    if(replay_file) {
+
+        sim.putchar = sim_serial_out;
+
+        replay_init(replay_file);
+
+        atexit(eeprom_close);
+        signal(SIGTERM, exithandler);
+
+        // The grbl code runs in this thread and drives the simulation, exits when the capture has been replayed.
+        grbl_enter();
+    }
+
     if(args.port) {
 
         socklen_t addrlen = sizeof(struct sockaddr_in);
@@ -315,6 +449,9 @@ int main(int argc, char *argv[])
         sim.putchar = sim_serial_out;
     }
 
+    if(record_file)
+        replay_record_init(record_file);
+
     //launch a thread with the original grbl code.
     plat_thread_t *th = platform_start_thread(grbl_main_thread); 
     if (!th){
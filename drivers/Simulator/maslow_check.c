@@ -0,0 +1,144 @@
+/*
+  maslow_check.c - Maslow router inverse kinematics accuracy check and benchmark
+
+  Part of Grbl Simulator
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Compares the single precision chain lengths from maslow_chain_lengths() against the double precision
+  formulation previously used by the Maslow kinematics, over a grid covering the default work area
+  extended by the sled size.
+
+  Reported are the largest chain length error in mm and in steps, the number of targets where the
+  rounded step count differs and the time taken per target by each version.
+
+  Returns non-zero if the chain length error exceeds the -e limit in steps, default 0.1.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "grbl/maslow.h"
+
+static void chain_lengths_double (double *a_len, double *b_len, float x, float y, float x_motor, float y_motor)
+{
+    double yyp = pow((double)y_motor - (double)y, 2.0);
+
+    *a_len = sqrt(pow((double)x_motor + (double)x, 2.0) + yyp);
+    *b_len = sqrt(pow((double)x_motor - (double)x, 2.0) + yyp);
+}
+
+static double elapsed (struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+int main (int argc, char *argv[])
+{
+    int c;
+    float steps_per_mm = 127.4f, grid = 0.5f, max_error = 0.1f;
+
+    while((c = getopt(argc, argv, "p:g:e:")) != -1) switch(c) {
+
+        case 'p':
+            steps_per_mm = atof(optarg);
+            break;
+
+        case 'g':
+            grid = atof(optarg);
+            break;
+
+        case 'e':
+            max_error = atof(optarg);
+            break;
+
+        default:
+            fprintf(stderr, "Usage: %s [-p steps_per_mm] [-g grid_mm] [-e max_error_steps]\n", argv[0]);
+            return 2;
+    }
+
+    if(steps_per_mm <= 0.0f || grid <= 0.0f) {
+        fprintf(stderr, "Steps per mm and grid size must be positive\n");
+        return 2;
+    }
+
+    float x_motor = MASLOW_DISTBETWEENMOTORS / 2.0f, y_motor = MASLOW_MACHINEHEIGHT / 2.0f + MASLOW_MOTOROFFSETY;
+    float half_width = (MASLOW_MACHINEWIDTH + MASLOW_SLEDWIDTH) / 2.0f, half_height = (MASLOW_MACHINEHEIGHT + MASLOW_SLEDHEIGHT) / 2.0f;
+    uint_fast32_t nx = (uint_fast32_t)(2.0f * half_width / grid) + 1, ny = (uint_fast32_t)(2.0f * half_height / grid) + 1;
+    uint_fast32_t ix, iy, targets = 0, mismatches = 0;
+    double error, max_error_mm = 0.0, t_float, t_double, sum_float = 0.0, sum_double = 0.0;
+    struct timespec start;
+
+    for(iy = 0; iy < ny; iy++) {
+        float y = (-half_height + (float)iy * grid) * MASLOW_BCORRSCALING;
+        for(ix = 0; ix < nx; ix++) {
+            float x = (-half_width + (float)ix * grid) * MASLOW_ACORRSCALING, a_len, b_len;
+            double a_ref, b_ref;
+
+            maslow_chain_lengths(&a_len, &b_len, x, y, x_motor, y_motor);
+            chain_lengths_double(&a_ref, &b_ref, x, y, x_motor, y_motor);
+
+            if((error = fabs((double)a_len - a_ref)) > max_error_mm)
+                max_error_mm = error;
+            if((error = fabs((double)b_len - b_ref)) > max_error_mm)
+                max_error_mm = error;
+
+            if(lroundf(a_len * steps_per_mm) != lround(a_ref * steps_per_mm))
+                mismatches++;
+            if(lroundf(b_len * steps_per_mm) != lround(b_ref * steps_per_mm))
+                mismatches++;
+
+            targets++;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(iy = 0; iy < ny; iy++) {
+        float y = (-half_height + (float)iy * grid) * MASLOW_BCORRSCALING;
+        for(ix = 0; ix < nx; ix++) {
+            float a_len, b_len;
+            maslow_chain_lengths(&a_len, &b_len, (-half_width + (float)ix * grid) * MASLOW_ACORRSCALING, y, x_motor, y_motor);
+            sum_float += a_len + b_len;
+        }
+    }
+    t_float = elapsed(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(iy = 0; iy < ny; iy++) {
+        float y = (-half_height + (float)iy * grid) * MASLOW_BCORRSCALING;
+        for(ix = 0; ix < nx; ix++) {
+            double a_len, b_len;
+            chain_lengths_double(&a_len, &b_len, (-half_width + (float)ix * grid) * MASLOW_ACORRSCALING, y, x_motor, y_motor);
+            sum_double += a_len + b_len;
+        }
+    }
+    t_double = elapsed(&start);
+
+    printf("Targets:              %" PRIuFAST32 " (%.1f mm grid)\n", targets, grid);
+    printf("Max chain error:      %.6f mm, %.4f steps (limit %.4f)\n", max_error_mm, max_error_mm * steps_per_mm, max_error);
+    printf("Step count mismatch:  %" PRIuFAST32 " of %" PRIuFAST32 " chains\n", mismatches, targets * 2);
+    printf("Time per target:      float %.1f ns, double %.1f ns (checksum %.0f/%.0f)\n",
+            t_float * 1e9 / (double)targets, t_double * 1e9 / (double)targets, sum_float, sum_double);
+
+    return max_error_mm * steps_per_mm > max_error ? 1 : 0;
+}
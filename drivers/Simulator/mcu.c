@@ -133,6 +133,91 @@ void mcu_master_clock (void)
     }
 }
 
+// Returns the number of master clock ticks until a timer reaches zero, including the tick where it does.
+static inline uint32_t timer_event (mcu_timer_t *timer)
+{
+    if(timer->value == 0)
+        return timer->load ? timer->load + 1 : UINT32_MAX; // Reloaded on the next tick
+    else
+        return timer->value;
+}
+
+// Counts a timer down by a number of ticks without reaching zero.
+static inline void timer_skip (mcu_timer_t *timer, uint32_t ticks)
+{
+    uint32_t event = timer_event(timer);
+
+    if(ticks >= event) // The timer may have been restarted since the event was calculated
+        ticks = event - 1;
+
+    if(ticks) {
+        if(timer->value == 0)
+            timer->value = timer->load - (ticks - 1);
+        else
+            timer->value -= ticks;
+    }
+}
+
+// Returns the number of master clock ticks until the next tick where an interrupt may be raised,
+// including that tick. Ticks before it only count timers down and can be skipped by mcu_skip_ticks().
+uint32_t mcu_next_event (void)
+{
+    uint_fast8_t i;
+    uint32_t ticks = UINT32_MAX, event;
+
+    if(!booted)
+        return ticks;
+
+    for(i = 0; i < MCU_N_GPIO; i++) {
+        if(gpio[i].irq_state.value & gpio[i].irq_mask.value)
+            return 1;
+    }
+
+    for(i = 0; i < MCU_N_TIMERS; i++) {
+        if(timer[i].enable) {
+            if(timer[i].prescaler) // Not worth the complexity, tick prescaled timers one by one
+                return 1;
+            if((event = timer_event(&timer[i])) < ticks)
+                ticks = event;
+        }
+    }
+
+    if(systick_timer.enable && (event = timer_event(&systick_timer)) < ticks)
+        ticks = event;
+
+    return ticks;
+}
+
+// Advances the peripherals by a number of ticks that does not exceed mcu_next_event() - 1.
+void mcu_skip_ticks (uint32_t ticks)
+{
+    uint_fast8_t i;
+
+    if(!booted || ticks == 0)
+        return;
+
+    for(i = 0; i < MCU_N_TIMERS; i++) {
+        if(timer[i].enable && !timer[i].prescaler)
+            timer_skip(&timer[i], ticks);
+    }
+
+    if(systick_timer.enable)
+        timer_skip(&systick_timer, ticks);
+}
+
+// Returns true if the UART has a character to transmit or room to receive while input is available,
+// the simulator then reads and writes a character each baud period. Otherwise baud ticks may be skipped.
+bool mcu_serial_pending (void)
+{
+    return booted && (uart.tx_flag || uart.tx_irq_enable || (uart.rx_irq_enable && !uart.rx_irq && !uart.rx_idle && hal.stream.get_rx_buffer_available() > 100));
+}
+
+// Makes the simulator read input again after none was available.
+void mcu_serial_poll (void)
+{
+    uart.rx_idle = false;
+}
+
 void mcu_gpio_set (gpio_port_t *port, uint8_t pins, uint8_t mask)
 {
     port->state.value = (port->state.value & ~mask) | (pins & mask);
@@ -188,7 +273,7 @@ void simulate_serial (void)
 
     if(uart.rx_irq_enable && !uart.rx_irq && hal.stream.get_rx_buffer_available() > 100) {
         uint8_t char_in = sim.getchar();
-        if (char_in) {
+        if (!(uart.rx_idle = !char_in)) {
             uart.rx_data = char_in;
             uart.rx_irq = 1;
             isr[UART_IRQ]();
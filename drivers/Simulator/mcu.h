@@ -67,6 +67,7 @@ typedef struct
     bool tx_flag;
     bool rx_irq_enable;
     bool tx_irq_enable;
+    bool rx_idle;       // no input was available at the last read
     uint8_t rx_data;
     uint8_t tx_data;
     uint32_t cdiv;
@@ -110,6 +111,10 @@ void mcu_reset (void);
 void mcu_enable_interrupts (void);
 void mcu_disable_interrupts (void);
 void mcu_master_clock (void);
+uint32_t mcu_next_event (void);
+void mcu_skip_ticks (uint32_t ticks);
+bool mcu_serial_pending (void);
+void mcu_serial_poll (void);
 void mcu_register_irq_handler (interrupt_handler handler, irq_num_t irq_num);
 void mcu_gpio_set (gpio_port_t *port, uint8_t pins, uint8_t mask);
 uint8_t mcu_gpio_get (gpio_port_t *port, uint8_t mask);
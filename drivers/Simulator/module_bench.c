@@ -0,0 +1,588 @@
+/*
+  module_bench.c - per module micro-benchmarks and checks of core functions
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Calls read_float() and ftoa_r() from nuts_bolts.c, plan_buffer_line() from planner.c and
+  spindle_compute_pwm_value() from spindle_control.c with inputs generated from a fixed seed, linked with
+  the validator null driver and the default settings from defaults.h. Each function is first run once
+  with its results checked and hashed, then timed over a number of passes, the fastest pass is reported:
+
+    bench,<module>,<function>,<calls per pass>,<ns per call>,<result hash>,<errors>
+
+  Checks:
+    read_float                  converted, at most 1 ulp from the correctly rounded strtod() result
+    ftoa                        at most half a unit in the last decimal from the value, plus float rounding
+    plan_buffer_line            entry speeds do not exceed the junction limits, blocks are planned
+    spindle_compute_pwm_value   monotonic in RPM, within one PWM step of the linear speed model
+    protocol_main_loop          with ENABLE_LINE_CHECKSUM, checksummed jobs streamed back to back, motions not executed,
+                                are all acknowledged and planned, the second job restarts at N100 after M30, the third at N1 after M110
+
+  The hash is over the results of the check run and only changes if the results of a function change.
+  Results written with -w can be compared against on later runs with -c, a function fails if its hash
+  differs or if it is slower than the baseline by more than the tolerance. Times depend on the host, use
+  the same host and build flags for the baseline. The exit code is non-zero if any check or comparison
+  failed.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <time.h>
+
+#include "platform.h"
+#include "grbl/grbl.h"
+
+#define BENCH_SEED 0x2020u
+#define N_NUMBERS 100000    // read_float() and ftoa_r() inputs
+#define N_BLOCKS 20000      // Blocks planned per pass
+#define N_RPM 100000        // RPM values converted per pass
+#define N_JOB_LINES 2000    // Lines per job streamed, three jobs per pass
+
+typedef struct arg_vars {
+    uint32_t passes;
+    float tolerance;
+    const char *write_file;
+    const char *compare_file;
+} arg_vars_t;
+
+typedef struct {
+    uint32_t calls;
+    uint32_t hash;
+    uint32_t errors;
+    double ns;
+} result_t;
+
+typedef struct {
+    const char *module;
+    const char *function;
+    void (*run)(result_t *result, bool check);
+    result_t result;
+} bench_t;
+
+arg_vars_t args;
+const char* progname;
+
+static uint32_t seed = BENCH_SEED;
+static char *number[N_NUMBERS];
+static float value[N_NUMBERS];
+static volatile float sink; // Keeps results from being optimized away
+static spindle_pwm_t pwm_data;
+
+int usage (const char* badarg)
+{
+    if (badarg)
+        printf("Unrecognized option %s\n", badarg);
+
+    printf("Usage: \n"
+     "%s <Options>\n"
+     "  Options:\n"
+     "    -n <passes>    : number of timed passes, the fastest is reported. Default=5\n"
+     "    -w <file>      : write the results to a baseline file.\n"
+     "    -c <file>      : compare the results with a baseline file.\n"
+     "    -t <percent>   : with -c, time regression tolerated. Default=10\n"
+     "\n  Reports ns per call and checks the results of core module functions\n",
+     progname);
+
+    return -1;
+}
+
+static void bench_write (const char *data)
+{
+}
+
+static uint32_t next_random (void)
+{
+    seed = seed * 1664525u + 1013904223u;
+
+    return seed >> 8;
+}
+
+static inline uint32_t hash_add (uint32_t hash, const void *data, size_t length)
+{
+    const uint8_t *byte = data;
+
+    while(length--)
+        hash = (hash ^ *byte++) * 16777619u; // FNV-1a
+
+    return hash;
+}
+
+/* nuts_bolts.c */
+
+static void bench_read_float (result_t *result, bool check)
+{
+    uint32_t idx;
+    uint_fast8_t char_counter;
+    float v, sum = 0.0f, exact;
+
+    for(idx = 0; idx < N_NUMBERS; idx++) {
+
+        char_counter = 0;
+
+        if(!read_float(number[idx], &char_counter, &v)) {
+            if(check) {
+                result->errors++;
+                printf("read_float: not converted: %s\n", number[idx]);
+            }
+            continue;
+        }
+
+        sum += v;
+
+        if(check) {
+            exact = (float)strtod(number[idx], NULL);
+            if(v != exact && v != nextafterf(exact, INFINITY) && v != nextafterf(exact, -INFINITY)) {
+                result->errors++;
+                printf("read_float: inexact: %s %.9g\n", number[idx], v);
+            }
+            result->hash = hash_add(result->hash, &v, sizeof(float));
+        }
+    }
+
+    result->calls = N_NUMBERS;
+    sink = sum;
+}
+
+static void bench_ftoa (result_t *result, bool check)
+{
+    uint32_t idx;
+    uint8_t decimals;
+    char buf[STRLEN_NUMBER_MAX], *end;
+    size_t length = 0;
+    double error;
+
+    for(idx = 0; idx < N_NUMBERS; idx++) {
+
+        decimals = idx & 1 ? N_DECIMAL_COORDVALUE_INCH : N_DECIMAL_COORDVALUE_MM;
+        end = ftoa_r(buf, value[idx], decimals);
+        length += end - buf;
+
+        if(check) {
+            error = fabs(strtod(buf, NULL) - (double)value[idx]);
+            if(error > 0.5 * pow(10.0, -decimals) + fabs((double)value[idx]) * FLT_EPSILON) {
+                result->errors++;
+                printf("ftoa: %.9g to %u decimals is %s\n", value[idx], decimals, buf);
+            }
+            result->hash = hash_add(result->hash, buf, end - buf);
+        }
+    }
+
+    result->calls = N_NUMBERS;
+    sink = (float)length;
+}
+
+/* planner.c */
+
+static void bench_plan_buffer_line (result_t *result, bool check)
+{
+    uint32_t block;
+    float target[N_AXIS] = {0}, angle = 0.0f;
+    plan_line_data_t pl_data;
+    plan_block_t *pl_block;
+
+    memset(&pl_data, 0, sizeof(plan_line_data_t));
+    pl_data.feed_rate = 3000.0f;
+
+    plan_reset();
+    plan_sync_position();
+
+    // A helix of 0.01 mm segments with a corner every 1000 blocks, the block buffer is kept full.
+    for(block = 0; block < N_BLOCKS; block++) {
+
+        angle += block % 1000 ? 0.001f : 0.5f;
+        target[X_AXIS] = 10.0f * cosf(angle);
+        target[Y_AXIS] = 10.0f * sinf(angle);
+        target[Z_AXIS] = angle * 0.1f;
+
+        while(plan_check_full_buffer()) {
+            if(check) {
+                pl_block = plan_get_current_block();
+                if(pl_block->entry_speed_sqr > plan_get_max_entry_speed_sqr(pl_block) * 1.0001f) {
+                    result->errors++;
+                    printf("plan_buffer_line: entry speed %.3f exceeds the junction limit %.3f\n",
+                            sqrtf(pl_block->entry_speed_sqr), sqrtf(plan_get_max_entry_speed_sqr(pl_block)));
+                }
+                result->hash = hash_add(result->hash, &pl_block->entry_speed_sqr, sizeof(float));
+            }
+            plan_discard_current_block();
+        }
+
+        if(!plan_buffer_line(target, &pl_data) && check) {
+            result->errors++;
+            printf("plan_buffer_line: block %" PRIu32 " not planned\n", block);
+        }
+    }
+
+    result->calls = N_BLOCKS;
+}
+
+/* spindle_control.c */
+
+static void bench_spindle_compute_pwm_value (result_t *result, bool check)
+{
+    uint32_t idx;
+    uint_fast16_t pwm, prev = 0, sum = 0;
+    float rpm, rpm_max = settings.spindle.rpm_max * 1.1f;
+    double model, tolerance = 1.0;
+
+#ifdef ENABLE_SPINDLE_PWM_LUT
+    tolerance += pwm_data.pwm_gradient * (settings.spindle.rpm_max - settings.spindle.rpm_min) / (float)SPINDLE_PWM_LUT_SIZE;
+#endif
+
+    for(idx = 0; idx < N_RPM; idx++) {
+
+        rpm = rpm_max * (float)idx / (float)(N_RPM - 1);
+        pwm = spindle_compute_pwm_value(&pwm_data, rpm, false);
+        sum += pwm;
+
+        if(check) {
+            if(rpm > settings.spindle.rpm_min) {
+                model = floor((double)(rpm - settings.spindle.rpm_min) * pwm_data.pwm_gradient) + pwm_data.min_value;
+                if(model > pwm_data.max_value)
+                    model = pwm_data.max_value;
+                if(fabs((double)pwm - model) > tolerance) {
+                    result->errors++;
+                    printf("spindle_compute_pwm_value: %.3f RPM is %u, model %.0f\n", rpm, (unsigned)pwm, model);
+                }
+            }
+            if(idx && pwm < prev) {
+                result->errors++;
+                printf("spindle_compute_pwm_value: %.3f RPM is %u, less than %u at a lower RPM\n", rpm, (unsigned)pwm, (unsigned)prev);
+            }
+            prev = pwm;
+            result->hash = hash_add(result->hash, &pwm, sizeof(pwm));
+        }
+    }
+
+    result->calls = N_RPM;
+    sink = (float)sum;
+}
+
+#ifdef ENABLE_LINE_CHECKSUM
+
+/* protocol.c */
+
+static struct {
+    char *data;
+    size_t length;
+    size_t pos;
+    uint32_t lines;
+    uint32_t n_lines;
+    uint32_t motions;
+    uint32_t n_motions;
+    result_t *result;
+    bool check;
+} job_stream;
+
+static int16_t bench_stream_read (void)
+{
+    // The motions are counted, not executed. Keeps the planner from filling up.
+    if(plan_get_current_block())
+        job_stream.motions++;
+
+    plan_reset();
+
+    if(job_stream.pos == job_stream.length) {
+        sys.abort = true;
+        return SERIAL_NO_DATA;
+    }
+
+    return (int16_t)job_stream.data[job_stream.pos++];
+}
+
+static status_code_t bench_status_message (status_code_t status)
+{
+    if(job_stream.check) {
+        if(status != Status_OK) {
+            job_stream.result->errors++;
+            printf("protocol_main_loop: error %d after %" PRIu32 " bytes\n", (int)status, (uint32_t)job_stream.pos);
+        }
+        job_stream.result->hash = hash_add(job_stream.result->hash, &status, sizeof(status));
+    }
+
+    job_stream.lines++;
+
+    return status;
+}
+
+// Appends a line with its line number and checksum to the job stream.
+static void job_line (const char *block, uint32_t number)
+{
+    uint8_t sum = 0;
+    char *s = &job_stream.data[job_stream.length];
+    int length = sprintf(s, "N%" PRIu32 " %s", number, block);
+
+    while(length--)
+        sum ^= (uint8_t)*s++;
+
+    job_stream.length += sprintf(s, "*%u\n", sum) + (s - &job_stream.data[job_stream.length]);
+    job_stream.n_lines++;
+}
+
+static bool generate_jobs (void)
+{
+    uint32_t job, line;
+    char block[48];
+
+    if((job_stream.data = malloc(3 * (N_JOB_LINES + 2) * 64)) == NULL)
+        return false;
+
+    job_stream.length = job_stream.n_lines = job_stream.n_motions = 0;
+
+    // Three jobs, the first ending with M30 and the second followed by M110 N0.
+    // The second job is numbered from N100, the sequence restarts at any number after program end.
+    for(job = 0; job < 3; job++) {
+        for(line = job == 1 ? 100 : 1; line < (job == 1 ? 99 : 0) + N_JOB_LINES; line++) {
+            snprintf(block, sizeof(block), "G1 X%.3f Y%.3f F1000", (double)(line % 100) * 0.5, (double)job + (double)line * 0.001);
+            job_line(block, line);
+            job_stream.n_motions++;
+        }
+        if(job == 0)
+            job_line("M30", line);
+        else if(job == 1)
+            job_line("M110 N0", line);
+    }
+
+    return true;
+}
+
+static void bench_protocol_main_loop (result_t *result, bool check)
+{
+    job_stream.pos = job_stream.lines = job_stream.motions = 0;
+    job_stream.result = result;
+    job_stream.check = check;
+
+    plan_reset();
+    sys.abort = false;
+    protocol_main_loop(false);
+
+    if(check && job_stream.lines != job_stream.n_lines) {
+        result->errors++;
+        printf("protocol_main_loop: %" PRIu32 " of %" PRIu32 " lines acknowledged\n", job_stream.lines, job_stream.n_lines);
+    }
+
+    if(check && job_stream.motions != job_stream.n_motions) {
+        result->errors++;
+        printf("protocol_main_loop: %" PRIu32 " of %" PRIu32 " motions planned\n", job_stream.motions, job_stream.n_motions);
+    }
+
+    result->calls = job_stream.lines;
+}
+
+#endif
+
+static bench_t bench[] = {
+    { "nuts_bolts", "read_float", bench_read_float },
+    { "nuts_bolts", "ftoa", bench_ftoa },
+    { "planner", "plan_buffer_line", bench_plan_buffer_line },
+    { "spindle_control", "spindle_compute_pwm_value", bench_spindle_compute_pwm_value },
+#ifdef ENABLE_LINE_CHECKSUM
+    { "protocol", "protocol_main_loop", bench_protocol_main_loop }
+#endif
+};
+
+#define N_BENCH (sizeof(bench) / sizeof(bench_t))
+
+static bool generate_inputs (void)
+{
+    uint32_t idx, decimals;
+    char buf[32];
+
+    for(idx = 0; idx < N_NUMBERS; idx++) {
+
+        // Up to 5 integer digits and 0 to 5 decimals, as in g-code words.
+        decimals = next_random() % 6;
+        snprintf(buf, sizeof(buf), "%s%.*f", next_random() & 1 ? "-" : "", (int)decimals, (double)(next_random() % 10000000) / 100.0);
+        if((number[idx] = strdup(buf)) == NULL)
+            return false;
+
+        value[idx] = ((float)(next_random() % 20000001) - 10000000.0f) / (float)(1 << (next_random() % 8));
+    }
+
+    return true;
+}
+
+// Compares the results with the baseline file, returns the number of failed comparisons.
+static uint32_t compare (FILE *file)
+{
+    char line[256], module[64], function[64];
+    unsigned int calls, hash, errors;
+    double ns;
+    uint32_t idx, failed = 0;
+    bool found[N_BENCH] = {0};
+
+    while(fgets(line, sizeof(line), file)) {
+
+        if(sscanf(line, "bench,%63[^,],%63[^,],%u,%lf,%x,%u", module, function, &calls, &ns, &hash, &errors) != 6)
+            continue;
+
+        for(idx = 0; idx < N_BENCH; idx++) {
+            if(!strcmp(bench[idx].module, module) && !strcmp(bench[idx].function, function)) {
+                found[idx] = true;
+                if(bench[idx].result.calls != calls || bench[idx].result.hash != hash) {
+                    failed++;
+                    printf("%s: results differ from the baseline\n", function);
+                }
+                if(bench[idx].result.ns > ns * (1.0 + args.tolerance / 100.0)) {
+                    failed++;
+                    printf("%s: %.2f ns per call, %.1f%% slower than the baseline %.2f ns\n", function,
+                            bench[idx].result.ns, (bench[idx].result.ns / ns - 1.0) * 100.0, ns);
+                }
+            }
+        }
+    }
+
+    for(idx = 0; idx < N_BENCH; idx++) {
+        if(!found[idx])
+            printf("%s: not in the baseline\n", bench[idx].function);
+    }
+
+    return failed;
+}
+
+int main (int argc, char *argv[])
+{
+    uint32_t idx, pass, errors = 0;
+    FILE *file;
+
+    //defaults
+    args.passes = 5;
+    args.tolerance = 10.0f;
+
+    progname = argv[0];
+
+    while (argc > 2 && argv[1][0] == '-') {
+        switch(argv[1][1]) {
+
+            case 'n':
+                args.passes = (uint32_t)atol(argv[2]);
+                break;
+
+            case 'w':
+                args.write_file = argv[2];
+                break;
+
+            case 'c':
+                args.compare_file = argv[2];
+                break;
+
+            case 't':
+                args.tolerance = (float)atof(argv[2]);
+                break;
+
+            default:
+                return usage(argv[1]);
+        }
+        argv += 2; argc -= 2;
+    }
+
+    if (argc > 1)
+        return usage(argc == 2 && argv[1][1] == 'h' ? NULL : argv[1]);
+
+    if (args.passes == 0)
+        return usage(NULL);
+
+    memset(&hal, 0, sizeof(HAL));
+
+    hal.version = HAL_VERSION;
+
+    if(!driver_init())
+       return -1;
+
+    hal.stream.write = bench_write;
+    hal.stream.write_all = bench_write;
+
+    eeprom_emu_init();
+    report_init();
+    settings_init();
+
+    memset(&sys, 0, sizeof(system_t));
+    sys.override.feed_rate = DEFAULT_FEED_OVERRIDE;
+    sys.override.rapid_rate = DEFAULT_RAPID_OVERRIDE;
+
+    memset(&pwm_data, 0, sizeof(spindle_pwm_t));
+    spindle_precompute_pwm_values(&pwm_data, 16000000);
+
+    if(!generate_inputs())
+        return -1;
+
+#ifdef ENABLE_LINE_CHECKSUM
+    if(!generate_jobs())
+        return -1;
+
+    hal.stream.read = bench_stream_read;
+    hal.report.status_message = bench_status_message;
+    hal.report.feedback_message = report_feedback_message;
+#endif
+
+    for(idx = 0; idx < N_BENCH; idx++) {
+
+        result_t *result = &bench[idx].result, timed;
+
+        memset(result, 0, sizeof(result_t));
+        result->hash = 2166136261u;
+
+        bench[idx].run(result, true);
+        errors += result->errors;
+
+        for(pass = 0; pass < args.passes; pass++) {
+
+            memset(&timed, 0, sizeof(result_t));
+
+            clock_t start = clock();
+
+            bench[idx].run(&timed, false);
+
+            double ns = (double)(clock() - start) * 1e9 / (double)CLOCKS_PER_SEC / (double)timed.calls;
+
+            if(pass == 0 || ns < result->ns)
+                result->ns = ns;
+        }
+
+        printf("bench,%s,%s,%" PRIu32 ",%.2f,%08" PRIx32 ",%" PRIu32 "\n", bench[idx].module, bench[idx].function,
+                result->calls, result->ns, result->hash, result->errors);
+    }
+
+    if(args.write_file) {
+        if((file = fopen(args.write_file, "w")) == NULL) {
+            perror("fopen");
+            return -1;
+        }
+        for(idx = 0; idx < N_BENCH; idx++)
+            fprintf(file, "bench,%s,%s,%" PRIu32 ",%.2f,%08" PRIx32 ",%" PRIu32 "\n", bench[idx].module, bench[idx].function,
+                     bench[idx].result.calls, bench[idx].result.ns, bench[idx].result.hash, bench[idx].result.errors);
+        fclose(file);
+    }
+
+    if(args.compare_file) {
+        if((file = fopen(args.compare_file, "r")) == NULL) {
+            perror("fopen");
+            return -1;
+        }
+        errors += compare(file);
+        fclose(file);
+    }
+
+    return errors ? 1 : 0;
+}
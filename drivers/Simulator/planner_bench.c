@@ -0,0 +1,173 @@
+/*
+  planner_bench.c - Grbl planner throughput benchmark
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Feeds a helical toolpath made of short line segments to the planner and reports the number of
+  blocks planned per second. The block buffer is kept full by discarding the oldest block before
+  each new block is added, as when streaming to a running machine.
+  Uses the default settings from defaults.h, the stepper module is not run.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "platform.h"
+#include "grbl/grbl.h"
+
+typedef struct arg_vars {
+    uint32_t blocks;
+    float segment_length;
+    float radius;
+    float feed_rate;
+    uint32_t buffer_size;
+} arg_vars_t;
+
+arg_vars_t args;
+const char* progname;
+
+int usage (const char* badarg)
+{
+    if (badarg)
+        printf("Unrecognized option %s\n", badarg);
+
+    printf("Usage: \n"
+     "%s <Options>\n"
+     "  Options:\n"
+     "    -n <blocks>         : number of blocks to plan. Default=1000000\n"
+     "    -l <segment length> : segment length in mm. Default=0.01\n"
+     "    -r <radius>         : helix radius in mm. Default=10\n"
+     "    -f <feed rate>      : feed rate in mm/min. Default=3000\n"
+     "    -b <buffer size>    : planner buffer size in blocks. Default=0=grbl default\n"
+     "\n  Reports planner throughput in blocks per second\n",
+     progname);
+
+    return -1;
+}
+
+static void bench_write (const char *data)
+{
+}
+
+int main (int argc, char *argv[])
+{
+    //defaults
+    args.blocks = 1000000;
+    args.segment_length = 0.01f;
+    args.radius = 10.0f;
+    args.feed_rate = 3000.0f;
+
+    progname = argv[0];
+
+    while (argc > 2 && argv[1][0] == '-') {
+        switch(argv[1][1]) {
+
+            case 'n':
+                args.blocks = (uint32_t)atol(argv[2]);
+                break;
+
+            case 'l':
+                args.segment_length = (float)atof(argv[2]);
+                break;
+
+            case 'r':
+                args.radius = (float)atof(argv[2]);
+                break;
+
+            case 'f':
+                args.feed_rate = (float)atof(argv[2]);
+                break;
+
+            case 'b':
+                args.buffer_size = (uint32_t)atol(argv[2]);
+                break;
+
+            default:
+                return usage(argv[1]);
+        }
+        argv += 2; argc -= 2;
+    }
+
+    if (argc > 1)
+        return usage(argc == 2 && argv[1][1] == 'h' ? NULL : argv[1]);
+
+    if (args.blocks == 0 || args.segment_length <= 0.0f || args.radius <= 0.0f || args.feed_rate <= 0.0f)
+        return usage(NULL);
+
+    memset(&hal, 0, sizeof(HAL));
+
+    hal.version = HAL_VERSION;
+
+    if(!driver_init())
+       return -1;
+
+    if (args.buffer_size && (hal.planner_buffer.blocks = malloc(args.buffer_size * sizeof(plan_block_t))))
+        hal.planner_buffer.size = args.buffer_size;
+#ifdef PLANNER_SOA
+    if (args.buffer_size)
+        hal.planner_buffer.profile = malloc(args.buffer_size * 4 * sizeof(float));
+#endif
+
+    hal.stream.write = bench_write;
+    hal.stream.write_all = bench_write;
+
+    eeprom_emu_init();
+    report_init();
+    settings_init();
+
+    memset(&sys, 0, sizeof(system_t));
+    sys.override.feed_rate = DEFAULT_FEED_OVERRIDE;
+    sys.override.rapid_rate = DEFAULT_RAPID_OVERRIDE;
+
+    plan_reset();
+    plan_sync_position();
+
+    uint32_t block;
+    float target[N_AXIS] = {0}, angle = 0.0f;
+    float angle_increment = args.segment_length / args.radius;
+    plan_line_data_t pl_data;
+
+    memset(&pl_data, 0, sizeof(plan_line_data_t));
+    pl_data.feed_rate = args.feed_rate;
+
+    clock_t start = clock();
+
+    for(block = 0; block < args.blocks; block++) {
+
+        angle += angle_increment;
+        target[X_AXIS] = args.radius * cosf(angle);
+        target[Y_AXIS] = args.radius * sinf(angle);
+        target[Z_AXIS] = angle * 0.1f;
+
+        while(plan_check_full_buffer())
+            plan_discard_current_block();
+
+        plan_buffer_line(target, &pl_data);
+    }
+
+    float elapsed = (float)(clock() - start) / (float)CLOCKS_PER_SEC;
+
+    printf("Planned %" PRIu32 " blocks of %.3f mm in %.3f s, buffer size %d: %.0f blocks/s\n",
+            args.blocks, args.segment_length, elapsed, (int)plan_get_block_buffer_size() + 1, elapsed > 0.0f ? (float)args.blocks / elapsed : 0.0f);
+
+    return 0;
+}
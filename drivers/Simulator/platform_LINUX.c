@@ -24,6 +24,7 @@
 #include <unistd.h>
 #include <termios.h>
 #include <time.h>
+#include <sched.h>
 #include <sys/time.h>
 #include "platform.h"
 
@@ -60,6 +61,11 @@ void platform_sleep(long  microsec)
 {
     struct timespec ts={0};
 
+    if (microsec == 0) { // just yield, as Sleep(0) does on Windows
+        sched_yield();
+        return;
+    }
+
     while (microsec >= MS_PER_SEC){
         ts.tv_sec++;
         microsec -= MS_PER_SEC;
@@ -135,9 +141,11 @@ uint8_t platform_poll_stdin()
 {
     uint8_t char_in = 0;
 
+    // Read unbuffered, kbhit() does not see input already read into the stdio buffer.
+    // stdin is always readable at end of file, read() then returns 0
     enable_kbhit(1);
-    if (kbhit())
-        char_in = getchar();
+    if (kbhit() && read(STDIN_FILENO, &char_in, 1) != 1)
+        char_in = 0;
 
     enable_kbhit(0);
 
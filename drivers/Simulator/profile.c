@@ -0,0 +1,330 @@
+/*
+  profile.c - host CPU time per g-code line, used with the cycle time estimate mode
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Tells which lines of a program are expensive to parse, to generate arc and spline segments for, to plan
+  and to convert to step segments, e.g. to tune the arc output, tolerances and point density of a CAM post.
+
+  The functions are measured by the performance counters, each call is reported by perf_on_record() when it
+  returns with the host time in ns on entry and the time spent. Calls include nested calls, e.g. the parser
+  calls the planner and waits for room in the planner buffer while the simulation advances and step segments
+  are prepared. The time of each call is booked exclusive of the calls nested in it and of the simulation:
+  the running sum of the exclusive time booked is logged with the end time of each call, a call returning
+  then subtracts the time booked since it was entered. The simulation, including the realtime checkpoints
+  the parser and planner loop on while waiting for room in the planner buffer or for motion to complete,
+  is booked to no line, nor is the overhead of the profiling.
+
+  Time spent by the parser, arc and spline generation and the planner is booked against the line being
+  executed, time spent preparing step segments against the line the planner block being prepared was planned
+  from. Blocks are tagged with the line, in the line number reported in status reports, as they are planned.
+
+  The report is written when the end of the input is reached, lines are ordered by descending total time:
+
+    # <line>,<total>,<gc_execute_block>,<mc_arc>,<mc_cubic_b_spline>,<plan_buffer_line>,<planner_recalculate>,<st_prep_buffer>
+    total,<us>,<us>,<us>,<us>,<us>,<us>,<us>
+    line,<line number>,<us>,<us>,<us>,<us>,<us>,<us>,<us>
+
+  Times are host CPU time in microseconds and vary from run to run, the ranking of the lines is what matters.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "simulator.h"
+#include "estimate.h"
+#include "profile.h"
+
+#include "grbl/grbl.h"
+
+#ifdef ENABLE_PERF_COUNTERS
+
+#define PROFILE_HISTORY (1 << 20) // Calls logged, must be a power of 2
+#define PROFILE_STEP_TICKS (F_CPU / 1000) // Ticks to simulate per realtime checkpoint, 1 ms
+
+// Functions for peeking inside planner state:
+plan_block_t *get_block_buffer_head();
+
+typedef enum {
+    Cost_Parse = 0,
+    Cost_Arc,
+    Cost_Spline,
+    Cost_Plan,
+    Cost_Recalculate,
+    Cost_Prep,
+    Cost_N
+} cost_t;
+
+typedef struct {
+    uint32_t line;
+    uint64_t ns[Cost_N];
+    uint64_t total;
+} line_cost_t;
+
+typedef struct {
+    uint32_t end;       // ns
+    uint64_t booked;    // Exclusive time booked up to and including the call, ns
+} call_t;
+
+static struct {
+    FILE *file;
+    uint64_t booked;
+    uint32_t head;
+    uint32_t count;
+    uint32_t rt_end;            // Time the last realtime checkpoint returned, ns
+    uint32_t rt_min_start;      // Earliest entry of the calls returned since, ns
+    bool rt_idle;               // No call returned since the last realtime checkpoint
+    call_t call[PROFILE_HISTORY];
+    line_cost_t *line;
+    uint32_t line_size;
+    uint32_t prep_line;
+    plan_block_t *planned;      // Planner head when the last block was tagged
+    sim_hook_fp on_realtime;
+    sim_hook_fp on_delay;
+} prof = {0};
+
+static line_cost_t *get_line (uint32_t line)
+{
+    if(line >= prof.line_size) {
+
+        uint32_t size = prof.line_size ? prof.line_size : 1024;
+
+        while(size <= line)
+            size <<= 1;
+
+        if((prof.line = realloc(prof.line, size * sizeof(line_cost_t))) == NULL) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(-5);
+        }
+
+        memset(&prof.line[prof.line_size], 0, (size - prof.line_size) * sizeof(line_cost_t));
+        prof.line_size = size;
+    }
+
+    return &prof.line[line];
+}
+
+// Returns the exclusive time booked by calls that returned before the given time.
+static uint64_t booked_before (uint32_t ns)
+{
+    uint32_t lo = 0, hi = prof.count, mid;
+
+    // Calls are logged in the order they returned, find the first returning at or after ns.
+    while(lo < hi) {
+        mid = (lo + hi) >> 1;
+        if((int32_t)(prof.call[(prof.head - prof.count + mid) & (PROFILE_HISTORY - 1)].end - ns) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if(lo)
+        return prof.call[(prof.head - prof.count + lo - 1) & (PROFILE_HISTORY - 1)].booked;
+
+    // Entered before the oldest call logged, the calls returned before it are taken as nested.
+    return prof.count ? prof.call[(prof.head - prof.count) & (PROFILE_HISTORY - 1)].booked : 0;
+}
+
+// Books the time of a call exclusive of nested calls, returns the time booked.
+static uint64_t book (uint32_t start, uint32_t ns)
+{
+    uint64_t nested = prof.booked - booked_before(start), exclusive = ns > nested ? ns - nested : 0;
+
+    prof.booked += exclusive;
+    prof.call[prof.head].end = start + ns;
+    prof.call[prof.head].booked = prof.booked;
+    prof.head = (prof.head + 1) & (PROFILE_HISTORY - 1);
+    if(prof.count < PROFILE_HISTORY)
+        prof.count++;
+
+    return exclusive;
+}
+
+// Books the time spent here since the last call returned as part of the simulation.
+static void book_overhead (void)
+{
+    uint32_t idx = (prof.head - 1) & (PROFILE_HISTORY - 1), now = platform_ns();
+
+    prof.booked += now - prof.call[idx].end;
+    prof.call[idx].end = now;
+    prof.call[idx].booked = prof.booked;
+}
+
+static void profile_record (perf_counter_t counter, uint32_t start, uint32_t cycles)
+{
+    uint32_t line = estimate_line();
+    uint64_t ns = book(start, cycles);
+    cost_t cost;
+    bool looped = counter == Perf_ProtocolRealtime && (prof.rt_idle || (int32_t)(prof.rt_min_start - start) >= 0);
+
+    // The time from the last realtime checkpoint to this one is spent looping on them, waiting for room in the
+    // planner buffer or for motion to complete, if no other call returned in between: book it as simulation.
+    if(looped && (int32_t)(start - prof.rt_end) > 0)
+        prof.booked += start - prof.rt_end;
+
+    if(prof.rt_idle || (int32_t)(start - prof.rt_min_start) < 0)
+        prof.rt_min_start = start;
+    prof.rt_idle = false;
+
+    switch(counter) {
+
+        case Perf_GcodeExecute:
+            cost = Cost_Parse;
+            break;
+
+        case Perf_ArcGenerate:
+            cost = Cost_Arc;
+            break;
+
+        case Perf_SplineGenerate:
+            cost = Cost_Spline;
+            break;
+
+        case Perf_PlanBufferLine:
+            cost = Cost_Plan;
+            // Tag the block queued with the line.
+            if(get_block_buffer_head() != prof.planned) {
+                prof.planned = get_block_buffer_head();
+                prof.planned->prev->line_number = (int32_t)line;
+            }
+            break;
+
+        case Perf_PlannerRecalculate:
+            cost = Cost_Recalculate;
+            break;
+
+        case Perf_PrepBuffer:
+            cost = Cost_Prep;
+            if(plan_get_current_block())
+                prof.prep_line = (uint32_t)plan_get_current_block()->line_number;
+            line = prof.prep_line;
+            break;
+
+        default: // Realtime checkpoints, stepper interrupt and realtime report, part of the simulation.
+            cost = Cost_N;
+            break;
+    }
+
+    if(line && cost != Cost_N) {
+        line_cost_t *l = get_line(line);
+        l->ns[cost] += ns;
+        l->total += ns;
+    }
+
+    book_overhead();
+
+    if(counter == Perf_ProtocolRealtime) {
+        prof.rt_end = prof.call[(prof.head - 1) & (PROFILE_HISTORY - 1)].end;
+        prof.rt_idle = true;
+    }
+}
+
+// Simulates up to 1 ms per checkpoint rather than up to the next interrupt, the step segment buffer holds
+// far more. Keeps the number of checkpoints passed and the overhead booked to the lines that wait for room
+// in the planner buffer down, the rate of the checkpoints is a property of the simulation and not of the line.
+static void profile_realtime (void)
+{
+    uint32_t start = platform_ns();
+    uint64_t clock, until = sim.masterclock + PROFILE_STEP_TICKS;
+
+    do {
+        clock = sim.masterclock;
+        prof.on_realtime();
+    } while(sim.masterclock != clock && sim.masterclock < until);
+
+    book(start, platform_ns() - start);
+}
+
+static void profile_delay (void)
+{
+    uint32_t start = platform_ns();
+
+    prof.on_delay();
+
+    book(start, platform_ns() - start);
+}
+
+static int cmp_cost (const void *a, const void *b)
+{
+    uint64_t ta = ((const line_cost_t *)a)->total, tb = ((const line_cost_t *)b)->total;
+
+    return ta < tb ? 1 : (ta > tb ? -1 : 0);
+}
+
+static void profile_report (void)
+{
+    uint32_t idx, n = 0;
+    uint_fast8_t cost;
+    line_cost_t total = {0};
+
+    perf_on_record = NULL;
+
+    for(idx = 1; idx < prof.line_size; idx++) {
+        if(prof.line[idx].total) {
+            for(cost = 0; cost < Cost_N; cost++)
+                total.ns[cost] += prof.line[idx].ns[cost];
+            total.total += prof.line[idx].total;
+            prof.line[idx].line = idx;
+            prof.line[n++] = prof.line[idx];
+        }
+    }
+
+    qsort(prof.line, n, sizeof(line_cost_t), cmp_cost);
+
+    fprintf(prof.file, "# <line>,<total>,<gc_execute_block>,<mc_arc>,<mc_cubic_b_spline>,<plan_buffer_line>,<planner_recalculate>,<st_prep_buffer>\n");
+
+    fprintf(prof.file, "total,%.3f", (double)total.total / 1000.0);
+    for(cost = 0; cost < Cost_N; cost++)
+        fprintf(prof.file, ",%.3f", (double)total.ns[cost] / 1000.0);
+    fputc('\n', prof.file);
+
+    for(idx = 0; idx < n; idx++) {
+        fprintf(prof.file, "line,%u,%.3f", prof.line[idx].line, (double)prof.line[idx].total / 1000.0);
+        for(cost = 0; cost < Cost_N; cost++)
+            fprintf(prof.file, ",%.3f", (double)prof.line[idx].ns[cost] / 1000.0);
+        fputc('\n', prof.file);
+    }
+
+    fclose(prof.file);
+}
+
+bool profile_init (FILE *report_file)
+{
+    prof.file = report_file;
+    prof.on_realtime = sim.on_realtime;
+    prof.on_delay = sim.on_delay;
+
+    sim.on_realtime = profile_realtime;
+    sim.on_delay = profile_delay;
+    perf_on_record = profile_record;
+
+    atexit(profile_report);
+
+    return true;
+}
+
+#else
+
+bool profile_init (FILE *report_file)
+{
+    return false;
+}
+
+#endif
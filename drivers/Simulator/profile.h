@@ -0,0 +1,32 @@
+/*
+  profile.h - host CPU time per g-code line, used with the cycle time estimate mode
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef profile_h
+#define profile_h
+
+#include <stdio.h>
+#include <stdbool.h>
+
+// Sets up profiling of the g-code run by the cycle time estimate, call after estimate_init().
+// The report is written to report_file on exit. Returns false if not compiled with ENABLE_PERF_COUNTERS.
+bool profile_init (FILE *report_file);
+
+#endif
@@ -0,0 +1,275 @@
+/*
+  read_float_bench.c - Grbl read_float() throughput and accuracy benchmark
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Extracts all word values from one or more g-code files and reports the number of values converted
+  per second by read_float() and by the previous implementation, kept here as a reference.
+  Each value is also checked against the correctly rounded result from strtod(), the number of
+  values that differ is reported for both implementations. Returns non-zero if read_float() fails
+  to parse a value accepted by the reference or returns a less accurate result.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "platform.h"
+#include "grbl/grbl.h"
+
+typedef bool (*read_float_ptr)(char *line, uint_fast8_t *char_counter, float *float_ptr);
+
+typedef struct arg_vars {
+    uint32_t passes;
+} arg_vars_t;
+
+arg_vars_t args;
+const char* progname;
+
+static char **values = NULL;
+static uint32_t n_values = 0, values_size = 0;
+
+int usage (const char* badarg)
+{
+    if (badarg)
+        printf("Unrecognized option %s\n", badarg);
+
+    printf("Usage: \n"
+     "%s <Options> gcode_file [gcode_file...]\n"
+     "  Options:\n"
+     "    -n <passes> : number of times to convert the values. Default=100\n"
+     "\n  Reports read_float() throughput in values per second\n",
+     progname);
+
+    return -1;
+}
+
+// Previous read_float() implementation, scales by repeated multiplication with inexact constants.
+static bool read_float_ref (char *line, uint_fast8_t *char_counter, float *float_ptr)
+{
+    char *ptr = line + *char_counter;
+    int_fast8_t exp = 0;
+    uint_fast8_t ndigit = 0, c;
+    uint32_t intval = 0;
+    bool isnegative, isdecimal = false;
+
+    c = *ptr++;
+
+    if ((isnegative = (c == '-')) || c == '+')
+        c = *ptr++;
+
+    while(c) {
+        c -= '0';
+        if (c <= 9) {
+            ndigit++;
+            if (ndigit <= MAX_INT_DIGITS) {
+                if (isdecimal)
+                    exp--;
+                intval = (((intval << 2) + intval) << 1) + c;
+            } else if (!isdecimal)
+                exp++;
+        } else if (c == (uint_fast8_t)('.' - '0') && !isdecimal)
+            isdecimal = true;
+         else
+            break;
+
+        c = *ptr++;
+    }
+
+    if (!ndigit)
+        return false;
+
+    float fval = (float)intval;
+
+    if (fval != 0.0f) {
+        while (exp <= -2) {
+            fval *= 0.01f;
+            exp += 2;
+        }
+        if (exp < 0)
+            fval *= 0.1f;
+        else if (exp > 0) do {
+            fval *= 10.0f;
+        } while (--exp > 0);
+    }
+
+    *float_ptr = isnegative ? - fval : fval;
+    *char_counter = ptr - line - 1;
+
+    return true;
+}
+
+static bool add_value (const char *value, size_t length)
+{
+    if(n_values == values_size) {
+        values_size = values_size ? values_size * 2 : 4096;
+        if((values = realloc(values, values_size * sizeof(char *))) == NULL)
+            return false;
+    }
+
+    if((values[n_values] = malloc(length + 1)) == NULL)
+        return false;
+
+    memcpy(values[n_values], value, length);
+    values[n_values++][length] = '\0';
+
+    return true;
+}
+
+// Extracts the values following word letters, comments are skipped.
+static bool load_file (const char *name)
+{
+    FILE *file;
+    char line[LINE_BUFFER_SIZE + 2], *ptr, *start;
+    bool comment;
+
+    if((file = fopen(name, "r")) == NULL) {
+        perror("fopen");
+        printf("Error opening : %s\n", name);
+        return false;
+    }
+
+    while(fgets(line, sizeof(line), file)) {
+        comment = false;
+        for(ptr = line; *ptr && *ptr != ';' && *ptr != '$'; ptr++) {
+            if(comment)
+                comment = *ptr != ')';
+            else if(*ptr == '(')
+                comment = true;
+            else if(isalpha((int)*ptr)) {
+                start = ptr + 1;
+                while(*start == ' ')
+                    start++;
+                for(ptr = start; *ptr == '-' || *ptr == '+' || *ptr == '.' || isdigit((int)*ptr); ptr++);
+                if(ptr > start && !add_value(start, ptr - start))
+                    return false;
+                ptr--;
+            }
+        }
+    }
+
+    fclose(file);
+
+    return true;
+}
+
+static float run (read_float_ptr convert, float *results)
+{
+    uint32_t pass, idx;
+    uint_fast8_t char_counter;
+    float value, sum = 0.0f;
+
+    clock_t start = clock();
+
+    for(pass = 0; pass < args.passes; pass++) {
+        for(idx = 0; idx < n_values; idx++) {
+            char_counter = 0;
+            if(convert(values[idx], &char_counter, &value))
+                sum += value;
+            if(pass == 0)
+                results[idx] = value;
+        }
+    }
+
+    float elapsed = (float)(clock() - start) / (float)CLOCKS_PER_SEC;
+
+    // Keep the conversions from being optimized away.
+    if(sum == 1.2345e-30f)
+        printf("%f\n", sum);
+
+    return elapsed;
+}
+
+int main (int argc, char *argv[])
+{
+    //defaults
+    args.passes = 100;
+
+    progname = argv[0];
+
+    while (argc > 2 && argv[1][0] == '-') {
+        switch(argv[1][1]) {
+
+            case 'n':
+                args.passes = (uint32_t)atol(argv[2]);
+                break;
+
+            default:
+                return usage(argv[1]);
+        }
+        argv += 2; argc -= 2;
+    }
+
+    if (argc < 2 || argv[1][0] == '-' || args.passes == 0)
+        return usage(argc > 1 && argv[1][1] != 'h' ? argv[1] : NULL);
+
+    for(argv++; *argv; argv++) {
+        if(!load_file(*argv))
+            return -1;
+    }
+
+    if(n_values == 0)
+        return usage(NULL);
+
+    float *results = malloc(n_values * sizeof(float)), *results_ref = malloc(n_values * sizeof(float));
+
+    if(results == NULL || results_ref == NULL)
+        return -1;
+
+    float elapsed_ref = run(read_float_ref, results_ref);
+    float elapsed = run(read_float, results);
+
+    uint32_t idx, inexact = 0, inexact_ref = 0, failed = 0;
+    uint_fast8_t char_counter;
+    float value;
+
+    for(idx = 0; idx < n_values; idx++) {
+        float exact = (float)strtod(values[idx], NULL);
+        char_counter = 0;
+        if(!read_float(values[idx], &char_counter, &value)) {
+            char_counter = 0;
+            if(read_float_ref(values[idx], &char_counter, &value)) {
+                failed++;
+                printf("Not converted: %s\n", values[idx]);
+            }
+        } else {
+            if(results_ref[idx] != exact)
+                inexact_ref++;
+            if(results[idx] != exact) {
+                inexact++;
+                if(fabsf(results[idx] - exact) > fabsf(results_ref[idx] - exact)) {
+                    failed++;
+                    printf("Less accurate: %s %.9g, was %.9g\n", values[idx], results[idx], results_ref[idx]);
+                }
+            }
+        }
+    }
+
+    printf("Converted %" PRIu32 " values %" PRIu32 " times\n", n_values, args.passes);
+    printf("  reference  : %.3f s, %" PRIu32 " inexact: %.0f values/s\n", elapsed_ref, inexact_ref, elapsed_ref > 0.0f ? (float)n_values * (float)args.passes / elapsed_ref : 0.0f);
+    printf("  read_float : %.3f s, %" PRIu32 " inexact: %.0f values/s\n", elapsed, inexact, elapsed > 0.0f ? (float)n_values * (float)args.passes / elapsed : 0.0f);
+
+    if(failed)
+        printf("%" PRIu32 " values failed\n", failed);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,206 @@
+/*
+  replay.c - input capture and deterministic replay
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Reproduces timing dependent behaviour, such as planner starvation under a given sender cadence, from input
+  recorded by the simulator or dumped from the receive ring buffer of a controller. The capture is a text file,
+  lines starting with # are comments, each other line is a record of bytes received back to back:
+
+    <time in us> <byte as two hex digits>...
+
+  Times are counted from boot, records must be in time order. A driver dump may write one record per byte.
+
+  When recording, a new record is started after a line feed, after a gap of more than two character times
+  or when a record holds CAPTURE_RECORD_MAX bytes.
+
+  On replay there is no hardware thread, the simulation is advanced by the grbl thread at each realtime
+  checkpoint and in busy delays, as for the cycle time estimate, but with serial input and output simulated
+  at the baud rate. The bytes of a record are delivered through the simulated UART from the time recorded,
+  paced by the baud rate and by the free space in the input buffer. The simulated clock and every interrupt
+  then only depend on the capture and the firmware, not on the host, so replays of the same capture with the
+  same settings produce the same step, block and response output and runs with different firmware can be
+  compared. Grbl output is written to the -g file, CTRL-F in the capture is ignored.
+
+  When all input has been delivered and processed and motion has completed a summary is written to the block
+  file:
+
+    replay,<bytes>,<seconds>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simulator.h"
+#include "mcu.h"
+#include "serial.h"
+#include "replay.h"
+
+#include "grbl/grbl.h"
+
+#define REPLAY_MAX_TICKS (F_CPU / 1000) // Maximum ticks to advance at a time, 1 ms
+#define CAPTURE_RECORD_MAX 64 // Max. bytes per record when recording
+
+static struct {
+    FILE *file;
+    uint8_t (*getchar)(void);   // Input recorded
+    uint64_t last_tick;         // Time of the last byte recorded
+    uint_fast8_t length;        // Bytes in the current record, 0 if none
+    bool eol;                   // Last byte recorded was a LF
+} rec = {0};
+
+static struct {
+    FILE *file;
+    bool eof;
+    uint64_t due;               // Tick at which the bytes of the current record are due
+    char *data;                 // Next hex digits of the current record
+    uint32_t bytes;             // Bytes delivered
+    char line[1024];
+} rp = {0};
+
+/* Capture */
+
+static uint8_t record_getchar (void)
+{
+    uint8_t c = rec.getchar();
+
+    if(c && c != 0x06) {
+
+        if(rec.length == 0 || rec.eol || rec.length == CAPTURE_RECORD_MAX || sim.masterclock - rec.last_tick > 2 * sim.baud_ticks) {
+            if(rec.length)
+                fputc('\n', rec.file);
+            fprintf(rec.file, "%llu", (unsigned long long)(sim.masterclock * 1000000 / F_CPU));
+            rec.length = 0;
+        }
+
+        fprintf(rec.file, " %02X", c);
+        rec.length++;
+        rec.eol = c == ASCII_LF;
+        rec.last_tick = sim.masterclock;
+        fflush(rec.file); // The simulator may be killed rather than exit.
+    }
+
+    return c;
+}
+
+static void record_close (void)
+{
+    if(rec.length)
+        fputc('\n', rec.file);
+
+    fclose(rec.file);
+}
+
+void replay_record_init (FILE *capture_file)
+{
+    rec.file = capture_file;
+    rec.getchar = sim.getchar;
+
+    fprintf(rec.file, "# grblHAL input capture, <time in us> <bytes as hex>...\n");
+
+    sim.getchar = record_getchar;
+
+    atexit(record_close);
+}
+
+/* Replay */
+
+// Reads the next record, sets rp.eof at the end of the capture.
+static void next_record (void)
+{
+    unsigned long long us;
+    int n;
+
+    rp.data = NULL;
+
+    while(rp.data == NULL && fgets(rp.line, sizeof(rp.line), rp.file)) {
+        if(*rp.line != '#' && sscanf(rp.line, "%llu%n", &us, &n) == 1) {
+            rp.due = (uint64_t)us * F_CPU / 1000000;
+            rp.data = &rp.line[n];
+        }
+    }
+
+    rp.eof = rp.data == NULL;
+}
+
+static uint8_t replay_getchar (void)
+{
+    unsigned int c;
+    int n;
+
+    while(!rp.eof && sim.masterclock >= rp.due) {
+        if(sscanf(rp.data, "%2x%n", &c, &n) == 1) {
+            rp.data += n;
+            if(c && c != 0x06) {
+                rp.bytes++;
+                return (uint8_t)c;
+            }
+        } else
+            next_record();
+    }
+
+    return 0;
+}
+
+static void replay_advance (void)
+{
+    uint64_t max_ticks = REPLAY_MAX_TICKS;
+
+    if(!rp.eof) {
+        if(sim.masterclock >= rp.due)
+            mcu_serial_poll(); // Input is due, read from the next character time.
+        else
+            max_ticks = min(max_ticks, rp.due - sim.masterclock);
+    }
+
+    sim_step_serial((uint32_t)max_ticks);
+}
+
+static inline bool motion_active (void)
+{
+    return !!(sys.state & (STATE_HOMING|STATE_CYCLE|STATE_HOLD|STATE_JOG));
+}
+
+static void replay_realtime (void)
+{
+    replay_advance();
+
+    if(rp.eof && !motion_active() && plan_get_current_block() == NULL &&
+        serialRxFree() == RX_BUFFER_SIZE - 1 && serialTxFree() == TX_BUFFER_SIZE - 1 && !uart.tx_flag) {
+        fprintf(args.block_out_file, "replay,%u,%.6f\n", rp.bytes, (double)sim.masterclock / (double)F_CPU);
+        fflush(args.block_out_file);
+        fflush(args.serial_out_file);
+        shutdown_simulator();
+        exit(EXIT_SUCCESS);
+    }
+}
+
+void replay_init (FILE *capture_file)
+{
+    rp.file = capture_file;
+
+    next_record();
+
+    sim.replay = true;
+    sim.getchar = replay_getchar;
+    sim.on_realtime = replay_realtime;
+    sim.on_delay = replay_advance;
+}
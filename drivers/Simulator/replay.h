@@ -0,0 +1,33 @@
+/*
+  replay.h - input capture and deterministic replay
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef replay_h
+#define replay_h
+
+#include <stdio.h>
+
+// Records the input read by sim.getchar to capture_file along with the time received, call after sim.getchar is set.
+void replay_record_init (FILE *capture_file);
+
+// Sets up the simulator hooks for replaying the input recorded in capture_file.
+void replay_init (FILE *capture_file);
+
+#endif
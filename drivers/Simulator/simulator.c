@@ -43,7 +43,9 @@ sim_vars_t sim = {
     .on_init = sim_nop,
     .on_tick = sim_nop,
     .on_byte = sim_nop,
-    .on_shutdown = sim_nop
+    .on_shutdown = sim_nop,
+    .on_realtime = sim_nop,
+    .on_delay = sim_nop
 };
 
 // Setup 
@@ -80,12 +82,79 @@ void simulate_hardware (bool do_serial)
   //  can ignore pinout int vect - hw start/hold not supported
 }
 
-// Runs the hardware simulator at the desired rate until sim.exit is set
+// Skips ticks where no interrupt is raised and no serial data is transferred, only timers are counted down.
+static void skip_ticks (uint64_t ticks)
+{
+    mcu_skip_ticks((uint32_t)ticks);
+    sim.masterclock += ticks;
+    sim.sim_time = (float)sim.masterclock / (float)F_CPU;
+}
+
+// At maximum speedup the simulation would run ahead of the grbl thread, wait for it to pass through
+// a realtime checkpoint twice, that is to complete a protocol_execute_realtime() call, after each event.
+// This gives it time to process input and to prepare step segments as it would on a real controller.
+static void wait_for_grbl (void)
+{
+    uint32_t count = sim.realtime_count, ns_start = platform_ns(), spins = 0;
+
+    while (sim.realtime_count - count < 2 && platform_ns() - ns_start < 1000000) {
+        if (++spins > 1000)
+            platform_sleep(0);
+    }
+}
+
+static uint64_t next_byte_tick = F_CPU;   //wait 1 sec before reading IO.
+static uint64_t next_poll_tick = F_CPU;   //check for input every ms when none was available.
+
+// Simulates the next tick where something happens, a timer interrupt, a pin change interrupt or a serial
+// character, ticks in between are skipped. Stops at simulated_ticks if nothing happens before.
+// Returns true if an interrupt was raised or a serial character was transferred.
+static bool simulate_next_event (uint64_t simulated_ticks)
+{
+    uint64_t ticks;
+
+    if (sim.masterclock >= next_poll_tick) {
+        mcu_serial_poll();
+        next_poll_tick += F_CPU / 1000;
+    }
+
+    // find the next tick where something happens
+    ticks = min(mcu_next_event(), next_poll_tick - sim.masterclock);
+    if (mcu_serial_pending())
+        ticks = min(ticks, next_byte_tick >= sim.masterclock ? next_byte_tick - sim.masterclock + 1 : 1);
+    ticks = min(ticks, simulated_ticks - sim.masterclock);
+
+    if (ticks > 1)
+        skip_ticks(ticks - 1);
+
+    // keep the baud rate phase when no serial data was transferred
+    if (next_byte_tick < sim.masterclock)
+        next_byte_tick += (sim.masterclock - next_byte_tick + sim.baud_ticks - 1) / sim.baud_ticks * sim.baud_ticks;
+
+    // only read serial port as fast as the baud rate allows
+    bool read_serial = (sim.masterclock >= next_byte_tick);
+    bool event = read_serial || mcu_next_event() == 1;
+
+    // do low level hardware
+    simulate_hardware(read_serial);
+
+    // do app-specific per-tick processing
+    sim.on_tick();
+
+    if (read_serial) {
+        next_byte_tick += sim.baud_ticks;
+        // do app-specific per-byte processing
+        sim.on_byte();
+    }
+
+    return event;
+}
+
+// Runs the hardware simulator at the desired rate until sim.exit is set.
 void sim_loop (void)
 {
     uint64_t simulated_ticks=0;
     uint32_t ns_prev = platform_ns();
-    uint64_t next_byte_tick = F_CPU;   //wait 1 sec before reading IO.
 
     while (sim.exit != exit_OK  ) { //don't quit until idle
 
@@ -97,27 +166,39 @@ void sim_loop (void)
             ns_prev = ns_now;
         }
         else
-            simulated_ticks++;  //as fast as possible
+            simulated_ticks = sim.masterclock + F_CPU / 1000;  //as fast as possible, 1 ms per pass
 
         while (sim.masterclock < simulated_ticks) {
-            // only read serial port as fast as the baud rate allows
-            bool read_serial = (sim.masterclock >= next_byte_tick);
+            if (simulate_next_event(simulated_ticks) && !sim.speedup)
+                wait_for_grbl();
+        }
 
-            // do low level hardware
-            simulate_hardware(read_serial);
+        if (sim.speedup)
+            platform_sleep(25); // yield
+        else
+            wait_for_grbl();
+    }
+}
 
-            // do app-specific per-tick processing
-            sim.on_tick();
+// Advances the simulation to the next tick where a timer or pin change interrupt is raised, or by max_ticks
+// if that comes first. Used when the grbl thread drives the simulation, serial input and output is not simulated.
+void sim_step (uint32_t max_ticks)
+{
+    uint32_t ticks = min(mcu_next_event(), max_ticks);
 
-            if (read_serial) {
-                next_byte_tick += sim.baud_ticks;
-                // do app-specific per-byte processing
-                sim.on_byte();
-            }
-        }
+    if (ticks > 1)
+        skip_ticks(ticks - 1);
 
-        platform_sleep(25); // yield
-    }
+    simulate_hardware(false);
+
+    sim.on_tick();
+}
+
+// As sim_step() but with serial input and output simulated at the baud rate. Used when the grbl thread
+// drives the simulation of a recorded input stream.
+void sim_step_serial (uint32_t max_ticks)
+{
+    simulate_next_event(sim.masterclock + max_ticks);
 }
 
 // Print serial output to args.serial_out_file
@@ -134,6 +215,9 @@ void sim_serial_out (uint8_t data)
             fprintf(args.serial_out_file, "%c ", args.comment_char);
         buf[len] = '\0';
         fprintf(args.serial_out_file, "%s", buf);
+        // flush complete lines, output is fully buffered when stdout is a pipe
+        if(data == '\n')
+            fflush(args.serial_out_file);
         // don't print comment on next line if we are just printing to avoid buffer overflow
         continuation = (len >= 128); 
         len = 0;
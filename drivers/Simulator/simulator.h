@@ -25,6 +25,7 @@
 #define simulator_h
 
 #include <stdio.h>
+#include <stdbool.h>
 
 #include "platform.h"
 
@@ -38,6 +39,10 @@ typedef struct sim_vars {
     enum {exit_NO, exit_REQ, exit_OK} exit;
     float speedup;
     int32_t baud_ticks;
+    volatile uint32_t realtime_count; // incremented by the grbl thread at each realtime checkpoint
+    bool estimate;    // cycle time estimation, the grbl thread drives the simulation
+    bool replay;      // replay of recorded input, the grbl thread drives the simulation
+    uint32_t block_count; // incremented by the stepper driver when execution of a new block starts
     int socket_fd;
     uint8_t (*getchar)(void);
     void (*putchar)(uint8_t);
@@ -45,10 +50,14 @@ typedef struct sim_vars {
     sim_hook_fp on_tick;
     sim_hook_fp on_byte;
     sim_hook_fp on_shutdown;
+    sim_hook_fp on_realtime;  // called by the grbl thread at each realtime checkpoint
+    sim_hook_fp on_delay;     // called by the grbl thread while waiting for a delay to expire
 } sim_vars_t;
 
 extern sim_vars_t sim;
 
+void sim_nop (void);
+
 typedef struct arg_vars {
     // Output file handles
     FILE *block_out_file;
@@ -56,6 +65,8 @@ typedef struct arg_vars {
     FILE *serial_out_file;
     char eeprom_file[128];
     double step_time;       // Minimum time step for printing stepper values. Given by user via command line
+    bool step_events;       // Print every step pulse and segment instead of sampled positions
+    int trace_format;       // Step and block trace format, see trace_file.h
     uint8_t comment_char;   // Char to prefix comments; default  '#' 
     uint16_t port;          // Port number for telnet communication
 } arg_vars_t;
@@ -74,6 +85,12 @@ void shutdown_simulator (void);
 // Simulates the hardware until sim.exit is set.
 void sim_loop (void);
 
+// Advances the simulation to the next event, by max_ticks at most. No serial emulation.
+void sim_step (uint32_t max_ticks);
+
+// Advances the simulation to the next event or serial character, by max_ticks at most.
+void sim_step_serial (uint32_t max_ticks);
+
 // Call the stepper interrupt until one block is finished
 // (defined in serial.c)
 void simulate_serial (void);
@@ -0,0 +1,495 @@
+/*
+  spline_bench.c - Grbl cubic spline (G5) evaluation benchmark
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Reports the number of G5 splines per second segmented into chords by mc_cubic_b_spline() and by the
+  previous adaptive step implementation, kept here as a reference. The splines are extracted from one
+  or more g-code files, or from a generated G5 heavy program if no files are given.
+
+  Timing is done in check mode so that mc_line() returns without planning the chords. The chords are
+  then collected by planning them with the planner drained at each realtime checkpoint, this to count
+  them and to find the largest deviation from the exact curve. Chord end points are thus rounded to
+  steps. Uses the default settings from defaults.h.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+
+#include "platform.h"
+#include "grbl/grbl.h"
+
+#define CURVE_SAMPLES 256   // Points per spline the deviation is evaluated at
+
+typedef void (*spline_ptr)(float *target, plan_line_data_t *pl_data, float *position, float *offset1, float *offset2);
+
+typedef struct {
+    float p0[2], p1[2], p2[2], p3[2]; // Start point, first and second control points and end point
+} spline_t;
+
+typedef struct arg_vars {
+    uint32_t passes;
+    uint32_t splines;
+} arg_vars_t;
+
+arg_vars_t args;
+const char* progname;
+
+static spline_t *splines = NULL;
+static uint32_t n_splines = 0, splines_size = 0;
+
+static float *chords = NULL;            // Chord end points collected from the planner, x and y
+static uint32_t n_chords = 0, chords_size = 0;
+
+int usage (const char* badarg)
+{
+    if (badarg)
+        printf("Unrecognized option %s\n", badarg);
+
+    printf("Usage: \n"
+     "%s <Options> [gcode_file...]\n"
+     "  Options:\n"
+     "    -n <passes>  : number of times to evaluate the splines. Default=10\n"
+     "    -s <splines> : number of splines generated when no files are given. Default=20000\n"
+     "\n  Reports G5 spline evaluation throughput in splines per second\n",
+     progname);
+
+    return -1;
+}
+
+static void bench_write (const char *data)
+{
+}
+
+// Previous mc_cubic_b_spline() implementation, from a pull request for Marlin by Giovanni Mascellani.
+// Adaptive step in t, halved or doubled until the midpoint of each chord is within BEZIER_SIGMA of the curve.
+
+static inline float interp (const float a, const float b, const float t)
+{
+    return (1.0f - t) * a + t * b;
+}
+
+static inline float eval_bezier (const float a, const float b, const float c, const float d, const float t)
+{
+    const float iab = interp(a, b, t),
+                ibc = interp(b, c, t),
+                icd = interp(c, d, t),
+                iabc = interp(iab, ibc, t),
+                ibcd = interp(ibc, icd, t);
+
+    return interp(iabc, ibcd, t);
+}
+
+static inline float dist1 (const float x1, const float y1, const float x2, const float y2)
+{
+    return fabsf(x1 - x2) + fabsf(y1 - y2);
+}
+
+static void cubic_b_spline_ref (float *target, plan_line_data_t *pl_data, float *position, float *offset1, float *offset2)
+{
+    float first[2] = { position[X_AXIS] + offset1[X_AXIS], position[Y_AXIS] + offset1[Y_AXIS] };
+    float second[2] = { target[X_AXIS] + offset2[X_AXIS], target[Y_AXIS] + offset2[Y_AXIS] };
+    float bez_target[N_AXIS];
+
+    memcpy(bez_target, position, sizeof(float) * N_AXIS);
+
+    float t = 0.0f, step = BEZIER_MAX_STEP;
+
+    while (t < 1.0f) {
+
+        bool did_reduce = false;
+        float new_t = t + step;
+
+        if(new_t > 1.0f)
+            new_t = 1.0f;
+
+        float new_pos0 = eval_bezier(position[X_AXIS], first[X_AXIS], second[X_AXIS], target[X_AXIS], new_t),
+              new_pos1 = eval_bezier(position[Y_AXIS], first[Y_AXIS], second[Y_AXIS], target[Y_AXIS], new_t);
+
+        while(new_t - t >= (BEZIER_MIN_STEP)) {
+
+            const float candidate_t = 0.5f * (t + new_t),
+                      candidate_pos0 = eval_bezier(position[X_AXIS], first[X_AXIS], second[X_AXIS], target[X_AXIS], candidate_t),
+                      candidate_pos1 = eval_bezier(position[Y_AXIS], first[Y_AXIS], second[Y_AXIS], target[Y_AXIS], candidate_t),
+                      interp_pos0 = 0.5f * (bez_target[X_AXIS] + new_pos0),
+                      interp_pos1 = 0.5f * (bez_target[Y_AXIS] + new_pos1);
+
+            if (dist1(candidate_pos0, candidate_pos1, interp_pos0, interp_pos1) <= (BEZIER_SIGMA))
+                break;
+
+            new_t = candidate_t;
+            new_pos0 = candidate_pos0;
+            new_pos1 = candidate_pos1;
+            did_reduce = true;
+        }
+
+        if (!did_reduce) while (new_t - t <= BEZIER_MAX_STEP) {
+
+            const float candidate_t = t + 2.0f * (new_t - t);
+
+            if (candidate_t >= 1.0f)
+                break;
+
+            const float candidate_pos0 = eval_bezier(position[X_AXIS], first[X_AXIS], second[X_AXIS], target[X_AXIS], candidate_t),
+                      candidate_pos1 = eval_bezier(position[Y_AXIS], first[Y_AXIS], second[Y_AXIS], target[Y_AXIS], candidate_t),
+                      interp_pos0 = 0.5f * (bez_target[X_AXIS] + candidate_pos0),
+                      interp_pos1 = 0.5f * (bez_target[Y_AXIS] + candidate_pos1);
+
+            if (dist1(new_pos0, new_pos1, interp_pos0, interp_pos1) > (BEZIER_SIGMA))
+                break;
+
+            new_t = candidate_t;
+            new_pos0 = candidate_pos0;
+            new_pos1 = candidate_pos1;
+        }
+
+        step = new_t - t;
+        t = new_t;
+
+        bez_target[X_AXIS] = new_pos0;
+        bez_target[Y_AXIS] = new_pos1;
+
+        if(!mc_line(bez_target, pl_data))
+            return;
+    }
+}
+
+// End of reference implementation
+
+static bool add_spline (float *p0, float *p1, float *p2, float *p3)
+{
+    if(n_splines == splines_size) {
+        splines_size = splines_size ? splines_size * 2 : 4096;
+        if((splines = realloc(splines, splines_size * sizeof(spline_t))) == NULL)
+            return false;
+    }
+
+    memcpy(splines[n_splines].p0, p0, sizeof(float) * 2);
+    memcpy(splines[n_splines].p1, p1, sizeof(float) * 2);
+    memcpy(splines[n_splines].p2, p2, sizeof(float) * 2);
+    memcpy(splines[n_splines++].p3, p3, sizeof(float) * 2);
+
+    return true;
+}
+
+// Extracts the G5 moves from a file, absolute millimeter coordinates are assumed. The end point
+// of any motion with X or Y words is tracked, first control point offsets default to the negated
+// second control point offsets of the previous spline as in gc_execute_block().
+static bool load_file (const char *name)
+{
+    FILE *file;
+    char line[LINE_BUFFER_SIZE + 2], *ptr;
+    float position[2] = {0}, target[2], ij[2], pq[2] = {0}, value;
+    bool comment, spline, has_ij;
+
+    if((file = fopen(name, "r")) == NULL) {
+        perror("fopen");
+        printf("Error opening : %s\n", name);
+        return false;
+    }
+
+    while(fgets(line, sizeof(line), file)) {
+
+        comment = spline = has_ij = false;
+        memcpy(target, position, sizeof(target));
+        ij[0] = -pq[0];
+        ij[1] = -pq[1];
+
+        for(ptr = line; *ptr && *ptr != ';' && *ptr != '$'; ptr++) {
+            if(comment)
+                comment = *ptr != ')';
+            else if(*ptr == '(')
+                comment = true;
+            else if(isalpha((int)*ptr)) {
+                char letter = toupper(*ptr);
+                value = (float)strtod(ptr + 1, &ptr);
+                ptr--;
+                switch(letter) {
+                    case 'G': spline = value == 5.0f; break;
+                    case 'X': target[0] = value; break;
+                    case 'Y': target[1] = value; break;
+                    case 'I': ij[0] = value; has_ij = true; break;
+                    case 'J': ij[1] = value; has_ij = true; break;
+                    case 'P': pq[0] = value; break;
+                    case 'Q': pq[1] = value; break;
+                }
+            }
+        }
+
+        if(spline) {
+            float p1[2] = { position[0] + ij[0], position[1] + ij[1] }, p2[2] = { target[0] + pq[0], target[1] + pq[1] };
+            if(!add_spline(position, p1, p2, target))
+                return false;
+        } else if(has_ij)
+            pq[0] = pq[1] = 0.0f; // Arc offsets, not a spline continuation
+
+        memcpy(position, target, sizeof(position));
+    }
+
+    fclose(file);
+
+    return true;
+}
+
+// Generates a tangent continuous chain of splines of varying size, from fine detail to long sweeps.
+static bool generate_splines (uint32_t count)
+{
+    uint32_t seed = 12345;
+    float p0[2] = {0}, p1[2], p2[2], p3[2], pq[2] = { 1.0f, 0.0f }, size;
+
+    while(count--) {
+        seed = seed * 1103515245 + 12345;
+        size = 0.5f + (float)((seed >> 16) % 500) / 10.0f;
+        for(uint_fast8_t idx = 0; idx < 2; idx++) {
+            seed = seed * 1103515245 + 12345;
+            p3[idx] = p0[idx] + size * ((float)((seed >> 16) % 2001) / 1000.0f - 1.0f);
+            p1[idx] = p0[idx] - pq[idx];
+            seed = seed * 1103515245 + 12345;
+            pq[idx] = size * ((float)((seed >> 16) % 2001) / 2000.0f - 0.5f);
+            p2[idx] = p3[idx] + pq[idx];
+        }
+        if(!add_spline(p0, p1, p2, p3))
+            return false;
+        memcpy(p0, p3, sizeof(p0));
+    }
+
+    return true;
+}
+
+static void spline_args (spline_t *spline, float *target, float *position, float *offset1, float *offset2)
+{
+    memset(target, 0, sizeof(float) * N_AXIS);
+    memset(position, 0, sizeof(float) * N_AXIS);
+    memset(offset1, 0, sizeof(float) * N_AXIS);
+    memset(offset2, 0, sizeof(float) * N_AXIS);
+
+    for(uint_fast8_t idx = 0; idx < 2; idx++) {
+        position[idx] = spline->p0[idx];
+        target[idx] = spline->p3[idx];
+        offset1[idx] = spline->p1[idx] - spline->p0[idx];
+        offset2[idx] = spline->p2[idx] - spline->p3[idx];
+    }
+}
+
+static float run (spline_ptr evaluate)
+{
+    uint32_t pass, idx;
+    float target[N_AXIS], position[N_AXIS], offset1[N_AXIS], offset2[N_AXIS];
+    plan_line_data_t pl_data;
+
+    memset(&pl_data, 0, sizeof(plan_line_data_t));
+    pl_data.feed_rate = 1000.0f;
+    sys.state = STATE_CHECK_MODE;
+
+    clock_t start = clock();
+
+    for(pass = 0; pass < args.passes; pass++) {
+        for(idx = 0; idx < n_splines; idx++) {
+            spline_args(&splines[idx], target, position, offset1, offset2);
+            evaluate(target, &pl_data, position, offset1, offset2);
+        }
+    }
+
+    return (float)(clock() - start) / (float)CLOCKS_PER_SEC;
+}
+
+static void add_chord (void)
+{
+    float mpos[N_AXIS];
+
+    if(n_chords == chords_size) {
+        chords_size = chords_size ? chords_size * 2 : 4096;
+        if((chords = realloc(chords, chords_size * 2 * sizeof(float))) == NULL) {
+            printf("Out of memory\n");
+            exit(-1);
+        }
+    }
+
+    plan_get_planner_mpos(mpos);
+    chords[n_chords * 2] = mpos[X_AXIS];
+    chords[n_chords++ * 2 + 1] = mpos[Y_AXIS];
+}
+
+// Called from the realtime checkpoint in mc_line(), records the end point of the block planned since the
+// previous call and discards it so the planner never fills up.
+static void bench_realtime (uint_fast16_t state)
+{
+    if(plan_get_current_block()) {
+        add_chord();
+        while(plan_get_current_block())
+            plan_discard_current_block();
+    }
+}
+
+static float distance_to_chord (float x, float y, float *c0, float *c1)
+{
+    float dx = c1[0] - c0[0], dy = c1[1] - c0[1], len_sqr = dx * dx + dy * dy, u = 0.0f;
+
+    if(len_sqr > 0.0f) {
+        u = ((x - c0[0]) * dx + (y - c0[1]) * dy) / len_sqr;
+        u = u < 0.0f ? 0.0f : (u > 1.0f ? 1.0f : u);
+    }
+
+    dx = c0[0] + u * dx - x;
+    dy = c0[1] + u * dy - y;
+
+    return sqrtf(dx * dx + dy * dy);
+}
+
+// Returns the largest distance from the curve to the chords, the curve is sampled and each sample
+// is matched with the nearest of the current and following chords.
+static float deviation (spline_t *spline, float *points, uint32_t n_points)
+{
+    uint32_t sample, chord = 0;
+    float t, x, y, d, max_deviation = 0.0f;
+
+    for(sample = 0; sample <= CURVE_SAMPLES; sample++) {
+        t = (float)sample / (float)CURVE_SAMPLES;
+        x = eval_bezier(spline->p0[0], spline->p1[0], spline->p2[0], spline->p3[0], t);
+        y = eval_bezier(spline->p0[1], spline->p1[1], spline->p2[1], spline->p3[1], t);
+        d = n_points > 1 ? distance_to_chord(x, y, &points[chord * 2], &points[chord * 2 + 2]) : 0.0f;
+        while(chord + 2 < n_points) {
+            float next = distance_to_chord(x, y, &points[chord * 2 + 2], &points[chord * 2 + 4]);
+            if(next > d)
+                break;
+            d = next;
+            chord++;
+        }
+        max_deviation = max(max_deviation, d);
+    }
+
+    return max_deviation;
+}
+
+// Plans the chords of each spline and returns the largest deviation, the chord count is returned in total.
+static float check (spline_ptr evaluate, uint32_t *total)
+{
+    uint32_t idx;
+    float target[N_AXIS], position[N_AXIS], offset1[N_AXIS], offset2[N_AXIS], max_deviation = 0.0f;
+    plan_line_data_t pl_data;
+
+    memset(&pl_data, 0, sizeof(plan_line_data_t));
+    pl_data.feed_rate = 1000.0f;
+    sys.state = STATE_IDLE;
+    *total = 0;
+
+    for(idx = 0; idx < n_splines; idx++) {
+        spline_args(&splines[idx], target, position, offset1, offset2);
+        // Move to the start point, the first chord point recorded.
+        n_chords = 0;
+        mc_line(position, &pl_data);
+        bench_realtime(STATE_IDLE);
+        n_chords = 0;
+        add_chord();
+        evaluate(target, &pl_data, position, offset1, offset2);
+        bench_realtime(STATE_IDLE);
+        *total += n_chords - 1;
+        max_deviation = max(max_deviation, deviation(&splines[idx], chords, n_chords));
+    }
+
+    return max_deviation;
+}
+
+int main (int argc, char *argv[])
+{
+    //defaults
+    args.passes = 10;
+    args.splines = 20000;
+
+    progname = argv[0];
+
+    while (argc > 2 && argv[1][0] == '-') {
+        switch(argv[1][1]) {
+
+            case 'n':
+                args.passes = (uint32_t)atol(argv[2]);
+                break;
+
+            case 's':
+                args.splines = (uint32_t)atol(argv[2]);
+                break;
+
+            default:
+                return usage(argv[1]);
+        }
+        argv += 2; argc -= 2;
+    }
+
+    if ((argc > 1 && argv[1][0] == '-') || args.passes == 0)
+        return usage(argc > 1 && argv[1][1] != 'h' ? argv[1] : NULL);
+
+    for(argv++; *argv; argv++) {
+        if(!load_file(*argv))
+            return -1;
+    }
+
+    if(n_splines == 0 && !generate_splines(args.splines))
+        return -1;
+
+    if(n_splines == 0)
+        return usage(NULL);
+
+    memset(&hal, 0, sizeof(HAL));
+
+    hal.version = HAL_VERSION;
+
+    if(!driver_init())
+       return -1;
+
+    hal.stream.write = bench_write;
+    hal.stream.write_all = bench_write;
+    hal.execute_realtime = bench_realtime;
+
+    eeprom_emu_init();
+    report_init();
+    settings_init();
+
+    memset(&sys, 0, sizeof(system_t));
+    sys.override.feed_rate = DEFAULT_FEED_OVERRIDE;
+    sys.override.rapid_rate = DEFAULT_RAPID_OVERRIDE;
+
+    plan_reset();
+    plan_sync_position();
+
+    float elapsed_ref = run(cubic_b_spline_ref);
+    float elapsed = run(mc_cubic_b_spline);
+
+    uint32_t chords_ref, chords_new;
+    float deviation_ref = check(cubic_b_spline_ref, &chords_ref);
+    float deviation_new = check(mc_cubic_b_spline, &chords_new);
+
+    // Chord end points are rounded to steps by the planner.
+    float limit = BEZIER_SIGMA + 1.0f / min(settings.steps_per_mm[X_AXIS], settings.steps_per_mm[Y_AXIS]);
+
+    printf("Evaluated %" PRIu32 " splines %" PRIu32 " times\n", n_splines, args.passes);
+    printf("  reference          : %.3f s, %.1f chords/spline, max deviation %.4f mm: %.0f splines/s\n", elapsed_ref,
+            (float)chords_ref / (float)n_splines, deviation_ref, elapsed_ref > 0.0f ? (float)n_splines * (float)args.passes / elapsed_ref : 0.0f);
+    printf("  mc_cubic_b_spline  : %.3f s, %.1f chords/spline, max deviation %.4f mm: %.0f splines/s\n", elapsed,
+            (float)chords_new / (float)n_splines, deviation_new, elapsed > 0.0f ? (float)n_splines * (float)args.passes / elapsed : 0.0f);
+
+    if(deviation_new > limit)
+        printf("Deviation exceeds %.4f mm\n", limit);
+
+    return deviation_new > limit ? 1 : 0;
+}
@@ -0,0 +1,608 @@
+/*
+  step_check.c - step output fidelity checker
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Reads a step file written by grbl_sim.exe with the -S option and reconstructs the position and
+  velocity of each axis from the step pulses. The position is compared against the programmed path,
+  the straight line in step space from the start to the end of each step block, and the step intervals
+  against the ideal intervals for the step segment executed.
+
+  Reported are:
+
+    path deviation      largest distance in steps from the programmed path
+    backlash take-up    number of blocks and steps taking up backlash, take-up pulses do not change the position
+    step errors         pulses moving an axis by more than one step, and blocks not ending at their target
+    step rate jitter    difference between the actual step interval and the ideal interval for the segment,
+                        RMS and largest value per axis
+    interval variation  largest difference between the longest and the shortest step interval within
+                        a segment, per axis
+    AMASS transitions   number of segments changing the AMASS level, and the largest relative change of
+                        the step interval of the dominant axis at a transition compared to that at other
+                        segment boundaries
+    laser pulses        number of laser PPI pulses and pulse trains, and with -p the largest and the RMS
+                        difference between the distance along the path from the previous pulse in the train
+                        and the pulse spacing. The position of a pulse is interpolated between the steps of
+                        the dominant axis, the path length is measured in step space so all axes moving must
+                        have the same steps/mm.
+
+  Returns non-zero if any step error is found, the path deviation exceeds the -d limit or a pulse spacing
+  differs by more than one step from the -p spacing.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#define MAX_AXES 6
+#define MAX_LEVELS 8
+
+typedef struct arg_vars {
+    double max_deviation;       // Path deviation limit in steps, 0 for none
+    double pulse_spacing;       // Laser PPI pulse spacing in steps, 0 for none
+    FILE *velocity_file;
+} arg_vars_t;
+
+typedef struct {
+    int32_t position;
+    uint64_t last_tick;         // Time of the last step, valid when stepped is set
+    uint64_t last_interval;     // Last step interval, 0 if none in the current block
+    uint32_t last_segment;      // Segment number of the last step
+    uint_fast8_t last_amass;    // AMASS level of the segment of the last step
+    bool stepped;               // Axis has stepped in the current block
+    double velocity;            // Signed step rate in steps/s
+    // Current segment
+    uint64_t segment_min;
+    uint64_t segment_max;
+    // Totals
+    uint32_t steps;
+    double max_rate;
+    double jitter_sum_sq;
+    uint32_t jitter_count;
+    double jitter_max;
+    uint64_t max_variation;
+    uint32_t max_variation_segment;
+    uint64_t max_variation_tick;
+} axis_t;
+
+typedef struct {
+    double distance;
+    uint32_t block;
+    uint64_t tick;
+} max_t;
+
+arg_vars_t args;
+const char* progname;
+
+static struct {
+    double clock;
+    uint_fast8_t n_axis;
+    axis_t axis[MAX_AXES];
+    // Current block
+    uint32_t block;
+    bool in_block;
+    int32_t start[MAX_AXES];
+    int32_t target[MAX_AXES];
+    int32_t block_steps[MAX_AXES];
+    uint_fast8_t dominant;
+    double block_length;        // Length of the block in step space
+    double path_start;          // Path length at the block start
+    uint32_t dominant_steps;    // Steps of the dominant axis in the block so far
+    uint64_t dominant_tick;     // Time of the last step of the dominant axis
+    // Current segment
+    uint32_t segment;
+    uint32_t cycles_per_tick;
+    uint_fast8_t amass;
+    bool in_segment;
+    // Totals
+    uint32_t blocks;
+    uint32_t segments;
+    uint32_t level_segments[MAX_LEVELS];
+    uint32_t amass_transitions;
+    uint32_t step_errors;
+    uint32_t target_errors;
+    uint32_t backlash_blocks;
+    uint64_t backlash_steps;
+    uint64_t pulses;
+    uint64_t last_tick;
+    max_t deviation;
+    max_t amass_change;         // Largest relative interval change at an AMASS transition
+    max_t boundary_change;      // Largest relative interval change at other segment boundaries
+    // Laser PPI pulses
+    bool in_pulse_train;
+    double last_pulse;          // Path length at the previous pulse
+    uint64_t laser_pulses;
+    uint32_t pulse_trains;
+    uint32_t spacing_count;
+    double spacing_sum_sq;
+    max_t spacing_error;
+} chk = {
+    .clock = 16000000.0,
+    .n_axis = 3
+};
+
+int usage (const char* badarg)
+{
+    if (badarg)
+        printf("Unrecognized option %s\n", badarg);
+
+    printf("Usage: \n"
+     "%s <Options> step_file\n"
+     "  Options:\n"
+     "    -d <steps>         : fail if the path deviation exceeds <steps>. Default=0=no limit\n"
+     "    -p <steps>         : laser PPI pulse spacing in steps, 1/PPI inch times steps/mm. Default=0=no check\n"
+     "    -v <velocity file> : write the reconstructed velocity of each axis in steps/s at each step\n"
+     "\n  Checks a step file written by grbl_sim.exe -S, use - for stdin\n",
+     progname);
+
+    return -1;
+}
+
+static inline double ticks_to_us (double ticks)
+{
+    return ticks * 1000000.0 / chk.clock;
+}
+
+// Distance in steps from the position to the straight line from the block start to the block target.
+static double path_deviation (void)
+{
+    uint_fast8_t idx;
+    double v[MAX_AXES], w[MAX_AXES], vv = 0.0, wv = 0.0, t, d, distance = 0.0;
+
+    for(idx = 0; idx < chk.n_axis; idx++) {
+        v[idx] = (double)(chk.target[idx] - chk.start[idx]);
+        w[idx] = (double)(chk.axis[idx].position - chk.start[idx]);
+        vv += v[idx] * v[idx];
+        wv += w[idx] * v[idx];
+    }
+
+    t = vv > 0.0 ? wv / vv : 0.0;
+    t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+
+    for(idx = 0; idx < chk.n_axis; idx++) {
+        d = w[idx] - t * v[idx];
+        distance += d * d;
+    }
+
+    return sqrt(distance);
+}
+
+static void end_segment (void)
+{
+    uint_fast8_t idx;
+    axis_t *axis;
+
+    if(!chk.in_segment)
+        return;
+
+    for(idx = 0; idx < chk.n_axis; idx++) {
+        axis = &chk.axis[idx];
+        if(axis->segment_max && axis->segment_max - axis->segment_min > axis->max_variation) {
+            axis->max_variation = axis->segment_max - axis->segment_min;
+            axis->max_variation_segment = chk.segment;
+            axis->max_variation_tick = axis->last_tick;
+        }
+        axis->segment_min = axis->segment_max = 0;
+    }
+
+    chk.in_segment = false;
+}
+
+static void end_block (void)
+{
+    uint_fast8_t idx;
+
+    end_segment();
+
+    if(!chk.in_block)
+        return;
+
+    chk.path_start += chk.block_length;
+
+    for(idx = 0; idx < chk.n_axis; idx++) {
+        if(chk.axis[idx].position != chk.target[idx]) {
+            chk.target_errors++;
+            fprintf(stderr, "Block %d ends at %d steps from the target, axis %d\n", chk.block, chk.axis[idx].position - chk.target[idx], idx);
+        }
+        chk.axis[idx].stepped = false;
+        chk.axis[idx].last_interval = 0;
+        chk.axis[idx].velocity = 0.0;
+    }
+
+    chk.in_block = false;
+}
+
+static bool parse_values (char *s, int32_t *values, uint_fast8_t n_values)
+{
+    char *end;
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < n_values; idx++) {
+        values[idx] = (int32_t)strtol(s, &end, 10);
+        if(end == s)
+            return false;
+        s = end;
+        while(*s == ',' || *s == ' ')
+            s++;
+    }
+
+    return true;
+}
+
+static bool new_block (char *s)
+{
+    uint_fast8_t idx;
+    uint32_t max_steps = 0;
+    double length = 0.0;
+
+    end_block();
+
+    chk.block = (uint32_t)strtoul(s, &s, 10);
+    if(!parse_values(s, chk.block_steps, chk.n_axis))
+        return false;
+
+    chk.dominant = 0;
+    for(idx = 0; idx < chk.n_axis; idx++) {
+        chk.start[idx] = chk.axis[idx].position;
+        chk.target[idx] = chk.start[idx] + chk.block_steps[idx];
+        if((uint32_t)abs(chk.block_steps[idx]) > max_steps) {
+            max_steps = (uint32_t)abs(chk.block_steps[idx]);
+            chk.dominant = idx;
+        }
+        length += (double)chk.block_steps[idx] * (double)chk.block_steps[idx];
+    }
+
+    chk.block_length = sqrt(length);
+    chk.dominant_steps = 0;
+    chk.dominant_tick = chk.last_tick;
+
+    chk.blocks++;
+    chk.in_block = true;
+
+    return true;
+}
+
+// Backlash take-up steps of the current block, these are not seen in the position.
+static bool block_backlash (char *s)
+{
+    uint_fast8_t idx;
+    int32_t steps[MAX_AXES];
+
+    if(!chk.in_block || !parse_values(s, steps, chk.n_axis))
+        return false;
+
+    for(idx = 0; idx < chk.n_axis; idx++)
+        chk.backlash_steps += (uint64_t)abs(steps[idx]);
+
+    chk.backlash_blocks++;
+
+    return true;
+}
+
+static bool new_segment (char *s)
+{
+    int32_t values[4];
+
+    end_segment();
+
+    if(!parse_values(s, values, 4) || values[3] < 0 || values[3] >= MAX_LEVELS)
+        return false;
+
+    if(chk.segments && (uint_fast8_t)values[3] != chk.amass)
+        chk.amass_transitions++;
+
+    chk.segment++;
+    chk.cycles_per_tick = (uint32_t)values[2];
+    chk.amass = (uint_fast8_t)values[3];
+    chk.level_segments[chk.amass]++;
+    chk.segments++;
+    chk.in_segment = true;
+
+    return true;
+}
+
+static bool step (char *s)
+{
+    uint_fast8_t idx;
+    uint64_t tick, interval;
+    int32_t position[MAX_AXES], delta;
+    double ideal, jitter, change, deviation;
+    axis_t *axis;
+
+    tick = strtoull(s, &s, 10);
+    if(!parse_values(s, position, chk.n_axis))
+        return false;
+
+    for(idx = 0; idx < chk.n_axis; idx++) {
+
+        axis = &chk.axis[idx];
+
+        if((delta = position[idx] - axis->position) == 0)
+            continue;
+
+        if(abs(delta) > 1) {
+            chk.step_errors++;
+            fprintf(stderr, "Axis %d moved %d steps at %.7f s\n", idx, delta, (double)tick / chk.clock);
+        }
+
+        axis->steps += abs(delta);
+        axis->position = position[idx];
+
+        if(idx == chk.dominant) {
+            chk.dominant_steps++;
+            chk.dominant_tick = tick;
+        }
+
+        if(axis->stepped && (interval = tick - axis->last_tick) > 0) {
+
+            axis->velocity = (delta > 0 ? chk.clock : -chk.clock) / (double)interval;
+            if(fabs(axis->velocity) > axis->max_rate)
+                axis->max_rate = fabs(axis->velocity);
+
+            if(axis->last_segment == chk.segment) {
+                // Ideal interval for the axis, cycles per tick times ticks per step
+                ideal = (double)(chk.cycles_per_tick << chk.amass) * (double)abs(chk.block_steps[chk.dominant]) / (double)abs(chk.block_steps[idx]);
+                jitter = fabs((double)interval - ideal);
+                axis->jitter_sum_sq += jitter * jitter;
+                axis->jitter_count++;
+                if(jitter > axis->jitter_max)
+                    axis->jitter_max = jitter;
+                if(axis->segment_max == 0)
+                    axis->segment_min = axis->segment_max = interval;
+                else if(interval < axis->segment_min)
+                    axis->segment_min = interval;
+                else if(interval > axis->segment_max)
+                    axis->segment_max = interval;
+            } else if(idx == chk.dominant && axis->last_interval) {
+                max_t *max = axis->last_amass != chk.amass ? &chk.amass_change : &chk.boundary_change;
+                change = fabs((double)interval - (double)axis->last_interval) / (double)axis->last_interval;
+                if(change > max->distance) {
+                    max->distance = change;
+                    max->block = chk.block;
+                    max->tick = tick;
+                }
+            }
+            axis->last_interval = interval;
+        }
+
+        axis->last_tick = tick;
+        axis->last_segment = chk.segment;
+        axis->last_amass = chk.amass;
+        axis->stepped = true;
+    }
+
+    if(chk.in_block && (deviation = path_deviation()) > chk.deviation.distance) {
+        chk.deviation.distance = deviation;
+        chk.deviation.block = chk.block;
+        chk.deviation.tick = tick;
+    }
+
+    if(args.velocity_file) {
+        fprintf(args.velocity_file, "%.7f", (double)tick / chk.clock);
+        for(idx = 0; idx < chk.n_axis; idx++)
+            fprintf(args.velocity_file, ", %.1f", chk.axis[idx].velocity);
+        fputc('\n', args.velocity_file);
+    }
+
+    chk.pulses++;
+    chk.last_tick = tick;
+
+    return true;
+}
+
+// Path length in step space at the time of a laser pulse, interpolated between steps of the dominant axis.
+static double pulse_position (uint64_t tick)
+{
+    double position = chk.path_start, interval, fraction;
+    uint32_t steps = (uint32_t)abs(chk.block_steps[chk.dominant]);
+
+    if(chk.in_block && steps) {
+        fraction = 0.0;
+        if(chk.dominant_steps < steps && (interval = (double)(chk.cycles_per_tick << chk.amass)) > 0.0 && tick > chk.dominant_tick)
+            fraction = (double)(tick - chk.dominant_tick) / interval;
+        if(fraction > 1.0)
+            fraction = 1.0;
+        position += ((double)chk.dominant_steps + fraction) * chk.block_length / (double)steps;
+    }
+
+    return position;
+}
+
+static bool laser_pulse (char *s)
+{
+    char *end;
+    uint64_t tick;
+    double position, error;
+
+    if(!strncmp(s, "off", 3)) {
+        chk.in_pulse_train = false;
+        return true;
+    }
+
+    tick = strtoull(s, &end, 10);
+    if(end == s)
+        return false;
+
+    position = pulse_position(tick);
+
+    if(!chk.in_pulse_train) {
+        chk.in_pulse_train = true;
+        chk.pulse_trains++;
+    } else if(args.pulse_spacing > 0.0) {
+        error = fabs(position - chk.last_pulse - args.pulse_spacing);
+        chk.spacing_sum_sq += error * error;
+        chk.spacing_count++;
+        if(error > chk.spacing_error.distance) {
+            chk.spacing_error.distance = error;
+            chk.spacing_error.block = chk.block;
+            chk.spacing_error.tick = tick;
+        }
+    }
+
+    chk.last_pulse = position;
+    chk.laser_pulses++;
+
+    return true;
+}
+
+static bool check_file (FILE *file)
+{
+    char line[256];
+    uint32_t line_number = 0;
+    bool ok = true, have_clock = false;
+    int clock, n_axis;
+
+    while(ok && fgets(line, sizeof(line), file)) {
+
+        line_number++;
+
+        if(!strncmp(line, "# clock ", 8)) {
+            if((ok = sscanf(line + 8, "%d, %d", &clock, &n_axis) == 2 && clock > 0 && n_axis > 0 && n_axis <= MAX_AXES)) {
+                chk.clock = (double)clock;
+                chk.n_axis = (uint_fast8_t)n_axis;
+                have_clock = true;
+            }
+        } else if(!strncmp(line, "# block ", 8))
+            ok = new_block(line + 8);
+        else if(!strncmp(line, "# backlash ", 11))
+            ok = block_backlash(line + 11);
+        else if(!strncmp(line, "# segment ", 10))
+            ok = new_segment(line + 10);
+        else if(!strncmp(line, "# pulse ", 8))
+            ok = laser_pulse(line + 8);
+        else if(*line >= '0' && *line <= '9')
+            ok = step(line);
+    }
+
+    end_block();
+
+    if(!ok)
+        fprintf(stderr, "Invalid step file, line %d: %s", line_number, line);
+    else if(!have_clock) {
+        fprintf(stderr, "Not a step event file, run grbl_sim.exe with the -S option\n");
+        ok = false;
+    }
+
+    return ok;
+}
+
+static void report (void)
+{
+    uint_fast8_t idx;
+    axis_t *axis;
+
+    printf("clock: %.0f Hz\n", chk.clock);
+    printf("blocks: %d, segments: %d, step pulses: %" PRIu64 ", time: %.6f s\n", chk.blocks, chk.segments, chk.pulses, (double)chk.last_tick / chk.clock);
+    printf("step errors: %d, block target errors: %d\n", chk.step_errors, chk.target_errors);
+    printf("max path deviation: %.3f steps, block %d at %.7f s\n", chk.deviation.distance, chk.deviation.block, (double)chk.deviation.tick / chk.clock);
+    if(chk.backlash_blocks)
+        printf("backlash take-up: %d blocks, %" PRIu64 " steps\n", chk.backlash_blocks, chk.backlash_steps);
+
+    printf("\naxis      steps   max rate   jitter rms   jitter max   max interval variation\n");
+    for(idx = 0; idx < chk.n_axis; idx++) {
+        axis = &chk.axis[idx];
+        printf("%4d %10d %10.1f %9.3f us %9.3f us %9.3f us, segment %d at %.7f s\n", idx, axis->steps, axis->max_rate,
+                axis->jitter_count ? ticks_to_us(sqrt(axis->jitter_sum_sq / (double)axis->jitter_count)) : 0.0,
+                 ticks_to_us(axis->jitter_max), ticks_to_us((double)axis->max_variation),
+                  axis->max_variation_segment, (double)axis->max_variation_tick / chk.clock);
+    }
+
+    printf("\nAMASS transitions: %d\n", chk.amass_transitions);
+    for(idx = 0; idx < MAX_LEVELS; idx++) {
+        if(chk.level_segments[idx])
+            printf("  level %d: %d segments\n", idx, chk.level_segments[idx]);
+    }
+    printf("max interval change at AMASS transition: %.1f%%, block %d at %.7f s\n", chk.amass_change.distance * 100.0, chk.amass_change.block, (double)chk.amass_change.tick / chk.clock);
+    printf("max interval change at other segment boundary: %.1f%%, block %d at %.7f s\n", chk.boundary_change.distance * 100.0, chk.boundary_change.block, (double)chk.boundary_change.tick / chk.clock);
+
+    if(chk.laser_pulses) {
+        printf("\nlaser pulses: %" PRIu64 " in %d trains\n", chk.laser_pulses, chk.pulse_trains);
+        if(args.pulse_spacing > 0.0)
+            printf("pulse spacing error: %.3f steps rms, max %.3f steps, block %d at %.7f s\n",
+                    chk.spacing_count ? sqrt(chk.spacing_sum_sq / (double)chk.spacing_count) : 0.0,
+                     chk.spacing_error.distance, chk.spacing_error.block, (double)chk.spacing_error.tick / chk.clock);
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    FILE *file;
+    bool ok;
+
+    progname = argv[0];
+
+    while (argc > 2 && argv[1][0] == '-' && argv[1][1]) {
+        switch(argv[1][1]) {
+
+            case 'd':
+                args.max_deviation = atof(argv[2]);
+                break;
+
+            case 'p':
+                args.pulse_spacing = atof(argv[2]);
+                break;
+
+            case 'v':
+                if((args.velocity_file = fopen(argv[2], "w")) == NULL) {
+                    perror("fopen");
+                    printf("Error opening : %s\n", argv[2]);
+                    return usage(NULL);
+                }
+                break;
+
+            default:
+                return usage(argv[1]);
+        }
+        argv += 2; argc -= 2;
+    }
+
+    if (argc != 2 || (argv[1][0] == '-' && argv[1][1]))
+        return usage(argc > 1 && argv[1][1] != 'h' ? argv[1] : NULL);
+
+    if((file = strcmp(argv[1], "-") ? fopen(argv[1], "r") : stdin) == NULL) {
+        perror("fopen");
+        printf("Error opening : %s\n", argv[1]);
+        return -1;
+    }
+
+    ok = check_file(file);
+
+    if(file != stdin)
+        fclose(file);
+
+    if(args.velocity_file)
+        fclose(args.velocity_file);
+
+    if(!ok)
+        return -1;
+
+    report();
+
+    if(args.max_deviation > 0.0 && chk.deviation.distance > args.max_deviation)
+        printf("\nFAIL: path deviation exceeds %.3f steps\n", args.max_deviation);
+
+    if(chk.spacing_error.distance > 1.0)
+        printf("\nFAIL: laser pulse spacing differs by more than one step\n");
+
+    return chk.step_errors || chk.target_errors || (args.max_deviation > 0.0 && chk.deviation.distance > args.max_deviation) || chk.spacing_error.distance > 1.0 ? 1 : 0;
+}
@@ -0,0 +1,16 @@
+#include "grbl/grbl.h"
+
+static volatile segment_t *segment_buffer_tail;     // Index of the segment being executed
+static segment_t *segment_buffer_head;              // Index of the next segment to be prepped
+
+// Number of segments prepped and not yet completed by the stepper ISR
+uint_fast16_t get_segment_buffer_count()
+{
+    uint_fast16_t count = 0;
+    segment_t *segment = (segment_t *)segment_buffer_tail;
+
+    for(; segment && segment != segment_buffer_head; segment = segment->next)
+        count++;
+
+    return count;
+}
@@ -0,0 +1,904 @@
+/*
+  stream_bench.c - g-code streaming throughput and realtime command latency benchmark
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Streams a g-code file to a controller as a sender does and reports the lines per second achieved,
+  the time the planner buffer held less than a given number of blocks and the round trip latency of
+  the status report request and of feed hold. The target may be the simulator, started as a child
+  process, or a real controller connected by a serial or USB device, raw telnet or websocket.
+
+  Two streaming protocols are supported:
+
+    character counting  lines are sent as long as they fit in the controller input buffer,
+                        the size is taken from the $I response or from the -r option
+    synchronous         the next line is sent when the previous one is acknowledged
+
+  The planner level is sampled from the Bf: field of status reports, requested with '?' at the poll
+  interval, and each sample is taken to last until the next one. Buffer state reporting must be
+  enabled in the status report mask setting ($10). Feed hold latency is measured to the first status
+  report in the Hold state and to the first in the Hold:0 (complete) state, the status is polled
+  back to back while a hold is in progress and motion is resumed with cycle start when complete.
+
+  Returns non-zero if a line returned an error or the controller raised an alarm.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#ifdef PLAT_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif
+
+#define LINE_BUFFER_SIZE 512
+#define WS_BUFFER_SIZE 8192
+#define WS_KEY "dGhlIHNhbXBsZSBub25jZQ==" // Any base64 encoded 16 byte value will do
+#define STATUS_TIMEOUT 1.0 // Seconds to wait for a status report before requesting a new one
+#define CONNECT_TIMEOUT 5.0
+
+typedef enum {
+    Protocol_CharCounting = 0,
+    Protocol_Synchronous
+} protocol_t;
+
+typedef struct arg_vars {
+    protocol_t protocol;
+    uint32_t rx_size;           // Input buffer size for character counting, 0 for the size reported by $I
+    uint32_t low_blocks;        // Planner level counted as starved when below
+    uint32_t poll_ms;           // Status report poll interval
+    uint32_t feed_holds;        // Number of feed holds to issue, evenly spaced over the file
+    uint32_t baud;
+} arg_vars_t;
+
+typedef struct {
+    uint32_t count;
+    double min;
+    double max;
+    double sum;
+} stats_t;
+
+arg_vars_t args;
+const char* progname;
+
+int usage (const char* badarg)
+{
+    if (badarg)
+        printf("Unrecognized option %s\n", badarg);
+
+    printf("Usage: \n"
+     "%s <Options> target gcode_file\n"
+     "  Options:\n"
+     "    -s              : synchronous protocol, send the next line when the previous is acknowledged.\n"
+     "                      Default is character counting.\n"
+     "    -r <bytes>      : controller input buffer size for character counting. Default=from $I\n"
+     "    -l <blocks>     : planner level counted as starved when below. Default=4\n"
+     "    -i <ms>         : status report poll interval. Default=50\n"
+     "    -h <count>      : number of feed holds to issue while streaming. Default=0\n"
+     "    -b <baud>       : baud rate for serial devices. Default=115200\n"
+     "\n  <target> is one of:\n"
+     "    <device>                serial or USB device, e.g. /dev/ttyACM0\n"
+     "    tcp:<host>:<port>       raw telnet\n"
+     "    ws://<host>:<port>/     websocket\n"
+     "    exec:<command>          child process, e.g. \"exec:./grbl_sim.exe -n -s /dev/null -b /dev/null\"\n",
+     progname);
+
+    return -1;
+}
+
+#ifndef PLAT_LINUX
+
+int main (int argc, char *argv[])
+{
+    progname = argv[0];
+
+    printf("%s is only available on Linux\n", progname);
+
+    return -1;
+}
+
+#else
+
+static struct {
+    enum {
+        Transport_Device,
+        Transport_TCP,
+        Transport_WebSocket,
+        Transport_Exec
+    } transport;
+    int rd;
+    int wr;
+    pid_t pid;
+    char line[LINE_BUFFER_SIZE];
+    size_t line_len;
+    uint8_t ws_buffer[WS_BUFFER_SIZE];
+    size_t ws_len;
+    bool closed;
+} conn = {
+    .rd = -1,
+    .wr = -1
+};
+
+static struct {
+    char **line;
+    uint32_t *length;           // Length of each line as sent, LF included
+    uint32_t n_lines;
+    uint32_t sent;
+    uint32_t acked;
+    uint32_t errors;
+    uint32_t in_flight;         // Bytes sent and not yet acknowledged
+    uint64_t bytes;
+    bool alarm;
+    double t_start;
+    double t_end;
+    double t_idle;
+    // Controller info
+    uint32_t blocks;
+    uint32_t rx_size;
+    bool have_buffer_state;
+    bool opt_received;
+    bool ack_received;
+    // Status reports
+    char state[16];
+    bool status_pending;
+    double status_sent;
+    double last_report;
+    double next_poll;
+    stats_t status_latency;
+    double run_time;
+    double starved_time;
+    uint32_t min_blocks;
+    // Feed hold
+    enum {
+        Hold_None,
+        Hold_Requested,
+        Hold_Reported
+    } hold;
+    double hold_sent;
+    uint32_t holds;
+    uint32_t holds_missed;
+    stats_t hold_reported;
+    stats_t hold_stopped;
+} bench = {0};
+
+static double now (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void stats_add (stats_t *stats, double value)
+{
+    if(stats->count == 0 || value < stats->min)
+        stats->min = value;
+    if(stats->count == 0 || value > stats->max)
+        stats->max = value;
+    stats->sum += value;
+    stats->count++;
+}
+
+static void stats_print (const char *name, stats_t *stats)
+{
+    if(stats->count)
+        printf("%s min %.3f, avg %.3f, max %.3f ms\n", name, stats->min * 1000.0, stats->sum * 1000.0 / (double)stats->count, stats->max * 1000.0);
+    else
+        printf("%s -\n", name);
+}
+
+/* Transport */
+
+static bool write_all (const uint8_t *data, size_t length)
+{
+    ssize_t n;
+
+    while(length) {
+        if((n = write(conn.wr, data, length)) < 0) {
+            if(errno == EINTR || errno == EAGAIN)
+                continue;
+            return false;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+
+    return true;
+}
+
+// Client to server frames must be masked, a zero masking key leaves the payload unchanged.
+static bool ws_write_frame (uint8_t opcode, const char *data, size_t length)
+{
+    uint8_t hdr[8];
+    size_t hdr_len = 2;
+
+    hdr[0] = 0x80 | opcode;
+
+    if(length < 126)
+        hdr[1] = 0x80 | (uint8_t)length;
+    else {
+        hdr[1] = 0x80 | 126;
+        hdr[2] = (uint8_t)(length >> 8);
+        hdr[3] = (uint8_t)length;
+        hdr_len = 4;
+    }
+
+    memset(&hdr[hdr_len], 0, 4);
+
+    return write_all(hdr, hdr_len + 4) && write_all((const uint8_t *)data, length);
+}
+
+static bool link_write (const char *data, size_t length)
+{
+    return conn.transport == Transport_WebSocket ? ws_write_frame(0x01, data, length) : write_all((const uint8_t *)data, length);
+}
+
+static int tcp_connect (const char *host, const char *port)
+{
+    int fd = -1;
+    struct addrinfo hints = {0}, *res, *ai;
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if(getaddrinfo(host, port, &hints, &res)) {
+        printf("Cannot resolve %s\n", host);
+        return -1;
+    }
+
+    for(ai = res; ai && fd < 0; ai = ai->ai_next) {
+        if((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    freeaddrinfo(res);
+
+    if(fd < 0)
+        printf("Cannot connect to %s:%s\n", host, port);
+
+    return fd;
+}
+
+static bool ws_handshake (const char *host, const char *port, const char *path)
+{
+    char request[512], response[1024];
+    size_t len = 0;
+    ssize_t n;
+    char *end = NULL;
+
+    snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: %s:%s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                        "Sec-WebSocket-Key: " WS_KEY "\r\nSec-WebSocket-Version: 13\r\n\r\n", path, host, port);
+
+    if(!write_all((uint8_t *)request, strlen(request)))
+        return false;
+
+    // Read the response header, any data following it is kept for the stream
+    while(end == NULL && len < sizeof(response) - 1 && (n = read(conn.rd, &response[len], sizeof(response) - 1 - len)) > 0) {
+        len += (size_t)n;
+        response[len] = '\0';
+        end = strstr(response, "\r\n\r\n");
+    }
+
+    if(end == NULL || strncmp(response, "HTTP/1.1 101", 12)) {
+        printf("Websocket upgrade failed\n");
+        return false;
+    }
+
+    end += 4;
+    conn.ws_len = len - (size_t)(end - response);
+    memcpy(conn.ws_buffer, end, conn.ws_len);
+
+    return true;
+}
+
+static speed_t baud_rate (uint32_t baud)
+{
+    switch(baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default: return B115200;
+    }
+}
+
+static bool link_open (const char *target)
+{
+    char host[256], *port, *path;
+
+    if(!strncmp(target, "exec:", 5)) {
+
+        int to_child[2], from_child[2];
+
+        if(pipe(to_child) || pipe(from_child))
+            return false;
+
+        if((conn.pid = fork()) == 0) {
+            dup2(to_child[0], STDIN_FILENO);
+            dup2(from_child[1], STDOUT_FILENO);
+            close(to_child[0]);
+            close(to_child[1]);
+            close(from_child[0]);
+            close(from_child[1]);
+            execl("/bin/sh", "sh", "-c", target + 5, (char *)NULL);
+            exit(127);
+        }
+
+        close(to_child[0]);
+        close(from_child[1]);
+        conn.transport = Transport_Exec;
+        conn.wr = to_child[1];
+        conn.rd = from_child[0];
+
+        return conn.pid > 0;
+    }
+
+    if(!strncmp(target, "tcp:", 4) || !strncmp(target, "ws://", 5)) {
+
+        bool ws = target[0] == 'w';
+
+        strncpy(host, target + (ws ? 5 : 4), sizeof(host) - 1);
+        host[sizeof(host) - 1] = '\0';
+
+        if((path = strchr(host, '/')))
+            *path = '\0';
+        if((port = strrchr(host, ':')) == NULL) {
+            printf("No port given for %s\n", target);
+            return false;
+        }
+        *port++ = '\0';
+
+        if((conn.rd = conn.wr = tcp_connect(host, port)) < 0)
+            return false;
+
+        conn.transport = ws ? Transport_WebSocket : Transport_TCP;
+
+        if(ws) {
+            path = strchr(target + 5, '/');
+            return ws_handshake(host, port, path ? path : "/");
+        }
+
+        return true;
+    }
+
+    struct termios tty;
+
+    if((conn.rd = conn.wr = open(target, O_RDWR|O_NOCTTY)) < 0) {
+        perror("open");
+        printf("Error opening : %s\n", target);
+        return false;
+    }
+
+    conn.transport = Transport_Device;
+
+    if(isatty(conn.rd) && tcgetattr(conn.rd, &tty) == 0) {
+        cfmakeraw(&tty);
+        cfsetspeed(&tty, baud_rate(args.baud));
+        tty.c_cflag |= CLOCAL|CREAD;
+        tcsetattr(conn.rd, TCSANOW, &tty);
+        tcflush(conn.rd, TCIOFLUSH);
+    }
+
+    return true;
+}
+
+static void link_close (void)
+{
+    uint32_t wait = 100;
+
+    if(conn.transport == Transport_Exec) {
+        // ^F shuts the simulator down cleanly, kill it if it does not exit
+        write_all((uint8_t *)"\x06", 1);
+        close(conn.wr);
+        while(wait-- && waitpid(conn.pid, NULL, WNOHANG) == 0)
+            usleep(10000);
+        if(wait == UINT32_MAX) {
+            kill(conn.pid, SIGKILL);
+            waitpid(conn.pid, NULL, 0);
+        }
+        close(conn.rd);
+    } else {
+        if(conn.transport == Transport_WebSocket)
+            ws_write_frame(0x08, NULL, 0);
+        close(conn.rd);
+    }
+}
+
+/* Responses */
+
+static void send_realtime (char c)
+{
+    link_write(&c, 1);
+}
+
+static void request_status (double t)
+{
+    send_realtime('?');
+    bench.status_pending = true;
+    bench.status_sent = t;
+}
+
+static void status_report (char *report, double t)
+{
+    char *field;
+    size_t len = strcspn(report + 1, "|>");
+    uint32_t free_blocks, free_rx, used;
+
+    if(len >= sizeof(bench.state))
+        len = sizeof(bench.state) - 1;
+    memcpy(bench.state, report + 1, len);
+    bench.state[len] = '\0';
+
+    if(bench.status_pending) {
+        stats_add(&bench.status_latency, t - bench.status_sent);
+        bench.status_pending = false;
+    }
+
+    if((field = strstr(report, "|Bf:")) && sscanf(field + 4, "%" SCNu32 ",%" SCNu32, &free_blocks, &free_rx) == 2) {
+        bench.have_buffer_state = true;
+        used = free_blocks < bench.blocks ? bench.blocks - free_blocks : 0;
+        if(bench.t_start > 0.0 && bench.t_idle == 0.0 && !strcmp(bench.state, "Run")) {
+            if(bench.last_report > 0.0) {
+                bench.run_time += t - bench.last_report;
+                if(used < args.low_blocks)
+                    bench.starved_time += t - bench.last_report;
+            }
+            if(used < bench.min_blocks)
+                bench.min_blocks = used;
+        }
+    }
+
+    bench.last_report = t;
+
+    switch(bench.hold) {
+
+        case Hold_Requested:
+            if(!strncmp(bench.state, "Hold", 4)) {
+                stats_add(&bench.hold_reported, t - bench.hold_sent);
+                bench.hold = Hold_Reported;
+            } else if(!strcmp(bench.state, "Idle")) {
+                bench.holds_missed++; // motion ended before the hold was requested
+                bench.hold = Hold_None;
+            }
+            // no break
+
+        case Hold_Reported:
+            if(!strcmp(bench.state, "Hold:0")) {
+                stats_add(&bench.hold_stopped, t - bench.hold_sent);
+                bench.hold = Hold_None;
+                bench.last_report = 0.0; // the hold is not streaming time
+                send_realtime('~');
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void response (char *line, double t)
+{
+    if(!strcmp(line, "ok") || !strncmp(line, "error", 5)) {
+        if(line[0] == 'e') {
+            if(bench.t_start > 0.0)
+                printf("Line %d: %s\n", bench.acked + 1, line);
+            bench.errors++;
+        }
+        if(bench.acked < bench.sent) {
+            bench.in_flight -= bench.length[bench.acked++];
+            if(bench.acked == bench.n_lines)
+                bench.t_end = t;
+        } else
+            bench.ack_received = true;
+    } else if(line[0] == '<')
+        status_report(line, t);
+    else if(!strncmp(line, "ALARM", 5)) {
+        printf("%s\n", line);
+        bench.alarm = true;
+    } else if(!strncmp(line, "[OPT:", 5)) {
+        char *s = strchr(line, ',');
+        if(s && sscanf(s + 1, "%" SCNu32 ",%" SCNu32, &bench.blocks, &bench.rx_size) == 2)
+            bench.opt_received = true;
+    }
+}
+
+static void add_data (const uint8_t *data, size_t length, double t)
+{
+    char c;
+
+    while(length--) {
+        if((c = (char)*data++) == '\n' || c == '\r') {
+            if(conn.line_len) {
+                conn.line[conn.line_len] = '\0';
+                response(conn.line, t);
+                conn.line_len = 0;
+            }
+        } else if(conn.line_len < LINE_BUFFER_SIZE - 1)
+            conn.line[conn.line_len++] = c;
+    }
+}
+
+// Passes the payload of complete frames in the receive buffer on, answers pings.
+static void ws_decode (double t)
+{
+    uint8_t *frame = conn.ws_buffer, opcode;
+    size_t hdr_len, length;
+
+    while(conn.ws_len >= 2) {
+
+        opcode = frame[0] & 0x0F;
+        length = frame[1] & 0x7F;
+        hdr_len = 2;
+
+        if(length == 126) {
+            if(conn.ws_len < 4)
+                break;
+            length = ((size_t)frame[2] << 8) | frame[3];
+            hdr_len = 4;
+        } else if(length == 127) {
+            if(conn.ws_len < 10)
+                break;
+            length = ((size_t)frame[6] << 24) | ((size_t)frame[7] << 16) | ((size_t)frame[8] << 8) | frame[9];
+            hdr_len = 10;
+        }
+
+        if(hdr_len + length > WS_BUFFER_SIZE) {
+            conn.closed = true; // frame too large, give up
+            break;
+        }
+
+        if(conn.ws_len < hdr_len + length)
+            break;
+
+        switch(opcode) {
+
+            case 0x00:
+            case 0x01:
+            case 0x02:
+                add_data(&frame[hdr_len], length, t);
+                break;
+
+            case 0x08:
+                conn.closed = true;
+                break;
+
+            case 0x09:
+                ws_write_frame(0x0A, (char *)&frame[hdr_len], length);
+                break;
+        }
+
+        conn.ws_len -= hdr_len + length;
+        frame += hdr_len + length;
+    }
+
+    memmove(conn.ws_buffer, frame, conn.ws_len);
+}
+
+// Waits for data for up to timeout seconds and handles the responses received.
+static void link_read (double timeout)
+{
+    fd_set rfds;
+    ssize_t n;
+    uint8_t data[4096];
+    struct timeval tv = {
+        .tv_sec = (time_t)timeout,
+        .tv_usec = (suseconds_t)((timeout - (double)(time_t)timeout) * 1e6)
+    };
+
+    FD_ZERO(&rfds);
+    FD_SET(conn.rd, &rfds);
+
+    if(conn.closed || select(conn.rd + 1, &rfds, NULL, NULL, &tv) <= 0)
+        return;
+
+    if(conn.transport == Transport_WebSocket) {
+        if((n = read(conn.rd, &conn.ws_buffer[conn.ws_len], WS_BUFFER_SIZE - conn.ws_len)) > 0) {
+            conn.ws_len += (size_t)n;
+            ws_decode(now());
+        }
+    } else if((n = read(conn.rd, data, sizeof(data))) > 0)
+        add_data(data, (size_t)n, now());
+
+    if(n == 0 || (n < 0 && errno != EINTR && errno != EAGAIN))
+        conn.closed = true;
+}
+
+/* Streaming */
+
+static bool load_file (const char *filename)
+{
+    FILE *file;
+    char line[LINE_BUFFER_SIZE], *s, *end;
+    uint32_t size = 0;
+
+    if((file = fopen(filename, "r")) == NULL) {
+        perror("fopen");
+        printf("Error opening : %s\n", filename);
+        return false;
+    }
+
+    while(fgets(line, sizeof(line) - 1, file)) {
+
+        for(s = line; isspace((unsigned char)*s); s++);
+        for(end = s + strlen(s); end > s && isspace((unsigned char)end[-1]); end--);
+
+        if(end == s)
+            continue;
+
+        *end++ = '\n';
+        *end = '\0';
+
+        if(bench.n_lines == size) {
+            size = size ? size << 1 : 4096;
+            if((bench.line = realloc(bench.line, size * sizeof(char *))) == NULL || (bench.length = realloc(bench.length, size * sizeof(uint32_t))) == NULL) {
+                printf("Out of memory\n");
+                return false;
+            }
+        }
+
+        bench.length[bench.n_lines] = (uint32_t)(end - s);
+        if((bench.line[bench.n_lines++] = strdup(s)) == NULL) {
+            printf("Out of memory\n");
+            return false;
+        }
+    }
+
+    fclose(file);
+
+    return true;
+}
+
+static bool can_send (void)
+{
+    if(bench.sent == bench.n_lines)
+        return false;
+
+    // A line longer than the input buffer is sent when the buffer is empty
+    return args.protocol == Protocol_Synchronous || bench.in_flight == 0 ? bench.sent == bench.acked : bench.in_flight + bench.length[bench.sent] <= bench.rx_size;
+}
+
+// Requests controller info with $I and a status report, checks that the Bf: field is reported.
+static bool connect_controller (void)
+{
+    double timeout;
+
+    // Skip the welcome message
+    timeout = now() + 0.5;
+    while(now() < timeout && !conn.closed)
+        link_read(0.05);
+
+    link_write("$I\n", 3);
+
+    timeout = now() + CONNECT_TIMEOUT;
+    while(!bench.ack_received && now() < timeout && !conn.closed)
+        link_read(0.05);
+
+    if(!bench.opt_received) {
+        printf("No response to $I from the controller\n");
+        return false;
+    }
+
+    request_status(now());
+    timeout = now() + CONNECT_TIMEOUT;
+    while(bench.status_pending && now() < timeout && !conn.closed)
+        link_read(0.05);
+
+    if(bench.status_pending) {
+        printf("No status report from the controller\n");
+        return false;
+    }
+
+    if(strcmp(bench.state, "Idle")) {
+        printf("Controller is not idle, state is %s\n", bench.state);
+        return false;
+    }
+
+    if(!bench.have_buffer_state)
+        printf("Buffer state is not reported, enable it in the status report mask ($10) for planner statistics\n");
+
+    if(args.rx_size)
+        bench.rx_size = args.rx_size;
+    else
+        bench.rx_size--; // grbl input buffers hold one character less than the size
+
+    bench.min_blocks = bench.blocks;
+    bench.status_latency.count = 0;
+    bench.status_latency.sum = 0.0;
+
+    return true;
+}
+
+static void stream (void)
+{
+    double t;
+    uint32_t next_hold = args.feed_holds ? bench.n_lines / (args.feed_holds + 1) : UINT32_MAX;
+
+    bench.t_start = now();
+
+    while(bench.acked < bench.n_lines && !bench.alarm && !conn.closed) {
+
+        while(bench.hold == Hold_None && can_send()) {
+            bench.in_flight += bench.length[bench.sent];
+            bench.bytes += bench.length[bench.sent];
+            link_write(bench.line[bench.sent], bench.length[bench.sent]);
+            bench.sent++;
+        }
+
+        t = now();
+
+        if(bench.hold == Hold_None && bench.holds < args.feed_holds && bench.acked >= next_hold) {
+            send_realtime('!');
+            bench.hold = Hold_Requested;
+            bench.hold_sent = t;
+            bench.holds++;
+            next_hold = bench.n_lines / (args.feed_holds + 1) * (bench.holds + 1);
+        }
+
+        if(bench.status_pending && t - bench.status_sent > STATUS_TIMEOUT)
+            bench.status_pending = false;
+
+        // Poll back to back while a hold is in progress
+        if(!bench.status_pending && (t >= bench.next_poll || bench.hold != Hold_None)) {
+            request_status(t);
+            bench.next_poll = t + (double)args.poll_ms / 1000.0;
+        }
+
+        link_read(bench.next_poll > t ? bench.next_poll - t : 0.001);
+    }
+
+    // Wait for motion to complete
+    while(!bench.alarm && !conn.closed && strcmp(bench.state, "Idle")) {
+        t = now();
+        if(bench.status_pending && t - bench.status_sent > STATUS_TIMEOUT)
+            bench.status_pending = false;
+        if(!bench.status_pending && t >= bench.next_poll) {
+            request_status(t);
+            bench.next_poll = t + (double)args.poll_ms / 1000.0;
+        }
+        link_read(bench.next_poll > t ? bench.next_poll - t : 0.001);
+    }
+
+    bench.t_idle = now();
+}
+
+static void report (const char *target)
+{
+    double time = (bench.t_end > 0.0 ? bench.t_end : now()) - bench.t_start;
+
+    printf("target: %s\n", target);
+    if(args.protocol == Protocol_Synchronous)
+        printf("protocol: synchronous\n");
+    else
+        printf("protocol: character counting, %d byte buffer\n", bench.rx_size);
+    printf("lines: %d of %d, errors: %d, time: %.3f s\n", bench.acked, bench.n_lines, bench.errors, time);
+    printf("lines/s: %.1f, bytes/s: %.0f\n", (double)bench.acked / time, (double)bench.bytes / time);
+    printf("time to idle: %.3f s\n", bench.t_idle - bench.t_start);
+
+    if(bench.have_buffer_state)
+        printf("planner: %d blocks, below %d blocks %.3f of %.3f s running (%.1f%%), min %d blocks\n", bench.blocks, args.low_blocks,
+                bench.starved_time, bench.run_time, bench.run_time > 0.0 ? bench.starved_time * 100.0 / bench.run_time : 0.0, bench.min_blocks);
+
+    stats_print("status report latency:", &bench.status_latency);
+
+    if(args.feed_holds) {
+        printf("feed holds: %d, not executed: %d\n", bench.holds, bench.holds_missed);
+        stats_print("  to Hold reported:", &bench.hold_reported);
+        stats_print("  to Hold:0 (stopped):", &bench.hold_stopped);
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    bool ok;
+
+    //defaults
+    args.protocol = Protocol_CharCounting;
+    args.low_blocks = 4;
+    args.poll_ms = 50;
+    args.baud = 115200;
+
+    progname = argv[0];
+
+    while (argc > 1 && argv[1][0] == '-') {
+        switch(argv[1][1]) {
+
+            case 's':
+                args.protocol = Protocol_Synchronous;
+                argv++; argc--;
+                continue;
+
+            case 'r':
+            case 'l':
+            case 'i':
+            case 'h':
+            case 'b':
+                if(argc < 3)
+                    return usage(NULL);
+                break;
+
+            default:
+                return usage(argv[1]);
+        }
+
+        switch(argv[1][1]) {
+
+            case 'r':
+                args.rx_size = (uint32_t)atol(argv[2]);
+                break;
+
+            case 'l':
+                args.low_blocks = (uint32_t)atol(argv[2]);
+                break;
+
+            case 'i':
+                args.poll_ms = (uint32_t)atol(argv[2]);
+                break;
+
+            case 'h':
+                args.feed_holds = (uint32_t)atol(argv[2]);
+                break;
+
+            case 'b':
+                args.baud = (uint32_t)atol(argv[2]);
+                break;
+        }
+        argv += 2; argc -= 2;
+    }
+
+    if (argc != 3 || args.poll_ms == 0)
+        return usage(NULL);
+
+    if(!load_file(argv[2]) || bench.n_lines == 0)
+        return usage(NULL);
+
+    signal(SIGPIPE, SIG_IGN);
+
+    if(!link_open(argv[1]))
+        return -1;
+
+    if((ok = connect_controller())) {
+        stream();
+        report(argv[1]);
+    }
+
+    link_close();
+
+    return ok && !bench.errors && !bench.alarm && bench.acked == bench.n_lines ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,377 @@
+/*
+  trace_decode.c - converts binary step and block trace files to text or CSV
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Reads a step or block file written by grbl_sim.exe with --trace binary or --trace delta and writes it
+  in the text form written by default, e.g. for gstepcheck.exe, or as comma separated records:
+
+    clock,<clock>,<axes>
+    sample,<time>,<x>,<y>,<z>,<ocr>
+    block_number,<n>
+    block,<n>,<steps>,...
+    segment,<id>,<steps>,<cycles per tick>,<AMASS level>
+    step,<master clock>,<position>,...
+    plan,<position>,...,<entry speed squared>
+    pulse,<master clock>
+    pulse_off
+
+  Text lines between the records, e.g. grbl responses written to the block file, are copied as is.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "trace_file.h"
+
+typedef struct arg_vars {
+    bool csv;
+    FILE *out_file;
+} arg_vars_t;
+
+arg_vars_t args;
+const char* progname;
+
+static struct {
+    FILE *file;
+    bool delta;
+    bool eof;
+    uint_fast8_t n_axis;
+    uint32_t clock;
+    uint32_t block_number;
+    uint32_t step_block;
+    int32_t sample[3];          // Previous positions, for delta compression
+    int32_t step[TRACE_MAX_AXES];
+    int32_t plan[TRACE_MAX_AXES];
+    uint64_t step_clock;
+    uint64_t pulse_clock;
+    uint64_t records;
+} dec = {0};
+
+int usage (const char* badarg)
+{
+    if (badarg)
+        printf("Unrecognized option %s\n", badarg);
+
+    printf("Usage: \n"
+     "%s <Options> trace_file\n"
+     "  Options:\n"
+     "    -c                 : write comma separated records instead of the text trace format\n"
+     "    -o <output file>   : file to write to.  default = stdout\n"
+     "\n  Decodes a step or block file written by grbl_sim.exe --trace binary|delta, use - for stdin\n",
+     progname);
+
+    return -1;
+}
+
+static inline uint8_t get_byte (void)
+{
+    int c = getc(dec.file);
+
+    if(c == EOF) {
+        dec.eof = true;
+        c = 0;
+    }
+
+    return (uint8_t)c;
+}
+
+static uint64_t get_fixed (uint_fast8_t size)
+{
+    uint_fast8_t shift = 0;
+    uint64_t value = 0;
+
+    while(size--) {
+        value |= (uint64_t)get_byte() << shift;
+        shift += 8;
+    }
+
+    return value;
+}
+
+static uint64_t get_varint (void)
+{
+    uint8_t c;
+    uint_fast8_t shift = 0;
+    uint64_t value = 0;
+
+    do {
+        c = get_byte();
+        value |= (uint64_t)(c & 0x7F) << shift;
+        shift += 7;
+    } while((c & 0x80) && !dec.eof && shift < 64);
+
+    return value;
+}
+
+static uint32_t get_uint (void)
+{
+    return dec.delta ? (uint32_t)get_varint() : (uint32_t)get_fixed(4);
+}
+
+static int32_t get_int (void)
+{
+    uint32_t value;
+
+    if(dec.delta) {
+        value = (uint32_t)get_varint();
+        return (int32_t)((value >> 1) ^ (~(value & 1) + 1)); // zigzag
+    }
+
+    return (int32_t)(uint32_t)get_fixed(4);
+}
+
+static void get_position (int32_t *position, uint_fast8_t n_axis)
+{
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < n_axis; idx++)
+        position[idx] = dec.delta ? (int32_t)((uint32_t)position[idx] + (uint32_t)get_int()) : get_int();
+}
+
+static void put_position (const int32_t *position, uint_fast8_t n_axis, const char *first, const char *next)
+{
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < n_axis; idx++)
+        fprintf(args.out_file, idx ? next : first, position[idx]);
+}
+
+static bool decode_header (void)
+{
+    if(get_byte() != 'G' || get_byte() != 'T' || get_byte() != 'R') {
+        fprintf(stderr, "Not a trace file\n");
+        return false;
+    }
+
+    if(get_byte() != TRACE_VERSION) {
+        fprintf(stderr, "Unsupported trace file version\n");
+        return false;
+    }
+
+    dec.delta = !!(get_byte() & TRACE_FLAG_DELTA);
+    dec.n_axis = get_byte();
+    dec.clock = (uint32_t)get_fixed(4);
+
+    if(dec.n_axis == 0 || dec.n_axis > TRACE_MAX_AXES) {
+        fprintf(stderr, "Invalid number of axes: %d\n", (int)dec.n_axis);
+        return false;
+    }
+
+    return !dec.eof;
+}
+
+static void decode_step (void)
+{
+    uint_fast8_t idx, mask[(TRACE_MAX_AXES * 2 + 7) / 8], bits;
+
+    if(dec.delta) {
+        dec.step_clock += get_varint();
+        for(idx = 0; idx < (dec.n_axis * 2 + 7) / 8; idx++)
+            mask[idx] = get_byte();
+        for(idx = 0; idx < dec.n_axis; idx++) {
+            bits = (mask[idx >> 2] >> ((idx & 0x03) << 1)) & 0x03;
+            dec.step[idx] += bits == 1 ? 1 : (bits == 2 ? -1 : (bits == 3 ? get_int() : 0));
+        }
+    } else {
+        dec.step_clock = get_fixed(8);
+        get_position(dec.step, dec.n_axis);
+    }
+
+    if(args.csv) {
+        fprintf(args.out_file, "step,%" PRIu64, dec.step_clock);
+        put_position(dec.step, dec.n_axis, ",%d", ",%d");
+    } else {
+        fprintf(args.out_file, "%" PRIu64, dec.step_clock);
+        put_position(dec.step, dec.n_axis, " %d", ", %d");
+    }
+    fputc('\n', args.out_file);
+}
+
+static bool decode_record (uint8_t tag)
+{
+    switch(tag) {
+
+        case TRACE_CLOCK:
+            fprintf(args.out_file, args.csv ? "clock,%" PRIu32 ",%d\n" : "# clock %" PRIu32 ", %d\n", dec.clock, (int)dec.n_axis);
+            break;
+
+        case TRACE_SAMPLE:
+            {
+                double time;
+                int32_t ocr;
+                uint_fast8_t idx;
+                for(idx = 0; idx < sizeof(double); idx++)
+                    ((uint8_t *)&time)[idx] = get_byte();
+                get_position(dec.sample, 3);
+                ocr = get_int();
+                fprintf(args.out_file, args.csv ? "sample,%.5f,%d,%d,%d,%d\n" : "%12.5f %d, %d, %d, %d\n", time, dec.sample[0], dec.sample[1], dec.sample[2], ocr);
+            }
+            break;
+
+        case TRACE_BLOCK_NUMBER:
+            fprintf(args.out_file, args.csv ? "block_number,%" PRIu32 "\n" : "# block number %" PRIu32 "\n", dec.block_number++);
+            break;
+
+        case TRACE_STEP_BLOCK:
+            {
+                int32_t steps[TRACE_MAX_AXES];
+                uint_fast8_t idx;
+                for(idx = 0; idx < dec.n_axis; idx++)
+                    steps[idx] = get_int();
+                fprintf(args.out_file, args.csv ? "block,%" PRIu32 : "# block %" PRIu32, dec.step_block++);
+                put_position(steps, dec.n_axis, args.csv ? ",%d" : " %d", args.csv ? ",%d" : ", %d");
+                fputc('\n', args.out_file);
+            }
+            break;
+
+        case TRACE_SEGMENT:
+            {
+                uint32_t id = get_uint(), n_step = get_uint(), cycles_per_tick = get_uint(), amass_level = get_uint();
+                fprintf(args.out_file, args.csv ? "segment,%d,%d,%" PRIu32 ",%d\n" : "# segment %d, %d, %" PRIu32 ", %d\n",
+                         (int)id, (int)n_step, cycles_per_tick, (int)amass_level);
+            }
+            break;
+
+        case TRACE_STEP:
+            decode_step();
+            break;
+
+        case TRACE_PLAN_BLOCK:
+            {
+                float entry_speed_sqr;
+                uint_fast8_t idx;
+                get_position(dec.plan, dec.n_axis);
+                for(idx = 0; idx < sizeof(float); idx++)
+                    ((uint8_t *)&entry_speed_sqr)[idx] = get_byte();
+                if(args.csv)
+                    fputs("plan", args.out_file);
+                put_position(dec.plan, dec.n_axis, args.csv ? ",%d" : "%d, ", args.csv ? ",%d" : "%d, ");
+                fprintf(args.out_file, args.csv ? ",%f\n" : "%f\n", entry_speed_sqr);
+            }
+            break;
+
+        case TRACE_PULSE:
+            dec.pulse_clock = dec.delta ? dec.pulse_clock + get_varint() : get_fixed(8);
+            fprintf(args.out_file, args.csv ? "pulse,%" PRIu64 "\n" : "# pulse %" PRIu64 "\n", dec.pulse_clock);
+            break;
+
+        case TRACE_PULSE_OFF:
+            fputs(args.csv ? "pulse_off\n" : "# pulse off\n", args.out_file);
+            break;
+
+        case TRACE_HEADER:
+            return decode_header(); // Traces appended to the same file.
+
+        default:
+            fprintf(stderr, "Invalid record 0x%02X after %" PRIu64 " records\n", tag, dec.records);
+            return false;
+    }
+
+    dec.records++;
+
+    return !dec.eof;
+}
+
+static bool decode_file (FILE *file)
+{
+    int c;
+    bool ok = true, header = false;
+
+    dec.file = file;
+
+    while(ok && (c = getc(file)) != EOF) {
+
+        // Text written to the same file is kept as is.
+        if(c >= ' ' || c == '\t' || c == '\n' || c == '\r' || c > TRACE_PULSE_OFF) {
+            do {
+                fputc(c, args.out_file);
+            } while(c != '\n' && (c = getc(file)) != EOF);
+            continue;
+        }
+
+        if(!header && c != TRACE_HEADER) {
+            fprintf(stderr, "Not a trace file\n");
+            return false;
+        }
+
+        header = true;
+
+        if(!(ok = decode_record((uint8_t)c)) && dec.eof)
+            fprintf(stderr, "Trace file is truncated\n");
+    }
+
+    return ok;
+}
+
+int main (int argc, char *argv[])
+{
+    FILE *file;
+    bool ok;
+
+    progname = argv[0];
+    args.out_file = stdout;
+
+    while (argc > 2 && argv[1][0] == '-' && argv[1][1]) {
+        switch(argv[1][1]) {
+
+            case 'c':
+                args.csv = true;
+                argv++; argc--;
+                continue;
+
+            case 'o':
+                if((args.out_file = fopen(argv[2], "w")) == NULL) {
+                    perror("fopen");
+                    printf("Error opening : %s\n", argv[2]);
+                    return usage(NULL);
+                }
+                break;
+
+            default:
+                return usage(argv[1]);
+        }
+        argv += 2; argc -= 2;
+    }
+
+    if (argc != 2 || (argv[1][0] == '-' && argv[1][1]))
+        return usage(argc > 1 && argv[1][1] != 'h' ? argv[1] : NULL);
+
+    if((file = strcmp(argv[1], "-") ? fopen(argv[1], "rb") : stdin) == NULL) {
+        perror("fopen");
+        printf("Error opening : %s\n", argv[1]);
+        return -1;
+    }
+
+    setvbuf(file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+    setvbuf(args.out_file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+
+    ok = decode_file(file);
+
+    if(file != stdin)
+        fclose(file);
+
+    fclose(args.out_file);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+/*
+  trace_file.c - binary step and block trace output, optionally delta compressed
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Each record is assembled in a local buffer and passed to the stream in one call, the stream is set up
+  with a large buffer by main() so that the trace is written to disk in large blocks. A step record is
+  typically 3 to 5 bytes delta compressed, against about 40 characters formatted as text.
+*/
+
+#include <string.h>
+
+#include "trace_file.h"
+
+#define RECORD_SIZE (2 + TRACE_MAX_AXES * 10 + 16)
+
+typedef struct {
+    uint8_t data[RECORD_SIZE];
+    uint_fast8_t length;
+} record_t;
+
+static inline void put_byte (record_t *record, uint8_t value)
+{
+    record->data[record->length++] = value;
+}
+
+static void put_fixed (record_t *record, uint64_t value, uint_fast8_t size)
+{
+    while(size--) {
+        put_byte(record, (uint8_t)value);
+        value >>= 8;
+    }
+}
+
+static void put_varint (record_t *record, uint64_t value)
+{
+    while(value >= 0x80) {
+        put_byte(record, (uint8_t)value | 0x80);
+        value >>= 7;
+    }
+    put_byte(record, (uint8_t)value);
+}
+
+static void put_uint (trace_file_t *trace, record_t *record, uint32_t value)
+{
+    if(trace->delta)
+        put_varint(record, value);
+    else
+        put_fixed(record, value, 4);
+}
+
+static void put_int (trace_file_t *trace, record_t *record, int32_t value)
+{
+    if(trace->delta)
+        put_varint(record, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31)); // zigzag
+    else
+        put_fixed(record, (uint32_t)value, 4);
+}
+
+// Writes positions in full or as the difference to the previous positions, which are updated.
+static void put_position (trace_file_t *trace, record_t *record, const int32_t *position, int32_t *previous, uint_fast8_t n_axis)
+{
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < n_axis; idx++) {
+        put_int(trace, record, trace->delta ? (int32_t)((uint32_t)position[idx] - (uint32_t)previous[idx]) : position[idx]);
+        previous[idx] = position[idx];
+    }
+}
+
+static void begin (trace_file_t *trace, record_t *record, trace_tag_t tag)
+{
+    record->length = 0;
+
+    if(!trace->started) {
+        trace->started = true;
+        put_byte(record, TRACE_HEADER);
+        put_byte(record, 'G');
+        put_byte(record, 'T');
+        put_byte(record, 'R');
+        put_byte(record, TRACE_VERSION);
+        put_byte(record, trace->delta ? TRACE_FLAG_DELTA : 0);
+        put_byte(record, trace->n_axis);
+        put_fixed(record, trace->clock, 4);
+        fwrite(record->data, 1, record->length, trace->file);
+        record->length = 0;
+    }
+
+    put_byte(record, (uint8_t)tag);
+}
+
+static inline void end (trace_file_t *trace, record_t *record)
+{
+    fwrite(record->data, 1, record->length, trace->file);
+}
+
+void trace_file_init (trace_file_t *trace, FILE *file, trace_format_t format, uint8_t n_axis, uint32_t clock)
+{
+    memset(trace, 0, sizeof(trace_file_t));
+
+    trace->file = file;
+    trace->delta = format == TraceFormat_Delta;
+    trace->n_axis = n_axis > TRACE_MAX_AXES ? TRACE_MAX_AXES : n_axis;
+    trace->clock = clock;
+}
+
+void trace_write_clock (trace_file_t *trace)
+{
+    record_t record;
+
+    begin(trace, &record, TRACE_CLOCK);
+    end(trace, &record);
+}
+
+void trace_write_sample (trace_file_t *trace, double time, const int32_t *position, int32_t ocr)
+{
+    record_t record;
+
+    begin(trace, &record, TRACE_SAMPLE);
+    memcpy(&record.data[record.length], &time, sizeof(double));
+    record.length += sizeof(double);
+    put_position(trace, &record, position, trace->sample, 3);
+    put_int(trace, &record, ocr);
+    end(trace, &record);
+}
+
+void trace_write_block_number (trace_file_t *trace)
+{
+    record_t record;
+
+    begin(trace, &record, TRACE_BLOCK_NUMBER);
+    end(trace, &record);
+}
+
+void trace_write_step_block (trace_file_t *trace, const int32_t *steps)
+{
+    uint_fast8_t idx;
+    record_t record;
+
+    begin(trace, &record, TRACE_STEP_BLOCK);
+    for(idx = 0; idx < trace->n_axis; idx++)
+        put_int(trace, &record, steps[idx]);
+    end(trace, &record);
+}
+
+void trace_write_segment (trace_file_t *trace, uint32_t id, uint32_t n_step, uint32_t cycles_per_tick, uint32_t amass_level)
+{
+    record_t record;
+
+    begin(trace, &record, TRACE_SEGMENT);
+    put_uint(trace, &record, id);
+    put_uint(trace, &record, n_step);
+    put_uint(trace, &record, cycles_per_tick);
+    put_uint(trace, &record, amass_level);
+    end(trace, &record);
+}
+
+void trace_write_step (trace_file_t *trace, uint64_t clock, const int32_t *position)
+{
+    record_t record;
+
+    begin(trace, &record, TRACE_STEP);
+
+    if(trace->delta) {
+
+        uint_fast8_t idx, mask_idx, n_escaped = 0;
+        int32_t delta, escaped[TRACE_MAX_AXES];
+
+        put_varint(&record, clock - trace->step_clock);
+        mask_idx = record.length;
+        record.length += (trace->n_axis * 2 + 7) / 8;
+        memset(&record.data[mask_idx], 0, record.length - mask_idx);
+
+        for(idx = 0; idx < trace->n_axis; idx++) {
+            delta = (int32_t)((uint32_t)position[idx] - (uint32_t)trace->step[idx]);
+            if(delta) {
+                record.data[mask_idx + (idx >> 2)] |= (delta == 1 ? 1 : (delta == -1 ? 2 : 3)) << ((idx & 0x03) << 1);
+                if(delta > 1 || delta < -1)
+                    escaped[n_escaped++] = delta;
+            }
+            trace->step[idx] = position[idx];
+        }
+
+        for(idx = 0; idx < n_escaped; idx++)
+            put_int(trace, &record, escaped[idx]);
+
+    } else {
+        put_fixed(&record, clock, 8);
+        put_position(trace, &record, position, trace->step, trace->n_axis);
+    }
+
+    trace->step_clock = clock;
+
+    end(trace, &record);
+}
+
+void trace_write_plan_block (trace_file_t *trace, const int32_t *position, float entry_speed_sqr)
+{
+    record_t record;
+
+    begin(trace, &record, TRACE_PLAN_BLOCK);
+    put_position(trace, &record, position, trace->plan, trace->n_axis);
+    memcpy(&record.data[record.length], &entry_speed_sqr, sizeof(float));
+    record.length += sizeof(float);
+    end(trace, &record);
+}
+
+void trace_write_pulse (trace_file_t *trace, bool on, uint64_t clock)
+{
+    record_t record;
+
+    begin(trace, &record, on ? TRACE_PULSE : TRACE_PULSE_OFF);
+
+    if(on) {
+        if(trace->delta)
+            put_varint(&record, clock - trace->pulse_clock);
+        else
+            put_fixed(&record, clock, 8);
+        trace->pulse_clock = clock;
+    }
+
+    end(trace, &record);
+}
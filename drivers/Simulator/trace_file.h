@@ -0,0 +1,96 @@
+/*
+  trace_file.h - binary step and block trace output, optionally delta compressed
+
+  Part of Grbl Simulator
+
+  2020 - Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef trace_file_h
+#define trace_file_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+  A trace file is a sequence of records, each starting with a tag byte. The first record is the header:
+
+    TRACE_HEADER 'G' 'T' 'R' <version> <flags> <axes> <clock, 4 bytes>
+
+  Multi byte values are little endian. In a binary trace integers are written in full, 4 bytes or 8 for the
+  master clock. In a delta compressed trace, flag TRACE_FLAG_DELTA, they are written as variable length
+  integers, 7 bits per byte with the high bit set if more follow, signed values zigzag encoded. Positions
+  are then written as the difference to the position in the previous record of the same kind, the master
+  clock of a step or a laser pulse as the difference to the previous step or pulse. The axis moves of a step are packed two bits per
+  axis, 0 for none, 1 for +1, 2 for -1 and 3 for a larger move written after the packed bits. Floating
+  point values are written as is.
+
+  Tags are control characters other than TAB, LF and CR. Other output written to the same file as text,
+  e.g. grbl responses or the estimate report, is kept as text lines between the records.
+*/
+
+#define TRACE_VERSION 1
+#define TRACE_FLAG_DELTA 0x01
+#define TRACE_MAX_AXES 8
+#define TRACE_BUFFER_SIZE (4 * 1024 * 1024) // Stream buffer size for trace files
+
+typedef enum {
+    TRACE_HEADER = 0x01,
+    TRACE_CLOCK = 0x02,         // # clock <clock>, <axes>
+    TRACE_SAMPLE = 0x03,        // <time> <x>, <y>, <z>, <ocr>
+    TRACE_BLOCK_NUMBER = 0x04,  // # block number <n>
+    TRACE_STEP_BLOCK = 0x05,    // # block <n> <steps>, ...
+    TRACE_SEGMENT = 0x06,       // # segment <id>, <steps>, <cycles per tick>, <AMASS level>
+    TRACE_STEP = 0x07,          // <master clock> <position>, ...
+    TRACE_PLAN_BLOCK = 0x08,    // <position>, ... <entry speed squared>
+    TRACE_PULSE = 0x0B,         // # pulse <master clock>, 0x09 and 0x0A are TAB and LF
+    TRACE_PULSE_OFF = 0x0C      // # pulse off
+} trace_tag_t;
+
+typedef enum {
+    TraceFormat_Text = 0,
+    TraceFormat_Binary,
+    TraceFormat_Delta
+} trace_format_t;
+
+typedef struct {
+    FILE *file;
+    bool delta;
+    bool started;               // Header written
+    uint8_t n_axis;
+    uint32_t clock;
+    int32_t sample[3];          // Previous positions, for delta compression
+    int32_t step[TRACE_MAX_AXES];
+    int32_t plan[TRACE_MAX_AXES];
+    uint64_t step_clock;
+    uint64_t pulse_clock;
+} trace_file_t;
+
+// Sets up a binary trace written to file, the header is written with the first record.
+void trace_file_init (trace_file_t *trace, FILE *file, trace_format_t format, uint8_t n_axis, uint32_t clock);
+
+// Writes the records corresponding to the text trace lines listed with the tags.
+void trace_write_clock (trace_file_t *trace);
+void trace_write_sample (trace_file_t *trace, double time, const int32_t *position, int32_t ocr);
+void trace_write_block_number (trace_file_t *trace);
+void trace_write_step_block (trace_file_t *trace, const int32_t *steps);
+void trace_write_segment (trace_file_t *trace, uint32_t id, uint32_t n_step, uint32_t cycles_per_tick, uint32_t amass_level);
+void trace_write_step (trace_file_t *trace, uint64_t clock, const int32_t *position);
+void trace_write_plan_block (trace_file_t *trace, const int32_t *position, float entry_speed_sqr);
+void trace_write_pulse (trace_file_t *trace, bool on, uint64_t clock);
+
+#endif
@@ -25,6 +25,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#ifdef PLAT_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 
 #include "platform.h"
 #include "grbl/grbl.h"
@@ -35,11 +40,21 @@ typedef struct arg_vars {
     FILE *output_file;
     uint8_t echo;
     uint8_t silent;   
+    uint32_t jobs;      // Number of worker processes for batch validation, 0 for single file validation
+    uint32_t line;      // Line number of the line being read
 } arg_vars_t;
 
+// Result of validating a file, passed from the worker process to the parent in batch mode
+typedef struct {
+    uint32_t file;      // Index of file
+    uint32_t status;    // First error or Status_OK
+    uint32_t line;      // Line number of the first error, number of lines if none
+} result_t;
+
 arg_vars_t args;
 const char* progname;
 uint8_t exit_code = 0;
+uint32_t error_line = 0;
 
 int usage (const char* badarg)
 {
@@ -47,13 +62,17 @@ int usage (const char* badarg)
         printf("Unrecognized option %s\n", badarg);
 
     printf("Usage: \n"
-     "%s <Options> [input_file]\n"
+     "%s <Options> [input_file...]\n"
      "  Options:\n"
      "    -o <output file> : use output file instead of stdout\n"
      "    -e        : echo input to output\n"
      "    -s        : silent, no output only return code \n"
+     "    -j <jobs> : validate files in parallel with <jobs> worker processes. Default=number of CPUs\n"
      "\n  Parses gcode from stdin or input line, prints grbl's expected response"
-     "\n  Returns 0 on successs, or line number of error",
+     "\n  Returns 0 on successs, or the code of the first error"
+     "\n  With more than one input file or -j the files are validated in parallel and a JSON"
+     "\n  summary with the first error and its line number for each file is output instead,"
+     "\n  returns 0 if all files passed\n",
      progname);
 
     return -1;
@@ -64,8 +83,10 @@ status_code_t validator_report_status_message (status_code_t status_code)
     report_status_message(status_code);
 
     if (status_code && !exit_code) {
-        printf("EXITING %d\n",status_code);
+        if (!args.silent)
+            printf("EXITING %d\n",status_code);
         exit_code = status_code;
+        error_line = args.line;
         sys.abort = 1;
     }
 
@@ -83,6 +104,12 @@ int16_t serial_read()
     if (args.echo)
         fputc(data, args.output_file); 
 
+    static bool new_line = true;
+
+    if (data != -1 && new_line)
+        args.line++;
+    new_line = data == '\n';
+
     plan_reset();
 
     if (sys.abort || feof(args.input_file) || data == 0x06 || data == -1) { 
@@ -103,9 +130,172 @@ void serial_write (const char *data)
     }
 }
 
+// Validates args.input_file, returns the first error.
+static uint8_t validate (void)
+{
+    memset(&hal, 0, sizeof(HAL));
+
+    hal.version = HAL_VERSION;
+
+    if(!driver_init())
+       return -1;
+
+    // TODO: read settings from EEPROM.dat if exists?
+
+    eeprom_emu_init();
+    settings_init();
+
+    report_init();
+    hal.report.status_message = validator_report_status_message;
+    hal.report.feedback_message = report_feedback_message;
+
+    hal.stream.read = serial_read;
+    hal.stream.write = serial_write;
+    hal.stream.write_all = serial_write;
+
+    protocol_main_loop(true);
+
+    return exit_code;
+}
+
+static void json_string (FILE *out, const char *s)
+{
+    fputc('"', out);
+
+    for(; *s; s++) {
+        if(*s == '"' || *s == '\\')
+            fprintf(out, "\\%c", *s);
+        else if((uint8_t)*s < ' ')
+            fprintf(out, "\\u%04x", (uint8_t)*s);
+        else
+            fputc(*s, out);
+    }
+
+    fputc('"', out);
+}
+
+#ifdef PLAT_LINUX
+
+// Validates each file in a separate worker process since the grbl core state is global,
+// at most args.jobs files at a time. Results are passed back via a pipe.
+static bool validate_files (char **files, uint32_t n_files, result_t *results)
+{
+    int fd[2];
+    pid_t pid;
+    uint32_t next = 0, running = 0;
+    result_t result;
+
+    if(pipe(fd))
+        return false;
+
+    fcntl(fd[0], F_SETFL, O_NONBLOCK);
+    fflush(NULL);
+
+    while(next < n_files || running) {
+
+        while(running < args.jobs && next < n_files) {
+
+            if((pid = fork()) == 0) {
+
+                close(fd[0]);
+
+                result.file = next;
+                result.status = 0;
+
+                if((args.input_file = fopen(files[next], "r")) == NULL)
+                    result.status = UINT32_MAX;
+                else {
+                    args.silent = 1;
+                    args.echo = 0;
+                    result.status = validate();
+                }
+
+                result.line = result.status ? error_line : args.line;
+
+                if(write(fd[1], &result, sizeof(result_t)) != sizeof(result_t))
+                    _exit(-1);
+                _exit(0);
+            }
+
+            if(pid < 0)
+                return false;
+
+            next++;
+            running++;
+        }
+
+        if((pid = wait(NULL)) > 0)
+            running--;
+
+        // Records are smaller than PIPE_BUF and thus written atomically
+        while(read(fd[0], &result, sizeof(result_t)) == sizeof(result_t)) {
+            if(result.file < n_files)
+                results[result.file] = result;
+        }
+    }
+
+    close(fd[0]);
+    close(fd[1]);
+
+    return true;
+}
+
+#endif
+
+// Validates several files and outputs a JSON summary, returns 0 if all files passed.
+static int validate_batch (char **files, uint32_t n_files)
+{
+    uint32_t idx, failed = 0;
+    result_t *results;
+
+    if((results = malloc(n_files * sizeof(result_t))) == NULL)
+        return -1;
+
+    // Marks files not reported by a worker process, e.g. when it crashed
+    for(idx = 0; idx < n_files; idx++)
+        results[idx].file = n_files;
+
+#ifdef PLAT_LINUX
+    if(!validate_files(files, n_files, results)) {
+        perror("fork");
+        return -1;
+    }
+#else
+    printf("Parallel validation is not supported on this platform\n");
+    return -1;
+#endif
+
+    fprintf(args.output_file, "{\"files\":[");
+
+    for(idx = 0; idx < n_files; idx++) {
+
+        fprintf(args.output_file, "%s\n{\"file\":", idx ? "," : "");
+        json_string(args.output_file, files[idx]);
+
+        if(results[idx].file == n_files) {
+            fprintf(args.output_file, ",\"status\":\"failed\"}");
+            failed++;
+        } else if(results[idx].status == UINT32_MAX) {
+            fprintf(args.output_file, ",\"status\":\"unreadable\"}");
+            failed++;
+        } else if(results[idx].status) {
+            fprintf(args.output_file, ",\"status\":\"error\",\"error\":%" PRIu32 ",\"line\":%" PRIu32 "}", results[idx].status, results[idx].line);
+            failed++;
+        } else
+            fprintf(args.output_file, ",\"status\":\"ok\",\"lines\":%" PRIu32 "}", results[idx].line);
+    }
+
+    fprintf(args.output_file, "\n],\"validated\":%" PRIu32 ",\"failed\":%" PRIu32 "}\n", n_files, failed);
+
+    free(results);
+
+    return failed ? 1 : 0;
+}
+
 int main(int argc, char *argv[])
 {
     int positional_args=0;
+    char **files;
 
     //defaults
     args.input_file = stdin;
@@ -115,6 +305,9 @@ int main(int argc, char *argv[])
 
     progname = argv[0];
 
+    if ((files = malloc(argc * sizeof(char *))) == NULL)
+        return -1;
+
     while (argc > 1) {
         argv++; argc--;
         if (argv[0][0] == '-') {
@@ -128,6 +321,13 @@ int main(int argc, char *argv[])
                     args.silent = 1;
                     break;
 
+                case 'j': //parallel jobs
+                    argv++; argc--;
+                    if (argc < 1 || atoi(*argv) <= 0)
+                        return usage(argc < 1 ? NULL : *argv);
+                    args.jobs = atoi(*argv);
+                    break;
+
                 case 'o': //output file
                     argv++; argc--;
                     args.output_file = fopen(*argv,"w");
@@ -143,48 +343,28 @@ int main(int argc, char *argv[])
                 default:
                     return usage(*argv);
             }
-        } else { //handle positional arguments
-            positional_args++;
-            switch(positional_args) {
+        } else //handle positional arguments, input files
+            files[positional_args++] = *argv;
+    }
 
-                case 1: //input file
-                    args.input_file = fopen(*argv,"r");
-                    if (!args.input_file) {
-                        perror("fopen");
-                        printf("Error opening : %s\n",*argv);
-                        return(usage(0));
-                    }
-                    break;
+    if (positional_args > 1 || args.jobs) {
+#ifdef PLAT_LINUX
+        if (args.jobs == 0 && (args.jobs = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+            args.jobs = 1;
+#endif
+        return validate_batch(files, positional_args);
+    }
 
-                default:
-                    return usage(*argv);
-            }
+    if (positional_args == 1) { //input file
+        args.input_file = fopen(*files,"r");
+        if (!args.input_file) {
+            perror("fopen");
+            printf("Error opening : %s\n",*files);
+            return(usage(0));
         }
     }
 
-    memset(&hal, 0, sizeof(HAL));
-
-    hal.version = HAL_VERSION;
-
-    if(!driver_init())
-       return -1;
-
-    // TODO: read settings from EEPROM.dat if exists?
-
-    eeprom_emu_init();
-    settings_init();
-
-    report_init();
-    hal.report.status_message = validator_report_status_message;
-    hal.report.feedback_message = report_feedback_message;
-
-    hal.stream.read = serial_read;
-    hal.stream.write = serial_write;
-    hal.stream.write_all = serial_write;
-
-    protocol_main_loop(true);
-
-    return exit_code;
+    return validate();
 }
 
 
@@ -32,10 +32,10 @@ static const float r1 = 10.0f, r2 = 20.0f;
 static tool_data_t *current_tool = 0, *next_tool = 0;
 static coord_data_t offset;
 
-void atc_tool_select (uint8_t tool)
+void atc_tool_select (tool_id_t tool)
 {
 #ifdef N_TOOLS
-    current_tool = &tool_table[tool];
+    current_tool = gc_get_tool_data(tool);
 #endif
 }
 
@@ -45,6 +45,93 @@ void atc_tool_selected (tool_data_t *tool)
     // check if tool->tool is not 0 (undefined)? here or in gcode.c?
 }
 
+#ifdef ENABLE_ATC_SEQUENCER
+
+#define ATC_MAX_STEPS 20
+
+static atc_step_t *atc_add_step (atc_step_t *steps, uint_fast8_t *n_steps, atc_step_type_t type, bool after_motion)
+{
+    atc_step_t *step = &steps[(*n_steps)++];
+
+    memset(step, 0, sizeof(atc_step_t));
+    step->type = type;
+    step->after_motion = after_motion;
+
+    return step;
+}
+
+// Adds a rapid move to the position relative to the G59.3 offset.
+static void atc_add_move (atc_step_t *steps, uint_fast8_t *n_steps, float x, float y, float z)
+{
+    atc_step_t *step = atc_add_step(steps, n_steps, AtcStep_Rapid, false);
+
+    step->move.target[X_AXIS] = x;
+    step->move.target[Y_AXIS] = y;
+    step->move.target[Z_AXIS] = z;
+
+    uint_fast8_t idx = N_AXIS;
+    do {
+        idx--;
+        step->move.target[idx] += offset.values[idx];
+    } while(idx);
+}
+
+// The tool change as a single sequence, the moves to and from the rack are planned as one path and the
+// spindle and coolant are restored while moving back to the program position.
+status_code_t atc_tool_change (parser_state_t *gc_state)
+{
+    if(next_tool != current_tool) {
+
+        float angle;
+        uint_fast8_t n_steps = 0;
+        atc_step_t steps[ATC_MAX_STEPS], *step;
+
+        settings_read_coord_data(8, &offset.values); // G59.3 - fail if not set?
+
+        step = atc_add_step(steps, &n_steps, AtcStep_Spindle, false);
+        step = atc_add_step(steps, &n_steps, AtcStep_Coolant, false);
+        step = atc_add_step(steps, &n_steps, AtcStep_Dwell, false);
+        step->dwell = 1.0f;
+
+        // put current tool back
+        angle = 0.25f * M_PI * (float)(current_tool->tool - 1);
+        atc_add_move(steps, &n_steps, 0.0f, 0.0f, 15.0f);
+        atc_add_move(steps, &n_steps, r1 * sinf(angle), r1 * cosf(angle), 15.0f);
+        atc_add_move(steps, &n_steps, r1 * sinf(angle), r1 * cosf(angle), 10.0f);
+        atc_add_move(steps, &n_steps, r2 * sinf(angle), r2 * cosf(angle), 10.0f);
+        atc_add_move(steps, &n_steps, r2 * sinf(angle), r2 * cosf(angle), 15.0f);
+
+        step = atc_add_step(steps, &n_steps, AtcStep_Dwell, false);
+        step->dwell = 1.0f;
+
+        // set next as current and fetch it
+        current_tool = next_tool;
+        angle = 0.25f * M_PI * (float)(current_tool->tool - 1);
+        atc_add_move(steps, &n_steps, r2 * sinf(angle), r2 * cosf(angle), 15.0f);
+        atc_add_move(steps, &n_steps, r2 * sinf(angle), r2 * cosf(angle), 10.0f);
+        atc_add_move(steps, &n_steps, r1 * sinf(angle), r1 * cosf(angle), 10.0f);
+        atc_add_move(steps, &n_steps, r1 * sinf(angle), r1 * cosf(angle), 15.0f);
+
+        step = atc_add_step(steps, &n_steps, AtcStep_Dwell, false);
+        step->dwell = 1.0f;
+
+        // back to the program position, spindle and coolant are restored as the move starts
+        step = atc_add_step(steps, &n_steps, AtcStep_Rapid, false);
+        memcpy(step->move.target, gc_state->position, sizeof(step->move.target));
+        step = atc_add_step(steps, &n_steps, AtcStep_Spindle, false);
+        step->spindle.state = gc_state->modal.spindle;
+        step->spindle.rpm = gc_state->spindle.rpm;
+        step = atc_add_step(steps, &n_steps, AtcStep_Coolant, false);
+        step->coolant = gc_state->modal.coolant;
+
+        return atc_seq_execute(steps, n_steps);
+    }
+
+    return Status_OK;
+}
+
+#else
+
 static void atc_move (coord_data_t position, plan_line_data_t *plan_data)
 {
     uint_fast8_t idx = N_AXIS;
@@ -57,7 +144,7 @@ static void atc_move (coord_data_t position, plan_line_data_t *plan_data)
     mc_line(position.values, plan_data);
 }
 
-void atc_tool_change (parser_state_t *gc_state)
+status_code_t atc_tool_change (parser_state_t *gc_state)
 {
     if(next_tool != current_tool) {
 
@@ -118,4 +205,8 @@ void atc_tool_change (parser_state_t *gc_state)
         mc_dwell(1.0);
 
     }
+
+    return Status_OK;
 }
+
+#endif
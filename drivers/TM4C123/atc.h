@@ -26,8 +26,8 @@
 
 #include "grbl/grbl.h"
 
-void atc_tool_select (uint8_t tool);
+void atc_tool_select (tool_id_t tool);
 void atc_tool_selected (tool_data_t *tool);
-void atc_tool_change (parser_state_t *gc_block);
+status_code_t atc_tool_change (parser_state_t *gc_block);
 
 #endif
@@ -1055,7 +1055,7 @@ static bool driver_setup (settings_t *settings)
 
   // Set defaults
 
-    IOInitDone = settings->version == 16;
+    IOInitDone = settings->version == 17;
 
     settings_changed(settings);
 
@@ -1197,11 +1197,11 @@ bool driver_init (void)
 #ifdef DRIVER_SETTINGS
 
   #if !TRINAMIC_ENABLE
-    assert(EEPROM_ADDR_TOOL_TABLE - (sizeof(driver_settings_t) + 2) > EEPROM_ADDR_GLOBAL + sizeof(settings_t) + 1);
+    assert(EEPROM_ADDR_TOOL_TABLE - (sizeof(driver_settings_t) + 2) > EEPROM_ADDR_GLOBAL + sizeof(settings_t) + EEPROM_CHECKSUM_SIZE);
     hal.eeprom.driver_area.address = EEPROM_ADDR_TOOL_TABLE - (sizeof(driver_settings_t) + 2);
   #else
     hal.eeprom.driver_area.address = 1024;
-    hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings_t) + 1;
+    hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings_t) + EEPROM_CHECKSUM_SIZE;
   #endif
     hal.eeprom.driver_area.size = sizeof(driver_settings_t);
     hal.driver_setting = driver_setting;
@@ -1269,7 +1269,7 @@ bool driver_init (void)
 
     // No need to move version check before init.
     // Compiler will fail any signature mismatch for existing entries.
-    return hal.version == 6;
+    return hal.version == 7;
 }
 
 /* interrupt handlers */
@@ -88,7 +88,9 @@ void eepromWriteBlockWithChecksum (uint32_t destination, uint8_t *source, uint32
     } else
         EEPROMProgram((uint32_t *)source, destination + EEPROMOFFSET, size);
 
-    eepromPutByte(destination + size, calc_checksum(source, size));
+    uint16_t checksum = calc_checksum(source, size);
+    eepromPutByte(destination + size, (uint8_t)checksum);
+    eepromPutByte(destination + size + 1, (uint8_t)(checksum >> 8));
 }
 
 bool eepromReadBlockWithChecksum (uint8_t *destination, uint32_t source, uint32_t size)
@@ -111,5 +113,5 @@ bool eepromReadBlockWithChecksum (uint8_t *destination, uint32_t source, uint32_
     } else
         EEPROMRead((uint32_t *)destination, source + EEPROMOFFSET, size);
 
-    return calc_checksum(destination, size) == eepromGetByte(source + size);
+    return calc_checksum(destination, size) == (eepromGetByte(source + size) | (eepromGetByte(source + size + 1) << 8));
 }
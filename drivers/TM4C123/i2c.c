@@ -49,6 +49,16 @@ typedef struct {
 
 static i2c_trans_t i2c;
 
+#if KEYPAD_ENABLE
+// Keycode read requested while the bus was busy, started by the interrupt handler when the current transfer completes
+static struct {
+    volatile bool pending;
+    uint8_t addr;
+    uint8_t keycode;
+    keycode_callback_ptr callback;
+} keypad = {0};
+#endif
+
 static void I2C_interrupt_handler (void);
 
 void I2CInit (void)
@@ -120,13 +130,29 @@ static uint8_t *I2C_ReadRegister (uint32_t i2cAddr, uint8_t bytes, bool block)
 
 #if KEYPAD_ENABLE
 
-void I2C_GetKeycode (uint32_t i2cAddr, keycode_callback_ptr callback)
+// Keycode is read to its own buffer so data from a pending foreground read is not overwritten
+static void I2C_ReceiveKeycode (void)
 {
-    while(i2cIsBusy);
+    keypad.pending = false;
 
-    i2c.keycode_callback = callback;
+    i2c.keycode_callback = keypad.callback;
+    i2c.data  = &keypad.keycode;
+    i2c.count = 1;
+    i2c.state = I2CState_ReceiveLast;
 
-    I2C_Receive(i2cAddr, 1, false);
+    I2CMasterSlaveAddrSet(I2C1_BASE, keypad.addr, true);
+    I2CMasterControl(I2C1_BASE, I2C_MASTER_CMD_SINGLE_RECEIVE);
+}
+
+// Called from the keypad interrupt, the read is deferred to the I2C interrupt handler if the bus is busy
+void I2C_GetKeycode (uint32_t i2cAddr, keycode_callback_ptr callback)
+{
+    keypad.addr = (uint8_t)i2cAddr;
+    keypad.callback = callback;
+    keypad.pending = true;
+
+    if(!i2cIsBusy && keypad.pending)
+        I2C_ReceiveKeycode();
 }
 
 #endif
@@ -223,6 +249,10 @@ static void I2C_interrupt_handler (void)
         case I2CState_AwaitCompletion:
             i2c.count = 0;
             i2c.state = I2CState_Idle;
+          #if KEYPAD_ENABLE
+            if(keypad.pending)
+                I2C_ReceiveKeycode();
+          #endif
             break;
 
         case I2CState_SendRegisterAddress:
@@ -257,6 +287,8 @@ static void I2C_interrupt_handler (void)
                 i2c.keycode_callback(*i2c.data);
                 i2c.keycode_callback = NULL;
             }
+            if(keypad.pending)
+                I2C_ReceiveKeycode();
           #endif
             break;
     }
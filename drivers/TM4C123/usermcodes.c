@@ -109,7 +109,7 @@ void userMCodeExecute (uint_fast16_t state, parser_block_t *gc_block) {
     switch((uint32_t)gc_block->user_mcode) {
 
         case 61:
-            atc_tool_select((uint8_t)truncf(gc_block->values.q));
+            atc_tool_select((tool_id_t)truncf(gc_block->values.q));
             break;
 
         case 100:
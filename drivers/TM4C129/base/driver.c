@@ -54,6 +54,7 @@ static void trinamic_diag1_isr (void);
 
 #if ETHERNET_ENABLE
   #include "ethernet/enet.h"
+  #include "networking/StreamMux.h"
   #if TELNET_ENABLE
     #include "networking/TCPStream.h"
   #endif
@@ -85,25 +86,14 @@ static uint16_t step_prescaler[3] = {
 
 static network_services_t services = {0};
 
-static void enetStreamWriteS (const char *data)
-{
-#if TELNET_ENABLE
-    if(services.telnet)
-        TCPStreamWriteS(data);
-#endif
-#if WEBSOCKET_ENABLE
-    if(services.websocket)
-        WsStreamWriteS(data);
-#endif
-    serialWriteS(data);
-}
-
   #if TELNET_ENABLE
     const io_stream_t ethernet_stream = {
         .type = StreamType_Telnet,
         .read = TCPStreamGetC,
+        .read_block = TCPStreamReadBlock,
         .write = TCPStreamWriteS,
-        .write_all = enetStreamWriteS,
+        .write_n = TCPStreamWriteN,
+        .write_all = StreamMuxWriteS,
         .get_rx_buffer_available = TCPStreamRxFree,
         .reset_read_buffer = TCPStreamRxFlush,
         .cancel_read_buffer = TCPStreamRxCancel,
@@ -120,8 +110,10 @@ static void enetStreamWriteS (const char *data)
     const io_stream_t websocket_stream = {
         .type = StreamType_WebSocket,
         .read = WsStreamGetC,
+        .read_block = WsStreamReadBlock,
         .write = WsStreamWriteS,
-        .write_all = enetStreamWriteS,
+        .write_n = WsStreamWriteN,
+        .write_all = StreamMuxWriteS,
         .get_rx_buffer_available = WsStreamRxFree,
         .reset_read_buffer = WsStreamRxFlush,
         .cancel_read_buffer = WsStreamRxCancel,
@@ -141,7 +133,7 @@ const io_stream_t serial_stream = {
     .read = serialGetC,
     .write = serialWriteS,
 #if ETHERNET_ENABLE
-    .write_all = enetStreamWriteS,
+    .write_all = StreamMuxWriteS,
 #else
     .write_all = serialWriteS,
 #endif
@@ -304,18 +296,22 @@ void selectStream (stream_type_t stream)
         case StreamType_Telnet:
             memcpy(&hal.stream, &ethernet_stream, sizeof(io_stream_t));
             services.telnet = On;
+            StreamMuxEnable(StreamType_Telnet, true);
             break;
 #endif
 #if WEBSOCKET_ENABLE
         case StreamType_WebSocket:
             memcpy(&hal.stream, &websocket_stream, sizeof(io_stream_t));
             services.websocket = On;
+            StreamMuxEnable(StreamType_WebSocket, true);
             break;
 #endif
         case StreamType_Serial:
             memcpy(&hal.stream, &serial_stream, sizeof(io_stream_t));
 #if ETHERNET_ENABLE
             services.mask = 0;
+            StreamMuxEnable(StreamType_Telnet, false);
+            StreamMuxEnable(StreamType_WebSocket, false);
 #endif
             break;
 
@@ -419,6 +415,52 @@ static void driver_delay_ms (uint32_t ms, void (*callback)(void))
 }
 #endif
 
+#ifdef ENABLE_IDLE_WAIT
+
+#ifdef FreeRTOS
+
+static TaskHandle_t grblTask = NULL;
+
+// Blocks the Grbl task until woken or for a tick at most, the network tasks run meanwhile.
+static void idleWait (void)
+{
+    ulTaskNotifyTake(pdTRUE, 1);
+}
+
+static void idleWake (void)
+{
+    if(HWREG(NVIC_INT_CTRL) & NVIC_INT_CTRL_VEC_ACT_M) {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(grblTask, &xHigherPriorityTaskWoken);
+        portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    } else
+        xTaskNotifyGive(grblTask);
+}
+
+#else
+
+static volatile bool idle_woken = false;
+
+// Sleeps until an interrupt occurs unless woken since the last call. Interrupts are masked while checking,
+// an interrupt pending ends WFI anyway and is serviced when they are enabled again.
+static void idleWait (void)
+{
+    IntMasterDisable();
+    if(!idle_woken)
+        CPUwfi();
+    idle_woken = false;
+    IntMasterEnable();
+}
+
+static void idleWake (void)
+{
+    idle_woken = true;
+}
+
+#endif
+
+#endif
+
 // Set stepper pulse output pins
 // NOTE: step_outbits are: bit0 -> X, bit1 -> Y, bit2 -> Z...
 // Mapping to registers can be done by
@@ -1135,6 +1177,7 @@ static void modeSelect (bool mpg_mode)
     if(mpg_mode) {
         normal_stream = hal.stream.type;
         hal.stream.read = serial2GetC;
+        hal.stream.read_block = NULL; // Network streams read blocks, input is read from hal.stream.read in MPG mode
         hal.stream.get_rx_buffer_available = serial2RxFree;
         hal.stream.cancel_read_buffer = serial2RxCancel;
         hal.stream.reset_read_buffer = serial2RxFlush;
@@ -1719,6 +1762,10 @@ bool driver_init (void)
     SysCtlDelay(26); // wait a bit for peripheral to wake up
     EEPROMInit();
 
+    // Enable the CRC module for EEPROM block checksums
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_CCM0);
+    SysCtlDelay(26); // wait a bit for peripheral to wake up
+
 #if USE_32BIT_TIMER && USE_PIOSC
     // Moved after EEPROM enable for giving time for 32768 Hz crystal to stabilize
     SysCtlPIOSCCalibrate(SYSCTL_PIOSC_CAL_AUTO);
@@ -1753,6 +1800,13 @@ bool driver_init (void)
     hal.rx_buffer_size = RX_BUFFER_SIZE;
     hal.delay_ms = driver_delay_ms;
     hal.settings_changed = settings_changed;
+#ifdef ENABLE_IDLE_WAIT
+  #ifdef FreeRTOS
+    grblTask = xTaskGetCurrentTaskHandle(); // driver_init() is called from the Grbl task.
+  #endif
+    hal.idle_wait = idleWait;
+    hal.idle_wake = idleWake;
+#endif
 
     hal.stepper_wake_up = stepperWakeUp;
     hal.stepper_go_idle = stepperGoIdle;
@@ -1784,6 +1838,17 @@ bool driver_init (void)
 
     hal.system_control_get_state = systemGetState;
 
+#if ETHERNET_ENABLE
+    StreamMuxAdd(StreamType_Serial, serialWriteS, NULL);
+  #if TELNET_ENABLE
+    StreamMuxAdd(StreamType_Telnet, TCPStreamWriteS, TCPStreamTxFree);
+    StreamMuxAdd(StreamType_Null, TCPStreamWriteObservers, NULL);
+  #endif
+  #if WEBSOCKET_ENABLE
+    StreamMuxAdd(StreamType_WebSocket, WsStreamWriteS, WsStreamTxFree);
+  #endif
+#endif
+
     selectStream(StreamType_Serial);
 
     hal.eeprom.type = EEPROM_Physical;
@@ -1791,6 +1856,7 @@ bool driver_init (void)
     hal.eeprom.put_byte = eepromPutByte;
     hal.eeprom.memcpy_to_with_checksum = eepromWriteBlockWithChecksum;
     hal.eeprom.memcpy_from_with_checksum = eepromReadBlockWithChecksum;
+    hal.eeprom.checksum = eepromChecksum;
 
 #if ETHERNET_ENABLE
     hal.report_options = reportIP;
@@ -1798,7 +1864,7 @@ bool driver_init (void)
 
 #ifdef DRIVER_SETTINGS
     hal.eeprom.driver_area.address = GRBL_EEPROM_SIZE;
-    hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings_t) + 1;
+    hal.eeprom.size = GRBL_EEPROM_SIZE + sizeof(driver_settings_t) + EEPROM_CHECKSUM_SIZE;
     hal.eeprom.driver_area.size = sizeof(driver_settings_t);
     hal.driver_setting = driver_setting;
     hal.driver_settings_report = driver_settings_report;
@@ -1874,7 +1940,7 @@ bool driver_init (void)
 #endif
 
     // no need to move version check before init - compiler will fail any signature mismatch for existing entries
-    return hal.version == 6;
+    return hal.version == 7;
 }
 
 /* interrupt handlers */
@@ -50,6 +50,7 @@
 #define ETHERNET_ENABLE         1 // Streaming over Ethernet.
 #define TELNET_ENABLE           1 // Enable telnet daemon - requires ethernet enabled
 #define WEBSOCKET_ENABLE        1 // Enable websocket daemon - requires ethernet enabled
+#define UDP_TELEMETRY_ENABLE    0 // Multicast binary status frames - requires ethernet and ENABLE_BINARY_STATUS_REPORT enabled
 #define M6_ENABLE               1 // Manual toolchange.
 #define TRINAMIC_ENABLE         0 // Trinamic TMC2130 stepper driver support.
 #define TRINAMIC_I2C            0 // Trinamic I2C - SPI bridge interface.
@@ -84,6 +85,10 @@
 #define NETWORK_TELNET_PORT     23
 #define NETWORK_WEBSOCKET_PORT  80
 #define NETWORK_HTTP_PORT       80
+
+// Schedules a stream poll in the lwIP thread on stream activity, see ethernet/enet.c.
+#define NETWORK_STREAM_NOTIFY() enet_stream_notify()
+void enet_stream_notify (void);
 #endif
 
 // End configuration
@@ -94,6 +99,7 @@
 
 
 #if TRINAMIC_ENABLE
+#define TRINAMIC_ASYNC_IO TRINAMIC_I2C // Status reads are queued on the I2C bridge, do not change!
 #include "tmc2130/trinamic.h"
 #if CNC_BOOSTERPACK_A4998
 #undef CNC_BOOSTERPACK_A4998
@@ -28,5 +28,6 @@ uint8_t eepromGetByte (uint32_t addr);
 void eepromPutByte (uint32_t addr, uint8_t new_value);
 void eepromWriteBlockWithChecksum (uint32_t destination, uint8_t *source, uint32_t size);
 bool eepromReadBlockWithChecksum (uint8_t *destination, uint32_t source, uint32_t size);
+uint16_t eepromChecksum (uint8_t *data, uint32_t size);
 
 #endif
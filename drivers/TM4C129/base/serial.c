@@ -269,6 +269,8 @@ static void uart_interrupt_handler (void)
         if (!rxbuffer.rts_state && BUFCOUNT(rxbuffer.head, rxbuffer.tail, RX_BUFFER_SIZE) >= RX_BUFFER_HWM)
             GPIOPinWrite(RTS_PORT, RTS_PIN, rxbuffer.rts_state = RTS_PIN);
    #endif
+
+        system_idle_wake();
     }
 }
 
@@ -347,6 +349,7 @@ static void uart2_interrupt_handler (void)
                 rx2_head = bptr;            // and update pointer
             }
         }
+        system_idle_wake();
     }
 }
 
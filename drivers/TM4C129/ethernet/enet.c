@@ -51,6 +51,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "base/driver.h"
 #include "networking/TCPStream.h"
 #include "networking/WsStream.h"
+#include "networking/UDPTelemetry.h"
 
 #define SYSTICK_INT_PRIORITY    0x80
 #define ETHERNET_INT_PRIORITY   0xC0
@@ -59,6 +60,7 @@ static volatile bool linkUp = false;
 static uint32_t IPAddress = 0;
 static network_settings_t *network;
 static network_services_t services = {0};
+static volatile bool poll_pending = false;
 
 char *enet_ip_address (void)
 {
@@ -74,6 +76,32 @@ char *enet_ip_address (void)
     return ip;
 }
 
+// Runs in the lwIP thread.
+static void streamsPoll (void *arg)
+{
+    poll_pending = false;
+
+#if TELNET_ENABLE
+    if(services.telnet)
+        TCPStreamPoll();
+#endif
+#if WEBSOCKET_ENABLE
+    if(services.websocket)
+        WsStreamPoll();
+#endif
+}
+
+// Called by the streams on activity, schedules a poll in the lwIP thread so that data is moved
+// without waiting for the next host timer tick. At most one poll is pending at any time.
+void enet_stream_notify (void)
+{
+    if(services.mask && !poll_pending) {
+        poll_pending = true;
+        if(tcpip_callback_with_block(streamsPoll, NULL, 0) != ERR_OK)
+            poll_pending = false; // lwIP mailbox full, the host timer will poll
+    }
+}
+
 void lwIPHostTimerHandler (void)
 {
     bool isLinkUp = PREF(GPIOPinRead(GPIO_PORTF_BASE, GPIO_PIN_0)) != 0;
@@ -85,13 +113,10 @@ void lwIPHostTimerHandler (void)
         TCPStreamNotifyLinkStatus(linkUp);
     }
 
-#if TELNET_ENABLE
-    if(services.telnet)
-        TCPStreamPoll();
-#endif
-#if WEBSOCKET_ENABLE
-    if(services.telnet)
-        WsStreamPoll();
+    streamsPoll(NULL);
+
+#if UDP_TELEMETRY_ENABLE
+    UDPTelemetryPoll();
 #endif
 }
 
@@ -122,6 +147,9 @@ void setupServices (void *pvArg)
         services.websocket = On;
     }
 #endif
+#if UDP_TELEMETRY_ENABLE
+    UDPTelemetryStart(UDP_TELEMETRY_GROUP, UDP_TELEMETRY_PORT, UDP_TELEMETRY_PERIOD);
+#endif
 }
 
 bool lwIPTaskInit (network_settings_t *settings)
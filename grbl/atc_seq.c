@@ -0,0 +1,173 @@
+/*
+  atc_seq.c - automatic tool changer sequencer, executes a tool change as a pipeline of steps
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_ATC_SEQUENCER
+
+/*
+  A tool change driven by hal.tool_change() is typically written as moves, each followed by a wait for the
+  planner buffer to empty, and outputs and spindle changes applied when the machine has stopped. Here the
+  change is described as a list of steps instead and only steps that depend on motion having completed wait
+  for it:
+
+  - Moves are queued to the planner without waiting, consecutive moves are planned as one continuous path.
+  - Outputs are attached to the next move as M62/M63 outputs and are set by the stepper when that move starts,
+    e.g. to open the drawbar on the final approach to the rack. Outputs with no move following are set
+    after motion has completed.
+  - Spindle and coolant changes are set as soon as the step is reached, e.g. to start the spindle while
+    moving back from the rack. A spindle started this way is waited for at the end of the sequence until at
+    speed, if the driver supports that.
+  - Waiting on input and dwells always wait for the queued motion to complete, as does any step with
+    after_motion set.
+
+  The sequence ends when all motion has completed, then the parser position is synced to the machine position.
+*/
+
+static output_command_t *outputs = NULL; // Outputs to attach to the next move, linked list
+
+static void outputs_add (uint8_t port, bool on)
+{
+    output_command_t cmd = {
+        .is_digital = true,
+        .port = port,
+        .value = on ? 1 : 0
+    }, *add_cmd;
+
+    if((add_cmd = pool_output_command_get(&cmd))) {
+        if(outputs == NULL)
+            outputs = add_cmd;
+        else {
+            output_command_t *last = outputs;
+            while(last->next)
+                last = last->next;
+            last->next = add_cmd;
+        }
+    }
+}
+
+// Sets outputs not attached to a move directly, motion must have completed.
+static void outputs_set (void)
+{
+    output_command_t *cmd;
+
+    while((cmd = outputs)) {
+        hal.port.digital_out(cmd->port, cmd->value != 0);
+        outputs = cmd->next;
+        pool_output_command_release(cmd);
+    }
+}
+
+static bool wait_for_motion (void)
+{
+    if(!protocol_buffer_synchronize())
+        return false;
+
+    outputs_set();
+
+    return true;
+}
+
+status_code_t atc_seq_execute (const atc_step_t *steps, uint_fast8_t n_steps)
+{
+    bool ok = true;
+    status_code_t status = Status_OK;
+    plan_line_data_t plan_data;
+    float target[N_AXIS];
+    const atc_step_t *spindle = NULL;
+
+    if(sys.state == STATE_CHECK_MODE)
+        return Status_OK;
+
+    pool_output_commands_release(outputs);
+    outputs = NULL;
+
+    while(ok && status == Status_OK && n_steps--) {
+
+        if(steps->after_motion || steps->type == AtcStep_WaitInput || steps->type == AtcStep_Dwell)
+            ok = wait_for_motion();
+
+        if(ok) switch(steps->type) {
+
+            case AtcStep_Rapid:
+            case AtcStep_Feed:
+                memset(&plan_data, 0, sizeof(plan_line_data_t));
+                if(steps->type == AtcStep_Rapid)
+                    plan_data.condition.rapid_motion = On;
+                else
+                    plan_data.feed_rate = steps->move.feed_rate;
+                plan_data.output_commands = outputs;
+                outputs = NULL;
+                memcpy(target, steps->move.target, sizeof(target));
+                ok = mc_line(target, &plan_data);
+                break;
+
+            case AtcStep_Output:
+                if(hal.port.digital_out) {
+                    outputs_add(steps->output.port, steps->output.on);
+                    if(steps->after_motion)
+                        outputs_set();
+                }
+                break;
+
+            case AtcStep_WaitInput:
+                if(hal.port.wait_on_input == NULL ||
+                    hal.port.wait_on_input(true, steps->input.port, steps->input.mode, steps->input.timeout) == -1)
+                    status = Status_GCodeToolError;
+                break;
+
+            case AtcStep_Spindle:
+                if(steps->after_motion)
+                    ok = spindle_sync(steps->spindle.state, steps->spindle.rpm) || !ABORTED;
+                else {
+                    spindle_set_state(steps->spindle.state, steps->spindle.rpm);
+                    spindle = steps->spindle.state.on ? steps : NULL;
+                }
+                break;
+
+            case AtcStep_Coolant:
+                coolant_set_state(steps->coolant);
+                break;
+
+            case AtcStep_Dwell:
+                delay_sec(steps->dwell, DelayMode_Dwell);
+                break;
+        }
+
+        ok = ok && protocol_execute_realtime();
+        steps++;
+    }
+
+    if(ok)
+        ok = wait_for_motion();
+
+    pool_output_commands_release(outputs);
+    outputs = NULL;
+
+    if(ok && status == Status_OK) {
+        if(spindle) // Wait for spindle at speed, the state is not changed.
+            ok = spindle_sync(spindle->spindle.state, spindle->spindle.rpm) || !ABORTED;
+        gc_sync_position();
+    }
+
+    return ok ? status : Status_OK; // Abort is reported by the reset.
+}
+
+#endif
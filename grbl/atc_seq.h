@@ -0,0 +1,69 @@
+/*
+  atc_seq.h - automatic tool changer sequencer, executes a tool change as a pipeline of steps
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _ATC_SEQ_H_
+#define _ATC_SEQ_H_
+
+#ifdef ENABLE_ATC_SEQUENCER
+
+typedef enum {
+    AtcStep_Rapid = 0,  // Rapid move to target in machine coordinates.
+    AtcStep_Feed,       // Feed move to target in machine coordinates at feed_rate (mm/min).
+    AtcStep_Output,     // Digital output on or off, set when the next move starts.
+    AtcStep_WaitInput,  // Wait for a digital input, always after motion. Fails on timeout.
+    AtcStep_Spindle,    // Spindle state and RPM, set immediately.
+    AtcStep_Coolant,    // Coolant state, set immediately.
+    AtcStep_Dwell       // Dwell, always after motion.
+} atc_step_type_t;
+
+typedef struct {
+    atc_step_type_t type;
+    bool after_motion;  // Execute the step after the motion queued by the previous steps have completed.
+    union {
+        struct {
+            float target[N_AXIS];
+            float feed_rate;
+        } move;
+        struct {
+            uint8_t port;
+            bool on;
+        } output;
+        struct {
+            uint8_t port;
+            wait_mode_t mode;
+            float timeout;
+        } input;
+        struct {
+            spindle_state_t state;
+            float rpm;
+        } spindle;
+        coolant_state_t coolant;
+        float dwell;
+    };
+} atc_step_t;
+
+// Executes n_steps steps of a tool change sequence and waits for it to complete. Moves are queued without
+// waiting so they are planned as a continuous path, other steps overlap the queued motion unless after_motion
+// is set. Returns Status_GCodeToolError if an input is not reached within its timeout.
+status_code_t atc_seq_execute (const atc_step_t *steps, uint_fast8_t n_steps);
+
+#endif
+
+#endif
@@ -0,0 +1,147 @@
+/*
+  binary_status.c - fixed layout binary status frames for high rate position logging
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_BINARY_STATUS_REPORT
+
+/*
+  A frame is sent in response to the CMD_STATUS_REPORT_BINARY realtime command, all values are little-endian.
+  Plugins may render frames for other transports with binary_status_render(), using their own sequence numbers:
+
+  Offset  Size  Content
+    0      1    BINARY_STATUS_START
+    1      1    Frame length in bytes, BINARY_STATUS_LENGTH
+    2      1    BINARY_STATUS_VERSION
+    3      1    Number of axes, N_AXIS
+    4      2    Sequence number, incremented for each frame
+    6      4    Timestamp in milliseconds, 0 if not provided by the driver
+   10      2    Machine state, sys.state
+   12      1    Sub-state: hold state, parking state or alarm code
+   13      1    Limit signals, bit 0 is X
+   14      2    Control signals, as for $14
+   16      1    Probe state, bit 0 triggered, bit 1 connected
+   17      1    Feed override in percent
+   18      1    Rapids override in percent
+   19      1    Spindle override in percent
+   20      2    Planner blocks available
+   22      2    Input stream characters available
+   24      4    Feed rate, float in mm/min
+   28      4    Programmed spindle speed, float in RPM
+   32    4 * N  Machine position in steps, signed, N = number of axes
+   32 + 4 * N  1  CRC-8 (polynomial 0x07, initial value 0) of the preceding bytes
+*/
+
+static uint16_t sequence = 0;
+
+inline static uint8_t *put_u16 (uint8_t *p, uint16_t v)
+{
+    *p++ = (uint8_t)v;
+    *p++ = (uint8_t)(v >> 8);
+
+    return p;
+}
+
+inline static uint8_t *put_u32 (uint8_t *p, uint32_t v)
+{
+    *p++ = (uint8_t)v;
+    *p++ = (uint8_t)(v >> 8);
+    *p++ = (uint8_t)(v >> 16);
+    *p++ = (uint8_t)(v >> 24);
+
+    return p;
+}
+
+inline static uint8_t *put_float (uint8_t *p, float v)
+{
+    uint32_t u;
+
+    memcpy(&u, &v, sizeof(uint32_t));
+
+    return put_u32(p, u);
+}
+
+void binary_status_render (uint8_t *frame, uint16_t sequence)
+{
+    uint_fast8_t idx;
+    uint8_t *p = frame, substate;
+    int32_t position[N_AXIS];
+    probe_state_t probe = hal.probe_get_state ? hal.probe_get_state() : (probe_state_t){0};
+
+    system_get_position(&position); // Copy current state of the system position variable
+
+    switch(sys.state) {
+
+        case STATE_HOLD:
+            substate = (uint8_t)sys.holding_state;
+            break;
+
+        case STATE_SAFETY_DOOR:
+            substate = (uint8_t)sys.parking_state;
+            break;
+
+        case STATE_ALARM:
+        case STATE_ESTOP:
+            substate = (uint8_t)current_alarm;
+            break;
+
+        default:
+            substate = 0;
+            break;
+    }
+
+    *p++ = BINARY_STATUS_START;
+    *p++ = BINARY_STATUS_LENGTH;
+    *p++ = BINARY_STATUS_VERSION;
+    *p++ = N_AXIS;
+    p = put_u16(p, sequence);
+    p = put_u32(p, hal.get_elapsed_ticks ? hal.get_elapsed_ticks() : 0);
+    p = put_u16(p, (uint16_t)sys.state);
+    *p++ = substate;
+    *p++ = hal.limits_get_state().value;
+    p = put_u16(p, hal.system_control_get_state().value);
+    *p++ = probe.triggered | (probe.connected << 1);
+    *p++ = sys.override.feed_rate;
+    *p++ = sys.override.rapid_rate;
+    *p++ = sys.override.spindle_rpm;
+    p = put_u16(p, (uint16_t)plan_get_block_buffer_available());
+    p = put_u16(p, hal.stream.get_rx_buffer_available());
+    p = put_float(p, st_get_realtime_rate());
+    p = put_float(p, sys.spindle_rpm);
+
+    for(idx = 0; idx < N_AXIS; idx++)
+        p = put_u32(p, (uint32_t)position[idx]);
+
+    *p = crc8(frame, BINARY_STATUS_LENGTH - 1);
+}
+
+void binary_status_report (void)
+{
+    uint8_t frame[BINARY_STATUS_LENGTH];
+
+    if(hal.stream.write_n == NULL) // Binary data cannot be written as a string.
+        return;
+
+    binary_status_render(frame, sequence++);
+
+    hal.stream.write_n((const char *)frame, BINARY_STATUS_LENGTH);
+}
+
+#endif
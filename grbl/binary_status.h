@@ -0,0 +1,34 @@
+/*
+  binary_status.h - fixed layout binary status frames for high rate position logging
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _BINARY_STATUS_H_
+#define _BINARY_STATUS_H_
+
+#define BINARY_STATUS_START 0xA5            // First byte of a frame, never sent in text output
+#define BINARY_STATUS_VERSION 1             // Frame layout version
+#define BINARY_STATUS_LENGTH (33 + N_AXIS * 4)
+
+// Renders a BINARY_STATUS_LENGTH bytes frame with the given sequence number into frame.
+void binary_status_render (uint8_t *frame, uint16_t sequence);
+
+// Writes a binary status frame to the current stream, requires hal.stream.write_n.
+void binary_status_report (void);
+
+#endif
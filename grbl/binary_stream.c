@@ -0,0 +1,456 @@
+/*
+  binary_stream.c - compact binary block framing, negotiated by the $BIN command
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_BINARY_STREAM
+
+/*
+  A frame is a line starting with BINARY_FRAME_START followed by 6-bit symbols and terminated by CR or LF.
+  Symbols 0-61 are sent as the characters '@' - '}', 62 as '*' and 63 as '+'. This keeps the realtime
+  command characters and the range reserved for extended realtime commands out of the frame so that
+  these are still acted upon by the input stream while streaming.
+
+  The frame content is one or more blocks separated by BINARY_END_OF_BLOCK, followed by a CRC-8
+  (polynomial 0x07, initial value 0) of the preceding symbols sent as two symbols: bits 7-6 and bits 5-0.
+
+  Each word in a block is a letter symbol followed by a value encoded as a varint: groups of 5 bits,
+  least significant group first, with bit 5 set in all but the last symbol.
+    Symbol 0 - 25 : absolute value for letter 'A' + symbol, the varint is (zigzag(m) << 3) | d
+                    where the value is m / 10^d.
+    Symbol 32 - 57: delta for letter 'A' + symbol - 32, the varint is zigzag(delta m). The delta is
+                    added to the value last sent for the letter and keeps its number of decimals.
+  Zigzag encoding maps signed to unsigned integers: 0, -1, 1, -2 ... to 0, 1, 2, 3 ...
+
+#ifdef ENABLE_RASTER_ROWS
+  Symbol BINARY_RASTER_ROW in a block is followed by a varint with the number of pixels n and n varints
+  with the laser power of each pixel, zigzag(delta m) to the previous power as for S word deltas.
+  The first delta is relative to the last S value sent, the S value is updated with each pixel.
+  The block must be a G1 move in units per minute feed rate mode, the move is divided into n pixels of
+  equal length.
+#endif
+  The delta state is kept across frames until binary frames are disabled or a reset occurs.
+  The frame is validated before any block is executed, a frame error is reported once for the frame.
+*/
+
+typedef struct {
+    bool enabled;
+    bool receiving;
+    bool error;
+    uint_fast16_t length;
+    uint8_t symbol[LINE_BUFFER_SIZE];
+} binary_frame_t;
+
+typedef struct {
+    uint32_t valid;     // Letters with a value received, bit 0 is 'A'
+    int32_t m[26];      // Last value received for each letter as an integer ...
+    uint8_t d[26];      // ... and its number of decimals
+} binary_delta_t;
+
+static binary_frame_t frame = {0};
+static binary_delta_t delta;
+
+inline static int_fast8_t symbol_value (char c)
+{
+    return c >= '@' && c <= '}' ? c - '@' : (c == '*' ? 62 : (c == '+' ? 63 : -1));
+}
+
+// Decodes a varint at idx, returns false if it is truncated or overflows.
+static bool get_varint (uint_fast16_t *idx, uint_fast16_t end, uint32_t *value)
+{
+    uint_fast8_t shift = 0, symbol;
+
+    *value = 0;
+
+    do {
+        if(*idx == end || shift > 30 || (shift == 30 && (frame.symbol[*idx] & 0x1F) > 0x03))
+            return false;
+        symbol = frame.symbol[(*idx)++];
+        *value |= (uint32_t)(symbol & 0x1F) << shift;
+        shift += 5;
+    } while(symbol & 0x20);
+
+    return true;
+}
+
+inline static int32_t unzigzag (uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// Decodes the frame, blocks are only executed when execute is true.
+// Returns false on a frame error or if a system abort occured during execution.
+static bool decode_frame (bool execute)
+{
+    uint_fast8_t letter, n_words = 0;
+    uint_fast16_t idx = 0, end = frame.length - 2;
+    uint32_t value, valid = delta.valid;
+    int32_t m;
+    gc_word_t words[BINARY_BLOCK_MAX_WORDS + 1];
+#ifdef ENABLE_RASTER_ROWS
+    bool has_raster = false;
+    raster_row_t *raster = NULL;
+#endif
+
+    while(true) {
+
+        if(idx == end || frame.symbol[idx] == BINARY_END_OF_BLOCK) {
+
+            if(execute) {
+
+                words[n_words].letter = '\0';
+
+                if(!protocol_execute_realtime()) // Runtime command check point.
+                    return false;
+
+                if (sys.state & (STATE_ALARM|STATE_ESTOP|STATE_JOG)) // Block if in alarm, eStop or jog mode.
+                    gc_state.last_error = Status_SystemGClock;
+#if COMPATIBILITY_LEVEL == 0
+                else if(gc_state.last_error == Status_OK)
+#else
+                else
+#endif
+#ifdef ENABLE_RASTER_ROWS
+                    gc_state.last_error = gc_execute_words(words, raster ? &raster : NULL, NULL);
+
+                if(raster) { // Not queued, return it to the pool.
+                    pool_raster_row_release(raster);
+                    raster = NULL;
+                }
+#else
+                    gc_state.last_error = gc_execute_words(words, NULL, NULL);
+#endif
+
+#if CHECK_MODE_DELAY
+                if(sys.state == STATE_CHECK_MODE)
+                    hal.delay_ms(CHECK_MODE_DELAY, NULL);
+#endif
+                hal.report.status_message(gc_state.last_error);
+            }
+
+            if(idx++ == end)
+                break;
+
+            n_words = 0;
+#ifdef ENABLE_RASTER_ROWS
+            has_raster = false;
+#endif
+            continue;
+        }
+
+        letter = frame.symbol[idx++];
+
+#ifdef ENABLE_RASTER_ROWS
+        if(letter == BINARY_RASTER_ROW) {
+
+            uint_fast16_t pixel = 0, n_pixels;
+
+            if(has_raster || !(valid & bit('S' - 'A')) || !get_varint(&idx, end, &value) || value == 0 || value > RASTER_ROW_MAX_PIXELS)
+                return false;
+
+            has_raster = true;
+            n_pixels = (uint_fast16_t)value;
+
+            if(execute) {
+                // Wait for a raster row to be returned to the pool by the planner.
+                while((raster = pool_raster_row_get()) == NULL) {
+                    protocol_auto_cycle_start();
+                    if(!protocol_execute_realtime())
+                        return false;
+                }
+                raster->n_pixels = n_pixels;
+            }
+
+            m = delta.m['S' - 'A'];
+
+            // NOTE: the frame is validated before execution, get_varint() cannot fail when executing.
+            do {
+                if(!get_varint(&idx, end, &value))
+                    return false;
+                m += unzigzag(value);
+                if(execute)
+                    raster->power[pixel] = (float)m / pow10_table[delta.d['S' - 'A']];
+            } while(++pixel < n_pixels);
+
+            if(execute)
+                delta.m['S' - 'A'] = m;
+
+            continue;
+        }
+#endif
+
+        if((letter & 0x1F) > 25 || n_words == BINARY_BLOCK_MAX_WORDS || !get_varint(&idx, end, &value))
+            return false;
+
+        if(letter & 0x20) {
+            letter &= 0x1F;
+            if(!(valid & bit(letter)))
+                return false; // Delta without a previous value.
+            m = delta.m[letter] + unzigzag(value);
+            if(execute)
+                delta.m[letter] = m;
+        } else {
+            m = unzigzag(value >> 3);
+            valid |= bit(letter);
+            if(execute) {
+                delta.m[letter] = m;
+                delta.d[letter] = value & 0x07;
+            }
+        }
+
+        if(execute) {
+            words[n_words].letter = 'A' + letter;
+            words[n_words].value = (float)m / pow10_table[delta.d[letter]];
+        }
+
+        n_words++;
+    }
+
+    if(execute)
+        delta.valid = valid;
+
+    return true;
+}
+
+void binary_stream_enable (bool on)
+{
+    frame.enabled = on;
+    frame.receiving = false;
+    delta.valid = 0;
+}
+
+bool binary_stream_enabled (void)
+{
+    return frame.enabled;
+}
+
+bool binary_stream_receiving (void)
+{
+    return frame.receiving;
+}
+
+bool binary_stream_receive (char c)
+{
+    bool complete = false;
+    int_fast8_t symbol;
+
+    if(!frame.receiving) {
+        frame.receiving = true;
+        frame.error = false;
+        frame.length = 0;
+    } else if(c == ASCII_LF || c == ASCII_CR) {
+        frame.receiving = false;
+        complete = true;
+    } else if((symbol = symbol_value(c)) < 0 || frame.length == LINE_BUFFER_SIZE)
+        frame.error = true;
+    else
+        frame.symbol[frame.length++] = (uint8_t)symbol;
+
+    return complete;
+}
+
+bool binary_stream_execute (void)
+{
+    bool ok = !frame.error && frame.length >= 2 && frame.symbol[frame.length - 2] <= 0x03 &&
+               crc8(frame.symbol, frame.length - 2) == ((frame.symbol[frame.length - 2] << 6) | frame.symbol[frame.length - 1]) &&
+                decode_frame(false);
+
+    if(!ok) {
+        hal.report.status_message(Status_BinaryFrameError);
+        return true;
+    }
+
+    return decode_frame(true) || !sys.abort;
+}
+
+inline static uint32_t zigzag (int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+// Appends a varint, returns false if there is no room for it.
+static bool put_varint (binary_encoder_t *encoder, uint32_t value, uint_fast16_t end)
+{
+    do {
+        if(encoder->length == end)
+            return false;
+        encoder->symbol[encoder->length++] = (value & 0x1F) | (value > 0x1F ? 0x20 : 0);
+        value >>= 5;
+    } while(value);
+
+    return true;
+}
+
+void binary_encoder_init (binary_encoder_t *encoder)
+{
+    memset(encoder, 0, sizeof(binary_encoder_t));
+}
+
+status_code_t binary_encoder_add_block (binary_encoder_t *encoder, const char *block, gc_word_t *words)
+{
+    static binary_delta_t saved;
+
+    bool point;
+    uint_fast8_t letter, n_words = 0;
+    uint_fast16_t length = encoder->length, end = LINE_BUFFER_SIZE - 2; // Leave room for the CRC
+    status_code_t status = Status_OK;
+    int32_t m;
+    uint32_t value;
+    uint8_t d;
+
+    saved.valid = encoder->valid;
+    memcpy(saved.m, encoder->m, sizeof(saved.m));
+    memcpy(saved.d, encoder->d, sizeof(saved.d));
+
+    if(encoder->length) {
+        if(encoder->length == end)
+            status = Status_Overflow;
+        else
+            encoder->symbol[encoder->length++] = BINARY_END_OF_BLOCK;
+    }
+
+    while(status == Status_OK && *block) {
+
+        if(*block < 'A' || *block > 'Z') {
+            status = Status_ExpectedCommandLetter;
+            break;
+        }
+
+        if(n_words == BINARY_BLOCK_MAX_WORDS) {
+            status = Status_Overflow; // Cannot be split, reported as a line overflow if the frame is empty.
+            break;
+        }
+
+        letter = *block++ - 'A';
+
+        // Convert the value to m / 10^d, keeping the number exact as written.
+        bool negative = *block == '-', digits = false;
+        if(*block == '-' || *block == '+')
+            block++;
+
+        m = 0;
+        d = 0;
+        point = false;
+        status = Status_OK;
+
+        while((*block >= '0' && *block <= '9') || (*block == '.' && !point)) {
+            if(*block == '.')
+                point = true;
+            else if(point && d == 7) {
+                if(*block != '0')
+                    status = Status_BadNumberFormat; // More decimals than can be encoded
+            } else if(m > 0x0FFFFFFF / 10)
+                status = Status_BadNumberFormat;
+            else {
+                m = m * 10 + (*block - '0');
+                d += point;
+            }
+            digits |= *block != '.';
+            block++;
+        }
+
+        if(!digits || m > 0x0FFFFFFF)
+            status = Status_BadNumberFormat;
+
+        if(status != Status_OK)
+            break;
+
+        if(negative)
+            m = -m;
+
+        if(encoder->length == end) {
+            status = Status_Overflow;
+            break;
+        }
+
+        if((encoder->valid & bit(letter)) && encoder->d[letter] == d) {
+            encoder->symbol[encoder->length++] = letter | 0x20;
+            value = zigzag(m - encoder->m[letter]);
+        } else {
+            encoder->symbol[encoder->length++] = letter;
+            value = (zigzag(m) << 3) | d;
+        }
+
+        if(!put_varint(encoder, value, end)) {
+            status = Status_Overflow;
+            break;
+        }
+
+        encoder->valid |= bit(letter);
+        encoder->m[letter] = m;
+        encoder->d[letter] = d;
+
+        words[n_words].letter = 'A' + letter;
+        words[n_words++].value = (float)m / pow10_table[d];
+    }
+
+    words[n_words].letter = '\0';
+
+    if(status != Status_OK) {
+        encoder->length = length;
+        encoder->valid = saved.valid;
+        memcpy(encoder->m, saved.m, sizeof(saved.m));
+        memcpy(encoder->d, saved.d, sizeof(saved.d));
+    }
+
+    return status;
+}
+
+inline static char symbol_char (uint8_t symbol)
+{
+    return symbol < 62 ? '@' + symbol : (symbol == 62 ? '*' : '+');
+}
+
+uint_fast16_t binary_encoder_write_frame (binary_encoder_t *encoder, char *buf)
+{
+    uint_fast16_t idx, length = 0;
+    uint8_t crc;
+
+    if(encoder->length) {
+
+        crc = crc8(encoder->symbol, encoder->length);
+
+        buf[length++] = BINARY_FRAME_START;
+        for(idx = 0; idx < encoder->length; idx++)
+            buf[length++] = symbol_char(encoder->symbol[idx]);
+        buf[length++] = symbol_char(crc >> 6);
+        buf[length++] = symbol_char(crc & 0x3F);
+        buf[length++] = ASCII_LF;
+
+        encoder->length = 0;
+    }
+
+    return length;
+}
+
+status_code_t binary_stream_command (char *args)
+{
+    status_code_t retval = Status_OK;
+
+    if(args[0] == '=' && (args[1] == '0' || args[1] == '1') && args[2] == '\0') {
+        binary_stream_enable(args[1] == '1');
+        hal.report.feedback_message(frame.enabled ? Message_Enabled : Message_Disabled);
+    } else
+        retval = Status_InvalidStatement;
+
+    return retval;
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+  binary_stream.h - compact binary block framing, negotiated by the $BIN command
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _BINARY_STREAM_H_
+#define _BINARY_STREAM_H_
+
+#define BINARY_FRAME_START '^'      // First character of a frame, only recognized at the start of a line
+#define BINARY_END_OF_BLOCK 26      // Symbol separating blocks within a frame
+#define BINARY_BLOCK_MAX_WORDS 24   // Max number of words in a block
+#define BINARY_RASTER_ROW 27        // Symbol starting the pixel power values of a raster row within a block
+
+// Enables or disables binary frames, the delta state is cleared.
+void binary_stream_enable (bool on);
+
+// Returns true if binary frames are enabled.
+bool binary_stream_enabled (void);
+
+// Returns true while a frame is being received.
+bool binary_stream_receiving (void);
+
+// Adds a received character to the frame, returns true when the frame is complete.
+bool binary_stream_receive (char c);
+
+// Validates and executes the blocks in a complete frame and reports their status as for text lines.
+// Returns false if a system abort occured.
+bool binary_stream_execute (void);
+
+// Executes the $BIN command, $BIN=1 enables and $BIN=0 disables binary frames.
+status_code_t binary_stream_command (char *args);
+
+// Encoder for frames written ahead of time, e.g. compiled jobs. The delta state mirrors that of the
+// decoder so frames must be decoded in the order they were encoded, starting with binary frames enabled.
+typedef struct {
+    uint32_t valid;
+    int32_t m[26];
+    uint8_t d[26];
+    uint_fast16_t length;
+    uint8_t symbol[LINE_BUFFER_SIZE];
+} binary_encoder_t;
+
+// Clears the encoder delta state and frame.
+void binary_encoder_init (binary_encoder_t *encoder);
+
+// Appends a block to the frame, block is a line as output by the line builder: no whitespace or comments and letters in uppercase.
+// The words are returned in words, terminated by a '\0' letter, with values as they will be decoded.
+// Returns Status_Overflow and leaves the frame unchanged if the block does not fit, the frame should then be written and the block added again.
+status_code_t binary_encoder_add_block (binary_encoder_t *encoder, const char *block, gc_word_t *words);
+
+// Writes the frame as a line terminated by LF into buf, which must have room for LINE_BUFFER_SIZE + 4 characters.
+// Returns the number of characters written, 0 if the frame is empty, and starts a new frame.
+uint_fast16_t binary_encoder_write_frame (binary_encoder_t *encoder, char *buf);
+
+#endif
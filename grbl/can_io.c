@@ -0,0 +1,344 @@
+/*
+  can_io.c - distributed I/O expansion over CAN with motion synchronized outputs
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "grbl.h"
+
+#ifdef ENABLE_CAN_IO
+
+/*
+  Remote modules are added to hal.port after the driver ports, module n has the CAN_IO_DIGITAL_CHANNELS digital and
+  CAN_IO_ANALOG_CHANNELS analog ports following module n - 1. The modules send their input states on change, these are
+  kept here so reading an input and M66 waits do not involve a bus transaction.
+
+  Outputs set immediately are sent with one frame per module carrying all changes not yet sent, changes that could
+  not be queued for transmission are sent from the realtime loop. M62, M63 and M67 outputs synchronized with motion
+  are staged on the modules when the segment generator prepares their block, batched to one frame per module for
+  digital outputs, and the stepper ISR sends a single broadcast commit frame with the block tag when the block starts.
+  The outputs are thus set within one short frame time of the block start regardless of how many are changed, and
+  as the commit follows the execution a feed hold does not make them fire early.
+*/
+
+typedef struct {
+    volatile uint32_t inputs;               // Digital input states
+    volatile int16_t analog_in[CAN_IO_ANALOG_CHANNELS];
+    volatile uint32_t set;                  // Digital outputs to set, not yet sent
+    volatile uint32_t clear;                // Digital outputs to clear, not yet sent
+    uint32_t stage_set;                     // Digital outputs to set, staged for the block being prepared
+    uint32_t stage_clear;                   // Digital outputs to clear, staged for the block being prepared
+} can_io_module_t;
+
+static struct {
+    bool enabled;
+    uint8_t local_digital;                  // Driver ports, remote ports are numbered after these
+    uint8_t local_analog;
+    io_port_t local;                        // Driver port handlers
+    volatile bool pending;                  // Digital output changes not yet sent
+    can_io_module_t module[CAN_IO_MODULES];
+} io = {0};
+
+static uint8_t *put_u32 (uint8_t *p, uint32_t v)
+{
+    *p++ = (uint8_t)v;
+    *p++ = (uint8_t)(v >> 8);
+    *p++ = (uint8_t)(v >> 16);
+    *p++ = (uint8_t)(v >> 24);
+
+    return p;
+}
+
+static uint8_t *put_float (uint8_t *p, float v)
+{
+    uint32_t u;
+
+    memcpy(&u, &v, sizeof(uint32_t));
+
+    return put_u32(p, u);
+}
+
+// Returns false for driver ports, else the module index and the channel of the port.
+static bool remote_port (bool digital, uint8_t port, uint_fast8_t *module, uint_fast8_t *channel)
+{
+    uint_fast8_t base = digital ? io.local_digital : io.local_analog;
+    uint_fast8_t channels = digital ? CAN_IO_DIGITAL_CHANNELS : CAN_IO_ANALOG_CHANNELS;
+
+    if(port < base || (port -= base) >= CAN_IO_MODULES * channels)
+        return false;
+
+    *module = port / channels;
+    *channel = port % channels;
+
+    return true;
+}
+
+// Sends the digital output changes not yet sent of a module, returns false if the frame could not be queued.
+static bool send_outputs (uint_fast8_t idx)
+{
+    uint8_t data[8], *p = data;
+    can_io_module_t *module = &io.module[idx];
+    uint32_t set = module->set, clear = module->clear;
+
+    if((set | clear) == 0)
+        return true;
+
+    p = put_u32(p, set);
+    put_u32(p, clear);
+
+    if(!hal.can.send(CAN_IO_ID_OUTPUTS | (idx + 1), data, 8))
+        return false;
+
+    module->set &= ~set;
+    module->clear &= ~clear;
+
+    return true;
+}
+
+// Sends output changes that could not be queued when set.
+static void can_io_flush (uint_fast16_t state)
+{
+    uint_fast8_t idx;
+
+    if(io.pending) {
+        io.pending = false;
+        for(idx = 0; idx < CAN_IO_MODULES; idx++) {
+            if(!send_outputs(idx))
+                io.pending = true;
+        }
+    }
+}
+
+static void digital_out (uint8_t port, bool on)
+{
+    uint_fast8_t module, channel;
+
+    if(!remote_port(true, port, &module, &channel)) {
+        if(io.local.digital_out)
+            io.local.digital_out(port, on);
+        return;
+    }
+
+    if(on) {
+        io.module[module].set |= bit(channel);
+        io.module[module].clear &= ~bit(channel);
+    } else {
+        io.module[module].clear |= bit(channel);
+        io.module[module].set &= ~bit(channel);
+    }
+
+    if(!send_outputs(module))
+        io.pending = true;
+}
+
+static bool analog_out (uint8_t port, float value)
+{
+    uint8_t data[5];
+    uint_fast8_t module, channel;
+
+    if(!remote_port(false, port, &module, &channel))
+        return io.local.analog_out ? io.local.analog_out(port, value) : false;
+
+    data[0] = channel;
+    put_float(&data[1], value);
+
+    return hal.can.send(CAN_IO_ID_ANALOG_OUT | (module + 1), data, 5);
+}
+
+static int32_t input_value (bool digital, uint_fast8_t module, uint_fast8_t channel)
+{
+    return digital ? (int32_t)((io.module[module].inputs >> channel) & 1) : (int32_t)io.module[module].analog_in[channel];
+}
+
+// Waits on a remote input by polling the input states kept, the realtime loop is serviced while waiting.
+static int32_t wait_on_input (bool digital, uint8_t port, wait_mode_t wait_mode, float timeout)
+{
+    int32_t value, last;
+    uint_fast8_t module, channel;
+
+    if(!remote_port(digital, port, &module, &channel))
+        return io.local.wait_on_input ? io.local.wait_on_input(digital, port, wait_mode, timeout) : -1;
+
+    value = input_value(digital, module, channel);
+
+    if(wait_mode == WaitMode_Immediate || !digital)
+        return value;
+
+    uint_fast16_t delay = (uint_fast16_t)ceilf((1000.0f / DWELL_TIME_STEP) * timeout) + 1;
+
+    do {
+        last = value;
+        value = input_value(true, module, channel);
+
+        switch(wait_mode) {
+
+            case WaitMode_Rise:
+                if(last == 0 && value == 1)
+                    return value;
+                break;
+
+            case WaitMode_Fall:
+                if(last == 1 && value == 0)
+                    return value;
+                break;
+
+            case WaitMode_High:
+                if(value == 1)
+                    return value;
+                break;
+
+            case WaitMode_Low:
+                if(value == 0)
+                    return value;
+                break;
+
+            default:
+                return value;
+        }
+
+        if(!protocol_execute_realtime())
+            break;
+
+        hal.delay_ms(DWELL_TIME_STEP, NULL);
+
+    } while(--delay);
+
+    return -1;
+}
+
+void can_io_init (void)
+{
+    uint_fast8_t idx;
+
+    memcpy(&io.local, &hal.port, sizeof(io_port_t));
+    io.local_digital = hal.port.num_digital;
+    io.local_analog = hal.port.num_analog;
+    io.enabled = true;
+
+    hal.port.num_digital += CAN_IO_MODULES * CAN_IO_DIGITAL_CHANNELS;
+    hal.port.num_analog += CAN_IO_MODULES * CAN_IO_ANALOG_CHANNELS;
+    hal.port.digital_out = digital_out;
+    hal.port.analog_out = analog_out;
+    hal.port.wait_on_input = wait_on_input;
+
+    hook_register(Hook_ExecuteRealtime, (hook_fn_t){ .execute_realtime = can_io_flush }, 0, true);
+
+    for(idx = 0; idx < CAN_IO_MODULES; idx++)
+        hal.can.send(CAN_IO_ID_REQUEST | (idx + 1), NULL, 0);
+}
+
+ISR_CODE void can_io_receive (uint32_t id, const uint8_t *data, uint_fast8_t length)
+{
+    uint_fast8_t node = id & 0x7F, idx;
+
+    if(!io.enabled || node == 0 || node > CAN_IO_MODULES)
+        return;
+
+    can_io_module_t *module = &io.module[node - 1];
+
+    switch(id & 0x780) {
+
+        case CAN_IO_ID_INPUTS:
+            if(length >= 4)
+                module->inputs = (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+            break;
+
+        case CAN_IO_ID_ANALOG_IN:
+            for(idx = 0; idx < CAN_IO_ANALOG_CHANNELS && length >= idx * 2 + 2; idx++)
+                module->analog_in[idx] = (int16_t)(data[idx * 2] | (data[idx * 2 + 1] << 8));
+            break;
+    }
+}
+
+bool can_io_stage (output_command_t **commands, uint8_t tag)
+{
+    bool staged = false;
+    uint8_t data[6];
+    uint_fast8_t idx, module, channel;
+    output_command_t *cmd, **link = commands;
+
+    if(!io.enabled)
+        return false;
+
+    while((cmd = *link)) {
+
+        if(!remote_port(cmd->is_digital, cmd->port, &module, &channel)) {
+            link = &cmd->next;
+            continue;
+        }
+
+        if(cmd->is_digital) {
+            if(cmd->value) {
+                io.module[module].stage_set |= bit(channel);
+                io.module[module].stage_clear &= ~bit(channel);
+            } else {
+                io.module[module].stage_clear |= bit(channel);
+                io.module[module].stage_set &= ~bit(channel);
+            }
+        } else {
+            data[0] = tag;
+            data[1] = 0x80 | channel;
+            put_float(&data[2], (float)cmd->value);
+            staged |= hal.can.send(CAN_IO_ID_STAGE | (module + 1), data, 6);
+        }
+
+        *link = cmd->next;
+        pool_output_command_release(cmd);
+    }
+
+    // Digital outputs are sent 16 channels per frame: [0] tag, [1] first channel, [2..3] set, [4..5] clear.
+    for(idx = 0; idx < CAN_IO_MODULES; idx++) {
+        for(channel = 0; channel < CAN_IO_DIGITAL_CHANNELS; channel += 16) {
+            uint16_t set = (uint16_t)(io.module[idx].stage_set >> channel), clear = (uint16_t)(io.module[idx].stage_clear >> channel);
+            if(set | clear) {
+                data[0] = tag;
+                data[1] = channel;
+                data[2] = (uint8_t)set;
+                data[3] = (uint8_t)(set >> 8);
+                data[4] = (uint8_t)clear;
+                data[5] = (uint8_t)(clear >> 8);
+                staged |= hal.can.send(CAN_IO_ID_STAGE | (idx + 1), data, 6);
+            }
+        }
+        io.module[idx].stage_set = io.module[idx].stage_clear = 0;
+    }
+
+    return staged;
+}
+
+ISR_CODE void can_io_commit (uint8_t tag)
+{
+    hal.can.send(CAN_IO_ID_COMMIT, &tag, 1);
+}
+
+void can_io_reset (void)
+{
+    uint_fast8_t idx;
+
+    if(!io.enabled)
+        return;
+
+    can_io_commit(0);
+
+    io.pending = false;
+    for(idx = 0; idx < CAN_IO_MODULES; idx++)
+        io.module[idx].set = io.module[idx].clear = 0;
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*
+  can_io.h - distributed I/O expansion over CAN with motion synchronized outputs
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _CAN_IO_H_
+#define _CAN_IO_H_
+
+#ifdef ENABLE_CAN_IO
+
+#ifndef CAN_IO_MODULES
+#define CAN_IO_MODULES 1        // Number of remote modules, node ids 1 to CAN_IO_MODULES.
+#endif
+#ifndef CAN_IO_DIGITAL_CHANNELS
+#define CAN_IO_DIGITAL_CHANNELS 32 // Digital inputs and outputs per module, 32 max.
+#endif
+#ifndef CAN_IO_ANALOG_CHANNELS
+#define CAN_IO_ANALOG_CHANNELS 4 // Analog inputs and outputs per module, 4 max.
+#endif
+
+#if CAN_IO_DIGITAL_CHANNELS > 32 || CAN_IO_ANALOG_CHANNELS > 4
+#error "CAN I/O modules have at most 32 digital and 4 analog channels!"
+#endif
+
+#if CAN_IO_MODULES < 1 || CAN_IO_MODULES * CAN_IO_DIGITAL_CHANNELS > 224
+#error "CAN_IO_MODULES must be 1 or more and provide at most 224 digital ports!"
+#endif
+
+/*
+  Standard 11 bit frame ids are function code << 7 | node id, multi byte values are little endian:
+
+  id             direction  data
+  0x000          broadcast  [0] tag: commit the outputs staged with the tag, 0 discards all staged outputs
+  0x080 | node   to core    [0..3] digital input states, sent on change and on request
+  0x100 | node   to core    [0..7] analog input values, 4 x int16, sent on change and on request
+  0x180 | node   to module  [0..3] digital outputs to set, [4..7] digital outputs to clear
+  0x200 | node   to module  [0] channel, [1..4] analog output value, float
+  0x280 | node   to module  [0] tag, [1] first channel, [2..3] digital outputs to set, [4..5] to clear, 16 channels per frame
+                            [0] tag, [1] channel | 0x80, [2..5] analog output value, float
+  0x300 | node   to module  no data: request the input states
+*/
+
+#define CAN_IO_ID_COMMIT      0x000
+#define CAN_IO_ID_INPUTS      0x080
+#define CAN_IO_ID_ANALOG_IN   0x100
+#define CAN_IO_ID_OUTPUTS     0x180
+#define CAN_IO_ID_ANALOG_OUT  0x200
+#define CAN_IO_ID_STAGE       0x280
+#define CAN_IO_ID_REQUEST     0x300
+
+// Adds the remote modules to hal.port, numbered after the driver ports. Called on startup if the driver provides hal.can.send.
+void can_io_init (void);
+
+// Called by the driver with frames received, may be called from interrupt context.
+void can_io_receive (uint32_t id, const uint8_t *data, uint_fast8_t length);
+
+// Called by the segment generator with the output commands of a block, commands for remote ports are staged on the modules
+// with the tag and removed from the list. Returns true if any were staged, can_io_commit() is then to be called on block start.
+bool can_io_stage (output_command_t **commands, uint8_t tag);
+
+// Called by the stepper ISR on block start, sets the outputs staged for the block.
+void can_io_commit (uint8_t tag);
+
+// Discards staged outputs and pending output changes, called on reset.
+void can_io_reset (void);
+
+#endif
+
+#endif
@@ -38,6 +38,26 @@
 #define ISR_CODE
 #endif
 
+// Targets with little RAM get smaller default sizes for the statically allocated queues, pools and caches:
+//                                              default   SMALL_RAM_TARGET
+//  OUTPUT_COMMAND_POOL_SIZE (pool.h)            8         4
+//  MESSAGE_POOL_SIZE (pool.h)                   4         2
+//  CANNED_CYCLE_QUEUE_SIZE (motion_control.h)   4         1
+//  REPORT_STATUS_BUFFER_SIZE (report.h)         200       64, longer reports are written in more parts
+//  PROTOCOL_READ_BLOCK_SIZE (protocol.h)        64        16
+//  WCO_POOL_SIZE (pool.h)                       4         2
+//  RASTER_ROW_POOL_SIZE (pool.h)                4         2
+//  RASTER_ROW_MAX_PIXELS (gcode.h)              128       32
+//  FLOWCTRL_CACHE_SIZE (flowctrl.h)             4096      1024
+// The small sizes free about 1000 bytes, room for 7 more planner blocks. With 3 axes the core then uses about
+// 2000 bytes more RAM than grbl 1.1f on the MSP430F5529 (BLOCK_BUFFER_SIZE 16) and 2550 bytes more on the
+// STM32F103C8 (36 blocks), 28 bytes of it per planner block for precomputed and cached values. Options that
+// are disabled by default add their pools when enabled.
+// Defined for the MSP430F5529 (8 KB RAM) and STM32F103C8 (20 KB RAM), may be defined for other targets.
+#if !defined(SMALL_RAM_TARGET) && (defined(__MSP430F5529__) || defined(STM32F103xB))
+#define SMALL_RAM_TARGET
+#endif
+
 // Defines compatibility level with the grbl 1.1 protocol.
 // Additional G- and M-codes are not disabled except when level is set to >= 10.
 //  This does not apply to G- and M-codes dependent on driver and/or configuration settings disabled by stting level > 1.
@@ -49,8 +69,21 @@
 // NOTE: if switching to a level > 1 please reset EEPROM with $RST=* after reflashing!
 #define COMPATIBILITY_LEVEL 0
 
+// Fixes the machine type at compile time. Runtime checks of the mode ($32), parking ($41) and of spindle
+// synchronized motion are then resolved by the compiler in the step segment generator, the stepper interrupt,
+// the planner and the parser, and their code is removed when the machine type does not use the feature:
+//  MACHINE_PROFILE_ROUTER  - mode 0, no spindle synchronized motion
+//  MACHINE_PROFILE_LASER   - mode 1 (laser), no parking, no spindle synchronized motion
+//  MACHINE_PROFILE_LATHE   - mode 2 (lathe), no parking
+//  MACHINE_PROFILE_PLOTTER - mode 0, no parking, no spindle synchronized motion
+// The fixed settings are applied on startup and on settings restore, other values are rejected with error 5.
+// G33, G76 and G95 are rejected when spindle synchronized motion is not used.
+//#define MACHINE_PROFILE MACHINE_PROFILE_ROUTER // Default disabled. Uncomment to enable.
+
 
 //#define KINEMATICS_API // Remove comment to add HAL entry points for custom kinematics
+// NOTE: Kinematics may use kinematics_segment_line() for line segmentation, lines are then split adaptively so
+// that the deviation estimated by kinematics.segment_error() stays within the arc tolerance ($12).
 
 // Enable Maslow router kinematics.
 // Experimental - testing required and homing needs to be worked out.
@@ -69,8 +102,16 @@
 // have the same steps per mm internally.
 //#define COREXY // Default disabled. Uncomment to enable.
 
+// Enable five axis tool center point kinematics for machines with an A axis rotating about X and a C axis
+// rotating about Z, either a tilting C table on an A trunnion or a tilting A head on a C axis. The X, Y and
+// Z position and the feed rate then apply to the tool tip in the workpiece frame. Requires N_AXIS 6.
+// The machine geometry is set by FIVE_AXIS_PIVOT_X, _Y, _Z or FIVE_AXIS_PIVOT_LENGTH, see five_axis.h.
+// Experimental - soft limits are checked against the workpiece position, not the machine position.
+//#define FIVE_AXIS_TABLE // Default disabled. Uncomment to enable.
+//#define FIVE_AXIS_HEAD // Default disabled. Uncomment to enable.
+
 // Add HAL entry points for custom kinematics
-#if (defined(COREXY) || defined(WALL_PLOTTER) || defined(MASLOW_ROUTER)) && !defined(KINEMATICS_API)
+#if (defined(COREXY) || defined(WALL_PLOTTER) || defined(MASLOW_ROUTER) || defined(FIVE_AXIS_TABLE) || defined(FIVE_AXIS_HEAD)) && !defined(KINEMATICS_API)
 #define KINEMATICS_API
 #endif
 
@@ -99,7 +140,7 @@
 // that do not and must not exist in the streamed g-code program. ASCII control characters may be
 // used, if they are available per user setup. Also, extended ASCII codes (>127), which are never in
 // g-code programs, maybe selected for interface programs.
-// NOTE: If changed, manually update help message in report.c.
+// NOTE: If changed, manually update help message in report.h.
 
 #define CMD_EXIT 0x03 // ctrl-C
 #define CMD_RESET 0x18 // ctrl-X
@@ -122,6 +163,7 @@
 //#define CMD_DEBUG_REPORT 0x86 // Only when DEBUG enabled, sends debug report in '{}' braces.
 #define CMD_STATUS_REPORT_ALL 0x87
 #define CMD_OPTIONAL_STOP_TOGGLE 0x88
+#define CMD_STATUS_REPORT_BINARY 0x89 // Only when ENABLE_BINARY_STATUS_REPORT enabled, sends a binary status frame.
 #define CMD_OVERRIDE_FEED_RESET 0x90         // Restores feed override value to 100%.
 #define CMD_OVERRIDE_FEED_COARSE_PLUS 0x91
 #define CMD_OVERRIDE_FEED_COARSE_MINUS 0x92
@@ -160,6 +202,16 @@
 // define to 1 to force Grbl to always set the machine origin at the homed location despite switch orientation.
 #define HOMING_FORCE_SET_ORIGIN 0 // Default 0 (disabled). Set to 1 to enable.
 
+// Home the axes of all homing cycles concurrently with the $H command. Each axis runs its seek, pull-off
+// and locate phases independently: when an axis latches its switch it starts its pull-off and locate while
+// the others keep seeking. Motion is restarted for each latch, stopping the other axes abruptly as is done
+// for the latched axis. Cuts homing time on machines with long travels, but the cycle order is no longer
+// honored. E.g. Z is not cleared before X and Y starts moving. Multi-axis cycles set by $44-$49 are homed
+// the same way. With ganged axes to be squared or kinematics the axes of all cycles are homed in a
+// single cycle where the phases are run for all axes at once.
+// NOTE: Single axis homing commands still home the requested axes only.
+//#define HOMING_CONCURRENT_CYCLES // Default disabled. Uncomment to enable.
+
 // Number of blocks Grbl executes upon startup. These blocks are stored in EEPROM, where the size
 // and addresses are defined in settings.h. With the current settings, up to 2 startup blocks may
 // be stored and executed in order. These startup blocks would typically be used to set the g-code
@@ -203,6 +255,27 @@
 #define SAFETY_DOOR_SPINDLE_DELAY 4.0f // Float (seconds)
 #define SAFETY_DOOR_COOLANT_DELAY 1.0f // Float (seconds)
 
+// When enabled and the driver provides spindle RPM data (hal.spindle_get_data), typically from an encoder,
+// spindle starts (M3/M4) and restores wait until the measured RPM is within SPINDLE_AT_SPEED_TOLERANCE
+// percent of the programmed RPM instead of the driver at speed signal or the fixed SAFETY_DOOR_SPINDLE_DELAY.
+// If not at speed within SPINDLE_AT_SPEED_TIMEOUT seconds the spindle state change fails as for a driver
+// reporting at speed.
+//#define ENABLE_SPINDLE_AT_SPEED_RPM // Default disabled. Uncomment to enable.
+#define SPINDLE_AT_SPEED_TOLERANCE 5.0f // Float (percent)
+#define SPINDLE_AT_SPEED_TIMEOUT 10.0f // Float (seconds)
+
+// With parking enabled, restores the spindle and coolant when the fast parking return motion starts instead
+// of on arrival at the pull-out position. The restore delays, or the wait for the spindle to get up to speed,
+// then overlap the return motion and only the remaining time is waited for before the plunge.
+//#define PARKING_OVERLAPPED_RESTORE // Default disabled. Uncomment to enable.
+
+// Allows jogging away from a completed feed hold without losing the job queued in the planner. Jog commands
+// queued by protocol_enqueue_gcode(), e.g. from a keypad or pendant, are executed as system motions while
+// the planner buffer and the partially executed block are kept. On cycle start the jogs are retraced back
+// to the hold position before the job is resumed. The input stream is not read while holding.
+//#define ENABLE_HOLD_JOG // Default disabled. Uncomment to enable.
+//#define HOLD_JOG_WAYPOINTS 16 // Max number of jogs away from the hold position.
+
 // ---------------------------------------------------------------------------------------
 // ADVANCED CONFIGURATION OPTIONS:
 
@@ -225,6 +298,8 @@
 
 // #define ENABLE_SPINDLE_LINEARIZATION        // Uncomment to enable spindle RPM linearization. Requires compatible driver if enabled.
 #define SPINDLE_NPWM_PIECES                 4 // Maximum number of pieces for spindle RPM linearization, do not change unless more are needed.
+// #define ENABLE_SPINDLE_PWM_LUT              // Uncomment to convert RPM to PWM by a lookup table, linearization and inversion included.
+#define SPINDLE_PWM_LUT_SIZE              256 // Number of RPM intervals from rpm_min to rpm_max in the lookup table, 256 - 1024. 2 bytes RAM per entry.
 #define DEFAULT_SPINDLE_RPM_OVERRIDE      100 // 100%. Don't change this value.
 #define MAX_SPINDLE_RPM_OVERRIDE          200 // Percent of programmed spindle speed (100-255). Usually 200%.
 #define MIN_SPINDLE_RPM_OVERRIDE           10 // Percent of programmed spindle speed (1-100). Usually 10%.
@@ -277,13 +352,35 @@
 // NOTE: AMASS cutoff frequency multiplied by ISR overdrive factor must not exceed maximum step frequency.
 // NOTE: Current settings are set to overdrive the ISR to no more than 16kHz, balancing CPU overhead
 // and timer accuracy.  Do not alter these settings unless you know what you are doing.
+// The cutoff frequency is halved for each level, up to 7 levels may be configured. Grbl uses fewer
+// levels if the driver does not support as many, see the amass_level driver capability.
 #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
   #define MAX_AMASS_LEVEL 3
-  #if MAX_AMASS_LEVEL <= 0
-    error "AMASS must have 1 or more levels to operate correctly."
+  #define AMASS_LEVEL1_CUTOFF 8000 // Hz
+  #if MAX_AMASS_LEVEL <= 0 || MAX_AMASS_LEVEL > 7
+    error "AMASS must have 1 to 7 levels to operate correctly."
   #endif
 #endif
 
+// Enables the timed step executor for drivers with the step_timing capability. Instead of Bresenham ticks
+// at a fixed rate per segment the step time of each axis is computed from the segment step rate and the
+// stepper timer is programmed for the next step of any axis. All axes then step at exact intervals and
+// there are no ISR ticks without steps, AMASS is not used. Drivers without the capability are not affected.
+//#define ENABLE_STEP_TIMING // Default disabled. Uncomment to enable.
+
+// Enables offloading step generation to a co-processor, e.g. over SPI, for drivers that provide the
+// hal.remote_stepper transport. Prepared segments and the Bresenham data of their blocks are streamed to
+// the co-processor, which queues and executes them and reports its position back. Flow control is credit
+// based, see stepper.h for the frame format. Drivers not providing the transport are not affected.
+//#define ENABLE_REMOTE_STEPPER // Default disabled. Uncomment to enable.
+
+// Enables synchronized motion across two controllers, e.g. a second board driving additional axes. The leader
+// forwards its prepared segments and their block data to the follower, in the remote stepper frame format, and
+// outputs a sync pulse each time it starts a segment. The follower executes the received segments with its own
+// stepper driver interrupt, each started on the sync pulse. Both controllers must be built with the same N_AXIS
+// and segment buffer size, axes are stepped by the controller they are wired to. See the motion_link HAL entry.
+//#define ENABLE_MOTION_LINK // Default disabled. Uncomment to enable.
+
 // Sets the maximum step rate allowed to be written as a Grbl setting. This option enables an error
 // check in the settings module to prevent settings values that will exceed this limitation. The maximum
 // step rate is strictly limited by the CPU speed and will change if something other than an AVR running
@@ -337,6 +434,17 @@
 // much greater than this. The default setting should capture most, if not all, full arc error situations.
 #define ARC_ANGULAR_TRAVEL_EPSILON 5E-7f // Float (radians)
 
+// Enables adaptive arc segmentation. By default arc chords are sized from the arc tolerance ($12) only,
+// giving fast arcs chords executed in a fraction of a step segment and arcs on coarse axes chords of a few steps.
+// With this enabled chords are still sized from the arc tolerance, but lengthened so that each takes at least
+// one acceleration tick at the programmed feed rate and spans at least ARC_MIN_CHORD_STEPS steps. The chord
+// deviation is then allowed to grow up to ARC_ADAPTIVE_TOLERANCE_SCALE times the arc tolerance, fast arcs
+// are sent to the planner in fewer blocks. Slow arcs on fine axes are segmented as before.
+// NOTE: ARC_ADAPTIVE_TOLERANCE_SCALE must be 1.0 or more, with 1.0 chords are only sized by the arc tolerance.
+//#define ENABLE_ADAPTIVE_ARC_SEGMENTATION // Default disabled. Uncomment to enable.
+#define ARC_MIN_CHORD_STEPS 4 // Integer (steps)
+#define ARC_ADAPTIVE_TOLERANCE_SCALE 4.0f // Float
+
 // Default constants for G5 Cubic splines
 //
 #define BEZIER_MIN_STEP 0.002f
@@ -355,6 +463,7 @@
 // available RAM, like when re-compiling for MCU with ample amounts of RAM. Or decrease if the MCU begins to
 // crash due to the lack of available RAM or if the CPU is having trouble keeping up with planning
 // new incoming motions as they are executed.
+// NOTE: Drivers for MCUs with ample RAM may provide a larger buffer at run time, see hal.planner_buffer.
 // #define BLOCK_BUFFER_SIZE 16 // Uncomment to override default in planner.h.
 
 // Governs the size of the intermediary step segment buffer between the step execution algorithm
@@ -363,8 +472,56 @@
 // block velocity profile is traced exactly. The size of this buffer governs how much step
 // execution lead time there is for other Grbl processes have to compute and do their thing
 // before having to come back and refill this buffer, currently at ~50msec of step moves.
+// NOTE: Drivers may provide the buffer and its size at run time, see hal.segment_buffer.
 // #define SEGMENT_BUFFER_SIZE 6 // Uncomment to override default in stepper.h.
 
+// On feed hold and motion cancel, retracts the step segments queued but not yet started by the stepper
+// driver and regenerates them with the deceleration ramp, deceleration then starts after the executing
+// segment and the next rather than after the whole segment buffer. Only segments of the block being
+// prepped are retracted, except for spindle synchronized, native arc and laser PPI motions.
+// NOTE: Not for drivers that read ahead in the segment buffer.
+// #define ENABLE_HOLD_SEGMENT_REWIND // Default disabled. Uncomment to enable.
+
+// Starts the deceleration for feed hold, safety door and motion cancel from a driver task as soon as the
+// command or input is received, the main program may be busy elsewhere for longer, e.g. in a flash write.
+// The driver must provide hal.planner_lock and hal.pend_realtime, see hal.md.
+// #define ENABLE_REALTIME_DISPATCH // Default disabled. Uncomment to enable.
+
+// Lets the main loop wait for an event when there is no input to process rather than spin, frees the processor
+// for other tasks such as networking. Realtime flags, realtime commands and executed step segments end the wait.
+// The driver must provide hal.idle_wait and hal.idle_wake, see hal.md.
+// #define ENABLE_IDLE_WAIT // Default disabled. Uncomment to enable.
+
+// Shortens soft resets by not reading persistent storage again when nothing has changed. The startup lines
+// and the G54 coordinate data read on each reset are kept in RAM after the first read, and the backlash
+// compensation state is kept. Settings are not reloaded and drivers are not reconfigured on a reset anyway.
+// The reset time in the $I report is then measured from the reset request rather than from the restart.
+// #define ENABLE_WARM_RESET // Default disabled. Uncomment to enable.
+
+// Delays the auto cycle start from the main loop when idle until the planner buffer holds at least
+// AUTO_CYCLE_START_MIN_TIME (200) ms of planned motion or the first block has waited AUTO_CYCLE_START_TIMEOUT
+// (500) ms. Jobs then start with enough motion buffered to not stutter until the sender catches up.
+// A buffer sync, such as by M2/M30 at the end of a program, or a full planner buffer starts the cycle at once.
+// #define ENABLE_AUTO_CYCLE_START_DELAY // Default disabled. Uncomment to enable.
+
+// Lowers the feed rate when the input stream does not keep up with the machine, e.g. over a slow or
+// unreliable link, rather than letting the planner run dry and stop at the end of each buffer load. While
+// running with the planner buffer not full and holding less than FEED_ADAPT_LOW_TIME (500) ms of motion, the
+// feed rate is lowered FEED_ADAPT_STEP (5) percent every FEED_ADAPT_INTERVAL (100) ms, to no less than
+// FEED_ADAPT_MIN (50) percent. It is raised again in the same steps as the buffer refills. The reduction comes
+// on top of the feed override and is not applied to rapids or moves not subject to overrides.
+// #define ENABLE_FEED_ADAPTATION // Default disabled. Uncomment to enable.
+
+// Keeps the planner block data used for look-ahead planning (entry speeds, acceleration and distance) in
+// contiguous arrays separate from the rest of the block data. May speed up planning on MCUs with data cache
+// and a large planner buffer in external RAM, use the Simulator gplanbench tool to verify the gain.
+// #define PLANNER_SOA // Default disabled. Uncomment to enable.
+
+// Feed and rapid override changes arriving within this time of the last replan of the buffered motions are
+// coalesced into a single replan, e.g. when an override key is tapped repeatedly. Requires hal.get_elapsed_ticks.
+// Set to 0 to replan on every change.
+// #define PLANNER_OVERRIDE_REPLAN_INTERVAL 20 // ms. Uncomment to override default in planner.h.
+
 // Configures the position after a probing cycle during Grbl's check mode. Disabled sets
 // the position to the probe target, when enabled sets the position to the start position.
 // #define SET_CHECK_MODE_PROBE_TO_START // Default disabled. Uncomment to enable.
@@ -426,6 +583,10 @@
 // that any of these commands are used need continuous motions through them.
 #define FORCE_BUFFER_SYNC_DURING_WCO_CHANGE 1 // Default 1 (enabled). Set to 0 to disable.
 
+// Keeps `WPos:` and `WCO:` correct without stopping motion. Changes of the work coordinate offsets are queued with
+// the next motion and reported from when the stepper starts executing it, the buffer sync option above is then not used.
+//#define ENABLE_WCO_MOTION_SYNC // Default disabled. Uncomment to enable.
+
 // Used if sleep mode is enabled
 #define SLEEP_DURATION 5.0f // Number of minutes before sleep mode is entered.
 
@@ -433,8 +594,16 @@
 #define MAX_STORED_LINE_LENGTH 70
 
 #if COMPATIBILITY_LEVEL == 0
-// Number of tools in ATC tool table, comment out to disable
+// Number of tools in ATC tool table, comment out to disable. Limited to 255 unless ENABLE_SPARSE_TOOL_TABLE is enabled.
 // #define N_TOOLS 8
+
+// Enables a sparse tool table for N_TOOLS up to 65535. Only tools with a non-zero offset or radius are stored, in
+// TOOL_TABLE_RECORDS records in persistent storage or by the driver via hal.tool_read() and hal.tool_write(), e.g.
+// on the SD card. The TOOL_TABLE_CACHE_SIZE most recently used tools are kept in RAM, others are read when the T word
+// is executed. See grbl/tool_table.c for details.
+//#define ENABLE_SPARSE_TOOL_TABLE // Default disabled. Uncomment to enable.
+//#define TOOL_TABLE_CACHE_SIZE 8 // Number of tools kept in RAM.
+//#define TOOL_TABLE_RECORDS 8 // Number of tools stored in persistent storage, each takes about 20 bytes.
 #endif
 
 // Enable EEPROM emulation/buffering in RAM (allocated from heap)
@@ -442,9 +611,319 @@
 // The buffer will be written to EEPROM when in idle state.
 #define EMULATE_EEPROM
 
+// Changes to the RAM buffer are written to EEPROM or flash when the machine has been idle for this many
+// milliseconds, so G10 and tool table changes between the moves of a program, e.g. of a probing macro,
+// do not cause writes between moves. Pending changes are written immediately with $SYNC.
+// Set to 0 to write as soon as the machine is idle. Requires hal.get_elapsed_ticks, without it 0 is used.
+#define SETTINGS_WRITE_DELAY 1000 // ms
+
 // Max number of entries in log for PID data reporting, to be used for tuning
 //#define PID_LOG 1000 // Default disabled. Uncomment to enable.
 
+// Enables the core fixed point PID controller for closed loop spindle RPM control, used by drivers with the
+// spindle_pid capability instead of their own. The driver samples it at a fixed rate, the $80 - $82 gains are
+// then per second and independent of the sample rate. Samples can be streamed for live tuning by $PIDS=<n>.
+// NOTE: The spindle PID settings are only available when SPINDLE_RPM_CONTROLLED is defined.
+//#define ENABLE_SPINDLE_PID // Default disabled. Uncomment to enable.
+
+// Enables the core spindle encoder for drivers counting the encoder pulses in a hardware counter. The period is
+// sampled about every SPINDLE_ENCODER_SAMPLE_TIME ms independent of the RPM and averaged over the last
+// SPINDLE_ENCODER_FILTER_LENGTH samples, or IIR filtered with SPINDLE_ENCODER_FILTER set to SPINDLE_ENCODER_FILTER_IIR.
+// See grbl/spindle_encoder.h for the defaults.
+//#define ENABLE_SPINDLE_ENCODER // Default disabled. Uncomment to enable.
+
+// Enables queuing spindle speed changes outside laser mode with the motion they are programmed with, e.g. the
+// S-words of a toolpath with feed dependent RPM. The parser then does not wait for the planner buffer to empty,
+// the RPM is carried in the planner blocks and set when the first block of the motion starts, motion continues
+// through the change. Set SPINDLE_RPM_RAMP to the spindle acceleration in RPM per second to limit the junction
+// speed into a block running faster so that the feed rate does not get ahead of the spindle as it speeds up.
+// NOTE: The at speed check is not done for queued changes. Spindle on and off and direction changes are synced.
+//#define ENABLE_SPINDLE_RPM_QUEUE // Default disabled. Uncomment to enable.
+//#define SPINDLE_RPM_RAMP 1000 // RPM per second, 0 for no junction speed limit.
+
+// Enables queuing coolant changes (M7, M8 and M9) with the motion they are programmed with. The parser then does
+// not wait for the planner buffer to empty, the coolant state is set by the stepper driver interrupt when the first
+// planner block of the motion starts, as for output commands (M62/M63/M67). Standalone M7, M8 and M9 commands
+// programmed while motion is queued are held and carried by the next motion, or set when the cycle completes.
+// Other lines set a held change after syncing. Changes on lines without motion are synced as before when idle.
+//#define ENABLE_COOLANT_QUEUE // Default disabled. Uncomment to enable.
+
+// Enables feed per revolution (G95) tracking the measured spindle RPM. G95 moves are then planned from the
+// programmed RPM and the step segment generator slows each segment down by the ratio of the measured to the
+// programmed RPM, so that the feed per revolution is kept when the spindle bogs down under load. G95 is then
+// available for G1, G2, G3 and G5 with any driver providing spindle RPM data, without spindle synchronization.
+// A feed hold is started when the measured RPM drops below 5% of the programmed RPM, e.g. when the spindle stalls.
+// NOTE: The feed rate is not raised above the rate planned for the programmed RPM.
+//#define ENABLE_FEED_PER_REV_TRACKING // Default disabled. Uncomment to enable.
+
+// Enables backlash compensation, set per axis by the $160 - $16x settings. The planner records the backlash steps
+// in the block reversing the axis direction, the stepper module executes them in a take-up phase ahead of the
+// steps of the block without changing the machine position. Motion then continues through reversals without
+// extra blocks. The take-up steps are output at the step rate of the dominant axis at the block start.
 //#define ENABLE_BACKLASH_COMPENSATION
 
+// Enables jerk limited (S-curve) acceleration and deceleration ramps. Adds per axis jerk settings,
+// $170 - $17x, used by the planner to derate block acceleration and by the segment generator to
+// shape each trapezoidal ramp into a third-order profile with the same duration and distance.
+// Acceleration settings ($120 - $12x) then set the peak acceleration.
+//#define ENABLE_JERK_ACCELERATION // Default disabled. Uncomment to enable.
+
+// Enables input shaping to reduce ringing of the machine frame after acceleration changes. Adds per axis
+// resonance frequency settings, $180 - $18x in Hz with 0 disabling shaping for the axis, and the shaper
+// type $97 (0 = ZV, 1 = ZVD, 2 = MZV) and damping ratio $98 settings. The segment generator convolves each
+// acceleration and deceleration ramp with the shaper impulses of the axes moving the most in the block,
+// the planner derates block acceleration to compensate for the time added. Acceleration settings
+// ($120 - $12x) then set the peak acceleration.
+// NOTE: Cannot be enabled together with ENABLE_JERK_ACCELERATION.
+//#define ENABLE_INPUT_SHAPING // Default disabled. Uncomment to enable.
+
+// Enables rotary axes that wrap, settings $87 and $88 are axis masks. Positions of the axes in $87 are
+// reported modulo 360 degrees and have no soft limits, their step counts are folded into a single
+// revolution when all motion has completed so that an axis turning the same way never overflows.
+// Absolute positions, G90 and G53 moves, G28/G30 and offsets set from the current position, are taken
+// relative to the start of the revolution the axis is in, so moves do not depend on when it is folded.
+// Absolute (G90) moves of the axes in $88 take the shortest way round to the target angle, i.e. never
+// more than 180 degrees, incremental moves are not affected.
+// NOTE: Steps per degree times 360 should be a whole number for the step counts to be folded.
+//#define ENABLE_ROTARY_WRAP // Default disabled. Uncomment to enable.
+
+// Enables G64 P<tolerance> path blending. In G64 mode the corner between two consecutive G1 moves is
+// replaced by an arc that deviates no more than the tolerance from the programmed corner, allowing the
+// programmed feed rate to be sustained through dense polylines. If the P-word is omitted the arc
+// tolerance ($12) is used. G61 restores exact path mode.
+// NOTE: The last G1 move is held back until the next move is known, it is released when a
+// non-blendable command is executed, on buffer sync or when the input stream runs dry.
+//#define ENABLE_PATH_BLENDING // Default disabled. Uncomment to enable.
+
+// Enables merging of consecutive short G1 moves into one planner block when no programmed point deviates
+// more than the coalescing tolerance ($7) from the merged move. This bounds both chord error and
+// direction deviation and increases the effective look-ahead distance of the planner buffer.
+// Moves are not merged across changes in feed rate, spindle speed or other move parameters, or when
+// messages or output commands (M62/M63) are queued with the move. Set $7 to 0 to disable at run time.
+// NOTE: The last G1 move is held back as for path blending above.
+//#define ENABLE_SEGMENT_COALESCING // Default disabled. Uncomment to enable.
+
+// Enables native arcs: a G2/G3 move is queued as a single planner block carrying the arc geometry instead of
+// as a number of line chords, and the chords are computed by the step segment generator as the arc is executed.
+// Chords are kept within the arc tolerance ($12) by limiting the segment length, the feed rate is limited so
+// that the centripetal acceleration does not exceed the acceleration of the plane axes. An arc then takes a
+// single planner block, increasing the effective look-ahead distance of the planner buffer for arc heavy jobs.
+// NOTE: Not available with kinematics. Arcs are segmented as lines when backlash compensation is active and
+// for spindle synchronized motion.
+//#define ENABLE_NATIVE_ARCS // Default disabled. Uncomment to enable.
+
+// Enables compact binary block frames alongside text, negotiated by the $BIN=1 command. Frames carry
+// pre-tokenized words with fixed point values, or deltas to the previous value for a word, protected by
+// a CRC. Decoded blocks are fed straight to the parser, skipping the line builder and number conversion.
+// Binary frames are disabled on reset. See doc/markdown/grblHAL extensions.md for the frame format.
+//#define ENABLE_BINARY_STREAM // Default disabled. Uncomment to enable.
+
+// Enables laser raster rows in binary frames: a G1 move carrying the power of up to RASTER_ROW_MAX_PIXELS
+// pixels of equal length as delta encoded values. Laser power is updated per pixel by the segment generator,
+// which limits segment length to about one pixel while executing a row. A row replaces one G1 move
+// per pixel, greatly reducing the number of planner blocks and the amount of data sent for engraving.
+// NOTE: Requires ENABLE_BINARY_STREAM. Rows are not blended or coalesced with adjacent moves.
+//#define ENABLE_RASTER_ROWS // Default disabled. Uncomment to enable.
+
+// Enables bidirectional raster scans generated by the controller for photo engraving: M170 sets up an image and
+// M171 carries the pixel power of one row as a raster row. The overscan zones, the alternating scan direction
+// and the step-over to the next row are generated here, the sender then only sends the pixels and rows run at
+// the feed rate across the whole image. See grbl/raster_scan.c for the parameters.
+// NOTE: Requires ENABLE_RASTER_ROWS. Uses user M-codes, M-codes not handled are passed on to the driver.
+//#define ENABLE_RASTER_SCAN // Default disabled. Uncomment to enable.
+
+// Enables laser power ramping within step segments for RPM rate adjusted motions (M4 in laser mode). Laser power
+// is otherwise updated once per segment, about every 10 ms, leaving darker or lighter bands where the laser
+// accelerates or decelerates. With this enabled each segment carries a PWM slope from the power at its start
+// speed to the power at its end speed, the stepper driver interrupt then updates the PWM output per step.
+// Drivers may instead ramp the power by a dedicated timer by providing hal.spindle_ramp_pwm().
+// NOTE: Requires a driver with direct PWM updates, i.e. SPINDLE_RPM_CONTROLLED must not be defined.
+//#define ENABLE_LASER_POWER_RAMP // Default disabled. Uncomment to enable.
+
+// Enables laser PPI (pulses per inch) mode, set by the $PPI command: in laser mode the laser fires pulses of fixed
+// length at fixed distances along the path instead of being on continuously. The pulse timing is computed per step
+// segment by the core and output by the driver with timers, the stepper driver interrupt is not loaded by it.
+// NOTE: Requires a driver that provides hal.laser_pulse_train().
+//#define ENABLE_LASER_PPI // Default disabled. Uncomment to enable.
+
+// Enables binary status frames for high rate position logging, sent in response to the CMD_STATUS_REPORT_BINARY
+// realtime command. A frame has a fixed little-endian layout with the position in steps, feed rate, spindle speed,
+// overrides, input signals and buffer states along with a sequence number and a timestamp, protected by a CRC.
+// Frames are only sent to the stream the command was received from and only if its driver provides write_n().
+// See doc/markdown/grblHAL extensions.md for the frame layout.
+//#define ENABLE_BINARY_STATUS_REPORT // Default disabled. Uncomment to enable.
+
+// Enables LinuxCNC style O-word subroutines (sub, endsub, return, call), loops (repeat, while, do, break, continue)
+// and conditionals (if, elseif, else, endif). Bodies are kept in a RAM cache of FLOWCTRL_CACHE_SIZE bytes and executed
+// from there without being sent again.
+// NOTE: Counts and conditions must be numbers unless ENABLE_NGC_EXPRESSIONS is enabled, subroutines take no arguments.
+// See doc/markdown/grblHAL extensions.md for details.
+//#define ENABLE_O_WORDS // Default disabled. Uncomment to enable.
+//#define FLOWCTRL_CACHE_SIZE 4096 // Size of the program cache in bytes.
+//#define FLOWCTRL_MAX_SUBS 16 // Maximum number of subroutines defined at a time.
+
+// Enables the $MAC command for named g-code macros, e.g. for tool change and probing sequences. Macros are stored
+// tokenized, syntax checked when stored and executed without text scanning, a macro named STARTUP is executed after the
+// startup lines. The store is kept in persistent storage after the driver area if the driver reports a large enough
+// storage size in hal.eeprom.size, else in RAM until reset.
+//#define ENABLE_MACROS // Default disabled. Uncomment to enable.
+//#define MACRO_STORE_SIZE 512 // Size of the macro store in bytes.
+
+// Enables LinuxCNC style numbered parameters and expressions in g-code words, e.g. G38.2 Z[#5063 - 5] F[#1 * 2],
+// and parameter assignments #<n>=<value>. Parameters #1 - #NGC_USER_PARAMETERS are read/write and kept in RAM,
+// the probe result, stored positions and coordinate system offsets are available as read only parameters.
+// The evaluator does not use the heap. See doc/markdown/grblHAL extensions.md for details.
+//#define ENABLE_NGC_EXPRESSIONS // Default disabled. Uncomment to enable.
+//#define NGC_USER_PARAMETERS 100 // Number of read/write parameters, each takes 4 bytes of RAM.
+
+// Enables tokenizing of g-code lines ahead of execution while the planner buffer is full. Up to LOOKAHEAD_BLOCKS
+// lines consisting of plain words are read and converted in advance and executed without text scanning when the
+// planner buffer has room, their responses are sent in order when executed. Lines with other content are executed
+// as before, after any blocks held ahead.
+//#define ENABLE_LOOKAHEAD // Default disabled. Uncomment to enable.
+//#define LOOKAHEAD_BLOCKS 4 // Number of blocks held ahead, each takes about 140 bytes of RAM.
+
+// Number of canned drilling cycles that can be set up while the moves of a previous cycle are still being queued.
+// The parser continues with the next block, e.g. the next hole of a pattern, until the queue is full.
+//#define CANNED_CYCLE_QUEUE_SIZE 4 // Default 4, each takes about 150 bytes of RAM.
+
+// Enables M66 wait on input without blocking the parser. The wait is queued as a barrier that motion after it is planned
+// to stop at, the input is polled from the realtime loop when the barrier is reached and motion resumes when the condition
+// is met or the wait times out. Realtime reports and feed hold stay responsive while waiting and the result is available
+// as parameter #5399 when ENABLE_NGC_EXPRESSIONS is enabled. Requires that the driver provides hal.get_elapsed_ticks(),
+// M66 is executed as before if not.
+//#define ENABLE_WAIT_ON_INPUT_ASYNC // Default disabled. Uncomment to enable.
+
+// Enables position triggered outputs. M62, M63 and M67 accept a D word, the distance along the next motion at which
+// the output is set. The stepper interrupt compares the position along the block with the trigger of the next output
+// pending, outputs without a D word are set at the start of the motion as before. Distances beyond the end of a planner
+// block are carried to the following blocks, outputs still pending when motion stops are set on cycle completion.
+//#define ENABLE_POSITION_OUTPUTS // Default disabled. Uncomment to enable.
+
+// Enables the tool change sequencer for drivers implementing hal.tool_change() for an automatic tool changer.
+// A tool change is described as a list of move, output, wait on input, spindle, coolant and dwell steps and
+// only steps depending on motion having completed wait for it, moves are planned as a continuous path.
+// See grbl/atc_seq.c for details.
+//#define ENABLE_ATC_SEQUENCER // Default disabled. Uncomment to enable.
+
+// Enables remote I/O modules on a CAN bus for drivers providing the hal.can transport, the module ports are added to
+// hal.port after the driver ports. Input states are sent by the modules on change. M62, M63 and M67 outputs are staged
+// on the modules when their motion is prepared and set by a single broadcast frame when the motion starts.
+// See grbl/can_io.h for the frame format.
+//#define ENABLE_CAN_IO // Default disabled. Uncomment to enable.
+//#define CAN_IO_MODULES 1 // Number of remote modules.
+
+// Enables following error monitoring of closed loop steppers or servos for drivers reading back the motor positions
+// from encoders, e.g. by quadrature timers, via hal.axis_encoder. The encoder positions are compared with the commanded
+// position each time a step segment is loaded. When the error exceeds FOLLOWING_ERROR_LIMIT mm on an axis a feed hold
+// is raised, or with FOLLOWING_ERROR_ALARM set to 1 motion is aborted and alarm 15 raised. The encoders are synced
+// to the commanded position on reset and when the position is set, e.g. by homing. The max. following error per
+// axis is reported by $FERR and cleared by $FERR=0.
+//#define ENABLE_FOLLOWING_ERROR // Default disabled. Uncomment to enable.
+//#define FOLLOWING_ERROR_LIMIT 0.1f // mm
+//#define FOLLOWING_ERROR_ALARM 0
+
+// Enables job statistics for maintenance scheduling: run time, motion time, spindle-on time and distance per axis of
+// each job, from its first motion to M2 or M30, and the number of jobs, aborted jobs and alarms. The counters are
+// updated per step segment, added to totals kept in persistent storage after the macro store or the driver area
+// when a job ends, and reported by $STATS. $STATS=0 clears the totals. The SD card plugin can log each job to a file.
+//#define ENABLE_JOB_STATS // Default disabled. Uncomment to enable.
+
+// Enables JSON formatted reports, selected by the $JSON=1 command. Each report is a single JSON object
+// on a line, rendered straight into the output buffer. Responses, messages, settings, the realtime, $G
+// and $# reports are formatted, $I is still reported as text. Text reports are restored on reset.
+// See doc/markdown/grblHAL extensions.md for the report format.
+//#define ENABLE_JSON_REPORTS // Default disabled. Uncomment to enable.
+
+// Enables output of the $$ and $# reports in chunks from the main loop, as much as fits in the transmit buffer
+// per pass, so that a slow link does not block the main loop and the segment buffer refill. Input is held until
+// the report is complete and $$ is accepted while in motion. Requires a stream that provides get_tx_buffer_available(),
+// the reports are output as before if not.
+//#define ENABLE_CHUNKED_REPORTS // Default disabled. Uncomment to enable.
+//#define REPORT_CHUNK_TX_FREE 128 // Transmit buffer space needed for the next report line.
+
+// Enables validation of lines sent as N<line number> ... *<checksum>, the checksum is the XOR of all characters
+// before the '*'. Lines with a bad checksum or out of sequence are not executed, [RESEND:<line number>] is output
+// before the error response. A line with a number lower than expected is taken as resent after a lost response and
+// only acknowledged. The sequence is restarted by M110 [N<n>], by a line numbered 0 or 1 and at program end (M2, M30).
+// Lines without a checksum are executed as before. Allows streaming at high baud rates without corrupted lines being
+// executed, the checksum is computed as the characters are classified.
+//#define ENABLE_LINE_CHECKSUM // Default disabled. Uncomment to enable.
+
+// Enables coalesced acknowledgments, selected by the $ACK=1 command. Successful lines are then acknowledged in aggregate
+// by ok:<n>, sent ACK_COALESCE_MS after the first line acknowledged or when 64 lines are pending. Errors are
+// sent immediately, after any pending acknowledgments, as error:<code>:<line> where line is the number of responses
+// since $ACK=1. Reduces the reverse traffic of links with a high per packet cost such as WebSocket and Bluetooth.
+//#define ENABLE_ACK_COALESCING // Default disabled. Uncomment to enable.
+//#define ACK_COALESCE_MS 5 // Max delay of an acknowledgment.
+
+// Enables cycle count instrumentation of the stepper interrupt handler, st_prep_buffer(), gc_execute_block(),
+// the planner recalculation and the realtime report. Minimum, average and maximum cycles per call and the
+// number of calls are reported by the $PERF command and cleared by $PERF=0. Requires a driver that provides
+// a cycle counter, e.g. DWT CYCCNT on Cortex-M or CCOUNT on ESP32, adds a few cycles to each call measured.
+// Segment buffer underruns, planner starvations, forced stops at the end of the planner buffer and the minimum
+// planner fill level are reported as well, these are counted with any driver.
+//#define ENABLE_PERF_COUNTERS // Default disabled. Uncomment to enable.
+
+// Enables a RAM trace of the last MOTION_TRACE_SIZE step segments executed, one compact record per segment
+// with timestamp, segment id, step rate, steps, AMASS level, spindle PWM or RPM and line number, for post-mortem
+// analysis of motion. Output by the $TRACE command, cleared by $TRACE=0. Recording is suspended on an alarm
+// to keep the records leading up to it. Each record takes 20 bytes of RAM.
+//#define ENABLE_MOTION_TRACE // Default disabled. Uncomment to enable.
+//#define MOTION_TRACE_SIZE 256 // Number of records, must be a power of 2.
+
+// Enables memory usage reporting in the $I report: the stack high-water mark, for drivers that provide the
+// stack region, and the number of heap allocations and bytes outstanding along with the peak heap usage.
+// The stack is painted with a pattern at boot, leaving STACK_PAINT_MARGIN bytes below the stack pointer.
+//#define ENABLE_MEMORY_USAGE // Default disabled. Uncomment to enable.
+
+// Enables the $PGRID command for probing a grid of points without host interaction, e.g. for height mapping.
+// Retract and traverse motions between points are chained in the planner and the probed positions are kept
+// in RAM, $PGRID outputs them as one block of reports. Each grid point takes 4 bytes of RAM.
+//#define ENABLE_PROBE_GRID // Default disabled. Uncomment to enable.
+//#define PROBE_GRID_MAX_POINTS 400 // Maximum number of grid points.
+
+// Enables the $HMAP command for Z compensation from the grid probed by $PGRID, e.g. for PCB milling or engraving
+// on warped stock. The Z offset is bilinearly interpolated from the grid and long XY motions are subdivided to
+// follow the surface. Requires ENABLE_PROBE_GRID.
+//#define ENABLE_HEIGHT_MAP // Default disabled. Uncomment to enable.
+//#define HEIGHT_MAP_SEGMENTS_PER_CELL 2 // Number of segments per grid spacing XY motions are subdivided into.
+
+// Enables continuous jogging for keypads and MPGs: while a jog key is held, or the MPG input is active, a short
+// horizon of jog blocks is kept queued ahead of the current position. Release decelerates immediately by the
+// jog cancel path. The input must refresh the jog within JOG_CONTINUOUS_TIMEOUT milliseconds, else it is stopped.
+//#define ENABLE_JOG_CONTINUOUS // Default disabled. Uncomment to enable.
+//#define JOG_CONTINUOUS_SEGMENTS 3 // Step segments of travel queued in addition to the braking distance.
+//#define JOG_CONTINUOUS_TIMEOUT 200 // ms
+
+// Enables handwheel (MPG) position following for encoders in the Encoder_MPG_<axis> modes. Encoder counts are turned
+// into jog blocks directly, without $J= commands, ending where the wheel stops. The travel queued ahead is limited to
+// the braking distance plus JOG_MPG_SEGMENTS step segments so that direction changes are followed with little lag.
+//#define ENABLE_JOG_MPG // Default disabled. Uncomment to enable.
+//#define JOG_MPG_DISTANCE 0.01f // Travel per encoder count (mm).
+//#define JOG_MPG_RATE_PCT 50 // Jog rate in percent of the axis max rate.
+//#define JOG_MPG_SEGMENTS 3 // Step segments of travel queued in addition to the braking distance.
+
+// Enables reading input from several streams, e.g. a host and an MPG pendant, without switching hal.stream. Each
+// stream keeps its own input buffer, at the start of each line the stream with the highest priority that has data
+// is read until the line ends, the response goes to that stream. Not available for drivers providing read_block().
+//#define ENABLE_STREAM_ARBITER // Default disabled. Uncomment to enable.
+
+// Converts integers to decimal digits by shifts and adds instead of division by 10 in uitoa() and ftoa(), for
+// MCUs without a hardware divider where each division is a library call. Enabled by default for Cortex-M0/M0+.
+// NOTE: Only number formatting is affected, segment prep and the planner still use floating point arithmetic.
+//#define NO_HW_DIVIDE // Default disabled. Uncomment to enable.
+#if !defined(NO_HW_DIVIDE) && defined(__ARM_ARCH_6M__)
+#define NO_HW_DIVIDE
+#endif
+
+// The realtime execution flags are set and cleared by inlined compiler atomics instead of calls to hal.set_bits_atomic()
+// and friends, which drivers usually implement by disabling interrupts. Enabled by default when the compiler has lock-free
+// atomics for the flag type, e.g. LDREX/STREX on Cortex-M3 and later and ESP32. Uncomment to always call the HAL functions.
+//#define NO_INLINE_ATOMICS // Default disabled. Uncomment to enable.
+#if !defined(NO_INLINE_ATOMICS) && defined(__GCC_ATOMIC_INT_LOCK_FREE) && __GCC_ATOMIC_INT_LOCK_FREE == 2 && \
+     defined(__GCC_ATOMIC_LONG_LOCK_FREE) && __GCC_ATOMIC_LONG_LOCK_FREE == 2
+#define INLINE_ATOMICS
+#endif
+
 #endif
@@ -112,6 +112,16 @@
 #define DEFAULT_X_ACCELERATION (10.0*60*60) // 10*60*60 mm/min^2 = 10 mm/sec^2
 #define DEFAULT_Y_ACCELERATION (10.0*60*60) // 10*60*60 mm/min^2 = 10 mm/sec^2
 #define DEFAULT_Z_ACCELERATION (10.0*60*60) // 10*60*60 mm/min^2 = 10 mm/sec^2
+#define DEFAULT_X_JERK (100.0*60*60*60) // 100*60*60*60 mm/min^3 = 100 mm/sec^3
+#define DEFAULT_Y_JERK (100.0*60*60*60) // 100*60*60*60 mm/min^3 = 100 mm/sec^3
+#define DEFAULT_Z_JERK (100.0*60*60*60) // 100*60*60*60 mm/min^3 = 100 mm/sec^3
+#define DEFAULT_X_SHAPER_FREQ 0.0f // Hz, 0 disables input shaping
+#define DEFAULT_Y_SHAPER_FREQ 0.0f // Hz, 0 disables input shaping
+#define DEFAULT_Z_SHAPER_FREQ 0.0f // Hz, 0 disables input shaping
+#define DEFAULT_SHAPER_TYPE 0 // ZV
+#define DEFAULT_SHAPER_DAMPING 0.1f
+#define DEFAULT_ROTARY_WRAP_MASK 0 // No axes wrap
+#define DEFAULT_ROTARY_SHORTEST_PATH_MASK 0
 #define DEFAULT_X_MAX_TRAVEL 200.0f // mm NOTE: Must be a positive value.
 #define DEFAULT_Y_MAX_TRAVEL 200.0f // mm NOTE: Must be a positive value.
 #define DEFAULT_Z_MAX_TRAVEL 200.0f // mm NOTE: Must be a positive value.
@@ -133,6 +143,7 @@
 #define DEFAULT_STEPPER_IDLE_LOCK_TIME 25 // msec (0-254, 255 keeps steppers enabled)
 #define DEFAULT_JUNCTION_DEVIATION 0.01f // mm
 #define DEFAULT_ARC_TOLERANCE 0.002f // mm
+#define DEFAULT_COALESCING_TOLERANCE 0.002f // mm
 #define DEFAULT_REPORT_INCHES 0 // false
 #define DEFAULT_INVERT_LIMIT_PINS 0 // false
 #define DEFAULT_SOFT_LIMIT_ENABLE 0 // false
@@ -150,16 +161,22 @@
 #define DEFAULT_A_STEPS_PER_MM 250.0f
 #define DEFAULT_A_MAX_RATE 500.0f // mm/min
 #define DEFAULT_A_ACCELERATION (10.0*60*60) // 10*60*60 mm/min^2 = 10 mm/sec^2
+#define DEFAULT_A_JERK (100.0*60*60*60) // 100*60*60*60 mm/min^3 = 100 mm/sec^3
+#define DEFAULT_A_SHAPER_FREQ 0.0f // Hz
 #define DEFAULT_A_MAX_TRAVEL 200.0f // mm
 
 #define DEFAULT_B_STEPS_PER_MM 250.0f
 #define DEFAULT_B_MAX_RATE 500.0f // mm/min
 #define DEFAULT_B_ACCELERATION (10.0*60*60) // 10*60*60 mm/min^2 = 10 mm/sec^2
+#define DEFAULT_B_JERK (100.0*60*60*60) // 100*60*60*60 mm/min^3 = 100 mm/sec^3
+#define DEFAULT_B_SHAPER_FREQ 0.0f // Hz
 #define DEFAULT_B_MAX_TRAVEL 200.0f // mm
 
 #define DEFAULT_C_STEPS_PER_MM 250.0f
 #define DEFAULT_C_MAX_RATE 500.0f // mm/min
 #define DEFAULT_C_ACCELERATION (10.0*60*60) // 10*60*60 mm/min^2 = 10 mm/sec^2
+#define DEFAULT_C_JERK (100.0*60*60*60) // 100*60*60*60 mm/min^3 = 100 mm/sec^3
+#define DEFAULT_C_SHAPER_FREQ 0.0f // Hz
 #define DEFAULT_C_MAX_TRAVEL 200.0f // mm
 
 #define DEFAULT_G73_RETRACT 0.1f // mm
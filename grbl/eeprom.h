@@ -23,6 +23,7 @@
 #define eeprom_h
 
 #define GRBL_EEPROM_SIZE 1024
+#define EEPROM_CHECKSUM_SIZE 2 // CRC-16 stored after each block, low byte first
 
 typedef enum {
     EEPROM_None = 0,
@@ -35,6 +36,16 @@ typedef struct {
     uint16_t size;
 } eeprom_driver_area_t;
 
+// Flash area for a settings journal, used by EEPROM emulation instead of memcpy_to_flash() when base is set.
+// Sectors are consecutive and each is erased as a unit, at least two are required.
+typedef struct {
+    const uint8_t *base;
+    uint32_t sector_size;   // a multiple of 8 bytes, must hold the complete settings image plus 16 bytes
+    uint8_t sectors;
+    bool (*erase)(const uint8_t *sector);
+    bool (*program)(const uint8_t *address, const uint8_t *data, uint32_t size); // address and size are multiples of 8
+} eeprom_journal_t;
+
 typedef struct {
     eeprom_type type;
     uint16_t size;
@@ -43,8 +54,12 @@ typedef struct {
     void (*put_byte)(uint32_t addr, uint8_t new_value);
     void (*memcpy_to_with_checksum)(uint32_t destination, uint8_t *source, uint32_t size);
     bool (*memcpy_from_with_checksum)(uint8_t *destination, uint32_t source, uint32_t size);
+    void (*memcpy_from)(uint8_t *destination, uint32_t source, uint32_t size); // optional, block read without checksum
     bool (*memcpy_from_flash)(uint8_t *dest);
     bool (*memcpy_to_flash)(uint8_t *source);
+    void (*memcpy_block_to_flash)(uint32_t destination, uint8_t *source, uint32_t size); // optional, writes a block of size bytes and its checksum
+    uint16_t (*checksum)(uint8_t *data, uint32_t size); // optional, CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF) by a hardware CRC unit
+    eeprom_journal_t journal;
 } eeprom_io_t;
 
 #endif
@@ -30,6 +30,7 @@
 static uint8_t *noepromdata = 0;
 static eeprom_io_t physical_eeprom;
 static bool dirty;
+static uint32_t dirty_since, idle_since;
 
 settings_dirty_t settings_dirty;
 
@@ -45,10 +46,10 @@ typedef struct {
 #define EEPROM_GRP_STARTUP 3
 #define EEPROM_GRP_BUILD 4
 
-#define PARAMETER_ADDR(n) (EEPROM_ADDR_PARAMETERS + n * (sizeof(coord_data_t) + 1))
-#define STARTLINE_ADDR(n) (EEPROM_ADDR_STARTUP_BLOCK + n * (MAX_STORED_LINE_LENGTH + 1))
+#define PARAMETER_ADDR(n) (EEPROM_ADDR_PARAMETERS + n * (sizeof(coord_data_t) + EEPROM_CHECKSUM_SIZE))
+#define STARTLINE_ADDR(n) (EEPROM_ADDR_STARTUP_BLOCK + n * (MAX_STORED_LINE_LENGTH + EEPROM_CHECKSUM_SIZE))
 #ifdef N_TOOLS
-#define TOOL_ADDR(n) (EEPROM_ADDR_TOOL_TABLE + n * (sizeof(tool_data_t) + 1))
+#define TOOL_ADDR(n) (EEPROM_ADDR_TOOL_TABLE + n * (sizeof(tool_data_t) + EEPROM_CHECKSUM_SIZE))
 #endif
 
 static const emap_t target[] = {
@@ -62,7 +63,7 @@ static const emap_t target[] = {
     {TOOL_ADDR(5), EEPROM_GRP_TOOLS, 5},
     {TOOL_ADDR(6), EEPROM_GRP_TOOLS, 6},
     {TOOL_ADDR(7), EEPROM_GRP_TOOLS, 7},
-#if N_TOOL > 8
+#if N_TOOL > 8 || (defined(ENABLE_SPARSE_TOOL_TABLE) && TOOL_TABLE_RECORDS > 8)
 #error Increase number of tool entries!
 #endif
 #endif
@@ -97,33 +98,48 @@ inline static uint8_t ram_get_byte (uint32_t addr)
 
 inline static void ram_put_byte (uint32_t addr, uint8_t new_value)
 {
+    if(addr == 0 && noepromdata[addr] != new_value)
+        settings_dirty.version = settings_dirty.is_dirty = true;
+
     dirty = dirty || noepromdata[addr] != new_value;
     noepromdata[addr] = new_value;
 }
 
+inline static uint16_t ram_get_checksum (uint32_t addr)
+{
+    return noepromdata[addr] | (noepromdata[addr + 1] << 8);
+}
+
 // Extensions added as part of Grbl
 
+// The block is compared and copied with the library functions, which move whole words when aligned.
 static void memcpy_to_ram_with_checksum (uint32_t destination, uint8_t *source, uint32_t size)
 {
-    uint32_t dest = destination;
-    uint8_t checksum = calc_checksum(source, size);
-
-    dirty = false;
-
-    for(; size > 0; size--)
-        ram_put_byte(dest++, *(source++));
+    uint16_t checksum = calc_checksum(source, size);
 
-    ram_put_byte(dest, checksum);
+    if((dirty = ram_get_checksum(destination + size) != checksum || memcmp(&noepromdata[destination], source, size))) {
 
-    if(dirty) {
+        memcpy(&noepromdata[destination], source, size);
+        noepromdata[destination + size] = (uint8_t)checksum;
+        noepromdata[destination + size + 1] = (uint8_t)(checksum >> 8);
 
         uint8_t idx = 0;
 
+        if(!settings_dirty.is_dirty && hal.get_elapsed_ticks)
+            dirty_since = idle_since = hal.get_elapsed_ticks();
+
         settings_dirty.is_dirty = dirty;
 
         if(hal.eeprom.driver_area.address && destination == hal.eeprom.driver_area.address)
             settings_dirty.driver_settings = true;
-
+#ifdef ENABLE_MACROS
+        else if(macros_storage_address() && destination == macros_storage_address())
+            settings_dirty.macros = true;
+#endif
+#ifdef ENABLE_JOB_STATS
+        else if(job_stats_storage_address() && destination == job_stats_storage_address())
+            settings_dirty.job_stats = true;
+#endif
         else {
 
             do {
@@ -159,12 +175,209 @@ static void memcpy_to_ram_with_checksum (uint32_t destination, uint8_t *source,
 
 static bool memcpy_from_ram_with_checksum (uint8_t *destination, uint32_t source, uint32_t size)
 {
-    uint8_t checksum = calc_checksum(&noepromdata[source], size);
+    memcpy(destination, &noepromdata[source], size);
+
+    return calc_checksum(&noepromdata[source], size) == ram_get_checksum(source + size);
+}
+
+static void memcpy_from_ram (uint8_t *destination, uint32_t source, uint32_t size)
+{
+    memcpy(destination, &noepromdata[source], size);
+}
+
+/*
+  Flash settings journal, used when the driver provides a flash area in hal.eeprom.journal.
+  Changed blocks of the RAM copy are appended as records to the active sector, so a G10 or a setting
+  change programs a few bytes instead of erasing and rewriting the whole image. When the active sector
+  is full the image is compacted into the next sector, which is erased in advance, at an earlier sync,
+  once the active sector is half full. The sector header is written after the image so an interrupted
+  compaction leaves the previous sector active. On startup the records of the sector with the highest
+  sequence number are replayed, records are written data first and a torn record ends the replay.
+  Records written by settings version 16 and earlier have a checksum byte instead of a CRC-16 and are
+  replayed too, the converted blocks are then appended by the first sync after settings_init().
+*/
+
+#define JOURNAL_MAGIC 0x4C4E524A // "JRNL"
+#define JOURNAL_RECORD_V16 0x5A
+#define JOURNAL_RECORD 0x5B
+#define JOURNAL_ALIGN(n) (((n) + 7) & ~7)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+} journal_header_t;
+
+typedef struct {
+    uint16_t addr;
+    uint16_t size;
+    uint8_t checksum;   // Version 16 records only
+    uint8_t marker;
+    uint16_t crc;
+} journal_record_t;
+
+static struct {
+    bool ok;
+    bool compact;       // Active sector is damaged or not yet written, compact before appending
+    bool compacted;     // Image compacted during the current sync
+    bool spare_erased;
+    uint_fast8_t sector;
+    uint32_t sequence;
+    uint32_t head;      // Offset of the next record in the active sector
+} journal = {0};
+
+inline static const uint8_t *journal_sector (uint_fast8_t sector)
+{
+    return hal.eeprom.journal.base + sector * hal.eeprom.journal.sector_size;
+}
+
+static bool journal_is_erased (const uint8_t *data, uint32_t size)
+{
+    while(size && *data++ == 0xFF)
+        size--;
+
+    return size == 0;
+}
+
+// Programs size bytes, the last partial group of 8 bytes is padded with erased bytes.
+static bool journal_program (const uint8_t *address, const uint8_t *data, uint32_t size)
+{
+    uint8_t tail[8];
+    uint32_t aligned = size & ~7;
+    bool ok = aligned == 0 || hal.eeprom.journal.program(address, data, aligned);
+
+    if(ok && (size -= aligned)) {
+        memset(tail, 0xFF, sizeof(tail));
+        memcpy(tail, data + aligned, size);
+        ok = hal.eeprom.journal.program(address + aligned, tail, sizeof(tail));
+    }
+
+    return ok;
+}
+
+static bool journal_append (uint32_t addr, uint32_t size)
+{
+    const uint8_t *sector = journal_sector(journal.sector);
+    journal_record_t record = {
+        .addr = (uint16_t)addr,
+        .size = (uint16_t)size,
+        .checksum = 0xFF,
+        .marker = JOURNAL_RECORD,
+        .crc = calc_checksum(&noepromdata[addr], size)
+    };
+
+    if(journal.head + sizeof(journal_record_t) + JOURNAL_ALIGN(size) > hal.eeprom.journal.sector_size)
+        return false;
+
+    bool ok = journal_program(sector + journal.head + sizeof(journal_record_t), &noepromdata[addr], size) &&
+               hal.eeprom.journal.program(sector + journal.head, (uint8_t *)&record, sizeof(journal_record_t));
+
+    journal.head += sizeof(journal_record_t) + JOURNAL_ALIGN(size);
+    journal.compact = !ok;
+
+    return ok;
+}
+
+static void journal_compact (void)
+{
+    uint_fast8_t active = journal.sector, next = (journal.sector + 1) % hal.eeprom.journal.sectors;
+    journal_header_t header = {
+        .magic = JOURNAL_MAGIC,
+        .sequence = journal.sequence + 1
+    };
+
+    journal.compacted = true; // Retried at next sync if failed
+
+    if(!(journal.spare_erased || hal.eeprom.journal.erase(journal_sector(next))))
+        return;
+
+    journal.sector = next;
+    journal.head = sizeof(journal_header_t);
+    journal.spare_erased = false;
+
+    if(journal_append(0, hal.eeprom.size) && hal.eeprom.journal.program(journal_sector(next), (uint8_t *)&header, sizeof(journal_header_t)))
+        journal.sequence = header.sequence;
+    else {
+        journal.sector = active;
+        journal.compact = true;
+    }
+}
+
+// Has the same signature as the physical EEPROM block write, source is the RAM copy of the block.
+static void journal_write (uint32_t destination, uint8_t *source, uint32_t size)
+{
+    if(journal.compacted)
+        return;
+
+    if(journal.compact || !journal_append(destination, size + EEPROM_CHECKSUM_SIZE)) // with checksum
+        journal_compact();
+}
+
+// Erases the sector to compact into at an earlier sync than the compaction itself.
+static void journal_prepare (void)
+{
+    if(!journal.spare_erased && !journal.compact && journal.head > hal.eeprom.journal.sector_size / 2)
+        journal.spare_erased = hal.eeprom.journal.erase(journal_sector((journal.sector + 1) % hal.eeprom.journal.sectors));
+}
+
+// Rebuilds the RAM copy from the active sector, returns false if there is none.
+static bool journal_load (void)
+{
+    uint_fast8_t sector = hal.eeprom.journal.sectors;
+    journal_header_t header;
+    journal_record_t record;
+    const uint8_t *data;
+    uint8_t *record_data;
+
+    journal.ok = true;
+    journal.compact = true;
+    journal.sector = hal.eeprom.journal.sectors - 1; // First compaction is to sector 0
+    journal.sequence = 0;
+
+    do {
+        memcpy(&header, journal_sector(--sector), sizeof(journal_header_t));
+        if(header.magic == JOURNAL_MAGIC && (journal.compact || header.sequence > journal.sequence)) {
+            journal.compact = false;
+            journal.sector = sector;
+            journal.sequence = header.sequence;
+        }
+    } while(sector);
+
+    if(journal.compact)
+        return false;
+
+    data = journal_sector(journal.sector);
+    journal.head = sizeof(journal_header_t);
+
+    while(journal.head + sizeof(journal_record_t) <= hal.eeprom.journal.sector_size) {
+
+        memcpy(&record, data + journal.head, sizeof(journal_record_t));
+
+        if(!(record.marker == JOURNAL_RECORD || record.marker == JOURNAL_RECORD_V16))
+            break;
+
+        record_data = (uint8_t *)data + journal.head + sizeof(journal_record_t);
+
+        if(journal.head + sizeof(journal_record_t) + JOURNAL_ALIGN(record.size) > hal.eeprom.journal.sector_size ||
+            record.addr + record.size > hal.eeprom.size ||
+             (record.marker == JOURNAL_RECORD
+               ? calc_checksum(record_data, record.size) != record.crc
+               : calc_checksum8(record_data, record.size) != record.checksum)) {
+            journal.compact = true;
+            break;
+        }
+
+        memcpy(&noepromdata[record.addr], record_data, record.size);
+        journal.head += sizeof(journal_record_t) + JOURNAL_ALIGN(record.size);
+    }
 
-    for(; size > 0; size--)
-        *(destination++) = ram_get_byte(source++);
+    // Partly written record?
+    if(!journal.compact && journal.head < hal.eeprom.journal.sector_size)
+        journal.compact = !journal_is_erased(data + journal.head, hal.eeprom.journal.sector_size - journal.head);
 
-    return checksum == ram_get_byte(source);
+    sector = (journal.sector + 1) % hal.eeprom.journal.sectors;
+    journal.spare_erased = journal_is_erased(journal_sector(sector), hal.eeprom.journal.sector_size);
+
+    return true;
 }
 
 //
@@ -180,7 +393,7 @@ bool eeprom_emu_init()
 
     memcpy(&physical_eeprom, &hal.eeprom, sizeof(eeprom_io_t)); // save pointers to physical EEPROM handler functions
 
-    if((noepromdata = malloc(hal.eeprom.size)) != 0) {
+    if((noepromdata = mem_alloc(hal.eeprom.size)) != 0) {
 
         if(physical_eeprom.type == EEPROM_Physical) {
 
@@ -188,11 +401,19 @@ bool eeprom_emu_init()
             if(physical_eeprom.get_byte(0) != SETTINGS_VERSION)
                 settings_init();
 
-            // Copy physical EEPROM content to RAM
-            do {
+            // Copy physical EEPROM content to RAM, in a single transfer if supported by the driver
+            if(physical_eeprom.memcpy_from)
+                physical_eeprom.memcpy_from(noepromdata, 0, hal.eeprom.size);
+            else do {
                 idx--;
                 ram_put_byte(idx, physical_eeprom.get_byte(idx));
             } while(idx);
+        } else if(hal.eeprom.journal.base) {
+            if(!journal_load()) {
+                memset(noepromdata, 0xFF, hal.eeprom.size);
+                if(hal.eeprom.memcpy_from_flash) // Import from previous single page storage
+                    hal.eeprom.memcpy_from_flash(noepromdata);
+            }
         } else if(hal.eeprom.memcpy_from_flash)
             hal.eeprom.memcpy_from_flash(noepromdata);
 
@@ -202,6 +423,7 @@ bool eeprom_emu_init()
         hal.eeprom.put_byte = &ram_put_byte;
         hal.eeprom.memcpy_to_with_checksum = &memcpy_to_ram_with_checksum;
         hal.eeprom.memcpy_from_with_checksum = &memcpy_from_ram_with_checksum;
+        hal.eeprom.memcpy_from = &memcpy_from_ram;
 
         // If no physical EEPROM available then import default settings to RAM
         if(physical_eeprom.type == EEPROM_None)
@@ -220,25 +442,44 @@ void eeprom_emu_sync_physical ()
     if(!settings_dirty.is_dirty)
         return;
 
-    if(physical_eeprom.type == EEPROM_Physical) {
+    if(physical_eeprom.type == EEPROM_Physical || journal.ok || hal.eeprom.memcpy_block_to_flash) {
+
+        void (*memcpy_to_with_checksum)(uint32_t destination, uint8_t *source, uint32_t size);
+
+        if(journal.ok) {
+            journal.compacted = false;
+            memcpy_to_with_checksum = journal_write;
+        } else if(physical_eeprom.type == EEPROM_Physical)
+            memcpy_to_with_checksum = physical_eeprom.memcpy_to_with_checksum;
+        else
+            memcpy_to_with_checksum = hal.eeprom.memcpy_block_to_flash;
 
         if(settings_dirty.build_info) {
             settings_dirty.build_info = false;
-            physical_eeprom.memcpy_to_with_checksum(EEPROM_ADDR_BUILD_INFO, (uint8_t *)(noepromdata + EEPROM_ADDR_BUILD_INFO), MAX_STORED_LINE_LENGTH);
+            memcpy_to_with_checksum(EEPROM_ADDR_BUILD_INFO, (uint8_t *)(noepromdata + EEPROM_ADDR_BUILD_INFO), MAX_STORED_LINE_LENGTH);
         }
 
-        if(settings_dirty.global_settings) {
-            settings_dirty.global_settings = false;
-            physical_eeprom.memcpy_to_with_checksum(EEPROM_ADDR_GLOBAL, (uint8_t *)(noepromdata + EEPROM_ADDR_GLOBAL), sizeof(settings_t));
+        if(settings_dirty.version || settings_dirty.global_settings) {
+            // Flash storage has no byte access, the version byte is written as a part of the global settings block.
+            if(journal.ok || physical_eeprom.type != EEPROM_Physical)
+                memcpy_to_with_checksum(0, noepromdata, EEPROM_ADDR_GLOBAL + sizeof(settings_t));
+            else {
+                if(settings_dirty.version)
+                    physical_eeprom.put_byte(0, noepromdata[0]);
+                if(settings_dirty.global_settings)
+                    memcpy_to_with_checksum(EEPROM_ADDR_GLOBAL, (uint8_t *)(noepromdata + EEPROM_ADDR_GLOBAL), sizeof(settings_t));
+            }
+            settings_dirty.version = settings_dirty.global_settings = false;
         }
 
-        uint_fast8_t idx = N_STARTUP_LINE, offset;
+        uint_fast8_t idx = N_STARTUP_LINE;
+        uint32_t offset;
         if(settings_dirty.startup_lines) do {
             idx--;
             if(bit_istrue(settings_dirty.startup_lines, bit(idx))) {
                 bit_false(settings_dirty.startup_lines, bit(idx));
-                offset = EEPROM_ADDR_STARTUP_BLOCK + idx * (MAX_STORED_LINE_LENGTH + 1);
-                physical_eeprom.memcpy_to_with_checksum(offset, (uint8_t *)(noepromdata + offset), MAX_STORED_LINE_LENGTH);
+                offset = EEPROM_ADDR_STARTUP_BLOCK + idx * (MAX_STORED_LINE_LENGTH + EEPROM_CHECKSUM_SIZE);
+                memcpy_to_with_checksum(offset, (uint8_t *)(noepromdata + offset), MAX_STORED_LINE_LENGTH);
             }
         } while(idx);
 
@@ -246,31 +487,74 @@ void eeprom_emu_sync_physical ()
         if(settings_dirty.coord_data) do {
             if(bit_istrue(settings_dirty.coord_data, bit(idx))) {
                 bit_false(settings_dirty.coord_data, bit(idx));
-                offset = EEPROM_ADDR_PARAMETERS + idx * (sizeof(coord_data_t) + 1);
-                physical_eeprom.memcpy_to_with_checksum(offset, (uint8_t *)(noepromdata + offset), sizeof(coord_data_t));
+                offset = EEPROM_ADDR_PARAMETERS + idx * (sizeof(coord_data_t) + EEPROM_CHECKSUM_SIZE);
+                memcpy_to_with_checksum(offset, (uint8_t *)(noepromdata + offset), sizeof(coord_data_t));
             }
         } while(idx--);
 
         if(settings_dirty.driver_settings) {
             settings_dirty.driver_settings = false;
             if(hal.eeprom.driver_area.size > 0)
-                physical_eeprom.memcpy_to_with_checksum(hal.eeprom.driver_area.address, (uint8_t *)(noepromdata + hal.eeprom.driver_area.address), hal.eeprom.driver_area.size);
+                memcpy_to_with_checksum(hal.eeprom.driver_area.address, (uint8_t *)(noepromdata + hal.eeprom.driver_area.address), hal.eeprom.driver_area.size);
         }
 
+#ifdef ENABLE_MACROS
+        if(settings_dirty.macros) {
+            settings_dirty.macros = false;
+            memcpy_to_with_checksum(macros_storage_address(), (uint8_t *)(noepromdata + macros_storage_address()), MACRO_STORE_SIZE);
+        }
+#endif
+
+#ifdef ENABLE_JOB_STATS
+        if(settings_dirty.job_stats) {
+            settings_dirty.job_stats = false;
+            memcpy_to_with_checksum(job_stats_storage_address(), (uint8_t *)(noepromdata + job_stats_storage_address()), sizeof(job_counters_t));
+        }
+#endif
+
 #ifdef N_TOOLS
+  #ifdef ENABLE_SPARSE_TOOL_TABLE
+        idx = TOOL_TABLE_RECORDS;
+  #else
         idx = N_TOOLS;
+  #endif
         if(settings_dirty.tool_data) do {
             idx--;
             if(bit_istrue(settings_dirty.tool_data, bit(idx))) {
                 bit_false(settings_dirty.tool_data, bit(idx));
-                offset = EEPROM_ADDR_TOOL_TABLE + idx * (sizeof(tool_data_t) + 1);
-                physical_eeprom.memcpy_to_with_checksum(offset, (uint8_t *)(noepromdata + offset), sizeof(tool_data_t));
+                offset = EEPROM_ADDR_TOOL_TABLE + idx * (sizeof(tool_data_t) + EEPROM_CHECKSUM_SIZE);
+                memcpy_to_with_checksum(offset, (uint8_t *)(noepromdata + offset), sizeof(tool_data_t));
             }
         } while(idx);
 #endif
 
+        if(journal.ok)
+            journal_prepare();
+
     } else if(hal.eeprom.memcpy_to_flash)
         hal.eeprom.memcpy_to_flash(noepromdata);
 
     settings_dirty.is_dirty = false;
 }
+
+// Called when there are pending changes, these are written when the machine has been idle for SETTINGS_WRITE_DELAY ms.
+void eeprom_emu_write_behind (bool idle)
+{
+#if SETTINGS_WRITE_DELAY
+    if(hal.get_elapsed_ticks) {
+        uint32_t ms = hal.get_elapsed_ticks();
+        if(!idle)
+            idle_since = ms;
+        else if(ms - idle_since >= SETTINGS_WRITE_DELAY)
+            eeprom_emu_sync_physical();
+    } else
+#endif
+    if(idle)
+        eeprom_emu_sync_physical();
+}
+
+// Returns the age in ms of the oldest pending change, 0 if none.
+uint32_t eeprom_emu_pending (void)
+{
+    return settings_dirty.is_dirty && hal.get_elapsed_ticks ? hal.get_elapsed_ticks() - dirty_since + 1 : 0;
+}
@@ -24,6 +24,7 @@
 
 typedef struct {
     bool is_dirty;
+    bool version;
     bool global_settings;
     bool build_info;
     bool driver_settings;
@@ -32,11 +33,19 @@ typedef struct {
 #ifdef N_TOOLS
     uint16_t tool_data;
 #endif
+#ifdef ENABLE_MACROS
+    bool macros;
+#endif
+#ifdef ENABLE_JOB_STATS
+    bool job_stats;
+#endif
 } settings_dirty_t;
 
 extern settings_dirty_t settings_dirty;
 
 bool eeprom_emu_init();
 void eeprom_emu_sync_physical ();
+void eeprom_emu_write_behind (bool idle);
+uint32_t eeprom_emu_pending (void);
 
 #endif
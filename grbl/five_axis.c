@@ -0,0 +1,297 @@
+/*
+  five_axis.c - five axis tool center point kinematics implementation
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "grbl.h"
+
+#if defined(FIVE_AXIS_TABLE) || defined(FIVE_AXIS_HEAD)
+
+#include "five_axis.h"
+
+/*
+  Tool center point control for machines with an A axis rotating about X and a C axis rotating about Z.
+  The programmed X, Y and Z position is the tool tip in the workpiece frame and is kept on the programmed
+  path while A and C move, the feed rate is applied to the tool tip.
+
+  FIVE_AXIS_TABLE: the C table is carried by the A trunnion, a point p on the table is at
+                   pivot + Rx(A) * Rz(C) * (p - pivot) in machine coordinates.
+  FIVE_AXIS_HEAD:  the A head is carried by the C axis, the tool points along Rz(C) * Rx(A) * +Z and the
+                   head moves by (FIVE_AXIS_PIVOT_LENGTH + tool length offset) * (tool direction - Z).
+
+  The rotation is computed once per A, C pair and cached, consecutive transforms of a segment and of the
+  planner position then reuse it. Lines are split by kinematics_segment_line() on the deviation of the
+  tool tip from the programmed path. Rapid and jog motions are not segmented, during homing the machine
+  coordinates are used as is.
+*/
+
+typedef struct {
+    float a;
+    float c;
+#ifdef FIVE_AXIS_TABLE
+    float r[3][3];          // Rx(A) * Rz(C)
+#else
+    float tool[3];          // Tool direction minus Z
+#endif
+} rotation_t;
+
+static rotation_t rotation;
+
+#ifdef FIVE_AXIS_TABLE
+static const float pivot[3] = { FIVE_AXIS_PIVOT_X, FIVE_AXIS_PIVOT_Y, FIVE_AXIS_PIVOT_Z };
+#endif
+
+static void rotation_update (float a, float c)
+{
+    if(a == rotation.a && c == rotation.c)
+        return;
+
+    rotation.a = a;
+    rotation.c = c;
+
+    float sa = sinf(a * FIVE_AXIS_A_SIGN * RADDEG), ca = cosf(a * FIVE_AXIS_A_SIGN * RADDEG);
+    float sc = sinf(c * FIVE_AXIS_C_SIGN * RADDEG), cc = cosf(c * FIVE_AXIS_C_SIGN * RADDEG);
+
+#ifdef FIVE_AXIS_TABLE
+    rotation.r[0][0] = cc;
+    rotation.r[0][1] = -sc;
+    rotation.r[0][2] = 0.0f;
+    rotation.r[1][0] = ca * sc;
+    rotation.r[1][1] = ca * cc;
+    rotation.r[1][2] = -sa;
+    rotation.r[2][0] = sa * sc;
+    rotation.r[2][1] = sa * cc;
+    rotation.r[2][2] = ca;
+#else
+    rotation.tool[X_AXIS] = sc * sa;
+    rotation.tool[Y_AXIS] = -cc * sa;
+    rotation.tool[Z_AXIS] = ca - 1.0f;
+#endif
+}
+
+// Transform tool tip position in the workpiece frame to machine position.
+static void fa_to_machine (float *machine, float *target)
+{
+    uint_fast8_t idx;
+
+    memcpy(machine, target, sizeof(float) * N_AXIS);
+
+    if(sys.state == STATE_HOMING)
+        return;
+
+    rotation_update(target[A_AXIS], target[C_AXIS]);
+
+#ifdef FIVE_AXIS_TABLE
+    float q[3];
+
+    idx = 3;
+    do {
+        idx--;
+        q[idx] = target[idx] - gc_state.tool_length_offset[idx] - pivot[idx];
+    } while(idx);
+
+    idx = 3;
+    do {
+        idx--;
+        machine[idx] = pivot[idx] + gc_state.tool_length_offset[idx] +
+                        rotation.r[idx][0] * q[0] + rotation.r[idx][1] * q[1] + rotation.r[idx][2] * q[2];
+    } while(idx);
+#else
+    float length = FIVE_AXIS_PIVOT_LENGTH + gc_state.tool_length_offset[Z_AXIS];
+
+    idx = 3;
+    do {
+        idx--;
+        machine[idx] += length * rotation.tool[idx];
+    } while(idx);
+#endif
+}
+
+// Transform machine position to tool tip position in the workpiece frame.
+static void fa_from_machine (float *position, float *machine)
+{
+    uint_fast8_t idx;
+
+    memcpy(position, machine, sizeof(float) * N_AXIS);
+
+    if(sys.state == STATE_HOMING)
+        return;
+
+    rotation_update(machine[A_AXIS], machine[C_AXIS]);
+
+#ifdef FIVE_AXIS_TABLE
+    float q[3];
+
+    idx = 3;
+    do {
+        idx--;
+        q[idx] = machine[idx] - gc_state.tool_length_offset[idx] - pivot[idx];
+    } while(idx);
+
+    // The inverse of the rotation is its transpose.
+    idx = 3;
+    do {
+        idx--;
+        position[idx] = pivot[idx] + gc_state.tool_length_offset[idx] +
+                         rotation.r[0][idx] * q[0] + rotation.r[1][idx] * q[1] + rotation.r[2][idx] * q[2];
+    } while(idx);
+#else
+    float length = FIVE_AXIS_PIVOT_LENGTH + gc_state.tool_length_offset[Z_AXIS];
+
+    idx = 3;
+    do {
+        idx--;
+        position[idx] -= length * rotation.tool[idx];
+    } while(idx);
+#endif
+}
+
+static void fa_convert_array_steps_to_mpos (float *position, int32_t *steps)
+{
+    uint_fast8_t idx = N_AXIS;
+    float machine[N_AXIS];
+
+    do {
+        idx--;
+        machine[idx] = steps[idx] / settings.steps_per_mm[idx];
+    } while(idx);
+
+    fa_from_machine(position, machine);
+}
+
+static void fa_plan_target_to_steps (int32_t *target_steps, float *target)
+{
+    uint_fast8_t idx = N_AXIS;
+    float machine[N_AXIS];
+
+    fa_to_machine(machine, target);
+
+    do {
+        idx--;
+        target_steps[idx] = lroundf(machine[idx] * settings.steps_per_mm[idx]);
+    } while(idx);
+}
+
+// Distance of the tool tip from the programmed path at the middle of a segment moved as a single block.
+static float fa_segment_error (float *start, float *end)
+{
+    uint_fast8_t idx = N_AXIS;
+    float mid[N_AXIS], m_start[N_AXIS], m_end[N_AXIS], m_mid[N_AXIS], error = 0.0f, d;
+
+    do {
+        idx--;
+        mid[idx] = 0.5f * (start[idx] + end[idx]);
+    } while(idx);
+
+    fa_to_machine(m_start, start);
+    fa_to_machine(m_end, end);
+    fa_to_machine(m_mid, mid);
+
+    idx = 3;
+    do {
+        idx--;
+        d = m_mid[idx] - 0.5f * (m_start[idx] + m_end[idx]);
+        error += d * d;
+    } while(idx);
+
+    return sqrtf(error);
+}
+
+// Segment lines and scale the feed rate so that it applies to the tool tip.
+// The planner plans the motion of all axes, for a segment moving the tool tip the programmed rate is scaled
+// by the ratio of the total length to the tool tip travel. Motions of rotary axes only keep the rate as is.
+static bool fa_segment_line (float *target, plan_line_data_t *pl_data, bool init)
+{
+    static float start[N_AXIS], feed_rate;
+
+    bool ok = kinematics_segment_line(target, pl_data, init);
+
+    if(init) {
+        plan_get_planner_mpos(start);
+        feed_rate = pl_data->feed_rate;
+    } else if(ok) {
+
+        if(!(pl_data->condition.rapid_motion || pl_data->condition.inverse_time)) {
+
+            uint_fast8_t idx = N_AXIS;
+            float length = 0.0f, tip_length = 0.0f, d;
+
+            do {
+                idx--;
+                d = target[idx] - start[idx];
+                length += d * d;
+                if(idx <= Z_AXIS)
+                    tip_length += d * d;
+            } while(idx);
+
+            pl_data->feed_rate = tip_length > 0.0f ? feed_rate * sqrtf(length / tip_length) : feed_rate;
+        }
+
+        memcpy(start, target, sizeof(start));
+    }
+
+    return ok;
+}
+
+static uint_fast8_t fa_limits_get_axis_mask (uint_fast8_t idx)
+{
+    return bit(idx);
+}
+
+static void fa_limits_set_target_pos (uint_fast8_t idx)
+{
+    sys_position[idx] = 0;
+}
+
+// Set machine positions for homed limit switches. Don't update non-homed axes.
+// NOTE: settings.max_travel[] is stored as a negative value.
+static void fa_limits_set_machine_positions (axes_signals_t cycle)
+{
+    uint_fast8_t idx = N_AXIS;
+
+    if(settings.homing.flags.force_set_origin) {
+        do {
+            if (cycle.mask & bit(--idx))
+                sys_position[idx] = 0;
+        } while(idx);
+    } else do {
+        if (cycle.mask & bit(--idx))
+            sys_position[idx] = bit_istrue(settings.homing.dir_mask.value, bit(idx))
+                                 ? lroundf((settings.max_travel[idx] + settings.homing.pulloff) * settings.steps_per_mm[idx])
+                                 : lroundf(-settings.homing.pulloff * settings.steps_per_mm[idx]);
+    } while(idx);
+}
+
+// Initialize API pointers for five axis kinematics
+void five_axis_init (void)
+{
+    rotation.a = rotation.c = 1.0f;
+    rotation_update(0.0f, 0.0f);
+
+    kinematics.limits_set_target_pos = fa_limits_set_target_pos;
+    kinematics.limits_get_axis_mask = fa_limits_get_axis_mask;
+    kinematics.limits_set_machine_positions = fa_limits_set_machine_positions;
+    kinematics.plan_target_to_steps = fa_plan_target_to_steps;
+    kinematics.convert_array_steps_to_mpos = fa_convert_array_steps_to_mpos;
+    kinematics.segment_line = fa_segment_line;
+    kinematics.segment_error = fa_segment_error;
+}
+
+#endif
@@ -0,0 +1,53 @@
+/*
+  five_axis.h - five axis tool center point kinematics implementation
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _five_axis_h_
+#define _five_axis_h_
+
+// Machine geometry, all in machine coordinates (mm) at A = C = 0.
+
+// Tilting table: the point where the A axis (parallel to X) and the C axis (parallel to Z) intersect.
+#ifndef FIVE_AXIS_PIVOT_X
+#define FIVE_AXIS_PIVOT_X 0.0f
+#endif
+#ifndef FIVE_AXIS_PIVOT_Y
+#define FIVE_AXIS_PIVOT_Y 0.0f
+#endif
+#ifndef FIVE_AXIS_PIVOT_Z
+#define FIVE_AXIS_PIVOT_Z 0.0f
+#endif
+
+// Tilting head: distance along Z from the spindle gauge line to the point where the A and C axes intersect.
+#ifndef FIVE_AXIS_PIVOT_LENGTH
+#define FIVE_AXIS_PIVOT_LENGTH 0.0f
+#endif
+
+// Rotation direction of the A and C axes, 1.0f for right hand rotation of the table or head about +X and +Z.
+#ifndef FIVE_AXIS_A_SIGN
+#define FIVE_AXIS_A_SIGN 1.0f
+#endif
+#ifndef FIVE_AXIS_C_SIGN
+#define FIVE_AXIS_C_SIGN 1.0f
+#endif
+
+// Initialize API pointers for five axis kinematics
+void five_axis_init (void);
+
+#endif
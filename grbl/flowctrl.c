@@ -0,0 +1,551 @@
+/*
+  flowctrl.c - O-word subroutines and loops executed from a controller-side program cache
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "grbl.h"
+
+#ifdef ENABLE_O_WORDS
+
+/*
+  LinuxCNC style numbered subroutines, loops and conditionals:
+
+    o<n> sub ... o<n> endsub    defines subroutine n, o<n> return ends it early
+    o<n> call                   executes subroutine n
+    o<n> repeat [<count>] ...  o<n> endrepeat   executes the body count times
+    o<n> while [<cond>] ... o<n> endwhile       executes the body while cond is not 0
+    o<n> do ... o<n> while [<cond>]             executes the body once, then while cond is not 0
+    o<n> if [<cond>] ... o<n> elseif [<cond>] ... o<n> else ... o<n> endif
+    o<n> break, o<n> continue   ends loop n, or its current iteration, from within its body
+
+  Lines between sub and endsub are stored in the cache as received from the line builder, uppercased and
+  without whitespace and comments, and are responded to with ok without being executed. A top level loop
+  or conditional is recorded the same way, including its first and last line, and is then executed and
+  discarded. Calls, loops and conditionals in cached lines are executed from the cache, nested up to
+  FLOWCTRL_MAX_DEPTH. A single response is sent for a call, loop or conditional, after the last line
+  executed, it is the status of the first line that failed if any.
+
+  Counts and conditions must be numbers unless ENABLE_NGC_EXPRESSIONS is enabled, they are then expressions
+  evaluated each time they are reached. Subroutine arguments are not supported and responded to with an
+  unsupported command error. Subroutines are cleared on program end (M2, M30) and on soft reset, a
+  redefinition replaces the previous definition.
+*/
+
+typedef enum {
+    OWord_None = 0,
+    OWord_Sub,
+    OWord_EndSub,
+    OWord_Return,
+    OWord_Call,
+    OWord_Repeat,
+    OWord_EndRepeat,
+    OWord_While,
+    OWord_EndWhile,
+    OWord_Do,
+    OWord_If,
+    OWord_ElseIf,
+    OWord_Else,
+    OWord_EndIf,
+    OWord_Break,
+    OWord_Continue
+} oword_t;
+
+typedef struct {
+    const char *name;
+    oword_t op;
+} keyword_t;
+
+typedef struct {
+    uint32_t id;
+    uint_fast16_t start;        // Offset of the first line of the body
+    uint_fast16_t end;          // Offset past the last line of the body
+} sub_t;
+
+static const keyword_t keywords[] = {
+    { "SUB",       OWord_Sub },
+    { "ENDSUB",    OWord_EndSub },
+    { "RETURN",    OWord_Return },
+    { "CALL",      OWord_Call },
+    { "REPEAT",    OWord_Repeat },
+    { "ENDREPEAT", OWord_EndRepeat },
+    { "WHILE",     OWord_While },
+    { "ENDWHILE",  OWord_EndWhile },
+    { "DO",        OWord_Do },
+    { "IF",        OWord_If },
+    { "ELSEIF",    OWord_ElseIf },
+    { "ELSE",      OWord_Else },
+    { "ENDIF",     OWord_EndIf },
+    { "BREAK",     OWord_Break },
+    { "CONTINUE",  OWord_Continue }
+};
+
+static struct {
+    char text[FLOWCTRL_CACHE_SIZE];
+    uint_fast16_t used;         // Bytes used by subroutine bodies
+    uint_fast8_t n_subs;
+    sub_t sub[FLOWCTRL_MAX_SUBS];
+    uint_fast8_t executing;     // Nesting of cached lines executing
+    oword_t unwind;             // Set by return, break or continue, unwinds to the call or loop
+    uint32_t unwind_id;         // Loop to unwind to on break or continue
+    bool clear_pending;         // Program end while executing cached lines
+    struct {
+        bool active;
+        oword_t op;             // OWord_Sub, OWord_Repeat, OWord_While, OWord_Do or OWord_If
+        uint32_t id;
+        uint_fast16_t end;      // Offset past the last line recorded
+        status_code_t status;   // Error to respond with until the body ends
+    } rec;
+} cache = {0};
+
+// Parses an O-word line, arg is set to the bracketed count or condition if any, else NULL.
+static status_code_t parse (char *line, oword_t *op, uint32_t *id, char **arg)
+{
+    uint_fast8_t idx = 0, char_counter = 1, len;
+
+    if(line[char_counter] < '0' || line[char_counter] > '9')
+        return Status_FlowControlSyntaxError;
+
+    *id = 0;
+    while(line[char_counter] >= '0' && line[char_counter] <= '9')
+        *id = *id * 10 + (line[char_counter++] - '0');
+
+    line += char_counter;
+
+    do {
+        len = strlen(keywords[idx].name);
+        if(!strncmp(line, keywords[idx].name, len) && (line[len] == '\0' || line[len] == '[')) {
+            *op = keywords[idx].op;
+            break;
+        }
+    } while(++idx < sizeof(keywords) / sizeof(keyword_t));
+
+    if(idx == sizeof(keywords) / sizeof(keyword_t))
+        return Status_FlowControlSyntaxError;
+
+    if(*op == OWord_Call && line[len] == '[')
+        return Status_GcodeUnsupportedCommand;
+
+    *arg = line[len] == '[' ? &line[len] : NULL;
+
+    // The while closing a do loop takes a condition as well.
+    if((*arg == NULL) == (*op == OWord_Repeat || *op == OWord_While || *op == OWord_If || *op == OWord_ElseIf))
+        return Status_FlowControlSyntaxError;
+
+    return Status_OK;
+}
+
+// Evaluates the bracketed count or condition of an O-word line.
+static status_code_t read_arg (char *arg, float *value)
+{
+#ifdef ENABLE_NGC_EXPRESSIONS
+    status_code_t status;
+    uint_fast8_t char_counter = 0;
+
+    if((status = ngc_read_real_value(arg, &char_counter, value)) != Status_OK)
+        return status;
+    if(arg[char_counter] != '\0')
+        return Status_FlowControlSyntaxError;
+#else
+    uint_fast8_t char_counter = 1;
+
+    if(!read_float(arg, &char_counter, value) || arg[char_counter] != ']' || arg[char_counter + 1] != '\0')
+        return Status_FlowControlSyntaxError;
+#endif
+
+    return Status_OK;
+}
+
+static sub_t *find_sub (uint32_t id)
+{
+    uint_fast8_t idx = cache.n_subs;
+
+    while(idx) {
+        if(cache.sub[--idx].id == id)
+            return &cache.sub[idx];
+    }
+
+    return NULL;
+}
+
+// Removes a subroutine and its body, the bodies following it are moved down.
+static void delete_sub (sub_t *sub)
+{
+    uint_fast8_t idx = cache.n_subs;
+    uint_fast16_t size = sub->end - sub->start;
+
+    memmove(&cache.text[sub->start], &cache.text[sub->end], cache.used - sub->end);
+    cache.used -= size;
+
+    while(idx--) {
+        if(cache.sub[idx].start > sub->start) {
+            cache.sub[idx].start -= size;
+            cache.sub[idx].end -= size;
+        }
+    }
+
+    *sub = cache.sub[--cache.n_subs];
+}
+
+static void clear_cache (void)
+{
+    cache.used = 0;
+    cache.n_subs = 0;
+    cache.clear_pending = false;
+}
+
+// Finds the next line for id with one of the operations in the ops mask, pos is the offset to start from and
+// is set to the offset after the line found, offset to the offset of the line found.
+static bool find_oword (uint_fast16_t *pos, uint_fast16_t end, uint32_t id, uint32_t ops, oword_t *op, uint_fast16_t *offset, char **arg)
+{
+    char *line;
+    uint32_t line_id;
+
+    while(*pos < end) {
+        line = &cache.text[*offset = *pos];
+        *pos += strlen(line) + 1;
+        if(*line == 'O' && parse(line, op, &line_id, arg) == Status_OK && line_id == id && (ops & bit(*op)))
+            return true;
+    }
+
+    return false;
+}
+
+// Returns the operation ending the body started by op.
+static oword_t end_op (oword_t op)
+{
+    switch(op) {
+        case OWord_Sub:
+            return OWord_EndSub;
+        case OWord_Repeat:
+            return OWord_EndRepeat;
+        case OWord_While:
+            return OWord_EndWhile;
+        case OWord_Do:
+            return OWord_While;
+        default:
+            return OWord_EndIf;
+    }
+}
+
+static status_code_t execute_range (uint_fast16_t pos, uint_fast16_t end, uint_fast8_t depth);
+
+// Executes the body of loop id from start up to end, arg is the count of a repeat loop or the condition of a while or do loop.
+static status_code_t execute_loop (oword_t op, uint32_t id, char *arg, uint_fast16_t start, uint_fast16_t end, uint_fast8_t depth)
+{
+    bool done = false;
+    float value;
+    uint32_t count = 0;
+    status_code_t status = Status_OK;
+
+    if(depth >= FLOWCTRL_MAX_DEPTH)
+        return Status_FlowControlStackOverflow;
+
+    if(op == OWord_Repeat) {
+        if((status = read_arg(arg, &value)) != Status_OK)
+            return status;
+        if(value < 0.0f || value != truncf(value))
+            return Status_FlowControlSyntaxError;
+        count = (uint32_t)value;
+    }
+
+    while(!done && status == Status_OK && !sys.abort) {
+
+        if(op == OWord_Repeat)
+            done = count-- == 0;
+        else if(op == OWord_While && (status = read_arg(arg, &value)) == Status_OK)
+            done = value == 0.0f;
+
+        if(done || status != Status_OK)
+            break;
+
+        status = execute_range(start, end, depth + 1);
+
+        if(cache.unwind != OWord_None) {
+            if(cache.unwind == OWord_Return || cache.unwind_id != id)
+                break; // Unwinds to an outer loop or the call.
+            done = cache.unwind == OWord_Break;
+            cache.unwind = OWord_None;
+        }
+
+        if(!done && op == OWord_Do && status == Status_OK && (status = read_arg(arg, &value)) == Status_OK)
+            done = value == 0.0f;
+    }
+
+    return status;
+}
+
+// Executes the branch of conditional id selected by its conditions, pos is the offset after the if line and
+// is set to the offset after the matching endif.
+static status_code_t execute_if (uint32_t id, char *arg, uint_fast16_t *pos, uint_fast16_t end, uint_fast8_t depth)
+{
+    bool taken = false;
+    float value = 0.0f;
+    oword_t op = OWord_If;
+    uint_fast16_t branch, branch_end;
+    status_code_t status = Status_OK;
+
+    if(depth >= FLOWCTRL_MAX_DEPTH)
+        return Status_FlowControlStackOverflow;
+
+    do {
+        // Conditions are evaluated until a branch is taken, else is taken if none was.
+        if(op == OWord_Else)
+            value = 1.0f;
+        else if(!taken && (status = read_arg(arg, &value)) != Status_OK)
+            return status;
+
+        branch = *pos;
+        if(!find_oword(pos, end, id, op == OWord_Else ? bit(OWord_EndIf) : bit(OWord_ElseIf)|bit(OWord_Else)|bit(OWord_EndIf), &op, &branch_end, &arg))
+            return Status_FlowControlSyntaxError;
+
+        if(!taken && value != 0.0f) {
+            taken = true;
+            if((status = execute_range(branch, branch_end, depth + 1)) != Status_OK || cache.unwind != OWord_None)
+                return status;
+        }
+    } while(op != OWord_EndIf);
+
+    return status;
+}
+
+static status_code_t execute_call (uint32_t id, uint_fast8_t depth)
+{
+    status_code_t status;
+    sub_t *sub;
+
+    if((sub = find_sub(id)) == NULL)
+        return Status_FlowControlSyntaxError;
+
+    if(depth >= FLOWCTRL_MAX_DEPTH)
+        return Status_FlowControlStackOverflow;
+
+    status = execute_range(sub->start, sub->end, depth + 1);
+
+    // A break or continue without an enclosing loop in the subroutine is an error.
+    if(cache.unwind != OWord_None && cache.unwind != OWord_Return && status == Status_OK)
+        status = Status_FlowControlSyntaxError;
+    cache.unwind = OWord_None;
+
+    return status;
+}
+
+// Executes the cached lines from pos up to end, depth is the number of calls, loops and conditionals the lines are nested in.
+static status_code_t execute_range (uint_fast16_t pos, uint_fast16_t end, uint_fast8_t depth)
+{
+    char *line, *arg, *closing_arg;
+    oword_t op, closing;
+    uint32_t id;
+    uint_fast16_t body, body_end;
+    status_code_t status = Status_OK;
+
+    while(pos < end && status == Status_OK && cache.unwind == OWord_None) {
+
+        line = &cache.text[pos];
+        pos += strlen(line) + 1;
+
+        if(*line == 'O') {
+            if((status = parse(line, &op, &id, &arg)) == Status_OK) switch(op) {
+
+                case OWord_Call:
+                    status = execute_call(id, depth);
+                    break;
+
+                case OWord_Repeat:
+                case OWord_While:
+                case OWord_Do:
+                    body = pos;
+                    if(find_oword(&pos, end, id, bit(end_op(op)), &closing, &body_end, &closing_arg))
+                        status = execute_loop(op, id, op == OWord_Do ? closing_arg : arg, body, body_end, depth);
+                    else
+                        status = Status_FlowControlSyntaxError;
+                    break;
+
+                case OWord_If:
+                    status = execute_if(id, arg, &pos, end, depth);
+                    break;
+
+                case OWord_Return:
+                case OWord_Break:
+                case OWord_Continue:
+                    cache.unwind = op;
+                    cache.unwind_id = id;
+                    break;
+
+                default:
+                    status = Status_FlowControlSyntaxError;
+                    break;
+            }
+        } else
+            status = gc_execute_block(line, NULL);
+
+        if(!protocol_execute_realtime()) // Bail upon system abort.
+            break;
+    }
+
+    return status;
+}
+
+// Executes a top level call, or a recorded loop or conditional which is discarded after execution.
+static status_code_t execute (oword_t op, uint32_t id, uint_fast16_t end)
+{
+    status_code_t status;
+
+    cache.executing++;
+
+    if(op == OWord_Call)
+        status = execute_call(id, 0);
+    else {
+        status = execute_range(cache.used, end, 0);
+        // A return, break or continue outside of a subroutine or its loop is an error.
+        if(cache.unwind != OWord_None && status == Status_OK)
+            status = Status_FlowControlSyntaxError;
+    }
+
+    cache.unwind = OWord_None;
+
+    if(--cache.executing == 0 && cache.clear_pending)
+        clear_cache();
+
+    return status;
+}
+
+static status_code_t append_line (char *line)
+{
+    uint_fast16_t len = strlen(line) + 1;
+
+    if(cache.rec.end + len > FLOWCTRL_CACHE_SIZE)
+        return Status_FlowControlOutOfMemory;
+
+    memcpy(&cache.text[cache.rec.end], line, len);
+    cache.rec.end += len;
+
+    return Status_OK;
+}
+
+static status_code_t record_line (char *line)
+{
+    char *arg;
+    oword_t op;
+    uint32_t id;
+    status_code_t status = Status_OK;
+
+    if(*line == 'O') {
+        if((status = parse(line, &op, &id, &arg)) == Status_OK && id == cache.rec.id && op == end_op(cache.rec.op)) {
+
+            if(cache.rec.op != OWord_Sub && cache.rec.status == Status_OK)
+                cache.rec.status = append_line(line);
+
+            cache.rec.active = false;
+
+            if((status = cache.rec.status) != Status_OK)
+                return status;
+
+            if(cache.rec.op != OWord_Sub)
+                return execute(cache.rec.op, id, cache.rec.end);
+
+            cache.sub[cache.n_subs].id = id;
+            cache.sub[cache.n_subs].start = cache.used;
+            cache.sub[cache.n_subs++].end = cache.used = cache.rec.end;
+
+            return Status_OK;
+        }
+        if(status == Status_OK && op == OWord_Sub)
+            status = Status_FlowControlSyntaxError; // Nested definitions are not allowed.
+    }
+
+    if(status == Status_OK && cache.rec.status == Status_OK)
+        status = append_line(line);
+
+    // Keep recording after an error so that the remaining lines of the body are not executed.
+    if(cache.rec.status == Status_OK)
+        cache.rec.status = status;
+
+    return cache.rec.status;
+}
+
+bool flowctrl_recording (void)
+{
+    return cache.rec.active;
+}
+
+status_code_t flowctrl_execute_line (char *line)
+{
+    char *arg;
+    oword_t op;
+    uint32_t id;
+    sub_t *sub;
+    status_code_t status;
+
+    if(cache.rec.active)
+        return record_line(line);
+
+    if((status = parse(line, &op, &id, &arg)) != Status_OK)
+        return status;
+
+    switch(op) {
+
+        case OWord_Sub:
+            if((sub = find_sub(id)))
+                delete_sub(sub);
+            if(cache.n_subs == FLOWCTRL_MAX_SUBS)
+                return Status_FlowControlOutOfMemory;
+            // no break
+
+        case OWord_Repeat:
+        case OWord_While:
+        case OWord_Do:
+        case OWord_If:
+            cache.rec.active = true;
+            cache.rec.op = op;
+            cache.rec.id = id;
+            cache.rec.end = cache.used;
+            // Loops and conditionals are recorded from their first line, the body of a subroutine only.
+            cache.rec.status = op == OWord_Sub ? Status_OK : append_line(line);
+            break;
+
+        case OWord_Call:
+            status = execute(OWord_Call, id, 0);
+            break;
+
+        default:
+            status = Status_FlowControlSyntaxError;
+            break;
+    }
+
+    return status;
+}
+
+void flowctrl_program_end (void)
+{
+    if(cache.executing)
+        cache.clear_pending = true;
+    else
+        clear_cache();
+}
+
+void flowctrl_reset (void)
+{
+    clear_cache();
+    cache.executing = 0;
+    cache.unwind = OWord_None;
+    cache.rec.active = false;
+}
+
+#endif
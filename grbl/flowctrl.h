@@ -0,0 +1,59 @@
+/*
+  flowctrl.h - O-word subroutines and loops executed from a controller-side program cache
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _FLOWCTRL_H_
+#define _FLOWCTRL_H_
+
+#ifdef ENABLE_O_WORDS
+
+// Size of the RAM cache holding subroutine and loop bodies, in bytes.
+#ifndef FLOWCTRL_CACHE_SIZE
+  #ifdef SMALL_RAM_TARGET
+    #define FLOWCTRL_CACHE_SIZE 1024
+  #else
+    #define FLOWCTRL_CACHE_SIZE 4096
+  #endif
+#endif
+
+// Maximum number of subroutines defined at a time.
+#ifndef FLOWCTRL_MAX_SUBS
+  #define FLOWCTRL_MAX_SUBS 16
+#endif
+
+// Maximum nesting of subroutine calls, loops and conditionals.
+#ifndef FLOWCTRL_MAX_DEPTH
+  #define FLOWCTRL_MAX_DEPTH 8
+#endif
+
+// Returns true while a subroutine or loop body is being recorded.
+bool flowctrl_recording (void);
+
+// Handles a line starting with an O-word, or any line received while recording a body.
+status_code_t flowctrl_execute_line (char *line);
+
+// Clears the program cache upon program end (M2, M30), deferred until no cached lines are executing.
+void flowctrl_program_end (void);
+
+// Clears the program cache and aborts recording, called on soft reset.
+void flowctrl_reset (void);
+
+#endif
+
+#endif
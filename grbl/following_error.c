@@ -0,0 +1,137 @@
+/*
+  following_error.c - following error monitoring of closed loop steppers and servos from axis encoders
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "grbl.h"
+
+#ifdef ENABLE_FOLLOWING_ERROR
+
+/*
+  The driver returns the encoder positions scaled to steps. The offset between the encoder and the commanded
+  position is taken when motion starts after the commanded position has been set, by homing or on reset, and is
+  kept across cycles so that position lost in a cycle is still detected in the next. The error is checked each
+  time a step segment is loaded, the segment period is a few ms at most and a servo lagging the commanded
+  position by its normal following error during acceleration should be allowed for by the limit.
+
+  Monitoring is suspended while homing as the steps are stopped abruptly when switches trigger.
+*/
+
+static struct {
+    bool synced;                    // offset is valid
+    volatile bool active;           // checked on segment load
+    bool tripped;                   // limit exceeded in this cycle
+    int32_t limit[N_AXIS];          // steps
+    int32_t offset[N_AXIS];         // encoder position - commanded position when synced
+    int32_t idle_position[N_AXIS];  // commanded position when the steppers went idle
+    volatile uint32_t max[N_AXIS];  // max. absolute following error since cleared, steps
+} ferr = {0};
+
+void following_error_start (void)
+{
+    uint_fast8_t idx;
+    int32_t position[N_AXIS];
+
+    ferr.active = false;
+
+    if(hal.axis_encoder.get_position == NULL || sys.state == STATE_HOMING)
+        return;
+
+    if(!ferr.synced || memcmp(ferr.idle_position, sys_position, sizeof(sys_position))) {
+        if(!hal.axis_encoder.get_position(&position))
+            return;
+        for(idx = 0; idx < N_AXIS; idx++) {
+            ferr.offset[idx] = position[idx] - sys_position[idx];
+            ferr.limit[idx] = (int32_t)(FOLLOWING_ERROR_LIMIT * settings.steps_per_mm[idx]);
+        }
+        ferr.synced = true;
+    }
+
+    ferr.tripped = false;
+    ferr.active = true;
+}
+
+ISR_CODE void following_error_check (void)
+{
+    if(!ferr.active || ferr.tripped)
+        return;
+
+    uint_fast8_t idx = N_AXIS;
+    int32_t position[N_AXIS];
+    uint32_t error;
+
+    if(!hal.axis_encoder.get_position(&position))
+        return;
+
+    do {
+        idx--;
+        if(hal.axis_encoder.axes.value & bit(idx)) {
+            error = (uint32_t)labs(position[idx] - ferr.offset[idx] - sys_position[idx]);
+            if(error > ferr.max[idx])
+                ferr.max[idx] = error;
+            if(error > (uint32_t)ferr.limit[idx])
+                ferr.tripped = true;
+        }
+    } while(idx);
+
+    if(ferr.tripped) {
+#if FOLLOWING_ERROR_ALARM
+        mc_reset();
+        system_set_exec_alarm(Alarm_FollowingError);
+#else
+        system_set_exec_state_flag(EXEC_FEED_HOLD);
+#endif
+    }
+}
+
+ISR_CODE void following_error_stop (void)
+{
+    ferr.active = false;
+    memcpy(ferr.idle_position, sys_position, sizeof(sys_position));
+}
+
+void following_error_reset (void)
+{
+    ferr.active = ferr.synced = false;
+}
+
+status_code_t following_error_command (char *args)
+{
+    uint_fast8_t idx;
+    status_code_t retval = Status_OK;
+
+    if(*args == '\0') {
+        hal.stream.write("[FERR:");
+        for(idx = 0; idx < N_AXIS; idx++) {
+            if(idx)
+                hal.stream.write(",");
+            hal.stream.write(ftoa((float)ferr.max[idx] / settings.steps_per_mm[idx], N_DECIMAL_COORDVALUE_MM));
+        }
+        hal.stream.write("]" ASCII_EOL);
+    } else if(!strcmp(args, "=0"))
+        memset((void *)ferr.max, 0, sizeof(ferr.max));
+    else
+        retval = Status_InvalidStatement;
+
+    return retval;
+}
+
+#endif
@@ -0,0 +1,50 @@
+/*
+  following_error.h - following error monitoring of closed loop steppers and servos from axis encoders
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _FOLLOWING_ERROR_H_
+#define _FOLLOWING_ERROR_H_
+
+#ifdef ENABLE_FOLLOWING_ERROR
+
+#ifndef FOLLOWING_ERROR_LIMIT
+#define FOLLOWING_ERROR_LIMIT 0.1f // mm
+#endif
+#ifndef FOLLOWING_ERROR_ALARM
+#define FOLLOWING_ERROR_ALARM 0 // 0 - feed hold, 1 - abort and alarm 15
+#endif
+
+// Called from st_wake_up(), syncs the encoders to the commanded position if it has been set since the steppers went idle.
+void following_error_start (void);
+
+// Compares the encoder positions with the commanded position, called from the stepper ISR when a segment is loaded.
+void following_error_check (void);
+
+// Records the commanded position when the steppers go idle, called from st_go_idle().
+void following_error_stop (void);
+
+// Syncs the encoders to the commanded position on the next start, called on reset.
+void following_error_reset (void);
+
+// Handles $FERR and $FERR=0, reports or clears the max. following error per axis.
+status_code_t following_error_command (char *args);
+
+#endif
+
+#endif
@@ -27,9 +27,12 @@
 // value when converting a float (7.2 digit precision)s to an integer.
 #define MAX_LINE_NUMBER 10000000
 #ifdef N_TOOLS
-#define MAX_TOOL_NUMBER N_TOOLS // Limited by max unsigned 8-bit value
+#define MAX_TOOL_NUMBER N_TOOLS // Limited by max unsigned 8-bit value unless the sparse tool table is enabled
+#if N_TOOLS > 255 && !defined(ENABLE_SPARSE_TOOL_TABLE)
+#error N_TOOLS is limited to 255, enable ENABLE_SPARSE_TOOL_TABLE for more tools!
+#endif
 #else
-#define MAX_TOOL_NUMBER 255 // Limited by max unsigned 8-bit value
+#define MAX_TOOL_NUMBER 65535 // Limited by max unsigned 16-bit value, tool_id_t
 #endif
 
 #define MACH3_SCALING
@@ -49,7 +52,7 @@ typedef enum {
 
 // Declare gc extern struct
 parser_state_t gc_state;
-#ifdef N_TOOLS
+#if defined(N_TOOLS) && !defined(ENABLE_SPARSE_TOOL_TABLE)
 tool_data_t tool_table[N_TOOLS + 1];
 #else
 tool_data_t tool_table;
@@ -57,9 +60,62 @@ tool_data_t tool_table;
 
 #define FAIL(status) return(status);
 
+// Value word import, letters that are not listed are either command words or not supported.
+typedef enum {
+    ValueWord_Unsupported = 0,
+    ValueWord_Float,        // Stored as is
+    ValueWord_Axis,         // Stored as is, flagged in axis_words
+    ValueWord_IJK,          // Stored as is, flagged in ijk_words
+    ValueWord_Integer,      // Must be an integer, stored as uint8_t
+    ValueWord_Tool,         // Must be an integer, stored as tool_id_t
+    ValueWord_LineNumber    // Truncated, stored as int32_t
+} value_word_type_t;
+
+typedef struct {
+    uint8_t type;           // value_word_type_t
+    uint8_t parameter;      // parameter_word_t
+    uint8_t offset;         // Offset of storage in gc_values_t
+    uint8_t idx;            // Axis or IJK index
+    bool non_negative;      // Value cannot be negative
+} value_word_t;
+
+#define VALUE_WORD(type, word, field, idx, non_negative) { ValueWord_ ## type, Word_ ## word, offsetof(gc_values_t, field), idx, non_negative }
+
+static const value_word_t value_words_table[] = {
+#ifdef A_AXIS
+    ['A' - 'A'] = VALUE_WORD(Axis, A, xyz[A_AXIS], A_AXIS, false),
+#endif
+#ifdef B_AXIS
+    ['B' - 'A'] = VALUE_WORD(Axis, B, xyz[B_AXIS], B_AXIS, false),
+#endif
+#ifdef C_AXIS
+    ['C' - 'A'] = VALUE_WORD(Axis, C, xyz[C_AXIS], C_AXIS, false),
+#endif
+    ['D' - 'A'] = VALUE_WORD(Float, D, d, 0, true),
+    ['E' - 'A'] = VALUE_WORD(Float, E, e, 0, false),
+    ['F' - 'A'] = VALUE_WORD(Float, F, f, 0, true),
+    ['H' - 'A'] = VALUE_WORD(Tool, H, h, 0, true),
+    ['I' - 'A'] = VALUE_WORD(IJK, I, ijk[I_VALUE], I_VALUE, false),
+    ['J' - 'A'] = VALUE_WORD(IJK, J, ijk[J_VALUE], J_VALUE, false),
+    ['K' - 'A'] = VALUE_WORD(IJK, K, ijk[K_VALUE], K_VALUE, false),
+    ['L' - 'A'] = VALUE_WORD(Integer, L, l, 0, false),
+    ['N' - 'A'] = VALUE_WORD(LineNumber, N, n, 0, true),
+    ['P' - 'A'] = VALUE_WORD(Float, P, p, 0, false), // NOTE: For certain commands, P value must be an integer, but none of these commands are supported.
+    ['Q' - 'A'] = VALUE_WORD(Float, Q, q, 0, false), // may be used for user defined mcodes or G61,G76
+    ['R' - 'A'] = VALUE_WORD(Float, R, r, 0, false),
+    ['S' - 'A'] = VALUE_WORD(Float, S, s, 0, true),
+    ['T' - 'A'] = VALUE_WORD(Tool, T, t, 0, true),
+    ['X' - 'A'] = VALUE_WORD(Axis, X, xyz[X_AXIS], X_AXIS, false),
+    ['Y' - 'A'] = VALUE_WORD(Axis, Y, xyz[Y_AXIS], Y_AXIS, false),
+    ['Z' - 'A'] = VALUE_WORD(Axis, Z, xyz[Z_AXIS], Z_AXIS, false)
+};
+
 static scale_factor_t scale_factor;
 static gc_thread_data thread;
 static output_command_t *output_commands = NULL; // Linked list
+#ifdef ENABLE_COOLANT_QUEUE
+static bool coolant_pending = false; // Standalone coolant change waiting for the next motion
+#endif
 
 // Simple hypotenuse computation function.
 inline static float hypot_f (float x, float y)
@@ -110,11 +166,61 @@ float gc_get_offset (uint_fast8_t idx)
     return gc_state.modal.coord_system.xyz[idx] + gc_state.g92_coord_offset[idx] + gc_state.tool_length_offset[idx];
 }
 
+// Constant Surface Speed RPM at tool axis position relative to the tool offset, limited by the G96 D max RPM.
+float gc_get_css_rpm (css_data_t *css, float position)
+{
+    return position <= 0.0f ? css->max_rpm : min(css->max_rpm, css->surface_speed / (position * (float)(2.0f * M_PI)));
+}
+
+#ifdef ENABLE_HEIGHT_MAP
+
+// The machine position includes the height map Z offset, the parser position does not.
+void gc_sync_position (void)
+{
+    system_convert_array_steps_to_mpos(gc_state.position, sys_position);
+
+    if(height_map_active())
+        gc_state.position[Z_AXIS] -= height_map_offset(gc_state.position);
+}
+
+#endif
+
 inline static float gc_get_block_offset (parser_block_t *gc_block, uint_fast8_t idx)
 {
     return gc_block->modal.coord_system.xyz[idx] + gc_state.g92_coord_offset[idx] + gc_state.tool_length_offset[idx];
 }
 
+#ifdef ENABLE_ROTARY_WRAP
+
+// Returns the start of the revolution the parser position of a wrapping rotary axis is in, 0 for other axes.
+// Absolute positions and offsets of wrapping axes are relative to it so that the result of a block does
+// not depend on whether the main loop has folded the position into a single revolution yet or not.
+inline static float rotary_base (uint_fast8_t idx)
+{
+    return bit_istrue(settings.rotary_wrap.mask, bit(idx)) ? floorf(gc_state.position[idx] / 360.0f) * 360.0f : 0.0f;
+}
+
+#else
+#define rotary_base(idx) 0.0f
+#endif
+
+#ifdef N_TOOLS
+
+// Returns the tool table entry for a tool, the entry is read from persistent storage on first use.
+tool_data_t *gc_get_tool_data (tool_id_t tool)
+{
+#ifdef ENABLE_SPARSE_TOOL_TABLE
+    return tool_table_get(tool);
+#else
+    if(tool && tool_table[tool].tool != tool)
+        settings_read_tool_data(tool, &tool_table[tool]);
+
+    return &tool_table[tool];
+#endif
+}
+
+#endif
+
 void gc_init(bool cold_start)
 {
 
@@ -124,7 +230,7 @@ void gc_init(bool cold_start)
 
     if(cold_start) {
         memset(&gc_state, 0, sizeof(parser_state_t));
-      #ifdef N_TOOLS
+      #if defined(N_TOOLS) && !defined(ENABLE_SPARSE_TOOL_TABLE)
         gc_state.tool = &tool_table[0];
       #else
         memset(&tool_table, 0, sizeof(tool_table));
@@ -137,11 +243,11 @@ void gc_init(bool cold_start)
     }
 
     // Clear any pending output commands
-    while(output_commands) {
-        output_command_t *next = output_commands->next;
-        free(output_commands);
-        output_commands = next;
-    }
+    pool_output_commands_release(output_commands);
+    output_commands = NULL;
+#ifdef ENABLE_COOLANT_QUEUE
+    coolant_pending = false;
+#endif
 
     // Load default override status
     gc_state.modal.override_ctrl = sys.override.control;
@@ -170,26 +276,48 @@ void gc_set_laser_ppimode (bool on)
     gc_state.is_laser_ppi_mode = on;
 }
 
-// Add output command to linked list
-static bool add_output_command (output_command_t *command)
+#ifdef ENABLE_COOLANT_QUEUE
+// Set a standalone coolant change held for the next motion, called on cycle completion when none followed.
+void gc_coolant_flush (void)
+{
+    if(coolant_pending) {
+        coolant_pending = false;
+        coolant_set_state(gc_state.modal.coolant);
+    }
+}
+#endif
+
+// Add output command to linked list.
+// If the pool is exhausted wait for an output command queued with motion to be executed, as for a full planner buffer.
+// Returns Status_Overflow if all entries are held by commands waiting for the next motion.
+static status_code_t add_output_command (output_command_t *command)
 {
-    output_command_t *add_cmd;
+    uint_fast16_t pending = 0;
+    output_command_t *add_cmd, *cmd = output_commands;
 
-    if((add_cmd = malloc(sizeof(output_command_t)))) {
+    while(cmd) {
+        pending++;
+        cmd = cmd->next;
+    }
 
-        memcpy(add_cmd, command, sizeof(output_command_t));
+    while((add_cmd = pool_output_command_get(command)) == NULL) {
+        if(pending >= OUTPUT_COMMAND_POOL_SIZE)
+            return Status_Overflow;
+        if(!protocol_execute_realtime())
+            return Status_Reset;
+        protocol_auto_cycle_start();
+    }
 
-        if(output_commands == NULL)
-            output_commands = add_cmd;
-        else {
-            output_command_t *cmd = output_commands;
-            while(cmd->next)
-                cmd = cmd->next;
-            cmd->next = add_cmd;
-        }
+    if(output_commands == NULL)
+        output_commands = add_cmd;
+    else {
+        cmd = output_commands;
+        while(cmd->next)
+            cmd = cmd->next;
+        cmd->next = add_cmd;
     }
 
-    return add_cmd != NULL;
+    return Status_OK;
 }
 
 static status_code_t init_sync_motion (plan_line_data_t *pl_data, float pitch)
@@ -221,21 +349,25 @@ static status_code_t init_sync_motion (plan_line_data_t *pl_data, float pitch)
 // characters have been removed. In this function, all units and positions are converted and
 // exported to grbl's internal functions in terms of (mm, mm/min) and absolute machine
 // coordinates, respectively.
-status_code_t gc_execute_block(char *block, char *message)
-{
-    static parser_block_t gc_block;
+static parser_block_t gc_block;
 
+// Parses and executes one block, either from a line or from a list of pre-tokenized words terminated by a '\0' letter.
+static status_code_t execute_block (char *block, const gc_word_t *words, raster_row_t **raster, char *message)
+{
     // Determine if the line is a program start/end marker.
     // Old comment from protocol.c:
     // NOTE: This maybe installed to tell Grbl when a program is running vs manual input,
     // where, during a program, the system auto-cycle start will continue to execute
     // everything until the next '%' sign. This will help fix resuming issues with certain
     // functions that empty the planner buffer to execute its task on-time.
-    if (block[0] == CMD_PROGRAM_DEMARCATION && block[1] == '\0') {
+    if (block && block[0] == CMD_PROGRAM_DEMARCATION && block[1] == '\0') {
         gc_state.file_run = !gc_state.file_run;
         return Status_OK;
     }
 
+    // Apply pending setting changes before they are used for motion.
+    settings_batch_commit();
+
   /* -------------------------------------------------------------------------------------
      STEP 1: Initialize parser block struct and copy current g-code state modes. The parser
      updates these modes and commands as the block line is parsed and will only be used and
@@ -245,6 +377,9 @@ status_code_t gc_execute_block(char *block, char *message)
 
     memset(&gc_block, 0, sizeof(gc_block));                           // Initialize the parser block struct.
     memcpy(&gc_block.modal, &gc_state.modal, sizeof(gc_state.modal)); // Copy current modes
+#ifdef ENABLE_RASTER_ROWS
+    gc_block.raster = raster;
+#endif
 
     bool set_tool = false;
     axis_command_t axis_command = AxisCommand_None;
@@ -261,7 +396,7 @@ status_code_t gc_execute_block(char *block, char *message)
     gc_parser_flags_t gc_parser_flags = {0};
 
     // Determine if the line is a jogging motion or a normal g-code block.
-    if (block[0] == '$') { // NOTE: `$J=` already parsed when passed to this function.
+    if (block && block[0] == '$') { // NOTE: `$J=` already parsed when passed to this function.
         // Set G1 and G94 enforced modes to ensure accurate error checks.
         gc_parser_flags.jog_motion = On;
         gc_block.modal.motion = MotionMode_Linear;
@@ -282,15 +417,37 @@ status_code_t gc_execute_block(char *block, char *message)
     float value;
     uint_fast16_t int_value = 0;
     uint_fast16_t mantissa = 0;
+    const value_word_t *value_word;
+#ifdef ENABLE_NGC_EXPRESSIONS
+    status_code_t status;
+
+    ngc_assign_reset();
+#endif
+
+    while ((letter = words ? words->letter : block[char_counter++]) != '\0') { // Loop until no more g-code words in block.
 
-    while ((letter = block[char_counter++]) != '\0') { // Loop until no more g-code words in block.
+#ifdef ENABLE_NGC_EXPRESSIONS
+        // Parameter assignment, applied when all words are read.
+        if(letter == '#' && !words) {
+            if((status = ngc_read_assignment(block, &char_counter)) != Status_OK)
+                FAIL(status);
+            continue;
+        }
+#endif
 
         // Import the next g-code word, expecting a letter followed by a value. Otherwise, error out.
         if((letter < 'A') || (letter > 'Z'))
             FAIL(Status_ExpectedCommandLetter); // [Expected word letter]
 
-        if (!read_float(block, &char_counter, &value))
+        if (words)
+            value = words++->value; // Pre-tokenized words are already converted.
+#ifdef ENABLE_NGC_EXPRESSIONS
+        else if ((status = ngc_read_real_value(block, &char_counter, &value)) != Status_OK)
+            FAIL(status); // [Expected word value or expression error]
+#else
+        else if (!read_float(block, &char_counter, &value))
             FAIL(Status_BadNumberFormat); // [Expected word value]
+#endif
 
         // Convert values to smaller uint8 significand and mantissa values for parsing this word.
         // NOTE: Mantissa is multiplied by 100 to catch non-integer command values. This is more
@@ -299,9 +456,13 @@ status_code_t gc_execute_block(char *block, char *message)
         // a good enough comprimise and catch most all non-integer errors. To make it compliant,
         // we would simply need to change the mantissa to int16, but this add compiled flash space.
         // Maybe update this later.
-        int_value = (uint_fast16_t)truncf(value);
-        mantissa = (uint_fast16_t)roundf(100.0f * (value - int_value)); // Compute mantissa for Gxx.x commands.
-        // NOTE: Rounding must be used to catch small floating point errors.
+        // Only command words and integer value words need the conversion, it is skipped for the remaining value words.
+        value_word = &value_words_table[letter - 'A'];
+        if(letter == 'G' || letter == 'M' || value_word->type == ValueWord_Integer || value_word->type == ValueWord_Tool) {
+            int_value = (uint_fast16_t)truncf(value);
+            mantissa = (uint_fast16_t)roundf(100.0f * (value - int_value)); // Compute mantissa for Gxx.x commands.
+            // NOTE: Rounding must be used to catch small floating point errors.
+        }
 
         // Check if the g-code word is supported or errors due to modal group violations or has
         // been repeated in the g-code block. If ok, update the command or record its value.
@@ -315,7 +476,7 @@ status_code_t gc_execute_block(char *block, char *message)
                 switch(int_value) {
 
                     case 7: case 8:
-                        if(settings.flags.lathe_mode) {
+                        if(LATHE_MODE) {
                             word_bit.group = ModalGroup_G15;
                             gc_block.modal.diameter_mode = int_value == 7; // TODO: find specs for implementation, only affects X calculation? reporting? current position?
                         } else
@@ -349,7 +510,7 @@ status_code_t gc_execute_block(char *block, char *message)
                         break;
 
                     case 33: case 76:
-                        if(!hal.spindle_get_data)
+                        if(!(hal.spindle_get_data && hal.driver_cap.spindle_sync && SPINDLE_SYNC_ENABLED))
                             FAIL(Status_GcodeUnsupportedCommand); // [G33 or G76 not supported]
                         if (axis_command)
                             FAIL(Status_GcodeAxisCommandConflict); // [Axis word/command conflict]
@@ -414,7 +575,11 @@ status_code_t gc_execute_block(char *block, char *message)
                         break;
 
                     case 95:
+#ifdef ENABLE_FEED_PER_REV_TRACKING
                         if(hal.spindle_get_data) {
+#else
+                        if(hal.spindle_get_data && SPINDLE_SYNC_ENABLED) {
+#endif
                             word_bit.group = ModalGroup_G5;
                             gc_block.modal.feed_mode = FeedMode_UnitsPerRev;
                         } else
@@ -471,13 +636,19 @@ status_code_t gc_execute_block(char *block, char *message)
 
                     case 61:
                         word_bit.group = ModalGroup_G13;
-                        if (mantissa != 0) // [G61.1 not supported]
+                        if (mantissa != 0 && mantissa != 10)
                             FAIL(Status_GcodeUnsupportedCommand);
-                        // gc_block.modal.control = CONTROL_MODE_EXACT_PATH; // G61
+                        gc_block.modal.control = mantissa == 0 ? ControlMode_ExactPath : ControlMode_ExactStop; // G61, G61.1
+                        mantissa = 0; // Set to zero to indicate valid non-integer G command.
+                        break;
+
+                    case 64:
+                        word_bit.group = ModalGroup_G13;
+                        gc_block.modal.control = ControlMode_PathBlending; // G64
                         break;
 
                     case 96: case 97:
-                        if(settings.flags.lathe_mode && hal.driver_cap.variable_spindle) {
+                        if(LATHE_MODE && hal.driver_cap.variable_spindle) {
                             word_bit.group = ModalGroup_G14;
                             gc_block.modal.spindle_rpm_mode = (spindle_rpm_mode_t)((int_value - 96) ^ 1);
                         } else
@@ -628,142 +799,56 @@ status_code_t gc_execute_block(char *block, char *message)
                 legal g-code words and stores their value. Error-checking is performed later since some
                 words (I,J,K,L,P,R) have multiple connotations and/or depend on the issued commands. */
 
-                switch(letter) {
-
-                  #ifdef A_AXIS
-                    case 'A':
-                        word_bit.parameter = Word_A;
-                        gc_block.values.xyz[A_AXIS] = value;
-                        bit_true(axis_words, bit(A_AXIS));
-                        break;
-                  #endif
-
-                  #ifdef B_AXIS
-                    case 'B':
-                        word_bit.parameter = Word_B;
-                        gc_block.values.xyz[B_AXIS] = value;
-                        bit_true(axis_words, bit(B_AXIS));
-                        break;
-                  #endif
-
-                  #ifdef C_AXIS
-                    case 'C':
-                        word_bit.parameter = Word_C;
-                        gc_block.values.xyz[C_AXIS] = value;
-                        bit_true(axis_words, bit(C_AXIS));
-                        break;
-                 #endif
+                if(value_word->type == ValueWord_Unsupported)
+                    FAIL(Status_GcodeUnsupportedCommand);
 
-                    case 'D':
-                        word_bit.parameter = Word_D;
-                        gc_block.values.d = value;
-                        break;
-
-                    case 'E':
-                        word_bit.parameter = Word_E;
-                        gc_block.values.e = value;
-                        break;
+                if(value_word->type == ValueWord_Integer || value_word->type == ValueWord_Tool) {
+                    if (mantissa > 0)
+                        FAIL(Status_GcodeCommandValueNotInteger);
+                    // NOTE: value is checked since int_value may be truncated to 16 bits.
+                    if (letter == 'T' && value > (float)MAX_TOOL_NUMBER)
+                        FAIL(Status_GcodeIllegalToolTableEntry);
+                    if (value_word->type == ValueWord_Tool && value > 65535.0f)
+                        FAIL(Status_GcodeValueOutOfRange);
+                }
 
-                    case 'F':
-                        word_bit.parameter = Word_F;
-                        gc_block.values.f = value;
-                        break;
+                word_bit.parameter = (parameter_word_t)value_word->parameter;
 
-                    case 'H':
-                        if (mantissa > 0)
-                            FAIL(Status_GcodeCommandValueNotInteger);
-                        word_bit.parameter = Word_H;
-                        gc_block.values.h = int_value;
-                        break;
+                switch(value_word->type) {
 
-                    case 'I':
-                        word_bit.parameter = Word_I;
-                        gc_block.values.ijk[I_VALUE] = value;
-                        bit_true(ijk_words, bit(I_VALUE));
+                    case ValueWord_Axis:
+                        bit_true(axis_words, bit(value_word->idx));
+                        *(float *)((uint8_t *)&gc_block.values + value_word->offset) = value;
                         break;
 
-                    case 'J':
-                        word_bit.parameter = Word_J;
-                        gc_block.values.ijk[J_VALUE] = value;
-                        bit_true(ijk_words, bit(J_VALUE));
+                    case ValueWord_IJK:
+                        bit_true(ijk_words, bit(value_word->idx));
+                        *(float *)((uint8_t *)&gc_block.values + value_word->offset) = value;
                         break;
 
-                    case 'K':
-                        word_bit.parameter = Word_K;
-                        gc_block.values.ijk[K_VALUE] = value;
-                        bit_true(ijk_words, bit(K_VALUE));
+                    case ValueWord_Integer:
+                        *((uint8_t *)&gc_block.values + value_word->offset) = (uint8_t)int_value;
                         break;
 
-                    case 'L':
-                        if (mantissa > 0)
-                            FAIL(Status_GcodeCommandValueNotInteger);
-                        word_bit.parameter = Word_L;
-                        gc_block.values.l = int_value;
+                    case ValueWord_Tool:
+                        *(tool_id_t *)((uint8_t *)&gc_block.values + value_word->offset) = (tool_id_t)int_value;
                         break;
 
-                    case 'N':
-                        word_bit.parameter = Word_N;
+                    case ValueWord_LineNumber:
                         gc_block.values.n = (int32_t)truncf(value);
                         break;
 
-                    case 'P': // NOTE: For certain commands, P value must be an integer, but none of these commands are supported.
-                        word_bit.parameter = Word_P;
-                        gc_block.values.p = value;
-                        break;
-
-                    case 'Q': // may be used for user defined mcodes or G61,G76
-                        word_bit.parameter = Word_Q;
-                        gc_block.values.q = value;
-                        break;
-
-                    case 'R':
-                        word_bit.parameter = Word_R;
-                        gc_block.values.r = value;
-                        break;
-
-                    case 'S':
-                        word_bit.parameter = Word_S;
-                        gc_block.values.s = value;
-                        break;
-
-                    case 'T':
-                        if (mantissa > 0)
-                            FAIL(Status_GcodeCommandValueNotInteger);
-                        if (int_value > MAX_TOOL_NUMBER)
-                            FAIL(Status_GcodeIllegalToolTableEntry);
-                        word_bit.parameter = Word_T;
-                        gc_block.values.t = int_value;
-                        break;
-
-                    case 'X':
-                        word_bit.parameter = Word_X;
-                        gc_block.values.xyz[X_AXIS] = value;
-                        bit_true(axis_words, bit(X_AXIS));
-                        break;
-
-                    case 'Y':
-                        word_bit.parameter = Word_Y;
-                        gc_block.values.xyz[Y_AXIS] = value;
-                        bit_true(axis_words, bit(Y_AXIS));
-                        break;
-
-                    case 'Z':
-                        word_bit.parameter = Word_Z;
-                        gc_block.values.xyz[Z_AXIS] = value;
-                        bit_true(axis_words, bit(Z_AXIS));
+                    default:
+                        *(float *)((uint8_t *)&gc_block.values + value_word->offset) = value;
                         break;
+                }
 
-                    default: FAIL(Status_GcodeUnsupportedCommand);
-
-                } // end parameter letter switch
-
-                // NOTE: Variable 'word_bit' is always assigned, if the non-command letter is valid.
                 if (bit_istrue(value_words, bit(word_bit.parameter)))
                     FAIL(Status_GcodeWordRepeated); // [Word repeated]
 
-                // Check for invalid negative values for words F, H, N, P, T, and S.
+                // Check for invalid negative values for words D, F, H, N, T, and S.
                 // NOTE: Negative value check is done here simply for code-efficiency.
-                if ((bit(word_bit.parameter) & (bit(Word_D)|bit(Word_F)|bit(Word_H)|bit(Word_N)|bit(Word_T)|bit(Word_S))) && value < 0.0f)
+                if (value_word->non_negative && value < 0.0f)
                     FAIL(Status_NegativeValue); // [Word value cannot be negative]
 
                 value_words |= bit(word_bit.parameter); // Flag to indicate parameter assigned.
@@ -771,6 +856,10 @@ status_code_t gc_execute_block(char *block, char *message)
         } // end main letter switch
     }
 
+#ifdef ENABLE_NGC_EXPRESSIONS
+    ngc_assign_commit();
+#endif
+
     // Parsing complete!
 
 
@@ -940,7 +1029,7 @@ status_code_t gc_execute_block(char *block, char *message)
         if ((int32_t)gc_block.values.q < 1 || (int32_t)gc_block.values.q > MAX_TOOL_NUMBER)
             FAIL(Status_GcodeIllegalToolTableEntry);
 
-        gc_block.values.t = (uint8_t)gc_block.values.q;
+        gc_block.values.t = (tool_id_t)gc_block.values.q;
 
         bit_false(value_words, bit(Word_Q));
     } else if (bit_isfalse(value_words, bit(Word_T)))
@@ -964,6 +1053,14 @@ status_code_t gc_execute_block(char *block, char *message)
                 gc_block.output_command.port = (uint8_t)gc_block.values.p;
                 gc_block.output_command.value = port_command == 62 || port_command == 64 ? 1.0f : 0.0f;
                 bit_false(value_words, bit(Word_P));
+#ifdef ENABLE_POSITION_OUTPUTS
+                if(port_command <= 63 && bit_istrue(value_words, bit(Word_D))) {
+                    if(gc_block.values.d < 0.0f)
+                        FAIL(Status_NegativeValue);
+                    gc_block.output_command.distance = gc_block.modal.units_imperial ? gc_block.values.d * MM_PER_INCH : gc_block.values.d;
+                    bit_false(value_words, bit(Word_D));
+                }
+#endif
                 break;
 
             case 66:
@@ -1012,6 +1109,14 @@ status_code_t gc_execute_block(char *block, char *message)
                 gc_block.output_command.port = (uint8_t)gc_block.values.e;
                 gc_block.output_command.value = gc_block.values.q;
                 bit_false(value_words, bit(Word_E)|bit(Word_Q));
+#ifdef ENABLE_POSITION_OUTPUTS
+                if(port_command == 67 && bit_istrue(value_words, bit(Word_D))) {
+                    if(gc_block.values.d < 0.0f)
+                        FAIL(Status_NegativeValue);
+                    gc_block.output_command.distance = gc_block.modal.units_imperial ? gc_block.values.d * MM_PER_INCH : gc_block.values.d;
+                    bit_false(value_words, bit(Word_D));
+                }
+#endif
             break;
         }
     }
@@ -1258,7 +1363,25 @@ status_code_t gc_execute_block(char *block, char *message)
             FAIL(Status_SettingReadFail);
     }
 
-    // [16. Set path control mode ]: N/A. Only G61. G61.1 and G64 NOT SUPPORTED.
+    // [16. Set path control mode ]: G61, G61.1 and G64.
+    // [G64 Errors]: Negative P value.
+    // NOTE: A P-word in a G64 block is always the path tolerance, as in LinuxCNC. If path blending is enabled and
+    //       it is omitted the arc tolerance is used. Else it is used as the junction deviation, if omitted or zero
+    //       the junction deviation setting ($11) is used.
+    if (bit_istrue(command_words, bit(ModalGroup_G13)) && gc_block.modal.control == ControlMode_PathBlending) {
+        if (bit_istrue(value_words, bit(Word_P))) {
+            if (gc_block.values.p < 0.0f)
+                FAIL(Status_NegativeValue);
+            if (gc_block.modal.units_imperial)
+                gc_block.values.p *= MM_PER_INCH;
+            bit_false(value_words, bit(Word_P));
+        } else
+#ifdef ENABLE_PATH_BLENDING
+            gc_block.values.p = settings.arc_tolerance;
+#else
+            gc_block.values.p = 0.0f;
+#endif
+    }
     // [17. Set distance mode ]: N/A. Only G91.1. G90.1 NOT SUPPORTED.
     // [18. Set retract mode ]: N/A.
 
@@ -1285,9 +1408,9 @@ status_code_t gc_execute_block(char *block, char *message)
             if(gc_block.values.p < 0.0f)
                 FAIL(Status_NegativeValue);
 
-            uint8_t p_value;
+            uint32_t p_value;
 
-            p_value = (uint8_t)truncf(gc_block.values.p); // Convert p value to int.
+            p_value = (uint32_t)truncf(gc_block.values.p); // Convert p value to int.
 
             switch(gc_block.values.l) {
 
@@ -1315,7 +1438,7 @@ status_code_t gc_execute_block(char *block, char *message)
                             if (gc_block.values.l == 20)
                                 // L20: Update coordinate system axis at current position (with modifiers) with programmed value
                                 // WPos = MPos - WCS - G92 - TLO  ->  WCS = MPos - G92 - TLO - WPos
-                                gc_block.values.coord_data.xyz[idx] = gc_state.position[idx] - gc_block.values.xyz[idx] - gc_state.g92_coord_offset[idx] - gc_state.tool_length_offset[idx];
+                                gc_block.values.coord_data.xyz[idx] = gc_state.position[idx] - rotary_base(idx) - gc_block.values.xyz[idx] - gc_state.g92_coord_offset[idx] - gc_state.tool_length_offset[idx];
                             else // L2: Update coordinate system axis to programmed value.
                                 gc_block.values.coord_data.xyz[idx] = gc_block.values.xyz[idx];
                         } // else, keep current stored value.
@@ -1327,10 +1450,10 @@ status_code_t gc_execute_block(char *block, char *message)
                     if(p_value == 0 || p_value > MAX_TOOL_NUMBER)
                        FAIL(Status_GcodeIllegalToolTableEntry); // [Greater than MAX_TOOL_NUMBER]
 
-                    tool_table[p_value].tool = p_value;
+                    tool_data_t *tool_data = gc_get_tool_data((tool_id_t)p_value); // Keep stored values for words not given
 
                     if(bit_istrue(value_words, bit(Word_R))) {
-                        tool_table[p_value].radius = gc_block.values.r;
+                        tool_data->radius = gc_block.values.r;
                         bit_false(value_words, bit(Word_R));
                     }
 
@@ -1342,19 +1465,25 @@ status_code_t gc_execute_block(char *block, char *message)
                     do {
                         if (bit_istrue(axis_words, bit(--idx))) {
                             if(gc_block.values.l == 1)
-                                tool_table[p_value].offset[idx] = gc_block.values.xyz[idx];
+                                tool_data->offset[idx] = gc_block.values.xyz[idx];
                             else if(gc_block.values.l == 10)
-                                tool_table[p_value].offset[idx] = gc_state.position[idx] - gc_state.g92_coord_offset[idx] - gc_block.values.xyz[idx];
+                                tool_data->offset[idx] = gc_state.position[idx] - rotary_base(idx) - gc_state.g92_coord_offset[idx] - gc_block.values.xyz[idx];
                             else if(gc_block.values.l == 11)
-                                tool_table[p_value].offset[idx] = g59_3_offset[idx] - gc_block.values.xyz[idx];
+                                tool_data->offset[idx] = g59_3_offset[idx] - gc_block.values.xyz[idx];
                             if (gc_block.values.l != 1)
-                                tool_table[p_value].offset[idx] -= gc_state.tool_length_offset[idx];
+                                tool_data->offset[idx] -= gc_state.tool_length_offset[idx];
                         }
                         // else, keep current stored value.
                     } while(idx);
 
+#ifdef ENABLE_SPARSE_TOOL_TABLE
+                    // Entries not cached are reread from storage, L10 and L11 are thus stored too.
+                    if(!tool_table_write(tool_data))
+                        FAIL(Status_ToolTableFull);
+#else
                     if(gc_block.values.l == 1)
-                        settings_write_tool_data(&tool_table[p_value]);
+                        settings_write_tool_data(tool_data);
+#endif
 
                     break;
 #endif
@@ -1376,7 +1505,7 @@ status_code_t gc_execute_block(char *block, char *message)
             do { // Axes indices are consistent, so loop may be used.
                 if (bit_istrue(axis_words, bit(--idx))) {
             // WPos = MPos - WCS - G92 - TLO  ->  G92 = MPos - WCS - TLO - WPos
-                    gc_block.values.xyz[idx] = gc_state.position[idx] - gc_block.modal.coord_system.xyz[idx] - gc_block.values.xyz[idx] - gc_state.tool_length_offset[idx];
+                    gc_block.values.xyz[idx] = gc_state.position[idx] - rotary_base(idx) - gc_block.modal.coord_system.xyz[idx] - gc_block.values.xyz[idx] - gc_state.tool_length_offset[idx];
                 } else
                     gc_block.values.xyz[idx] = gc_state.g92_coord_offset[idx];
             } while(idx);
@@ -1399,9 +1528,26 @@ status_code_t gc_execute_block(char *block, char *message)
                         // Apply coordinate offsets based on distance mode.
                         if (gc_block.modal.distance_incremental)
                             gc_block.values.xyz[idx] += gc_state.position[idx];
-                        else  // Absolute mode
+                        else {  // Absolute mode
                             gc_block.values.xyz[idx] += gc_get_block_offset(&gc_block, idx);
+#ifdef ENABLE_ROTARY_WRAP
+                            gc_block.values.xyz[idx] += rotary_base(idx);
+                            // Rotary axis, move to the target angle the shortest way round.
+                            if(axis_command == AxisCommand_MotionMode && bit_istrue(settings.rotary_shortest.mask, bit(idx))) {
+                                float delta = fmodf(gc_block.values.xyz[idx] - gc_state.position[idx], 360.0f);
+                                if(delta > 180.0f)
+                                    delta -= 360.0f;
+                                else if(delta < -180.0f)
+                                    delta += 360.0f;
+                                gc_block.values.xyz[idx] = gc_state.position[idx] + delta;
+                            }
+#endif
+                        }
                     }
+#ifdef ENABLE_ROTARY_WRAP
+                    else // G53, machine position in the current revolution.
+                        gc_block.values.xyz[idx] += rotary_base(idx);
+#endif
                 } while(idx);
             }
 
@@ -1416,6 +1562,14 @@ status_code_t gc_execute_block(char *block, char *message)
                     if (!settings_read_coord_data(gc_block.non_modal_command == NonModal_GoHome_0 ? SETTING_INDEX_G28 : SETTING_INDEX_G30, &gc_block.values.coord_data.xyz))
                         FAIL(Status_SettingReadFail);
 
+#ifdef ENABLE_ROTARY_WRAP
+                    idx = N_AXIS;
+                    do {
+                        idx--;
+                        gc_block.values.coord_data.xyz[idx] += rotary_base(idx);
+                    } while(idx);
+#endif
+
                     if (axis_words) {
                         // Move only the axes specified in secondary move.
                         idx = N_AXIS;
@@ -1919,6 +2073,20 @@ status_code_t gc_execute_block(char *block, char *message)
                         FAIL(Status_GcodeNoAxisWords); // [No axis words]
                     if (isequal_position_vector(gc_state.position, gc_block.values.xyz))
                         FAIL(Status_GcodeInvalidTarget); // [Invalid target]
+                    // Two-phase probing: Q is the feed rate of a second, slow, approach that is started
+                    // after retracting R from the first trigger point. Both words must be present.
+                    if (bit_istrue(value_words, bit(Word_Q)|bit(Word_R))) {
+                        if ((value_words & (bit(Word_Q)|bit(Word_R))) != (bit(Word_Q)|bit(Word_R)))
+                            FAIL(Status_GcodeValueWordMissing); // [Q or R word missing]
+                        if (gc_block.values.q <= 0.0f || gc_block.values.r <= 0.0f)
+                            FAIL(Status_NonPositiveValue); // [Q or R <= 0]
+                        if (gc_block.modal.units_imperial) {
+                            gc_block.values.q *= MM_PER_INCH;
+                            gc_block.values.r *= MM_PER_INCH;
+                        }
+                        bit_false(value_words, bit(Word_Q)|bit(Word_R)); // Remove single-meaning value words.
+                        gc_parser_flags.probe_two_phase = On;
+                    }
                     break;
 
                 default:
@@ -1943,12 +2111,24 @@ status_code_t gc_execute_block(char *block, char *message)
     if (value_words)
         FAIL(Status_GcodeUnusedWords); // [Unused words]
 
+#ifdef ENABLE_RASTER_ROWS
+    // Raster rows can only be attached to linear feed motions.
+    if (gc_block.raster && *gc_block.raster && !(gc_block.modal.motion == MotionMode_Linear && axis_command == AxisCommand_MotionMode &&
+                                gc_block.modal.feed_mode == FeedMode_UnitsPerMin))
+        FAIL(Status_GcodeUnsupportedCommand);
+#endif
+
     /* -------------------------------------------------------------------------------------
      STEP 4: EXECUTE!!
      Assumes that all error-checking has been completed and no failure modes exist. We just
      need to update the state and execute the block according to the order-of-execution.
     */
 
+    // Queue remaining moves of any pending canned cycle on a motion mode change. Cycles set up while one is
+    // pending are queued after it, other motion and buffer synchronization flush pending cycles when planned.
+    if(gc_block.modal.motion != gc_state.modal.motion && !mc_canned_flush())
+        FAIL(Status_Reset);
+
     // Initialize planner data struct for motion blocks.
     plan_line_data_t plan_data;
     memset(&plan_data, 0, sizeof(plan_line_data_t)); // Zero plan_data struct
@@ -1979,8 +2159,22 @@ status_code_t gc_execute_block(char *block, char *message)
         return (status_code_t)int_value;
     }
 
+#ifdef ENABLE_COOLANT_QUEUE
+    // Queue coolant changes with straight and arc motion, standalone M7/M8/M9 commands are held for the next one.
+    bool coolant_queue = axis_command == AxisCommand_MotionMode &&
+                          (gc_block.modal.motion == MotionMode_Seek || gc_block.modal.motion == MotionMode_Linear ||
+                            gc_block.modal.motion == MotionMode_CwArc || gc_block.modal.motion == MotionMode_CcwArc);
+
+    // Any other command set a held coolant change when the queued motion has completed.
+    if(coolant_pending && !coolant_queue && !(command_words == bit(ModalGroup_M8) && axis_words == 0)) {
+        coolant_pending = false;
+        if(!coolant_sync(gc_state.modal.coolant))
+            FAIL(Status_Reset);
+    }
+#endif
+
     // If in laser mode, setup laser power based on current and past parser conditions.
-    if (settings.flags.laser_mode) {
+    if (LASER_MODE) {
 
         if (!((gc_block.modal.motion == MotionMode_Linear) || (gc_block.modal.motion == MotionMode_CwArc) || (gc_block.modal.motion == MotionMode_CcwArc)))
           gc_parser_flags.laser_disable = On;
@@ -2009,8 +2203,14 @@ status_code_t gc_execute_block(char *block, char *message)
     plan_data.line_number = gc_state.line_number; // Record data for planner use.
 
     // [1. Comments feedback ]: Extracted in protocol.c if HAL entry point provided
-    if(message && (plan_data.message = malloc(strlen(message) + 1)))
-        strcpy(plan_data.message, message);
+    // If the message pool is exhausted wait for a queued message to be displayed, as for a full planner buffer.
+    if(message) {
+        while((plan_data.message = pool_message_get(message)) == NULL) {
+            if(!protocol_execute_realtime())
+                FAIL(Status_Reset);
+            protocol_auto_cycle_start();
+        }
+    }
 
     // [2. Set feed rate mode ]:
     gc_state.modal.feed_mode = gc_block.modal.feed_mode;
@@ -2029,8 +2229,7 @@ status_code_t gc_execute_block(char *block, char *message)
             gc_state.spindle.css.active = true;
             gc_state.spindle.css.axis = plane.axis_1;
             gc_state.spindle.css.tool_offset = gc_get_offset(gc_state.spindle.css.axis);
-            float pos = gc_state.position[gc_state.spindle.css.axis] - gc_state.spindle.css.tool_offset;
-            gc_block.values.s = pos <= 0.0f ? gc_state.spindle.css.max_rpm : min(gc_state.spindle.css.max_rpm, gc_state.spindle.css.surface_speed / (pos * (float)(2.0f * M_PI)));
+            gc_block.values.s = gc_get_css_rpm(&gc_state.spindle.css, gc_state.position[gc_state.spindle.css.axis] - gc_state.spindle.css.tool_offset);
             gc_parser_flags.spindle_force_sync = On;
         } else {
             if(gc_state.spindle.css.active) {
@@ -2043,7 +2242,16 @@ status_code_t gc_execute_block(char *block, char *message)
 
 
     if ((gc_state.spindle.rpm != gc_block.values.s) || gc_parser_flags.spindle_force_sync) {
-        if (gc_state.modal.spindle.on && !gc_parser_flags.laser_is_motion)
+#ifdef ENABLE_SPINDLE_RPM_QUEUE
+        // Queue the change with the motion if the spindle keeps running, it is set when the first planner block starts.
+        bool rpm_queued = !gc_parser_flags.spindle_force_sync && axis_command == AxisCommand_MotionMode &&
+                           gc_state.modal.spindle.value == gc_block.modal.spindle.value &&
+                            (gc_block.modal.motion == MotionMode_Seek || gc_block.modal.motion == MotionMode_Linear ||
+                              gc_block.modal.motion == MotionMode_CwArc || gc_block.modal.motion == MotionMode_CcwArc);
+#else
+        bool rpm_queued = false;
+#endif
+        if (gc_state.modal.spindle.on && !gc_parser_flags.laser_is_motion && !rpm_queued)
             spindle_sync(gc_state.modal.spindle, gc_parser_flags.laser_disable ? 0.0f : gc_block.values.s);
         gc_state.spindle.rpm = gc_block.values.s; // Update spindle speed state.
     }
@@ -2061,7 +2269,7 @@ status_code_t gc_execute_block(char *block, char *message)
         // If M6 not available or M61 commanded set new tool immediately
         if(set_tool || !(hal.stream.suspend_read || hal.tool_change)) {
 #ifdef N_TOOLS
-            gc_state.tool = &tool_table[gc_state.tool_pending];
+            gc_state.tool = gc_get_tool_data(gc_state.tool_pending);
 #else
             gc_state.tool->tool = gc_state.tool_pending;
 #endif
@@ -2071,12 +2279,16 @@ status_code_t gc_execute_block(char *block, char *message)
         // Prepare tool carousel when available
         if(hal.tool_select) {
 #ifdef N_TOOLS
-            hal.tool_select(&tool_table[gc_state.tool_pending], !set_tool);
+            hal.tool_select(gc_get_tool_data(gc_state.tool_pending), !set_tool);
 #else
             hal.tool_select(gc_state.tool, !set_tool);
 #endif
-        } else
+        } else {
+#if defined(N_TOOLS) && defined(ENABLE_SPARSE_TOOL_TABLE)
+            gc_get_tool_data(gc_state.tool_pending); // Read ahead of M6.
+#endif
             sys.report.tool = On;
+        }
     }
 
     // [5a. HAL pin I/O ]: M62 - M68. (Modal group M10)
@@ -2087,7 +2299,12 @@ status_code_t gc_execute_block(char *block, char *message)
 
             case 62:
             case 63:
-                add_output_command(&gc_block.output_command);
+            case 67:
+                {
+                    status_code_t status = add_output_command(&gc_block.output_command);
+                    if(status != Status_OK)
+                        FAIL(status);
+                }
                 break;
 
             case 64:
@@ -2096,13 +2313,18 @@ status_code_t gc_execute_block(char *block, char *message)
                 break;
 
             case 66:
+#ifdef ENABLE_WAIT_ON_INPUT_ASYNC
+                if(hal.get_elapsed_ticks) { // Queue as a barrier, the timeout is measured in ms ticks.
+                    if(!wait_input_queue(gc_block.output_command.is_digital, gc_block.output_command.port, (wait_mode_t)gc_block.values.l, gc_block.values.q))
+                        FAIL(Status_Reset);
+                    break;
+                }
+#endif
+                if(!mc_canned_flush()) // Keep motion of pending canned cycles running while waiting.
+                    FAIL(Status_Reset);
                 hal.port.wait_on_input(gc_block.output_command.is_digital, gc_block.output_command.port, (wait_mode_t)gc_block.values.l, gc_block.values.q);
                 break;
 
-            case 67:
-                add_output_command(&gc_block.output_command);
-                break;
-
             case 68:
                 hal.port.analog_out(gc_block.output_command.port, gc_block.output_command.value);
                 break;
@@ -2113,7 +2335,7 @@ status_code_t gc_execute_block(char *block, char *message)
     if (bit_istrue(command_words, bit(ModalGroup_M6)) && !set_tool) {
         protocol_buffer_synchronize();
 #ifdef N_TOOLS
-        gc_state.tool = &tool_table[gc_state.tool_pending];
+        gc_state.tool = gc_get_tool_data(gc_state.tool_pending);
 #else
         gc_state.tool->tool = gc_state.tool_pending;
 #endif
@@ -2147,10 +2369,28 @@ status_code_t gc_execute_block(char *block, char *message)
     if (gc_parser_flags.set_coolant && gc_state.modal.coolant.value != gc_block.modal.coolant.value) {
     // NOTE: Coolant M-codes are modal. Only one command per line is allowed. But, multiple states
     // can exist at the same time, while coolant disable clears all states.
+#ifdef ENABLE_COOLANT_QUEUE
+        // Queue the change with the motion, it is set when the first planner block starts.
+        if(coolant_queue) {
+            gc_state.modal.coolant = gc_block.modal.coolant;
+            plan_data.condition.coolant_sync = On;
+        } else if(axis_words == 0 && command_words == bit(ModalGroup_M8) && (coolant_pending || plan_get_current_block())) {
+            // Standalone command while motion is queued: hold the change for the next motion or cycle completion.
+            gc_state.modal.coolant = gc_block.modal.coolant;
+            coolant_pending = true;
+        } else
+#endif
         if(coolant_sync(gc_block.modal.coolant))
             gc_state.modal.coolant = gc_block.modal.coolant;
     }
 
+#ifdef ENABLE_COOLANT_QUEUE
+    if(coolant_pending && coolant_queue) {
+        coolant_pending = false;
+        plan_data.condition.coolant_sync = On;
+    }
+#endif
+
     plan_data.condition.coolant = gc_state.modal.coolant; // Set condition flag for planner use.
 
     sys.flags.delay_overrides = Off;
@@ -2213,15 +2453,15 @@ status_code_t gc_execute_block(char *block, char *message)
                     break;
 #ifdef N_TOOLS
                 case ToolLengthOffset_Enable: // G43
-                    if (gc_state.tool_length_offset[idx] != tool_table[gc_block.values.h].offset[idx]) {
+                    if (gc_state.tool_length_offset[idx] != gc_get_tool_data(gc_block.values.h)->offset[idx]) {
                         tlo_changed = true;
-                        gc_state.tool_length_offset[idx] = tool_table[gc_block.values.h].offset[idx];
+                        gc_state.tool_length_offset[idx] = gc_get_tool_data(gc_block.values.h)->offset[idx];
                     }
                     break;
 
                 case ToolLengthOffset_ApplyAdditional: // G43.2
-                    tlo_changed |= tool_table[gc_block.values.h].offset[idx] != 0.0f;
-                    gc_state.tool_length_offset[idx] += tool_table[gc_block.values.h].offset[idx];
+                    tlo_changed |= gc_get_tool_data(gc_block.values.h)->offset[idx] != 0.0f;
+                    gc_state.tool_length_offset[idx] += gc_get_tool_data(gc_block.values.h)->offset[idx];
                     break;
 #endif
                 case ToolLengthOffset_EnableDynamic: // G43.1
@@ -2249,8 +2489,21 @@ status_code_t gc_execute_block(char *block, char *message)
         system_flag_wco_change();
     }
 
-    // [16. Set path control mode ]: G61.1/G64 NOT SUPPORTED
-    // gc_state.modal.control = gc_block.modal.control; // NOTE: Always default.
+    // [16. Set path control mode ]:
+    gc_state.modal.control = gc_block.modal.control;
+    if (bit_istrue(command_words, bit(ModalGroup_G13)) && gc_state.modal.control == ControlMode_PathBlending)
+#ifdef ENABLE_PATH_BLENDING
+        gc_state.path_tolerance = gc_block.values.p;
+#else
+        gc_state.junction_deviation = gc_block.values.p;
+#endif
+
+    // Path control mode applies to all motion in the block, exact stop starts each move from rest.
+    plan_data.condition.exact_stop = gc_state.modal.control == ControlMode_ExactStop;
+#ifndef ENABLE_PATH_BLENDING
+    if(gc_state.modal.control == ControlMode_PathBlending)
+        plan_data.junction_deviation = gc_state.junction_deviation;
+#endif
 
     // [17. Set distance mode ]:
     gc_state.modal.distance_incremental = gc_block.modal.distance_incremental;
@@ -2283,11 +2536,17 @@ status_code_t gc_execute_block(char *block, char *message)
             break;
 
         case NonModal_SetHome_0:
-            settings_write_coord_data(SETTING_INDEX_G28, &gc_state.position);
-            break;
-
         case NonModal_SetHome_1:
-            settings_write_coord_data(SETTING_INDEX_G30, &gc_state.position);
+#ifdef ENABLE_ROTARY_WRAP
+            idx = N_AXIS;
+            do { // Store wrapping axes within a revolution.
+                idx--;
+                gc_block.values.coord_data.xyz[idx] = gc_state.position[idx] - rotary_base(idx);
+            } while(idx);
+#else
+            memcpy(gc_block.values.coord_data.xyz, gc_state.position, sizeof(gc_state.position));
+#endif
+            settings_write_coord_data(gc_block.non_modal_command == NonModal_SetHome_0 ? SETTING_INDEX_G28 : SETTING_INDEX_G30, &gc_block.values.coord_data.xyz);
             break;
 
         case NonModal_SetCoordinateOffset: // G92
@@ -2335,10 +2594,30 @@ status_code_t gc_execute_block(char *block, char *message)
 
             case MotionMode_Linear:
                 if(gc_state.modal.feed_mode == FeedMode_UnitsPerRev) {
+#ifdef ENABLE_FEED_PER_REV_TRACKING
+                    plan_data.condition.feed_per_rev = On;
+#else
                     plan_data.condition.spindle.synchronized = On;
+#endif
                 //??    gc_state.distance_per_rev = plan_data.feed_rate;
                     // check initial feed rate - fail if zero?
                 }
+#ifdef ENABLE_PATH_BLENDING
+                if(gc_state.modal.control == ControlMode_PathBlending)
+                    plan_data.path_tolerance = gc_state.path_tolerance;
+#endif
+#ifdef ENABLE_SEGMENT_COALESCING
+                plan_data.coalesce = gc_state.modal.control != ControlMode_ExactStop;
+#endif
+#ifdef ENABLE_RASTER_ROWS
+                if(gc_block.raster) {
+                    plan_data.raster = *gc_block.raster;
+                    mc_line(gc_block.values.xyz, &plan_data);
+                    *gc_block.raster = plan_data.raster; // NULL if queued.
+                    plan_data.raster = NULL;
+                    break;
+                }
+#endif
                 mc_line(gc_block.values.xyz, &plan_data);
                 break;
 
@@ -2349,12 +2628,18 @@ status_code_t gc_execute_block(char *block, char *message)
 
             case MotionMode_CwArc:
             case MotionMode_CcwArc:
+#ifdef ENABLE_FEED_PER_REV_TRACKING
+                plan_data.condition.feed_per_rev = gc_state.modal.feed_mode == FeedMode_UnitsPerRev;
+#endif
                 // fail if spindle synchronized motion?
                 mc_arc(gc_block.values.xyz, &plan_data, gc_state.position, gc_block.values.ijk, gc_block.values.r,
                         plane, gc_parser_flags.arc_is_clockwise);
                 break;
 
             case MotionMode_CubicSpline:
+#ifdef ENABLE_FEED_PER_REV_TRACKING
+                plan_data.condition.feed_per_rev = gc_state.modal.feed_mode == FeedMode_UnitsPerRev;
+#endif
                 mc_cubic_b_spline(gc_block.values.xyz, &plan_data, gc_state.position, gc_block.values.ijk, gc_state.modal.spline_pq);
                 break;
 
@@ -2409,7 +2694,18 @@ status_code_t gc_execute_block(char *block, char *message)
                 // NOTE: gc_block.values.xyz is returned from mc_probe_cycle with the updated position value. So
                 // upon a successful probing cycle, the machine position and the returned value should be the same.
                 plan_data.condition.no_feed_override = !settings.flags.allow_probing_feed_override;
-                gc_update_pos = (pos_update_t)mc_probe_cycle(gc_block.values.xyz, &plan_data, gc_parser_flags);
+                if(gc_parser_flags.probe_two_phase) {
+                    gc_probe_slow_t slow = {
+                        .feed_rate = gc_block.values.q,
+                        .retract = gc_block.values.r
+                    };
+                    gc_update_pos = (pos_update_t)mc_probe_cycle(gc_block.values.xyz, &plan_data, gc_parser_flags, &slow);
+                } else
+                    gc_update_pos = (pos_update_t)mc_probe_cycle(gc_block.values.xyz, &plan_data, gc_parser_flags, NULL);
+                // All done! Output the probe position as message if configured, once per cycle.
+                if((gc_update_pos == (pos_update_t)GCProbe_Found || gc_update_pos == (pos_update_t)GCProbe_FailEnd) &&
+                     sys.state != STATE_CHECK_MODE && settings.status_report.probe_coordinates)
+                    report_probe_parameters();
                 break;
 
             default:
@@ -2421,11 +2717,14 @@ status_code_t gc_execute_block(char *block, char *message)
             gc_update_pos = GCUpdatePos_None;
 
         //  Clean out any remaining output commands (may linger on error)
-        while(plan_data.output_commands) {
-            output_command_t *next = plan_data.output_commands;
-            free(plan_data.output_commands);
-            plan_data.output_commands = next;
-        }
+        pool_output_commands_release(plan_data.output_commands);
+        plan_data.output_commands = NULL;
+
+#ifdef ENABLE_COOLANT_QUEUE
+        // No planner block was queued for the motion, e.g. for a zero length move: set the coolant now.
+        if(plan_data.condition.coolant_sync)
+            coolant_sync(gc_state.modal.coolant);
+#endif
 
         // As far as the parser is concerned, the position is now == target. In reality the
         // motion control system might still be processing the action and the real tool position
@@ -2499,14 +2798,21 @@ status_code_t gc_execute_block(char *block, char *message)
                 hal.coolant_set_state(gc_state.modal.coolant);
                 sys.report.spindle = On; // Set to report change immediately
                 sys.report.coolant = On; // ...
+#ifdef ENABLE_JOB_STATS
+                job_stats_program_end();
+#endif
             }
 
             // Clear any pending output commands
-            while(output_commands) {
-                output_command_t *next = output_commands->next;
-                free(output_commands);
-                output_commands = next;
-            }
+            pool_output_commands_release(output_commands);
+            output_commands = NULL;
+
+#ifdef ENABLE_O_WORDS
+            flowctrl_program_end();
+#endif
+#ifdef ENABLE_LINE_CHECKSUM
+            protocol_line_sequence_reset();
+#endif
 
             hal.report.feedback_message(Message_ProgramEnd);
         }
@@ -2517,3 +2823,47 @@ status_code_t gc_execute_block(char *block, char *message)
 
     return Status_OK;
 }
+
+status_code_t gc_execute_block (char *block, char *message)
+{
+    PERF_START(t);
+
+    status_code_t status = execute_block(block, NULL, NULL, message);
+
+    PERF_END(Perf_GcodeExecute, t);
+
+    return status;
+}
+
+// Executes one block of pre-tokenized words, skipping the text scanning and number conversion.
+// Used by streams that deliver blocks in binary form. Jog motions are not supported.
+status_code_t gc_execute_words (const gc_word_t *words, raster_row_t **raster, char *message)
+{
+    return execute_block(NULL, words, raster, message);
+}
+
+#ifdef ENABLE_HOLD_JOG
+
+// Executes a jog command during a feed hold. The block being executed when the hold was entered, typically
+// waiting for planner buffer space, and the parser position at the end of the queued blocks are kept and
+// the jog target is computed from the current machine position.
+status_code_t gc_execute_hold_jog (char *block)
+{
+    status_code_t status;
+    parser_block_t held_block;
+    float position[N_AXIS];
+
+    memcpy(&held_block, &gc_block, sizeof(parser_block_t));
+    memcpy(position, gc_state.position, sizeof(position));
+
+    gc_sync_position();
+
+    status = execute_block(block, NULL, NULL, NULL);
+
+    memcpy(gc_state.position, position, sizeof(position));
+    memcpy(&gc_block, &held_block, sizeof(parser_block_t));
+
+    return status;
+}
+
+#endif
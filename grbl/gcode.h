@@ -79,8 +79,17 @@ typedef enum {
     Status_HomingRequired = 46,
     Status_GCodeToolError = 47,
     Status_ValueWordConflict = 48,
+    Status_BinaryFrameError = 49,
 
     Status_EStop = 50,
+    Status_FlowControlSyntaxError = 51,
+    Status_FlowControlOutOfMemory = 52,
+    Status_FlowControlStackOverflow = 53,
+    Status_MacroNotFound = 54,
+    Status_MacroStoreFull = 55,
+    Status_ExpressionSyntaxError = 56,
+    Status_ExpressionDivideByZero = 57,
+    Status_ExpressionInvalidArgument = 58,
     Status_Unhandled = 59, // For internal use only
 
 // Some error codes as defined in bdring's ESP32 port
@@ -89,8 +98,14 @@ typedef enum {
     Status_SDFailedOpenDir = 62,
     Status_SDDirNotFound = 63,
     Status_SDFileEmpty = 64,
+    Status_SDWriteError = 65,
 
-    Status_BTInitError = 70
+    Status_BTInitError = 70,
+
+    Status_ToolTableFull = 80,
+
+    Status_LineChecksum = 81,
+    Status_LineSequence = 82
 } status_code_t;
 
 
@@ -113,7 +128,7 @@ typedef enum {
     ModalGroup_G10,     // [G98,G99] Return mode in canned cycles
     ModalGroup_G11,     // [G50,G51] Scaling
     ModalGroup_G12,     // [G54,G55,G56,G57,G58,G59] Coordinate system selection
-    ModalGroup_G13,     // [G61] Control mode
+    ModalGroup_G13,     // [G61,G64] Control mode
     ModalGroup_G14,     // [G96,G97] Spindle Speed Mode
     ModalGroup_G15,     // [G7,G8] Lathe Diameter Mode
 
@@ -248,7 +263,11 @@ typedef enum {
 //#define CUTTER_COMP_DISABLE 0 // G40 (Default: Must be zero)
 
 // Modal Group G13: Control mode
-//#define CONTROL_MODE_EXACT_PATH 0 // G61 (Default: Must be zero)
+typedef enum {
+    ControlMode_ExactPath = 0,    // G61 (Default: Must be zero)
+    ControlMode_PathBlending = 1, // G64
+    ControlMode_ExactStop = 2     // G61.1
+} control_mode_t;
 
 // Modal Group G8: Tool length offset
 typedef enum {
@@ -281,9 +300,32 @@ typedef struct output_command {
     bool is_digital;
     uint8_t port;
     int32_t value;
+#ifdef ENABLE_POSITION_OUTPUTS
+    float distance;                 // Distance from the start of the next motion (mm) at which the output is set, D word
+    uint32_t trigger;               // Stepper ISR position at which the output is set, calculated by the segment generator
+#endif
     struct output_command *next;
 } output_command_t;
 
+#ifdef ENABLE_RASTER_ROWS
+#ifndef RASTER_ROW_MAX_PIXELS
+  #ifdef SMALL_RAM_TARGET
+    #define RASTER_ROW_MAX_PIXELS 32
+  #else
+    #define RASTER_ROW_MAX_PIXELS 128
+  #endif
+#endif
+
+// Laser raster row, a linear motion divided into pixels of equal length with individual power (spindle speed).
+typedef struct {
+    float length;                           // Length of the motion (mm), set by the planner
+    uint_fast16_t n_pixels;
+    float power[RASTER_ROW_MAX_PIXELS];
+} raster_row_t;
+#else
+typedef void raster_row_t;
+#endif
+
 typedef enum {
     WaitMode_Immediate = 0,
     WaitMode_Rise,
@@ -303,7 +345,8 @@ typedef enum {
     Trinamic_ReportPrewarnFlags = 911,
     Trinamic_ClearPrewarnFlags = 912,
     Trinamic_HybridThreshold = 913,
-    Trinamic_HomingSensivity = 914
+    Trinamic_HomingSensivity = 914,
+    Trinamic_HomingCalibrate = 915
 } user_mcode_t;
 
 // Define g-code parser position updating flags
@@ -326,6 +369,12 @@ typedef enum {
   #endif
 } gc_probe_t;
 
+// Second, slow, approach of a two-phase probing cycle. Set from the Q and R words of G38.x.
+typedef struct {
+    float feed_rate;    // Feed rate of the slow approach (mm/min)
+    float retract;      // Retract distance from the first trigger point before the slow approach (mm)
+} gc_probe_slow_t;
+
 // Define gcode parser flags for handling special cases.
 
 typedef union {
@@ -341,7 +390,8 @@ typedef union {
                  laser_is_motion     :1,
                  set_coolant         :1,
                  motion_mode_changed :1,
-                 reserved            :6;
+                 probe_two_phase     :1,
+                 reserved            :5;
     };
 } gc_parser_flags_t;
 
@@ -398,7 +448,7 @@ typedef struct {
     // uint8_t cutter_comp;              // {G40} NOTE: Don't track. Only default supported.
     tool_offset_mode_t tool_offset_mode; // {G43,G43.1,G49}
     coord_system_t coord_system;         // {G54,G55,G56,G57,G58,G59,G59.1,G59.2,G59.3}
-    // uint8_t control;                  // {G61} NOTE: Don't track. Only default supported.
+    control_mode_t control;              // {G61,G64}
     program_flow_t program_flow;         // {M0,M1,M2,M30}
     coolant_state_t coolant;             // {M7,M8,M9}
     spindle_state_t spindle;             // {M3,M4,M5}
@@ -410,6 +460,9 @@ typedef struct {
     float spline_pq[2];                  // {G5}
 } gc_modal_t;
 
+// Tool number, the G-code T and H words and the tool table are limited to MAX_TOOL_NUMBER
+typedef uint16_t tool_id_t;
+
 typedef struct {
     float d;                   // Max spindle RPM in Constant Surface Speed Mode (G96)
     float e;                   // Thread taper length (G76)
@@ -423,8 +476,8 @@ typedef struct {
     float xyz[N_AXIS];         // X,Y,Z Translational axes
     coord_system_t coord_data; // Coordinate data
     int32_t n;                 // Line number
-    uint8_t h;                 // Tool number
-    uint8_t t;                 // Tool selection
+    tool_id_t h;               // Tool number
+    tool_id_t t;               // Tool selection
     uint8_t l;                 // G10 or canned cycles parameters
 } gc_values_t;
 
@@ -465,13 +518,18 @@ typedef struct {
 typedef struct {
     float offset[N_AXIS];
     float radius;
-    uint8_t tool;
+#if defined(N_TOOLS) && !defined(ENABLE_SPARSE_TOOL_TABLE)
+    uint8_t tool;       // Kept 8-bit for the stored tool table layout, N_TOOLS is limited to 255
+#else
+    tool_id_t tool;
+#endif
 } tool_data_t;
 
 // Data used for Constant Surface Speed Mode calculations
 typedef struct {
     float surface_speed;    // Surface speed in millimeters/min
-    float target_rpm;       // Target RPM at end of movement
+    float start_pos;        // Tool axis position relative to the tool offset at start of movement
+    float delta_pos;        // Tool axis travel of movement
     float max_rpm;          // Maximum spindle RPM
     float tool_offset;      // Tool offset
     uint_fast8_t axis;      // Linear (tool) axis
@@ -491,7 +549,12 @@ typedef struct {
     float distance_per_rev;             // Millimeters/rev
     float position[N_AXIS];             // Where the interpreter considers the tool to be at this point in the code
     int32_t line_number;                // Last line number sent
-    uint8_t tool_pending;               // Tool to be selected on next M6
+#ifdef ENABLE_PATH_BLENDING
+    float path_tolerance;               // G64 P-word, millimeters
+#else
+    float junction_deviation;           // G64 P-word, millimeters. 0 for the junction deviation setting ($11).
+#endif
+    tool_id_t tool_pending;             // Tool to be selected on next M6
     bool file_run;                      // Tracks % command
     bool is_laser_ppi_mode;
     bool is_rpm_rate_adjusted;
@@ -511,7 +574,14 @@ typedef struct {
 
 extern parser_state_t gc_state;
 #ifdef N_TOOLS
+#ifdef ENABLE_SPARSE_TOOL_TABLE
+extern tool_data_t tool_table; // Entry for tools not in the tool table, tool_table.c caches the others
+#else
 extern tool_data_t tool_table[N_TOOLS + 1];
+#endif
+
+// Returns the tool table entry for a tool, entries are read from persistent storage on first use.
+tool_data_t *gc_get_tool_data (tool_id_t tool);
 #else
 extern tool_data_t tool_table;
 #endif
@@ -524,25 +594,53 @@ typedef struct {
     gc_modal_t modal;
     gc_values_t values;
     output_command_t output_command;
+#ifdef ENABLE_RASTER_ROWS
+    raster_row_t **raster;              // Raster row of the block, set to NULL by a user M-code claiming the row
+#endif
 } parser_block_t;
 
 // Initialize the parser
 void gc_init(bool cold_start);
 
+// Pre-tokenized g-code word, the value is already converted
+typedef struct {
+    char letter;
+    float value;
+} gc_word_t;
+
 // Execute one block of rs275/ngc/g-code
 status_code_t gc_execute_block(char *block, char *message);
 
+// Execute one block of pre-tokenized words, terminated by a word with letter set to '\0'.
+// If raster is not NULL and points to a raster row the block must be a linear feed motion, the
+// pointer is cleared when the row is queued with it. The caller still owns the row otherwise.
+status_code_t gc_execute_words(const gc_word_t *words, raster_row_t **raster, char *message);
+
+#ifdef ENABLE_HOLD_JOG
+// Execute a $J= jog command during a feed hold, the parser block and position are preserved.
+status_code_t gc_execute_hold_jog(char *block);
+#endif
+
 // Sets g-code parser position in mm. Input in steps. Called by the system abort and hard
 // limit pull-off routines.
+#ifdef ENABLE_HEIGHT_MAP
+void gc_sync_position (void);
+#else
 #define gc_sync_position() system_convert_array_steps_to_mpos (gc_state.position, sys_position)
+#endif
 
 void gc_set_laser_ppimode (bool on);
 
+#ifdef ENABLE_COOLANT_QUEUE
+void gc_coolant_flush (void);
+#endif
+
 // Gets axes scaling state.
 axes_signals_t gc_get_g51_state (void);
 float *gc_get_scaling (void);
 
 // Get current axis offset.
 float gc_get_offset (uint_fast8_t idx);
+float gc_get_css_rpm (css_data_t *css, float position);
 
 #endif
@@ -39,6 +39,7 @@
 
 // Define the Grbl system include files. NOTE: Do not alter organization.
 #include "config.h"
+#include "machine_profile.h"
 #include "nuts_bolts.h"
 #include "settings.h"
 #include "hal.h"
@@ -60,6 +61,32 @@
 #include "override.h"
 #include "sleep.h"
 #include "stream.h"
+#include "pool.h"
+#include "binary_stream.h"
+#include "binary_status.h"
+#include "report_json.h"
+#include "perf.h"
+#include "trace.h"
+#include "memory_usage.h"
+#include "probe_grid.h"
+#include "height_map.h"
+#include "laser_ppi.h"
+#include "spindle_pid.h"
+#include "stepdir_map.h"
+#include "flowctrl.h"
+#include "macros.h"
+#include "ngc_expr.h"
+#include "lookahead.h"
+#include "atc_seq.h"
+#include "wait_input.h"
+#include "can_io.h"
+#include "following_error.h"
+#include "job_stats.h"
+#include "tool_table.h"
+#include "hooks.h"
+#include "raster_scan.h"
+#include "spindle_encoder.h"
+#include "stream_arbiter.h"
 #ifdef KINEMATICS_API
 #include "kinematics.h"
 #endif
@@ -79,6 +106,38 @@
   #endif
 #endif
 
+#if defined(ENABLE_RASTER_ROWS) && !defined(ENABLE_BINARY_STREAM)
+  #error "ENABLE_RASTER_ROWS requires ENABLE_BINARY_STREAM."
+#endif
+
+#if defined(ENABLE_RASTER_SCAN) && !defined(ENABLE_RASTER_ROWS)
+  #error "ENABLE_RASTER_SCAN requires ENABLE_RASTER_ROWS."
+#endif
+
+#if defined(ENABLE_LASER_POWER_RAMP) && !defined(SPINDLE_PWM_DIRECT)
+  #error "ENABLE_LASER_POWER_RAMP requires direct PWM updates, SPINDLE_RPM_CONTROLLED cannot be defined."
+#endif
+#if defined(ENABLE_HEIGHT_MAP) && !defined(ENABLE_PROBE_GRID)
+  #error "ENABLE_HEIGHT_MAP requires ENABLE_PROBE_GRID."
+#endif
+#if (defined(FIVE_AXIS_TABLE) || defined(FIVE_AXIS_HEAD)) && N_AXIS != 6
+  #error "Five axis kinematics requires N_AXIS 6."
+#endif
+#if defined(FIVE_AXIS_TABLE) && defined(FIVE_AXIS_HEAD)
+  #error "FIVE_AXIS_TABLE and FIVE_AXIS_HEAD cannot be enabled at the same time."
+#endif
+#if defined(ENABLE_NATIVE_ARCS) && defined(KINEMATICS_API)
+  #error "ENABLE_NATIVE_ARCS is not supported with kinematics."
+#endif
+#if defined(ENABLE_INPUT_SHAPING) && defined(ENABLE_JERK_ACCELERATION)
+  #error "ENABLE_INPUT_SHAPING and ENABLE_JERK_ACCELERATION cannot be enabled at the same time."
+#endif
+#if defined(ENABLE_REMOTE_STEPPER) && (defined(ENABLE_BACKLASH_COMPENSATION) || defined(ENABLE_POSITION_OUTPUTS))
+  #error "ENABLE_REMOTE_STEPPER is not supported with ENABLE_BACKLASH_COMPENSATION or ENABLE_POSITION_OUTPUTS."
+#endif
+#if defined(ENABLE_FOLLOWING_ERROR) && (defined(ENABLE_BACKLASH_COMPENSATION) || defined(ENABLE_REMOTE_STEPPER))
+  #error "ENABLE_FOLLOWING_ERROR is not supported with ENABLE_BACKLASH_COMPENSATION or ENABLE_REMOTE_STEPPER."
+#endif
 #if (REPORT_WCO_REFRESH_BUSY_COUNT < REPORT_WCO_REFRESH_IDLE_COUNT)
   #error "WCO busy refresh is less than idle refresh."
 #endif
@@ -30,12 +30,18 @@
 #include "wall_plotter.h"
 #endif
 
+#if defined(FIVE_AXIS_TABLE) || defined(FIVE_AXIS_HEAD)
+#include "five_axis.h"
+#endif
+
 // Declare system global variable structure
 system_t sys;
 int32_t sys_position[N_AXIS];               // Real-time machine (aka home) position vector in steps.
+volatile uint_fast8_t sys_position_seq;     // Incremented before and after each update of sys_position, odd while updating.
 int32_t sys_probe_position[N_AXIS];         // Last probe position in machine coordinates and steps.
 bool prior_mpg_mode;                        // Enter MPG mode on startup?
 bool cold_start = true;
+startup_time_t sys_startup_time;            // Power-up and reset to ready times, ms.
 volatile probing_state_t sys_probing_state; // Probing state value. Used to coordinate the probing cycle with stepper ISR.
 volatile uint_fast16_t sys_rt_exec_state;   // Global realtime executor bitflag variable for state management. See EXEC bitmasks.
 volatile uint_fast16_t sys_rt_exec_alarm;   // Global realtime executor bitflag variable for setting various alarms.
@@ -44,7 +50,10 @@ HAL hal;
 
 static const report_t report_fns = {
     .status_message = report_status_message,
-    .feedback_message = report_feedback_message
+    .feedback_message = report_feedback_message,
+#ifdef ENABLE_BINARY_STATUS_REPORT
+    .binary_status = binary_status_report
+#endif
 };
 
 // called from stream drivers while tx is blocking, return false to terminate
@@ -60,7 +69,7 @@ static bool stream_tx_blocking (void)
 kinematics_t kinematics;
 
 // called from mc_line() to segment lines if not overridden, default implementation for pass-through
-static bool kinematics_segment_line (float *target, plan_line_data_t *pl_data, bool init)
+static bool segment_line_passthrough (float *target, plan_line_data_t *pl_data, bool init)
 {
     static uint_fast8_t iterations;
 
@@ -86,12 +95,12 @@ static void debug_out (bool on)
 int grbl_enter (void)
 {
 #ifdef N_TOOLS
-    assert(EEPROM_ADDR_GLOBAL + sizeof(settings_t) + 1 < EEPROM_ADDR_TOOL_TABLE);
+    assert(EEPROM_ADDR_GLOBAL + sizeof(settings_t) + EEPROM_CHECKSUM_SIZE < EEPROM_ADDR_TOOL_TABLE);
 #else
-    assert(EEPROM_ADDR_GLOBAL + sizeof(settings_t) + 1 < EEPROM_ADDR_PARAMETERS);
+    assert(EEPROM_ADDR_GLOBAL + sizeof(settings_t) + EEPROM_CHECKSUM_SIZE < EEPROM_ADDR_PARAMETERS);
 #endif
-    assert(EEPROM_ADDR_PARAMETERS + SETTING_INDEX_NCOORD * (sizeof(coord_data_t) + 1) < EEPROM_ADDR_STARTUP_BLOCK);
-    assert(EEPROM_ADDR_STARTUP_BLOCK + N_STARTUP_LINE * (MAX_STORED_LINE_LENGTH + 1) < EEPROM_ADDR_BUILD_INFO);
+    assert(EEPROM_ADDR_PARAMETERS + SETTING_INDEX_NCOORD * (sizeof(coord_data_t) + EEPROM_CHECKSUM_SIZE) < EEPROM_ADDR_STARTUP_BLOCK);
+    assert(EEPROM_ADDR_STARTUP_BLOCK + N_STARTUP_LINE * (MAX_STORED_LINE_LENGTH + EEPROM_CHECKSUM_SIZE) < EEPROM_ADDR_BUILD_INFO);
 
     bool looping = true, driver_ok;
 
@@ -99,8 +108,13 @@ int grbl_enter (void)
 
     hal.version = HAL_VERSION; // Update when signatures and/or contract is changed - driver_init() should fail
     hal.limit_interrupt_callback = limit_interrupt_handler;
+    hal.probe_interrupt_callback = probe_interrupt_handler;
     hal.control_interrupt_callback = control_interrupt_handler;
+#ifdef ENABLE_PERF_COUNTERS
+    hal.stepper_interrupt_callback = perf_stepper_interrupt_handler;
+#else
     hal.stepper_interrupt_callback = stepper_driver_interrupt_handler;
+#endif
     hal.stream.enqueue_realtime_command = protocol_enqueue_realtime_command;
     hal.stream_blocking_callback = stream_tx_blocking;
     hal.protocol_enqueue_gcode = protocol_enqueue_gcode;
@@ -111,7 +125,7 @@ int grbl_enter (void)
 #ifdef KINEMATICS_API
     memset(&kinematics, 0, sizeof(kinematics_t));
 
-    kinematics.segment_line = kinematics_segment_line; // default to no segmentation
+    kinematics.segment_line = segment_line_passthrough; // default to no segmentation
 #endif
 
 #ifdef DEBUGOUT
@@ -119,10 +133,27 @@ int grbl_enter (void)
 #endif
     driver_ok = driver_init();
 
+#ifdef ENABLE_CAN_IO
+    if(hal.can.send)
+        can_io_init();
+#endif
+
+#ifdef ENABLE_RASTER_SCAN
+    raster_scan_init();
+#endif
+
+#ifdef ENABLE_MEMORY_USAGE
+    mem_stack_paint();
+#endif
+
 #if COMPATIBILITY_LEVEL > 0
     hal.stream.suspend_read = NULL;
 #endif
 
+#ifdef ENABLE_STREAM_ARBITER
+    stream_arbiter_init();
+#endif
+
 #if COMPATIBILITY_LEVEL > 1
     hal.driver_setting = NULL;
     hal.driver_settings_report = NULL;
@@ -139,14 +170,34 @@ int grbl_enter (void)
     eeprom_emu_init();
   #endif
     settings_init(); // Load Grbl settings from EEPROM
+#ifdef ENABLE_MACROS
+    macros_init(); // Load macros, after the settings as the driver area must be known.
+#endif
+#ifdef ENABLE_JOB_STATS
+    job_stats_init(); // Load job statistics totals, after the macros as they are stored after the macro store.
+#endif
 
     memset(sys_position, 0, sizeof(sys_position)); // Clear machine position.
 
 // check and configure driver
 
+#ifdef ENABLE_STEP_TIMING
+    // The timed step executor steps each axis at its exact time, AMASS is not needed.
+    if(hal.driver_cap.step_timing) {
+        hal.driver_cap.amass_level = 0;
+  #ifndef ENABLE_PERF_COUNTERS
+        hal.stepper_interrupt_callback = stepper_timed_interrupt_handler;
+  #endif
+    }
+#else
+    hal.driver_cap.step_timing = Off;
+#endif
+
 #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    driver_ok = driver_ok && hal.driver_cap.amass_level >= MAX_AMASS_LEVEL;
-    hal.driver_cap.amass_level = MAX_AMASS_LEVEL;
+    // Use the number of levels supported by the driver if less than configured.
+    driver_ok = driver_ok && (hal.driver_cap.amass_level > 0 || hal.driver_cap.step_timing);
+    if(hal.driver_cap.amass_level > MAX_AMASS_LEVEL)
+        hal.driver_cap.amass_level = MAX_AMASS_LEVEL;
 #else
     hal.driver_cap.amass_level = 0;
 #endif
@@ -188,10 +239,26 @@ int grbl_enter (void)
     wall_plotter_init();
 #endif
 
+#if defined(FIVE_AXIS_TABLE) || defined(FIVE_AXIS_HEAD)
+    five_axis_init();
+#endif
+
     // Grbl initialization loop upon power-up or a system abort. For the latter, all processes
     // will return to this loop to be cleanly re-initialized.
     while(looping) {
 
+        uint32_t reset_ticks = hal.get_elapsed_ticks ? hal.get_elapsed_ticks() : 0;
+
+#ifdef ENABLE_WARM_RESET
+        // Include the driver and plugin resets and the unwinding to this loop in the reset time.
+        if(!cold_start && sys_startup_time.reset_request)
+            reset_ticks = sys_startup_time.reset_request;
+        sys_startup_time.reset_request = 0;
+#endif
+
+        // Apply setting changes of an unfinished $BEGIN batch
+        settings_batch_commit();
+
         // Reset report entry points
         memcpy(&hal.report, &report_fns, sizeof(report_t));
 
@@ -200,13 +267,16 @@ int grbl_enter (void)
         uint_fast16_t prior_state = sys.state;
 
         if(sys.message)
-            free(sys.message);
+            pool_message_release(sys.message);
 
         memset(&sys, 0, sizeof(system_t)); // Clear system struct variable.
         set_state(prior_state);
         sys.override.feed_rate = DEFAULT_FEED_OVERRIDE;          // Set to 100%
         sys.override.rapid_rate = DEFAULT_RAPID_OVERRIDE;        // Set to 100%
         sys.override.spindle_rpm = DEFAULT_SPINDLE_RPM_OVERRIDE; // Set to 100%
+#ifdef ENABLE_FEED_ADAPTATION
+        sys.override.feed_adapt = 100;
+#endif
 
         if(settings.parking.flags.enabled)
             sys.override.control.parking_disable = settings.parking.flags.deactivate_upon_init;
@@ -222,19 +292,57 @@ int grbl_enter (void)
         hal.stream.reset_read_buffer(); // Clear input stream buffer
         gc_init(cold_start); // Set g-code parser to default state
         hal.limits_enable(settings.limits.flags.hard_enabled, false);
+        mc_canned_discard(); // Discard any pending canned cycle.
+#ifdef ENABLE_O_WORDS
+        flowctrl_reset(); // Clear subroutines and abort any body being recorded.
+#endif
+#ifdef ENABLE_WAIT_ON_INPUT_ASYNC
+        wait_input_reset(); // Discard any pending M66 barrier.
+#endif
+#ifdef ENABLE_CAN_IO
+        can_io_reset(); // Discard outputs staged on remote I/O modules.
+#endif
+#ifdef ENABLE_FOLLOWING_ERROR
+        following_error_reset(); // Sync the encoders to the commanded position when motion starts.
+#endif
+#ifdef ENABLE_JOB_STATS
+        job_stats_reset(); // End a running job as aborted.
+#endif
+#ifdef MC_LINE_HOLD
+        mc_line_discard(); // Discard any line held back by mc_line().
+#endif
         plan_reset(); // Clear block buffer and planner variables
         st_reset(); // Clear stepper subsystem variables.
+#ifdef ENABLE_WCO_MOTION_SYNC
+        system_wco_reset(); // Discard offsets queued with motion, after the planner and stepper blocks are released.
+#endif
         limits_set_homing_axes(); // Set axes to be homed from settings.
 #ifdef ENABLE_BACKLASH_COMPENSATION
-        mc_backlash_init(); // Init backlash configuration.
+  #ifdef ENABLE_WARM_RESET
+        if(cold_start) // Initialized on setting changes, the direction last moved is kept over a reset.
+  #endif
+        plan_backlash_init(); // Init backlash configuration.
 #endif
         // Sync cleared gcode and planner positions to current system position.
         plan_sync_position();
         gc_sync_position();
 
+#ifdef ENABLE_JSON_REPORTS
+        report_json_enable(false); // Revert to text reports, the welcome message is always sent as text.
+#endif
+#ifdef ENABLE_ACK_COALESCING
+        report_ack_enable(false); // Revert to per line acknowledgments.
+#endif
+
         // Print welcome message. Indicates an initialization has occured at power-up or with a reset.
         report_init_message();
 
+        if(hal.get_elapsed_ticks) {
+            sys_startup_time.reset = hal.get_elapsed_ticks() - reset_ticks;
+            if(cold_start)
+                sys_startup_time.cold_start = hal.get_elapsed_ticks();
+        }
+
         if(sys.state == STATE_ESTOP)
             set_state(STATE_ALARM);
 
@@ -35,7 +35,7 @@
 #include "probe.h"
 #include "plugins.h"
 
-#define HAL_VERSION 6
+#define HAL_VERSION 7
 
 // driver capabilities, to be set by driver in driver_init(), flags may be cleared after to switch off option
 typedef union {
@@ -50,7 +50,7 @@ typedef union {
                  limits_pull_up            :1,
                  control_pull_up           :1,
                  probe_pull_up             :1,
-                 amass_level               :2, // 0...3
+                 amass_level               :3, // 0...7, max supported AMASS level
                  program_stop              :1,
                  block_delete              :1,
                  e_stop                    :1,
@@ -69,15 +69,19 @@ typedef union {
                  mpg_mode                  :1,
                  spindle_pwm_linearization :1,
                  probe_connected           :1,
-                 unassigned                :3;
+                 probe_latch               :1, // Driver calls probe_interrupt_callback on probe edges, the stepper ISR does not poll the probe
+                 step_timing               :1; // stepper_cycles_per_tick() sets the time to the next interrupt only, see ENABLE_STEP_TIMING
     };
 } driver_cap_t;
 
 typedef void (*stream_write_ptr)(const char *s);
+typedef void (*stream_write_n_ptr)(const char *s, uint16_t length);
 typedef axes_signals_t (*limits_get_state_ptr)(void);
 typedef void (*driver_reset_ptr)(void);
 
-/* TODO: add to HAL so that a different formatting (xml, json etc) of reports may be implemented by driver? */
+// Report formatter, selected by report_set_formatter() so that a different formatting (xml, json etc)
+// of reports may be implemented by a driver. Entry points left unassigned (null) are handled by the
+// default text formatter.
 typedef struct {
     status_code_t (*report_status_message)(status_code_t status_code);
     alarm_code_t (*report_alarm_message)(alarm_code_t alarm_code);
@@ -85,9 +89,13 @@ typedef struct {
     void (*report_init_message)(void);
     void (*report_grbl_help)(void);
     void (*report_grbl_settings)(void);
+    void (*report_uint_setting)(setting_type_t n, uint32_t val);
+    void (*report_float_setting)(setting_type_t n, float val, uint8_t n_decimal);
+    void (*report_string_setting)(setting_type_t n, char *val);
     void (*report_echo_line_received)(char *line);
     void (*report_realtime_status)(void);
     void (*report_probe_parameters)(void);
+    void (*report_tool_offsets)(void);
     void (*report_ngc_parameters)(void);
     void (*report_gcode_modes)(void);
     void (*report_startup_line)(uint8_t n, char *line);
@@ -97,15 +105,20 @@ typedef struct {
 typedef struct {
     status_code_t (*status_message)(status_code_t status_code);
     message_code_t (*feedback_message)(message_code_t message_code);
+    void (*binary_status)(void); // NULL if binary status frames are not enabled
 } report_t;
 
 typedef struct {
     stream_type_t type;
     uint16_t (*get_rx_buffer_available)(void);
+    uint16_t (*get_tx_buffer_available)(void); // optional, returns number of free characters in the output buffer
 //    bool (*stream_write)(char c);
     stream_write_ptr write; // write to current I/O stream only
     stream_write_ptr write_all; // write to all active output streams
+    stream_write_n_ptr write_n; // optional, write length characters to current I/O stream only
     int16_t (*read)(void);
+    uint16_t (*read_block)(char *buffer, uint16_t max); // optional, reads up to max characters and ends after the first CR or LF, returns number of characters read
+    uint16_t (*get_rx_lines)(void); // optional, returns number of complete lines in the input buffer, provided by flow controlled streams
     void (*reset_read_buffer)(void);
     void (*cancel_read_buffer)(void);
     bool (*suspend_read)(bool await);
@@ -127,12 +140,66 @@ typedef struct HAL {
     char *driver_options;
     char *board;
     uint32_t f_step_timer;
+    uint32_t f_cycle_counter;   // frequency of the get_cycle_count() counter, Hz
     uint32_t rx_buffer_size;
 
+    // optional buffer storage, may be set by driver in driver_init() to place the buffers in external/TCM RAM
+    // and/or to change their size. Grbl uses its default buffers if left unassigned (null).
+    struct {
+        plan_block_t *blocks;       // planner block ring buffer storage, size entries
+        uint_fast16_t size;         // number of planner blocks, minimum 3. One block is always kept empty.
+#ifdef PLANNER_SOA
+        float *profile;             // look-ahead data storage, size * 4 entries
+#endif
+    } planner_buffer;
+    struct {
+        segment_t *segments;        // step segment ring buffer storage, size entries
+        st_block_t *st_blocks;      // stepper block ring buffer storage, size - 1 entries
+        uint_fast16_t size;         // number of step segments, minimum 3
+    } segment_buffer;
+#ifdef ENABLE_REMOTE_STEPPER
+    // Optional, set by drivers that offload step generation to a co-processor. Frames are sent from st_prep_buffer()
+    // and from st_remote_status(), the driver passes status frames received from the co-processor to st_remote_status().
+    struct {
+        bool (*send)(const uint8_t *frame, uint_fast8_t length); // returns false if the frame could not be queued for transmission
+    } remote_stepper;
+#endif
+#ifdef ENABLE_CAN_IO
+    // Optional, CAN bus transport for remote I/O modules, see can_io.h. Called from the foreground and from the stepper ISR,
+    // the driver calls can_io_receive() with frames received.
+    struct {
+        bool (*send)(uint32_t id, const uint8_t *data, uint_fast8_t length); // returns false if the frame could not be queued for transmission
+    } can;
+#endif
+#ifdef ENABLE_MOTION_LINK
+    // Optional, set by drivers linking two controllers for synchronized motion. The leader driver sets send and sync_pulse, the
+    // follower driver sets follower and passes received frames to st_link_receive() and sync pulse edges to st_link_sync().
+    struct {
+        bool follower;                                           // segments are received from the leader instead of generated
+        bool (*send)(const uint8_t *frame, uint_fast8_t length); // leader, sends a frame to the follower, called from st_prep_buffer()
+        void (*sync_pulse)(void);                                // leader, outputs the sync pulse, called from the stepper ISR on segment start
+    } motion_link;
+#endif
+#ifdef ENABLE_FOLLOWING_ERROR
+    // Optional, set by drivers reading back motor positions from encoders for following error monitoring, see following_error.h.
+    struct {
+        axes_signals_t axes;                                // axes with encoders
+        bool (*get_position)(int32_t (*position)[N_AXIS]);  // encoder positions in steps, called from the stepper ISR. Returns false if not available
+    } axis_encoder;
+#endif
+    // optional main stack region, may be set by driver in driver_init() to enable stack usage reporting (ENABLE_MEMORY_USAGE).
+    struct {
+        uint8_t *base;              // lowest address of the stack region, the stack grows downwards towards it
+        uint32_t size;              // size of the stack region in bytes
+    } stack;
+
     bool (*driver_setup)(settings_t *settings);
 
     void (*limits_enable)(bool on, bool homing);
     limits_get_state_ptr limits_get_state;
+    // Optional, returns the limit switch state of motor A (SquaringMode_A) or motor B (SquaringMode_B) of the ganged axes.
+    // When provided ganged axes are squared in the homing cycle, each motor stops on its own switch.
+    axes_signals_t (*limits_get_squaring_state)(squaring_mode_t motor);
     void (*coolant_set_state)(coolant_state_t mode);
     coolant_state_t (*coolant_get_state)(void);
     void (*delay_ms)(uint32_t ms, void (*callback)(void));
@@ -142,6 +209,12 @@ typedef struct HAL {
 #ifdef SPINDLE_PWM_DIRECT
     uint_fast16_t (*spindle_get_pwm)(float rpm);
     void (*spindle_update_pwm)(uint_fast16_t pwm);
+#ifdef ENABLE_LASER_POWER_RAMP
+    void (*spindle_ramp_pwm)(segment_t *segment); // Optional, ramps PWM from segment->spindle_pwm by segment->spindle_pwm_slope per step tick
+#endif
+#ifdef ENABLE_LASER_PPI
+    void (*laser_pulse_train)(uint32_t delay, uint32_t period, uint_fast16_t pulse_length); // Optional, for laser PPI mode
+#endif
 #else
     void (*spindle_update_rpm)(float rpm);
 #endif
@@ -150,9 +223,12 @@ typedef struct HAL {
     void (*stepper_wake_up)(void);
     void (*stepper_go_idle)(bool clear_signals);
     void (*stepper_enable)(axes_signals_t enable);
-    void (*stepper_disable_motors)(axes_signals_t axes, squaring_mode_t mode);
+    void (*stepper_disable_motors)(axes_signals_t axes, squaring_mode_t mode); // Enables only motor A, only motor B or both motors of the ganged axes in axes, other axes are not changed.
     void (*stepper_cycles_per_tick)(uint32_t cycles_per_tick);
     void (*stepper_pulse_start)(stepper_t *stepper);
+    // Optional, called from st_prep_buffer() when the motion phase changes. The phase is signalled when the first
+    // segment of it is prepared, ahead of execution by the segment buffer length. Idle is signalled when the buffer is empty.
+    void (*stepper_motion_phase)(motion_phase_t phase);
 
     io_stream_t stream; // pointers to current I/O stream handlers
 
@@ -178,6 +254,8 @@ typedef struct HAL {
     bool (*get_position)(int32_t (*position)[N_AXIS]);
     void (*tool_select)(tool_data_t *tool, bool next);
     status_code_t (*tool_change)(parser_state_t *gc_state);
+    bool (*tool_read)(tool_id_t tool, tool_data_t *tool_data); // Tool table storage, e.g. on SD card, used by ENABLE_SPARSE_TOOL_TABLE. Returns false if not stored.
+    bool (*tool_write)(tool_data_t *tool_data);                   // An entry with all values zero is not stored. Returns false if no room.
     void (*show_message)(const char *msg);
     void (*report_options)(void);
     driver_reset_ptr driver_reset;
@@ -189,6 +267,22 @@ typedef struct HAL {
     void (*spindle_reset_data)(void);
     void (*state_change_requested)(uint_fast16_t state);
     void (*encoder_state_changed)(encoder_t *encoder);
+    // Set by drivers that call st_prep_buffer() from a task of their own, possibly on another core. Grbl claims the lock
+    // around planner and segment generator updates, it must be recursive and must not be claimed from interrupt context.
+    void (*planner_lock)(bool lock);
+    // Optional, called when a realtime command or input requests a stop. Set by drivers that call protocol_realtime_dispatch()
+    // from a task of their own, this must then be signalled to run. May be called from interrupt context.
+    void (*pend_realtime)(void);
+    // Optional, called by the main loop when it has nothing to do, used when compiled with ENABLE_IDLE_WAIT. Should block until
+    // hal.idle_wake is called or an interrupt occurs, e.g. by WFI or a task notification, and return within a ms or a tick regardless.
+    void (*idle_wait)(void);
+    // Optional, ends hal.idle_wait. Called when a realtime flag is set, a realtime command is received and a step segment has been
+    // executed, drivers should call it when stream input is received. May be called from interrupt context.
+    void (*idle_wake)(void);
+    // Calls callback from interrupt context every ms milliseconds until called with ms = 0, used for periodic status reports.
+    void (*periodic_ms)(uint32_t ms, void (*callback)(void));
+    uint32_t (*get_elapsed_ticks)(void); // returns milliseconds since startup, used for timestamps
+    uint32_t (*get_cycle_count)(void);   // returns a free running 32-bit cycle counter, used by ENABLE_PERF_COUNTERS and ENABLE_MOTION_TRACE instrumentation
 #ifdef DEBUGOUT
     void (*debug_out)(bool on);
 #endif
@@ -205,6 +299,7 @@ typedef struct HAL {
     bool (*stream_blocking_callback)(void);
     void (*stepper_interrupt_callback)(void);
     void (*limit_interrupt_callback)(axes_signals_t state);
+    void (*probe_interrupt_callback)(int32_t (*position)[N_AXIS]); // position at probe edge, NULL for the current position
     void (*control_interrupt_callback)(control_signals_t signals);
     void (*spindle_index_callback)(spindle_data_t *rpm);
 
@@ -214,4 +309,6 @@ typedef struct HAL {
 extern HAL hal;
 extern bool driver_init (void);
 
+#define PLANNER_LOCK(on) { if(hal.planner_lock) hal.planner_lock(on); }
+
 #endif
@@ -0,0 +1,145 @@
+/*
+  height_map.c - Z compensation from a probed height map
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "grbl.h"
+
+#ifdef ENABLE_HEIGHT_MAP
+
+/*
+  $HMAP=1 enables and $HMAP=0 disables Z compensation from the grid probed by $PGRID, $HMAP reports the
+  state as [HMAP:<0|1>]. When enabled mc_line() adds the Z offset bilinearly interpolated from the grid to
+  each line motion and subdivides XY motions so that they follow the surface. The offset is relative to the
+  first grid point, Z at that point is not changed. Compensation is suspended while the grid is cleared or
+  reprobed.
+
+  The Z value interpolated in a cell is z00 + dx * u + dy * v + dxy * u * v where u and v are the fractional
+  position in the cell. The coefficients are computed when a new cell is entered, consecutive segments
+  of a subdivided motion are mostly in the same cell so the cost per segment is constant and low.
+*/
+
+static struct {
+    bool enabled;
+    probe_grid_t *grid;             // Grid the lookup data below is for, NULL if none
+    float inv_spacing[2];
+    float max_idx[2];               // Index of the last grid point along X and Y
+    float segment_length;
+    int_fast32_t cell[2];           // Index of the cached cell, -1 if none
+    float z00, dx, dy, dxy;         // Coefficients for the cached cell, relative to the first grid point
+} hmap = {
+    .cell = {-1, -1}
+};
+
+void height_map_invalidate (void)
+{
+    hmap.grid = NULL;
+    hmap.cell[X_AXIS] = hmap.cell[Y_AXIS] = -1;
+}
+
+bool height_map_active (void)
+{
+    probe_grid_t *grid;
+
+    if(!(hmap.enabled && (grid = probe_grid_get())))
+        return false;
+
+    if(hmap.grid != grid) {
+        hmap.grid = grid;
+        hmap.inv_spacing[X_AXIS] = 1.0f / grid->spacing[X_AXIS];
+        hmap.inv_spacing[Y_AXIS] = 1.0f / grid->spacing[Y_AXIS];
+        hmap.max_idx[X_AXIS] = (float)(grid->n_points[X_AXIS] - 1);
+        hmap.max_idx[Y_AXIS] = (float)(grid->n_points[Y_AXIS] - 1);
+        hmap.segment_length = min(grid->spacing[X_AXIS], grid->spacing[Y_AXIS]) / (float)HEIGHT_MAP_SEGMENTS_PER_CELL;
+        hmap.cell[X_AXIS] = hmap.cell[Y_AXIS] = -1;
+    }
+
+    return true;
+}
+
+float height_map_segment_length (void)
+{
+    return hmap.segment_length;
+}
+
+// Computes the interpolation coefficients for the cell with the lower left grid point at i, j.
+// Along an axis with a single grid point the cell has no extent and the offset is constant.
+static void load_cell (int_fast32_t i, int_fast32_t j)
+{
+    uint_fast16_t nx = hmap.grid->n_points[X_AXIS];
+    uint_fast16_t i1 = i < (int_fast32_t)hmap.max_idx[X_AXIS] ? 1 : 0;
+    uint_fast16_t j1 = j < (int_fast32_t)hmap.max_idx[Y_AXIS] ? nx : 0;
+    float *z = &hmap.grid->z[j * nx + i];
+
+    hmap.cell[X_AXIS] = i;
+    hmap.cell[Y_AXIS] = j;
+    hmap.z00 = z[0] - hmap.grid->z[0];
+    hmap.dx = z[i1] - z[0];
+    hmap.dy = z[j1] - z[0];
+    hmap.dxy = z[i1 + j1] - z[j1] - hmap.dx;
+}
+
+float height_map_offset (float *position)
+{
+    int_fast32_t i, j;
+    float u = (position[X_AXIS] - hmap.grid->origin[X_AXIS]) * hmap.inv_spacing[X_AXIS];
+    float v = (position[Y_AXIS] - hmap.grid->origin[Y_AXIS]) * hmap.inv_spacing[Y_AXIS];
+
+    u = u < 0.0f ? 0.0f : min(u, hmap.max_idx[X_AXIS]);
+    v = v < 0.0f ? 0.0f : min(v, hmap.max_idx[Y_AXIS]);
+
+    // The last grid point along an axis belongs to the cell before it.
+    i = (int_fast32_t)u;
+    if(i && (float)i == hmap.max_idx[X_AXIS])
+        i--;
+    j = (int_fast32_t)v;
+    if(j && (float)j == hmap.max_idx[Y_AXIS])
+        j--;
+
+    if(i != hmap.cell[X_AXIS] || j != hmap.cell[Y_AXIS])
+        load_cell(i, j);
+
+    u -= (float)i;
+    v -= (float)j;
+
+    return hmap.z00 + u * (hmap.dx + v * hmap.dxy) + v * hmap.dy;
+}
+
+status_code_t height_map_command (char *args)
+{
+    status_code_t retval = Status_OK;
+
+    if(*args == '\0') {
+        hal.stream.write("[HMAP:");
+        hal.stream.write(hmap.enabled ? "1" : "0");
+        hal.stream.write("]" ASCII_EOL);
+    } else if(strcmp(args, "=0") && strcmp(args, "=1"))
+        retval = Status_InvalidStatement;
+    else if(sys.state != STATE_IDLE)
+        retval = Status_IdleError;
+    else if(args[1] == '1' && !probe_grid_get())
+        retval = Status_SettingDisabled; // No grid probed
+    else
+        hmap.enabled = args[1] == '1'; // Applied from the next motion on
+
+    return retval;
+}
+
+#endif
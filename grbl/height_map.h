@@ -0,0 +1,49 @@
+/*
+  height_map.h - Z compensation from a probed height map
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _HEIGHT_MAP_H_
+#define _HEIGHT_MAP_H_
+
+#ifdef ENABLE_HEIGHT_MAP
+
+// Number of line segments per grid cell spacing long XY motions are subdivided into.
+#ifndef HEIGHT_MAP_SEGMENTS_PER_CELL
+  #define HEIGHT_MAP_SEGMENTS_PER_CELL 2
+#endif
+
+// Returns true if compensation is enabled and a probed grid is available.
+bool height_map_active (void);
+
+// Returns the Z offset at the XY position (machine coordinates, mm), relative to the first grid point.
+// Positions outside the grid get the offset at the nearest grid edge. Only valid when active.
+float height_map_offset (float *position);
+
+// Returns the max length of a XY segment (mm) motions are subdivided into. Only valid when active.
+float height_map_segment_length (void);
+
+// Drops the lookup data computed for the current grid, called when the grid is cleared or reprobed.
+void height_map_invalidate (void);
+
+// Handles $HMAP=1, $HMAP=0 and $HMAP, enables, disables or reports compensation.
+status_code_t height_map_command (char *args);
+
+#endif
+
+#endif
@@ -0,0 +1,154 @@
+/*
+  hooks.c - registry for plugin hooks called from the core, dispatched in priority order
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+/*
+  Plugins used to extend the core by saving a HAL function pointer and replacing it with their own that calls the
+  saved one, so each call of a hook became a chain of indirect calls and a plugin could only unhook itself if no
+  other plugin had hooked in later. Here subscribers are kept in a compact array per hook, sorted by priority, with
+  a bit per subscriber set when enabled. Dispatch walks the enabled bits only and skips hooks with no subscribers.
+*/
+
+typedef struct {
+    hook_fn_t fn;
+    uint8_t priority;
+    bool enabled;
+} hook_entry_t;
+
+typedef struct {
+    uint8_t count;
+    uint8_t enabled; // Bit per entry, set when the entry is enabled.
+    hook_entry_t entry[HOOK_SUBSCRIBERS_MAX];
+} hook_list_t;
+
+static hook_list_t hooks[Hook_N] = {0};
+
+static void update_enabled (hook_list_t *list)
+{
+    uint_fast8_t idx = list->count, enabled = 0;
+
+    while(idx) {
+        idx--;
+        enabled = (enabled << 1) | (list->entry[idx].enabled ? 1 : 0);
+    }
+
+    list->enabled = enabled;
+}
+
+// NOTE: Subscribers are identified by the function pointer, all union members have the same representation.
+static int_fast8_t find_entry (hook_list_t *list, hook_fn_t fn)
+{
+    int_fast8_t idx;
+
+    for(idx = 0; idx < list->count; idx++) {
+        if(list->entry[idx].fn.execute_realtime == fn.execute_realtime)
+            return idx;
+    }
+
+    return -1;
+}
+
+bool hook_register (hook_id_t id, hook_fn_t fn, uint8_t priority, bool enable)
+{
+    hook_list_t *list = &hooks[id];
+    uint_fast8_t idx;
+
+    if(find_entry(list, fn) >= 0)
+        return hook_enable(id, fn, enable);
+
+    if(list->count == HOOK_SUBSCRIBERS_MAX)
+        return false;
+
+    // Insert after entries with the same or lower priority value.
+    for(idx = list->count; idx && list->entry[idx - 1].priority > priority; idx--)
+        list->entry[idx] = list->entry[idx - 1];
+
+    list->entry[idx].fn = fn;
+    list->entry[idx].priority = priority;
+    list->entry[idx].enabled = enable;
+    list->count++;
+
+    update_enabled(list);
+
+    return true;
+}
+
+bool hook_enable (hook_id_t id, hook_fn_t fn, bool enable)
+{
+    hook_list_t *list = &hooks[id];
+    int_fast8_t idx = find_entry(list, fn);
+
+    if(idx >= 0) {
+        list->entry[idx].enabled = enable;
+        update_enabled(list);
+    }
+
+    return idx >= 0;
+}
+
+bool hook_active (hook_id_t id)
+{
+    return hooks[id].enabled != 0;
+}
+
+void hooks_execute_realtime (uint_fast16_t state)
+{
+    uint_fast8_t enabled = hooks[Hook_ExecuteRealtime].enabled;
+    hook_entry_t *entry = hooks[Hook_ExecuteRealtime].entry;
+
+    for(; enabled; enabled >>= 1, entry++) {
+        if(enabled & 1)
+            entry->fn.execute_realtime(state);
+    }
+}
+
+void hooks_motion_phase (motion_phase_t phase)
+{
+    uint_fast8_t enabled = hooks[Hook_MotionPhase].enabled;
+    hook_entry_t *entry = hooks[Hook_MotionPhase].entry;
+
+    for(; enabled; enabled >>= 1, entry++) {
+        if(enabled & 1)
+            entry->fn.motion_phase(phase);
+    }
+}
+
+void hooks_job_end (const job_counters_t *job)
+{
+    uint_fast8_t enabled = hooks[Hook_JobEnd].enabled;
+    hook_entry_t *entry = hooks[Hook_JobEnd].entry;
+
+    for(; enabled; enabled >>= 1, entry++) {
+        if(enabled & 1)
+            entry->fn.job_end(job);
+    }
+}
+
+void hooks_check_mode_motion (float *target, plan_line_data_t *pl_data)
+{
+    uint_fast8_t enabled = hooks[Hook_CheckModeMotion].enabled;
+    hook_entry_t *entry = hooks[Hook_CheckModeMotion].entry;
+
+    for(; enabled; enabled >>= 1, entry++) {
+        if(enabled & 1)
+            entry->fn.check_mode_motion(target, pl_data);
+    }
+}
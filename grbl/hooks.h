@@ -0,0 +1,70 @@
+/*
+  hooks.h - registry for plugin hooks called from the core, dispatched in priority order
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _HOOKS_H_
+#define _HOOKS_H_
+
+// Max number of subscribers per hook, 8 at most.
+#ifndef HOOK_SUBSCRIBERS_MAX
+  #define HOOK_SUBSCRIBERS_MAX 4
+#endif
+
+#if HOOK_SUBSCRIBERS_MAX > 8
+#error "HOOK_SUBSCRIBERS_MAX must be 8 or less!"
+#endif
+
+/*
+  Hooks are called from the foreground process only. Hooks in the step ISR path, such as hal.stepper_pulse_start,
+  are not dispatched from the registry as each subscriber would add to the worst case ISR time, these are provided
+  by the driver as before.
+*/
+typedef enum {
+    Hook_ExecuteRealtime = 0, // Called from protocol_execute_realtime() after hal.execute_realtime.
+    Hook_MotionPhase,         // Called from st_prep_buffer() when the motion phase changes, after hal.stepper_motion_phase.
+    Hook_JobEnd,              // Called when a job ends with the job statistics, jobs is 1 at program end and aborted is 1 on reset.
+    Hook_CheckModeMotion,     // Called from mc_line() in check mode with the target in machine coordinates, before the soft limit check.
+    Hook_N
+} hook_id_t;
+
+typedef union {
+    void (*execute_realtime)(uint_fast16_t state);
+    void (*motion_phase)(motion_phase_t phase);
+    void (*job_end)(const job_counters_t *job);
+    void (*check_mode_motion)(float *target, plan_line_data_t *pl_data);
+} hook_fn_t;
+
+// Adds a subscriber to a hook, subscribers with a lower priority value are called first and in order of registration
+// when equal. A subscriber may be registered disabled and enabled when needed. Returns false if the hook is full.
+// NOTE: Must be called on startup, e.g. from a plugin init function, or from the foreground process.
+bool hook_register (hook_id_t id, hook_fn_t fn, uint8_t priority, bool enable);
+
+// Enables or disables a registered subscriber, returns false if not registered.
+bool hook_enable (hook_id_t id, hook_fn_t fn, bool enable);
+
+// Returns true if a hook has enabled subscribers.
+bool hook_active (hook_id_t id);
+
+// Calls the enabled subscribers of the hook in priority order.
+void hooks_execute_realtime (uint_fast16_t state);
+void hooks_motion_phase (motion_phase_t phase);
+void hooks_job_end (const job_counters_t *job);
+void hooks_check_mode_motion (float *target, plan_line_data_t *pl_data);
+
+#endif
@@ -0,0 +1,233 @@
+/*
+  job_stats.c - persistent job statistics, runtime, spindle-on time, distance per axis and alarm counts
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "grbl.h"
+
+#ifdef ENABLE_JOB_STATS
+
+/*
+  A job starts with the first step segment executed outside homing and jogging and ends at M2 or M30, or as
+  aborted by a reset. Segments are counted when the stepper driver has completed them, so segments retracted
+  for a feed hold or discarded by a reset are not. Each segment adds its time and the distance of each axis,
+  from the fraction of the block steps it executes, to small accumulators that are folded into the job counters once a second of motion has
+  been accumulated. This keeps the per segment cost to a few float operations and the counters precise over long
+  jobs. Distances are motor distances, for kinematics such as CoreXY these differ from the cartesian distances.
+
+  When a job ends it is added to the totals, Hook_JobEnd subscribers are called with the job counters, and the
+  totals are written back as a single checksummed area after the macro store or the driver area. With EEPROM
+  emulation the write is deferred by the write-behind mechanism until the machine has been idle for a while.
+  Alarms are counted immediately and written back on the next job end or reset. The totals are kept in RAM only
+  if persistent storage is not large enough.
+*/
+
+static struct {
+    uint32_t address;       // Persistent storage address, 0 if not persisted
+    bool active;            // A job is running
+    bool dirty;             // Totals changed since last written
+    uint32_t started;       // ms
+    job_counters_t total;
+    job_counters_t job;     // Current job, or the last job if not active
+    struct {
+        float motion_time;  // s
+        float spindle_time; // s
+        float distance[N_AXIS]; // mm
+    } acc;
+} stats = {0};
+
+static void fold (void)
+{
+    uint_fast8_t idx = N_AXIS;
+    uint32_t s;
+
+    s = (uint32_t)stats.acc.motion_time;
+    stats.job.motion_time += s;
+    stats.acc.motion_time -= (float)s;
+
+    s = (uint32_t)stats.acc.spindle_time;
+    stats.job.spindle_time += s;
+    stats.acc.spindle_time -= (float)s;
+
+    do {
+        idx--;
+        stats.job.distance[idx] += stats.acc.distance[idx] * 0.001f;
+        stats.acc.distance[idx] = 0.0f;
+    } while(idx);
+}
+
+static void write_totals (void)
+{
+    stats.dirty = false;
+
+    if(stats.address)
+        hal.eeprom.memcpy_to_with_checksum(stats.address, (uint8_t *)&stats.total, sizeof(job_counters_t));
+}
+
+static void job_end (bool completed)
+{
+    uint_fast8_t idx = N_AXIS;
+
+    if(stats.active) {
+        fold();
+        if(hal.get_elapsed_ticks)
+            stats.job.run_time = (hal.get_elapsed_ticks() - stats.started) / 1000;
+    } else // No motion since the last job ended.
+        memset(&stats.job, 0, sizeof(job_counters_t));
+
+    if(completed)
+        stats.job.jobs = 1;
+    else
+        stats.job.aborted = 1;
+
+    stats.total.jobs += stats.job.jobs;
+    stats.total.aborted += stats.job.aborted;
+    stats.total.run_time += stats.job.run_time;
+    stats.total.motion_time += stats.job.motion_time;
+    stats.total.spindle_time += stats.job.spindle_time;
+    do {
+        idx--;
+        stats.total.distance[idx] += stats.job.distance[idx];
+    } while(idx);
+
+    stats.active = false;
+
+    hooks_job_end(&stats.job);
+
+    write_totals();
+}
+
+void job_stats_segment (const float *distance, float fraction, float dt, bool spindle_on)
+{
+    if(sys.state & (STATE_HOMING|STATE_JOG))
+        return;
+
+    uint_fast8_t idx = N_AXIS;
+
+    if(!stats.active) {
+        stats.active = true;
+        stats.started = hal.get_elapsed_ticks ? hal.get_elapsed_ticks() : 0;
+        memset(&stats.job, 0, sizeof(job_counters_t));
+    }
+
+    dt *= 60.0f;
+    stats.acc.motion_time += dt;
+    if(spindle_on)
+        stats.acc.spindle_time += dt;
+
+    do {
+        idx--;
+        stats.acc.distance[idx] += fraction * distance[idx];
+    } while(idx);
+
+    if(stats.acc.motion_time >= 1.0f)
+        fold();
+}
+
+void job_stats_program_end (void)
+{
+    job_end(true);
+}
+
+void job_stats_alarm (alarm_code_t alarm)
+{
+    if(alarm != Alarm_HomingRequried) {
+        stats.total.alarms++;
+        if(stats.active)
+            stats.job.alarms++;
+        stats.dirty = true;
+    }
+}
+
+void job_stats_reset (void)
+{
+    if(stats.active)
+        job_end(false);
+    else if(stats.dirty)
+        write_totals();
+}
+
+static void report_counters (const char *name, job_counters_t *counters)
+{
+    uint_fast8_t idx;
+
+    hal.stream.write("[STATS:");
+    hal.stream.write(name);
+    hal.stream.write(",");
+    hal.stream.write(uitoa(counters->jobs));
+    hal.stream.write(",");
+    hal.stream.write(uitoa(counters->aborted));
+    hal.stream.write(",");
+    hal.stream.write(uitoa(counters->alarms));
+    hal.stream.write(",");
+    hal.stream.write(uitoa(counters->run_time));
+    hal.stream.write(",");
+    hal.stream.write(uitoa(counters->motion_time));
+    hal.stream.write(",");
+    hal.stream.write(uitoa(counters->spindle_time));
+    for(idx = 0; idx < N_AXIS; idx++) {
+        hal.stream.write(",");
+        hal.stream.write(ftoa(counters->distance[idx], 3));
+    }
+    hal.stream.write("]" ASCII_EOL);
+}
+
+status_code_t job_stats_command (char *args)
+{
+    status_code_t retval = Status_OK;
+
+    if(*args == '\0') {
+        report_counters("TOTAL", &stats.total);
+        report_counters(stats.active ? "JOB" : "LAST", &stats.job);
+    } else if(!strcmp(args, "=0")) {
+        if(sys.state == STATE_IDLE || sys.state == STATE_ALARM) {
+            memset(&stats.total, 0, sizeof(job_counters_t));
+            write_totals();
+        } else
+            retval = Status_IdleError;
+    } else
+        retval = Status_InvalidStatement;
+
+    return retval;
+}
+
+uint32_t job_stats_storage_address (void)
+{
+    return stats.address;
+}
+
+void job_stats_init (void)
+{
+    uint32_t address = hal.eeprom.driver_area.address >= GRBL_EEPROM_SIZE
+                        ? hal.eeprom.driver_area.address + hal.eeprom.driver_area.size + EEPROM_CHECKSUM_SIZE
+                        : GRBL_EEPROM_SIZE;
+
+#ifdef ENABLE_MACROS
+    if(macros_storage_address())
+        address = macros_storage_address() + MACRO_STORE_SIZE + EEPROM_CHECKSUM_SIZE;
+#endif
+
+    stats.address = hal.eeprom.type != EEPROM_None && address + sizeof(job_counters_t) + EEPROM_CHECKSUM_SIZE <= hal.eeprom.size ? address : 0;
+
+    if(!(stats.address && hal.eeprom.memcpy_from_with_checksum((uint8_t *)&stats.total, stats.address, sizeof(job_counters_t))))
+        memset(&stats.total, 0, sizeof(job_counters_t));
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+  job_stats.h - persistent job statistics, runtime, spindle-on time, distance per axis and alarm counts
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _JOB_STATS_H_
+#define _JOB_STATS_H_
+
+// Defined regardless of ENABLE_JOB_STATS as it is passed to Hook_JobEnd subscribers.
+typedef struct {
+    uint32_t jobs;              // Programs ended by M2 or M30
+    uint32_t aborted;           // Jobs ended by a reset
+    uint32_t alarms;            // Alarms raised, excluding homing required
+    uint32_t run_time;          // s, from the first motion of a job to its end, 0 if the driver has no ms tick
+    uint32_t motion_time;       // s, time moving
+    uint32_t spindle_time;      // s, time moving with the spindle on
+    float distance[N_AXIS];     // m, distance travelled per axis
+} job_counters_t;
+
+#ifdef ENABLE_JOB_STATS
+
+// Loads the totals from persistent storage, called once at boot after the settings and macros are loaded.
+void job_stats_init (void);
+
+// Adds an executed step segment covering fraction of a block with the given axis distances and taking dt minutes,
+// called from st_prep_buffer() when the stepper driver has completed the segment.
+void job_stats_segment (const float *distance, float fraction, float dt, bool spindle_on);
+
+// Ends the job on program end (M2, M30), adds it to the totals and writes them back.
+void job_stats_program_end (void);
+
+// Counts an alarm, called when the alarm is reported.
+void job_stats_alarm (alarm_code_t alarm);
+
+// Ends an active job as aborted and writes back the totals if changed, called on reset.
+void job_stats_reset (void);
+
+// Handles $STATS and $STATS=0, reports the totals and the current or last job or clears the totals.
+status_code_t job_stats_command (char *args);
+
+// Returns the persistent storage address of the totals, 0 if they are kept in RAM only.
+uint32_t job_stats_storage_address (void);
+
+#endif
+
+#endif
@@ -0,0 +1,190 @@
+/*
+  kinematics.c - adaptive line segmentation for non-linear kinematics
+
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "grbl.h"
+
+#ifdef KINEMATICS_API
+
+/*
+  The stepper moves the motors linearly from the start to the end of each block, for non-linear kinematics
+  the tool then deviates from the programmed line. kinematics_segment_line() splits lines so that the
+  deviation estimated by kinematics.segment_error() for each segment stays within settings.arc_tolerance.
+  Segments are long where the mapping is nearly linear and short near singularities, the deviation grows
+  with the square of the segment length so the next length tried is scaled by the root of the error ratio.
+  Lines are split in segments of KINEMATICS_SEGMENT_MAX_LENGTH if no error estimate is provided.
+*/
+
+#define SEGMENT_RETRIES 6
+
+static struct {
+    bool segmented;
+    bool pending;               // A segment remains to be returned
+    float origin[N_AXIS];       // Start of the line
+    float start[N_AXIS];        // Start of the next segment
+    float end[N_AXIS];
+    float delta[N_AXIS];
+    float t;                    // Fraction of the line completed
+    float dt_max, dt_min;       // Segment length limits as a fraction of the line
+    float dt;                   // Fraction to try for the next segment
+    float feed_rate;            // Inverse time feed rate for the whole line
+} seg;
+
+static inline float segment_error (float *start, float *end)
+{
+    return kinematics.segment_error ? kinematics.segment_error(start, end) : 0.0f;
+}
+
+// Call with init set to start a line, then until false is returned for the targets to queue in turn.
+bool kinematics_segment_line (float *target, plan_line_data_t *pl_data, bool init)
+{
+    uint_fast8_t idx;
+
+    if(init) {
+
+        float length = 0.0f, error = 0.0f;
+
+        plan_get_planner_mpos(seg.origin);
+        memcpy(seg.start, seg.origin, sizeof(seg.start));
+        memcpy(seg.end, target, sizeof(seg.end));
+
+        idx = N_AXIS;
+        do {
+            idx--;
+            seg.delta[idx] = seg.end[idx] - seg.origin[idx];
+            length += seg.delta[idx] * seg.delta[idx];
+        } while(idx);
+
+        length = sqrtf(length);
+
+        seg.segmented = !(pl_data->condition.rapid_motion || pl_data->condition.jog_motion) &&
+                         length > KINEMATICS_SEGMENT_MIN_LENGTH &&
+                          (length > KINEMATICS_SEGMENT_MAX_LENGTH || (error = segment_error(seg.origin, seg.end)) > settings.arc_tolerance);
+
+        if(seg.segmented) {
+            seg.t = 0.0f;
+            seg.dt_max = min(1.0f, KINEMATICS_SEGMENT_MAX_LENGTH / length);
+            seg.dt_min = KINEMATICS_SEGMENT_MIN_LENGTH / length;
+            seg.dt = error > settings.arc_tolerance ? max(seg.dt_min, 0.9f * sqrtf(settings.arc_tolerance / error)) : seg.dt_max;
+            seg.feed_rate = pl_data->feed_rate;
+        }
+
+        return seg.pending = true;
+    }
+
+    if(!seg.pending)
+        return false;
+
+    if(!seg.segmented) {
+        seg.pending = false;
+        return true;
+    }
+
+    uint_fast8_t retries = SEGMENT_RETRIES;
+    float t, dt = seg.dt, error;
+
+    while(true) {
+
+        if((t = seg.t + dt) >= 1.0f - seg.dt_min * 0.5f) {
+            t = 1.0f;
+            dt = 1.0f - seg.t;
+            memcpy(target, seg.end, sizeof(seg.end));
+        } else {
+            idx = N_AXIS;
+            do {
+                idx--;
+                target[idx] = seg.origin[idx] + seg.delta[idx] * t;
+            } while(idx);
+        }
+
+        if(dt <= seg.dt_min || !--retries || (error = segment_error(seg.start, target)) <= settings.arc_tolerance)
+            break;
+
+        dt = max(seg.dt_min, dt * max(0.25f, 0.9f * sqrtf(settings.arc_tolerance / error)));
+    }
+
+    // Inverse time feed rate is for the whole line, each segment takes its share of the time.
+    if(pl_data->condition.inverse_time)
+        pl_data->feed_rate = seg.feed_rate / dt;
+
+    memcpy(seg.start, target, sizeof(seg.start));
+    seg.t = t;
+    seg.dt = min(seg.dt_max, dt * 2.0f);
+    seg.pending = t < 1.0f;
+
+    return true;
+}
+
+static inline float cable_length (float *motor, float *position)
+{
+    float dx = position[X_AXIS] - motor[X_AXIS], dy = position[Y_AXIS] - motor[Y_AXIS];
+
+    return sqrtf(dx * dx + dy * dy);
+}
+
+static inline float cable_excess (float *motor, float *start, float *end, float d2, float l_mid)
+{
+    float l0 = cable_length(motor, start), l1 = cable_length(motor, end);
+
+    return (d2 - (l0 - l1) * (l0 - l1)) / (2.0f * (l0 + l1 + 2.0f * l_mid));
+}
+
+// Deviation estimate for kinematics driving the tool point by two cables or chains from the motors at
+// motor_a and motor_b in the XY plane. With linear interpolation of the cable lengths each cable is
+// (|d|^2 - (La - Lb)^2) / (2 * (La + Lb + 2 * Lm)) longer at the midpoint of the segment than needed,
+// d being the XY distance and La, Lb and Lm the lengths at the start, the end and the midpoint. This is
+// exact for the midpoint and free of cancellation, the position error is this excess transformed by the
+// inverse of the Jacobian at the midpoint. It grows without bound as the cables become collinear.
+float kinematics_cable_error (float *motor_a, float *motor_b, float *start, float *end)
+{
+    float dx = end[X_AXIS] - start[X_AXIS], dy = end[Y_AXIS] - start[Y_AXIS], d2 = dx * dx + dy * dy;
+
+    if(d2 == 0.0f)
+        return 0.0f;
+
+    float mx = start[X_AXIS] + dx * 0.5f, my = start[Y_AXIS] + dy * 0.5f;
+    float ax = mx - motor_a[X_AXIS], ay = my - motor_a[Y_AXIS], bx = mx - motor_b[X_AXIS], by = my - motor_b[Y_AXIS];
+    float lma = sqrtf(ax * ax + ay * ay), lmb = sqrtf(bx * bx + by * by);
+    float ea, eb, det;
+
+    if(lma < 1e-3f || lmb < 1e-3f)
+        return INFINITY;
+
+    ea = cable_excess(motor_a, start, end, d2, lma);
+    eb = cable_excess(motor_b, start, end, d2, lmb);
+
+    // Rows of the Jacobian are the cable directions, solve J * e_xy = (ea, eb).
+    ax /= lma;
+    ay /= lma;
+    bx /= lmb;
+    by /= lmb;
+
+    if(fabsf(det = ax * by - ay * bx) < 1e-6f)
+        return INFINITY;
+
+    dx = (ea * by - ay * eb) / det;
+    dy = (ax * eb - bx * ea) / det;
+
+    return sqrtf(dx * dx + dy * dy);
+}
+
+#endif
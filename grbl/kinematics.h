@@ -22,10 +22,19 @@
 #ifndef _kinematics_h_
 #define _kinematics_h_
 
+// Segment length limits for kinematics_segment_line(), in mm
+#ifndef KINEMATICS_SEGMENT_MAX_LENGTH
+#define KINEMATICS_SEGMENT_MAX_LENGTH 25.0f
+#endif
+#ifndef KINEMATICS_SEGMENT_MIN_LENGTH
+#define KINEMATICS_SEGMENT_MIN_LENGTH 0.1f
+#endif
+
 typedef struct {
     void (*convert_array_steps_to_mpos)(float *position, int32_t *steps);
     void (*plan_target_to_steps) (int32_t *target_steps, float *target);
     bool (*segment_line) (float *target, plan_line_data_t *pl_data, bool init);
+    float (*segment_error) (float *start, float *end); // Optional, largest distance in mm from the line start - end when moved as a single block
     uint_fast8_t (*limits_get_axis_mask)(uint_fast8_t idx);
     void (*limits_set_target_pos)(uint_fast8_t idx);
     void (*limits_set_machine_positions)(axes_signals_t cycle);
@@ -33,4 +42,7 @@ typedef struct {
 
 extern kinematics_t kinematics;
 
+bool kinematics_segment_line (float *target, plan_line_data_t *pl_data, bool init);
+float kinematics_cable_error (float *motor_a, float *motor_b, float *start, float *end);
+
 #endif
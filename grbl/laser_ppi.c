@@ -0,0 +1,119 @@
+/*
+  laser_ppi.c - laser PPI (pulses per inch) mode, pulses timed from the step segments
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_LASER_PPI
+
+/*
+  In PPI mode the laser fires a pulse of fixed length every 1/PPI inch of travel, the power of each pulse
+  is the programmed S value. Pulse positions are tracked along the path as distance to the next pulse
+  by the segment generator. A step segment moves at constant speed, so the pulses within it are evenly
+  spaced in time: the first after ppi_delay and then every ppi_period stepper timer cycles. These are
+  handed to the driver by hal.laser_pulse_train() when the segment is loaded, the driver times the
+  pulses by a timer and a one-shot for the pulse length. The stepper driver interrupt is not involved
+  in the pulse generation and the pulse positions do not depend on the step resolution.
+*/
+
+static struct {
+    float ppi;                  // Pulses per inch
+    float spacing;              // Distance between pulses (mm)
+    float next;                 // Distance from the end of the last segment prepped to the next pulse (mm)
+    uint_fast16_t pulse_length; // Pulse length (us)
+} ppi = {
+    .ppi = 600.0f,
+    .spacing = 25.4f / 600.0f
+};
+
+bool laser_ppi_configure (float ppi_value, uint_fast16_t pulse_length)
+{
+    if(hal.laser_pulse_train == NULL || ppi_value <= 0.0f)
+        return false;
+
+    ppi.ppi = ppi_value;
+    ppi.spacing = 25.4f / ppi_value;
+    ppi.pulse_length = pulse_length;
+    ppi.next = 0.0f;
+
+    gc_set_laser_ppimode(pulse_length != 0);
+
+    return true;
+}
+
+void laser_ppi_segment (segment_t *segment, bool on, uint32_t n_tick, float ticks_per_mm, uint32_t cycles_per_tick)
+{
+    if(!(on && ppi.pulse_length) || n_tick == 0) {
+        // Laser is off, the first pulse when switched on is at the start of the burn.
+        segment->ppi_period = 0;
+        if(n_tick)
+            ppi.next = 0.0f;
+        return;
+    }
+
+    float cycles_per_mm = ticks_per_mm * (float)cycles_per_tick;
+    uint32_t cycles = n_tick * cycles_per_tick, delay;
+
+    segment->ppi_delay = delay = (uint32_t)(ppi.next * cycles_per_mm);
+    segment->ppi_period = max(1, (uint32_t)(ppi.spacing * cycles_per_mm));
+    segment->ppi_pulse_length = ppi.pulse_length;
+
+    // Distance from the segment end to the next pulse, tracked in timer cycles as the driver fires them:
+    // a pulse at or after the segment end is left to the next segment.
+    if(delay < cycles)
+        delay += ((cycles - 1 - delay) / segment->ppi_period + 1) * segment->ppi_period;
+
+    ppi.next = (float)(delay - cycles) / cycles_per_mm;
+}
+
+status_code_t laser_ppi_command (char *args)
+{
+    status_code_t retval = Status_OK;
+
+    if(*args == '\0') {
+        hal.stream.write("[PPI:");
+        hal.stream.write(ftoa(ppi.ppi, 1));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(gc_state.is_laser_ppi_mode ? ppi.pulse_length : 0));
+        hal.stream.write("]" ASCII_EOL);
+    } else if(*args++ != '=')
+        retval = Status_InvalidStatement;
+    else if(sys.state != STATE_IDLE)
+        retval = Status_IdleError;
+    else if(!strcmp(args, "0"))
+        gc_set_laser_ppimode(false);
+    else {
+
+        uint_fast8_t counter = 0;
+        float ppi_value, pulse_length;
+
+        if(!read_float(args, &counter, &ppi_value) || args[counter++] != ',' || !read_float(args, &counter, &pulse_length))
+            retval = Status_BadNumberFormat;
+        else if(args[counter] != '\0')
+            retval = Status_InvalidStatement;
+        else if(ppi_value <= 0.0f || pulse_length < 0.0f)
+            retval = Status_NegativeValue;
+        else if(!laser_ppi_configure(ppi_value, (uint_fast16_t)pulse_length))
+            retval = Status_SettingDisabled;
+    }
+
+    return retval;
+}
+
+#endif
@@ -0,0 +1,42 @@
+/*
+  laser_ppi.h - laser PPI (pulses per inch) mode, pulses timed from the step segments
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _LASER_PPI_H_
+#define _LASER_PPI_H_
+
+#ifdef ENABLE_LASER_PPI
+
+// Sets the pulse density and the pulse length in microseconds, a pulse length of 0 switches PPI mode off.
+// Returns false if the driver does not provide hal.laser_pulse_train.
+bool laser_ppi_configure (float ppi, uint_fast16_t pulse_length);
+
+// Computes the pulse timing of a step segment of n_tick stepper interrupts of ticks_per_mm interrupts per mm
+// and cycles_per_tick stepper timer cycles per interrupt. No pulses are scheduled unless on is true.
+void laser_ppi_segment (segment_t *segment, bool on, uint32_t n_tick, float ticks_per_mm, uint32_t cycles_per_tick);
+
+// Returns the pulse length in microseconds, 0 if PPI mode is off.
+uint_fast16_t laser_ppi_pulse_length (void);
+
+// $PPI, $PPI=<ppi>,<pulse length> and $PPI=0 command handler, report, set or switch off PPI mode.
+status_code_t laser_ppi_command (char *args);
+
+#endif
+
+#endif
@@ -92,19 +92,20 @@ void limits_set_machine_positions (axes_signals_t cycle, bool add_pulloff)
 // the trigger point of the limit switches. The rapid stops are handled by a system level axis lock
 // mask, which prevents the stepper algorithm from executing step pulses. Homing motions typically
 // circumvent the processes for executing motions in normal operation.
+// Ganged axes in squaring are squared while homing, each motor stops on its own switch when approaching.
 // NOTE: Only the abort realtime command can interrupt this process.
-static bool limits_homing_cycle (axes_signals_t cycle)
+static bool limits_homing_cycle (axes_signals_t cycle, axes_signals_t squaring)
 {
     if (ABORTED) // Block if system reset has been issued.
         return false;
 
     bool approach = true;
     uint_fast8_t n_cycle = (2 * settings.homing.locate_cycles + 1);
-    uint_fast8_t step_pin[N_AXIS], limit_state, n_active_axis;
+    uint_fast8_t step_pin[N_AXIS], limit_state, n_active_axis, motors;
     float target[N_AXIS];
     float max_travel = 0.0f;
     float homing_rate = settings.homing.seek_rate;
-    axes_signals_t axislock;
+    axes_signals_t axislock, stopped_a = {0}, stopped_b = {0};
     plan_line_data_t plan_data;
 
     // Initialize plan data struct for homing motion.
@@ -181,6 +182,22 @@ static bool limits_homing_cycle (axes_signals_t cycle)
                 // Check limit state. Lock out cycle axes when they change.
                 limit_state = hal.limits_get_state().value;
 
+                if(squaring.mask) {
+                    // Stop the motor of a ganged axis reaching its switch, the axis is locked out when both have stopped.
+                    limit_state &= ~squaring.mask;
+                    if((motors = hal.limits_get_squaring_state(SquaringMode_A).mask & squaring.mask & ~stopped_a.mask)) {
+                        stopped_a.mask |= motors;
+                        if((motors &= ~stopped_b.mask))
+                            hal.stepper_disable_motors((axes_signals_t){ .mask = motors }, SquaringMode_B);
+                    }
+                    if((motors = hal.limits_get_squaring_state(SquaringMode_B).mask & squaring.mask & ~stopped_b.mask)) {
+                        stopped_b.mask |= motors;
+                        if((motors &= ~stopped_a.mask))
+                            hal.stepper_disable_motors((axes_signals_t){ .mask = motors }, SquaringMode_A);
+                    }
+                    limit_state |= stopped_a.mask & stopped_b.mask;
+                }
+
                 idx = N_AXIS;
                 do {
                     idx--;
@@ -220,6 +237,8 @@ static bool limits_homing_cycle (axes_signals_t cycle)
                     system_set_exec_alarm(Alarm_HomingFailApproach);
 
                 if (sys_rt_exec_alarm) {
+                    if(squaring.mask)
+                        hal.stepper_disable_motors(squaring, SquaringMode_Both);
                     mc_reset(); // Stop motors, if they are running.
                     protocol_execute_realtime();
                     return false;
@@ -235,6 +254,12 @@ static bool limits_homing_cycle (axes_signals_t cycle)
         st_reset(); // Immediately force kill steppers and reset step segment buffer.
         hal.delay_ms(settings.homing.debounce_delay, 0); // Delay to allow transient dynamics to dissipate.
 
+        // Ganged motors stopped independently move together again for the pull-off.
+        if(squaring.mask) {
+            hal.stepper_disable_motors(squaring, SquaringMode_Both);
+            stopped_a.mask = stopped_b.mask = 0;
+        }
+
         // Reverse direction and reset homing rate for locate cycle(s).
         approach = !approach;
 
@@ -262,7 +287,7 @@ static bool limits_homing_cycle (axes_signals_t cycle)
 #endif
 
 #ifdef ENABLE_BACKLASH_COMPENSATION
-    mc_backlash_init();
+    plan_backlash_init();
 #endif
     sys.step_control.flags = 0; // Return step control to normal operation.
     sys.homed.mask |= cycle.mask;
@@ -270,6 +295,256 @@ static bool limits_homing_cycle (axes_signals_t cycle)
     return true;
 }
 
+#if defined(HOMING_CONCURRENT_CYCLES) && !defined(KINEMATICS_API)
+
+typedef enum {
+    HomingPhase_Idle = 0, // Axis not in cycle
+    HomingPhase_Seek,
+    HomingPhase_Pulloff,
+    HomingPhase_Locate,
+    HomingPhase_Done      // Last locate completed, waiting for the final pull-off
+} homing_phase_t;
+
+typedef struct {
+    homing_phase_t phase;
+    bool approach;
+    uint_fast8_t locate_cycles;
+    int32_t start;      // Position at the start of the phase in steps
+    int32_t distance;   // Max travel of the phase in steps
+    float rate;         // Phase rate in mm/min
+} homing_axis_t;
+
+// Sets up the next homing phase of an axis: seek, then pull-off and locate for each locate cycle.
+static void homing_axis_next_phase (homing_axis_t *axis, uint_fast8_t idx, float max_travel)
+{
+    float distance = 0.0f;
+
+    switch(axis->phase) {
+
+        case HomingPhase_Idle:
+            axis->phase = HomingPhase_Seek;
+            axis->locate_cycles = settings.homing.locate_cycles;
+            axis->rate = settings.homing.seek_rate;
+            distance = max_travel;
+            break;
+
+        case HomingPhase_Pulloff:
+            axis->phase = HomingPhase_Locate;
+            axis->rate = settings.homing.feed_rate;
+            distance = settings.homing.pulloff * HOMING_AXIS_LOCATE_SCALAR;
+            break;
+
+        default:
+            if(axis->locate_cycles) {
+                axis->locate_cycles--;
+                axis->phase = HomingPhase_Pulloff;
+                axis->rate = settings.homing.seek_rate;
+                distance = settings.homing.pulloff;
+            } else
+                axis->phase = HomingPhase_Done;
+            break;
+    }
+
+    axis->approach = axis->phase != HomingPhase_Pulloff;
+    axis->start = sys_position[idx];
+    axis->distance = max(1, (int32_t)lroundf(distance * settings.steps_per_mm[idx]));
+}
+
+// Executes a homing motion until it completes or one of the approaching axes triggers its switch.
+// Returns the approaching axes latched, sys_rt_exec_alarm is set on failure.
+static axes_signals_t homing_execute (float *target, plan_line_data_t *plan_data, axes_signals_t axes, axes_signals_t approach)
+{
+    uint8_t rt_exec;
+    axes_signals_t latched = {0};
+
+    sys.homing_axis_lock.mask = axes.mask;
+
+    plan_buffer_line(target, plan_data); // Bypass mc_line(). Directly plan homing motion.
+
+    sys.step_control.flags = 0;
+    sys.step_control.execute_sys_motion = On; // Set to execute homing motion and clear existing flags.
+    st_prep_buffer(); // Prep and fill segment buffer from newly planned block.
+    st_wake_up(); // Initiate motion
+
+    do {
+        // Check limit state. Lock out approaching axes when their switch is triggered.
+        if((latched.mask = hal.limits_get_state().mask & approach.mask)) {
+            sys.homing_axis_lock.mask &= ~latched.mask;
+            break;
+        }
+
+        st_prep_buffer(); // Check and prep segment buffer. NOTE: Should take no longer than 200us.
+
+        // Exit routines: No time to run protocol_execute_realtime() in this loop.
+        if ((rt_exec = sys_rt_exec_state) & (EXEC_SAFETY_DOOR | EXEC_RESET)) {
+
+            // Homing failure condition: Reset issued during cycle.
+            if (rt_exec & EXEC_RESET)
+                system_set_exec_alarm(Alarm_HomingFailReset);
+
+            // Homing failure condition: Safety door was opened.
+            if (rt_exec & EXEC_SAFETY_DOOR)
+                system_set_exec_alarm(Alarm_HomingFailDoor);
+        }
+
+    } while (!(sys_rt_exec_alarm || (sys_rt_exec_state & EXEC_CYCLE_COMPLETE)));
+
+    st_reset(); // Immediately force kill steppers and reset step segment buffer.
+    system_clear_exec_state_flag(EXEC_CYCLE_COMPLETE);
+
+    return latched;
+}
+
+// Homes the cycle axes concurrently, each axis runs its seek, pull-off and locate phases independently
+// at its own rate. The motion is restarted with new directions and rates each time an axis latches its
+// switch or completes a pull-off, the final pull-off is then performed for all axes together.
+// NOTE: The axes still moving are stopped abruptly on a restart, as the latched axis is. Steps lost on
+//       these stops are of no consequence as all axes locate their switch again after the seek.
+static bool limits_homing_cycle_concurrent (axes_signals_t cycle)
+{
+    if (ABORTED) // Block if system reset has been issued.
+        return false;
+
+    uint_fast8_t idx, n_active_axis = 0;
+    int32_t remaining;
+    float target[N_AXIS], delta, time, feed_rate, max_travel = 0.0f;
+    axes_signals_t active, approach, latched, limit_state;
+    homing_axis_t axis[N_AXIS] = {0};
+    plan_line_data_t plan_data;
+
+    // Initialize plan data struct for homing motion.
+
+    memset(&plan_data, 0, sizeof(plan_line_data_t));
+    plan_data.condition.system_motion = On;
+    plan_data.condition.no_feed_override = On;
+    plan_data.line_number = HOMING_CYCLE_LINE_NUMBER;
+    memcpy(&plan_data.spindle, &gc_state.spindle, sizeof(spindle_t));
+    plan_data.condition.spindle = gc_state.modal.spindle;
+    plan_data.condition.coolant = gc_state.modal.coolant;
+
+    // Set search distance based on max_travel setting. Ensure homing switches engaged with search scalar.
+    // NOTE: settings.max_travel[] is stored as a negative value.
+    idx = N_AXIS;
+    do {
+        if (bit_istrue(cycle.mask, bit(--idx)))
+            max_travel = max(max_travel, (-HOMING_AXIS_SEARCH_SCALAR) * settings.max_travel[idx]);
+    } while(idx);
+
+    idx = N_AXIS;
+    do {
+        if (bit_istrue(cycle.mask, bit(--idx))) {
+            n_active_axis++;
+            homing_axis_next_phase(&axis[idx], idx, max_travel);
+        }
+    } while(idx);
+
+    do {
+
+        // Time until the first axis reaches the end of its phase.
+        active.mask = approach.mask = 0;
+        time = 0.0f;
+
+        idx = N_AXIS;
+        do {
+            idx--;
+            if(axis[idx].phase != HomingPhase_Idle && axis[idx].phase != HomingPhase_Done) {
+                remaining = axis[idx].distance - labs(sys_position[idx] - axis[idx].start);
+                delta = (float)remaining / (axis[idx].rate * settings.steps_per_mm[idx]);
+                if(active.mask == 0 || delta < time)
+                    time = delta;
+                active.mask |= bit(idx);
+                if(axis[idx].approach)
+                    approach.mask |= bit(idx);
+            }
+        } while(idx);
+
+        if(active.mask == 0)
+            break;
+
+        // Set the target for the active axes, each axis moves at the rate of its phase.
+        system_convert_array_steps_to_mpos(target, sys_position);
+
+        feed_rate = 0.0f;
+        idx = N_AXIS;
+        do {
+            if(active.mask & bit(--idx)) {
+                remaining = axis[idx].distance - labs(sys_position[idx] - axis[idx].start);
+                delta = min((float)remaining / settings.steps_per_mm[idx], axis[idx].rate * time);
+                feed_rate += delta * delta;
+                target[idx] += bit_istrue(settings.homing.dir_mask.value, bit(idx)) == axis[idx].approach ? - delta : delta;
+            }
+        } while(idx);
+
+        plan_data.feed_rate = sqrtf(feed_rate) / time;
+
+        latched = homing_execute(target, &plan_data, active, approach);
+
+        // Advance the axes that latched their switch or completed their travel.
+        if(!sys_rt_exec_alarm) {
+            limit_state = hal.limits_get_state();
+            idx = N_AXIS;
+            do {
+                if(active.mask & bit(--idx)) {
+                    if(latched.mask & bit(idx))
+                        homing_axis_next_phase(&axis[idx], idx, max_travel);
+                    else if(labs(sys_position[idx] - axis[idx].start) >= axis[idx].distance) {
+                        if(axis[idx].approach) // Homing failure condition: Limit switch not found during approach.
+                            system_set_exec_alarm(Alarm_HomingFailApproach);
+                        else if(limit_state.mask & bit(idx)) // Homing failure condition: Limit switch still engaged after pull-off motion.
+                            system_set_exec_alarm(Alarm_FailPulloff);
+                        else
+                            homing_axis_next_phase(&axis[idx], idx, max_travel);
+                    }
+                }
+            } while(idx);
+        }
+
+        if (!sys_rt_exec_alarm)
+            hal.delay_ms(settings.homing.debounce_delay, 0); // Delay to allow transient dynamics to dissipate.
+
+    } while(!sys_rt_exec_alarm);
+
+    // Final pull-off of all axes together at the seek rate.
+    if(!sys_rt_exec_alarm) {
+
+        system_convert_array_steps_to_mpos(target, sys_position);
+
+        idx = N_AXIS;
+        do {
+            if (bit_istrue(cycle.mask, bit(--idx)))
+                target[idx] += bit_istrue(settings.homing.dir_mask.value, bit(idx)) ? settings.homing.pulloff : - settings.homing.pulloff;
+        } while(idx);
+
+        plan_data.feed_rate = settings.homing.seek_rate * sqrtf(n_active_axis);
+
+        homing_execute(target, &plan_data, cycle, (axes_signals_t){0});
+
+        // Homing failure condition: Limit switch still engaged after pull-off motion
+        if (!sys_rt_exec_alarm && (hal.limits_get_state().mask & cycle.mask))
+            system_set_exec_alarm(Alarm_FailPulloff);
+    }
+
+    if (sys_rt_exec_alarm) {
+        mc_reset(); // Stop motors, if they are running.
+        protocol_execute_realtime();
+        return false;
+    }
+
+    hal.delay_ms(settings.homing.debounce_delay, 0);
+
+    limits_set_machine_positions(cycle, true);
+
+#ifdef ENABLE_BACKLASH_COMPENSATION
+    plan_backlash_init();
+#endif
+    sys.step_control.flags = 0; // Return step control to normal operation.
+    sys.homed.mask |= cycle.mask;
+
+    return true;
+}
+
+#endif // HOMING_CONCURRENT_CYCLES
+
 // Perform homing cycle(s) according to configuration
 bool limits_go_home (axes_signals_t cycle)
 {
@@ -279,19 +554,29 @@ bool limits_go_home (axes_signals_t cycle)
       .z = hal.driver_cap.axis_ganged_z
     };
 
-    bool homed = limits_homing_cycle(cycle);
-
     ganged.mask &= cycle.mask;
 
+    // Square ganged axes in a single cycle if the driver reports the switches of each motor.
+    if(ganged.mask && hal.stepper_disable_motors && hal.limits_get_squaring_state)
+        return limits_homing_cycle(cycle, ganged);
+
+#if defined(HOMING_CONCURRENT_CYCLES) && !defined(KINEMATICS_API)
+    // Home multiple axes concurrently, unless ganged axes are to be squared.
+    if(!ganged.mask && (cycle.mask & (cycle.mask - 1)))
+        return limits_homing_cycle_concurrent(cycle);
+#endif
+
+    bool homed = limits_homing_cycle(cycle, (axes_signals_t){0});
+
     if(homed && ganged.mask && hal.stepper_disable_motors) {
         sys.homed.mask &= ~ganged.mask;
         hal.stepper_disable_motors(ganged, SquaringMode_A);
-        if((homed = limits_homing_cycle(cycle))) {
+        if((homed = limits_homing_cycle(cycle, (axes_signals_t){0}))) {
             sys.homed.mask &= ~ganged.mask;
             hal.stepper_disable_motors(ganged, SquaringMode_B);
-            homed = limits_homing_cycle(cycle);
+            homed = limits_homing_cycle(cycle, (axes_signals_t){0});
         }
-        hal.stepper_disable_motors((axes_signals_t){0}, SquaringMode_Both);
+        hal.stepper_disable_motors(ganged, SquaringMode_Both);
     }
 
     return homed;
@@ -0,0 +1,136 @@
+/*
+  lookahead.c - tokenizes g-code blocks ahead of execution while the planner buffer is full
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_LOOKAHEAD
+
+/*
+  When the planner buffer is full executing the next line would block until a block is consumed, and the
+  text scanning and number conversion of the line would then be done while the planner is being refilled.
+  Instead the main loop keeps reading the input while the buffer is full and lines consisting of plain
+  letter and number words are tokenized into a small ring of blocks. These are executed by gc_execute_words()
+  when the planner has room, without text scanning. Their status is reported when they are executed, so
+  responses are sent in order and the flow control of the sender is not affected.
+
+  Empty and comment lines are queued too. Lines with anything else, such as system commands, O-words,
+  parameters, expressions and messages, are not tokenized ahead and the queued blocks are executed before
+  such a line is. Modal errors depend on the blocks before and are reported when the block is executed.
+*/
+
+typedef struct {
+    gc_word_t words[LOOKAHEAD_MAX_WORDS + 1];
+} lookahead_block_t;
+
+static struct {
+    uint_fast8_t head;
+    uint_fast8_t tail;
+    uint_fast8_t count;
+    lookahead_block_t block[LOOKAHEAD_BLOCKS];
+} ring;
+
+// Tokenizes a line into words terminated by a '\0' letter, returns false if the line is not plain words.
+// An empty line is tokenized as no words so that its response is sent in order.
+static bool tokenize (char *line, gc_word_t *words)
+{
+    uint_fast8_t char_counter = 0, n = 0;
+    char letter;
+
+    while((letter = line[char_counter++]) != '\0') {
+        if(letter < 'A' || letter > 'Z' || letter == 'O' || n == LOOKAHEAD_MAX_WORDS)
+            return false;
+        if(!read_float(line, &char_counter, &words[n].value))
+            return false; // Reported by the parser when the line is executed.
+        words[n++].letter = letter;
+    }
+
+    words[n].letter = '\0';
+
+    return true;
+}
+
+// Executes the oldest queued block and reports its status.
+static bool execute_next (void)
+{
+    if(ring.block[ring.tail].words[0].letter == '\0') // Empty or comment line.
+        gc_state.last_error = Status_OK;
+#if COMPATIBILITY_LEVEL == 0
+    else if(gc_state.last_error == Status_OK)
+#else
+    else
+#endif
+        gc_state.last_error = gc_execute_words(ring.block[ring.tail].words, NULL, NULL);
+
+    ring.tail = ring.tail == LOOKAHEAD_BLOCKS - 1 ? 0 : ring.tail + 1;
+    ring.count--;
+
+    hal.report.status_message(gc_state.last_error);
+
+    return protocol_execute_realtime();
+}
+
+void lookahead_reset (void)
+{
+    ring.head = ring.tail = ring.count = 0;
+}
+
+bool lookahead_queue (char *line)
+{
+    if(ring.count == LOOKAHEAD_BLOCKS || (ring.count == 0 && !plan_check_full_buffer()))
+        return false;
+
+    if(sys.state & (STATE_ALARM|STATE_ESTOP|STATE_JOG))
+        return false;
+
+#ifdef ENABLE_O_WORDS
+    if(flowctrl_recording())
+        return false;
+#endif
+
+    if(!tokenize(line, ring.block[ring.head].words))
+        return false;
+
+    ring.head = ring.head == LOOKAHEAD_BLOCKS - 1 ? 0 : ring.head + 1;
+    ring.count++;
+
+    return true;
+}
+
+bool lookahead_execute (void)
+{
+    bool ok = true;
+
+    while(ok && ring.count && !plan_check_full_buffer())
+        ok = execute_next();
+
+    return ok;
+}
+
+bool lookahead_flush (void)
+{
+    bool ok = true;
+
+    while(ok && ring.count)
+        ok = execute_next();
+
+    return ok;
+}
+
+#endif
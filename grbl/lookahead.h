@@ -0,0 +1,53 @@
+/*
+  lookahead.h - tokenizes g-code blocks ahead of execution while the planner buffer is full
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _LOOKAHEAD_H_
+#define _LOOKAHEAD_H_
+
+#ifdef ENABLE_LOOKAHEAD
+
+// Number of tokenized blocks held ahead of execution.
+#ifndef LOOKAHEAD_BLOCKS
+  #define LOOKAHEAD_BLOCKS 4
+#endif
+
+// Maximum number of words in a block held ahead, longer blocks are executed from the line.
+#ifndef LOOKAHEAD_MAX_WORDS
+  #define LOOKAHEAD_MAX_WORDS 16
+#endif
+
+// Discards all blocks held ahead, called on reset and when the input is cancelled.
+void lookahead_reset (void);
+
+// Tokenizes and queues a line as output by the line builder if the planner buffer is full or blocks are already queued.
+// Returns false if the line is not queued, queued blocks must then be executed by lookahead_flush() before the line is.
+bool lookahead_queue (char *line);
+
+// Executes queued blocks in order and reports their status as long as the planner buffer has room.
+// Returns false if a system abort occured.
+bool lookahead_execute (void);
+
+// Executes all queued blocks in order and reports their status, waiting for planner buffer room as needed.
+// Returns false if a system abort occured.
+bool lookahead_flush (void);
+
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+/*
+  machine_profile.h - compile time machine type, resolves mode and feature settings for the hot paths
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _MACHINE_PROFILE_H_
+#define _MACHINE_PROFILE_H_
+
+#define MACHINE_PROFILE_ROUTER  1
+#define MACHINE_PROFILE_LASER   2
+#define MACHINE_PROFILE_LATHE   3
+#define MACHINE_PROFILE_PLOTTER 4
+
+// PROFILE_MODE is the fixed $32 value, features not used by the machine type are 0.
+#if MACHINE_PROFILE == MACHINE_PROFILE_ROUTER
+#define PROFILE_MODE 0
+#define PROFILE_SPINDLE_SYNC 0
+#elif MACHINE_PROFILE == MACHINE_PROFILE_LASER
+#define PROFILE_MODE 1
+#define PROFILE_PARKING 0
+#define PROFILE_SPINDLE_SYNC 0
+#elif MACHINE_PROFILE == MACHINE_PROFILE_LATHE
+#define PROFILE_MODE 2
+#define PROFILE_PARKING 0
+#elif MACHINE_PROFILE == MACHINE_PROFILE_PLOTTER
+#define PROFILE_MODE 0
+#define PROFILE_PARKING 0
+#define PROFILE_SPINDLE_SYNC 0
+#elif defined(MACHINE_PROFILE)
+#error "Unknown MACHINE_PROFILE"
+#endif
+
+#if defined(PROFILE_MODE) && PROFILE_MODE == 2 && COMPATIBILITY_LEVEL > 1
+#error "MACHINE_PROFILE_LATHE requires COMPATIBILITY_LEVEL <= 1"
+#endif
+
+// Use these rather than the settings and block conditions in code where the machine type matters.
+
+#ifdef PROFILE_MODE
+#define LASER_MODE (PROFILE_MODE == 1)
+#define LATHE_MODE (PROFILE_MODE == 2)
+#else
+#define LASER_MODE (settings.flags.laser_mode)
+#define LATHE_MODE (settings.flags.lathe_mode)
+#endif
+
+#ifdef PROFILE_PARKING
+#define PARKING_ENABLED false
+#else
+#define PARKING_ENABLED (settings.parking.flags.enabled)
+#endif
+
+// G33, G76 and G95 are rejected by the parser if spindle synchronized motion is not used.
+#ifdef PROFILE_SPINDLE_SYNC
+#define SPINDLE_SYNC_ENABLED false
+#define SPINDLE_SYNCHRONIZED(condition) false
+#else
+#define SPINDLE_SYNC_ENABLED true
+#define SPINDLE_SYNCHRONIZED(condition) ((condition).spindle.synchronized)
+#endif
+
+#endif
@@ -0,0 +1,326 @@
+/*
+  macros.c - named g-code macros stored in tokenized form
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "grbl.h"
+
+#ifdef ENABLE_MACROS
+
+/*
+  $MAC:<name>=<block>|<block>|...  stores a macro, blocks are separated by |
+  $MAC:<name>=                     deletes a macro
+  $MAC=<name>                      executes a macro
+  $MAC                             outputs all macros as [MAC:<name>=<block>|<block>|...]
+
+  Names are up to MACRO_NAME_LENGTH letters and digits. Blocks are tokenized when stored, into the same
+  words the binary stream delivers, and are executed by gc_execute_words() without text scanning or
+  number conversion. A block that is not a sequence of letters followed by numbers is rejected when the
+  macro is stored, modal errors are reported when it is executed. Execution stops at the first block that
+  fails and its status is returned.
+
+  Entries in the store are laid out as the NUL terminated name followed by the blocks, each block is the
+  number of words followed by the words as the letter and the float value, a zero word count ends the
+  entry and an empty name ends the store. The store is kept in RAM and written as a single checksummed
+  area after the driver area, it is kept in RAM only if persistent storage is not large enough.
+*/
+
+#define WORD_SIZE (1 + sizeof(float))
+
+static struct {
+    uint32_t address;           // Persistent storage address, 0 if not persisted
+    uint_fast16_t used;         // Bytes used, excluding the terminating empty name
+    uint8_t data[MACRO_STORE_SIZE];
+} store;
+
+// Returns the size of the entry at pos, 0 if the entry runs past the end of the store.
+static uint_fast16_t entry_size (uint_fast16_t pos)
+{
+    uint_fast16_t start = pos;
+    uint_fast8_t n;
+
+    while(pos < MACRO_STORE_SIZE && store.data[pos++]);
+
+    while(pos < MACRO_STORE_SIZE) {
+        if((n = store.data[pos++]) == 0)
+            return pos - start;
+        pos += n * WORD_SIZE;
+    }
+
+    return 0;
+}
+
+static bool find_macro (char *name, uint_fast16_t *pos)
+{
+    *pos = 0;
+
+    while(*pos < store.used) {
+        if(!strcmp((char *)&store.data[*pos], name))
+            return true;
+        *pos += entry_size(*pos);
+    }
+
+    return false;
+}
+
+static void store_write (void)
+{
+    if(store.address)
+        hal.eeprom.memcpy_to_with_checksum(store.address, store.data, MACRO_STORE_SIZE);
+}
+
+// Tokenizes blocks separated by | into dest, returns the size in size. If dest is NULL the blocks are only checked.
+static status_code_t tokenize (char *blocks, uint8_t *dest, uint_fast16_t *size)
+{
+    uint_fast8_t char_counter = 0, n = 0;
+    uint_fast16_t count_pos = 0;
+    float value;
+    char letter;
+
+    *size = 0;
+
+    while(true) {
+
+        if((letter = blocks[char_counter]) == '|' || letter == '\0') {
+            if(n) {
+                if(dest)
+                    dest[count_pos] = n;
+                n = 0;
+            }
+            if(letter == '\0')
+                break;
+            char_counter++;
+            continue;
+        }
+
+        if(letter < 'A' || letter > 'Z')
+            return Status_ExpectedCommandLetter;
+
+        char_counter++;
+
+        if(!read_float(blocks, &char_counter, &value))
+            return Status_BadNumberFormat;
+
+        if(n == MACRO_MAX_WORDS)
+            return Status_Overflow;
+
+        if(n++ == 0)
+            count_pos = (*size)++;
+
+        if(dest) {
+            dest[*size] = letter;
+            memcpy(&dest[*size + 1], &value, sizeof(float));
+        }
+        *size += WORD_SIZE;
+    }
+
+    if(dest)
+        dest[*size] = 0;
+    (*size)++;
+
+    return *size > 1 ? Status_OK : Status_InvalidStatement;
+}
+
+static status_code_t define_macro (char *name, char *blocks)
+{
+    status_code_t status = Status_OK;
+    uint_fast16_t pos, old_size = 0, size, name_len = strlen(name) + 1;
+    bool exists = find_macro(name, &pos);
+
+    if(exists)
+        old_size = entry_size(pos);
+
+    if(*blocks == '\0') {
+        if(!exists)
+            return Status_MacroNotFound;
+    } else {
+        if((status = tokenize(blocks, NULL, &size)) != Status_OK)
+            return status;
+        if(store.used - old_size + name_len + size >= MACRO_STORE_SIZE) // Room for the terminating empty name is required.
+            return Status_MacroStoreFull;
+    }
+
+    if(exists) {
+        memmove(&store.data[pos], &store.data[pos + old_size], store.used - pos - old_size);
+        store.used -= old_size;
+    }
+
+    if(*blocks != '\0') {
+        memcpy(&store.data[store.used], name, name_len);
+        tokenize(blocks, &store.data[store.used + name_len], &size);
+        store.used += name_len + size;
+    }
+
+    memset(&store.data[store.used], 0, MACRO_STORE_SIZE - store.used);
+    store_write();
+
+    return status;
+}
+
+static status_code_t execute_macro (char *name)
+{
+    gc_word_t words[MACRO_MAX_WORDS + 1];
+    uint_fast8_t n, idx;
+    uint_fast16_t pos;
+    status_code_t status = Status_OK;
+
+    if(!find_macro(name, &pos))
+        return Status_MacroNotFound;
+
+    pos += strlen(name) + 1;
+
+    while(status == Status_OK && (n = store.data[pos++])) {
+
+        for(idx = 0; idx < n; idx++) {
+            words[idx].letter = (char)store.data[pos];
+            memcpy(&words[idx].value, &store.data[pos + 1], sizeof(float));
+            pos += WORD_SIZE;
+        }
+        words[n].letter = '\0';
+
+        status = gc_execute_words(words, NULL, NULL);
+
+        if(!protocol_execute_realtime()) // Bail upon system abort.
+            break;
+    }
+
+    return status;
+}
+
+static void report_macros (void)
+{
+    uint_fast16_t pos = 0;
+    uint_fast8_t n;
+    float value;
+    char *s, letter[2] = {0};
+
+    while(pos < store.used) {
+
+        hal.stream.write("[MAC:");
+        hal.stream.write((char *)&store.data[pos]);
+        hal.stream.write("=");
+
+        pos += strlen((char *)&store.data[pos]) + 1;
+
+        while((n = store.data[pos++])) {
+            while(n--) {
+                letter[0] = (char)store.data[pos];
+                hal.stream.write(letter);
+                memcpy(&value, &store.data[pos + 1], sizeof(float));
+                s = ftoa(value, isintf(value) ? 0 : N_DECIMAL_COORDVALUE_INCH);
+                if(strchr(s, '.')) {
+                    char *end = s + strlen(s) - 1;
+                    while(*end == '0')
+                        *end-- = '\0';
+                    if(*end == '.')
+                        *end = '\0';
+                }
+                hal.stream.write(s);
+                pos += WORD_SIZE;
+            }
+            if(store.data[pos])
+                hal.stream.write("|");
+        }
+
+        hal.stream.write("]" ASCII_EOL);
+    }
+}
+
+status_code_t macros_command (char *args)
+{
+    status_code_t retval = Status_OK;
+    char *name, *blocks;
+
+    switch(*args) {
+
+        case '\0':
+            report_macros();
+            break;
+
+        case '=':
+            if(sys.state & (STATE_ALARM|STATE_ESTOP|STATE_JOG))
+                retval = Status_SystemGClock;
+            else
+                retval = execute_macro(&args[1]);
+            break;
+
+        case ':':
+            name = &args[1];
+            if((blocks = strchr(name, '=')) == NULL || blocks == name || blocks - name > MACRO_NAME_LENGTH)
+                retval = Status_InvalidStatement;
+            else if(!(sys.state == STATE_IDLE || (sys.state & (STATE_ALARM|STATE_ESTOP))))
+                retval = Status_IdleError;
+            else {
+                *blocks++ = '\0';
+                for(args = name; *args; args++) {
+                    if(!((*args >= 'A' && *args <= 'Z') || (*args >= '0' && *args <= '9')))
+                        return Status_InvalidStatement;
+                }
+                retval = define_macro(name, blocks);
+            }
+            break;
+
+        default:
+            retval = Status_InvalidStatement;
+            break;
+    }
+
+    return retval;
+}
+
+void macros_execute_startup (void)
+{
+    uint_fast16_t pos;
+
+    if(find_macro(MACRO_STARTUP, &pos)) {
+        char line[] = "$MAC=" MACRO_STARTUP;
+        report_execute_startup_message(line, execute_macro(MACRO_STARTUP));
+    }
+}
+
+uint32_t macros_storage_address (void)
+{
+    return store.address;
+}
+
+void macros_init (void)
+{
+    uint32_t address = hal.eeprom.driver_area.address >= GRBL_EEPROM_SIZE
+                        ? hal.eeprom.driver_area.address + hal.eeprom.driver_area.size + EEPROM_CHECKSUM_SIZE
+                        : GRBL_EEPROM_SIZE;
+    uint_fast16_t size;
+
+    store.address = hal.eeprom.type != EEPROM_None && address + MACRO_STORE_SIZE + EEPROM_CHECKSUM_SIZE <= hal.eeprom.size ? address : 0;
+    store.used = 0;
+
+    if(store.address && hal.eeprom.memcpy_from_with_checksum(store.data, store.address, MACRO_STORE_SIZE)) {
+        while(store.used < MACRO_STORE_SIZE && store.data[store.used]) {
+            if((size = entry_size(store.used)) == 0) {
+                store.used = 0; // Corrupt, discard all.
+                break;
+            }
+            store.used += size;
+        }
+    }
+
+    memset(&store.data[store.used], 0, MACRO_STORE_SIZE - store.used);
+}
+
+#endif
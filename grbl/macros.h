@@ -0,0 +1,58 @@
+/*
+  macros.h - named g-code macros stored in tokenized form
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _MACROS_H_
+#define _MACROS_H_
+
+#ifdef ENABLE_MACROS
+
+// Size of the macro store in bytes, each word takes 5 bytes, each block 1 and each name its length plus 1.
+#ifndef MACRO_STORE_SIZE
+  #define MACRO_STORE_SIZE 512
+#endif
+
+// Maximum length of a macro name.
+#ifndef MACRO_NAME_LENGTH
+  #define MACRO_NAME_LENGTH 8
+#endif
+
+// Maximum number of words in a macro block.
+#ifndef MACRO_MAX_WORDS
+  #define MACRO_MAX_WORDS 16
+#endif
+
+// Name of the macro executed after the startup lines.
+#define MACRO_STARTUP "STARTUP"
+
+// Loads the macro store from persistent storage, called once at boot after the settings are loaded.
+void macros_init (void);
+
+// Handles $MAC, $MAC=<name>, $MAC:<name>=<blocks> and $MAC:<name>=, args points past $MAC.
+status_code_t macros_command (char *args);
+
+// Executes the startup macro if defined, reporting the outcome as for a startup line.
+void macros_execute_startup (void);
+
+// Returns the persistent storage address of the macro store, 0 if it is kept in RAM only.
+uint32_t macros_storage_address (void);
+
+#endif
+
+#endif
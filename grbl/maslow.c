@@ -43,11 +43,16 @@ typedef struct {
     float xCordOfMotor_x4;
     float xCordOfMotor_x2_pow;
     float yCordOfMotor;
+    float XcorrScaling;
+    float YcorrScaling;
+    float motor[2][2];      //Motor positions in the scaled frame
     float height_to_bit; //distance between sled attach point and bit
 } machine_t;
 
 static machine_t machine = {0};
 
+static void recomputeGeometry (void);
+
 uint_fast8_t selected_motor = A_MOTOR;
 
 maslow_hal_t maslow_hal = {0};
@@ -194,8 +199,10 @@ status_code_t maslow_setting (setting_type_t param, float value, char *svalue)
             break;
     }
 
-    if(status == Status_OK)
+    if(status == Status_OK) {
+        recomputeGeometry();
         hal.eeprom.memcpy_to_with_checksum(hal.eeprom.driver_area.address, (uint8_t *)&driver_settings, sizeof(driver_settings));
+    }
 
     return status;
 }
@@ -307,7 +314,7 @@ void maslow_settings_restore (void)
 
 }
 
-void recomputeGeometry()
+static void recomputeGeometry (void)
 {
     /*
     Some variables are computed on initialization for the geometry of the machine to reduce overhead,
@@ -318,7 +325,12 @@ void recomputeGeometry()
     machine.xCordOfMotor = (maslow_hal.settings->distBetweenMotors / 2.0f);
     machine.yCordOfMotor = (machine.halfHeight + maslow_hal.settings->motorOffsetY);
     machine.xCordOfMotor_x4 = machine.xCordOfMotor * 4.0f;
-    machine.xCordOfMotor_x2_pow = powf((machine.xCordOfMotor * 2.0f), 2.0f);
+    machine.xCordOfMotor_x2_pow = machine.xCordOfMotor_x4 * machine.xCordOfMotor;
+    machine.XcorrScaling = maslow_hal.settings->XcorrScaling;
+    machine.YcorrScaling = maslow_hal.settings->YcorrScaling;
+    machine.motor[A_MOTOR][X_AXIS] = -machine.xCordOfMotor;
+    machine.motor[B_MOTOR][X_AXIS] = machine.xCordOfMotor;
+    machine.motor[A_MOTOR][Y_AXIS] = machine.motor[B_MOTOR][Y_AXIS] = machine.yCordOfMotor;
 }
 
 // limit motion to stay within table (in mm)
@@ -340,10 +352,10 @@ static void maslow_convert_array_steps_to_mpos (float *position, int32_t *steps)
     float a_len = ((float)steps[A_MOTOR] / settings.steps_per_mm[A_MOTOR]);
     float b_len = ((float)steps[B_MOTOR] / settings.steps_per_mm[B_MOTOR]);
 
-    a_len = (machine.xCordOfMotor_x2_pow - powf(b_len, 2.0f) + powf(a_len, 2.0f)) / machine.xCordOfMotor_x4;
+    a_len = (machine.xCordOfMotor_x2_pow - b_len * b_len + a_len * a_len) / machine.xCordOfMotor_x4;
     position[X_AXIS] = a_len - machine.xCordOfMotor;
     a_len = maslow_hal.settings->distBetweenMotors - a_len;
-    position[Y_AXIS] = machine.yCordOfMotor - sqrtf(powf(b_len, 2.0f) - powf(a_len, 2.0f));
+    position[Y_AXIS] = machine.yCordOfMotor - sqrtf(b_len * b_len - a_len * a_len);
     position[Z_AXIS] = steps[Z_AXIS] / settings.steps_per_mm[Z_AXIS];
 
 // back out any correction factor
@@ -359,14 +371,14 @@ inline static void triangularInverse (int32_t *target_steps, float *target)
     //Confirm that the coordinates are on the table
 //    verifyValidTarget(&xTarget, &yTarget);
 
-    // scale target (absolute position) by any correction factor
-    double xxx = (double)target[A_MOTOR] * (double)maslow_hal.settings->XcorrScaling;
-    double yyy = (double)target[B_MOTOR] * (double)maslow_hal.settings->YcorrScaling;
-    double yyp = pow((double)machine.yCordOfMotor - yyy, 2.0);
+    float a_len, b_len;
+
+    // scale target (absolute position) by any correction factor and calculate motor axes length to the bit
+    maslow_chain_lengths(&a_len, &b_len, target[A_MOTOR] * machine.XcorrScaling, target[B_MOTOR] * machine.YcorrScaling,
+                          machine.xCordOfMotor, machine.yCordOfMotor);
 
-    //Calculate motor axes length to the bit
-    target_steps[A_MOTOR] = (int32_t)lround(sqrt(pow((double)machine.xCordOfMotor + xxx, 2.0f) + yyp) * settings.steps_per_mm[A_MOTOR]);
-    target_steps[B_MOTOR] = (int32_t)lround(sqrt(pow((double)machine.xCordOfMotor - xxx, 2.0f) + yyp) * settings.steps_per_mm[B_MOTOR]);
+    target_steps[A_MOTOR] = lroundf(a_len * settings.steps_per_mm[A_MOTOR]);
+    target_steps[B_MOTOR] = lroundf(b_len * settings.steps_per_mm[B_MOTOR]);
 }
 
 // Transform absolute position from cartesian coordinate system (mm) to maslow coordinate system (step)
@@ -386,59 +398,17 @@ static uint_fast8_t maslow_limits_get_axis_mask (uint_fast8_t idx)
     return ((idx == A_MOTOR) || (idx == B_MOTOR)) ? (bit(X_AXIS) | bit(Y_AXIS)) : bit(idx);
 }
 
-// MASLOW is circular in motion, so long lines must be divided up
-static bool maslow_segment_line (float *target, plan_line_data_t *pl_data, bool init)
+// Chains move the sled along a curve between the planned positions, provide the deviation for segmentation
+static float maslow_segment_error (float *start, float *end)
 {
-    static uint_fast16_t iterations;
-    static bool segmented;
-    static float delta[N_AXIS], segment_target[N_AXIS];
-//    static plan_line_data_t plan;
-
-    uint_fast8_t idx = N_AXIS;
-
-    if(init) {
-
-        float max_delta = 0.0f;
-
-        do {
-            idx--;
-            delta[idx] = target[idx] - gc_state.position[idx];
-            max_delta = max(max_delta, fabsf(delta[idx]));
-        } while(idx);
-
-        if((segmented = !(pl_data->condition.rapid_motion || pl_data->condition.jog_motion) &&
-                          max_delta > MAX_SEG_LENGTH_MM && !(delta[X_AXIS] == 0.0f && delta[Y_AXIS] == 0.0f))) {
-
-            idx = N_AXIS;
-            iterations = (uint_fast16_t)ceilf(max_delta / MAX_SEG_LENGTH_MM);
+    float s[2], e[2];
 
-            memcpy(segment_target, gc_state.position, sizeof(segment_target));
-//            memcpy(&plan, pl_data, sizeof(plan_line_data_t));
-
-            do {
-                delta[--idx] /= (float)iterations;
-                target[idx] = gc_state.position[idx];
-            } while(idx);
-
-        } else
-            iterations = 1;
-
-        iterations++; // return at least one iteration
-
-    } else {
-
-        iterations--;
-
-        if(segmented && iterations) do {
-            idx--;
-            segment_target[idx] += delta[idx];
-            target[idx] = segment_target[idx];
-//            memcpy(pl_data, &plan, sizeof(plan_line_data_t));
-        } while(idx);
-
-    }
+    s[X_AXIS] = start[X_AXIS] * machine.XcorrScaling;
+    s[Y_AXIS] = start[Y_AXIS] * machine.YcorrScaling;
+    e[X_AXIS] = end[X_AXIS] * machine.XcorrScaling;
+    e[Y_AXIS] = end[Y_AXIS] * machine.YcorrScaling;
 
-    return iterations != 0;
+    return kinematics_cable_error(machine.motor[A_MOTOR], machine.motor[B_MOTOR], s, e);
 }
 
 static void maslow_limits_set_target_pos (uint_fast8_t idx) // fn name?
@@ -542,7 +512,7 @@ static void maslow_limits_set_machine_positions (axes_signals_t cycle)
 }
 
 // TODO: format output in grbl fashion: [...]
-status_code_t maslow_tuning (uint_fast16_t state, char *line, char *lcline)
+static status_code_t maslow_tuning (uint_fast16_t state, char *line, char *lcline)
 {
     status_code_t retval = Status_OK;
 
@@ -744,7 +714,8 @@ void maslow_init (void)
     kinematics.limits_set_machine_positions = maslow_limits_set_machine_positions;
     kinematics.plan_target_to_steps = maslow_target_to_steps;
     kinematics.convert_array_steps_to_mpos = maslow_convert_array_steps_to_mpos;
-    kinematics.segment_line = maslow_segment_line;
+    kinematics.segment_line = kinematics_segment_line;
+    kinematics.segment_error = maslow_segment_error;
 
     hal.driver_sys_command_execute = maslow_tuning;
 }
@@ -36,7 +36,6 @@
 
 #define FP_SCALING 1024.0f
 #define SPROCKET_RADIUS_MM (10.1f)
-#define MAX_SEG_LENGTH_MM 2.0f /* long lines must be segmented due to circular motion */
 
   // PID position loop factors              X: Kp = 25000 Ki = 15000 Kd = 22000 Imax = 5000
   // 14.000 fixed point arithmatic S13.10
@@ -163,6 +162,15 @@ void maslow_init (void);
 status_code_t maslow_setting (setting_type_t param, float value, char *svalue);
 void maslow_settings_report (setting_type_t setting);
 void maslow_settings_restore (void);
-static status_code_t maslow_tuning (uint_fast16_t state, char *line, char *lcline);
+
+// Chain lengths (mm) from the motors at (-x_motor, y_motor) and (x_motor, y_motor) to the point x, y.
+// Single precision, the squared vertical distance is shared and each chain takes a single square root.
+static inline void maslow_chain_lengths (float *a_len, float *b_len, float x, float y, float x_motor, float y_motor)
+{
+    float dy = y_motor - y, dy2 = dy * dy, dxa = x_motor + x, dxb = x_motor - x;
+
+    *a_len = sqrtf(dxa * dxa + dy2);
+    *b_len = sqrtf(dxb * dxb + dy2);
+}
 
 #endif
@@ -0,0 +1,126 @@
+/*
+  memory_usage.c - stack high-water mark and heap allocation tracking
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_MEMORY_USAGE
+
+/*
+  The stack region, if provided by the driver, is painted with a pattern from its lowest address up to
+  STACK_PAINT_MARGIN bytes below the stack pointer after driver_init() has returned. The stack high-water
+  mark is found by scanning for the first word overwritten, from the lowest address and up.
+  This assumes a descending stack, as on ARM, Xtensa and MSP430 processors.
+
+  Heap allocations made by grbl through mem_alloc() are prefixed with their size so that the number of
+  allocations and bytes outstanding can be tracked, along with the peak number of bytes allocated.
+
+  The $I report contains:
+
+    [MEMORY:<stack used>,<stack size>,<allocations>,<bytes allocated>,<peak bytes allocated>]
+
+  Stack figures are 0 if the driver does not provide the stack region.
+*/
+
+#define STACK_PAINT_PATTERN 0xA5A5A5A5
+
+typedef union {
+    size_t size;
+    void *ptr;
+    double align;
+} mem_header_t;
+
+static struct {
+    uint32_t allocations;
+    uint32_t bytes;
+    uint32_t peak;
+} heap = {0};
+
+void *mem_alloc (size_t size)
+{
+    mem_header_t *header;
+
+    if((header = malloc(sizeof(mem_header_t) + size)) == NULL)
+        return NULL;
+
+    header->size = size;
+    heap.allocations++;
+    if((heap.bytes += size) > heap.peak)
+        heap.peak = heap.bytes;
+
+    return header + 1;
+}
+
+void mem_free (void *ptr)
+{
+    if(ptr) {
+        mem_header_t *header = (mem_header_t *)ptr - 1;
+        heap.allocations--;
+        heap.bytes -= header->size;
+        free(header);
+    }
+}
+
+static inline bool stack_valid (void)
+{
+    return hal.stack.base != NULL && hal.stack.size >= sizeof(uint32_t);
+}
+
+void mem_stack_paint (void)
+{
+    if(stack_valid()) {
+
+        volatile uint8_t marker = 0; // Approximates the stack pointer
+        uint32_t *word = (uint32_t *)(((uintptr_t)hal.stack.base + 3) & ~(uintptr_t)3);
+        uintptr_t end = (uintptr_t)&marker - STACK_PAINT_MARGIN; // Integer arithmetic, the margin is outside the marker object
+
+        if(end > (uintptr_t)(hal.stack.base + hal.stack.size))
+            end = (uintptr_t)(hal.stack.base + hal.stack.size);
+
+        while((uintptr_t)(word + 1) <= end)
+            *word++ = STACK_PAINT_PATTERN;
+    }
+}
+
+static uint32_t stack_used (void)
+{
+    uint32_t *word = (uint32_t *)(((uintptr_t)hal.stack.base + 3) & ~(uintptr_t)3), *end = (uint32_t *)(hal.stack.base + hal.stack.size);
+
+    while(word < end && *word == STACK_PAINT_PATTERN)
+        word++;
+
+    return (uint32_t)((uint8_t *)end - (uint8_t *)word);
+}
+
+void mem_report (void)
+{
+    hal.stream.write("[MEMORY:");
+    hal.stream.write(uitoa(stack_valid() ? stack_used() : 0));
+    hal.stream.write(",");
+    hal.stream.write(uitoa(stack_valid() ? hal.stack.size : 0));
+    hal.stream.write(",");
+    hal.stream.write(uitoa(heap.allocations));
+    hal.stream.write(",");
+    hal.stream.write(uitoa(heap.bytes));
+    hal.stream.write(",");
+    hal.stream.write(uitoa(heap.peak));
+    hal.stream.write("]" ASCII_EOL);
+}
+
+#endif
@@ -0,0 +1,51 @@
+/*
+  memory_usage.h - stack high-water mark and heap allocation tracking
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _MEMORY_USAGE_H_
+#define _MEMORY_USAGE_H_
+
+#ifdef ENABLE_MEMORY_USAGE
+
+// Number of bytes below the stack pointer left unpainted, reserved for interrupts that may fire while painting.
+#ifndef STACK_PAINT_MARGIN
+  #define STACK_PAINT_MARGIN 256
+#endif
+
+// Allocates memory from the heap and tracks the number of allocations and bytes outstanding.
+// NOTE: Must only be called from the foreground process.
+void *mem_alloc (size_t size);
+
+// Returns memory allocated by mem_alloc() to the heap.
+void mem_free (void *ptr);
+
+// Fills the unused part of the stack region provided by the driver in hal.stack with a pattern, called after driver_init().
+void mem_stack_paint (void);
+
+// Outputs the [MEMORY:...] line of the $I report.
+void mem_report (void);
+
+#else
+
+#define mem_alloc(size) malloc(size)
+#define mem_free(ptr) free(ptr)
+
+#endif
+
+#endif
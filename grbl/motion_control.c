@@ -26,35 +26,410 @@
 
 #include "grbl.h"
 
-#ifdef ENABLE_BACKLASH_COMPENSATION
+// Queue linear motion in the planner, adds kinematics segmentation if enabled.
+// NOTE: Backlash compensation, if enabled, is added by the planner to the block reversing the axis direction.
+static bool plan_line (float *target, plan_line_data_t *pl_data)
+{
+    // Moves of pending canned cycles precede the line.
+    if(!mc_canned_flush())
+        return false;
+
+    // If in check gcode mode, prevent motion by blocking planner. Soft limits still work.
+    if (sys.state != STATE_CHECK_MODE && protocol_execute_realtime()) {
+
+#ifdef KINEMATICS_API
+     kinematics.segment_line(target, pl_data, true);
+
+     while(kinematics.segment_line(target, pl_data, false)) {
+#endif
+        // If the buffer is full: good! That means we are well ahead of the robot.
+        // Remain in this loop until there is room in the buffer.
+         do {
+            if(!protocol_execute_realtime())    // Check for any run-time commands
+                return false;                   // Bail, if system abort.
+            if(plan_check_full_buffer())
+                protocol_auto_cycle_start();    // Auto-cycle start when buffer is full.
+            else
+                break;
+        } while(true);
+
+        // Plan and queue motion into planner buffer
+        // bool plan_status; // Not used in normal operation.
+        if(!plan_buffer_line(target, pl_data) && LASER_MODE && pl_data->condition.spindle.on && !pl_data->condition.spindle.ccw) {
+            // Correctly set spindle state, if there is a coincident position passed.
+            // Forces a buffer sync while in M3 laser mode only.
+            hal.spindle_set_state(pl_data->condition.spindle, pl_data->spindle.rpm);
+        }
+#ifdef KINEMATICS_API
+      }
+#endif
+    }
+
+    return !ABORTED;
+}
 
-static float target_prev[N_AXIS];
-static axes_signals_t dir_negative, backlash_enabled;
+#ifdef ENABLE_HEIGHT_MAP
 
-void mc_backlash_init (void)
+// Queue linear motion with the height map Z offset added, XY motion is subdivided to follow the surface.
+// Spindle synchronized motions and raster rows are not subdivided, only the offset at the target is added.
+// NOTE: The start position is derived from the planner position, the Z offset only depends on X and Y.
+static bool queue_compensated_line (float *target, plan_line_data_t *pl_data)
 {
-    uint_fast8_t idx = N_AXIS;
+    bool ok = true;
+    uint_fast8_t idx;
+    uint32_t segments = 1, i;
+    plan_line_data_t pl_segment;
+    float start[N_AXIS], delta[N_AXIS], point[N_AXIS];
 
-    backlash_enabled.mask = dir_negative.value = 0;
+    memcpy(&pl_segment, pl_data, sizeof(plan_line_data_t));
+    plan_get_planner_mpos(start);
+    start[Z_AXIS] -= height_map_offset(start);
 
+    idx = N_AXIS;
     do {
-        if(settings.backlash[--idx] > 0.0001f)
-            backlash_enabled.mask |= bit(idx);
-        dir_negative.value |= bit(idx);
+        idx--;
+        delta[idx] = target[idx] - start[idx];
     } while(idx);
 
-    dir_negative.value ^= settings.homing.dir_mask.value;
+    if(!(pl_data->condition.spindle.synchronized
+#ifdef ENABLE_RASTER_ROWS
+          || pl_data->raster
+#endif
+        )) {
+
+        segments = (uint32_t)ceilf(sqrtf(delta[X_AXIS] * delta[X_AXIS] + delta[Y_AXIS] * delta[Y_AXIS]) / height_map_segment_length());
+
+        // Inverse time feed rate is for the whole motion, each segment takes its share of the time.
+        if(segments > 1 && pl_data->condition.inverse_time)
+            pl_segment.feed_rate *= segments;
+    }
+
+    for(i = 1; ok && i < segments; i++) {
+
+        float t = (float)i / (float)segments;
+
+        idx = N_AXIS;
+        do {
+            idx--;
+            point[idx] = start[idx] + delta[idx] * t;
+        } while(idx);
+
+        point[Z_AXIS] += height_map_offset(point);
 
-    mc_sync_backlash_position();
+        ok = plan_line(point, &pl_segment);
+    }
+
+    if(ok) {
+        // Ensure last segment arrives at target location.
+        memcpy(point, target, sizeof(point));
+        point[Z_AXIS] += height_map_offset(point);
+
+        ok = plan_line(point, &pl_segment);
+    }
+
+    // Return message, output commands etc. handed over to the planner, the caller's feed rate is kept.
+    pl_segment.feed_rate = pl_data->feed_rate;
+    memcpy(pl_data, &pl_segment, sizeof(plan_line_data_t));
+
+    return ok;
 }
 
-void mc_sync_backlash_position (void)
+#endif // ENABLE_HEIGHT_MAP
+
+// Queue linear motion, adds the height map Z offset if enabled. System motions (parking) are not compensated.
+static bool queue_line (float *target, plan_line_data_t *pl_data)
 {
-    // Update target_prev
-    system_convert_array_steps_to_mpos(target_prev, sys_position);
+#ifdef ENABLE_HEIGHT_MAP
+    if(height_map_active() && !pl_data->condition.system_motion)
+        return queue_compensated_line(target, pl_data);
+#endif
+
+    return plan_line(target, pl_data);
 }
 
+#ifdef MC_LINE_HOLD
+
+#ifndef COALESCE_MAX_SEGMENTS
+#define COALESCE_MAX_SEGMENTS 8 // Max number of line motions merged into one planner block.
+#endif
+
+// The last line motion is held back until the next one is known. This allows consecutive short lines
+// to be merged into one (segment coalescing) and/or the corner between two lines to be replaced by an
+// arc deviating no more than the path tolerance from it (G64 path blending).
+static struct {
+    bool pending;
+    float start[N_AXIS];        // Start of the held line, tangent point of the previous blend if blended.
+    float target[N_AXIS];
+    float unit_vec[N_AXIS];
+    float length;               // Length of the held line (mm).
+#ifdef ENABLE_SEGMENT_COALESCING
+    uint_fast8_t n_vertices;
+    float vertex[COALESCE_MAX_SEGMENTS][N_AXIS]; // Programmed points merged away.
+#endif
+    plan_line_data_t pl_data;   // Owns the message and output commands of the held line.
+} held = {0};
+
+// Returns true if line motion may be held back.
+static inline bool line_can_be_held (plan_line_data_t *pl_data)
+{
+    bool ok = false;
+
+#ifdef ENABLE_PATH_BLENDING
+    ok = pl_data->path_tolerance > 0.0f;
+#endif
+#ifdef ENABLE_SEGMENT_COALESCING
+    ok = ok || (pl_data->coalesce && settings.coalescing_tolerance > 0.0f);
+#endif
+
+    return ok && !(pl_data->condition.rapid_motion || pl_data->condition.system_motion ||
+                    pl_data->condition.jog_motion || pl_data->condition.inverse_time ||
+                     pl_data->condition.spindle.synchronized
+#ifdef ENABLE_RASTER_ROWS
+                      || pl_data->raster
+#endif
+#ifdef ENABLE_NATIVE_ARCS
+                      || pl_data->arc
 #endif
+                    );
+}
+
+// Queue the held back line, releases any message and output commands not taken by the planner.
+static bool queue_held_line (void)
+{
+    bool ok;
+
+    held.pending = false;
+
+    ok = queue_line(held.target, &held.pl_data);
+
+    if(held.pl_data.message) {
+        protocol_message(held.pl_data.message);
+        held.pl_data.message = NULL;
+    }
+
+    pool_output_commands_release(held.pl_data.output_commands);
+    held.pl_data.output_commands = NULL;
+
+    return ok;
+}
+
+#ifdef ENABLE_SEGMENT_COALESCING
+
+// Try to merge line motion with the held line. Merging is only done if the motions have the same
+// parameters and no programmed point deviates more than the coalescing tolerance from the merged line.
+// NOTE: This also limits the direction deviation to what is within the tolerance.
+static bool coalesce_line (float *target, plan_line_data_t *pl_data)
+{
+    uint_fast8_t idx, vertex;
+    float unit_vec[N_AXIS], length, tolerance_sqr = settings.coalescing_tolerance * settings.coalescing_tolerance;
+
+    if(!(pl_data->coalesce && held.pl_data.coalesce && held.n_vertices < COALESCE_MAX_SEGMENTS))
+        return false;
+
+    // Output commands and messages are synchronized with the start of a line, do not merge them away.
+    if(pl_data->message || pl_data->output_commands)
+        return false;
+
+    if(pl_data->feed_rate != held.pl_data.feed_rate ||
+        pl_data->spindle.rpm != held.pl_data.spindle.rpm ||
+         pl_data->condition.value != held.pl_data.condition.value ||
+          pl_data->overrides.value != held.pl_data.overrides.value)
+        return false;
+
+    idx = N_AXIS;
+    do {
+        idx--;
+        unit_vec[idx] = target[idx] - held.start[idx];
+    } while(idx);
+
+    if((length = convert_delta_vector_to_unit_vector(unit_vec)) == 0.0f)
+        return false;
+
+    memcpy(held.vertex[held.n_vertices], held.target, sizeof(held.target));
+
+    vertex = held.n_vertices + 1;
+    do {
+        float *point = held.vertex[--vertex], distance = 0.0f, distance_sqr = 0.0f, delta;
+        idx = N_AXIS;
+        do {
+            idx--;
+            delta = point[idx] - held.start[idx];
+            distance += delta * unit_vec[idx];
+            distance_sqr += delta * delta;
+        } while(idx);
+        // Point must be between the end points and within tolerance from the merged line.
+        if(distance <= 0.0f || distance >= length || distance_sqr - distance * distance > tolerance_sqr)
+            return false;
+    } while(vertex);
+
+    held.n_vertices++;
+    held.length = length;
+    memcpy(held.target, target, sizeof(held.target));
+    memcpy(held.unit_vec, unit_vec, sizeof(held.unit_vec));
+
+    return true;
+}
+
+#endif // ENABLE_SEGMENT_COALESCING
+
+#ifdef ENABLE_PATH_BLENDING
+
+// Queue the held line with the corner to the new line replaced by an arc. Trim is set to the
+// distance from the corner to the tangent point on the new line.
+static bool blend_corner (float *unit_vec, float length, plan_line_data_t *pl_data, float *trim)
+{
+    uint_fast8_t idx;
+    float cos_theta = 0.0f;
+
+    *trim = 0.0f;
+
+    idx = N_AXIS;
+    do {
+        idx--;
+        cos_theta += held.unit_vec[idx] * unit_vec[idx];
+    } while(idx);
+
+    // Blend proper corners only, not (near) collinear motions or (near) reversals.
+    if(!(cos_theta > -0.9999f && cos_theta < 0.999999f))
+        return queue_held_line();
+
+    uint_fast16_t segments;
+    plan_line_data_t pl_arc;
+    float corner[N_AXIS], center[N_AXIS], normal[N_AXIS], point[N_AXIS];
+    float cos_half = sqrtf(0.5f * (1.0f + cos_theta)), sin_half = sqrtf(0.5f * (1.0f - cos_theta));
+    float tan_half = sin_half / cos_half, sin_theta = 2.0f * sin_half * cos_half, theta = acosf(cos_theta);
+    float radius = pl_data->path_tolerance * cos_half / (1.0f - cos_half);
+
+    // Tangent distance from the corner, limited so that consecutive arcs do not overlap.
+    *trim = min(radius * tan_half, min(held.length, 0.5f * length));
+    radius = *trim / tan_half;
+
+    memcpy(corner, held.target, sizeof(corner));
+
+    idx = N_AXIS;
+    do {
+        idx--;
+        normal[idx] = (unit_vec[idx] - cos_theta * held.unit_vec[idx]) / sin_theta;
+        held.target[idx] = corner[idx] - *trim * held.unit_vec[idx];
+        center[idx] = held.target[idx] + radius * normal[idx];
+    } while(idx);
+
+    if(!queue_held_line())
+        return false;
+
+    // Number of arc segments, calculated as in mc_arc().
+    segments = 2.0f * radius > settings.arc_tolerance
+                ? (uint_fast16_t)floorf(0.5f * theta * radius / sqrtf(settings.arc_tolerance * (2.0f * radius - settings.arc_tolerance)))
+                : 0;
+
+    memcpy(&pl_arc, pl_data, sizeof(plan_line_data_t));
+    pl_arc.message = NULL;
+    pl_arc.output_commands = NULL;
+
+    for(uint_fast16_t i = 1; i < segments; i++) {
+        float angle = theta * (float)i / (float)segments, cos_angle = radius * cosf(angle), sin_angle = radius * sinf(angle);
+        idx = N_AXIS;
+        do {
+            idx--;
+            point[idx] = center[idx] - cos_angle * normal[idx] + sin_angle * held.unit_vec[idx];
+        } while(idx);
+        if(!queue_line(point, &pl_arc))
+            return false;
+    }
+
+    // Ensure last segment arrives exactly at the tangent point on the new line.
+    idx = N_AXIS;
+    do {
+        idx--;
+        point[idx] = corner[idx] + *trim * unit_vec[idx];
+    } while(idx);
+
+    return queue_line(point, &pl_arc);
+}
+
+#endif // ENABLE_PATH_BLENDING
+
+// Hold back line motion, merging it with or blending it to the previously held line.
+static bool hold_line (float *target, plan_line_data_t *pl_data)
+{
+    uint_fast8_t idx;
+    float unit_vec[N_AXIS], start[N_AXIS], length, trim = 0.0f;
+
+    if(held.pending)
+        memcpy(start, held.target, sizeof(start));
+    else {
+        plan_get_planner_mpos(start);
+#ifdef ENABLE_HEIGHT_MAP
+        if(height_map_active())
+            start[Z_AXIS] -= height_map_offset(start);
+#endif
+    }
+
+    idx = N_AXIS;
+    do {
+        idx--;
+        unit_vec[idx] = target[idx] - start[idx];
+    } while(idx);
+
+    if((length = convert_delta_vector_to_unit_vector(unit_vec)) == 0.0f)
+        return !ABORTED; // Zero length motion, nothing to hold back.
+
+    if(held.pending) {
+#ifdef ENABLE_SEGMENT_COALESCING
+        if(coalesce_line(target, pl_data))
+            return !ABORTED;
+#endif
+#ifdef ENABLE_PATH_BLENDING
+        if(!(pl_data->path_tolerance > 0.0f ? blend_corner(unit_vec, length, pl_data, &trim) : queue_held_line()))
+            return false;
+#else
+        if(!queue_held_line())
+            return false;
+#endif
+    }
+
+    // Take ownership of message and output commands, they are queued with the held line.
+    memcpy(&held.pl_data, pl_data, sizeof(plan_line_data_t));
+    pl_data->message = NULL;
+    pl_data->output_commands = NULL;
+
+    idx = N_AXIS;
+    do {
+        idx--;
+        held.start[idx] = start[idx] + trim * unit_vec[idx];
+    } while(idx);
+
+    memcpy(held.target, target, sizeof(held.target));
+    memcpy(held.unit_vec, unit_vec, sizeof(held.unit_vec));
+    held.length = length - trim;
+#ifdef ENABLE_SEGMENT_COALESCING
+    held.n_vertices = 0;
+#endif
+    held.pending = true;
+
+    return !ABORTED;
+}
+
+// Queue held back line motion, if any.
+bool mc_line_flush (void)
+{
+    return held.pending ? queue_held_line() : !ABORTED;
+}
+
+// Discard held back line motion, if any.
+void mc_line_discard (void)
+{
+    if(held.pending) {
+        held.pending = false;
+        if(held.pl_data.message)
+            pool_message_release(held.pl_data.message);
+        pool_output_commands_release(held.pl_data.output_commands);
+        held.pl_data.message = NULL;
+        held.pl_data.output_commands = NULL;
+    }
+}
+
+#endif // MC_LINE_HOLD
 
 // Execute linear motion in absolute millimeter coordinates. Feed rate given in millimeters/second
 // unless invert_feed_rate is true. Then the feed_rate means that the motion should be completed in
@@ -65,6 +440,13 @@ void mc_sync_backlash_position (void)
 // in the planner and to let backlash compensation or canned cycle integration simple and direct.
 bool mc_line (float *target, plan_line_data_t *pl_data)
 {
+    // Moves of pending canned cycles precede the line, it must not be held back before them.
+    if(!mc_canned_flush())
+        return false;
+
+    // Let subscribers follow the motions of a program run in check mode, e.g. to verify it.
+    if (sys.state == STATE_CHECK_MODE && hook_active(Hook_CheckModeMotion))
+        hooks_check_mode_motion(target, pl_data);
 
     // If enabled, check for soft limit violations. Placed here all line motions are picked up
     // from everywhere in Grbl.
@@ -72,106 +454,85 @@ bool mc_line (float *target, plan_line_data_t *pl_data)
     if (!pl_data->condition.jog_motion && settings.limits.flags.soft_enabled)
         limits_soft_check(target);
 
-    // If in check gcode mode, prevent motion by blocking planner. Soft limits still work.
-    if (sys.state != STATE_CHECK_MODE && protocol_execute_realtime()) {
-
-        // NOTE: Backlash compensation may be installed here. It will need direction info to track when
-        // to insert a backlash line motion(s) before the intended line motion and will require its own
-        // plan_check_full_buffer() and check for system abort loop. Also for position reporting
-        // backlash steps will need to be also tracked, which will need to be kept at a system level.
-        // There are likely some other things that will need to be tracked as well. However, we feel
-        // that backlash compensation should NOT be handled by Grbl itself, because there are a myriad
-        // of ways to implement it and can be effective or ineffective for different CNC machines. This
-        // would be better handled by the interface as a post-processor task, where the original g-code
-        // is translated and inserts backlash motions that best suits the machine.
-        // NOTE: Perhaps as a middle-ground, all that needs to be sent is a flag or special command that
-        // indicates to Grbl what is a backlash compensation motion, so that Grbl executes the move but
-        // doesn't update the machine position values. Since the position values used by the g-code
-        // parser and planner are separate from the system machine positions, this is doable.
-
-#ifdef ENABLE_BACKLASH_COMPENSATION
-
-        if(backlash_enabled.mask) {
-
-            bool backlash_comp = false;
-            uint_fast8_t idx = N_AXIS, axismask = bit(N_AXIS - 1);
-
-            do {
-                idx--;
-                if(backlash_enabled.mask & axismask) {
-                    if(target[idx] > target_prev[idx]) {
-                        if (dir_negative.value & axismask) {
-                            dir_negative.value &= ~axismask;
-                            target_prev[idx] += settings.backlash[idx];
-                            backlash_comp = true;
-                        }
-                    } else if(target[idx] < target_prev[idx] && !(dir_negative.value & axismask)) {
-                        dir_negative.value |= axismask;
-                        target_prev[idx] -= settings.backlash[idx];
-                        backlash_comp = true;
-                    }
-                }
-                axismask >>= 1;
-            } while(idx);
+#ifdef MC_LINE_HOLD
+    if (sys.state != STATE_CHECK_MODE) {
+        if (line_can_be_held(pl_data))
+            return hold_line(target, pl_data);
+        if (held.pending && !mc_line_flush())
+            return false;
+    }
+#endif
 
-            if(backlash_comp) {
+    return queue_line(target, pl_data);
+}
 
-                plan_line_data_t pl_backlash;
 
-                memset(&pl_backlash, 0, sizeof(plan_line_data_t));
+#ifdef ENABLE_NATIVE_ARCS
 
-                pl_backlash.condition.rapid_motion = On;
-                pl_backlash.condition.backlash_motion = On;
-                pl_backlash.line_number = pl_data->line_number;
-                pl_backlash.spindle.rpm = pl_data->spindle.rpm;
+// Checks the points where the arc crosses the lines through the center parallel to the plane axes,
+// the extremes of the arc, against the soft limits. The end points are checked by mc_line().
+static void arc_soft_check (float *target, plan_arc_t *arc)
+{
+    static const float cos_q[4] = { 1.0f, 0.0f, -1.0f, 0.0f };
 
-                // If the buffer is full: good! That means we are well ahead of the robot.
-                // Remain in this loop until there is room in the buffer.
-                while(plan_check_full_buffer()) {
-                    protocol_auto_cycle_start();     // Auto-cycle start when buffer is full.
-                    if(!protocol_execute_realtime()) // Check for any run-time commands
-                        return false;                // Bail, if system abort.
-                }
+    uint_fast8_t q;
+    float point[N_AXIS];
 
-                plan_buffer_line(target_prev, &pl_backlash);
-            }
+    memcpy(point, target, sizeof(point));
 
-            memcpy(target_prev, target, sizeof(float) * N_AXIS);
+    for(q = 0; q < 4; q++) {
+        if(plan_arc_crosses_angle(arc, (float)q * (0.5f * M_PI))) {
+            point[arc->axis_0] = arc->center[0] + arc->radius * cos_q[q];
+            point[arc->axis_1] = arc->center[1] + arc->radius * cos_q[(q + 3) & 0x03]; // sin(q * pi/2)
+            limits_soft_check(point);
         }
+    }
+}
 
-#endif // Backlash comp
+// Queues the arc as a single planner block, the chords are computed by the step segment generator.
+static void native_arc (float *target, plan_line_data_t *pl_data, float *position, float *offset, float radius,
+                         float angular_travel, plane_t plane)
+{
+    plan_arc_t arc;
+    uint_fast8_t idx = N_AXIS;
+    float planar = angular_travel * radius;
+
+    arc.axis_0 = plane.axis_0;
+    arc.axis_1 = plane.axis_1;
+    arc.center[0] = position[plane.axis_0] + offset[plane.axis_0];
+    arc.center[1] = position[plane.axis_1] + offset[plane.axis_1];
+    arc.r[0] = -offset[plane.axis_0];
+    arc.r[1] = -offset[plane.axis_1];
+    arc.radius = radius;
+    arc.angular_travel = angular_travel;
+    arc.max_chord = settings.arc_tolerance < radius ? 2.0f * sqrtf(settings.arc_tolerance * (2.0f * radius - settings.arc_tolerance)) : 2.0f * radius;
+    arc.length = planar * planar;
 
-#ifdef KINEMATICS_API
-     kinematics.segment_line(target, pl_data, true);
+    do {
+        idx--;
+        arc.start[idx] = position[idx];
+        if(idx == plane.axis_0 || idx == plane.axis_1)
+            arc.delta[idx] = 0.0f;
+        else {
+            arc.delta[idx] = target[idx] - position[idx];
+            arc.length += arc.delta[idx] * arc.delta[idx];
+        }
+    } while(idx);
 
-     while(kinematics.segment_line(target, pl_data, false)) {
-#endif
-        // If the buffer is full: good! That means we are well ahead of the robot.
-        // Remain in this loop until there is room in the buffer.
-         do {
-            if(!protocol_execute_realtime())    // Check for any run-time commands
-                return false;                   // Bail, if system abort.
-            if(plan_check_full_buffer())
-                protocol_auto_cycle_start();    // Auto-cycle start when buffer is full.
-            else
-                break;
-        } while(true);
+    arc.length = sqrtf(arc.length);
 
-        // Plan and queue motion into planner buffer
-        // bool plan_status; // Not used in normal operation.
-        if(!plan_buffer_line(target, pl_data) && settings.flags.laser_mode && pl_data->condition.spindle.on && !pl_data->condition.spindle.ccw) {
-            // Correctly set spindle state, if there is a coincident position passed.
-            // Forces a buffer sync while in M3 laser mode only.
-            hal.spindle_set_state(pl_data->condition.spindle, pl_data->spindle.rpm);
-        }
-#ifdef KINEMATICS_API
-      }
-#endif
+    if(settings.limits.flags.soft_enabled) {
+        arc_soft_check(target, &arc);
+        if(ABORTED)
+            return;
     }
 
-    return !ABORTED;
+    pl_data->arc = &arc;
+    mc_line(target, pl_data);
+    pl_data->arc = NULL;
 }
 
+#endif
 
 // Execute an arc in offset mode format. position == current xyz, target == target xyz,
 // offset == offset from current xyz, axis_X defines circle plane in tool space, axis_linear is
@@ -180,8 +541,8 @@ bool mc_line (float *target, plan_line_data_t *pl_data)
 // The arc is approximated by generating a huge number of tiny, linear segments. The chordal tolerance
 // of each segment is configured in settings.arc_tolerance, which is defined to be the maximum normal
 // distance from segment to the circle when the end points both lie on the circle.
-void mc_arc (float *target, plan_line_data_t *pl_data, float *position, float *offset, float radius,
-              plane_t plane, bool is_clockwise_arc)
+static void generate_arc (float *target, plan_line_data_t *pl_data, float *position, float *offset, float radius,
+                           plane_t plane, bool is_clockwise_arc)
 {
     float center_axis0 = position[plane.axis_0] + offset[plane.axis_0];
     float center_axis1 = position[plane.axis_1] + offset[plane.axis_1];
@@ -205,10 +566,42 @@ void mc_arc (float *target, plan_line_data_t *pl_data, float *position, float *o
     // (2x) settings.arc_tolerance. For 99% of users, this is just fine. If a different arc segment fit
     // is desired, i.e. least-squares, midpoint on arc, just change the mm_per_arc_segment calculation.
     // For the intended uses of Grbl, this value shouldn't exceed 2000 for the strictest of cases.
+#ifdef ENABLE_ADAPTIVE_ARC_SEGMENTATION
+    float mm_per_arc_segment = 2.0f * sqrtf(settings.arc_tolerance * (2.0f * radius - settings.arc_tolerance));
+    float max_tolerance = settings.arc_tolerance * max(ARC_ADAPTIVE_TOLERANCE_SCALE, 1.0f);
+
+    if (max_tolerance < radius) {
+        // Lengthen chords to at least one acceleration tick at the programmed feed rate and to at least
+        // ARC_MIN_CHORD_STEPS steps, with the chord deviation up to ARC_ADAPTIVE_TOLERANCE_SCALE times the arc tolerance.
+        float feed_rate = pl_data->condition.inverse_time ? pl_data->feed_rate * fabsf(angular_travel * radius) : pl_data->feed_rate;
+        float min_chord = max(feed_rate / (ACCELERATION_TICKS_PER_SECOND * 60.0f),
+                               (float)ARC_MIN_CHORD_STEPS / min(settings.steps_per_mm[plane.axis_0], settings.steps_per_mm[plane.axis_1]));
+        if (min_chord > mm_per_arc_segment)
+            mm_per_arc_segment = min(min_chord, 2.0f * sqrtf(max_tolerance * (2.0f * radius - max_tolerance)));
+    }
+
+    uint16_t segments = (uint16_t)floorf(fabsf(angular_travel * radius) / mm_per_arc_segment);
+#else
     uint16_t segments = (uint16_t)floorf(fabsf(0.5f * angular_travel * radius) / sqrtf(settings.arc_tolerance * (2.0f * radius - settings.arc_tolerance)));
+#endif
 
     if (segments) {
 
+#ifdef ENABLE_NATIVE_ARCS
+        // Spindle synchronized arcs and arcs with backlash or height map compensation active are segmented here.
+        if (!pl_data->condition.spindle.synchronized
+  #ifdef ENABLE_BACKLASH_COMPENSATION
+             && !plan_get_backlash_axes().mask
+  #endif
+  #ifdef ENABLE_HEIGHT_MAP
+             && !height_map_active()
+  #endif
+           ) {
+            native_arc(target, pl_data, position, offset, radius, angular_travel, plane);
+            return;
+        }
+#endif
+
         // Multiply inverse feed_rate to compensate for the fact that this movement is approximated
         // by a number of discrete segments. The inverse feed_rate should be correct for the sum of
         // all segments.
@@ -282,270 +675,393 @@ void mc_arc (float *target, plan_line_data_t *pl_data, float *position, float *o
             // Bail mid-circle on system abort. Runtime command check already performed by mc_line.
             if(!mc_line(position, pl_data))
                 return;
+
+            pl_data->condition.exact_stop = Off; // Exact stop mode (G61.1) stops at the start of the arc only.
         }
     }
     // Ensure last segment arrives at target location.
     mc_line(target, pl_data);
 }
 
-// Bezier splines, from a pull request for Marlin
-// By Giovanni Mascellani - https://github.com/giomasce/Marlin
-
-// Compute the linear interpolation between two real numbers.
-static inline float interp(const float a, const float b, const float t)
-{
-    return (1.0f - t) * a + t * b;
-}
-
-/**
- * Compute a Bzier curve using the De Casteljau's algorithm (see
- * https://en.wikipedia.org/wiki/De_Casteljau's_algorithm), which is
- * easy to code and has good numerical stability (very important,
- * since Arudino works with limited precision real numbers).
- */
-static inline float eval_bezier(const float a, const float b, const float c, const float d, const float t)
-{
-    const float iab = interp(a, b, t),
-                ibc = interp(b, c, t),
-                icd = interp(c, d, t),
-                iabc = interp(iab, ibc, t),
-                ibcd = interp(ibc, icd, t);
-
-    return interp(iabc, ibcd, t);
-}
-
-/**
- * We approximate Euclidean distance with the sum of the coordinates
- * offset (so-called "norm 1"), which is quicker to compute.
- */
-static inline float dist1(const float x1, const float y1, const float x2, const float y2)
-{
-    return fabsf(x1 - x2) + fabsf(y1 - y2);
-}
-
-/**
- * The algorithm for computing the step is loosely based on the one in Kig
- * (See https://sources.debian.net/src/kig/4:15.08.3-1/misc/kigpainter.cpp/#L759)
- * However, we do not use the stack.
- *
- * The algorithm goes as it follows: the parameters t runs from 0.0 to
- * 1.0 describing the curve, which is evaluated by eval_bezier(). At
- * each iteration we have to choose a step, i.e., the increment of the
- * t variable. By default the step of the previous iteration is taken,
- * and then it is enlarged or reduced depending on how straight the
- * curve locally is. The step is always clamped between MIN_STEP/2 and
- * 2*MAX_STEP. MAX_STEP is taken at the first iteration.
- *
- * For some t, the step value is considered acceptable if the curve in
- * the interval [t, t+step] is sufficiently straight, i.e.,
- * sufficiently close to linear interpolation. In practice the
- * following test is performed: the distance between eval_bezier(...,
- * t+step/2) is evaluated and compared with 0.5*(eval_bezier(...,
- * t)+eval_bezier(..., t+step)). If it is smaller than SIGMA, then the
- * step value is considered acceptable, otherwise it is not. The code
- * seeks to find the larger step value which is considered acceptable.
- *
- * At every iteration the recorded step value is considered and then
- * iteratively halved until it becomes acceptable. If it was already
- * acceptable in the beginning (i.e., no halving were done), then
- * maybe it was necessary to enlarge it; then it is iteratively
- * doubled while it remains acceptable. The last acceptable value
- * found is taken, provided that it is between MIN_STEP and MAX_STEP
- * and does not bring t over 1.0.
- *
- * Caveat: this algorithm is not perfect, since it can happen that a
- * step is considered acceptable even when the curve is not linear at
- * all in the interval [t, t+step] (but its mid point coincides "by
- * chance" with the midpoint according to the parametrization). This
- * kind of glitches can be eliminated with proper first derivative
- * estimates; however, given the improbability of such configurations,
- * the mitigation offered by MIN_STEP and the small computational
- * power available on Arduino, I think it is not wise to implement it.
- */
+void mc_arc (float *target, plan_line_data_t *pl_data, float *position, float *offset, float radius,
+              plane_t plane, bool is_clockwise_arc)
+{
+    PERF_START(t);
 
-void mc_cubic_b_spline (float *target, plan_line_data_t *pl_data, float *position, float *offset1, float *offset2)
+    generate_arc(target, pl_data, position, offset, radius, plane, is_clockwise_arc);
+
+    PERF_END(Perf_ArcGenerate, t);
+}
+
+// Cubic Bezier splines
+
+/*
+  The spline is evaluated at n evenly spaced parameter values by forward differencing, three additions per
+  axis and point. Written as a polynomial relative to the start point, P(t) = a*t^3 + b*t^2 + c*t, the second
+  derivative P''(t) = 6*a*t + 2*b is linear in t so its largest magnitude is found at one of the end points.
+  The deviation of a chord spanning the parameter interval h from the curve is at most h^2/8 * max|P''|,
+  n is set so that this does not exceed BEZIER_SIGMA and is then clamped to the number of chords given
+  by BEZIER_MAX_STEP and BEZIER_MIN_STEP. The differences are kept relative to the start point to limit
+  the accumulated round-off error, the last chord ends at the programmed target.
+*/
+static void generate_spline (float *target, plan_line_data_t *pl_data, float *position, float *offset1, float *offset2)
 {
-    // Absolute first and second control points are recovered.
+    uint_fast8_t idx;
+    uint32_t n, i;
+    float a[2], b[2], c[2], d1[2], d2[2], d3[2], p[2] = {0}, bez_target[N_AXIS];
+
+    for(idx = 0; idx < 2; idx++) {
+        // Control points relative to the start point: first = offset1, second = target + offset2, end = target.
+        float p1 = offset1[idx], p2 = target[idx] + offset2[idx] - position[idx], p3 = target[idx] - position[idx];
+        a[idx] = 3.0f * (p1 - p2) + p3;
+        b[idx] = 3.0f * (p2 - 2.0f * p1);
+        c[idx] = 3.0f * p1;
+    }
+
+    float accel_sqr = max(b[X_AXIS] * b[X_AXIS] + b[Y_AXIS] * b[Y_AXIS],
+                           (3.0f * a[X_AXIS] + b[X_AXIS]) * (3.0f * a[X_AXIS] + b[X_AXIS]) + (3.0f * a[Y_AXIS] + b[Y_AXIS]) * (3.0f * a[Y_AXIS] + b[Y_AXIS]));
+
+    // max|P''| = 2 * sqrt(accel_sqr), n = sqrt(max|P''| / (8 * BEZIER_SIGMA))
+    n = (uint32_t)ceilf(sqrtf(sqrtf(accel_sqr) * (0.25f / BEZIER_SIGMA)));
+    n = min(max(n, (uint32_t)ceilf(1.0f / BEZIER_MAX_STEP)), (uint32_t)(1.0f / BEZIER_MIN_STEP));
 
-    float first[2] = { position[X_AXIS] + offset1[X_AXIS], position[Y_AXIS] + offset1[Y_AXIS] };
-    float second[2] = { target[X_AXIS] + offset2[X_AXIS], target[Y_AXIS] + offset2[Y_AXIS] };
-    float bez_target[N_AXIS];
+    float h = 1.0f / (float)n, h2 = h * h, h3 = h2 * h;
+
+    for(idx = 0; idx < 2; idx++) {
+        d1[idx] = a[idx] * h3 + b[idx] * h2 + c[idx] * h;
+        d3[idx] = 6.0f * a[idx] * h3;
+        d2[idx] = d3[idx] + 2.0f * b[idx] * h2;
+    }
 
     memcpy(bez_target, position, sizeof(float) * N_AXIS);
 
-    float t = 0.0f, step = BEZIER_MAX_STEP;
+    for(i = 1; i < n; i++) {
 
-    while (t < 1.0f) {
+        for(idx = 0; idx < 2; idx++) {
+            p[idx] += d1[idx];
+            d1[idx] += d2[idx];
+            d2[idx] += d3[idx];
+            bez_target[idx] = position[idx] + p[idx];
+        }
 
-        // First try to reduce the step in order to make it sufficiently
-        // close to a linear interpolation.
-        bool did_reduce = false;
-        float new_t = t + step;
+        // Bail mid-spline on system abort. Runtime command check already performed by mc_line.
+        if(!mc_line(bez_target, pl_data))
+            return;
 
-        if(new_t > 1.0f)
-            new_t = 1.0f;
+        pl_data->condition.exact_stop = Off; // Exact stop mode (G61.1) stops at the start of the spline only.
+    }
 
-        float new_pos0 = eval_bezier(position[X_AXIS], first[X_AXIS], second[X_AXIS], target[X_AXIS], new_t),
-              new_pos1 = eval_bezier(position[Y_AXIS], first[Y_AXIS], second[Y_AXIS], target[Y_AXIS], new_t);
+    mc_line(target, pl_data);
+}
 
-        while(new_t - t >= (BEZIER_MIN_STEP)) {
+void mc_cubic_b_spline (float *target, plan_line_data_t *pl_data, float *position, float *offset1, float *offset2)
+{
+    PERF_START(t);
 
-//            if (new_t - t < (BEZIER_MIN_STEP))
-//                break;
+    generate_spline(target, pl_data, position, offset1, offset2);
 
-            const float candidate_t = 0.5f * (t + new_t),
-                      candidate_pos0 = eval_bezier(position[X_AXIS], first[X_AXIS], second[X_AXIS], target[X_AXIS], candidate_t),
-                      candidate_pos1 = eval_bezier(position[Y_AXIS], first[Y_AXIS], second[Y_AXIS], target[Y_AXIS], candidate_t),
-                      interp_pos0 = 0.5f * (bez_target[X_AXIS] + new_pos0),
-                      interp_pos1 = 0.5f * (bez_target[Y_AXIS] + new_pos1);
+    PERF_END(Perf_SplineGenerate, t);
+}
 
-            if (dist1(candidate_pos0, candidate_pos1, interp_pos0, interp_pos1) <= (BEZIER_SIGMA))
-                break;
+// end Bezier splines
 
-            new_t = candidate_t;
-            new_pos0 = candidate_pos0;
-            new_pos1 = candidate_pos1;
-            did_reduce = true;
-        }
+// Canned drilling cycles (G73, G81 - G83) are expanded by a resumable generator stepped by the protocol loop.
+// mc_canned_drill() only sets up the cycle, moves are queued as planner buffer space becomes available
+// so that the input stream is consumed and parsed while long hole patterns execute. Cycles set up while
+// one is pending, e.g. the next hole of a pattern, wait in a queue of CANNED_CYCLE_QUEUE_SIZE entries.
+// Pending cycles are flushed when other motion is planned, on buffer synchronization and before system
+// commands other than reports.
+
+typedef enum {
+    CannedStep_Idle = 0,
+    CannedStep_ClearToR,    // rapid move to R if current Z < R
+    CannedStep_MoveXY,      // rapid move to X, Y
+    CannedStep_DownToR,     // rapid move to R if current Z > R
+    CannedStep_Drill,       // feed to next peck depth
+    CannedStep_Dwell,       // dwell and/or stop spindle at peck depth
+    CannedStep_Retract,     // retract from peck depth
+    CannedStep_SpindleOn,   // restart spindle after retract
+    CannedStep_NextHole,    // rapid move to next position if incremental mode
+    CannedStep_FinalRetract // retract to previous position if G98 mode
+} canned_step_t;
+
+typedef struct {
+    canned_step_t step;
+    motion_mode_t motion;
+    plane_t plane;
+    uint32_t repeats;           // Number of holes left, including the current one.
+    bool incremental;
+    float current_z;
+    float position[N_AXIS];     // Target of the last move generated.
+    float target[N_AXIS];       // First hole position.
+    gc_canned_t canned;
+    spindle_state_t spindle;
+    plan_line_data_t pl_data;   // Owns the message and output commands until handed over to the planner.
+} canned_cycle_t;
+
+static canned_cycle_t cycle = {0};
+static canned_cycle_t cycle_queue[CANNED_CYCLE_QUEUE_SIZE];
+static uint_fast8_t cycle_tail = 0, cycle_queued = 0;
+static bool cycle_stepping = false;
+
+// Start next peck depth or, if at bottom, next hole.
+static canned_step_t canned_peck_done (canned_cycle_t *c)
+{
+    if(c->current_z > c->canned.xyz[c->plane.axis_linear])
+        return CannedStep_Drill;
 
-        // If we did not reduce the step, maybe we should enlarge it.
-        if (!did_reduce) while (new_t - t <= BEZIER_MAX_STEP) {
+    if(--c->repeats == 0)
+        return CannedStep_FinalRetract;
 
-//            if (new_t - t > BEZIER_MAX_STEP)
-//                break;
+    c->current_z = c->canned.retract_position;
 
-            const float candidate_t = t + 2.0f * (new_t - t);
+    return c->incremental ? CannedStep_NextHole : canned_peck_done(c);
+}
 
-            if (candidate_t >= 1.0f)
-                break;
+// Generate next move or action of the cycle, motions are only queued and actions only performed if execute is true.
+// Returns false if aborted.
+static bool canned_next (canned_cycle_t *c, bool execute)
+{
+    bool move = true;
+    canned_step_t next = CannedStep_Idle;
+    uint_fast8_t axis_z = c->plane.axis_linear;
+
+    switch(c->step) {
+
+        case CannedStep_ClearToR:
+            if((move = c->position[axis_z] < c->canned.retract_position))
+                c->position[axis_z] = c->canned.retract_position;
+            next = CannedStep_MoveXY;
+            break;
+
+        case CannedStep_MoveXY:
+            memcpy(c->position, c->target, sizeof(c->position));
+            c->position[axis_z] = c->canned.prev_position > c->canned.retract_position ? c->canned.prev_position : c->canned.retract_position;
+            next = CannedStep_DownToR;
+            break;
+
+        case CannedStep_DownToR:
+            if((move = c->position[axis_z] > c->canned.retract_position))
+                c->position[axis_z] = c->canned.retract_position;
+            if(c->canned.retract_mode == CCRetractMode_RPos)
+                c->canned.prev_position = c->canned.retract_position;
+            c->current_z = c->canned.retract_position;
+            next = c->repeats ? canned_peck_done(c) : CannedStep_FinalRetract;
+            break;
+
+        case CannedStep_Drill:
+            c->current_z -= c->canned.delta;
+            if(c->current_z < c->canned.xyz[axis_z])
+                c->current_z = c->canned.xyz[axis_z];
+            c->pl_data.condition.rapid_motion = Off;
+            c->position[axis_z] = c->current_z;
+            next = c->canned.dwell > 0.0f || c->canned.spindle_off ? CannedStep_Dwell : CannedStep_Retract;
+            break;
+
+        case CannedStep_Dwell:
+            move = false;
+            if(execute) {
+                if(c->canned.dwell > 0.0f)
+                    mc_dwell(c->canned.dwell);
+                if(c->canned.spindle_off)
+                    hal.spindle_set_state((spindle_state_t){0}, 0.0f);
+            }
+            next = CannedStep_Retract;
+            break;
 
-            const float candidate_pos0 = eval_bezier(position[X_AXIS], first[X_AXIS], second[X_AXIS], target[X_AXIS], candidate_t),
-                      candidate_pos1 = eval_bezier(position[Y_AXIS], first[Y_AXIS], second[Y_AXIS], target[Y_AXIS], candidate_t),
-                      interp_pos0 = 0.5f * (bez_target[X_AXIS] + candidate_pos0),
-                      interp_pos1 = 0.5f * (bez_target[Y_AXIS] + candidate_pos1);
+        case CannedStep_Retract:
+            if(c->motion == MotionMode_DrillChipBreak && c->position[axis_z] != c->canned.xyz[axis_z])
+                c->position[axis_z] += settings.g73_retract;
+            else
+                c->position[axis_z] = c->canned.retract_position;
+            c->pl_data.condition.rapid_motion = c->canned.rapid_retract;
+            next = c->canned.spindle_off ? CannedStep_SpindleOn : canned_peck_done(c);
+            break;
+
+        case CannedStep_SpindleOn:
+            move = false;
+            if(execute)
+                spindle_sync(c->spindle, c->pl_data.spindle.rpm);
+            next = canned_peck_done(c);
+            break;
+
+        case CannedStep_NextHole:
+            c->position[c->plane.axis_0] += c->canned.xyz[c->plane.axis_0];
+            c->position[c->plane.axis_1] += c->canned.xyz[c->plane.axis_1];
+            c->position[axis_z] = c->canned.prev_position;
+            c->pl_data.condition.rapid_motion = On;
+            next = canned_peck_done(c);
+            break;
+
+        case CannedStep_FinalRetract:
+            if((move = c->canned.retract_mode == CCRetractMode_Previous && c->motion != MotionMode_DrillChipBreak && c->position[axis_z] < c->canned.prev_position)) {
+                c->pl_data.condition.rapid_motion = On;
+                c->position[axis_z] = c->canned.prev_position;
+            }
+            break;
 
-            if (dist1(new_pos0, new_pos1, interp_pos0, interp_pos1) > (BEZIER_SIGMA))
-                break;
+        default:
+            move = false;
+            break;
+    }
 
-            new_t = candidate_t;
-            new_pos0 = candidate_pos0;
-            new_pos1 = candidate_pos1;
-        }
+    if(move && execute && !mc_line(c->position, &c->pl_data)) {
+        mc_canned_discard();
+        return false;
+    }
 
-        // Check some postcondition; they are disabled in the actual
-        // Marlin build, but if you test the same code on a computer you
-        // may want to check they are respect.
-        /*
-          assert(new_t <= 1.0);
-          if (new_t < 1.0) {
-            assert(new_t - t >= (MIN_STEP) / 2.0);
-            assert(new_t - t <= (MAX_STEP) * 2.0);
-          }
-        */
+    c->step = next;
 
-        step = new_t - t;
-        t = new_t;
+    return true;
+}
 
-        bez_target[X_AXIS] = new_pos0;
-        bez_target[Y_AXIS] = new_pos1;
+// Returns true if the step has to wait for all queued motions to complete.
+static inline bool canned_needs_sync (canned_cycle_t *c)
+{
+    return (c->step == CannedStep_Dwell && c->canned.dwell > 0.0f) || c->step == CannedStep_SpindleOn;
+}
 
-        // Bail mid-spline on system abort. Runtime command check already performed by mc_line.
-        if(!mc_line(bez_target, pl_data))
-            return;
+// Makes the oldest queued cycle the active one when the active cycle is done.
+// Returns false if no cycle is pending.
+static bool canned_load_next (void)
+{
+    if(cycle.step == CannedStep_Idle && cycle_queued) {
+        memcpy(&cycle, &cycle_queue[cycle_tail], sizeof(canned_cycle_t));
+        if(++cycle_tail == CANNED_CYCLE_QUEUE_SIZE)
+            cycle_tail = 0;
+        cycle_queued--;
     }
-}
 
-// end Bezier splines
+    return cycle.step != CannedStep_Idle;
+}
 
-void mc_canned_drill (motion_mode_t motion, float *target, plan_line_data_t *pl_data, float *position, plane_t plane, uint32_t repeats, gc_canned_t *canned)
+// Queue all remaining moves of the active cycle, blocks until done. Returns false if aborted.
+static bool canned_flush_active (void)
 {
-    pl_data->condition.rapid_motion = On; // Set rapid motion condition flag.
+    bool ok = true;
 
-    // if current Z < R, rapid move to R
-    if(position[plane.axis_linear] < canned->retract_position) {
-        position[plane.axis_linear] = canned->retract_position;
-        if(!mc_line(position, pl_data))
-            return;
-    }
+    while(cycle.step != CannedStep_Idle && (ok = canned_next(&cycle, true)));
 
-    // rapid move to X, Y
-    memcpy(position, target, sizeof(float) * N_AXIS);
-    position[plane.axis_linear] = canned->prev_position > canned->retract_position ? canned->prev_position : canned->retract_position;
-    if(!mc_line(position, pl_data))
-        return;
+    return ok;
+}
 
-    // if current Z > R, rapid move to R
-    if(position[plane.axis_linear] > canned->retract_position) {
-        position[plane.axis_linear] = canned->retract_position;
-        if(!mc_line(position, pl_data))
-            return;
+// Release the message and output commands of a cycle not taken by the planner.
+static void canned_release (canned_cycle_t *c)
+{
+    if(c->pl_data.message) {
+        pool_message_release(c->pl_data.message);
+        c->pl_data.message = NULL;
     }
 
-    if(canned->retract_mode == CCRetractMode_RPos)
-        canned->prev_position = canned->retract_position;
+    pool_output_commands_release(c->pl_data.output_commands);
+    c->pl_data.output_commands = NULL;
 
-    while(repeats--) {
+    c->step = CannedStep_Idle;
+}
 
-        float current_z = canned->retract_position;
+// Queue moves of pending canned cycles while there is room in the planner buffer, does not block.
+// Called from the protocol main loop.
+void mc_canned_step (void)
+{
+    if(cycle_stepping || !canned_load_next())
+        return;
 
-        while(current_z > canned->xyz[plane.axis_linear]) {
+    cycle_stepping = true;
 
-            current_z -= canned->delta;
-            if(current_z < canned->xyz[plane.axis_linear])
-                current_z = canned->xyz[plane.axis_linear];
+    while(canned_load_next() && !plan_check_full_buffer()) {
+        if(canned_needs_sync(&cycle) && (plan_get_current_block() || sys.state == STATE_CYCLE))
+            break;
+        if(!canned_next(&cycle, true))
+            break;
+    }
 
-            pl_data->condition.rapid_motion = Off;
+    cycle_stepping = false;
+}
 
-            position[plane.axis_linear] = current_z;
-            if(!mc_line(position, pl_data)) // drill
-                return;
+// Queue all remaining moves of pending canned cycles, blocks until done. Returns false if aborted.
+// Called before other motion is planned, on buffer synchronization and before system commands.
+bool mc_canned_flush (void)
+{
+    bool ok = true;
 
-            if(canned->dwell > 0.0f)
-                mc_dwell(canned->dwell);
+    if(cycle_stepping || !canned_load_next())
+        return ok;
 
-            if(canned->spindle_off)
-                hal.spindle_set_state((spindle_state_t){0}, 0.0f);
+    cycle_stepping = true;
 
-            // rapid retract
-            switch(motion) {
+    while(ok && canned_load_next())
+        ok = canned_flush_active();
 
-                case MotionMode_DrillChipBreak:
-                    position[plane.axis_linear] = position[plane.axis_linear] == canned->xyz[plane.axis_linear]
-                                                   ? canned->retract_position
-                                                   : position[plane.axis_linear] + settings.g73_retract;
-                    break;
+    cycle_stepping = false;
 
-                default:
-                    position[plane.axis_linear] = canned->retract_position;
-                    break;
-            }
+    return ok;
+}
 
-            pl_data->condition.rapid_motion = canned->rapid_retract;
-            if(!mc_line(position, pl_data))
-                return;
+// Returns true if a canned cycle has moves not yet queued.
+bool mc_canned_pending (void)
+{
+    return cycle.step != CannedStep_Idle || cycle_queued;
+}
 
-            if(canned->spindle_off)
-                spindle_sync(gc_state.modal.spindle, pl_data->spindle.rpm);
-        }
+// Discard any pending canned cycles, releases messages and output commands not taken by the planner.
+void mc_canned_discard (void)
+{
+    canned_release(&cycle);
 
-       // rapid move to next position if incremental mode
-        if(repeats && gc_state.modal.distance_incremental) {
-            position[plane.axis_0] += canned->xyz[plane.axis_0];
-            position[plane.axis_1] += canned->xyz[plane.axis_1];
-            position[plane.axis_linear] = canned->prev_position;
-            if(!mc_line(position, pl_data))
-                return;
-        }
+    while(cycle_queued) {
+        canned_release(&cycle_queue[cycle_tail]);
+        if(++cycle_tail == CANNED_CYCLE_QUEUE_SIZE)
+            cycle_tail = 0;
+        cycle_queued--;
     }
+}
 
-    memcpy(target, position, sizeof(float) * N_AXIS);
+// Set up a canned drilling cycle for execution by mc_canned_step(), the cycle is queued if one is pending.
+// NOTE: target is returned with the final position of the cycle, any message and output commands
+// in pl_data are handed over to the cycle.
+void mc_canned_drill (motion_mode_t motion, float *target, plan_line_data_t *pl_data, float *position, plane_t plane, uint32_t repeats, gc_canned_t *canned)
+{
+    canned_cycle_t *c, dry;
+
+    // If the queue is full wait for the active cycle to be queued to the planner.
+    if(cycle_queued == CANNED_CYCLE_QUEUE_SIZE && !cycle_stepping) {
+        cycle_stepping = true;
+        canned_flush_active();
+        canned_load_next();
+        cycle_stepping = false;
+    }
 
-    if(canned->retract_mode == CCRetractMode_Previous && motion != MotionMode_DrillChipBreak && target[plane.axis_linear] < canned->prev_position) {
-        pl_data->condition.rapid_motion = On;
-        target[plane.axis_linear] = canned->prev_position;
-        if(!mc_line(target, pl_data))
-            return;
+    if(cycle.step == CannedStep_Idle && cycle_queued == 0)
+        c = &cycle;
+    else {
+        c = &cycle_queue[(cycle_tail + cycle_queued) % CANNED_CYCLE_QUEUE_SIZE];
+        cycle_queued++;
     }
+
+    c->step = CannedStep_ClearToR;
+    c->motion = motion;
+    c->plane = plane;
+    c->repeats = repeats;
+    c->incremental = gc_state.modal.distance_incremental;
+    c->spindle = gc_state.modal.spindle;
+    memcpy(c->position, position, sizeof(c->position));
+    memcpy(c->target, target, sizeof(c->target));
+    memcpy(&c->canned, canned, sizeof(gc_canned_t));
+    memcpy(&c->pl_data, pl_data, sizeof(plan_line_data_t));
+    c->pl_data.condition.rapid_motion = On; // Set rapid motion condition flag.
+
+    pl_data->message = NULL;
+    pl_data->output_commands = NULL;
+
+    // Run the generator without queuing moves to get the final position for the parser.
+    memcpy(&dry, c, sizeof(canned_cycle_t));
+    while(dry.step != CannedStep_Idle)
+        canned_next(&dry, false);
+
+    memcpy(target, dry.position, sizeof(dry.position));
+
+    if(canned->retract_mode == CCRetractMode_RPos)
+        canned->prev_position = canned->retract_position;
 }
 
 // Calculates depth-of-cut (DOC) for a given threading pass.
@@ -693,6 +1209,11 @@ status_code_t mc_jog_execute (plan_line_data_t *pl_data, parser_block_t *gc_bloc
     else if (settings.limits.flags.soft_enabled && !system_check_travel_limits(gc_block->values.xyz))
         return Status_TravelExceeded;
 
+#ifdef ENABLE_HOLD_JOG
+    if(sys.state == STATE_HOLD)
+        return state_hold_jog_motion(gc_block->values.xyz, pl_data);
+#endif
+
     // Valid jog command. Plan, set state, and execute.
     mc_line(gc_block->values.xyz, pl_data);
     if ((sys.state == STATE_IDLE || sys.state == STATE_TOOL_CHANGE) && plan_get_current_block() != NULL) { // Check if there is a block to execute.
@@ -704,6 +1225,300 @@ status_code_t mc_jog_execute (plan_line_data_t *pl_data, parser_block_t *gc_bloc
     return Status_OK;
 }
 
+#ifdef ENABLE_JOG_CONTINUOUS
+
+/*
+  Continuous (velocity) jogging for keypads and MPGs. While active a short rolling horizon of jog blocks is
+  kept queued ahead of the current position: the braking distance at the jog rate plus the travel during
+  JOG_CONTINUOUS_SEGMENTS step segments. The planner thus cruises at the jog rate and a stop decelerates
+  at once by the motion cancel path, as for a jog cancel, without having to drain long jog blocks first.
+  Direction and rate changes are applied to the blocks queued from then on.
+*/
+
+static struct {
+    volatile bool active;
+    float unit_vec[N_AXIS];     // Jog direction
+    float feed_rate;            // Jog rate (mm/min)
+    float horizon;              // Travel to keep queued ahead of the current position (mm)
+    float block_length;         // Length of the blocks queued (mm)
+    float target[N_AXIS];       // End of the last block queued, machine position (mm)
+    uint32_t refreshed;         // Time of last start or refresh (ms)
+} jog = {0};
+
+status_code_t mc_jog_continuous_start (float *direction, float feed_rate)
+{
+    float unit_vec[N_AXIS], rate, accel, travel;
+
+    if(!(sys.state == STATE_IDLE || (sys.state == STATE_JOG && jog.active)))
+        return Status_IdleError;
+
+    if(feed_rate <= 0.0f)
+        return Status_NonPositiveValue;
+
+    memcpy(unit_vec, direction, sizeof(unit_vec));
+    if(convert_delta_vector_to_unit_vector(unit_vec) == 0.0f)
+        return Status_InvalidStatement;
+
+    rate = min(feed_rate, limit_value_by_axis_maximum(settings.max_rate, unit_vec));
+    accel = limit_value_by_axis_maximum(settings.acceleration, unit_vec);
+    travel = rate * (float)JOG_CONTINUOUS_SEGMENTS / (ACCELERATION_TICKS_PER_SECOND * 60.0f);
+
+    if(!jog.active)
+        plan_get_planner_mpos(jog.target);
+
+    memcpy(jog.unit_vec, unit_vec, sizeof(unit_vec));
+    jog.feed_rate = rate;
+    jog.horizon = rate * rate / (2.0f * accel) + travel;
+    // Keep the horizon within half the planner buffer.
+    jog.block_length = max(travel, jog.horizon / (float)(plan_get_block_buffer_size() >> 1));
+    jog.refreshed = hal.get_elapsed_ticks ? hal.get_elapsed_ticks() : 0;
+    jog.active = true;
+
+    return Status_OK;
+}
+
+bool mc_jog_continuous_refresh (void)
+{
+    if(jog.active && hal.get_elapsed_ticks)
+        jog.refreshed = hal.get_elapsed_ticks();
+
+    return jog.active;
+}
+
+// Ends continuous jogging, may be called from an interrupt handler.
+void mc_jog_continuous_stop (void)
+{
+    if(jog.active) {
+        jog.active = false;
+        if(sys.state == STATE_JOG) {
+            system_set_exec_state_flag(EXEC_MOTION_CANCEL);
+            system_pend_realtime();
+        }
+    }
+}
+
+// Queues jog blocks as needed to keep the horizon ahead of the current position, called from the protocol loop.
+// Ends the jog if not refreshed within JOG_CONTINUOUS_TIMEOUT ms or when jogging is cancelled by other means.
+void mc_jog_continuous_step (void)
+{
+    if(!jog.active)
+        return;
+
+    if(sys.suspend || (sys_rt_exec_state & EXEC_MOTION_CANCEL) || !(sys.state == STATE_IDLE || sys.state == STATE_JOG) ||
+        (hal.get_elapsed_ticks && hal.get_elapsed_ticks() - jog.refreshed > JOG_CONTINUOUS_TIMEOUT)) {
+        mc_jog_continuous_stop();
+        return;
+    }
+
+    uint_fast8_t idx;
+    int32_t steps[N_AXIS];
+    float position[N_AXIS], target[N_AXIS], distance = 0.0f, delta;
+    plan_line_data_t pl_data;
+
+    system_get_position(&steps);
+    system_convert_array_steps_to_mpos(position, steps);
+
+    idx = N_AXIS;
+    do {
+        idx--;
+        delta = jog.target[idx] - position[idx];
+        distance += delta * delta;
+    } while(idx);
+
+    distance = sqrtf(distance);
+
+    while(distance < jog.horizon && !plan_check_full_buffer()) {
+
+        idx = N_AXIS;
+        do {
+            idx--;
+            target[idx] = jog.target[idx] + jog.unit_vec[idx] * jog.block_length;
+        } while(idx);
+
+        // Stop at the soft limits.
+        if(settings.limits.flags.soft_enabled || settings.limits.flags.jog_soft_limited)
+            system_apply_jog_limits(target);
+
+        delta = 0.0f;
+        idx = N_AXIS;
+        do {
+            idx--;
+            delta += (target[idx] - jog.target[idx]) * jog.unit_vec[idx];
+        } while(idx);
+
+        if(delta < 0.5f * jog.block_length)
+            break; // At a limit, let the queued blocks run out.
+
+        memset(&pl_data, 0, sizeof(plan_line_data_t));
+        memcpy(&pl_data.spindle, &gc_state.spindle, sizeof(spindle_t));
+        pl_data.condition.spindle = gc_state.modal.spindle;
+        pl_data.condition.coolant = gc_state.modal.coolant;
+        pl_data.condition.is_rpm_rate_adjusted = gc_state.is_rpm_rate_adjusted;
+        pl_data.condition.no_feed_override = On;
+        pl_data.condition.jog_motion = On;
+        pl_data.feed_rate = jog.feed_rate;
+
+        if(!mc_line(target, &pl_data))
+            return;
+
+        memcpy(jog.target, target, sizeof(target));
+        memcpy(gc_state.position, target, sizeof(target));
+        distance += delta;
+    }
+
+    if(sys.state == STATE_IDLE && plan_get_current_block() != NULL) {
+        set_state(STATE_JOG);
+        st_prep_buffer();
+        st_wake_up();
+    }
+}
+
+#endif // ENABLE_JOG_CONTINUOUS
+
+#ifdef ENABLE_JOG_MPG
+
+/*
+  Handwheel (MPG) position following. Encoder counts are added, from interrupt context, to a per axis count that
+  the protocol loop moves the handwheel target by. Jog blocks are queued directly towards the target, bypassing
+  the g-code parser, and end on it so that motion stops where the wheel stops. The travel queued ahead of the
+  current position is limited to the braking distance at the jog rate plus the travel during JOG_MPG_SEGMENTS
+  step segments, a direction change of the wheel is thus followed after at most that distance.
+  Counts received while the machine is busy otherwise are discarded.
+*/
+
+static struct {
+    volatile int32_t counts[N_AXIS];    // Counts received
+    int32_t consumed[N_AXIS];           // Counts applied to the handwheel target or discarded
+    bool following;                     // The current jog is ours
+    bool pending;                       // Handwheel target not yet reached by the queued blocks
+    float wheel[N_AXIS];                // Handwheel target, machine position (mm)
+    float target[N_AXIS];               // End of the last block queued, machine position (mm)
+} mpg = {0};
+
+void mc_jog_mpg_move (uint_fast8_t axis, int32_t counts)
+{
+    if(axis < N_AXIS)
+        mpg.counts[axis] += counts;
+}
+
+// Queues a jog block towards the handwheel target if the horizon allows, called from the protocol loop.
+void mc_jog_mpg_step (void)
+{
+    uint_fast8_t idx = N_AXIS;
+    int32_t delta[N_AXIS];
+    bool moved = false;
+
+    do {
+        idx--;
+        delta[idx] = mpg.counts[idx] - mpg.consumed[idx];
+        mpg.consumed[idx] += delta[idx];
+        moved |= delta[idx] != 0;
+    } while(idx);
+
+    if(sys.state != STATE_JOG)
+        mpg.following = mpg.pending = false;
+
+    if(!(moved || mpg.pending))
+        return;
+
+    if(sys.suspend || (sys_rt_exec_state & EXEC_MOTION_CANCEL) ||
+#ifdef ENABLE_JOG_CONTINUOUS
+        jog.active ||
+#endif
+         !((sys.state == STATE_IDLE && plan_get_current_block() == NULL) || (sys.state == STATE_JOG && mpg.following))) {
+        mpg.pending = false;
+        return;
+    }
+
+    if(!mpg.following) {
+        plan_get_planner_mpos(mpg.target);
+        memcpy(mpg.wheel, mpg.target, sizeof(mpg.target));
+    }
+
+    if(moved) {
+        idx = N_AXIS;
+        do {
+            idx--;
+            mpg.wheel[idx] += (float)delta[idx] * JOG_MPG_DISTANCE;
+        } while(idx);
+
+        if(settings.limits.flags.soft_enabled || settings.limits.flags.jog_soft_limited)
+            system_apply_jog_limits(mpg.wheel);
+    }
+
+    float position[N_AXIS], unit_vec[N_AXIS], target[N_AXIS], length, queued = 0.0f, rate, accel, horizon, d;
+
+    idx = N_AXIS;
+    do {
+        idx--;
+        unit_vec[idx] = mpg.wheel[idx] - mpg.target[idx];
+    } while(idx);
+
+    if(!(mpg.pending = (length = convert_delta_vector_to_unit_vector(unit_vec)) > 0.0f))
+        return;
+
+    if(plan_check_full_buffer())
+        return;
+
+    int32_t steps[N_AXIS];
+
+    system_get_position(&steps);
+    system_convert_array_steps_to_mpos(position, steps);
+
+    idx = N_AXIS;
+    do {
+        idx--;
+        d = mpg.target[idx] - position[idx];
+        queued += d * d;
+    } while(idx);
+
+    queued = sqrtf(queued);
+
+    rate = limit_value_by_axis_maximum(settings.max_rate, unit_vec) * (float)JOG_MPG_RATE_PCT / 100.0f;
+    accel = limit_value_by_axis_maximum(settings.acceleration, unit_vec);
+    horizon = rate * rate / (2.0f * accel) + rate * (float)JOG_MPG_SEGMENTS / (ACCELERATION_TICKS_PER_SECOND * 60.0f);
+
+    // Wait for the queued travel to run down before adding more, the final block ends on the handwheel target.
+    if(queued >= horizon)
+        return;
+
+    if(length > horizon - queued) {
+        length = horizon - queued;
+        idx = N_AXIS;
+        do {
+            idx--;
+            target[idx] = mpg.target[idx] + unit_vec[idx] * length;
+        } while(idx);
+    } else
+        memcpy(target, mpg.wheel, sizeof(target));
+
+    plan_line_data_t pl_data;
+
+    memset(&pl_data, 0, sizeof(plan_line_data_t));
+    memcpy(&pl_data.spindle, &gc_state.spindle, sizeof(spindle_t));
+    pl_data.condition.spindle = gc_state.modal.spindle;
+    pl_data.condition.coolant = gc_state.modal.coolant;
+    pl_data.condition.is_rpm_rate_adjusted = gc_state.is_rpm_rate_adjusted;
+    pl_data.condition.no_feed_override = On;
+    pl_data.condition.jog_motion = On;
+    pl_data.feed_rate = rate;
+
+    if(!mc_line(target, &pl_data))
+        return;
+
+    memcpy(mpg.target, target, sizeof(target));
+    memcpy(gc_state.position, target, sizeof(target));
+
+    if(sys.state == STATE_IDLE && plan_get_current_block() != NULL) {
+        mpg.following = true;
+        set_state(STATE_JOG);
+        st_prep_buffer();
+        st_wake_up();
+    }
+}
+
+#endif // ENABLE_JOG_MPG
+
 // Execute dwell in seconds.
 void mc_dwell (float seconds)
 {
@@ -764,10 +1579,15 @@ status_code_t mc_homing_cycle (axes_signals_t cycle)
             limits_go_home(cycle);
         else {
 
-            uint_fast8_t idx = 0;
-
             sys.homed.mask &= ~sys.homing.mask;
 
+#ifdef HOMING_CONCURRENT_CYCLES
+            // Home the axes of all cycles in one go, each axis is located independently.
+            if((cycle.mask = sys.homing.mask))
+                limits_go_home(cycle);
+#else
+            uint_fast8_t idx = 0;
+
             do {
                 if(settings.homing.cycle[idx].mask) {
                     cycle.mask = settings.homing.cycle[idx].mask;
@@ -775,6 +1595,7 @@ status_code_t mc_homing_cycle (axes_signals_t cycle)
                         break;
                 }
             } while(++idx < N_AXIS);
+#endif
         }
 
         // If hard limits feature enabled, re-enable hard limits pin change register after homing cycle.
@@ -815,20 +1636,9 @@ status_code_t mc_homing_cycle (axes_signals_t cycle)
 }
 
 
-// Perform tool length probe cycle. Requires probe switch.
-// NOTE: Upon probe failure, the program will be stopped and placed into ALARM state.
-gc_probe_t mc_probe_cycle (float *target, plan_line_data_t *pl_data, gc_parser_flags_t parser_flags)
+// Executes a single probing move, the probe position is returned in sys_probe_position.
+static gc_probe_t probe_move (float *target, plan_line_data_t *pl_data, gc_parser_flags_t parser_flags)
 {
-    // TODO: Need to update this cycle so it obeys a non-auto cycle start.
-    if (sys.state == STATE_CHECK_MODE)
-        return GCProbe_CheckMode;
-
-    // Finish all queued commands and empty planner buffer before starting probe cycle.
-    protocol_buffer_synchronize();
-
-    if (sys.abort)
-        return GCProbe_Abort; // Return if system reset has been issued.
-
     // Initialize probing control variables
     sys.flags.probe_succeeded = Off; // Re-initialize probe history before beginning cycle.
     hal.probe_configure_invert_mask(parser_flags.probe_is_away);
@@ -861,7 +1671,7 @@ gc_probe_t mc_probe_cycle (float *target, plan_line_data_t *pl_data, gc_parser_f
     // Set state variables and error out, if the probe failed and cycle with error is enabled.
     if (sys_probing_state == Probing_Active) {
         if (parser_flags.probe_is_no_error)
-            memcpy(sys_probe_position, sys_position, sizeof(sys_position));
+            system_get_position(&sys_probe_position);
         else
             system_set_exec_alarm(Alarm_ProbeFailContact);
     } else
@@ -874,16 +1684,73 @@ gc_probe_t mc_probe_cycle (float *target, plan_line_data_t *pl_data, gc_parser_f
     // Reset the stepper and planner buffers to remove the remainder of the probe motion.
     st_reset();             // Reset step segment buffer.
     plan_reset();           // Reset planner buffer. Zero planner positions. Ensure probing motion is cleared.
+#ifdef ENABLE_WCO_MOTION_SYNC
+    system_wco_reset();     // Discard offsets queued with the probing motion.
+#endif
     plan_sync_position();   // Sync planner position to current machine position.
 
-    // All done! Output the probe position as message if configured.
-    if(settings.status_report.probe_coordinates)
-        report_probe_parameters();
-
     // Successful probe cycle or Failed to trigger probe within travel. With or without error.
     return sys.flags.probe_succeeded ? GCProbe_Found : GCProbe_FailEnd;
 }
 
+// Perform tool length probe cycle. Requires probe switch. The probe position is returned in sys_probe_position.
+// If slow is not NULL the cycle is a two-phase one: after the first trigger the probe is retracted along the
+// probing direction and a second approach at the slow feed rate is made through the first trigger point.
+// NOTE: Upon probe failure, the program will be stopped and placed into ALARM state.
+gc_probe_t mc_probe_cycle (float *target, plan_line_data_t *pl_data, gc_parser_flags_t parser_flags, gc_probe_slow_t *slow)
+{
+    gc_probe_t result;
+
+    // TODO: Need to update this cycle so it obeys a non-auto cycle start.
+    if (sys.state == STATE_CHECK_MODE)
+        return GCProbe_CheckMode;
+
+    // Finish all queued commands and empty planner buffer before starting probe cycle.
+    protocol_buffer_synchronize();
+
+    if (sys.abort)
+        return GCProbe_Abort; // Return if system reset has been issued.
+
+    if((result = probe_move(target, pl_data, parser_flags)) == GCProbe_Found && slow) {
+
+        uint_fast8_t idx = N_AXIS;
+        float position[N_AXIS], unit_vec[N_AXIS];
+
+        system_convert_array_steps_to_mpos(position, sys_probe_position);
+
+        // Probing direction, from the start of the cycle to the target.
+        do {
+            idx--;
+            unit_vec[idx] = target[idx] - gc_state.position[idx];
+        } while(idx);
+
+        convert_delta_vector_to_unit_vector(unit_vec);
+
+        // Retract from the trigger point at the probing feed rate.
+        idx = N_AXIS;
+        do {
+            idx--;
+            target[idx] = position[idx] - unit_vec[idx] * slow->retract;
+        } while(idx);
+
+        if(!(mc_line(target, pl_data) && protocol_buffer_synchronize()))
+            return GCProbe_Abort;
+
+        // Probe again at the slow feed rate, allowing for the retract distance past the first trigger point.
+        idx = N_AXIS;
+        do {
+            idx--;
+            target[idx] = position[idx] + unit_vec[idx] * slow->retract;
+        } while(idx);
+
+        pl_data->feed_rate = slow->feed_rate;
+
+        result = probe_move(target, pl_data, parser_flags);
+    }
+
+    return result;
+}
+
 
 // Plans and executes the single special motion case for parking. Independent of main planner buffer.
 // NOTE: Uses the always free planner ring buffer head to store motion parameters for execution.
@@ -37,6 +37,16 @@
 // (1 minute)/feed_rate time.
 bool mc_line(float *target, plan_line_data_t *pl_data);
 
+#if defined(ENABLE_PATH_BLENDING) || defined(ENABLE_SEGMENT_COALESCING)
+#define MC_LINE_HOLD // mc_line() may hold back the last line motion.
+#endif
+
+#ifdef MC_LINE_HOLD
+// Queue or discard the line motion held back for G64 path blending or segment coalescing.
+bool mc_line_flush (void);
+void mc_line_discard (void);
+#endif
+
 // Execute an arc in offset mode format. position == current xyz, target == target xyz,
 // offset == offset from current xyz, axis_XXX defines circle plane in tool space, axis_linear is
 // the direction of helical travel, radius == circle radius, is_clockwise_arc boolean. Used
@@ -44,8 +54,22 @@ bool mc_line(float *target, plan_line_data_t *pl_data);
 void mc_arc(float *target, plan_line_data_t *pl_data, float *position, float *offset, float radius,
   plane_t plane, bool is_clockwise_arc);
 
-// Execute canned cycle (drill)
+// Number of canned cycles that can wait for a pending cycle, e.g. the holes of a pattern programmed one per line.
+#ifndef CANNED_CYCLE_QUEUE_SIZE
+  #ifdef SMALL_RAM_TARGET
+    #define CANNED_CYCLE_QUEUE_SIZE 1
+  #else
+    #define CANNED_CYCLE_QUEUE_SIZE 4
+  #endif
+#endif
+
+// Set up canned cycle (drill), moves are queued by mc_canned_step() from the protocol loop or
+// by mc_canned_flush() before other motion is planned, on buffer synchronization and before system commands.
 void mc_canned_drill (motion_mode_t motion, float *target, plan_line_data_t *pl_data, float *position, plane_t plane, uint32_t repeats, gc_canned_t *canned);
+void mc_canned_step (void);
+bool mc_canned_flush (void);
+bool mc_canned_pending (void);
+void mc_canned_discard (void);
 
 // Execute canned cycle (threading)
 void mc_thread (plan_line_data_t *pl_data, float *position, gc_thread_data *thread, bool feed_hold_disabled);
@@ -53,6 +77,36 @@ void mc_thread (plan_line_data_t *pl_data, float *position, gc_thread_data *thre
 // Sets up valid jog motion received from g-code parser, checks for soft-limits, and executes the jog.
 status_code_t mc_jog_execute(plan_line_data_t *pl_data, parser_block_t *gc_block);
 
+#ifdef ENABLE_JOG_CONTINUOUS
+#ifndef JOG_CONTINUOUS_SEGMENTS
+#define JOG_CONTINUOUS_SEGMENTS 3
+#endif
+#ifndef JOG_CONTINUOUS_TIMEOUT
+#define JOG_CONTINUOUS_TIMEOUT 200 // ms
+#endif
+// Starts continuous jogging in the direction given by the per axis components at the given rate, or changes
+// direction and rate if active. Must be refreshed by mc_jog_continuous_refresh() until stopped.
+status_code_t mc_jog_continuous_start (float *direction, float feed_rate);
+bool mc_jog_continuous_refresh (void);
+void mc_jog_continuous_stop (void);
+void mc_jog_continuous_step (void);
+#endif
+
+#ifdef ENABLE_JOG_MPG
+#ifndef JOG_MPG_DISTANCE
+#define JOG_MPG_DISTANCE 0.01f // mm
+#endif
+#ifndef JOG_MPG_RATE_PCT
+#define JOG_MPG_RATE_PCT 50
+#endif
+#ifndef JOG_MPG_SEGMENTS
+#define JOG_MPG_SEGMENTS 3
+#endif
+// Adds handwheel counts for an axis, may be called from an interrupt handler.
+void mc_jog_mpg_move (uint_fast8_t axis, int32_t counts);
+void mc_jog_mpg_step (void);
+#endif
+
 // Dwell for a specific number of seconds
 void mc_dwell(float seconds);
 
@@ -60,7 +114,7 @@ void mc_dwell(float seconds);
 status_code_t mc_homing_cycle(axes_signals_t cycle);
 
 // Perform tool length probe cycle. Requires probe switch.
-gc_probe_t mc_probe_cycle(float *target, plan_line_data_t *pl_data, gc_parser_flags_t parser_flags);
+gc_probe_t mc_probe_cycle(float *target, plan_line_data_t *pl_data, gc_parser_flags_t parser_flags, gc_probe_slow_t *slow);
 
 // Handles updating the override control state.
 void mc_override_ctrl_update(gc_override_flags_t override_state);
@@ -73,9 +127,4 @@ void mc_cubic_b_spline(float *target, plan_line_data_t *pl_data, float *position
 // Performs system reset. If in motion state, kills all motion and sets system alarm.
 void mc_reset();
 
-#ifdef ENABLE_BACKLASH_COMPENSATION
-void mc_backlash_init (void);
-void mc_sync_backlash_position (void);
-#endif
-
 #endif
@@ -0,0 +1,570 @@
+/*
+  ngc_expr.c - numbered parameters and expression evaluation for the g-code parser
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "grbl.h"
+
+#ifdef ENABLE_NGC_EXPRESSIONS
+
+/*
+  LinuxCNC style parameters and expressions, word values may be a number, a parameter reference
+  #<n> or #[expr] or an expression in brackets. Blocks may contain assignments #<n>=<value>, these
+  take effect when all words of the block are read.
+
+  Operators by increasing precedence: AND OR XOR, EQ NE GT GE LT LE, + -, * / MOD, **.
+  Unary functions: ABS ACOS ASIN COS EXP FIX FUP LN ROUND SIN SQRT TAN and ATAN[y]/[x], angles
+  are in degrees.
+
+  Parameters #1 - #NGC_USER_PARAMETERS can be read and assigned to, they are kept in RAM and are
+  cleared on power up only. Read only parameters, positions in the current units:
+
+    #5061 - #5069   probe position of the last G38 cycle in work coordinates
+    #5070           1 if the last G38 cycle succeeded, else 0
+    #5161 - #5169   G28 position
+    #5181 - #5189   G30 position
+    #5211 - #5219   G92 offset
+    #5220           coordinate system number, 1 - 9 for G54 - G59.3
+    #5221 - #5389   coordinate system offsets, G54 at #5221, G55 at #5241 and so on
+    #5399           result of the last M66, the input value or -1 on timeout (ENABLE_WAIT_ON_INPUT_ASYNC)
+
+  Evaluation is recursive with the depth bounded by NGC_EXPR_MAX_DEPTH, no heap is used.
+*/
+
+typedef enum {
+    Op_Power = 0,
+    Op_Multiply,
+    Op_Divide,
+    Op_Modulo,
+    Op_Add,
+    Op_Subtract,
+    Op_EQ,
+    Op_NE,
+    Op_GT,
+    Op_GE,
+    Op_LT,
+    Op_LE,
+    Op_And,
+    Op_Or,
+    Op_Xor,
+    Op_None
+} ngc_op_t;
+
+typedef enum {
+    Func_Abs = 0,
+    Func_Acos,
+    Func_Asin,
+    Func_Atan,
+    Func_Cos,
+    Func_Exp,
+    Func_Fix,
+    Func_Fup,
+    Func_Ln,
+    Func_Round,
+    Func_Sin,
+    Func_Sqrt,
+    Func_Tan
+} ngc_func_t;
+
+typedef struct {
+    const char *name;
+    uint8_t level;
+    ngc_op_t op;
+} operator_t;
+
+typedef struct {
+    const char *name;
+    ngc_func_t func;
+} function_t;
+
+typedef struct {
+    uint_fast16_t n;
+    float value;
+} assignment_t;
+
+#define PRECEDENCE_LEVELS 5
+
+// In the order to match them, ** before *.
+static const operator_t operators[] = {
+    { "**",  4, Op_Power },
+    { "*",   3, Op_Multiply },
+    { "/",   3, Op_Divide },
+    { "MOD", 3, Op_Modulo },
+    { "+",   2, Op_Add },
+    { "-",   2, Op_Subtract },
+    { "EQ",  1, Op_EQ },
+    { "NE",  1, Op_NE },
+    { "GT",  1, Op_GT },
+    { "GE",  1, Op_GE },
+    { "LT",  1, Op_LT },
+    { "LE",  1, Op_LE },
+    { "AND", 0, Op_And },
+    { "OR",  0, Op_Or },
+    { "XOR", 0, Op_Xor }
+};
+
+static const function_t functions[] = {
+    { "ABS",   Func_Abs },
+    { "ACOS",  Func_Acos },
+    { "ASIN",  Func_Asin },
+    { "ATAN",  Func_Atan },
+    { "COS",   Func_Cos },
+    { "EXP",   Func_Exp },
+    { "FIX",   Func_Fix },
+    { "FUP",   Func_Fup },
+    { "LN",    Func_Ln },
+    { "ROUND", Func_Round },
+    { "SIN",   Func_Sin },
+    { "SQRT",  Func_Sqrt },
+    { "TAN",   Func_Tan }
+};
+
+static float params[NGC_USER_PARAMETERS];
+static uint32_t params_set[(NGC_USER_PARAMETERS + 31) / 32];
+static assignment_t assignments[NGC_MAX_ASSIGNMENTS];
+static uint_fast8_t n_assignments = 0, depth = 0;
+
+static status_code_t read_operand (char *line, uint_fast8_t *pos, float *value);
+static status_code_t read_binary (char *line, uint_fast8_t *pos, float *value, uint_fast8_t level);
+
+static inline float to_units (float value)
+{
+    return gc_state.modal.units_imperial ? value * INCH_PER_MM : value;
+}
+
+bool ngc_param_get (uint_fast16_t n, float *value)
+{
+    uint_fast8_t axis = (n % 10) - 1;
+    float coord_data[N_AXIS];
+
+    *value = 0.0f;
+
+    if(n >= 1 && n <= NGC_USER_PARAMETERS) {
+        *value = params[n - 1];
+        return true;
+    }
+
+    if(n == 5070) {
+        *value = sys.flags.probe_succeeded ? 1.0f : 0.0f;
+        return true;
+    }
+
+    if(n == 5220) {
+        *value = (float)(gc_state.modal.coord_system.idx + 1);
+        return true;
+    }
+
+#ifdef ENABLE_WAIT_ON_INPUT_ASYNC
+    if(n == 5399) { // Waits for a pending M66 to complete.
+        *value = (float)wait_input_result();
+        return true;
+    }
+#endif
+
+    if(n % 10 == 0 || !((n >= 5061 && n <= 5069) || (n >= 5161 && n <= 5169) || (n >= 5181 && n <= 5189) ||
+                          (n >= 5211 && n <= 5219) || (n >= 5221 && n <= 5389 && (n - 5221) % 20 < 9)))
+        return false;
+
+    if(axis >= N_AXIS) // Axis not configured, reads as 0.
+        return true;
+
+    if(n <= 5069) {
+        float position[N_AXIS];
+        system_convert_array_steps_to_mpos(position, sys_probe_position);
+        *value = position[axis] - gc_state.modal.coord_system.xyz[axis] - gc_state.g92_coord_offset[axis] - gc_state.tool_length_offset[axis];
+    } else if(n >= 5211 && n <= 5219)
+        *value = gc_state.g92_coord_offset[axis];
+    else {
+        uint_fast8_t idx = n <= 5169 ? SETTING_INDEX_G28 : (n <= 5189 ? SETTING_INDEX_G30 : (n - 5221) / 20);
+        if((n >= 5221 && idx >= N_COORDINATE_SYSTEM) || !settings_read_coord_data(idx, &coord_data))
+            return false;
+        *value = coord_data[axis];
+    }
+
+    *value = to_units(*value);
+
+    return true;
+}
+
+static void param_set (uint_fast16_t n, float value)
+{
+    params[n - 1] = value;
+    params_set[(n - 1) >> 5] |= bit(((n - 1) & 0x1F));
+}
+
+// Reads a parameter number, an operand rounded to an integer.
+static status_code_t read_param_number (char *line, uint_fast8_t *pos, uint_fast16_t *n)
+{
+    float value;
+    status_code_t status;
+
+    if((status = read_operand(line, pos, &value)) != Status_OK)
+        return status;
+
+    if(value < 0.0f || fabsf(value - roundf(value)) > 0.0001f || value > 65535.0f)
+        return Status_ExpressionInvalidArgument;
+
+    *n = (uint_fast16_t)roundf(value);
+
+    return Status_OK;
+}
+
+// Reads an expression in brackets, pos points to the opening bracket.
+static status_code_t read_bracketed (char *line, uint_fast8_t *pos, float *value)
+{
+    status_code_t status;
+
+    if(line[*pos] != '[')
+        return Status_ExpressionSyntaxError;
+
+    (*pos)++;
+
+    if((status = read_binary(line, pos, value, 0)) == Status_OK) {
+        if(line[*pos] == ']')
+            (*pos)++;
+        else
+            status = Status_ExpressionSyntaxError;
+    }
+
+    return status;
+}
+
+static const function_t *match_function (char *line, uint_fast8_t pos)
+{
+    uint_fast8_t idx = 0, len;
+
+    do {
+        len = strlen(functions[idx].name);
+        if(!strncmp(&line[pos], functions[idx].name, len) && line[pos + len] == '[')
+            return &functions[idx];
+    } while(++idx < sizeof(functions) / sizeof(function_t));
+
+    return NULL;
+}
+
+static status_code_t read_function (char *line, uint_fast8_t *pos, const function_t *function, float *value)
+{
+    float arg, x;
+    status_code_t status;
+
+    *pos += strlen(function->name);
+
+    if((status = read_bracketed(line, pos, &arg)) != Status_OK)
+        return status;
+
+    switch(function->func) {
+
+        case Func_Abs:
+            *value = fabsf(arg);
+            break;
+
+        case Func_Acos:
+        case Func_Asin:
+            if(arg < -1.0f || arg > 1.0f)
+                return Status_ExpressionInvalidArgument;
+            *value = (function->func == Func_Acos ? acosf(arg) : asinf(arg)) / RADDEG;
+            break;
+
+        case Func_Atan:
+            if(line[(*pos)++] != '/')
+                return Status_ExpressionSyntaxError;
+            if((status = read_bracketed(line, pos, &x)) != Status_OK)
+                return status;
+            *value = atan2f(arg, x) / RADDEG;
+            break;
+
+        case Func_Cos:
+            *value = cosf(arg * RADDEG);
+            break;
+
+        case Func_Exp:
+            *value = expf(arg);
+            break;
+
+        case Func_Fix:
+            *value = floorf(arg);
+            break;
+
+        case Func_Fup:
+            *value = ceilf(arg);
+            break;
+
+        case Func_Ln:
+            if(arg <= 0.0f)
+                return Status_ExpressionInvalidArgument;
+            *value = logf(arg);
+            break;
+
+        case Func_Round:
+            *value = roundf(arg);
+            break;
+
+        case Func_Sin:
+            *value = sinf(arg * RADDEG);
+            break;
+
+        case Func_Sqrt:
+            if(arg < 0.0f)
+                return Status_ExpressionInvalidArgument;
+            *value = sqrtf(arg);
+            break;
+
+        case Func_Tan:
+            *value = tanf(arg * RADDEG);
+            break;
+    }
+
+    return Status_OK;
+}
+
+// Reads a number, a parameter reference, an expression in brackets, a function or a unary minus or plus followed by an operand.
+static status_code_t read_operand (char *line, uint_fast8_t *pos, float *value)
+{
+    uint_fast16_t n;
+    char c = line[*pos];
+    const function_t *function;
+    status_code_t status = Status_OK;
+
+    if(++depth > NGC_EXPR_MAX_DEPTH)
+        status = Status_ExpressionSyntaxError;
+
+    else if(c == '[')
+        status = read_bracketed(line, pos, value);
+
+    else if(c == '#') {
+        (*pos)++;
+        if((status = read_param_number(line, pos, &n)) == Status_OK && !ngc_param_get(n, value))
+            status = Status_ExpressionInvalidArgument;
+    }
+
+    else if(c == '-' || c == '+') {
+        (*pos)++;
+        if((status = read_operand(line, pos, value)) == Status_OK && c == '-')
+            *value = -*value;
+    }
+
+    else if((function = match_function(line, *pos)))
+        status = read_function(line, pos, function, value);
+
+    else if(!read_float(line, pos, value))
+        status = Status_ExpressionSyntaxError;
+
+    depth--;
+
+    return status;
+}
+
+static ngc_op_t match_operator (char *line, uint_fast8_t *pos, uint_fast8_t level)
+{
+    uint_fast8_t idx = 0, len;
+
+    do {
+        len = strlen(operators[idx].name);
+        if(!strncmp(&line[*pos], operators[idx].name, len)) {
+            if(operators[idx].level != level)
+                break;
+            *pos += len;
+            return operators[idx].op;
+        }
+    } while(++idx < sizeof(operators) / sizeof(operator_t));
+
+    return Op_None;
+}
+
+static status_code_t apply_operator (ngc_op_t op, float *lhs, float rhs)
+{
+    switch(op) {
+
+        case Op_Power:
+            if(*lhs < 0.0f && rhs != truncf(rhs))
+                return Status_ExpressionInvalidArgument;
+            *lhs = powf(*lhs, rhs);
+            break;
+
+        case Op_Multiply:
+            *lhs *= rhs;
+            break;
+
+        case Op_Divide:
+            if(rhs == 0.0f)
+                return Status_ExpressionDivideByZero;
+            *lhs /= rhs;
+            break;
+
+        case Op_Modulo:
+            if(rhs == 0.0f)
+                return Status_ExpressionDivideByZero;
+            *lhs = fmodf(*lhs, rhs);
+            if(*lhs < 0.0f) // Result has the sign of the divisor, as in LinuxCNC.
+                *lhs += fabsf(rhs);
+            break;
+
+        case Op_Add:
+            *lhs += rhs;
+            break;
+
+        case Op_Subtract:
+            *lhs -= rhs;
+            break;
+
+        case Op_EQ:
+            *lhs = *lhs == rhs ? 1.0f : 0.0f;
+            break;
+
+        case Op_NE:
+            *lhs = *lhs != rhs ? 1.0f : 0.0f;
+            break;
+
+        case Op_GT:
+            *lhs = *lhs > rhs ? 1.0f : 0.0f;
+            break;
+
+        case Op_GE:
+            *lhs = *lhs >= rhs ? 1.0f : 0.0f;
+            break;
+
+        case Op_LT:
+            *lhs = *lhs < rhs ? 1.0f : 0.0f;
+            break;
+
+        case Op_LE:
+            *lhs = *lhs <= rhs ? 1.0f : 0.0f;
+            break;
+
+        case Op_And:
+            *lhs = *lhs != 0.0f && rhs != 0.0f ? 1.0f : 0.0f;
+            break;
+
+        case Op_Or:
+            *lhs = *lhs != 0.0f || rhs != 0.0f ? 1.0f : 0.0f;
+            break;
+
+        case Op_Xor:
+            *lhs = (*lhs != 0.0f) != (rhs != 0.0f) ? 1.0f : 0.0f;
+            break;
+
+        default:
+            break;
+    }
+
+    return Status_OK;
+}
+
+// Reads operands and operators of the given precedence level and higher, evaluated left to right.
+static status_code_t read_binary (char *line, uint_fast8_t *pos, float *value, uint_fast8_t level)
+{
+    float rhs;
+    ngc_op_t op;
+    status_code_t status;
+
+    if(level == PRECEDENCE_LEVELS)
+        return read_operand(line, pos, value);
+
+    status = read_binary(line, pos, value, level + 1);
+
+    while(status == Status_OK && (op = match_operator(line, pos, level)) != Op_None) {
+        if((status = read_binary(line, pos, &rhs, level + 1)) == Status_OK)
+            status = apply_operator(op, value, rhs);
+    }
+
+    return status;
+}
+
+status_code_t ngc_read_real_value (char *line, uint_fast8_t *char_counter, float *value)
+{
+    uint_fast8_t pos = *char_counter;
+    status_code_t status;
+
+    if(line[pos] == '-' || line[pos] == '+')
+        pos++;
+
+    // Plain numbers are read as before, keeping the error code for malformed numbers.
+    if(!(line[pos] == '[' || line[pos] == '#' || match_function(line, pos)))
+        return read_float(line, char_counter, value) ? Status_OK : Status_BadNumberFormat;
+
+    depth = 0;
+
+    if((status = read_operand(line, char_counter, value)) == Status_OK && isnan(*value))
+        status = Status_ExpressionInvalidArgument;
+
+    return status;
+}
+
+status_code_t ngc_read_assignment (char *line, uint_fast8_t *char_counter)
+{
+    uint_fast16_t n;
+    float value;
+    status_code_t status;
+
+    depth = 0;
+
+    if((status = read_param_number(line, char_counter, &n)) != Status_OK)
+        return status;
+
+    if(n < 1 || n > NGC_USER_PARAMETERS)
+        return Status_ExpressionInvalidArgument;
+
+    if(line[(*char_counter)++] != '=')
+        return Status_ExpressionSyntaxError;
+
+    if((status = ngc_read_real_value(line, char_counter, &value)) != Status_OK)
+        return status;
+
+    if(n_assignments == NGC_MAX_ASSIGNMENTS)
+        return Status_Overflow;
+
+    assignments[n_assignments].n = n;
+    assignments[n_assignments++].value = value;
+
+    return Status_OK;
+}
+
+void ngc_assign_reset (void)
+{
+    n_assignments = 0;
+}
+
+void ngc_assign_commit (void)
+{
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < n_assignments; idx++)
+        param_set(assignments[idx].n, assignments[idx].value);
+
+    n_assignments = 0;
+}
+
+void ngc_report_parameters (void)
+{
+    uint_fast16_t n;
+
+    for(n = 1; n <= NGC_USER_PARAMETERS; n++) {
+        if(params_set[(n - 1) >> 5] & bit(((n - 1) & 0x1F))) {
+            hal.stream.write("[#");
+            hal.stream.write(uitoa((uint32_t)n));
+            hal.stream.write(":");
+            hal.stream.write(ftoa(params[n - 1], N_DECIMAL_COORDVALUE_INCH));
+            hal.stream.write("]" ASCII_EOL);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+  ngc_expr.h - numbered parameters and expression evaluation for the g-code parser
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _NGC_EXPR_H_
+#define _NGC_EXPR_H_
+
+#ifdef ENABLE_NGC_EXPRESSIONS
+
+// Number of read/write parameters, #1 to #NGC_USER_PARAMETERS. Each takes 4 bytes of RAM.
+#ifndef NGC_USER_PARAMETERS
+  #define NGC_USER_PARAMETERS 100
+#endif
+
+// Maximum number of parameter assignments in a block.
+#ifndef NGC_MAX_ASSIGNMENTS
+  #define NGC_MAX_ASSIGNMENTS 8
+#endif
+
+// Maximum nesting of brackets and parameter references in an expression.
+#ifndef NGC_EXPR_MAX_DEPTH
+  #define NGC_EXPR_MAX_DEPTH 8
+#endif
+
+// Reads a real value, a number, a parameter reference #<n> or #[expr] or an expression [expr].
+// Line points to the input buffer and char_counter to the first character of the value, it is advanced past it.
+status_code_t ngc_read_real_value (char *line, uint_fast8_t *char_counter, float *value);
+
+// Reads a parameter assignment <n>=<value>, char_counter points past the #. The assignment is queued until
+// ngc_assign_commit() is called so that references in the same block read the values prior to it.
+status_code_t ngc_read_assignment (char *line, uint_fast8_t *char_counter);
+
+// Discards queued assignments, called before a block is parsed.
+void ngc_assign_reset (void);
+
+// Applies queued assignments, called when all words of a block are read.
+void ngc_assign_commit (void);
+
+// Gets the value of parameter n, returns false if the parameter is not supported.
+bool ngc_param_get (uint_fast16_t n, float *value);
+
+// Outputs the parameters that have been assigned to as [#<n>:<value>].
+void ngc_report_parameters (void);
+
+#endif
+
+#endif
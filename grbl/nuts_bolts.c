@@ -22,24 +22,12 @@
 
 #include "grbl.h"
 
-#define MAX_PRECISION 10
+#define MAX_PRECISION 9
 
-static char buf[STRLEN_COORDVALUE + 1];
+static char buf[STRLEN_NUMBER_MAX];
 
-static const float froundvalues[MAX_PRECISION + 1] =
-{
-    0.5,                // 0
-    0.05,               // 1
-    0.005,              // 2
-    0.0005,             // 3
-    0.00005,            // 4
-    0.000005,           // 5
-    0.0000005,          // 6
-    0.00000005,         // 7
-    0.000000005,        // 8
-    0.0000000005,       // 9
-    0.00000000005       // 10
-};
+// Powers of ten for scaling the decimals in ftoa_r().
+static const uint32_t upow10[MAX_PRECISION + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
 
 char const *const axis_letter[N_AXIS] = {
     "X",
@@ -56,94 +44,173 @@ char const *const axis_letter[N_AXIS] = {
 #endif
 };
 
-// Converts an uint32 variable to string.
-char *uitoa (uint32_t n)
+// Divides by 10, returns the quotient and the remainder in *rem.
+inline static uint32_t udiv10 (uint32_t n, uint32_t *rem)
 {
-    char *bptr = buf + sizeof(buf);
+#ifdef NO_HW_DIVIDE
+    // Quotient estimate by n * 0.8 / 8 with shifts and adds, it is at most 1 too small. Exact for all 32 bit values.
+    uint32_t q = (n >> 1) + (n >> 2);
+    q += q >> 4;
+    q += q >> 8;
+    q += q >> 16;
+    q >>= 3;
+    *rem = n - ((q << 3) + (q << 1));
+    if(*rem > 9) {
+        q++;
+        *rem -= 10;
+    }
+    return q;
+#else
+    *rem = n % 10;
+    return n / 10;
+#endif
+}
 
-    *--bptr = '\0';
+#ifndef NO_HW_DIVIDE
+
+// Two digit pairs "00" to "99" for converting two digits per division.
+static const char digit_pairs[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'
+};
 
-    if (n == 0)
-        *--bptr = '0';
-    else while (n) {
-        *--bptr = '0' + (n % 10);
-        n /= 10;
+#endif
+
+// Writes the digits of n backwards ending at end, at least min_digits with leading zeros.
+// Returns a pointer to the first digit.
+static char *put_digits (char *end, uint32_t n, uint_fast8_t min_digits)
+{
+    char *start = end - min_digits;
+
+#ifdef NO_HW_DIVIDE
+    uint32_t digit;
+
+    do {
+        n = udiv10(n, &digit);
+        *--end = '0' + digit;
+    } while(n);
+#else
+    uint32_t pair;
+
+    while(n >= 100) {
+        pair = n % 100;
+        n /= 100;
+        *--end = digit_pairs[pair * 2 + 1];
+        *--end = digit_pairs[pair * 2];
     }
 
-    return bptr;
+    if(n >= 10) {
+        *--end = digit_pairs[n * 2 + 1];
+        *--end = digit_pairs[n * 2];
+    } else
+        *--end = '0' + n;
+#endif
+
+    while(end > start)
+        *--end = '0';
+
+    return end;
 }
 
-// Convert float to string by immediately converting to integers.
-// Number of decimal places, which are tracked by a counter, must be set by the user.
-// The integers is then efficiently converted to a string.
-char *ftoa (float n, uint8_t decimal_places)
+char *uitoa_r (char *s, uint32_t n)
 {
-    bool isNegative;
-    char *bptr = buf + sizeof(buf);
+    char digits[10], *start = put_digits(digits + sizeof(digits), n, 1);
 
-    *--bptr = '\0';
+    while(start < digits + sizeof(digits))
+        *s++ = *start++;
 
-    if ((isNegative = n < 0.0f))
-        n = -n;
+    *s = '\0';
 
-    n += froundvalues[decimal_places];
+    return s;
+}
 
-    uint32_t a = (uint32_t)n;
+// The fractional part is scaled by 10^decimal_places and rounded to an integer, any carry is added to
+// the integer part. Both are then converted two digits at a time.
+char *ftoa_r (char *s, float n, uint8_t decimal_places)
+{
+    uint32_t a, b;
+    char digits[STRLEN_NUMBER_MAX], *end = digits + sizeof(digits), *start;
 
-    if (decimal_places) {
+    if(decimal_places > MAX_PRECISION)
+        decimal_places = MAX_PRECISION;
 
-        n -= (float)a;
+    if (n < 0.0f) {
+        *s++ = '-';
+        n = -n;
+    }
 
-        uint_fast8_t decimals = decimal_places;
-        while (decimals >= 2) { // Quickly convert values expected to be E0 to E-4.
-            n *= 100.0f;
-            decimals -= 2;
-        }
+    a = (uint32_t)n;
+    b = (uint32_t)((n - (float)a) * (float)upow10[decimal_places] + 0.5f);
 
-        if (decimals)
-            n *= 10.0f;
+    if(b >= upow10[decimal_places]) { // Rounded up to the next integer.
+        b -= upow10[decimal_places];
+        a++;
+    }
 
-        uint32_t b = (uint32_t)n;
+    start = decimal_places ? put_digits(end, b, decimal_places) : end;
+    start = put_digits(start, a, 1);
 
-        while(decimal_places--) {
-            if(b) {
-                *--bptr = (b % 10) + '0'; // Get digit
-                b /= 10;
-            } else
-                *--bptr = '0';
-        }
-    }
+    // Copy the integer digits, add the decimal point and copy the decimals.
+    end -= decimal_places;
+    while(start < end)
+        *s++ = *start++;
 
-    *--bptr = '.'; // Always add decimal point (TODO: is this really needed?)
+    *s++ = '.'; // Always add decimal point (TODO: is this really needed?)
 
-    if(a == 0)
-        *--bptr = '0';
+    end += decimal_places;
+    while(start < end)
+        *s++ = *start++;
 
-    else while(a) {
-        *--bptr = (a % 10) + '0'; // Get digit
-        a /= 10;
-    }
+    *s = '\0';
+
+    return s;
+}
 
-    if(isNegative)
-        *--bptr = '-';
+// Converts an uint32 variable to string.
+char *uitoa (uint32_t n)
+{
+    uitoa_r(buf, n);
+
+    return buf;
+}
+
+// Converts a float variable to string with the specified number of decimal places.
+// The result shares the static buffer with uitoa().
+char *ftoa (float n, uint8_t decimal_places)
+{
+    ftoa_r(buf, n, decimal_places);
 
-    return bptr;
+    return buf;
 }
 
+// Powers of ten used for scaling in read_float(), these are all exactly representable as floats.
+const float pow10_table[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
 // Extracts a floating point value from a string. The following code is based loosely on
 // the avr-libc strtod() function by Michael Stumpf and Dmitry Xmelkov and many freely
 // available conversion method examples, but has been highly optimized for Grbl. For known
 // CNC applications, the typical decimal value is expected to be in the range of E0 to E-4.
 // Scientific notation is officially not supported by g-code, and the 'E' character may
 // be a g-code word on some CNC systems. So, 'E' notation will not be recognized.
+// Up to READ_FLOAT_MAX_DIGITS significant digits are accumulated in an integer which is then
+// divided by an exact power of ten, this results in a correctly rounded value for all inputs
+// with up to 7 significant digits. Leading zeros are not counted as significant.
 // NOTE: Thanks to Radu-Eosif Mihailescu for identifying the issues with using strtod().
 bool read_float (char *line, uint_fast8_t *char_counter, float *float_ptr)
 {
     char *ptr = line + *char_counter;
-    int_fast8_t exp = 0;
+    int_fast16_t exp = 0;
     uint_fast8_t ndigit = 0, c;
     uint32_t intval = 0;
-    bool isnegative, isdecimal = false;
+    bool isnegative;
 
     // Grab first character and increment pointer. No spaces assumed in line.
     c = *ptr++;
@@ -152,44 +219,55 @@ bool read_float (char *line, uint_fast8_t *char_counter, float *float_ptr)
     if ((isnegative = (c == '-')) || c == '+')
         c = *ptr++;
 
-    // Extract number into fast integer. Track decimal in terms of exponent value.
-    while(c) {
-        c -= '0';
-        if (c <= 9) {
-            ndigit++;
-            if (ndigit <= MAX_INT_DIGITS) {
-                if (isdecimal)
-                    exp--;
-                intval = (((intval << 2) + intval) << 1) + c; // intval*10 + c
-            } else if (!isdecimal)
-                exp++;  // Drop overflow digits
-        } else if (c == (uint_fast8_t)('.' - '0') && !isdecimal)
-            isdecimal = true;
-         else
-            break;
+    // Extract number into fast integer, integer and fractional part separately. Track decimal in terms of exponent value.
+    char *digits = ptr;
 
+    while((c -= '0') <= 9) {
+        if (ndigit < READ_FLOAT_MAX_DIGITS) {
+            intval = (((intval << 2) + intval) << 1) + c; // intval*10 + c
+            if (intval)
+                ndigit++;
+        } else
+            exp++;  // Drop overflow digits
         c = *ptr++;
     }
 
+    if (c == (uint_fast8_t)('.' - '0')) {
+        digits++;
+        c = *ptr++;
+        while((c -= '0') <= 9) {
+            if (ndigit < READ_FLOAT_MAX_DIGITS) {
+                exp--;
+                intval = (((intval << 2) + intval) << 1) + c; // intval*10 + c
+                if (intval)
+                    ndigit++;
+            }
+            c = *ptr++;
+        }
+    }
+
     // Return if no digits have been read.
-    if (!ndigit)
+    if (ptr == digits)
         return false;
 
     // Convert integer into floating point.
     float fval = (float)intval;
 
-    // Apply decimal. Should perform no more than two floating point multiplications for the
-    // expected range of E0 to E-4.
+    // Apply decimal. A single division by an exact power of ten for the expected range of E0 to E-10.
     if (fval != 0.0f) {
-        while (exp <= -2) {
-            fval *= 0.01f;
-            exp += 2;
+        if (exp < 0) {
+            while (exp < -10) {
+                fval /= 1e10f;
+                exp += 10;
+            }
+            fval /= pow10_table[-exp];
+        } else if (exp > 0) {
+            while (exp > 10) {
+                fval *= 1e10f;
+                exp -= 10;
+            }
+            fval *= pow10_table[exp];
         }
-        if (exp < 0)
-            fval *= 0.1f;
-        else if (exp > 0) do {
-            fval *= 10.0f;
-        } while (--exp > 0);
     }
 
     // Assign floating point value with correct sign.
@@ -259,17 +337,60 @@ float limit_value_by_axis_maximum (float *max_value, float *unit_vec)
     return limit_value;
 }
 
-// calculate checksum byte for EEPROM data
-uint8_t calc_checksum (uint8_t *data, uint32_t size) {
+// calculate CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF) for EEPROM data, by the driver if it has a CRC unit
+uint16_t calc_checksum (uint8_t *data, uint32_t size)
+{
+    static const uint16_t crc_table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+    };
+
+    if(hal.eeprom.checksum)
+        return hal.eeprom.checksum(data, size);
 
-    uint8_t checksum = 0;
+    uint16_t crc = 0xFFFF;
 
+    // A nibble at a time, the table is small enough to not matter for flash constrained MCUs.
     while(size--) {
-        checksum = (checksum << 1) | (checksum >> 7);
-        checksum += *(data++);
+        crc = (uint16_t)(crc << 4) ^ crc_table[(crc >> 12) ^ (*data >> 4)];
+        crc = (uint16_t)(crc << 4) ^ crc_table[(crc >> 12) ^ (*data++ & 0x0F)];
+    }
+
+    return crc;
+}
+
+// calculate the checksum byte used for EEPROM data by settings version 16 and earlier, for migration
+uint8_t calc_checksum8 (uint8_t *data, uint32_t size) {
+
+    uint_fast8_t checksum = 0;
+
+    // Unrolled, the checksum is the same as when rotated and added a byte at a time.
+    for(; size >= 4; size -= 4) {
+        checksum = (uint8_t)(((checksum << 1) | (checksum >> 7)) + *data++);
+        checksum = (uint8_t)(((checksum << 1) | (checksum >> 7)) + *data++);
+        checksum = (uint8_t)(((checksum << 1) | (checksum >> 7)) + *data++);
+        checksum = (uint8_t)(((checksum << 1) | (checksum >> 7)) + *data++);
+    }
+
+    while(size--)
+        checksum = (uint8_t)(((checksum << 1) | (checksum >> 7)) + *data++);
+
+    return (uint8_t)checksum;
+}
+
+// calculate CRC-8 with polynomial 0x07 and initial value 0, used for binary frames
+uint8_t crc8 (const uint8_t *data, uint_fast16_t length)
+{
+    uint_fast8_t bit;
+    uint8_t crc = 0;
+
+    while(length--) {
+        crc ^= *data++;
+        for(bit = 0; bit < 8; bit++)
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
     }
 
-    return checksum;
+    return crc;
 }
 
 void dummy_handler (void)
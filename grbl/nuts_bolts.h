@@ -113,12 +113,21 @@ typedef struct {
     void (*callback)(void);
 } delay_t;
 
+// Periodic timer struct, may be used by drivers to implement hal.periodic_ms
+typedef struct {
+    volatile uint32_t ms;
+    uint32_t period;
+    void (*volatile callback)(void);
+} periodic_t;
+
 // Conversions
 #define MM_PER_INCH (25.40f)
 #define INCH_PER_MM (0.0393701f)
 
 #define MAX_INT_DIGITS 8 // Maximum number of digits in int32 (and float)
+#define READ_FLOAT_MAX_DIGITS 9 // Maximum number of significant digits accumulated by read_float(), must fit in uint32_t
 #define STRLEN_COORDVALUE (MAX_INT_DIGITS + N_DECIMAL_COORDVALUE_INCH + 1) // 8.4 format - excluding terminating null
+#define STRLEN_NUMBER_MAX 23 // Longest string written by ftoa_r(): sign, 10 integer digits, decimal point, 9 decimals and terminating null
 
 // Useful macros
 #define clear_vector(a) memset(a, 0, sizeof(a))
@@ -132,7 +141,7 @@ typedef struct {
 
 // Bit field and masking macros
 #ifndef bit
-#define bit(n) (1UL << n)
+#define bit(n) (1UL << (n))
 #endif
 #define bit_true(x,mask) (x) |= (mask)
 #define bit_false(x,mask) (x) &= ~(mask)
@@ -143,11 +152,21 @@ typedef struct {
 #define bit_isfalse(x, mask) ((x & (mask)) == 0)
 
 // Converts an uint32 variable to string.
+// NOTE: returns a pointer to a static buffer shared with ftoa().
 char *uitoa (uint32_t n);
 
 // Converts a float variable to string with the specified number of decimal places.
+// NOTE: returns a pointer to a static buffer shared with uitoa().
 char *ftoa (float n, uint8_t decimal_places);
 
+// Writes an uint32 variable as a null terminated string to s, returns a pointer to the terminating null.
+// Needs up to 11 characters.
+char *uitoa_r (char *s, uint32_t n);
+
+// Writes a float variable with the specified number of decimal places as a null terminated string to s,
+// returns a pointer to the terminating null. Needs up to STRLEN_NUMBER_MAX characters.
+char *ftoa_r (char *s, float n, uint8_t decimal_places);
+
 // Returns true if float value is a whole number (integer)
 bool isintf (float value);
 
@@ -156,14 +175,23 @@ bool isintf (float value);
 // a pointer to the result variable. Returns true when it succeeds
 bool read_float(char *line, uint_fast8_t *char_counter, float *float_ptr);
 
+// Exact powers of ten, 1e0 - 1e10.
+extern const float pow10_table[];
+
 // Non-blocking delay function used for general operation and suspend features.
 void delay_sec(float seconds, delaymode_t mode);
 
 float convert_delta_vector_to_unit_vector(float *vector);
 float limit_value_by_axis_maximum(float *max_value, float *unit_vec);
 
-// calculate checksum byte for EEPROM data
-uint8_t calc_checksum (uint8_t *data, uint32_t size);
+// calculate CRC-16/CCITT for EEPROM data
+uint16_t calc_checksum (uint8_t *data, uint32_t size);
+
+// calculate the checksum byte used for EEPROM data by settings version 16 and earlier
+uint8_t calc_checksum8 (uint8_t *data, uint32_t size);
+
+// calculate CRC-8 with polynomial 0x07 and initial value 0, used for binary frames
+uint8_t crc8 (const uint8_t *data, uint_fast16_t length);
 
 void dummy_handler (void);
 
@@ -29,7 +29,13 @@ typedef struct {
     uint8_t buf[OVERRIDE_BUFSIZE];
 } override_queue_t;
 
+typedef struct {
+    volatile bool pending;
+    volatile uint8_t value;
+} override_target_t;
+
 static override_queue_t feed = {0}, accessory = {0};
+static override_target_t feed_target = {0}, spindle_target = {0};
 
 ISR_CODE void enqueue_feed_override (uint8_t cmd)
 {
@@ -79,6 +85,56 @@ uint8_t get_accessory_override (void)
     return data;
 }
 
+// Absolute override targets, the last target set is applied once per main loop pass.
+// The target is read after clearing the pending flag, a target set in between is then applied again on the next pass.
+
+ISR_CODE void set_feed_override_target (uint8_t percent)
+{
+    feed_target.value = percent;
+    feed_target.pending = true;
+}
+
+// Returns the pending feed override target, the current override if none is pending.
+uint8_t feed_override_target (void)
+{
+    return feed_target.pending ? feed_target.value : sys.override.feed_rate;
+}
+
+// Returns 0 if no target set
+uint8_t get_feed_override_target (void)
+{
+    if(!feed_target.pending)
+        return 0;
+
+    feed_target.pending = false;
+
+    return max(feed_target.value, 1);
+}
+
+ISR_CODE void set_spindle_override_target (uint8_t percent)
+{
+    spindle_target.value = percent;
+    spindle_target.pending = true;
+}
+
+// Returns the pending spindle override target, the current override if none is pending.
+uint8_t spindle_override_target (void)
+{
+    return spindle_target.pending ? spindle_target.value : sys.override.spindle_rpm;
+}
+
+// Returns 0 if no target set
+uint8_t get_spindle_override_target (void)
+{
+    if(!spindle_target.pending)
+        return 0;
+
+    spindle_target.pending = false;
+
+    return max(spindle_target.value, 1);
+}
+
 void flush_override_buffers () {
     feed.head = feed.tail = accessory.head = accessory.tail = 0;
+    feed_target.pending = spindle_target.pending = false;
 }
@@ -31,5 +31,11 @@ void enqueue_feed_override (uint8_t cmd);
 uint8_t get_feed_override (void);
 void enqueue_accessory_override (uint8_t cmd);
 uint8_t get_accessory_override (void);
+void set_feed_override_target (uint8_t percent);
+uint8_t feed_override_target (void);
+uint8_t get_feed_override_target (void);
+void set_spindle_override_target (uint8_t percent);
+uint8_t spindle_override_target (void);
+uint8_t get_spindle_override_target (void);
 
 #endif
@@ -0,0 +1,205 @@
+/*
+  perf.c - cycle count instrumentation of time critical functions
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_PERF_COUNTERS
+
+/*
+  The driver provides a free running 32-bit cycle counter via hal.get_cycle_count and its frequency in
+  hal.f_cycle_counter, e.g. DWT CYCCNT on Cortex-M or CCOUNT on ESP32. No cycle counts are recorded if not.
+
+  Cycles are measured from entry to exit of a function and thus includes nested calls and interrupts,
+  e.g. gc_execute_block() includes the time spent in the planner and in step segment preparation
+  when the realtime checkpoint is passed while waiting for room in the planner buffer.
+  Function durations must be shorter than 2^32 cycles for the counter wrap to be handled.
+
+  Buffer events are counted regardless of the cycle counter, they tell why motion was slowed down or stopped:
+
+    Segment underruns:      the segment buffer ran empty while motion was expected to continue, st_prep_buffer()
+                            was not called often enough. Motion then stops without deceleration.
+    Planner starvations:    a block was queued to an empty planner buffer during a cycle, input was too slow
+                            and motion stopped before the block was executed.
+    Forced stops:           a block ended at zero speed since the next block was queued too late to be blended
+                            with it, the planner decelerates to a stop at the end of the buffer.
+
+  The minimum number of blocks in the planner buffer when a block is queued, the new block included, is reported
+  along with the events, 0 if not sampled. It is sampled during cycles once the planner buffer has been filled,
+  this to exclude the buffer filling up after a cycle start. The buffer draining at the end of a program is not
+  sampled since no blocks are queued then.
+
+  $PERF outputs one line for the buffer events, one for the counter frequency and one for each function measured:
+
+    [PERF:BUFFERS,<segment underruns>,<planner starvations>,<forced stops>,<minimum planner blocks>]
+    [PERF:CLOCK,<counter frequency in Hz>]
+    [PERF:<function>,<calls>,<min cycles>,<average cycles>,<max cycles>]
+
+  The CLOCK and function lines are only output if the driver provides a cycle counter.
+
+  $PERF=0 clears the statistics.
+*/
+
+typedef struct {
+    uint32_t calls;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} perf_stats_t;
+
+static const char *const perf_name[Perf_Counters] = {
+    "STEPPER_ISR",
+    "ST_PREP_BUFFER",
+    "GC_EXECUTE_BLOCK",
+    "PLANNER_RECALCULATE",
+    "REALTIME_REPORT",
+    "PLAN_BUFFER_LINE",
+    "MC_ARC",
+    "MC_CUBIC_B_SPLINE",
+    "PROTOCOL_EXECUTE_REALTIME"
+};
+
+static volatile perf_stats_t stats[Perf_Counters];
+static uint_fast16_t planner_min = 0;
+
+volatile uint32_t perf_events[Perf_Events];
+void (*perf_on_record)(perf_counter_t counter, uint32_t start, uint32_t cycles) = NULL;
+
+static void perf_reset (void)
+{
+    uint_fast8_t idx = Perf_Counters;
+
+    do {
+        idx--;
+        stats[idx].calls = 0; // min is set by the first call recorded
+        stats[idx].max = 0;
+        stats[idx].total = 0;
+    } while(idx);
+
+    idx = Perf_Events;
+    do {
+        perf_events[--idx] = 0;
+    } while(idx);
+
+    planner_min = 0;
+}
+
+void perf_planner_level (uint_fast16_t blocks)
+{
+    static bool filled = false;
+
+    if(sys.state != STATE_CYCLE)
+        filled = false;
+    else if(filled) {
+        if(planner_min == 0 || blocks < planner_min)
+            planner_min = blocks;
+    } else
+        filled = blocks == plan_get_block_buffer_size();
+}
+
+ISR_CODE void perf_record (perf_counter_t counter, uint32_t start)
+{
+    if(hal.get_cycle_count) {
+
+        uint32_t cycles = hal.get_cycle_count() - start;
+        volatile perf_stats_t *s = &stats[counter];
+
+        if(s->calls++ == 0)
+            s->min = UINT32_MAX;
+        if(cycles < s->min)
+            s->min = cycles;
+        if(cycles > s->max)
+            s->max = cycles;
+        s->total += cycles;
+
+        if(perf_on_record)
+            perf_on_record(counter, start, cycles);
+    }
+}
+
+ISR_CODE void perf_stepper_interrupt_handler (void)
+{
+    PERF_START(t);
+
+#ifdef ENABLE_STEP_TIMING
+    if(hal.driver_cap.step_timing)
+        stepper_timed_interrupt_handler();
+    else
+#endif
+    stepper_driver_interrupt_handler();
+
+    PERF_END(Perf_StepperInterrupt, t);
+}
+
+static void perf_report (void)
+{
+    uint_fast8_t idx;
+    perf_stats_t s;
+
+    hal.stream.write("[PERF:BUFFERS,");
+    for(idx = 0; idx < Perf_Events; idx++) {
+        hal.stream.write(uitoa(perf_events[idx]));
+        hal.stream.write(",");
+    }
+    hal.stream.write(uitoa(planner_min));
+    hal.stream.write("]" ASCII_EOL);
+
+    if(hal.get_cycle_count == NULL)
+        return;
+
+    hal.stream.write("[PERF:CLOCK,");
+    hal.stream.write(uitoa(hal.f_cycle_counter));
+    hal.stream.write("]" ASCII_EOL);
+
+    for(idx = 0; idx < Perf_Counters; idx++) {
+
+        // Copy again if a call was recorded while copying, the stepper interrupt updates its counter at any time.
+        do {
+            s = *(perf_stats_t *)&stats[idx];
+        } while(s.calls != stats[idx].calls);
+
+        hal.stream.write("[PERF:");
+        hal.stream.write(perf_name[idx]);
+        hal.stream.write(",");
+        hal.stream.write(uitoa(s.calls));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(s.calls ? s.min : 0));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(s.calls ? (uint32_t)(s.total / s.calls) : 0));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(s.max));
+        hal.stream.write("]" ASCII_EOL);
+    }
+}
+
+status_code_t perf_command (char *args)
+{
+    status_code_t retval = Status_OK;
+
+    if(*args == '\0')
+        perf_report();
+    else if(!strcmp(args, "=0"))
+        perf_reset();
+    else
+        retval = Status_InvalidStatement;
+
+    return retval;
+}
+
+#endif
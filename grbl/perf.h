@@ -0,0 +1,82 @@
+/*
+  perf.h - cycle count instrumentation of time critical functions
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _PERF_H_
+#define _PERF_H_
+
+typedef enum {
+    Perf_StepperInterrupt = 0,
+    Perf_PrepBuffer,
+    Perf_GcodeExecute,
+    Perf_PlannerRecalculate,
+    Perf_RealtimeReport,
+    Perf_PlanBufferLine,
+    Perf_ArcGenerate,
+    Perf_SplineGenerate,
+    Perf_ProtocolRealtime,
+    Perf_Counters // NOTE: always last
+} perf_counter_t;
+
+typedef enum {
+    Perf_SegmentUnderrun = 0,   // Segment buffer ran empty during a cycle while motion was expected to continue
+    Perf_PlannerStarved,        // Block queued to an empty planner buffer during a cycle
+    Perf_ForcedStop,            // Block ended at zero speed since the next block was queued too late to be blended with it
+    Perf_Events // NOTE: always last
+} perf_event_t;
+
+#ifdef ENABLE_PERF_COUNTERS
+
+// Declares a local variable t holding the cycle counter on entry, 0 if the driver does not provide a counter.
+#define PERF_START(t) uint32_t t = hal.get_cycle_count ? hal.get_cycle_count() : 0
+// Records the cycles spent since PERF_START(t) against counter c.
+#define PERF_END(c, t) perf_record(c, t)
+// Counts one occurrence of event e, safe to use in interrupt context.
+#define PERF_EVENT(e) perf_events[e]++
+// Records the number of blocks in the planner buffer when a block is queued, the new block included.
+#define PERF_PLANNER_LEVEL(n) perf_planner_level(n)
+
+extern volatile uint32_t perf_events[Perf_Events];
+
+// Called by perf_record() with the cycle count on entry and the cycles spent if set, e.g. by the simulator
+// to attribute cycles to the g-code line executing. Calls of nested functions are recorded before the caller.
+extern void (*perf_on_record)(perf_counter_t counter, uint32_t start, uint32_t cycles);
+
+// Adds one call of counter to the statistics, safe to call from interrupt context.
+void perf_record (perf_counter_t counter, uint32_t start);
+
+// Records the planner buffer fill level, the minimum seen during cycles once the buffer has been filled is reported.
+void perf_planner_level (uint_fast16_t blocks);
+
+// Stepper driver interrupt handler wrapper, registered in place of stepper_driver_interrupt_handler().
+void perf_stepper_interrupt_handler (void);
+
+// Handles $PERF and $PERF=0, reports or resets the statistics.
+status_code_t perf_command (char *args);
+
+#else
+
+#define PERF_START(t)
+#define PERF_END(c, t)
+#define PERF_EVENT(e)
+#define PERF_PLANNER_LEVEL(n)
+
+#endif
+
+#endif
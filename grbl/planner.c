@@ -23,14 +23,63 @@
 
 #include "grbl.h"
 
-static plan_block_t block_buffer[BLOCK_BUFFER_SIZE];    // A ring buffer for motion instructions
+static plan_block_t *block_buffer = NULL;               // A ring buffer for motion instructions
+static uint_fast16_t block_buffer_size;                 // Number of blocks in the ring buffer
 static plan_block_t *block_buffer_tail;                 // Pointer to the block to process now
 static plan_block_t *block_buffer_head;                 // Pointer to the next block to be pushed
 static plan_block_t *next_buffer_head;                  // Pointer to the next buffer head
 static plan_block_t *block_buffer_planned;              // Pointer to the optimally planned block
 
+#ifdef PLANNER_SOA
+// Look-ahead data used by planner_recalculate() kept in contiguous arrays indexed by ring buffer position.
+// NOTE: The entry speed and distance of the executing block are owned by the stepper module and are only
+// copied here when needed, the entry speed of a new buffer tail is copied back to its block.
+static struct {
+    float *entry_speed_sqr;
+    float *max_entry_speed_sqr;
+    float *acceleration;
+    float *millimeters;
+} profile;
+
+#define ENTRY_SPEED_SQR(idx) profile.entry_speed_sqr[idx]
+#define MAX_ENTRY_SPEED_SQR(idx) profile.max_entry_speed_sqr[idx]
+#define ACCELERATION(idx) profile.acceleration[idx]
+#define MILLIMETERS(idx) profile.millimeters[idx]
+#else
+#define ENTRY_SPEED_SQR(idx) block_buffer[idx].entry_speed_sqr
+#define MAX_ENTRY_SPEED_SQR(idx) block_buffer[idx].max_entry_speed_sqr
+#define ACCELERATION(idx) block_buffer[idx].acceleration
+#define MILLIMETERS(idx) block_buffer[idx].millimeters
+#endif
+
+#define BLOCK_INDEX(block) ((uint_fast16_t)((block) - block_buffer))
+#define PREV_INDEX(idx) ((idx) == 0 ? block_buffer_size - 1 : (idx) - 1)
+#define NEXT_INDEX(idx) ((idx) == block_buffer_size - 1 ? 0 : (idx) + 1)
+
 static planner_t pl;
 
+static struct {
+    uint8_t generation;     // Incremented when override changes are applied to the plan, never 0.
+    bool pending;           // Override values changed but not yet applied to the plan.
+    uint32_t replanned;     // Time of last replan (ms).
+} ovr = { .generation = 1 };
+
+#ifdef ENABLE_BACKLASH_COMPENSATION
+static struct {
+    axes_signals_t enabled;         // Axes with backlash compensation
+    axes_signals_t dir_negative;    // Axes last moved in the negative direction
+    uint32_t steps[N_AXIS];         // Backlash (steps)
+} backlash;
+#endif
+
+#ifdef ENABLE_INPUT_SHAPING
+static struct {
+    plan_shaper_t impulses;
+    float period_scale;     // Damped period (min) = period_scale / frequency (Hz)
+    float delay;            // Ramp time added by the shaper as fraction of the damped period, see plan_shaper_init()
+} shaper;
+#endif
+
 
 /*                            PLANNER SPEED DEFINITION
                                      +--------+   <- current->nominal_speed
@@ -72,6 +121,13 @@ static planner_t pl;
   used feed holds or feedrate overrides, the stop-compute pointers will be reset and the entire plan is
   recomputed as stated in the general guidelines.
 
+  When a block is appended the planned entry speeds of the blocks already in the buffer can only increase.
+  The reverse pass can thus be terminated as soon as it computes an entry speed equal to the one already
+  planned for a block, since all blocks before it will then be reverse computed to their current values.
+  The forward pass is then started from this block. This is typically the case when the newly added block
+  cannot raise the speed beyond a nearby junction where the entry speed is at its maximum, or when a long
+  stream of short segments is limited by acceleration rather than by the speed it can stop from.
+
   Planner buffer pointer mapping:
   - block_buffer_tail: Points to the beginning of the planner buffer. First to be executed or being executed.
   - block_buffer_head: Points to the buffer block after the last block in the buffer. Used to indicate whether
@@ -97,53 +153,96 @@ static planner_t pl;
   look-ahead blocks numbering up to a hundred or more.
 
 */
-static void planner_recalculate ()
+#ifdef PLANNER_SOA
+
+// Copies the entry speed and remaining distance of the executing block, owned by the stepper module, to the arrays.
+inline static void plan_fetch_exec_block_profile (void)
+{
+    uint_fast16_t tail = BLOCK_INDEX(block_buffer_tail);
+
+    ENTRY_SPEED_SQR(tail) = block_buffer_tail->entry_speed_sqr;
+    MILLIMETERS(tail) = block_buffer_tail->millimeters;
+}
+
+#endif
+
+// Notifies the stepper module to update the parameters of the executing block and picks up the entry speed
+// it is now executing from, the passes are planned from this.
+inline static void plan_update_exec_block_parameters (void)
 {
-    // Initialize block pointer to the last block in the planner buffer.
-    plan_block_t *block = block_buffer_head->prev;
+    st_update_plan_block_parameters();
+#ifdef PLANNER_SOA
+    plan_fetch_exec_block_profile();
+#endif
+}
+
+static void planner_recalculate (bool block_appended)
+{
+    // Initialize block index to the last block in the planner buffer.
+    uint_fast16_t block = PREV_INDEX(BLOCK_INDEX(block_buffer_head));
+    uint_fast16_t planned = BLOCK_INDEX(block_buffer_planned), tail = BLOCK_INDEX(block_buffer_tail);
 
     // Bail. Can't do anything with one only one plan-able block.
-    if (block == block_buffer_planned)
+    if (block == planned)
         return;
 
+#ifdef PLANNER_SOA
+    // The stepper may have updated the distance and entry speed of the executing block.
+    if (planned == tail)
+        plan_fetch_exec_block_profile();
+#endif
+
     // Reverse Pass: Coarsely maximize all possible deceleration curves back-planning from the last
     // block in buffer. Cease planning when the last optimal planned or tail pointer is reached.
     // NOTE: Forward pass will later refine and correct the reverse pass to create an optimal plan.
     float entry_speed_sqr;
-    plan_block_t *next;
-    plan_block_t *current = block;
+    uint_fast16_t next;
+    uint_fast16_t current = block;
+    uint_fast16_t forward_start = planned;
 
     // Calculate maximum entry speed for last block in buffer, where the exit speed is always zero.
-    current->entry_speed_sqr = min(current->max_entry_speed_sqr, 2.0f * current->acceleration * current->millimeters);
+    ENTRY_SPEED_SQR(current) = min(MAX_ENTRY_SPEED_SQR(current), 2.0f * ACCELERATION(current) * MILLIMETERS(current));
 
-    block = block->prev;
-    if (block == block_buffer_planned) { // Only two plannable blocks in buffer. Reverse pass complete.
+    block = PREV_INDEX(block);
+    if (block == planned) { // Only two plannable blocks in buffer. Reverse pass complete.
         // Check if the first block is the tail. If so, notify stepper to update its current parameters.
-        if (block == block_buffer_tail)
-            st_update_plan_block_parameters();
-    } else while (block != block_buffer_planned) { // Three or more plan-able blocks
+        if (block == tail)
+            plan_update_exec_block_parameters();
+    } else while (block != planned) { // Three or more plan-able blocks
 
         next = current;
         current = block;
-        block = block->prev;
+        block = PREV_INDEX(block);
 
         // Check if next block is the tail block(=planned block). If so, update current stepper parameters.
-        if (block == block_buffer_tail)
-            st_update_plan_block_parameters();
+        if (block == tail)
+            plan_update_exec_block_parameters();
 
         // Compute maximum entry speed decelerating over the current block from its exit speed.
-        if (current->entry_speed_sqr != current->max_entry_speed_sqr) {
-            entry_speed_sqr = next->entry_speed_sqr + 2.0f * current->acceleration * current->millimeters;
-            current->entry_speed_sqr = entry_speed_sqr < current->max_entry_speed_sqr ? entry_speed_sqr : current->max_entry_speed_sqr;
+        entry_speed_sqr = MAX_ENTRY_SPEED_SQR(current);
+        if (ENTRY_SPEED_SQR(current) != entry_speed_sqr) {
+            entry_speed_sqr = ENTRY_SPEED_SQR(next) + 2.0f * ACCELERATION(current) * MILLIMETERS(current);
+            if (entry_speed_sqr > MAX_ENTRY_SPEED_SQR(current))
+                entry_speed_sqr = MAX_ENTRY_SPEED_SQR(current);
         }
+
+        // Plan is unchanged from here back to the planned pointer, stop the reverse pass.
+        if (block_appended && entry_speed_sqr == ENTRY_SPEED_SQR(current)) {
+            forward_start = current;
+            break;
+        }
+
+        ENTRY_SPEED_SQR(current) = entry_speed_sqr;
     }
 
     // Forward Pass: Forward plan the acceleration curve from the planned pointer onward.
     // Also scans for optimal plan breakpoints and appropriately updates the planned pointer.
-    next = block_buffer_planned; // Begin at buffer planned pointer
-    block = block_buffer_planned->next;
+    uint_fast16_t head = BLOCK_INDEX(block_buffer_head);
 
-    while (block != block_buffer_head) {
+    next = forward_start; // Begin at buffer planned pointer or where the reverse pass was terminated
+    block = NEXT_INDEX(forward_start);
+
+    while (block != head) {
 
         current = next;
         next = block;
@@ -151,12 +250,12 @@ static void planner_recalculate ()
         // Any acceleration detected in the forward pass automatically moves the optimal planned
         // pointer forward, since everything before this is all optimal. In other words, nothing
         // can improve the plan from the buffer tail to the planned pointer by logic.
-        if (current->entry_speed_sqr < next->entry_speed_sqr) {
-            entry_speed_sqr = current->entry_speed_sqr + 2.0f * current->acceleration * current->millimeters;
+        if (ENTRY_SPEED_SQR(current) < ENTRY_SPEED_SQR(next)) {
+            entry_speed_sqr = ENTRY_SPEED_SQR(current) + 2.0f * ACCELERATION(current) * MILLIMETERS(current);
         // If true, current block is full-acceleration and we can move the planned pointer forward.
-            if (entry_speed_sqr < next->entry_speed_sqr) {
-                next->entry_speed_sqr = entry_speed_sqr; // Always <= max_entry_speed_sqr. Backward pass sets this.
-                block_buffer_planned = block; // Set optimal plan pointer.
+            if (entry_speed_sqr < ENTRY_SPEED_SQR(next)) {
+                ENTRY_SPEED_SQR(next) = entry_speed_sqr; // Always <= max_entry_speed_sqr. Backward pass sets this.
+                planned = block; // Set optimal plan pointer.
             }
         }
 
@@ -164,32 +263,48 @@ static void planner_recalculate ()
         // point in the buffer. When the plan is bracketed by either the beginning of the
         // buffer and a maximum entry speed or two maximum entry speeds, every block in between
         // cannot logically be further improved. Hence, we don't have to recompute them anymore.
-        if (next->entry_speed_sqr == next->max_entry_speed_sqr)
-            block_buffer_planned = block;
+        if (ENTRY_SPEED_SQR(next) == MAX_ENTRY_SPEED_SQR(next))
+            planned = block;
 
-        block = block->next;
+        block = NEXT_INDEX(block);
     }
+
+    block_buffer_planned = &block_buffer[planned];
 }
 
+// Returns any message and output commands not handed over to the stepper module to the pools.
 inline static void plan_cleanup (plan_block_t *block)
 {
     if(block->message) {
-        free(block->message);
+        pool_message_release(block->message);
         block->message = NULL;
     }
 
-    while(block->output_commands) {
-        output_command_t *next = block->output_commands->next;
-        free(block->output_commands);
-        block->output_commands = next;
+    if(block->output_commands) {
+        pool_output_commands_release(block->output_commands);
+        block->output_commands = NULL;
     }
+
+#ifdef ENABLE_WCO_MOTION_SYNC
+    if(block->wco) {
+        pool_wco_release(block->wco);
+        block->wco = NULL;
+    }
+#endif
+
+#ifdef ENABLE_RASTER_ROWS
+    if(block->raster) {
+        pool_raster_row_release(block->raster);
+        block->raster = NULL;
+    }
+#endif
 }
 
 
 inline static void plan_reset_buffer (bool soft_reset)
 {
     if(soft_reset) {
-        // Free memory for any pending messages and output commands after soft reset
+        // Return any pending messages and output commands to the pools after soft reset
         while(block_buffer_tail != block_buffer_head) {
             plan_cleanup(block_buffer_tail);
             block_buffer_tail = block_buffer_tail->next;
@@ -206,17 +321,53 @@ void plan_reset ()
 {
     static bool soft_reset = false;
 
+    PLANNER_LOCK(true);
+
     memset(&pl, 0, sizeof(planner_t)); // Clear planner struct
 
+    if(block_buffer == NULL) {
+#ifdef PLANNER_SOA
+        float *profile_data;
+#endif
+        // Use driver provided storage if available, else the default buffer.
+#ifdef PLANNER_SOA
+        if(hal.planner_buffer.blocks && hal.planner_buffer.profile && hal.planner_buffer.size >= 3) {
+            profile_data = hal.planner_buffer.profile;
+#else
+        if(hal.planner_buffer.blocks && hal.planner_buffer.size >= 3) {
+#endif
+            block_buffer = hal.planner_buffer.blocks;
+            block_buffer_size = hal.planner_buffer.size;
+        } else {
+            static plan_block_t block_buffer_default[BLOCK_BUFFER_SIZE];
+            block_buffer = block_buffer_default;
+            block_buffer_size = BLOCK_BUFFER_SIZE;
+#ifdef PLANNER_SOA
+            static float profile_default[BLOCK_BUFFER_SIZE * 4];
+            profile_data = profile_default;
+#endif
+        }
+        memset(block_buffer, 0, block_buffer_size * sizeof(plan_block_t)); // Driver provided storage may not be initialized
+#ifdef PLANNER_SOA
+        memset(profile_data, 0, block_buffer_size * 4 * sizeof(float));
+        profile.entry_speed_sqr = profile_data;
+        profile.max_entry_speed_sqr = profile_data + block_buffer_size;
+        profile.acceleration = profile_data + block_buffer_size * 2;
+        profile.millimeters = profile_data + block_buffer_size * 3;
+#endif
+    }
+
     // Set up stepper block ringbuffer as circular doubly linked list
-    uint_fast8_t idx;
-    for(idx = 0 ; idx <= BLOCK_BUFFER_SIZE - 1 ; idx++) {
-        block_buffer[idx].prev = &block_buffer[idx == 0 ? BLOCK_BUFFER_SIZE - 1 : idx - 1];
-        block_buffer[idx].next = &block_buffer[idx == BLOCK_BUFFER_SIZE - 1 ? 0 : idx + 1];
+    uint_fast16_t idx;
+    for(idx = 0 ; idx <= block_buffer_size - 1 ; idx++) {
+        block_buffer[idx].prev = &block_buffer[idx == 0 ? block_buffer_size - 1 : idx - 1];
+        block_buffer[idx].next = &block_buffer[idx == block_buffer_size - 1 ? 0 : idx + 1];
     }
 
     plan_reset_buffer(soft_reset);
     soft_reset = true;
+
+    PLANNER_LOCK(false);
 }
 
 
@@ -228,9 +379,42 @@ void plan_discard_current_block ()
         if (block_buffer_tail == block_buffer_planned)
             block_buffer_planned = block_buffer_tail->next;
         block_buffer_tail = block_buffer_tail->next;
+#ifdef PLANNER_SOA
+        // Hand over the planned entry speed of the new executing block to the stepper module.
+        if (block_buffer_tail != block_buffer_head)
+            block_buffer_tail->entry_speed_sqr = ENTRY_SPEED_SQR(BLOCK_INDEX(block_buffer_tail));
+#endif
+    }
+}
+
+
+#if defined(ENABLE_AUTO_CYCLE_START_DELAY) || defined(ENABLE_FEED_ADAPTATION)
+
+// Each block is taken to be executed at the peak speed reachable from its entry and exit speeds, limited by
+// its nominal speed, which gives a lower bound of its execution time. The entry speed and remaining distance
+// of the first block are read from the block as they are owned by the stepper module when it is executing.
+uint32_t plan_get_planned_time (uint32_t limit)
+{
+    float time = 0.0f, max_time = (float)limit / 60000.0f, exit_speed_sqr, speed;
+    float entry_speed_sqr = block_buffer_tail->entry_speed_sqr, millimeters = block_buffer_tail->millimeters;
+    uint_fast16_t idx = BLOCK_INDEX(block_buffer_tail), head = BLOCK_INDEX(block_buffer_head), next;
+
+    while(idx != head && time < max_time) {
+        next = NEXT_INDEX(idx);
+        exit_speed_sqr = next == head ? 0.0f : ENTRY_SPEED_SQR(next);
+        speed = min(plan_compute_profile_nominal_speed(&block_buffer[idx]),
+                     sqrtf(0.5f * (entry_speed_sqr + exit_speed_sqr) + ACCELERATION(idx) * millimeters));
+        if(speed > 0.0f)
+            time += millimeters / speed; // min
+        entry_speed_sqr = exit_speed_sqr;
+        if((idx = next) != head)
+            millimeters = MILLIMETERS(idx);
     }
+
+    return (uint32_t)(time * 60000.0f);
 }
 
+#endif
 
 // Returns address of planner buffer block used by system motions. Called by segment generator.
 plan_block_t *plan_get_system_motion_block ()
@@ -249,7 +433,14 @@ plan_block_t *plan_get_current_block ()
 inline float plan_get_exec_block_exit_speed_sqr ()
 {
     plan_block_t *block = block_buffer_tail->next;
-    return block == block_buffer_head ? 0.0f : block->entry_speed_sqr;
+    return block == block_buffer_head ? 0.0f : ENTRY_SPEED_SQR(BLOCK_INDEX(block));
+}
+
+
+// Returns the maximum allowable entry speed of a buffered block, for verification.
+float plan_get_max_entry_speed_sqr (plan_block_t *block)
+{
+    return MAX_ENTRY_SPEED_SQR(BLOCK_INDEX(block));
 }
 
 
@@ -261,22 +452,43 @@ bool plan_check_full_buffer ()
 
 
 // Computes and returns block nominal speed based on running condition and override values.
+// The result is kept in the block until overrides are changed, except for spindle synchronized motion.
 // NOTE: All system motion commands, such as homing/parking, are not subject to overrides.
 float plan_compute_profile_nominal_speed (plan_block_t *block)
 {
-    float nominal_speed = block->condition.spindle.synchronized ? block->programmed_rate * hal.spindle_get_data(SpindleData_RPM).rpm : block->programmed_rate;
+    if(block->override_generation == ovr.generation)
+        return block->nominal_speed;
+
+    float nominal_speed = SPINDLE_SYNCHRONIZED(block->condition) ? block->programmed_rate * hal.spindle_get_data(SpindleData_RPM).rpm : block->programmed_rate;
+
+#ifdef ENABLE_FEED_PER_REV_TRACKING
+    if(block->condition.feed_per_rev)
+        nominal_speed = block->programmed_rate * block->spindle.rpm;
+#endif
 
     if (block->condition.rapid_motion)
         nominal_speed *= (0.01f * sys.override.rapid_rate);
     else {
         if (!block->condition.no_feed_override)
+#ifdef ENABLE_FEED_ADAPTATION
+            nominal_speed *= (0.0001f * sys.override.feed_rate * sys.override.feed_adapt);
+#else
             nominal_speed *= (0.01f * sys.override.feed_rate);
+#endif
         if (nominal_speed > block->rapid_rate)
             nominal_speed = block->rapid_rate;
     }
 
 // TODO: if nominal speed is outside bounds when synchronized motion is on then (?? retract and) abort, ignore overrides?
-    return nominal_speed > MINIMUM_FEED_RATE ? nominal_speed : MINIMUM_FEED_RATE;
+    if(nominal_speed < MINIMUM_FEED_RATE)
+        nominal_speed = MINIMUM_FEED_RATE;
+
+    if(!SPINDLE_SYNCHRONIZED(block->condition)) {
+        block->nominal_speed = nominal_speed;
+        block->override_generation = ovr.generation;
+    }
+
+    return nominal_speed;
 }
 
 
@@ -285,9 +497,8 @@ float plan_compute_profile_nominal_speed (plan_block_t *block)
 inline static float plan_compute_profile_parameters (plan_block_t *block, float nominal_speed, float prev_nominal_speed)
 {
   // Compute the junction maximum entry based on the minimum of the junction speed and neighboring nominal speeds.
-    block->max_entry_speed_sqr = nominal_speed > prev_nominal_speed ? (prev_nominal_speed * prev_nominal_speed) : (nominal_speed * nominal_speed);
-    if (block->max_entry_speed_sqr > block->max_junction_speed_sqr)
-        block->max_entry_speed_sqr = block->max_junction_speed_sqr;
+    float max_entry_speed_sqr = nominal_speed > prev_nominal_speed ? (prev_nominal_speed * prev_nominal_speed) : (nominal_speed * nominal_speed);
+    MAX_ENTRY_SPEED_SQR(BLOCK_INDEX(block)) = max_entry_speed_sqr > block->max_junction_speed_sqr ? block->max_junction_speed_sqr : max_entry_speed_sqr;
     return nominal_speed;
 }
 
@@ -305,6 +516,105 @@ void plan_update_velocity_profile_parameters ()
 }
 
 
+#ifdef ENABLE_NATIVE_ARCS
+
+// Returns true if the radius vector passes the angle (radians, from the plane axis_0) when the arc is traversed.
+bool plan_arc_crosses_angle (plan_arc_t *arc, float angle)
+{
+    angle -= atan2f(arc->r[1], arc->r[0]);
+    if(arc->angular_travel < 0.0f)
+        angle = -angle;
+    if((angle = fmodf(angle, 2.0f * M_PI)) < 0.0f)
+        angle += 2.0f * M_PI;
+
+    return angle < fabsf(arc->angular_travel);
+}
+
+// Sets up a native arc block. The step event count is the number of steps along the path at the highest
+// step resolution of the moving axes, the segment generator computes the steps and directions of each
+// chord from the arc geometry. unit_vec is set to the start tangent and exit_vec to the end tangent for
+// the junction speeds. The block has a single nominal speed, limit_vec is set to the largest tangent
+// component of each plane axis along the arc so that the axis maximum rates and accelerations hold for
+// the complete arc.
+static void plan_arc_setup (plan_block_t *block, plan_arc_t *arc, int32_t *position_steps, int32_t *target_steps,
+                             float *unit_vec, float *exit_vec, float *limit_vec)
+{
+    uint_fast8_t idx = N_AXIS;
+    float steps_per_mm = 0.0f;
+    float planar = fabsf(arc->angular_travel) * arc->radius / arc->length; // Plane share of the path length
+    float k = (arc->angular_travel < 0.0f ? -planar : planar) / arc->radius;
+    float cos_T = cosf(arc->angular_travel), sin_T = sinf(arc->angular_travel);
+
+    memcpy(&block->arc, arc, sizeof(plan_arc_t));
+    memcpy(block->arc.start_steps, position_steps, sizeof(block->arc.start_steps));
+    memcpy(block->arc.target_steps, target_steps, sizeof(block->arc.target_steps));
+    block->condition.arc_motion = On;
+
+    do {
+        idx--;
+        unit_vec[idx] = exit_vec[idx] = limit_vec[idx] = arc->delta[idx] / arc->length;
+        if(arc->delta[idx] != 0.0f || idx == arc->axis_0 || idx == arc->axis_1)
+            steps_per_mm = max(steps_per_mm, settings.steps_per_mm[idx]);
+    } while(idx);
+
+    // Tangents are the radius vectors rotated 90 degrees in the direction of travel.
+    unit_vec[arc->axis_0] = -arc->r[1] * k;
+    unit_vec[arc->axis_1] = arc->r[0] * k;
+    exit_vec[arc->axis_0] = -(arc->r[0] * sin_T + arc->r[1] * cos_T) * k;
+    exit_vec[arc->axis_1] = (arc->r[0] * cos_T - arc->r[1] * sin_T) * k;
+
+    // The axis_0 tangent component peaks where the radius vector is parallel to axis_1 and vice versa.
+    limit_vec[arc->axis_0] = plan_arc_crosses_angle(arc, 0.5f * M_PI) || plan_arc_crosses_angle(arc, -0.5f * M_PI)
+                              ? planar
+                              : max(fabsf(unit_vec[arc->axis_0]), fabsf(exit_vec[arc->axis_0]));
+    limit_vec[arc->axis_1] = plan_arc_crosses_angle(arc, 0.0f) || plan_arc_crosses_angle(arc, M_PI)
+                              ? planar
+                              : max(fabsf(unit_vec[arc->axis_1]), fabsf(exit_vec[arc->axis_1]));
+
+    block->step_event_count = (uint32_t)ceilf(arc->length * steps_per_mm);
+}
+
+#endif
+
+#ifdef ENABLE_INPUT_SHAPING
+
+// Selects the shapers of the two axes moving the most in the block, cascaded by the segment generator.
+// Axes with the same frequency share a shaper. Returns false if the block is not shaped.
+static bool shaper_select (plan_block_t *block, float *limit_vec)
+{
+    uint_fast8_t idx = N_AXIS;
+    float weight[2] = {0.0f}, period, w;
+
+    block->shaper_period[0] = block->shaper_period[1] = 0.0f;
+
+    if(block->condition.system_motion)
+        return false;
+
+    do {
+        idx--;
+        if(settings.shaper_freq[idx] > 0.0f && (w = fabsf(limit_vec[idx])) > 0.0f) {
+            period = shaper.period_scale / settings.shaper_freq[idx];
+            if(period == block->shaper_period[0])
+                weight[0] = max(weight[0], w);
+            else if(period == block->shaper_period[1])
+                weight[1] = max(weight[1], w);
+            else if(w > weight[0]) {
+                block->shaper_period[1] = block->shaper_period[0];
+                weight[1] = weight[0];
+                block->shaper_period[0] = period;
+                weight[0] = w;
+            } else if(w > weight[1]) {
+                block->shaper_period[1] = period;
+                weight[1] = w;
+            }
+        }
+    } while(idx);
+
+    return block->shaper_period[0] > 0.0f;
+}
+
+#endif
+
 /* Add a new linear movement to the buffer. target[N_AXIS] is the signed, absolute target position
    in millimeters. Feed rate specifies the speed of the motion. If feed rate is inverted, the feed
    rate is taken to mean "frequency" and would complete the operation in 1/feed_rate minutes.
@@ -319,22 +629,35 @@ void plan_update_velocity_profile_parameters ()
    head. It avoids changing the planner state and preserves the buffer to ensure subsequent gcode
    motions are still planned correctly, while the stepper module only points to the block buffer head
    to execute the special system motion. */
-bool plan_buffer_line (float *target, plan_line_data_t *pl_data)
+static bool buffer_line (float *target, plan_line_data_t *pl_data)
 {
     // Prepare and initialize new block. Copy relevant pl_data for block execution.
     plan_block_t *block = block_buffer_head;
     int32_t target_steps[N_AXIS], position_steps[N_AXIS], delta_steps;
     uint_fast8_t idx;
-    float unit_vec[N_AXIS];
+    float unit_vec[N_AXIS], *limit_vec = unit_vec, *exit_vec = unit_vec;
+#ifdef KINEMATICS_API
+    float motor_vec[N_AXIS], magnitude = 0.0f;
+#endif
+#ifdef ENABLE_NATIVE_ARCS
+    float arc_limit_vec[N_AXIS], arc_exit_vec[N_AXIS];
+#endif
 
 //    plan_cleanup(block);
     memset(block, 0, sizeof(plan_block_t) - 2 * sizeof(plan_block_t *));    // Zero all block values (except linked list pointers).
     memcpy(&block->spindle, &pl_data->spindle, sizeof(spindle_t));          // Copy spindle data (RPM etc)
     block->condition = pl_data->condition;
+#ifdef ENABLE_WAIT_ON_INPUT_ASYNC
+    if (!(block->condition.system_motion || block->condition.jog_motion))
+        block->condition.wait_on_input = wait_input_attach();
+#endif
     block->overrides = pl_data->overrides;
     block->line_number = pl_data->line_number;
     block->message = pl_data->message;
     block->output_commands = pl_data->output_commands;
+#ifdef ENABLE_RASTER_ROWS
+    block->raster = pl_data->raster;
+#endif
 
     // Copy position data based on type of motion being planned.
     memcpy(position_steps, block->condition.system_motion ? sys_position : pl.position, sizeof(position_steps));
@@ -357,8 +680,21 @@ bool plan_buffer_line (float *target, plan_line_data_t *pl_data)
 #endif
         delta_steps = target_steps[idx] - position_steps[idx];
         block->steps[idx] = labs(delta_steps);
+#ifdef ENABLE_BACKLASH_COMPENSATION
+        // On direction reversal record the steps taking up the backlash. The stepper module executes them ahead
+        // of the steps of the block and does not change the machine position for them.
+        if(delta_steps && (backlash.enabled.mask & bit(idx)) && !block->condition.system_motion &&
+            (delta_steps < 0) != !!(backlash.dir_negative.mask & bit(idx))) {
+            backlash.dir_negative.mask ^= bit(idx);
+            block->backlash_steps[idx] = backlash.steps[idx];
+        }
+#endif
         block->step_event_count = max(block->step_event_count, block->steps[idx]);
+#ifdef KINEMATICS_API
+        motor_vec[idx] = (float)delta_steps / settings.steps_per_mm[idx]; // Store motor vector numerator
+#else
         unit_vec[idx] = (float)delta_steps / settings.steps_per_mm[idx]; // Store unit vector numerator
+#endif
 
         // Set direction bits. Bit enabled always means direction is negative.
         if (delta_steps < 0)
@@ -366,37 +702,95 @@ bool plan_buffer_line (float *target, plan_line_data_t *pl_data)
 
     } while(idx);
 
-    // Calculate RPMs to be used for Constant Surface Speed calculations
+#ifdef KINEMATICS_API
+    // Plan the motion along the cartesian line from the planner position to the target, the motor travel
+    // per mm along the line is used to limit rate and acceleration against the motor (axis) settings.
+    // NOTE: The motor travel is linear in the cartesian travel over the block for linear kinematics such as
+    // CoreXY, for non-linear kinematics it is the average over the block and lines must be segmented.
+    kinematics.convert_array_steps_to_mpos(unit_vec, position_steps);
+
+    idx = N_AXIS;
+    do {
+        idx--;
+        unit_vec[idx] = target[idx] - unit_vec[idx];
+        magnitude += unit_vec[idx] * unit_vec[idx];
+    } while(idx);
+
+    // Fall back to motor space if motor steps are not matched by cartesian travel, possible from rounding.
+    if(magnitude == 0.0f)
+        memcpy(unit_vec, motor_vec, sizeof(unit_vec));
+
+    limit_vec = motor_vec;
+#endif
+
+#ifdef ENABLE_NATIVE_ARCS
+    if(pl_data->arc) {
+        plan_arc_setup(block, pl_data->arc, position_steps, target_steps, unit_vec, arc_exit_vec, arc_limit_vec);
+        limit_vec = arc_limit_vec;
+        exit_vec = arc_exit_vec;
+    }
+#endif
+
+    // Calculate data to be used for Constant Surface Speed calculations, the stepper
+    // recomputes the RPM per segment from the tool axis position.
     if(block->condition.is_rpm_pos_adjusted) {
-        float pos;
-        if((pos = (float)position_steps[block->spindle.css.axis] / settings.steps_per_mm[block->spindle.css.axis] - block->spindle.css.tool_offset) > 0.0f) {
-            block->spindle.rpm = block->spindle.css.surface_speed / (pos * (float)(2.0f * M_PI));
-            if(block->spindle.rpm > block->spindle.css.max_rpm)
-                block->spindle.rpm = block->spindle.css.max_rpm;
-        } else
-            block->spindle.rpm = block->spindle.css.max_rpm;
-        if((pos = target[block->spindle.css.axis] - block->spindle.css.tool_offset) > 0.0f) {
-            block->spindle.css.target_rpm = block->spindle.css.surface_speed / (pos * (float)(2.0f * M_PI));
-            if(block->spindle.css.target_rpm > block->spindle.css.max_rpm)
-                block->spindle.css.target_rpm = block->spindle.css.max_rpm;
-        } else
-            block->spindle.css.target_rpm = block->spindle.css.max_rpm;
+        block->spindle.css.start_pos = (float)position_steps[block->spindle.css.axis] / settings.steps_per_mm[block->spindle.css.axis] - block->spindle.css.tool_offset;
+        block->spindle.css.delta_pos = target[block->spindle.css.axis] - block->spindle.css.tool_offset - block->spindle.css.start_pos;
+        block->spindle.rpm = gc_get_css_rpm(&block->spindle.css, block->spindle.css.start_pos);
     }
 
     // Bail if this is a zero-length block. Highly unlikely to occur.
     if (block->step_event_count == 0)
         return false;
 
+#ifdef ENABLE_WCO_MOTION_SYNC
+    if (!block->condition.system_motion)
+        block->wco = system_wco_attach();
+#endif
+
     pl_data->message = NULL;         // Indicate message is already queued for display on execution
     pl_data->output_commands = NULL; // Indicate commands are already queued for execution
+#ifdef ENABLE_COOLANT_QUEUE
+    pl_data->condition.coolant_sync = Off; // Indicate coolant change is already queued for execution
+#endif
+#ifdef ENABLE_RASTER_ROWS
+    pl_data->raster = NULL;          // Indicate raster row is owned by the planner block
+#endif
+
+    // NOTE: the code above only touches the new block which is not yet visible to the segment generator.
+    PLANNER_LOCK(true);
 
     // Calculate the unit vector of the line move and the block maximum feed rate and acceleration scaled
     // down such that no individual axes maximum values are exceeded with respect to the line direction.
     // NOTE: This calculation assumes all axes are orthogonal (Cartesian) and works with ABC-axes,
-    // if they are also orthogonal/independent. Operates on the absolute value of the unit vector.
+    // if they are also orthogonal/independent. Operates on the absolute value of the unit vector, with kinematics
+    // on the motor travel per mm instead.
+#ifdef ENABLE_NATIVE_ARCS
+    if(block->condition.arc_motion)
+        block->millimeters = block->arc.length;
+    else
+#endif
     block->millimeters = convert_delta_vector_to_unit_vector(unit_vec);
-    block->acceleration = limit_value_by_axis_maximum(settings.acceleration, unit_vec);
-    block->rapid_rate = limit_value_by_axis_maximum(settings.max_rate, unit_vec);
+#ifdef KINEMATICS_API
+    idx = N_AXIS;
+    do {
+        motor_vec[--idx] /= block->millimeters;
+    } while(idx);
+#endif
+    block->acceleration = limit_value_by_axis_maximum(settings.acceleration, limit_vec);
+    block->rapid_rate = limit_value_by_axis_maximum(settings.max_rate, limit_vec);
+#ifdef ENABLE_NATIVE_ARCS
+    if(block->condition.arc_motion) {
+        // Limit the rate so that the centripetal acceleration, v^2/r, is within the acceleration of the plane axes.
+        float centripetal_rate = sqrtf(min(settings.acceleration[block->arc.axis_0], settings.acceleration[block->arc.axis_1]) * block->arc.radius);
+        if(block->rapid_rate > centripetal_rate)
+            block->rapid_rate = centripetal_rate;
+    }
+#endif
+#ifdef ENABLE_RASTER_ROWS
+    if(block->raster)
+        block->raster->length = block->millimeters; // The block length is consumed by the segment generator.
+#endif
 
     // Store programmed rate.
     if (block->condition.rapid_motion)
@@ -407,11 +801,50 @@ bool plan_buffer_line (float *target, plan_line_data_t *pl_data)
             block->programmed_rate *= block->millimeters;
     }
 
+#ifdef ENABLE_JERK_ACCELERATION
+    // The planner plans trapezoidal profiles and the segment generator shapes each ramp into a jerk limited
+    // S-curve with the same duration and distance. Plan with the average acceleration of a full S-curve ramp
+    // from rest to the nominal speed, this ramp then peaks at exactly the axis-limited acceleration.
+    float nominal_speed = plan_compute_profile_nominal_speed(block);
+    block->max_acceleration = block->acceleration;
+    block->jerk = limit_value_by_axis_maximum(settings.jerk, limit_vec);
+    block->acceleration = block->max_acceleration * nominal_speed / (nominal_speed + block->max_acceleration * block->max_acceleration / block->jerk);
+#endif
+
+#ifdef ENABLE_INPUT_SHAPING
+    block->max_acceleration = block->acceleration;
+    if(shaper_select(block, limit_vec)) {
+        // The segment generator convolves each ramp with the shaper impulses, the shaped ramp covers the planned
+        // distance and needs a higher acceleration the longer the shapers are. Plan with the reduced acceleration
+        // of a ramp from rest to the nominal speed that then peaks at exactly the axis-limited acceleration.
+        float nominal_speed = plan_compute_profile_nominal_speed(block);
+        float delay = shaper.delay * (block->shaper_period[0] + block->shaper_period[1]);
+        block->acceleration = block->max_acceleration * nominal_speed / (nominal_speed + block->max_acceleration * delay);
+    }
+#endif
+
+    // Precompute reciprocals for the segment generator, this moves the divisions out of st_prep_buffer().
+    block->steps_per_mm = (float)block->step_event_count / block->millimeters;
+    block->req_mm_increment = REQ_MM_INCREMENT_SCALAR / block->steps_per_mm;
+    block->inv_2_accel = 0.5f / block->acceleration;
+    if (block->condition.is_rpm_rate_adjusted)
+        block->inv_feedrate = block->condition.is_laser_ppi_mode ? 1.0f : 1.0f / block->programmed_rate;
+
+#ifdef ENABLE_PERF_COUNTERS
+    if (!block->condition.system_motion) {
+        // The planner ran dry while the steppers are still executing the last block, motion will stop before this block is executed.
+        if (block_buffer_head == block_buffer_tail && sys.state == STATE_CYCLE)
+            PERF_EVENT(Perf_PlannerStarved);
+        PERF_PLANNER_LEVEL(block_buffer_size - plan_get_block_buffer_available());
+    }
+#endif
+
     // TODO: Need to check this method handling zero junction speeds when starting from rest.
-    if ((block_buffer_head == block_buffer_tail) || (block->condition.system_motion)) {
+    if ((block_buffer_head == block_buffer_tail) || block->condition.system_motion || block->condition.wait_on_input || block->condition.exact_stop) {
 
         // Initialize block entry speed as zero. Assume it will be starting from rest. Planner will correct this later.
         // If system motion, the system motion block always is assumed to start from rest and end at a complete stop.
+        // In exact stop mode (G61.1) the previous block is decelerated to a complete stop before this block starts.
         block->entry_speed_sqr = 0.0f;
         block->max_junction_speed_sqr = 0.0f; // Starting from rest. Enforce start from zero velocity.
 
@@ -433,6 +866,8 @@ bool plan_buffer_line (float *target, plan_line_data_t *pl_data)
         // is exactly the same. Instead of motioning all the way to junction point, the machine will
         // just follow the arc circle defined here. The Arduino doesn't have the CPU cycles to perform
         // a continuous mode path, but ARM-based microcontrollers most certainly do.
+        // NOTE: Unless path blending is enabled a G64 P-word replaces the junction deviation setting for
+        // the junction at the start of the block.
         //
         // NOTE: The max junction speed is a fixed value, since machine acceleration limits cannot be
         // changed dynamically during operation nor can the line move geometry. This must be kept in
@@ -441,12 +876,18 @@ bool plan_buffer_line (float *target, plan_line_data_t *pl_data)
 
         float junction_unit_vec[N_AXIS];
         float junction_cos_theta = 0.0f;
+#ifdef KINEMATICS_API
+        float junction_motor_vec[N_AXIS];
+#endif
 
         idx = N_AXIS;
         do {
             idx--;
             junction_cos_theta -= pl.previous_unit_vec[idx] * unit_vec[idx];
             junction_unit_vec[idx] = unit_vec[idx] - pl.previous_unit_vec[idx];
+#ifdef KINEMATICS_API
+            junction_motor_vec[idx] = motor_vec[idx] - pl.previous_motor_vec[idx];
+#endif
         } while(idx);
 
         // NOTE: Computed without any expensive trig, sin() or acos(), by trig half angle identity of cos(theta).
@@ -457,35 +898,89 @@ bool plan_buffer_line (float *target, plan_line_data_t *pl_data)
             // Junction is a straight line or 180 degrees. Junction speed is infinite.
             block->max_junction_speed_sqr = SOME_LARGE_VALUE;
         } else {
+#ifdef KINEMATICS_API
+            // The motor acceleration per unit of cartesian acceleration in the junction direction.
+            float junction_length = convert_delta_vector_to_unit_vector(junction_unit_vec);
+            idx = N_AXIS;
+            do {
+                junction_motor_vec[--idx] /= junction_length;
+            } while(idx);
+            float junction_acceleration = limit_value_by_axis_maximum(settings.acceleration, junction_motor_vec);
+#else
             convert_delta_vector_to_unit_vector(junction_unit_vec);
             float junction_acceleration = limit_value_by_axis_maximum(settings.acceleration, junction_unit_vec);
+#endif
             float sin_theta_d2 = sqrtf(0.5f * (1.0f - junction_cos_theta)); // Trig half angle identity. Always positive.
+#ifdef ENABLE_PATH_BLENDING
+            float junction_deviation = settings.junction_deviation;
+#else
+            float junction_deviation = pl_data->junction_deviation > 0.0f ? pl_data->junction_deviation : settings.junction_deviation;
+#endif
             block->max_junction_speed_sqr = max(MINIMUM_JUNCTION_SPEED * MINIMUM_JUNCTION_SPEED,
-                                                  (junction_acceleration * settings.junction_deviation * sin_theta_d2) / (1.0f - sin_theta_d2));
+                                                  (junction_acceleration * junction_deviation * sin_theta_d2) / (1.0f - sin_theta_d2));
+        }
+
+#if defined(ENABLE_SPINDLE_RPM_QUEUE) && SPINDLE_RPM_RAMP > 0
+        // The spindle speeds up from the previous RPM at the junction, limit the junction speed so that the feed rate
+        // stays within the feed per revolution of the block: at most the nominal speed scaled by the RPM ratio, and
+        // if the block accelerates faster than the spindle low enough to not reach the nominal speed before it does.
+        if (pl.previous_rpm > 0.0f && block->condition.spindle.on && block->spindle.rpm > pl.previous_rpm && !LASER_MODE) {
+            float nominal_speed = plan_compute_profile_nominal_speed(block);
+            float ramp_time = (block->spindle.rpm - pl.previous_rpm) / (SPINDLE_RPM_RAMP * 60.0f); // min
+            float speed = nominal_speed * pl.previous_rpm / block->spindle.rpm;
+            if (block->acceleration * ramp_time > nominal_speed - speed)
+                speed = max(MINIMUM_JUNCTION_SPEED, nominal_speed - block->acceleration * ramp_time);
+            block->max_junction_speed_sqr = min(block->max_junction_speed_sqr, speed * speed);
         }
+#endif
     }
 
     // Block system motion from updating this data to ensure next g-code motion is computed correctly.
     if (!block->condition.system_motion) {
 
         pl.previous_nominal_speed = plan_compute_profile_parameters(block, plan_compute_profile_nominal_speed(block), pl.previous_nominal_speed);
+#ifdef ENABLE_SPINDLE_RPM_QUEUE
+        pl.previous_rpm = block->condition.spindle.on ? block->spindle.rpm : 0.0f;
+#endif
 
-        if(!block->condition.backlash_motion) {
-            // Update previous path unit_vector and planner position.
-            memcpy(pl.previous_unit_vec, unit_vec, sizeof(unit_vec)); // pl.previous_unit_vec[] = unit_vec[]
-            memcpy(pl.position, target_steps, sizeof(target_steps)); // pl.position[] = target_steps[]
-        }
+        // Update previous path unit_vector and planner position.
+        memcpy(pl.previous_unit_vec, exit_vec, sizeof(unit_vec)); // pl.previous_unit_vec[] = unit_vec[]
+#ifdef KINEMATICS_API
+        memcpy(pl.previous_motor_vec, motor_vec, sizeof(motor_vec));
+#endif
+        memcpy(pl.position, target_steps, sizeof(target_steps)); // pl.position[] = target_steps[]
+#ifdef PLANNER_SOA
+        uint_fast16_t block_idx = BLOCK_INDEX(block);
+        ENTRY_SPEED_SQR(block_idx) = block->entry_speed_sqr;
+        ACCELERATION(block_idx) = block->acceleration;
+        MILLIMETERS(block_idx) = block->millimeters;
+#endif
         // New block is all set. Update buffer head and next buffer head indices.
         block_buffer_head = next_buffer_head;
         next_buffer_head = block_buffer_head->next;
 
         // Finish up by recalculating the plan with the new block.
-        planner_recalculate();
+        PERF_START(t);
+        planner_recalculate(true);
+        PERF_END(Perf_PlannerRecalculate, t);
     }
 
+    PLANNER_LOCK(false);
+
     return true;
 }
 
+bool plan_buffer_line (float *target, plan_line_data_t *pl_data)
+{
+    PERF_START(t);
+
+    bool ok = buffer_line(target, pl_data);
+
+    PERF_END(Perf_PlanBufferLine, t);
+
+    return ok;
+}
+
 
 // Reset the planner position vectors. Called by the system abort/initialization routine.
 void plan_sync_position ()
@@ -494,12 +989,119 @@ void plan_sync_position ()
 }
 
 
+// Returns the planner position, the end point of the last queued block, in machine coordinates (mm).
+void plan_get_planner_mpos (float *target)
+{
+    system_convert_array_steps_to_mpos(target, pl.position);
+}
+
+#ifdef ENABLE_BACKLASH_COMPENSATION
+
+void plan_backlash_init (void)
+{
+    uint_fast8_t idx = N_AXIS;
+
+    backlash.enabled.mask = backlash.dir_negative.mask = 0;
+
+    do {
+        idx--;
+        if((backlash.steps[idx] = (uint32_t)lroundf(settings.backlash[idx] * settings.steps_per_mm[idx])))
+            backlash.enabled.mask |= bit(idx);
+        backlash.dir_negative.mask |= bit(idx);
+    } while(idx);
+
+    backlash.dir_negative.mask ^= settings.homing.dir_mask.value;
+}
+
+axes_signals_t plan_get_backlash_axes (void)
+{
+    return backlash.enabled;
+}
+
+#endif
+
+#ifdef ENABLE_INPUT_SHAPING
+
+/*
+  A ramp with constant acceleration a over the time Tb is convolved with impulses A(i) at times t(i), the shaped
+  ramp then reaches the end speed after Tb + t(n-1). For the shaped ramp to cover the planned ramp distance
+  Tb is shorter than the planned ramp time and a is higher. For a ramp between rest and the nominal speed v,
+  planned with acceleration a0, a = v / (v / a0 - 2 * c) where c is the impulse centroid sum(A(i) * t(i)) for
+  deceleration ramps and t(n-1) - c for acceleration ramps. delay is set to 2 * max(c, t(n-1) - c).
+*/
+void plan_shaper_init (void)
+{
+    uint_fast8_t idx;
+    float zeta = settings.shaper_damping, df = sqrtf(1.0f - zeta * zeta), k, sum = 0.0f, centroid = 0.0f;
+    plan_shaper_t *impulses = &shaper.impulses;
+
+    switch((input_shaper_t)settings.shaper_type) {
+
+        case InputShaper_ZVD:
+            k = expf(-zeta * M_PI / df);
+            impulses->n_impulses = 3;
+            impulses->amplitude[0] = 1.0f;
+            impulses->amplitude[1] = 2.0f * k;
+            impulses->amplitude[2] = k * k;
+            impulses->time[0] = 0.0f;
+            impulses->time[1] = 0.5f;
+            impulses->time[2] = 1.0f;
+            break;
+
+        case InputShaper_MZV:
+            k = expf(-0.75f * zeta * M_PI / df);
+            impulses->n_impulses = 3;
+            impulses->amplitude[0] = 1.0f - 1.0f / sqrtf(2.0f);
+            impulses->amplitude[1] = (sqrtf(2.0f) - 1.0f) * k;
+            impulses->amplitude[2] = impulses->amplitude[0] * k * k;
+            impulses->time[0] = 0.0f;
+            impulses->time[1] = 0.375f;
+            impulses->time[2] = 0.75f;
+            break;
+
+        default: // InputShaper_ZV
+            k = expf(-zeta * M_PI / df);
+            impulses->n_impulses = 2;
+            impulses->amplitude[0] = 1.0f;
+            impulses->amplitude[1] = k;
+            impulses->time[0] = 0.0f;
+            impulses->time[1] = 0.5f;
+            break;
+    }
+
+    for(idx = 0; idx < impulses->n_impulses; idx++)
+        sum += impulses->amplitude[idx];
+
+    for(idx = 0; idx < impulses->n_impulses; idx++) {
+        impulses->amplitude[idx] /= sum;
+        centroid += impulses->amplitude[idx] * impulses->time[idx];
+    }
+
+    shaper.delay = 2.0f * max(centroid, impulses->time[impulses->n_impulses - 1] - centroid);
+    shaper.period_scale = 1.0f / (60.0f * df);
+}
+
+const plan_shaper_t *plan_get_shaper (void)
+{
+    return &shaper.impulses;
+}
+
+#endif
+
+
 // Returns the number of available blocks are in the planner buffer.
-uint8_t plan_get_block_buffer_available ()
+uint_fast16_t plan_get_block_buffer_available ()
 {
-    return (uint8_t)(block_buffer_head >= block_buffer_tail
-                      ? ((BLOCK_BUFFER_SIZE - 1) - (block_buffer_head - block_buffer_tail))
-                      : ((block_buffer_tail - block_buffer_head) - 1));
+    return (uint_fast16_t)(block_buffer_head >= block_buffer_tail
+                            ? ((block_buffer_size - 1) - (block_buffer_head - block_buffer_tail))
+                            : ((block_buffer_tail - block_buffer_head) - 1));
+}
+
+
+// Returns the number of blocks that can be queued in the planner buffer, one block is always kept empty.
+uint_fast16_t plan_get_block_buffer_size ()
+{
+    return block_buffer_size - 1;
 }
 
 
@@ -507,10 +1109,17 @@ uint8_t plan_get_block_buffer_available ()
 // Called after a steppers have come to a complete stop for a feed hold and the cycle is stopped.
 void plan_cycle_reinitialize ()
 {
+    PLANNER_LOCK(true);
+
     // Re-plan from a complete stop. Reset planner entry speeds and buffer planned pointer.
     st_update_plan_block_parameters();
     block_buffer_planned = block_buffer_tail;
-    planner_recalculate();
+
+    PERF_START(t);
+    planner_recalculate(false);
+    PERF_END(Perf_PlannerRecalculate, t);
+
+    PLANNER_LOCK(false);
 }
 
 // Set feed overrides
@@ -525,7 +1134,66 @@ void plan_feed_override (uint_fast8_t feed_override, uint_fast8_t rapid_override
       sys.override.feed_rate = (uint8_t)feed_override;
       sys.override.rapid_rate = (uint8_t)rapid_override;
       sys.report.overrides = On; // Set to report change immediately
-      plan_update_velocity_profile_parameters();
-      plan_cycle_reinitialize();
+      ovr.pending = true;
+      plan_apply_overrides();
     }
 }
+
+#ifdef ENABLE_FEED_ADAPTATION
+
+// Starvation of the planner buffer is predicted when it is not full and holds less than FEED_ADAPT_LOW_TIME ms
+// of planned motion while running, the feed rate is then lowered by FEED_ADAPT_STEP percent every
+// FEED_ADAPT_INTERVAL ms down to FEED_ADAPT_MIN percent. This makes the buffered motion last longer and
+// the sender may catch up before the machine has to decelerate to a stop at the end of the buffer.
+// The feed rate is raised in the same steps when the buffer is full or holds twice that time of motion,
+// and restored at once when not running or not streaming. The change is applied as a feed override.
+void plan_feed_adapt (bool streaming)
+{
+    static uint32_t checked = 0;
+
+    uint_fast8_t rate = sys.override.feed_adapt;
+
+    if(!(streaming && sys.state == STATE_CYCLE && hal.get_elapsed_ticks))
+        rate = 100;
+    else {
+        uint32_t ms = hal.get_elapsed_ticks();
+        if(ms - checked >= FEED_ADAPT_INTERVAL) {
+            uint32_t time = plan_check_full_buffer() ? FEED_ADAPT_LOW_TIME * 2 : plan_get_planned_time(FEED_ADAPT_LOW_TIME * 2);
+            checked = ms;
+            if(time < FEED_ADAPT_LOW_TIME)
+                rate = rate > FEED_ADAPT_MIN + FEED_ADAPT_STEP ? rate - FEED_ADAPT_STEP : FEED_ADAPT_MIN;
+            else if(time >= FEED_ADAPT_LOW_TIME * 2)
+                rate = rate < 100 - FEED_ADAPT_STEP ? rate + FEED_ADAPT_STEP : 100;
+        }
+    }
+
+    if(rate != sys.override.feed_adapt) {
+        sys.override.feed_adapt = (uint8_t)rate;
+        ovr.pending = true;
+    }
+}
+
+#endif
+
+// Changes arriving within PLANNER_OVERRIDE_REPLAN_INTERVAL ms of the last replan are left pending and
+// applied together by a later call, the buffer is then walked once for all of them.
+void plan_apply_overrides (void)
+{
+    if(!ovr.pending)
+        return;
+
+    uint32_t ms = hal.get_elapsed_ticks ? hal.get_elapsed_ticks() : 0;
+
+    if(hal.get_elapsed_ticks && ms - ovr.replanned < PLANNER_OVERRIDE_REPLAN_INTERVAL)
+        return;
+
+    ovr.pending = false;
+    ovr.replanned = ms;
+    if(++ovr.generation == 0) // Invalidate the nominal speeds kept in the blocks.
+        ovr.generation = 1;
+
+    PLANNER_LOCK(true);
+    plan_update_velocity_profile_parameters();
+    plan_cycle_reinitialize();
+    PLANNER_LOCK(false);
+}
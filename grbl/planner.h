@@ -28,24 +28,65 @@
   #define BLOCK_BUFFER_SIZE 36
 #endif
 
+#ifndef PLANNER_OVERRIDE_REPLAN_INTERVAL
+  #define PLANNER_OVERRIDE_REPLAN_INTERVAL 20 // ms
+#endif
+
+#ifdef ENABLE_FEED_ADAPTATION
+#ifndef FEED_ADAPT_LOW_TIME
+  #define FEED_ADAPT_LOW_TIME 500 // ms of planned motion below which the feed rate is lowered
+#endif
+#ifndef FEED_ADAPT_MIN
+  #define FEED_ADAPT_MIN 50 // percent
+#endif
+#ifndef FEED_ADAPT_STEP
+  #define FEED_ADAPT_STEP 5 // percent per FEED_ADAPT_INTERVAL
+#endif
+#ifndef FEED_ADAPT_INTERVAL
+  #define FEED_ADAPT_INTERVAL 100 // ms
+#endif
+#endif
+
 typedef union {
     uint32_t value;
     struct {
         uint16_t rapid_motion         :1,
                  system_motion        :1,
                  jog_motion           :1,
-                 backlash_motion      :1,
                  no_feed_override     :1,
                  inverse_time         :1,
                  is_rpm_rate_adjusted :1,
                  is_rpm_pos_adjusted  :1,
                  is_laser_ppi_mode    :1,
-                 unassigned           :7;
+                 arc_motion           :1,
+                 wait_on_input        :1, // First block after an M66 barrier, starts from rest when the barrier is resolved.
+                 exact_stop           :1, // G61.1, block starts from rest.
+                 coolant_sync         :1, // Coolant state changed by the parser, set when the block starts.
+                 feed_per_rev         :1, // G95, rate is per revolution of the programmed RPM, tracked against the measured RPM.
+                 unassigned           :3;
         spindle_state_t spindle;
         coolant_state_t coolant;
     };
 } planner_cond_t;
 
+#ifdef ENABLE_NATIVE_ARCS
+// Geometry of a native arc block, the segment generator computes the chord end points from it.
+typedef struct {
+    uint_fast8_t axis_0;            // Plane axes, the arc is CCW from axis_0 towards axis_1 for positive angular travel
+    uint_fast8_t axis_1;
+    float center[2];                // Arc center in the plane (mm)
+    float r[2];                     // Radius vector from the center to the start point (mm)
+    float radius;                   // (mm)
+    float angular_travel;           // Signed angular travel, positive for CCW arcs (radians)
+    float length;                   // Length of the helical path (mm)
+    float max_chord;                // Longest chord within the arc tolerance (mm)
+    float start[N_AXIS];            // Start position of the linearly interpolated axes (mm)
+    float delta[N_AXIS];            // Travel of the linearly interpolated axes, 0 for the plane axes (mm)
+    int32_t start_steps[N_AXIS];    // Start position in absolute steps. Set by the planner.
+    int32_t target_steps[N_AXIS];   // Target position in absolute steps. Set by the planner.
+} plan_arc_t;
+#endif
+
 // This struct stores a linear movement of a g-code block motion with its critical "nominal" values
 // are as specified in the source g-code.
 typedef struct plan_block {
@@ -54,6 +95,9 @@ typedef struct plan_block {
     uint32_t steps[N_AXIS];         // Step count along each axis
     uint32_t step_event_count;      // The maximum step axis count and number of steps required to complete this block.
     axes_signals_t direction_bits;  // The direction bit set for this block (refers to *_DIRECTION_BIT in config.h)
+#ifdef ENABLE_BACKLASH_COMPENSATION
+    uint32_t backlash_steps[N_AXIS]; // Steps taking up backlash, executed ahead of steps[]
+#endif
 
     // Block condition data to ensure correct execution depending on states and overrides.
     planner_cond_t condition;       // Block bitfield variable defining block run conditions. Copied from pl_line_data.
@@ -63,22 +107,50 @@ typedef struct plan_block {
     // Fields used by the motion planner to manage acceleration. Some of these values may be updated
     // by the stepper module during execution of special motion cases for replanning purposes.
     float entry_speed_sqr;      // The current planned entry speed at block junction in (mm/min)^2
+#ifndef PLANNER_SOA
     float max_entry_speed_sqr;  // Maximum allowable entry speed based on the minimum of junction limit and
                                 // neighboring nominal speeds with overrides in (mm/min)^2
+#endif
     float acceleration;         // Axis-limit adjusted line acceleration in (mm/min^2). Does not change.
+#if defined(ENABLE_JERK_ACCELERATION) || defined(ENABLE_INPUT_SHAPING)
+    float max_acceleration;     // Axis-limit adjusted peak line acceleration in (mm/min^2). Does not change.
+#endif
+#ifdef ENABLE_JERK_ACCELERATION
+    float jerk;                 // Axis-limit adjusted line jerk in (mm/min^3). Does not change.
+#endif
+#ifdef ENABLE_INPUT_SHAPING
+    float shaper_period[2];     // Damped periods of the input shapers applied to the ramps, 0 if not used (min). Does not change.
+#endif
     float millimeters;          // The remaining distance for this block to be executed in (mm).
                                 // NOTE: This value may be altered by stepper algorithm during execution.
 
+    // Values precomputed for the segment generator, avoids divisions when the block is loaded for execution.
+    float steps_per_mm;         // Step events per mm, step_event_count / initial millimeters. Does not change.
+    float req_mm_increment;     // Min distance to generate a step segment, REQ_MM_INCREMENT_SCALAR steps (mm). Does not change.
+    float inv_2_accel;          // 0.5 / acceleration (min^2/mm). Does not change.
+    float inv_feedrate;         // Inverse programmed rate, only set for RPM rate adjusted (laser) motions (min/mm).
+
     // Stored rate limiting data used by planner when changes occur.
     float max_junction_speed_sqr; // Junction entry speed limit based on direction vectors in (mm/min)^2
     float rapid_rate;             // Axis-limit adjusted maximum rate for this block direction in (mm/min)
     float programmed_rate;        // Programmed rate of this block (mm/min).
+    float nominal_speed;          // Nominal speed with overrides applied, valid for override_generation (mm/min).
+    uint8_t override_generation;  // Override generation nominal_speed was computed for, 0 if not computed.
 
     // Stored spindle speed data used by spindle overrides and resuming methods.
     spindle_t spindle;    // Block spindle speed. Copied from pl_line_data.
 
     char *message;                // Message to be displayed when block is executed.
     output_command_t *output_commands;
+#ifdef ENABLE_WCO_MOTION_SYNC
+    float *wco;                   // Work coordinate offset to be reported from the start of the block, NULL if not changed.
+#endif
+#ifdef ENABLE_RASTER_ROWS
+    raster_row_t *raster;         // Pixel power values, set the laser power along the block when not NULL.
+#endif
+#ifdef ENABLE_NATIVE_ARCS
+    plan_arc_t arc;               // Arc geometry, only valid if condition.arc_motion is set.
+#endif
     struct plan_block *prev, *next; // Linked list pointers, DO NOT MOVE - these MUST be the last elements in the struct!
 } plan_block_t;
 
@@ -93,6 +165,20 @@ typedef struct {
 //    void *parameters;               // TODO: pointer to extra parameters, for canned cycles and threading?
     char *message;                  // Message to be displayed when block is executed.
     output_command_t *output_commands;
+#ifdef ENABLE_RASTER_ROWS
+    raster_row_t *raster;           // Pixel power values for a raster row, NULL for a normal move.
+#endif
+#ifdef ENABLE_NATIVE_ARCS
+    plan_arc_t *arc;                // Arc geometry for a native arc move, NULL for a line. Copied to the block.
+#endif
+#ifdef ENABLE_PATH_BLENDING
+    float path_tolerance;           // Max deviation from the programmed corner when blending, 0 for exact path (mm).
+#else
+    float junction_deviation;       // Junction deviation for the corner at the start of the line, 0 for the setting ($11) value (mm).
+#endif
+#ifdef ENABLE_SEGMENT_COALESCING
+    bool coalesce;                  // Line may be merged with adjacent lines within the coalescing tolerance.
+#endif
 } plan_line_data_t;
 
 
@@ -102,7 +188,13 @@ typedef struct {
                                     // from g-code position for movements requiring multiple line motions,
                                     // i.e. arcs, canned cycles, and backlash compensation.
   float previous_unit_vec[N_AXIS];  // Unit vector of previous path line segment
+#ifdef KINEMATICS_API
+  float previous_motor_vec[N_AXIS]; // Motor travel per mm along the previous path line segment
+#endif
   float previous_nominal_speed;     // Nominal speed of previous path line segment
+#ifdef ENABLE_SPINDLE_RPM_QUEUE
+  float previous_rpm;               // Spindle RPM of previous path line segment, 0 if the spindle is off
+#endif
 } planner_t;
 
 // Initialize and reset the motion plan subsystem
@@ -114,6 +206,11 @@ void plan_reset(); // Reset all
 // rate is taken to mean "frequency" and would complete the operation in 1/feed_rate minutes.
 bool plan_buffer_line(float *target, plan_line_data_t *pl_data);
 
+#ifdef ENABLE_NATIVE_ARCS
+// Returns true if the arc passes the angle (radians) measured from the first plane axis.
+bool plan_arc_crosses_angle(plan_arc_t *arc, float angle);
+#endif
+
 // Called when the current block is no longer needed. Discards the block and makes the memory
 // availible for new blocks.
 void plan_discard_current_block();
@@ -127,6 +224,9 @@ plan_block_t *plan_get_current_block();
 // Called by step segment buffer when computing executing block velocity profile.
 float plan_get_exec_block_exit_speed_sqr();
 
+// Gets the maximum allowable entry speed of a buffered block, the field is compiled out when PLANNER_SOA is defined.
+float plan_get_max_entry_speed_sqr (plan_block_t *block);
+
 // Called by main program during planner calculations and step segment buffer during initialization.
 float plan_compute_profile_nominal_speed(plan_block_t *block);
 
@@ -140,12 +240,52 @@ void plan_sync_position();
 void plan_cycle_reinitialize();
 
 // Returns the number of available blocks in the planner buffer.
-uint8_t plan_get_block_buffer_available();
+uint_fast16_t plan_get_block_buffer_available();
+
+// Returns the number of blocks that can be queued in the planner buffer.
+uint_fast16_t plan_get_block_buffer_size();
 
 // Returns the status of the block ring buffer. True, if buffer is full.
 bool plan_check_full_buffer();
 
 void plan_get_planner_mpos(float *target);
+
+#if defined(ENABLE_AUTO_CYCLE_START_DELAY) || defined(ENABLE_FEED_ADAPTATION)
+// Returns an estimate of the execution time of the buffered blocks in ms, counting stops at limit.
+uint32_t plan_get_planned_time (uint32_t limit);
+#endif
+
+#ifdef ENABLE_FEED_ADAPTATION
+// Adapts the feed rate to the planner buffer fill, called from the realtime loop. Set streaming false
+// when no more input is expected before the buffer has been executed, e.g. on buffer sync.
+void plan_feed_adapt (bool streaming);
+#endif
 void plan_feed_override (uint_fast8_t feed_override, uint_fast8_t rapid_override);
 
+// Replans the buffered motions for pending feed and rapid override changes, called from the realtime loop.
+void plan_apply_overrides (void);
+
+#ifdef ENABLE_BACKLASH_COMPENSATION
+// Initializes backlash compensation from settings, the axes are assumed to have last moved away from home.
+void plan_backlash_init (void);
+
+// Returns the axes with backlash compensation enabled.
+axes_signals_t plan_get_backlash_axes (void);
+#endif
+
+#ifdef ENABLE_INPUT_SHAPING
+// Input shaper impulses for a damped period of 1, a block shaper is scaled by the block shaper_period.
+typedef struct {
+    uint_fast8_t n_impulses;
+    float amplitude[3];     // Impulse amplitudes, sum to 1.
+    float time[3];          // Impulse times as fractions of the damped period.
+} plan_shaper_t;
+
+// Computes the shaper impulses from the shaper type and damping ratio settings.
+void plan_shaper_init (void);
+
+// Returns the shaper impulses for a damped period of 1.
+const plan_shaper_t *plan_get_shaper (void);
+#endif
+
 #endif
@@ -0,0 +1,179 @@
+/*
+  pool.c - fixed block pools for data queued along with motion (output commands and messages)
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+/*
+  Output commands and messages are attached to planner blocks by the parser, handed over to the
+  stepper blocks by the segment generator and consumed by the stepper ISR. Allocating them from
+  the heap adds unbounded latency to the ISR and fragments the heap on small MCUs, so they are
+  borrowed from statically sized pools instead.
+
+  Each entry has an "allocated" flag. Only the foreground process allocates, by scanning for a
+  cleared flag from where the last allocation ended. Release only clears the flag, this is an
+  atomic store that may be performed from any context without locking. Since entries are
+  normally released in the same order as they are allocated the scan is O(1) amortized.
+  Raster rows are not handed over, these are released when the planner block is discarded.
+*/
+
+typedef char message_t[MESSAGE_POOL_LENGTH];
+
+static output_command_t output_command_pool[OUTPUT_COMMAND_POOL_SIZE];
+static volatile bool output_command_allocated[OUTPUT_COMMAND_POOL_SIZE];
+static uint_fast8_t output_command_next = 0;
+
+static message_t message_pool[MESSAGE_POOL_SIZE];
+static volatile bool message_allocated[MESSAGE_POOL_SIZE];
+static uint_fast8_t message_next = 0;
+
+#ifdef ENABLE_WCO_MOTION_SYNC
+typedef float wco_t[N_AXIS];
+
+static wco_t wco_pool[WCO_POOL_SIZE];
+static volatile bool wco_allocated[WCO_POOL_SIZE];
+static uint_fast8_t wco_next = 0;
+#endif
+
+#ifdef ENABLE_RASTER_ROWS
+static raster_row_t raster_row_pool[RASTER_ROW_POOL_SIZE];
+static volatile bool raster_row_allocated[RASTER_ROW_POOL_SIZE];
+static uint_fast8_t raster_row_next = 0;
+#endif
+
+output_command_t *pool_output_command_get (output_command_t *command)
+{
+    output_command_t *cmd = NULL;
+    uint_fast8_t idx = output_command_next, count = OUTPUT_COMMAND_POOL_SIZE;
+
+    do {
+        if(!output_command_allocated[idx]) {
+            cmd = &output_command_pool[idx];
+            memcpy(cmd, command, sizeof(output_command_t));
+            cmd->next = NULL;
+            output_command_allocated[idx] = true;
+        }
+        if(++idx == OUTPUT_COMMAND_POOL_SIZE)
+            idx = 0;
+    } while(cmd == NULL && --count);
+
+    output_command_next = idx;
+
+    return cmd;
+}
+
+ISR_CODE void pool_output_command_release (output_command_t *command)
+{
+    output_command_allocated[command - output_command_pool] = false;
+}
+
+void pool_output_commands_release (output_command_t *commands)
+{
+    output_command_t *next;
+
+    while(commands) {
+        next = commands->next;
+        pool_output_command_release(commands);
+        commands = next;
+    }
+}
+
+char *pool_message_get (const char *message)
+{
+    char *msg = NULL;
+    uint_fast8_t idx = message_next, count = MESSAGE_POOL_SIZE;
+
+    do {
+        if(!message_allocated[idx]) {
+            msg = message_pool[idx];
+            strncpy(msg, message, MESSAGE_POOL_LENGTH - 1);
+            msg[MESSAGE_POOL_LENGTH - 1] = '\0';
+            message_allocated[idx] = true;
+        }
+        if(++idx == MESSAGE_POOL_SIZE)
+            idx = 0;
+    } while(msg == NULL && --count);
+
+    message_next = idx;
+
+    return msg;
+}
+
+ISR_CODE void pool_message_release (char *message)
+{
+    message_allocated[(message_t *)message - message_pool] = false;
+}
+
+#ifdef ENABLE_WCO_MOTION_SYNC
+
+float *pool_wco_get (float *wco)
+{
+    float *entry = NULL;
+    uint_fast8_t idx = wco_next, count = WCO_POOL_SIZE;
+
+    do {
+        if(!wco_allocated[idx]) {
+            entry = wco_pool[idx];
+            memcpy(entry, wco, sizeof(wco_t));
+            wco_allocated[idx] = true;
+        }
+        if(++idx == WCO_POOL_SIZE)
+            idx = 0;
+    } while(entry == NULL && --count);
+
+    wco_next = idx;
+
+    return entry;
+}
+
+ISR_CODE void pool_wco_release (float *wco)
+{
+    wco_allocated[(wco_t *)wco - wco_pool] = false;
+}
+
+#endif
+
+#ifdef ENABLE_RASTER_ROWS
+
+raster_row_t *pool_raster_row_get (void)
+{
+    raster_row_t *row = NULL;
+    uint_fast8_t idx = raster_row_next, count = RASTER_ROW_POOL_SIZE;
+
+    do {
+        if(!raster_row_allocated[idx]) {
+            row = &raster_row_pool[idx];
+            row->n_pixels = 0;
+            raster_row_allocated[idx] = true;
+        }
+        if(++idx == RASTER_ROW_POOL_SIZE)
+            idx = 0;
+    } while(row == NULL && --count);
+
+    raster_row_next = idx;
+
+    return row;
+}
+
+ISR_CODE void pool_raster_row_release (raster_row_t *row)
+{
+    raster_row_allocated[row - raster_row_pool] = false;
+}
+
+#endif
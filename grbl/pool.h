@@ -0,0 +1,107 @@
+/*
+  pool.h - fixed block pools for data queued along with motion (output commands and messages)
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+// Number of output commands (M62 - M68) that can be queued with motion at any given time.
+// NOTE: The parser waits for an output command to be executed when the pool is exhausted.
+#ifndef OUTPUT_COMMAND_POOL_SIZE
+  #ifdef SMALL_RAM_TARGET
+    #define OUTPUT_COMMAND_POOL_SIZE 4
+  #else
+    #define OUTPUT_COMMAND_POOL_SIZE 8
+  #endif
+#endif
+
+// Number of messages that can be queued with motion at any given time and the max message length.
+// Queued messages longer than MESSAGE_POOL_LENGTH - 1 characters will be truncated.
+// NOTE: The parser waits for a message to be displayed when the pool is exhausted.
+#ifndef MESSAGE_POOL_SIZE
+  #ifdef SMALL_RAM_TARGET
+    #define MESSAGE_POOL_SIZE 2
+  #else
+    #define MESSAGE_POOL_SIZE 4
+  #endif
+#endif
+#ifndef MESSAGE_POOL_LENGTH
+  #define MESSAGE_POOL_LENGTH 64
+#endif
+
+#ifdef ENABLE_WCO_MOTION_SYNC
+// Number of work coordinate offset changes that can be queued with motion at any given time, one is in use for reporting.
+#ifndef WCO_POOL_SIZE
+  #ifdef SMALL_RAM_TARGET
+    #define WCO_POOL_SIZE 2
+  #else
+    #define WCO_POOL_SIZE 4
+  #endif
+#endif
+#endif
+
+// Gets a free output command and copies the command into it, returns NULL if the pool is exhausted.
+// NOTE: Must only be called from the foreground process.
+output_command_t *pool_output_command_get (output_command_t *command);
+
+// Returns an output command to the pool. O(1), safe to call from interrupt context.
+void pool_output_command_release (output_command_t *command);
+
+// Returns a linked list of output commands to the pool.
+void pool_output_commands_release (output_command_t *commands);
+
+// Gets a free message and copies the string into it, returns NULL if the pool is exhausted.
+// NOTE: Must only be called from the foreground process.
+char *pool_message_get (const char *message);
+
+// Returns a message to the pool. O(1), safe to call from interrupt context.
+void pool_message_release (char *message);
+
+#ifdef ENABLE_WCO_MOTION_SYNC
+
+// Gets a free work coordinate offset entry and copies the N_AXIS offsets into it, returns NULL if the pool is exhausted.
+// NOTE: Must only be called from the foreground process.
+float *pool_wco_get (float *wco);
+
+// Returns a work coordinate offset entry to the pool. O(1), safe to call from interrupt context.
+void pool_wco_release (float *wco);
+
+#endif
+
+#ifdef ENABLE_RASTER_ROWS
+
+// Number of raster rows that can be queued with motion at any given time.
+#ifndef RASTER_ROW_POOL_SIZE
+  #ifdef SMALL_RAM_TARGET
+    #define RASTER_ROW_POOL_SIZE 2
+  #else
+    #define RASTER_ROW_POOL_SIZE 4
+  #endif
+#endif
+
+// Gets a free raster row, returns NULL if the pool is exhausted.
+// NOTE: Must only be called from the foreground process.
+raster_row_t *pool_raster_row_get (void);
+
+// Returns a raster row to the pool. O(1), safe to call from interrupt context.
+void pool_raster_row_release (raster_row_t *row);
+
+#endif
+
+#endif
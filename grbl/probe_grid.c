@@ -0,0 +1,220 @@
+/*
+  probe_grid.c - controller-side probing of a grid of points for surface mapping
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "grbl.h"
+
+#ifdef ENABLE_PROBE_GRID
+
+/*
+  $PGRID=<X>,<Y>,<X spacing>,<Y spacing>,<X points>,<Y points>,<clearance Z>,<probe Z>,<feed rate>
+
+  probes the grid without host interaction. Positions are in work coordinates and, as the feed rate, in the
+  current units. For each point the probe is retracted to the clearance height and moved to the point by rapid
+  motions chained in the planner, then G38.2 style probing toward the probe Z position is performed. Rows are
+  probed in alternating directions. The probe is left at the clearance height above the last point.
+
+  The probe position captured for each point is stored in RAM in machine coordinates. $PGRID outputs the grid:
+
+    [PGRID:<X points>,<Y points>,<X>,<Y>,<X spacing>,<Y spacing>]
+    [PGR:<row>:<Z>,<Z>,...]  one line per row
+
+  in machine coordinates and mm, $PGRID=0 clears it. The grid is also cleared when a new one is started and
+  is kept only if all points were probed.
+*/
+
+#define PROBE_GRID_ARGS 9
+
+static probe_grid_t grid = {0};
+
+probe_grid_t *probe_grid_get (void)
+{
+    return grid.valid ? &grid : NULL;
+}
+
+static void probe_grid_clear (void)
+{
+    grid.valid = false;
+#ifdef ENABLE_HEIGHT_MAP
+    height_map_invalidate();
+#endif
+}
+
+static void probe_grid_report (void)
+{
+    uint_fast16_t x, y;
+    float *z = grid.z;
+
+    hal.stream.write("[PGRID:");
+    hal.stream.write(uitoa(grid.valid ? grid.n_points[X_AXIS] : 0));
+    hal.stream.write(",");
+    hal.stream.write(uitoa(grid.valid ? grid.n_points[Y_AXIS] : 0));
+    hal.stream.write(",");
+    hal.stream.write(ftoa(grid.origin[X_AXIS], N_DECIMAL_COORDVALUE_MM));
+    hal.stream.write(",");
+    hal.stream.write(ftoa(grid.origin[Y_AXIS], N_DECIMAL_COORDVALUE_MM));
+    hal.stream.write(",");
+    hal.stream.write(ftoa(grid.spacing[X_AXIS], N_DECIMAL_COORDVALUE_MM));
+    hal.stream.write(",");
+    hal.stream.write(ftoa(grid.spacing[Y_AXIS], N_DECIMAL_COORDVALUE_MM));
+    hal.stream.write("]" ASCII_EOL);
+
+    if(grid.valid) for(y = 0; y < grid.n_points[Y_AXIS]; y++) {
+        hal.stream.write("[PGR:");
+        hal.stream.write(uitoa(y));
+        for(x = 0; x < grid.n_points[X_AXIS]; x++) {
+            hal.stream.write(x == 0 ? ":" : ",");
+            hal.stream.write(ftoa(*z++, N_DECIMAL_COORDVALUE_MM));
+        }
+        hal.stream.write("]" ASCII_EOL);
+    }
+}
+
+// Moves to the clearance height and then to the XY position, rapid motions queued back to back.
+static bool probe_grid_traverse (float *target, float clearance)
+{
+    plan_line_data_t plan_data;
+    float position[N_AXIS];
+
+    memset(&plan_data, 0, sizeof(plan_line_data_t));
+    plan_data.condition.rapid_motion = On;
+
+    system_convert_array_steps_to_mpos(position, sys_position);
+
+    position[Z_AXIS] = clearance;
+    if(!mc_line(position, &plan_data))
+        return false;
+
+    memcpy(position, target, sizeof(position));
+    position[Z_AXIS] = clearance;
+
+    return mc_line(position, &plan_data);
+}
+
+static status_code_t probe_grid_run (float *args)
+{
+    uint_fast8_t idx;
+    uint_fast16_t x, y, point;
+    float target[N_AXIS], clearance, depth, feed_rate, scale = gc_state.modal.units_imperial ? MM_PER_INCH : 1.0f;
+    plan_line_data_t plan_data;
+    gc_parser_flags_t parser_flags = {0};
+
+    if(!(isintf(args[4]) && isintf(args[5]) && args[4] >= 1.0f && args[5] >= 1.0f))
+        return Status_InvalidStatement;
+
+    if(args[4] * args[5] > (float)PROBE_GRID_MAX_POINTS)
+        return Status_Overflow;
+
+    if(args[2] <= 0.0f || args[3] <= 0.0f || args[8] <= 0.0f)
+        return Status_NonPositiveValue;
+
+    if(args[7] >= args[6])
+        return Status_GcodeInvalidTarget; // Probe Z must be below the clearance height
+
+    for(idx = 0; idx < PROBE_GRID_ARGS; idx++) {
+        if(idx != 4 && idx != 5)
+            args[idx] *= scale;
+    }
+
+    probe_grid_clear();
+    grid.n_points[X_AXIS] = (uint_fast16_t)args[4];
+    grid.n_points[Y_AXIS] = (uint_fast16_t)args[5];
+    grid.origin[X_AXIS] = args[0] + gc_get_offset(X_AXIS);
+    grid.origin[Y_AXIS] = args[1] + gc_get_offset(Y_AXIS);
+    grid.spacing[X_AXIS] = args[2];
+    grid.spacing[Y_AXIS] = args[3];
+    clearance = args[6] + gc_get_offset(Z_AXIS);
+    depth = args[7] + gc_get_offset(Z_AXIS);
+    feed_rate = args[8];
+
+    memset(&plan_data, 0, sizeof(plan_line_data_t));
+    plan_data.feed_rate = feed_rate;
+    plan_data.condition.no_feed_override = !settings.flags.allow_probing_feed_override;
+
+    system_convert_array_steps_to_mpos(target, sys_position);
+
+    for(y = 0; y < grid.n_points[Y_AXIS]; y++) {
+
+        for(point = 0; point < grid.n_points[X_AXIS]; point++) {
+
+            x = y & 1 ? grid.n_points[X_AXIS] - 1 - point : point;
+
+            target[X_AXIS] = grid.origin[X_AXIS] + (float)x * grid.spacing[X_AXIS];
+            target[Y_AXIS] = grid.origin[Y_AXIS] + (float)y * grid.spacing[Y_AXIS];
+
+            if(!probe_grid_traverse(target, clearance))
+                return Status_Unhandled;
+
+            // mc_probe_cycle() executes the queued traverse motions before probing.
+            target[Z_AXIS] = depth;
+            if(mc_probe_cycle(target, &plan_data, parser_flags, NULL) != GCProbe_Found)
+                return Status_Unhandled; // Alarm is raised on failure
+
+            system_convert_array_steps_to_mpos(target, sys_probe_position);
+            grid.z[y * grid.n_points[X_AXIS] + x] = target[Z_AXIS];
+        }
+    }
+
+    target[Z_AXIS] = clearance;
+    if(!(probe_grid_traverse(target, clearance) && protocol_buffer_synchronize()))
+        return Status_Unhandled;
+
+    grid.valid = true;
+
+    return Status_OK;
+}
+
+status_code_t probe_grid_command (char *args)
+{
+    status_code_t retval = Status_OK;
+
+    if(*args == '\0')
+        probe_grid_report();
+    else if(!strcmp(args, "=0"))
+        probe_grid_clear();
+    else if(*args++ != '=')
+        retval = Status_InvalidStatement;
+    else if(sys.state != STATE_IDLE)
+        retval = Status_IdleError;
+    else {
+
+        uint_fast8_t idx = 0, counter = 0;
+        float values[PROBE_GRID_ARGS];
+
+        do {
+            if(!read_float(args, &counter, &values[idx]))
+                return Status_BadNumberFormat;
+        } while(++idx < PROBE_GRID_ARGS && args[counter++] == ',');
+
+        if(idx != PROBE_GRID_ARGS || args[counter] != '\0')
+            return Status_InvalidStatement;
+
+        if((retval = probe_grid_run(values)) == Status_Unhandled)
+            retval = Status_OK; // Alarm raised or aborted, already reported.
+
+        // Sync parser position to where the probe was left.
+        gc_sync_position();
+    }
+
+    return retval;
+}
+
+#endif
@@ -0,0 +1,47 @@
+/*
+  probe_grid.h - controller-side probing of a grid of points for surface mapping
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _PROBE_GRID_H_
+#define _PROBE_GRID_H_
+
+#ifdef ENABLE_PROBE_GRID
+
+// Maximum number of grid points, each point takes 4 bytes of RAM.
+#ifndef PROBE_GRID_MAX_POINTS
+  #define PROBE_GRID_MAX_POINTS 400
+#endif
+
+typedef struct {
+    bool valid;                         // Set when all points have been probed
+    uint_fast16_t n_points[2];          // Number of points along X and Y
+    float origin[2];                    // Machine position of the first point (mm)
+    float spacing[2];                   // Distance between points along X and Y (mm)
+    float z[PROBE_GRID_MAX_POINTS];     // Probed machine Z positions (mm), rows along X
+} probe_grid_t;
+
+// Returns the probed grid, NULL if no complete grid is available.
+probe_grid_t *probe_grid_get (void);
+
+// Handles $PGRID=..., $PGRID and $PGRID=0, probes the grid, outputs or clears the results.
+status_code_t probe_grid_command (char *args);
+
+#endif
+
+#endif
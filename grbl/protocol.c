@@ -34,6 +34,17 @@ typedef union {
     };
 } line_flags_t;
 
+// Character classes used by the line builder, see char_class[] below.
+typedef enum {
+    CharClass_Text = 0, // Added to the line as is
+    CharClass_Lower,    // Lower case letter, upper cased unless in a system or user command
+    CharClass_Space,    // Removed unless in a system or user command
+    CharClass_Control,  // Control character, always removed
+    CharClass_EOL,      // CR or LF
+    CharClass_Cancel,   // ASCII_CAN
+    CharClass_Special   // '/', '$', '[', '(' and ';', start of block delete, command or comment
+} char_class_t;
+
 typedef struct {
     char *message;
     uint_fast8_t idx;
@@ -46,8 +57,164 @@ static char line[LINE_BUFFER_SIZE]; // Line to be executed. Zero-terminated.
 static char xcommand[LINE_BUFFER_SIZE];
 static bool keep_rt_commands = false;
 static user_message_t user_message = {NULL, 0, 0, false};
-static const char *msg = "(MSG,";
+static const char msg[] = "(MSG,";
+static char rx_block[PROTOCOL_READ_BLOCK_SIZE];
+#ifdef ENABLE_FEED_ADAPTATION
+static bool synchronizing = false; // No more input is read until the buffer has been executed.
+#endif
+
+#ifdef ENABLE_LINE_CHECKSUM
+
+static struct {
+    uint8_t sum;            // XOR of the characters received for the line.
+    uint8_t star_sum;       // XOR of the characters before the last '*'.
+    int_fast16_t star_pos;  // Position in line of the last '*', -1 if none or not followed by digits only.
+    uint_fast16_t value;    // Checksum received after the last '*'.
+    uint_fast8_t digits;
+    bool sequenced;         // A numbered line has been accepted since reset.
+    uint32_t expected;      // Line number of the next numbered line.
+} cksum;
+
+static void checksum_reset (void)
+{
+    cksum.sum = 0;
+    cksum.star_pos = -1;
+}
+
+// Adds a character, not end of line, to the checksum. The checksum is the digits after the last '*' in the line,
+// expressions may contain '*' as well.
+inline static void checksum_add (char c)
+{
+    if(c == '*') {
+        cksum.star_sum = cksum.sum;
+        cksum.star_pos = char_counter;
+        cksum.value = cksum.digits = 0;
+    } else if(cksum.star_pos >= 0) {
+        if(c >= '0' && c <= '9' && cksum.digits < 3) {
+            cksum.value = cksum.value * 10 + c - '0';
+            cksum.digits++;
+        } else if(c != ' ')
+            cksum.star_pos = -1;
+    }
+
+    cksum.sum ^= (uint8_t)c;
+}
+
+// Parses the line number at s, returns a pointer to the character following its digits.
+static char *line_number (char *s, uint32_t *number)
+{
+    *number = 0;
+
+    while(*s >= '0' && *s <= '9')
+        *number = *number * 10 + *s++ - '0';
+
+    return s;
+}
+
+// Returns true if the block at s is M110, the line number is then set to that of its N word if present.
+static bool line_number_set (char *s, uint32_t *number)
+{
+    uint32_t n;
+    bool ok;
+
+    if((ok = !strncmp(s, "M110", 4) && (s[4] == '\0' || s[4] == 'N')) && s[4] == 'N' && (ok = *line_number(&s[5], &n) == '\0'))
+        *number = n;
+
+    return ok;
+}
+
+// Validates the line number and checksum of a line ending with *<checksum> and strips the checksum.
+// The sequence is restarted by M110 [N<n>], by a line numbered 0 or 1 and at program end by M2 or M30.
+// Returns Status_OK if the line is to be executed, Status_Unhandled if it is to be acknowledged only.
+static status_code_t checksum_validate (void)
+{
+    status_code_t status = Status_OK;
+
+    if(cksum.star_pos >= 0 && cksum.digits) {
+
+        uint32_t number = 0;
+        char *s = line[0] == '/' ? &line[1] : line, *n = s + 1; // Skip block delete.
+
+        line[cksum.star_pos] = '\0';
+
+        if(*s == 'N')
+            n = line_number(n, &number);
+
+        if(n == s + 1 || cksum.value != cksum.star_sum)
+            status = Status_LineChecksum;
+        else if(line_number_set(n, &number)) {
+            status = Status_Unhandled;
+            cksum.sequenced = true;
+            cksum.expected = number + 1;
+        } else if(cksum.sequenced && number != cksum.expected && !(number <= 1 && cksum.expected > 2))
+            status = number < cksum.expected ? Status_Unhandled : Status_LineSequence;
+        else {
+            cksum.sequenced = true;
+            cksum.expected = number + 1;
+        }
+
+        if(status == Status_LineChecksum || status == Status_LineSequence)
+            report_line_resend(cksum.sequenced ? cksum.expected : number);
+
+    } else if(line_number_set(line, &cksum.expected)) {
+        status = Status_Unhandled;
+        if((cksum.sequenced = line[4] == 'N'))
+            cksum.expected++;
+    }
+
+    checksum_reset();
+
+    return status;
+}
+
+// Restarts the line number sequence, the next numbered line starts a new sequence. Called at program end.
+void protocol_line_sequence_reset (void)
+{
+    cksum.sequenced = false;
+}
+
+#endif
+
+// Classifies incoming characters for the line builder with a single lookup.
+#define TX CharClass_Text
+#define LC CharClass_Lower
+#define SP CharClass_Space
+#define CT CharClass_Control
+#define EL CharClass_EOL
+#define CA CharClass_Cancel
+#define SC CharClass_Special
+
+static const uint8_t char_class[256] = {
+    CT, CT, CT, CT, CT, CT, CT, CT, CT, CT, EL, CT, CT, EL, CT, CT, // 0x00
+    CT, CT, CT, CT, CT, CT, CT, CT, CA, CT, CT, CT, CT, CT, CT, CT, // 0x10
+    SP, TX, TX, TX, SC, TX, TX, TX, SC, TX, TX, TX, TX, TX, TX, SC, // 0x20
+    TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, SC, TX, TX, TX, TX, // 0x30
+    TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, // 0x40
+    TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, SC, TX, TX, TX, TX, // 0x50
+    TX, LC, LC, LC, LC, LC, LC, LC, LC, LC, LC, LC, LC, LC, LC, LC, // 0x60
+    LC, LC, LC, LC, LC, LC, LC, LC, LC, LC, LC, TX, TX, TX, TX, TX, // 0x70
+    TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, // 0x80
+    TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, // 0x90
+    TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, // 0xA0
+    TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, // 0xB0
+    TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, // 0xC0
+    TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, // 0xD0
+    TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, // 0xE0
+    TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX, TX  // 0xF0
+};
+
+#undef TX
+#undef LC
+#undef SP
+#undef CT
+#undef EL
+#undef CA
+#undef SC
+
 static void protocol_exec_rt_suspend();
+#ifdef ENABLE_AUTO_CYCLE_START_DELAY
+static void auto_cycle_start_delayed (void);
+#endif
 
 // add gcode to execute not originating from normal input stream
 bool protocol_enqueue_gcode (char *gcode)
@@ -56,6 +223,11 @@ bool protocol_enqueue_gcode (char *gcode)
                (sys.state == STATE_IDLE || (sys.state & (STATE_JOG|STATE_TOOL_CHANGE))) &&
                  bit_isfalse(sys_rt_exec_state, EXEC_MOTION_CANCEL);
 
+#ifdef ENABLE_HOLD_JOG
+    if(!ok && xcommand[0] == '\0' && state_hold_jog_ready())
+        ok = !strncmp((char *)gcode, "$J=", 3); // Jogs are executed from the suspend loop.
+#endif
+
     if(ok && gc_state.file_run)
         ok = gc_state.modal.program_flow != ProgramFlow_Running || strncmp((char *)gcode, "$J=", 3);
 
@@ -65,6 +237,22 @@ bool protocol_enqueue_gcode (char *gcode)
     return ok;
 }
 
+// Reads up to max characters from the input stream, ends after the first CR or LF.
+// Used when the stream does not provide a read_block() function.
+static uint16_t stream_read_block (char *buffer, uint16_t max)
+{
+    int16_t c;
+    uint16_t count = 0;
+
+    while(count < max && (c = hal.stream.read()) != SERIAL_NO_DATA) {
+        buffer[count++] = (char)c;
+        if(c == ASCII_LF || c == ASCII_CR)
+            break;
+    }
+
+    return count;
+}
+
 /*
   GRBL PRIMARY LOOP:
 */
@@ -117,152 +305,265 @@ bool protocol_main_loop(bool cold_start)
     // This is also where Grbl idles while waiting for something to do.
     // ---------------------------------------------------------------------------------
 
-    int16_t c;
-    char eol = '\0';
+    char c, eol = '\0';
+    uint_fast8_t cclass;
+    uint16_t idx, count;
     line_flags_t line_flags = {0};
     bool nocaps = false;
+#ifdef ENABLE_IDLE_WAIT
+    bool idle;
+#endif
 
     xcommand[0] = '\0';
     user_message.show = keep_rt_commands = false;
 
+#ifdef ENABLE_BINARY_STREAM
+    binary_stream_enable(false);
+#endif
+#ifdef ENABLE_LOOKAHEAD
+    lookahead_reset();
+#endif
+#ifdef ENABLE_CHUNKED_REPORTS
+    report_chunk_reset();
+#endif
+#ifdef ENABLE_LINE_CHECKSUM
+    checksum_reset();
+    cksum.sequenced = false;
+#endif
+
     while(true) {
 
+#ifdef ENABLE_IDLE_WAIT
+        idle = true;
+#endif
+
         // Process one line of incoming stream data, as the data becomes available. Performs an
         // initial filtering by removing spaces and comments and capitalizing all letters.
-        while((c = hal.stream.read()) != SERIAL_NO_DATA) {
-
-            if(c == ASCII_CAN) {
+        // NOTE: Input is read in blocks ending at the end of a line so that changes to the stream
+        //       made while executing the line, such as suspending input, takes effect for the next line.
+        //       Input is held while a report is being output in chunks.
+        while(
+#ifdef ENABLE_CHUNKED_REPORTS
+              !report_chunk_pending() &&
+#endif
+              (count = hal.stream.read_block ? hal.stream.read_block(rx_block, PROTOCOL_READ_BLOCK_SIZE)
+                                             : stream_read_block(rx_block, PROTOCOL_READ_BLOCK_SIZE))) {
 
-                eol = xcommand[0] = '\0';
-                keep_rt_commands = nocaps = user_message.show = false;
-                char_counter = line_flags.value = 0;
-                gc_state.last_error = Status_OK;
+#ifdef ENABLE_IDLE_WAIT
+            idle = false;
+#endif
 
-                if (sys.state == STATE_JOG) // Block all other states from invoking motion cancel.
-                    system_set_exec_state_flag(EXEC_MOTION_CANCEL);
+            for(idx = 0; idx < count; idx++) {
 
-            } else if ((c == '\n') || (c == '\r')) { // End of line reached
+                c = rx_block[idx];
 
-                // Check for possible secondary end of line character, do not process as empty line
-                // if part of crlf (or lfcr pair) as this produces a possibly unwanted double response
-                if(char_counter == 0 && eol && eol != c) {
-                    eol = '\0';
+#ifdef ENABLE_BINARY_STREAM
+                // Binary frames bypass the line builder.
+                if(binary_stream_receiving() || (c == BINARY_FRAME_START && char_counter == 0 && !line_flags.value && binary_stream_enabled())) {
+                    if(binary_stream_receive((char)c)) {
+                        if(!protocol_execute_realtime() || !binary_stream_execute())
+                            return !sys.flags.exit; // Bail to calling function upon system abort
+                        eol = (char)c;
+                    }
                     continue;
-                } else
-                    eol = (char)c;
+                }
+#endif
 
-                if(!protocol_execute_realtime()) // Runtime command check point.
-                    return !sys.flags.exit;      // Bail to calling function upon system abort
+                cclass = char_class[(uint8_t)c];
 
-                line[char_counter] = '\0'; // Set string termination character.
+#ifdef ENABLE_LINE_CHECKSUM
+                if(cclass != CharClass_EOL)
+                    checksum_add(c);
+#endif
 
-              #ifdef REPORT_ECHO_LINE_RECEIVED
-                report_echo_line_received(line);
-              #endif
+                if(cclass == CharClass_Cancel) {
 
-                // Direct and execute one line of formatted input, and report status of execution.
-                if (line_flags.overflow) // Report line overflow error.
-                    gc_state.last_error = Status_Overflow;
-                else if ((line[0] == '\0' || char_counter == 0) && !user_message.show) // Empty or comment line. For syncing purposes.
+                    eol = xcommand[0] = '\0';
+                    keep_rt_commands = nocaps = user_message.show = false;
+                    char_counter = line_flags.value = 0;
                     gc_state.last_error = Status_OK;
-                else if (line[0] == '$') {// Grbl '$' system command
-                    if((gc_state.last_error = system_execute_line(line)) == Status_LimitsEngaged) {
-                        set_state(STATE_ALARM); // Ensure alarm state is active.
-                        report_alarm_message(Alarm_LimitsEngaged);
-                        hal.report.feedback_message(Message_CheckLimits);
+#ifdef ENABLE_LOOKAHEAD
+                    lookahead_reset();
+#endif
+#ifdef ENABLE_LINE_CHECKSUM
+                    checksum_reset();
+#endif
+
+                    if (sys.state == STATE_JOG) // Block all other states from invoking motion cancel.
+                        system_set_exec_state_flag(EXEC_MOTION_CANCEL);
+
+                } else if (cclass == CharClass_EOL) { // End of line reached
+
+                    // Check for possible secondary end of line character, do not process as empty line
+                    // if part of crlf (or lfcr pair) as this produces a possibly unwanted double response
+                    if(char_counter == 0 && eol && eol != c) {
+                        eol = '\0';
+                        continue;
+                    } else
+                        eol = (char)c;
+
+                    if(!protocol_execute_realtime()) // Runtime command check point.
+                        return !sys.flags.exit;      // Bail to calling function upon system abort
+
+                    line[char_counter] = '\0'; // Set string termination character.
+
+#ifdef ENABLE_LINE_CHECKSUM
+                    status_code_t status;
+                    if(line_flags.overflow)
+                        checksum_reset();
+                    else if((status = checksum_validate()) != Status_OK) {
+  #ifdef ENABLE_LOOKAHEAD
+                        if(!lookahead_flush()) // Report in order.
+                            return !sys.flags.exit;
+  #endif
+                        hal.report.status_message(status == Status_Unhandled ? Status_OK : status);
+                        keep_rt_commands = nocaps = user_message.show = false;
+                        char_counter = line_flags.value = 0;
+                        continue;
+                    }
+#endif
+
+                  #ifdef REPORT_ECHO_LINE_RECEIVED
+                    report_echo_line_received(line);
+                  #endif
+
+#ifdef ENABLE_LOOKAHEAD
+                    // Tokenize plain g-code blocks ahead while the planner buffer is full, they are executed
+                    // and their status reported in order as the planner buffer gets room.
+                    if(!(line_flags.overflow || user_message.show) && lookahead_queue(line)) {
+                        if(!lookahead_execute())
+                            return !sys.flags.exit;
+                        keep_rt_commands = nocaps = user_message.show = false;
+                        char_counter = line_flags.value = 0;
+                        continue;
                     }
-                } else if (line[0] == '[' && hal.user_command_execute)
-                    gc_state.last_error = hal.user_command_execute(line);
-                else if (sys.state & (STATE_ALARM|STATE_ESTOP|STATE_JOG)) // Everything else is gcode. Block if in alarm, eStop or jog mode.
-                    gc_state.last_error = Status_SystemGClock;
+                    if(!lookahead_flush()) // Execute queued blocks before the line.
+                        return !sys.flags.exit;
+#endif
+
+                    // Direct and execute one line of formatted input, and report status of execution.
+                    if (line_flags.overflow) // Report line overflow error.
+                        gc_state.last_error = Status_Overflow;
+                    else if ((line[0] == '\0' || char_counter == 0) && !user_message.show) // Empty or comment line. For syncing purposes.
+                        gc_state.last_error = Status_OK;
+                    else if (line[0] == '$') {// Grbl '$' system command
+                        if((gc_state.last_error = system_execute_line(line)) == Status_LimitsEngaged) {
+                            set_state(STATE_ALARM); // Ensure alarm state is active.
+                            report_alarm_message(Alarm_LimitsEngaged);
+                            hal.report.feedback_message(Message_CheckLimits);
+                        }
+                    } else if (line[0] == '[' && hal.user_command_execute)
+                        gc_state.last_error = hal.user_command_execute(line);
+                    else if (sys.state & (STATE_ALARM|STATE_ESTOP|STATE_JOG)) // Everything else is gcode. Block if in alarm, eStop or jog mode.
+                        gc_state.last_error = Status_SystemGClock;
+#ifdef ENABLE_O_WORDS
+                    else if (line[0] == 'O' || flowctrl_recording()) { // O-word or line of a subroutine or loop body.
 #if COMPATIBILITY_LEVEL == 0
-                else if(gc_state.last_error == Status_OK) { // Parse and execute g-code block.
+                        if(gc_state.last_error == Status_OK)
+#endif
+                        gc_state.last_error = flowctrl_execute_line(line);
+                    }
+#endif
+#if COMPATIBILITY_LEVEL == 0
+                    else if(gc_state.last_error == Status_OK) { // Parse and execute g-code block.
 #else
-                else { // Parse and execute g-code block.
+                    else { // Parse and execute g-code block.
 
 #endif
-                    gc_state.last_error = gc_execute_block(line, user_message.show ? user_message.message : NULL);
-                }
-
-                // Add a short delay for each block processed in Check Mode to
-                // avoid overwhelming the sender with fast reply messages.
-                // This is likely to happen when streaming is done via a protocol where
-                // the speed is not limited to 115200 baud. An example is native USB streaming.
-#if CHECK_MODE_DELAY
-                if(sys.state == STATE_CHECK_MODE)
-                    hal.delay_ms(CHECK_MODE_DELAY, NULL);
-#endif
-
-                hal.report.status_message(gc_state.last_error);
-
-                // Reset tracking data for next line.
-                keep_rt_commands = nocaps = user_message.show = false;
-                char_counter = line_flags.value = 0;
-
-            } else if (c <= (nocaps ? ' ' - 1 : ' ') || line_flags.value) {
-                // Throw away all whitepace, control characters, comment characters and overflow characters.
-                if(c >= ' ' && line_flags.comment_parentheses) {
-                    if(user_message.tracker == 5)
-                        user_message.message[user_message.idx++] = c == ')' ? '\0' : c;
-                    else if(user_message.tracker > 0 && CAPS(c) == msg[user_message.tracker])
-                        user_message.tracker++;
-                    else
-                        user_message.tracker = 0;
-                    if (c == ')') {
-                        // End of '()' comment. Resume line.
-                        line_flags.comment_parentheses = Off;
-                        keep_rt_commands = false;
-                        user_message.show = user_message.show || user_message.tracker == 5;
+                        gc_state.last_error = gc_execute_block(line, user_message.show ? user_message.message : NULL);
                     }
-                }
-            } else {
-                switch(c) {
 
-                    case '/':
-                        if(char_counter == 0)
-                            line_flags.block_delete = sys.flags.block_delete_enabled;
-                        break;
+                    // Add a short delay for each block processed in Check Mode to
+                    // avoid overwhelming the sender with fast reply messages.
+                    // This is likely to happen when streaming is done via a protocol where
+                    // the speed is not limited to 115200 baud. An example is native USB streaming.
+#if CHECK_MODE_DELAY
+                    if(sys.state == STATE_CHECK_MODE)
+                        hal.delay_ms(CHECK_MODE_DELAY, NULL);
+#endif
 
-                    case '$':
-                    case '[':
-                        // Do not uppercase system or user commands - will destroy passwords etc...
-                        if(char_counter == 0)
-                            nocaps = keep_rt_commands = true;
-                        break;
+#ifdef ENABLE_CHUNKED_REPORTS
+                    report_chunk_status(gc_state.last_error); // Deferred until a report started by the line is complete.
+#else
+                    hal.report.status_message(gc_state.last_error);
+#endif
 
-                    case '(':
-                        if(!keep_rt_commands) {
-                            // Enable comments flag and ignore all characters until ')' or EOL unless it is a message.
-                            // NOTE: This doesn't follow the NIST definition exactly, but is good enough for now.
-                            // In the future, we could simply remove the items within the comments, but retain the
-                            // comment control characters, so that the g-code parser can error-check it.
-                            if((line_flags.comment_parentheses = !line_flags.comment_semicolon)) {
-                                if(hal.show_message) {
-                                    if(user_message.message == NULL)
-                                        user_message.message = malloc(LINE_BUFFER_SIZE);
-                                    if(user_message.message) {
-                                        user_message.idx = 0;
-                                        user_message.tracker = 1;
+                    // Reset tracking data for next line.
+                    keep_rt_commands = nocaps = user_message.show = false;
+                    char_counter = line_flags.value = 0;
+
+                } else if (line_flags.value || cclass == CharClass_Control || (cclass == CharClass_Space && !nocaps)) {
+                    // Throw away all whitepace, control characters, comment characters and overflow characters.
+                    if(cclass != CharClass_Control && line_flags.comment_parentheses) {
+                        if(user_message.tracker == 5)
+                            user_message.message[user_message.idx++] = c == ')' ? '\0' : c;
+                        else if(user_message.tracker > 0 && CAPS(c) == msg[user_message.tracker])
+                            user_message.tracker++;
+                        else
+                            user_message.tracker = 0;
+                        if (c == ')') {
+                            // End of '()' comment. Resume line.
+                            line_flags.comment_parentheses = Off;
+                            keep_rt_commands = false;
+                            user_message.show = user_message.show || user_message.tracker == 5;
+                        }
+                    }
+                } else {
+                    if(cclass == CharClass_Special) switch(c) {
+
+                        case '/':
+                            if(char_counter == 0)
+                                line_flags.block_delete = sys.flags.block_delete_enabled;
+                            break;
+
+                        case '$':
+                        case '[':
+                            // Do not uppercase system or user commands - will destroy passwords etc...
+                            if(char_counter == 0)
+                                nocaps = keep_rt_commands = true;
+                            break;
+
+                        case '(':
+                            if(!keep_rt_commands) {
+                                // Enable comments flag and ignore all characters until ')' or EOL unless it is a message.
+                                // NOTE: This doesn't follow the NIST definition exactly, but is good enough for now.
+                                // In the future, we could simply remove the items within the comments, but retain the
+                                // comment control characters, so that the g-code parser can error-check it.
+                                if((line_flags.comment_parentheses = !line_flags.comment_semicolon)) {
+                                    if(hal.show_message) {
+                                        if(user_message.message == NULL)
+                                            user_message.message = mem_alloc(LINE_BUFFER_SIZE);
+                                        if(user_message.message) {
+                                            user_message.idx = 0;
+                                            user_message.tracker = 1;
+                                        }
                                     }
+                                    keep_rt_commands = true;
                                 }
-                                keep_rt_commands = true;
                             }
-                        }
-                        break;
+                            break;
 
-                    case ';':
-                        // NOTE: ';' comment to EOL is a LinuxCNC definition. Not NIST.
-                        if(!keep_rt_commands) {
-                            if((line_flags.comment_semicolon = !line_flags.comment_parentheses))
-                                keep_rt_commands = true;
-                        }
-                        break;
+                        case ';':
+                            // NOTE: ';' comment to EOL is a LinuxCNC definition. Not NIST.
+                            if(!keep_rt_commands) {
+                                if((line_flags.comment_semicolon = !line_flags.comment_parentheses))
+                                    keep_rt_commands = true;
+                            }
+                            break;
+                    }
+                    if (line_flags.value == 0 && !(line_flags.overflow = char_counter >= (LINE_BUFFER_SIZE - 1)))
+                        line[char_counter++] = cclass == CharClass_Lower && !nocaps ? c & 0x5F : c;
                 }
-                if (line_flags.value == 0 && !(line_flags.overflow = char_counter >= (LINE_BUFFER_SIZE - 1)))
-                    line[char_counter++] = nocaps ? c : CAPS(c);
             }
         }
 
+#ifdef ENABLE_CHUNKED_REPORTS
+        report_chunk_poll(); // Output the next part of a report in progress.
+#endif
+#ifdef ENABLE_ACK_COALESCING
+        report_ack_flush(false); // Acknowledge the lines executed when due.
+#endif
+
         // Handle extra command (internal stream)
         if(xcommand[0] != '\0') {
 
@@ -279,7 +580,27 @@ bool protocol_main_loop(bool cold_start)
         // If there are no more characters in the input stream buffer to be processed and executed,
         // this indicates that g-code streaming has either filled the planner buffer or has
         // completed. In either case, auto-cycle start, if enabled, any queued moves.
+#ifdef ENABLE_LOOKAHEAD
+        if(!lookahead_execute()) // Execute tokenized blocks as planner buffer space permits.
+            return !sys.flags.exit;
+#endif
+        mc_canned_step(); // Queue moves of any pending canned cycle as planner buffer space permits.
+#ifdef ENABLE_JOG_CONTINUOUS
+        mc_jog_continuous_step(); // Keep the continuous jog horizon queued.
+#endif
+#ifdef ENABLE_JOG_MPG
+        mc_jog_mpg_step(); // Follow the handwheel position.
+#endif
+#ifdef MC_LINE_HOLD
+        // Release any line held back by mc_line() when the planner is about to run dry.
+        if(plan_get_block_buffer_available() + 1 >= plan_get_block_buffer_size())
+            mc_line_flush();
+#endif
+#ifdef ENABLE_AUTO_CYCLE_START_DELAY
+        auto_cycle_start_delayed();
+#else
         protocol_auto_cycle_start();
+#endif
 
         if(!protocol_execute_realtime() && sys.abort) // Runtime command check point.
             return !sys.flags.exit;                   // Bail to main() program loop to reset system.
@@ -289,6 +610,22 @@ bool protocol_main_loop(bool cold_start)
         // Check for sleep conditions and execute auto-park, if timeout duration elapses.
         if(settings.flags.sleep_enable)
             sleep_check();
+
+#ifdef ENABLE_ROTARY_WRAP
+        if(settings.rotary_wrap.mask)
+            system_fold_rotary_position();
+#endif
+
+#ifdef ENABLE_IDLE_WAIT
+        // Nothing was read, wait for an event rather than spin. Work pending in the planner and segment buffers,
+        // lookahead and canned cycles proceeds as step segments are executed, which wakes the loop up.
+        if(idle && hal.idle_wait && !(sys_rt_exec_state || sys_rt_exec_alarm)
+  #ifdef ENABLE_CHUNKED_REPORTS
+            && !report_chunk_pending()
+  #endif
+           )
+            hal.idle_wait();
+#endif
     }
 }
 
@@ -298,9 +635,24 @@ bool protocol_main_loop(bool cold_start)
 bool protocol_buffer_synchronize ()
 {
     bool ok = true;
+
+    mc_canned_flush(); // Queue remaining moves of any pending canned cycle.
+#ifdef MC_LINE_HOLD
+    mc_line_flush(); // Queue any line held back by mc_line().
+#endif
     // If system is queued, ensure cycle resumes if the auto start flag is present.
     protocol_auto_cycle_start();
+#ifdef ENABLE_FEED_ADAPTATION
+    synchronizing = true;
+#endif
+#ifdef ENABLE_WAIT_ON_INPUT_ASYNC
+    while ((ok = protocol_execute_realtime()) && (plan_get_current_block() || sys.state == STATE_CYCLE || wait_input_pending()));
+#else
     while ((ok = protocol_execute_realtime()) && (plan_get_current_block() || sys.state == STATE_CYCLE));
+#endif
+#ifdef ENABLE_FEED_ADAPTATION
+    synchronizing = false;
+#endif
 
     return ok;
 }
@@ -318,6 +670,41 @@ void protocol_auto_cycle_start ()
         system_set_exec_state_flag(EXEC_CYCLE_START); // If so, execute them!
 }
 
+#ifdef ENABLE_AUTO_CYCLE_START_DELAY
+
+// Auto-cycle start from the main loop. When idle the cycle is not started until the planner buffer holds
+// AUTO_CYCLE_START_MIN_TIME ms of planned motion or the first block has waited AUTO_CYCLE_START_TIMEOUT ms,
+// so that a job does not start with a near empty buffer and stutter until the sender catches up.
+// NOTE: A buffer sync, e.g. by M2 or M30, and a full planner buffer start the cycle at once.
+static void auto_cycle_start_delayed (void)
+{
+    static bool waiting = false;
+    static uint32_t queued_at;
+
+    if (plan_get_current_block() == NULL) {
+        waiting = false;
+        return;
+    }
+
+    if (sys.state == STATE_IDLE && hal.get_elapsed_ticks) {
+
+        uint32_t ms = hal.get_elapsed_ticks();
+
+        if (!waiting) {
+            waiting = true;
+            queued_at = ms;
+        }
+
+        if (ms - queued_at < AUTO_CYCLE_START_TIMEOUT && plan_get_planned_time(AUTO_CYCLE_START_MIN_TIME) < AUTO_CYCLE_START_MIN_TIME)
+            return;
+    }
+
+    waiting = false;
+    system_set_exec_state_flag(EXEC_CYCLE_START);
+}
+
+#endif
+
 
 // This function is the general interface to Grbl's real-time command execution system. It is called
 // from various check points in the main program, primarily where there may be a while loop waiting
@@ -333,17 +720,24 @@ void protocol_auto_cycle_start ()
 // Returns false if aborted
 bool protocol_execute_realtime ()
 {
+    PERF_START(t);
+
     if(protocol_exec_rt_system()) {
 
         if (sys.suspend)
             protocol_exec_rt_suspend();
 
       #ifdef EMULATE_EEPROM
-        if((sys.state == STATE_IDLE || sys.state == STATE_ALARM) && settings_dirty.is_dirty && !gc_state.file_run)
-            eeprom_emu_sync_physical();
+        if(settings_dirty.is_dirty && !gc_state.file_run)
+            eeprom_emu_write_behind(sys.state == STATE_IDLE || sys.state == STATE_ALARM);
+      #endif
+      #ifdef ENABLE_WAIT_ON_INPUT_ASYNC
+        wait_input_poll(); // Resolve any M66 barrier reached.
       #endif
     }
 
+    PERF_END(Perf_ProtocolRealtime, t);
+
     return !ABORTED;
 }
 
@@ -359,17 +753,44 @@ void protocol_message (char *message)
 
     if(message) {
         if(sys.message)
-            free(sys.message);
+            pool_message_release(sys.message);
         sys.message = message;
     } else if(sys.message) {
         hal.show_message(sys.message);
-        free(sys.message);
+        pool_message_release(sys.message);
         sys.message = NULL;
     }
 
     spin_lock = false;
 }
 
+#ifdef ENABLE_REALTIME_DISPATCH
+
+// Starts the deceleration for a pending feed hold, safety door or motion cancel while in a cycle or jogging.
+// Called by the driver from a task of its own, of higher priority than the main program, when signalled by
+// hal.pend_realtime. State transitions and reports are left to the main program as these are not serialized
+// by the planner lock, protocol_exec_rt_system() then finds the deceleration already in progress.
+void protocol_realtime_dispatch (void)
+{
+    if(hal.planner_lock == NULL || !(sys_rt_exec_state & (EXEC_FEED_HOLD|EXEC_SAFETY_DOOR|EXEC_MOTION_CANCEL)))
+        return;
+
+    PLANNER_LOCK(true);
+
+    if((sys.state & (STATE_CYCLE|STATE_JOG)) && !(sys.suspend || sys.step_control.execute_hold || sys.step_control.execute_sys_motion)) {
+#ifdef ENABLE_HOLD_SEGMENT_REWIND
+        st_hold_rewind();
+#endif
+        st_update_plan_block_parameters();
+        sys.step_control.execute_hold = On;
+        st_prep_buffer();
+    }
+
+    PLANNER_LOCK(false);
+}
+
+#endif
+
 // Executes run-time commands, when required. This function primarily operates as Grbl's state
 // machine and controls the various real-time features Grbl has to offer.
 // NOTE: Do not alter this unless you know exactly what you are doing!
@@ -387,6 +808,9 @@ bool protocol_exec_rt_system ()
         // loop until system reset/abort.
         set_state((alarm_code_t)rt_exec == Alarm_EStop ? STATE_ESTOP : STATE_ALARM); // Set system alarm state
         report_alarm_message((alarm_code_t)rt_exec);
+#ifdef ENABLE_JOB_STATS
+        job_stats_alarm((alarm_code_t)rt_exec);
+#endif
         // Halt everything upon a critical event flag. Currently hard and soft limits flag this.
         if ((alarm_code_t)rt_exec == Alarm_HardLimit || (alarm_code_t)rt_exec == Alarm_SoftLimit || (alarm_code_t)rt_exec == Alarm_EStop) {
             system_set_exec_alarm(rt_exec);
@@ -399,12 +823,22 @@ bool protocol_exec_rt_system ()
                 // incoming stream. The same could be said about soft limits. While the position is not
                 // lost, continued streaming could cause a serious crash if by chance it gets executed.
                 if(bit_istrue(sys_rt_exec_state, EXEC_STATUS_REPORT)) {
-                    system_clear_exec_state_flag(EXEC_STATUS_REPORT);
+                    system_clear_exec_state_flag(EXEC_STATUS_REPORT|EXEC_STATUS_PUSH);
                     report_realtime_status();
+                } else if(bit_istrue(sys_rt_exec_state, EXEC_STATUS_PUSH)) {
+                    system_clear_exec_state_flag(EXEC_STATUS_PUSH);
+                    report_status_push();
+                }
+
+                if(bit_istrue(sys_rt_exec_state, EXEC_BINARY_REPORT)) {
+                    system_clear_exec_state_flag(EXEC_BINARY_REPORT);
+                    hal.report.binary_status();
                 }
 
                 if(hal.execute_realtime)
                     hal.execute_realtime(STATE_ESTOP);
+
+                hooks_execute_realtime(STATE_ESTOP);
             }
             system_clear_exec_alarm(); // Clear alarm
         }
@@ -415,6 +849,11 @@ bool protocol_exec_rt_system ()
         // Execute system abort.
         if (rt_exec & EXEC_RESET) {
 
+#ifdef ENABLE_WARM_RESET
+            if(hal.get_elapsed_ticks)
+                sys_startup_time.reset_request = hal.get_elapsed_ticks();
+#endif
+
             hal.driver_reset();
 
             sys.abort = !hal.system_control_get_state().e_stop;  // Only place this is set true.
@@ -446,8 +885,15 @@ bool protocol_exec_rt_system ()
             if(hal.stream.suspend_read && hal.stream.suspend_read(false))
                 hal.stream.cancel_read_buffer(); // flush pending blocks (after M6)
 
+            mc_canned_discard();
+#ifdef MC_LINE_HOLD
+            mc_line_discard();
+#endif
             plan_reset();
             st_reset();
+#ifdef ENABLE_WCO_MOTION_SYNC
+            system_wco_reset(); // Discard offsets queued with the flushed motion.
+#endif
             gc_sync_position();
             plan_sync_position();
             flush_override_buffers();
@@ -457,6 +903,11 @@ bool protocol_exec_rt_system ()
         // Execute and print status to output stream
         if (rt_exec & EXEC_STATUS_REPORT)
             report_realtime_status();
+        else if (rt_exec & EXEC_STATUS_PUSH) // Periodic report, skipped if a report was requested
+            report_status_push();
+
+        if(rt_exec & EXEC_BINARY_REPORT)
+            hal.report.binary_status();
 
         if(rt_exec & EXEC_GCODE_REPORT)
             report_gcode_modes();
@@ -468,7 +919,7 @@ bool protocol_exec_rt_system ()
         if (rt_exec & EXEC_PID_REPORT)
             report_pid_log();
 
-        rt_exec &= ~(EXEC_STOP|EXEC_STATUS_REPORT|EXEC_GCODE_REPORT|EXEC_PID_REPORT|EXEC_TLO_REPORT); // clear requests already processed
+        rt_exec &= ~(EXEC_STOP|EXEC_STATUS_REPORT|EXEC_STATUS_PUSH|EXEC_BINARY_REPORT|EXEC_GCODE_REPORT|EXEC_PID_REPORT|EXEC_TLO_REPORT); // clear requests already processed
 
         if(sys.flags.feed_hold_pending) {
             if(rt_exec & EXEC_CYCLE_START)
@@ -485,15 +936,27 @@ bool protocol_exec_rt_system ()
     if(hal.execute_realtime)
         hal.execute_realtime(sys.state);
 
+    hooks_execute_realtime(sys.state);
+
+#ifdef ENABLE_ACK_COALESCING
+    report_ack_flush(false); // Acknowledge lines executed while blocked, e.g. by a full planner buffer.
+#endif
+
+#ifdef ENABLE_SPINDLE_PID
+    spindle_pid_stream_output();
+#endif
+
     if(!sys.flags.delay_overrides) {
 
         // Execute overrides.
 
-        if((rt_exec = get_feed_override())) {
+        uint_fast8_t target = get_feed_override_target();
+
+        if((rt_exec = get_feed_override()) || target) {
 
-            uint_fast8_t new_f_override = sys.override.feed_rate, new_r_override = sys.override.rapid_rate;
+            uint_fast8_t new_f_override = target ? target : sys.override.feed_rate, new_r_override = sys.override.rapid_rate;
 
-            do {
+            if(rt_exec) do {
 
                 switch(rt_exec) {
 
@@ -535,13 +998,25 @@ bool protocol_exec_rt_system ()
             plan_feed_override(new_f_override, new_r_override);
         }
 
-        if((rt_exec = get_accessory_override())) {
+#ifdef ENABLE_FEED_ADAPTATION
+        plan_feed_adapt(!synchronizing);
+#endif
+        plan_apply_overrides(); // Replan for any override changes left pending.
+
+        target = get_spindle_override_target();
+
+        if((rt_exec = get_accessory_override()) || target) {
 
             bool spindle_stop = false;
-            uint_fast8_t last_s_override = sys.override.spindle_rpm;
+            uint_fast8_t last_s_override = target ? target : sys.override.spindle_rpm;
+#ifdef ENABLE_COOLANT_QUEUE
+            coolant_state_t coolant_current = hal.coolant_get_state(); // The parser state may be ahead of a queued change.
+            coolant_state_t coolant_state = coolant_current;
+#else
             coolant_state_t coolant_state = gc_state.modal.coolant;
+#endif
 
-            do {
+            if(rt_exec) do {
 
                 switch(rt_exec) {
 
@@ -593,7 +1068,12 @@ bool protocol_exec_rt_system ()
 
           // NOTE: Since coolant state always performs a planner sync whenever it changes, the current
           // run state can be determined by checking the parser state.
+          // A queued change not yet executed is still set when its block starts.
+#ifdef ENABLE_COOLANT_QUEUE
+            if(coolant_state.value != coolant_current.value) {
+#else
             if(coolant_state.value != gc_state.modal.coolant.value) {
+#endif
                 coolant_set_state(coolant_state); // Report flag set in coolant_set_state().
                 gc_state.modal.coolant = coolant_state;
             }
@@ -642,6 +1122,14 @@ static void protocol_exec_rt_suspend ()
         if(settings.flags.sleep_enable)
             sleep_check();
 
+#ifdef ENABLE_HOLD_JOG
+        // Execute jog commands queued by protocol_enqueue_gcode(), the input stream holding the job is not read.
+        if(!strncmp(xcommand, "$J=", 3) && state_hold_jog_ready()) {
+            system_execute_line(xcommand);
+            xcommand[0] = '\0';
+        }
+#endif
+
         protocol_exec_rt_system();
     }
 }
@@ -697,6 +1185,13 @@ ISR_CODE bool protocol_enqueue_realtime_command (char c)
             drop = true;
             break;
 
+        case CMD_STATUS_REPORT_BINARY:
+            if(hal.report.binary_status) {
+                system_set_exec_state_flag(EXEC_BINARY_REPORT);
+                drop = true;
+            }
+            break;
+
         case CMD_CYCLE_START:
             system_set_exec_state_flag(EXEC_CYCLE_START);
             // Cancel any pending tool change
@@ -706,17 +1201,26 @@ ISR_CODE bool protocol_enqueue_realtime_command (char c)
 
         case CMD_FEED_HOLD:
             system_set_exec_state_flag(EXEC_FEED_HOLD);
+            system_pend_realtime();
             drop = true;
             break;
 
         case CMD_SAFETY_DOOR:
             if(!hal.driver_cap.safety_door) {
                 system_set_exec_state_flag(EXEC_SAFETY_DOOR);
+                system_pend_realtime();
                 drop = true;
             }
             break;
 
         case CMD_JOG_CANCEL:
+#ifdef ENABLE_HOLD_JOG
+            if (sys.state == STATE_HOLD) { // Input is kept, it holds the job.
+                system_set_exec_state_flag(EXEC_MOTION_CANCEL);
+                drop = true;
+                break;
+            }
+#endif
             char_counter = 0;
             drop = true;
             hal.stream.cancel_read_buffer();
@@ -796,6 +1300,7 @@ ISR_CODE bool protocol_enqueue_realtime_command (char c)
         case CMD_FEED_HOLD_LEGACY:
             if(!keep_rt_commands || settings.legacy_rt_commands) {
                 system_set_exec_state_flag(EXEC_FEED_HOLD);
+                system_pend_realtime();
                 drop = true;
             }
             break;
@@ -805,5 +1310,10 @@ ISR_CODE bool protocol_enqueue_realtime_command (char c)
             break;
     }
 
+#ifdef ENABLE_IDLE_WAIT
+    if(drop)
+        system_idle_wake();
+#endif
+
     return drop;
 }
@@ -32,6 +32,26 @@
   #define LINE_BUFFER_SIZE 257 // 256 characters plus terminator
 #endif
 
+// Max number of characters read from the input stream at a time by the line builder.
+#ifndef PROTOCOL_READ_BLOCK_SIZE
+  #ifdef SMALL_RAM_TARGET
+    #define PROTOCOL_READ_BLOCK_SIZE 16
+  #else
+    #define PROTOCOL_READ_BLOCK_SIZE 64
+  #endif
+#endif
+
+#ifdef ENABLE_AUTO_CYCLE_START_DELAY
+// Planned motion time (ms) needed for the main loop to start a cycle.
+#ifndef AUTO_CYCLE_START_MIN_TIME
+  #define AUTO_CYCLE_START_MIN_TIME 200
+#endif
+// Time (ms) after which the cycle is started anyway.
+#ifndef AUTO_CYCLE_START_TIMEOUT
+  #define AUTO_CYCLE_START_TIMEOUT 500
+#endif
+#endif
+
 // Starts Grbl main loop. It handles all incoming characters from the input stream and executes
 // them as they complete. It is also responsible for finishing the initialization procedures.
 bool protocol_main_loop(bool cold_start);
@@ -40,6 +60,11 @@ bool protocol_main_loop(bool cold_start);
 bool protocol_execute_realtime();
 bool protocol_exec_rt_system();
 
+#ifdef ENABLE_REALTIME_DISPATCH
+// Starts the deceleration for a pending stop request, called by the driver when signalled by hal.pend_realtime.
+void protocol_realtime_dispatch (void);
+#endif
+
 // Executes the auto cycle feature, if enabled.
 void protocol_auto_cycle_start();
 
@@ -50,6 +75,11 @@ bool protocol_enqueue_realtime_command (char c);
 bool protocol_enqueue_gcode (char *data);
 void protocol_message (char *message);
 
+#ifdef ENABLE_LINE_CHECKSUM
+// Restarts the line number sequence of checksummed lines, called at program end.
+void protocol_line_sequence_reset (void);
+#endif
+
 // work in progress...
 //void set_state (uint_fast16_t state);
 
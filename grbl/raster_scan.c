@@ -0,0 +1,222 @@
+/*
+  raster_scan.c - bidirectional laser raster scan with overscan, generated from raster rows by M-codes
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_RASTER_SCAN
+
+#include <string.h>
+
+/*
+  For photo engraving the sender only sends the pixel power of each row, the moves are generated here:
+
+    M170 P<pixel size> E<row step-over> [Q<overscan>]
+
+  starts an image with its first row at the current position, rows run along X from the left edge of the
+  image at the current X position and are stepped over along Y, towards -Y for a negative E value. Q is the
+  length of the zones before and after each row where the laser is off, it defaults to the distance needed to
+  accelerate along X to the feed rate. Lengths are in the current units.
+
+    M171 F<feed rate>
+
+  carries the power of one row, left to right, as a raster row in a binary frame. The row is scanned at the
+  feed rate in alternating directions: the first row towards +X, the next towards -X and so on. Each row is
+  queued as four moves, the step-over to the start of the overscan zone, the overscan zone, the row with the
+  power set per pixel by the step segment generator and the overscan zone after it. Overscan zones and
+  step-overs are moves with zero power, the row and its overscan zones are collinear and the row is thus
+  executed at the feed rate from the first to the last pixel. Neither command waits for motion to complete.
+*/
+
+typedef enum {
+    RasterScan_Start = 170,
+    RasterScan_Row = 171
+} raster_scan_mcode_t;
+
+static struct {
+    bool active;
+    bool reverse;                   // Next row is scanned towards -X
+    uint32_t row;                   // Next row number, from 0
+    float origin[2];                // Left edge of the first row (mm)
+    float pixel_size;               // (mm)
+    float step_over;                // (mm)
+    float overscan;                 // (mm), 0 for the distance to accelerate to the feed rate
+    raster_row_t **raster;          // Row claimed by the block being executed
+} scan = {0};
+
+static user_mcode_t (*check_next)(user_mcode_t mcode) = NULL;
+static status_code_t (*validate_next)(parser_block_t *gc_block, uint32_t *value_words) = NULL;
+static void (*execute_next)(uint_fast16_t state, parser_block_t *gc_block) = NULL;
+
+static user_mcode_t check (user_mcode_t mcode)
+{
+    return (mcode == (user_mcode_t)RasterScan_Start || mcode == (user_mcode_t)RasterScan_Row)
+            ? mcode
+            : (check_next ? check_next(mcode) : UserMCode_Ignore);
+}
+
+static status_code_t validate (parser_block_t *gc_block, uint32_t *value_words)
+{
+    status_code_t state = Status_OK;
+    float scale = gc_block->modal.units_imperial ? MM_PER_INCH : 1.0f;
+
+    switch((uint32_t)gc_block->user_mcode) {
+
+        case RasterScan_Start:
+            if(bit_isfalse(*value_words, bit(Word_P)) || bit_isfalse(*value_words, bit(Word_E)))
+                state = Status_GcodeValueWordMissing;
+            else if(gc_block->values.p <= 0.0f || gc_block->values.e == 0.0f ||
+                     (bit_istrue(*value_words, bit(Word_Q)) && gc_block->values.q < 0.0f))
+                state = Status_GcodeValueOutOfRange;
+            else {
+                gc_block->values.p *= scale;
+                gc_block->values.e *= scale;
+                gc_block->values.q = bit_istrue(*value_words, bit(Word_Q)) ? gc_block->values.q * scale : 0.0f;
+            }
+            bit_false(*value_words, bit(Word_P)|bit(Word_E)|bit(Word_Q));
+            break;
+
+        case RasterScan_Row:
+            if(gc_block->raster == NULL || *gc_block->raster == NULL || !scan.active)
+                state = Status_GcodeUnsupportedCommand;
+            else if(gc_block->modal.feed_mode != FeedMode_UnitsPerMin || gc_block->values.f <= 0.0f)
+                state = Status_GcodeUndefinedFeedRate;
+            else {
+                scan.raster = gc_block->raster;
+                gc_block->raster = NULL; // Claim the row, it is not attached to a motion of the block.
+            }
+            break;
+
+        default:
+            state = validate_next ? validate_next(gc_block, value_words) : Status_GcodeUnsupportedCommand;
+            break;
+    }
+
+    return state;
+}
+
+// Queues a move along the row or the step-over to the next row, power is off unless a raster row is given.
+static bool scan_move (float *target, raster_row_t **raster)
+{
+    plan_line_data_t plan_data;
+
+    memset(&plan_data, 0, sizeof(plan_line_data_t));
+
+    plan_data.feed_rate = gc_state.feed_rate;
+    plan_data.line_number = gc_state.line_number;
+    plan_data.condition.spindle = gc_state.modal.spindle;
+    plan_data.condition.coolant = gc_state.modal.coolant;
+    plan_data.condition.is_rpm_rate_adjusted = gc_state.is_rpm_rate_adjusted;
+    plan_data.condition.is_laser_ppi_mode = gc_state.is_rpm_rate_adjusted && gc_state.is_laser_ppi_mode;
+    if(raster) {
+        memcpy(&plan_data.spindle, &gc_state.spindle, sizeof(spindle_t));
+        plan_data.raster = *raster;
+    }
+
+    mc_line(target, &plan_data);
+
+    if(raster)
+        *raster = plan_data.raster; // NULL if queued.
+
+    return !ABORTED;
+}
+
+static void scan_row (void)
+{
+    raster_row_t *row = *scan.raster;
+    float target[N_AXIS], width = (float)row->n_pixels * scan.pixel_size, dir = scan.reverse ? -1.0f : 1.0f;
+    float overscan = scan.overscan;
+
+    if(overscan == 0.0f) { // Distance to accelerate to the feed rate, limited by the max rate.
+        float rate = min(gc_state.feed_rate, settings.max_rate[X_AXIS]);
+        overscan = rate * rate / (2.0f * settings.acceleration[X_AXIS]);
+    }
+
+    if(scan.reverse) { // Pixels are sent left to right, reverse them to the scan direction.
+        uint_fast16_t idx = 0, end = row->n_pixels - 1;
+        float power;
+        while(idx < end) {
+            power = row->power[idx];
+            row->power[idx++] = row->power[end];
+            row->power[end--] = power;
+        }
+    }
+
+    memcpy(target, gc_state.position, sizeof(target));
+
+    // Step over to the start of the overscan zone before the row.
+    target[X_AXIS] = scan.origin[0] + (scan.reverse ? width + overscan : -overscan);
+    target[Y_AXIS] = scan.origin[1] + (float)scan.row * scan.step_over;
+
+    if(scan_move(target, NULL)) {
+        target[X_AXIS] += dir * overscan;
+        if(scan_move(target, NULL)) {
+            target[X_AXIS] += dir * width;
+            if(scan_move(target, scan.raster)) {
+                target[X_AXIS] += dir * overscan;
+                scan_move(target, NULL);
+            }
+        }
+    }
+
+    memcpy(gc_state.position, target, sizeof(target));
+
+    scan.row++;
+    scan.reverse = !scan.reverse;
+}
+
+static void execute (uint_fast16_t state, parser_block_t *gc_block)
+{
+    switch((uint32_t)gc_block->user_mcode) {
+
+        case RasterScan_Start:
+            scan.active = true;
+            scan.reverse = false;
+            scan.row = 0;
+            scan.origin[0] = gc_state.position[X_AXIS];
+            scan.origin[1] = gc_state.position[Y_AXIS];
+            scan.pixel_size = gc_block->values.p;
+            scan.step_over = gc_block->values.e;
+            scan.overscan = gc_block->values.q;
+            break;
+
+        case RasterScan_Row:
+            scan_row();
+            scan.raster = NULL;
+            break;
+
+        default:
+            if(execute_next)
+                execute_next(state, gc_block);
+            break;
+    }
+}
+
+void raster_scan_init (void)
+{
+    check_next = hal.user_mcode_check;
+    validate_next = hal.user_mcode_validate;
+    execute_next = hal.user_mcode_execute;
+
+    hal.user_mcode_check = check;
+    hal.user_mcode_validate = validate;
+    hal.user_mcode_execute = execute;
+}
+
+#endif
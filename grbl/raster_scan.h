@@ -0,0 +1,32 @@
+/*
+  raster_scan.h - bidirectional laser raster scan with overscan, generated from raster rows by M-codes
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _RASTER_SCAN_H_
+#define _RASTER_SCAN_H_
+
+#ifdef ENABLE_RASTER_SCAN
+
+// Registers the M170 and M171 user M-codes, M-codes not handled are passed on to the driver handlers.
+// NOTE: Must be called after driver_init().
+void raster_scan_init (void);
+
+#endif
+
+#endif
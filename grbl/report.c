@@ -35,15 +35,102 @@
 #include <stdio.h>
 #endif
 
-static char buf[(STRLEN_COORDVALUE + 1) * N_AXIS];
+// Max length of the axis values string returned by get_axis_values(), including the terminating null.
+#define AXIS_VALUES_LENGTH ((STRLEN_COORDVALUE + 1) * N_AXIS)
+
+// Also used for building the option reports, the NEWOPT report needs about 100 characters with all options enabled.
+static char buf[max(AXIS_VALUES_LENGTH, 128)];
 static char *(*get_axis_values)(float *axis_values);
 static char *(*get_rate_value)(float value);
 static uint8_t override_counter = 0; // Tracks when to add override data to status reports.
 static uint8_t wco_counter = 0;      // Tracks when to add work coordinate offset data to status reports.
 alarm_code_t current_alarm = Alarm_None;
 
+// Realtime status reports are rendered into this buffer and written to the output stream(s) in one go.
+static struct {
+    uint_fast16_t length;
+    char data[REPORT_STATUS_BUFFER_SIZE];
+} status;
+
+// Stream subscribed to periodic status reports by $RT and the report period, 0 when not subscribed.
+static struct {
+    stream_type_t stream;
+    uint32_t period;
+} status_push = {0};
+
+// Fields of the realtime status report that change infrequently are kept rendered along with
+// the values they were rendered from, these are only formatted again when the values changes.
+// NOTE: The cache is invalidated by report_init() as it is called when the report format changes, and by
+//       report_status_cache_invalidate() when settings change, e.g. steps/mm.
+static struct {
+    bool valid;
+    struct {
+        uint32_t key;
+        char s[12];
+    } state;
+    struct {
+        bool mpos;
+        int32_t steps[N_AXIS];
+        float wco[N_AXIS];
+        char s[AXIS_VALUES_LENGTH + 6];
+    } position;
+    struct {
+        float wco[N_AXIS];
+        char s[AXIS_VALUES_LENGTH + 5];
+    } wco;
+    struct {
+        uint32_t key;
+        char s[16];
+    } overrides;
+    struct {
+        uint32_t key;
+        char s[24];
+    } pins;
+} status_cache = {0};
+
+// Writes the rendered part of the realtime status report, with a single write_n() call if the
+// current stream is the only output stream.
+static void status_flush (void)
+{
+    if(status.length) {
+        status.data[status.length] = '\0';
+        if(hal.stream.write_n && hal.stream.write_all == hal.stream.write)
+            hal.stream.write_n(status.data, (uint16_t)status.length);
+        else
+            hal.stream.write_all(status.data);
+        status.length = 0;
+    }
+}
+
+// Appends a string to the realtime status report, flushes the buffer when full.
+static void status_write (const char *s)
+{
+    char c, *d = &status.data[status.length], *end = &status.data[sizeof(status.data) - 1];
+
+    while((c = *s++)) {
+        if(d == end) {
+            status.length = d - status.data;
+            status_flush();
+            d = status.data;
+        }
+        *d++ = c;
+    }
+
+    status.length = d - status.data;
+}
+
+// Appends an integer to the realtime status report, converted in place.
+static void status_write_uint (uint32_t n)
+{
+    if(status.length + 11 >= sizeof(status.data)) // Up to 10 digits and terminating null.
+        status_flush();
+
+    status.length = uitoa_r(&status.data[status.length], n) - status.data;
+}
+
 // Append a number of strings to the static buffer
 // NOTE: do NOT use for several int/float conversions as these share the same underlying buffer!
+//       Use uitoa_r() and ftoa_r() for building strings with several values instead.
 static char *appendbuf (int argc, ...)
 {
     char c, *s = buf, *arg;
@@ -81,16 +168,15 @@ static char *map_coord_system (uint8_t idx)
 static char *get_axis_values_mm (float *axis_values)
 {
     uint_fast32_t idx;
-
-    buf[0] = '\0';
+    char *s = buf;
 
     for (idx = 0; idx < N_AXIS; idx++) {
         if(idx == X_AXIS && gc_state.modal.diameter_mode)
-            strcat(buf, ftoa(axis_values[idx] * 2.0f, N_DECIMAL_COORDVALUE_MM));
+            s = ftoa_r(s, axis_values[idx] * 2.0f, N_DECIMAL_COORDVALUE_MM);
         else
-            strcat(buf, ftoa(axis_values[idx], N_DECIMAL_COORDVALUE_MM));
+            s = ftoa_r(s, axis_values[idx], N_DECIMAL_COORDVALUE_MM);
         if (idx < (N_AXIS - 1))
-            strcat(buf, ",");
+            *s++ = ',';
     }
 
     return buf;
@@ -100,16 +186,15 @@ static char *get_axis_values_mm (float *axis_values)
 static char *get_axis_values_inches (float *axis_values)
 {
     uint_fast32_t idx;
-
-    buf[0] = '\0';
+    char *s = buf;
 
     for (idx = 0; idx < N_AXIS; idx++) {
         if(idx == X_AXIS && gc_state.modal.diameter_mode)
-            strcat(buf, ftoa(axis_values[idx] * INCH_PER_MM * 2.0f, N_DECIMAL_COORDVALUE_INCH));
+            s = ftoa_r(s, axis_values[idx] * INCH_PER_MM * 2.0f, N_DECIMAL_COORDVALUE_INCH);
         else
-            strcat(buf, ftoa(axis_values[idx] * INCH_PER_MM, N_DECIMAL_COORDVALUE_INCH));
+            s = ftoa_r(s, axis_values[idx] * INCH_PER_MM, N_DECIMAL_COORDVALUE_INCH);
         if (idx < (N_AXIS - 1))
-            strcat(buf, ",");
+            *s++ = ',';
     }
 
     return buf;
@@ -163,18 +248,82 @@ inline static char *axis_signals_tostring (char *buf, axes_signals_t signals)
 void report_init (void)
 {
     current_alarm = Alarm_None;
+    status_cache.valid = false;
     get_axis_values = settings.flags.report_inches ? get_axis_values_inches : get_axis_values_mm;
     get_rate_value = settings.flags.report_inches ? get_rate_value_inch : get_rate_value_mm;
 }
 
+// Forces the cached fields of the realtime status report to be formatted again on the next report.
+void report_status_cache_invalidate (void)
+{
+    status_cache.valid = false;
+}
+
 // Handles the primary confirmation protocol response for streaming interfaces and human-feedback.
 // For every incoming line, this method responds with an 'ok' for a successful command or an
 // 'error:'  to indicate some error event with the line or some critical system error during
 // operation. Errors events can originate from the g-code parser, settings module, or asynchronously
 // from a critical error, such as a triggered hard limit. Interface should always monitor for these
 // responses.
-status_code_t report_status_message (status_code_t status_code)
+#ifdef ENABLE_ACK_COALESCING
+
+static struct {
+    bool enabled;
+    uint_fast16_t pending;  // Successful lines not yet acknowledged.
+    uint32_t responses;     // Responses since enabled, reported with errors.
+    uint32_t since;         // Time of the first pending acknowledgment, ms.
+} ack = {0};
+
+void report_ack_enable (bool on)
 {
+    ack.enabled = on;
+    ack.pending = 0;
+    ack.responses = 0;
+}
+
+void report_ack_flush (bool force)
+{
+    if(ack.pending && (force || hal.get_elapsed_ticks == NULL || hal.get_elapsed_ticks() - ack.since >= ACK_COALESCE_MS)) {
+        hal.stream.write(appendbuf(3, "ok:", uitoa((uint32_t)ack.pending), "\r\n"));
+        ack.pending = 0;
+    }
+}
+
+// $ACK=1 enables coalesced acknowledgments, the response to it is the first line counted. $ACK=0 disables them.
+status_code_t report_ack_command (char *args)
+{
+    if(!(args[0] == '=' && (args[1] == '0' || args[1] == '1') && args[2] == '\0'))
+        return Status_InvalidStatement;
+
+    report_ack_flush(true);
+    report_ack_enable(args[1] == '1');
+
+    return Status_OK;
+}
+
+#endif
+
+static status_code_t text_status_message (status_code_t status_code)
+{
+#ifdef ENABLE_ACK_COALESCING
+    if(ack.enabled) {
+        ack.responses++;
+        if(status_code == Status_OK) {
+            if(ack.pending++ == 0 && hal.get_elapsed_ticks)
+                ack.since = hal.get_elapsed_ticks();
+            if(ack.pending == ACK_COALESCE_MAX)
+                report_ack_flush(true);
+        } else {
+            report_ack_flush(true);
+            char *s = uitoa_r(strcpy(buf, "error:") + 6, (uint32_t)status_code);
+            *s++ = ':';
+            strcpy(uitoa_r(s, ack.responses), "\r\n");
+            hal.stream.write(buf);
+        }
+        return status_code;
+    }
+#endif
+
     switch(status_code) {
 
         case Status_OK: // STATUS_OK
@@ -191,7 +340,7 @@ status_code_t report_status_message (status_code_t status_code)
 
 
 // Prints alarm messages.
-alarm_code_t report_alarm_message (alarm_code_t alarm_code)
+static alarm_code_t text_alarm_message (alarm_code_t alarm_code)
 {
     current_alarm = alarm_code;
     hal.stream.write_all(appendbuf(3, "ALARM:", uitoa((uint32_t)alarm_code), "\r\n"));
@@ -200,83 +349,96 @@ alarm_code_t report_alarm_message (alarm_code_t alarm_code)
     return alarm_code;
 }
 
-// Prints feedback messages. This serves as a centralized method to provide additional
-// user feedback for things that are not of the status/alarm message protocol. These are
-// messages such as setup warnings, switch toggling, and how to exit alarms.
-// NOTE: For interfaces, messages are always placed within brackets. And if silent mode
-// is installed, the message number codes are less than zero.
-message_code_t report_feedback_message(message_code_t message_code)
+// Returns the text for a feedback message, NULL for messages handled by the driver.
+const char *report_message_text (message_code_t message_code)
 {
-    hal.stream.write_all("[MSG:");
+    const char *text = NULL;
 
     switch(message_code) {
 
         case Message_None:
-            hal.stream.write_all("");
+            text = "";
             break;
 
         case Message_CriticalEvent:
-            hal.stream.write_all("Reset to continue");
+            text = "Reset to continue";
             break;
 
         case Message_AlarmLock:
-            hal.stream.write_all("'$H'|'$X' to unlock");
+            text = "'$H'|'$X' to unlock";
             break;
 
         case Message_AlarmUnlock:
-            hal.stream.write_all("Caution: Unlocked");
+            text = "Caution: Unlocked";
             break;
 
         case Message_Enabled:
-            hal.stream.write_all("Enabled");
+            text = "Enabled";
             break;
 
         case Message_Disabled:
-            hal.stream.write_all("Disabled");
+            text = "Disabled";
             break;
 
         case Message_SafetyDoorAjar:
-            hal.stream.write_all("Check Door");
+            text = "Check Door";
             break;
 
         case Message_CheckLimits:
-            hal.stream.write_all("Check Limits");
+            text = "Check Limits";
             break;
 
         case Message_ProgramEnd:
-            hal.stream.write_all("Pgm End");
+            text = "Pgm End";
             break;
 
         case Message_RestoreDefaults:
-            hal.stream.write_all("Restoring defaults");
+            text = "Restoring defaults";
             break;
 
         case Message_SpindleRestore:
-            hal.stream.write_all("Restoring spindle");
+            text = "Restoring spindle";
             break;
 
         case Message_SleepMode:
-            hal.stream.write_all("Sleeping");
+            text = "Sleeping";
             break;
 
         case Message_EStop:
-            hal.stream.write_all("Emergency stop");
+            text = "Emergency stop";
             break;
 
         case Message_HomingCycleRequired:
-            hal.stream.write_all("Homing cycle required");
+            text = "Homing cycle required";
             break;
 
         case Message_CycleStartToRerun:
-            hal.stream.write_all("Cycle start to rerun job");
+            text = "Cycle start to rerun job";
             break;
 
         default:
-            if(hal.driver_feedback_message)
-                hal.driver_feedback_message(hal.stream.write_all);
             break;
     }
 
+    return text;
+}
+
+// Prints feedback messages. This serves as a centralized method to provide additional
+// user feedback for things that are not of the status/alarm message protocol. These are
+// messages such as setup warnings, switch toggling, and how to exit alarms.
+// NOTE: For interfaces, messages are always placed within brackets. And if silent mode
+// is installed, the message number codes are less than zero.
+static message_code_t text_feedback_message (message_code_t message_code)
+{
+    const char *text = report_message_text(message_code);
+
+    hal.stream.write_all("[MSG:");
+
+    if(text)
+        hal.stream.write_all(text);
+    else if(hal.driver_feedback_message)
+        hal.driver_feedback_message(hal.stream.write_all);
+
     hal.stream.write_all("]\r\n");
 
     return message_code;
@@ -284,7 +446,7 @@ message_code_t report_feedback_message(message_code_t message_code)
 
 
 // Welcome message
-void report_init_message (void)
+static void text_init_message (void)
 {
     override_counter = wco_counter = 0;
 #if COMPATIBILITY_LEVEL == 0
@@ -295,217 +457,254 @@ void report_init_message (void)
 }
 
 // Grbl help message
-void report_grbl_help (void)
+static void text_grbl_help (void)
 {
-    hal.stream.write("[HLP:$$ $# $G $I $N $x=val $Nx=line $J=line $SLP $C $X $H $B ~ ! ? ctrl-x]\r\n");
+    hal.stream.write("[HLP:" REPORT_HELP "]\r\n");
 }
 
 
 // Grbl settings print out.
 
-void report_uint_setting (setting_type_t n, uint32_t val)
+// Renders "$<n>=" to the static buffer, returns a pointer to the end.
+static char *setting_prefix (setting_type_t n)
 {
-    hal.stream.write(appendbuf(3, "$", uitoa((uint32_t)n), "="));
-    hal.stream.write(appendbuf(2, uitoa(val), "\r\n"));
-}
+    char *s = buf;
 
+    *s++ = '$';
+    s = uitoa_r(s, (uint32_t)n);
+    *s++ = '=';
 
-void report_float_setting (setting_type_t n, float val, uint8_t n_decimal)
-{
-    hal.stream.write(appendbuf(3, "$", uitoa((uint32_t)n), "="));
-    hal.stream.write(appendbuf(2, ftoa(val, n_decimal), "\r\n"));
+    return s;
 }
 
-void report_string_setting (setting_type_t n, char *val)
+static void text_uint_setting (setting_type_t n, uint32_t val)
 {
-    hal.stream.write(appendbuf(3, "$", uitoa((uint32_t)n), "="));
-    hal.stream.write(appendbuf(2, val, "\r\n"));
+    strcpy(uitoa_r(setting_prefix(n), val), "\r\n");
+    hal.stream.write(buf);
 }
 
-void report_grbl_settings (void)
+static void text_float_setting (setting_type_t n, float val, uint8_t n_decimal)
 {
-    uint_fast8_t idx;
-
-    // Print Grbl settings.
-    report_uint_setting(Setting_PulseMicroseconds, settings.steppers.pulse_microseconds);
-    report_uint_setting(Setting_StepperIdleLockTime, settings.steppers.idle_lock_time);
-    report_uint_setting(Setting_StepInvertMask, settings.steppers.step_invert.mask);
-    report_uint_setting(Setting_DirInvertMask, settings.steppers.dir_invert.mask);
-    report_uint_setting(Setting_InvertStepperEnable, settings.steppers.enable_invert.mask);
-    report_uint_setting(Setting_LimitPinsInvertMask, settings.limits.invert.mask);
-    if(hal.probe_configure_invert_mask)
-        report_uint_setting(Setting_InvertProbePin, settings.flags.invert_probe_pin);
-#if COMPATIBILITY_LEVEL <= 1
-    report_uint_setting(Setting_StatusReportMask, (uint32_t)settings.status_report.mask);
-#else
-    report_uint_setting(Setting_StatusReportMask, settings.status_report.mask & 0x3);
-#endif
-    report_float_setting(Setting_JunctionDeviation, settings.junction_deviation, N_DECIMAL_SETTINGVALUE);
-    report_float_setting(Setting_ArcTolerance, settings.arc_tolerance, N_DECIMAL_SETTINGVALUE);
-    report_uint_setting(Setting_ReportInches, settings.flags.report_inches);
+    strcpy(ftoa_r(setting_prefix(n), val, n_decimal), "\r\n");
+    hal.stream.write(buf);
+}
 
-#if COMPATIBILITY_LEVEL <= 1
+static void text_string_setting (setting_type_t n, char *val)
+{
+    *setting_prefix(n) = '\0';
+    hal.stream.write(buf);
+    hal.stream.write(val);
+    hal.stream.write("\r\n");
+}
 
-    report_uint_setting(Setting_ControlInvertMask, settings.control_invert.mask);
-    report_uint_setting(Setting_CoolantInvertMask, settings.coolant_invert.mask);
-    report_uint_setting(Setting_SpindleInvertMask, settings.spindle.invert.mask);
-    report_uint_setting(Setting_ControlPullUpDisableMask, settings.control_disable_pullup.mask);
-    report_uint_setting(Setting_LimitPullUpDisableMask, settings.limits.disable_pullup.mask);
-    if(hal.probe_configure_invert_mask)
-        report_uint_setting(Setting_ProbePullUpDisable, settings.flags.disable_probe_pullup);
+#ifdef ENABLE_CHUNKED_REPORTS
 
-#endif
+/*
+  Large reports are emitted one item at a time from the main loop as long as the output stream has at least
+  REPORT_CHUNK_TX_FREE characters free in its transmit buffer, so that writing the report never blocks.
+  Input is not processed while a report is in progress and the status of the command is sent when complete.
+*/
 
-    report_uint_setting(Setting_SoftLimitsEnable, settings.limits.flags.soft_enabled);
-    report_uint_setting(Setting_HardLimitsEnable, ((settings.limits.flags.hard_enabled & bit(0)) ? bit(0) | (settings.limits.flags.check_at_init ? bit(1) : 0) : 0));
-    report_uint_setting(Setting_HomingEnable, (settings.homing.flags.value & 0x0F) |
-                                               (settings.limits.flags.two_switches ? bit(4) : 0) |
-                                                (settings.homing.flags.manual ? bit(5) : 0));
-    report_uint_setting(Setting_HomingDirMask, settings.homing.dir_mask.value);
-    report_float_setting(Setting_HomingFeedRate, settings.homing.feed_rate, N_DECIMAL_SETTINGVALUE);
-    report_float_setting(Setting_HomingSeekRate, settings.homing.seek_rate, N_DECIMAL_SETTINGVALUE);
-    report_uint_setting(Setting_HomingDebounceDelay, settings.homing.debounce_delay);
-    report_float_setting(Setting_HomingPulloff, settings.homing.pulloff, N_DECIMAL_SETTINGVALUE);
+typedef bool (*report_item_ptr)(uint_fast32_t n);
 
-#if COMPATIBILITY_LEVEL <= 1
+static struct {
+    report_item_ptr item;   // Item output function of the report in progress, NULL if none.
+    uint_fast32_t n;        // Next item
+    bool status_pending;
+    status_code_t status;
+} chunk = {0};
 
-    report_float_setting(Setting_G73Retract, settings.g73_retract, N_DECIMAL_SETTINGVALUE);
-    report_uint_setting(Setting_PulseDelayMicroseconds, settings.steppers.pulse_delay_microseconds);
+// Outputs the next item, returns false when the report is complete.
+static bool report_chunk_next (void)
+{
+    if(chunk.item && !chunk.item(chunk.n++)) {
+        chunk.item = NULL;
+        if(chunk.status_pending) {
+            chunk.status_pending = false;
+            hal.report.status_message(chunk.status);
+        }
+    }
 
-#endif
+    return chunk.item != NULL;
+}
 
-    report_float_setting(Setting_RpmMax, settings.spindle.rpm_max, N_DECIMAL_RPMVALUE);
-    report_float_setting(Setting_RpmMin, settings.spindle.rpm_min, N_DECIMAL_RPMVALUE);
-    report_uint_setting(Setting_Mode, settings.flags.laser_mode ? 1 : (settings.flags.lathe_mode ? 2 : 0));
+// Starts a report, returns false if the stream cannot report its transmit buffer space.
+static bool report_chunk_start (report_item_ptr item)
+{
+    if(hal.stream.get_tx_buffer_available == NULL)
+        return false;
 
-#if COMPATIBILITY_LEVEL <= 1
+    while(report_chunk_next()); // Complete a report in progress first.
 
-    report_float_setting(Setting_PWMFreq, settings.spindle.pwm_freq, N_DECIMAL_SETTINGVALUE);
-    report_float_setting(Setting_PWMOffValue, settings.spindle.pwm_off_value, N_DECIMAL_SETTINGVALUE);
-    report_float_setting(Setting_PWMMinValue, settings.spindle.pwm_min_value, N_DECIMAL_SETTINGVALUE);
-    report_float_setting(Setting_PWMMaxValue, settings.spindle.pwm_max_value, N_DECIMAL_SETTINGVALUE);
-    report_uint_setting(Setting_StepperDeenergizeMask, settings.steppers.deenergize.mask);
-    if(hal.driver_cap.spindle_sync || hal.driver_cap.spindle_pid)
-        report_uint_setting(Setting_SpindlePPR, settings.spindle.ppr);
+    chunk.item = item;
+    chunk.n = 0;
+    report_chunk_poll();
 
-    report_uint_setting(Setting_EnableLegacyRTCommands, settings.legacy_rt_commands ? 1 : 0);
-    report_uint_setting(Setting_JogSoftLimited, settings.limits.flags.jog_soft_limited);
-    report_uint_setting(Setting_ParkingEnable, settings.parking.flags.value);
-    report_uint_setting(Setting_ParkingAxis, settings.parking.axis);
+    return true;
+}
 
-    report_uint_setting(Setting_HomingLocateCycles, settings.homing.locate_cycles);
+bool report_chunk_pending (void)
+{
+    return chunk.item != NULL;
+}
 
-    for(idx = 0 ; idx < N_AXIS ; idx++)
-        report_uint_setting((setting_type_t)(Setting_HomingCycle_1 + idx), settings.homing.cycle[idx].mask);
+void report_chunk_status (status_code_t status_code)
+{
+    if(chunk.item) {
+        chunk.status = status_code;
+        chunk.status_pending = true;
+    } else
+        hal.report.status_message(status_code);
+}
 
-    if(hal.driver_settings_report) {
-        for(idx = Setting_JogStepSpeed; idx < Setting_ParkingPulloutIncrement; idx++)
-            hal.driver_settings_report((setting_type_t)idx);
+void report_chunk_poll (void)
+{
+    if(chunk.item) {
+        if(hal.stream.get_tx_buffer_available == NULL) // Stream changed, complete the report blocking.
+            while(report_chunk_next());
+        else while(hal.stream.get_tx_buffer_available() >= REPORT_CHUNK_TX_FREE && report_chunk_next());
     }
+}
 
-    report_float_setting(Setting_ParkingPulloutIncrement, settings.parking.pullout_increment, N_DECIMAL_SETTINGVALUE);
-    report_float_setting(Setting_ParkingPulloutRate, settings.parking.pullout_rate, N_DECIMAL_SETTINGVALUE);
-    report_float_setting(Setting_ParkingTarget, settings.parking.target, N_DECIMAL_SETTINGVALUE);
-    report_float_setting(Setting_ParkingFastRate, settings.parking.rate, N_DECIMAL_SETTINGVALUE);
-    report_uint_setting(Setting_RestoreOverrides, settings.flags.restore_overrides);
-    report_uint_setting(Setting_IgnoreDoorWhenIdle, settings.flags.safety_door_ignore_when_idle);
-    report_uint_setting(Setting_SleepEnable, settings.flags.sleep_enable);
-    report_uint_setting(Setting_HoldActions, (settings.flags.disable_laser_during_hold ? bit(0) : 0) | (settings.flags.restore_after_feed_hold ? bit(1) : 0));
-    report_uint_setting(Setting_ForceInitAlarm, settings.flags.force_initialization_alarm);
-    report_uint_setting(Setting_ProbingFeedOverride, settings.flags.allow_probing_feed_override);
-
-  #ifdef ENABLE_SPINDLE_LINEARIZATION
-    for(idx = 0 ; idx < SPINDLE_NPWM_PIECES ; idx++) {
-        if(isnan(settings.spindle.pwm_piece[idx].rpm))
-            report_float_setting((setting_type_t)(Setting_LinearSpindlePiece1 + idx), settings.spindle.pwm_piece[idx].rpm, N_DECIMAL_RPMVALUE);
-        else {
-            sprintf(buf, "$%d=%f,%f,%f\r\n", (setting_type_t)(Setting_LinearSpindlePiece1 + idx), settings.spindle.pwm_piece[idx].rpm, settings.spindle.pwm_piece[idx].start, settings.spindle.pwm_piece[idx].end);
-            hal.stream.write(buf);
-        }
-    }
-  #endif
+void report_chunk_reset (void)
+{
+    chunk.item = NULL;
+    chunk.status_pending = false;
+}
 
 #endif
 
-    if(hal.driver_settings_report) {
-        for(idx = Setting_NetworkServices; idx < Setting_SpindlePGain; idx++)
-            hal.driver_settings_report((setting_type_t)idx);
-    }
+// Prints a core setting from its descriptor.
+static void report_setting (const setting_detail_t *setting)
+{
+    void *value = setting_get_value_ptr(setting);
 
-#ifdef SPINDLE_RPM_CONTROLLED
+    if(setting->is_available && !setting->is_available())
+        return;
 
-    if(hal.driver_cap.spindle_pid) {
-        report_float_setting(Setting_SpindlePGain, settings.spindle.pid.p_gain, N_DECIMAL_SETTINGVALUE);
-        report_float_setting(Setting_SpindleIGain, settings.spindle.pid.i_gain, N_DECIMAL_SETTINGVALUE);
-        report_float_setting(Setting_SpindleDGain, settings.spindle.pid.d_gain, N_DECIMAL_SETTINGVALUE);
-        report_float_setting(Setting_SpindleMaxError, settings.spindle.pid.max_error, N_DECIMAL_SETTINGVALUE);
-        report_float_setting(Setting_SpindleIMaxError, settings.spindle.pid.i_max_error, N_DECIMAL_SETTINGVALUE);
-    }
+    if(setting->report)
+        setting->report(setting->id);
+    else if(value) switch(setting->format) {
 
-#endif
+        case SettingFormat_Bool:
+            report_uint_setting(setting->id, *(bool *)value ? 1 : 0);
+            break;
 
-    if(hal.driver_cap.spindle_sync) {
-        report_float_setting(Setting_PositionPGain, settings.position.pid.p_gain, N_DECIMAL_SETTINGVALUE);
-        report_float_setting(Setting_PositionIGain, settings.position.pid.i_gain, N_DECIMAL_SETTINGVALUE);
-        report_float_setting(Setting_PositionDGain, settings.position.pid.d_gain, N_DECIMAL_SETTINGVALUE);
-        report_float_setting(Setting_PositionIMaxError, settings.position.pid.i_max_error, N_DECIMAL_SETTINGVALUE);
-    }
+        case SettingFormat_UInt8:
+        case SettingFormat_AxisMask:
+            report_uint_setting(setting->id, *(uint8_t *)value);
+            break;
+
+        case SettingFormat_UInt16:
+            report_uint_setting(setting->id, *(uint16_t *)value);
+            break;
 
-    // Print axis settings
-    uint_fast8_t set_idx, val = (uint_fast8_t)Setting_AxisSettingsBase;
-    uint_fast8_t max_set = hal.driver_settings_report ? AXIS_SETTINGS_INCREMENT : AXIS_N_SETTINGS;
-    for (set_idx = 0; set_idx < max_set; set_idx++) {
+        case SettingFormat_Float:
+            report_float_setting(setting->id, *(float *)value, setting->n_decimal);
+            break;
 
-        for (idx = 0; idx < N_AXIS; idx++) {
+        default:
+            break;
+    }
+}
 
-            switch ((axis_setting_type_t)set_idx) {
+// Prints an axis setting.
+static void report_axis_setting (axis_setting_type_t set_idx, uint_fast8_t idx)
+{
+    setting_type_t setting = (setting_type_t)(Setting_AxisSettingsBase + set_idx * AXIS_SETTINGS_INCREMENT + idx);
 
-                case AxisSetting_StepsPerMM:
-                    report_float_setting((setting_type_t)(val + idx), settings.steps_per_mm[idx], N_DECIMAL_SETTINGVALUE);
-                    break;
+    switch (set_idx) {
 
-                case AxisSetting_MaxRate:
-                    report_float_setting((setting_type_t)(val + idx), settings.max_rate[idx], N_DECIMAL_SETTINGVALUE);
-                    break;
+        case AxisSetting_StepsPerMM:
+            report_float_setting(setting, settings.steps_per_mm[idx], N_DECIMAL_SETTINGVALUE);
+            break;
 
-                case AxisSetting_Acceleration:
-                    report_float_setting((setting_type_t)(val + idx), settings.acceleration[idx] / (60.0f * 60.0f), N_DECIMAL_SETTINGVALUE);
-                    break;
+        case AxisSetting_MaxRate:
+            report_float_setting(setting, settings.max_rate[idx], N_DECIMAL_SETTINGVALUE);
+            break;
 
-                case AxisSetting_MaxTravel:
-                    report_float_setting((setting_type_t)(val + idx), -settings.max_travel[idx], N_DECIMAL_SETTINGVALUE);
-                    break;
+        case AxisSetting_Acceleration:
+            report_float_setting(setting, settings.acceleration[idx] / (60.0f * 60.0f), N_DECIMAL_SETTINGVALUE);
+            break;
+
+        case AxisSetting_MaxTravel:
+            report_float_setting(setting, -settings.max_travel[idx], N_DECIMAL_SETTINGVALUE);
+            break;
 
 #ifdef ENABLE_BACKLASH_COMPENSATION
-                case AxisSetting_Backlash:
-                    report_float_setting((setting_type_t)(val + idx), settings.backlash[idx], N_DECIMAL_SETTINGVALUE);
-                    break;
+        case AxisSetting_Backlash:
+            report_float_setting(setting, settings.backlash[idx], N_DECIMAL_SETTINGVALUE);
+            break;
 #endif
 
-                default:
-                    if(hal.driver_axis_settings_report)
-                        hal.driver_axis_settings_report((axis_setting_type_t)set_idx, idx);
-                    break;
-            }
-        }
-        val += AXIS_SETTINGS_INCREMENT;
-    }
+#ifdef ENABLE_JERK_ACCELERATION
+        case AxisSetting_Jerk:
+            report_float_setting(setting, settings.jerk[idx] / (60.0f * 60.0f * 60.0f), N_DECIMAL_SETTINGVALUE);
+            break;
+#endif
+
+#ifdef ENABLE_INPUT_SHAPING
+        case AxisSetting_ShaperFrequency:
+            report_float_setting(setting, settings.shaper_freq[idx], N_DECIMAL_SETTINGVALUE);
+            break;
+#endif
 
-    if(hal.driver_settings_report) {
-        for(idx = Setting_AxisSettingsMax + 1; idx <= Setting_SettingsMax; idx++)
-            hal.driver_settings_report((setting_type_t)idx);
+        default:
+            if(hal.driver_axis_settings_report)
+                hal.driver_axis_settings_report(set_idx, idx);
+            break;
     }
 }
 
+// Prints the setting with number id, if any. Returns false when past the last setting number.
+// Core, axis and driver settings are printed in setting number order.
+static bool report_settings_item (uint_fast32_t id)
+{
+    const setting_detail_t *setting;
+
+    if(id < Setting_AxisSettingsBase) {
+        if((setting = setting_get_details((setting_type_t)id)))
+            report_setting(setting);
+        else if(hal.driver_settings_report)
+            hal.driver_settings_report((setting_type_t)id);
+    } else if(id <= Setting_AxisSettingsMax) {
+        uint_fast16_t base_idx = id - Setting_AxisSettingsBase;
+        uint_fast8_t idx = base_idx % AXIS_SETTINGS_INCREMENT, set_idx = base_idx / AXIS_SETTINGS_INCREMENT;
+        if(idx < N_AXIS && set_idx < (hal.driver_settings_report ? AXIS_SETTINGS_INCREMENT : AXIS_N_SETTINGS))
+            report_axis_setting((axis_setting_type_t)set_idx, idx);
+    } else if(id <= Setting_SettingsMax) {
+        if(hal.driver_settings_report)
+            hal.driver_settings_report((setting_type_t)id);
+    } else
+        return false;
+
+    return true;
+}
+
+static void text_grbl_settings (void)
+{
+#ifdef ENABLE_CHUNKED_REPORTS
+    if(report_chunk_start(report_settings_item))
+        return;
+#endif
+
+    uint_fast32_t id = 0;
+
+    while(report_settings_item(id++));
+}
+
 
 // Prints current probe parameters. Upon a probe command, these parameters are updated upon a
 // successful probe or upon a failed probe with the G38.3 without errors command (if supported).
 // These values are retained until Grbl is power-cycled, whereby they will be re-zeroed.
-void report_probe_parameters (void)
+static void text_probe_parameters (void)
 {
     // Report in terms of machine position.
     float print_position[N_AXIS];
     system_convert_array_steps_to_mpos(print_position, sys_probe_position);
+#ifdef ENABLE_ROTARY_WRAP
+    system_wrap_rotary_axes(print_position);
+#endif
     hal.stream.write("[PRB:");
     hal.stream.write(get_axis_values(print_position));
     hal.stream.write(sys.flags.probe_succeeded ? ":1" : ":0");
@@ -513,7 +712,7 @@ void report_probe_parameters (void)
 }
 
 // Prints current tool offsets.
-void report_tool_offsets (void)
+static void text_tool_offsets (void)
 {
     hal.stream.write("[TLO:");
 #ifdef TOOL_LENGTH_OFFSET_AXIS
@@ -524,28 +723,31 @@ void report_tool_offsets (void)
     hal.stream.write("]\r\n");
 }
 
-// Prints Grbl NGC parameters (coordinate offsets, probing, tool table)
-void report_ngc_parameters (void)
+// Prints item n of the Grbl NGC parameters (coordinate offsets, probing, tool table).
+// Returns false when past the last item or if reading a coordinate system failed.
+static bool report_ngc_parameters_item (uint_fast32_t n)
 {
-    uint_fast8_t idx;
     float coord_data[N_AXIS];
 
-    if(gc_state.modal.scaling_active) {
-        hal.stream.write("[G51:");
-        hal.stream.write(get_axis_values(gc_get_scaling()));
-        hal.stream.write("]\r\n");
+    if(n == 0) {
+        if(gc_state.modal.scaling_active) {
+            hal.stream.write("[G51:");
+            hal.stream.write(get_axis_values(gc_get_scaling()));
+            hal.stream.write("]\r\n");
+        }
+        return true;
     }
 
-    for (idx = 0; idx < SETTING_INDEX_NCOORD; idx++) {
+    if(--n < SETTING_INDEX_NCOORD) {
 
-        if (!(settings_read_coord_data(idx, &coord_data))) {
+        if (!(settings_read_coord_data(n, &coord_data))) {
             hal.report.status_message(Status_SettingReadFail);
-            return;
+            return false;
         }
 
         hal.stream.write("[G");
 
-        switch (idx) {
+        switch (n) {
 
             case SETTING_INDEX_G28:
                 hal.stream.write("28");
@@ -556,49 +758,100 @@ void report_ngc_parameters (void)
                 break;
 
             default: // G54-G59
-                hal.stream.write(map_coord_system(idx));
+                hal.stream.write(map_coord_system(n));
                 break;
         }
         hal.stream.write(":");
         hal.stream.write(get_axis_values(coord_data));
         hal.stream.write("]\r\n");
+
+        return true;
     }
 
+    n -= SETTING_INDEX_NCOORD;
+
     // Print G92,G92.1 which are not persistent in memory
-    hal.stream.write("[G92:");
-    hal.stream.write(get_axis_values(gc_state.g92_coord_offset));
-    hal.stream.write("]\r\n");
+    if(n-- == 0) {
+        hal.stream.write("[G92:");
+        hal.stream.write(get_axis_values(gc_state.g92_coord_offset));
+        hal.stream.write("]\r\n");
+        return true;
+    }
+
 #ifdef N_TOOLS
-    for (idx = 1; idx <= N_TOOLS; idx++) {
+    if(n < N_TOOLS) {
+        tool_data_t *tool;
+  #ifdef ENABLE_SPARSE_TOOL_TABLE
+        tool_data_t tool_data;
+        if(!tool_table_read((tool_id_t)(n + 1), tool = &tool_data)) // Only stored tools are reported, the cache is not changed.
+            return true;
+  #else
+        tool = gc_get_tool_data((tool_id_t)(n + 1));
+  #endif
         hal.stream.write("[T:");
-        hal.stream.write(uitoa((uint32_t)idx));
+        hal.stream.write(uitoa((uint32_t)(n + 1)));
         hal.stream.write("|");
-        hal.stream.write(get_axis_values(tool_table[idx].offset));
+        hal.stream.write(get_axis_values(tool->offset));
         hal.stream.write("|");
         if(settings.flags.report_inches)
-            hal.stream.write(ftoa(tool_table[idx].radius * INCH_PER_MM, N_DECIMAL_COORDVALUE_INCH));
+            hal.stream.write(ftoa(tool->radius * INCH_PER_MM, N_DECIMAL_COORDVALUE_INCH));
         else
-            hal.stream.write(ftoa(tool_table[idx].radius, N_DECIMAL_COORDVALUE_MM));
+            hal.stream.write(ftoa(tool->radius, N_DECIMAL_COORDVALUE_MM));
         hal.stream.write("]\r\n");
+        return true;
     }
+
+    n -= N_TOOLS;
 #endif
 
-    report_tool_offsets();      // Print tool length offset value
-    report_probe_parameters();  // Print probe parameters. Not persistent in memory.
+    switch(n) {
+
+        case 0:
+            report_tool_offsets();      // Print tool length offset value
+            break;
+
+        case 1:
+            report_probe_parameters();  // Print probe parameters. Not persistent in memory.
+            break;
+
+#ifdef ENABLE_NGC_EXPRESSIONS
+        case 2:
+            ngc_report_parameters();    // Print assigned numbered parameters.
+            break;
+#endif
+
+        default:
+            return false;
+    }
+
+    return true;
 }
 
-// Print current gcode parser mode state
-void report_gcode_modes (void)
+// Prints Grbl NGC parameters (coordinate offsets, probing, tool table)
+static void text_ngc_parameters (void)
+{
+#ifdef ENABLE_CHUNKED_REPORTS
+    if(report_chunk_start(report_ngc_parameters_item))
+        return;
+#endif
+
+    uint_fast32_t n = 0;
+
+    while(report_ngc_parameters_item(n++));
+}
+
+// Writes the current gcode parser modes, separated by spaces.
+void report_gcode_words (stream_write_ptr write)
 {
-    hal.stream.write("[GC:G");
+    write("G");
     if (gc_state.modal.motion >= MotionMode_ProbeToward) {
-        hal.stream.write("38.");
-        hal.stream.write(uitoa((uint32_t)(gc_state.modal.motion - (MotionMode_ProbeToward - 2))));
+        write("38.");
+        write(uitoa((uint32_t)(gc_state.modal.motion - (MotionMode_ProbeToward - 2))));
     } else
-        hal.stream.write(uitoa((uint32_t)gc_state.modal.motion));
+        write(uitoa((uint32_t)gc_state.modal.motion));
 
-    hal.stream.write(" G");
-    hal.stream.write(map_coord_system(gc_state.modal.coord_system.idx));
+    write(" G");
+    write(map_coord_system(gc_state.modal.coord_system.idx));
 
 #if COMPATIBILITY_LEVEL < 10
 
@@ -611,66 +864,71 @@ void report_gcode_modes (void)
     } while(idx && !g92_active);
 
     if(g92_active)
-        hal.stream.write(" G92");
+        write(" G92");
 
 #endif
 
     if(settings.flags.lathe_mode)
-        hal.stream.write(gc_state.modal.diameter_mode ? " G7" : " G8");
+        write(gc_state.modal.diameter_mode ? " G7" : " G8");
 
-    hal.stream.write(" G");
-    hal.stream.write(uitoa((uint32_t)(gc_state.modal.plane_select + 17)));
+    write(" G");
+    write(uitoa((uint32_t)(gc_state.modal.plane_select + 17)));
 
-    hal.stream.write(gc_state.modal.units_imperial ? " G20" : " G21");
+    write(gc_state.modal.units_imperial ? " G20" : " G21");
 
-    hal.stream.write(gc_state.modal.distance_incremental ? " G91" : " G90");
+    write(gc_state.modal.distance_incremental ? " G91" : " G90");
 
-    hal.stream.write(" G");
-    hal.stream.write(uitoa((uint32_t)(94 - gc_state.modal.feed_mode)));
+    write(" G");
+    write(uitoa((uint32_t)(94 - gc_state.modal.feed_mode)));
 
     if(settings.flags.lathe_mode && hal.driver_cap.variable_spindle)
-        hal.stream.write(gc_state.modal.spindle_rpm_mode == SpindleSpeedMode_RPM ? " G97" : " G96");
+        write(gc_state.modal.spindle_rpm_mode == SpindleSpeedMode_RPM ? " G97" : " G96");
 
 #if COMPATIBILITY_LEVEL < 10
 
     if(gc_state.modal.tool_offset_mode == ToolLengthOffset_Cancel)
-        hal.stream.write(" G49");
+        write(" G49");
     else {
-        hal.stream.write(" G43");
+        write(" G43");
         if(gc_state.modal.tool_offset_mode != ToolLengthOffset_Enable)
-            hal.stream.write(gc_state.modal.tool_offset_mode == ToolLengthOffset_EnableDynamic ? ".1" : ".2");
+            write(gc_state.modal.tool_offset_mode == ToolLengthOffset_EnableDynamic ? ".1" : ".2");
     }
 
-    hal.stream.write(gc_state.canned.retract_mode == CCRetractMode_RPos ? " G99" : " G98");
+    write(gc_state.canned.retract_mode == CCRetractMode_RPos ? " G99" : " G98");
 
-    hal.stream.write(gc_state.modal.scaling_active ? " G51" : " G50");
+    write(gc_state.modal.scaling_active ? " G51" : " G50");
 
     if(gc_state.modal.scaling_active) {
         axis_signals_tostring(buf, gc_get_g51_state());
-        hal.stream.write(":");
-        hal.stream.write(buf);
+        write(":");
+        write(buf);
     }
 
 #endif
 
+#ifndef ENABLE_PATH_BLENDING
+    if(gc_state.modal.control != ControlMode_ExactPath)
+#endif
+    write(gc_state.modal.control == ControlMode_PathBlending ? " G64" : (gc_state.modal.control == ControlMode_ExactStop ? " G61.1" : " G61"));
+
     if (gc_state.modal.program_flow) {
 
         switch (gc_state.modal.program_flow) {
 
             case ProgramFlow_Paused:
-                hal.stream.write(" M0");
+                write(" M0");
                 break;
 
             case ProgramFlow_OptionalStop:
-                hal.stream.write(" M1");
+                write(" M1");
                 break;
 
             case ProgramFlow_CompletedM2:
-                hal.stream.write(" M2");
+                write(" M2");
                 break;
 
             case ProgramFlow_CompletedM30:
-                hal.stream.write(" M30");
+                write(" M30");
                 break;
 
             default:
@@ -678,53 +936,59 @@ void report_gcode_modes (void)
         }
     }
 
-    hal.stream.write(gc_state.modal.spindle.on ? (gc_state.modal.spindle.ccw ? " M4" : " M3") : " M5");
+    write(gc_state.modal.spindle.on ? (gc_state.modal.spindle.ccw ? " M4" : " M3") : " M5");
 
     if(gc_state.tool_change)
-        hal.stream.write(" M6");
+        write(" M6");
 
     if (gc_state.modal.coolant.value) {
 
         if (gc_state.modal.coolant.mist)
-             hal.stream.write(" M7");
+             write(" M7");
 
         if (gc_state.modal.coolant.flood)
-            hal.stream.write(" M8");
+            write(" M8");
 
     } else
-        hal.stream.write(" M9");
+        write(" M9");
 
     if (sys.override.control.feed_rate_disable)
-        hal.stream.write(" M50");
+        write(" M50");
 
     if (sys.override.control.spindle_rpm_disable)
-        hal.stream.write(" M51");
+        write(" M51");
 
     if (sys.override.control.feed_hold_disable)
-        hal.stream.write(" M53");
+        write(" M53");
 
     if (settings.parking.flags.enable_override_control && sys.override.control.parking_disable)
-        hal.stream.write(" M56");
+        write(" M56");
 
-    hal.stream.write(appendbuf(2, " T", uitoa((uint32_t)gc_state.tool->tool)));
+    write(appendbuf(2, " T", uitoa((uint32_t)gc_state.tool->tool)));
 
-    hal.stream.write(appendbuf(2, " F", get_rate_value(gc_state.feed_rate)));
+    write(appendbuf(2, " F", get_rate_value(gc_state.feed_rate)));
 
     if(hal.driver_cap.variable_spindle)
-        hal.stream.write(appendbuf(2, " S", ftoa(gc_state.spindle.rpm, N_DECIMAL_RPMVALUE)));
+        write(appendbuf(2, " S", ftoa(gc_state.spindle.rpm, N_DECIMAL_RPMVALUE)));
+}
 
+// Print current gcode parser mode state
+static void text_gcode_modes (void)
+{
+    hal.stream.write("[GC:");
+    report_gcode_words(hal.stream.write);
     hal.stream.write("]\r\n");
 }
 
 // Prints specified startup line
-void report_startup_line (uint8_t n, char *line)
+static void text_startup_line (uint8_t n, char *line)
 {
     hal.stream.write(appendbuf(3, "$N", uitoa((uint32_t)n), "="));
     hal.stream.write(line);
     hal.stream.write("\r\n");
 }
 
-void report_execute_startup_message (char *line, status_code_t status_code)
+static void text_execute_startup_message (char *line, status_code_t status_code)
 {
     hal.stream.write(">");
     hal.stream.write(line);
@@ -814,7 +1078,7 @@ void report_build_info (char *line)
     hal.stream.write(buf);
 
     // NOTE: Compiled values, like override increments/max/min values, may be added at some point later.
-    hal.stream.write(uitoa((uint32_t)(BLOCK_BUFFER_SIZE - 1)));
+    hal.stream.write(uitoa((uint32_t)plan_get_block_buffer_size()));
     hal.stream.write(",");
     hal.stream.write(uitoa(hal.rx_buffer_size));
     hal.stream.write(",");
@@ -863,6 +1127,68 @@ void report_build_info (char *line)
     if(settings.flags.lathe_mode)
         strcat(buf, "LATHE,");
 
+#ifdef ENABLE_BINARY_STREAM
+    strcat(buf, "BIN,");
+#endif
+
+#ifdef ENABLE_RASTER_ROWS
+    strcat(buf, "RR,");
+#endif
+
+#ifdef ENABLE_RASTER_SCAN
+    strcat(buf, "RS,");
+#endif
+
+#ifdef ENABLE_O_WORDS
+    strcat(buf, "OW,");
+#endif
+
+#ifdef ENABLE_MACROS
+    strcat(buf, "MAC,");
+#endif
+
+#ifdef ENABLE_NGC_EXPRESSIONS
+    strcat(buf, "EXPR,");
+#endif
+
+#ifdef ENABLE_LOOKAHEAD
+    strcat(buf, "LA,");
+#endif
+
+#ifdef ENABLE_POSITION_OUTPUTS
+    strcat(buf, "POUT,");
+#endif
+
+#ifdef ENABLE_JSON_REPORTS
+    strcat(buf, "JSON,");
+#endif
+#ifdef ENABLE_PERF_COUNTERS
+    strcat(buf, "PERF,");
+#endif
+#ifdef ENABLE_MOTION_TRACE
+    strcat(buf, "TRACE,");
+#endif
+#ifdef ENABLE_PROBE_GRID
+    strcat(buf, "PGRID,");
+#endif
+#ifdef ENABLE_HEIGHT_MAP
+    strcat(buf, "HMAP,");
+#endif
+#if defined(FIVE_AXIS_TABLE) || defined(FIVE_AXIS_HEAD)
+    strcat(buf, "TCP,");
+#endif
+#ifdef ENABLE_LASER_PPI
+    if(hal.laser_pulse_train)
+        strcat(buf, "PPI,");
+#endif
+#ifdef ENABLE_FOLLOWING_ERROR
+    if(hal.axis_encoder.get_position)
+        strcat(buf, "FERR,");
+#endif
+#ifdef ENABLE_JOB_STATS
+    strcat(buf, "STATS,");
+#endif
+
 #ifdef N_TOOLS
     if(hal.tool_change)
         strcat(buf, "ATC,");
@@ -905,6 +1231,30 @@ void report_build_info (char *line)
         hal.stream.write("]"  ASCII_EOL);
     }
 
+    // Power-up and last reset to ready times, ms.
+    if(hal.get_elapsed_ticks) {
+        hal.stream.write("[STARTUP:");
+        hal.stream.write(uitoa(sys_startup_time.cold_start));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(sys_startup_time.reset));
+        hal.stream.write("]"  ASCII_EOL);
+    }
+
+#ifdef ENABLE_MEMORY_USAGE
+    mem_report();
+#endif
+
+#ifdef EMULATE_EEPROM
+    // Settings write delay and age of oldest pending change, ms.
+    if(hal.eeprom.type == EEPROM_Emulated) {
+        hal.stream.write("[NVS WRITE:");
+        hal.stream.write(uitoa(hal.get_elapsed_ticks ? SETTINGS_WRITE_DELAY : 0));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(eeprom_emu_pending()));
+        hal.stream.write("]"  ASCII_EOL);
+    }
+#endif
+
     if(hal.report_options)
         hal.report_options();
 #endif
@@ -914,7 +1264,7 @@ void report_build_info (char *line)
 
 // Prints the character string line Grbl has received from the user, which has been pre-parsed,
 // and has been sent into protocol_execute_line() routine to be executed by Grbl.
-void report_echo_line_received (char *line)
+static void text_echo_line_received (char *line)
 {
     hal.stream.write("[echo: ");
     hal.stream.write(line);
@@ -927,106 +1277,154 @@ void report_echo_line_received (char *line)
  // specific needs, but the desired real-time data report must be as short as possible. This is
  // requires as it minimizes the computational overhead and allows grbl to keep running smoothly,
  // especially during g-code programs with fast, short line segments and high frequency reports (5-20Hz).
-void report_realtime_status (void)
+static void text_realtime_status (void)
 {
-    int32_t current_position[N_AXIS]; // Copy current state of the system position variable
-    float print_position[N_AXIS];
-
-    memcpy(current_position, sys_position, sizeof(sys_position));
-    system_convert_array_steps_to_mpos(print_position, current_position);
+    uint_fast8_t idx;
+    uint32_t key;
+    float wco[N_AXIS];
 
     // Report current machine state and sub-states
-    hal.stream.write_all("<");
+    key = sys.state | (sys.flags.feed_hold_pending << 12) | ((uint32_t)sys.holding_state << 16) | ((uint32_t)sys.parking_state << 20) |
+           ((uint32_t)(settings.status_report.alarm_substate ? current_alarm : Alarm_None) << 24);
 
-    switch (sys.state) {
+    if(!status_cache.valid || status_cache.state.key != key) {
 
-        case STATE_IDLE:
-            hal.stream.write_all("Idle");
-            break;
+        char *s = status_cache.state.s;
 
-        case STATE_CYCLE:
-            hal.stream.write_all("Run");
-            if(sys.flags.feed_hold_pending)
-                hal.stream.write_all(":1");
-            break;
+        status_cache.state.key = key;
 
-        case STATE_HOLD:
-            hal.stream.write_all(appendbuf(2, "Hold:", uitoa((uint32_t)(sys.holding_state - 1))));
-            break;
+        switch (sys.state) {
 
-        case STATE_JOG:
-            hal.stream.write_all("Jog");
-            break;
+            case STATE_IDLE:
+                strcpy(s, "<Idle");
+                break;
 
-        case STATE_HOMING:
-            hal.stream.write_all("Home");
-            break;
+            case STATE_CYCLE:
+                strcpy(s, sys.flags.feed_hold_pending ? "<Run:1" : "<Run");
+                break;
 
-        case STATE_ESTOP:
-        case STATE_ALARM:
-            if(settings.status_report.alarm_substate)
-                hal.stream.write_all(appendbuf(2, "Alarm:", uitoa((uint32_t)current_alarm)));
-            else
-                hal.stream.write_all("Alarm");
-            break;
+            case STATE_HOLD:
+                strcpy(s, appendbuf(2, "<Hold:", uitoa((uint32_t)(sys.holding_state - 1))));
+                break;
 
-        case STATE_CHECK_MODE:
-            hal.stream.write_all("Check");
-            break;
+            case STATE_JOG:
+                strcpy(s, "<Jog");
+                break;
 
-        case STATE_SAFETY_DOOR:
-            hal.stream.write_all(appendbuf(2, "Door:", uitoa((uint32_t)sys.parking_state)));
-            break;
+            case STATE_HOMING:
+                strcpy(s, "<Home");
+                break;
 
-        case STATE_SLEEP:
-            hal.stream.write_all("Sleep");
-            break;
+            case STATE_ESTOP:
+            case STATE_ALARM:
+                if(settings.status_report.alarm_substate)
+                    strcpy(s, appendbuf(2, "<Alarm:", uitoa((uint32_t)current_alarm)));
+                else
+                    strcpy(s, "<Alarm");
+                break;
 
-        case STATE_TOOL_CHANGE:
-            hal.stream.write_all("Tool");
-            break;
+            case STATE_CHECK_MODE:
+                strcpy(s, "<Check");
+                break;
+
+            case STATE_SAFETY_DOOR:
+                strcpy(s, appendbuf(2, "<Door:", uitoa((uint32_t)sys.parking_state)));
+                break;
+
+            case STATE_SLEEP:
+                strcpy(s, "<Sleep");
+                break;
+
+            case STATE_TOOL_CHANGE:
+                strcpy(s, "<Tool");
+                break;
+
+            default:
+                strcpy(s, "<");
+                break;
+        }
     }
 
-    uint_fast8_t idx;
-    float wco[N_AXIS];
+    status_write(status_cache.state.s);
+
+#ifdef ENABLE_WCO_MOTION_SYNC
+    if (system_get_wco(wco)) // Offsets of the motion being executed.
+        sys.report.wco = settings.status_report.work_coord_offset;
+#else
     if (!settings.status_report.machine_position || sys.report.wco) {
-        for (idx = 0; idx < N_AXIS; idx++) {
-            // Apply work coordinate offsets and tool length offset to current position.
+        for (idx = 0; idx < N_AXIS; idx++) // Apply work coordinate offsets and tool length offset to current position.
             wco[idx] = gc_get_offset(idx);
-            if (!settings.status_report.machine_position)
+    }
+#endif
+
+    int32_t position[N_AXIS];
+
+    system_get_position(&position); // Copy current state of the system position variable
+
+    // Report position, only converted and formatted when the position or work offset has changed.
+    if (!status_cache.valid || status_cache.position.mpos != settings.status_report.machine_position ||
+         memcmp(status_cache.position.steps, position, sizeof(position)) ||
+          (!settings.status_report.machine_position && memcmp(status_cache.position.wco, wco, sizeof(wco)))) {
+
+        float print_position[N_AXIS];
+
+        memcpy(status_cache.position.steps, position, sizeof(position));
+        system_convert_array_steps_to_mpos(print_position, status_cache.position.steps);
+
+        if ((status_cache.position.mpos = settings.status_report.machine_position) == Off) {
+            memcpy(status_cache.position.wco, wco, sizeof(wco));
+            for (idx = 0; idx < N_AXIS; idx++)
                 print_position[idx] -= wco[idx];
         }
+#ifdef ENABLE_ROTARY_WRAP
+        system_wrap_rotary_axes(print_position);
+#endif
+
+        strcpy(status_cache.position.s, settings.status_report.machine_position ? "|MPos:" : "|WPos:");
+        strcat(status_cache.position.s, get_axis_values(print_position));
     }
 
-    // Report position
-    hal.stream.write_all(settings.status_report.machine_position ? "|MPos:" : "|WPos:");
-    hal.stream.write_all(get_axis_values(print_position));
+    status_write(status_cache.position.s);
 
     // Returns planner and output stream buffer states.
 
     if (settings.status_report.buffer_state) {
-        hal.stream.write_all("|Bf:");
-        hal.stream.write_all(uitoa((uint32_t)plan_get_block_buffer_available()));
-        hal.stream.write_all(",");
-        hal.stream.write_all(uitoa(hal.stream.get_rx_buffer_available()));
+        status_write("|Bf:");
+        status_write_uint((uint32_t)plan_get_block_buffer_available());
+        status_write(",");
+        status_write_uint(hal.stream.get_rx_buffer_available());
+        if(hal.stream.get_rx_lines) {
+            // Flow controlled stream: planner blocks free when the lines already received are planned.
+            uint_fast16_t blocks = plan_get_block_buffer_available(), lines = hal.stream.get_rx_lines();
+            status_write(",");
+            status_write_uint((uint32_t)(blocks > lines ? blocks - lines : 0));
+        }
     }
 
     if(settings.status_report.line_numbers) {
         // Report current line number
         plan_block_t *cur_block = plan_get_current_block();
-        if (cur_block != NULL && cur_block->line_number > 0)
-            hal.stream.write_all(appendbuf(2, "|Ln:", uitoa((uint32_t)cur_block->line_number)));
+        if (cur_block != NULL && cur_block->line_number > 0) {
+            status_write("|Ln:");
+            status_write_uint((uint32_t)cur_block->line_number);
+        }
     }
 
     // Report realtime feed speed
     if(settings.status_report.feed_speed) {
         if(hal.driver_cap.variable_spindle) {
-            hal.stream.write_all(appendbuf(2, "|FS:", get_rate_value(st_get_realtime_rate())));
-            hal.stream.write_all(appendbuf(2, ",", uitoa((uint32_t)sys.spindle_rpm)));
-            if(hal.spindle_get_data /* && sys.mpg_mode */)
-                hal.stream.write_all(appendbuf(2, ",", uitoa((uint32_t)hal.spindle_get_data(SpindleData_RPM).rpm)));
-        } else
-            hal.stream.write_all(appendbuf(2, "|F:", get_rate_value(st_get_realtime_rate())));
+            status_write("|FS:");
+            status_write(get_rate_value(st_get_realtime_rate()));
+            status_write(",");
+            status_write_uint((uint32_t)sys.spindle_rpm);
+            if(hal.spindle_get_data /* && sys.mpg_mode */) {
+                status_write(",");
+                status_write_uint((uint32_t)hal.spindle_get_data(SpindleData_RPM).rpm);
+            }
+        } else {
+            status_write("|F:");
+            status_write(get_rate_value(st_get_realtime_rate()));
+        }
     }
 
     if(settings.status_report.pin_state) {
@@ -1035,11 +1433,17 @@ void report_realtime_status (void)
         control_signals_t ctrl_pin_state = hal.system_control_get_state();
         probe_state_t probe_pin_state = hal.probe_get_state();
 
-        if (lim_pin_state.value | ctrl_pin_state.value | probe_pin_state.triggered | !probe_pin_state.connected | sys.flags.block_delete_enabled) {
+        key = lim_pin_state.value | ((uint32_t)ctrl_pin_state.value << 8) | (probe_pin_state.triggered << 24) | (probe_pin_state.connected << 25) |
+               (sys.flags.block_delete_enabled << 26) | (sys.flags.optional_stop_disable << 27);
 
-            char *append = &buf[4];
+        if (status_cache.valid && status_cache.pins.key == key) {
+            if(*status_cache.pins.s)
+                status_write(status_cache.pins.s);
+        } else if (lim_pin_state.value | ctrl_pin_state.value | probe_pin_state.triggered | !probe_pin_state.connected | sys.flags.block_delete_enabled) {
 
-            strcpy(buf, "|Pn:");
+            char *append = &status_cache.pins.s[4];
+
+            strcpy(status_cache.pins.s, "|Pn:");
 
             if (probe_pin_state.triggered)
                 *append++ = 'P';
@@ -1066,8 +1470,11 @@ void report_realtime_status (void)
                     *append++ = 'O';
             }
             *append = '\0';
-            hal.stream.write_all(buf);
-        }
+            status_write(status_cache.pins.s);
+        } else
+            *status_cache.pins.s = '\0';
+
+        status_cache.pins.key = key;
     }
 
     if(settings.status_report.work_coord_offset) {
@@ -1099,19 +1506,32 @@ void report_realtime_status (void)
     if(sys.report.value || gc_state.tool_change) {
 
         if(sys.report.wco) {
-            hal.stream.write_all("|WCO:");
-            hal.stream.write_all(get_axis_values(wco));
+            if(!status_cache.valid || memcmp(status_cache.wco.wco, wco, sizeof(wco))) {
+                memcpy(status_cache.wco.wco, wco, sizeof(wco));
+                strcpy(status_cache.wco.s, "|WCO:");
+                strcat(status_cache.wco.s, get_axis_values(wco));
+            }
+            status_write(status_cache.wco.s);
         }
 
         if(sys.report.gwco) {
-            hal.stream.write_all("|WCS:G");
-            hal.stream.write_all(map_coord_system(gc_state.modal.coord_system.idx));
+            status_write("|WCS:G");
+            status_write(map_coord_system(gc_state.modal.coord_system.idx));
         }
 
         if(sys.report.overrides) {
-            hal.stream.write_all(appendbuf(2, "|Ov:", uitoa((uint32_t)sys.override.feed_rate)));
-            hal.stream.write_all(appendbuf(2, ",", uitoa((uint32_t)sys.override.rapid_rate)));
-            hal.stream.write_all(appendbuf(2, ",", uitoa((uint32_t)sys.override.spindle_rpm)));
+            key = sys.override.feed_rate | ((uint32_t)sys.override.rapid_rate << 8) | ((uint32_t)sys.override.spindle_rpm << 16);
+            if(!status_cache.valid || status_cache.overrides.key != key) {
+                status_cache.overrides.key = key;
+                char *s = status_cache.overrides.s;
+                strcpy(s, "|Ov:");
+                s = uitoa_r(s + 4, (uint32_t)sys.override.feed_rate);
+                *s++ = ',';
+                s = uitoa_r(s, (uint32_t)sys.override.rapid_rate);
+                *s++ = ',';
+                uitoa_r(s, (uint32_t)sys.override.spindle_rpm);
+            }
+            status_write(status_cache.overrides.s);
         }
 
         if(sys.report.spindle || sys.report.coolant || sys.report.tool || gc_state.tool_change) {
@@ -1136,37 +1556,51 @@ void report_realtime_status (void)
                 *append++ = 'T';
 
             *append = '\0';
-            hal.stream.write_all(buf);
+            status_write(buf);
         }
 
         if(sys.report.scaling) {
             axis_signals_tostring(buf, gc_get_g51_state());
-            hal.stream.write_all("|Sc:");
-            hal.stream.write_all(buf);
+            status_write("|Sc:");
+            status_write(buf);
         }
 
         if(sys.report.mpg_mode && hal.driver_cap.mpg_mode)
-            hal.stream.write_all(sys.mpg_mode ? "|MPG:1" : "|MPG:0");
+            status_write(sys.mpg_mode ? "|MPG:1" : "|MPG:0");
 
         if(sys.report.homed && (sys.homing.mask || settings.homing.flags.single_axis_commands || settings.homing.flags.manual)) {
             axes_signals_t homing = {sys.homing.mask ? sys.homing.mask : AXES_BITMASK};
-            hal.stream.write_all(appendbuf(2, "|H:", (homing.mask & sys.homed.mask) == homing.mask ? "1" : "0"));
-            if(settings.homing.flags.single_axis_commands)
-                hal.stream.write_all(appendbuf(2, ",", uitoa(sys.homed.mask)));
+            status_write((homing.mask & sys.homed.mask) == homing.mask ? "|H:1" : "|H:0");
+            if(settings.homing.flags.single_axis_commands) {
+                status_write(",");
+                status_write_uint(sys.homed.mask);
+            }
         }
 
         if(sys.report.xmode && settings.flags.lathe_mode)
-            hal.stream.write_all(gc_state.modal.diameter_mode ? "|D:1" : "|D:0");
+            status_write(gc_state.modal.diameter_mode ? "|D:1" : "|D:0");
 
-        if(sys.report.tool)
-            hal.stream.write_all(appendbuf(2, "|T:", uitoa((uint32_t)gc_state.tool->tool)));
+        if(sys.report.tool) {
+            status_write("|T:");
+            status_write_uint((uint32_t)gc_state.tool->tool);
+        }
     }
 
     if(hal.driver_rt_report)
-        hal.driver_rt_report(hal.stream.write_all, sys.report);
+        hal.driver_rt_report(status_write, sys.report);
+
+    status_write(">\r\n");
+    status_flush();
 
-    hal.stream.write_all(">\r\n");
+    status_cache.valid = true;
 
+    report_realtime_status_done();
+}
+
+// Requests a parser state report if the parser state has changed and clears the report flags, called by
+// report formatters when a realtime status report is completed.
+void report_realtime_status_done (void)
+{
     if(settings.status_report.parser_state) {
 
         static uint8_t tool;
@@ -1202,6 +1636,60 @@ void report_realtime_status (void)
     sys.report.wco = settings.status_report.work_coord_offset && wco_counter == 0; // Set to report on next request
 }
 
+// Called from interrupt context by the periodic timer. Requests are not queued, a report
+// not yet sent when the next period ends is only sent once.
+static void status_push_tick (void)
+{
+    system_set_exec_state_flag(EXEC_STATUS_PUSH);
+}
+
+// Prints a periodic realtime status report to the subscribed stream only.
+void report_status_push (void)
+{
+    if(status_push.period == 0)
+        return;
+
+    // Unsubscribe if the stream has been switched, periodic reports are not sent to other streams.
+    if(hal.stream.type != status_push.stream) {
+        status_push.period = 0;
+        hal.periodic_ms(0, NULL);
+        return;
+    }
+
+    // Route output for all streams to the subscribed stream while the report is formatted.
+    stream_write_ptr write_all = hal.stream.write_all;
+
+    hal.stream.write_all = hal.stream.write;
+    report_realtime_status();
+    hal.stream.write_all = write_all;
+}
+
+// $RT=<ms> subscribes the current stream to periodic status reports, $RT=0 unsubscribes.
+// NOTE: Reports are sent from the main loop, the period is not kept while it is blocked by long running commands.
+status_code_t report_status_push_command (char *args)
+{
+    float period;
+    uint_fast8_t counter = 1;
+
+    if(hal.periodic_ms == NULL)
+        return Status_InvalidStatement;
+
+    if(args[0] != '=' || !read_float(args, &counter, &period) || args[counter] != '\0')
+        return Status_BadNumberFormat;
+
+    if(!isintf(period) || (period != 0.0f && (period < (float)REPORT_PUSH_MIN_PERIOD || period > 60000.0f)))
+        return Status_InvalidStatement;
+
+    hal.periodic_ms(0, NULL);
+
+    if((status_push.period = (uint32_t)period)) {
+        status_push.stream = hal.stream.type;
+        hal.periodic_ms(status_push.period, status_push_tick);
+    }
+
+    return Status_OK;
+}
+
 
 void report_pid_log (void)
 {
@@ -1229,3 +1717,170 @@ void report_pid_log (void)
     hal.report.status_message(Status_GcodeUnsupportedCommand);
 #endif
 }
+
+// Default text formatter.
+static const HAL_report_t text_formatter = {
+    .report_status_message = text_status_message,
+    .report_alarm_message = text_alarm_message,
+    .report_feedback_message = text_feedback_message,
+    .report_init_message = text_init_message,
+    .report_grbl_help = text_grbl_help,
+    .report_grbl_settings = text_grbl_settings,
+    .report_uint_setting = text_uint_setting,
+    .report_float_setting = text_float_setting,
+    .report_string_setting = text_string_setting,
+    .report_echo_line_received = text_echo_line_received,
+    .report_realtime_status = text_realtime_status,
+    .report_probe_parameters = text_probe_parameters,
+    .report_tool_offsets = text_tool_offsets,
+    .report_ngc_parameters = text_ngc_parameters,
+    .report_gcode_modes = text_gcode_modes,
+    .report_startup_line = text_startup_line,
+    .report_execute_startup_message = text_execute_startup_message
+};
+
+static HAL_report_t formatter = {
+    .report_status_message = text_status_message,
+    .report_alarm_message = text_alarm_message,
+    .report_feedback_message = text_feedback_message,
+    .report_init_message = text_init_message,
+    .report_grbl_help = text_grbl_help,
+    .report_grbl_settings = text_grbl_settings,
+    .report_uint_setting = text_uint_setting,
+    .report_float_setting = text_float_setting,
+    .report_string_setting = text_string_setting,
+    .report_echo_line_received = text_echo_line_received,
+    .report_realtime_status = text_realtime_status,
+    .report_probe_parameters = text_probe_parameters,
+    .report_tool_offsets = text_tool_offsets,
+    .report_ngc_parameters = text_ngc_parameters,
+    .report_gcode_modes = text_gcode_modes,
+    .report_startup_line = text_startup_line,
+    .report_execute_startup_message = text_execute_startup_message
+};
+
+// Selects the report formatter, NULL selects the default text formatter.
+// Entry points not assigned by the formatter are handled by the text formatter.
+void report_set_formatter (const HAL_report_t *report)
+{
+    if(report == NULL)
+        report = &text_formatter;
+
+    formatter.report_status_message = report->report_status_message ? report->report_status_message : text_status_message;
+    formatter.report_alarm_message = report->report_alarm_message ? report->report_alarm_message : text_alarm_message;
+    formatter.report_feedback_message = report->report_feedback_message ? report->report_feedback_message : text_feedback_message;
+    formatter.report_init_message = report->report_init_message ? report->report_init_message : text_init_message;
+    formatter.report_grbl_help = report->report_grbl_help ? report->report_grbl_help : text_grbl_help;
+    formatter.report_grbl_settings = report->report_grbl_settings ? report->report_grbl_settings : text_grbl_settings;
+    formatter.report_uint_setting = report->report_uint_setting ? report->report_uint_setting : text_uint_setting;
+    formatter.report_float_setting = report->report_float_setting ? report->report_float_setting : text_float_setting;
+    formatter.report_string_setting = report->report_string_setting ? report->report_string_setting : text_string_setting;
+    formatter.report_echo_line_received = report->report_echo_line_received ? report->report_echo_line_received : text_echo_line_received;
+    formatter.report_realtime_status = report->report_realtime_status ? report->report_realtime_status : text_realtime_status;
+    formatter.report_probe_parameters = report->report_probe_parameters ? report->report_probe_parameters : text_probe_parameters;
+    formatter.report_tool_offsets = report->report_tool_offsets ? report->report_tool_offsets : text_tool_offsets;
+    formatter.report_ngc_parameters = report->report_ngc_parameters ? report->report_ngc_parameters : text_ngc_parameters;
+    formatter.report_gcode_modes = report->report_gcode_modes ? report->report_gcode_modes : text_gcode_modes;
+    formatter.report_startup_line = report->report_startup_line ? report->report_startup_line : text_startup_line;
+    formatter.report_execute_startup_message = report->report_execute_startup_message ? report->report_execute_startup_message : text_execute_startup_message;
+}
+
+// Report entry points, dispatched to the selected formatter.
+
+status_code_t report_status_message (status_code_t status_code)
+{
+    return formatter.report_status_message(status_code);
+}
+
+alarm_code_t report_alarm_message (alarm_code_t alarm_code)
+{
+    return formatter.report_alarm_message(alarm_code);
+}
+
+message_code_t report_feedback_message (message_code_t message_code)
+{
+    return formatter.report_feedback_message(message_code);
+}
+
+void report_init_message (void)
+{
+    formatter.report_init_message();
+}
+
+void report_grbl_help (void)
+{
+    formatter.report_grbl_help();
+}
+
+void report_grbl_settings (void)
+{
+    formatter.report_grbl_settings();
+}
+
+void report_uint_setting (setting_type_t n, uint32_t val)
+{
+    formatter.report_uint_setting(n, val);
+}
+
+void report_float_setting (setting_type_t n, float val, uint8_t n_decimal)
+{
+    formatter.report_float_setting(n, val, n_decimal);
+}
+
+void report_string_setting (setting_type_t n, char *val)
+{
+    formatter.report_string_setting(n, val);
+}
+
+void report_echo_line_received (char *line)
+{
+    formatter.report_echo_line_received(line);
+}
+
+#ifdef ENABLE_LINE_CHECKSUM
+
+void report_line_resend (uint32_t line_number)
+{
+    hal.stream.write(appendbuf(3, "[RESEND:", uitoa(line_number), "]\r\n"));
+}
+
+#endif
+
+void report_realtime_status (void)
+{
+    PERF_START(t);
+
+    formatter.report_realtime_status();
+
+    PERF_END(Perf_RealtimeReport, t);
+}
+
+void report_probe_parameters (void)
+{
+    formatter.report_probe_parameters();
+}
+
+void report_tool_offsets (void)
+{
+    formatter.report_tool_offsets();
+}
+
+void report_ngc_parameters (void)
+{
+    formatter.report_ngc_parameters();
+}
+
+void report_gcode_modes (void)
+{
+    formatter.report_gcode_modes();
+}
+
+void report_startup_line (uint8_t n, char *line)
+{
+    formatter.report_startup_line(n, line);
+}
+
+void report_execute_startup_message (char *line, status_code_t status_code)
+{
+    formatter.report_execute_startup_message(line, status_code);
+}
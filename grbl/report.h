@@ -24,12 +24,57 @@
 
 #include "system.h"
 
+// Size of the buffer the realtime status report is rendered into, longer reports are written in parts.
+#ifndef REPORT_STATUS_BUFFER_SIZE
+#ifdef SMALL_RAM_TARGET
+  #define REPORT_STATUS_BUFFER_SIZE 64
+#else
+  #define REPORT_STATUS_BUFFER_SIZE 200
+#endif
+#endif
+
+// Commands listed by the help message.
+// NOTE: Manually update when commands are added or changed.
+#define REPORT_HELP "$$ $# $G $I $N $x=val $Nx=line $J=line $SLP $C $X $H $B $RT=ms ~ ! ? ctrl-x"
+
+// Shortest period in milliseconds accepted for periodic status reports, see $RT.
+#ifndef REPORT_PUSH_MIN_PERIOD
+#define REPORT_PUSH_MIN_PERIOD 10
+#endif
+
+// Last alarm code reported, Alarm_None if cleared.
+extern alarm_code_t current_alarm;
+
 // Initialize reporting subsystem
 void report_init (void);
 
+// Invalidate cached fields of the realtime status report, called when settings change
+void report_status_cache_invalidate (void);
+
 // Prints system status messages.
 status_code_t report_status_message (status_code_t status_code);
 
+#ifdef ENABLE_ACK_COALESCING
+
+#ifndef ACK_COALESCE_MS
+#define ACK_COALESCE_MS 5 // Max delay of an acknowledgment, used if the driver provides hal.get_elapsed_ticks.
+#endif
+#ifndef ACK_COALESCE_MAX
+#define ACK_COALESCE_MAX 64 // Max number of lines acknowledged by a single ok:<n>.
+#endif
+
+// Enables or disables coalesced acknowledgments, pending acknowledgments are discarded.
+void report_ack_enable (bool on);
+
+// Sends pending acknowledgments as ok:<n>, unless force is set only when ACK_COALESCE_MS has elapsed since the first.
+// Without hal.get_elapsed_ticks acknowledgments are sent on each call, once per main loop pass.
+void report_ack_flush (bool force);
+
+// Executes the $ACK=<0|1> command.
+status_code_t report_ack_command (char *args);
+
+#endif
+
 // Prints system alarm messages.
 alarm_code_t report_alarm_message (alarm_code_t alarm_code);
 
@@ -44,6 +89,26 @@ void report_grbl_help();
 
 // Prints Grbl setting(s)
 void report_grbl_settings (void);
+
+#ifdef ENABLE_CHUNKED_REPORTS
+
+#ifndef REPORT_CHUNK_TX_FREE
+#define REPORT_CHUNK_TX_FREE 128 // Transmit buffer space needed for the next item of a report in progress, must exceed the longest line.
+#endif
+
+// Returns true while a $$ or $# report is being output.
+bool report_chunk_pending (void);
+
+// Sends the status of the command that started a report when the report is complete, immediately if none is in progress.
+void report_chunk_status (status_code_t status_code);
+
+// Outputs the report in progress as long as there is space in the transmit buffer, called from the main loop.
+void report_chunk_poll (void);
+
+// Discards a report in progress, called on reset.
+void report_chunk_reset (void);
+
+#endif
 void report_uint_setting (setting_type_t n, uint32_t val);
 void report_float_setting (setting_type_t n, float val, uint8_t n_decimal);
 void report_string_setting (setting_type_t n, char *val);
@@ -51,9 +116,20 @@ void report_string_setting (setting_type_t n, char *val);
 // Prints an echo of the pre-parsed line received right before execution.
 void report_echo_line_received (char *line);
 
+#ifdef ENABLE_LINE_CHECKSUM
+// Requests the sender to resend from the line number given.
+void report_line_resend (uint32_t line_number);
+#endif
+
 // Prints realtime status report.
 void report_realtime_status (void);
 
+// Prints a periodic realtime status report to the subscribed stream only.
+void report_status_push (void);
+
+// Executes the $RT command, $RT=<ms> subscribes the current stream to periodic status reports, $RT=0 unsubscribes.
+status_code_t report_status_push_command (char *args);
+
 // Prints recorded probe position.
 void report_probe_parameters (void);
 
@@ -76,4 +152,19 @@ void report_build_info (char *line);
 // Prints current PID log.
 void report_pid_log (void);
 
+// Selects the formatter for the reports above, NULL selects the default text formatter.
+void report_set_formatter (const HAL_report_t *report);
+
+// Helpers for report formatters.
+
+// Returns the text for a feedback message, NULL for messages handled by the driver.
+const char *report_message_text (message_code_t message_code);
+
+// Writes the current gcode parser modes as reported by $G, separated by spaces.
+void report_gcode_words (stream_write_ptr write);
+
+// Requests a parser state report if the parser state has changed and clears the report flags,
+// to be called when a realtime status report is completed.
+void report_realtime_status_done (void);
+
 #endif
@@ -0,0 +1,641 @@
+/*
+  report_json.c - JSON report formatter, selected by the $JSON command
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_JSON_REPORTS
+
+/*
+  Each report is a single JSON object terminated by CR LF, values are rendered straight into the
+  output buffer which is written to the stream(s) when the object is complete or the buffer is full.
+  Positions and offsets are arrays with one value per axis in the units selected by $13.
+*/
+
+static struct {
+    bool enabled;
+    bool all;       // Write to all output streams
+    bool comma;     // A value has been written to the current object or array
+    uint_fast16_t length;
+    char data[REPORT_JSON_BUFFER_SIZE];
+} json = {0};
+
+static void json_flush (void)
+{
+    if(json.length) {
+        json.data[json.length] = '\0';
+        if(hal.stream.write_n && (!json.all || hal.stream.write_all == hal.stream.write))
+            hal.stream.write_n(json.data, (uint16_t)json.length);
+        else if(json.all)
+            hal.stream.write_all(json.data);
+        else
+            hal.stream.write(json.data);
+        json.length = 0;
+    }
+}
+
+inline static void json_putc (char c)
+{
+    if(json.length == sizeof(json.data) - 1)
+        json_flush();
+
+    json.data[json.length++] = c;
+}
+
+static void json_puts (const char *s)
+{
+    char c;
+
+    while((c = *s++))
+        json_putc(c);
+}
+
+// Writes string contents with quotes, backslashes and control characters escaped.
+static void json_escaped (const char *s)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char c;
+
+    while((c = *s++)) {
+        if(c == '"' || c == '\\') {
+            json_putc('\\');
+            json_putc(c);
+        } else if((uint8_t)c < ' ') {
+            json_puts("\\u00");
+            json_putc(hex[(uint8_t)c >> 4]);
+            json_putc(hex[c & 0x0F]);
+        } else
+            json_putc(c);
+    }
+}
+
+static void json_begin (bool all)
+{
+    json.all = all;
+    json.comma = false;
+    json_putc('{');
+}
+
+static void json_end (void)
+{
+    json_puts("}\r\n");
+    json_flush();
+}
+
+// Starts a value, key is NULL for array elements.
+static void json_key (const char *key)
+{
+    if(json.comma)
+        json_putc(',');
+
+    if(key) {
+        json_putc('"');
+        json_puts(key);
+        json_puts("\":");
+    }
+
+    json.comma = true;
+}
+
+static void json_uint (const char *key, uint32_t value)
+{
+    json_key(key);
+    json_puts(uitoa(value));
+}
+
+static void json_float (const char *key, float value, uint8_t decimals)
+{
+    char *s = ftoa(value, decimals), *last = s + strlen(s) - 1;
+
+    if(*last == '.') // Not a valid JSON number.
+        *last = '\0';
+
+    json_key(key);
+    json_puts(s);
+}
+
+static void json_bool (const char *key, bool value)
+{
+    json_key(key);
+    json_puts(value ? "true" : "false");
+}
+
+static void json_string (const char *key, const char *value)
+{
+    json_key(key);
+    json_putc('"');
+    json_escaped(value);
+    json_putc('"');
+}
+
+static void json_array_begin (const char *key)
+{
+    json_key(key);
+    json_putc('[');
+    json.comma = false;
+}
+
+static void json_array_end (void)
+{
+    json_putc(']');
+    json.comma = true;
+}
+
+// Writes a length or position value in the reporting units.
+static void json_coord (const char *key, float value)
+{
+    if(settings.flags.report_inches)
+        json_float(key, value * INCH_PER_MM, N_DECIMAL_COORDVALUE_INCH);
+    else
+        json_float(key, value, N_DECIMAL_COORDVALUE_MM);
+}
+
+static void json_axes (const char *key, float *values)
+{
+    uint_fast8_t idx;
+
+    json_array_begin(key);
+
+    for(idx = 0; idx < N_AXIS; idx++)
+        json_coord(NULL, idx == X_AXIS && gc_state.modal.diameter_mode ? values[idx] * 2.0f : values[idx]);
+
+    json_array_end();
+}
+
+static void json_rate (const char *key, float value)
+{
+    json_uint(key, (uint32_t)(settings.flags.report_inches ? value * INCH_PER_MM : value));
+}
+
+static void json_axis_signals (axes_signals_t signals)
+{
+    static const char letters[] = "XYZABC";
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < N_AXIS; idx++) {
+        if(signals.mask & bit(idx))
+            json_putc(letters[idx]);
+    }
+}
+
+static status_code_t json_status_message (status_code_t status_code)
+{
+    json_begin(false);
+
+    if(status_code == Status_OK)
+        json_bool("ok", true);
+    else
+        json_uint("error", (uint32_t)status_code);
+
+    json_end();
+
+    return status_code;
+}
+
+static alarm_code_t json_alarm_message (alarm_code_t alarm_code)
+{
+    current_alarm = alarm_code;
+
+    json_begin(true);
+    json_uint("alarm", (uint32_t)alarm_code);
+    json_end();
+
+    hal.delay_ms(500, NULL); // Force delay to ensure message clears output stream buffer.
+
+    return alarm_code;
+}
+
+static message_code_t json_feedback_message (message_code_t message_code)
+{
+    const char *text = report_message_text(message_code);
+
+    json_begin(true);
+    json_uint("code", (uint32_t)message_code);
+
+    json_key("msg");
+    json_putc('"');
+    if(text)
+        json_escaped(text);
+    else if(hal.driver_feedback_message)
+        hal.driver_feedback_message(json_escaped);
+    json_putc('"');
+
+    json_end();
+
+    return message_code;
+}
+
+static void json_init_message (void)
+{
+    json_begin(true);
+#if COMPATIBILITY_LEVEL == 0
+    json_string("firmware", "GrblHAL");
+#else
+    json_string("firmware", "Grbl");
+#endif
+    json_string("version", GRBL_VERSION);
+    json_string("build", GRBL_VERSION_BUILD);
+    json_end();
+}
+
+static void json_grbl_help (void)
+{
+    json_begin(false);
+    json_string("help", REPORT_HELP);
+    json_end();
+}
+
+static void json_uint_setting (setting_type_t n, uint32_t val)
+{
+    json_begin(false);
+    json_uint("setting", (uint32_t)n);
+    json_uint("value", val);
+    json_end();
+}
+
+static void json_float_setting (setting_type_t n, float val, uint8_t n_decimal)
+{
+    json_begin(false);
+    json_uint("setting", (uint32_t)n);
+    json_float("value", val, n_decimal);
+    json_end();
+}
+
+static void json_string_setting (setting_type_t n, char *val)
+{
+    json_begin(false);
+    json_uint("setting", (uint32_t)n);
+    json_string("value", val);
+    json_end();
+}
+
+static void json_echo_line_received (char *line)
+{
+    json_begin(false);
+    json_string("echo", line);
+    json_end();
+}
+
+static void json_realtime_status (void)
+{
+    uint_fast8_t idx;
+    float position[N_AXIS], wco[N_AXIS];
+    int32_t steps[N_AXIS];
+
+    system_get_position(&steps); // Copy current state of the system position variable
+    system_convert_array_steps_to_mpos(position, steps);
+
+#ifdef ENABLE_WCO_MOTION_SYNC
+    system_get_wco(wco);
+#else
+    for (idx = 0; idx < N_AXIS; idx++)
+        wco[idx] = gc_get_offset(idx);
+#endif
+
+    json_begin(true);
+
+    switch (sys.state) {
+
+        case STATE_IDLE:
+            json_string("state", "Idle");
+            break;
+
+        case STATE_CYCLE:
+            json_string("state", "Run");
+            if(sys.flags.feed_hold_pending)
+                json_uint("sub", 1);
+            break;
+
+        case STATE_HOLD:
+            json_string("state", "Hold");
+            json_uint("sub", (uint32_t)(sys.holding_state - 1));
+            break;
+
+        case STATE_JOG:
+            json_string("state", "Jog");
+            break;
+
+        case STATE_HOMING:
+            json_string("state", "Home");
+            break;
+
+        case STATE_ESTOP:
+        case STATE_ALARM:
+            json_string("state", "Alarm");
+            json_uint("sub", (uint32_t)current_alarm);
+            break;
+
+        case STATE_CHECK_MODE:
+            json_string("state", "Check");
+            break;
+
+        case STATE_SAFETY_DOOR:
+            json_string("state", "Door");
+            json_uint("sub", (uint32_t)sys.parking_state);
+            break;
+
+        case STATE_SLEEP:
+            json_string("state", "Sleep");
+            break;
+
+        case STATE_TOOL_CHANGE:
+            json_string("state", "Tool");
+            break;
+
+        default:
+            json_string("state", "");
+            break;
+    }
+
+    if(!settings.status_report.machine_position) {
+        for (idx = 0; idx < N_AXIS; idx++)
+            position[idx] -= wco[idx];
+    }
+#ifdef ENABLE_ROTARY_WRAP
+    system_wrap_rotary_axes(position);
+#endif
+
+    json_axes(settings.status_report.machine_position ? "mpos" : "wpos", position);
+    json_axes("wco", wco);
+
+    if (settings.status_report.buffer_state) {
+        json_array_begin("bf");
+        json_uint(NULL, (uint32_t)plan_get_block_buffer_available());
+        json_uint(NULL, hal.stream.get_rx_buffer_available());
+        json_array_end();
+    }
+
+    if(settings.status_report.line_numbers) {
+        plan_block_t *cur_block = plan_get_current_block();
+        if (cur_block != NULL && cur_block->line_number > 0)
+            json_uint("ln", (uint32_t)cur_block->line_number);
+    }
+
+    if(settings.status_report.feed_speed) {
+        json_rate("f", st_get_realtime_rate());
+        if(hal.driver_cap.variable_spindle)
+            json_uint("s", (uint32_t)sys.spindle_rpm);
+    }
+
+    if(settings.status_report.pin_state) {
+
+        axes_signals_t lim_pin_state = hal.limits_get_state();
+        control_signals_t ctrl_pin_state = hal.system_control_get_state();
+        probe_state_t probe_pin_state = hal.probe_get_state();
+
+        json_key("pn");
+        json_putc('"');
+
+        if (probe_pin_state.triggered)
+            json_putc('P');
+
+        json_axis_signals(lim_pin_state);
+
+        if (ctrl_pin_state.safety_door_ajar && hal.driver_cap.safety_door)
+            json_putc('D');
+        if (ctrl_pin_state.reset)
+            json_putc('R');
+        if (ctrl_pin_state.feed_hold)
+            json_putc('H');
+        if (ctrl_pin_state.cycle_start)
+            json_putc('S');
+        if (ctrl_pin_state.e_stop)
+            json_putc('E');
+        if (ctrl_pin_state.block_delete && sys.flags.block_delete_enabled)
+            json_putc('B');
+        if (hal.driver_cap.program_stop ? ctrl_pin_state.stop_disable : sys.flags.optional_stop_disable)
+            json_putc('T');
+        if(!probe_pin_state.connected)
+            json_putc('O');
+
+        json_putc('"');
+    }
+
+    json_array_begin("ov");
+    json_uint(NULL, (uint32_t)sys.override.feed_rate);
+    json_uint(NULL, (uint32_t)sys.override.rapid_rate);
+    json_uint(NULL, (uint32_t)sys.override.spindle_rpm);
+    json_array_end();
+
+    spindle_state_t sp_state = hal.spindle_get_state();
+    coolant_state_t cl_state = hal.coolant_get_state();
+
+    json_key("a");
+    json_putc('"');
+    if (sp_state.on)
+        json_putc(sp_state.ccw ? 'C' : 'S');
+    if (cl_state.flood)
+        json_putc('F');
+    if (cl_state.mist)
+        json_putc('M');
+    if(gc_state.tool_change)
+        json_putc('T');
+    json_putc('"');
+
+    json_uint("t", (uint32_t)gc_state.tool->tool);
+
+    if(sys.homing.mask || settings.homing.flags.single_axis_commands || settings.homing.flags.manual) {
+        axes_signals_t homing = {sys.homing.mask ? sys.homing.mask : AXES_BITMASK};
+        json_bool("homed", (homing.mask & sys.homed.mask) == homing.mask);
+    }
+
+    if(hal.driver_cap.mpg_mode)
+        json_bool("mpg", sys.mpg_mode);
+
+    if(settings.flags.lathe_mode)
+        json_bool("diameter", gc_state.modal.diameter_mode);
+
+    // Driver specific fields are added as text.
+    if(hal.driver_rt_report) {
+        json_key("driver");
+        json_putc('"');
+        hal.driver_rt_report(json_escaped, sys.report);
+        json_putc('"');
+    }
+
+    json_end();
+
+    report_realtime_status_done();
+}
+
+static void json_probe_parameters (void)
+{
+    float print_position[N_AXIS];
+
+    system_convert_array_steps_to_mpos(print_position, sys_probe_position);
+#ifdef ENABLE_ROTARY_WRAP
+    system_wrap_rotary_axes(print_position);
+#endif
+
+    json_begin(false);
+    json_axes("prb", print_position);
+    json_bool("succeeded", sys.flags.probe_succeeded);
+    json_end();
+}
+
+static void json_tool_offsets (void)
+{
+    json_begin(false);
+#ifdef TOOL_LENGTH_OFFSET_AXIS
+    json_coord("tlo", gc_state.tool_length_offset[TOOL_LENGTH_OFFSET_AXIS]);
+#else
+    json_axes("tlo", gc_state.tool_length_offset);
+#endif
+    json_end();
+}
+
+static void json_ngc_parameters (void)
+{
+    uint_fast8_t idx;
+    float coord_data[N_AXIS];
+    char key[8];
+
+    json_begin(false);
+
+    for (idx = 0; idx < SETTING_INDEX_NCOORD; idx++) {
+
+        if (!(settings_read_coord_data(idx, &coord_data))) {
+            json_end();
+            hal.report.status_message(Status_SettingReadFail);
+            return;
+        }
+
+        switch (idx) {
+
+            case SETTING_INDEX_G28:
+                strcpy(key, "g28");
+                break;
+
+            case SETTING_INDEX_G30:
+                strcpy(key, "g30");
+                break;
+
+            default: // G54-G59
+                strcpy(key, "g");
+                strcat(key, uitoa((uint32_t)(idx > 5 ? 59 : idx + 54)));
+                if(idx > 5) {
+                    strcat(key, ".");
+                    strcat(key, uitoa((uint32_t)(idx - 5)));
+                }
+                break;
+        }
+
+        json_axes(key, coord_data);
+    }
+
+    // G92, G92.1 and G51 which are not persistent in memory
+    json_axes("g92", gc_state.g92_coord_offset);
+
+    if(gc_state.modal.scaling_active)
+        json_axes("g51", gc_get_scaling());
+
+    json_end();
+
+#ifdef N_TOOLS
+    uint32_t tool_id;
+    tool_data_t *tool;
+  #ifdef ENABLE_SPARSE_TOOL_TABLE
+    tool_data_t tool_data;
+  #endif
+    for (tool_id = 1; tool_id <= N_TOOLS; tool_id++) {
+  #ifdef ENABLE_SPARSE_TOOL_TABLE
+        if(!tool_table_read((tool_id_t)tool_id, tool = &tool_data))
+            continue;
+  #else
+        tool = gc_get_tool_data((tool_id_t)tool_id);
+  #endif
+        json_begin(false);
+        json_uint("tool", tool_id);
+        json_axes("offset", tool->offset);
+        json_coord("radius", tool->radius);
+        json_end();
+    }
+#endif
+
+    report_tool_offsets();      // Print tool length offset value
+    report_probe_parameters();  // Print probe parameters. Not persistent in memory.
+}
+
+static void json_gcode_modes (void)
+{
+    json_begin(false);
+    json_key("gc");
+    json_putc('"');
+    report_gcode_words(json_escaped);
+    json_putc('"');
+    json_end();
+}
+
+static void json_startup_line (uint8_t n, char *line)
+{
+    json_begin(false);
+    json_uint("startup", (uint32_t)n);
+    json_string("line", line);
+    json_end();
+}
+
+static void json_execute_startup_message (char *line, status_code_t status_code)
+{
+    json_begin(false);
+    json_string("executed", line);
+    json_uint("status", (uint32_t)status_code);
+    json_end();
+}
+
+static const HAL_report_t json_formatter = {
+    .report_status_message = json_status_message,
+    .report_alarm_message = json_alarm_message,
+    .report_feedback_message = json_feedback_message,
+    .report_init_message = json_init_message,
+    .report_grbl_help = json_grbl_help,
+    .report_uint_setting = json_uint_setting,
+    .report_float_setting = json_float_setting,
+    .report_string_setting = json_string_setting,
+    .report_echo_line_received = json_echo_line_received,
+    .report_realtime_status = json_realtime_status,
+    .report_probe_parameters = json_probe_parameters,
+    .report_tool_offsets = json_tool_offsets,
+    .report_ngc_parameters = json_ngc_parameters,
+    .report_gcode_modes = json_gcode_modes,
+    .report_startup_line = json_startup_line,
+    .report_execute_startup_message = json_execute_startup_message
+};
+
+void report_json_enable (bool on)
+{
+    if(on != json.enabled) {
+        json.enabled = on;
+        report_set_formatter(on ? &json_formatter : NULL);
+    }
+}
+
+status_code_t report_json_command (char *args)
+{
+    status_code_t retval = Status_OK;
+
+    if(args[0] == '=' && (args[1] == '0' || args[1] == '1') && args[2] == '\0') {
+        report_json_enable(args[1] == '1');
+        hal.report.feedback_message(json.enabled ? Message_Enabled : Message_Disabled);
+    } else
+        retval = Status_InvalidStatement;
+
+    return retval;
+}
+
+#endif
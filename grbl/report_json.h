@@ -0,0 +1,35 @@
+/*
+  report_json.h - JSON report formatter, selected by the $JSON command
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _REPORT_JSON_H_
+#define _REPORT_JSON_H_
+
+// Size of the buffer reports are rendered into, longer reports are written in parts.
+#ifndef REPORT_JSON_BUFFER_SIZE
+#define REPORT_JSON_BUFFER_SIZE 128
+#endif
+
+// Selects the JSON formatter or reverts to the default text formatter.
+void report_json_enable (bool on);
+
+// Executes the $JSON command, $JSON=1 selects JSON reports and $JSON=0 text reports.
+status_code_t report_json_command (char *args);
+
+#endif
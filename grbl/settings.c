@@ -28,6 +28,12 @@
 
 settings_t settings;
 
+static struct {
+    bool active;            // $BEGIN received
+    bool changed;           // a global setting was changed since
+    uint8_t reconfigure;    // setting_group_t flags of the changed settings
+} batch = {0};
+
 const settings_restore_t settings_all = {
     .defaults          = SETTINGS_RESTORE_DEFAULTS,
     .parameters        = SETTINGS_RESTORE_PARAMETERS,
@@ -42,6 +48,9 @@ const settings_t defaults = {
 
     .junction_deviation = DEFAULT_JUNCTION_DEVIATION,
     .arc_tolerance = DEFAULT_ARC_TOLERANCE,
+#ifdef ENABLE_SEGMENT_COALESCING
+    .coalescing_tolerance = DEFAULT_COALESCING_TOLERANCE,
+#endif
     .g73_retract = DEFAULT_G73_RETRACT,
 
     .legacy_rt_commands = DEFAULT_LEGACY_RTCOMMANDS,
@@ -139,12 +148,34 @@ const settings_t defaults = {
     .max_travel[X_AXIS] = (-DEFAULT_X_MAX_TRAVEL),
     .max_travel[Y_AXIS] = (-DEFAULT_Y_MAX_TRAVEL),
     .max_travel[Z_AXIS] = (-DEFAULT_Z_MAX_TRAVEL),
+#ifdef ENABLE_JERK_ACCELERATION
+    .jerk[X_AXIS] = DEFAULT_X_JERK,
+    .jerk[Y_AXIS] = DEFAULT_Y_JERK,
+    .jerk[Z_AXIS] = DEFAULT_Z_JERK,
+#endif
+#ifdef ENABLE_INPUT_SHAPING
+    .shaper_freq[X_AXIS] = DEFAULT_X_SHAPER_FREQ,
+    .shaper_freq[Y_AXIS] = DEFAULT_Y_SHAPER_FREQ,
+    .shaper_freq[Z_AXIS] = DEFAULT_Z_SHAPER_FREQ,
+    .shaper_type = DEFAULT_SHAPER_TYPE,
+    .shaper_damping = DEFAULT_SHAPER_DAMPING,
+#endif
+#ifdef ENABLE_ROTARY_WRAP
+    .rotary_wrap.mask = DEFAULT_ROTARY_WRAP_MASK,
+    .rotary_shortest.mask = DEFAULT_ROTARY_SHORTEST_PATH_MASK,
+#endif
 
   #ifdef A_AXIS
     .steps_per_mm[A_AXIS] = DEFAULT_A_STEPS_PER_MM,
     .max_rate[A_AXIS] = DEFAULT_A_MAX_RATE,
     .acceleration[A_AXIS] = DEFAULT_A_ACCELERATION,
     .max_travel[A_AXIS] = (-DEFAULT_A_MAX_TRAVEL),
+   #ifdef ENABLE_JERK_ACCELERATION
+    .jerk[A_AXIS] = DEFAULT_A_JERK,
+   #endif
+   #ifdef ENABLE_INPUT_SHAPING
+    .shaper_freq[A_AXIS] = DEFAULT_A_SHAPER_FREQ,
+   #endif
     .homing.cycle[3].mask = HOMING_CYCLE_3,
   #endif
   #ifdef B_AXIS
@@ -152,6 +183,12 @@ const settings_t defaults = {
     .max_rate[B_AXIS] = DEFAULT_B_MAX_RATE,
     .acceleration[B_AXIS] = DEFAULT_B_ACCELERATION,
     .max_travel[B_AXIS] = (-DEFAULT_B_MAX_TRAVEL),
+   #ifdef ENABLE_JERK_ACCELERATION
+    .jerk[B_AXIS] = DEFAULT_B_JERK,
+   #endif
+   #ifdef ENABLE_INPUT_SHAPING
+    .shaper_freq[B_AXIS] = DEFAULT_B_SHAPER_FREQ,
+   #endif
     .homing.cycle[4].mask = HOMING_CYCLE_4,
   #endif
   #ifdef C_AXIS
@@ -159,6 +196,12 @@ const settings_t defaults = {
     .acceleration[C_AXIS] = DEFAULT_C_ACCELERATION,
     .max_rate[C_AXIS] = DEFAULT_C_MAX_RATE,
     .max_travel[C_AXIS] = (-DEFAULT_C_MAX_TRAVEL),
+   #ifdef ENABLE_JERK_ACCELERATION
+    .jerk[C_AXIS] = DEFAULT_C_JERK,
+   #endif
+   #ifdef ENABLE_INPUT_SHAPING
+    .shaper_freq[C_AXIS] = DEFAULT_C_SHAPER_FREQ,
+   #endif
     .homing.cycle[5].mask = HOMING_CYCLE_5,
   #endif
 
@@ -191,6 +234,19 @@ bool settings_read_build_info(char *line)
     return true;
 }
 
+#ifdef ENABLE_WARM_RESET
+
+// The startup lines and the G54 coordinate data are read on every reset, they are kept in RAM after
+// the first read as they are only written by the functions below.
+static struct {
+    bool g54_valid;
+    uint8_t startup_valid; // Startup lines read, one bit per line
+    float g54[N_AXIS];
+    char startup_line[N_STARTUP_LINE][MAX_STORED_LINE_LENGTH];
+} reset_cache = {0};
+
+#endif
+
 // Write startup line to persistent storage
 void settings_write_startup_line (uint8_t idx, char *line)
 {
@@ -200,8 +256,12 @@ void settings_write_startup_line (uint8_t idx, char *line)
     protocol_buffer_synchronize(); // A startup line may contain a motion and be executing.
 #endif
 
+#ifdef ENABLE_WARM_RESET
+    bit_false(reset_cache.startup_valid, bit(idx));
+#endif
+
     if(hal.eeprom.type != EEPROM_None)
-        hal.eeprom.memcpy_to_with_checksum(EEPROM_ADDR_STARTUP_BLOCK + idx * (MAX_STORED_LINE_LENGTH + 1), (uint8_t *)line, MAX_STORED_LINE_LENGTH);
+        hal.eeprom.memcpy_to_with_checksum(EEPROM_ADDR_STARTUP_BLOCK + idx * (MAX_STORED_LINE_LENGTH + EEPROM_CHECKSUM_SIZE), (uint8_t *)line, MAX_STORED_LINE_LENGTH);
 }
 
 // Read startup line to persistent storage.
@@ -209,12 +269,25 @@ bool settings_read_startup_line (uint8_t idx, char *line)
 {
     assert(idx < N_STARTUP_LINE);
 
-    if (!(hal.eeprom.type != EEPROM_None && hal.eeprom.memcpy_from_with_checksum((uint8_t *)line, EEPROM_ADDR_STARTUP_BLOCK + idx * (MAX_STORED_LINE_LENGTH + 1), MAX_STORED_LINE_LENGTH))) {
+#ifdef ENABLE_WARM_RESET
+    if(bit_istrue(reset_cache.startup_valid, bit(idx))) {
+        memcpy(line, reset_cache.startup_line[idx], MAX_STORED_LINE_LENGTH);
+        return true;
+    }
+#endif
+
+    if (!(hal.eeprom.type != EEPROM_None && hal.eeprom.memcpy_from_with_checksum((uint8_t *)line, EEPROM_ADDR_STARTUP_BLOCK + idx * (MAX_STORED_LINE_LENGTH + EEPROM_CHECKSUM_SIZE), MAX_STORED_LINE_LENGTH))) {
         // Reset line with default value
         *line = '\0'; // Empty line
         settings_write_startup_line(idx, line);
         return false;
     }
+
+#ifdef ENABLE_WARM_RESET
+    memcpy(reset_cache.startup_line[idx], line, MAX_STORED_LINE_LENGTH);
+    bit_true(reset_cache.startup_valid, bit(idx));
+#endif
+
     return true;
 }
 
@@ -227,8 +300,13 @@ void settings_write_coord_data (uint8_t idx, float (*coord_data)[N_AXIS])
     protocol_buffer_synchronize();
 #endif
 
+#ifdef ENABLE_WARM_RESET
+    if(idx == 0)
+        reset_cache.g54_valid = false;
+#endif
+
     if(hal.eeprom.type != EEPROM_None)
-        hal.eeprom.memcpy_to_with_checksum(EEPROM_ADDR_PARAMETERS + idx * (sizeof(coord_data_t) + 1), (uint8_t *)coord_data, sizeof(coord_data_t));
+        hal.eeprom.memcpy_to_with_checksum(EEPROM_ADDR_PARAMETERS + idx * (sizeof(coord_data_t) + EEPROM_CHECKSUM_SIZE), (uint8_t *)coord_data, sizeof(coord_data_t));
 }
 
 // Read selected coordinate data from persistent storage.
@@ -236,23 +314,40 @@ bool settings_read_coord_data (uint8_t idx, float (*coord_data)[N_AXIS])
 {
     assert(idx <= SETTING_INDEX_NCOORD);
 
-    if (!(hal.eeprom.type != EEPROM_None && hal.eeprom.memcpy_from_with_checksum((uint8_t *)coord_data, EEPROM_ADDR_PARAMETERS + idx * (sizeof(coord_data_t) + 1), sizeof(coord_data_t)))) {
+#ifdef ENABLE_WARM_RESET
+    if(idx == 0 && reset_cache.g54_valid) {
+        memcpy(coord_data, reset_cache.g54, sizeof(reset_cache.g54));
+        return true;
+    }
+#endif
+
+    if (!(hal.eeprom.type != EEPROM_None && hal.eeprom.memcpy_from_with_checksum((uint8_t *)coord_data, EEPROM_ADDR_PARAMETERS + idx * (sizeof(coord_data_t) + EEPROM_CHECKSUM_SIZE), sizeof(coord_data_t)))) {
         // Reset with default zero vector
         memset(coord_data, 0, sizeof(coord_data_t));
         settings_write_coord_data(idx, coord_data);
         return false;
     }
+
+#ifdef ENABLE_WARM_RESET
+    if(idx == 0) {
+        memcpy(reset_cache.g54, coord_data, sizeof(reset_cache.g54));
+        reset_cache.g54_valid = true;
+    }
+#endif
+
     return true;
 }
 
 // Write selected tool data to persistent storage.
 bool settings_write_tool_data (tool_data_t *tool_data)
 {
-#ifdef N_TOOLS
+#if defined(N_TOOLS) && defined(ENABLE_SPARSE_TOOL_TABLE)
+    return tool_table_write(tool_data);
+#elif defined(N_TOOLS)
     assert(tool_data->tool > 0 && tool_data->tool <= N_TOOLS); // NOTE: idx 0 is a non-persistent entry for tools not in tool table
 
     if(hal.eeprom.type != EEPROM_None)
-        hal.eeprom.memcpy_to_with_checksum(EEPROM_ADDR_TOOL_TABLE + (tool_data->tool - 1) * (sizeof(tool_data_t) + 1), (uint8_t *)tool_data, sizeof(tool_data_t));
+        hal.eeprom.memcpy_to_with_checksum(EEPROM_ADDR_TOOL_TABLE + (tool_data->tool - 1) * (sizeof(tool_data_t) + EEPROM_CHECKSUM_SIZE), (uint8_t *)tool_data, sizeof(tool_data_t));
 
     return true;
 #else
@@ -261,12 +356,16 @@ bool settings_write_tool_data (tool_data_t *tool_data)
 }
 
 // Read selected tool data from persistent storage.
-bool settings_read_tool_data (uint8_t tool, tool_data_t *tool_data)
+bool settings_read_tool_data (tool_id_t tool, tool_data_t *tool_data)
 {
-#ifdef N_TOOLS
+#if defined(N_TOOLS) && defined(ENABLE_SPARSE_TOOL_TABLE)
+    tool_table_read(tool, tool_data);
+
+    return tool_data->tool == tool;
+#elif defined(N_TOOLS)
     assert(tool > 0 && tool <= N_TOOLS); // NOTE: idx 0 is a non-persistent entry for tools not in tool table
 
-    if (!(hal.eeprom.type != EEPROM_None && hal.eeprom.memcpy_from_with_checksum((uint8_t *)tool_data, EEPROM_ADDR_TOOL_TABLE + (tool - 1) * (sizeof(tool_data_t) + 1), sizeof(tool_data_t)) && tool_data->tool == tool)) {
+    if (!(hal.eeprom.type != EEPROM_None && hal.eeprom.memcpy_from_with_checksum((uint8_t *)tool_data, EEPROM_ADDR_TOOL_TABLE + (tool - 1) * (sizeof(tool_data_t) + EEPROM_CHECKSUM_SIZE), sizeof(tool_data_t)) && tool_data->tool == tool)) {
         memset(tool_data, 0, sizeof(tool_data_t));
         tool_data->tool = tool;
     }
@@ -294,6 +393,33 @@ void write_global_settings ()
 }
 
 
+// Write global settings and reconfigure the driver after a setting change
+static void settings_changed (void)
+{
+    write_global_settings();
+    system_init_travel_limits();
+    report_status_cache_invalidate();   // Positions reported depend on steps/mm
+#ifdef ENABLE_BACKLASH_COMPENSATION
+    plan_backlash_init();
+#endif
+#ifdef ENABLE_INPUT_SHAPING
+    plan_shaper_init();
+#endif
+    hal.settings_changed(&settings);
+}
+
+// Sets the mode and feature settings fixed by the machine profile, the profile takes precedence over stored settings.
+static void apply_machine_profile (void)
+{
+#ifdef PROFILE_MODE
+    settings.flags.laser_mode = PROFILE_MODE == 1;
+    settings.flags.lathe_mode = PROFILE_MODE == 2;
+#endif
+#ifdef PROFILE_PARKING
+    settings.parking.flags.value = 0;
+#endif
+}
+
 // Restore Grbl global settings to defaults and write to persistent storage
 void settings_restore (settings_restore_t restore)
 {
@@ -313,7 +439,9 @@ void settings_restore (settings_restore_t restore)
         settings.control_disable_pullup.e_stop &= hal.driver_cap.e_stop;
         settings.control_disable_pullup.stop_disable &= hal.driver_cap.program_stop;
 
+        apply_machine_profile();
         write_global_settings();
+        system_init_travel_limits();
     }
 
     if (restore.parameters) {
@@ -325,7 +453,9 @@ void settings_restore (settings_restore_t restore)
 
         settings_write_coord_data(SETTING_INDEX_G92, &coord_data); // Clear G92 offsets
 
-#ifdef N_TOOLS
+#if defined(N_TOOLS) && defined(ENABLE_SPARSE_TOOL_TABLE)
+        tool_table_restore();
+#elif defined(N_TOOLS)
         tool_data_t tool_data;
         memset(&tool_data, 0, sizeof(tool_data_t));
         for (idx = 1; idx <= N_TOOLS; idx++) {
@@ -349,468 +479,821 @@ void settings_restore (settings_restore_t restore)
     eeprom_emu_sync_physical();
 }
 
-// A helper method to set settings from command line
-status_code_t settings_store_global_setting (setting_type_t setting, char *svalue)
-{
-    uint_fast8_t set_idx = 0;
-    float value;
+// Core (non-axis) setting handlers, for settings that need validation, are stored as bitfields or have side effects.
 
-    if (!read_float(svalue, &set_idx, &value)) {
-        status_code_t status;
-        if(hal.driver_setting && (status = hal.driver_setting(setting, NAN, svalue)) != Status_Unhandled)
-            return status;
-        else
-            return Status_BadNumberFormat;
-    }
+static bool probe_available (void)
+{
+    return hal.probe_configure_invert_mask != NULL;
+}
 
 #if COMPATIBILITY_LEVEL <= 1
 
-    if (value < 0.0f && setting != Setting_ParkingTarget)
-        return Status_NegativeValue;
+static bool spindle_ppr_available (void)
+{
+    return hal.driver_cap.spindle_sync || hal.driver_cap.spindle_pid;
+}
 
 #endif
 
-    if (setting >= Setting_AxisSettingsBase && setting <= Setting_AxisSettingsMax) {
-        // Store axis configuration. Axis numbering sequence set by AXIS_SETTING defines.
-        // NOTE: Ensure the setting index corresponds to the report.c settings printout.
-        bool found = false;
-        uint_fast16_t base_idx = (uint_fast16_t)setting - (uint_fast16_t)Setting_AxisSettingsBase;
-        uint_fast8_t axis_idx = base_idx % AXIS_SETTINGS_INCREMENT;
+#ifdef SPINDLE_RPM_CONTROLLED
 
-        if(axis_idx < N_AXIS) switch((base_idx - axis_idx) / AXIS_SETTINGS_INCREMENT) {
+static bool spindle_pid_available (void)
+{
+    return hal.driver_cap.spindle_pid;
+}
 
-            case AxisSetting_StepsPerMM:
-                #ifdef MAX_STEP_RATE_HZ
-                if (value * settings.max_rate[axis_idx] > (MAX_STEP_RATE_HZ * 60.0f))
-                    return Status_MaxStepRateExceeded;
-                #endif
-                found = true;
-                settings.steps_per_mm[axis_idx] = value;
-                break;
+#endif
 
-            case AxisSetting_MaxRate:
-                #ifdef MAX_STEP_RATE_HZ
-                if (value * settings.steps_per_mm[axis_idx] > (MAX_STEP_RATE_HZ * 60.0f))
-                    return Status_MaxStepRateExceeded;
-                #endif
-                found = true;
-                settings.max_rate[axis_idx] = value;
-                break;
+static bool position_pid_available (void)
+{
+    return hal.driver_cap.spindle_sync;
+}
 
-            case AxisSetting_Acceleration:
-                found = true;
-                settings.acceleration[axis_idx] = value * 60.0f * 60.0f; // Convert to mm/min^2 for grbl internal use.
-                break;
+static status_code_t set_pulse_width (setting_type_t setting, float value, uint_fast16_t int_value, char *svalue)
+{
+    if (int_value < 3)
+        return Status_SettingStepPulseMin;
 
-            case AxisSetting_MaxTravel:
-                found = true;
-                settings.max_travel[axis_idx] = -value; // Store as negative for grbl internal use.
-                break;
+    settings.steppers.pulse_microseconds = int_value;
+
+    return Status_OK;
+}
+
+#if COMPATIBILITY_LEVEL <= 1
+
+static status_code_t set_pulse_delay (setting_type_t setting, float value, uint_fast16_t int_value, char *svalue)
+{
+    if(int_value > 0 && !hal.driver_cap.step_pulse_delay)
+        return Status_SettingDisabled;
+
+    settings.steppers.pulse_delay_microseconds = int_value;
+
+    return Status_OK;
+}
 
-#ifdef ENABLE_BACKLASH_COMPENSATION
-            case AxisSetting_Backlash:
-                found = true;
-                settings.backlash[axis_idx] = value;
-                break;
 #endif
 
-            default: // for stopping compiler warning
-                break;
-        }
+// Boolean flags stored in bitfields
+static status_code_t set_flag (setting_type_t setting, float value, uint_fast16_t int_value, char *svalue)
+{
+    bool on = int_value != 0;
 
-        if(!(found || (hal.driver_setting && hal.driver_setting(setting, value, svalue) == Status_OK)))
-            return Status_InvalidStatement;
+    switch(setting) {
 
-    } else {
-        // Store non-axis Grbl settings
-        uint_fast16_t int_value = (uint_fast16_t)truncf(value);
-        switch(setting) {
+        case Setting_InvertProbePin:
+            if(!hal.probe_configure_invert_mask)
+                return Status_SettingDisabled;
+            settings.flags.invert_probe_pin = on;
+            break;
 
-            case Setting_PulseMicroseconds:
-                if (int_value < 3)
-                    return Status_SettingStepPulseMin;
-                settings.steppers.pulse_microseconds = int_value;
-                break;
+        case Setting_ReportInches:
+            settings.flags.report_inches = on;
+            break;
+
+        case Setting_SoftLimitsEnable:
+            if (on && !settings.homing.flags.enabled)
+                return Status_SoftLimitError;
+            settings.limits.flags.soft_enabled = on;
+            break;
 
 #if COMPATIBILITY_LEVEL <= 1
 
-            case Setting_PulseDelayMicroseconds:
-                if(int_value > 0 && !hal.driver_cap.step_pulse_delay)
-                    return Status_SettingDisabled;
-                settings.steppers.pulse_delay_microseconds = int_value;
-                break;
+        case Setting_ProbePullUpDisable:
+            if(!hal.probe_configure_invert_mask)
+                return Status_SettingDisabled;
+            settings.flags.disable_probe_pullup = on;
+            break;
+
+        case Setting_JogSoftLimited:
+            if (on && !settings.homing.flags.enabled)
+                return Status_SoftLimitError;
+            settings.limits.flags.jog_soft_limited = on;
+            break;
+
+        case Setting_RestoreOverrides:
+            settings.flags.restore_overrides = on;
+            break;
+
+        case Setting_IgnoreDoorWhenIdle:
+            settings.flags.safety_door_ignore_when_idle = on;
+            break;
+
+        case Setting_SleepEnable:
+            settings.flags.sleep_enable = on;
+            break;
+
+        case Setting_ForceInitAlarm:
+            settings.flags.force_initialization_alarm = on;
+            break;
+
+        case Setting_ProbingFeedOverride:
+            settings.flags.allow_probing_feed_override = on;
+            break;
 
 #endif
 
-            case Setting_StepperIdleLockTime:
-                settings.steppers.idle_lock_time = int_value;
-                break;
+        default:
+            break;
+    }
 
-            case Setting_StepInvertMask:
-                settings.steppers.step_invert.mask = int_value & AXES_BITMASK;
-                break;
+    return Status_OK;
+}
 
-            case Setting_DirInvertMask:
-                settings.steppers.dir_invert.mask = int_value & AXES_BITMASK;
-                break;
+static void report_flag (setting_type_t setting)
+{
+    bool on = false;
 
-            case Setting_InvertStepperEnable: // Reset to ensure change. Immediate re-init may cause problems.
-                settings.steppers.enable_invert.mask = int_value & AXES_BITMASK;
-                break;
+    switch(setting) {
 
-            case Setting_LimitPinsInvertMask: // Reset to ensure change. Immediate re-init may cause problems.
-                settings.limits.invert.mask = int_value & AXES_BITMASK;
-                break;
+        case Setting_InvertProbePin:
+            on = settings.flags.invert_probe_pin;
+            break;
 
-            case Setting_InvertProbePin: // Reset to ensure change. Immediate re-init may cause problems.
-                if(!hal.probe_configure_invert_mask)
-                    return Status_SettingDisabled;
-                settings.flags.invert_probe_pin = int_value != 0;
-                hal.probe_configure_invert_mask(false);
-                break;
+        case Setting_ReportInches:
+            on = settings.flags.report_inches;
+            break;
+
+        case Setting_SoftLimitsEnable:
+            on = settings.limits.flags.soft_enabled;
+            break;
 
-            case Setting_StatusReportMask:
 #if COMPATIBILITY_LEVEL <= 1
-                settings.status_report.mask = int_value;
-#else
-                int_value &= 0x03;
-                settings.status_report.mask = (settings.status_report.mask & ~0x03) | int_value;
+
+        case Setting_ProbePullUpDisable:
+            on = settings.flags.disable_probe_pullup;
+            break;
+
+        case Setting_JogSoftLimited:
+            on = settings.limits.flags.jog_soft_limited;
+            break;
+
+        case Setting_RestoreOverrides:
+            on = settings.flags.restore_overrides;
+            break;
+
+        case Setting_IgnoreDoorWhenIdle:
+            on = settings.flags.safety_door_ignore_when_idle;
+            break;
+
+        case Setting_SleepEnable:
+            on = settings.flags.sleep_enable;
+            break;
+
+        case Setting_ForceInitAlarm:
+            on = settings.flags.force_initialization_alarm;
+            break;
+
+        case Setting_ProbingFeedOverride:
+            on = settings.flags.allow_probing_feed_override;
+            break;
+
 #endif
-                break;
 
-            case Setting_JunctionDeviation:
-                settings.junction_deviation = value;
-                break;
+        default:
+            break;
+    }
 
-            case Setting_ArcTolerance:
-                settings.arc_tolerance = value;
-                break;
+    report_uint_setting(setting, on ? 1 : 0);
+}
 
-            case Setting_ReportInches:
-                settings.flags.report_inches = int_value != 0;
-                report_init();
-                system_flag_wco_change(); // Make sure WCO is immediately updated.
-                break;
+#if COMPATIBILITY_LEVEL > 1
 
-#if COMPATIBILITY_LEVEL <= 1
+static status_code_t set_report_mask (setting_type_t setting, float value, uint_fast16_t int_value, char *svalue)
+{
+    int_value &= 0x03;
+    settings.status_report.mask = (settings.status_report.mask & ~0x03) | int_value;
 
-            case Setting_ControlInvertMask:
-                settings.control_invert.mask = int_value;
-                settings.control_invert.block_delete &= hal.driver_cap.block_delete;
-                settings.control_invert.e_stop &= hal.driver_cap.e_stop;
-                settings.control_invert.stop_disable &= hal.driver_cap.program_stop;
-                break;
+    return Status_OK;
+}
 
-            case Setting_CoolantInvertMask:
-                settings.coolant_invert.mask = int_value;
-                break;
+static void report_report_mask (setting_type_t setting)
+{
+    report_uint_setting(setting, settings.status_report.mask & 0x3);
+}
 
-            case Setting_SpindleInvertMask:
-                settings.spindle.invert.mask = int_value;
-                if(settings.spindle.invert.pwm && !hal.driver_cap.spindle_pwm_invert) {
-                    settings.spindle.invert.pwm = Off;
-                    return Status_SettingDisabled;
-                }
-                break;
+#else
 
-            case Setting_ControlPullUpDisableMask:
-                settings.control_disable_pullup.mask = int_value & 0x0F;
-                settings.control_disable_pullup.block_delete &= hal.driver_cap.block_delete;
-                settings.control_disable_pullup.e_stop &= hal.driver_cap.e_stop;
-                settings.control_disable_pullup.stop_disable &= hal.driver_cap.program_stop;
-                break;
+static status_code_t set_control_mask (setting_type_t setting, float value, uint_fast16_t int_value, char *svalue)
+{
+    control_signals_t *signals = setting == Setting_ControlInvertMask ? &settings.control_invert : &settings.control_disable_pullup;
 
-            case Setting_LimitPullUpDisableMask:
-                settings.limits.disable_pullup.mask = int_value;
-                break;
+    signals->mask = setting == Setting_ControlInvertMask ? int_value : (int_value & 0x0F);
+    signals->block_delete &= hal.driver_cap.block_delete;
+    signals->e_stop &= hal.driver_cap.e_stop;
+    signals->stop_disable &= hal.driver_cap.program_stop;
 
-            case Setting_ProbePullUpDisable:
-                if(!hal.probe_configure_invert_mask)
-                    return Status_SettingDisabled;
-                settings.flags.disable_probe_pullup = int_value != 0;
-                break;
+    return Status_OK;
+}
+
+static status_code_t set_spindle_invert (setting_type_t setting, float value, uint_fast16_t int_value, char *svalue)
+{
+    settings.spindle.invert.mask = int_value;
+    if(settings.spindle.invert.pwm && !hal.driver_cap.spindle_pwm_invert) {
+        settings.spindle.invert.pwm = Off;
+        return Status_SettingDisabled;
+    }
+
+    return Status_OK;
+}
 
+static status_code_t set_hold_actions (setting_type_t setting, float value, uint_fast16_t int_value, char *svalue)
+{
+    settings.flags.disable_laser_during_hold =  bit_istrue(int_value, bit(0));
+    settings.flags.restore_after_feed_hold =  bit_istrue(int_value, bit(1));
+
+    return Status_OK;
+}
+
+static void report_hold_actions (setting_type_t setting)
+{
+    report_uint_setting(setting, (settings.flags.disable_laser_during_hold ? bit(0) : 0) | (settings.flags.restore_after_feed_hold ? bit(1) : 0));
+}
+
+static status_code_t set_parking_enable (setting_type_t setting, float value, uint_fast16_t int_value, char *svalue)
+{
+#ifdef PROFILE_PARKING
+    if (bit_istrue(int_value, bit(0)))
+        return Status_SettingDisabled;
 #endif
+    if (bit_istrue(int_value, bit(0)))
+        settings.parking.flags.value = bit_istrue(int_value, bit(0)) ? (int_value & 0x07) : 0;
 
-            case Setting_SoftLimitsEnable:
-                if (int_value && !settings.homing.flags.enabled)
-                    return Status_SoftLimitError;
-                settings.limits.flags.soft_enabled = int_value != 0;
-                break;
+    return Status_OK;
+}
 
-            case Setting_HardLimitsEnable:
-                settings.limits.flags.hard_enabled = bit_istrue(int_value, bit(0));
+#endif
+
+static status_code_t set_hard_limits (setting_type_t setting, float value, uint_fast16_t int_value, char *svalue)
+{
+    settings.limits.flags.hard_enabled = bit_istrue(int_value, bit(0));
 #if COMPATIBILITY_LEVEL <= 1
-                settings.limits.flags.check_at_init = bit_istrue(int_value, bit(1));
+    settings.limits.flags.check_at_init = bit_istrue(int_value, bit(1));
 #endif
-                hal.limits_enable(settings.limits.flags.hard_enabled, false); // Change immediately. NOTE: Nice to have but could be problematic later.
-                break;
+
+    return Status_OK;
+}
+
+static void report_hard_limits (setting_type_t setting)
+{
+    report_uint_setting(setting, ((settings.limits.flags.hard_enabled & bit(0)) ? bit(0) | (settings.limits.flags.check_at_init ? bit(1) : 0) : 0));
+}
+
+static status_code_t set_homing_enable (setting_type_t setting, float value, uint_fast16_t int_value, char *svalue)
+{
+    if (bit_istrue(int_value, bit(0))) {
+#if COMPATIBILITY_LEVEL > 1
+        settings.homing.flags.enabled = On;
+#else
+        settings.homing.flags.value = int_value & 0x0F;
+        settings.homing.flags.manual = bit_istrue(int_value, bit(5));
+        settings.limits.flags.two_switches = bit_istrue(int_value, bit(4));
+#endif
+    } else {
+        settings.homing.flags.value = 0;
+        settings.limits.flags.soft_enabled = Off; // Force disable soft-limits.
+        settings.limits.flags.jog_soft_limited = Off;
+    }
+
+    return Status_OK;
+}
+
+static void report_homing_enable (setting_type_t setting)
+{
+    report_uint_setting(setting, (settings.homing.flags.value & 0x0F) |
+                                  (settings.limits.flags.two_switches ? bit(4) : 0) |
+                                   (settings.homing.flags.manual ? bit(5) : 0));
+}
+
+static status_code_t set_mode (setting_type_t setting, float value, uint_fast16_t int_value, char *svalue)
+{
+#ifdef PROFILE_MODE
+    if(int_value != PROFILE_MODE)
+        return Status_SettingDisabled;
+#endif
+
+    switch(int_value) {
+        case 1:
+            if(!hal.driver_cap.variable_spindle)
+                return Status_SettingDisabledLaser;
+            settings.flags.laser_mode = On;
+            settings.flags.lathe_mode = Off;
+            break;
 
 #if COMPATIBILITY_LEVEL <= 1
 
-            case Setting_JogSoftLimited:
-                if (int_value && !settings.homing.flags.enabled)
-                    return Status_SoftLimitError;
-                settings.limits.flags.jog_soft_limited = int_value != 0;
-                break;
+         case 2:
+            settings.flags.laser_mode = Off;
+            settings.flags.lathe_mode = On;
+            break;
+#endif
 
-            case Setting_RestoreOverrides:
-                settings.flags.restore_overrides = int_value != 0;
-                break;
+         default:
+            settings.flags.laser_mode = Off;
+            settings.flags.lathe_mode = Off;
+            break;
+    }
 
-            case Setting_IgnoreDoorWhenIdle:
-                settings.flags.safety_door_ignore_when_idle = int_value != 0;
-                break;
+    if(!settings.flags.lathe_mode)
+        gc_state.modal.diameter_mode = false;
 
-            case Setting_SleepEnable:
-                settings.flags.sleep_enable = int_value != 0;
-                break;
+    return Status_OK;
+}
 
-            case Setting_HoldActions:
-                settings.flags.disable_laser_during_hold =  bit_istrue(int_value, bit(0));
-                settings.flags.restore_after_feed_hold =  bit_istrue(int_value, bit(1));
-                break;
+static void report_mode (setting_type_t setting)
+{
+    report_uint_setting(setting, settings.flags.laser_mode ? 1 : (settings.flags.lathe_mode ? 2 : 0));
+}
 
-            case Setting_ForceInitAlarm:
-                settings.flags.force_initialization_alarm = int_value != 0;
-                break;
+#if COMPATIBILITY_LEVEL <= 1 && defined(ENABLE_SPINDLE_LINEARIZATION)
 
-            case Setting_ProbingFeedOverride:
-                settings.flags.allow_probing_feed_override = int_value != 0;
-                break;
+static status_code_t set_linear_piece (setting_type_t setting, float value, uint_fast16_t int_value, char *svalue)
+{
+    uint32_t idx = setting - Setting_LinearSpindlePiece1;
+    float rpm, start, end;
+
+    if(svalue[0] == '0' && svalue[1] == '\0') {
+        settings.spindle.pwm_piece[idx].rpm = NAN;
+        settings.spindle.pwm_piece[idx].start =
+        settings.spindle.pwm_piece[idx].end = 0.0f;
+    } else if(sscanf(svalue, "%f,%f,%f", &rpm, &start, &end) == 3) {
+        settings.spindle.pwm_piece[idx].rpm = rpm;
+        settings.spindle.pwm_piece[idx].start = start;
+        settings.spindle.pwm_piece[idx].end = end;
+    } else
+        return Status_InvalidStatement;
+
+    return Status_OK;
+}
+
+static void report_linear_piece (setting_type_t setting)
+{
+    char buf[40];
+    uint32_t idx = setting - Setting_LinearSpindlePiece1;
+
+    if(isnan(settings.spindle.pwm_piece[idx].rpm))
+        report_float_setting(setting, settings.spindle.pwm_piece[idx].rpm, N_DECIMAL_RPMVALUE);
+    else {
+        sprintf(buf, "%f,%f,%f", settings.spindle.pwm_piece[idx].rpm, settings.spindle.pwm_piece[idx].start, settings.spindle.pwm_piece[idx].end);
+        report_string_setting(setting, buf);
+    }
+}
 
 #endif
 
-            case Setting_HomingEnable:
-                if (bit_istrue(int_value, bit(0))) {
-#if COMPATIBILITY_LEVEL > 1
-                    settings.homing.flags.enabled = On;
+// Core settings, must be sorted by id. Settings not listed here, other than axis settings, are passed on to the driver.
+static const setting_detail_t setting_detail[] = {
+    { .id = Setting_PulseMicroseconds, .format = SettingFormat_UInt8, .offset = offsetof(settings_t, steppers.pulse_microseconds), .set = set_pulse_width },
+    { .id = Setting_StepperIdleLockTime, .format = SettingFormat_UInt8, .offset = offsetof(settings_t, steppers.idle_lock_time) },
+    { .id = Setting_StepInvertMask, .format = SettingFormat_AxisMask, .offset = offsetof(settings_t, steppers.step_invert.mask) },
+    { .id = Setting_DirInvertMask, .format = SettingFormat_AxisMask, .offset = offsetof(settings_t, steppers.dir_invert.mask) },
+    { .id = Setting_InvertStepperEnable, .format = SettingFormat_AxisMask, .offset = offsetof(settings_t, steppers.enable_invert.mask) },
+    { .id = Setting_LimitPinsInvertMask, .format = SettingFormat_AxisMask, .offset = offsetof(settings_t, limits.invert.mask) },
+    { .id = Setting_InvertProbePin, .format = SettingFormat_Custom, .group = SettingGroup_Probe, .is_available = probe_available, .set = set_flag, .report = report_flag },
+#ifdef ENABLE_SEGMENT_COALESCING
+    { .id = Setting_CoalescingTolerance, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, coalescing_tolerance) },
+#endif
+#if COMPATIBILITY_LEVEL <= 1
+    { .id = Setting_StatusReportMask, .format = SettingFormat_UInt16, .offset = offsetof(settings_t, status_report.mask) },
 #else
-                    settings.homing.flags.value = int_value & 0x0F;
-                    settings.homing.flags.manual = bit_istrue(int_value, bit(5));
-                    settings.limits.flags.two_switches = bit_istrue(int_value, bit(4));
-#endif
-                } else {
-                    settings.homing.flags.value = 0;
-                    settings.limits.flags.soft_enabled = Off; // Force disable soft-limits.
-                    settings.limits.flags.jog_soft_limited = Off;
-                }
-                break;
+    { .id = Setting_StatusReportMask, .format = SettingFormat_Custom, .set = set_report_mask, .report = report_report_mask },
+#endif
+    { .id = Setting_JunctionDeviation, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, junction_deviation) },
+    { .id = Setting_ArcTolerance, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, arc_tolerance) },
+    { .id = Setting_ReportInches, .format = SettingFormat_Custom, .group = SettingGroup_Report, .set = set_flag, .report = report_flag },
+#if COMPATIBILITY_LEVEL <= 1
+    { .id = Setting_ControlInvertMask, .format = SettingFormat_UInt16, .offset = offsetof(settings_t, control_invert.mask), .set = set_control_mask },
+    { .id = Setting_CoolantInvertMask, .format = SettingFormat_UInt8, .offset = offsetof(settings_t, coolant_invert.mask) },
+    { .id = Setting_SpindleInvertMask, .format = SettingFormat_UInt8, .offset = offsetof(settings_t, spindle.invert.mask), .set = set_spindle_invert },
+    { .id = Setting_ControlPullUpDisableMask, .format = SettingFormat_UInt16, .offset = offsetof(settings_t, control_disable_pullup.mask), .set = set_control_mask },
+    { .id = Setting_LimitPullUpDisableMask, .format = SettingFormat_UInt8, .offset = offsetof(settings_t, limits.disable_pullup.mask) },
+    { .id = Setting_ProbePullUpDisable, .format = SettingFormat_Custom, .is_available = probe_available, .set = set_flag, .report = report_flag },
+#endif
+    { .id = Setting_SoftLimitsEnable, .format = SettingFormat_Custom, .set = set_flag, .report = report_flag },
+    { .id = Setting_HardLimitsEnable, .format = SettingFormat_Custom, .group = SettingGroup_Limits, .set = set_hard_limits, .report = report_hard_limits },
+    { .id = Setting_HomingEnable, .format = SettingFormat_Custom, .set = set_homing_enable, .report = report_homing_enable },
+    { .id = Setting_HomingDirMask, .format = SettingFormat_AxisMask, .offset = offsetof(settings_t, homing.dir_mask.value) },
+    { .id = Setting_HomingFeedRate, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, homing.feed_rate) },
+    { .id = Setting_HomingSeekRate, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, homing.seek_rate) },
+    { .id = Setting_HomingDebounceDelay, .format = SettingFormat_UInt16, .offset = offsetof(settings_t, homing.debounce_delay) },
+    { .id = Setting_HomingPulloff, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, homing.pulloff) },
+#if COMPATIBILITY_LEVEL <= 1
+    { .id = Setting_G73Retract, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, g73_retract) },
+    { .id = Setting_PulseDelayMicroseconds, .format = SettingFormat_UInt8, .offset = offsetof(settings_t, steppers.pulse_delay_microseconds), .set = set_pulse_delay },
+#endif
+    { .id = Setting_RpmMax, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_RPMVALUE, .offset = offsetof(settings_t, spindle.rpm_max) },
+    { .id = Setting_RpmMin, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_RPMVALUE, .offset = offsetof(settings_t, spindle.rpm_min) },
+    { .id = Setting_Mode, .format = SettingFormat_Custom, .set = set_mode, .report = report_mode },
+#if COMPATIBILITY_LEVEL <= 1
+    { .id = Setting_PWMFreq, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, spindle.pwm_freq) },
+    { .id = Setting_PWMOffValue, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, spindle.pwm_off_value) },
+    { .id = Setting_PWMMinValue, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, spindle.pwm_min_value) },
+    { .id = Setting_PWMMaxValue, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, spindle.pwm_max_value) },
+    { .id = Setting_StepperDeenergizeMask, .format = SettingFormat_AxisMask, .offset = offsetof(settings_t, steppers.deenergize.mask) },
+    { .id = Setting_SpindlePPR, .format = SettingFormat_UInt16, .offset = offsetof(settings_t, spindle.ppr), .is_available = spindle_ppr_available },
+    { .id = Setting_EnableLegacyRTCommands, .format = SettingFormat_Bool, .offset = offsetof(settings_t, legacy_rt_commands) },
+    { .id = Setting_JogSoftLimited, .format = SettingFormat_Custom, .set = set_flag, .report = report_flag },
+    { .id = Setting_ParkingEnable, .format = SettingFormat_UInt8, .offset = offsetof(settings_t, parking.flags.value), .set = set_parking_enable },
+    { .id = Setting_ParkingAxis, .format = SettingFormat_UInt8, .offset = offsetof(settings_t, parking.axis) },
+    { .id = Setting_HomingLocateCycles, .format = SettingFormat_UInt8, .offset = offsetof(settings_t, homing.locate_cycles), .min = 1.0f, .max = 127.0f },
+    { .id = Setting_HomingCycle_1, .format = SettingFormat_UInt8, .group = SettingGroup_Homing, .offset = offsetof(settings_t, homing.cycle[0].mask) },
+    { .id = Setting_HomingCycle_2, .format = SettingFormat_UInt8, .group = SettingGroup_Homing, .offset = offsetof(settings_t, homing.cycle[1].mask) },
+    { .id = Setting_HomingCycle_3, .format = SettingFormat_UInt8, .group = SettingGroup_Homing, .offset = offsetof(settings_t, homing.cycle[2].mask) },
+  #if N_AXIS > 3
+    { .id = Setting_HomingCycle_4, .format = SettingFormat_UInt8, .group = SettingGroup_Homing, .offset = offsetof(settings_t, homing.cycle[3].mask) },
+  #endif
+  #if N_AXIS > 4
+    { .id = Setting_HomingCycle_5, .format = SettingFormat_UInt8, .group = SettingGroup_Homing, .offset = offsetof(settings_t, homing.cycle[4].mask) },
+  #endif
+  #if N_AXIS > 5
+    { .id = Setting_HomingCycle_6, .format = SettingFormat_UInt8, .group = SettingGroup_Homing, .offset = offsetof(settings_t, homing.cycle[5].mask) },
+  #endif
+    { .id = Setting_ParkingPulloutIncrement, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, parking.pullout_increment) },
+    { .id = Setting_ParkingPulloutRate, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, parking.pullout_rate) },
+    { .id = Setting_ParkingTarget, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, parking.target) },
+    { .id = Setting_ParkingFastRate, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, parking.rate) },
+    { .id = Setting_RestoreOverrides, .format = SettingFormat_Custom, .set = set_flag, .report = report_flag },
+    { .id = Setting_IgnoreDoorWhenIdle, .format = SettingFormat_Custom, .set = set_flag, .report = report_flag },
+    { .id = Setting_SleepEnable, .format = SettingFormat_Custom, .set = set_flag, .report = report_flag },
+    { .id = Setting_HoldActions, .format = SettingFormat_Custom, .set = set_hold_actions, .report = report_hold_actions },
+    { .id = Setting_ForceInitAlarm, .format = SettingFormat_Custom, .set = set_flag, .report = report_flag },
+    { .id = Setting_ProbingFeedOverride, .format = SettingFormat_Custom, .set = set_flag, .report = report_flag },
+  #ifdef ENABLE_SPINDLE_LINEARIZATION
+   #if SPINDLE_NPWM_PIECES > 0
+    { .id = Setting_LinearSpindlePiece1, .format = SettingFormat_Custom, .set = set_linear_piece, .report = report_linear_piece },
+   #endif
+   #if SPINDLE_NPWM_PIECES > 1
+    { .id = Setting_LinearSpindlePiece2, .format = SettingFormat_Custom, .set = set_linear_piece, .report = report_linear_piece },
+   #endif
+   #if SPINDLE_NPWM_PIECES > 2
+    { .id = Setting_LinearSpindlePiece3, .format = SettingFormat_Custom, .set = set_linear_piece, .report = report_linear_piece },
+   #endif
+   #if SPINDLE_NPWM_PIECES > 3
+    { .id = Setting_LinearSpindlePiece4, .format = SettingFormat_Custom, .set = set_linear_piece, .report = report_linear_piece },
+   #endif
+  #endif
+#endif
+#ifdef SPINDLE_RPM_CONTROLLED
+    { .id = Setting_SpindlePGain, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, spindle.pid.p_gain), .is_available = spindle_pid_available },
+    { .id = Setting_SpindleIGain, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, spindle.pid.i_gain), .is_available = spindle_pid_available },
+    { .id = Setting_SpindleDGain, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, spindle.pid.d_gain), .is_available = spindle_pid_available },
+    { .id = Setting_SpindleMaxError, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, spindle.pid.max_error), .is_available = spindle_pid_available },
+    { .id = Setting_SpindleIMaxError, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, spindle.pid.i_max_error), .is_available = spindle_pid_available },
+#endif
+#ifdef ENABLE_ROTARY_WRAP
+    { .id = Setting_RotaryWrapMask, .format = SettingFormat_AxisMask, .offset = offsetof(settings_t, rotary_wrap.mask) },
+    { .id = Setting_RotaryShortestPathMask, .format = SettingFormat_AxisMask, .offset = offsetof(settings_t, rotary_shortest.mask) },
+#endif
+    { .id = Setting_PositionPGain, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, position.pid.p_gain), .is_available = position_pid_available },
+    { .id = Setting_PositionIGain, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, position.pid.i_gain), .is_available = position_pid_available },
+    { .id = Setting_PositionDGain, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, position.pid.d_gain), .is_available = position_pid_available },
+    { .id = Setting_PositionIMaxError, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, position.pid.i_max_error), .is_available = position_pid_available },
+#ifdef ENABLE_INPUT_SHAPING
+    { .id = Setting_ShaperType, .format = SettingFormat_UInt8, .offset = offsetof(settings_t, shaper_type), .min = (float)InputShaper_ZV, .max = (float)InputShaper_MZV },
+    { .id = Setting_ShaperDamping, .format = SettingFormat_Float, .n_decimal = N_DECIMAL_SETTINGVALUE, .offset = offsetof(settings_t, shaper_damping), .min = 0.0f, .max = 0.5f },
+#endif
+};
 
-            case Setting_HomingDirMask:
-                settings.homing.dir_mask.value = int_value & AXES_BITMASK;
-                break;
+// Binary search, the table is sorted by id.
+const setting_detail_t *setting_get_details (setting_type_t setting)
+{
+    uint_fast16_t low = 0, high = sizeof(setting_detail) / sizeof(setting_detail_t), mid;
+
+    while(low < high) {
+        mid = (low + high) >> 1;
+        if(setting_detail[mid].id == setting)
+            return &setting_detail[mid];
+        if(setting_detail[mid].id < setting)
+            low = mid + 1;
+        else
+            high = mid;
+    }
 
-            case Setting_HomingFeedRate:
-                settings.homing.feed_rate = value;
-                break;
+    return NULL;
+}
 
-            case Setting_HomingSeekRate:
-                settings.homing.seek_rate = value;
-                break;
+void *setting_get_value_ptr (const setting_detail_t *setting)
+{
+    return setting->format == SettingFormat_Custom ? NULL : (void *)((uint8_t *)&settings + setting->offset);
+}
 
-            case Setting_HomingDebounceDelay:
-                settings.homing.debounce_delay = int_value;
-                break;
+// Default store for settings with a settings_t member.
+static status_code_t setting_set_value (const setting_detail_t *setting, float value, uint_fast16_t int_value)
+{
+    void *ptr = setting_get_value_ptr(setting);
 
-            case Setting_HomingPulloff:
-                settings.homing.pulloff = value;
-                break;
+    if(ptr == NULL)
+        return Status_InvalidStatement;
 
-#if COMPATIBILITY_LEVEL <= 1
+    if(setting->max > setting->min)
+        int_value = value < setting->min ? (uint_fast16_t)setting->min : (value > setting->max ? (uint_fast16_t)setting->max : int_value);
 
-            case Setting_EnableLegacyRTCommands:
-                settings.legacy_rt_commands = value != 0;
-                break;
+    switch(setting->format) {
 
-            case Setting_HomingLocateCycles:
-                settings.homing.locate_cycles = int_value < 1 ? 1 :(int_value > 127 ? 127 : int_value);
-                break;
+        case SettingFormat_Bool:
+            *(bool *)ptr = value != 0.0f;
+            break;
 
-            case Setting_HomingCycle_1:
-            case Setting_HomingCycle_2:
-            case Setting_HomingCycle_3:
-            case Setting_HomingCycle_4:
-            case Setting_HomingCycle_5:
-            case Setting_HomingCycle_6:
-                settings.homing.cycle[setting - Setting_HomingCycle_1].mask = int_value;
-                limits_set_homing_axes();
-                break;
+        case SettingFormat_UInt8:
+            *(uint8_t *)ptr = (uint8_t)int_value;
+            break;
 
-            case Setting_G73Retract:
-                settings.g73_retract = value;
-                break;
+        case SettingFormat_UInt16:
+            *(uint16_t *)ptr = (uint16_t)int_value;
+            break;
 
-            case Setting_PWMFreq:
-                settings.spindle.pwm_freq = value;
-                break;
+        case SettingFormat_AxisMask:
+            *(uint8_t *)ptr = (uint8_t)(int_value & AXES_BITMASK);
+            break;
 
-#endif
+        case SettingFormat_Float:
+            *(float *)ptr = setting->max > setting->min ? (value < setting->min ? setting->min : (value > setting->max ? setting->max : value)) : value;
+            break;
 
-            case Setting_RpmMax:
-                settings.spindle.rpm_max = value;
-                break;
+        default:
+            break;
+    }
 
-            case Setting_RpmMin:
-                settings.spindle.rpm_min = value;
-                break;
+    return Status_OK;
+}
 
-            case Setting_Mode:
-                switch(int_value) {
-                    case 1:
-                        if(!hal.driver_cap.variable_spindle)
-                            return Status_SettingDisabledLaser;
-                        settings.flags.laser_mode = On;
-                        settings.flags.lathe_mode = Off;
-                        break;
+// Applies the reconfiguration needed after settings in the given groups are changed.
+static void settings_reconfigure (uint8_t group)
+{
+    if(group & SettingGroup_Report) {
+        report_init();
+        system_flag_wco_change(); // Make sure WCO is immediately updated.
+    }
+
+    if(group & SettingGroup_Limits)
+        hal.limits_enable(settings.limits.flags.hard_enabled, false); // Change immediately. NOTE: Nice to have but could be problematic later.
+
+    if(group & SettingGroup_Homing)
+        limits_set_homing_axes();
+
+    if((group & SettingGroup_Probe) && hal.probe_configure_invert_mask) // Reset to ensure change. Immediate re-init may cause problems.
+        hal.probe_configure_invert_mask(false);
+}
+
+// A helper method to set settings from command line
+status_code_t settings_store_global_setting (setting_type_t setting, char *svalue)
+{
+    uint_fast8_t set_idx = 0;
+    float value;
+
+    if (!read_float(svalue, &set_idx, &value)) {
+        status_code_t status;
+        if(hal.driver_setting && (status = hal.driver_setting(setting, NAN, svalue)) != Status_Unhandled)
+            return status;
+        else
+            return Status_BadNumberFormat;
+    }
 
 #if COMPATIBILITY_LEVEL <= 1
 
-                     case 2:
-                        settings.flags.laser_mode = Off;
-                        settings.flags.lathe_mode = On;
-                        break;
+    if (value < 0.0f && setting != Setting_ParkingTarget)
+        return Status_NegativeValue;
+
 #endif
 
-                     default:
-                        settings.flags.laser_mode = Off;
-                        settings.flags.lathe_mode = Off;
-                        break;
-                }
-                if(!settings.flags.lathe_mode)
-                    gc_state.modal.diameter_mode = false;
-                break;
+    if (setting >= Setting_AxisSettingsBase && setting <= Setting_AxisSettingsMax) {
+        // Store axis configuration. Axis numbering sequence set by AXIS_SETTING defines.
+        // NOTE: Ensure the setting index corresponds to the report.c settings printout.
+        bool found = false;
+        uint_fast16_t base_idx = (uint_fast16_t)setting - (uint_fast16_t)Setting_AxisSettingsBase;
+        uint_fast8_t axis_idx = base_idx % AXIS_SETTINGS_INCREMENT;
 
-#if COMPATIBILITY_LEVEL <= 1
+        if(axis_idx < N_AXIS) switch((base_idx - axis_idx) / AXIS_SETTINGS_INCREMENT) {
 
-            case Setting_ParkingEnable:
-                if (bit_istrue(int_value, bit(0)))
-                    settings.parking.flags.value = bit_istrue(int_value, bit(0)) ? (int_value & 0x07) : 0;
+            case AxisSetting_StepsPerMM:
+                #ifdef MAX_STEP_RATE_HZ
+                if (value * settings.max_rate[axis_idx] > (MAX_STEP_RATE_HZ * 60.0f))
+                    return Status_MaxStepRateExceeded;
+                #endif
+                found = true;
+                settings.steps_per_mm[axis_idx] = value;
                 break;
 
-            case Setting_ParkingAxis:
-                settings.parking.axis = int_value;
+            case AxisSetting_MaxRate:
+                #ifdef MAX_STEP_RATE_HZ
+                if (value * settings.steps_per_mm[axis_idx] > (MAX_STEP_RATE_HZ * 60.0f))
+                    return Status_MaxStepRateExceeded;
+                #endif
+                found = true;
+                settings.max_rate[axis_idx] = value;
                 break;
 
-            case Setting_ParkingPulloutIncrement:
-                settings.parking.pullout_increment = value;
+            case AxisSetting_Acceleration:
+                found = true;
+                settings.acceleration[axis_idx] = value * 60.0f * 60.0f; // Convert to mm/min^2 for grbl internal use.
                 break;
 
-            case Setting_ParkingPulloutRate:
-                settings.parking.pullout_rate = value;
+            case AxisSetting_MaxTravel:
+                found = true;
+                settings.max_travel[axis_idx] = -value; // Store as negative for grbl internal use.
                 break;
 
-            case Setting_ParkingTarget:
-                settings.parking.target = value;
+#ifdef ENABLE_BACKLASH_COMPENSATION
+            case AxisSetting_Backlash:
+                found = true;
+                settings.backlash[axis_idx] = value;
                 break;
+#endif
 
-            case Setting_ParkingFastRate:
-                settings.parking.rate = value;
+#ifdef ENABLE_JERK_ACCELERATION
+            case AxisSetting_Jerk:
+                if(value == 0.0f)
+                    return Status_InvalidStatement;
+                found = true;
+                settings.jerk[axis_idx] = value * 60.0f * 60.0f * 60.0f; // Convert to mm/min^3 for grbl internal use.
                 break;
+#endif
 
-            case Setting_PWMOffValue:
-                settings.spindle.pwm_off_value = value;
+#ifdef ENABLE_INPUT_SHAPING
+            case AxisSetting_ShaperFrequency:
+                if(value < 0.0f)
+                    return Status_NegativeValue;
+                found = true;
+                settings.shaper_freq[axis_idx] = value;
                 break;
+#endif
 
-            case Setting_PWMMinValue:
-                settings.spindle.pwm_min_value = value;
+            default: // for stopping compiler warning
                 break;
+        }
 
-            case Setting_PWMMaxValue:
-                settings.spindle.pwm_max_value = value;
-                break;
+        if(!(found || (hal.driver_setting && hal.driver_setting(setting, value, svalue) == Status_OK)))
+            return Status_InvalidStatement;
 
-            case Setting_StepperDeenergizeMask:
-                settings.steppers.deenergize.mask = int_value & AXES_BITMASK;
-                break;
+    } else {
+        // Store non-axis Grbl settings
+        status_code_t status;
+        const setting_detail_t *detail;
+        uint_fast16_t int_value = (uint_fast16_t)truncf(value);
 
-            case Setting_SpindlePPR:
-                settings.spindle.ppr = int_value;
-                break;
+        if((detail = setting_get_details(setting)) == NULL) {
+            status = hal.driver_setting ? hal.driver_setting(setting, value, svalue) : Status_Unhandled;
+            return status == Status_Unhandled ? Status_InvalidStatement : status;
+        }
 
-#endif
+        if((status = detail->set ? detail->set(setting, value, int_value, svalue) : setting_set_value(detail, value, int_value)) != Status_OK)
+            return status;
 
-#ifdef ENABLE_SPINDLE_LINEARIZATION
+        if(batch.active)
+            batch.reconfigure |= detail->group;
+        else
+            settings_reconfigure(detail->group);
+    }
 
-            case Setting_LinearSpindlePiece1:
-            case Setting_LinearSpindlePiece2:
-            case Setting_LinearSpindlePiece3:
-            case Setting_LinearSpindlePiece4:
-                {
-                    uint32_t idx = setting - Setting_LinearSpindlePiece1;
-                    float rpm, start, end;
-
-                    if(svalue[0] == '0' && svalue[1] == '\0') {
-                        settings.spindle.pwm_piece[idx].rpm = NAN;
-                        settings.spindle.pwm_piece[idx].start =
-                        settings.spindle.pwm_piece[idx].end = 0.0f;
-                    } else if(sscanf(svalue, "%f,%f,%f", &rpm, &start, &end) == 3) {
-                        settings.spindle.pwm_piece[idx].rpm = rpm;
-                        settings.spindle.pwm_piece[idx].start = start;
-                        settings.spindle.pwm_piece[idx].end = end;
-                    } else
-                        return Status_InvalidStatement;
-                }
-                break;
+    if(batch.active)
+        batch.changed = true;
+    else
+        settings_changed();
+
+    return Status_OK;
+}
+
+void settings_batch_begin (void)
+{
+    batch.active = true;
+}
+
+void settings_batch_commit (void)
+{
+    if(batch.active) {
+        batch.active = false;
+        if(batch.changed) {
+            batch.changed = false;
+            settings_reconfigure(batch.reconfigure);
+            batch.reconfigure = SettingGroup_None;
+            settings_changed();
+        }
+    }
+}
+
+// Initialize the config subsystem
+// Layout of settings version 16, each block was followed by a single checksum byte.
+#define V16_ADDR_BUILD_INFO     942U
+#define V16_ADDR_STARTUP_BLOCK  (V16_ADDR_BUILD_INFO - 1 - N_STARTUP_LINE * (MAX_STORED_LINE_LENGTH + 1))
+#ifdef N_TOOLS
+#define V16_ADDR_TOOL_TABLE     (EEPROM_ADDR_PARAMETERS - 1 - EEPROM_TOOL_RECORDS * (sizeof(tool_data_t) + 1))
 #endif
 
-#ifdef SPINDLE_RPM_CONTROLLED
+// Reads a version 16 block, returns false if the checksum does not match.
+static bool read_v16_block (uint8_t *data, uint32_t source, uint32_t size)
+{
+    uint32_t idx;
 
-            case Setting_SpindlePGain:
-                settings.spindle.pid.p_gain = value;
-                break;
+    if(hal.eeprom.memcpy_from)
+        hal.eeprom.memcpy_from(data, source, size);
+    else for(idx = 0; idx < size; idx++)
+        data[idx] = hal.eeprom.get_byte(source + idx);
 
-            case Setting_SpindleIGain:
-                settings.spindle.pid.i_gain = value;
-                break;
+    return calc_checksum8(data, size) == hal.eeprom.get_byte(source + size);
+}
 
-            case Setting_SpindleDGain:
-                settings.spindle.pid.d_gain = value;
-                break;
+// Moves a version 16 block to its current address, a block with a bad checksum is left to be reset on first read.
+static void migrate_block (uint32_t source, uint32_t destination, uint32_t size)
+{
+    uint8_t *data;
 
-            case Setting_SpindleMaxError:
-                settings.spindle.pid.max_error = value;
-                break;
+    if((data = mem_alloc(size)) == NULL)
+        return;
 
-            case Setting_SpindleIMaxError:
-                settings.spindle.pid.i_max_error = value;
-                break;
+    if(read_v16_block(data, source, size))
+        hal.eeprom.memcpy_to_with_checksum(destination, data, size);
 
+    mem_free(data);
+}
+
+// Converts settings stored by version 16 to the current layout where blocks have a CRC-16 instead of a checksum byte.
+// Blocks moving down are moved in ascending and blocks moving up in descending address order, so that no block
+// is overwritten before it is moved. The version byte is written last, an interrupted conversion is thus restarted.
+static void settings_migrate (void)
+{
+    uint_fast8_t idx;
+
+    // The global settings are converted in place, these carry the version too.
+    if(read_v16_block((uint8_t *)&settings, EEPROM_ADDR_GLOBAL, sizeof(settings_t))) {
+        settings.version = SETTINGS_VERSION;
+        hal.eeprom.memcpy_to_with_checksum(EEPROM_ADDR_GLOBAL, (uint8_t *)&settings, sizeof(settings_t));
+    }
+
+    // A driver area below the tool table or the parameters is claimed right below them.
+    if(hal.eeprom.driver_area.size && hal.eeprom.driver_area.address < GRBL_EEPROM_SIZE)
+#ifdef N_TOOLS
+        migrate_block(hal.eeprom.driver_area.address + V16_ADDR_TOOL_TABLE - EEPROM_ADDR_TOOL_TABLE, hal.eeprom.driver_area.address, hal.eeprom.driver_area.size);
+#else
+        migrate_block(hal.eeprom.driver_area.address, hal.eeprom.driver_area.address, hal.eeprom.driver_area.size);
 #endif
 
-            case Setting_PositionPGain:
-                settings.position.pid.p_gain = value;
-                break;
+#ifdef N_TOOLS
+    for(idx = 0; idx < EEPROM_TOOL_RECORDS; idx++)
+        migrate_block(V16_ADDR_TOOL_TABLE + idx * (sizeof(tool_data_t) + 1), EEPROM_ADDR_TOOL_TABLE + idx * (sizeof(tool_data_t) + EEPROM_CHECKSUM_SIZE), sizeof(tool_data_t));
+#endif
 
-            case Setting_PositionIGain:
-                settings.position.pid.i_gain = value;
-                break;
+#if defined(ENABLE_MACROS) || defined(ENABLE_JOB_STATS)
+    uint32_t address = GRBL_EEPROM_SIZE, v16_address = GRBL_EEPROM_SIZE;
+  #ifdef ENABLE_MACROS
+    uint32_t macros_address = 0, v16_macros_address = 0;
+  #endif
 
-            case Setting_PositionDGain:
-                settings.position.pid.d_gain = value;
-                break;
+    // Macros and job statistics are stored after a driver area above the settings, see macros_init() and job_stats_init().
+    if(hal.eeprom.driver_area.address >= GRBL_EEPROM_SIZE) {
+        v16_address = hal.eeprom.driver_area.address + hal.eeprom.driver_area.size + 1;
+        address = hal.eeprom.driver_area.address + hal.eeprom.driver_area.size + EEPROM_CHECKSUM_SIZE;
+    }
+#endif
 
-            case Setting_PositionIMaxError:
-                settings.position.pid.i_max_error = value;
-                break;
+#ifdef ENABLE_MACROS
+    if(address + MACRO_STORE_SIZE + EEPROM_CHECKSUM_SIZE <= hal.eeprom.size) {
+        macros_address = address;
+        v16_macros_address = v16_address;
+        address += MACRO_STORE_SIZE + EEPROM_CHECKSUM_SIZE;
+        v16_address += MACRO_STORE_SIZE + 1;
+    }
+#endif
 
-            default:;
-                status_code_t status = hal.driver_setting ? hal.driver_setting(setting, value, svalue) : Status_Unhandled;
-                return status == Status_Unhandled ? Status_InvalidStatement : status;
-        }
+#ifdef ENABLE_JOB_STATS
+    if(address + sizeof(job_counters_t) + EEPROM_CHECKSUM_SIZE <= hal.eeprom.size) {
+        migrate_block(v16_address, address, sizeof(job_counters_t));
+  #ifdef EMULATE_EEPROM
+        settings_dirty.job_stats = settings_dirty.is_dirty = hal.eeprom.type == EEPROM_Emulated;
+  #endif
     }
+#endif
 
-    write_global_settings();
-#ifdef ENABLE_BACKLASH_COMPENSATION
-    mc_backlash_init();
+#ifdef ENABLE_MACROS
+    if(macros_address) {
+        migrate_block(v16_macros_address, macros_address, MACRO_STORE_SIZE);
+  #ifdef EMULATE_EEPROM
+        settings_dirty.macros = settings_dirty.is_dirty = hal.eeprom.type == EEPROM_Emulated;
+  #endif
+    }
 #endif
-    hal.settings_changed(&settings);
 
-    return Status_OK;
+    if(hal.eeprom.driver_area.size && hal.eeprom.driver_area.address >= GRBL_EEPROM_SIZE)
+        migrate_block(hal.eeprom.driver_area.address, hal.eeprom.driver_area.address, hal.eeprom.driver_area.size);
+
+    migrate_block(V16_ADDR_BUILD_INFO, EEPROM_ADDR_BUILD_INFO, MAX_STORED_LINE_LENGTH);
+
+    idx = N_STARTUP_LINE;
+    do {
+        idx--;
+        migrate_block(V16_ADDR_STARTUP_BLOCK + idx * (MAX_STORED_LINE_LENGTH + 1), EEPROM_ADDR_STARTUP_BLOCK + idx * (MAX_STORED_LINE_LENGTH + EEPROM_CHECKSUM_SIZE), MAX_STORED_LINE_LENGTH);
+    } while(idx);
+
+    idx = SETTING_INDEX_NCOORD;
+    do {
+        migrate_block(EEPROM_ADDR_PARAMETERS + idx * (sizeof(coord_data_t) + 1), EEPROM_ADDR_PARAMETERS + idx * (sizeof(coord_data_t) + EEPROM_CHECKSUM_SIZE), sizeof(coord_data_t));
+    } while(idx--);
+
+    hal.eeprom.put_byte(0, SETTINGS_VERSION);
 }
 
-// Initialize the config subsystem
 void settings_init() {
+    if(hal.eeprom.type != EEPROM_None && hal.eeprom.get_byte(0) == 16)
+        settings_migrate();
+
     if(!read_global_settings()) {
         settings_restore_t settings = settings_all;
         settings.defaults = 1; // Ensure global settings get restored
@@ -820,14 +1303,15 @@ void settings_init() {
         report_grbl_settings();
     } else {
         memset(&tool_table, 0, sizeof(tool_data_t)); // First entry is for tools not in tool table
-#ifdef N_TOOLS
-        uint_fast8_t idx;
-        for (idx = 1; idx <= N_TOOLS; idx++)
-            settings_read_tool_data(idx, &tool_table[idx]);
-#endif
+        // NOTE: tool table entries are read on first use, see gc_get_tool_data()
+        apply_machine_profile();
         report_init();
+        system_init_travel_limits();
 #ifdef ENABLE_BACKLASH_COMPENSATION
-        mc_backlash_init();
+        plan_backlash_init();
+#endif
+#ifdef ENABLE_INPUT_SHAPING
+        plan_shaper_init();
 #endif
         hal.settings_changed(&settings);
         if(hal.probe_configure_invert_mask) // Initialize probe invert mask.
@@ -28,18 +28,24 @@
 
 // Version of the persistent storage data. Will be used to migrate existing data from older versions of Grbl
 // when firmware is upgraded. Always stored in byte 0 of eeprom
-#define SETTINGS_VERSION 16  // NOTE: Check settings_reset() when moving to next version.
+#define SETTINGS_VERSION 17  // NOTE: Check settings_reset() when moving to next version.
 
 // Define persistent storage memory address location values for Grbl settings and parameters
 // NOTE: 1KB persistent storage is the minimum required. The upper half is reserved for parameters and
 // the startup script. The lower half contains the global settings and space for future
-// developments.
+// developments. Each block is followed by its EEPROM_CHECKSUM_SIZE bytes checksum.
+// Version 16 blocks had a single checksum byte, these are converted by settings_init().
 #define EEPROM_ADDR_GLOBAL         1U
 #define EEPROM_ADDR_PARAMETERS     512U
-#define EEPROM_ADDR_BUILD_INFO     942U
-#define EEPROM_ADDR_STARTUP_BLOCK  (EEPROM_ADDR_BUILD_INFO - 1 - N_STARTUP_LINE * (MAX_STORED_LINE_LENGTH + 1))
+#define EEPROM_ADDR_BUILD_INFO     950U
+#define EEPROM_ADDR_STARTUP_BLOCK  (EEPROM_ADDR_BUILD_INFO - 1 - N_STARTUP_LINE * (MAX_STORED_LINE_LENGTH + EEPROM_CHECKSUM_SIZE))
+#if defined(N_TOOLS) && defined(ENABLE_SPARSE_TOOL_TABLE)
+#define EEPROM_TOOL_RECORDS        TOOL_TABLE_RECORDS
+#elif defined(N_TOOLS)
+#define EEPROM_TOOL_RECORDS        N_TOOLS
+#endif
 #ifdef N_TOOLS
-#define EEPROM_ADDR_TOOL_TABLE     (EEPROM_ADDR_PARAMETERS - 1 - N_TOOLS * (sizeof(tool_data_t) + 1))
+#define EEPROM_ADDR_TOOL_TABLE     (EEPROM_ADDR_PARAMETERS - 1 - EEPROM_TOOL_RECORDS * (sizeof(tool_data_t) + EEPROM_CHECKSUM_SIZE))
 #endif
 
 // Define persistent storage address indexing for coordinate parameters
@@ -78,8 +84,12 @@ typedef enum {
 #define N_COORDINATE_SYSTEMS (SettingIndex_NCoord - 3)  // Number of supported work coordinate systems (from index 1)
 
 // Define Grbl axis settings numbering scheme. Starts at Setting_AxisSettingsBase, every INCREMENT, over N_SETTINGS.
-#ifdef ENABLE_BACKLASH_COMPENSATION
-#define AXIS_N_SETTINGS          6
+#if defined(ENABLE_INPUT_SHAPING)
+#define AXIS_N_SETTINGS          9
+#elif defined(ENABLE_JERK_ACCELERATION)
+#define AXIS_N_SETTINGS          8
+#elif defined(ENABLE_BACKLASH_COMPENSATION)
+#define AXIS_N_SETTINGS          7
 #else
 #define AXIS_N_SETTINGS          4
 #endif
@@ -93,6 +103,7 @@ typedef enum {
     Setting_InvertStepperEnable = 4,
     Setting_LimitPinsInvertMask = 5,
     Setting_InvertProbePin = 6,
+    Setting_CoalescingTolerance = 7,
     Setting_StatusReportMask = 10,
     Setting_JunctionDeviation = 11,
     Setting_ArcTolerance = 12,
@@ -188,6 +199,10 @@ typedef enum {
     Setting_SpindleIMaxError = 85,
     Setting_SpindleDMaxError = 86,
 
+// Optional settings for rotary axes
+    Setting_RotaryWrapMask = 87,
+    Setting_RotaryShortestPathMask = 88,
+
 // Optional settings for closed loop spindle synchronized motion
     Setting_PositionPGain = 90,
     Setting_PositionIGain = 91,
@@ -198,6 +213,11 @@ typedef enum {
     Setting_PositionDMaxError = 96,
 //
 
+// Optional settings for input shaping
+    Setting_ShaperType = 97,
+    Setting_ShaperDamping = 98,
+//
+
     Setting_AxisSettingsBase = 100, // NOTE: Reserving settings values >= 100 for axis settings. Up to 255.
     Setting_AxisSettingsMax = 255,
 
@@ -248,12 +268,14 @@ typedef enum {
     AxisSetting_MaxTravel = 3,
     AxisSetting_StepperCurrent = 4,
     AxisSetting_MicroSteps = 5,
-    AxisSetting_Backlash = 6
+    AxisSetting_Backlash = 6,
+    AxisSetting_Jerk = 7,
+    AxisSetting_ShaperFrequency = 8
     /*
-    AxisSetting_P_Gain = 7,
-    AxisSetting_I_Gain = 8,
-    AxisSetting_D_Gain = 9,
-    AxisSetting_I_MaxError = 10
+    AxisSetting_P_Gain = 9,
+    AxisSetting_I_Gain = 10,
+    AxisSetting_D_Gain = 11,
+    AxisSetting_I_MaxError = 12
     */
 } axis_setting_type_t;
 
@@ -412,6 +434,12 @@ typedef struct {
     axes_signals_t disable_pullup;
 } limit_settings_t;
 
+typedef enum {
+    InputShaper_ZV = 0,     // Zero vibration, two impulses over half the damped period
+    InputShaper_ZVD,        // Zero vibration and derivative, three impulses over the damped period
+    InputShaper_MZV         // Modified zero vibration, three impulses over 3/4 of the damped period
+} input_shaper_t;
+
 // Global persistent settings (Stored from byte persistent storage_ADDR_GLOBAL onwards)
 typedef struct {
     // Settings struct version
@@ -423,9 +451,24 @@ typedef struct {
     float max_travel[N_AXIS];
 #ifdef ENABLE_BACKLASH_COMPENSATION
     float backlash[N_AXIS];
+#endif
+#ifdef ENABLE_JERK_ACCELERATION
+    float jerk[N_AXIS];
+#endif
+#ifdef ENABLE_INPUT_SHAPING
+    float shaper_freq[N_AXIS];  // Hz, 0 if not shaped
+    uint8_t shaper_type;        // input_shaper_t
+    float shaper_damping;
+#endif
+#ifdef ENABLE_ROTARY_WRAP
+    axes_signals_t rotary_wrap;     // Axes with positions wrapping modulo 360 degrees
+    axes_signals_t rotary_shortest; // Axes taking the shortest path to absolute targets
 #endif
     float junction_deviation;
     float arc_tolerance;
+#ifdef ENABLE_SEGMENT_COALESCING
+    float coalescing_tolerance;
+#endif
     float g73_retract;
     bool legacy_rt_commands;
     control_signals_t control_invert;
@@ -515,6 +558,39 @@ typedef struct {
 
 // End of setting structs that may be used by drivers
 
+// Descriptors for the core (non-axis) settings
+
+typedef enum {
+    SettingFormat_Bool = 0, // bool
+    SettingFormat_UInt8,    // uint8_t, clamped to min/max if max > min
+    SettingFormat_UInt16,   // uint16_t, clamped to min/max if max > min
+    SettingFormat_AxisMask, // uint8_t, masked with AXES_BITMASK
+    SettingFormat_Float,    // float, reported with n_decimal decimals
+    SettingFormat_Custom    // stored and reported by the set and report handlers
+} setting_format_t;
+
+// Reconfiguration needed after a setting is changed, deferred to the commit when in a batch.
+typedef enum {
+    SettingGroup_None   = 0,
+    SettingGroup_Report = bit(0), // Report units, also refreshes the WCO.
+    SettingGroup_Limits = bit(1), // Hard limits enable
+    SettingGroup_Homing = bit(2), // Homing cycle axes
+    SettingGroup_Probe  = bit(3)  // Probe input inversion
+} setting_group_t;
+
+typedef struct {
+    setting_type_t id;
+    setting_format_t format;
+    uint8_t group;              // setting_group_t flags
+    uint8_t n_decimal;
+    uint16_t offset;            // offsetof(settings_t, <member>), not used for SettingFormat_Custom
+    float min;
+    float max;
+    bool (*is_available)(void); // Optional, setting is not reported if it returns false
+    status_code_t (*set)(setting_type_t setting, float value, uint_fast16_t int_value, char *svalue); // Optional, replaces the default store
+    void (*report)(setting_type_t setting);                                                           // Optional, replaces the default report
+} setting_detail_t;
+
 extern settings_t settings;
 
 // Initialize the configuration subsystem (load settings from persistent storage)
@@ -526,6 +602,20 @@ void settings_restore(settings_restore_t restore_flags);
 // A helper method to set new settings from command line
 status_code_t settings_store_global_setting(setting_type_t setting, char *svalue);
 
+// Returns the descriptor of a core (non-axis) setting, NULL if the setting is not a core setting.
+const setting_detail_t *setting_get_details (setting_type_t setting);
+
+// Returns a pointer to the settings_t member of a setting, NULL for SettingFormat_Custom settings.
+void *setting_get_value_ptr (const setting_detail_t *setting);
+
+// Starts a batch of setting changes ($BEGIN), global settings are written and the driver
+// reconfigured once when the batch is committed instead of after each change.
+void settings_batch_begin (void);
+
+// Commits a batch of setting changes ($COMMIT). Called before a g-code block is executed
+// and on a reset so that a batch is never left pending while the machine is in use.
+void settings_batch_commit (void);
+
 // Writes the protocol line variable as a startup line in persistent storage
 void settings_write_startup_line(uint8_t idx, char *line);
 
@@ -548,6 +638,6 @@ bool settings_read_coord_data(uint8_t idx, float (*coord_data)[N_AXIS]);
 bool settings_write_tool_data (tool_data_t *tool_data);
 
 // Read selected tool data from persistent storage
-bool settings_read_tool_data (uint8_t tool, tool_data_t *tool_data);
+bool settings_read_tool_data (tool_id_t tool, tool_data_t *tool_data);
 
 #endif
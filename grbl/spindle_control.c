@@ -67,24 +67,67 @@ bool spindle_set_state (spindle_state_t state, float rpm)
     return !ABORTED;
 }
 
+#ifdef ENABLE_SPINDLE_AT_SPEED_RPM
+
+// Spindle at speed when the measured RPM is within the tolerance band of the programmed RPM.
+static bool spindle_rpm_at_speed (void)
+{
+    return sys.spindle_rpm == 0.0f ||
+            fabsf(hal.spindle_get_data(SpindleData_RPM).rpm - sys.spindle_rpm) <= sys.spindle_rpm * (SPINDLE_AT_SPEED_TOLERANCE / 100.0f);
+}
+
+#endif
+
+// Returns true if the spindle at speed state can be checked, from spindle RPM data or a driver at speed signal.
+static inline bool spindle_at_speed_available (void)
+{
+#ifdef ENABLE_SPINDLE_AT_SPEED_RPM
+    return hal.spindle_get_data != NULL || hal.driver_cap.spindle_at_speed;
+#else
+    return hal.driver_cap.spindle_at_speed;
+#endif
+}
+
+// Wait for the spindle to get up to speed, returns false on timeout or abort.
+// With spindle RPM data available the RPM is polled every dwell time step, else the driver signal every 100 ms.
+static bool spindle_wait_at_speed (delaymode_t mode)
+{
+    bool at_speed;
+    float delay = 0.0f;
+
+#ifdef ENABLE_SPINDLE_AT_SPEED_RPM
+    if(hal.spindle_get_data) {
+        while(!(at_speed = spindle_rpm_at_speed())) {
+            delay_sec(DWELL_TIME_STEP / 1000.0f, mode);
+            delay += DWELL_TIME_STEP / 1000.0f;
+            if(ABORTED || delay >= SPINDLE_AT_SPEED_TIMEOUT)
+                break;
+        }
+        return at_speed;
+    }
+#endif
+
+    while(!(at_speed = hal.spindle_get_state().at_speed)) {
+        delay_sec(0.1f, mode);
+        delay += 0.1f;
+        if(ABORTED || delay >= SAFETY_DOOR_SPINDLE_DELAY)
+            break;
+    }
+
+    return at_speed;
+}
+
 // G-code parser entry-point for setting spindle state. Forces a planner buffer sync and bails
 // if an abort or check-mode is active.
 bool spindle_sync (spindle_state_t state, float rpm)
 {
     bool ok = true;
-    bool at_speed = sys.state == STATE_CHECK_MODE || !hal.driver_cap.spindle_at_speed;
+    bool at_speed = sys.state == STATE_CHECK_MODE || !state.on || !spindle_at_speed_available();
 
     if (sys.state != STATE_CHECK_MODE) {
         // Empty planner buffer to ensure spindle is set when programmed.
-        if((ok = protocol_buffer_synchronize()) && spindle_set_state(state, rpm) && !at_speed) {
-            float delay = 0.0f;
-            while(!(at_speed = hal.spindle_get_state().at_speed)) {
-                delay_sec(0.1f, DelayMode_Dwell);
-                delay += 0.1f;
-                if(ABORTED || delay >= SAFETY_DOOR_SPINDLE_DELAY)
-                    break;
-            }
-        }
+        if((ok = protocol_buffer_synchronize()) && spindle_set_state(state, rpm) && !at_speed)
+            at_speed = spindle_wait_at_speed(DelayMode_Dwell);
     }
 
     return ok && at_speed;
@@ -99,17 +142,24 @@ bool spindle_restore (spindle_state_t state, float rpm)
         sys.step_control.update_spindle_rpm = On;
     else { // TODO: add check for current spindle state matches restore state?
         spindle_set_state(state, rpm);
-        if((ok = !hal.driver_cap.spindle_at_speed))
-            delay_sec(SAFETY_DOOR_SPINDLE_DELAY, DelayMode_SysSuspend);
-        else {
-            float delay = 0.0f;
-            while(!(ok = hal.spindle_get_state().at_speed)) {
-                delay_sec(0.1f, DelayMode_SysSuspend);
-                delay += 0.1f;
-                if(ABORTED || delay >= SAFETY_DOOR_SPINDLE_DELAY)
-                    break;
-            }
-        }
+        ok = spindle_restore_wait(state, 0.0f);
+    }
+
+    return ok;
+}
+
+// Waits for the spindle to get up to speed if an at speed check is available, else for the remainder of
+// SAFETY_DOOR_SPINDLE_DELAY after the elapsed time since the spindle was set running.
+bool spindle_restore_wait (spindle_state_t state, float elapsed)
+{
+    bool ok = true;
+
+    if(state.on && !settings.flags.laser_mode) { // No spin-up delay when restoring a stopped spindle.
+        if((ok = !spindle_at_speed_available())) {
+            if(elapsed < SAFETY_DOOR_SPINDLE_DELAY)
+                delay_sec(SAFETY_DOOR_SPINDLE_DELAY - elapsed, DelayMode_SysSuspend);
+        } else
+            ok = spindle_wait_at_speed(DelayMode_SysSuspend);
     }
 
     return ok;
@@ -144,6 +194,41 @@ static inline uint_fast16_t invert_pwm (spindle_pwm_t *pwm_data, uint_fast16_t p
     return pwm_data->invert_pwm ? pwm_data->period - pwm_value - 1 : pwm_value;
 }
 
+// Spindle RPM to PWM conversion, used directly or to fill the lookup table.
+static uint_fast16_t compute_pwm_value (spindle_pwm_t *pwm_data, float rpm, bool pid_limit)
+{
+    uint_fast16_t pwm_value;
+
+    if(rpm > settings.spindle.rpm_min) {
+      #ifdef ENABLE_SPINDLE_LINEARIZATION
+        // Compute intermediate PWM value with linear spindle speed model via piecewise linear fit model.
+        uint_fast8_t idx = pwm_data->n_pieces;
+
+        if(idx) {
+            do {
+                idx--;
+                if(idx == 0 || rpm > pwm_data->piece[idx].rpm) {
+                    pwm_value = floorf(pwm_data->piece[idx].start * rpm - pwm_data->piece[idx].end);
+                    break;
+                }
+            } while(idx);
+        } else
+      #endif
+        // Compute intermediate PWM value with linear spindle speed model.
+        pwm_value = (uint_fast16_t)floorf((rpm - settings.spindle.rpm_min) * pwm_data->pwm_gradient) + pwm_data->min_value;
+
+        if(pwm_value >= (pid_limit ? pwm_data->period : pwm_data->max_value))
+            pwm_value = pid_limit ? pwm_data->period - 1 : pwm_data->max_value;
+        else if(pwm_value < pwm_data->min_value)
+            pwm_value = pwm_data->min_value;
+
+        pwm_value = invert_pwm(pwm_data, pwm_value);
+    } else
+        pwm_value = rpm == 0.0f ? pwm_data->off_value : invert_pwm(pwm_data, pwm_data->min_value);
+
+    return pwm_value;
+}
+
 // Precompute PWM values for faster conversion.
 // Returns false if no PWM range possible, driver should revert to simple on/off spindle control if so.
 bool spindle_precompute_pwm_values (spindle_pwm_t *pwm_data, uint32_t clock_hz)
@@ -171,40 +256,37 @@ bool spindle_precompute_pwm_values (spindle_pwm_t *pwm_data, uint32_t clock_hz)
     }
 #endif
 
+#ifdef ENABLE_SPINDLE_PWM_LUT
+    pwm_data->lut_scale = 0.0f;
+
+    if(settings.spindle.rpm_max > settings.spindle.rpm_min) {
+
+        uint_fast16_t entry;
+        float rpm_step = (settings.spindle.rpm_max - settings.spindle.rpm_min) / (float)SPINDLE_PWM_LUT_SIZE;
+
+        // The first entry is for RPM just above rpm_min, at and below rpm_min the off or min value is returned.
+        pwm_data->lut[0] = (uint16_t)compute_pwm_value(pwm_data, settings.spindle.rpm_min + rpm_step * 0.001f, false);
+        for(entry = 1; entry < SPINDLE_PWM_LUT_SIZE; entry++)
+            pwm_data->lut[entry] = (uint16_t)compute_pwm_value(pwm_data, settings.spindle.rpm_min + rpm_step * (float)entry, false);
+        pwm_data->lut[SPINDLE_PWM_LUT_SIZE] = (uint16_t)compute_pwm_value(pwm_data, settings.spindle.rpm_max, false);
+
+        pwm_data->lut_scale = 1.0f / rpm_step;
+    }
+#endif
+
     return settings.spindle.rpm_max > settings.spindle.rpm_min;
 }
 
 // Spindle RPM to PWM conversion.
 uint_fast16_t spindle_compute_pwm_value (spindle_pwm_t *pwm_data, float rpm, bool pid_limit)
 {
-    uint_fast16_t pwm_value;
-
-    if(rpm > settings.spindle.rpm_min) {
-      #ifdef ENABLE_SPINDLE_LINEARIZATION
-        // Compute intermediate PWM value with linear spindle speed model via piecewise linear fit model.
-        uint_fast8_t idx = pwm_data->n_pieces;
-
-        if(idx) {
-            do {
-                idx--;
-                if(idx == 0 || rpm > pwm_data->piece[idx].rpm) {
-                    pwm_value = floorf(pwm_data->piece[idx].start * rpm - pwm_data->piece[idx].end);
-                    break;
-                }
-            } while(idx);
-        } else
-      #endif
-        // Compute intermediate PWM value with linear spindle speed model.
-        pwm_value = (uint_fast16_t)floorf((rpm - settings.spindle.rpm_min) * pwm_data->pwm_gradient) + pwm_data->min_value;
-
-        if(pwm_value >= (pid_limit ? pwm_data->period : pwm_data->max_value))
-            pwm_value = pid_limit ? pwm_data->period - 1 : pwm_data->max_value;
-        else if(pwm_value < pwm_data->min_value)
-            pwm_value = pwm_data->min_value;
-
-        pwm_value = invert_pwm(pwm_data, pwm_value);
-    } else
-        pwm_value = rpm == 0.0f ? pwm_data->off_value : invert_pwm(pwm_data, pwm_data->min_value);
+#ifdef ENABLE_SPINDLE_PWM_LUT
+    // Nearest lookup table entry, RPM above rpm_max is clamped to the last entry.
+    if(!pid_limit && pwm_data->lut_scale != 0.0f && rpm > settings.spindle.rpm_min) {
+        uint_fast32_t idx = (uint_fast32_t)((rpm - settings.spindle.rpm_min) * pwm_data->lut_scale + 0.5f);
+        return pwm_data->lut[idx > SPINDLE_PWM_LUT_SIZE ? SPINDLE_PWM_LUT_SIZE : idx];
+    }
+#endif
 
-    return pwm_value;
+    return compute_pwm_value(pwm_data, rpm, pid_limit);
 }
@@ -23,6 +23,10 @@
 #ifndef spindle_control_h
 #define spindle_control_h
 
+#ifndef SPINDLE_RPM_RAMP
+#define SPINDLE_RPM_RAMP 0 // RPM per second
+#endif
+
 typedef union {
     uint8_t value;
     uint8_t mask;
@@ -55,6 +59,10 @@ typedef struct {
     bool always_on;
     uint_fast16_t n_pieces;
     pwm_piece_t piece[SPINDLE_NPWM_PIECES];
+#ifdef ENABLE_SPINDLE_PWM_LUT
+    float lut_scale;                             // LUT intervals per RPM, 0 if no lookup table
+    uint16_t lut[SPINDLE_PWM_LUT_SIZE + 1];      // PWM values from rpm_min to rpm_max
+#endif
 } spindle_pwm_t;
 
 // Used when HAL driver supports spindle synchronization
@@ -93,6 +101,9 @@ float spindle_set_rpm (float rpm, uint8_t speed_override);
 // Restore spindle running state with direction, enable, spindle RPM and appropriate delay.
 bool spindle_restore (spindle_state_t state, float rpm);
 
+// Waits for a restored spindle set running elapsed seconds ago to get up to speed, as spindle_restore() does.
+bool spindle_restore_wait (spindle_state_t state, float elapsed);
+
 //
 // The following functions are not called by the core, may be called by driver code.
 //
@@ -0,0 +1,202 @@
+/*
+  spindle_encoder.c - spindle RPM and position from a hardware pulse counter, with filtered period averaging
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_SPINDLE_ENCODER
+
+/*
+  Spindle encoder shared by drivers that count the encoder pulses in a hardware counter. The driver sets a
+  compare value on the counter and calls spindle_encoder_sample() from the compare interrupt with the count
+  and the timestamp, the return value is the number of pulses to the next interrupt. It is computed from the
+  filtered period so that samples are taken about every SPINDLE_ENCODER_SAMPLE_TIME ms, the interrupt load
+  thus does not increase with the RPM. Below the RPM where one pulse takes longer than the sample time the
+  driver is interrupted once per pulse.
+
+  Each sample is the number of pulses and the timer ticks between two interrupts, the period is the sum of
+  the ticks divided by the sum of the pulses over the filter:
+
+  SPINDLE_ENCODER_FILTER_AVERAGE: moving average of the last SPINDLE_ENCODER_FILTER_LENGTH samples. A step
+    change of the RPM is fully reported after SPINDLE_ENCODER_FILTER_LENGTH samples.
+  SPINDLE_ENCODER_FILTER_IIR: first order IIR filter with a time constant of SPINDLE_ENCODER_FILTER_LENGTH
+    samples, 63% of a step change is reported after that.
+
+  The RPM reported is thus updated every sample time at speed, and the filter is restarted when no sample
+  has been taken for SPINDLE_ENCODER_STOP_TIME ms, i.e. when the spindle starts from standstill.
+*/
+
+#define DP_SCALE 256 // Pulse sums are scaled for the IIR filter to not be biased by the integer division.
+
+static struct {
+    spindle_data_t *data;
+    uint32_t ppr;
+    uint32_t counter_mask;
+    uint32_t max_pulses;            // Max pulses between samples, half the counter range
+    uint32_t sample_ticks;          // Timer ticks per sample time
+    uint32_t stop_ticks;            // Timer ticks before RPM = 0 is reported
+    float rpm_factor;
+    float pulse_distance;           // Encoder pulse distance in fraction of one revolution
+    volatile uint32_t last_count;   // Pulse count at last sample
+    volatile uint32_t last_time;    // Timestamp of last sample
+    volatile uint32_t index_pulse;  // Pulse count at last index pulse
+    volatile uint32_t next_pulses;  // Pulses until next sample
+    volatile uint32_t sum_dp;       // Filtered pulses, scaled by DP_SCALE
+    volatile uint32_t sum_dt;       // Filtered timer ticks
+#if SPINDLE_ENCODER_FILTER == SPINDLE_ENCODER_FILTER_AVERAGE
+    uint_fast8_t idx;
+    uint32_t dp[SPINDLE_ENCODER_FILTER_LENGTH];
+    uint32_t dt[SPINDLE_ENCODER_FILTER_LENGTH];
+#endif
+} encoder = {0};
+
+static void filter_clear (void)
+{
+    encoder.sum_dp = encoder.sum_dt = 0;
+#if SPINDLE_ENCODER_FILTER == SPINDLE_ENCODER_FILTER_AVERAGE
+    encoder.idx = 0;
+    memset(encoder.dp, 0, sizeof(encoder.dp));
+    memset(encoder.dt, 0, sizeof(encoder.dt));
+#endif
+}
+
+void spindle_encoder_init (spindle_data_t *data, uint32_t ppr, uint32_t timer_hz, uint32_t counter_mask)
+{
+    encoder.data = data;
+    encoder.ppr = ppr ? ppr : 1;
+    encoder.counter_mask = counter_mask;
+    encoder.max_pulses = max(counter_mask >> 1, 1);
+    encoder.sample_ticks = (uint32_t)(((uint64_t)timer_hz * SPINDLE_ENCODER_SAMPLE_TIME) / 1000);
+    encoder.stop_ticks = (uint32_t)(((uint64_t)timer_hz * SPINDLE_ENCODER_STOP_TIME) / 1000);
+    encoder.rpm_factor = 60.0f * (float)timer_hz / ((float)encoder.ppr * (float)DP_SCALE);
+    encoder.pulse_distance = 1.0f / (float)encoder.ppr;
+}
+
+uint32_t spindle_encoder_reset (uint32_t count, uint32_t timestamp)
+{
+    filter_clear();
+
+    encoder.last_count = encoder.index_pulse = count;
+    encoder.last_time = timestamp;
+    encoder.next_pulses = 1;
+
+    if(encoder.data) {
+        encoder.data->pulse_count = 0;
+        encoder.data->index_count = 0;
+        encoder.data->rpm = 0.0f;
+        encoder.data->angular_position = 0.0f;
+    }
+
+    return encoder.next_pulses;
+}
+
+uint32_t spindle_encoder_sample (uint32_t count, uint32_t timestamp)
+{
+    uint32_t dp = (count - encoder.last_count) & encoder.counter_mask, dt = timestamp - encoder.last_time;
+
+    if(dp == 0)
+        return encoder.next_pulses;
+
+    encoder.data->pulse_count += dp;
+    encoder.last_count = count;
+    encoder.last_time = timestamp;
+
+    if(dt > encoder.stop_ticks) // Spindle was stopped, the interval does not give the period.
+        filter_clear();
+    else {
+        dp *= DP_SCALE;
+#if SPINDLE_ENCODER_FILTER == SPINDLE_ENCODER_FILTER_AVERAGE
+        encoder.sum_dp += dp - encoder.dp[encoder.idx];
+        encoder.sum_dt += dt - encoder.dt[encoder.idx];
+        encoder.dp[encoder.idx] = dp;
+        encoder.dt[encoder.idx] = dt;
+        encoder.idx = (encoder.idx + 1) & (SPINDLE_ENCODER_FILTER_LENGTH - 1);
+#else
+        if(encoder.sum_dt == 0) { // Start from the first sample.
+            encoder.sum_dp = dp * SPINDLE_ENCODER_FILTER_LENGTH;
+            encoder.sum_dt = dt * SPINDLE_ENCODER_FILTER_LENGTH;
+        } else {
+            encoder.sum_dp += dp - encoder.sum_dp / SPINDLE_ENCODER_FILTER_LENGTH;
+            encoder.sum_dt += dt - encoder.sum_dt / SPINDLE_ENCODER_FILTER_LENGTH;
+        }
+#endif
+    }
+
+    if(encoder.sum_dt) {
+        uint64_t pulses = ((uint64_t)encoder.sample_ticks * encoder.sum_dp) / ((uint64_t)encoder.sum_dt * DP_SCALE);
+        encoder.next_pulses = pulses == 0 ? 1 : (pulses > encoder.max_pulses ? encoder.max_pulses : (uint32_t)pulses);
+    } else
+        encoder.next_pulses = 1;
+
+    return encoder.next_pulses;
+}
+
+bool spindle_encoder_index (uint32_t count)
+{
+    bool ok = encoder.data->index_count == 0 || ((count - encoder.index_pulse) & encoder.counter_mask) == encoder.ppr;
+
+    encoder.index_pulse = count;
+    encoder.data->index_count++;
+
+    return ok;
+}
+
+uint32_t spindle_encoder_tpp (uint32_t timestamp)
+{
+    uint32_t sum_dp = encoder.sum_dp, sum_dt = encoder.sum_dt;
+
+    return sum_dp == 0 || (timestamp - encoder.last_time) > encoder.stop_ticks
+            ? 0
+            : (uint32_t)(((uint64_t)sum_dt * DP_SCALE) / sum_dp);
+}
+
+spindle_data_t spindle_encoder_get_data (spindle_data_request_t request, uint32_t count, uint32_t timestamp)
+{
+    spindle_data_t data;
+    uint32_t sum_dp = encoder.sum_dp, sum_dt = encoder.sum_dt, elapsed = timestamp - encoder.last_time;
+    bool stopped = sum_dp == 0 || elapsed > encoder.stop_ticks;
+
+    switch(request) {
+
+        case SpindleData_Counters:
+            break;
+
+        case SpindleData_RPM:
+            encoder.data->rpm = stopped ? 0.0f : encoder.rpm_factor * (float)sum_dp / (float)sum_dt;
+            break;
+
+        case SpindleData_AngularPosition:
+            {
+                float pulses = (float)((encoder.last_count - encoder.index_pulse) & encoder.counter_mask);
+                if(!stopped) // Interpolate from the time since the last sample, up to the next sample.
+                    pulses += min((float)elapsed * (float)sum_dp / ((float)sum_dt * (float)DP_SCALE), (float)encoder.next_pulses);
+                encoder.data->angular_position = (float)encoder.data->index_count + pulses * encoder.pulse_distance;
+            }
+            break;
+    }
+
+    data = *encoder.data;
+
+    if(request == SpindleData_Counters)
+        data.pulse_count += (count - encoder.last_count) & encoder.counter_mask;
+
+    return data;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+  spindle_encoder.h - spindle RPM and position from a hardware pulse counter, with filtered period averaging
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SPINDLE_ENCODER_H_
+#define _SPINDLE_ENCODER_H_
+
+#ifdef ENABLE_SPINDLE_ENCODER
+
+#define SPINDLE_ENCODER_FILTER_AVERAGE 0
+#define SPINDLE_ENCODER_FILTER_IIR     1
+
+// Filter applied to the period samples, a moving average or a first order IIR filter.
+#ifndef SPINDLE_ENCODER_FILTER
+  #define SPINDLE_ENCODER_FILTER SPINDLE_ENCODER_FILTER_AVERAGE
+#endif
+
+// Number of samples averaged, or the IIR filter time constant in samples. Must be a power of 2.
+#ifndef SPINDLE_ENCODER_FILTER_LENGTH
+  #define SPINDLE_ENCODER_FILTER_LENGTH 4
+#endif
+
+// Target time between samples, the driver is interrupted once per sample period (ms).
+#ifndef SPINDLE_ENCODER_SAMPLE_TIME
+  #define SPINDLE_ENCODER_SAMPLE_TIME 2
+#endif
+
+// RPM is reported as 0 when no sample has been taken for this long (ms).
+#ifndef SPINDLE_ENCODER_STOP_TIME
+  #define SPINDLE_ENCODER_STOP_TIME 250
+#endif
+
+#if SPINDLE_ENCODER_FILTER_LENGTH < 1 || (SPINDLE_ENCODER_FILTER_LENGTH & (SPINDLE_ENCODER_FILTER_LENGTH - 1))
+#error "SPINDLE_ENCODER_FILTER_LENGTH must be a power of 2!"
+#endif
+
+// Counter values are encoder pulse counts masked by the counter_mask given at init. Timestamps are from a
+// free running 32 bit timer counting up at timer_hz, drivers with a down counting timer pass its complement.
+
+// Sets up the encoder for ppr pulses per revolution and keeps the counts, RPM and angular position in data.
+// Must be followed by spindle_encoder_reset().
+void spindle_encoder_init (spindle_data_t *data, uint32_t ppr, uint32_t timer_hz, uint32_t counter_mask);
+
+// Clears the counts and the filter, returns the number of pulses until the first sample.
+uint32_t spindle_encoder_reset (uint32_t count, uint32_t timestamp);
+
+// Takes a sample, to be called from the counter compare interrupt with the pulse count and the time of the
+// pulse. Returns the number of pulses until the next sample, the driver adds it to the compare value.
+// Integer math only.
+uint32_t spindle_encoder_sample (uint32_t count, uint32_t timestamp);
+
+// Counts an index pulse, to be called from the index interrupt. Returns false if the number of pulses since
+// the previous index pulse did not match the pulses per revolution.
+bool spindle_encoder_index (uint32_t count);
+
+// Returns the filtered period in timer ticks per pulse, 0 when stopped.
+uint32_t spindle_encoder_tpp (uint32_t timestamp);
+
+// Updates the requested data from the current pulse count and time.
+spindle_data_t spindle_encoder_get_data (spindle_data_request_t request, uint32_t count, uint32_t timestamp);
+
+#endif
+
+#endif
@@ -0,0 +1,194 @@
+/*
+  spindle_pid.c - fixed point PID controller for closed loop spindle RPM control
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_SPINDLE_PID
+
+/*
+  PID controller shared by drivers with closed loop spindle RPM control ($80 - $85 settings). The driver
+  calls spindle_pid_update() at a fixed rate from a timer, with the RPM measured from the encoder over the
+  sample period, and adds the result to the programmed RPM when computing the PWM value.
+
+  The gains are converted to 16.16 fixed point scaled by the sample period when loaded, a sample then takes
+  integer multiplications and additions only. The derivative term is computed from the actual RPM so that
+  setpoint changes do not kick the output. The integral term is limited to i_max_error and is not
+  integrated further while the output is limited by max_error in the direction of the error (anti-windup).
+
+  $PIDS=<n> streams every n-th sample as [PIDS:<setpoint>,<actual>,<output>] for live tuning.
+*/
+
+#define Q16(v) ((int64_t)lroundf((v) * 65536.0f))
+#define PID_NO_LIMIT INT64_MAX
+
+typedef struct {
+    int32_t setpoint;
+    int32_t actual;
+    int32_t output;
+} pid_sample_t;
+
+static struct {
+    uint_fast16_t decimation;       // Stream every n-th sample, 0 when off
+    uint_fast16_t count;
+    volatile uint_fast16_t head;
+    volatile uint_fast16_t tail;
+    volatile uint32_t dropped;      // Samples dropped as the buffer was full
+    pid_sample_t sample[SPINDLE_PID_STREAM_SIZE];
+} stream = {0};
+
+static inline int64_t pid_limit (float limit)
+{
+    return limit > 0.0f ? Q16(limit) : PID_NO_LIMIT;
+}
+
+void spindle_pid_init (spindle_pid_t *pid, pid_values_t *cfg, float sample_period)
+{
+    pid->p_gain = (int32_t)Q16(cfg->p_gain);
+    pid->i_gain = (int32_t)Q16(cfg->i_gain * sample_period);
+    pid->d_gain = (int32_t)Q16(cfg->d_gain / sample_period);
+    pid->deadband = (int32_t)lroundf(cfg->deadband);
+    pid->i_max = pid_limit(cfg->i_max_error);
+    pid->d_max = pid_limit(cfg->d_max_error);
+    pid->max_output = pid_limit(cfg->max_error);
+
+    spindle_pid_reset(pid);
+}
+
+void spindle_pid_reset (spindle_pid_t *pid)
+{
+    pid->i_term = 0;
+    pid->output = 0;
+    pid->primed = false;
+}
+
+static inline int64_t clamp (int64_t value, int64_t limit)
+{
+    return value > limit ? limit : (value < -limit ? -limit : value);
+}
+
+ISR_CODE int32_t spindle_pid_update (spindle_pid_t *pid, int32_t setpoint, int32_t actual)
+{
+    int32_t error = setpoint - actual;
+
+    if(error > pid->deadband)
+        error -= pid->deadband;
+    else if(error < -pid->deadband)
+        error += pid->deadband;
+    else
+        error = 0;
+
+    if(!pid->primed) {
+        pid->prev_actual = actual;
+        pid->primed = true;
+    }
+
+    int64_t d_term = clamp((int64_t)pid->d_gain * (pid->prev_actual - actual), pid->d_max);
+    int64_t i_term = clamp(pid->i_term + (int64_t)pid->i_gain * error, pid->i_max);
+    int64_t output = (int64_t)pid->p_gain * error + i_term + d_term;
+
+    pid->prev_actual = actual;
+
+    if(output > pid->max_output || output < -pid->max_output) {
+        // Saturated, do not integrate further into the saturation.
+        if((output > 0) == (i_term > pid->i_term))
+            i_term = pid->i_term;
+        output = clamp(output, pid->max_output);
+    }
+
+    pid->i_term = i_term;
+    pid->output = (int32_t)((output + 0x8000) / 65536);
+
+    if(stream.decimation && ++stream.count >= stream.decimation) {
+        stream.count = 0;
+        uint_fast16_t next = (stream.head + 1) & (SPINDLE_PID_STREAM_SIZE - 1);
+        if(next == stream.tail)
+            stream.dropped++;
+        else {
+            stream.sample[stream.head].setpoint = setpoint;
+            stream.sample[stream.head].actual = actual;
+            stream.sample[stream.head].output = pid->output;
+            stream.head = next;
+        }
+    }
+
+    return pid->output;
+}
+
+static char *itoa32 (int32_t value)
+{
+    static char buf[12];
+
+    buf[0] = '-';
+    strcpy(&buf[value < 0 ? 1 : 0], uitoa(value < 0 ? (uint32_t)-value : (uint32_t)value));
+
+    return buf;
+}
+
+void spindle_pid_stream_output (void)
+{
+    while(stream.tail != stream.head) {
+        pid_sample_t *sample = &stream.sample[stream.tail];
+        hal.stream.write("[PIDS:");
+        hal.stream.write(itoa32(sample->setpoint));
+        hal.stream.write(",");
+        hal.stream.write(itoa32(sample->actual));
+        hal.stream.write(",");
+        hal.stream.write(itoa32(sample->output));
+        hal.stream.write("]" ASCII_EOL);
+        stream.tail = (stream.tail + 1) & (SPINDLE_PID_STREAM_SIZE - 1);
+    }
+}
+
+status_code_t spindle_pid_command (char *args)
+{
+    status_code_t retval = Status_OK;
+
+    if(*args == '\0') {
+        hal.stream.write("[PIDS:");
+        hal.stream.write(uitoa(stream.decimation));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(stream.dropped));
+        hal.stream.write("]" ASCII_EOL);
+    } else if(*args++ != '=')
+        retval = Status_InvalidStatement;
+    else {
+
+        uint_fast8_t counter = 0;
+        float value;
+
+        if(!read_float(args, &counter, &value))
+            retval = Status_BadNumberFormat;
+        else if(args[counter] != '\0' || !isintf(value) || value > 65535.0f)
+            retval = Status_InvalidStatement;
+        else if(value < 0.0f)
+            retval = Status_NegativeValue;
+        else {
+            stream.decimation = 0;
+            stream.count = 0;
+            stream.tail = stream.head;
+            stream.dropped = 0;
+            stream.decimation = (uint_fast16_t)value;
+        }
+    }
+
+    return retval;
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+  spindle_pid.h - fixed point PID controller for closed loop spindle RPM control
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SPINDLE_PID_H_
+#define _SPINDLE_PID_H_
+
+#ifdef ENABLE_SPINDLE_PID
+
+// Number of samples buffered for the $PIDS stream, must be a power of 2. Each sample takes 12 bytes of RAM.
+#ifndef SPINDLE_PID_STREAM_SIZE
+  #define SPINDLE_PID_STREAM_SIZE 32
+#endif
+
+#if SPINDLE_PID_STREAM_SIZE < 2 || (SPINDLE_PID_STREAM_SIZE & (SPINDLE_PID_STREAM_SIZE - 1))
+#error "SPINDLE_PID_STREAM_SIZE must be a power of 2!"
+#endif
+
+// All values are in RPM, gains and terms are 16.16 fixed point.
+typedef struct {
+    int32_t p_gain;         // Proportional gain
+    int32_t i_gain;         // Integral gain multiplied by the sample period
+    int32_t d_gain;         // Derivative gain divided by the sample period
+    int32_t deadband;       // Errors within the deadband are ignored
+    int64_t i_max;          // Limit of the integral term
+    int64_t d_max;          // Limit of the derivative term
+    int64_t max_output;     // Limit of the output
+    int64_t i_term;         // Integral term
+    int32_t prev_actual;    // Actual RPM of the previous sample, for the derivative term
+    int32_t output;         // Last output
+    bool primed;            // Set when prev_actual is valid
+} spindle_pid_t;
+
+// Loads the gains and limits from cfg for a controller sampled every sample_period seconds and resets it.
+// The gains are per second: the integral gain for an error of 1 RPM for 1 s and the derivative gain for an
+// error changing by 1 RPM/s. A limit of 0 is no limit.
+void spindle_pid_init (spindle_pid_t *pid, pid_values_t *cfg, float sample_period);
+
+// Resets the controller state, to be called when the spindle is started or stopped.
+void spindle_pid_reset (spindle_pid_t *pid);
+
+// Computes the correction to add to the setpoint from the actual RPM, to be called once per sample period.
+// Integer math only, may be called from an interrupt handler.
+int32_t spindle_pid_update (spindle_pid_t *pid, int32_t setpoint, int32_t actual);
+
+// Outputs the samples buffered for the $PIDS stream, called from the main loop.
+void spindle_pid_stream_output (void);
+
+// $PIDS=<n>, $PIDS=0 and $PIDS command handler, stream every n-th sample, stop or report the stream state.
+status_code_t spindle_pid_command (char *args);
+
+#endif
+
+#endif
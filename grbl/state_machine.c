@@ -36,6 +36,11 @@ static void state_await_waypoint_retract (uint_fast16_t rt_exec);
 static void state_restore (uint_fast16_t rt_exec);
 static void state_await_resumed (uint_fast16_t rt_exec);
 static void state_await_restore (uint_fast16_t rt_exec);
+#ifdef ENABLE_HOLD_JOG
+static void state_hold_jogging (uint_fast16_t rt_exec);
+static void state_hold_jog_return (uint_fast16_t rt_exec);
+static void hold_jog_return (void);
+#endif
 
 static void (* volatile stateHandler)(uint_fast16_t rt_exec) = state_idle;
 
@@ -49,14 +54,85 @@ typedef struct {
     float retract_waypoint;
     bool retracting;
     bool restart_retract;
+#ifdef PARKING_OVERLAPPED_RESTORE
+    bool restored;              // Spindle and coolant restored at the start of the return motion
+    uint32_t restored_ms;       // Time of restore
+#endif
     plan_line_data_t plan_data;
 } parking_data_t;
 
 // Declare and initialize parking local variables
 static parking_data_t park;
 
+#ifdef ENABLE_HOLD_JOG
+
+/*
+  Jogging away from a feed hold and back. When the hold is complete the planner buffer, the partially
+  executed block and the parser state are kept as they are, as for parking. Jog commands are then executed
+  as system motions, one at a time, in the planner block reserved for them and the job is not affected.
+  The start of each jog is recorded as a waypoint, on cycle start the jogs are retraced in reverse order
+  back to where the hold was entered before the job is resumed with its lookahead intact.
+*/
+
+typedef struct {
+    float target[N_AXIS];
+    float feed_rate;
+} hold_jog_waypoint_t;
+
+static struct {
+    bool motion;                    // Jog or return motion executing
+    bool stop;                      // Motion is decelerating to a stop
+    uint_fast16_t pending;          // EXEC_SAFETY_DOOR or EXEC_SLEEP to execute when the motion has stopped
+    uint_fast8_t n_waypoints;
+    hold_jog_waypoint_t waypoint[HOLD_JOG_WAYPOINTS];
+} hold_jog = {0};
+
+#endif
+
+#ifdef PARKING_OVERLAPPED_RESTORE
+
+// Restores the spindle and coolant without delay when the parking return motion starts.
+static void state_restore_start (planner_cond_t *condition, float rpm)
+{
+    if(settings.flags.laser_mode)
+        return; // Laser is restored when the cycle starts.
+
+    park.restored = true;
+    park.restored_ms = hal.get_elapsed_ticks ? hal.get_elapsed_ticks() : 0;
+
+    if(condition->spindle.on)
+        spindle_set_state(condition->spindle, rpm);
+
+    if (gc_state.modal.coolant.value != hal.coolant_get_state().value)
+        coolant_set_state(condition->coolant);
+}
+
+// Waits for the remainder of the restore delays after the return motion.
+static void state_restore_finish (planner_cond_t *condition)
+{
+    float elapsed = hal.get_elapsed_ticks ? (float)(hal.get_elapsed_ticks() - park.restored_ms) / 1000.0f : 0.0f;
+
+    park.restored = false;
+
+    spindle_restore_wait(condition->spindle, elapsed);
+
+    if (condition->coolant.value && elapsed < SAFETY_DOOR_COOLANT_DELAY)
+        delay_sec(SAFETY_DOOR_COOLANT_DELAY - elapsed, DelayMode_SysSuspend);
+
+    sys.override.spindle_stop.value = 0; // Clear spindle stop override states
+}
+
+#endif
+
 static void state_restore_conditions (planner_cond_t *condition, float rpm)
 {
+#ifdef PARKING_OVERLAPPED_RESTORE
+    if(park.restored) {
+        state_restore_finish(condition);
+        return;
+    }
+#endif
+
     if(!settings.parking.flags.enabled || !park.restart_retract) {
 
         spindle_restore(condition->spindle, rpm);
@@ -97,6 +173,9 @@ bool initiate_hold (uint_fast16_t new_state)
         enqueue_accessory_override(CMD_OVERRIDE_SPINDLE_STOP);
 
     if(sys.state & (STATE_CYCLE|STATE_JOG)) {
+#ifdef ENABLE_HOLD_SEGMENT_REWIND
+        st_hold_rewind();                   // Retract queued segments so that deceleration starts sooner.
+#endif
         st_update_plan_block_parameters();  // Notify stepper module to recompute for hold deceleration.
         sys.step_control.execute_hold = On; // Initiate suspend state with active flag.
         stateHandler = state_await_hold;
@@ -120,6 +199,11 @@ bool state_door_reopened (void)
 
 void update_state (uint_fast16_t rt_exec)
 {
+#ifdef ENABLE_HOLD_JOG
+    if(hold_jog.motion) // State changes are deferred until the jog or return motion has stopped.
+        stateHandler(rt_exec);
+    else
+#endif
     if((rt_exec & EXEC_SAFETY_DOOR) && sys.state != STATE_SAFETY_DOOR)
         set_state(STATE_SAFETY_DOOR);
     else
@@ -139,13 +223,20 @@ void set_state (uint_fast16_t new_state)
                 sys.holding_state = Hold_NotHolding;
                 sys.state = pending_state = new_state;
                 stateHandler = state_idle;
+#ifdef ENABLE_HOLD_JOG
+                memset(&hold_jog, 0, sizeof(hold_jog));
+#endif
                 break;
 
             case STATE_CYCLE:
                 if(sys.state == STATE_IDLE) {
                     // Start cycle only if queued motions exist in planner buffer and the motion is not canceled.
                     plan_block_t *block;
+#ifdef ENABLE_WAIT_ON_INPUT_ASYNC
+                    if ((block = plan_get_current_block()) && !(block->condition.wait_on_input && wait_input_pending())) {
+#else
                     if ((block = plan_get_current_block())) {
+#endif
                         sys.state = new_state;
                         sys.steppers_deenergize = false;    // Cancel stepper deenergize if pending.
                         st_prep_buffer();                   // Initialize step segment buffer before beginning cycle.
@@ -213,6 +304,9 @@ void set_state (uint_fast16_t new_state)
                 sys.state = new_state;
                 sys.suspend = false;
                 stateHandler = state_noop;
+#ifdef ENABLE_HOLD_JOG
+                memset(&hold_jog, 0, sizeof(hold_jog));
+#endif
                 break;
         }
 
@@ -275,10 +369,20 @@ static void state_cycle (uint_fast16_t rt_exec)
     if ((rt_exec & EXEC_TOOL_CHANGE))
         hal.stream.suspend_read(true); // Block reading from input stream until tool change state is acknowledged
 
-    if (rt_exec & EXEC_CYCLE_COMPLETE)
+    if (rt_exec & EXEC_CYCLE_COMPLETE) {
+#ifdef ENABLE_COOLANT_QUEUE
+        gc_coolant_flush(); // Set any standalone coolant change not followed by motion
+#endif
+#ifdef ENABLE_POSITION_OUTPUTS
+        st_output_events_flush(); // Set outputs with a distance beyond the end of the motion
+#endif
         set_state(gc_state.tool_change ? STATE_TOOL_CHANGE : STATE_IDLE);
+    }
 
     if (rt_exec & EXEC_MOTION_CANCEL) {
+#ifdef ENABLE_HOLD_SEGMENT_REWIND
+        st_hold_rewind();                   // Retract queued segments so that deceleration starts sooner.
+#endif
         st_update_plan_block_parameters();  // Notify stepper module to recompute for hold deceleration.
         sys.suspend = true;
         sys.step_control.execute_hold = On; // Initiate suspend state with active flag.
@@ -311,11 +415,11 @@ static void state_await_motion_cancel (uint_fast16_t rt_exec)
             sys.step_control.flags = 0;
             plan_reset();
             st_reset();
+#ifdef ENABLE_WCO_MOTION_SYNC
+            system_wco_reset(); // Discard offsets queued with the cancelled jog motion.
+#endif
             gc_sync_position();
             plan_sync_position();
-#ifdef ENABLE_BACKLASH_COMPENSATION
-            mc_sync_backlash_position();
-#endif
             sys.suspend = false;
         }
         set_state(pending_state);
@@ -405,6 +509,19 @@ static void state_await_hold (uint_fast16_t rt_exec)
     }
 }
 
+// Restarts the cycle, after returning to the position where the hold was entered if jogged away from it.
+static void resume_cycle (void)
+{
+#ifdef ENABLE_HOLD_JOG
+    if(hold_jog.n_waypoints) {
+        hold_jog_return();
+        return;
+    }
+#endif
+    set_state(STATE_IDLE);
+    set_state(STATE_CYCLE);
+}
+
 static void state_await_resume (uint_fast16_t rt_exec)
 {
     if((rt_exec & EXEC_CYCLE_COMPLETE) && settings.parking.flags.enabled) {
@@ -443,6 +560,9 @@ static void state_await_resume (uint_fast16_t rt_exec)
                     if (park.retracting) {
                         handler_changed = true;
                         stateHandler = state_restore;
+#ifdef PARKING_OVERLAPPED_RESTORE
+                        state_restore_start(&restore_condition, restore_spindle_rpm);
+#endif
                         // Check to ensure the motion doesn't move below pull-out position.
                         if (park.target[settings.parking.axis] <= settings.parking.target) {
                             park.target[settings.parking.axis] = park.retract_waypoint;
@@ -474,10 +594,8 @@ static void state_await_resume (uint_fast16_t rt_exec)
         }
 
         // Restart cycle if there is no further processing to take place
-        if(!(handler_changed || sys.state == STATE_SLEEP)) {
-            set_state(STATE_IDLE);
-            set_state(STATE_CYCLE);
-        }
+        if(!(handler_changed || sys.state == STATE_SLEEP))
+            resume_cycle();
     }
 
     if (rt_exec & EXEC_SLEEP)
@@ -507,10 +625,8 @@ static void state_await_restore (uint_fast16_t rt_exec)
 
         hal.report.feedback_message(Message_None);
 
-        if(restart) {
-            set_state(STATE_IDLE);
-            set_state(STATE_CYCLE);
-        }
+        if(restart)
+            resume_cycle();
     }
 
     if(rt_exec & EXEC_FEED_HOLD) {
@@ -528,6 +644,9 @@ static void restart_retract (void)
 
     park.restart_retract = true;
     sys.parking_state = Parking_Retracting;
+#ifdef PARKING_OVERLAPPED_RESTORE
+    park.restored = false; // Spindle and coolant are de-energized again by the retract.
+#endif
 
     if (sys.step_control.execute_sys_motion) {
         st_update_plan_block_parameters(); // Notify stepper module to recompute for hold deceleration.
@@ -638,11 +757,143 @@ static void state_await_resumed (uint_fast16_t rt_exec)
             sys.step_control.flags = 0;
             st_parking_restore_buffer(); // Restore step segment buffer to normal run state.
         }
-        set_state(STATE_IDLE);
-        set_state(STATE_CYCLE);
+        resume_cycle();
+    }
+}
+
+#ifdef ENABLE_HOLD_JOG
+
+// Decelerates the jog or return motion to a stop, a safety door or sleep request is executed when stopped.
+static void hold_jog_stop (uint_fast16_t rt_exec)
+{
+    hold_jog.pending |= rt_exec & (EXEC_SAFETY_DOOR|EXEC_SLEEP);
+
+    if(!hold_jog.stop) {
+        hold_jog.stop = true;
+        st_update_plan_block_parameters(); // Notify stepper module to recompute for hold deceleration.
+        sys.step_control.execute_hold = On;
+        sys.step_control.execute_sys_motion = On;
+    }
+}
+
+// Restores the step segment buffer to the held job after a jog or return motion. Returns true if the motion
+// was stopped before reaching its target.
+static bool hold_jog_motion_end (void)
+{
+    bool stopped = hold_jog.stop;
+
+    if(sys.step_control.execute_sys_motion) {
+        sys.step_control.flags = 0;
+        st_parking_restore_buffer(); // Restore step segment buffer to normal run state.
+    }
+
+    hold_jog.motion = hold_jog.stop = false;
+    stateHandler = state_await_resume;
+
+    if(hold_jog.pending) {
+        uint_fast16_t pending = hold_jog.pending;
+        hold_jog.pending = 0;
+        set_state(pending & EXEC_SAFETY_DOOR ? STATE_SAFETY_DOOR : STATE_SLEEP);
+    }
+
+    return stopped;
+}
+
+// Queues a system motion to target with planner data for a jog or return motion.
+static bool hold_jog_motion (float *target, plan_line_data_t *pl_data, void (*handler)(uint_fast16_t rt_exec))
+{
+    pl_data->condition.system_motion = On;
+    pl_data->condition.no_feed_override = On;
+    pl_data->condition.is_rpm_rate_adjusted = pl_data->condition.is_laser_ppi_mode = Off;
+    pl_data->condition.coolant = restore_condition.coolant;
+    pl_data->condition.spindle = restore_condition.spindle;
+    pl_data->spindle.rpm = restore_spindle_rpm;
+    if(settings.flags.laser_mode) // Keep the laser off.
+        pl_data->condition.spindle.value = 0;
+
+    if((hold_jog.motion = mc_parking_motion(target, pl_data)))
+        stateHandler = handler;
+
+    return hold_jog.motion;
+}
+
+// Starts the return motion to the start of the last jog.
+static void hold_jog_return (void)
+{
+    plan_line_data_t plan_data;
+    hold_jog_waypoint_t *waypoint = &hold_jog.waypoint[hold_jog.n_waypoints - 1];
+
+    // Resumed from a safety door, the door is closed and the machine restored at the position jogged to.
+    sys.state = STATE_HOLD;
+    sys.holding_state = Hold_Complete;
+    sys.parking_state = Parking_DoorClosed;
+
+    memset(&plan_data, 0, sizeof(plan_line_data_t));
+    plan_data.feed_rate = waypoint->feed_rate;
+    plan_data.line_number = JOG_LINE_NUMBER;
+
+    if(!hold_jog_motion(waypoint->target, &plan_data, state_hold_jog_return)) {
+        system_clear_exec_state_flag(EXEC_CYCLE_COMPLETE); // Already there, no motion.
+        hold_jog.n_waypoints--;
+        resume_cycle();
+    }
+}
+
+static void state_hold_jogging (uint_fast16_t rt_exec)
+{
+    if(rt_exec & (EXEC_MOTION_CANCEL|EXEC_FEED_HOLD|EXEC_SAFETY_DOOR|EXEC_SLEEP))
+        hold_jog_stop(rt_exec);
+
+    if(rt_exec & EXEC_CYCLE_COMPLETE)
+        hold_jog_motion_end();
+}
+
+static void state_hold_jog_return (uint_fast16_t rt_exec)
+{
+    if(rt_exec & (EXEC_FEED_HOLD|EXEC_SAFETY_DOOR|EXEC_SLEEP))
+        hold_jog_stop(rt_exec);
+
+    if(rt_exec & EXEC_CYCLE_COMPLETE) {
+        uint_fast8_t n_waypoints = hold_jog.n_waypoints;
+        if(!hold_jog_motion_end()) {
+            hold_jog.n_waypoints = n_waypoints - 1;
+            if(stateHandler == state_await_resume)
+                resume_cycle();
+        }
     }
 }
 
+// Returns true if a jog command can be executed, i.e. when a feed hold is complete and no jog is executing.
+bool state_hold_jog_ready (void)
+{
+    return sys.state == STATE_HOLD && stateHandler == state_await_resume && !hold_jog.motion &&
+            hold_jog.n_waypoints < HOLD_JOG_WAYPOINTS && !mc_canned_pending();
+}
+
+// Executes a $J= jog command line during a feed hold.
+status_code_t state_hold_jog (char *line)
+{
+    return state_hold_jog_ready() ? gc_execute_hold_jog(line) : Status_IdleError;
+}
+
+// Executes a jog motion to target during a feed hold, called by mc_jog_execute().
+status_code_t state_hold_jog_motion (float *target, plan_line_data_t *pl_data)
+{
+    hold_jog_waypoint_t *waypoint = &hold_jog.waypoint[hold_jog.n_waypoints];
+
+    system_convert_array_steps_to_mpos(waypoint->target, sys_position);
+    waypoint->feed_rate = pl_data->feed_rate;
+
+    if(hold_jog_motion(target, pl_data, state_hold_jogging))
+        hold_jog.n_waypoints++;
+    else
+        system_clear_exec_state_flag(EXEC_CYCLE_COMPLETE); // No motion.
+
+    return Status_OK;
+}
+
+#endif
+
 static void state_noop (uint_fast16_t rt_exec)
 {
     // Do nothing - state change requests are handled elsewhere or ignored.
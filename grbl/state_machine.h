@@ -25,3 +25,16 @@ void set_state (uint_fast16_t state);
 void update_state (uint_fast16_t rt_exec);
 bool state_door_reopened (void);
 void state_suspend_manager (void);
+
+#ifdef ENABLE_HOLD_JOG
+
+// Max number of jogs away from a feed hold, the return retraces them.
+#ifndef HOLD_JOG_WAYPOINTS
+#define HOLD_JOG_WAYPOINTS 16
+#endif
+
+bool state_hold_jog_ready (void);
+status_code_t state_hold_jog (char *line);
+status_code_t state_hold_jog_motion (float *target, plan_line_data_t *pl_data);
+
+#endif
@@ -0,0 +1,62 @@
+/*
+  stepdir_map.c - port wide step and direction output lookup tables
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+/*
+  Drivers with step or direction pins scattered over several ports may use these tables to update
+  each port with a single write to its set and reset registers, in place of a test and write per pin.
+  The step ISR then takes the same time regardless of which axes are stepped, and all pins on a port
+  change at the same time. The tables are indexed by the axes bits as passed to the driver, the pins of
+  an axis may be on different ports and more than one pin may be driven by an axis (ganged motors).
+*/
+
+uint_fast8_t stepdir_map_init (stepdir_port_t *ports, uint_fast8_t max_ports, const stepdir_pin_t *pins, uint_fast8_t n_pins, axes_signals_t invert)
+{
+    uint_fast8_t n_ports = 0, idx, port;
+    uint32_t value;
+
+    for(idx = 0; idx < n_pins; idx++) {
+
+        for(port = 0; port < n_ports && ports[port].port != pins[idx].port; port++);
+
+        if(port == n_ports) {
+            if(n_ports == max_ports)
+                return 0;
+            memset(&ports[port], 0, sizeof(stepdir_port_t));
+            ports[port].port = pins[idx].port;
+            n_ports++;
+        }
+
+        ports[port].mask |= pins[idx].bit;
+
+        for(value = 0; value < (1 << N_AXIS); value++) {
+            if((value ^ invert.mask) & bit(pins[idx].axis))
+                ports[port].set[value] |= pins[idx].bit;
+        }
+    }
+
+    for(port = 0; port < n_ports; port++) {
+        for(value = 0; value < (1 << N_AXIS); value++)
+            ports[port].reset[value] = ports[port].mask & ~ports[port].set[value];
+    }
+
+    return n_ports;
+}
@@ -0,0 +1,45 @@
+/*
+  stepdir_map.h - port wide step and direction output lookup tables
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _STEPDIR_MAP_H_
+#define _STEPDIR_MAP_H_
+
+// An output pin driven by an axis bit, port is an opaque driver specific port identifier
+// such as the address of the port registers. Ports are only compared for equality.
+typedef struct {
+    uint8_t axis;
+    void *port;
+    uint32_t bit;
+} stepdir_pin_t;
+
+// Set and reset masks for all values of the axes bits, to be written to the set and reset
+// (or the masked data) registers of the port. Output inversion is applied by the tables.
+typedef struct {
+    void *port;
+    uint32_t mask;                  // All mapped pins of the port
+    uint32_t set[1 << N_AXIS];
+    uint32_t reset[1 << N_AXIS];
+} stepdir_port_t;
+
+// Builds the tables for the pins, returns the number of ports mapped or 0 if the pins are on more than max_ports ports.
+// Call from the driver when pins are set up and when the output inversion setting changes.
+uint_fast8_t stepdir_map_init (stepdir_port_t *ports, uint_fast8_t max_ports, const stepdir_pin_t *pins, uint_fast8_t n_pins, axes_signals_t invert);
+
+#endif
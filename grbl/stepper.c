@@ -26,7 +26,21 @@
 
 // Some useful constants.
 #define DT_SEGMENT (1.0f/(ACCELERATION_TICKS_PER_SECOND*60.0f)) // min/segment
-#define REQ_MM_INCREMENT_SCALAR 1.25f
+
+#ifdef ENABLE_FEED_PER_REV_TRACKING
+#define FEED_PER_REV_MIN_RATIO 0.05f // Lowest measured to programmed RPM ratio the feed rate is scaled by, below it motion is held
+#endif
+
+// A block held partially completed is kept when system motions may be executed in the hold.
+#ifdef ENABLE_HOLD_JOG
+#define SYSTEM_MOTION_IN_HOLD true
+#else
+#define SYSTEM_MOTION_IN_HOLD PARKING_ENABLED
+#endif
+
+#if defined(ENABLE_JERK_ACCELERATION) || defined(ENABLE_INPUT_SHAPING)
+#define SHAPED_RAMPS // Acceleration ramps are shaped by ramp_init() and ramp_position().
+#endif
 
 typedef enum {
     Ramp_Accel,
@@ -48,26 +62,74 @@ typedef union {
 
 // Holds the planner block Bresenham algorithm execution data for the segments in the segment
 // buffer. Normally, this buffer is partially in-use, but, for the worst case scenario, it will
-// never exceed the number of accessible stepper buffer segments (SEGMENT_BUFFER_SIZE-1).
+// never exceed the number of accessible stepper buffer segments (segment_buffer_size-1).
 // NOTE: This data is copied from the prepped planner blocks so that the planner blocks may be
 // discarded when entirely consumed and completed by the segment buffer. Also, AMASS alters this
 // data for its own use.
-static st_block_t st_block_buffer[SEGMENT_BUFFER_SIZE - 1];
+static st_block_t *st_block_buffer = NULL;
 
 // Primary stepper segment ring buffer. Contains small, short line segments for the stepper
 // algorithm to execute, which are "checked-out" incrementally from the first block in the
 // planner buffer. Once "checked-out", the steps in the segments buffer cannot be modified by
 // the planner, where the remaining planner block steps still can.
-static segment_t segment_buffer[SEGMENT_BUFFER_SIZE];
+static segment_t *segment_buffer;
+static uint_fast16_t segment_buffer_size;
 
 // Stepper ISR data struct. Contains the running data for the main stepper ISR.
 static stepper_t st;
 
+#ifdef ENABLE_STEP_TIMING
+// Step timing of an axis in the executing segment, times are relative to the segment start.
+typedef struct {
+    uint32_t steps;         // Steps remaining in segment
+    uint32_t next;          // Time of next step (cycles)
+    uint32_t next_rem;      // Remainder of next step time (cycles / axis steps per tick)
+    uint32_t interval;      // Step interval (cycles)
+    uint32_t interval_rem;  // Remainder of step interval (cycles / axis steps per tick)
+    uint32_t counter;       // Bresenham counter at the segment end, the phase of the axis for the next segment
+} st_axis_timing_t;
+
+static struct {
+    int32_t now;            // Time of the step event pending output relative to the segment start, may be negative (cycles)
+    int32_t end;            // Segment duration (cycles)
+    uint32_t merge;         // Steps within this time after the first step of an event are output with it (cycles)
+    uint32_t pulse_cycles;  // Step pulse length (cycles)
+    axes_signals_t dominant; // Axis stepping on every Bresenham tick, it paces position outputs and laser power ramps
+    st_axis_timing_t axis[N_AXIS];
+} timing;
+#endif
+
+#ifdef ENABLE_REMOTE_STEPPER
+#define REMOTE_STATUS_EXECUTING 0x01
+#define REMOTE_STATUS_PROBE     0x02
+
+// Segments from the buffer tail up to send have been sent to the co-processor, the tail is advanced as they complete.
+static struct {
+    segment_t *send;        // Next segment to send
+    st_block_t *block;      // Block of the last block frame sent
+    uint8_t sent;           // Frames sent since reset, modulo 256
+    uint8_t received;       // Frames received by the co-processor at the last status, modulo 256
+    uint8_t completed;      // Segments completed since reset, modulo 256
+    uint8_t free;           // Free co-processor queue slots at the last status
+    bool executing;         // Segments sent and the cycle end not yet signalled
+    volatile bool busy;     // Sending in progress, or the segment buffer head is being moved back
+} remote;
+#endif
+
+#ifdef ENABLE_MOTION_LINK
+static struct {
+    segment_t *send;                // Leader: next segment to send to the follower
+    st_block_t *block;              // Leader: block of the last block frame sent. Follower: block being received
+    uint8_t block_id;               // Follower: leader id of the block being received
+    bool running;                   // Follower: stepper driver interrupt started for the received segments
+    volatile uint_fast8_t syncs;    // Follower: sync pulses not yet consumed by a segment start
+} link;
+#endif
+
 #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
 typedef struct {
-    uint32_t level_1;
-    uint32_t level_2;
-    uint32_t level_3;
+    uint_fast8_t max_level;             // Number of AMASS levels in use, the lower of MAX_AMASS_LEVEL and the driver capability
+    uint32_t level[MAX_AMASS_LEVEL];    // Level cutoffs in timer cycles per step, element n is the cutoff for level n + 1
 } amass_t;
 
 static amass_t amass;
@@ -85,6 +147,72 @@ static segment_t *segment_buffer_head, *segment_next_head;
 static plan_block_t *pl_block;     // Pointer to the planner block being prepped
 static st_block_t *st_prep_block;  // Pointer to the stepper block data being prepped
 
+#ifdef ENABLE_PERF_COUNTERS
+// False if the last segment prepped ends at zero speed, motion is then expected to stop when it has been executed.
+static volatile bool motion_continues = false;
+#endif
+
+#ifdef ENABLE_LASER_PPI
+// True while the driver outputs laser PPI pulses.
+static bool ppi_pulses = false;
+#endif
+
+#ifdef ENABLE_POSITION_OUTPUTS
+// Output commands with a distance beyond the end of the block prepped, carried to the following blocks.
+static output_command_t *output_carry = NULL;
+#endif
+
+#ifdef ENABLE_JOB_STATS
+
+// Next segment to be counted in the job statistics, segments are counted when the stepper driver has completed them.
+static segment_t *stats_tail;
+
+// Counts the segments completed by the stepper driver. Called by the segment generator before a stepper
+// block is reused, the blocks of the segments counted are then still intact.
+static void stats_count (void)
+{
+    segment_t *tail = (segment_t *)segment_buffer_tail;
+
+    while (stats_tail != tail) {
+        if (stats_tail->stats_dt > 0.0f)
+            job_stats_segment(stats_tail->exec_block->stats_distance, stats_tail->stats_fraction, stats_tail->stats_dt, stats_tail->exec_block->stats_spindle_on);
+        stats_tail = stats_tail->next;
+    }
+}
+
+#endif
+
+#ifdef ENABLE_JERK_ACCELERATION
+// Jerk limited acceleration or deceleration ramp, see scurve_init() for details.
+typedef struct {
+    bool active;            // True when ramp data is valid for the current ramp
+    float v0;               // Speed at start of ramp (mm/min)
+    float v1;               // Speed at end of ramp (mm/min)
+    float mm_start;         // Start of ramp measured from end of block (mm)
+    float t;                // Time elapsed since start of ramp (min)
+    float t_ramp;           // Ramp duration (min)
+    float t_jerk;           // Duration of each of the jerk phases at start and end of ramp (min)
+    float accel;            // Signed peak acceleration (mm/min^2)
+    float jerk;             // Signed jerk (mm/min^3)
+} scurve_t;
+#endif
+
+#ifdef ENABLE_INPUT_SHAPING
+// Input shaped acceleration or deceleration ramp, see shaper_init() for details.
+typedef struct {
+    bool active;            // True when ramp data is valid for the current ramp
+    float v0;               // Speed at start of ramp (mm/min)
+    float mm_start;         // Start of ramp measured from end of block (mm)
+    float t;                // Time elapsed since start of ramp (min)
+    float t_ramp;           // Ramp duration (min)
+    float t_accel;          // Duration of the unshaped constant acceleration ramp (min)
+    float accel;            // Signed acceleration of the unshaped ramp (mm/min^2)
+    uint_fast8_t n_impulses;
+    float amplitude[9];     // Impulse amplitudes of the cascaded shapers
+    float time[9];          // Impulse times of the cascaded shapers (min)
+} shaped_ramp_t;
+#endif
+
 // Segment preparation data struct. Contains all the necessary information to compute new segments
 // based on the current executing planner block.
 typedef struct {
@@ -98,6 +226,7 @@ typedef struct {
     st_block_t *last_st_block;
     uint32_t last_steps_remaining;
     float last_steps_per_mm;
+    float last_req_mm_increment;
     float last_dt_remainder;
 
     ramp_type_t ramp_type;  // Current segment ramp state
@@ -106,16 +235,210 @@ typedef struct {
     float current_speed;    // Current speed at the end of the segment buffer (mm/min)
     float maximum_speed;    // Maximum speed of executing block. Not always nominal speed. (mm/min)
     float exit_speed;       // Exit speed of executing block (mm/min)
+    float exit_speed_sqr;   // Planned exit speed squared the exit speed was computed from, -1.0 if not planned (mm/min)^2
     float accelerate_until; // Acceleration ramp end measured from end of block (mm)
     float decelerate_after; // Deceleration ramp start measured from end of block (mm)
     float target_position;  //
     float target_feed;      //
     float inv_feedrate;     // Used by PWM laser mode to speed up segment calculations.
     float current_spindle_rpm;
+#ifdef ENABLE_JERK_ACCELERATION
+    scurve_t ramp;
+#endif
+#ifdef ENABLE_INPUT_SHAPING
+    shaped_ramp_t ramp;
+#endif
+#ifdef ENABLE_NATIVE_ARCS
+    int32_t arc_position[N_AXIS]; // Position at the end of the last chord prepped from the current arc block (steps)
+    bool arc_chord;               // A chord has been prepped from the current arc block, the next needs a new stepper block
+#endif
 } st_prep_t;
 
 static st_prep_t prep;
 
+#ifdef ENABLE_JERK_ACCELERATION
+
+/* Jerk limited ramps.
+
+  The planner plans trapezoidal velocity profiles, each ramp is then shaped into an S-curve here.
+  The S-curve has the same duration and covers the same distance as the planned constant acceleration
+  ramp so the planned entry-, exit- and cruise speeds and distances are kept as-is:
+
+    acceleration
+         ^    ________
+         |   /        \          Jerk phase, duration t_jerk
+         |  /          \         Constant acceleration phase
+         | /            \        Jerk phase, duration t_jerk
+         +----------------> time
+         |<--  t_ramp  -->|
+
+  The planner derates the block acceleration so that a ramp from rest to nominal speed peaks at the
+  axis limited acceleration, shorter ramps may need higher jerk than set to keep within the peak
+  acceleration. Acceleration is not continuous across block boundaries and replans.
+*/
+
+// Initializes a jerk limited ramp from current speed to end_speed, ending at mm_end from end of block.
+// Leaves the ramp inactive if there is nothing to shape, the caller then falls back to constant acceleration.
+static void scurve_init (float mm_start, float mm_end, float end_speed)
+{
+    float dv = fabsf(end_speed - prep.current_speed);
+
+    if((prep.ramp.active = dv > 1.0f && mm_start > mm_end)) {
+
+        float t_ramp, t_jerk, accel, disc;
+
+        prep.ramp.v0 = prep.current_speed;
+        prep.ramp.v1 = end_speed;
+        prep.ramp.mm_start = mm_start;
+        prep.ramp.t = 0.0f;
+        prep.ramp.t_ramp = t_ramp = 2.0f * (mm_start - mm_end) / (prep.ramp.v0 + prep.ramp.v1);
+
+        if((disc = t_ramp * t_ramp - 4.0f * dv / pl_block->jerk) >= 0.0f) {
+            t_jerk = 0.5f * (t_ramp - sqrtf(disc));
+            accel = pl_block->jerk * t_jerk;
+        } else { // Not enough time to reach constant acceleration, use a triangular acceleration profile.
+            t_jerk = 0.5f * t_ramp;
+            accel = 2.0f * dv / t_ramp;
+        }
+
+        if(accel > pl_block->max_acceleration) { // Keep within acceleration limit, jerk will be higher than set.
+            accel = pl_block->max_acceleration;
+            if((t_jerk = t_ramp - dv / accel) < 0.0f)
+                t_jerk = 0.0f;
+        }
+
+        prep.ramp.t_jerk = t_jerk;
+        prep.ramp.accel = end_speed > prep.current_speed ? accel : -accel;
+        prep.ramp.jerk = t_jerk > 0.0f ? prep.ramp.accel / t_jerk : 0.0f;
+    }
+}
+
+// Returns distance from end of block at ramp time t and updates current speed accordingly.
+static float scurve_position (float t)
+{
+    float mm;
+    scurve_t *ramp = &prep.ramp;
+
+    if(t < ramp->t_jerk) {
+        prep.current_speed = ramp->v0 + 0.5f * ramp->jerk * t * t;
+        mm = t * (ramp->v0 + ramp->jerk * t * t * (1.0f / 6.0f));
+    } else if(t <= ramp->t_ramp - ramp->t_jerk) {
+        float tc = t - ramp->t_jerk;
+        prep.current_speed = ramp->v0 + ramp->accel * (0.5f * ramp->t_jerk + tc);
+        mm = ramp->v0 * t + ramp->accel * (ramp->t_jerk * ramp->t_jerk * (1.0f / 6.0f) + 0.5f * tc * (ramp->t_jerk + tc));
+    } else {
+        float tr = ramp->t_ramp - t;
+        prep.current_speed = ramp->v1 - 0.5f * ramp->jerk * tr * tr;
+        mm = 0.5f * (ramp->v0 + ramp->v1) * ramp->t_ramp - tr * (ramp->v1 - ramp->jerk * tr * tr * (1.0f / 6.0f));
+    }
+
+    return ramp->mm_start - mm;
+}
+
+#define ramp_init scurve_init
+#define ramp_position scurve_position
+
+#endif
+
+#ifdef ENABLE_INPUT_SHAPING
+
+/* Input shaped ramps.
+
+  The planner plans trapezoidal velocity profiles, each ramp is then replaced here by a constant acceleration
+  ramp convolved with the impulses of the block input shapers. Each impulse starts a fraction of the ramp,
+  delayed by the impulse time and scaled by its amplitude, so that the residual vibration excited at the
+  damped period of the shaper is cancelled:
+
+    speed
+      ^         ____           Ramp of the first impulse
+      |      __/               Ramp of the second impulse, delayed
+      |   __/                  Sum, the shaped ramp
+      |__/
+      +----------------> time
+      |<-- t_ramp -->|
+
+  The path is a straight line within a block so shaping the path speed shapes the motion of each axis.
+  The planner selects the shapers of the two axes moving the most, these are cascaded. The shaped ramp
+  covers the planned distance and keeps the planned entry-, exit- and cruise speeds, its acceleration is
+  higher than planned as the shapers add to the ramp time. The planner derates the block acceleration so
+  that a ramp from rest to nominal speed peaks at the axis limited acceleration, shorter ramps that would
+  exceed it are not shaped. Ramps are not convolved across block boundaries and replans.
+*/
+
+// Initializes a shaped ramp from current speed to end_speed, ending at mm_end from end of block.
+// Leaves the ramp inactive if there is nothing to shape, the caller then falls back to constant acceleration.
+static void shaper_init (float mm_start, float mm_end, float end_speed)
+{
+    float dv = end_speed - prep.current_speed;
+
+    if((prep.ramp.active = fabsf(dv) > 1.0f && mm_start > mm_end && pl_block->shaper_period[0] > 0.0f)) {
+
+        uint_fast8_t idx, idx2, n_impulses = 0;
+        float t_delay = 0.0f, centroid = 0.0f, t_accel;
+        const plan_shaper_t *shaper = plan_get_shaper();
+
+        // Cascade the shapers, the impulses are the products of the impulses of each shaper.
+        for(idx = 0; idx < shaper->n_impulses; idx++) {
+            if(pl_block->shaper_period[1] > 0.0f) {
+                for(idx2 = 0; idx2 < shaper->n_impulses; idx2++) {
+                    prep.ramp.amplitude[n_impulses] = shaper->amplitude[idx] * shaper->amplitude[idx2];
+                    prep.ramp.time[n_impulses++] = shaper->time[idx] * pl_block->shaper_period[0] + shaper->time[idx2] * pl_block->shaper_period[1];
+                }
+            } else {
+                prep.ramp.amplitude[n_impulses] = shaper->amplitude[idx];
+                prep.ramp.time[n_impulses++] = shaper->time[idx] * pl_block->shaper_period[0];
+            }
+        }
+
+        for(idx = 0; idx < n_impulses; idx++) {
+            t_delay = max(t_delay, prep.ramp.time[idx]);
+            centroid += prep.ramp.amplitude[idx] * prep.ramp.time[idx];
+        }
+
+        // Ramp time for the shaped ramp to cover the planned distance, see plan_shaper_init().
+        t_accel = (mm_start - mm_end - prep.current_speed * t_delay - dv * (t_delay - centroid)) * 2.0f / (prep.current_speed + end_speed);
+
+        if((prep.ramp.active = t_accel > 0.0f && fabsf(dv) <= pl_block->max_acceleration * t_accel * 1.001f)) {
+            prep.ramp.v0 = prep.current_speed;
+            prep.ramp.mm_start = mm_start;
+            prep.ramp.t = 0.0f;
+            prep.ramp.t_accel = t_accel;
+            prep.ramp.t_ramp = t_accel + t_delay;
+            prep.ramp.accel = dv / t_accel;
+            prep.ramp.n_impulses = n_impulses;
+        }
+    }
+}
+
+// Returns distance from end of block at ramp time t and updates current speed accordingly.
+static float shaper_position (float t)
+{
+    uint_fast8_t idx;
+    float dt, dv = 0.0f, mm = 0.0f;
+    shaped_ramp_t *ramp = &prep.ramp;
+
+    for(idx = 0; idx < ramp->n_impulses; idx++) {
+        if((dt = t - ramp->time[idx]) > 0.0f) {
+            if(dt < ramp->t_accel) {
+                dv += ramp->amplitude[idx] * dt;
+                mm += ramp->amplitude[idx] * 0.5f * dt * dt;
+            } else {
+                dv += ramp->amplitude[idx] * ramp->t_accel;
+                mm += ramp->amplitude[idx] * ramp->t_accel * (dt - 0.5f * ramp->t_accel);
+            }
+        }
+    }
+
+    prep.current_speed = ramp->v0 + ramp->accel * dv;
+
+    return ramp->mm_start - ramp->v0 * t - ramp->accel * mm;
+}
+
+#define ramp_init shaper_init
+#define ramp_position shaper_position
+
+#endif
+
 
 /*    BLOCK VELOCITY PROFILE DEFINITION
           __________________________
@@ -174,6 +497,10 @@ void st_wake_up ()
     st.exec_block = NULL;
     sys.steppers_deenergize = false;
 
+#ifdef ENABLE_FOLLOWING_ERROR
+    following_error_start();
+#endif
+
     hal.stepper_wake_up();
 }
 
@@ -185,6 +512,17 @@ ISR_CODE void st_go_idle ()
 
     hal.stepper_go_idle(false);
 
+#ifdef ENABLE_FOLLOWING_ERROR
+    following_error_stop();
+#endif
+
+#ifdef ENABLE_LASER_PPI
+    if (ppi_pulses) {
+        ppi_pulses = false;
+        hal.laser_pulse_train(0, 0, 0);
+    }
+#endif
+
     // Set stepper driver idle state, disabled or enabled, depending on settings and circumstances.
     if (((settings.steppers.idle_lock_time != 0xff) || sys_rt_exec_alarm || sys.state == STATE_SLEEP) && sys.state != STATE_HOMING) {
         // Force stepper dwell to lock axes for a defined amount of time to ensure the axes come to a complete
@@ -195,6 +533,317 @@ ISR_CODE void st_go_idle ()
         hal.stepper_enable(settings.steppers.deenergize);
 }
 
+// Memory barrier for handing segments between the segment generator and the stepper ISR,
+// these may run on different cores.
+#ifdef __GNUC__
+#define SEGMENT_BUFFER_BARRIER() __sync_synchronize()
+#else
+#define SEGMENT_BUFFER_BARRIER()
+#endif
+
+// Pops the next step segment from the segment buffer and initializes the stepper variables for it,
+// executes block start actions if it starts a new planner block. Returns false if the buffer is empty.
+inline static bool st_load_segment (void)
+{
+#ifdef ENABLE_MOTION_TRACE
+    bool new_block = false;
+#endif
+
+    // Anything in the buffer? If so, load and initialize next step segment.
+    if (segment_buffer_head == segment_buffer_tail)
+        return false;
+
+    SEGMENT_BUFFER_BARRIER(); // Do not read the segment before it is published
+
+    // Initialize new step segment and load number of steps to execute
+    st.exec_segment = (segment_t *)segment_buffer_tail;
+    st.step_count = st.exec_segment->n_step; // NOTE: Can sometimes be zero when moving slow.
+
+    // If the new segment starts a new planner block, initialize stepper variables and counters.
+    if (st.exec_block != st.exec_segment->exec_block) {
+
+#ifdef ENABLE_MOTION_TRACE
+        new_block = true;
+#endif
+        st.exec_block = st.exec_segment->exec_block;
+        st.step_event_count = st.exec_block->step_event_count;
+        st.dir_outbits = st.exec_block->direction_bits;
+        st.new_block = true;
+        st.active_axes = st.exec_block->active_axes;
+        memcpy(st.position_delta, st.exec_block->position_delta, sizeof(st.position_delta));
+
+#ifdef ENABLE_BACKLASH_COMPENSATION
+        // Start the take-up phase if the block reverses the direction of an axis with backlash.
+        uint_fast8_t idx = N_AXIS;
+        st.backlash_axes.mask = 0;
+        st.backlash_tick = 0;
+        do {
+            idx--;
+            if (st.exec_block->backlash_taken[idx] < st.exec_block->backlash_steps[idx])
+                st.backlash_axes.mask |= bit(idx);
+        } while(idx);
+#endif
+
+        if(st.exec_block->overrides.sync)
+            sys.override.control = st.exec_block->overrides;
+
+        // Execute output commands to be syncronized with motion
+        while(st.exec_block->output_commands) {
+            output_command_t *cmd = st.exec_block->output_commands;
+            if(cmd->is_digital)
+                hal.port.digital_out(cmd->port, cmd->value != 0.0f);
+            else
+                hal.port.analog_out(cmd->port, cmd->value);
+            cmd = cmd->next;
+            pool_output_command_release(st.exec_block->output_commands);
+            st.exec_block->output_commands = cmd;
+        }
+
+#ifdef ENABLE_COOLANT_QUEUE
+        if(st.exec_block->coolant_sync) {
+            st.exec_block->coolant_sync = false;
+            hal.coolant_set_state(st.exec_block->coolant);
+            sys.report.coolant = On;
+        }
+#endif
+
+#ifdef ENABLE_CAN_IO
+        if(st.exec_block->can_io_commit) {
+            st.exec_block->can_io_commit = false;
+            can_io_commit((uint8_t)st.exec_block->id);
+        }
+#endif
+
+#ifdef ENABLE_WCO_MOTION_SYNC
+        // Report the work coordinate offset the block was programmed with.
+        if(st.exec_block->wco) {
+            system_wco_execute(st.exec_block->wco);
+            st.exec_block->wco = NULL;
+        }
+#endif
+
+        // "Enqueue" any message to be displayed (by foreground process)
+        if(st.exec_block->message) {
+            protocol_message(st.exec_block->message);
+            st.exec_block->message = NULL;
+        }
+
+        // Initialize Bresenham line and distance counters
+        st.counter_x = st.counter_y = st.counter_z
+        #ifdef A_AXIS
+          = st.counter_a
+        #endif
+        #ifdef B_AXIS
+          = st.counter_b
+        #endif
+        #ifdef C_AXIS
+          = st.counter_c
+        #endif
+          = st.step_event_count >> 1;
+
+      #ifndef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+        memcpy(st.steps, st.exec_block->steps, sizeof(st.steps));
+       #ifdef ENABLE_POSITION_OUTPUTS
+        st.output_increment = 1;
+       #endif
+      #endif
+    }
+
+  #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+    // With AMASS enabled, adjust Bresenham axis increment counters according to AMASS level.
+    st.amass_level = st.exec_segment->amass_level;
+   #ifdef ENABLE_POSITION_OUTPUTS
+    st.output_increment = 1 << (MAX_AMASS_LEVEL - st.amass_level);
+   #endif
+    st.steps[X_AXIS] = st.exec_block->steps[X_AXIS] >> st.amass_level;
+    st.steps[Y_AXIS] = st.exec_block->steps[Y_AXIS] >> st.amass_level;
+    st.steps[Z_AXIS] = st.exec_block->steps[Z_AXIS] >> st.amass_level;
+   #ifdef A_AXIS
+    st.steps[A_AXIS] = st.exec_block->steps[A_AXIS] >> st.amass_level;
+   #endif
+   #ifdef B_AXIS
+    st.steps[B_AXIS] = st.exec_block->steps[B_AXIS] >> st.amass_level;
+   #endif
+   #ifdef C_AXIS
+    st.steps[C_AXIS] = st.exec_block->steps[C_AXIS] >> st.amass_level;
+   #endif
+ #endif
+
+#ifdef ENABLE_LASER_POWER_RAMP
+    st.spindle_pwm_slope = 0;
+#endif
+
+#ifdef ENABLE_LASER_PPI
+    // Hand the laser pulse timing of the segment to the driver, or stop the pulses.
+    if (st.exec_segment->ppi_period || ppi_pulses) {
+        ppi_pulses = st.exec_segment->ppi_period != 0;
+        hal.laser_pulse_train(st.exec_segment->ppi_delay, st.exec_segment->ppi_period, st.exec_segment->ppi_pulse_length);
+    }
+#endif
+
+    if(st.exec_segment->update_rpm) {
+      #ifdef ENABLE_LASER_POWER_RAMP
+        if(st.exec_segment->spindle_pwm_slope && hal.spindle_ramp_pwm)
+            hal.spindle_ramp_pwm(st.exec_segment);
+        else {
+            // Start at the middle of the PWM count for rounding, the ramp is then stepped by the ISR.
+            st.spindle_pwm = ((uint32_t)st.exec_segment->spindle_pwm << 16) | 0x8000;
+            st.spindle_pwm_slope = st.exec_segment->spindle_pwm_slope;
+            hal.spindle_update_pwm(st.exec_segment->spindle_pwm);
+        }
+      #elif defined(SPINDLE_PWM_DIRECT)
+        hal.spindle_update_pwm(st.exec_segment->spindle_pwm);
+      #else
+        hal.spindle_update_rpm(st.exec_segment->spindle_rpm);
+      #endif
+    }
+
+#ifdef ENABLE_FOLLOWING_ERROR
+    following_error_check();
+#endif
+
+#ifdef ENABLE_MOTION_TRACE
+    trace_segment(st.exec_segment, st.exec_block, new_block);
+#endif
+
+    return true;
+}
+
+// Segment buffer empty. Shutdown.
+inline static void st_segment_buffer_empty (void)
+{
+#ifdef ENABLE_PERF_COUNTERS
+    if(motion_continues && sys.state == STATE_CYCLE)
+        PERF_EVENT(Perf_SegmentUnderrun); // Segment generator did not keep up, stopping without deceleration
+    motion_continues = false;
+#endif
+
+    st_go_idle();
+    // Ensure pwm is set properly upon completion of rate-controlled motion.
+    if (st.exec_block && st.exec_block->dynamic_rpm && LASER_MODE)
+        hal.spindle_set_state((spindle_state_t){0}, 0.0f);
+
+    system_set_exec_state_flag(EXEC_CYCLE_COMPLETE); // Flag main program for cycle complete
+}
+
+// Check probing state.
+// Monitors probe pin state and records the system position when detected.
+// NOTE: This function must be extremely efficient as to not bog down the stepper ISR.
+inline static void st_probe_check (void)
+{
+    if (sys_probing_state == Probing_Active && !hal.driver_cap.probe_latch && hal.probe_get_state().triggered) {
+        sys_probing_state = Probing_Off;
+        memcpy(sys_probe_position, sys_position, sizeof(sys_position));
+        bit_true(sys_rt_exec_state, EXEC_MOTION_CANCEL);
+    }
+}
+
+// Probe edge interrupt handler, called by drivers that has the probe_latch capability.
+// Records the position passed, or the current system position if NULL, when probing.
+// Drivers with a hardware capture timer may pass the position interpolated to the probe edge.
+ISR_CODE void probe_interrupt_handler (int32_t (*position)[N_AXIS])
+{
+    if (sys_probing_state == Probing_Active) {
+        sys_probing_state = Probing_Off;
+        memcpy(sys_probe_position, position ? *position : sys_position, sizeof(sys_position));
+        bit_true(sys_rt_exec_state, EXEC_MOTION_CANCEL);
+    }
+}
+
+// Updates the system position for a step.
+#define ST_AXIS_POSITION(axis) sys_position[axis] += st.position_delta[axis];
+
+// Executes the Bresenham step for one axis, axes without steps in the current block are skipped.
+#define ST_AXIS_TICK(axis, counter, bit) \
+    if (st.active_axes.bit) { \
+        st.counter += st.steps[axis]; \
+        if (st.counter > st.step_event_count) { \
+            step_outbits.bit = On; \
+            st.counter -= st.step_event_count; \
+            ST_AXIS_POSITION(axis) \
+        } \
+    }
+
+#ifdef ENABLE_POSITION_OUTPUTS
+
+// Advances the position along the block and executes the output commands that are due, if any.
+// Output triggers are in ISR ticks at the highest AMASS level, each tick at a lower level advances the position more.
+inline static void st_output_events_tick (void)
+{
+    output_command_t *cmd;
+
+    if((cmd = st.exec_block->output_events) && (st.exec_block->output_position += st.output_increment) >= cmd->trigger) do {
+        if(cmd->is_digital)
+            hal.port.digital_out(cmd->port, cmd->value != 0.0f);
+        else
+            hal.port.analog_out(cmd->port, cmd->value);
+        st.exec_block->output_events = cmd->next;
+        pool_output_command_release(cmd);
+    } while((cmd = st.exec_block->output_events) && st.exec_block->output_position >= cmd->trigger);
+}
+
+#endif
+
+// Executes one step tick of the step displacement profile by Bresenham line algorithm,
+// updates the system position and returns the step bits to output.
+inline static axes_signals_t st_bresenham_tick (void)
+{
+    register axes_signals_t step_outbits = (axes_signals_t){0};
+
+    sys_position_write_begin();
+
+    ST_AXIS_TICK(X_AXIS, counter_x, x);
+    ST_AXIS_TICK(Y_AXIS, counter_y, y);
+    ST_AXIS_TICK(Z_AXIS, counter_z, z);
+  #ifdef A_AXIS
+    ST_AXIS_TICK(A_AXIS, counter_a, a);
+  #endif
+  #ifdef B_AXIS
+    ST_AXIS_TICK(B_AXIS, counter_b, b);
+  #endif
+  #ifdef C_AXIS
+    ST_AXIS_TICK(C_AXIS, counter_c, c);
+  #endif
+
+    sys_position_write_end();
+
+    // During a homing cycle, lock out and prevent desired axes from moving.
+    if (sys.state == STATE_HOMING)
+        step_outbits.value &= sys.homing_axis_lock.mask;
+
+    return step_outbits;
+}
+
+#ifdef ENABLE_BACKLASH_COMPENSATION
+
+// Executes one tick of the backlash take-up phase of a block reversing the direction of an axis and returns the
+// step bits to output. The take-up steps are output ahead of the steps of the block, at the step rate of the
+// dominant axis of the segment executing, and do not change the system position. The Bresenham counters and
+// the segment step count are not advanced, the block is thus executed unchanged after the take-up phase.
+// NOTE: The take-up steps executed are kept in the block so that they survive a stop in the block.
+inline static axes_signals_t st_backlash_tick (void)
+{
+    register axes_signals_t step_outbits = (axes_signals_t){0};
+    uint_fast8_t idx = N_AXIS;
+
+  #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+    if (st.backlash_tick++ & ((1 << st.amass_level) - 1))
+        return step_outbits;
+  #endif
+
+    do {
+        idx--;
+        if (st.backlash_axes.mask & bit(idx)) {
+            step_outbits.mask |= bit(idx);
+            if (++st.exec_block->backlash_taken[idx] == st.exec_block->backlash_steps[idx])
+                st.backlash_axes.mask &= ~bit(idx);
+        }
+    } while(idx);
+
+    return step_outbits;
+}
+
+#endif
 
 /* "The Stepper Driver Interrupt" - This timer interrupt is the workhorse of Grbl. Grbl employs
    the venerable Bresenham line algorithm to manage and exactly synchronize multi-axis moves.
@@ -243,229 +892,667 @@ ISR_CODE void st_go_idle ()
 */
 ISR_CODE void stepper_driver_interrupt_handler (void)
 {
+    // Start a step pulse when there is a block to execute.
+    if(st.exec_block) {
+
+        hal.stepper_pulse_start(&st);
+
+        if (st.step_count == 0) // Segment is complete. Discard current segment.
+            st.exec_segment = NULL;
+    }
+
+    // If there is no step segment, attempt to pop one from the stepper buffer
+    if (st.exec_segment == NULL) {
+#ifdef ENABLE_MOTION_LINK
+        // The follower starts a segment on the sync pulse from the leader starting it, ticks are idle while waiting.
+        if (hal.motion_link.follower && link.syncs == 0 && segment_buffer_tail != segment_buffer_head)
+            return;
+#endif
+        if (st_load_segment()) {
+#ifdef ENABLE_MOTION_LINK
+            if (hal.motion_link.follower)
+                link.syncs--;
+            else if (hal.motion_link.sync_pulse)
+                hal.motion_link.sync_pulse();
+#endif
+            // Initialize step segment timing per step.
+            hal.stepper_cycles_per_tick(st.exec_segment->cycles_per_tick);
+        } else {
+#ifdef ENABLE_MOTION_LINK
+            link.running = false;
+#endif
+            st_segment_buffer_empty();
+            return; // Nothing to do but exit.
+        }
+    }
+
+    st_probe_check();
+
 #ifdef ENABLE_BACKLASH_COMPENSATION
-    static bool backlash_motion;
+    if (st.backlash_axes.mask) {
+        st.step_outbits = st_backlash_tick();
+        return; // Take-up tick, the segment is not advanced.
+    }
 #endif
 
-    // Start a step pulse when there is a block to execute.
-    if(st.exec_block) {
+    st.step_outbits = st_bresenham_tick();
+
+#ifdef ENABLE_POSITION_OUTPUTS
+    st_output_events_tick();
+#endif
+
+#ifdef ENABLE_LASER_POWER_RAMP
+    // Ramp laser power with speed, the PWM output is only updated when the PWM count changes.
+    if (st.spindle_pwm_slope) {
+        uint32_t pwm = st.spindle_pwm + (uint32_t)st.spindle_pwm_slope;
+        if ((pwm ^ st.spindle_pwm) >> 16)
+            hal.spindle_update_pwm(pwm >> 16);
+        st.spindle_pwm = pwm;
+    }
+#endif
+
+    if (st.step_count == 0 || --st.step_count == 0) {
+        // Segment is complete. Advance segment tail pointer.
+        SEGMENT_BUFFER_BARRIER();
+        segment_buffer_tail = segment_buffer_tail->next;
+        system_idle_wake(); // Room for the segment generator.
+    }
+}
+
+/* Renders the next step segment, or the next part of it if it does not fit, to a step pulse train for
+   drivers that output the step pulses by DMA or similar instead of by the stepper driver interrupt.
+   Performs the same actions as the stepper driver interrupt does for the ticks rendered, the system
+   position is thus updated ahead of the physical position by the ticks buffered by the driver.
+   The segment is released to the segment generator when completely rendered.
+   Returns false when there is nothing more to render, the steppers are then set idle and cycle
+   complete is signalled as with the stepper driver interrupt.
+   NOTE: The probe input is only checked once per call and homing axis locks are applied when rendered,
+   drivers should use the stepper driver interrupt for probing and homing cycles.
+*/
+ISR_CODE bool st_segment_render (step_train_t *train)
+{
+    train->ticks = 0;
+
+    if (st.exec_segment == NULL && !st_load_segment()) {
+        st_segment_buffer_empty();
+        return false;
+    }
+
+    train->cycles_per_tick = st.exec_segment->cycles_per_tick;
+    train->dir_outbits = st.dir_outbits;
+    train->new_block = st.new_block;
+    st.new_block = false;
+
+    st_probe_check();
+
+    do {
+#ifdef ENABLE_BACKLASH_COMPENSATION
+        if (st.backlash_axes.mask) {
+            train->step_outbits[train->ticks++] = st_backlash_tick();
+            continue; // Take-up tick, the segment is not advanced.
+        }
+#endif
+        train->step_outbits[train->ticks++] = st_bresenham_tick();
+#ifdef ENABLE_POSITION_OUTPUTS
+        st_output_events_tick();
+#endif
+#ifdef ENABLE_LASER_POWER_RAMP
+        st.spindle_pwm += (uint32_t)st.spindle_pwm_slope;
+#endif
+        if (st.step_count == 0 || --st.step_count == 0) {
+            // Segment is complete. Advance segment tail pointer.
+            SEGMENT_BUFFER_BARRIER();
+            segment_buffer_tail = segment_buffer_tail->next;
+            st.exec_segment = NULL;
+            system_idle_wake();
+            break;
+        }
+    } while (train->ticks < train->size);
+
+#ifdef ENABLE_LASER_POWER_RAMP
+    // Laser power is ramped per train, set to the power at the end of the ticks rendered.
+    if (st.spindle_pwm_slope)
+        hal.spindle_update_pwm(st.spindle_pwm >> 16);
+#endif
+
+    return true;
+}
+
+// Returns true if st_segment_render() has a step segment to render. For drivers rendering a train ahead
+// of the one being output, st_segment_render() sets the steppers idle when there is none.
+ISR_CODE bool st_segment_ready (void)
+{
+    return st.exec_segment != NULL || segment_buffer_head != segment_buffer_tail;
+}
+
+#ifdef ENABLE_STEP_TIMING
+
+/* Timed step executor for drivers with the step_timing capability.
+
+   The Bresenham line tracer steps an axis on the first tick its counter exceeds the step event count,
+   each axis step is thus delayed by up to a tick from its exact time. Here the exact time is computed
+   instead: for an axis with s steps per tick and counter c the next step is due (step_event_count - c) / s
+   ticks after the segment start and subsequent steps every step_event_count / s ticks. Times are kept as
+   integer timer cycles with remainders so that they do not drift, and the number of steps of each axis in
+   a segment is the same as the line tracer executes. The counters at the segment end carry the phase of
+   each axis to the next segment, so the step rate changes smoothly between segments.
+
+   The stepper timer is programmed for the next step of any axis, steps of different axes within the
+   merge time are output together. The segment stream, the system position and block start actions are
+   the same as for the stepper driver interrupt, AMASS is not used. The position may be ahead of the
+   Bresenham position by less than one tick.
+*/
+
+// Computes the step timing of an axis for the segment loaded.
+inline static void st_axis_timing (uint_fast8_t axis, uint32_t counter)
+{
+    st_axis_timing_t *t = &timing.axis[axis];
+    uint32_t steps = st.steps[axis];
+
+    if(steps && st.active_axes.mask & bit(axis)) {
+        uint64_t total = (uint64_t)counter + (uint64_t)st.exec_segment->n_step * steps, cycles;
+        // Steps crossing the step event count in the segment, see ST_AXIS_TICK().
+        t->steps = total ? (uint32_t)((total - 1) / st.step_event_count) : 0;
+        t->counter = (uint32_t)(total - (uint64_t)t->steps * st.step_event_count);
+        cycles = (uint64_t)(st.step_event_count - counter) * st.exec_segment->cycles_per_tick;
+        t->next = (uint32_t)(cycles / steps);
+        t->next_rem = (uint32_t)(cycles % steps);
+        cycles = (uint64_t)st.step_event_count * st.exec_segment->cycles_per_tick;
+        t->interval = (uint32_t)(cycles / steps);
+        t->interval_rem = (uint32_t)(cycles % steps);
+    } else {
+        t->steps = 0;
+        t->counter = counter;
+    }
+}
+
+// Loads the next segment and computes the step timing of each axis. Returns false if the buffer is empty.
+inline static bool st_timed_load_segment (void)
+{
+    uint_fast8_t idx = N_AXIS;
+    st_block_t *block = st.exec_block;
+
+    if(!st_load_segment())
+        return false;
+
+    timing.end = (int32_t)(st.exec_segment->n_step * st.exec_segment->cycles_per_tick);
+    timing.merge = min(timing.pulse_cycles, st.exec_segment->cycles_per_tick >> 1);
+
+    if(st.exec_block != block) {
+        // New block, start the axes at the same phase as the Bresenham counters.
+        timing.dominant.mask = 0;
+        do {
+            idx--;
+            timing.axis[idx].counter = st.step_event_count >> 1;
+            if(st.steps[idx] == st.step_event_count && !timing.dominant.mask)
+                timing.dominant.mask = bit(idx);
+        } while(idx);
+        idx = N_AXIS;
+    }
+
+    do {
+        idx--;
+        st_axis_timing(idx, timing.axis[idx].counter);
+    } while(idx);
 
+    return true;
+}
+
+// Updates the step timing of an axis for the step event at time now, returns true if the axis steps.
+inline static bool st_axis_step (uint_fast8_t axis, uint32_t now)
+{
+    st_axis_timing_t *t = &timing.axis[axis];
+
+    if(t->steps == 0 || t->next > now)
+        return false;
+
+    t->steps--;
+    t->next += t->interval;
+    if((t->next_rem += t->interval_rem) >= st.steps[axis]) {
+        t->next_rem -= st.steps[axis];
+        t->next++;
+    }
+
+    ST_AXIS_POSITION(axis)
+
+    return true;
+}
+
+// Computes the next step event and its step bits, loading the next segment when the executing segment
+// has no more steps. Returns the time from the step event output to the next (cycles).
+inline static uint32_t st_timed_next_event (void)
+{
+    uint_fast8_t idx;
+    int32_t next, earliest = timing.now + (int32_t)timing.merge, delta;
+    axes_signals_t step_outbits = (axes_signals_t){0};
+
+#ifdef ENABLE_BACKLASH_COMPENSATION
+    // Take-up steps are output a tick apart ahead of the block steps, these are then delayed by the take-up phase.
+    if (st.backlash_axes.mask) {
+        st.step_outbits = st_backlash_tick();
+        return st.exec_segment->cycles_per_tick;
+    }
+#endif
+
+    while(true) {
+        next = timing.end;
+        idx = N_AXIS;
+        do {
+            idx--;
+            if(timing.axis[idx].steps && (int32_t)timing.axis[idx].next < next)
+                next = (int32_t)timing.axis[idx].next;
+        } while(idx);
+        if(next < timing.end)
+            break;
+        // Segment is complete. Advance segment tail pointer and continue with the next segment,
+        // times are now relative to its start.
+        timing.now -= timing.end;
+        earliest -= timing.end;
+        SEGMENT_BUFFER_BARRIER();
+        segment_buffer_tail = segment_buffer_tail->next;
+        st.exec_segment = NULL;
+        system_idle_wake();
+        if(!st_timed_load_segment()) {
+            st.step_outbits = step_outbits;
+            return (uint32_t)max(-timing.now, (int32_t)timing.pulse_cycles); // End of motion, idle on next interrupt.
+        }
+#ifdef ENABLE_BACKLASH_COMPENSATION
+        if (st.backlash_axes.mask) {
+            // New block taking up backlash, start the take-up phase at the block start.
+            st.step_outbits = step_outbits;
+            delta = max(-timing.now, (int32_t)timing.pulse_cycles);
+            timing.now = 0;
+            return (uint32_t)delta;
+        }
+#endif
+    }
+
+    if(next < earliest) // Keep events apart, steps are output late by less than the merge time.
+        next = earliest;
+
+    if(next - timing.now > (int32_t)st.exec_segment->cycles_per_tick)
+        next = timing.now + (int32_t)st.exec_segment->cycles_per_tick; // Keep within the tick period, no steps.
+    else {
+        uint32_t merged = (uint32_t)next + timing.merge;
+        sys_position_write_begin();
+        idx = N_AXIS;
+        do {
+            idx--;
+            if(st_axis_step(idx, merged)) {
+                step_outbits.mask |= bit(idx);
+#if defined(ENABLE_POSITION_OUTPUTS) || defined(ENABLE_LASER_POWER_RAMP)
+                if(timing.dominant.mask & bit(idx)) {
+  #ifdef ENABLE_POSITION_OUTPUTS
+                    st_output_events_tick();
+  #endif
+  #ifdef ENABLE_LASER_POWER_RAMP
+                    if (st.spindle_pwm_slope) {
+                        uint32_t pwm = st.spindle_pwm + (uint32_t)st.spindle_pwm_slope;
+                        if ((pwm ^ st.spindle_pwm) >> 16)
+                            hal.spindle_update_pwm(pwm >> 16);
+                        st.spindle_pwm = pwm;
+                    }
+  #endif
+                }
+#endif
+            }
+        } while(idx);
+        sys_position_write_end();
+    }
+
+    // During a homing cycle, lock out and prevent desired axes from moving.
+    if (sys.state == STATE_HOMING)
+        step_outbits.value &= sys.homing_axis_lock.mask;
+
+    st.step_outbits = step_outbits;
+    delta = next - timing.now;
+    timing.now = next;
+
+    return (uint32_t)delta;
+}
+
+ISR_CODE void stepper_timed_interrupt_handler (void)
+{
+    // Start the step pulse of the step event due now.
+    if(st.exec_block)
         hal.stepper_pulse_start(&st);
 
-        if (st.step_count == 0) // Segment is complete. Discard current segment.
-            st.exec_segment = NULL;
+    if (st.exec_segment == NULL) {
+        timing.now = 0;
+        if (!st_timed_load_segment()) {
+            st_segment_buffer_empty();
+            return; // Nothing to do but exit.
+        }
+    }
+
+    st_probe_check();
+
+    hal.stepper_cycles_per_tick(st_timed_next_event());
+}
+
+#endif
+
+#if defined(ENABLE_REMOTE_STEPPER) || defined(ENABLE_MOTION_LINK)
+
+static uint8_t *put_u32 (uint8_t *p, uint32_t v)
+{
+    *p++ = (uint8_t)v;
+    *p++ = (uint8_t)(v >> 8);
+    *p++ = (uint8_t)(v >> 16);
+    *p++ = (uint8_t)(v >> 24);
+
+    return p;
+}
+
+static uint32_t get_u32 (const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Renders a block frame to frame, REMOTE_BLOCK_LENGTH bytes.
+static void st_block_frame (uint8_t *frame, st_block_t *block)
+{
+    uint_fast8_t idx;
+    uint8_t *p = frame;
+
+    *p++ = REMOTE_FRAME_BLOCK;
+    *p++ = (uint8_t)block->id;
+    *p++ = (uint8_t)block->direction_bits.value;
+    *p++ = (uint8_t)block->active_axes.value;
+    p = put_u32(p, block->step_event_count);
+    for (idx = 0; idx < N_AXIS; idx++)
+        p = put_u32(p, block->steps[idx]);
+    *p = crc8(frame, REMOTE_BLOCK_LENGTH - 1);
+}
+
+// Renders a segment frame to frame, REMOTE_SEGMENT_LENGTH bytes.
+static void st_segment_frame (uint8_t *frame, segment_t *segment)
+{
+    uint8_t *p = frame;
+
+    *p++ = REMOTE_FRAME_SEGMENT;
+    *p++ = (uint8_t)segment->exec_block->id;
+    *p++ = (uint8_t)segment->amass_level;
+    *p++ = (uint8_t)segment->n_step;
+    *p++ = (uint8_t)(segment->n_step >> 8);
+    p = put_u32(p, segment->cycles_per_tick);
+    *p = crc8(frame, REMOTE_SEGMENT_LENGTH - 1);
+}
+
+// Sends a reset frame with send.
+static void st_reset_frame (bool (*send)(const uint8_t *frame, uint_fast8_t length))
+{
+    uint8_t frame[2] = { REMOTE_FRAME_RESET };
+
+    frame[1] = crc8(frame, 1);
+    send(frame, 2);
+}
+
+#endif
+
+#ifdef ENABLE_MOTION_LINK
+
+// Leader, sends the prepared segments, and the block frames for them, to the follower. The follower buffer
+// has the same size so segments received are always consumed before the follower runs out of room.
+static void st_link_send (void)
+{
+    uint8_t frame[REMOTE_BLOCK_LENGTH];
+
+    while (link.send != segment_buffer_head) {
+
+        SEGMENT_BUFFER_BARRIER(); // Do not read the segment before it is published
+
+        if (link.send->exec_block != link.block) {
+            st_block_frame(frame, link.send->exec_block);
+            hal.motion_link.send(frame, REMOTE_BLOCK_LENGTH);
+            link.block = link.send->exec_block;
+        }
+
+        st_segment_frame(frame, link.send);
+        hal.motion_link.send(frame, REMOTE_SEGMENT_LENGTH);
+        link.send = link.send->next;
     }
+}
 
-    // If there is no step segment, attempt to pop one from the stepper buffer
-    if (st.exec_segment == NULL) {
-        // Anything in the buffer? If so, load and initialize next step segment.
-        if (segment_buffer_head != segment_buffer_tail) {
+// Follower, adds received blocks and segments to the segment buffer, the segment generator is not used.
+bool st_link_receive (const uint8_t *frame, uint_fast8_t length)
+{
+    uint_fast8_t idx;
 
-            // Initialize new step segment and load number of steps to execute
-            st.exec_segment = (segment_t *)segment_buffer_tail;
+    if (!hal.motion_link.follower || length < 2 || crc8(frame, length - 1) != frame[length - 1])
+        return false;
+
+    switch (frame[0]) {
+
+        case REMOTE_FRAME_RESET:
+            mc_reset();
+            break;
+
+        case REMOTE_FRAME_BLOCK:
+            if (length != REMOTE_BLOCK_LENGTH)
+                return false;
+            // Blocks are allocated in the same order as by the leader, a block is thus free when the leader reuses it.
+            st_prep_block = st_prep_block->next;
+            st_prep_block->direction_bits.value = frame[2];
+            st_prep_block->active_axes.value = frame[3];
+            st_prep_block->step_event_count = get_u32(&frame[4]);
+            for (idx = 0; idx < N_AXIS; idx++) {
+                st_prep_block->steps[idx] = get_u32(&frame[8 + idx * 4]);
+                st_prep_block->position_delta[idx] = bit_istrue(st_prep_block->direction_bits.value, bit(idx)) ? -1 : 1;
+            }
+            st_prep_block->overrides.sync = Off;
+            st_prep_block->dynamic_rpm = false;
+            link.block = st_prep_block;
+            link.block_id = frame[1];
+            break;
+
+        case REMOTE_FRAME_SEGMENT:
+            if (length != REMOTE_SEGMENT_LENGTH || link.block == NULL || frame[1] != link.block_id || segment_next_head == segment_buffer_tail)
+                return false;
+            segment_buffer_head->exec_block = link.block;
+            segment_buffer_head->amass_level = frame[2];
+            segment_buffer_head->n_step = (uint_fast16_t)frame[3] | ((uint_fast16_t)frame[4] << 8);
+            segment_buffer_head->cycles_per_tick = get_u32(&frame[5]);
+            segment_buffer_head->update_rpm = segment_buffer_head->spindle_sync = segment_buffer_head->cruising = false;
+#ifdef ENABLE_LASER_PPI
+            segment_buffer_head->ppi_period = 0;
+#endif
+#ifdef ENABLE_JOB_STATS
+            segment_buffer_head->stats_dt = 0.0f; // Counted by the leader.
+#endif
+            SEGMENT_BUFFER_BARRIER(); // Publish the segment before moving the head
+            segment_buffer_head = segment_next_head;
+            segment_next_head = segment_next_head->next;
+            if (!link.running) {
+                link.running = true;
+                st_wake_up();
+            }
+            break;
 
-            // Initialize step segment timing per step and load number of steps to execute.
-            hal.stepper_cycles_per_tick(st.exec_segment->cycles_per_tick);
-            st.step_count = st.exec_segment->n_step; // NOTE: Can sometimes be zero when moving slow.
+        default:
+            return false;
+    }
 
-            // If the new segment starts a new planner block, initialize stepper variables and counters.
-            if (st.exec_block != st.exec_segment->exec_block) {
+    return true;
+}
+
+void st_link_sync (void)
+{
+    link.syncs++;
+}
 
-                st.exec_block = st.exec_segment->exec_block;
-                st.step_event_count = st.exec_block->step_event_count;
-                st.dir_outbits = st.exec_block->direction_bits;
-                st.new_block = true;
-#ifdef ENABLE_BACKLASH_COMPENSATION
-                backlash_motion = st.exec_block->backlash_motion;
 #endif
 
-                if(st.exec_block->overrides.sync)
-                    sys.override.control = st.exec_block->overrides;
+#ifdef ENABLE_REMOTE_STEPPER
 
-                // Execute output commands to be syncronized with motion
-                while(st.exec_block->output_commands) {
-                    output_command_t *cmd = st.exec_block->output_commands;
-                    if(cmd->is_digital)
-                        hal.port.digital_out(cmd->port, cmd->value != 0.0f);
-                    else
-                        hal.port.analog_out(cmd->port, cmd->value);
-                    cmd = cmd->next;
-                    free(st.exec_block->output_commands);
-                    st.exec_block->output_commands = cmd;
-                }
+// Sends prepared segments, and the block frames for them, while the co-processor has free queue slots.
+static void st_remote_send (void)
+{
+    uint8_t frame[REMOTE_BLOCK_LENGTH];
 
-                // "Enqueue" any message to be displayed (by foreground process)
-                if(st.exec_block->message) {
-                    protocol_message(st.exec_block->message);
-                    st.exec_block->message = NULL;
-                }
+    if (remote.busy)
+        return;
 
-                // Initialize Bresenham line and distance counters
-                st.counter_x = st.counter_y = st.counter_z
-                #ifdef A_AXIS
-                  = st.counter_a
-                #endif
-                #ifdef B_AXIS
-                  = st.counter_b
-                #endif
-                #ifdef C_AXIS
-                  = st.counter_c
-                #endif
-                  = st.step_event_count >> 1;
+    remote.busy = true;
 
-              #ifndef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-                memcpy(st.steps, st.exec_block->steps, sizeof(st.steps));
-              #endif
-            }
+    while (remote.send != segment_buffer_head) {
 
-          #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-            // With AMASS enabled, adjust Bresenham axis increment counters according to AMASS level.
-            st.amass_level = st.exec_segment->amass_level;
-            st.steps[X_AXIS] = st.exec_block->steps[X_AXIS] >> st.amass_level;
-            st.steps[Y_AXIS] = st.exec_block->steps[Y_AXIS] >> st.amass_level;
-            st.steps[Z_AXIS] = st.exec_block->steps[Z_AXIS] >> st.amass_level;
-           #ifdef A_AXIS
-            st.steps[A_AXIS] = st.exec_block->steps[A_AXIS] >> st.amass_level;
-           #endif
-           #ifdef B_AXIS
-            st.steps[B_AXIS] = st.exec_block->steps[B_AXIS] >> st.amass_level;
-           #endif
-           #ifdef C_AXIS
-            st.steps[C_AXIS] = st.exec_block->steps[C_AXIS] >> st.amass_level;
-           #endif
-         #endif
-
-            if(st.exec_segment->update_rpm) {
-              #ifdef SPINDLE_PWM_DIRECT
-                hal.spindle_update_pwm(st.exec_segment->spindle_pwm);
-              #else
-                hal.spindle_update_rpm(st.exec_segment->spindle_rpm);
-              #endif
-            }
-        } else {
-            // Segment buffer empty. Shutdown.
-            st_go_idle();
-            // Ensure pwm is set properly upon completion of rate-controlled motion.
-            if (st.exec_block->dynamic_rpm && settings.flags.laser_mode)
-                hal.spindle_set_state((spindle_state_t){0}, 0.0f);
+        bool new_block = remote.send->exec_block != remote.block;
 
-            system_set_exec_state_flag(EXEC_CYCLE_COMPLETE); // Flag main program for cycle complete
+        // Frames sent but not yet received when the co-processor last reported its free slots take slots too.
+        if ((int_fast16_t)remote.free - (uint8_t)(remote.sent - remote.received) < (new_block ? 2 : 1))
+            break;
 
-            return; // Nothing to do but exit.
+        SEGMENT_BUFFER_BARRIER(); // Do not read the segment before it is published
+
+        if (new_block) {
+            st_block_frame(frame, remote.send->exec_block);
+            if (!hal.remote_stepper.send(frame, REMOTE_BLOCK_LENGTH))
+                break;
+            remote.sent++;
+            remote.block = remote.send->exec_block;
         }
-    }
 
-    // Check probing state.
-    // Monitors probe pin state and records the system position when detected.
-    // NOTE: This function must be extremely efficient as to not bog down the stepper ISR.
-    if (sys_probing_state == Probing_Active && hal.probe_get_state().triggered) {
-        sys_probing_state = Probing_Off;
-        memcpy(sys_probe_position, sys_position, sizeof(sys_position));
-        bit_true(sys_rt_exec_state, EXEC_MOTION_CANCEL);
+        st_segment_frame(frame, remote.send);
+        if (!hal.remote_stepper.send(frame, REMOTE_SEGMENT_LENGTH))
+            break;
+
+        remote.sent++;
+        remote.executing = true;
+        remote.send = remote.send->next;
     }
 
-    register axes_signals_t step_outbits = (axes_signals_t){0};
+    remote.busy = false;
+}
 
-    // Execute step displacement profile by Bresenham line algorithm
+// Status frame from the co-processor. Completed segments are retired from the segment buffer and the block start
+// actions and spindle updates of the segment being executed are performed, segments completed between two status
+// frames have them performed late. The system position is set from the co-processor position.
+bool st_remote_status (const uint8_t *frame, uint_fast8_t length)
+{
+    uint_fast8_t idx;
+    int32_t position[N_AXIS];
+    const uint8_t *p = &frame[5];
 
-    st.counter_x += st.steps[X_AXIS];
-    if (st.counter_x > st.step_event_count) {
-        step_outbits.x = On;
-        st.counter_x -= st.step_event_count;
-#ifdef ENABLE_BACKLASH_COMPENSATION
-        if(!backlash_motion)
-#endif
-            sys_position[X_AXIS] = sys_position[X_AXIS] + (st.dir_outbits.x ? -1 : 1);
-    }
+    if (length != REMOTE_STATUS_LENGTH || frame[0] != REMOTE_FRAME_STATUS || crc8(frame, length - 1) != frame[length - 1])
+        return false;
 
-    st.counter_y += st.steps[Y_AXIS];
-    if (st.counter_y > st.step_event_count) {
-        step_outbits.y = On;
-        st.counter_y -= st.step_event_count;
-#ifdef ENABLE_BACKLASH_COMPENSATION
-        if(!backlash_motion)
-#endif
-            sys_position[Y_AXIS] = sys_position[Y_AXIS] + (st.dir_outbits.y ? -1 : 1);
+    for (idx = 0; idx < N_AXIS; idx++) {
+        position[idx] = (int32_t)get_u32(p);
+        p += 4;
     }
 
-    st.counter_z += st.steps[Z_AXIS];
-    if (st.counter_z > st.step_event_count) {
-        step_outbits.z = On;
-        st.counter_z -= st.step_event_count;
-#ifdef ENABLE_BACKLASH_COMPENSATION
-        if(!backlash_motion)
-#endif
-            sys_position[Z_AXIS] = sys_position[Z_AXIS] + (st.dir_outbits.z ? -1 : 1);
+    while (remote.completed != frame[2] && segment_buffer_tail != remote.send) {
+        if (st.exec_segment == NULL)
+            st_load_segment();
+        st.exec_segment = NULL;
+        segment_buffer_tail = segment_buffer_tail->next;
+        remote.completed++;
+        system_idle_wake();
     }
 
-  #ifdef A_AXIS
-      st.counter_a += st.steps[A_AXIS];
-      if (st.counter_a > st.step_event_count) {
-          step_outbits.a = On;
-          st.counter_a -= st.step_event_count;
-#ifdef ENABLE_BACKLASH_COMPENSATION
-        if(!backlash_motion)
-#endif
-              sys_position[A_AXIS] = sys_position[A_AXIS] + (st.dir_outbits.a ? -1 : 1);
-      }
-  #endif
-
-  #ifdef B_AXIS
-      st.counter_b += st.steps[B_AXIS];
-      if (st.counter_b > st.step_event_count) {
-          step_outbits.b = On;
-          st.counter_b -= st.step_event_count;
-#ifdef ENABLE_BACKLASH_COMPENSATION
-        if(!backlash_motion)
-#endif
-              sys_position[B_AXIS] = sys_position[B_AXIS] + (st.dir_outbits.b ? -1 : 1);
-      }
-  #endif
+    if ((frame[1] & REMOTE_STATUS_EXECUTING) && st.exec_segment == NULL && segment_buffer_tail != remote.send)
+        st_load_segment();
 
-  #ifdef C_AXIS
-      st.counter_c += st.steps[C_AXIS];
-      if (st.counter_c > st.step_event_count) {
-          step_outbits.c = On;
-          st.counter_c -= st.step_event_count;
-#ifdef ENABLE_BACKLASH_COMPENSATION
-        if(!backlash_motion)
-#endif
-              sys_position[C_AXIS] = sys_position[C_AXIS] + (st.dir_outbits.c ? -1 : 1);
-      }
-  #endif
+    if (frame[1] & REMOTE_STATUS_PROBE)
+        probe_interrupt_handler(&position);
+    else {
+        sys_position_write_begin();
+        memcpy(sys_position, position, sizeof(sys_position));
+        sys_position_write_end();
+    }
 
-    st.step_outbits.value = step_outbits.value;
+    // Free slots are stored first, a send in between then sees too few rather than too many.
+    remote.free = frame[4];
+    SEGMENT_BUFFER_BARRIER();
+    remote.received = frame[3];
 
-    // During a homing cycle, lock out and prevent desired axes from moving.
-    if (sys.state == STATE_HOMING)
-        st.step_outbits.value &= sys.homing_axis_lock.mask;
+    if (remote.executing && !(frame[1] & REMOTE_STATUS_EXECUTING) && segment_buffer_tail == segment_buffer_head) {
+        remote.executing = false;
+        st_segment_buffer_empty();
+    } else
+        st_remote_send();
 
-    if (st.step_count == 0 || --st.step_count == 0) {
-        // Segment is complete. Advance segment tail pointer.
-        segment_buffer_tail = segment_buffer_tail->next;
-    }
+    return true;
 }
 
+#endif
+
 // Reset and clear stepper subsystem variables
 void st_reset ()
 {
+    PLANNER_LOCK(true);
+
     hal.probe_configure_invert_mask(false);
 
     // Initialize stepper driver idle state, clear step and direction port pins.
     hal.stepper_go_idle(true);
 
+#ifdef ENABLE_LASER_PPI
+    ppi_pulses = false;
+    if(hal.laser_pulse_train)
+        hal.laser_pulse_train(0, 0, 0);
+#endif
+
+    if(st_block_buffer == NULL) {
+        // Use driver provided storage if available, else the default buffers.
+        if(hal.segment_buffer.segments && hal.segment_buffer.st_blocks && hal.segment_buffer.size >= 3) {
+            st_block_buffer = hal.segment_buffer.st_blocks;
+            segment_buffer = hal.segment_buffer.segments;
+            segment_buffer_size = hal.segment_buffer.size;
+        } else {
+            static st_block_t st_block_buffer_default[SEGMENT_BUFFER_SIZE - 1];
+            static segment_t segment_buffer_default[SEGMENT_BUFFER_SIZE];
+            st_block_buffer = st_block_buffer_default;
+            segment_buffer = segment_buffer_default;
+            segment_buffer_size = SEGMENT_BUFFER_SIZE;
+        }
+        // Driver provided storage may not be initialized.
+        memset(st_block_buffer, 0, (segment_buffer_size - 1) * sizeof(st_block_t));
+        memset(segment_buffer, 0, segment_buffer_size * sizeof(segment_t));
+    }
+
     // NOTE: buffer indices starts from 1 for simpler driver coding!
 
-    // Set up stepper block ringbuffer as circular linked list and add id
-    uint_fast8_t idx;
-    for(idx = 0 ; idx <= SEGMENT_BUFFER_SIZE - 2 ; idx++) {
-        st_block_buffer[idx].next = &st_block_buffer[idx == SEGMENT_BUFFER_SIZE - 2 ? 0 : idx + 1];
+    // Set up stepper block ringbuffer as circular linked list and add id.
+    // Return any messages and output commands not yet executed to the pools.
+    uint_fast16_t idx;
+    for(idx = 0 ; idx <= segment_buffer_size - 2 ; idx++) {
+        st_block_buffer[idx].next = &st_block_buffer[idx == segment_buffer_size - 2 ? 0 : idx + 1];
         st_block_buffer[idx].id = idx + 1;
+        if(st_block_buffer[idx].message) {
+            pool_message_release(st_block_buffer[idx].message);
+            st_block_buffer[idx].message = NULL;
+        }
+        if(st_block_buffer[idx].output_commands) {
+            pool_output_commands_release(st_block_buffer[idx].output_commands);
+            st_block_buffer[idx].output_commands = NULL;
+        }
+#ifdef ENABLE_CAN_IO
+        st_block_buffer[idx].can_io_commit = false;
+#endif
+#ifdef ENABLE_WCO_MOTION_SYNC
+        if(st_block_buffer[idx].wco) {
+            pool_wco_release(st_block_buffer[idx].wco);
+            st_block_buffer[idx].wco = NULL;
+        }
+#endif
+#ifdef ENABLE_POSITION_OUTPUTS
+        if(st_block_buffer[idx].output_events) {
+            pool_output_commands_release(st_block_buffer[idx].output_events);
+            st_block_buffer[idx].output_events = NULL;
+        }
+#endif
     }
 
+#ifdef ENABLE_POSITION_OUTPUTS
+    pool_output_commands_release(output_carry);
+    output_carry = NULL;
+#endif
+
     // Set up segments ringbuffer as circular linked list, add id and clear AMASS level
-    for(idx = 0 ; idx <= SEGMENT_BUFFER_SIZE - 1 ; idx++) {
-        segment_buffer[idx].next = &segment_buffer[idx == SEGMENT_BUFFER_SIZE - 1 ? 0 : idx + 1];
+    for(idx = 0 ; idx <= segment_buffer_size - 1 ; idx++) {
+        segment_buffer[idx].next = &segment_buffer[idx == segment_buffer_size - 1 ? 0 : idx + 1];
         segment_buffer[idx].id = idx + 1;
         segment_buffer[idx].amass_level = 0;
     }
@@ -476,20 +1563,50 @@ void st_reset ()
     pl_block = NULL;  // Planner block pointer used by segment buffer
     segment_buffer_tail = segment_buffer_head = &segment_buffer[0]; // empty = tail
     segment_next_head = segment_buffer_head->next;
+#ifdef ENABLE_JOB_STATS
+    stats_tail = segment_buffer_head; // Segments not yet counted are discarded with the job.
+#endif
 
     memset(&prep, 0, sizeof(st_prep_t));
     memset(&st, 0, sizeof(stepper_t));
+#ifdef ENABLE_PERF_COUNTERS
+    motion_continues = false;
+#endif
 
 #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
     // TODO: move to driver?
     // AMASS_LEVEL0: Normal operation. No AMASS. No upper cutoff frequency. Starts at LEVEL1 cutoff frequency.
-    // Defined as step timer frequency / Cutoff frequency in Hz
-    amass.level_1 = hal.f_step_timer / 8000;
-    amass.level_2 = hal.f_step_timer / 4000;
-    amass.level_3 = hal.f_step_timer / 2000;
+    // Defined as step timer frequency / Cutoff frequency in Hz. The cutoff frequency is halved for each level
+    // so that the ISR is overdriven to no more than twice the LEVEL1 cutoff frequency.
+    amass.max_level = hal.driver_cap.amass_level;
+    for(idx = 0; idx < amass.max_level; idx++)
+        amass.level[idx] = hal.f_step_timer / (AMASS_LEVEL1_CUTOFF >> idx);
+    if(amass.max_level == 0)
+        amass.level[0] = UINT32_MAX; // AMASS not used by the timed step executor.
 #endif
 
     cycles_per_min = (float)hal.f_step_timer * 60.0f;
+
+#ifdef ENABLE_STEP_TIMING
+    memset(&timing, 0, sizeof(timing));
+    timing.pulse_cycles = (uint32_t)((float)hal.f_step_timer * (float)settings.steppers.pulse_microseconds / 1000000.0f);
+#endif
+
+#ifdef ENABLE_REMOTE_STEPPER
+    memset(&remote, 0, sizeof(remote));
+    remote.send = (segment_t *)segment_buffer_tail;
+    if (hal.remote_stepper.send) // Queue slots are granted by the status frame the co-processor sends after the reset.
+        st_reset_frame(hal.remote_stepper.send);
+#endif
+
+#ifdef ENABLE_MOTION_LINK
+    memset(&link, 0, sizeof(link));
+    link.send = (segment_t *)segment_buffer_tail;
+    if (hal.motion_link.send)
+        st_reset_frame(hal.motion_link.send);
+#endif
+
+    PLANNER_LOCK(false);
 }
 
 // Called by spindle_set_state() to inform about RPM changes.
@@ -502,33 +1619,101 @@ void st_rpm_changed (float rpm)
 // Called by planner_recalculate() when the executing block is updated by the new plan.
 void st_update_plan_block_parameters ()
 {
+    PLANNER_LOCK(true);
+
     if (pl_block != NULL) { // Ignore if at start of a new block.
         prep.recalculate.velocity_profile = On;
         pl_block->entry_speed_sqr = prep.current_speed * prep.current_speed; // Update entry speed.
         pl_block = NULL; // Flag st_prep_segment() to load and check active velocity profile.
     }
+
+    PLANNER_LOCK(false);
+}
+
+#ifdef ENABLE_HOLD_SEGMENT_REWIND
+
+// Retracts the segments of the block being prepped that the stepper driver has not yet started and restores
+// the segment generator state to the start of the first of them, the hold deceleration is then generated from
+// there. The executing segment and the next are kept as the stepper driver may be about to load the next one,
+// this leaves ample time for moving the segment buffer head back before the tail can reach it.
+void st_hold_rewind (void)
+{
+    PLANNER_LOCK(true);
+
+    if (pl_block && !(sys.step_control.execute_sys_motion || SPINDLE_SYNCHRONIZED(pl_block->condition) ||
+                       pl_block->condition.arc_motion || pl_block->condition.is_laser_ppi_mode)) {
+
+        uint_fast8_t keep = 2;
+        segment_t *segment = (segment_t *)segment_buffer_tail;
+
+        // Segments sent to a co-processor or follower cannot be retracted.
+#ifdef ENABLE_REMOTE_STEPPER
+        if ((remote.busy = !!hal.remote_stepper.send))
+            segment = remote.send;
+#endif
+#ifdef ENABLE_MOTION_LINK
+        if (hal.motion_link.send)
+            segment = link.send;
+#endif
+
+        while (keep && segment != segment_buffer_head) {
+            keep--;
+            segment = segment->next;
+        }
+
+        // Segments of previous blocks cannot be retracted, their planner blocks are discarded.
+        while (segment != segment_buffer_head && segment->exec_block != st_prep_block)
+            segment = segment->next;
+
+        if (segment != segment_buffer_head) {
+
+            pl_block->millimeters = segment->rewind_mm;
+            prep.current_speed = segment->rewind_speed;
+            prep.dt_remainder = segment->rewind_dt_remainder;
+            prep.current_spindle_rpm = segment->rewind_rpm;
+            prep.steps_remaining = segment->rewind_steps;
+
+            segment_next_head = segment->next;
+            SEGMENT_BUFFER_BARRIER();
+            segment_buffer_head = segment;
+        }
+#ifdef ENABLE_REMOTE_STEPPER
+        remote.busy = false;
+#endif
+    }
+
+    PLANNER_LOCK(false);
 }
 
+#endif
+
 // Changes the run state of the step segment buffer to execute the special parking motion.
 void st_parking_setup_buffer()
 {
+    PLANNER_LOCK(true);
+
     // Store step execution data of partially completed block, if necessary.
     if (prep.recalculate.hold_partial_block) {
         prep.last_st_block = st_prep_block;
         prep.last_steps_remaining = prep.steps_remaining;
         prep.last_dt_remainder = prep.dt_remainder;
         prep.last_steps_per_mm = prep.steps_per_mm;
+        prep.last_req_mm_increment = prep.req_mm_increment;
     }
     // Set flags to execute a parking motion
     prep.recalculate.parking = On;
     prep.recalculate.velocity_profile = Off;
     pl_block = NULL; // Always reset parking motion to reload new block.
+
+    PLANNER_LOCK(false);
 }
 
 
 // Restores the step segment buffer to the normal run state after a parking motion.
 void st_parking_restore_buffer()
 {
+    PLANNER_LOCK(true);
+
     // Restore step execution data and flags of partially completed block, if necessary.
     if (prep.recalculate.hold_partial_block) {
         st_prep_block = prep.last_st_block;
@@ -537,13 +1722,122 @@ void st_parking_restore_buffer()
         prep.steps_per_mm = prep.last_steps_per_mm;
         prep.recalculate.flags = 0;
         prep.recalculate.hold_partial_block = prep.recalculate.velocity_profile = On;
-        prep.req_mm_increment = REQ_MM_INCREMENT_SCALAR / prep.steps_per_mm; // Recompute this value.
+        prep.req_mm_increment = prep.last_req_mm_increment;
     } else
         prep.recalculate.flags = 0;
 
     pl_block = NULL; // Set to reload next block.
+
+    PLANNER_LOCK(false);
+}
+
+#ifdef ENABLE_NATIVE_ARCS
+
+#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+#define ARC_STEP_SHIFT MAX_AMASS_LEVEL
+#else
+#define ARC_STEP_SHIFT 1
+#endif
+
+// Returns the position on the arc at mm_remaining from the end of the block in absolute steps.
+static void arc_position (plan_arc_t *arc, float mm_remaining, int32_t *steps)
+{
+    if (mm_remaining <= 0.0f)
+        memcpy(steps, arc->target_steps, sizeof(arc->target_steps));
+    else {
+        uint_fast8_t idx = N_AXIS;
+        float fraction = 1.0f - mm_remaining / arc->length;
+        float cos_T = cosf(fraction * arc->angular_travel), sin_T = sinf(fraction * arc->angular_travel);
+
+        do {
+            idx--;
+            steps[idx] = lroundf((arc->start[idx] + arc->delta[idx] * fraction) * settings.steps_per_mm[idx]);
+        } while(idx);
+
+        steps[arc->axis_0] = lroundf((arc->center[0] + arc->r[0] * cos_T - arc->r[1] * sin_T) * settings.steps_per_mm[arc->axis_0]);
+        steps[arc->axis_1] = lroundf((arc->center[1] + arc->r[0] * sin_T + arc->r[1] * cos_T) * settings.steps_per_mm[arc->axis_1]);
+    }
+}
+
+// Prepares the stepper block for the chord from the end of the previous chord to the point on the arc
+// at mm_remaining from the end of the block. The first chord uses the stepper block set up when the
+// planner block was loaded, it owns the message and output commands. Returns the number of step events.
+static uint_fast16_t arc_chord (float mm_remaining)
+{
+    int32_t target[N_AXIS], delta_steps;
+    uint_fast8_t idx = N_AXIS;
+
+    if (prep.arc_chord) {
+        st_block_t *block = st_prep_block;
+#ifdef ENABLE_JOB_STATS
+        stats_count();
+#endif
+        st_prep_block = st_prep_block->next;
+        st_prep_block->overrides = block->overrides;
+        st_prep_block->steps_per_mm = block->steps_per_mm;
+        st_prep_block->millimeters = block->millimeters;
+        st_prep_block->programmed_rate = block->programmed_rate;
+        st_prep_block->dynamic_rpm = block->dynamic_rpm;
+#ifdef ENABLE_BACKLASH_COMPENSATION
+        memset(st_prep_block->backlash_steps, 0, sizeof(st_prep_block->backlash_steps));
+        memset(st_prep_block->backlash_taken, 0, sizeof(st_prep_block->backlash_taken));
+#endif
+        st_prep_block->message = NULL;
+        st_prep_block->output_commands = NULL;
+#ifdef ENABLE_COOLANT_QUEUE
+        st_prep_block->coolant_sync = false;
+#endif
+#ifdef ENABLE_JOB_STATS
+        st_prep_block->stats_spindle_on = block->stats_spindle_on;
+        memcpy(st_prep_block->stats_distance, block->stats_distance, sizeof(st_prep_block->stats_distance));
+#endif
+#ifdef ENABLE_WCO_MOTION_SYNC
+        st_prep_block->wco = NULL;
+#endif
+#ifdef ENABLE_POSITION_OUTPUTS
+        if(st_prep_block->output_events) {
+            pool_output_commands_release(st_prep_block->output_events);
+            st_prep_block->output_events = NULL;
+        }
+#endif
+        st_prep_block->arc_chord = true;
+#ifdef ENABLE_MOTION_TRACE
+        st_prep_block->line_number = block->line_number;
+#endif
+    }
+
+    arc_position(&pl_block->arc, mm_remaining, target);
+
+    st_prep_block->step_event_count = 0;
+    st_prep_block->direction_bits.mask = st_prep_block->active_axes.mask = 0;
+
+    do {
+        idx--;
+        delta_steps = target[idx] - prep.arc_position[idx];
+        if (delta_steps < 0) {
+            delta_steps = -delta_steps;
+            st_prep_block->direction_bits.mask |= bit(idx);
+        }
+        if (delta_steps)
+            st_prep_block->active_axes.mask |= bit(idx);
+        st_prep_block->position_delta[idx] = st_prep_block->direction_bits.mask & bit(idx) ? -1 : 1;
+        st_prep_block->steps[idx] = (uint32_t)delta_steps << ARC_STEP_SHIFT;
+        st_prep_block->step_event_count = max(st_prep_block->step_event_count, (uint32_t)delta_steps);
+    } while(idx);
+
+    if (st_prep_block->step_event_count == 0)
+        st_prep_block->step_event_count = 1; // No steps in this chord, execute an idle step event to keep the timing
+
+    memcpy(prep.arc_position, target, sizeof(prep.arc_position));
+    prep.arc_chord = true;
+
+    st_prep_block->step_event_count <<= ARC_STEP_SHIFT;
+
+    return (uint_fast16_t)(st_prep_block->step_event_count >> ARC_STEP_SHIFT);
 }
 
+#endif
+
 /* Prepares step segment buffer. Continuously called from main program.
 
    The segment buffer is an intermediary buffer interface between the execution of steps
@@ -557,7 +1851,92 @@ void st_parking_restore_buffer()
    Currently, the segment buffer conservatively holds roughly up to 40-50 msec of steps.
    NOTE: Computation units are in steps, millimeters, and minutes.
 */
-void st_prep_buffer()
+static void set_motion_phase (motion_phase_t phase)
+{
+    static motion_phase_t motion_phase = MotionPhase_Idle;
+
+    if(phase != motion_phase) {
+        motion_phase = phase;
+        if(hal.stepper_motion_phase)
+            hal.stepper_motion_phase(phase);
+        hooks_motion_phase(phase);
+    }
+}
+
+#ifdef ENABLE_POSITION_OUTPUTS
+
+// Moves the output commands with a distance from the block start to the output events of the block, sorted
+// by trigger position. Arc motions and commands with a zero distance are executed at the block start.
+// The trigger is in step events scaled as the Bresenham data. Commands with a distance beyond the end of
+// the block are carried to the next block with the remaining distance, commands carried from the
+// previous block are handled first.
+static void st_output_events_prep (st_block_t *block)
+{
+    output_command_t *cmd = block->output_commands, *next, **start = &block->output_commands, **event, **carry;
+
+    if(block->output_events)
+        pool_output_commands_release(block->output_events); // Not reached in an aborted block.
+
+    if(output_carry) {
+        next = output_carry;
+        while(next->next)
+            next = next->next;
+        next->next = cmd;
+        cmd = output_carry;
+        output_carry = NULL;
+    }
+
+    block->output_commands = block->output_events = NULL;
+    block->output_position = 0;
+    carry = &output_carry;
+
+    while(cmd) {
+        next = cmd->next;
+        cmd->next = NULL;
+        if(cmd->distance > pl_block->millimeters) {
+            cmd->distance -= pl_block->millimeters;
+            *carry = cmd;
+            carry = &cmd->next;
+        } else if(cmd->distance > 0.0f && pl_block->millimeters > 0.0f
+#ifdef ENABLE_NATIVE_ARCS
+            && !pl_block->condition.arc_motion
+#endif
+          ) {
+            cmd->trigger = (uint32_t)((float)block->step_event_count * cmd->distance / pl_block->millimeters);
+          #ifndef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+            cmd->trigger >>= 1; // One step event per ISR tick.
+          #endif
+            event = &block->output_events;
+            while(*event && (*event)->trigger <= cmd->trigger)
+                event = &(*event)->next;
+            cmd->next = *event;
+            *event = cmd;
+        } else {
+            *start = cmd;
+            start = &cmd->next;
+        }
+        cmd = next;
+    }
+}
+
+// Sets the outputs carried beyond the end of the motion, called by the main program on cycle completion.
+void st_output_events_flush (void)
+{
+    output_command_t *cmd;
+
+    while((cmd = output_carry)) {
+        if(cmd->is_digital)
+            hal.port.digital_out(cmd->port, cmd->value != 0.0f);
+        else
+            hal.port.analog_out(cmd->port, cmd->value);
+        output_carry = cmd->next;
+        pool_output_command_release(cmd);
+    }
+}
+
+#endif
+
+static void prep_buffer (void)
 {
     // Block step prep buffer, while in a suspend state and there is no suspend motion to execute.
     if (sys.step_control.end_motion)
@@ -572,12 +1951,22 @@ void st_prep_buffer()
 
             pl_block = sys.step_control.execute_sys_motion ? plan_get_system_motion_block() : plan_get_current_block();
 
-            if (pl_block == NULL)
+            if (pl_block == NULL) {
+                if((hal.stepper_motion_phase || hook_active(Hook_MotionPhase)) && segment_buffer_tail == segment_buffer_head)
+                    set_motion_phase(MotionPhase_Idle);
                 return; // No planner blocks. Exit.
+            }
+
+#ifdef ENABLE_WAIT_ON_INPUT_ASYNC
+            if (pl_block->condition.wait_on_input && wait_input_pending()) {
+                pl_block = NULL;
+                return; // Block waits on an M66 barrier. Exit.
+            }
+#endif
 
             // Check if we need to only recompute the velocity profile or load a new block.
             if (prep.recalculate.velocity_profile) {
-                if(settings.parking.flags.enabled) {
+                if(SYSTEM_MOTION_IN_HOLD) {
                     if (prep.recalculate.parking)
                         prep.recalculate.velocity_profile = Off;
                     else
@@ -590,9 +1979,25 @@ void st_prep_buffer()
                 // when the segment buffer completes the planner block, it may be discarded when the
                 // segment buffer finishes the prepped block, but the stepper ISR is still executing it.
 
+#ifdef ENABLE_JOB_STATS
+                stats_count();
+#endif
                 st_prep_block = st_prep_block->next;
 
                 uint_fast8_t idx = N_AXIS;
+                st_prep_block->active_axes.mask = 0;
+                do {
+                    idx--;
+                    if (pl_block->steps[idx])
+                        st_prep_block->active_axes.mask |= bit(idx);
+                    st_prep_block->position_delta[idx] = pl_block->direction_bits.mask & bit(idx) ? -1 : 1;
+                } while(idx);
+#ifdef ENABLE_BACKLASH_COMPENSATION
+                memcpy(st_prep_block->backlash_steps, pl_block->backlash_steps, sizeof(st_prep_block->backlash_steps));
+                memset(st_prep_block->backlash_taken, 0, sizeof(st_prep_block->backlash_taken));
+#endif
+
+                idx = N_AXIS;
               #ifndef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
                 do {
                     idx--;
@@ -613,16 +2018,48 @@ void st_prep_buffer()
                 st_prep_block->direction_bits = pl_block->direction_bits;
                 st_prep_block->programmed_rate = pl_block->programmed_rate;
                 st_prep_block->millimeters = pl_block->millimeters;
-                st_prep_block->steps_per_mm = (float)pl_block->step_event_count / pl_block->millimeters;
+                st_prep_block->steps_per_mm = pl_block->steps_per_mm;
+#ifdef ENABLE_JOB_STATS
+                st_prep_block->stats_spindle_on = pl_block->condition.spindle.on;
+                idx = N_AXIS;
+                do {
+                    idx--;
+                    st_prep_block->stats_distance[idx] = (float)pl_block->steps[idx] / settings.steps_per_mm[idx];
+                } while(idx);
+#endif
+                // Hand over ownership of message and output commands, the stepper ISR returns them to the pools.
                 st_prep_block->message = pl_block->message;
                 st_prep_block->output_commands = pl_block->output_commands;
+                pl_block->message = NULL;
+                pl_block->output_commands = NULL;
+#ifdef ENABLE_COOLANT_QUEUE
+                st_prep_block->coolant_sync = pl_block->condition.coolant_sync;
+                st_prep_block->coolant = pl_block->condition.coolant;
+#endif
+#ifdef ENABLE_WCO_MOTION_SYNC
+                st_prep_block->wco = pl_block->wco;
+                pl_block->wco = NULL;
+#endif
+#ifdef ENABLE_POSITION_OUTPUTS
+                st_output_events_prep(st_prep_block);
+#endif
+#ifdef ENABLE_CAN_IO
+                st_prep_block->can_io_commit = can_io_stage(&st_prep_block->output_commands, (uint8_t)st_prep_block->id);
+#endif
                 st_prep_block->overrides = pl_block->overrides;
-                st_prep_block->backlash_motion = pl_block->condition.backlash_motion;
+#ifdef ENABLE_MOTION_TRACE
+                st_prep_block->line_number = pl_block->line_number;
+#endif
+#ifdef ENABLE_NATIVE_ARCS
+                st_prep_block->arc_chord = prep.arc_chord = false;
+                if(pl_block->condition.arc_motion)
+                    memcpy(prep.arc_position, pl_block->arc.start_steps, sizeof(prep.arc_position));
+#endif
 
                 // Initialize segment buffer data for generating the segments.
                 prep.steps_per_mm = st_prep_block->steps_per_mm;
                 prep.steps_remaining = pl_block->step_event_count;
-                prep.req_mm_increment = REQ_MM_INCREMENT_SCALAR / prep.steps_per_mm;
+                prep.req_mm_increment = pl_block->req_mm_increment;
                 prep.dt_remainder = prep.target_position = 0.0f; // Reset for new segment block
 
                 if (sys.step_control.execute_hold || prep.recalculate.decel_override) {
@@ -630,16 +2067,20 @@ void st_prep_buffer()
                     prep.current_speed = prep.exit_speed;
                     pl_block->entry_speed_sqr = prep.exit_speed * prep.exit_speed;
                     prep.recalculate.decel_override = Off;
-                } else
-                    prep.current_speed = sqrtf(pl_block->entry_speed_sqr);
+                } else // Reuse the exit speed of the previous block if the plan is unchanged, avoids a square root.
+                    prep.current_speed = pl_block->entry_speed_sqr == prep.exit_speed_sqr ? prep.exit_speed : sqrtf(pl_block->entry_speed_sqr);
 
                 // Setup laser mode variables. RPM rate adjusted motions will always complete a motion with the
                 // spindle off.
                 if ((st_prep_block->dynamic_rpm = pl_block->condition.is_rpm_rate_adjusted))
-                    // Pre-compute inverse programmed rate to speed up RPM updating per step segment.
-                    prep.inv_feedrate = pl_block->condition.is_laser_ppi_mode ? 1.0f : 1.0f / pl_block->programmed_rate;
+                    // Inverse programmed rate is precomputed by the planner to speed up RPM updating per step segment.
+                    prep.inv_feedrate = pl_block->inv_feedrate;
                 else
                     st_prep_block->dynamic_rpm = pl_block->condition.is_rpm_pos_adjusted;
+#ifdef ENABLE_RASTER_ROWS
+                // Raster rows change power per pixel, prep.inv_feedrate is set above if rate adjusted.
+                st_prep_block->dynamic_rpm = st_prep_block->dynamic_rpm || pl_block->raster != NULL;
+#endif
             }
 
             /* ---------------------------------------------------------------------------------
@@ -649,7 +2090,12 @@ void st_prep_buffer()
              hold, override the planner velocities and decelerate to the target exit speed.
             */
             prep.mm_complete = 0.0f; // Default velocity profile complete at 0.0mm from end of block.
-            float inv_2_accel = 0.5f / pl_block->acceleration;
+#ifdef SHAPED_RAMPS
+            prep.ramp.active = false;
+#endif
+            float inv_2_accel = pl_block->inv_2_accel;
+
+            prep.exit_speed_sqr = -1.0f; // Exit speed is not the planned exit speed unless set below.
 
             if (sys.step_control.execute_hold) { // [Forced Deceleration to Zero Velocity]
                 // Compute velocity profile parameters for a feed hold in-progress. This profile overrides
@@ -676,6 +2122,7 @@ void st_prep_buffer()
                     exit_speed_sqr = plan_get_exec_block_exit_speed_sqr();
                     prep.exit_speed = sqrtf(exit_speed_sqr);
                 }
+                prep.exit_speed_sqr = exit_speed_sqr;
 
                 float nominal_speed = plan_compute_profile_nominal_speed(pl_block);
                 float nominal_speed_sqr = nominal_speed * nominal_speed;
@@ -694,6 +2141,7 @@ void st_prep_buffer()
 
                         // Compute override block exit speed since it doesn't match the planner exit speed.
                         prep.exit_speed = sqrtf(pl_block->entry_speed_sqr - 2.0f * pl_block->acceleration * pl_block->millimeters);
+                        prep.exit_speed_sqr = -1.0f;
                         prep.recalculate.decel_override = On; // Flag to load next block as deceleration override.
 
                         // TODO: Determine correct handling of parameters in deceleration-only.
@@ -736,7 +2184,12 @@ void st_prep_buffer()
             }
 
             if(sys.state != STATE_HOMING)
-                sys.step_control.update_spindle_rpm |= settings.flags.laser_mode; // Force update whenever updating block in laser mode.
+#ifdef ENABLE_SPINDLE_RPM_QUEUE
+                // Force update whenever updating block in laser mode, else when the spindle runs to apply RPM changes queued with the block.
+                sys.step_control.update_spindle_rpm |= LASER_MODE || pl_block->condition.spindle.on;
+#else
+                sys.step_control.update_spindle_rpm |= LASER_MODE; // Force update whenever updating block in laser mode.
+#endif
         }
 
         // Initialize new segment
@@ -745,6 +2198,19 @@ void st_prep_buffer()
         // Set new segment to point to the current segment data block.
         prep_segment->exec_block = st_prep_block;
         prep_segment->update_rpm = false;
+#ifdef ENABLE_HOLD_SEGMENT_REWIND
+        prep_segment->rewind_mm = pl_block->millimeters;
+        prep_segment->rewind_speed = prep.current_speed;
+        prep_segment->rewind_dt_remainder = prep.dt_remainder;
+        prep_segment->rewind_rpm = prep.current_spindle_rpm;
+        prep_segment->rewind_steps = prep.steps_remaining;
+#endif
+#ifdef ENABLE_LASER_POWER_RAMP
+        prep_segment->spindle_pwm_slope = 0;
+        float segment_entry_speed = prep.current_speed; // Speed at the start of the segment, for ramping laser power
+        float entry_rpm = -1.0f;
+        int32_t pwm_delta = 0;
+#endif
 
         /*------------------------------------------------------------------------------------
             Compute the average velocity of this new segment by determining the total distance
@@ -771,6 +2237,23 @@ void st_prep_buffer()
         if (minimum_mm < 0.0f)
             minimum_mm = 0.0f;
 
+#ifdef ENABLE_RASTER_ROWS
+        // Limit segment time to about one pixel so that laser power is updated per pixel.
+        if (pl_block->raster && prep.current_speed > 0.0f) {
+            float dt_pixel = pl_block->raster->length / ((float)pl_block->raster->n_pixels * prep.current_speed);
+            if (dt_pixel < dt_max)
+                time_var = dt_max = dt_pixel;
+        }
+#endif
+#ifdef ENABLE_NATIVE_ARCS
+        // Limit segment time so that the chord does not exceed the longest chord within the arc tolerance.
+        if (pl_block->condition.arc_motion) {
+            float speed = max(prep.current_speed, prep.target_feed);
+            if (speed > 0.0f && (speed = pl_block->arc.max_chord / speed) < dt_max)
+                time_var = dt_max = speed;
+        }
+#endif
+
         do {
 
             switch (prep.ramp_type) {
@@ -791,6 +2274,22 @@ void st_prep_buffer()
 
                 case Ramp_Accel:
                     // NOTE: Acceleration ramp only computes during first do-while loop.
+#ifdef SHAPED_RAMPS
+                    if (!prep.ramp.active)
+                        ramp_init(mm_remaining, prep.accelerate_until, prep.maximum_speed);
+                    if (prep.ramp.active) {
+                        if ((prep.ramp.t += time_var) < prep.ramp.t_ramp)
+                            mm_remaining = ramp_position(prep.ramp.t);
+                        else { // End of acceleration ramp.
+                            time_var -= prep.ramp.t - prep.ramp.t_ramp; // Only the time up to the end of the ramp, t is at or past it.
+                            mm_remaining = prep.accelerate_until; // NOTE: 0.0 at EOB
+                            prep.ramp_type = mm_remaining == prep.decelerate_after ? Ramp_Decel : Ramp_Cruise;
+                            prep.current_speed = prep.maximum_speed;
+                            prep.ramp.active = false;
+                        }
+                        break;
+                    }
+#endif
                     speed_var = pl_block->acceleration * time_var;
                     mm_remaining -= time_var * (prep.current_speed + 0.5f * speed_var);
                     if (mm_remaining < prep.accelerate_until) { // End of acceleration ramp.
@@ -818,6 +2317,24 @@ void st_prep_buffer()
                     break;
 
                 default: // case Ramp_Decel:
+#ifdef SHAPED_RAMPS
+                    if (!prep.ramp.active)
+                        ramp_init(mm_remaining, prep.mm_complete, prep.exit_speed);
+                    if (prep.ramp.active) {
+                        if ((prep.ramp.t += time_var) < prep.ramp.t_ramp && (mm_var = ramp_position(prep.ramp.t)) > prep.mm_complete)
+                            mm_remaining = mm_var; // In deceleration ramp.
+                        else { // End of block or end of forced-deceleration.
+                            // Only the time up to the end of the ramp. Forced deceleration may reach mm_complete
+                            // before the ramp ends, the segment time is then kept as the upper bound.
+                            if (prep.ramp.t > prep.ramp.t_ramp)
+                                time_var -= prep.ramp.t - prep.ramp.t_ramp;
+                            mm_remaining = prep.mm_complete;
+                            prep.current_speed = prep.exit_speed;
+                            prep.ramp.active = false;
+                        }
+                        break;
+                    }
+#endif
                     // NOTE: mm_var used as a misc worker variable to prevent errors when near zero speed.
                     speed_var = pl_block->acceleration * time_var; // Used as delta speed (mm/min)
                     if (prep.current_speed > speed_var) { // Check if at or below zero speed.
@@ -858,22 +2375,48 @@ void st_prep_buffer()
         if (sys.step_control.update_spindle_rpm || st_prep_block->dynamic_rpm) {
             float rpm;
             if (pl_block->condition.spindle.on) {
+                float block_rpm = pl_block->spindle.rpm;
+#ifdef ENABLE_RASTER_ROWS
+                if (pl_block->raster) {
+                    // Use the power of the pixel at the segment midpoint.
+                    raster_row_t *raster = pl_block->raster;
+                    float pixel = (raster->length - 0.5f * (pl_block->millimeters + mm_remaining)) * (float)raster->n_pixels / raster->length;
+                    block_rpm = raster->power[pixel <= 0.0f ? 0 : min((uint_fast16_t)pixel, raster->n_pixels - 1)];
+                }
+#endif
+#ifdef ENABLE_LASER_POWER_RAMP
+                // Power follows the speed, ramp from the power at the segment entry speed.
+                // NOTE: Computed first as spindle_set_rpm() also sets the reported spindle speed.
+                if(pl_block->condition.is_rpm_rate_adjusted && !(pl_block->condition.is_laser_ppi_mode || pl_block->condition.is_rpm_pos_adjusted) &&
+                    segment_entry_speed != prep.current_speed)
+                    entry_rpm = spindle_set_rpm(block_rpm * segment_entry_speed * prep.inv_feedrate, sys.override.spindle_rpm);
+#endif
                 // NOTE: Feed and rapid overrides are independent of PWM value and do not alter laser power/rate.
                 // If current_speed is zero, then may need to be rpm_min*(100/MAX_SPINDLE_RPM_OVERRIDE)
                 // but this would be instantaneous only and during a motion. May not matter at all.
-                rpm = spindle_set_rpm(pl_block->condition.is_rpm_rate_adjusted && !pl_block->condition.is_laser_ppi_mode
-                                       ? pl_block->spindle.rpm * prep.current_speed * prep.inv_feedrate
-                                       : pl_block->spindle.rpm, sys.override.spindle_rpm);
-
                 if(pl_block->condition.is_rpm_pos_adjusted) {
-                    float npos = (float)(pl_block->step_event_count - prep.steps_remaining) / (float)pl_block->step_event_count;
-                    rpm += (spindle_set_rpm(pl_block->spindle.css.target_rpm, sys.override.spindle_rpm) - prep.current_spindle_rpm) * npos;
+                    // Constant Surface Speed, RPM from the tool axis position at the segment midpoint.
+                    float npos = 1.0f - 0.5f * (pl_block->millimeters + mm_remaining) * prep.steps_per_mm / (float)pl_block->step_event_count;
+                    block_rpm = gc_get_css_rpm(&pl_block->spindle.css, pl_block->spindle.css.start_pos + pl_block->spindle.css.delta_pos * npos);
                 }
+
+                rpm = spindle_set_rpm(pl_block->condition.is_rpm_rate_adjusted && !pl_block->condition.is_laser_ppi_mode
+                                       ? block_rpm * prep.current_speed * prep.inv_feedrate
+                                       : block_rpm, sys.override.spindle_rpm);
             } else
                 sys.spindle_rpm = rpm = 0.0f;
 
             if(rpm != prep.current_spindle_rpm) {
-              #ifdef SPINDLE_PWM_DIRECT
+              #ifdef ENABLE_LASER_POWER_RAMP
+                prep.current_spindle_rpm = rpm;
+                prep_segment->spindle_pwm = hal.spindle_get_pwm(rpm);
+                // The slope per ISR tick is computed below when the number of ticks is known.
+                if(entry_rpm >= 0.0f) {
+                    uint_fast16_t pwm = prep_segment->spindle_pwm;
+                    prep_segment->spindle_pwm = hal.spindle_get_pwm(entry_rpm);
+                    pwm_delta = (int32_t)pwm - (int32_t)prep_segment->spindle_pwm;
+                }
+              #elif defined(SPINDLE_PWM_DIRECT)
                 prep.current_spindle_rpm = rpm;
                 prep_segment->spindle_pwm = hal.spindle_get_pwm(rpm);
               #else
@@ -904,7 +2447,7 @@ void st_prep_buffer()
             // Less than one step to decelerate to zero speed, but already very close. AMASS
             // requires full steps to execute. So, just bail.
             sys.step_control.end_motion = On;
-            if (settings.parking.flags.enabled && !prep.recalculate.parking)
+            if (SYSTEM_MOTION_IN_HOLD && !prep.recalculate.parking)
                 prep.recalculate.hold_partial_block = On;
             return; // Segment not generated, but current step data still retained.
         }
@@ -918,13 +2461,38 @@ void st_prep_buffer()
         // typically very small and do not adversely effect performance, but ensures that Grbl
         // outputs the exact acceleration and velocity profiles as computed by the planner.
         dt += prep.dt_remainder; // Apply previous segment partial step execute time
-        float inv_rate = dt / ((float)prep.steps_remaining - step_dist_remaining); // Compute adjusted step rate inverse
+        float inv_rate;
+#ifdef ENABLE_NATIVE_ARCS
+        // Arc chords end on whole steps, there is no partial step time to carry over.
+        if (pl_block->condition.arc_motion) {
+            prep_segment->n_step = arc_chord(mm_remaining);
+            prep_segment->exec_block = st_prep_block;
+            inv_rate = dt / (float)prep_segment->n_step;
+        } else
+#endif
+        inv_rate = dt / ((float)prep.steps_remaining - step_dist_remaining); // Compute adjusted step rate inverse
+
+#ifdef ENABLE_FEED_PER_REV_TRACKING
+        // Feed per revolution, slow the segment down by the measured to programmed RPM ratio as for a feed override.
+        // The profile is unchanged as the ratio is at most 1, the segment just takes longer to execute.
+        // A stalled spindle, below the minimum ratio, starts a feed hold. Segments are still slowed down by
+        // the minimum ratio so that the hold deceleration continues from the rate being output.
+        if (pl_block->condition.feed_per_rev) {
+            float ratio = pl_block->spindle.rpm > 0.0f ? hal.spindle_get_data(SpindleData_RPM).rpm / pl_block->spindle.rpm : 0.0f;
+            if(ratio < FEED_PER_REV_MIN_RATIO) {
+                ratio = FEED_PER_REV_MIN_RATIO;
+                if(!sys.step_control.execute_hold)
+                    system_set_exec_state_flag(EXEC_FEED_HOLD);
+            }
+            inv_rate /= ratio > 1.0f ? 1.0f : ratio;
+        }
+#endif
 
         // Compute timer ticks per step for the prepped segment.
         uint32_t cycles = (uint32_t)ceilf(cycles_per_min * inv_rate); // (cycles/step)
 
         // Record end position of segment relative to block if spindle synchronized motion
-        if((prep_segment->spindle_sync = pl_block->condition.spindle.synchronized)) {
+        if((prep_segment->spindle_sync = SPINDLE_SYNCHRONIZED(pl_block->condition))) {
             prep.target_position += dt * prep.target_feed;
             prep_segment->cruising = prep.ramp_type == Ramp_Cruise;
             prep_segment->target_position = prep.target_position; //st_prep_block->millimeters - pl_block->millimeters;
@@ -933,10 +2501,13 @@ void st_prep_buffer()
       #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
         // Compute step timing and multi-axis smoothing level.
         // NOTE: AMASS overdrives the timer with each level, so only one prescalar is required.
-        if (cycles < amass.level_1)
+        if (cycles < amass.level[0])
             prep_segment->amass_level = 0;
         else {
-            prep_segment->amass_level = cycles < amass.level_2 ? 1 : (cycles < amass.level_3 ? 2 : 3);
+            uint_fast8_t level = 1;
+            while (level < amass.max_level && cycles >= amass.level[level])
+                level++;
+            prep_segment->amass_level = level;
             cycles >>= prep_segment->amass_level;
             prep_segment->n_step <<= prep_segment->amass_level;
         }
@@ -944,13 +2515,47 @@ void st_prep_buffer()
 
         prep_segment->cycles_per_tick = cycles;
 
+#ifdef ENABLE_LASER_PPI
+        // Pulses are timed against the ISR ticks actually executed, AMASS truncates the cycles per step.
+        laser_ppi_segment(prep_segment, pl_block->condition.is_laser_ppi_mode && pl_block->condition.spindle.on && prep.current_spindle_rpm > 0.0f,
+                           prep_segment->n_step, prep.steps_per_mm * (float)(1 << prep_segment->amass_level), cycles);
+#endif
+
+#ifdef ENABLE_LASER_POWER_RAMP
+        if (pwm_delta) {
+            if (prep_segment->n_step)
+                prep_segment->spindle_pwm_slope = (int32_t)(((int64_t)pwm_delta << 16) / (int64_t)prep_segment->n_step);
+            else
+                prep_segment->spindle_pwm += pwm_delta;
+        }
+#endif
+
+#ifdef ENABLE_PERF_COUNTERS
+        // Motion stops after this segment at the end of a forced termination and when the block ends at zero speed.
+        motion_continues = !(mm_remaining <= prep.mm_complete && (mm_remaining > 0.0f || prep.exit_speed == 0.0f || sys.step_control.execute_sys_motion));
+#endif
+
+        if(hal.stepper_motion_phase || hook_active(Hook_MotionPhase))
+            set_motion_phase(prep.ramp_type == Ramp_Accel ? MotionPhase_Accel : (prep.ramp_type == Ramp_Cruise ? MotionPhase_Cruise : MotionPhase_Decel));
+
+#ifdef ENABLE_JOB_STATS
+        prep_segment->stats_dt = dt;
+        prep_segment->stats_fraction = (float)(prep.steps_remaining - n_steps_remaining) / (float)pl_block->step_event_count;
+#endif
+
         // Segment complete! Increment segment pointers, so stepper ISR can immediately execute it.
+        SEGMENT_BUFFER_BARRIER();
         segment_buffer_head = segment_next_head;
         segment_next_head = segment_next_head->next;
 
         // Update the appropriate planner and segment data.
         pl_block->millimeters = mm_remaining;
         prep.steps_remaining = n_steps_remaining;
+#ifdef ENABLE_NATIVE_ARCS
+        if (pl_block->condition.arc_motion)
+            prep.dt_remainder = 0.0f;
+        else
+#endif
         prep.dt_remainder = ((float)n_steps_remaining - step_dist_remaining) * inv_rate;
 
         // Check for exit conditions and flag to load next planner block.
@@ -962,7 +2567,7 @@ void st_prep_buffer()
                 // the segment queue, where realtime protocol will set new state upon receiving the
                 // cycle stop flag from the ISR. Prep_segment is blocked until then.
                 sys.step_control.end_motion = On;
-                if (settings.parking.flags.enabled && !prep.recalculate.parking)
+                if (SYSTEM_MOTION_IN_HOLD && !prep.recalculate.parking)
                     prep.recalculate.hold_partial_block = On;
                 return; // Bail!
             } else { // End of planner block
@@ -973,11 +2578,45 @@ void st_prep_buffer()
                 }
                 pl_block = NULL; // Set pointer to indicate check and load next planner block.
                 plan_discard_current_block();
+#ifdef ENABLE_PERF_COUNTERS
+                // A stop where the next block allows a non-zero junction speed is forced by the end of the planner buffer,
+                // the next block was queued too late to be blended with this one.
+                plan_block_t *next_block;
+                if(prep.exit_speed == 0.0f && sys.state == STATE_CYCLE && (next_block = plan_get_current_block()) && next_block->max_junction_speed_sqr > 0.0f)
+                    PERF_EVENT(Perf_ForcedStop);
+#endif
             }
         }
     }
 }
 
+// Drivers may call this from a task of their own in addition to the calls from the main program,
+// planner and segment generator updates are then serialized by hal.planner_lock.
+void st_prep_buffer()
+{
+    PERF_START(t);
+
+    PLANNER_LOCK(true);
+#ifdef ENABLE_JOB_STATS
+    stats_count();
+#endif
+#ifdef ENABLE_MOTION_LINK
+    if (!hal.motion_link.follower)
+        prep_buffer();
+    if (hal.motion_link.send)
+        st_link_send();
+#else
+    prep_buffer();
+#endif
+#ifdef ENABLE_REMOTE_STEPPER
+    if (hal.remote_stepper.send)
+        st_remote_send();
+#endif
+    PLANNER_LOCK(false);
+
+    PERF_END(Perf_PrepBuffer, t);
+}
+
 
 // Called by realtime status reporting to fetch the current speed being executed. This value
 // however is not exactly the current speed, but the speed computed in the last step segment
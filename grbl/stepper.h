@@ -29,12 +29,23 @@
   #define SEGMENT_BUFFER_SIZE 10
 #endif
 
+// Minimum distance, in steps, to generate a step segment for. Used by the planner to precompute values.
+#define REQ_MM_INCREMENT_SCALAR 1.25f
+
 typedef enum {
     SquaringMode_Both = 0,
     SquaringMode_A,
     SquaringMode_B,
 } squaring_mode_t;
 
+// Motion phase of the segments prepared, passed to hal.stepper_motion_phase when it changes.
+typedef enum {
+    MotionPhase_Idle = 0,
+    MotionPhase_Accel,
+    MotionPhase_Cruise,
+    MotionPhase_Decel
+} motion_phase_t;
+
 // Holds the planner block Bresenham algorithm execution data for the segments in the segment buffer.
 // NOTE: This data is copied from the prepped planner blocks so that the planner blocks may be
 // discarded when entirely consumed and completed by the segment buffer. Also, AMASS alters this
@@ -45,14 +56,43 @@ typedef struct st_block {
     uint32_t steps[N_AXIS];
     uint32_t step_event_count;
     axes_signals_t direction_bits;
+    axes_signals_t active_axes;       // Axes with steps to execute
+    int32_t position_delta[N_AXIS];   // System position change per step, -1 or 1
+#ifdef ENABLE_BACKLASH_COMPENSATION
+    uint32_t backlash_steps[N_AXIS];  // Steps taking up backlash, executed ahead of steps[]
+    uint32_t backlash_taken[N_AXIS];  // Backlash steps executed, these do not change the system position
+#endif
     gc_override_flags_t overrides;    // Block bitfield variable for overrides
     float steps_per_mm;
     float millimeters;
     float programmed_rate;
     char *message;                     // Message to be displayed when block is executed
     output_command_t *output_commands; // Output commands (linked list) to be performed when block is executed
+#ifdef ENABLE_COOLANT_QUEUE
+    bool coolant_sync;                 // Set coolant state when block is executed
+    coolant_state_t coolant;
+#endif
+#ifdef ENABLE_WCO_MOTION_SYNC
+    float *wco;                        // Work coordinate offset to be reported when block is executed
+#endif
+#ifdef ENABLE_POSITION_OUTPUTS
+    output_command_t *output_events;   // Output commands (linked list) to be performed at a position along the block, sorted by trigger
+    uint32_t output_position;          // Position along the block in output trigger units, only maintained while output events are pending
+#endif
     bool dynamic_rpm;                  // Tracks motions that require dynamic RPM adjustment
-    bool backlash_motion;
+#ifdef ENABLE_NATIVE_ARCS
+    bool arc_chord;                    // Chord following the first chord of a native arc, not the start of a new planner block
+#endif
+#ifdef ENABLE_MOTION_TRACE
+    int32_t line_number;               // Block line number, recorded in the motion trace
+#endif
+#ifdef ENABLE_CAN_IO
+    bool can_io_commit;                // Outputs are staged on remote I/O modules, committed when block is executed
+#endif
+#ifdef ENABLE_JOB_STATS
+    bool stats_spindle_on;             // Spindle on, for job statistics
+    float stats_distance[N_AXIS];      // Motor distance of each axis over the block (mm), for job statistics
+#endif
 } st_block_t;
 
 typedef struct st_segment {
@@ -64,13 +104,33 @@ typedef struct st_segment {
     uint_fast16_t n_step;           // Number of step events to be executed for this segment
 #ifdef SPINDLE_PWM_DIRECT
     uint_fast16_t spindle_pwm;      // Spindle PWM to be set at the start of segment execution
+#ifdef ENABLE_LASER_POWER_RAMP
+    int32_t spindle_pwm_slope;      // Spindle PWM change per ISR tick as 16.16 fixed point, zero if constant
+#endif
 #else
     float spindle_rpm;              // Spindle RPM to be set at the start of the segment execution
+#endif
+#ifdef ENABLE_LASER_PPI
+    uint32_t ppi_delay;             // Stepper timer cycles from the start of the segment to the first laser pulse
+    uint32_t ppi_period;            // Stepper timer cycles between laser pulses, 0 if no pulses
+    uint_fast16_t ppi_pulse_length; // Laser pulse length in microseconds
 #endif
     bool update_rpm;                // True if set spindle speed at the start of the segment execution
     bool spindle_sync;              // True if block is spindle synchronized
     bool cruising;                  // True when in cruising part of profile, only set for spindle synced moves
     uint_fast8_t amass_level;       // Indicates AMASS level for the ISR to execute this segment
+#ifdef ENABLE_JOB_STATS
+    float stats_dt;                 // Segment time (min), 0 if not counted in job statistics
+    float stats_fraction;           // Fraction of the block steps executed by the segment
+#endif
+#ifdef ENABLE_HOLD_SEGMENT_REWIND
+    // Segment generator state at the start of the segment, restored when the segment is retracted.
+    float rewind_mm;                // Distance from end of block (mm)
+    float rewind_speed;             // Speed (mm/min)
+    float rewind_dt_remainder;      // Partial step time carried over from the previous segment
+    float rewind_rpm;               // Spindle RPM
+    uint32_t rewind_steps;          // Steps remaining in block
+#endif
 } segment_t;
 
 // Stepper ISR data struct. Contains the running data for the main stepper ISR.
@@ -92,15 +152,38 @@ typedef struct {
     bool new_block;                 // Set to true when a new block is started, might be used by driver for advanced functionality
     axes_signals_t step_outbits;    // The next stepping-bits to be output
     axes_signals_t dir_outbits;     // The next direction-bits to be output
+    axes_signals_t active_axes;     // Axes with steps in the current block, the Bresenham line tracer skips the others
+    int32_t position_delta[N_AXIS]; // System position change per step
     uint32_t steps[N_AXIS];
     uint_fast8_t amass_level;       // AMASS level for this segment
-//    uint_fast16_t spindle_pwm;
+#ifdef ENABLE_BACKLASH_COMPENSATION
+    axes_signals_t backlash_axes;   // Axes with backlash take-up steps remaining in the current block
+    uint_fast8_t backlash_tick;     // ISR ticks in the take-up phase, take-up steps are output every 2^amass_level ticks
+#endif
+#ifdef ENABLE_LASER_POWER_RAMP
+    uint32_t spindle_pwm;           // Spindle PWM being output as 16.16 fixed point
+    int32_t spindle_pwm_slope;      // Spindle PWM change per ISR tick as 16.16 fixed point
+#endif
     uint_fast16_t step_count;       // Steps remaining in line segment motion
     uint32_t step_event_count;
+#ifdef ENABLE_POSITION_OUTPUTS
+    uint32_t output_increment;      // Output position change per ISR tick, depends on the AMASS level
+#endif
     st_block_t *exec_block;         // Pointer to the block data for the segment being executed
     segment_t *exec_segment;        // Pointer to the segment being executed
 } stepper_t;
 
+// Step pulse train rendered from a step segment by st_segment_render(), for drivers that output
+// step pulses by DMA or similar. All ticks in a train have the same period and direction.
+typedef struct {
+    uint32_t cycles_per_tick;       // Tick period, in the same unit as for hal.stepper_cycles_per_tick()
+    axes_signals_t dir_outbits;     // The direction bits to be output before the first tick
+    bool new_block;                 // Set to true when a new block is started, direction bits may have changed
+    uint_fast16_t size;             // Size of the step_outbits array, set by driver
+    uint_fast16_t ticks;            // Number of rendered ticks
+    axes_signals_t *step_outbits;   // The step bits to be output per tick, pointer to driver provided array
+} step_train_t;
+
 // Initialize and setup the stepper motor subsystem
 void stepper_init();
 
@@ -128,9 +211,106 @@ void st_prep_buffer();
 // Called by planner_recalculate() when the executing block is updated by the new plan.
 void st_update_plan_block_parameters();
 
+#ifdef ENABLE_HOLD_SEGMENT_REWIND
+// Retracts queued segments not yet started, called before st_update_plan_block_parameters() for a hold.
+void st_hold_rewind (void);
+#endif
+
+#ifdef ENABLE_POSITION_OUTPUTS
+// Sets position triggered outputs with a distance beyond the end of the motion, called on cycle completion.
+void st_output_events_flush (void);
+#endif
+
 // Called by realtime status reporting if realtime rate reporting is enabled in config.h.
 float st_get_realtime_rate();
 
 void stepper_driver_interrupt_handler (void);
 
+// Probe edge interrupt handler, see the probe_latch driver capability.
+void probe_interrupt_handler (int32_t (*position)[N_AXIS]);
+
+// Alternative to the stepper driver interrupt, renders the next step segment to a step pulse train.
+// Returns false when the segment buffer is empty, steppers are then set idle.
+bool st_segment_render (step_train_t *train);
+
+// Returns true if st_segment_render() has a step segment to render.
+bool st_segment_ready (void);
+
+#if defined(ENABLE_REMOTE_STEPPER) || defined(ENABLE_MOTION_LINK)
+
+/*
+  Remote stepper frames, multi byte values are little endian. The last byte of each frame is the CRC-8 of the
+  preceding bytes. Frames sent to the co-processor:
+
+  Block, sent before the first segment of a block, n = N_AXIS:
+    offset  size  content
+    0       1     REMOTE_FRAME_BLOCK
+    1       1     block id, st_block_t id
+    2       1     direction bits
+    3       1     active axes
+    4       4     step event count
+    8       4*n   steps per axis
+    8+4n    1     CRC-8
+
+  Segment, executed with the Bresenham data of the last block frame with the same block id:
+    0       1     REMOTE_FRAME_SEGMENT
+    1       1     block id
+    2       1     AMASS level, the axis steps of the block are shifted right by it
+    3       2     number of step events
+    5       4     step timer cycles per tick
+    9       1     CRC-8
+
+  Reset, the co-processor stops, discards its queue and clears its counters:
+    0       1     REMOTE_FRAME_RESET
+    1       1     CRC-8
+
+  Each block and segment frame takes a queue slot on the co-processor. A status frame is expected after a
+  reset and then whenever the driver polls the co-processor, n = N_AXIS:
+    0       1     REMOTE_FRAME_STATUS
+    1       1     flags, bit 0: executing, bit 1: probe triggered
+    2       1     number of segments completed since reset, modulo 256
+    3       1     number of frames received since reset, modulo 256
+    4       1     number of free queue slots
+    5       4*n   position in steps, signed. The position latched at the probe edge if the probe flag is set
+    5+4n    1     CRC-8
+
+  The co-processor Bresenham counters are reset to step event count / 2 when it starts a segment of a new block.
+*/
+
+#define REMOTE_FRAME_BLOCK   0x01
+#define REMOTE_FRAME_SEGMENT 0x02
+#define REMOTE_FRAME_RESET   0x03
+#define REMOTE_FRAME_STATUS  0x81
+
+#define REMOTE_BLOCK_LENGTH   (9 + 4 * N_AXIS)
+#define REMOTE_SEGMENT_LENGTH 10
+#define REMOTE_STATUS_LENGTH  (6 + 4 * N_AXIS)
+
+#endif
+
+#ifdef ENABLE_REMOTE_STEPPER
+
+// Called by the driver with status frames received from the co-processor, may be called from interrupt context.
+// Returns false if the frame is not a valid status frame.
+bool st_remote_status (const uint8_t *frame, uint_fast8_t length);
+
+#endif
+
+#ifdef ENABLE_MOTION_LINK
+
+// Called by the follower driver with block, segment and reset frames received from the leader, may be called from
+// interrupt context. A reset frame resets the follower. Returns false if the frame is invalid or the buffer is full.
+bool st_link_receive (const uint8_t *frame, uint_fast8_t length);
+
+// Called by the follower driver on the sync pulse edge, the next segment is started on the following stepper interrupt.
+void st_link_sync (void);
+
+#endif
+
+#ifdef ENABLE_STEP_TIMING
+// Alternative stepper driver interrupt handler stepping each axis at its exact step time, registered
+// in place of stepper_driver_interrupt_handler() for drivers with the step_timing capability.
+void stepper_timed_interrupt_handler (void);
+#endif
+
 #endif
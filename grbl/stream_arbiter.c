@@ -0,0 +1,242 @@
+/*
+  stream_arbiter.c - input from several streams, switched at line boundaries by priority
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_STREAM_ARBITER
+
+/*
+  Each source keeps its data in its own input buffer, the arbiter reads one line at a time from one of them.
+  At the start of a line the source with the highest priority that has data is selected, it then owns the
+  input until the line ends and the response to it is written to it. Sources are thus switched at block
+  boundaries without flushing or syncing, a host stream can stay connected while an MPG pendant jogs.
+
+  The owner is read through hal.stream.read so that the driver can suspend and restore it as before, e.g.
+  during a tool change. The owner is not switched while its input is suspended or a binary frame is being
+  received. A LF following a CR is read from the same source so that a CR LF line end is not split.
+*/
+
+typedef struct {
+    io_stream_t stream;
+    bool active;
+    int16_t held;           // Character read when looking for data, SERIAL_NO_DATA if none
+} arbiter_source_t;
+
+static struct {
+    bool initialized;
+    bool in_line;           // Owner is in the middle of a line
+    bool cr;                // Last character from owner was a CR
+    bool suspended;         // Owner input is suspended
+    bool cancel;            // Cancel the partial line from a removed or replaced owner
+    arbiter_source_t *owner;
+    arbiter_source_t source[StreamPriority_Count];
+} arbiter = {0};
+
+static uint16_t arbiter_read_block (char *buffer, uint16_t max);
+static void arbiter_reset_read_buffer (void);
+static void arbiter_cancel_read_buffer (void);
+static bool arbiter_suspend_read (bool suspend);
+
+static void set_owner (arbiter_source_t *source)
+{
+    io_stream_t *host = &arbiter.source[StreamPriority_Host].stream;
+
+    arbiter.owner = source;
+    arbiter.in_line = arbiter.cr = false;
+
+    hal.stream.type = source->stream.type;
+    hal.stream.read = source->stream.read;
+    hal.stream.write = source->stream.write;
+    hal.stream.write_n = source->stream.write_n;
+    hal.stream.write_all = host->write_all ? host->write_all : source->stream.write;
+    hal.stream.get_rx_buffer_available = source->stream.get_rx_buffer_available;
+    hal.stream.get_tx_buffer_available = source->stream.get_tx_buffer_available;
+    hal.stream.get_rx_lines = source->stream.get_rx_lines;
+    hal.stream.read_block = arbiter_read_block;
+    hal.stream.reset_read_buffer = arbiter_reset_read_buffer;
+    hal.stream.cancel_read_buffer = source->stream.cancel_read_buffer ? arbiter_cancel_read_buffer : NULL;
+    hal.stream.suspend_read = source->stream.suspend_read ? arbiter_suspend_read : NULL;
+}
+
+static int16_t source_peek (arbiter_source_t *source)
+{
+    if(source->held == SERIAL_NO_DATA)
+        source->held = source == arbiter.owner ? hal.stream.read() : source->stream.read();
+
+    return source->held;
+}
+
+static void select_source (void)
+{
+    uint_fast8_t idx = StreamPriority_Count;
+    arbiter_source_t *source = arbiter.owner;
+
+    if(arbiter.cr && source_peek(source) == ASCII_LF)
+        return;
+
+    if(arbiter.suspended)
+        return;
+
+#ifdef ENABLE_BINARY_STREAM
+    if(binary_stream_receiving())
+        return;
+#endif
+
+    do {
+        idx--;
+        if(arbiter.source[idx].active && source_peek(&arbiter.source[idx]) != SERIAL_NO_DATA) {
+            source = &arbiter.source[idx];
+            break;
+        }
+    } while(idx);
+
+    if(source != arbiter.owner) {
+        arbiter.owner->stream.read = hal.stream.read; // Keep the handler, the driver may have swapped it.
+        set_owner(source);
+    }
+}
+
+static uint16_t arbiter_read_block (char *buffer, uint16_t max)
+{
+    int16_t c;
+    uint16_t count = 0;
+
+    if(arbiter.cancel) {
+        arbiter.cancel = false;
+        *buffer = ASCII_CAN;
+        return 1;
+    }
+
+    if(!arbiter.in_line)
+        select_source();
+
+    while(count < max) {
+
+        if((c = arbiter.owner->held) != SERIAL_NO_DATA)
+            arbiter.owner->held = SERIAL_NO_DATA;
+        else if((c = hal.stream.read()) == SERIAL_NO_DATA)
+            break;
+
+        buffer[count++] = (char)c;
+
+        if(c == ASCII_LF || c == ASCII_CR) {
+            arbiter.in_line = false;
+            arbiter.cr = c == ASCII_CR;
+            break;
+        }
+
+        arbiter.in_line = true;
+        arbiter.cr = false;
+    }
+
+    return count;
+}
+
+static void arbiter_reset_read_buffer (void)
+{
+    uint_fast8_t idx = StreamPriority_Count;
+
+    do {
+        idx--;
+        arbiter.source[idx].held = SERIAL_NO_DATA;
+        if(arbiter.source[idx].active && arbiter.source[idx].stream.reset_read_buffer)
+            arbiter.source[idx].stream.reset_read_buffer();
+    } while(idx);
+
+    arbiter.in_line = arbiter.cr = arbiter.suspended = arbiter.cancel = false;
+}
+
+static void arbiter_cancel_read_buffer (void)
+{
+    arbiter.owner->held = SERIAL_NO_DATA;
+    arbiter.in_line = arbiter.cr = false;
+    arbiter.owner->stream.cancel_read_buffer();
+}
+
+static bool arbiter_suspend_read (bool suspend)
+{
+    arbiter.suspended = suspend;
+
+    return arbiter.owner->stream.suspend_read(suspend);
+}
+
+bool stream_arbiter_init (void)
+{
+    uint_fast8_t idx = StreamPriority_Count;
+
+    if(hal.stream.read_block)
+        return false;
+
+    memset(&arbiter, 0, sizeof(arbiter));
+
+    do {
+        arbiter.source[--idx].held = SERIAL_NO_DATA;
+    } while(idx);
+
+    memcpy(&arbiter.source[StreamPriority_Host].stream, &hal.stream, sizeof(io_stream_t));
+    arbiter.source[StreamPriority_Host].active = true;
+    arbiter.initialized = true;
+
+    set_owner(&arbiter.source[StreamPriority_Host]);
+
+    return true;
+}
+
+bool stream_arbiter_add (const io_stream_t *stream, stream_priority_t priority)
+{
+    arbiter_source_t *source;
+
+    if(!arbiter.initialized || priority >= StreamPriority_Count)
+        return false;
+
+    source = &arbiter.source[priority];
+
+    memcpy(&source->stream, stream, sizeof(io_stream_t));
+    source->active = true;
+    source->held = SERIAL_NO_DATA;
+
+    if(source == arbiter.owner) {
+        arbiter.cancel = arbiter.in_line;
+        arbiter.suspended = false;
+        set_owner(source);
+    } else if(priority == StreamPriority_Host)
+        hal.stream.write_all = stream->write_all ? stream->write_all : arbiter.owner->stream.write;
+
+    return true;
+}
+
+void stream_arbiter_remove (stream_priority_t priority)
+{
+    arbiter_source_t *source;
+
+    if(!arbiter.initialized || priority == StreamPriority_Host || priority >= StreamPriority_Count || !(source = &arbiter.source[priority])->active)
+        return;
+
+    source->active = false;
+    source->held = SERIAL_NO_DATA;
+
+    if(source == arbiter.owner) {
+        arbiter.cancel = arbiter.in_line;
+        arbiter.suspended = false;
+        set_owner(&arbiter.source[StreamPriority_Host]);
+    }
+}
+
+#endif
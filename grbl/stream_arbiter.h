@@ -0,0 +1,49 @@
+/*
+  stream_arbiter.h - input from several streams, switched at line boundaries by priority
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _STREAM_ARBITER_H_
+#define _STREAM_ARBITER_H_
+
+#ifdef ENABLE_STREAM_ARBITER
+
+// One input source per priority, a source with higher priority is read first.
+typedef enum {
+    StreamPriority_Host = 0,    // The stream set up by the driver, replaced when the driver switches streams
+    StreamPriority_Keypad,
+    StreamPriority_MPG,
+    StreamPriority_Count
+} stream_priority_t;
+
+// Takes the current hal.stream as the host source and replaces its input handlers, called by the core after
+// driver_init(). Returns false, and leaves hal.stream unchanged, if the stream provides read_block().
+bool stream_arbiter_init (void);
+
+// Adds stream as the input source with the given priority, or replaces the source with that priority. A
+// partial line read from a replaced source is cancelled. Returns false if the arbiter is not initialized,
+// the driver should then set up hal.stream itself.
+bool stream_arbiter_add (const io_stream_t *stream, stream_priority_t priority);
+
+// Removes the source with the given priority, the host source cannot be removed. A partial line read from
+// the source is cancelled.
+void stream_arbiter_remove (stream_priority_t priority);
+
+#endif
+
+#endif
@@ -21,6 +21,22 @@
 
 #include "grbl.h"
 
+// Soft limits and jog envelopes in machine coordinates, see system_init_travel_limits().
+static struct {
+    float min[N_AXIS];
+    float max[N_AXIS];
+    float jog_min[N_AXIS];
+    float jog_max[N_AXIS];
+} travel_envelope;
+
+#ifdef ENABLE_ROTARY_WRAP
+#ifdef KINEMATICS_API
+#error "ENABLE_ROTARY_WRAP cannot be used with kinematics"
+#endif
+// Steps per revolution of the wrapping rotary axes, 0 if a revolution is not a whole number of steps.
+static int32_t rotary_rev_steps[N_AXIS];
+#endif
+
 // Pin change interrupt for pin-out commands, i.e. cycle start, feed hold, and reset. Sets
 // only the realtime command execute variable to have the main program execute these when
 // its ready. This works exactly like the character-based realtime commands when picked off
@@ -57,6 +73,7 @@ ISR_CODE void control_interrupt_handler (control_signals_t signals)
                 system_set_exec_state_flag(EXEC_FEED_HOLD);
             else if (signals.cycle_start)
                 system_set_exec_state_flag(EXEC_CYCLE_START);
+            system_pend_realtime();
         }
     }
 }
@@ -76,9 +93,19 @@ void system_execute_startup (char *line)
                 report_execute_startup_message(line, gc_execute_block(line, NULL));
         }
     }
+
+#ifdef ENABLE_MACROS
+    macros_execute_startup();
+#endif
 }
 
 
+// Returns true for the reports not depending on queued motion: $, $$, $G, $# and $I.
+static inline bool is_report_command (const char *line)
+{
+    return line[1] == '\0' || (line[2] == '\0' && (line[1] == '$' || line[1] == 'G' || line[1] == '#' || line[1] == 'I'));
+}
+
 // Directs and executes one line of formatted input from protocol_process. While mostly
 // incoming streaming g-code blocks, this also executes Grbl internal commands, such as
 // settings, initiating the homing cycle, and toggling switch states. This differs from
@@ -98,6 +125,10 @@ status_code_t system_execute_line (char *line)
     if(strlen(line) >= ((LINE_BUFFER_SIZE / 2) - 1))
         return Status_Overflow;
 
+    // Queue remaining moves of any pending canned cycle, commands are executed in program order.
+    if(!is_report_command(line) && !mc_canned_flush())
+        return Status_Reset;
+
     // Uppercase original and copy original out in the buffer
     // TODO: create a common function for stripping down uppercase version?
     do {
@@ -116,6 +147,17 @@ status_code_t system_execute_line (char *line)
             break;
 
         case 'J': // Jogging, execute only if in IDLE or JOG states.
+          #ifdef ENABLE_JSON_REPORTS
+            if (line[2] == 'S' && line[3] == 'O' && line[4] == 'N') { // $JSON=<0|1>, select text or JSON reports
+                retval = report_json_command(&line[5]);
+                break;
+            }
+          #endif
+          #ifdef ENABLE_HOLD_JOG
+            if (sys.state == STATE_HOLD) // Jog away from a feed hold, executed as a system motion.
+                retval = line[2] != '=' ? Status_InvalidStatement : state_hold_jog(line);
+            else
+          #endif
             if (!(sys.state == STATE_IDLE || (sys.state & (STATE_JOG|STATE_TOOL_CHANGE))))
                 retval = Status_IdleError;
             else
@@ -125,7 +167,11 @@ status_code_t system_execute_line (char *line)
         case '$': // Prints Grbl settings
             if (line[2] != '\0' )
                 retval = Status_InvalidStatement;
+#ifdef ENABLE_CHUNKED_REPORTS
+            else if ((sys.state & (STATE_CYCLE|STATE_HOLD)) && hal.stream.get_tx_buffer_available == NULL)
+#else
             else if (sys.state & (STATE_CYCLE|STATE_HOLD))
+#endif
                 retval =  Status_IdleError; // Block during cycle. Takes too long to print.
             else
                 report_grbl_settings();
@@ -141,6 +187,19 @@ status_code_t system_execute_line (char *line)
             break;
 
         case 'B': // Toggle block delete mode
+            if(!strcmp(&line[1], "BEGIN")) { // Start a batch of setting changes [IDLE/ALARM]
+                if(!(sys.state == STATE_IDLE || (sys.state & (STATE_ALARM|STATE_ESTOP))))
+                    retval = Status_IdleError;
+                else
+                    settings_batch_begin();
+                break;
+            }
+          #ifdef ENABLE_BINARY_STREAM
+            if (line[2] == 'I' && line[3] == 'N') { // $BIN=<0|1>, disable or enable binary frames
+                retval = binary_stream_command(&line[4]);
+                break;
+            }
+          #endif
             if (line[2] != '\0')
                 retval = Status_InvalidStatement;
             else {
@@ -150,6 +209,10 @@ status_code_t system_execute_line (char *line)
             break;
 
         case 'C': // Set check g-code mode [IDLE/CHECK]
+            if(!strcmp(&line[1], "COMMIT")) { // Apply a batch of setting changes
+                settings_batch_commit();
+                break;
+            }
             if (line[2] != '\0')
                 retval = Status_InvalidStatement;
             else if (sys.state == STATE_CHECK_MODE) {
@@ -194,6 +257,12 @@ status_code_t system_execute_line (char *line)
             break;
 
         case 'H': // Perform homing cycle [IDLE/ALARM]
+#ifdef ENABLE_HEIGHT_MAP
+            if(line[2] == 'M' && line[3] == 'A' && line[4] == 'P') { // $HMAP=1, $HMAP=0 and $HMAP, enable, disable or report height map compensation
+                retval = height_map_command(&line[5]);
+                break;
+            }
+#endif
             if(!(sys.state == STATE_IDLE || sys.state == STATE_ALARM))
                 retval = Status_IdleError;
             else {
@@ -265,6 +334,21 @@ status_code_t system_execute_line (char *line)
             break;
 
         case 'S': // Puts Grbl to sleep [IDLE/ALARM]
+#ifdef ENABLE_JOB_STATS
+            if(!strncmp(&line[1], "STATS", 5)) { // Report or clear job statistics
+                retval = job_stats_command(&line[6]);
+                break;
+            }
+#endif
+#ifdef EMULATE_EEPROM
+            if(!strcmp(&line[1], "SYNC")) { // Write pending settings changes [IDLE/ALARM]
+                if(!(sys.state == STATE_IDLE || (sys.state & (STATE_ALARM|STATE_ESTOP|STATE_CHECK_MODE))))
+                    retval = Status_IdleError;
+                else
+                    eeprom_emu_sync_physical();
+                break;
+            }
+#endif
             if(!settings.flags.sleep_enable || !(line[2] == 'L' && line[3] == 'P' && line[4] == '\0'))
                 retval = Status_InvalidStatement;
             else if(!(sys.state == STATE_IDLE || sys.state == STATE_ALARM))
@@ -298,6 +382,10 @@ status_code_t system_execute_line (char *line)
             break;
 
         case 'R': // Restore defaults [IDLE/ALARM]
+            if (line[2] == 'T') { // $RT=<ms>, periodic status reports
+                retval = report_status_push_command(&line[3]);
+                break;
+            }
             {
                 settings_restore_t restore = {0};
                 if (!(line[2] == 'S' && line[3] == 'T' && line[4] == '=' && line[6] == '\0'))
@@ -379,11 +467,76 @@ status_code_t system_execute_line (char *line)
         case 'Q':
             hal.stream.write(uitoa((uint32_t)sizeof(settings_t)));
             hal.stream.write(" ");
-            hal.stream.write(uitoa((uint32_t)sizeof(coord_data_t) + 1));
+            hal.stream.write(uitoa((uint32_t)sizeof(coord_data_t) + EEPROM_CHECKSUM_SIZE));
             hal.stream.write("\r\n");
             break;
 #endif
 
+#ifdef ENABLE_MOTION_TRACE
+        case 'T':
+            if(line[2] == 'R' && line[3] == 'A' && line[4] == 'C' && line[5] == 'E') { // $TRACE and $TRACE=0, output or clear the motion trace
+                retval = trace_command(&line[6]);
+                break;
+            }
+            // no break
+#endif
+
+#if defined(ENABLE_PERF_COUNTERS) || defined(ENABLE_PROBE_GRID) || defined(ENABLE_LASER_PPI) || defined(ENABLE_SPINDLE_PID)
+        case 'P':
+  #ifdef ENABLE_PERF_COUNTERS
+            if(line[2] == 'E' && line[3] == 'R' && line[4] == 'F') { // $PERF and $PERF=0, report or reset cycle counts
+                retval = perf_command(&line[5]);
+                break;
+            }
+  #endif
+  #ifdef ENABLE_PROBE_GRID
+            if(line[2] == 'G' && line[3] == 'R' && line[4] == 'I' && line[5] == 'D') { // $PGRID=..., $PGRID and $PGRID=0, probe, output or clear grid
+                retval = probe_grid_command(&line[6]);
+                break;
+            }
+  #endif
+  #ifdef ENABLE_LASER_PPI
+            if(line[2] == 'P' && line[3] == 'I') { // $PPI=<ppi>,<pulse length>, $PPI and $PPI=0, set, report or switch off laser PPI mode
+                retval = laser_ppi_command(&line[4]);
+                break;
+            }
+  #endif
+  #ifdef ENABLE_SPINDLE_PID
+            if(line[2] == 'I' && line[3] == 'D' && line[4] == 'S') { // $PIDS=<n>, $PIDS=0 and $PIDS, stream every n-th sample, stop or report the spindle PID stream
+                retval = spindle_pid_command(&line[5]);
+                break;
+            }
+  #endif
+            // no break
+#endif
+
+#ifdef ENABLE_FOLLOWING_ERROR
+        case 'F':
+            if(line[2] == 'E' && line[3] == 'R' && line[4] == 'R') { // $FERR and $FERR=0, report or clear the max. following error
+                retval = following_error_command(&line[5]);
+                break;
+            }
+            // no break
+#endif
+
+#ifdef ENABLE_ACK_COALESCING
+        case 'A':
+            if(line[2] == 'C' && line[3] == 'K') { // $ACK=<0|1>, select coalesced or per line acknowledgments
+                retval = report_ack_command(&line[4]);
+                break;
+            }
+            // no break
+#endif
+
+#ifdef ENABLE_MACROS
+        case 'M':
+            if(line[2] == 'A' && line[3] == 'C') { // $MAC, $MAC=<name> and $MAC:<name>=<blocks>, output, execute or store macros
+                retval = macros_command(&line[4]);
+                break;
+            }
+            // no break
+#endif
+
         default:
             retval = Status_Unhandled;
 
@@ -410,6 +563,107 @@ status_code_t system_execute_line (char *line)
     return retval;
 }
 
+#ifdef ENABLE_WCO_MOTION_SYNC
+
+/*
+  The parser offsets are ahead of the motion being executed. Instead of waiting for the planner buffer to empty
+  a changed offset is attached to the next planner block and the stepper ISR makes it the reported offset when
+  the block starts. If no motion follows the change is reported when the buffered motion has completed.
+*/
+
+static void system_get_parser_wco (float *wco)
+{
+    uint_fast8_t idx = N_AXIS;
+
+    do {
+        idx--;
+        wco[idx] = gc_get_offset(idx);
+    } while(idx);
+}
+
+static float *wco_pending = NULL;           // Offset changed since the last block planned.
+static float *volatile wco_active = NULL;   // Offset of the motion being executed, NULL for the parser offset.
+static volatile uint_fast8_t wco_sequence = 0;
+static uint_fast8_t wco_reported = 0;
+
+void system_flag_wco_change ()
+{
+    float wco[N_AXIS];
+
+    // Lines held back by motion control were programmed with the previous offset.
+    mc_canned_flush();
+#ifdef MC_LINE_HOLD
+    mc_line_flush();
+#endif
+
+    system_get_parser_wco(wco);
+
+    if(wco_pending)
+        memcpy(wco_pending, wco, sizeof(wco));
+    else if((wco_pending = pool_wco_get(wco)) == NULL && protocol_buffer_synchronize())
+        wco_pending = pool_wco_get(wco); // Pool exhausted, the queued offsets are released when motion has completed.
+
+    sys.report.wco = On;
+}
+
+float *system_wco_attach (void)
+{
+    float *wco = wco_pending;
+
+    wco_pending = NULL;
+
+    return wco;
+}
+
+ISR_CODE void system_wco_execute (float *wco)
+{
+    float *previous = wco_active;
+
+    wco_active = wco;
+    wco_sequence++;
+
+    // NOTE: Entries are only reused by the foreground process, a previous entry being copied by system_get_wco() is not overwritten.
+    if(previous)
+        pool_wco_release(previous);
+}
+
+bool system_get_wco (float *wco)
+{
+    bool changed;
+    float *active;
+
+    if(wco_pending && plan_get_current_block() == NULL && !(sys.state & (STATE_CYCLE|STATE_HOLD)))
+        system_wco_execute(system_wco_attach());
+
+    if((active = wco_active))
+        memcpy(wco, active, sizeof(float) * N_AXIS);
+    else
+        system_get_parser_wco(wco);
+
+    changed = wco_reported != wco_sequence;
+    wco_reported = wco_sequence;
+
+    return changed;
+}
+
+void system_wco_reset (void)
+{
+    float wco[N_AXIS];
+
+    if(wco_pending) {
+        pool_wco_release(wco_pending);
+        wco_pending = NULL;
+    }
+
+    system_wco_execute(NULL);
+
+    // No motion is queued, the parser offset is the offset of the machine.
+    system_get_parser_wco(wco);
+    system_wco_execute(pool_wco_get(wco));
+}
+
+#else
+
 void system_flag_wco_change ()
 {
     if(!settings.status_report.sync_on_wco_change)
@@ -418,6 +672,24 @@ void system_flag_wco_change ()
     sys.report.wco = On;
 }
 
+#endif
+
+// Copies a coherent snapshot of the system position while motion is running, without disabling interrupts.
+// Writers increment sys_position_seq before and after updating the position, the copy is retried if the
+// counter was odd, an update in progress, or changed while copying. Can be called from the foreground only,
+// the ISR has no need for it.
+void system_get_position (int32_t (*position)[N_AXIS])
+{
+    uint_fast8_t seq;
+
+    do {
+        while((seq = sys_position_seq) & 0x01);
+        SYS_POSITION_BARRIER();
+        memcpy(position, sys_position, sizeof(sys_position));
+        SYS_POSITION_BARRIER();
+    } while(seq != sys_position_seq);
+}
+
 // Sets machine position. Must be sent a 'step' array.
 // NOTE: If motor steps and machine position are not in the same coordinate frame, this function
 //       serves as a central place to compute the transformation.
@@ -434,60 +706,134 @@ void system_convert_array_steps_to_mpos (float *position, int32_t *steps)
 #endif
 }
 
-// Checks and reports if target array exceeds machine travel limits. Returns false if check failed.
+// Computes the soft limits envelope, the min and max machine position per axis, from the settings.
+// The jog envelope keeps the pulloff distance from the limit switches of homed axes when hard limits
+// are enabled, the origin end is not adjusted when homing forced set origin is enabled.
+// Called on startup and when settings are changed.
 // NOTE: max_travel is stored as negative
+void system_init_travel_limits (void)
+{
+    uint_fast8_t idx = N_AXIS;
+    axes_signals_t homing = {0};
+    float pulloff;
+
+    do {
+        homing.mask |= settings.homing.cycle[--idx].mask;
+    } while(idx);
+
+    idx = N_AXIS;
+    do {
+        idx--;
+        if(settings.max_travel[idx] < -0.0f) {
+            // When homing forced set origin is enabled, soft limits need to account for directionality.
+            if(settings.homing.flags.force_set_origin && bit_istrue(settings.homing.dir_mask.value, bit(idx))) {
+                travel_envelope.min[idx] = 0.0f;
+                travel_envelope.max[idx] = -settings.max_travel[idx];
+            } else {
+                travel_envelope.min[idx] = settings.max_travel[idx];
+                travel_envelope.max[idx] = 0.0f;
+            }
+        } else { // No max travel set, axis is not limited.
+            travel_envelope.min[idx] = -INFINITY;
+            travel_envelope.max[idx] = INFINITY;
+        }
+#ifdef ENABLE_ROTARY_WRAP
+        rotary_rev_steps[idx] = 0;
+        if(bit_istrue(settings.rotary_wrap.mask, bit(idx))) {
+            // A wrapping axis has no end of travel.
+            float rev_steps = settings.steps_per_mm[idx] * 360.0f;
+            travel_envelope.min[idx] = -INFINITY;
+            travel_envelope.max[idx] = INFINITY;
+            if(fabsf(rev_steps - roundf(rev_steps)) < 0.001f)
+                rotary_rev_steps[idx] = (int32_t)lroundf(rev_steps);
+        }
+#endif
+        pulloff = settings.limits.flags.hard_enabled && bit_istrue(homing.mask, bit(idx)) ? settings.homing.pulloff : 0.0f;
+        travel_envelope.jog_min[idx] = travel_envelope.min[idx] +
+                                        (settings.homing.flags.force_set_origin && bit_istrue(settings.homing.dir_mask.value, bit(idx)) ? 0.0f : pulloff);
+        travel_envelope.jog_max[idx] = travel_envelope.max[idx] -
+                                        (settings.homing.flags.force_set_origin && bit_isfalse(settings.homing.dir_mask.value, bit(idx)) ? 0.0f : pulloff);
+    } while(idx);
+}
+
+#ifdef ENABLE_ROTARY_WRAP
+
+// Wraps the positions of the wrapping rotary axes in the position array to 0 - 360 degrees.
+void system_wrap_rotary_axes (float *position)
+{
+    uint_fast8_t idx = N_AXIS;
+
+    do {
+        idx--;
+        if(bit_istrue(settings.rotary_wrap.mask, bit(idx))) {
+            position[idx] = fmodf(position[idx], 360.0f);
+            if(position[idx] < 0.0f)
+                position[idx] += 360.0f;
+        }
+    } while(idx);
+}
+
+// Folds the step counts of the wrapping rotary axes into a single revolution, keeping them from overflowing
+// on axes that keep turning the same way. The parser and planner positions are moved by the same number of
+// revolutions. Called from the main loop between blocks, only when all motion has completed. The parser takes
+// absolute positions of the axes relative to the revolution it is in, so the fold does not change later moves.
+// NOTE: Axes where a revolution is not a whole number of steps are not folded, only their reported position wraps.
+void system_fold_rotary_position (void)
+{
+    bool folded = false;
+    int32_t revs;
+    uint_fast8_t idx = N_AXIS;
+
+    if(sys.state != STATE_IDLE || plan_get_current_block())
+        return;
+
+    sys_position_write_begin();
+
+    do {
+        idx--;
+        if(rotary_rev_steps[idx] && (sys_position[idx] < 0 || sys_position[idx] >= rotary_rev_steps[idx])) {
+            revs = sys_position[idx] / rotary_rev_steps[idx];
+            if(sys_position[idx] < revs * rotary_rev_steps[idx])
+                revs--; // Round towards minus infinity.
+            sys_position[idx] -= revs * rotary_rev_steps[idx];
+            gc_state.position[idx] -= (float)revs * 360.0f;
+            folded = true;
+        }
+    } while(idx);
+
+    sys_position_write_end();
+
+    if(folded) {
+        plan_sync_position();
+    }
+}
+
+#endif
+
+// Checks and reports if target array exceeds machine travel limits. Returns false if check failed.
+// All axes are compared against the envelope without branching or early exit.
 // TODO: only check homed axes?
 bool system_check_travel_limits (float *target)
 {
-    bool failed = false;
-    uint_fast8_t idx = N_AXIS;
+    uint_fast8_t failed = 0, idx = N_AXIS;
 
-    if(settings.homing.flags.force_set_origin) {
-        do {
-            idx--;
-        // When homing forced set origin is enabled, soft limits checks need to account for directionality.
-            failed = settings.max_travel[idx] < -0.0f &&
-                      (bit_istrue(settings.homing.dir_mask.value, bit(idx))
-                        ? (target[idx] < 0.0f || target[idx] > -settings.max_travel[idx])
-                        : (target[idx] > 0.0f || target[idx] < settings.max_travel[idx]));
-        } while(!failed && idx);
-    } else do {
+    do {
         idx--;
-        failed = settings.max_travel[idx] < -0.0f && (target[idx] > 0.0f || target[idx] < settings.max_travel[idx]);
-    } while(!failed && idx);
+        failed |= (target[idx] < travel_envelope.min[idx]) | (target[idx] > travel_envelope.max[idx]);
+    } while(idx);
 
     return !failed;
 }
 
-// Limits jog commands to be within machine limits, homed axes only.
-// When hard limits are enabled pulloff distance is subtracted to avoid triggering limit switches.
-// NOTE: max_travel is stored as negative
+// Limits jog commands to be within the jog envelope, homed axes only.
+// Each axis is clamped against the envelope as for system_check_travel_limits().
 void system_apply_jog_limits (float *target)
 {
     uint_fast8_t idx = N_AXIS;
 
     if(sys.homed.mask) do {
         idx--;
-        float pulloff = settings.limits.flags.hard_enabled && bit_istrue(sys.homing.mask, bit(idx)) ? settings.homing.pulloff : 0.0f;
-        if(bit_istrue(sys.homed.mask, bit(idx)) && settings.max_travel[idx] < -0.0f) {
-            if(settings.homing.flags.force_set_origin) {
-                if(bit_isfalse(settings.homing.dir_mask.value, bit(idx))) {
-                    if(target[idx] > 0.0f)
-                        target[idx] = 0.0f;
-                    else if(target[idx] < (settings.max_travel[idx] + pulloff))
-                        target[idx] = (settings.max_travel[idx] + pulloff);
-                } else {
-                    if(target[idx] < 0.0f)
-                        target[idx] = 0.0f;
-                    else if(target[idx] > -(settings.max_travel[idx] + pulloff))
-                        target[idx] = -(settings.max_travel[idx] + pulloff);
-                }
-            } else {
-                if(target[idx] > -pulloff)
-                    target[idx] = -pulloff;
-                else if(target[idx] < (settings.max_travel[idx] + pulloff))
-                    target[idx] = (settings.max_travel[idx] + pulloff);
-            }
-        }
+        if(bit_istrue(sys.homed.mask, bit(idx)))
+            target[idx] = fminf(fmaxf(target[idx], travel_envelope.jog_min[idx]), travel_envelope.jog_max[idx]);
     } while(idx);
 }
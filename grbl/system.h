@@ -43,6 +43,8 @@
 #define EXEC_PID_REPORT     bit(10)
 #define EXEC_GCODE_REPORT   bit(11)
 #define EXEC_TLO_REPORT     bit(12)
+#define EXEC_STATUS_PUSH    bit(13)
+#define EXEC_BINARY_REPORT  bit(14)
 
 // Define system state bit map. The state variable primarily tracks the individual functions
 // of Grbl to manage each without overlapping. It is also used as a messaging flag for
@@ -95,7 +97,9 @@ typedef enum {
     Alarm_EStop = 10,
     Alarm_HomingRequried = 11,
     Alarm_LimitsEngaged = 12,
-    Alarm_ProbeProtect = 13
+    Alarm_ProbeProtect = 13,
+    Alarm_Spindle = 14,
+    Alarm_FollowingError = 15
 } alarm_code_t;
 
 typedef enum {
@@ -192,6 +196,9 @@ typedef struct {
     uint8_t feed_rate;              // Feed rate override value in percent
     uint8_t rapid_rate;             // Rapids override value in percent
     uint8_t spindle_rpm;            // Spindle speed override value in percent
+#ifdef ENABLE_FEED_ADAPTATION
+    uint8_t feed_adapt;             // Feed rate reduction for stream starvation in percent, see plan_feed_adapt()
+#endif
     spindle_stop_t spindle_stop;    // Tracks spindle stop override states
     gc_override_flags_t control;    // Tracks override control states.
 } overrides_t;
@@ -238,9 +245,42 @@ typedef struct {
 
 extern system_t sys;
 
+// Time taken to reach the welcome message from power-up and from the last reset, in ms.
+// Only measured if the driver provides hal.get_elapsed_ticks.
+typedef struct {
+    uint32_t cold_start;
+    uint32_t reset;
+#ifdef ENABLE_WARM_RESET
+    uint32_t reset_request; // Tick count when the last reset was executed, the reset time is measured from it.
+#endif
+} startup_time_t;
+
+extern startup_time_t sys_startup_time;
+
 // NOTE: These position variables may need to be declared as volatiles, if problems arise.
 extern int32_t sys_position[N_AXIS];      // Real-time machine (aka home) position vector in steps.
 extern int32_t sys_probe_position[N_AXIS]; // Last probe position in machine coordinates and steps.
+extern volatile uint_fast8_t sys_position_seq; // Position update sequence counter, odd while an update is in progress.
+
+// Memory barrier for position updates, the stepper ISR and the reader may run on different cores.
+#ifdef __GNUC__
+#define SYS_POSITION_BARRIER() __sync_synchronize()
+#else
+#define SYS_POSITION_BARRIER()
+#endif
+
+// Brackets an update of sys_position while motion may be running, see system_get_position().
+static inline void sys_position_write_begin (void)
+{
+    sys_position_seq++;
+    SYS_POSITION_BARRIER();
+}
+
+static inline void sys_position_write_end (void)
+{
+    SYS_POSITION_BARRIER();
+    sys_position_seq++;
+}
 
 extern volatile probing_state_t sys_probing_state; // Probing state value.  Used to coordinate the probing cycle with stepper ISR.
 extern volatile uint_fast16_t sys_rt_exec_state;   // Global realtime executor bitflag variable for state management. See EXEC bitmasks.
@@ -254,11 +294,36 @@ void system_execute_startup(char *line);
 
 void system_flag_wco_change();
 
+#ifdef ENABLE_WCO_MOTION_SYNC
+// Called by the planner for each new block, returns the work coordinate offset changed since the previous block or NULL.
+float *system_wco_attach (void);
+
+// Sets the work coordinate offset to be reported, called from the stepper ISR when a block with a changed offset starts.
+void system_wco_execute (float *wco);
+
+// Copies the work coordinate offset of the motion being executed, returns true when changed since the last call.
+bool system_get_wco (float *wco);
+
+// Discards queued work coordinate offsets and reports the parser offsets from now on. Called on reset.
+void system_wco_reset (void);
+#endif
+
 // Returns machine position of axis 'idx'. Must be sent a 'step' array.
 //float system_convert_axis_steps_to_mpos(int32_t *steps, uint_fast8_t idx);
 
 // Updates a machine 'position' array based on the 'step' array sent.
 void system_convert_array_steps_to_mpos(float *position, int32_t *steps);
+void system_get_position (int32_t (*position)[N_AXIS]);
+
+// Computes the soft limits envelope from the max travel and homing settings.
+void system_init_travel_limits (void);
+
+#ifdef ENABLE_ROTARY_WRAP
+// Wraps the rotary axes positions to 0 - 360 degrees for reporting.
+void system_wrap_rotary_axes (float *position);
+// Folds the rotary axes step counts into a single revolution when idle.
+void system_fold_rotary_position (void);
+#endif
 
 // Checks and reports if target array exceeds machine travel limits.
 bool system_check_travel_limits(float *target);
@@ -266,12 +331,56 @@ bool system_check_travel_limits(float *target);
 // Checks and limit jog commands to within machine travel limits.
 void system_apply_jog_limits (float *target);
 
+// Atomic bit operations on the real-time execution flags, inlined if the compiler provides lock-free atomics.
+// Otherwise the driver provided HAL functions are called.
+#ifdef INLINE_ATOMICS
+
+static inline void system_bits_set_atomic (volatile uint_fast16_t *value, uint_fast16_t bits)
+{
+    __atomic_fetch_or(value, bits, __ATOMIC_SEQ_CST);
+}
+
+static inline uint_fast16_t system_bits_clear_atomic (volatile uint_fast16_t *value, uint_fast16_t bits)
+{
+    return __atomic_fetch_and(value, ~bits, __ATOMIC_SEQ_CST);
+}
+
+static inline uint_fast16_t system_value_set_atomic (volatile uint_fast16_t *value, uint_fast16_t new_value)
+{
+    return __atomic_exchange_n(value, new_value, __ATOMIC_SEQ_CST);
+}
+
+#else
+#define system_bits_set_atomic(value, bits) hal.set_bits_atomic(value, bits)
+#define system_bits_clear_atomic(value, bits) hal.clear_bits_atomic(value, bits)
+#define system_value_set_atomic(value, new_value) hal.set_value_atomic(value, new_value)
+#endif
+
+#ifdef ENABLE_IDLE_WAIT
+#define system_idle_wake() (hal.idle_wake ? hal.idle_wake() : (void)0)
+#else
+#define system_idle_wake()
+#endif
+
 // Special handlers for setting and clearing Grbl's real-time execution flags.
-#define system_set_exec_state_flag(mask) hal.set_bits_atomic(&sys_rt_exec_state, (mask))
-#define system_clear_exec_state_flag(mask) hal.clear_bits_atomic(&sys_rt_exec_state, (mask))
-#define system_clear_exec_states() hal.set_value_atomic(&sys_rt_exec_state, 0)
-#define system_set_exec_alarm(code) hal.set_value_atomic(&sys_rt_exec_alarm, (uint_fast16_t)(code))
-#define system_clear_exec_alarm() hal.set_value_atomic(&sys_rt_exec_alarm, 0)
+#ifdef ENABLE_IDLE_WAIT
+#define system_set_exec_state_flag(mask) (system_bits_set_atomic(&sys_rt_exec_state, (mask)), system_idle_wake())
+#else
+#define system_set_exec_state_flag(mask) system_bits_set_atomic(&sys_rt_exec_state, (mask))
+#endif
+#ifdef ENABLE_REALTIME_DISPATCH
+#define system_pend_realtime() { if(hal.pend_realtime) hal.pend_realtime(); }
+#else
+#define system_pend_realtime()
+#endif
+#define system_clear_exec_state_flag(mask) system_bits_clear_atomic(&sys_rt_exec_state, (mask))
+#define system_clear_exec_states() system_value_set_atomic(&sys_rt_exec_state, 0)
+#ifdef ENABLE_IDLE_WAIT
+#define system_set_exec_alarm(code) (system_value_set_atomic(&sys_rt_exec_alarm, (uint_fast16_t)(code)), system_idle_wake())
+#else
+#define system_set_exec_alarm(code) system_value_set_atomic(&sys_rt_exec_alarm, (uint_fast16_t)(code))
+#endif
+#define system_clear_exec_alarm() system_value_set_atomic(&sys_rt_exec_alarm, 0)
 
 void control_interrupt_handler (control_signals_t signals);
 
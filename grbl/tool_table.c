@@ -0,0 +1,310 @@
+/*
+  tool_table.c - sparse tool table with a RAM cache of recently used tools
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#if defined(N_TOOLS) && defined(ENABLE_SPARSE_TOOL_TABLE)
+
+/*
+  The default tool table reserves a storage slot and a RAM entry for each of the N_TOOLS tools. Here only tools
+  with a non-zero offset or radius are stored, and only the TOOL_TABLE_CACHE_SIZE most recently used tools are
+  held in RAM. Cached tools are looked up by a hash of the tool number with a chain of entries per bucket, a tool
+  not cached is read on first use, e.g. when the T word is executed, so the M6 that follows does not wait for storage.
+
+  Storage is provided by the driver through hal.tool_read() and hal.tool_write(), e.g. a file on the SD card, or
+  else as TOOL_TABLE_RECORDS records in persistent storage tagged with the tool number. The record tags are read
+  on first use and kept sorted by tool number for a binary search. Entries are written through to storage when
+  changed, a cache entry may thus always be replaced.
+*/
+
+#define RECORD_ADDR(n) (EEPROM_ADDR_TOOL_TABLE + (n) * (sizeof(tool_data_t) + EEPROM_CHECKSUM_SIZE))
+
+// Number of hash buckets, a power of two of at least twice the number of cache entries.
+#if TOOL_TABLE_CACHE_SIZE <= 4
+#define CACHE_BUCKETS 8
+#elif TOOL_TABLE_CACHE_SIZE <= 8
+#define CACHE_BUCKETS 16
+#elif TOOL_TABLE_CACHE_SIZE <= 16
+#define CACHE_BUCKETS 32
+#elif TOOL_TABLE_CACHE_SIZE <= 32
+#define CACHE_BUCKETS 64
+#elif TOOL_TABLE_CACHE_SIZE <= 64
+#define CACHE_BUCKETS 128
+#elif TOOL_TABLE_CACHE_SIZE <= 128
+#define CACHE_BUCKETS 256
+#else
+#define CACHE_BUCKETS 512
+#endif
+
+#define CACHE_BUCKET(tool) ((tool) & (CACHE_BUCKETS - 1))
+
+typedef struct {
+    tool_data_t data;
+    bool stored;        // Tool has a storage record.
+    uint8_t next;       // Next entry + 1 in the hash bucket chain, 0 if last.
+    uint32_t used;      // Use count at last lookup, the entry with the lowest is replaced.
+} tool_entry_t;
+
+typedef struct {
+    tool_id_t tool;     // Tool number, 0 if the record is free.
+    uint8_t record;     // Storage record number.
+} record_tag_t;
+
+static tool_entry_t cache[TOOL_TABLE_CACHE_SIZE];
+static uint8_t bucket[CACHE_BUCKETS];               // First cache entry + 1 by tool number hash, 0 if none.
+static record_tag_t record_tag[TOOL_TABLE_RECORDS]; // Storage record tags sorted by tool number, free records first.
+static bool records_indexed = false;
+static uint32_t use_count = 0;
+
+static bool is_empty (tool_data_t *tool_data)
+{
+    uint_fast8_t idx = N_AXIS;
+
+    if(tool_data->radius != 0.0f)
+        return false;
+
+    do {
+        if(tool_data->offset[--idx] != 0.0f)
+            return false;
+    } while(idx);
+
+    return true;
+}
+
+// Returns the cache entry for a tool, NULL if not cached.
+static tool_entry_t *cache_find (tool_id_t tool)
+{
+    uint_fast8_t entry = bucket[CACHE_BUCKET(tool)];
+
+    while(entry && cache[entry - 1].data.tool != tool)
+        entry = cache[entry - 1].next;
+
+    return entry ? &cache[entry - 1] : NULL;
+}
+
+static void cache_link (uint_fast8_t entry)
+{
+    uint8_t *link = &bucket[CACHE_BUCKET(cache[entry].data.tool)];
+
+    cache[entry].next = *link;
+    *link = entry + 1;
+}
+
+static void cache_unlink (uint_fast8_t entry)
+{
+    uint8_t *link = &bucket[CACHE_BUCKET(cache[entry].data.tool)];
+
+    while(*link && *link != entry + 1)
+        link = &cache[*link - 1].next;
+
+    if(*link)
+        *link = cache[entry].next;
+}
+
+static void index_records (void)
+{
+    uint_fast8_t idx, pos;
+    tool_data_t tool_data;
+    record_tag_t tag;
+
+    // Tag the records and insertion sort them by tool number.
+    for(idx = 0; idx < TOOL_TABLE_RECORDS; idx++) {
+        tag.record = idx;
+        if(hal.eeprom.type != EEPROM_None && hal.eeprom.memcpy_from_with_checksum((uint8_t *)&tool_data, RECORD_ADDR(idx), sizeof(tool_data_t)))
+            tag.tool = tool_data.tool <= N_TOOLS ? tool_data.tool : 0;
+        else
+            tag.tool = 0;
+        for(pos = idx; pos && record_tag[pos - 1].tool > tag.tool; pos--)
+            record_tag[pos] = record_tag[pos - 1];
+        record_tag[pos] = tag;
+    }
+
+    records_indexed = true;
+}
+
+// Returns the tag index of the record for a tool, or of a free record for tool 0. Returns -1 if not found.
+static int_fast16_t find_record (tool_id_t tool)
+{
+    int_fast16_t low = 0, high = TOOL_TABLE_RECORDS - 1, mid;
+
+    if(!records_indexed)
+        index_records();
+
+    while(low <= high) {
+        mid = (low + high) >> 1;
+        if(record_tag[mid].tool == tool)
+            return mid;
+        if(record_tag[mid].tool < tool)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+
+    return -1;
+}
+
+// Changes the tool number of a record tag and moves the tag to keep the tags sorted.
+static void retag_record (int_fast16_t idx, tool_id_t tool)
+{
+    record_tag_t tag = { .tool = tool, .record = record_tag[idx].record };
+
+    for(; idx && record_tag[idx - 1].tool > tool; idx--)
+        record_tag[idx] = record_tag[idx - 1];
+
+    for(; idx < TOOL_TABLE_RECORDS - 1 && record_tag[idx + 1].tool < tool; idx++)
+        record_tag[idx] = record_tag[idx + 1];
+
+    record_tag[idx] = tag;
+}
+
+// Reads a tool from storage, the entry is cleared if not stored.
+static bool storage_read (tool_id_t tool, tool_data_t *tool_data)
+{
+    bool ok;
+    int_fast16_t idx;
+
+    if(hal.tool_read)
+        ok = hal.tool_read(tool, tool_data) && tool_data->tool == tool;
+    else
+        ok = (idx = find_record(tool)) >= 0 &&
+              hal.eeprom.memcpy_from_with_checksum((uint8_t *)tool_data, RECORD_ADDR(record_tag[idx].record), sizeof(tool_data_t)) &&
+               tool_data->tool == tool;
+
+    if(!ok) {
+        memset(tool_data, 0, sizeof(tool_data_t));
+        tool_data->tool = tool;
+    }
+
+    return ok;
+}
+
+tool_data_t *tool_table_get (tool_id_t tool)
+{
+    uint_fast8_t idx, entry;
+    tool_entry_t *cached;
+
+    if(tool == 0 || tool > N_TOOLS)
+        return &tool_table;
+
+    if((cached = cache_find(tool)) == NULL) {
+
+        // Replace the least recently used entry, the current tool is referenced by the parser state.
+        for(idx = 0, entry = TOOL_TABLE_CACHE_SIZE; idx < TOOL_TABLE_CACHE_SIZE; idx++) {
+            if(&cache[idx].data != gc_state.tool && (entry == TOOL_TABLE_CACHE_SIZE || cache[idx].used < cache[entry].used))
+                entry = idx;
+        }
+
+        if(cache[entry].data.tool)
+            cache_unlink(entry);
+
+        cache[entry].stored = storage_read(tool, &cache[entry].data);
+        cache_link(entry);
+        cached = &cache[entry];
+    }
+
+    cached->used = ++use_count;
+
+    return &cached->data;
+}
+
+bool tool_table_read (tool_id_t tool, tool_data_t *tool_data)
+{
+    tool_entry_t *cached;
+
+    if(tool == 0 || tool > N_TOOLS) {
+        memset(tool_data, 0, sizeof(tool_data_t));
+        tool_data->tool = tool;
+        return false;
+    }
+
+    if((cached = cache_find(tool))) {
+        memcpy(tool_data, &cached->data, sizeof(tool_data_t));
+        return cached->stored;
+    }
+
+    return storage_read(tool, tool_data);
+}
+
+bool tool_table_write (tool_data_t *tool_data)
+{
+    bool ok = true, empty = is_empty(tool_data);
+    int_fast16_t idx;
+    tool_entry_t *cached;
+
+    if(tool_data->tool == 0 || tool_data->tool > N_TOOLS)
+        return false;
+
+    if(hal.tool_write)
+        ok = hal.tool_write(tool_data);
+
+    else if((idx = find_record(tool_data->tool)) >= 0 || (!empty && (idx = find_record(0)) >= 0)) {
+        uint_fast8_t record = record_tag[idx].record;
+        if(empty) {
+            tool_data_t free_record = {0};
+            retag_record(idx, 0);
+            if(hal.eeprom.type != EEPROM_None)
+                hal.eeprom.memcpy_to_with_checksum(RECORD_ADDR(record), (uint8_t *)&free_record, sizeof(tool_data_t));
+        } else {
+            retag_record(idx, tool_data->tool);
+            if(hal.eeprom.type != EEPROM_None)
+                hal.eeprom.memcpy_to_with_checksum(RECORD_ADDR(record), (uint8_t *)tool_data, sizeof(tool_data_t));
+        }
+    } else
+        ok = empty; // Nothing to store or no free record.
+
+    if(ok && (cached = cache_find(tool_data->tool))) {
+        if(&cached->data != tool_data)
+            memcpy(&cached->data, tool_data, sizeof(tool_data_t));
+        cached->stored = !empty;
+    }
+
+    return ok;
+}
+
+void tool_table_restore (void)
+{
+    uint_fast8_t idx;
+    tool_data_t free_record = {0};
+
+    // Drop cached entries, except for the current tool.
+    for(idx = 0; idx < TOOL_TABLE_CACHE_SIZE; idx++) {
+        if(&cache[idx].data != gc_state.tool && cache[idx].data.tool) {
+            cache_unlink(idx);
+            cache[idx].data.tool = 0;
+        }
+    }
+
+    if(hal.tool_write) {
+        uint32_t tool;
+        for(tool = 1; tool <= N_TOOLS; tool++) {
+            free_record.tool = (tool_id_t)tool;
+            hal.tool_write(&free_record);
+        }
+    } else for(idx = 0; idx < TOOL_TABLE_RECORDS; idx++) {
+        record_tag[idx].tool = 0;
+        record_tag[idx].record = idx;
+        if(hal.eeprom.type != EEPROM_None)
+            hal.eeprom.memcpy_to_with_checksum(RECORD_ADDR(idx), (uint8_t *)&free_record, sizeof(tool_data_t));
+    }
+
+    records_indexed = true;
+}
+
+#endif
@@ -0,0 +1,65 @@
+/*
+  tool_table.h - sparse tool table with a RAM cache of recently used tools
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _TOOL_TABLE_H_
+#define _TOOL_TABLE_H_
+
+#if defined(N_TOOLS) && defined(ENABLE_SPARSE_TOOL_TABLE)
+
+#if N_TOOLS > 65535
+#error N_TOOLS is limited to 65535 by the 16-bit tool number!
+#endif
+
+// Number of tools kept in RAM, each takes the size of a tool table entry plus 8 bytes and 1 or 2 bytes for the hash.
+#ifndef TOOL_TABLE_CACHE_SIZE
+  #define TOOL_TABLE_CACHE_SIZE 8
+#endif
+
+#if TOOL_TABLE_CACHE_SIZE < 2 || TOOL_TABLE_CACHE_SIZE > 255
+#error TOOL_TABLE_CACHE_SIZE must be in the range 2 - 255!
+#endif
+
+// Number of tool records in persistent storage, only tools with a non-zero offset or radius take a record.
+// Not used when the driver provides hal.tool_read() and hal.tool_write().
+#ifndef TOOL_TABLE_RECORDS
+  #define TOOL_TABLE_RECORDS 8
+#endif
+
+#if TOOL_TABLE_RECORDS < 1 || TOOL_TABLE_RECORDS > 255
+#error TOOL_TABLE_RECORDS must be in the range 1 - 255!
+#endif
+
+// Returns the cached entry for a tool, the entry is read from storage when not cached. The least recently used entry
+// is replaced, except the entry for the current tool. Tool 0 and tools above N_TOOLS return the non-persistent entry.
+tool_data_t *tool_table_get (tool_id_t tool);
+
+// Copies the entry for a tool without caching it, returns false if the tool is not stored.
+bool tool_table_read (tool_id_t tool, tool_data_t *tool_data);
+
+// Writes an entry to storage and updates the cache, an entry with all values zero frees its record.
+// Returns false if no record is free.
+bool tool_table_write (tool_data_t *tool_data);
+
+// Frees all records in persistent storage, called when the settings are restored.
+void tool_table_restore (void);
+
+#endif
+
+#endif
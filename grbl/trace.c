@@ -0,0 +1,129 @@
+/*
+  trace.c - motion trace ring buffer, one record per step segment executed
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_MOTION_TRACE
+
+/*
+  The stepper interrupt adds a record to the ring buffer each time it loads a step segment, the last
+  MOTION_TRACE_SIZE segments executed are thus kept in RAM. Recording costs a few stores per segment.
+
+  Recording is suspended when an alarm is raised so that the records leading up to it are kept
+  until cleared by $TRACE=0, and while the records are output.
+
+  $TRACE outputs the records, oldest first:
+
+    [TRACE:<records>,<timestamp frequency in Hz>]
+    [TR:<timestamp>,<segment id>,<cycles per tick>,<steps>,<AMASS level>,<spindle>,<line number>,<flags>]
+
+  <flags> is a bitmask where bit 0 = first segment of a block, 1 = spindle speed updated. <spindle> is the PWM
+  value if the driver supports direct PWM updates (SPINDLE_PWM_DIRECT), else the RPM.
+*/
+
+static trace_record_t trace[MOTION_TRACE_SIZE];
+static volatile uint32_t head = 0;      // Number of records added since cleared
+static volatile bool suspended = false;
+
+ISR_CODE void trace_segment (segment_t *segment, st_block_t *block, bool new_block)
+{
+    if(suspended || (suspended = !!sys_rt_exec_alarm))
+        return;
+
+    trace_record_t *record = &trace[head & (MOTION_TRACE_SIZE - 1)];
+
+    record->timestamp = hal.get_cycle_count ? hal.get_cycle_count() : (hal.get_elapsed_ticks ? hal.get_elapsed_ticks() : 0);
+    record->cycles_per_tick = segment->cycles_per_tick;
+    record->line_number = block->line_number;
+    record->n_step = (uint16_t)segment->n_step;
+#ifdef SPINDLE_PWM_DIRECT
+    record->spindle = (uint16_t)segment->spindle_pwm;
+#else
+    record->spindle = segment->spindle_rpm > 65535.0f ? 65535 : (uint16_t)segment->spindle_rpm;
+#endif
+    record->segment_id = (uint8_t)segment->id;
+    record->amass_level = (uint8_t)segment->amass_level;
+    record->flags.value = 0;
+    record->flags.new_block = new_block;
+    record->flags.update_rpm = segment->update_rpm;
+
+    head++;
+}
+
+static void trace_report (void)
+{
+    bool was_suspended = suspended;
+    uint32_t idx, count;
+
+    suspended = true; // Keep the buffer from being updated while output
+
+    count = head > MOTION_TRACE_SIZE ? MOTION_TRACE_SIZE : head;
+
+    hal.stream.write("[TRACE:");
+    hal.stream.write(uitoa(count));
+    hal.stream.write(",");
+    hal.stream.write(uitoa(hal.get_cycle_count ? hal.f_cycle_counter : (hal.get_elapsed_ticks ? 1000 : 0)));
+    hal.stream.write("]" ASCII_EOL);
+
+    for(idx = head - count; idx != head; idx++) {
+
+        trace_record_t *record = &trace[idx & (MOTION_TRACE_SIZE - 1)];
+
+        hal.stream.write("[TR:");
+        hal.stream.write(uitoa(record->timestamp));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(record->segment_id));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(record->cycles_per_tick));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(record->n_step));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(record->amass_level));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(record->spindle));
+        hal.stream.write(",");
+        if(record->line_number < 0)
+            hal.stream.write("-");
+        hal.stream.write(uitoa((uint32_t)(record->line_number < 0 ? -record->line_number : record->line_number)));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(record->flags.value));
+        hal.stream.write("]" ASCII_EOL);
+    }
+
+    suspended = was_suspended;
+}
+
+status_code_t trace_command (char *args)
+{
+    status_code_t retval = Status_OK;
+
+    if(*args == '\0')
+        trace_report();
+    else if(!strcmp(args, "=0")) {
+        suspended = true;
+        head = 0;
+        suspended = false;
+    } else
+        retval = Status_InvalidStatement;
+
+    return retval;
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+  trace.h - motion trace ring buffer, one record per step segment executed
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#ifdef ENABLE_MOTION_TRACE
+
+// Number of records kept, must be a power of 2. Each record takes 20 bytes of RAM.
+#ifndef MOTION_TRACE_SIZE
+  #define MOTION_TRACE_SIZE 256
+#endif
+
+#if MOTION_TRACE_SIZE < 2 || (MOTION_TRACE_SIZE & (MOTION_TRACE_SIZE - 1))
+#error "MOTION_TRACE_SIZE must be a power of 2!"
+#endif
+
+typedef union {
+    uint8_t value;
+    struct {
+        uint8_t new_block  :1,
+                update_rpm :1,
+                unused     :6;
+    };
+} trace_flags_t;
+
+typedef struct {
+    uint32_t timestamp;         // Cycle counter, milliseconds if the driver does not provide one
+    uint32_t cycles_per_tick;   // Step timer period of the segment
+    int32_t line_number;        // Line number of the block the segment belongs to
+    uint16_t n_step;            // Number of step events in the segment, AMASS scaled
+    uint16_t spindle;           // Spindle PWM value, or RPM if the driver does not set the PWM value directly
+    uint8_t segment_id;         // Segment buffer entry id
+    uint8_t amass_level;
+    trace_flags_t flags;
+} trace_record_t;
+
+// Adds a record for a step segment loaded for execution, called from the stepper interrupt.
+void trace_segment (segment_t *segment, st_block_t *block, bool new_block);
+
+// Handles $TRACE and $TRACE=0, outputs or clears the records.
+status_code_t trace_command (char *args);
+
+#endif
+
+#endif
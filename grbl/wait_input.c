@@ -0,0 +1,160 @@
+/*
+  wait_input.c - M66 wait on input as a planner synchronized barrier
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef ENABLE_WAIT_ON_INPUT_ASYNC
+
+/*
+  M66 does not block the parser. The wait is queued as a barrier and the first planner block after it is
+  flagged with condition.wait_on_input, the planner plans a stop before that block and the segment generator
+  does not load it while the barrier is pending. The parser keeps planning the blocks after the barrier.
+
+  When the motion before the barrier has completed, the cycle has ended and the machine is Idle, the input
+  is polled from protocol_execute_realtime() with hal.port.wait_on_input() in WaitMode_Immediate mode. When
+  the condition is met, or the Q word timeout has elapsed, the barrier is resolved and the cycle is restarted.
+  Realtime reports, feed hold and reset are serviced while waiting. Edges are detected by polling so pulses
+  shorter than the main loop period may be missed.
+*/
+
+static struct {
+    bool pending;       // Barrier queued and not resolved.
+    bool attached;      // A planner block waits on the barrier.
+    bool reached;       // Motion before the barrier has completed, the input is being polled.
+    bool digital;
+    uint8_t port;
+    wait_mode_t mode;
+    uint32_t timeout;   // ms
+    uint32_t started;   // ms
+    int32_t value;      // Input value at last poll.
+    int32_t result;     // Input value when resolved, -1 on timeout.
+} wait = {0};
+
+bool wait_input_queue (bool digital, uint8_t port, wait_mode_t wait_mode, float timeout)
+{
+    // Lines held back by motion control precede the barrier.
+    if(!mc_canned_flush())
+        return false;
+#ifdef MC_LINE_HOLD
+    if(!mc_line_flush())
+        return false;
+#endif
+
+    if(wait.pending && !protocol_buffer_synchronize())
+        return false;
+
+    wait.digital = digital;
+    wait.port = port;
+    wait.mode = wait_mode;
+    wait.timeout = (uint32_t)(timeout * 1000.0f);
+    wait.attached = wait.reached = false;
+    wait.result = -1;
+    wait.pending = true;
+
+    return true;
+}
+
+bool wait_input_attach (void)
+{
+    bool attach = wait.pending && !wait.attached;
+
+    if(attach)
+        wait.attached = true;
+
+    return attach;
+}
+
+bool wait_input_pending (void)
+{
+    return wait.pending;
+}
+
+void wait_input_poll (void)
+{
+    if(!wait.pending)
+        return;
+
+    bool resolved = false;
+    int32_t value;
+
+    if(!wait.reached) {
+        plan_block_t *block = plan_get_current_block();
+        // The barrier is reached when the cycle has ended and the next block, if any, is the one waiting on it.
+        if(sys.state != STATE_IDLE || (wait.attached ? (block == NULL || !block->condition.wait_on_input) : block != NULL))
+            return;
+        wait.reached = true;
+        wait.started = hal.get_elapsed_ticks();
+        wait.value = hal.port.wait_on_input(wait.digital, wait.port, WaitMode_Immediate, 0.0f);
+    }
+
+    value = hal.port.wait_on_input(wait.digital, wait.port, WaitMode_Immediate, 0.0f);
+
+    switch(wait.mode) {
+
+        case WaitMode_Rise:
+            resolved = wait.value == 0 && value == 1;
+            break;
+
+        case WaitMode_Fall:
+            resolved = wait.value == 1 && value == 0;
+            break;
+
+        case WaitMode_High:
+            resolved = value == 1;
+            break;
+
+        case WaitMode_Low:
+            resolved = value == 0;
+            break;
+
+        default:
+            resolved = true;
+            break;
+    }
+
+    wait.value = value;
+
+    if(resolved)
+        wait.result = value;
+    else
+        resolved = hal.get_elapsed_ticks() - wait.started >= wait.timeout;
+
+    if(resolved) {
+        wait.pending = false;
+        if(sys.state == STATE_IDLE && plan_get_current_block())
+            system_set_exec_state_flag(EXEC_CYCLE_START); // Resume motion queued after the barrier.
+    }
+}
+
+int32_t wait_input_result (void)
+{
+    if(wait.pending)
+        protocol_buffer_synchronize();
+
+    return wait.result;
+}
+
+void wait_input_reset (void)
+{
+    wait.pending = false;
+    wait.result = -1;
+}
+
+#endif
@@ -0,0 +1,48 @@
+/*
+  wait_input.h - M66 wait on input as a planner synchronized barrier
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _WAIT_INPUT_H_
+#define _WAIT_INPUT_H_
+
+#ifdef ENABLE_WAIT_ON_INPUT_ASYNC
+
+// Queues a wait on input barrier, motion queued after it starts when the input condition is met or the wait times out.
+// Waits for a previous barrier to be resolved first. Returns false if a system abort occured.
+bool wait_input_queue (bool digital, uint8_t port, wait_mode_t wait_mode, float timeout);
+
+// Called by the planner for each new block, returns true for the first block after a barrier.
+bool wait_input_attach (void);
+
+// Returns true while a barrier is not resolved.
+bool wait_input_pending (void);
+
+// Checks if the motion before the barrier has completed and then if the input condition is met or the wait has timed out.
+// Called from protocol_execute_realtime().
+void wait_input_poll (void);
+
+// Returns the outcome of the last wait, the input value or -1 on timeout. Waits for a pending barrier to be resolved.
+int32_t wait_input_result (void);
+
+// Discards any pending barrier, called on reset.
+void wait_input_reset (void);
+
+#endif
+
+#endif
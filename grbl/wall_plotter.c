@@ -29,7 +29,6 @@
 
 #define A_MOTOR X_AXIS // Must be X_AXIS
 #define B_MOTOR Y_AXIS // Must be Y_AXIS
-#define MAX_SEG_LENGTH_MM 2.0f
 
 typedef struct {
     int32_t width;
@@ -40,6 +39,7 @@ typedef struct {
     int32_t height_2;
     int32_t spindlezero[2];
     float spindlezero_mm[2];
+    float motor[2][2];
 } machine_t;
 
 typedef struct {
@@ -91,62 +91,12 @@ static void wp_plan_target_to_steps (int32_t *target_steps, float *target)
     target_steps[B_MOTOR] = wp_convert_to_b_motor_steps(target);
 }
 
-// Wall plotter is circular in motion, so long lines must be divided up
-static bool wp_segment_line (float *target, plan_line_data_t *pl_data, bool init)
+// Wall plotter is circular in motion, provide the deviation for segmentation of lines
+static float wp_segment_error (float *start, float *end)
 {
-    static uint_fast16_t iterations;
-    static bool segmented;
-    static float delta[N_AXIS], segment_target[N_AXIS];
-//    static plan_line_data_t plan;
-
-    uint_fast8_t idx = N_AXIS;
-
-    if(init) {
-
-        float max_delta = 0.0f;
-
-        do {
-            idx--;
-            delta[idx] = target[idx] - gc_state.position[idx];
-            max_delta = max(max_delta, fabsf(delta[idx]));
-        } while(idx);
-
-        if((segmented = !(pl_data->condition.rapid_motion || pl_data->condition.jog_motion) &&
-                           max_delta > MAX_SEG_LENGTH_MM && !(delta[X_AXIS] == 0.0f && delta[Y_AXIS] == 0.0f))) {
-
-            idx = N_AXIS;
-            iterations = (uint_fast16_t)ceilf(max_delta / MAX_SEG_LENGTH_MM);
-
-            memcpy(segment_target, gc_state.position, sizeof(segment_target));
-//            memcpy(&plan, pl_data, sizeof(plan_line_data_t));
-
-            do {
-                delta[--idx] /= (float)iterations;
-                target[idx] = gc_state.position[idx];
-            } while(idx);
-
-        } else
-            iterations = 1;
-
-        iterations++; // return at least one iteration
-
-    } else {
-
-        iterations--;
-
-        if(segmented && iterations) do {
-            idx--;
-            segment_target[idx] += delta[idx];
-            target[idx] = segment_target[idx];
-//            memcpy(pl_data, &plan, sizeof(plan_line_data_t));
-        } while(idx);
-
-    }
-
-    return iterations != 0;
+    return kinematics_cable_error(machine.motor[A_MOTOR], machine.motor[B_MOTOR], start, end);
 }
 
-
 static uint_fast8_t wp_limits_get_axis_mask (uint_fast8_t idx)
 {
     return ((idx == A_MOTOR) || (idx == B_MOTOR)) ? (bit(X_AXIS) | bit(Y_AXIS)) : bit(idx);
@@ -243,6 +193,8 @@ void wall_plotter_init (void)
     machine.spindlezero_mm[A_MOTOR] = (float)machine.spindlezero[A_MOTOR] / settings.steps_per_mm[A_MOTOR];
     machine.spindlezero_mm[B_MOTOR] = (float)machine.spindlezero[B_MOTOR] / settings.steps_per_mm[B_MOTOR];
 
+    machine.motor[B_MOTOR][X_AXIS] = machine.width_mm;
+
     sys_position[B_MOTOR] = machine.width;
 
     kinematics.limits_set_target_pos = wp_limits_set_target_pos;
@@ -250,7 +202,8 @@ void wall_plotter_init (void)
     kinematics.limits_set_machine_positions = wp_limits_set_machine_positions;
     kinematics.plan_target_to_steps = wp_plan_target_to_steps;
     kinematics.convert_array_steps_to_mpos = wp_convert_array_steps_to_mpos;
-    kinematics.segment_line = wp_segment_line;
+    kinematics.segment_line = kinematics_segment_line;
+    kinematics.segment_error = wp_segment_error;
 }
 
 #endif
@@ -170,6 +170,84 @@ static char *strrepl (char *str, int c, char *str3)
     return str;
 }
 
+#ifdef ENABLE_JOG_CONTINUOUS
+
+// Sets the jog direction for a jog keycode, returns false if not a jog keycode.
+static bool jog_direction (char keycode, float *direction)
+{
+    memset(direction, 0, sizeof(float) * N_AXIS);
+
+    switch(keycode) {
+
+        case JOG_XR:
+            direction[X_AXIS] = 1.0f;
+            break;
+
+        case JOG_XL:
+            direction[X_AXIS] = -1.0f;
+            break;
+
+        case JOG_YF:
+            direction[Y_AXIS] = 1.0f;
+            break;
+
+        case JOG_YB:
+            direction[Y_AXIS] = -1.0f;
+            break;
+
+        case JOG_ZU:
+            direction[Z_AXIS] = 1.0f;
+            break;
+
+        case JOG_ZD:
+            direction[Z_AXIS] = -1.0f;
+            break;
+
+        case JOG_XRYF:
+            direction[X_AXIS] = direction[Y_AXIS] = 1.0f;
+            break;
+
+        case JOG_XRYB:
+            direction[X_AXIS] = 1.0f;
+            direction[Y_AXIS] = -1.0f;
+            break;
+
+        case JOG_XLYF:
+            direction[X_AXIS] = -1.0f;
+            direction[Y_AXIS] = 1.0f;
+            break;
+
+        case JOG_XLYB:
+            direction[X_AXIS] = direction[Y_AXIS] = -1.0f;
+            break;
+
+        case JOG_XRZU:
+            direction[X_AXIS] = direction[Z_AXIS] = 1.0f;
+            break;
+
+        case JOG_XRZD:
+            direction[X_AXIS] = 1.0f;
+            direction[Z_AXIS] = -1.0f;
+            break;
+
+        case JOG_XLZU:
+            direction[X_AXIS] = -1.0f;
+            direction[Z_AXIS] = 1.0f;
+            break;
+
+        case JOG_XLZD:
+            direction[X_AXIS] = direction[Z_AXIS] = -1.0f;
+            break;
+
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+#endif
+
 void keypad_process_keypress (uint_fast16_t state)
 {
     bool addedGcode, jogCommand = false;
@@ -178,6 +256,20 @@ void keypad_process_keypress (uint_fast16_t state)
     if(state == STATE_ESTOP)
         return;
 
+#ifdef ENABLE_JOG_CONTINUOUS
+    float direction[N_AXIS];
+
+    // Slow and fast jogging is continuous while the key is held, step jogging is by jog commands.
+    if(keycode && jogMode != JogMode_Step && jog_direction(keycode, direction)) {
+        if(!keyreleased && mc_jog_continuous_start(direction, jogMode == JogMode_Slow ? driver_settings.jog.slow_speed : driver_settings.jog.fast_speed) == Status_OK)
+            jogging = true;
+        return;
+    }
+
+    if(jogging && !keyreleased)
+        mc_jog_continuous_refresh();
+#endif
+
     if(keycode)
       switch(keycode) {
 
@@ -306,6 +398,9 @@ ISR_CODE void keypad_keyclick_handler (bool keydown)
 
     else if(jogging) {
         jogging = false;
+#ifdef ENABLE_JOG_CONTINUOUS
+        mc_jog_continuous_stop();
+#endif
         hal.stream.enqueue_realtime_command(CMD_JOG_CANCEL);
         keybuf_tail = keybuf_head = 0; // flush keycode buffer
     }
@@ -73,46 +73,54 @@ void eepromPutByte (uint32_t addr, uint8_t new_value)
     i2c_eeprom_transfer(&i2c, false);
 }
 
+// Writes are split at page boundaries, the checksum is appended to the data of the page(s) it falls in
+// so that a block that fits in a page is written with a single write cycle.
 void eepromWriteBlockWithChecksum (uint32_t destination, uint8_t *source, uint32_t size)
 {
-    uint32_t remaining = size;
-    uint8_t *target = source;
+    uint8_t page[EEPROM_PAGE_SIZE];
+    uint16_t checksum = calc_checksum(source, size);
+    uint32_t idx, offset = 0, remaining = size > 0 ? size + EEPROM_CHECKSUM_SIZE : 0;
 
     while(remaining > 0) {
         i2c.address = EEPROM_I2C_ADDRESS | (destination >> EEPROM_ADDR_BITS_LO);
         i2c.word_addr = destination & 0xFF;
         i2c.count = EEPROM_PAGE_SIZE - (destination & (EEPROM_PAGE_SIZE - 1));
         i2c.count = remaining < i2c.count ? remaining : i2c.count;
-        i2c.data = target;
+        if(offset + i2c.count <= size)
+            i2c.data = source + offset;
+        else {
+            for(idx = 0; idx < i2c.count; idx++)
+                page[idx] = offset + idx < size ? source[offset + idx] : (uint8_t)(checksum >> ((offset + idx - size) << 3));
+            i2c.data = page;
+        }
         remaining -= i2c.count;
-        target += i2c.count;
+        offset += i2c.count;
         destination += i2c.count;
 
         i2c_eeprom_transfer(&i2c, false);
     }
-
-    if(size > 0)
-        eepromPutByte(destination, calc_checksum(source, size));
 }
 
-bool eepromReadBlockWithChecksum (uint8_t *destination, uint32_t source, uint32_t size)
+void eepromReadBlock (uint8_t *destination, uint32_t source, uint32_t size)
 {
-    uint32_t remaining = size;
-    uint8_t *target = destination;
-
-    while(remaining) {
+    while(size) {
         i2c.address = EEPROM_I2C_ADDRESS | (source >> 8);
         i2c.word_addr = source & 0xFF;
-        i2c.count = remaining > 255 ? 255 : (uint8_t)remaining;
-        i2c.data = target;
-        remaining -= i2c.count;
-        target += i2c.count;
+        i2c.count = size > 255 ? 255 : (uint8_t)size;
+        i2c.data = destination;
+        size -= i2c.count;
+        destination += i2c.count;
         source += i2c.count;
 
         i2c_eeprom_transfer(&i2c, true);
     }
+}
+
+bool eepromReadBlockWithChecksum (uint8_t *destination, uint32_t source, uint32_t size)
+{
+    eepromReadBlock(destination, source, size);
 
-    return calc_checksum(destination, size) == eepromGetByte(source);
+    return calc_checksum(destination, size) == (eepromGetByte(source + size) | (eepromGetByte(source + size + 1) << 8));
 }
 
 #endif
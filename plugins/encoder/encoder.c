@@ -35,7 +35,7 @@
 #include "grbl/plugins.h"
 #endif
 
-static uint32_t position = 0;
+static int32_t position = 0;
 static bool mode_chg = false;
 static encoder_mode_t mode = Encoder_FeedRate;
 
@@ -68,19 +68,36 @@ void encoder_changed (encoder_t *encoder)
         mode = mode == Encoder_FeedRate ? Encoder_Spindle_RPM : Encoder_FeedRate;
     }
 
-	if(encoder->changed.position)
-	  switch(encoder->mode == Encoder_Universal ? mode : encoder->mode) {
+	// Overrides are set as absolute targets, all detents since the last main loop pass are then applied at once.
+	if(encoder->changed.position) {
 
-		case Encoder_FeedRate:
-			hal.stream.enqueue_realtime_command(encoder->position > position ? CMD_OVERRIDE_FEED_FINE_PLUS : CMD_OVERRIDE_FEED_FINE_MINUS);
-			break;
+		int32_t target, delta = encoder->position - position;
 
-		case Encoder_Spindle_RPM:
-			hal.stream.enqueue_realtime_command(encoder->position > position ? CMD_OVERRIDE_SPINDLE_FINE_PLUS : CMD_OVERRIDE_SPINDLE_FINE_MINUS);
-			break;
+		switch(encoder->mode == Encoder_Universal ? mode : encoder->mode) {
 
-		default:
-			break;
+			case Encoder_FeedRate:
+				target = (int32_t)feed_override_target() + delta * FEED_OVERRIDE_FINE_INCREMENT;
+				set_feed_override_target((uint8_t)max(min(target, MAX_FEED_RATE_OVERRIDE), MIN_FEED_RATE_OVERRIDE));
+				break;
+
+			case Encoder_Spindle_RPM:
+				target = (int32_t)spindle_override_target() + delta * SPINDLE_OVERRIDE_FINE_INCREMENT;
+				set_spindle_override_target((uint8_t)max(min(target, MAX_SPINDLE_RPM_OVERRIDE), MIN_SPINDLE_RPM_OVERRIDE));
+				break;
+#ifdef ENABLE_JOG_MPG
+			case Encoder_MPG_X:
+			case Encoder_MPG_Y:
+			case Encoder_MPG_Z:
+			case Encoder_MPG_A:
+			case Encoder_MPG_B:
+			case Encoder_MPG_C:
+				mc_jog_mpg_move(encoder->mode - Encoder_MPG_X, delta);
+				break;
+#endif
+
+			default:
+				break;
+		}
 	}
 
     position = encoder->position;
@@ -0,0 +1,176 @@
+//
+// StreamMux.c - output multiplexer for messages sent to all streams
+//
+// v1.0 / 2020-06-20 / Io Engineering / Terje
+//
+
+/*
+
+Copyright (c) 2020, Terje Io
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+ Neither the name of the copyright holder nor the names of its contributors may
+be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+  Messages written via write_all are assembled into lines and each line is then passed to the
+  transmit buffer of every enabled output. Only the active stream, the stream commands are received
+  from, may block, for other outputs a line is dropped if it does not fit in the transmit buffer.
+  This way a slow or stalled client cannot hold up the main loop while other clients are kept waiting.
+
+  Realtime status reports are never waited for, not even by the active stream. A dropped report is
+  superseded by the next one and a client polling for reports will get one as soon as there is room.
+  Responses to commands (ok and error) are sent via the write entry point of the active stream and
+  are thus not affected.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "driver.h"
+#include "StreamMux.h"
+
+typedef struct {
+    stream_type_t type;
+    bool enabled;
+    bool skip;          // Part of the current line was dropped, drop the rest of it
+    uint32_t dropped;   // Number of lines dropped
+    stream_write_ptr write;
+    uint16_t (*tx_free)(void);
+} mux_output_t;
+
+static struct {
+    uint_fast8_t n_outputs;
+    uint_fast16_t length;
+    bool partial;       // Start of the current line has been passed on
+    char line[STREAM_MUX_LINE_SIZE];
+    mux_output_t output[STREAM_MUX_MAX_OUTPUTS];
+} mux = {0};
+
+static mux_output_t *getOutput (stream_write_ptr write)
+{
+    uint_fast8_t idx = mux.n_outputs;
+
+    while(idx) {
+        if(mux.output[--idx].write == write)
+            return &mux.output[idx];
+    }
+
+    return NULL;
+}
+
+bool StreamMuxAdd (stream_type_t type, stream_write_ptr write, uint16_t (*tx_free)(void))
+{
+    mux_output_t *output;
+
+    if((output = getOutput(write)) == NULL) {
+        if(mux.n_outputs == STREAM_MUX_MAX_OUTPUTS)
+            return false;
+        output = &mux.output[mux.n_outputs++];
+    }
+
+    output->type = type;
+    output->write = write;
+    output->tx_free = tx_free;
+    output->enabled = true;
+    output->skip = false;
+    output->dropped = 0;
+
+    return true;
+}
+
+void StreamMuxEnable (stream_type_t type, bool on)
+{
+    uint_fast8_t idx = mux.n_outputs;
+
+    while(idx) {
+        if(mux.output[--idx].type == type && mux.output[idx].enabled != on) {
+            mux.output[idx].enabled = on;
+            mux.output[idx].skip = false;
+        }
+    }
+}
+
+uint32_t StreamMuxDropped (stream_type_t type)
+{
+    uint_fast8_t idx = mux.n_outputs;
+    uint32_t dropped = 0;
+
+    while(idx) {
+        if(mux.output[--idx].type == type)
+            dropped += mux.output[idx].dropped;
+    }
+
+    return dropped;
+}
+
+// A status report is a complete line, in text or JSON format.
+static inline bool isStatusReport (bool eol)
+{
+    return eol && !mux.partial && (*mux.line == '<' || !strncmp(mux.line, "{\"state\"", 8));
+}
+
+static void dispatchLine (bool eol)
+{
+    bool status = isStatusReport(eol);
+    uint_fast8_t idx = mux.n_outputs;
+    mux_output_t *output;
+
+    mux.line[mux.length] = '\0';
+
+    while(idx) {
+
+        output = &mux.output[--idx];
+
+        if(!output->enabled)
+            continue;
+
+        if(output->skip)
+            output->skip = !eol;
+        else if((output->type == hal.stream.type && !status) || output->tx_free == NULL || output->tx_free() >= mux.length)
+            output->write(mux.line);
+        else {
+            output->skip = !eol;
+            output->dropped++;
+        }
+    }
+
+    mux.length = 0;
+    mux.partial = !eol;
+}
+
+void StreamMuxWriteS (const char *data)
+{
+    char c;
+
+    while((c = *data++)) {
+        mux.line[mux.length++] = c;
+        if(c == ASCII_LF || mux.length == sizeof(mux.line) - 1)
+            dispatchLine(c == ASCII_LF);
+    }
+}
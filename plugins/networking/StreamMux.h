@@ -0,0 +1,59 @@
+//
+// StreamMux.h - output multiplexer for messages sent to all streams
+//
+// v1.0 / 2020-06-20 / Io Engineering / Terje
+//
+
+/*
+
+Copyright (c) 2020, Terje Io
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+ Neither the name of the copyright holder nor the names of its contributors may
+be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef __STREAMMUX_H__
+#define __STREAMMUX_H__
+
+#ifndef STREAM_MUX_MAX_OUTPUTS
+#define STREAM_MUX_MAX_OUTPUTS 4
+#endif
+
+#ifndef STREAM_MUX_LINE_SIZE
+#define STREAM_MUX_LINE_SIZE 256
+#endif
+
+// Registers a stream output, tx_free may be NULL if the free space in the transmit buffer is unknown
+// or the output never blocks. Outputs are registered enabled, several outputs may share a stream type.
+// Outputs that never are the active stream, e.g. read-only observer sessions, use StreamType_Null.
+bool StreamMuxAdd(stream_type_t type, stream_write_ptr write, uint16_t (*tx_free)(void));
+void StreamMuxEnable(stream_type_t type, bool on);
+// To be used as the HAL write_all entry point.
+void StreamMuxWriteS(const char *data);
+uint32_t StreamMuxDropped(stream_type_t type);
+
+#endif
@@ -40,6 +40,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <assert.h>
 
 //#include "driverlib/debug.h"
@@ -51,8 +52,27 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "driver.h"
 #include "TCPStream.h"
+#include "rxbuffer.h"
 
 #define SOCKET_TIMEOUT 0
+
+// Called when data is queued for input, when a line of output is complete and when input waits for
+// room in the input buffer. A driver serving the streams from a task may define this to wake it.
+#ifndef NETWORK_STREAM_NOTIFY
+#define NETWORK_STREAM_NOTIFY()
+#endif
+
+// Max time in ms a partial line is held back in the transmit buffer before being sent.
+#ifndef TCP_STREAM_TX_DELAY
+#define TCP_STREAM_TX_DELAY 5
+#endif
+
+// Set to 0 to keep the Nagle algorithm enabled, transmission is then delayed further by lwIP.
+#ifndef TCP_STREAM_NO_DELAY
+#define TCP_STREAM_NO_DELAY 1
+#endif
+
+#define TCP_STREAM_TX_DELAY_TICKS ((TCP_STREAM_TX_DELAY + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS)
 #define BUFCOUNT(head, tail, size) ((head >= tail) ? (head - tail) : (size - tail + head))
 
 typedef enum
@@ -85,6 +105,9 @@ typedef struct
     uint32_t bufferIndex;
     stream_rx_buffer_t rxbuf;
     stream_tx_buffer_t txbuf;
+    uint_fast16_t txSent;   // Index of first character not yet passed to lwIP, tail is advanced when data is acknowledged
+    bool txWaiting;         // Partial line is held back
+    TickType_t txWaitStart;
     TickType_t lastSendTime;
     err_t lastErr;
     uint8_t errorCount;
@@ -105,6 +128,8 @@ static const sessiondata_t defaultSettings =
     .bufferIndex = 0,
     .rxbuf = {0},
     .txbuf = {0},
+    .txSent = 0,
+    .txWaiting = false,
     .lastSendTime = 0,
     .linkLost = false,
     .connectCount = 0,
@@ -115,6 +140,23 @@ static const sessiondata_t defaultSettings =
 
 static sessiondata_t streamSession;
 
+#if TCP_STREAM_OBSERVERS
+
+// Read-only sessions, receiving output sent to all streams only.
+typedef struct
+{
+    struct tcp_pcb *pcb;
+    bool skip;              // Part of the current line was dropped, drop the rest of it
+    uint32_t dropped;       // Number of lines dropped
+    volatile uint_fast16_t head;
+    volatile uint_fast16_t tail;
+    char data[TCP_OBSERVER_TX_BUFFER_SIZE];
+} observerdata_t;
+
+static observerdata_t observers[TCP_STREAM_OBSERVERS];
+
+#endif
+
 void TCPStreamInit (void)
 {
     memcpy(&streamSession, &defaultSettings, sizeof(sessiondata_t));
@@ -142,9 +184,25 @@ int16_t TCPStreamGetC (void)
     data = streamSession.rxbuf.data[bptr++];                // Get next character, increment tmp pointer
     streamSession.rxbuf.tail = bptr & (RX_BUFFER_SIZE - 1); // and update pointer
 
+    if(data == ASCII_LF && streamSession.pbufHead)          // Input is waiting for room
+        NETWORK_STREAM_NOTIFY();
+
     return data;
 }
 
+//
+// TCPStreamReadBlock - reads up to max characters, ends after the first CR or LF
+//
+uint16_t TCPStreamReadBlock (char *buffer, uint16_t max)
+{
+    uint16_t count = rxbuffer_read_block(&streamSession.rxbuf, buffer, max);
+
+    if(count && buffer[count - 1] == ASCII_LF && streamSession.pbufHead)   // Input is waiting for room
+        NETWORK_STREAM_NOTIFY();
+
+    return count;
+}
+
 inline uint16_t TCPStreamRxCount (void)
 {
     uint_fast16_t head = streamSession.rxbuf.head, tail = streamSession.rxbuf.tail;
@@ -169,28 +227,13 @@ void TCPStreamRxCancel (void)
     streamSession.rxbuf.head = (streamSession.rxbuf.tail + 1) & (RX_BUFFER_SIZE - 1);
 }
 
-static bool streamBufferRX (char c)
-{
-    // discard input if MPG has taken over...
-    if(hal.stream.type != StreamType_MPG) {
-
-        uint_fast16_t bptr = (streamSession.rxbuf.head + 1) & (RX_BUFFER_SIZE - 1); // Get next head pointer
-
-        if(bptr == streamSession.rxbuf.tail)                        // If buffer full
-            streamSession.rxbuf.overflow = true;                    // flag overflow
-        else if(!hal.stream.enqueue_realtime_command(c)) {          // If not a real time command
-            streamSession.rxbuf.data[streamSession.rxbuf.head] = c; // add data to buffer
-            streamSession.rxbuf.head = bptr;                        // and update pointer
-        }
-    }
-
-    return !streamSession.rxbuf.overflow;
-}
-
 bool TCPStreamPutC (const char c)
 {
     uint32_t next_head = (streamSession.txbuf.head + 1) & (TX_BUFFER_SIZE - 1);  // Get and update head pointer
 
+    if(streamSession.txbuf.tail == next_head)
+        NETWORK_STREAM_NOTIFY();
+
     while(streamSession.txbuf.tail == next_head) {                               // Buffer full, block until space is available...
         if(!hal.stream_blocking_callback())
             return false;
@@ -199,6 +242,9 @@ bool TCPStreamPutC (const char c)
     streamSession.txbuf.data[streamSession.txbuf.head] = c;                     // Add data to buffer
     streamSession.txbuf.head = next_head;                                       // and update head pointer
 
+    if(c == ASCII_LF)
+        NETWORK_STREAM_NOTIFY();
+
     return true;
 }
 
@@ -224,6 +270,18 @@ void TCPStreamWrite (const char *data, unsigned int length)
         TCPStreamPutC(*ptr++);
 }
 
+// Copies the data to the transmit buffer in runs rather than character by character.
+void TCPStreamWriteN (const char *data, uint16_t length)
+{
+    bool eol = memchr(data, ASCII_LF, length) != NULL;
+
+    if(length > TCPStreamTxFree())
+        NETWORK_STREAM_NOTIFY();
+
+    if(txbuffer_write_n(&streamSession.txbuf, data, length) && eol)
+        NETWORK_STREAM_NOTIFY();
+}
+
 uint16_t TCPStreamTxCount(void) {
 
     uint_fast16_t head = streamSession.txbuf.head, tail = streamSession.txbuf.tail;
@@ -231,23 +289,23 @@ uint16_t TCPStreamTxCount(void) {
     return BUFCOUNT(head, tail, TX_BUFFER_SIZE);
 }
 
-static int16_t streamReadTXC (void)
+uint16_t TCPStreamTxFree (void)
 {
-    int16_t data;
-    uint_fast16_t bptr = streamSession.txbuf.tail;
-
-    if(bptr == streamSession.txbuf.head)
-        return -1; // no data available else EOF
-
-    data = streamSession.txbuf.data[bptr++];                 // Get next character, increment tmp pointer
-    streamSession.txbuf.tail = bptr & (TX_BUFFER_SIZE - 1);  // and update pointer
-
-    return data;
+    return (TX_BUFFER_SIZE - 1) - TCPStreamTxCount();
 }
 
+// Discards data not yet passed to lwIP, data sent but not acknowledged is still referenced by lwIP.
 void TCPStreamTxFlush (void)
 {
-    streamSession.txbuf.tail = streamSession.txbuf.head;
+    streamSession.txbuf.head = streamSession.txSent;
+    streamSession.txWaiting = false;
+}
+
+// Discards all transmit data, only to be called when the connection is gone.
+static void streamTxReset (sessiondata_t *session)
+{
+    session->txbuf.tail = session->txSent = session->txbuf.head;
+    session->txWaiting = false;
 }
 
 static void streamFreeBuffers (sessiondata_t *session)
@@ -282,6 +340,7 @@ static void streamError (void *arg, err_t err)
     sessiondata_t *session = arg;
 
     streamFreeBuffers(session);
+    streamTxReset(session);
 
     session->state = TCPState_Listen;
     session->errorCount++;
@@ -318,6 +377,7 @@ static void closeSocket (sessiondata_t *session, struct tcp_pcb *pcb)
     tcp_close(pcb);
 
     streamFreeBuffers(session);
+    streamTxReset(session);
 
     session->pcbConnect = NULL;
     session->state = TCPState_Listen;
@@ -348,6 +408,7 @@ static err_t streamReceive (void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_
                 session->rcvHead->pbuf = p;
                 session->rcvHead = session->rcvHead->next;
                 SYS_ARCH_UNPROTECT(lev);
+                NETWORK_STREAM_NOTIFY();
             }
         } else // Null packet received, means close connection
             closeSocket(session, pcb);;
@@ -356,13 +417,147 @@ static err_t streamReceive (void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_
     return ERR_OK;
 }
 
+// Releases acknowledged data from the transmit buffer.
 static err_t streamSent (void *arg, struct tcp_pcb *pcb, u16_t ui16len)
 {
-    ((sessiondata_t *)arg)->timeout = 0;
+    sessiondata_t *session = arg;
+
+    session->timeout = 0;
+    session->txbuf.tail = (session->txbuf.tail + ui16len) & (TX_BUFFER_SIZE - 1);
 
     return ERR_OK;
 }
 
+#if TCP_STREAM_OBSERVERS
+
+static void observerClose (observerdata_t *observer)
+{
+    if(observer->pcb) {
+        tcp_arg(observer->pcb, NULL);
+        tcp_recv(observer->pcb, NULL);
+        tcp_err(observer->pcb, NULL);
+        if(tcp_close(observer->pcb) != ERR_OK)
+            tcp_abort(observer->pcb);
+        observer->pcb = NULL;
+    }
+}
+
+static void observerError (void *arg, err_t err)
+{
+    ((observerdata_t *)arg)->pcb = NULL; // pcb is already freed
+}
+
+// Input from observers is discarded.
+static err_t observerReceive (void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    if(err == ERR_OK) {
+        if(p) {
+            tcp_recved(pcb, p->tot_len);
+            pbuf_free(p);
+        } else // Null packet received, means close connection
+            observerClose((observerdata_t *)arg);
+    }
+
+    return ERR_OK;
+}
+
+static err_t observerAccept (struct tcp_pcb *pcb)
+{
+    uint_fast8_t idx = TCP_STREAM_OBSERVERS;
+    observerdata_t *observer;
+
+    while(idx) {
+        observer = &observers[--idx];
+        if(observer->pcb == NULL) {
+
+            observer->head = observer->tail = 0;
+            observer->skip = false;
+            observer->pcb = pcb;
+
+            tcp_accepted(pcb);
+#if TCP_STREAM_NO_DELAY
+            tcp_nagle_disable(pcb);
+#endif
+            tcp_arg(pcb, observer);
+            tcp_setprio(pcb, TCP_PRIO_MIN);
+            tcp_recv(pcb, observerReceive);
+            tcp_err(pcb, observerError);
+
+            return ERR_OK;
+        }
+    }
+
+    return ERR_CONN; // No free slot, refuse connection
+}
+
+// Copies output to the transmit buffer of each observer, a line that does not fit is dropped.
+// Never blocks, to be registered as a write_all output.
+void TCPStreamWriteObservers (const char *data)
+{
+    uint_fast8_t idx = TCP_STREAM_OBSERVERS;
+    uint_fast16_t length = strlen(data), head, part;
+    bool eol = length && data[length - 1] == ASCII_LF;
+    observerdata_t *observer;
+
+    while(idx) {
+
+        observer = &observers[--idx];
+
+        if(observer->pcb == NULL)
+            continue;
+
+        head = observer->head;
+
+        if(observer->skip)
+            observer->skip = !eol;
+        else if((TCP_OBSERVER_TX_BUFFER_SIZE - 1) - BUFCOUNT(head, observer->tail, TCP_OBSERVER_TX_BUFFER_SIZE) >= length) {
+            if((part = TCP_OBSERVER_TX_BUFFER_SIZE - head) > length)
+                part = length;
+            memcpy(&observer->data[head], data, part);
+            if(length > part)
+                memcpy(observer->data, data + part, length - part);
+            observer->head = (head + length) & (TCP_OBSERVER_TX_BUFFER_SIZE - 1);
+        } else {
+            observer->skip = !eol;
+            observer->dropped++;
+        }
+    }
+}
+
+static void observersPoll (void)
+{
+    uint_fast8_t idx = TCP_STREAM_OBSERVERS;
+    uint_fast16_t head, tail, count;
+    observerdata_t *observer;
+
+    while(idx) {
+
+        observer = &observers[--idx];
+
+        if(observer->pcb == NULL || (head = observer->head) == (tail = observer->tail))
+            continue;
+
+        // Contiguous part only, any remaining data is sent on next poll
+        count = (head > tail ? head : TCP_OBSERVER_TX_BUFFER_SIZE) - tail;
+        if(count > tcp_sndbuf(observer->pcb))
+            count = tcp_sndbuf(observer->pcb);
+
+        if(count && observer->pcb->snd_queuelen < TCP_SND_QUEUELEN - 1 &&
+             tcp_write(observer->pcb, &observer->data[tail], (u16_t)count, TCP_WRITE_FLAG_COPY) == ERR_OK) {
+            observer->tail = (tail + count) & (TCP_OBSERVER_TX_BUFFER_SIZE - 1);
+            tcp_output(observer->pcb);
+        }
+    }
+}
+
+#else
+
+void TCPStreamWriteObservers (const char *data)
+{
+}
+
+#endif
+
 static err_t TCPStreamAccept (void *arg, struct tcp_pcb *pcb, err_t err)
 {
     sessiondata_t *session = arg;
@@ -370,7 +565,11 @@ static err_t TCPStreamAccept (void *arg, struct tcp_pcb *pcb, err_t err)
     if(session->state != TCPState_Listen) {
 
         if(!session->linkLost)
+#if TCP_STREAM_OBSERVERS
+            return observerAccept(pcb); // Busy, connect as observer if possible
+#else
             return ERR_CONN; // Busy, refuse connection
+#endif
 
         // Link was previously lost, abort current connection
 
@@ -387,6 +586,11 @@ static err_t TCPStreamAccept (void *arg, struct tcp_pcb *pcb, err_t err)
     tcp_accepted(pcb);
 
     TCPStreamRxFlush();
+    streamTxReset(session);
+
+#if TCP_STREAM_NO_DELAY
+    tcp_nagle_disable(pcb);
+#endif
 
     session->timeout = 0;
 
@@ -413,6 +617,7 @@ void TCPStreamClose (void)
 
         tcp_abort(streamSession.pcbConnect);
         streamFreeBuffers(&streamSession);
+        streamTxReset(&streamSession);
     }
 
     if(streamSession.pcbListen != NULL) {
@@ -420,6 +625,13 @@ void TCPStreamClose (void)
         streamFreeBuffers(&streamSession);
     }
 
+#if TCP_STREAM_OBSERVERS
+    uint_fast8_t idx = TCP_STREAM_OBSERVERS;
+
+    while(idx)
+        observerClose(&observers[--idx]);
+#endif
+
     streamSession.state = TCPState_Idle;
     streamSession.pcbConnect = streamSession.pcbListen = NULL;
     streamSession.timeout = 0;
@@ -462,7 +674,9 @@ void TCPStreamListen (uint16_t port)
 //
 void TCPStreamPoll (void)
 {
-    static uint8_t tempBuffer[PBUF_POOL_BUFSIZE];
+#if TCP_STREAM_OBSERVERS
+    observersPoll();
+#endif
 
     if(streamSession.state != TCPState_Connected)
         return;
@@ -487,7 +701,10 @@ void TCPStreamPoll (void)
         if(payload == NULL)
             break; // No more data to be processed...
 
-        streamBufferRX(payload[streamSession.bufferIndex++]);
+        uint_fast16_t length = streamSession.pbufCurrent->len - streamSession.bufferIndex,
+                      consumed = rxbuffer_add_block(&streamSession.rxbuf, &payload[streamSession.bufferIndex], length);
+
+        streamSession.bufferIndex += consumed;
 
         if(streamSession.bufferIndex >= streamSession.pbufCurrent->len) {
             streamSession.pbufCurrent = streamSession.pbufCurrent->next;
@@ -502,34 +719,51 @@ void TCPStreamPoll (void)
             streamSession.pbufCurrent = streamSession.pbufHead = NULL;
             streamSession.bufferIndex = 0;
         }
+
+        if(consumed < length)
+            break; // Input buffer full
     }
 
-//    tcp_output(streamSession.pcbConnect);
+    // 2. Process output stream
+    // Data is passed to lwIP by reference, without copying, and released from the buffer when acknowledged.
+    // Complete lines are sent at once, a partial line is held back until it is completed, the buffer is half full
+    // or TCP_STREAM_TX_DELAY ms has elapsed so that consecutive writes are sent as one segment.
+    uint_fast16_t TXCount, length, head = streamSession.txbuf.head, sent = streamSession.txSent;
 
-    int_fast16_t TXCount;
+    if((TXCount = BUFCOUNT(head, sent, TX_BUFFER_SIZE))) {
 
-    // 2. Process output stream
-    if((TXCount = TCPStreamTxCount()) && tcp_sndbuf(streamSession.pcbConnect) && streamSession.pcbConnect->snd_queuelen < TCP_SND_QUEUELEN) {
+        struct tcp_pcb *pcb = streamSession.pcbConnect;
+        TickType_t now = xTaskGetTickCount();
 
-        uint_fast16_t idx;
+        if(!streamSession.txWaiting) {
+            streamSession.txWaiting = true;
+            streamSession.txWaitStart = now;
+        }
 
-        if(TXCount > tcp_sndbuf(streamSession.pcbConnect))
-            TXCount = tcp_sndbuf(streamSession.pcbConnect);
+        if((streamSession.txbuf.data[(head - 1) & (TX_BUFFER_SIZE - 1)] == ASCII_LF ||
+             TXCount >= TX_BUFFER_SIZE / 2 ||
+              (now - streamSession.txWaitStart) >= TCP_STREAM_TX_DELAY_TICKS) &&
+               pcb->snd_queuelen < TCP_SND_QUEUELEN - 1) {
 
-        while(TXCount && streamSession.pcbConnect->snd_queuelen < TCP_SND_QUEUELEN)
-        {
-            idx = 0;
+            if(TXCount > tcp_sndbuf(pcb))
+                TXCount = tcp_sndbuf(pcb);
 
-            while(TXCount && idx < sizeof(tempBuffer)) {
-                tempBuffer[idx] = (uint8_t)streamReadTXC();
-                idx++;
-                TXCount--;
-            }
+            // Data may wrap around the end of the buffer, if so it is sent in two parts.
+            length = TXCount > TX_BUFFER_SIZE - sent ? TX_BUFFER_SIZE - sent : TXCount;
 
-            tcp_write(streamSession.pcbConnect, tempBuffer, (u16_t)idx, 1);
-        }
+            if(length && tcp_write(pcb, &streamSession.txbuf.data[sent], (u16_t)length, length < TXCount ? TCP_WRITE_FLAG_MORE : 0) == ERR_OK) {
+
+                sent = (sent + length) & (TX_BUFFER_SIZE - 1);
+
+                if((TXCount -= length) && tcp_write(pcb, streamSession.txbuf.data, (u16_t)TXCount, 0) == ERR_OK)
+                    sent = TXCount;
 
-        tcp_output(streamSession.pcbConnect);
-        streamSession.lastSendTime = xTaskGetTickCount();
+                streamSession.txSent = sent;
+                streamSession.txWaiting = sent != head;
+
+                tcp_output(pcb);
+                streamSession.lastSendTime = now;
+            }
+        }
     }
 }
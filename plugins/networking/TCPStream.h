@@ -39,17 +39,30 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef __TCPSTREAM_H__
 #define __TCPSTREAM_H__
 
+// Number of read-only sessions accepted when a controlling session is connected, set to 0 to refuse them.
+#ifndef TCP_STREAM_OBSERVERS
+#define TCP_STREAM_OBSERVERS 2
+#endif
+
+#ifndef TCP_OBSERVER_TX_BUFFER_SIZE
+#define TCP_OBSERVER_TX_BUFFER_SIZE 256 // must be a power of 2
+#endif
+
 void TCPStreamInit(void);
 void TCPStreamListen(uint16_t port);
 void TCPStreamClose(void);
 void TCPStreamPoll(void);
 void TCPStreamNotifyLinkStatus(bool bLinkStatusUp);
 int16_t TCPStreamGetC(void);
+uint16_t TCPStreamReadBlock(char *buffer, uint16_t max);
 bool TCPStreamPutC(const char data);
 void TCPStreamWriteS(const char *data);
 void TCPStreamWriteLn(const char *data);
 void TCPStreamWrite(const char *data, unsigned int length);
+void TCPStreamWriteN(const char *data, uint16_t length);
+void TCPStreamWriteObservers(const char *data);
 uint16_t TCPStreamTxCount(void);
+uint16_t TCPStreamTxFree(void);
 uint16_t TCPStreamRxCount(void);
 uint16_t TCPStreamRxFree(void);
 void TCPStreamRxFlush(void);
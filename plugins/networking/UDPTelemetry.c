@@ -0,0 +1,124 @@
+//
+// UDPTelemetry.c - periodic multicast of binary status frames
+//
+// v1.0 / 2020-06-27 / Io Engineering / Terje
+//
+
+/*
+
+Copyright (c) 2020, Terje Io
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+ Neither the name of the copyright holder nor the names of its contributors may
+be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+  Sends a binary status frame, as described in grbl/binary_status.c, in a single UDP datagram
+  to a multicast group at a fixed interval. Listeners just join the group, the controller does the
+  same amount of work regardless of their number and nothing is ever received. The frame sequence
+  number is incremented for each datagram so listeners may detect lost frames, a lost frame is not
+  resent - listeners just wait for the next one.
+
+  Frames are rendered from the lwIP thread, the G-code stream and the active stream are not involved.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "networking.h"
+
+#include "driver.h"
+#include "UDPTelemetry.h"
+
+#ifdef ENABLE_BINARY_STATUS_REPORT
+
+static struct {
+    struct udp_pcb *pcb;
+    ip_addr_t group;
+    uint16_t port;
+    uint16_t sequence;
+    TickType_t period;
+    TickType_t lastSendTime;
+} telemetry = {0};
+
+bool UDPTelemetryStart (const char *group, uint16_t port, uint32_t period)
+{
+    UDPTelemetryStop();
+
+    if(!ipaddr_aton(group, &telemetry.group) || (telemetry.pcb = udp_new()) == NULL)
+        return false;
+
+    telemetry.port = port;
+    telemetry.period = (period + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+    telemetry.lastSendTime = xTaskGetTickCount();
+
+    return true;
+}
+
+void UDPTelemetryStop (void)
+{
+    if(telemetry.pcb) {
+        udp_remove(telemetry.pcb);
+        telemetry.pcb = NULL;
+    }
+}
+
+void UDPTelemetryPoll (void)
+{
+    struct pbuf *p;
+    TickType_t now = xTaskGetTickCount();
+
+    if(telemetry.pcb == NULL || (now - telemetry.lastSendTime) < telemetry.period)
+        return;
+
+    telemetry.lastSendTime = now;
+
+    // Rendered straight into the payload, if no pbuf is available the frame is skipped.
+    if((p = pbuf_alloc(PBUF_TRANSPORT, BINARY_STATUS_LENGTH, PBUF_RAM))) {
+        binary_status_render((uint8_t *)p->payload, telemetry.sequence++);
+        udp_sendto(telemetry.pcb, p, &telemetry.group, telemetry.port);
+        pbuf_free(p);
+    }
+}
+
+#else
+
+bool UDPTelemetryStart (const char *group, uint16_t port, uint32_t period)
+{
+    return false;
+}
+
+void UDPTelemetryStop (void)
+{
+}
+
+void UDPTelemetryPoll (void)
+{
+}
+
+#endif
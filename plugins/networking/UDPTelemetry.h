@@ -0,0 +1,59 @@
+//
+// UDPTelemetry.h - periodic multicast of binary status frames
+//
+// v1.0 / 2020-06-27 / Io Engineering / Terje
+//
+
+/*
+
+Copyright (c) 2020, Terje Io
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+ Neither the name of the copyright holder nor the names of its contributors may
+be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef __UDPTELEMETRY_H__
+#define __UDPTELEMETRY_H__
+
+#ifndef UDP_TELEMETRY_GROUP
+#define UDP_TELEMETRY_GROUP "239.255.71.76" // Multicast group or broadcast address frames are sent to
+#endif
+
+#ifndef UDP_TELEMETRY_PORT
+#define UDP_TELEMETRY_PORT 5474
+#endif
+
+#ifndef UDP_TELEMETRY_PERIOD
+#define UDP_TELEMETRY_PERIOD 100 // Milliseconds between frames, rounded up to the poll interval
+#endif
+
+bool UDPTelemetryStart(const char *group, uint16_t port, uint32_t period);
+void UDPTelemetryStop(void);
+// To be called from the lwIP thread at the same interval as the stream polls.
+void UDPTelemetryPoll(void);
+
+#endif
@@ -41,10 +41,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdint.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <string.h>
 
 #include "driver.h"
 #include "networking.h"
 #include "WsStream.h"
+#include "rxbuffer.h"
 #include "base64.h"
 #include "sha1.h"
 #include "utils.h"
@@ -52,6 +54,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "grbl/grbl.h"
 
+// Called when data is queued for input, when a line of output is complete and when input waits for
+// room in the input buffer. A driver serving the streams from a task may define this to wake it.
+#ifndef NETWORK_STREAM_NOTIFY
+#define NETWORK_STREAM_NOTIFY()
+#endif
+
 //#define WSDEBUG
 
 #define CRLF "\r\n"
@@ -108,7 +116,8 @@ typedef struct {
     uint32_t mask;
     bool masked;
     bool complete;
-    uint8_t data[13];
+    uint8_t size;       // Size of header, known when the first two bytes are received
+    uint8_t data[14];   // Max size of header: 2 + 8 byte extended payload length + 4 byte masking key
 } frame_header_t;
 
 typedef struct pbuf_entry
@@ -146,6 +155,11 @@ typedef struct ws_sessiondata
     uint8_t pingCount;
     char *http_request;
     uint32_t hdrsize;
+#ifdef ENABLE_BINARY_STATUS_REPORT
+    bool status_push;               // Binary status subprotocol selected, status frames are pushed at a fixed interval.
+    uint16_t status_sequence;
+    TickType_t lastStatusTime;
+#endif
     void (*traffic_handler)(struct ws_sessiondata *session);
 } ws_sessiondata_t;
 
@@ -223,9 +237,25 @@ int16_t WsStreamGetC (void)
     data = streamSession.rxbuf.data[bptr++];                // Get next character, increment tmp pointer
     streamSession.rxbuf.tail = bptr & (RX_BUFFER_SIZE - 1); // and update pointer
 
+    if(data == ASCII_LF && streamSession.pbufHead)          // Input is waiting for room
+        NETWORK_STREAM_NOTIFY();
+
     return data;
 }
 
+//
+// WsStreamReadBlock - reads up to max characters, ends after the first CR or LF
+//
+uint16_t WsStreamReadBlock (char *buffer, uint16_t max)
+{
+    uint16_t count = rxbuffer_read_block(&streamSession.rxbuf, buffer, max);
+
+    if(count && buffer[count - 1] == ASCII_LF && streamSession.pbufHead)   // Input is waiting for room
+        NETWORK_STREAM_NOTIFY();
+
+    return count;
+}
+
 inline uint16_t WsStreamRxCount (void)
 {
     uint_fast16_t head = streamSession.rxbuf.head, tail = streamSession.rxbuf.tail;
@@ -272,6 +302,9 @@ bool WsStreamPutC (const char c) {
 
     uint32_t next_head = (streamSession.txbuf.head + 1) & (TX_BUFFER_SIZE - 1);  // Get and update head pointer
 
+    if(streamSession.txbuf.tail == next_head)
+        NETWORK_STREAM_NOTIFY();
+
     while(streamSession.txbuf.tail == next_head) {                               // Buffer full, block until space is available...
         if(!hal.stream_blocking_callback())
             return false;
@@ -280,6 +313,9 @@ bool WsStreamPutC (const char c) {
     streamSession.txbuf.data[streamSession.txbuf.head] = c;                     // Add data to buffer
     streamSession.txbuf.head = next_head;                                       // and update head pointer
 
+    if(c == ASCII_LF)
+        NETWORK_STREAM_NOTIFY();
+
     return true;
 }
 
@@ -305,6 +341,18 @@ void WsStreamWrite (const char *data, unsigned int length)
         WsStreamPutC(*ptr++);
 }
 
+// Copies the data to the transmit buffer in runs rather than character by character.
+void WsStreamWriteN (const char *data, uint16_t length)
+{
+    bool eol = memchr(data, ASCII_LF, length) != NULL;
+
+    if(length > WsStreamTxFree())
+        NETWORK_STREAM_NOTIFY();
+
+    if(txbuffer_write_n(&streamSession.txbuf, data, length) && eol)
+        NETWORK_STREAM_NOTIFY();
+}
+
 uint16_t WsStreamTxCount(void) {
 
     uint_fast16_t head = streamSession.txbuf.head, tail = streamSession.txbuf.tail;
@@ -312,6 +360,11 @@ uint16_t WsStreamTxCount(void) {
     return BUFCOUNT(head, tail, TX_BUFFER_SIZE);
 }
 
+uint16_t WsStreamTxFree (void)
+{
+    return (TX_BUFFER_SIZE - 1) - WsStreamTxCount();
+}
+
 static int16_t streamReadTXC (void)
 {
     int16_t data;
@@ -440,6 +493,7 @@ static err_t streamReceive (void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_
                 session->rcvHead->pbuf = p;
                 session->rcvHead = session->rcvHead->next;
                 SYS_ARCH_UNPROTECT(lev);
+                NETWORK_STREAM_NOTIFY();
             }
         } else // Null packet received, means close connection
             closeSocket(session, pcb);
@@ -474,6 +528,9 @@ static err_t WsStreamAccept (void *arg, struct tcp_pcb *pcb, err_t err)
     }
 
     session->ftype = wshdr_txt;
+#ifdef ENABLE_BINARY_STATUS_REPORT
+    session->status_push = false;
+#endif
     session->pcbConnect = pcb;
     session->state = WsState_Connected;
     session->fragment_opcode = WsOpcode_Continuation;
@@ -673,6 +730,41 @@ static void WsConnectionHandler (ws_sessiondata_t *session)
 #endif
 
         char *keyp, *key_hdr;
+        const char *protocol = NULL;
+
+        // Select subprotocol, parsed first as the key parsing below terminates the request at the key.
+        if((key_hdr = stristr(session->http_request, WS_PROT))) {
+
+            char protocols[64], *prot;
+            size_t len;
+
+            keyp = key_hdr + sizeof(WS_PROT) - 1;
+
+            if((key_hdr = strstr(keyp, "\r\n")) && (len = key_hdr - keyp) < sizeof(protocols)) {
+
+                memcpy(protocols, keyp, len);
+                protocols[len] = '\0';
+
+                // The client may offer a comma separated list of protocols.
+                prot = strtok(protocols, ", ");
+                while(prot && protocol == NULL) {
+#ifdef ENABLE_BINARY_STATUS_REPORT
+                    // Text frames as usual plus binary status frames pushed at a fixed interval.
+                    if(!strcmp(prot, WEBSOCKET_BINARY_PROTOCOL)) {
+                        protocol = WEBSOCKET_BINARY_PROTOCOL;
+                        session->status_push = true;
+                        session->status_sequence = 0;
+                    } else
+#endif
+                    // Switch to binary frames if protocol is: arduino
+                    if(!strcmp(prot, "arduino")) {
+                        protocol = "arduino";
+                        session->ftype = wshdr_bin;
+                    }
+                    prot = strtok(NULL, ", ");
+                }
+            }
+        }
 
         if((key_hdr = stristr(session->http_request, WS_KEY))) {
 
@@ -681,7 +773,7 @@ static void WsConnectionHandler (ws_sessiondata_t *session)
             if((key_hdr = strstr(keyp, "\r\n"))) {
 
                 char key[64];
-                char rsp[150];
+                char rsp[200];
 
                 *key_hdr = '\0';
 
@@ -713,6 +805,8 @@ static void WsConnectionHandler (ws_sessiondata_t *session)
                 // Upgrade...
                 if (olen) {
                     response[olen + sizeof(WS_RSP) - 1] = '\0';
+                    if(protocol) // The selected subprotocol has to be echoed back
+                        strcat(strcat(strcat(response, CRLF), WS_PROT), protocol);
                     strcat(response, CRLF CRLF);
 #ifdef WSDEBUG
     DEBUG_PRINT(response);
@@ -721,33 +815,14 @@ static void WsConnectionHandler (ws_sessiondata_t *session)
                     http_write(session->pcbConnect, response, (u16_t *)&len, 1);
                     session->traffic_handler = WsStreamHandler;
                     session->lastSendTime = xTaskGetTickCount();
+#ifdef ENABLE_BINARY_STATUS_REPORT
+                    session->lastStatusTime = session->lastSendTime;
+#endif
                     selectStream(StreamType_WebSocket);
                 }
             }
         }
 
-        if((key_hdr = stristr(session->http_request, WS_PROT))) {
-
-            keyp = key_hdr + sizeof(WS_PROT) - 1;
-
-            if((key_hdr = strstr(keyp, "\r\n"))) {
-
-                *key_hdr = '\0';
-
-                // Trim leading spaces from key
-                while(*keyp == ' ')
-                    keyp++;
-
-                // Trim trailing spaces from key
-                while(*--key_hdr == ' ')
-                    key_hdr = '\0';
-
-                // Switch to binary frames if protocol is: arduino
-                if(!strcmp(keyp, "arduino"))
-                    session->ftype = wshdr_bin;
-            }
-        }
-
         free(session->http_request);
         session->http_request = NULL;
         session->hdrsize = MAX_HTTP_HEADER_SIZE;
@@ -796,17 +871,29 @@ static uint32_t WsParse (ws_sessiondata_t *session, uint8_t *payload, uint32_t l
         if(session->header.idx == 2) {
             session->header.masked      = session->header.data[1] & 0x80; // always true from client
             session->header.payload_len = session->header.data[1] & 0x7F;
+            session->header.size = 2 + (session->header.payload_len == 126 ? 2 : (session->header.payload_len == 127 ? 8 : 0)) +
+                                    (session->header.masked ? 4 : 0);
         }
 
-        if(session->header.idx >= 6) {
-            if((session->header.complete = (session->header.idx == (session->header.payload_len == 126 ? 8 : 6)))) {
-                if(session->header.payload_len == 126) {
-                    session->header.payload_len = (session->header.data[2] << 8) | session->header.data[3];
-                    memcpy(&session->header.mask, &session->header.data[4], sizeof(uint32_t));
-                } else
-                    memcpy(&session->header.mask, &session->header.data[2], sizeof(uint32_t));
-                session->header.payload_rem = session->header.payload_len;
+        if(session->header.idx > 2 && (session->header.complete = session->header.idx == session->header.size)) {
+
+            uint_fast8_t idx = 2;
+
+            if(session->header.payload_len == 126) {
+                session->header.payload_len = (session->header.data[2] << 8) | session->header.data[3];
+                idx = 4;
+            } else if(session->header.payload_len == 127) { // 64 bit length, frames larger than 4 GB are not supported
+                session->header.payload_len = (session->header.data[6] << 24) | (session->header.data[7] << 16) |
+                                               (session->header.data[8] << 8) | session->header.data[9];
+                idx = 10;
             }
+
+            if(session->header.masked)
+                memcpy(&session->header.mask, &session->header.data[idx], sizeof(uint32_t));
+            else
+                session->header.mask = 0;
+
+            session->header.payload_rem = session->header.payload_len;
         }
 
         plen--;
@@ -843,7 +930,6 @@ static uint32_t WsParse (ws_sessiondata_t *session, uint8_t *payload, uint32_t l
 
                 if (session->header.payload_rem) {
 
-                    uint8_t *mask = (uint8_t *)&session->header.mask;
                     uint_fast16_t payload_len = session->header.payload_rem > plen ? plen : session->header.payload_rem;
 
                     session->start.token = session->header.payload_rem > plen ? fs.token : FRAME_NONE;
@@ -858,18 +944,13 @@ static uint32_t WsParse (ws_sessiondata_t *session, uint8_t *payload, uint32_t l
                     DEBUG_PRINT(uitoa(payload_len));
                     DEBUG_PRINT("\r\n");
 */
-                    // Unmask and add data to input buffer
-                    uint_fast16_t i = session->header.rx_index;
-                    session->rxbuf.overflow = false;
-
-                    while (payload_len--) {
-                        if(!WsStreamRxInsert(*payload++ ^ mask[i % 4]))
-                            break; // If overflow pend buffering rest of data until next polling
-                        plen--;
-                        i++;
-                    }
+                    // Unmask and add data to input buffer, if overflow pend buffering rest of data until next polling
+                    uint_fast16_t added = rxbuffer_add_masked(&session->rxbuf, payload, payload_len, session->header.mask, session->header.rx_index & 0x03);
+
+                    session->rxbuf.overflow = added < payload_len;
+                    session->header.rx_index += added;
+                    plen -= added;
 
-                    session->header.rx_index = i;
                     frame_done = (session->header.payload_rem = session->header.payload_len - session->header.rx_index) == 0;
                 }
                 break;
@@ -1032,6 +1113,22 @@ static void WsStreamHandler (ws_sessiondata_t *session)
         session->lastSendTime = xTaskGetTickCount();
     }
 
+#ifdef ENABLE_BINARY_STATUS_REPORT
+    // 3. Push a binary status frame in a binary message, skipped if there is no room in the send buffer.
+    // Messages are written whole so status frames are never interleaved with text output.
+    if(session->status_push && (xTaskGetTickCount() - session->lastStatusTime) >= (WEBSOCKET_STATUS_PERIOD + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS) {
+        if(tcp_sndbuf(session->pcbConnect) >= BINARY_STATUS_LENGTH + 2) {
+            tempBuffer[0] = wshdr_bin.token;
+            tempBuffer[1] = BINARY_STATUS_LENGTH;
+            binary_status_render(&tempBuffer[2], session->status_sequence++);
+            tcp_write(session->pcbConnect, tempBuffer, BINARY_STATUS_LENGTH + 2, 1);
+            tcp_output(session->pcbConnect);
+            session->lastSendTime = xTaskGetTickCount();
+        }
+        session->lastStatusTime = xTaskGetTickCount();
+    }
+#endif
+
     // Send ping every 3 seconds if no outgoing traffic.
     // Disconnect session after 3 failed pings (9 seconds).
     if(session->pingCount > 3)
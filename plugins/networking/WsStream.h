@@ -39,17 +39,29 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef __WSSTREAM_H__
 #define __WSSTREAM_H__
 
+// Subprotocol for clients receiving binary status frames, see grbl/binary_status.c, pushed at a fixed interval.
+#ifndef WEBSOCKET_BINARY_PROTOCOL
+#define WEBSOCKET_BINARY_PROTOCOL "grblhal.bin"
+#endif
+
+#ifndef WEBSOCKET_STATUS_PERIOD
+#define WEBSOCKET_STATUS_PERIOD 100 // Milliseconds between status frames, rounded up to the poll interval
+#endif
+
 void WsStreamInit(void);
 void WsStreamListen(uint16_t port);
 void WsStreamClose(void);
 void WsStreamPoll(void);
 void WsStreamNotifyLinkStatus(bool bLinkStatusUp);
 int16_t WsStreamGetC(void);
+uint16_t WsStreamReadBlock(char *buffer, uint16_t max);
 bool WsStreamPutC(const char data);
 void WsStreamWriteS(const char *data);
 void WsStreamWriteLn(const char *data);
 void WsStreamWrite(const char *data, unsigned int length);
+void WsStreamWriteN(const char *data, uint16_t length);
 uint16_t WsStreamTxCount(void);
+uint16_t WsStreamTxFree(void);
 uint16_t WsStreamRxCount(void);
 uint16_t WsStreamRxFree(void);
 void WsStreamRxFlush(void);
@@ -247,14 +247,10 @@ reexecute:
 
             case s_data:
                 mark = p;
-                while (p != data + size) {
-                    c = *p;
-                    if (c == CR) {
-                        parser->state = s_data_cr;
-                        break;
-                    }
-                    ++p;
-                }
+                if ((p = memchr(mark, CR, data + size - mark)) != NULL)
+                    parser->state = s_data_cr;
+                else
+                    p = data + size;
                 if (p > mark) {
                     CALLBACK_DATA(data, mark, p - mark);
                 }
@@ -302,6 +298,7 @@ reexecute:
                     parser->index++;
                     break;
                 }
+                CALLBACK_DATA(data, "\r\n--", 4);
                 CALLBACK_DATA(data, parser->boundary, parser->index);
                 parser->state = s_data;
                 goto reexecute;
@@ -11,6 +11,10 @@
 #include "WsSTream.h"
 #endif
 
+#if UDP_TELEMETRY_ENABLE
+#include "UDPTelemetry.h"
+#endif
+
 //*****************************************************************************
 //
 // lwIP Options
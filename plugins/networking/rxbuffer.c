@@ -0,0 +1,159 @@
+//
+// rxbuffer.c - Input buffer handling for networking plugin streams
+//
+// Part of GrblHAL
+//
+
+#include <string.h>
+
+#include "rxbuffer.h"
+#include "grbl/grbl.h"
+
+#define RXBUFFER_CHUNK_SIZE 64 // Size of block unmasked at a time, must be a multiple of 4
+
+// Returns true for characters that may be realtime commands, all others are always added to the input buffer.
+static inline bool is_realtime_candidate (uint8_t c)
+{
+    return c >= 0x7F || (c < ' ' && c != ASCII_LF && c != ASCII_CR) ||
+            c == CMD_STATUS_REPORT_LEGACY || c == CMD_CYCLE_START_LEGACY || c == CMD_FEED_HOLD_LEGACY;
+}
+
+static inline uint_fast16_t rx_free (stream_rx_buffer_t *rxbuf)
+{
+    uint_fast16_t head = rxbuf->head, tail = rxbuf->tail;
+
+    return (RX_BUFFER_SIZE - 1) - BUFCOUNT(head, tail, RX_BUFFER_SIZE);
+}
+
+// Adds a run of characters to the input buffer, caller must ensure there is room for them.
+static void rx_copy (stream_rx_buffer_t *rxbuf, const uint8_t *data, uint_fast16_t length)
+{
+    uint_fast16_t head = rxbuf->head, part = RX_BUFFER_SIZE - head;
+
+    if(part > length)
+        part = length;
+
+    memcpy(&rxbuf->data[head], data, part);
+    if(length > part)
+        memcpy(rxbuf->data, data + part, length - part);
+
+    rxbuf->head = (head + length) & (RX_BUFFER_SIZE - 1);
+}
+
+// The data is scanned once, realtime commands are passed on as they are encountered
+// and the runs of characters between them are copied to the input buffer.
+uint_fast16_t rxbuffer_add_block (stream_rx_buffer_t *rxbuf, const uint8_t *data, uint_fast16_t length)
+{
+    // discard input if MPG has taken over...
+    if(hal.stream.type == StreamType_MPG)
+        return length;
+
+    uint_fast16_t idx = 0, run = 0, free = rx_free(rxbuf);
+
+    while(idx < length) {
+
+        if(is_realtime_candidate(data[idx])) {
+            rx_copy(rxbuf, &data[run], idx - run); // Realtime commands may cancel the buffered input, add pending data first
+            run = idx;
+            if(hal.stream.enqueue_realtime_command((char)data[idx])) {
+                run = ++idx;
+                free = rx_free(rxbuf);
+                continue;
+            }
+        }
+
+        if(free == 0)
+            break;
+
+        free--;
+        idx++;
+    }
+
+    rx_copy(rxbuf, &data[run], idx - run);
+
+    if(idx)
+        system_idle_wake(); // Input is available, end a pending hal.idle_wait().
+
+    return idx;
+}
+
+uint16_t rxbuffer_read_block (stream_rx_buffer_t *rxbuf, char *buffer, uint16_t max)
+{
+    char c;
+    uint16_t count = 0;
+    uint_fast16_t bptr = rxbuf->tail, head = rxbuf->head;
+
+    while(count < max && bptr != head) {
+        buffer[count++] = c = rxbuf->data[bptr];
+        bptr = (bptr + 1) & (RX_BUFFER_SIZE - 1);
+        if(c == ASCII_LF || c == ASCII_CR)
+            break;
+    }
+
+    rxbuf->tail = bptr;
+
+    return count;
+}
+
+bool txbuffer_write_n (stream_tx_buffer_t *txbuf, const char *data, uint16_t length)
+{
+    uint_fast16_t head, free, part;
+
+    while(length) {
+
+        head = txbuf->head;
+
+        while((free = (TX_BUFFER_SIZE - 1) - BUFCOUNT(head, txbuf->tail, TX_BUFFER_SIZE)) == 0) { // Buffer full, block until space is available...
+            if(!hal.stream_blocking_callback())
+                return false;
+        }
+
+        if(free > length)
+            free = length;
+
+        if((part = TX_BUFFER_SIZE - head) > free)
+            part = free;
+
+        memcpy(&txbuf->data[head], data, part);
+        memcpy(txbuf->data, data + part, free - part);
+
+        txbuf->head = (head + free) & (TX_BUFFER_SIZE - 1); // Update pointer after the data is in place
+        data += free;
+        length -= free;
+    }
+
+    return true;
+}
+
+// Data is unmasked 32 bits at a time in chunks small enough to stay on the stack.
+uint_fast16_t rxbuffer_add_masked (stream_rx_buffer_t *rxbuf, const uint8_t *data, uint_fast16_t length, uint32_t mask, uint_fast8_t phase)
+{
+    uint32_t chunk[RXBUFFER_CHUNK_SIZE / sizeof(uint32_t)], word;
+    uint8_t *key = (uint8_t *)&mask, rotated[4];
+    uint_fast16_t consumed = 0, n, i, added;
+
+    // Rotate the key so that it starts at the first character
+    for(i = 0; i < 4; i++)
+        rotated[i] = key[(phase + i) & 0x03];
+    memcpy(&mask, rotated, sizeof(uint32_t));
+
+    while(consumed < length) {
+
+        n = length - consumed > RXBUFFER_CHUNK_SIZE ? RXBUFFER_CHUNK_SIZE : length - consumed;
+
+        for(i = 0; i < n / 4; i++) {
+            memcpy(&word, data + consumed + i * 4, sizeof(uint32_t)); // Payload may be unaligned
+            chunk[i] = word ^ mask;
+        }
+
+        for(i = i * 4; i < n; i++) // Tail of the last chunk
+            ((uint8_t *)chunk)[i] = data[consumed + i] ^ rotated[i & 0x03];
+
+        consumed += (added = rxbuffer_add_block(rxbuf, (uint8_t *)chunk, n));
+
+        if(added < n)
+            break; // Input buffer full
+    }
+
+    return consumed;
+}
@@ -0,0 +1,30 @@
+//
+// rxbuffer.h - Input buffer handling for networking plugin streams
+//
+// Part of GrblHAL
+//
+
+#ifndef __NETWORKING_RXBUFFER_H__
+#define __NETWORKING_RXBUFFER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "grbl/stream.h"
+
+// Adds a block of received data to the input buffer, realtime commands are extracted and acted upon on the way.
+// Returns the number of characters consumed, less than length if the input buffer is full.
+uint_fast16_t rxbuffer_add_block (stream_rx_buffer_t *rxbuf, const uint8_t *data, uint_fast16_t length);
+
+// As rxbuffer_add_block() but for websocket payload data to be unmasked, mask is the masking key as stored
+// in the frame and phase the position of the first character in the frame payload modulo 4.
+uint_fast16_t rxbuffer_add_masked (stream_rx_buffer_t *rxbuf, const uint8_t *data, uint_fast16_t length, uint32_t mask, uint_fast8_t phase);
+
+// Reads up to max characters from the input buffer, ends after the first CR or LF. Returns the number of characters read.
+uint16_t rxbuffer_read_block (stream_rx_buffer_t *rxbuf, char *buffer, uint16_t max);
+
+// Adds length characters to the output buffer in runs, blocks until there is room for them. Returns false
+// if the blocking callback asked to abort, the remaining characters are then dropped.
+bool txbuffer_write_n (stream_tx_buffer_t *txbuf, const char *data, uint16_t length);
+
+#endif
@@ -0,0 +1,223 @@
+//
+// ws_bench.c - websocket upload throughput benchmark, built by the Simulator makefile (gwsbench)
+//
+// Part of GrblHAL
+//
+
+/*
+  Generates 1 MB of g-code and passes it through the websocket payload path as a web UI
+  file upload would: split into masked frames that arrive in pbuf sized segments. Each segment
+  is unmasked and added to the input buffer, which is drained as if by the parser after each call.
+  Reports the throughput in bytes per second for rxbuffer_add_masked() and for the previous
+  character by character implementation, kept here as a reference. Returns non-zero if the
+  drained data differs from the generated g-code for either implementation.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "platform.h"
+#include "grbl/grbl.h"
+
+#include "rxbuffer.h"
+
+#define UPLOAD_SIZE (1024 * 1024)
+
+typedef uint_fast16_t (*add_masked_ptr)(stream_rx_buffer_t *rxbuf, const uint8_t *data, uint_fast16_t length, uint32_t mask, uint_fast8_t phase);
+
+typedef struct arg_vars {
+    uint32_t passes;
+    uint32_t frame_size;
+    uint32_t segment_size;
+} arg_vars_t;
+
+arg_vars_t args;
+const char* progname;
+
+static stream_rx_buffer_t rxbuf;
+static uint8_t *gcode, *masked, *drained;
+static uint32_t length, drained_length;
+
+int usage (const char* badarg)
+{
+    if (badarg)
+        printf("Unrecognized option %s\n", badarg);
+
+    printf("Usage: \n"
+     "%s <Options>\n"
+     "  Options:\n"
+     "    -n <passes> : number of times to upload the data. Default=10\n"
+     "    -f <bytes>  : websocket frame payload size. Default=4096\n"
+     "    -s <bytes>  : pbuf segment size. Default=1460\n"
+     "\n  Reports websocket upload throughput in bytes per second\n",
+     progname);
+
+    return -1;
+}
+
+// Previous implementation, unmasks and buffers one character at a time.
+static bool insert_ref (char c)
+{
+    uint_fast16_t bptr = (rxbuf.head + 1) & (RX_BUFFER_SIZE - 1);
+
+    if(bptr == rxbuf.tail)
+        rxbuf.overflow = true;
+    else if(!hal.stream.enqueue_realtime_command(c)) {
+        rxbuf.data[rxbuf.head] = c;
+        rxbuf.head = bptr;
+    }
+
+    return !rxbuf.overflow;
+}
+
+static uint_fast16_t add_masked_ref (stream_rx_buffer_t *rxbuf, const uint8_t *data, uint_fast16_t length, uint32_t mask, uint_fast8_t phase)
+{
+    uint8_t *key = (uint8_t *)&mask;
+    uint_fast16_t i = phase, added = 0;
+
+    rxbuf->overflow = false;
+
+    while(length--) {
+        if(!insert_ref(*data++ ^ key[i % 4]))
+            break;
+        added++;
+        i++;
+    }
+
+    return added;
+}
+
+// Empties the input buffer as the parser would.
+static void drain (void)
+{
+    uint_fast16_t head = rxbuf.head, count;
+
+    while(rxbuf.tail != head) {
+        count = (head > rxbuf.tail ? head : RX_BUFFER_SIZE) - rxbuf.tail;
+        if(drained_length + count <= length)
+            memcpy(&drained[drained_length], &rxbuf.data[rxbuf.tail], count);
+        drained_length += count;
+        rxbuf.tail = (rxbuf.tail + count) & (RX_BUFFER_SIZE - 1);
+    }
+}
+
+static float run (add_masked_ptr add_masked, uint32_t mask)
+{
+    uint32_t pass, frame, offset, segment, added;
+
+    clock_t start = clock();
+
+    for(pass = 0; pass < args.passes; pass++) {
+
+        drained_length = 0;
+        rxbuf.head = rxbuf.tail = 0;
+
+        for(frame = 0; frame < length; frame += args.frame_size) {
+            for(offset = 0; offset < args.frame_size && frame + offset < length; offset += segment) {
+                segment = args.segment_size;
+                if(segment > args.frame_size - offset)
+                    segment = args.frame_size - offset;
+                if(segment > length - frame - offset)
+                    segment = length - frame - offset;
+                for(added = 0; added < segment; drain()) // Retry from where the input buffer overflowed
+                    added += add_masked(&rxbuf, &masked[frame + offset + added], segment - added, mask, (offset + added) & 0x03);
+            }
+        }
+    }
+
+    return (float)(clock() - start) / (float)CLOCKS_PER_SEC;
+}
+
+static void generate (uint32_t mask)
+{
+    uint8_t *key = (uint8_t *)&mask;
+    uint32_t idx, line = 0;
+    char block[64];
+    int n;
+
+    length = 0;
+
+    while(length < UPLOAD_SIZE - sizeof(block)) {
+        n = sprintf(block, "G1X%.3fY%.3fZ%.3fF%d\n", (float)(line % 5000) * 0.1f, (float)(line % 3000) * 0.2f, -(float)(line % 7), 500 + (int)(line % 1000));
+        memcpy(&gcode[length], block, n);
+        length += n;
+        line++;
+    }
+
+    // Masking restarts with each frame
+    for(idx = 0; idx < length; idx++)
+        masked[idx] = gcode[idx] ^ key[(idx % args.frame_size) & 0x03];
+}
+
+int main (int argc, char *argv[])
+{
+    int ret = 0;
+    uint32_t mask = 0x5AC3E817;
+    float elapsed, elapsed_ref;
+
+    progname = argv[0];
+    args.passes = 10;
+    args.frame_size = 4096;
+    args.segment_size = 1460;
+
+    argv++;
+    argc--;
+    while(argc && argv[0][0] == '-') {
+        switch(argv[0][1]) {
+
+            case 'n':
+            case 'f':
+            case 's':
+                if(argc < 2 || atoi(argv[1]) <= 0)
+                    return usage(argv[0]);
+                if(argv[0][1] == 'n')
+                    args.passes = atoi(argv[1]);
+                else if(argv[0][1] == 'f')
+                    args.frame_size = atoi(argv[1]);
+                else
+                    args.segment_size = atoi(argv[1]);
+                argv++;
+                argc--;
+                break;
+
+            default:
+                return usage(argv[0]);
+        }
+        argv++;
+        argc--;
+    }
+
+    gcode = malloc(UPLOAD_SIZE);
+    masked = malloc(UPLOAD_SIZE);
+    drained = malloc(UPLOAD_SIZE);
+
+    if(gcode == NULL || masked == NULL || drained == NULL) {
+        printf("Out of memory\n");
+        return -1;
+    }
+
+    hal.stream.type = StreamType_Telnet;
+    hal.stream.enqueue_realtime_command = protocol_enqueue_realtime_command;
+
+    generate(mask);
+
+    elapsed_ref = run(add_masked_ref, mask);
+    if(drained_length != length || memcmp(drained, gcode, length)) {
+        printf("Reference implementation mismatch\n");
+        ret = 1;
+    }
+
+    elapsed = run(rxbuffer_add_masked, mask);
+    if(drained_length != length || memcmp(drained, gcode, length)) {
+        printf("rxbuffer_add_masked() mismatch\n");
+        ret = 1;
+    }
+
+    printf("Upload: %" PRIu32 " bytes, frame size %" PRIu32 ", segment size %" PRIu32 ", %" PRIu32 " passes\n", length, args.frame_size, args.segment_size, args.passes);
+    printf("rxbuffer_add_masked(): %.0f bytes/s\n", (float)length * (float)args.passes / elapsed);
+    printf("Reference:             %.0f bytes/s\n", (float)length * (float)args.passes / elapsed_ref);
+
+    return ret;
+}
@@ -30,6 +30,39 @@
 /* uses fatfs - http://www.elm-chan.org/fsw/ff/00index_e.html */
 
 #define MAX_PATHLEN 128
+
+// Size of each of the two read buffers, a multiple of the sector size keeps reads sector aligned.
+#ifndef SDCARD_READ_BUFFER_SIZE
+#define SDCARD_READ_BUFFER_SIZE 512
+#endif
+
+// Size of the directory index in bytes, set to 0 to disable. Allocated from the heap on the first listing.
+#ifndef SDCARD_DIR_INDEX_SIZE
+#define SDCARD_DIR_INDEX_SIZE 4096
+#endif
+
+// Max. number of files listed by $FL.
+#ifndef SDCARD_LIST_PAGE_SIZE
+#define SDCARD_LIST_PAGE_SIZE 20
+#endif
+
+// Number of lines between line index entries, set to 0 to disable indexing.
+#ifndef SDCARD_INDEX_INTERVAL
+#define SDCARD_INDEX_INTERVAL 1000
+#endif
+
+// Max. number of errors and soft limit violations reported by line by $FV.
+#ifndef SDCARD_VERIFY_REPORT_MAX
+#define SDCARD_VERIFY_REPORT_MAX 10
+#endif
+
+// Name of the job log and size of its RAM buffer, set the size to 0 to disable logging. Requires ENABLE_JOB_STATS.
+#ifndef SDCARD_JOB_LOG
+#define SDCARD_JOB_LOG "/jobs.csv"
+#endif
+#ifndef SDCARD_JOB_LOG_SIZE
+#define SDCARD_JOB_LOG_SIZE 512
+#endif
 #define LCAPS(c) ((c >= 'A' && c <= 'Z') ? c | 0x20 : c)
 
 
@@ -45,6 +78,9 @@ char const *const filetypes[] = {
     "text",
     "tap",
     "ngc",
+#ifdef ENABLE_BINARY_STREAM
+    "gcb",
+#endif
     ""
 };
 
@@ -64,7 +100,11 @@ typedef struct
     size_t size;
     size_t pos;
     uint32_t line;
+    uint32_t resume_line;   // Line to resume from, lines before it are executed in check mode
     uint8_t eol;
+#if SDCARD_CACHE_ENABLE
+    bool cached;            // File is read via the RAM file cache
+#endif
 } file_t;
 
 static file_t file = {
@@ -74,7 +114,55 @@ static file_t file = {
     .pos = 0
 };
 
+/*
+  File data is read into two buffers used in turn. Characters are returned from the current
+  buffer while the other is refilled ahead of consumption from the execute_realtime handler,
+  that is while the main loop waits for the planner or the machine to catch up. A refill is
+  only done by file_read() if the other buffer is still empty when the current one runs dry.
+*/
+
+typedef struct {
+    char data[2][SDCARD_READ_BUFFER_SIZE];
+    UINT length[2];
+    bool empty[2];          // Buffer waiting to be refilled
+    uint_fast8_t current;
+    uint_fast16_t idx;      // Index of next character in the current buffer
+    size_t offset;          // File offset of the current buffer
+} read_buffer_t;
+
+static read_buffer_t rdbuf;
+
+#if SDCARD_CACHE_ENABLE
+
+/*
+  Large RAM targets may attach a RAM file cache with sdcard_cache_attach(). A job file that fits
+  is read into the cache when opened and then run without further card access, rewinds and seeks
+  included. The contents are kept when the job ends, a file not changed since is not read again.
+  Larger files are streamed through the cache used as a ring buffer, refilled block by block from
+  the execute_realtime handler as space is freed.
+*/
+
+typedef struct {
+    uint8_t *data;
+    size_t size;            // Multiple of SDCARD_READ_BUFFER_SIZE
+    size_t base;            // File offset of the oldest data in the cache
+    size_t fill;            // File offset of the next block to read, the file is positioned here
+    bool claimed;           // In use by an upload handler
+    bool valid;             // Holds all of the file below
+    size_t file_size;
+    WORD fdate;
+    WORD ftime;
+    char name[MAX_PATHLEN];
+} file_cache_t;
+
+static file_cache_t cache = {0};
+
+#endif
+
 static bool frewind = false;
+#ifdef ENABLE_BINARY_STREAM
+static bool compiled = false, binary_enabled = false;
+#endif
 static io_stream_t active_stream;
 static driver_reset_ptr driver_reset = NULL;
 //static report_t active_reports;
@@ -145,7 +233,14 @@ static inline char *get_name (FILINFO *file)
 #endif
 }
 
-static FRESULT scan_dir (char *path, uint_fast8_t depth, char *buf)
+// Called for each file found, returns false to end the scan.
+typedef bool (*dir_visitor_ptr)(const char *filename, uint32_t size, file_status_t status, void *context);
+
+static bool scan_ended;
+
+// Calls visit() for the allowed files in path and, down to depth levels, in its subdirectories.
+// Files in a directory are visited before its subdirectories.
+static FRESULT scan_dir (char *path, uint_fast8_t depth, dir_visitor_ptr visit, void *context)
 {
 #if defined(ESP_PLATFORM)
     FF_DIR dir;
@@ -156,6 +251,7 @@ static FRESULT scan_dir (char *path, uint_fast8_t depth, char *buf)
     FRESULT res;
     file_status_t status;
     bool subdirs = false;
+    size_t pathlen = strlen(path);
 #if _USE_LFN
     static TCHAR lfn[_MAX_LFN + 1];   /* Buffer to store the LFN */
     fno.lfname = lfn;
@@ -166,7 +262,7 @@ static FRESULT scan_dir (char *path, uint_fast8_t depth, char *buf)
         return res;
 
     // Pass 1: Scan files
-    while(true) {
+    while(!scan_ended) {
 
         if((res = f_readdir(&dir, &fno)) != FR_OK || fno.fname[0] == '\0')
             break;
@@ -174,26 +270,28 @@ static FRESULT scan_dir (char *path, uint_fast8_t depth, char *buf)
         subdirs |= fno.fattrib & AM_DIR;
 
         if(!(fno.fattrib & AM_DIR) && (status = allowed(get_name(&fno), true)) != Filename_Filtered) {
-            sprintf(buf, "[FILE:%s/%s|SIZE:%u%s]\r\n", path, get_name(&fno), (uint32_t)fno.fsize, status == Filename_Invalid ? "|UNUSABLE" : "");
-            hal.stream.write(buf);
+            if(pathlen + strlen(get_name(&fno)) > (MAX_PATHLEN - 2))
+                continue;
+            sprintf(&path[pathlen], "/%s", get_name(&fno));
+            scan_ended = !visit(path, (uint32_t)fno.fsize, status, context);
+            path[pathlen] = '\0';
         }
     }
 
-    if((subdirs = (subdirs && --depth)))
+    if((subdirs = (subdirs && --depth && !scan_ended)))
         f_readdir(&dir, NULL); // Rewind
 
     // Pass 2: Scan directories
-    while(subdirs) {
+    while(subdirs && !scan_ended) {
 
         if((res = f_readdir(&dir, &fno)) != FR_OK || fno.fname[0] == '\0')
             break;
 
         if(fno.fattrib & AM_DIR) { // It is a directory
-            size_t pathlen = strlen(path);
             if(pathlen + strlen(get_name(&fno)) > (MAX_PATHLEN - 1))
                 break;
             sprintf(&path[pathlen], "/%s", get_name(&fno));
-            if((res = scan_dir(path, depth, buf)) != FR_OK)
+            if((res = scan_dir(path, depth, visit, context)) != FR_OK)
                 break;
             path[pathlen] = '\0';
         }
@@ -206,8 +304,430 @@ static FRESULT scan_dir (char *path, uint_fast8_t depth, char *buf)
     return res;
 }
 
+#if SDCARD_DIR_INDEX_SIZE
+
+/*
+  The allowed files on the card are indexed on the first listing and the index is used for listings
+  until it is invalidated by a write to the card, by sdcard_dir_changed() or on (re)mount. Entries are
+  kept in the order they are found and are packed into a buffer of SDCARD_DIR_INDEX_SIZE bytes,
+  allocated when the index is first built. If there are more files than fit listings scan the card.
+*/
+
+typedef struct {
+    uint32_t size;
+    uint8_t status;
+    char filename[];
+} dir_entry_t;
+
+static struct {
+    uint8_t *data;
+    size_t used;
+    uint32_t entries;
+    bool valid;
+    bool overflow;  // Not all files fit, the card is scanned instead until invalidated.
+} dir_index = {0};
+
+static inline size_t dir_entry_size (const char *filename)
+{
+    return (sizeof(dir_entry_t) + strlen(filename) + 1 + 3) & ~(size_t)3;
+}
+
+static bool dir_index_add (const char *filename, uint32_t size, file_status_t status, void *context)
+{
+    size_t entry_size = dir_entry_size(filename);
+
+    if((dir_index.overflow = dir_index.used + entry_size > SDCARD_DIR_INDEX_SIZE))
+        return false;
+
+    dir_entry_t *entry = (dir_entry_t *)&dir_index.data[dir_index.used];
+
+    entry->size = size;
+    entry->status = (uint8_t)status;
+    strcpy(entry->filename, filename);
+
+    dir_index.used += entry_size;
+    dir_index.entries++;
+
+    return true;
+}
+
+static bool dir_index_build (void)
+{
+    if(dir_index.valid || dir_index.overflow)
+        return dir_index.valid;
+
+    if(dir_index.data == NULL && (dir_index.data = malloc(SDCARD_DIR_INDEX_SIZE)) == NULL)
+        return false;
+
+    char path[MAX_PATHLEN] = ""; // NB! also used as work area when recursing directories
+
+    dir_index.used = 0;
+    dir_index.entries = 0;
+    scan_ended = false;
+
+    dir_index.valid = scan_dir(path, 10, dir_index_add, NULL) == FR_OK && !dir_index.overflow;
+
+    return dir_index.valid;
+}
+
+static void dir_index_visit (dir_visitor_ptr visit, void *context)
+{
+    uint32_t idx = dir_index.entries;
+    dir_entry_t *entry = (dir_entry_t *)dir_index.data;
+
+    while(idx-- && visit(entry->filename, entry->size, (file_status_t)entry->status, context))
+        entry = (dir_entry_t *)((uint8_t *)entry + dir_entry_size(entry->filename));
+}
+
+#endif
+
+// Invalidates the directory index, to be called when files are written, deleted or renamed.
+void sdcard_dir_changed (void)
+{
+#if SDCARD_DIR_INDEX_SIZE
+    dir_index.valid = dir_index.overflow = false;
+#endif
+}
+
+typedef struct {
+    char *buf;
+    const char *filter;     // Case insensitive substring of the filename, NULL for all files.
+    uint32_t first;         // Index of the first matching file to output.
+    uint32_t count;         // Max. number of files to output.
+    uint32_t matched;
+} dir_list_t;
+
+static bool filename_matches (const char *filename, const char *filter)
+{
+    const char *s, *f;
+
+    do {
+        for(s = filename, f = filter; *f && LCAPS(*s) == LCAPS(*f); s++, f++);
+        if(*f == '\0')
+            return true;
+    } while(*filename++);
+
+    return false;
+}
+
+static bool dir_list_file (const char *filename, uint32_t size, file_status_t status, void *context)
+{
+    dir_list_t *list = (dir_list_t *)context;
+
+    if(list->filter == NULL || filename_matches(filename, list->filter)) {
+        if(list->matched >= list->first && list->matched - list->first < list->count) {
+            sprintf(list->buf, "[FILE:%s|SIZE:%u%s]\r\n", filename, size, status == Filename_Invalid ? "|UNUSABLE" : "");
+            hal.stream.write(list->buf);
+        }
+        list->matched++;
+    }
+
+    return true;
+}
+
+static void buffer_fill (uint_fast8_t buffer)
+{
+    if(f_read(file.handle, rdbuf.data[buffer], SDCARD_READ_BUFFER_SIZE, &rdbuf.length[buffer]) != FR_OK)
+        rdbuf.length[buffer] = 0;
+
+    rdbuf.empty[buffer] = false;
+}
+
+// Reads the first buffer from the current file position, must be sector aligned.
+static void buffer_reset (void)
+{
+    rdbuf.current = rdbuf.idx = 0;
+    rdbuf.offset = f_tell(file.handle);
+    buffer_fill(0);
+    rdbuf.empty[1] = rdbuf.length[0] == SDCARD_READ_BUFFER_SIZE;
+    rdbuf.length[1] = 0;
+}
+
+#if SDCARD_CACHE_ENABLE
+
+static void cache_set_valid (const char *filename, FILINFO *info)
+{
+    cache.valid = true;
+    cache.file_size = info->fsize;
+    cache.fdate = info->fdate;
+    cache.ftime = info->ftime;
+    strncpy(cache.name, filename, sizeof(cache.name));
+    cache.name[sizeof(cache.name) - 1] = '\0';
+}
+
+// Reads the next block into the cache, returns false at end of file or on a read error.
+static bool cache_fill (void)
+{
+    UINT count;
+
+    if(cache.fill >= file.size || f_read(file.handle, &cache.data[cache.fill % cache.size], SDCARD_READ_BUFFER_SIZE, &count) != FR_OK || count == 0)
+        return false;
+
+    if(cache.fill + SDCARD_READ_BUFFER_SIZE > cache.base + cache.size) // Oldest block overwritten
+        cache.base = cache.fill + SDCARD_READ_BUFFER_SIZE - cache.size;
+
+    cache.fill += count;
+
+    return true;
+}
+
+// The block to be filled must not hold unread data or the block currently read from.
+static inline bool cache_has_room (void)
+{
+    return cache.fill < file.size && cache.fill + SDCARD_READ_BUFFER_SIZE <= file.pos - file.pos % SDCARD_READ_BUFFER_SIZE + cache.size;
+}
+
+// Reads the file into the cache if it fits, unless already there.
+static void cache_load (char *filename)
+{
+    FILINFO info;
+    bool stat = f_stat(filename, &info) == FR_OK;
+
+    if(stat && cache.valid && cache.file_size == file.size && cache.fdate == info.fdate &&
+        cache.ftime == info.ftime && !strcmp(cache.name, filename)) {
+        cache.base = 0;
+        cache.fill = file.size;
+        f_lseek(file.handle, file.size);
+        return;
+    }
+
+    cache.valid = false;
+    cache.base = cache.fill = 0;
+
+    if(file.size <= cache.size) {
+        while(cache_fill());
+        if(stat && cache.fill == file.size)
+            cache_set_valid(filename, &info);
+    }
+}
+
+static void cache_seek (size_t offset)
+{
+    if(offset < cache.base || offset > cache.fill) {
+        cache.base = cache.fill = offset - offset % SDCARD_READ_BUFFER_SIZE;
+        f_lseek(file.handle, cache.fill);
+    }
+    file.pos = offset;
+}
+
+static int16_t cache_read (void)
+{
+    if(file.pos >= cache.fill)
+        cache_fill();
+
+    return file.pos < cache.fill ? (int16_t)cache.data[file.pos++ % cache.size] : -1;
+}
+
+// Storage for the cache is supplied by the driver, size must be at least twice the read buffer size.
+bool sdcard_cache_attach (void *data, size_t size)
+{
+    size -= size % SDCARD_READ_BUFFER_SIZE;
+
+    if(data == NULL || size < 2 * SDCARD_READ_BUFFER_SIZE)
+        return false;
+
+    cache.data = data;
+    cache.size = size;
+    cache.valid = cache.claimed = false;
+
+    return true;
+}
+
+// Hands the cache to an upload handler, returns NULL if not attached, already claimed or while a file is open.
+void *sdcard_cache_claim (size_t *size)
+{
+    if(cache.data == NULL || cache.claimed || file.handle)
+        return NULL;
+
+    cache.claimed = true;
+    cache.valid = false;
+    *size = cache.size;
+
+    return cache.data;
+}
+
+// Returns the cache from an upload handler. If filename is not NULL the cache holds length bytes of
+// the file, as just written to the card, and is used when the file is run unless the file is changed.
+void sdcard_cache_release (const char *filename, size_t length)
+{
+    FILINFO info;
+
+    cache.claimed = false;
+
+    sdcard_dir_changed();
+
+    if(filename && length <= cache.size && f_stat(filename, &info) == FR_OK && info.fsize == length)
+        cache_set_valid(filename, &info);
+}
+
+#endif
+
+// Sets the read position to offset, reads are kept aligned to the buffer size.
+static void buffer_seek (size_t offset)
+{
+#if SDCARD_CACHE_ENABLE
+    if(file.cached) {
+        cache_seek(offset);
+        return;
+    }
+#endif
+    f_lseek(file.handle, offset - offset % SDCARD_READ_BUFFER_SIZE);
+    buffer_reset();
+    rdbuf.idx = offset % SDCARD_READ_BUFFER_SIZE;
+    file.pos = offset;
+}
+
+#if SDCARD_INDEX_INTERVAL || defined(ENABLE_BINARY_STREAM)
+
+// Copies filename to dest with the file type replaced by type, dest must have room for MAX_PATHLEN characters.
+static bool set_file_type (char *dest, const char *filename, const char *type)
+{
+    char *ftptr;
+
+    if(strlen(filename) + strlen(type) > MAX_PATHLEN - 2)
+        return false;
+
+    strcpy(dest, filename);
+    if((ftptr = strrchr(dest, '.')) == NULL || strchr(ftptr, '/'))
+        ftptr = strchr(dest, '\0');
+    *ftptr++ = '.';
+    strcpy(ftptr, type);
+
+    return true;
+}
+
+#endif
+
+#if SDCARD_INDEX_INTERVAL
+
+/*
+  While a job runs a line index is written to a file with the same name and file type idx. Every
+  SDCARD_INDEX_INTERVAL lines the file offset of the line is added along with a snapshot of the parser
+  state, taken when the line is read and thus after the preceding lines are executed. Entries are
+  synced to the card when added so that the index survives a power loss. The index is kept and
+  extended by later runs as long as the size of the file is unchanged.
+*/
+
+#define INDEX_MAGIC 0x58444947 // "GIDX"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t file_size;
+    uint16_t interval;
+    uint16_t entry_size;
+} index_header_t;
+
+typedef struct {
+    uint32_t offset;
+    parser_state_t gc_state;
+} index_entry_t;
+
+typedef struct {
+    FIL handle;
+    uint32_t entries;
+    index_header_t header;
+    index_entry_t entry;
+} line_index_t;
+
+static line_index_t *line_index = NULL;
+
+static void index_close (void)
+{
+    if(line_index) {
+        f_close(&line_index->handle);
+        free(line_index);
+        line_index = NULL;
+    }
+}
+
+static bool index_add (size_t offset)
+{
+    UINT count;
+
+    line_index->entry.offset = offset;
+    memcpy(&line_index->entry.gc_state, &gc_state, sizeof(parser_state_t));
+
+    if(f_write(&line_index->handle, &line_index->entry, sizeof(index_entry_t), &count) == FR_OK &&
+        count == sizeof(index_entry_t) && f_sync(&line_index->handle) == FR_OK)
+        line_index->entries++;
+    else
+        index_close(); // Card full or write error, stop indexing.
+
+    return line_index != NULL;
+}
+
+// Opens the index for the current file, an index that does not match the file is cleared.
+// Indexing is silently disabled if the index cannot be written.
+static void index_open (char *filename)
+{
+    UINT count;
+    char name[MAX_PATHLEN];
+
+    if(!set_file_type(name, filename, "idx") || (line_index = malloc(sizeof(line_index_t))) == NULL)
+        return;
+
+    if(f_open(&line_index->handle, name, FA_READ|FA_WRITE|FA_OPEN_ALWAYS) != FR_OK) {
+        free(line_index);
+        line_index = NULL;
+        return;
+    }
+
+    if(f_read(&line_index->handle, &line_index->header, sizeof(index_header_t), &count) == FR_OK && count == sizeof(index_header_t) &&
+        line_index->header.magic == INDEX_MAGIC && line_index->header.file_size == file.size &&
+         line_index->header.interval == SDCARD_INDEX_INTERVAL && line_index->header.entry_size == sizeof(index_entry_t)) {
+        line_index->entries = (f_size(&line_index->handle) - sizeof(index_header_t)) / sizeof(index_entry_t);
+        f_lseek(&line_index->handle, sizeof(index_header_t) + line_index->entries * sizeof(index_entry_t));
+    } else {
+        line_index->header.magic = INDEX_MAGIC;
+        line_index->header.file_size = file.size;
+        line_index->header.interval = SDCARD_INDEX_INTERVAL;
+        line_index->header.entry_size = sizeof(index_entry_t);
+        line_index->entries = 0;
+        f_lseek(&line_index->handle, 0);
+        if(f_truncate(&line_index->handle) != FR_OK ||
+            f_write(&line_index->handle, &line_index->header, sizeof(index_header_t), &count) != FR_OK || count != sizeof(index_header_t))
+            index_close();
+    }
+
+    if(line_index && line_index->entries == 0)
+        index_add(0); // Parser state at start of file.
+}
+
+// Restores the file position and the parser state from the closest index entry preceding line.
+// The current tool is kept.
+static void index_seek (uint32_t line)
+{
+    UINT count;
+    uint32_t entry = line / SDCARD_INDEX_INTERVAL;
+    tool_data_t *tool = gc_state.tool;
+
+    if(line_index == NULL || line_index->entries < 2)
+        return;
+
+    if(entry >= line_index->entries)
+        entry = line_index->entries - 1;
+
+    f_lseek(&line_index->handle, sizeof(index_header_t) + entry * sizeof(index_entry_t));
+
+    if(f_read(&line_index->handle, &line_index->entry, sizeof(index_entry_t), &count) == FR_OK && count == sizeof(index_entry_t)) {
+        buffer_seek(line_index->entry.offset);
+        memcpy(&gc_state, &line_index->entry.gc_state, sizeof(parser_state_t));
+        gc_state.tool = tool;
+        gc_state.last_error = Status_OK;
+        file.line = entry * SDCARD_INDEX_INTERVAL;
+    }
+
+    f_lseek(&line_index->handle, sizeof(index_header_t) + line_index->entries * sizeof(index_entry_t));
+}
+
+#endif
+
 static void file_close (void)
 {
+#if SDCARD_INDEX_INTERVAL
+    index_close();
+#endif
+
     if(file.handle) {
         f_close(file.handle);
         file.handle = NULL;
@@ -223,8 +743,14 @@ static bool file_open (char *filename)
         file.handle = &cncfile;
         file.size = f_size(file.handle);
         file.pos = 0;
-        file.line = 0;
+        file.line = file.resume_line = 0;
         file.eol = false;
+#if SDCARD_CACHE_ENABLE
+        if((file.cached = cache.data && !cache.claimed))
+            cache_load(filename);
+        else
+#endif
+        buffer_reset();
         char *leafname = strrchr(filename, '/');
         strncpy(file.name, leafname ? leafname + 1 : filename, sizeof(file.name));
         file.name[sizeof(file.name) - 1] = '\0';
@@ -233,15 +759,36 @@ static bool file_open (char *filename)
     return file.handle != NULL;
 }
 
-static int16_t file_read (void)
+static int16_t buffer_read (void)
 {
-    signed char c;
-    UINT count;
+    if(rdbuf.idx == rdbuf.length[rdbuf.current] && rdbuf.length[rdbuf.current] == SDCARD_READ_BUFFER_SIZE) {
 
-    if(f_read(file.handle, &c, 1, &count) == FR_OK && count == 1)
-        file.pos = f_tell(file.handle);
-    else
-        c = -1;
+        uint_fast8_t next = rdbuf.current ^ 1;
+
+        if(rdbuf.empty[next])
+            buffer_fill(next);
+
+        rdbuf.offset += SDCARD_READ_BUFFER_SIZE;
+        rdbuf.current = next;
+        rdbuf.idx = 0;
+        rdbuf.empty[next ^ 1] = rdbuf.length[next] == SDCARD_READ_BUFFER_SIZE; // Refill unless end of file
+    }
+
+    if(rdbuf.idx == rdbuf.length[rdbuf.current])
+        return -1;
+
+    file.pos = rdbuf.offset + rdbuf.idx + 1;
+
+    return (int16_t)(signed char)rdbuf.data[rdbuf.current][rdbuf.idx++];
+}
+
+static int16_t file_read (void)
+{
+#if SDCARD_CACHE_ENABLE
+    signed char c = (signed char)(file.cached ? cache_read() : buffer_read());
+#else
+    signed char c = (signed char)buffer_read();
+#endif
 
     if(c == '\r' || c == '\n')
         file.eol++;
@@ -272,28 +819,109 @@ static bool sdcard_mount (void)
 #endif
 }
 
-static status_code_t sdcard_ls (char *buf)
+// Outputs count files matching filter starting with the first, all files if count is 0.
+// A page of files is followed by a [FILES:<first>,<count>,<matched>] line, matched is the number of files matching the filter.
+static status_code_t sdcard_ls (char *buf, uint32_t first, uint32_t count, const char *filter)
 {
-    char path[MAX_PATHLEN] = ""; // NB! also used as work area when recursing directories
+    FRESULT res = FR_OK;
+    dir_list_t list = {
+        .buf = buf,
+        .filter = filter && *filter ? filter : NULL,
+        .first = first,
+        .count = count ? count : UINT32_MAX
+    };
+
+#if SDCARD_DIR_INDEX_SIZE
+    if(dir_index_build())
+        dir_index_visit(dir_list_file, &list);
+    else
+#endif
+    {
+        char path[MAX_PATHLEN] = ""; // NB! also used as work area when recursing directories
+
+        scan_ended = false;
+        res = scan_dir(path, 10, dir_list_file, &list);
+    }
 
-    return scan_dir(path, 10, buf) == FR_OK ? Status_OK : Status_SDFailedOpenDir;
+    if(res == FR_OK && count) {
+        sprintf(buf, "[FILES:%u,%u,%u]\r\n", first, list.matched > first ? min(list.matched - first, count) : 0, list.matched);
+        hal.stream.write(buf);
+    }
+
+    return res == FR_OK ? Status_OK : Status_SDFailedOpenDir;
+}
+
+// Lists a page of files, args is [<first>[,<count>[,<filter>]]]. Count defaults to and is limited to SDCARD_LIST_PAGE_SIZE.
+static status_code_t sdcard_ls_page (char *buf, char *args)
+{
+    uint32_t first = 0, count = SDCARD_LIST_PAGE_SIZE;
+
+    if(*args) {
+        first = strtoul(args, &args, 10);
+        if(*args == ',') {
+            count = strtoul(++args, &args, 10);
+            if(*args == ',')
+                args++;
+            else if(*args != '\0')
+                return Status_InvalidStatement;
+        } else if(*args != '\0')
+            return Status_InvalidStatement;
+        if(count == 0 || count > SDCARD_LIST_PAGE_SIZE)
+            count = SDCARD_LIST_PAGE_SIZE;
+    }
+
+    return sdcard_ls(buf, first, count, args);
 }
 
 static void sdcard_end_job (void)
 {
     file_close();
     memcpy(&hal.stream, &active_stream, sizeof(io_stream_t));   // Restore stream pointers
+    if(file.resume_line) {                                      // Line to resume from not found,
+        file.resume_line = 0;                                   // exit check mode by a reset
+        hal.stream.write("[MSG:Resume line not found in SD file]\r\n");
+        mc_reset();
+    }
     hal.stream.reset_read_buffer();                             // and flush input buffer
     hal.driver_rt_report = NULL;
     hal.state_change_requested = NULL;
     hal.report.status_message = report_status_message;
     hal.report.feedback_message = report_feedback_message;
     frewind = false;
+#ifdef ENABLE_BINARY_STREAM
+    if(compiled) {
+        binary_stream_enable(binary_enabled);
+        compiled = false;
+    }
+#endif
+}
+
+// Called when the first character of the line to resume from has been read, the preceding line is then executed.
+static void resume_job (void)
+{
+    char buf[50];
+
+    file.resume_line = 0;
+
+    if(sys.state == STATE_CHECK_MODE)
+        set_state(STATE_IDLE);
+
+    // Continue from the current position with work offsets as currently set.
+    gc_sync_position();
+    if(settings_read_coord_data(gc_state.modal.coord_system.idx, &gc_state.modal.coord_system.xyz))
+        system_flag_wco_change();
+
+    sprintf(buf, "[MSG:Resuming SD file at line %u]\r\n", file.line + 1);
+    active_stream.write(buf);
+
+    spindle_sync(gc_state.modal.spindle, gc_state.spindle.rpm);
+    coolant_sync(gc_state.modal.coolant);
 }
 
 static int16_t sdcard_read (void)
 {
     int16_t c = -1;
+    uint_fast8_t eol = file.eol;
 
     if(file.eol == 1)
         file.line++;
@@ -303,6 +931,15 @@ static int16_t sdcard_read (void)
         if(sys.state == STATE_IDLE || (sys.state & (STATE_CYCLE|STATE_HOLD|STATE_CHECK_MODE)))
             c = file_read();
 
+        if(eol && file.eol == 0 && c != -1) { // First character of a line
+#if SDCARD_INDEX_INTERVAL
+            if(line_index && file.line == line_index->entries * SDCARD_INDEX_INTERVAL)
+                index_add(file.pos - 1);
+#endif
+            if(file.resume_line && file.line == file.resume_line)
+                resume_job();
+        }
+
         if(c == -1) { // EOF or error reading or grbl problem
             file_close();
             if(file.eol == 0) // Return newline if line was incorrectly terminated
@@ -315,6 +952,90 @@ static int16_t sdcard_read (void)
     return c;
 }
 
+#if defined(ENABLE_JOB_STATS) && SDCARD_JOB_LOG_SIZE
+
+/*
+  Each job is logged as a line of comma separated values: the name of the SD file run, if any, 1 when completed
+  or 0 when aborted, the number of alarms, run, motion and spindle-on time in seconds and distance per axis in m.
+  Lines are formatted into a RAM buffer when the job ends and appended to the log in a single f_write() when the
+  machine is idle and the card is mounted, so logging never blocks the main loop while in motion. Lines that do
+  not fit in the buffer are dropped and counted, the count is logged with the next line buffered. The buffer is
+  discarded if the log cannot be written.
+*/
+
+static struct {
+    uint_fast16_t length;
+    uint32_t dropped;
+    char data[SDCARD_JOB_LOG_SIZE];
+} job_log = {0};
+
+static void job_log_add (const job_counters_t *job)
+{
+    uint_fast8_t idx;
+    char line[50 + 7 * 11 + N_AXIS * 13];
+
+    strcpy(line, file.handle ? file.name : "");
+    strcat(line, job->jobs ? ",1," : ",0,");
+    strcat(line, uitoa(job->alarms));
+    strcat(line, ",");
+    strcat(line, uitoa(job->run_time));
+    strcat(line, ",");
+    strcat(line, uitoa(job->motion_time));
+    strcat(line, ",");
+    strcat(line, uitoa(job->spindle_time));
+    for(idx = 0; idx < N_AXIS; idx++) {
+        strcat(line, ",");
+        strcat(line, ftoa(job->distance[idx], 3));
+    }
+    if(job_log.dropped) {
+        strcat(line, ",dropped:");
+        strcat(line, uitoa(job_log.dropped));
+    }
+    strcat(line, "\n");
+
+    size_t length = strlen(line);
+
+    if(job_log.length + length <= SDCARD_JOB_LOG_SIZE) {
+        memcpy(&job_log.data[job_log.length], line, length);
+        job_log.length += length;
+        job_log.dropped = 0;
+    } else
+        job_log.dropped++;
+}
+
+static void job_log_flush (void)
+{
+    static FIL handle;
+
+    UINT bytes_written;
+
+    if(f_open(&handle, SDCARD_JOB_LOG, FA_WRITE|FA_OPEN_ALWAYS) == FR_OK) {
+        if(f_lseek(&handle, f_size(&handle)) == FR_OK)
+            f_write(&handle, job_log.data, job_log.length, &bytes_written);
+        f_close(&handle);
+    }
+
+    job_log.length = 0; // Not retried on failure, e.g. when the card has been removed.
+}
+
+#endif
+
+static void sdcard_execute_realtime (uint_fast16_t state)
+{
+#if defined(ENABLE_JOB_STATS) && SDCARD_JOB_LOG_SIZE
+    if(job_log.length && state == STATE_IDLE && file.fs)
+        job_log_flush();
+#endif
+#if SDCARD_CACHE_ENABLE
+    if(file.handle && file.cached) {
+        if(cache_has_room())
+            cache_fill();
+    } else
+#endif
+    if(file.handle && rdbuf.empty[rdbuf.current ^ 1])
+        buffer_fill(rdbuf.current ^ 1);
+}
+
 static int16_t await_cycle_start (void)
 {
     return -1;
@@ -355,9 +1076,13 @@ static message_code_t trap_feedback_message (message_code_t message_code)
 
     if(message_code == Message_ProgramEnd) {
         if(frewind) {
-            f_lseek(file.handle, 0);
-            file.pos = file.line = 0;
+            buffer_seek(0);
+            file.line = 0;
             file.eol = false;
+#ifdef ENABLE_BINARY_STREAM
+            if(compiled)
+                binary_stream_enable(true); // Clear delta state
+#endif
             report_feedback_message(Message_CycleStartToRerun);
             hal.stream.read = await_cycle_start;
             hal.state_change_requested = trap_state_change_request;
@@ -388,10 +1113,12 @@ static bool sdcard_suspend (bool suspend)
     if(suspend) {
         hal.stream.reset_read_buffer();
         hal.stream.read = active_stream.read;               // Restore normal stream input for tool change (jog etc)
+        hal.stream.read_block = active_stream.read_block;
         hal.stream.enqueue_realtime_command = active_stream.enqueue_realtime_command;
         hal.report.status_message = report_status_message;  // as well as normal status messages reporting
     } else {
         hal.stream.read = sdcard_read;                      // Resume reading from SD card
+        hal.stream.read_block = NULL;
         hal.stream.enqueue_realtime_command = drop_input_stream;
         hal.report.status_message = trap_status_report;     // and redirect status messages back to us
     }
@@ -400,19 +1127,387 @@ static bool sdcard_suspend (bool suspend)
 }
 #endif
 
+// Reads a line into buf, of LINE_BUFFER_SIZE, and strips whitespace and comments as the protocol line builder does.
+// Returns false at end of file, status is set for lines that cannot be compiled, or checked, messages only when compiling.
+static bool read_line (char *buf, char *eol, bool compile, uint32_t *line, status_code_t *status)
+{
+    static const char msg[] = "MSG,";
+
+    int16_t c;
+    uint_fast16_t length;
+    uint_fast8_t tracker;
+    bool comment, semicolon;
+
+    *status = Status_OK;
+
+    do {
+
+        length = tracker = 0;
+        comment = semicolon = false;
+
+        while((c = file_read()) != -1 && c != '\n' && c != '\r') {
+            if(semicolon)
+                continue;
+            if(comment) {
+                if(c == ')')
+                    comment = false;
+                else if(compile && tracker < sizeof(msg) - 1) {
+                    if(CAPS(c) != msg[tracker])
+                        tracker = sizeof(msg); // Not a message
+                    else if(++tracker == sizeof(msg) - 1)
+                        *status = Status_InvalidStatement; // Messages cannot be compiled.
+                }
+            } else if(c == '(') {
+                comment = true;
+                tracker = 0;
+            } else if(c == ';')
+                semicolon = true;
+            else if(c <= ' ')
+                continue;
+            else if(length == 0 && (c == '$' || c == '[' || c == '/'))
+                *status = Status_InvalidStatement; // System and user commands and block delete cannot be compiled.
+            else if(length == LINE_BUFFER_SIZE - 1)
+                *status = Status_Overflow;
+            else
+                buf[length++] = CAPS(c);
+        }
+
+        if(c == -1 && length == 0 && *status == Status_OK)
+            return false;
+
+        // Do not count the second character of a CRLF or LFCR pair as a line.
+        if(length == 0 && *status == Status_OK && *eol && *eol != c) {
+            *eol = '\0';
+            continue;
+        }
+
+        *eol = (char)c;
+        buf[length] = '\0';
+        (*line)++;
+
+        if(length == 1 && *buf == CMD_PROGRAM_DEMARCATION)
+            length = 0;
+
+    } while(length == 0 && *status == Status_OK);
+
+    return true;
+}
+
+/*
+  A file is verified with $FV=<filename> in check mode, the lines are read and executed by the parser one after
+  the other without the stream and line builder round trip. The motions are followed from mc_line() to check the
+  targets against the soft limits and are planned by the otherwise idle planner, the time of each block is taken
+  from its planned velocity profile when it leaves the buffer. Lines with system commands, user commands and block
+  delete are skipped.
+*/
+
+typedef struct {
+    char eol;
+    bool soft_limits;       // Soft limits are enabled, the core check is disabled while verifying
+    uint32_t line;
+    uint32_t errors;
+    uint32_t violations;
+    uint32_t reported;
+    status_code_t status;   // First error
+    float time;             // min
+    float peak_feed;        // mm/min
+    char buf[LINE_BUFFER_SIZE];
+} verifier_t;
+
+static verifier_t *verifier = NULL;
+
+static void verify_report (const char *what, uint_fast16_t code)
+{
+    if(verifier->reported++ < SDCARD_VERIFY_REPORT_MAX) {
+        char buf[60];
+        sprintf(buf, "[MSG:Line %u: %s %u]\r\n", (unsigned int)verifier->line, what, (unsigned int)code);
+        hal.stream.write(buf);
+    }
+}
+
+// Adds the execution time of the first planner block, accelerating from its entry speed towards the nominal
+// speed and decelerating to the entry speed of the next block, to the estimate and discards it.
+static void verify_discard_block (void)
+{
+    plan_block_t *block = plan_get_current_block();
+
+    float entry_speed_sqr = block->entry_speed_sqr, exit_speed_sqr = plan_get_exec_block_exit_speed_sqr(),
+          nominal_speed = plan_compute_profile_nominal_speed(block), nominal_speed_sqr = nominal_speed * nominal_speed,
+          accel_dist = (nominal_speed_sqr - entry_speed_sqr) * block->inv_2_accel,
+          decel_dist = (nominal_speed_sqr - exit_speed_sqr) * block->inv_2_accel;
+
+    if(nominal_speed > 0.0f) {
+        if(accel_dist + decel_dist < block->millimeters) // Trapezoid, cruising at nominal speed.
+            verifier->time += (2.0f * nominal_speed - sqrtf(entry_speed_sqr) - sqrtf(exit_speed_sqr)) / block->acceleration +
+                               (block->millimeters - accel_dist - decel_dist) / nominal_speed;
+        else { // Triangle, decelerating from the speed reached halfway through the ramps.
+            float peak_speed = sqrtf(0.5f * (entry_speed_sqr + exit_speed_sqr) + block->acceleration * block->millimeters);
+            verifier->time += (2.0f * peak_speed - sqrtf(entry_speed_sqr) - sqrtf(exit_speed_sqr)) / block->acceleration;
+        }
+        if(!block->condition.rapid_motion)
+            verifier->peak_feed = max(verifier->peak_feed, nominal_speed);
+    }
+
+    plan_discard_current_block();
+}
+
+static void verify_motion (float *target, plan_line_data_t *pl_data)
+{
+    if(!pl_data->condition.jog_motion) {
+
+        // The planner gets a copy, the message and output commands stay with the parser.
+        float position[N_AXIS];
+        plan_line_data_t plan_data;
+
+        memcpy(position, target, sizeof(position));
+        memcpy(&plan_data, pl_data, sizeof(plan_line_data_t));
+        plan_data.message = NULL;
+        plan_data.output_commands = NULL;
+#ifdef ENABLE_RASTER_ROWS
+        plan_data.raster = NULL;
+#endif
+
+        if(plan_check_full_buffer())
+            verify_discard_block();
+
+        plan_buffer_line(position, &plan_data);
+    }
+
+    if(verifier->soft_limits && !system_check_travel_limits(target)) {
+        if(verifier->violations++ == 0 && verifier->status == Status_OK)
+            verifier->status = Status_SoftLimitError;
+        verify_report("soft limit", Alarm_SoftLimit);
+    }
+}
+
+// Verifies filename at full speed, must be run in check mode.
+static status_code_t sdcard_verify (char *filename)
+{
+    char buf[100];
+    status_code_t status = Status_OK, line_status;
+
+    if(sys.state != STATE_CHECK_MODE)
+        return Status_IdleError;
+
+    if((verifier = calloc(1, sizeof(verifier_t))) == NULL)
+        return Status_SDReadError;
+
+    if(!file_open(filename)) {
+        free(verifier);
+        verifier = NULL;
+        return Status_SDReadError;
+    }
+
+    // Start planning from the parser position, the planner is not kept up to date in check mode.
+    plan_line_data_t plan_data;
+    float position[N_AXIS];
+
+    memset(&plan_data, 0, sizeof(plan_line_data_t));
+    memcpy(position, gc_state.position, sizeof(position));
+    plan_data.condition.rapid_motion = On;
+
+    plan_reset();
+    plan_sync_position();
+    if(plan_buffer_line(position, &plan_data))
+        plan_discard_current_block();
+
+    if((verifier->soft_limits = settings.limits.flags.soft_enabled))
+        settings.limits.flags.soft_enabled = Off; // Violations are counted rather than raising an alarm.
+
+    hook_enable(Hook_CheckModeMotion, (hook_fn_t){ .check_mode_motion = verify_motion }, true);
+
+    while(read_line(verifier->buf, &verifier->eol, false, &verifier->line, &line_status)) {
+
+        if(!protocol_execute_realtime()) {
+            status = Status_Reset;
+            break;
+        }
+
+        if(line_status == Status_OK)
+            line_status = gc_execute_block(verifier->buf, NULL);
+        else if(line_status == Status_InvalidStatement)
+            continue; // Not checked.
+
+        if(line_status != Status_OK) {
+            if(verifier->errors++ == 0 && verifier->status == Status_OK)
+                verifier->status = line_status;
+            verify_report("error", line_status);
+        }
+    }
+
+    hook_enable(Hook_CheckModeMotion, (hook_fn_t){ .check_mode_motion = verify_motion }, false);
+
+    while(plan_get_current_block())
+        verify_discard_block();
+
+    plan_reset();
+    plan_sync_position();
+
+    if(verifier->soft_limits)
+        settings.limits.flags.soft_enabled = On;
+
+    file_close();
+
+    if(status == Status_OK) {
+        sprintf(buf, "[VERIFY:%u,%u,%u,%u,%u]\r\n", (unsigned int)verifier->line, (unsigned int)verifier->errors,
+                      (unsigned int)verifier->violations, (unsigned int)lroundf(verifier->time * 60.0f),
+                       (unsigned int)lroundf(verifier->peak_feed));
+        hal.stream.write(buf);
+        status = verifier->status;
+    }
+
+    free(verifier);
+    verifier = NULL;
+
+    return status;
+}
+
+#ifdef ENABLE_BINARY_STREAM
+
+/*
+  A compiled job is a file of binary frames, see grbl/binary_stream.c, with the blocks of a G-code file
+  validated in check mode. Playback streams the frames as any other file with binary frames enabled,
+  blocks are thus executed without being passed through the line builder and number conversion.
+  Lines with system commands, user commands, block delete or messages cannot be compiled.
+*/
+
+typedef struct {
+    FIL handle;
+    char eol;
+    binary_encoder_t encoder;
+    char line[LINE_BUFFER_SIZE];
+    char frame[LINE_BUFFER_SIZE + 4];
+    gc_word_t words[BINARY_BLOCK_MAX_WORDS + 1];
+} compiler_t;
+
+static bool is_compiled (char *filename)
+{
+    char *ftptr = strrchr(filename, '.');
+
+    return ftptr && LCAPS(ftptr[1]) == 'g' && LCAPS(ftptr[2]) == 'c' && LCAPS(ftptr[3]) == 'b' && ftptr[4] == '\0';
+}
+
+static bool write_frame (compiler_t *compiler)
+{
+    UINT count, length = binary_encoder_write_frame(&compiler->encoder, compiler->frame);
+
+    return length == 0 || (f_write(&compiler->handle, compiler->frame, length, &count) == FR_OK && count == length);
+}
+
+// Compiles filename to a file with the same name and file type gcb, must be run in check mode.
+static status_code_t sdcard_compile (char *filename)
+{
+    char outname[MAX_PATHLEN];
+    uint32_t line = 0;
+    status_code_t status = Status_OK;
+    compiler_t *compiler;
+
+    if(sys.state != STATE_CHECK_MODE)
+        return Status_IdleError;
+
+    if(is_compiled(filename) || !set_file_type(outname, filename, "gcb"))
+        return Status_InvalidStatement;
+
+    if((compiler = malloc(sizeof(compiler_t))) == NULL)
+        return Status_SDWriteError;
+
+    if(!file_open(filename)) {
+        free(compiler);
+        return Status_SDReadError;
+    }
+
+    if(f_open(&compiler->handle, outname, FA_WRITE|FA_CREATE_ALWAYS) != FR_OK) {
+        file_close();
+        free(compiler);
+        return Status_SDWriteError;
+    }
+
+    compiler->eol = '\0';
+    binary_encoder_init(&compiler->encoder);
+
+    while(status == Status_OK && read_line(compiler->line, &compiler->eol, true, &line, &status)) {
+
+        if(status != Status_OK)
+            break;
+
+        if((status = binary_encoder_add_block(&compiler->encoder, compiler->line, compiler->words)) == Status_Overflow) {
+            if(!write_frame(compiler))
+                status = Status_SDWriteError;
+            else // Block is too long for a frame if this fails.
+                status = binary_encoder_add_block(&compiler->encoder, compiler->line, compiler->words);
+        }
+
+        if(status == Status_OK)
+            status = protocol_execute_realtime() ? gc_execute_words(compiler->words, NULL, NULL) : Status_Reset;
+    }
+
+    if(status == Status_OK && !write_frame(compiler))
+        status = Status_SDWriteError;
+
+    f_close(&compiler->handle);
+    file_close();
+    free(compiler);
+    sdcard_dir_changed();
+
+    if(status != Status_OK) {
+        f_unlink(outname);
+        if(status != Status_Reset) {
+            char buf[50];
+            sprintf(buf, "[MSG:Compile failed at line %u]\r\n", line);
+            hal.stream.write(buf);
+        }
+    }
+
+    return status;
+}
+
+#endif
+
+// Terminates the filename in args and gets the line number from an optional L<line> argument, 0 if not present.
+static bool get_resume_line (char *args, uint32_t *line)
+{
+    *line = 0;
+
+    if((args = strchr(args, ' ')) == NULL)
+        return true;
+
+    *args++ = '\0';
+
+    while(*args == ' ')
+        args++;
+
+    if(LCAPS(*args) != 'l' || *++args == '\0')
+        return false;
+
+    while(*args >= '0' && *args <= '9' && *line < 0x0FFFFFFF)
+        *line = *line * 10 + *args++ - '0';
+
+    return *args == '\0';
+}
+
 static status_code_t sdcard_parse (uint_fast16_t state, char *line, char *lcline)
 {
+    uint32_t resume;
     status_code_t retval = Status_Unhandled;
 
     if(line[1] == 'F') switch(line[2]) {
 
         case '\0':
             frewind = false;
-            retval = sdcard_ls(line); // (re)use line buffer for reporting filenames
+            retval = sdcard_ls(line, 0, 0, NULL); // (re)use line buffer for reporting filenames
+            break;
+
+        case 'L':
+            frewind = false;
+            if(line[3] == '\0' || line[3] == '=')
+                retval = sdcard_ls_page(line, line[3] == '\0' ? &line[3] : &lcline[4]); // (re)use line buffer for reporting filenames
+            else
+                retval = Status_InvalidStatement;
             break;
 
         case 'M':
             frewind = false;
+            sdcard_dir_changed();
             retval = sdcard_mount() ? Status_OK : Status_SDMountError;
             break;
 
@@ -421,9 +1516,25 @@ static status_code_t sdcard_parse (uint_fast16_t state, char *line, char *lcline
             retval = Status_OK;
             break;
 
+#ifdef ENABLE_BINARY_STREAM
+        case 'C':
+            frewind = false;
+            retval = line[3] == '=' ? sdcard_compile(&lcline[4]) : Status_InvalidStatement;
+            break;
+#endif
+
+        case 'V':
+            frewind = false;
+            retval = line[3] == '=' ? sdcard_verify(&lcline[4]) : Status_InvalidStatement;
+            break;
+
         case '=':
             if (!(state == STATE_IDLE || state == STATE_CHECK_MODE))
                 retval = Status_SystemGClock;
+            else if(!get_resume_line(&lcline[3], &resume))
+                retval = Status_InvalidStatement;
+            else if(resume > 1 && state != STATE_IDLE)
+                retval = Status_IdleError;
             else {
                 if(file_open(&lcline[3])) {
                     gc_state.last_error = Status_OK;                            // Start with no errors
@@ -431,6 +1542,7 @@ static status_code_t sdcard_parse (uint_fast16_t state, char *line, char *lcline
                     memcpy(&active_stream, &hal.stream, sizeof(io_stream_t));   // Save current stream pointers
                     hal.stream.type = StreamType_SDCard;                        // then redirect to read from SD card instead
                     hal.stream.read = sdcard_read;                              // ...
+                    hal.stream.read_block = NULL;                               // ...
                     hal.stream.enqueue_realtime_command = drop_input_stream;    // Drop input from current stream except realtime commands
 #if M6_ENABLE
                     hal.stream.suspend_read = sdcard_suspend;                   // ...
@@ -440,6 +1552,24 @@ static status_code_t sdcard_parse (uint_fast16_t state, char *line, char *lcline
                     hal.driver_rt_report = sdcard_report;                       // Add percent complete to real time report
                     hal.report.status_message = trap_status_report;             // Redirect status message and feedback message
                     hal.report.feedback_message = trap_feedback_message;        // reports here
+#ifdef ENABLE_BINARY_STREAM
+                    if((compiled = is_compiled(file.name))) {
+                        binary_enabled = binary_stream_enabled();
+                        binary_stream_enable(true);                             // Compiled jobs are streamed as binary frames
+                    } else
+#endif
+                    {
+#if SDCARD_INDEX_INTERVAL
+                        index_open(&lcline[3]);                                 // Open or create line index
+                        if(resume > 1)
+                            index_seek(resume - 1);                             // and skip ahead if resuming.
+#endif
+                        if(resume > 1 && file.line < resume - 1) {
+                            file.resume_line = resume - 1;                      // Execute preceding lines in check mode
+                            set_state(STATE_CHECK_MODE);
+                        } else if(resume > 1)
+                            resume_job();
+                    }
                     retval = Status_OK;
                 } else
                     retval = Status_SDReadError;
@@ -472,6 +1602,11 @@ void sdcard_init (void)
 {
     driver_reset = hal.driver_reset;
     hal.driver_reset = sdcard_reset;
+    hook_register(Hook_ExecuteRealtime, (hook_fn_t){ .execute_realtime = sdcard_execute_realtime }, 10, true);
+    hook_register(Hook_CheckModeMotion, (hook_fn_t){ .check_mode_motion = verify_motion }, 10, false);
+#if defined(ENABLE_JOB_STATS) && SDCARD_JOB_LOG_SIZE
+    hook_register(Hook_JobEnd, (hook_fn_t){ .job_end = job_log_add }, 10, true);
+#endif
     hal.driver_sys_command_execute = sdcard_parse;
 }
 
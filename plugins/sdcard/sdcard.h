@@ -34,6 +34,11 @@
 
 #if SDCARD_ENABLE
 
+// RAM file cache for large RAM targets, storage is supplied by the driver with sdcard_cache_attach().
+#ifndef SDCARD_CACHE_ENABLE
+#define SDCARD_CACHE_ENABLE 0
+#endif
+
 #ifdef __MSP432E401Y__
 #include "fatfs/ff.h"
 #include "fatfs/diskio.h"
@@ -54,6 +59,13 @@
 
 void sdcard_init (void);
 FATFS *sdcard_getfs(void);
+void sdcard_dir_changed (void);
+
+#if SDCARD_CACHE_ENABLE
+bool sdcard_cache_attach (void *data, size_t size);
+void *sdcard_cache_claim (size_t *size);
+void sdcard_cache_release (const char *filename, size_t length);
+#endif
 
 #endif // SDCARD_ENABLE
 
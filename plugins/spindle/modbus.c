@@ -0,0 +1,198 @@
+/*
+  modbus.c - non-blocking Modbus RTU master, requests are queued and processed from the realtime loop
+
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "modbus.h"
+
+#if MODBUS_ENABLE
+
+#include <string.h>
+
+#ifdef ARDUINO
+#include "../grbl/grbl.h"
+#else
+#include "grbl/grbl.h"
+#endif
+
+/*
+  Requests are sent one at a time from a ring queue. The response is collected by polling the driver serial
+  input buffer from the realtime loop, a request is resent on timeout or CRC error and the callbacks are called
+  when it completes. Nothing here waits on the bus, a round-trip takes a number of realtime loop passes.
+*/
+
+typedef enum {
+    ModBus_Idle = 0,
+    ModBus_AwaitReply,
+    ModBus_Silent
+} modbus_state_t;
+
+typedef struct {
+    modbus_message_t msg;
+    const modbus_callbacks_t *callbacks;
+} queue_entry_t;
+
+static struct {
+    modbus_state_t state;
+    uint_fast8_t retries;
+    uint_fast8_t rx_count;
+    uint32_t timestamp;                 // ms, when the request was sent or the response received
+    volatile uint_fast8_t head;
+    volatile uint_fast8_t tail;
+    queue_entry_t queue[MODBUS_QUEUE_LENGTH];
+    uint8_t rx_buffer[MODBUS_MAX_ADU_SIZE + 2];
+} modbus = {0};
+
+static const modbus_stream_t *stream = NULL;
+
+static uint16_t modbus_crc16 (const uint8_t *buf, uint_fast8_t length)
+{
+    uint16_t crc = 0xFFFF;
+
+    while(length--) {
+        crc ^= *buf++;
+        uint_fast8_t bits = 8;
+        do {
+            crc = crc & 1 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        } while(--bits);
+    }
+
+    return crc;
+}
+
+static void modbus_transmit (void)
+{
+    queue_entry_t *entry = &modbus.queue[modbus.tail];
+
+    stream->flush_rx_buffer();
+    stream->write((const char *)entry->msg.adu, entry->msg.tx_length + 2);
+
+    modbus.rx_count = 0;
+    modbus.timestamp = hal.get_elapsed_ticks();
+    modbus.state = ModBus_AwaitReply;
+}
+
+// Removes the current request from the queue and calls its callback, ok is false on timeout or exception.
+static void modbus_complete (bool ok, uint8_t exception)
+{
+    queue_entry_t *entry = &modbus.queue[modbus.tail];
+
+    modbus.timestamp = hal.get_elapsed_ticks();
+    modbus.state = ModBus_Silent;
+
+    if(ok) {
+        memcpy(entry->msg.adu, modbus.rx_buffer, entry->msg.rx_length);
+        if(entry->callbacks && entry->callbacks->on_rx_packet)
+            entry->callbacks->on_rx_packet(&entry->msg);
+    } else if(entry->callbacks && entry->callbacks->on_rx_exception)
+        entry->callbacks->on_rx_exception(exception, entry->msg.context);
+
+    modbus.tail = (modbus.tail + 1) & (MODBUS_QUEUE_LENGTH - 1);
+}
+
+static void modbus_retry (void)
+{
+    if(modbus.retries--)
+        modbus_transmit();
+    else
+        modbus_complete(false, ModBus_Timeout);
+}
+
+static void modbus_poll (uint_fast16_t state)
+{
+    int16_t c;
+    uint32_t ms = hal.get_elapsed_ticks();
+
+    switch(modbus.state) {
+
+        case ModBus_Silent:
+            if(ms - modbus.timestamp < MODBUS_SILENCE)
+                break;
+            modbus.state = ModBus_Idle;
+            // no break
+
+        case ModBus_Idle:
+            if(modbus.tail != modbus.head) {
+                modbus.retries = MODBUS_RETRIES;
+                modbus_transmit();
+            }
+            break;
+
+        case ModBus_AwaitReply:
+            {
+                queue_entry_t *entry = &modbus.queue[modbus.tail];
+                uint_fast8_t length = entry->msg.rx_length + 2;
+
+                while(modbus.rx_count < length && (c = stream->read()) != -1) {
+                    modbus.rx_buffer[modbus.rx_count++] = (uint8_t)c;
+                    // An exception response is the server address, the function code with bit 7 set and the exception code.
+                    if(modbus.rx_count == 2 && (modbus.rx_buffer[1] & 0x80))
+                        length = 5;
+                }
+
+                if(modbus.rx_count == length) {
+                    uint16_t crc = modbus_crc16(modbus.rx_buffer, length - 2);
+                    if(modbus.rx_buffer[length - 2] != (crc & 0xFF) || modbus.rx_buffer[length - 1] != (crc >> 8) ||
+                        modbus.rx_buffer[0] != entry->msg.adu[0])
+                        modbus_retry();
+                    else
+                        modbus_complete(length != 5, length == 5 ? modbus.rx_buffer[2] : 0);
+                } else if(ms - modbus.timestamp >= MODBUS_TIMEOUT)
+                    modbus_retry();
+            }
+            break;
+    }
+}
+
+bool modbus_send (modbus_message_t *msg, const modbus_callbacks_t *callbacks)
+{
+    uint_fast8_t bptr = (modbus.head + 1) & (MODBUS_QUEUE_LENGTH - 1);
+
+    if(bptr == modbus.tail || msg->tx_length > MODBUS_MAX_ADU_SIZE - 2 || msg->rx_length > MODBUS_MAX_ADU_SIZE)
+        return false;
+
+    queue_entry_t *entry = &modbus.queue[modbus.head];
+    uint16_t crc = modbus_crc16(msg->adu, msg->tx_length);
+
+    memcpy(&entry->msg, msg, sizeof(modbus_message_t));
+    entry->msg.adu[msg->tx_length] = crc & 0xFF;
+    entry->msg.adu[msg->tx_length + 1] = crc >> 8;
+    entry->callbacks = callbacks;
+
+    modbus.head = bptr;
+
+    return true;
+}
+
+bool modbus_isidle (void)
+{
+    return modbus.tail == modbus.head && modbus.state != ModBus_AwaitReply;
+}
+
+bool modbus_init (const modbus_stream_t *port)
+{
+    if(port == NULL || port->write == NULL || port->read == NULL || hal.get_elapsed_ticks == NULL)
+        return false;
+
+    stream = port;
+
+    return hook_register(Hook_ExecuteRealtime, (hook_fn_t){ .execute_realtime = modbus_poll }, 5, true);
+}
+
+#endif
@@ -0,0 +1,97 @@
+/*
+  modbus.h - non-blocking Modbus RTU master, requests are queued and processed from the realtime loop
+
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _MODBUS_H_
+#define _MODBUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ARDUINO
+#include "../../driver.h"
+#else
+#include "driver.h"
+#endif
+
+#if MODBUS_ENABLE
+
+#ifndef MODBUS_QUEUE_LENGTH
+#define MODBUS_QUEUE_LENGTH 8 // must be a power of 2
+#endif
+#ifndef MODBUS_TIMEOUT
+#define MODBUS_TIMEOUT 50 // ms, response timeout
+#endif
+#ifndef MODBUS_RETRIES
+#define MODBUS_RETRIES 2  // number of resends after a timeout or a CRC error
+#endif
+#ifndef MODBUS_SILENCE
+#define MODBUS_SILENCE 2  // ms, min. bus idle time between a response and the next request
+#endif
+
+#define MODBUS_MAX_ADU_SIZE 16 // max request/response length without the CRC
+
+typedef enum {
+    ModBus_ReadCoils = 1,
+    ModBus_ReadDiscreteInputs = 2,
+    ModBus_ReadHoldingRegisters = 3,
+    ModBus_ReadInputRegisters = 4,
+    ModBus_WriteCoil = 5,
+    ModBus_WriteRegister = 6
+} modbus_function_t;
+
+// ModBus_Timeout is reported when no valid response was received after MODBUS_RETRIES resends,
+// else the exception code returned by the server.
+#define ModBus_Timeout 0
+
+typedef struct {
+    void *context;                      // passed to the callbacks, e.g. to identify the request
+    uint8_t tx_length;                  // request length without the CRC
+    uint8_t rx_length;                  // expected response length without the CRC
+    uint8_t adu[MODBUS_MAX_ADU_SIZE];   // request, the response when a callback is called
+} modbus_message_t;
+
+typedef struct {
+    void (*on_rx_packet)(modbus_message_t *msg);
+    void (*on_rx_exception)(uint8_t code, void *context);
+} modbus_callbacks_t;
+
+// Serial port provided by the driver. Transmission must be interrupt or DMA driven as write() is called
+// from the realtime loop and must not wait for the characters to be sent. RS485 direction control, if
+// required, is handled by the driver, e.g. from the transmit complete interrupt.
+typedef struct {
+    void (*write)(const char *s, uint16_t length);
+    int16_t (*read)(void);              // returns -1 if no character is available
+    void (*flush_rx_buffer)(void);
+} modbus_stream_t;
+
+// Queues a request, the CRC is added. The callbacks are called from the realtime loop when the response
+// has been received or all retries have failed. Returns false if the queue is full.
+bool modbus_send (modbus_message_t *msg, const modbus_callbacks_t *callbacks);
+
+// Returns true if no requests are queued or pending.
+bool modbus_isidle (void);
+
+// Sets the serial port used and registers the request processing with the realtime loop.
+bool modbus_init (const modbus_stream_t *stream);
+
+#endif
+
+#endif
@@ -0,0 +1,271 @@
+/*
+  vfd_spindle.c - Modbus RTU VFD spindle, state is cached and updated asynchronously
+
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "vfd_spindle.h"
+
+#if VFD_ENABLE
+
+#include <math.h>
+
+#ifdef ARDUINO
+#include "../grbl/grbl.h"
+#else
+#include "grbl/grbl.h"
+#endif
+
+/*
+  The spindle HAL entry points only update the programmed state and flag it for sending, the Modbus requests
+  are queued from the realtime loop. The output frequency is read back every VFD_POLL_INTERVAL ms and cached,
+  hal.spindle_get_state() and hal.spindle_get_data() return the cached state so the realtime report and the
+  at speed wait in spindle_sync() never wait on the bus. At speed is only reported from a read back taken
+  after the last programmed state has been acknowledged by the VFD.
+
+  If the VFD does not respond to a command, or to the read back while the spindle is on, motion is aborted
+  and alarm 14 raised.
+*/
+
+typedef enum {
+    VFD_Control = 0,
+    VFD_Frequency,
+    VFD_Status
+} vfd_request_t;
+
+static struct {
+    volatile spindle_state_t state; // programmed state
+    volatile float rpm;             // programmed RPM
+    volatile bool update_control;
+    volatile bool update_rpm;
+    volatile uint32_t seq;          // incremented on each programmed change
+    uint_fast8_t busy;              // requests queued and not completed, bit per vfd_request_t
+    uint32_t status_seq;            // seq when the pending read back was queued
+    bool status_valid;              // no commands were waiting to be queued ahead of the pending read back
+    uint32_t poll_ms;               // ms at last read back request
+    float rpm_measured;
+    bool fresh;                     // rpm_measured is read after the last change was acknowledged
+    bool alarm;
+} vfd = {0};
+
+static driver_reset_ptr driver_reset;
+static void (*settings_changed)(settings_t *settings);
+
+static void vfd_rx_packet (modbus_message_t *msg);
+static void vfd_rx_exception (uint8_t code, void *context);
+
+static const modbus_callbacks_t callbacks = {
+    .on_rx_packet = vfd_rx_packet,
+    .on_rx_exception = vfd_rx_exception
+};
+
+static bool vfd_send (vfd_request_t request, uint16_t value)
+{
+    uint16_t reg = request == VFD_Control ? VFD_CONTROL_REGISTER : (request == VFD_Frequency ? VFD_FREQUENCY_REGISTER : VFD_OUTPUT_REGISTER);
+    modbus_message_t msg = {
+        .context = (void *)(uintptr_t)request,
+        .tx_length = 6,
+        .rx_length = request == VFD_Status ? 5 : 6,
+        .adu[0] = VFD_ADDRESS,
+        .adu[1] = request == VFD_Status ? ModBus_ReadHoldingRegisters : ModBus_WriteRegister,
+        .adu[2] = reg >> 8,
+        .adu[3] = reg & 0xFF,
+        .adu[4] = value >> 8,
+        .adu[5] = value & 0xFF
+    };
+
+    if(modbus_send(&msg, &callbacks))
+        vfd.busy |= bit(request);
+
+    return (vfd.busy & bit(request)) != 0;
+}
+
+static void vfd_failed (void)
+{
+    if(!vfd.alarm) {
+        vfd.alarm = true;
+        if(!(sys.state & (STATE_ALARM|STATE_ESTOP)))
+            mc_reset();
+        system_set_exec_alarm(Alarm_Spindle);
+    }
+}
+
+static void vfd_rx_packet (modbus_message_t *msg)
+{
+    vfd_request_t request = (vfd_request_t)(uintptr_t)msg->context;
+
+    vfd.busy &= ~bit(request);
+
+    if(request == VFD_Status) {
+        vfd.rpm_measured = (float)((msg->adu[3] << 8) | msg->adu[4]) * VFD_RPM_PER_UNIT;
+        vfd.fresh = vfd.status_valid && vfd.status_seq == vfd.seq;
+    }
+}
+
+static void vfd_rx_exception (uint8_t code, void *context)
+{
+    vfd_request_t request = (vfd_request_t)(uintptr_t)context;
+
+    vfd.busy &= ~bit(request);
+
+    if(request != VFD_Status || vfd.state.on)
+        vfd_failed();
+}
+
+// Queues pending commands and the periodic read back, called from the realtime loop.
+static void vfd_poll (uint_fast16_t state)
+{
+    uint32_t ms;
+
+    // The frequency is set before the VFD is started, and after it has been stopped.
+    if(vfd.update_control && !(vfd.busy & bit(VFD_Control)) && !(vfd.state.on && vfd.update_rpm)) {
+        vfd.update_control = false;
+        if(!vfd_send(VFD_Control, vfd.state.on ? (vfd.state.ccw ? VFD_CONTROL_REV : VFD_CONTROL_FWD) : VFD_CONTROL_STOP))
+            vfd.update_control = true;
+    }
+
+    if(vfd.update_rpm && !(vfd.busy & bit(VFD_Frequency))) {
+        vfd.update_rpm = false;
+        if(!vfd_send(VFD_Frequency, (uint16_t)lroundf(vfd.rpm / VFD_RPM_PER_UNIT)))
+            vfd.update_rpm = true;
+    }
+
+    if(!(vfd.busy & bit(VFD_Status)) && ((ms = hal.get_elapsed_ticks()) - vfd.poll_ms >= VFD_POLL_INTERVAL)) {
+        uint32_t seq = vfd.seq;
+        if(vfd_send(VFD_Status, 1)) {
+            vfd.poll_ms = ms;
+            // The read back is only valid for the programmed state if the commands are queued ahead of it.
+            vfd.status_seq = seq;
+            vfd.status_valid = !(vfd.update_control || vfd.update_rpm);
+        }
+    }
+}
+
+static void vfdUpdateRPM (float rpm)
+{
+    if(rpm != vfd.rpm) {
+        vfd.rpm = rpm;
+        vfd.update_rpm = true;
+        vfd.seq++;
+    }
+}
+
+static void vfdSetState (spindle_state_t state, float rpm)
+{
+    if(state.on != vfd.state.on || (state.on && state.ccw != vfd.state.ccw)) {
+        vfd.state.on = state.on;
+        vfd.state.ccw = state.ccw;
+        vfd.update_control = true;
+        vfd.seq++;
+    }
+
+    vfdUpdateRPM(state.on ? rpm : 0.0f);
+}
+
+static spindle_state_t vfdGetState (void)
+{
+    spindle_state_t state = {0};
+
+    state.on = vfd.state.on;
+    state.ccw = vfd.state.ccw;
+    state.at_speed = vfd.fresh && fabsf(vfd.rpm_measured - vfd.rpm) <= vfd.rpm * (VFD_AT_SPEED_TOLERANCE / 100.0f);
+
+    return state;
+}
+
+static spindle_data_t vfdGetData (spindle_data_request_t request)
+{
+    spindle_data_t data = {0};
+
+    data.rpm = vfd.rpm_measured;
+    data.rpm_programmed = vfd.rpm;
+    data.state_programmed = vfd.state;
+
+    return data;
+}
+
+#ifdef SPINDLE_PWM_DIRECT
+
+// The core passes PWM values to the spindle when the RPM is changed from the stepper, here the value is the RPM.
+static uint_fast16_t vfdGetPWM (float rpm)
+{
+    return (uint_fast16_t)rpm;
+}
+
+static void vfdUpdatePWM (uint_fast16_t pwm)
+{
+    vfdUpdateRPM((float)pwm);
+}
+
+#endif
+
+static void vfd_set_hal (void)
+{
+    hal.spindle_set_state = vfdSetState;
+    hal.spindle_get_state = vfdGetState;
+    hal.spindle_get_data = vfdGetData;
+    hal.spindle_reset_data = NULL;
+#ifdef SPINDLE_PWM_DIRECT
+    hal.spindle_get_pwm = vfdGetPWM;
+    hal.spindle_update_pwm = vfdUpdatePWM;
+#else
+    hal.spindle_update_rpm = vfdUpdateRPM;
+#endif
+}
+
+// The driver may reassign the spindle entry points when settings change.
+static void vfd_settings_changed (settings_t *settings)
+{
+    if(settings_changed)
+        settings_changed(settings);
+
+    vfd_set_hal();
+}
+
+static void vfd_reset (void)
+{
+    vfd.alarm = false;
+
+    driver_reset();
+}
+
+bool vfd_spindle_init (const modbus_stream_t *stream)
+{
+    if(!(modbus_init(stream) && hook_register(Hook_ExecuteRealtime, (hook_fn_t){ .execute_realtime = vfd_poll }, 4, true)))
+        return false;
+
+    settings_changed = hal.settings_changed;
+    hal.settings_changed = vfd_settings_changed;
+
+    driver_reset = hal.driver_reset;
+    hal.driver_reset = vfd_reset;
+
+    hal.driver_cap.variable_spindle = On;
+    hal.driver_cap.spindle_dir = On;
+    hal.driver_cap.spindle_at_speed = On;
+    hal.driver_cap.spindle_sync = Off;
+    hal.driver_cap.spindle_pid = Off;
+
+    vfd_set_hal();
+
+    vfd.update_control = true; // Send stop on startup.
+
+    return true;
+}
+
+#endif
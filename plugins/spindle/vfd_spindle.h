@@ -0,0 +1,71 @@
+/*
+  vfd_spindle.h - Modbus RTU VFD spindle, state is cached and updated asynchronously
+
+  Part of GrblHAL
+
+  Copyright (c) 2020 Terje Io
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _VFD_SPINDLE_H_
+#define _VFD_SPINDLE_H_
+
+#include "modbus.h"
+
+#if VFD_ENABLE
+
+#if !MODBUS_ENABLE
+#error "VFD spindle requires MODBUS_ENABLE!"
+#endif
+
+// Register map, defaults are for Delta VFD-E series drives. Set to match the VFD manual.
+#ifndef VFD_ADDRESS
+#define VFD_ADDRESS 1
+#endif
+#ifndef VFD_CONTROL_REGISTER
+#define VFD_CONTROL_REGISTER 0x2000
+#endif
+#ifndef VFD_CONTROL_FWD
+#define VFD_CONTROL_FWD 0x0012  // run forward
+#endif
+#ifndef VFD_CONTROL_REV
+#define VFD_CONTROL_REV 0x0022  // run reverse
+#endif
+#ifndef VFD_CONTROL_STOP
+#define VFD_CONTROL_STOP 0x0001
+#endif
+#ifndef VFD_FREQUENCY_REGISTER
+#define VFD_FREQUENCY_REGISTER 0x2001   // frequency command
+#endif
+#ifndef VFD_OUTPUT_REGISTER
+#define VFD_OUTPUT_REGISTER 0x2103      // output frequency, read back as the spindle RPM
+#endif
+#ifndef VFD_RPM_PER_UNIT
+#define VFD_RPM_PER_UNIT 0.6f   // RPM per frequency register unit, 0.01 Hz units and a 2-pole spindle
+#endif
+
+#ifndef VFD_POLL_INTERVAL
+#define VFD_POLL_INTERVAL 100   // ms, RPM read back interval
+#endif
+#ifndef VFD_AT_SPEED_TOLERANCE
+#define VFD_AT_SPEED_TOLERANCE 5.0f // percent of programmed RPM
+#endif
+
+// Sets the serial port used and replaces the spindle HAL entry points, call from driver_init().
+bool vfd_spindle_init (const modbus_stream_t *stream);
+
+#endif
+
+#endif
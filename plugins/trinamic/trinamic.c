@@ -46,22 +46,37 @@
 
 static bool warning = false, is_homing = false;
 static volatile uint_fast16_t diag1_poll = 0;
+static bool sg_status_active = false; // report_sg_status() subscribed to Hook_ExecuteRealtime
 static char sbuf[65]; // string buffer for reports
 static TMC2130_t stepper[N_AXIS];
 static axes_signals_t homing = {0}, otpw_triggered = {0};
 static limits_get_state_ptr limits_get_state = NULL;
-static void (*hal_stepper_pulse_start)(stepper_t *stepper) = NULL;
-static void (*hal_execute_realtime)(uint_fast16_t state) = NULL;
 static struct {
     axes_signals_t axes;
     bool raw;
     bool sg_status_enable;
-    volatile bool sg_status;
     bool sfilt;
     uint32_t sg_status_axis;
-    uint32_t msteps;
+    uint32_t sg_interval;
 } report = {0};
 
+// DRV_STATUS reads requested by realtime hooks, one driver at a time. The shadow registers are
+// the status cache, with TRINAMIC_ASYNC_IO they are written by the transfer interrupt.
+static struct {
+    axes_signals_t request;
+    volatile axes_signals_t fresh;  // Reads completed
+    volatile bool busy;             // Queued read in progress
+    uint_fast8_t axis;
+    uint32_t last_ms;
+} status_poll = {0};
+
+// stallGuard samples of the reported axes, written as one line when TRINAMIC_SG_BATCH samples are collected.
+static struct {
+    uint_fast8_t count;
+    uint32_t ms;                                // Time of first sample
+    uint16_t sg_result[TRINAMIC_SG_BATCH][N_AXIS];
+} sg_samples = {0};
+
 #if TRINAMIC_DEV
 static TMC2130_datagram_t *reg_ptr = NULL;
 #endif
@@ -77,6 +92,61 @@ TMCI2C_monitor_status_dgr_t dgr_monitor = {
 #endif
 
 static void write_debug_report (void);
+static void homing_calibrate (parser_block_t *gc_block);
+
+#if TRINAMIC_DYNAMIC_CURRENT
+
+// Configured run current and hold current percentage, the run current is reduced to TRINAMIC_CRUISE_CURRENT_PCT
+// percent when cruising or idle while the hold current is kept.
+static struct {
+    uint16_t current;
+    uint8_t hold_pct;
+} base_current[N_AXIS];
+static uint_fast8_t current_pct = 100;
+
+static void apply_current (uint_fast8_t axis)
+{
+    TMC2130_SetCurrent(&stepper[axis], (uint16_t)((uint32_t)base_current[axis].current * current_pct / 100),
+                        (uint8_t)min(100, (uint32_t)base_current[axis].hold_pct * 100 / current_pct));
+}
+
+// Full current when accelerating and decelerating, reduced when cruising or idle.
+static void trinamic_motion_phase (motion_phase_t phase)
+{
+    uint_fast8_t pct = phase == MotionPhase_Accel || phase == MotionPhase_Decel ? 100 : TRINAMIC_CRUISE_CURRENT_PCT;
+
+    if(pct != current_pct) {
+        uint_fast8_t idx = N_AXIS;
+        current_pct = pct;
+        do {
+            if(bit_istrue(driver_settings.trinamic.driver_enable.mask, bit(--idx)))
+                apply_current(idx);
+        } while(idx);
+    }
+}
+
+#endif
+
+// Configured hold current percentage.
+static inline uint8_t hold_current_pct (uint_fast8_t axis)
+{
+#if TRINAMIC_DYNAMIC_CURRENT
+    return base_current[axis].hold_pct;
+#else
+    return stepper[axis].hold_current_pct;
+#endif
+}
+
+static void set_current (uint_fast8_t axis, uint16_t current, uint8_t hold_pct)
+{
+#if TRINAMIC_DYNAMIC_CURRENT
+    base_current[axis].current = current;
+    base_current[axis].hold_pct = hold_pct;
+    apply_current(axis);
+#else
+    TMC2130_SetCurrent(&stepper[axis], current, hold_pct);
+#endif
+}
 
 // Wrapper for initializing physical interface (since two alternatives are provided)
 void TMC_DriverInit (TMC_io_driver_t *driver)
@@ -158,8 +228,15 @@ void trinamic_init (void)
           #if TRINAMIC_I2C
             TMC2130_WriteRegister(NULL, (TMC2130_datagram_t *)&dgr_enable);
           #endif
+          #if TRINAMIC_DYNAMIC_CURRENT
+            set_current(idx, stepper[idx].current, stepper[idx].hold_current_pct);
+          #endif
         }
     } while(idx);
+
+#if TRINAMIC_DYNAMIC_CURRENT
+    hook_register(Hook_MotionPhase, (hook_fn_t){ .motion_phase = trinamic_motion_phase }, 10, true);
+#endif
 }
 
 // Update driver settings on changes
@@ -170,7 +247,7 @@ void trinamic_configure (void)
     do {
         if(bit_istrue(driver_settings.trinamic.driver_enable.mask, bit(--idx))) {
             stepper[idx].r_sense = driver_settings.trinamic.driver[idx].r_sense;
-            TMC2130_SetCurrent(&stepper[idx], driver_settings.trinamic.driver[idx].current, stepper[idx].hold_current_pct);
+            set_current(idx, driver_settings.trinamic.driver[idx].current, hold_current_pct(idx));
             TMC2130_SetMicrosteps(&stepper[idx], driver_settings.trinamic.driver[idx].microsteps);
         }
     } while(idx);
@@ -324,39 +401,108 @@ static void write_line (char *s)
     hal.stream.write(s);
 }
 
-//
-static void report_sg_status (uint_fast16_t state)
+#if TRINAMIC_ASYNC_IO
+
+static void drv_status_read (TMC2130_t *driver, TMC2130_datagram_t *reg)
+{
+    status_poll.fresh.mask |= bit(driver - stepper);
+    status_poll.busy = false;
+}
+
+#endif
+
+// Read DRV_STATUS of the next requested driver into its shadow register, one driver per call.
+// With TRINAMIC_ASYNC_IO the read is queued and the call returns without waiting for the bus,
+// a read that cannot be queued since the bus is busy is retried on the next call.
+static void poll_drv_status (void)
 {
-    if(report.sg_status) {
-        report.sg_status = false;
-        TMC2130_ReadRegister(&stepper[report.sg_status_axis], (TMC2130_datagram_t *)&stepper[report.sg_status_axis].drv_status);
-        hal.stream.write("[SG:");
-        hal.stream.write(uitoa((uint32_t)stepper[report.sg_status_axis].drv_status.reg.sg_result));
-        hal.stream.write("]\r\n");
+    if(status_poll.request.mask == 0 || status_poll.busy)
+        return;
+
+    while(!(status_poll.request.mask & bit(status_poll.axis)))
+        status_poll.axis = status_poll.axis == N_AXIS - 1 ? 0 : status_poll.axis + 1;
+
+#if TRINAMIC_ASYNC_IO
+    status_poll.busy = true;
+    if(!TMC_ReadRegisterAsync(&stepper[status_poll.axis], (TMC2130_datagram_t *)&stepper[status_poll.axis].drv_status, drv_status_read)) {
+        status_poll.busy = false;
+        return;
     }
-    if(hal_execute_realtime)
-        hal_execute_realtime(state);
+#else
+    TMC2130_ReadRegister(&stepper[status_poll.axis], (TMC2130_datagram_t *)&stepper[status_poll.axis].drv_status);
+    status_poll.fresh.mask |= bit(status_poll.axis);
+#endif
+
+    status_poll.request.mask &= ~bit(status_poll.axis);
 }
 
-static void report_sg_params (void)
+// Write buffered stallGuard samples as [SG:<ms>:<axis values>:<axis values>...], values are for
+// the reported axes in axis order and samples are report.sg_interval ms apart.
+static void write_sg_samples (void)
 {
-    sprintf(sbuf, "[SGPARAMS:%ld:%d:%d:%d]\r\n", report.sg_status_axis, stepper[report.sg_status_axis].coolconf.reg.sfilt, stepper[report.sg_status_axis].coolconf.reg.semin, stepper[report.sg_status_axis].coolconf.reg.semax);
-    hal.stream.write(sbuf);
+    static char buf[(6 + 5 * N_AXIS) * TRINAMIC_SG_BATCH + 16];
+    uint_fast8_t idx, sample;
+
+    if(sg_samples.count == 0)
+        return;
+
+    strcpy(buf, "[SG:");
+    strcat(buf, uitoa(sg_samples.ms));
+
+    for(sample = 0; sample < sg_samples.count; sample++) {
+        char *sep = ":";
+        for(idx = 0; idx < N_AXIS; idx++) {
+            if(bit_istrue(report.axes.mask, bit(idx))) {
+                strcat(buf, sep);
+                strcat(buf, uitoa(sg_samples.sg_result[sample][idx]));
+                sep = ",";
+            }
+        }
+    }
+
+    write_line(buf);
+    sg_samples.count = 0;
 }
 
-static void stepper_pulse_start (stepper_t *motors)
+// Sample stallGuard results of all reported axes every report.sg_interval ms, reading one driver
+// per call. Replaces sampling triggered from the step interrupt. Samples are taken from the shadow
+// registers only when all reads of the interval are completed.
+static void report_sg_status (uint_fast16_t state)
 {
-    static uint32_t step_count = 0;
-    hal_stepper_pulse_start(motors);
-    report.sg_status_axis = 0;
+    uint_fast8_t idx;
 
-    if(motors->step_outbits.x) {
-        step_count++;
-        if(step_count == report.msteps) {
-            step_count = 0;
-            report.sg_status = true;
+    if(status_poll.request.mask == 0 && status_poll.fresh.mask == 0) {
+        uint32_t ms = hal.get_elapsed_ticks ? hal.get_elapsed_ticks() : status_poll.last_ms + report.sg_interval;
+        if(ms - status_poll.last_ms >= report.sg_interval) {
+            status_poll.last_ms = ms;
+            status_poll.request.mask = report.axes.mask;
         }
     }
+
+    poll_drv_status();
+
+    if(status_poll.request.mask == 0 && !status_poll.busy && status_poll.fresh.mask) {
+
+        if(sg_samples.count == 0)
+            sg_samples.ms = status_poll.last_ms;
+
+        idx = N_AXIS;
+        do {
+            idx--;
+            sg_samples.sg_result[sg_samples.count][idx] = stepper[idx].drv_status.reg.sg_result;
+        } while(idx);
+
+        status_poll.fresh.mask = 0;
+
+        if(++sg_samples.count == TRINAMIC_SG_BATCH)
+            write_sg_samples();
+    }
+}
+
+static void report_sg_params (void)
+{
+    sprintf(sbuf, "[SGPARAMS:%ld:%d:%d:%d]\r\n", report.sg_status_axis, stepper[report.sg_status_axis].coolconf.reg.sfilt, stepper[report.sg_status_axis].coolconf.reg.semin, stepper[report.sg_status_axis].coolconf.reg.semax);
+    hal.stream.write(sbuf);
 }
 
 // Enable/disable stallGuard
@@ -416,7 +562,8 @@ user_mcode_t trinamic_MCodeCheck (user_mcode_t mcode)
 
     return driver_settings.trinamic.driver_enable.mask &&
             (mcode == Trinamic_DebugReport || mcode == Trinamic_StepperCurrent || mcode == Trinamic_ReportPrewarnFlags ||
-              mcode == Trinamic_ClearPrewarnFlags || mcode == Trinamic_HybridThreshold || mcode == Trinamic_HomingSensivity) ? mcode : UserMCode_Ignore;
+              mcode == Trinamic_ClearPrewarnFlags || mcode == Trinamic_HybridThreshold || mcode == Trinamic_HomingSensivity ||
+               mcode == Trinamic_HomingCalibrate) ? mcode : UserMCode_Ignore;
 }
 
 // Validate driver specific M-code parameters
@@ -455,10 +602,16 @@ status_code_t trinamic_MCodeValidate (parser_block_t *gc_block, uint32_t *value_
             if(bit_istrue(*value_words, bit(Word_H)))
                 report.sfilt = gc_block->values.h != 0.0f;
 
-            if(bit_istrue(*value_words, bit(Word_S))) {
+            if(bit_istrue(*value_words, bit(Word_S)))
                 report.sg_status_enable = gc_block->values.s != 0.0f;
-                report.msteps = driver_settings.trinamic.driver[report.sg_status_axis].microsteps;
-            }
+
+            if(bit_istrue(*value_words, bit(Word_P))) {
+                if(gc_block->values.p < 1.0f)
+                    state = Status_GcodeValueOutOfRange;
+                else
+                    report.sg_interval = (uint32_t)gc_block->values.p;
+            } else if(report.sg_interval == 0)
+                report.sg_interval = TRINAMIC_SG_SAMPLE_INTERVAL;
 
             if(report.axes.mask) {
                 report.axes.mask &= driver_settings.trinamic.driver_enable.mask;
@@ -474,7 +627,7 @@ status_code_t trinamic_MCodeValidate (parser_block_t *gc_block, uint32_t *value_
             } else
                 report.axes.mask = driver_settings.trinamic.driver_enable.mask;
 
-            bit_false(*value_words, bit(Word_Q|Word_S|bit(Word_X)|bit(Word_Y)|bit(Word_Z)|bit(Word_H)));
+            bit_false(*value_words, bit(Word_Q|Word_S|bit(Word_X)|bit(Word_Y)|bit(Word_Z)|bit(Word_H)|bit(Word_P)));
 
 //            gc_block->user_mcode_sync = true;
             break;
@@ -514,6 +667,20 @@ status_code_t trinamic_MCodeValidate (parser_block_t *gc_block, uint32_t *value_
             }
             break;
 
+        case Trinamic_HomingCalibrate:
+            if(check_params(gc_block, value_words)) {
+                state = Status_OK;
+                gc_block->user_mcode_sync = true;
+                if(bit_isfalse(*value_words, bit(Word_F)))
+                    gc_block->values.f = settings.homing.seek_rate * 4.0f;
+                else if(gc_block->values.f < settings.homing.seek_rate)
+                    state = Status_GcodeValueOutOfRange;
+                if(bit_isfalse(*value_words, bit(Word_P)))
+                    gc_block->values.p = 0.0f;
+                bit_false(*value_words, bit(Word_F)|bit(Word_P));
+            }
+            break;
+
         default:
             break;
     }
@@ -543,18 +710,21 @@ void trinamic_MCodeExecute (uint_fast16_t state, parser_block_t *gc_block)
 
         case Trinamic_DebugReport:
             if(report.sg_status_enable) {
-                if(hal.execute_realtime != report_sg_status) {
-                    hal_execute_realtime = hal.execute_realtime;
-                    hal.execute_realtime = report_sg_status;
-                    hal_stepper_pulse_start = hal.stepper_pulse_start;
-                    hal.stepper_pulse_start = stepper_pulse_start;
+                if(!sg_status_active) {
+                    status_poll.request.mask = status_poll.fresh.mask = 0;
+                    sg_samples.count = 0;
+                    sg_status_active = hook_register(Hook_ExecuteRealtime, (hook_fn_t){ .execute_realtime = report_sg_status }, 20, true);
                 }
-                stepper[report.sg_status_axis].coolconf.reg.sfilt = report.sfilt;
-                TMC2130_WriteRegister(&stepper[report.sg_status_axis], (TMC2130_datagram_t *)&stepper[report.sg_status_axis].coolconf);
-            } else if(hal.execute_realtime == report_sg_status) {
-                hal.execute_realtime = NULL;
-                hal.execute_realtime = hal_execute_realtime;
-                hal.stepper_pulse_start = hal_stepper_pulse_start;
+                do {
+                    if(bit_istrue(report.axes.mask, bit(--idx))) {
+                        stepper[idx].coolconf.reg.sfilt = report.sfilt;
+                        TMC2130_WriteRegister(&stepper[idx], (TMC2130_datagram_t *)&stepper[idx].coolconf);
+                    }
+                } while(idx);
+            } else if(sg_status_active) {
+                sg_status_active = false;
+                hook_enable(Hook_ExecuteRealtime, (hook_fn_t){ .execute_realtime = report_sg_status }, false);
+                write_sg_samples();
             }
             write_debug_report();
             break;
@@ -563,8 +733,8 @@ void trinamic_MCodeExecute (uint_fast16_t state, parser_block_t *gc_block)
             do {
                 idx--;
                 if(!isnan(gc_block->values.xyz[idx]))
-                    TMC2130_SetCurrent(&stepper[idx], (uint16_t)gc_block->values.xyz[idx],
-                                        isnan(gc_block->values.q) ? stepper[idx].hold_current_pct : (uint8_t)gc_block->values.q);
+                    set_current(idx, (uint16_t)gc_block->values.xyz[idx],
+                                  isnan(gc_block->values.q) ? hold_current_pct(idx) : (uint8_t)gc_block->values.q);
             } while(idx);
             break;
 
@@ -613,6 +783,10 @@ void trinamic_MCodeExecute (uint_fast16_t state, parser_block_t *gc_block)
             } while(idx);
             break;
 
+        case Trinamic_HomingCalibrate:
+            homing_calibrate(gc_block);
+            break;
+
         default:
             break;
     }
@@ -637,7 +811,7 @@ static axes_signals_t trinamic_limits (void)
 
     signals.mask &= ~homing.mask;
 
-    if(hal.clear_bits_atomic(&diag1_poll, 0)) {
+    if(system_bits_clear_atomic(&diag1_poll, 0)) {
         // TODO: read I2C bridge status register instead of polling drivers when using I2C comms
         uint_fast8_t idx = N_AXIS;
         do {
@@ -679,6 +853,164 @@ void trinamic_homing (bool enable)
     }
 }
 
+/*
+  Sensorless homing calibration (M915).
+
+  For each axis given, or all sensorless homing axes, homing rates from $25 up to the F word (default 4 * $25)
+  are tried in steps of TRINAMIC_CAL_RATE_STEP. For each rate the lowest, most sensitive, stallGuard threshold
+  giving a stallGuard result of at least TRINAMIC_CAL_SG_MARGIN when running free at speed is searched for by
+  moving the axis TRINAMIC_CAL_DISTANCE away from the homing switch and back. The fastest rate with such a
+  threshold is kept and reported as [TMCHOMING:<axis>:<rate>:<threshold>:<min sg_result>].
+  The thresholds are set as the homing sensitivity, with P1 they are stored and $25 is set to the lowest
+  rate found. The axes must be clear of obstacles for TRINAMIC_CAL_DISTANCE in the opposite homing direction.
+*/
+
+
+static struct {
+    uint_fast8_t axis;
+    float min_rate;     // Min. rate for sampling, excludes acceleration and deceleration
+    uint32_t sg_min;
+    uint32_t samples;
+} sg_cal;
+
+static void sg_cal_sample (uint_fast16_t state)
+{
+    if(st_get_realtime_rate() >= sg_cal.min_rate) {
+        TMC2130_ReadRegister(&stepper[sg_cal.axis], (TMC2130_datagram_t *)&stepper[sg_cal.axis].drv_status);
+        if(stepper[sg_cal.axis].drv_status.reg.sg_result < sg_cal.sg_min)
+            sg_cal.sg_min = stepper[sg_cal.axis].drv_status.reg.sg_result;
+        sg_cal.samples++;
+    }
+}
+
+// Move the axis away from the homing switch and back at rate with stallGuard threshold sgt.
+// Returns the lowest stallGuard result seen at speed, -1 if a stall was signalled, speed not reached or motion failed.
+static int32_t sg_cal_trial (uint_fast8_t axis, float rate, int_fast8_t sgt)
+{
+    float target[N_AXIS], start;
+    plan_line_data_t plan_data;
+
+    stepper[axis].coolconf.reg.sgt = sgt & 0x7F; // 7-bits signed value
+    TMC2130_WriteRegister(&stepper[axis], (TMC2130_datagram_t *)&stepper[axis].coolconf);
+
+    memset(&plan_data, 0, sizeof(plan_line_data_t));
+    plan_data.feed_rate = rate;
+    plan_data.condition.no_feed_override = On;
+
+    sg_cal.axis = axis;
+    sg_cal.min_rate = rate * 0.95f;
+    sg_cal.sg_min = 0x3FF;
+    sg_cal.samples = 0;
+    diag1_poll = 0;
+
+    system_convert_array_steps_to_mpos(target, sys_position);
+    start = target[axis];
+    // Homing direction is negative when the direction mask bit is set.
+    target[axis] += bit_istrue(settings.homing.dir_mask.value, bit(axis)) ? TRINAMIC_CAL_DISTANCE : -TRINAMIC_CAL_DISTANCE;
+
+    if(!mc_line(target, &plan_data))
+        return -1;
+
+    target[axis] = start;
+    if(!(mc_line(target, &plan_data) && protocol_buffer_synchronize()))
+        return -1;
+
+    return diag1_poll || sg_cal.samples == 0 ? -1 : (int32_t)sg_cal.sg_min;
+}
+
+// Binary search for the lowest threshold leaving at least TRINAMIC_CAL_SG_MARGIN when running free at rate.
+static bool sg_cal_threshold (uint_fast8_t axis, float rate, int_fast8_t *sgt, int32_t *margin)
+{
+    bool found = false;
+    int32_t sg_min;
+    int_fast8_t lo = -64, hi = 63, mid;
+
+    while(lo <= hi && !ABORTED) {
+        mid = lo + (hi - lo) / 2;
+        if((sg_min = sg_cal_trial(axis, rate, mid)) >= TRINAMIC_CAL_SG_MARGIN) {
+            found = true;
+            *sgt = mid;
+            *margin = sg_min;
+            hi = mid - 1;
+        } else
+            lo = mid + 1;
+    }
+
+    return found && !ABORTED;
+}
+
+static void homing_calibrate (parser_block_t *gc_block)
+{
+    uint_fast8_t idx;
+    int_fast8_t sgt, best_sgt = 0;
+    int32_t margin, best_margin = 0;
+    float rate, best_rate, min_rate = 0.0f;
+    axes_signals_t axes = {0};
+
+    idx = N_AXIS;
+    do {
+        idx--;
+        if(!isnan(gc_block->values.xyz[idx]))
+            axes.mask |= bit(idx);
+    } while(idx);
+
+    axes.mask &= driver_settings.trinamic.driver_enable.mask & driver_settings.trinamic.homing_enable.mask;
+
+    is_homing = true; // DIAG1 stall signals set diag1_poll instead of raising an alarm
+    hook_register(Hook_ExecuteRealtime, (hook_fn_t){ .execute_realtime = sg_cal_sample }, 20, true);
+
+    for(idx = 0; idx < N_AXIS && !ABORTED; idx++) {
+
+        if(bit_isfalse(axes.mask, bit(idx)))
+            continue;
+
+        stallGuard_enable(idx, true);
+
+        best_rate = 0.0f;
+        rate = settings.homing.seek_rate;
+        while(rate <= gc_block->values.f && sg_cal_threshold(idx, rate, &sgt, &margin)) {
+            best_rate = rate;
+            best_sgt = sgt;
+            best_margin = margin;
+            rate *= TRINAMIC_CAL_RATE_STEP;
+        }
+
+        stallGuard_enable(idx, false);
+
+        if(ABORTED)
+            break;
+
+        strcpy(sbuf, "[TMCHOMING:");
+        strcat(sbuf, axis_letter[idx]);
+        strcat(sbuf, ":");
+        strcat(sbuf, ftoa(best_rate, N_DECIMAL_RATEVALUE_MM));
+        if(best_rate > 0.0f) {
+            driver_settings.trinamic.driver[idx].homing_sensitivity = best_sgt;
+            min_rate = min_rate == 0.0f ? best_rate : min(min_rate, best_rate);
+            sprintf(append(sbuf), ":%d:%ld", (int)best_sgt, (long)best_margin);
+        }
+        strcat(sbuf, "]");
+        write_line(sbuf);
+    }
+
+    hook_enable(Hook_ExecuteRealtime, (hook_fn_t){ .execute_realtime = sg_cal_sample }, false);
+    is_homing = false;
+
+    // Restore thresholds, stallGuard_enable() sets them from the homing sensitivity.
+    idx = N_AXIS;
+    do {
+        if(bit_istrue(axes.mask, bit(--idx))) {
+            stepper[idx].coolconf.reg.sgt = driver_settings.trinamic.driver[idx].homing_sensitivity & 0x7F;
+            TMC2130_WriteRegister(&stepper[idx], (TMC2130_datagram_t *)&stepper[idx].coolconf);
+        }
+    } while(idx);
+
+    if(!ABORTED && gc_block->values.p != 0.0f && min_rate > 0.0f) {
+        hal.eeprom.memcpy_to_with_checksum(hal.eeprom.driver_area.address, (uint8_t *)&driver_settings, sizeof(driver_settings));
+        settings_store_global_setting(Setting_HomingSeekRate, ftoa(min_rate, N_DECIMAL_RATEVALUE_MM));
+    }
+}
+
 // Write Marlin style driver debug report to output stream (M122)
 // NOTE: this output is not in a parse friendly format for grbl senders
 static void write_debug_report (void)
@@ -36,6 +36,42 @@
 
 #if TRINAMIC_ENABLE
 
+// Dynamic current: set to 1 to reduce the run current to TRINAMIC_CRUISE_CURRENT_PCT percent when cruising
+// or idle, full current is used when accelerating and decelerating. The hold current is not changed.
+#ifndef TRINAMIC_DYNAMIC_CURRENT
+#define TRINAMIC_DYNAMIC_CURRENT 0
+#endif
+#ifndef TRINAMIC_CRUISE_CURRENT_PCT
+#define TRINAMIC_CRUISE_CURRENT_PCT 70
+#endif
+
+// Default stallGuard sample interval for the M122 S1 report, set by the P word.
+#ifndef TRINAMIC_SG_SAMPLE_INTERVAL
+#define TRINAMIC_SG_SAMPLE_INTERVAL 20 // ms
+#endif
+// Sensorless homing calibration (M915): travel of each trial move, min. stallGuard result required
+// when running free and factor between the homing rates tried.
+#ifndef TRINAMIC_CAL_DISTANCE
+#define TRINAMIC_CAL_DISTANCE 10.0f // mm
+#endif
+#ifndef TRINAMIC_CAL_SG_MARGIN
+#define TRINAMIC_CAL_SG_MARGIN 100
+#endif
+#ifndef TRINAMIC_CAL_RATE_STEP
+#define TRINAMIC_CAL_RATE_STEP 1.25f
+#endif
+
+// Number of stallGuard samples written per report line.
+#ifndef TRINAMIC_SG_BATCH
+#define TRINAMIC_SG_BATCH 4
+#endif
+
+// Set to 1 by drivers providing TMC_ReadRegisterAsync(), the stallGuard report then queues its DRV_STATUS
+// reads instead of reading from the realtime loop.
+#ifndef TRINAMIC_ASYNC_IO
+#define TRINAMIC_ASYNC_IO 0
+#endif
+
 #define tmc_write_register(axis, reg, val) { TMC2130_datagram_t *p = TMC2130_GetRegPtr(&stepper[axis], reg); p->payload.value = val; TMC2130_WriteRegister(&stepper[ axis], p); }
 
 #define tmc_stealthChop(axis, val)      { stepper[axis].gconf.reg.en_pwm_mode = val; TMC2130_WriteRegister(&stepper[axis], (TMC2130_datagram_t *)&stepper[axis].gconf); }
@@ -146,6 +182,13 @@ typedef struct {
 // Init wrapper for physical interface
 void TMC_DriverInit (TMC_io_driver_t *driver);
 
+#if TRINAMIC_ASYNC_IO
+// Called from interrupt context when a queued register read completes, the payload of reg is updated.
+typedef void (*tmc_read_callback_ptr)(TMC2130_t *driver, TMC2130_datagram_t *reg);
+// Provided by the driver, starts a register read and returns without waiting. Returns false if the bus is busy.
+bool TMC_ReadRegisterAsync (TMC2130_t *driver, TMC2130_datagram_t *reg, tmc_read_callback_ptr callback);
+#endif
+
 void trinamic_init (void);
 void trinamic_configure (void);
 void trinamic_homing (bool enable);
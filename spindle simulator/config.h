@@ -83,11 +83,26 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define SPINDLE_PULSE_CCR1 timerCcr(SPINDLE_PULSE_TIMER, SPINDLE_PULSE_TIMERI, 1)
 #define SPINDLE_PULSE_CCTL0 timerCCtl(SPINDLE_PULSE_TIMER, SPINDLE_PULSE_TIMERI, 0)
 #define SPINDLE_PULSE_CCTL1 timerCCtl(SPINDLE_PULSE_TIMER, SPINDLE_PULSE_TIMERI, 1)
+#define SPINDLE_PULSE_CCR2 timerCcr(SPINDLE_PULSE_TIMER, SPINDLE_PULSE_TIMERI, 2)
+#define SPINDLE_PULSE_CCTL2 timerCCtl(SPINDLE_PULSE_TIMER, SPINDLE_PULSE_TIMERI, 2)
+#define SPINDLE_PULSE_R timerR(SPINDLE_PULSE_TIMER, SPINDLE_PULSE_TIMERI)
+#define SPINDLE_PULSE_IV timerIv(SPINDLE_PULSE_TIMER, SPINDLE_PULSE_TIMERI)
 #define SPINDLE_PULSE_IRQH timerInt(SPINDLE_PULSE_TIMER, SPINDLE_PULSE_TIMERI, 0)
+#define SPINDLE_PULSE_IRQH1 timerInt(SPINDLE_PULSE_TIMER, SPINDLE_PULSE_TIMERI, 1)
 
 #define SPINDLE_PULSE_PORT_DIR portDir(SPINDLE_PULSE_PORT)
 #define SPINDLE_PULSE_PORT_SEL portSel(SPINDLE_PULSE_PORT)
 
+// Inputs captured by the spindle pulse timer for the HIL measurements
+
+#define STEP_IN_PORT    2
+#define STEP_IN_BIT     BIT3 // P2.3 - step pulse input, TA1 CCI0B
+#define STEP_IN_PORT_SEL portSel(STEP_IN_PORT)
+
+#define PWM_IN_PORT     2
+#define PWM_IN_BIT      BIT5 // P2.5 - unfiltered PWM input, TA1 CCI2B
+#define PWM_IN_PORT_SEL portSel(PWM_IN_PORT)
+
 #define SPINDLE_ON_PORT     2
 #define SPINDLE_ON_BIT      BIT2 // P2.2
 #define SPINDLE_ON_PORT_IN  portIn(SPINDLE_ON_PORT)
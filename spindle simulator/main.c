@@ -3,7 +3,7 @@
 //
 // For Texas Instruments MSP430 Value Line Launchpad
 //
-// v1.0 / 2019-03-21 / Io Engineering / Terje
+// v1.1 / 2020-10-14 / Io Engineering / Terje
 //
 
 /*
@@ -52,8 +52,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MSG_FAIL  3U
 #define MSG_BADC  4U
 
+#define PULSE_WIDTH  10         // Encoder pulse width, in timer ticks
+#define PERIOD_MIN   100        // Shortest encoder pulse period, in timer ticks
+#define PASS_GAP     200000UL   // No steps for 100 ms starts a new threading pass, in timer ticks
+#define PWM_CHANGE   4          // Smallest change of the PWM high time taken as an update, in timer ticks
+#define TICKS_PER_US 2          // Timer ticks per microsecond, SMCLK / 8
+
 char const *const message[] = {
-    "\r\nSpindle Simulator 1.0\0",
+    "\r\nSpindle Simulator 1.1\0",
     "Error: missing parameters",
     "OK",
     "FAILED",
@@ -66,12 +72,124 @@ typedef struct {
     const bool report;
 } command_t;
 
+// Hardware in the loop measurements, positions and angles are in 1/256 encoder pulse
+
+typedef struct {
+    uint16_t spr;           // Steps per spindle revolution for G33 tracking, 0 if not measured
+    uint16_t inc;           // Expected spindle position change per step
+    uint16_t rem;           // and the remainder, in 1/spr
+    uint16_t acc;
+    uint32_t expected;      // Expected spindle position at next step
+    uint32_t last_step;     // Timestamp of last step
+    uint32_t steps;         // Steps tracked, excluding the first step of each pass
+    uint32_t err_sum;       // Sum of absolute tracking errors
+    int32_t err_max;        // Largest absolute tracking error
+    uint16_t passes;        // Threading passes, started by a step after PASS_GAP without steps
+    int32_t phase0;         // Spindle angle from index at the start of the first pass
+    int32_t phase_max;      // Largest absolute angle difference of later passes to the first
+    uint16_t pwm_rise;      // Timer at last PWM rising edge
+    uint16_t pwm_period;    // Last PWM period
+    uint16_t pwm_high;      // Last PWM high time
+    uint16_t pwm_trig;      // PWM high time at the last STEP command
+    bool pwm_pending;       // Waiting for the PWM update following a STEP command
+    uint32_t trig_time;     // Timestamp of the last STEP command
+    uint32_t pwm_latency;   // Time from the last STEP command to the PWM update
+} hil_t;
+
 char cmdbuf[16];
 uint16_t ppr = 120, rpm = 400;
 int16_t step = 0;
 
 bool manual = false, lock = false;
 
+static hil_t hil = {0};
+static volatile bool running = false, pulse_high = false;
+static volatile uint16_t period = 40000;    // Encoder pulse period, in timer ticks
+static volatile uint16_t timer_hi = 0;      // Timer high word, counts timer overflows
+static volatile uint16_t pulse_edge = 0;    // Timer at last encoder pulse
+static volatile uint32_t pulse_count = 0;   // Encoder pulses since spindle start
+static volatile uint16_t pulse_index = 0;   // Encoder pulses since index pulse at next encoder pulse
+static volatile uint16_t pulse_angle = 0;   // Encoder pulses since index pulse at last encoder pulse
+
+// Extends a timer value captured or read in this timer cycle to 32 bits, interrupts must be disabled
+static inline uint32_t timestamp (uint16_t t)
+{
+    uint16_t hi = timer_hi;
+
+    if((SPINDLE_PULSE_CTL & TAIFG) && t < 0x8000) // Overflow not yet counted
+        hi++;
+
+    return ((uint32_t)hi << 16) | t;
+}
+
+char *intToStr (int32_t value)
+{
+    static char buf[12];
+
+    char *s = &buf[sizeof(buf) - 1];
+    uint32_t v = value < 0 ? -value : value;
+
+    *s = '\0';
+
+    do {
+        *--s = '0' + v % 10;
+        v /= 10;
+    } while(v);
+
+    if(value < 0)
+        *--s = '-';
+
+    return s;
+}
+
+// Converts 1/256 encoder pulse to 1/100 degree
+static int32_t centiDegrees (int32_t value)
+{
+    return (value * 1125L) / ((int32_t)ppr * 8L); // 36000 / 256 = 1125 / 8
+}
+
+void hilReset (void)
+{
+    uint16_t spr = hil.spr;
+    uint32_t pos = (uint32_t)ppr << 8;
+
+    _DINT();
+    memset(&hil, 0, sizeof(hil_t));
+    if((hil.spr = spr)) {
+        hil.inc = (uint16_t)(pos / spr);
+        hil.rem = (uint16_t)(pos % spr);
+    }
+    _EINT();
+}
+
+void hilReport (void)
+{
+    hil_t data;
+
+    _DINT();
+    memcpy(&data, &hil, sizeof(hil_t));
+    _EINT();
+
+    serialWriteS("SYNC:");
+    serialWriteS(intToStr(data.steps));
+    serialWriteS(",");
+    serialWriteS(intToStr(centiDegrees(data.err_max)));
+    serialWriteS(",");
+    serialWriteLn(intToStr(data.steps ? centiDegrees(data.err_sum / data.steps) : 0));
+
+    serialWriteS("PHASE:");
+    serialWriteS(intToStr(data.passes));
+    serialWriteS(",");
+    serialWriteLn(intToStr(centiDegrees(data.phase_max)));
+
+    serialWriteS("PWM:");
+    serialWriteS(data.pwm_pending ? "-1" : intToStr(data.pwm_latency / TICKS_PER_US));
+    serialWriteS(",");
+    serialWriteS(intToStr(data.pwm_period / TICKS_PER_US));
+    serialWriteS(",");
+    serialWriteLn(intToStr(data.pwm_high / TICKS_PER_US));
+}
+
 void trigOut (void)
 {
     SPINDLE_TRIG_PORT_OUT |= SPINDLE_TRIG_BIT;
@@ -115,6 +233,8 @@ uint16_t read_adc (void)
 bool setPPR (int value)
 {
     ppr = value;
+    pulse_index = 0;
+    hilReset();
 
     return true;
 }
@@ -129,9 +249,9 @@ void setRPM (int value, int16_t offset)
     uint32_t new_rpm = ((2000000UL * 60UL) / (value + (lock ? 0 : offset)) / ppr);
 
     rpm = value;
-    new_rpm = new_rpm > (1UL << 16) ? (1UL << 16) - 1 : new_rpm;
+    new_rpm = new_rpm > (1UL << 16) ? (1UL << 16) - 1 : (new_rpm < PERIOD_MIN ? PERIOD_MIN : new_rpm);
 
-    SPINDLE_PULSE_CCR0 = (uint16_t)new_rpm;
+    period = (uint16_t)new_rpm;
 
     INDEX_CCR0 = 25;
     INDEX_CCR1 = 5;
@@ -146,11 +266,16 @@ bool cmdSetRPM (char *params)
 
 void SpindleOn (bool on)
 {
-    if(on) {
-        SPINDLE_PULSE_CTL |= MC0;       // Start timer in up mode and
-        trigOut();                      // output trigger pulse
+    if(on == running)
+        return;
+
+    if((running = on)) {
+        pulse_high = false;
+        SPINDLE_PULSE_CCR1 = SPINDLE_PULSE_R + period;
+        SPINDLE_PULSE_CCTL1 = OUTMOD_4|CCIE;    // Toggle encoder output on compare and
+        trigOut();                              // output trigger pulse
     } else
-        SPINDLE_PULSE_CTL &= ~MC0;      // Stop timer
+        SPINDLE_PULSE_CCTL1 = OUTMOD_0;         // Stop encoder output, low
 }
 
 bool cmdSpindle (char *params)
@@ -168,6 +293,24 @@ bool cmdAuto (char *params)
     return true;
 }
 
+bool cmdSPR (char *params)
+{
+    hil.spr = parseInt(params);
+    hilReset();
+
+    return true;
+}
+
+bool cmdHIL (char *params)
+{
+    if(parseInt(params))
+        hilReport();
+    else
+        hilReset();
+
+    return true;
+}
+
 bool cmdLock (char *params)
 {
     lock = parseInt(params);
@@ -179,6 +322,12 @@ bool cmdStep (char *params)
 {
     step = parseInt(params);
 
+    _DINT();
+    hil.pwm_trig = hil.pwm_high;
+    hil.pwm_pending = true;
+    hil.trig_time = timestamp(SPINDLE_PULSE_R);
+    _EINT();
+
     trigOut();
 
     return true;
@@ -192,7 +341,9 @@ void exeCommand (char *cmdline)
         "SPINDLE:", cmdSpindle, true,
         "AUTO:",    cmdAuto, true,
         "LOCK:",    cmdLock, true,
-        "STEP:",    cmdStep, true
+        "STEP:",    cmdStep, true,
+        "SPR:",     cmdSPR, true,
+        "HIL:",     cmdHIL, true
     };
 
     static const uint16_t numcmds = sizeof(commands) / sizeof(command_t);
@@ -245,14 +396,15 @@ void main (void)
     INDEX_CTL = TASSEL1|ID0|ID1|TACLR;  // bind to SMCLK and clear TA
     INDEX_PORT_SEL |= INDEX_BIT;        // Enable TA0.1 on INDEX pin
     INDEX_PORT_DIR |= INDEX_BIT;        // Set X step and
-    SPINDLE_PULSE_CCTL0 = CCIE;
-
-    SPINDLE_PULSE_CCR0 = 40000;                     // Set initial step time and
-    SPINDLE_PULSE_CCR1 = 10;                        // pulse width
-    SPINDLE_PULSE_CCTL1 = OUTMOD_7;                 // Set output mode to PWM,
-    SPINDLE_PULSE_CTL = TASSEL1|ID0|ID1|TACLR;      // bind to SMCLK and clear TA
-    SPINDLE_PULSE_PORT_SEL |= SPINDLE_PULSE_BIT;    // Enable TA1.0 on Y/ZSTEP pins
-    SPINDLE_PULSE_PORT_DIR |= SPINDLE_PULSE_BIT;    // Set step pins as outputs
+
+    SPINDLE_PULSE_CCTL0 = CM_1|CCIS_1|SCS|CAP|CCIE; // Capture step input (CCI0B) on rising edge,
+    SPINDLE_PULSE_CCTL1 = OUTMOD_0;                 // encoder output low until spindle on,
+    SPINDLE_PULSE_CCTL2 = CM_3|CCIS_1|SCS|CAP|CCIE; // capture PWM input (CCI2B) on both edges,
+    SPINDLE_PULSE_CTL = TASSEL1|ID0|ID1|MC1|TACLR|TAIE; // bind to SMCLK, continuous mode, overflow interrupt
+    SPINDLE_PULSE_PORT_SEL |= SPINDLE_PULSE_BIT;    // Enable TA1.1 on encoder pulse pin
+    SPINDLE_PULSE_PORT_DIR |= SPINDLE_PULSE_BIT;    // Set encoder pin as output
+    STEP_IN_PORT_SEL |= STEP_IN_BIT;                // Enable TA1.0 capture on step input pin
+    PWM_IN_PORT_SEL |= PWM_IN_BIT;                  // Enable TA1.2 capture on PWM input pin
     INDEX_CCTL0 = CCIE;                             // Enable X step timer interrupt
 
     SPINDLE_ON_PORT_OUT |= SPINDLE_ON_BIT;
@@ -308,16 +460,101 @@ void main (void)
     }
 }
 
+// Step input capture: tracking error against the spindle position and phase of each threading pass
 #pragma vector=SPINDLE_PULSE_IRQH
-__interrupt void TIMER_SP_ISR(void)
+__interrupt void TIMER_STEP_ISR(void)
 {
-    static unsigned int index = 0;
+    uint16_t t = SPINDLE_PULSE_CCR0, dt = t - pulse_edge, angle = pulse_angle;
+    uint32_t ts = timestamp(t), pulses = pulse_count, pos;
+    int32_t err;
 
-    if(index == 0) {
-        index = ppr - 1;
-        INDEX_CTL |= MC0;   // Start index timer in up mode
-    } else
-        index--;
+    if(!running || hil.spr == 0)
+        return;
+
+    if(dt >= period) { // Encoder pulse not yet handled
+        dt -= period;
+        pulses++;
+        angle = pulse_index;
+    }
+
+    dt = (uint16_t)(((uint32_t)dt << 8) / period);
+    pos = (pulses << 8) + dt;
+
+    if(hil.passes == 0 || ts - hil.last_step > PASS_GAP) { // Start of pass
+        err = ((int32_t)angle << 8) + dt;
+        if(hil.passes++ == 0)
+            hil.phase0 = err;
+        else {
+            err -= hil.phase0;
+            if(err > ((int32_t)ppr << 7))
+                err -= (int32_t)ppr << 8;
+            else if(err < -((int32_t)ppr << 7))
+                err += (int32_t)ppr << 8;
+            if(err < 0)
+                err = -err;
+            if(err > hil.phase_max)
+                hil.phase_max = err;
+        }
+        hil.expected = pos;
+        hil.acc = 0;
+    } else {
+        hil.expected += hil.inc;
+        if((hil.acc += hil.rem) >= hil.spr) {
+            hil.acc -= hil.spr;
+            hil.expected++;
+        }
+        err = (int32_t)(pos - hil.expected);
+        if(err < 0)
+            err = -err;
+        if(err > hil.err_max)
+            hil.err_max = err;
+        hil.err_sum += err;
+        hil.steps++;
+    }
+
+    hil.last_step = ts;
+}
+
+// Encoder pulse output, PWM input capture and timer overflow
+#pragma vector=SPINDLE_PULSE_IRQH1
+__interrupt void TIMER_SP_ISR(void)
+{
+    uint16_t t;
+
+    switch(SPINDLE_PULSE_IV) {
+
+        case 2: // CCR1, encoder pulse output toggled
+            if((pulse_high = !pulse_high)) {
+                pulse_edge = SPINDLE_PULSE_CCR1;
+                SPINDLE_PULSE_CCR1 += PULSE_WIDTH;
+                pulse_count++;
+                pulse_angle = pulse_index;
+                if(pulse_index == 0)
+                    INDEX_CTL |= MC0;   // Start index timer in up mode
+                if(++pulse_index >= ppr)
+                    pulse_index = 0;
+            } else
+                SPINDLE_PULSE_CCR1 += period - PULSE_WIDTH;
+            break;
+
+        case 4: // CCR2, PWM input edge
+            t = SPINDLE_PULSE_CCR2;
+            if(SPINDLE_PULSE_CCTL2 & CCI) {
+                hil.pwm_period = t - hil.pwm_rise;
+                hil.pwm_rise = t;
+            } else {
+                hil.pwm_high = t - hil.pwm_rise;
+                if(hil.pwm_pending && (hil.pwm_high > hil.pwm_trig + PWM_CHANGE || hil.pwm_high + PWM_CHANGE < hil.pwm_trig)) {
+                    hil.pwm_latency = timestamp(t) - hil.trig_time;
+                    hil.pwm_pending = false;
+                }
+            }
+            break;
+
+        case 10: // Timer overflow
+            timer_hi++;
+            break;
+    }
 }
 
 #pragma vector=INDEX_IRQH
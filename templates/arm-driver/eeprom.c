@@ -34,25 +34,28 @@ void eepromPutByte (uint32_t addr, uint8_t new_value)
 }
 
 // Read block of data from EEPROM, return true if checksum matches.
-// Checksum is stored in the byte following the last byte read from the block.
+// Checksum is stored in the two bytes following the last byte read from the block, low byte first.
 bool eepromReadBlockWithChecksum (uint8_t *destination, uint32_t source, uint32_t size)
 {
     uint8_t *data = destination;
+    uint32_t remaining = size;
 
-    for(; size > 0; size--)
+    for(; remaining > 0; remaining--)
       *data++ = eepromGetByte(source++);
 
-    return calc_checksum(destination, size) == eepromGetByte(source);
+    return calc_checksum(destination, size) == (eepromGetByte(source) | (eepromGetByte(source + 1) << 8));
 }
 
-// Write block of data to EEPROM followed by a checksum byte.
+// Write block of data to EEPROM followed by a CRC-16 checksum.
 void eepromWriteBlockWithChecksum (uint32_t destination, uint8_t *source, uint32_t size) {
 
     uint8_t *data = source;
     uint32_t remaining = size;
+    uint16_t checksum = calc_checksum(source, size);
 
     for(; remaining > 0; remaining--)
         eepromPutByte(destination++, *data++);
 
-    eepromPutByte(destination, calc_checksum(source, size));
+    eepromPutByte(destination, (uint8_t)checksum);
+    eepromPutByte(destination + 1, (uint8_t)(checksum >> 8));
 }